@@ -0,0 +1,21 @@
+# - Try to find liburing
+# Once done, this will define
+#
+# LIBURING_FOUND - system has liburing
+# LIBURING_INCLUDE_DIR - the liburing include directory
+# LIBURING_LIBRARIES - link these to use liburing
+
+include(FindPackageHandleStandardArgs)
+
+find_path(LIBURING_INCLUDE_DIR liburing.h
+  PATHS ${LIBURING_INCLUDEDIR})
+
+find_library(LIBURING_LIBRARY uring
+  PATHS ${LIBURING_LIBRARYDIR})
+
+find_package_handle_standard_args(liburing DEFAULT_MSG
+  LIBURING_LIBRARY LIBURING_INCLUDE_DIR)
+
+mark_as_advanced(LIBURING_INCLUDE_DIR LIBURING_LIBRARY)
+
+set(LIBURING_LIBRARIES ${LIBURING_LIBRARY})
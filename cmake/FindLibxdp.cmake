@@ -0,0 +1,24 @@
+# - Try to find libxdp
+# Once done, this will define
+#
+# LIBXDP_FOUND - system has libxdp
+# LIBXDP_INCLUDE_DIR - the libxdp include directory
+# LIBXDP_LIBRARIES - link these to use libxdp
+
+include(FindPackageHandleStandardArgs)
+
+find_path(LIBXDP_INCLUDE_DIR xdp/xsk.h
+  PATHS ${LIBXDP_INCLUDEDIR})
+
+find_library(LIBXDP_LIBRARY xdp
+  PATHS ${LIBXDP_LIBRARYDIR})
+
+find_library(LIBBPF_LIBRARY bpf
+  PATHS ${LIBXDP_LIBRARYDIR})
+
+find_package_handle_standard_args(libxdp DEFAULT_MSG
+  LIBXDP_LIBRARY LIBBPF_LIBRARY LIBXDP_INCLUDE_DIR)
+
+mark_as_advanced(LIBXDP_INCLUDE_DIR LIBXDP_LIBRARY LIBBPF_LIBRARY)
+
+set(LIBXDP_LIBRARIES ${LIBXDP_LIBRARY} ${LIBBPF_LIBRARY})
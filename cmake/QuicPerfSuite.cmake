@@ -0,0 +1,59 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+# quic_perf_suite runs the benchmarks and the perf sample and fails when any
+# of them regressed against QUIC_PERF_BASELINE; quic_perf_baseline records a
+# new baseline. Both only exist with BUILD_TESTS, like the benchmarks.
+
+if(NOT BUILD_TESTS)
+  return()
+endif()
+
+set(QUIC_PERF_BASELINE "${CMAKE_BINARY_DIR}/quic_perf_baseline.json"
+  CACHE FILEPATH "Stored results quic_perf_suite compares against")
+set(QUIC_PERF_TOLERANCE "0.1"
+  CACHE STRING "Default regression tolerance, as a fraction of the baseline")
+set(QUIC_PERF_CPU "0"
+  CACHE STRING "CPU the benchmarks and perf server are pinned to, the perf "
+  "client uses the next one")
+set(QUIC_PERF_BENCHMARK_ARGS ""
+  CACHE STRING "Extra arguments for the folly benchmarks")
+
+find_package(PythonInterp 3 REQUIRED)
+
+set(_QUIC_PERF_BENCHMARKS
+  CubicBench
+  QuicCodecBench
+  QuicLossBench
+  QuicPacketSchedulerBench
+  QuicServerWorkerBench
+)
+
+set(_QUIC_PERF_COMMAND
+  ${PYTHON_EXECUTABLE} ${CMAKE_CURRENT_LIST_DIR}/QuicPerfSuite.py
+  --baseline ${QUIC_PERF_BASELINE}
+  --output ${CMAKE_BINARY_DIR}/quic_perf_results.json
+  --tolerance ${QUIC_PERF_TOLERANCE}
+  --cpu ${QUIC_PERF_CPU}
+  "--benchmark-args=${QUIC_PERF_BENCHMARK_ARGS}"
+  --perf $<TARGET_FILE:perf>
+)
+foreach(benchmark ${_QUIC_PERF_BENCHMARKS})
+  list(APPEND _QUIC_PERF_COMMAND --benchmark $<TARGET_FILE:${benchmark}>)
+endforeach()
+
+add_custom_target(
+  quic_perf_suite
+  COMMAND ${_QUIC_PERF_COMMAND}
+  DEPENDS ${_QUIC_PERF_BENCHMARKS} perf
+  USES_TERMINAL
+)
+
+add_custom_target(
+  quic_perf_baseline
+  COMMAND ${_QUIC_PERF_COMMAND} --update
+  DEPENDS ${_QUIC_PERF_BENCHMARKS} perf
+  USES_TERMINAL
+)
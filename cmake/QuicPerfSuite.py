@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+# Copyright (c) Facebook, Inc. and its affiliates.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+"""
+Runs the mvfst benchmarks and the end to end perf sample pinned to fixed CPUs,
+and compares the results with a stored baseline. Exits non zero when any
+result regressed by more than its tolerance, so that it can gate a deploy the
+same way a test failure does.
+
+Benchmark results are the nanoseconds per iteration folly reports with --json,
+lower is better. The end to end result is the goodput of the perf client in
+Mb/s, higher is better.
+
+The baseline is the JSON this script writes with --update:
+  {
+    "tolerance": 0.1,
+    "tolerances": {"QuicLossBench/processAck(100k_Burst)": 0.25},
+    "results": {"QuicLossBench/processAck(100k_Burst)": 1234.5, ...}
+  }
+"tolerances" is optional and kept as is on --update.
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+
+PERF_GOODPUT_NAME = "perf/goodput_mbps"
+PERF_GOODPUT_RE = re.compile(r"connected=.* goodput Mb/s=([0-9.eE+-]+)")
+
+
+def pinned(cpu):
+    if cpu is None:
+        return None
+    return lambda: os.sched_setaffinity(0, {cpu})
+
+
+def run_benchmark(path, cpu, extra_args):
+    suite = os.path.basename(path)
+    output = subprocess.check_output(
+        [path, "--json"] + extra_args, preexec_fn=pinned(cpu)
+    )
+    # Anything the benchmark logs before the results is not part of the JSON.
+    text = output.decode()
+    results = json.loads(text[text.index("{") :])
+    return {"{}/{}".format(suite, name): ns for name, ns in results.items()}
+
+
+def run_perf(path, server_cpu, client_cpu, port, duration):
+    server = subprocess.Popen(
+        [path, "--mode=server", "--port={}".format(port)],
+        stdout=subprocess.DEVNULL,
+        stderr=subprocess.DEVNULL,
+        preexec_fn=pinned(server_cpu),
+    )
+    try:
+        time.sleep(1)
+        client = subprocess.run(
+            [
+                path,
+                "--mode=client",
+                "--port={}".format(port),
+                "--duration={}".format(duration),
+            ],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.STDOUT,
+            preexec_fn=pinned(client_cpu),
+            check=True,
+        )
+    finally:
+        server.terminate()
+        server.wait()
+    match = PERF_GOODPUT_RE.search(client.stdout.decode())
+    if not match:
+        raise RuntimeError("perf client reported no goodput")
+    return {PERF_GOODPUT_NAME: float(match.group(1))}
+
+
+def higher_is_better(name):
+    return name == PERF_GOODPUT_NAME
+
+
+def compare(results, baseline, default_tolerance):
+    tolerance = baseline.get("tolerance", default_tolerance)
+    tolerances = baseline.get("tolerances", {})
+    regressions = []
+    for name, expected in sorted(baseline.get("results", {}).items()):
+        if name not in results:
+            print("MISSING {}".format(name))
+            regressions.append(name)
+            continue
+        actual = results[name]
+        if expected == 0:
+            continue
+        change = (actual - expected) / expected
+        if higher_is_better(name):
+            change = -change
+        allowed = tolerances.get(name, tolerance)
+        status = "REGRESSED" if change > allowed else "ok"
+        print(
+            "{:9} {} {:.4g} -> {:.4g} ({:+.1%}, tolerance {:.0%})".format(
+                status, name, expected, actual, change, allowed
+            )
+        )
+        if change > allowed:
+            regressions.append(name)
+    for name in sorted(set(results) - set(baseline.get("results", {}))):
+        print("NEW       {} {:.4g}".format(name, results[name]))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split("\n")[0])
+    parser.add_argument("--benchmark", action="append", default=[])
+    parser.add_argument("--benchmark-args", default="")
+    parser.add_argument("--perf")
+    parser.add_argument("--perf-port", type=int, default=6667)
+    parser.add_argument("--perf-duration", type=int, default=10)
+    parser.add_argument("--cpu", type=int, default=None)
+    parser.add_argument("--baseline", required=True)
+    parser.add_argument("--output")
+    parser.add_argument("--tolerance", type=float, default=0.1)
+    parser.add_argument("--update", action="store_true")
+    args = parser.parse_args()
+
+    results = {}
+    for path in args.benchmark:
+        results.update(
+            run_benchmark(path, args.cpu, args.benchmark_args.split())
+        )
+    if args.perf:
+        client_cpu = None if args.cpu is None else args.cpu + 1
+        results.update(
+            run_perf(
+                args.perf,
+                args.cpu,
+                client_cpu,
+                args.perf_port,
+                args.perf_duration,
+            )
+        )
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    if args.update or not baseline:
+        baseline.setdefault("tolerance", args.tolerance)
+        baseline["results"] = results
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=2, sort_keys=True)
+        print("Wrote baseline {}".format(args.baseline))
+        return 0
+
+    regressions = compare(results, baseline, args.tolerance)
+    if regressions:
+        print("{} perf regressions".format(len(regressions)))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -56,12 +56,18 @@ std::string writeDataReasonString(WriteDataReason reason) {
       return "StreamWindowUpdate";
     case WriteDataReason::CONN_WINDOW_UPDATE:
       return "ConnWindowUpdate";
+    case WriteDataReason::STREAM_LIMIT_UPDATE:
+      return "StreamLimitUpdate";
     case WriteDataReason::SIMPLE:
       return "Simple";
     case WriteDataReason::RESET:
       return "Reset";
     case WriteDataReason::PATHCHALLENGE:
       return "PathChallenge";
+    case WriteDataReason::DATAGRAM:
+      return "Datagram";
+    case WriteDataReason::PING:
+      return "Ping";
     case WriteDataReason::NO_WRITE:
       return "NoWrite";
   }
@@ -80,6 +86,8 @@ std::string writeNoWriteReasonString(NoWriteReason reason) {
       return "NoBody";
     case NoWriteReason::SOCKET_FAILURE:
       return "SocketFailure";
+    case NoWriteReason::WRITE_BUDGET:
+      return "WriteBudget";
   }
   folly::assume_unreachable();
 }
@@ -46,6 +46,45 @@ constexpr uint16_t kDefaultMsgSizeBackOffSize = 50;
 // larger than this, unless configured otherwise.
 constexpr uint16_t kDefaultUDPReadBufferSize = 4096;
 
+// Default number of idle receive buffers kept for reuse. 0 disables pooling of
+// receive buffers.
+constexpr uint32_t kDefaultReadBufferPoolSize = 0;
+
+// Received datagrams up to this size are copied out of pooled receive buffers
+// into right sized buffers.
+constexpr uint32_t kDefaultReadBufferCopyThreshold = 256;
+
+// Size of the huge pages a BufferArena is carved out of.
+constexpr size_t kBufferArenaChunkSize = 2 * 1024 * 1024;
+
+// Default most bytes of huge pages each BufferArena of a server worker maps.
+constexpr size_t kDefaultBufferArenaMaxBytes = 64 * 1024 * 1024;
+
+// Size of the packet buffers of a server worker's send BufferArena. Fits a
+// full size packet of a 1500 bytes MTU path with its headroom, larger ones
+// are allocated from the heap.
+constexpr size_t kBufferArenaSendBufferSize = 2048;
+
+// Room the receive buffers of a server worker's BufferArena leave on top of
+// the read buffer size, for the header of pooled receive buffers.
+constexpr size_t kBufferArenaReadBufferSlack = 64;
+
+// Stream writes up to this size are copied into the tail of the stream's
+// write buffer instead of chaining the caller's buffer.
+constexpr uint32_t kDefaultWriteCoalesceThreshold = 1024;
+
+// Size of the buffers crypto stream writes are copied into, enough for a
+// typical handshake flight of an encryption level.
+constexpr size_t kDefaultCryptoStreamBufferSize = 8 * 1024;
+
+// Size of read buffer used when UDP GRO is enabled, large enough to hold the
+// biggest super-datagram the kernel can hand over.
+constexpr uint16_t kDefaultGROReadBufferSize = 65535;
+
+// Kernel receive timestamps older than this are assumed to be off because the
+// wall clock stepped, and the time the datagram was read is used instead.
+constexpr std::chrono::seconds kMaxRxTimestampAge{1};
+
 constexpr uint16_t kMaxNumCoalescedPackets = 5;
 // As per version 20 of the spec, transport parameters for private use must
 // have ids with first byte being 0xff.
@@ -83,6 +122,10 @@ enum class FrameType : uint8_t {
   PATH_RESPONSE = 0x1B,
   CONNECTION_CLOSE = 0x1C,
   APPLICATION_CLOSE = 0x1D,
+  DATAGRAM = 0x30,
+  DATAGRAM_LEN = 0x31,
+  ACK_FREQUENCY = 0xAF,
+  FEC_REPAIR = 0xFC,
   MIN_STREAM_DATA = 0xFE, // subject to change (https://fburl.com/qpr)
   EXPIRED_STREAM_DATA = 0xFF, // subject to change (https://fburl.com/qpr)
 };
@@ -184,6 +227,18 @@ using TransportPartialReliabilitySetting = bool;
 
 constexpr uint16_t kPartialReliabilityParameterId = 0xFF00; // subject to change
 
+// Transport parameter of the DATAGRAM extension, the largest DATAGRAM frame
+// an endpoint is willing to receive.
+constexpr uint16_t kMaxDatagramFrameSizeParameterId = 0x0020;
+
+// Transport parameter of the ACK frequency extension, the smallest max ack
+// delay in microseconds an endpoint accepts in an ACK_FREQUENCY frame.
+constexpr uint16_t kMinAckDelayParameterId = 0xde1a;
+
+// Transport parameter of forward error correction, which an endpoint sends
+// with a value of 1 to receive FEC_REPAIR frames.
+constexpr uint16_t kFecParameterId = 0xFF01;
+
 constexpr uint32_t kDrainFactor = 3;
 
 // batching mode
@@ -199,6 +254,34 @@ QuicBatchingMode getQuicBatchingMode(uint32_t val);
 // by BATCHING_MODE_GSO
 constexpr uint32_t kDefaultQuicMaxBatchSize = 16;
 
+// most segments, and bytes, the kernel accepts in a single UDP GSO send.
+constexpr uint32_t kMaxGSOSegments = 64;
+constexpr uint64_t kMaxGSOBatchBytes = 65507;
+
+// default number of datagrams to read from the socket per read event. A value
+// of 1 reads one datagram per callback, larger values use recvmmsg.
+constexpr uint32_t kDefaultQuicMaxRecvBatchSize = 1;
+
+// default number of packets built before they are encrypted together. A value
+// of 1 encrypts every packet as soon as it is built.
+constexpr uint32_t kDefaultMaxEncryptBatchSize = 1;
+
+// fewest packets of a batch handed to an encryption helper thread, below
+// which the hand off costs more than it saves.
+constexpr size_t kDefaultMinPacketsPerEncryptHelper = 4;
+
+// default number of packets the server worker accumulates across all its
+// connections before writing them out with a single sendmmsg call.
+constexpr uint32_t kDefaultWorkerWriteBatchSize = 64;
+
+// A long header packet is only held back to be coalesced with the packets
+// written after it if at least this many bytes of the datagram are left.
+constexpr uint64_t kMinCoalescedPacketRoom = 64;
+
+// default minimum size in bytes of a GSO batch for it to be sent with
+// MSG_ZEROCOPY. Below this the page pinning costs more than the copy.
+constexpr uint32_t kDefaultZeroCopySendThreshold = 16 * 1024;
+
 // rfc6298:
 constexpr int kRttAlpha = 8;
 constexpr int kRttBeta = 4;
@@ -207,15 +290,83 @@ constexpr int kRttBeta = 4;
 // recommendation. This is not a bug.
 constexpr std::chrono::microseconds kDefaultInitialRtt = 50000us;
 
+// How long the path state of a closed connection seeds new connections from
+// the same subnet, see CongestionStateCache.
+constexpr std::chrono::seconds kDefaultCongestionStateCacheTtl{600};
+// Subnets sharing cached path state. A /64 is usually a single IPv6 link, as
+// a /24 is for IPv4.
+constexpr uint8_t kCongestionStateCacheV4PrefixLen = 24;
+constexpr uint8_t kCongestionStateCacheV6PrefixLen = 64;
+
+// Most datagram bytes a PacketTraceRecorder records by default.
+constexpr size_t kDefaultPacketTraceMaxBytes = 64 * 1024 * 1024;
+
+// Bytes of a datagram a PacketCaptureRing keeps by default: enough for the
+// headers of its packets, not for their protected payload.
+constexpr uint32_t kDefaultPacketCaptureSnapLength = 128;
+
+// Consecutive PTOs on which a connection hands its packet capture over.
+constexpr uint32_t kDefaultPacketCapturePtoThreshold = 4;
+
+// Cached path state a new connection's TransportProfile is picked from, see
+// selectTransportProfile. A path with an rtt of at least kMobileProfileMinRtt,
+// or with an rttvar of at least half its rtt, gets the Mobile profile. One
+// with a cwnd of at least kBulkProfileMinCwndBytes gets the Bulk profile, the
+// other ones the Interactive profile.
+constexpr std::chrono::microseconds kMobileProfileMinRtt = 150000us;
+constexpr uint64_t kBulkProfileMinCwndBytes = 1024 * 1024;
+// The Bulk profile advertises receive windows this many times larger.
+constexpr uint64_t kBulkProfileWindowMultiplier = 4;
+
+// Source prefixes sharing the Initial rate limit of InitialPacketFilter, and
+// the number of prefixes it tracks at once.
+constexpr uint8_t kInitialFilterV4PrefixLen = 24;
+constexpr uint8_t kInitialFilterV6PrefixLen = 48;
+constexpr size_t kInitialFilterTableSize = 4096;
+// default bursts of the Initial and new connection rate limits.
+constexpr uint32_t kDefaultInitialsPerPrefixBurst = 64;
+constexpr uint32_t kDefaultNewConnectionsBurst = 256;
+// Default burst of the limit on version negotiation packets and stateless
+// resets a worker sends.
+constexpr uint32_t kDefaultStatelessResponsesBurst = 256;
+// Stateless reset tokens a worker keeps for the connection ids it recently
+// sent resets for.
+constexpr size_t kStatelessResetTokenCacheSize = 1024;
+
+// Careful resume: the first rtt sample of a resumed connection has to be
+// within [saved rtt / divisor, saved rtt * factor] for the saved cwnd to be
+// used, and tickets older than the max age are not used at all.
+constexpr uint64_t kCarefulResumeRttLowerDivisor = 2;
+constexpr uint64_t kCarefulResumeRttUpperFactor = 10;
+constexpr std::chrono::seconds kCarefulResumeMaxTicketAge{3600};
+
 // HHWheelTimer tick interval
 constexpr std::chrono::microseconds kGranularity = 10000us;
 
 constexpr uint32_t kReorderingThreshold = 3;
+// Bound on the packet reordering threshold adapted to spurious losses.
+constexpr uint32_t kMaxReorderingThreshold = 32;
+// Time threshold of the loss detection, in eighths of an rtt, and its bound
+// when adapted to spurious losses.
+constexpr uint32_t kTimeReorderingThreshold = 9;
+constexpr uint32_t kMaxTimeReorderingThreshold = 16;
+// Loss events without a spurious loss after which adapted reordering
+// thresholds go back to their defaults.
+constexpr uint32_t kReorderingThresholdResetLossEvents = 16;
+// Lost packets remembered to detect spurious losses.
+constexpr size_t kMaxTrackedLostPackets = 128;
 
 constexpr auto kPacketToSendForPTO = 2;
 
+// Number of times the data of a packet is cloned on PTOs before it has been
+// acked or declared lost.
+constexpr uint64_t kDefaultMaxClonesPerPacket = 2;
+
 // Maximum number of packets to write per writeConnectionDataToSocket call.
 constexpr uint64_t kDefaultWriteConnectionDataPacketLimit = 5;
+// Smallest share of TransportSettings::writeLoopTimeBudget a transport gets,
+// however many transports are writing on the same EventBase.
+constexpr std::chrono::microseconds kMinWriteLoopTimeSlice = 100us;
 // Maximum number of packets to write per burst in pacing
 constexpr uint64_t kDefaultMaxBurstPackets = 10;
 // Default timer tick interval for pacing timer
@@ -223,13 +374,51 @@ constexpr uint64_t kDefaultMaxBurstPackets = 10;
 // but the notifications can get delayed if the event loop is busy
 // this is subject to testing but I would suggest a value >= 200usec
 constexpr std::chrono::microseconds kDefaultPacingTimerTickInterval{1000};
+// Default slot of the pacing timer wheel shared by the connections of a
+// worker, see TransportSettings::pacingTimerWheelEnabled.
+constexpr std::chrono::microseconds kDefaultPacingTimerWheelSlotInterval{50};
+// How often the fair share of workerEgressBandwidth is recomputed.
+constexpr std::chrono::milliseconds kBandwidthAllocationInterval{10};
+// Connections that haven't written for this long don't take a share.
+constexpr std::chrono::milliseconds kBandwidthAllocationIdleTimeout{200};
+
+// ECN codepoints, the two low bits of the IP TOS / traffic class field.
+enum class ECNCodepoint : uint8_t {
+  NotECT = 0x00,
+  ECT1 = 0x01,
+  ECT0 = 0x02,
+  CE = 0x03,
+};
 
 // Congestion control:
 constexpr std::chrono::microseconds::rep kPersistentCongestionThreshold = 3;
-enum class CongestionControlType : uint8_t { Cubic, NewReno, Copa, BBR, None };
+enum class CongestionControlType : uint8_t {
+  Cubic,
+  NewReno,
+  Copa,
+  BBR,
+  BBR2,
+  None
+};
 // This is an approximation of a small enough number for cwnd to be blocked.
 constexpr size_t kBlockedSizeBytes = 20;
 
+// What keeps a connection from writing more stream data, in the spirit of
+// TCP's busy, rwnd limited and sndbuf limited times.
+enum class WriteLimiter : uint8_t {
+  // Not limited, the connection ran out of write loop budget.
+  None,
+  // The application has nothing more to send.
+  App,
+  Cwnd,
+  Pacing,
+  ConnFlowControl,
+  StreamFlowControl,
+  // NOTE: MAX should always be at the end
+  MAX
+};
+constexpr size_t kNumWriteLimiters = static_cast<size_t>(WriteLimiter::MAX);
+
 constexpr uint64_t kInitCwndInMss = 10;
 constexpr uint64_t kMinCwndInMss = 2;
 constexpr uint64_t kDefaultMaxCwndInMss = 2000;
@@ -250,6 +439,19 @@ constexpr std::chrono::microseconds kDelayIncreaseUpperBound(8);
 // Hystart's lower bound for DelayIncrease
 constexpr std::chrono::microseconds kDelayIncreaseLowerBound(2);
 
+/* HyStart++, RFC 9406: */
+// Rtt samples needed in a round before it is compared with the previous one
+constexpr uint8_t kHystartPlusPlusRttSamples = 8;
+// Bounds of the rtt increase that ends slow start
+constexpr std::chrono::microseconds kHystartPlusPlusMinRttThresh(4000);
+constexpr std::chrono::microseconds kHystartPlusPlusMaxRttThresh(16000);
+// Fraction of the last round's min rtt that counts as an increase
+constexpr uint8_t kHystartPlusPlusRttThreshDivisor = 8;
+// Conservative slow start grows cwnd by ackedBytes / kCssGrowthDivisor
+constexpr uint8_t kCssGrowthDivisor = 4;
+// Number of conservative slow start rounds before congestion avoidance
+constexpr uint8_t kCssRounds = 5;
+
 /* Cubic */
 // Default cwnd reduction factor:
 constexpr double kDefaultCubicReductionFactor = 0.8;
@@ -265,17 +467,58 @@ constexpr float kDefaultLastMaxReductionFactor = 0.85f;
 // Default flow control window for HTTP/2 + 1K for headers
 constexpr uint64_t kDefaultStreamWindowSize = (64 + 1) * 1024;
 constexpr uint64_t kDefaultConnectionWindowSize = 1024 * 1024;
+// Default caps of the receive windows with receive window auto-tuning, and
+// bytes by which the connections of a server worker may grow their windows
+// in total.
+constexpr uint64_t kDefaultMaxReceiveStreamWindowSize = 6 * 1024 * 1024;
+constexpr uint64_t kDefaultMaxReceiveConnectionWindowSize = 16 * 1024 * 1024;
+constexpr uint64_t kDefaultWorkerReceiveWindowBudget = 256 * 1024 * 1024;
+// With deferred window updates, an update is sent right away once the peer has
+// less than 1 / kUrgentWindowUpdateFraction of the window left to send.
+constexpr uint64_t kUrgentWindowUpdateFraction = 4;
+// default maximum number of MAX_STREAM_DATA frames per packet when window
+// updates are deferred.
+constexpr uint32_t kDefaultMaxWindowUpdatesPerPacket = 16;
 
 /* Stream Limits */
 constexpr uint64_t kDefaultMaxStreamsBidirectional = 2048;
 constexpr uint64_t kDefaultMaxStreamsUnidirectional = 2048;
 constexpr uint64_t kMaxStreamId = 1ull << 62;
 constexpr uint64_t kMaxMaxStreams = 1ull << 60;
+// The peer is granted new streams once 1 / kDefaultStreamLimitWindowingFraction
+// of the advertised stream limit closed, in a single MAX_STREAMS frame.
+constexpr uint64_t kDefaultStreamLimitWindowingFraction = 2;
+
+/* Stream Priority */
+// Streams with a lower urgency are scheduled first.
+constexpr uint8_t kDefaultPriorityUrgency = 3;
+constexpr uint8_t kMaxPriorityUrgency = 7;
+// Share of the bandwidth a stream gets relative to the other streams of its
+// urgency, with weighted fair queueing.
+constexpr uint16_t kDefaultStreamWeight = 1;
+
+enum class StreamSchedulingMode : uint8_t {
+  // Streams of an urgency are sent one after another, or round robin packet
+  // by packet for incremental streams.
+  RoundRobin,
+  // Deficit round robin: streams of an urgency take turns, each sending its
+  // weight times a packet worth of bytes per turn.
+  WeightedFairQueueing,
+};
+
+/* Datagrams */
+// Largest DATAGRAM frame we advertise when datagrams are enabled.
+constexpr uint16_t kMaxDatagramFrameSize = 65535;
+// Default number of datagrams buffered on each of the read and write paths.
+constexpr uint32_t kDefaultMaxDatagramsBuffered = 75;
 
 /* Idle timeout parameters */
 // Default idle timeout to advertise.
 constexpr auto kDefaultIdleTimeout = 60000ms;
 constexpr auto kMaxIdleTimeout = 600000ms;
+// Keepalive deadlines are rounded down to a multiple of this, so that the
+// connections of a worker due around the same time share a timer wakeup.
+constexpr auto kKeepaliveAlignment = 1000ms;
 
 // Time format related:
 constexpr uint8_t kQuicTimeExpoBits = 5;
@@ -301,13 +544,50 @@ constexpr std::chrono::microseconds kMaxAckTimeout = 25000us;
 // min ack timeout: 10ms
 constexpr std::chrono::microseconds kMinAckTimeout = 10000us;
 
+/* Ack frequency */
+// Smallest max ack delay we accept from the peer when ack frequency is
+// enabled. Our ack timer has millisecond granularity.
+constexpr std::chrono::microseconds kMinAckDelay = 1000us;
+// Once out of slow start, we ask the peer to ack every
+// cwnd / kAckFrequencyCwndFraction packets.
+constexpr uint64_t kAckFrequencyCwndFraction = 4;
+// Upper bound of the packet tolerance we request from the peer.
+constexpr uint64_t kMaxAckFrequencyPacketTolerance = 64;
+
+/* Path MTU discovery */
+// A probe size is given up on once this many probes of that size got lost.
+constexpr uint64_t kPmtuMaxProbes = 3;
+// The search for the path MTU stops once it is known within this many bytes.
+constexpr uint64_t kPmtuSearchPrecision = 20;
+// Time after which a completed search is started over, in case the path MTU
+// grew.
+constexpr std::chrono::seconds kPmtuRaiseTimeout = 600s;
+// The path is considered to drop packets of the discovered size after this
+// many of them got lost without any of them being acked.
+constexpr uint64_t kPmtuBlackHoleThreshold = 6;
+
 constexpr uint64_t kAckPurgingThresh = 10;
 
+// Maximum number of ACK ranges to track per packet number space. The oldest
+// ranges are dropped beyond this, which bounds the cost of writing ACKs on
+// lossy connections.
+constexpr uint64_t kDefaultMaxAckRanges = 64;
+
+// ACK ranges received more than this many RTTs ago are dropped. A peer that
+// has not seen any of our ACKs for that long has declared the packets lost.
+constexpr uint32_t kDefaultAckRangeAgeRtts = 10;
+// Lower bound on the ACK range age, so connections with a tiny RTT don't
+// forget ranges faster than the ACK timer can send them.
+constexpr std::chrono::microseconds kMinAckRangeAge = 1000000us;
+
 // Default number of packets to buffer if keys are not present.
 constexpr uint32_t kDefaultMaxBufferedPackets = 20;
 
 // Default exponent to use while computing ack delay.
 constexpr uint64_t kDefaultAckDelayExponent = 3;
+
+// Number of ACK blocks a decoded ACK frame holds without allocating.
+constexpr size_t kInlineReadAckBlocks = 4;
 constexpr uint64_t kMaxAckDelayExponent = 20;
 
 // Default connection id size of the connection id we will send.
@@ -338,8 +618,27 @@ constexpr std::chrono::milliseconds kHappyEyeballsV4Delay = 150ms;
 constexpr std::chrono::milliseconds kHappyEyeballsConnAttemptDelayWithCache =
     15s;
 
+// How long QuicHappyEyeballsCache trusts the address a race settled on, and
+// how many hostnames it remembers.
+constexpr std::chrono::seconds kDefaultHappyEyeballsCacheTtl = 600s;
+constexpr size_t kDefaultHappyEyeballsCacheSize = 1024;
+
+// Consecutive PTOs of the current path after which a client fails over to its
+// standby path, see TransportSettings::standbyPathEnabled.
+constexpr uint32_t kDefaultStandbyPathFailoverPtoCount = 2;
+
 constexpr size_t kMaxNumTokenSourceAddresses = 3;
 
+// Lock stripes of ShardedQuicPskCache.
+constexpr size_t kDefaultPskCacheShards = 16;
+
+// Defaults of QuicClientConnectionPool::Options.
+constexpr size_t kDefaultConnectionPoolMaxConnectionsPerKey = 8;
+constexpr std::chrono::milliseconds kDefaultConnectionPoolIdleTimeoutMargin =
+    1000ms;
+constexpr std::chrono::milliseconds kDefaultConnectionPoolRefreshInterval =
+    1000ms;
+
 // Amount of time to retain initial keys until they are dropped after handshake
 // completion.
 constexpr std::chrono::seconds kTimeToRetainInitialKeys = 20s;
@@ -352,10 +651,82 @@ constexpr std::chrono::seconds kTimeToRetainLastCongestionAndRttState = 60s;
 
 constexpr uint32_t kMaxNumMigrationsAllowed = 6;
 
+// Every qlog event type, see TransportSettings::qLogEvents.
+constexpr uint32_t kQLogAllEvents = 0xFFFFFFFF;
+
+// Congestion state and rtt stats kept for validated paths the peer migrated
+// away from, so that they are recovered if it comes back to one of them.
+constexpr size_t kMaxRetainedPathStates = 4;
+
+// A peer address change within the same prefix is taken for a NAT rebinding,
+// which keeps the congestion state and the peer connection id.
+constexpr uint8_t kMigrationV4PrefixLen = 24;
+constexpr uint8_t kMigrationV6PrefixLen = 64;
+
+// Unused connection ids issued by the peer kept for migrations.
+constexpr size_t kMaxPeerConnectionIds = 8;
+
+// Most connection ids a server keeps issued to its peer on top of the one in
+// use, which is as many as an mvfst client keeps.
+constexpr size_t kMaxConnectionIdPoolSize = kMaxPeerConnectionIds;
+
+// Forward error correction protects stream frames with at most this much
+// data, so a repair frame fits in a packet with room to spare.
+constexpr uint64_t kFecMaxSourceDataLength = 512;
+
+// Bounds of the number of source frames a repair frame covers, which adapts
+// to the loss rate every kFecAdaptationPackets packets.
+constexpr uint32_t kFecMinWindow = 4;
+constexpr uint32_t kFecMaxWindow = 32;
+constexpr uint64_t kFecAdaptationPackets = 100;
+
+// Source frames a receiver keeps to recover lost ones from.
+constexpr size_t kFecMaxReceivedSymbols = 2 * kFecMaxWindow;
+
 constexpr auto kExpectedNumOfParamsInTheTicket = 8;
 
 constexpr auto kStatelessResetTokenSecretLength = 32;
 
+constexpr auto kRetryTokenSecretLength = 32;
+
+// Session ticket secrets of TicketKeyStore are at least this long.
+constexpr size_t kMinTicketSecretLength = 32;
+
+// How long after a Retry the token it carries is accepted.
+constexpr std::chrono::seconds kDefaultRetryTokenLifetime = 10s;
+
+// Source addresses whose rate of new connections is tracked to decide on
+// Retry, and the window the rate is counted over.
+constexpr size_t kRetrySourceRateCacheSize = 10000;
+constexpr std::chrono::milliseconds kRetrySourceRateWindow = 1000ms;
+
+// Compression level of the certificate chains compressed with zlib. They are
+// compressed once per certificate, so the best ratio is worth it.
+constexpr int kCertCompressionZlibLevel = 9;
+
+// Released Initial aeads an InitialCipherPool keeps for reuse. Each handshake
+// in progress holds two.
+constexpr size_t kDefaultInitialCipherPoolSize = 256;
+
+// Max size of a datagram of packets forwarded to another server with
+// TakeoverProtocolVersion::V1.
+constexpr uint16_t kMaxTakeoverBatchSize = 16 * 1024;
+
+// Loop latency from which a server worker hands its new connections to less
+// loaded workers, with newConnectionLoadBalancing.
+constexpr std::chrono::microseconds kDefaultWorkerHotLoopLatency = 5000us;
+// An overloaded server goes down a level once its loop latency is below this
+// percentage of the level's threshold, see OverloadController.
+constexpr uint64_t kOverloadRecoveryPercent = 75;
+// Factor by which an overloaded server lowers the ack frequency it asks of
+// its peers.
+constexpr uint64_t kOverloadAckFrequencyMultiplier = 4;
+// Packets a connection of an overloaded server writes at a time.
+constexpr uint64_t kDefaultOverloadWritePacketsLimit = 2;
+// New connections a worker remembers having handed to another worker, so
+// that their retransmitted Initials and 0-RTT packets follow.
+constexpr size_t kRedirectedConnectionsCacheSize = 10000;
+
 // default capability of QUIC partial reliability
 constexpr TransportPartialReliabilitySetting kDefaultPartialReliability = false;
 
@@ -375,6 +746,26 @@ inline folly::StringPiece nodeToString(QuicNodeType node) {
   }
 }
 
+inline folly::StringPiece writeLimiterToString(WriteLimiter limiter) {
+  switch (limiter) {
+    case WriteLimiter::None:
+      return "None";
+    case WriteLimiter::App:
+      return "App";
+    case WriteLimiter::Cwnd:
+      return "Cwnd";
+    case WriteLimiter::Pacing:
+      return "Pacing";
+    case WriteLimiter::ConnFlowControl:
+      return "ConnFlowControl";
+    case WriteLimiter::StreamFlowControl:
+      return "StreamFlowControl";
+    case WriteLimiter::MAX:
+      break;
+  }
+  return "Unknown";
+}
+
 template <class T>
 inline std::ostream& operator<<(std::ostream& os, const std::vector<T>& v) {
   for (auto it = v.cbegin(); it != v.cend(); ++it) {
@@ -401,9 +792,12 @@ enum class WriteDataReason {
   BLOCKED,
   STREAM_WINDOW_UPDATE,
   CONN_WINDOW_UPDATE,
+  STREAM_LIMIT_UPDATE,
   SIMPLE,
   RESET,
   PATHCHALLENGE,
+  DATAGRAM,
+  PING,
 };
 
 enum class NoWriteReason {
@@ -412,6 +806,7 @@ enum class NoWriteReason {
   NO_FRAME,
   NO_BODY,
   SOCKET_FAILURE,
+  WRITE_BUDGET,
 };
 
 std::string writeDataReasonString(WriteDataReason reason);
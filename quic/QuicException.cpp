@@ -36,6 +36,19 @@ QuicTransportException::QuicTransportException(
     FrameType frameType)
     : std::runtime_error(msg), errCode_(errCode), frameType_(frameType){};
 
+QuicTransportError::QuicTransportError(
+    std::string messageIn,
+    TransportErrorCode codeIn,
+    folly::Optional<FrameType> frameTypeIn)
+    : message(std::move(messageIn)), code(codeIn), frameType(frameTypeIn) {}
+
+void throwTransportError(const QuicTransportError& error) {
+  if (error.frameType) {
+    throw QuicTransportException(error.message, error.code, *error.frameType);
+  }
+  throw QuicTransportException(error.message, error.code);
+}
+
 QuicInternalException::QuicInternalException(
     const std::string& msg,
     LocalErrorCode errCode)
@@ -45,6 +45,24 @@ class QuicTransportException : public std::runtime_error {
   folly::Optional<FrameType> frameType_;
 };
 
+/**
+ * A transport error returned as a value rather than thrown, by the code that
+ * decodes packets. It becomes a QuicTransportException, with
+ * throwTransportError, where the callers expect one.
+ */
+struct QuicTransportError {
+  QuicTransportError(
+      std::string messageIn,
+      TransportErrorCode codeIn,
+      folly::Optional<FrameType> frameTypeIn = folly::none);
+
+  std::string message;
+  TransportErrorCode code;
+  folly::Optional<FrameType> frameType;
+};
+
+[[noreturn]] void throwTransportError(const QuicTransportError& error);
+
 class QuicInternalException : public std::runtime_error {
  public:
   explicit QuicInternalException(
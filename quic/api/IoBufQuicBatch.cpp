@@ -27,6 +27,13 @@ bool IOBufQuicBatch::write(
     std::unique_ptr<folly::IOBuf>&& buf,
     size_t encodedSize) {
   pktSent_++;
+  if (conn_.packetCapture) {
+    conn_.packetCapture->record(
+        PacketCaptureRing::Direction::Sent,
+        loopClockNow(conn_),
+        peerAddress_,
+        *buf);
+  }
 
   // see if we need to flush the prev buffer(s)
   if (batchWriter_->needsFlush(encodedSize)) {
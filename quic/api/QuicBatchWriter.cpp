@@ -8,6 +8,8 @@
 
 #include <quic/api/QuicBatchWriter.h>
 
+#include <folly/net/NetOps.h>
+
 namespace quic {
 // BatchWriter
 bool BatchWriter::needsFlush(size_t /*unused*/) {
@@ -31,12 +33,23 @@ bool SinglePacketBatchWriter::append(
 ssize_t SinglePacketBatchWriter::write(
     folly::AsyncUDPSocket& sock,
     const folly::SocketAddress& address) {
+  if (kernelPacer_ &&
+      kernelPacer_->getNetworkSocket() == sock.getNetworkSocket()) {
+    return kernelPacer_->write(address, buf_, 0, 1);
+  }
   return sock.write(address, buf_);
 }
 
 // GSOPacketBatchWriter
-GSOPacketBatchWriter::GSOPacketBatchWriter(size_t maxBufs)
-    : maxBufs_(maxBufs) {}
+GSOPacketBatchWriter::GSOPacketBatchWriter(
+    size_t maxBufs,
+    ZeroCopySendTracker* zeroCopyTracker,
+    KernelPacer* kernelPacer,
+    uint64_t maxBytes)
+    : maxBufs_(maxBufs),
+      maxBytes_(maxBytes),
+      zeroCopyTracker_(zeroCopyTracker),
+      kernelPacer_(kernelPacer) {}
 
 void GSOPacketBatchWriter::reset() {
   buf_.reset(nullptr);
@@ -60,7 +73,8 @@ bool GSOPacketBatchWriter::append(
     prevSize_ = size;
     currBufs_ = 1;
 
-    return false; // continue
+    // a single packet can already use up the byte limit
+    return maxBytes_ && 2 * size > maxBytes_;
   }
 
   // now we've got an additional buffer
@@ -79,6 +93,11 @@ bool GSOPacketBatchWriter::append(
     return true;
   }
 
+  // another buffer of the same size would go over the max bytes
+  if (maxBytes_ && (currBufs_ + 1) * prevSize_ > maxBytes_) {
+    return true;
+  }
+
   // does not need to be flushed yet
   return false;
 }
@@ -86,6 +105,20 @@ bool GSOPacketBatchWriter::append(
 ssize_t GSOPacketBatchWriter::write(
     folly::AsyncUDPSocket& sock,
     const folly::SocketAddress& address) {
+  if (kernelPacer_ &&
+      kernelPacer_->getNetworkSocket() == sock.getNetworkSocket()) {
+    return kernelPacer_->write(
+        address,
+        buf_,
+        currBufs_ > 1 ? static_cast<int>(prevSize_) : 0,
+        currBufs_);
+  }
+  if (currBufs_ > 1 && zeroCopyTracker_ &&
+      zeroCopyTracker_->getNetworkSocket() == sock.getNetworkSocket() &&
+      zeroCopyTracker_->shouldUseZeroCopy(size())) {
+    return zeroCopyTracker_->writeGSO(
+        address, buf_, static_cast<int>(prevSize_));
+  }
   return (currBufs_ > 1)
       ? sock.writeGSO(address, buf_, static_cast<int>(prevSize_))
       : sock.write(address, buf_);
@@ -149,20 +182,132 @@ ssize_t SendmmsgPacketBatchWriter::write(
   return 0;
 }
 
+// SharedPacketBatch
+SharedPacketBatch::SharedPacketBatch(
+    folly::EventBase* evb,
+    folly::AsyncUDPSocket& sock,
+    size_t maxPackets)
+    : evb_(evb), sock_(sock), maxPackets_(std::max<size_t>(maxPackets, 1)) {
+  packets_.reserve(maxPackets_);
+}
+
+SharedPacketBatch::~SharedPacketBatch() {
+  flush();
+}
+
+bool SharedPacketBatch::canBatch(const folly::AsyncUDPSocket& sock) const {
+  return sock.getNetworkSocket() == sock_.getNetworkSocket();
+}
+
+void SharedPacketBatch::enqueue(
+    const folly::SocketAddress& address,
+    std::unique_ptr<folly::IOBuf>&& buf) {
+  DCHECK(evb_->isInEventBaseThread());
+  Packet packet;
+  packet.addrLen = address.getAddress(&packet.addr);
+  packet.buf = std::move(buf);
+  packets_.push_back(std::move(packet));
+  if (packets_.size() >= maxPackets_) {
+    flush();
+  } else if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+}
+
+void SharedPacketBatch::runLoopCallback() noexcept {
+  flush();
+}
+
+void SharedPacketBatch::flush() {
+  cancelLoopCallback();
+  if (packets_.empty()) {
+    return;
+  }
+  // Collect the iovecs first, the msghdrs point into iovecs_ so they can only
+  // be filled in once it stops growing.
+  iovecs_.clear();
+  msgs_.resize(packets_.size());
+  for (size_t i = 0; i < packets_.size(); ++i) {
+    auto& msg = msgs_[i].msg_hdr;
+    msg = {};
+    msg.msg_name = &packets_[i].addr;
+    msg.msg_namelen = packets_[i].addrLen;
+    msg.msg_iovlen = 0;
+    for (auto range : *packets_[i].buf) {
+      if (!range.empty()) {
+        iovecs_.push_back(
+            {const_cast<uint8_t*>(range.data()), range.size()});
+        msg.msg_iovlen++;
+      }
+    }
+    msgs_[i].msg_len = 0;
+  }
+  size_t iovIndex = 0;
+  for (auto& msg : msgs_) {
+    msg.msg_hdr.msg_iov = iovecs_.data() + iovIndex;
+    iovIndex += msg.msg_hdr.msg_iovlen;
+  }
+
+  size_t sent = 0;
+  while (sent < msgs_.size()) {
+    int ret = folly::netops::sendmmsg(
+        sock_.getNetworkSocket(),
+        msgs_.data() + sent,
+        static_cast<unsigned int>(msgs_.size() - sent),
+        MSG_DONTWAIT);
+    if (ret <= 0) {
+      if (ret < 0 && errno == EINTR) {
+        continue;
+      }
+      VLOG(4) << "sendmmsg() failed errno=" << errno << " dropping "
+              << (msgs_.size() - sent) << " packets";
+      break;
+    }
+    sent += static_cast<size_t>(ret);
+  }
+  packets_.clear();
+}
+
+// SharedPacketBatchWriter
+SharedPacketBatchWriter::SharedPacketBatchWriter(
+    SharedPacketBatch& sharedBatch,
+    size_t maxBufs)
+    : SendmmsgPacketBatchWriter(maxBufs), sharedBatch_(sharedBatch) {}
+
+ssize_t SharedPacketBatchWriter::write(
+    folly::AsyncUDPSocket& sock,
+    const folly::SocketAddress& address) {
+  if (!sharedBatch_.canBatch(sock)) {
+    return SendmmsgPacketBatchWriter::write(sock, address);
+  }
+  for (auto& buf : bufs_) {
+    sharedBatch_.enqueue(address, std::move(buf));
+  }
+  return currSize_;
+}
+
 // BatchWriterFactory
 std::unique_ptr<BatchWriter> BatchWriterFactory::makeBatchWriter(
     folly::AsyncUDPSocket& sock,
     const quic::QuicBatchingMode& batchingMode,
-    uint32_t batchSize) {
+    uint32_t batchSize,
+    SharedPacketBatch* sharedBatch,
+    ZeroCopySendTracker* zeroCopyTracker,
+    KernelPacer* kernelPacer,
+    uint64_t maxBatchBytes) {
+  if (sharedBatch) {
+    return std::make_unique<SharedPacketBatchWriter>(*sharedBatch, batchSize);
+  }
   switch (batchingMode) {
     case quic::QuicBatchingMode::BATCHING_MODE_NONE:
-      return std::make_unique<SinglePacketBatchWriter>();
+      return std::make_unique<SinglePacketBatchWriter>(kernelPacer);
     case quic::QuicBatchingMode::BATCHING_MODE_GSO: {
       if (sock.getGSO() >= 0) {
-        return std::make_unique<GSOPacketBatchWriter>(batchSize);
+        return std::make_unique<GSOPacketBatchWriter>(
+            batchSize, zeroCopyTracker, kernelPacer, maxBatchBytes);
       }
 
-      return std::make_unique<SinglePacketBatchWriter>();
+      return std::make_unique<SinglePacketBatchWriter>(kernelPacer);
     }
     case quic::QuicBatchingMode::BATCHING_MODE_SENDMMSG:
       return std::make_unique<SendmmsgPacketBatchWriter>(batchSize);
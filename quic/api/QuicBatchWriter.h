@@ -10,7 +10,11 @@
 
 #include <folly/io/IOBuf.h>
 #include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/portability/Sockets.h>
 #include <quic/QuicConstants.h>
+#include <quic/api/QuicKernelPacing.h>
+#include <quic/api/QuicZeroCopy.h>
 
 namespace quic {
 class BatchWriter {
@@ -58,7 +62,8 @@ class IOBufBatchWriter : public BatchWriter {
 
 class SinglePacketBatchWriter : public IOBufBatchWriter {
  public:
-  SinglePacketBatchWriter() = default;
+  explicit SinglePacketBatchWriter(KernelPacer* kernelPacer = nullptr)
+      : kernelPacer_(kernelPacer) {}
   ~SinglePacketBatchWriter() override = default;
 
   void reset() override;
@@ -66,11 +71,19 @@ class SinglePacketBatchWriter : public IOBufBatchWriter {
   ssize_t write(
       folly::AsyncUDPSocket& sock,
       const folly::SocketAddress& address) override;
+
+ private:
+  // used to set departure times on the packets if set
+  KernelPacer* kernelPacer_{nullptr};
 };
 
 class GSOPacketBatchWriter : public IOBufBatchWriter {
  public:
-  explicit GSOPacketBatchWriter(size_t maxBufs);
+  explicit GSOPacketBatchWriter(
+      size_t maxBufs,
+      ZeroCopySendTracker* zeroCopyTracker = nullptr,
+      KernelPacer* kernelPacer = nullptr,
+      uint64_t maxBytes = 0);
   ~GSOPacketBatchWriter() override = default;
 
   void reset() override;
@@ -87,6 +100,12 @@ class GSOPacketBatchWriter : public IOBufBatchWriter {
   size_t currBufs_{0};
   // size of the previous buffer chain appended to the buf_
   size_t prevSize_{0};
+  // max number of bytes in a batch, 0 if only maxBufs_ applies
+  uint64_t maxBytes_{0};
+  // used to send large batches with zero copy if set
+  ZeroCopySendTracker* zeroCopyTracker_{nullptr};
+  // used to set departure times on the batches if set
+  KernelPacer* kernelPacer_{nullptr};
 };
 
 class SendmmsgPacketBatchWriter : public BatchWriter {
@@ -104,7 +123,7 @@ class SendmmsgPacketBatchWriter : public BatchWriter {
       folly::AsyncUDPSocket& sock,
       const folly::SocketAddress& address) override;
 
- private:
+ protected:
   // max number of buffer chains we can accumulate before we need to flush
   size_t maxBufs_{1};
   // size of data in all the buffers
@@ -113,12 +132,83 @@ class SendmmsgPacketBatchWriter : public BatchWriter {
   std::vector<std::unique_ptr<folly::IOBuf>> bufs_;
 };
 
+/**
+ * Packets queued by all the connections that write to the same socket from
+ * one event base. Every packet keeps its own destination address, and the
+ * whole batch is written with a single sendmmsg call at the end of the event
+ * loop iteration, or earlier when it fills up.
+ *
+ * Writes are fire and forget: errors from the deferred sendmmsg are logged
+ * and the packets are left to loss recovery.
+ */
+class SharedPacketBatch : public folly::EventBase::LoopCallback {
+ public:
+  SharedPacketBatch(
+      folly::EventBase* evb,
+      folly::AsyncUDPSocket& sock,
+      size_t maxPackets);
+  ~SharedPacketBatch() override;
+
+  // returns true if packets written to sock can be queued to this batch
+  bool canBatch(const folly::AsyncUDPSocket& sock) const;
+
+  void enqueue(
+      const folly::SocketAddress& address,
+      std::unique_ptr<folly::IOBuf>&& buf);
+
+  // writes all the queued packets
+  void flush();
+
+  // number of queued packets
+  size_t size() const {
+    return packets_.size();
+  }
+
+  void runLoopCallback() noexcept override;
+
+ private:
+  struct Packet {
+    sockaddr_storage addr;
+    socklen_t addrLen;
+    std::unique_ptr<folly::IOBuf> buf;
+  };
+
+  folly::EventBase* evb_;
+  folly::AsyncUDPSocket& sock_;
+  size_t maxPackets_;
+  std::vector<Packet> packets_;
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> msgs_;
+};
+
+/**
+ * Batch writer that hands the packets of one connection over to a
+ * SharedPacketBatch instead of writing them to the socket.
+ */
+class SharedPacketBatchWriter : public SendmmsgPacketBatchWriter {
+ public:
+  SharedPacketBatchWriter(SharedPacketBatch& sharedBatch, size_t maxBufs);
+  ~SharedPacketBatchWriter() override = default;
+
+  ssize_t write(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address) override;
+
+ private:
+  SharedPacketBatch& sharedBatch_;
+};
+
 class BatchWriterFactory {
  public:
   static std::unique_ptr<BatchWriter> makeBatchWriter(
       folly::AsyncUDPSocket& sock,
       const quic::QuicBatchingMode& batchingMode,
-      uint32_t batchSize);
+      uint32_t batchSize,
+      SharedPacketBatch* sharedBatch = nullptr,
+      ZeroCopySendTracker* zeroCopyTracker = nullptr,
+      KernelPacer* kernelPacer = nullptr,
+      // max number of bytes in a GSO batch, 0 for no limit
+      uint64_t maxBatchBytes = 0);
 };
 
 } // namespace quic
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicECN.h>
+
+#include <folly/net/NetOps.h>
+
+#include <cstring>
+
+namespace quic {
+
+namespace {
+
+constexpr uint8_t kECNMask = 0x03;
+
+#ifdef __linux__
+bool setIntOption(
+    folly::NetworkSocket sock,
+    int level,
+    int optname,
+    int val) noexcept {
+  return folly::netops::setsockopt(sock, level, optname, &val, sizeof(val)) ==
+      0;
+}
+#endif
+
+} // namespace
+
+bool setSocketECN(
+    FOLLY_MAYBE_UNUSED folly::NetworkSocket sock,
+    FOLLY_MAYBE_UNUSED sa_family_t family,
+    FOLLY_MAYBE_UNUSED bool enabled) noexcept {
+#ifdef __linux__
+  int tos = enabled ? static_cast<int>(ECNCodepoint::ECT0) : 0;
+  int recv = enabled ? 1 : 0;
+  if (family == AF_INET6) {
+    if (!setIntOption(sock, IPPROTO_IPV6, IPV6_TCLASS, tos) ||
+        !setIntOption(sock, IPPROTO_IPV6, IPV6_RECVTCLASS, recv)) {
+      return false;
+    }
+    // These fail on v6-only sockets, which never see v4 packets anyway.
+    setIntOption(sock, IPPROTO_IP, IP_TOS, tos);
+    setIntOption(sock, IPPROTO_IP, IP_RECVTOS, recv);
+    return true;
+  }
+  return setIntOption(sock, IPPROTO_IP, IP_TOS, tos) &&
+      setIntOption(sock, IPPROTO_IP, IP_RECVTOS, recv);
+#else
+  return false;
+#endif
+}
+
+ECNCodepoint getECNCodepoint(
+    FOLLY_MAYBE_UNUSED const struct msghdr& msg) noexcept {
+#ifdef __linux__
+  if (!msg.msg_control) {
+    return ECNCodepoint::NotECT;
+  }
+  for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&msg), cmsg)) {
+    // IP_TOS carries a single byte, IPV6_TCLASS an int.
+    if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TOS) {
+      uint8_t tos;
+      memcpy(&tos, CMSG_DATA(cmsg), sizeof(tos));
+      return static_cast<ECNCodepoint>(tos & kECNMask);
+    }
+    if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_TCLASS) {
+      int tclass;
+      memcpy(&tclass, CMSG_DATA(cmsg), sizeof(tclass));
+      return static_cast<ECNCodepoint>(tclass & kECNMask);
+    }
+  }
+#endif
+  return ECNCodepoint::NotECT;
+}
+
+} // namespace quic
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/net/NetworkSocket.h>
+#include <folly/portability/Sockets.h>
+#include <quic/QuicConstants.h>
+
+namespace quic {
+
+// Size of the control buffer needed to receive the TOS / traffic class cmsg.
+constexpr size_t kECNControlSize = 32;
+
+/**
+ * Marks the packets sent on the socket with ECT(0), or clears the mark, and
+ * asks the kernel to report the TOS / traffic class byte of received packets.
+ * family is the address family the socket is bound to; IPv6 sockets have the
+ * IPv4 options set as well for v4-mapped peers. Returns false if the platform
+ * or the kernel does not support it.
+ */
+bool setSocketECN(
+    folly::NetworkSocket sock,
+    sa_family_t family,
+    bool enabled) noexcept;
+
+/**
+ * Returns the ECN codepoint of a received datagram, as reported by the kernel
+ * in the control messages of a recvmsg call, or NotECT if the message carries
+ * no TOS / traffic class.
+ */
+ECNCodepoint getECNCodepoint(const struct msghdr& msg) noexcept;
+
+} // namespace quic
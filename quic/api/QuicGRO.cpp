@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicGRO.h>
+
+#include <folly/net/NetOps.h>
+
+#include <cstring>
+
+#if defined(__linux__) && !defined(SOL_UDP)
+#define SOL_UDP 17
+#endif
+
+#if defined(__linux__) && !defined(UDP_GRO)
+#define UDP_GRO 104
+#endif
+
+namespace quic {
+
+bool setSocketGRO(
+    FOLLY_MAYBE_UNUSED folly::NetworkSocket sock,
+    FOLLY_MAYBE_UNUSED bool enabled) noexcept {
+#ifdef UDP_GRO
+  int val = enabled ? 1 : 0;
+  return folly::netops::setsockopt(
+             sock, SOL_UDP, UDP_GRO, &val, sizeof(val)) == 0;
+#else
+  return false;
+#endif
+}
+
+size_t getGROSegmentSize(FOLLY_MAYBE_UNUSED const struct msghdr& msg) noexcept {
+#ifdef UDP_GRO
+  if (!msg.msg_control) {
+    return 0;
+  }
+  for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&msg), cmsg)) {
+    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+      int segmentSize;
+      memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof(segmentSize));
+      return segmentSize > 0 ? segmentSize : 0;
+    }
+  }
+#endif
+  return 0;
+}
+
+void splitGROBuffer(
+    std::unique_ptr<folly::IOBuf> buf,
+    size_t segmentSize,
+    std::vector<std::unique_ptr<folly::IOBuf>>& packets) {
+  DCHECK(!buf->isChained());
+  size_t remaining = buf->length();
+  if (segmentSize == 0 || remaining <= segmentSize) {
+    packets.emplace_back(std::move(buf));
+    return;
+  }
+  size_t offset = 0;
+  while (remaining > segmentSize) {
+    // cloneOne shares the underlying buffer, we just narrow the view.
+    auto packet = buf->cloneOne();
+    packet->trimStart(offset);
+    packet->trimEnd(remaining - segmentSize);
+    packets.emplace_back(std::move(packet));
+    offset += segmentSize;
+    remaining -= segmentSize;
+  }
+  // The last datagram reuses the original IOBuf.
+  buf->trimStart(offset);
+  packets.emplace_back(std::move(buf));
+}
+
+} // namespace quic
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <folly/net/NetworkSocket.h>
+#include <folly/portability/Sockets.h>
+#include <quic/QuicConstants.h>
+
+#include <vector>
+
+namespace quic {
+
+// Size of the control buffer needed to receive the GRO segment size cmsg.
+constexpr size_t kGROControlSize = 64;
+
+/**
+ * Turns UDP generic receive offload on or off for the socket. Returns false
+ * if the platform or the kernel does not support it.
+ */
+bool setSocketGRO(folly::NetworkSocket sock, bool enabled) noexcept;
+
+/**
+ * Returns the size of each datagram coalesced by GRO into the message, as
+ * reported by the kernel in the control messages of a recvmsg call, or 0 if
+ * the message carries no segment size.
+ */
+size_t getGROSegmentSize(const struct msghdr& msg) noexcept;
+
+/**
+ * Splits a buffer holding several GRO-coalesced datagrams of segmentSize
+ * bytes (the last one may be shorter) into one IOBuf per datagram, appending
+ * them to packets. The resulting IOBufs share the input's underlying buffer,
+ * so no data is copied.
+ */
+void splitGROBuffer(
+    std::unique_ptr<folly::IOBuf> buf,
+    size_t segmentSize,
+    std::vector<std::unique_ptr<folly::IOBuf>>& packets);
+
+} // namespace quic
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicKernelPacing.h>
+
+#include <folly/net/NetOps.h>
+#include <folly/portability/Sockets.h>
+
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#ifdef __linux__
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef SO_TXTIME
+#define SO_TXTIME 61
+#define SCM_TXTIME SO_TXTIME
+#endif
+
+namespace {
+// struct sock_txtime from linux/net_tstamp.h, not available in older headers.
+struct QuicSockTxTime {
+  clockid_t clockid;
+  uint32_t flags;
+};
+} // namespace
+#endif
+
+namespace quic {
+
+std::unique_ptr<KernelPacer> KernelPacer::create(
+    FOLLY_MAYBE_UNUSED folly::NetworkSocket sock) {
+#ifdef SO_TXTIME
+  // Departure times are taken from Clock, which is CLOCK_MONOTONIC.
+  QuicSockTxTime txTime = {CLOCK_MONOTONIC, 0};
+  if (folly::netops::setsockopt(
+          sock, SOL_SOCKET, SO_TXTIME, &txTime, sizeof(txTime)) == 0) {
+    return std::make_unique<KernelPacer>(sock);
+  }
+#endif
+  return nullptr;
+}
+
+KernelPacer::KernelPacer(folly::NetworkSocket sock) : sock_(sock) {}
+
+void KernelPacer::setPacingRate(
+    std::chrono::microseconds interval,
+    uint64_t burstSize) {
+  packetInterval_ = burstSize
+      ? std::chrono::duration_cast<std::chrono::nanoseconds>(interval) /
+          static_cast<int64_t>(burstSize)
+      : std::chrono::nanoseconds(0);
+}
+
+TimePoint KernelPacer::getDepartureTime(TimePoint now, size_t numPackets) {
+  // An idle connection does not get to catch up on the departures it missed.
+  auto departureTime = std::max(now, nextDepartureTime_);
+  nextDepartureTime_ =
+      departureTime + packetInterval_ * static_cast<int64_t>(numPackets);
+  return departureTime;
+}
+
+ssize_t KernelPacer::write(
+    FOLLY_MAYBE_UNUSED const folly::SocketAddress& address,
+    FOLLY_MAYBE_UNUSED const std::unique_ptr<folly::IOBuf>& buf,
+    FOLLY_MAYBE_UNUSED int gso,
+    FOLLY_MAYBE_UNUSED size_t numPackets) {
+#ifdef SO_TXTIME
+  uint64_t txTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        getDepartureTime(Clock::now(), numPackets)
+                            .time_since_epoch())
+                        .count();
+  sockaddr_storage addr;
+  std::vector<iovec> iov;
+  for (auto range : *buf) {
+    if (!range.empty()) {
+      iov.push_back({const_cast<uint8_t*>(range.data()), range.size()});
+    }
+  }
+  char control[CMSG_SPACE(sizeof(uint64_t)) + CMSG_SPACE(sizeof(uint16_t))] =
+      {};
+  msghdr msg = {};
+  msg.msg_name = &addr;
+  msg.msg_namelen = address.getAddress(&addr);
+  msg.msg_iov = iov.data();
+  msg.msg_iovlen = iov.size();
+  msg.msg_control = control;
+  msg.msg_controllen = gso > 0 ? sizeof(control)
+                               : CMSG_SPACE(sizeof(uint64_t));
+  auto cm = CMSG_FIRSTHDR(&msg);
+  cm->cmsg_level = SOL_SOCKET;
+  cm->cmsg_type = SCM_TXTIME;
+  cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+  memcpy(CMSG_DATA(cm), &txTime, sizeof(txTime));
+  if (gso > 0) {
+    cm = CMSG_NXTHDR(&msg, cm);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    auto gsoSize = static_cast<uint16_t>(gso);
+    memcpy(CMSG_DATA(cm), &gsoSize, sizeof(gsoSize));
+  }
+  return folly::netops::sendmsg(sock_, &msg, 0);
+#else
+  errno = ENOTSUP;
+  return -1;
+#endif
+}
+
+} // namespace quic
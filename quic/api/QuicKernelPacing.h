@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+#include <folly/net/NetworkSocket.h>
+#include <quic/QuicConstants.h>
+
+namespace quic {
+
+/**
+ * Offloads pacing of one socket to the kernel. Every write carries an
+ * SCM_TXTIME departure time derived from the congestion controller's pacing
+ * rate, and the fq qdisc holds the packets back until then. This lets the
+ * transport hand over large batches without a pacing timer wakeup per burst.
+ *
+ * A GSO batch gets a single departure time, the next write is then delayed by
+ * the time it takes to send all of the batch's packets at the pacing rate.
+ */
+class KernelPacer {
+ public:
+  /**
+   * Turns SO_TXTIME on for the socket. Returns nullptr if the platform or
+   * the kernel does not support it.
+   */
+  static std::unique_ptr<KernelPacer> create(folly::NetworkSocket sock);
+
+  explicit KernelPacer(folly::NetworkSocket sock);
+
+  folly::NetworkSocket getNetworkSocket() const {
+    return sock_;
+  }
+
+  // Sets the pacing rate to burstSize packets every interval.
+  void setPacingRate(std::chrono::microseconds interval, uint64_t burstSize);
+
+  /**
+   * Returns the departure time for a batch of numPackets packets written at
+   * now, and moves the departure time of the next batch accordingly.
+   */
+  TimePoint getDepartureTime(TimePoint now, size_t numPackets);
+
+  /**
+   * Writes buf with a departure time. A non zero gso sends buf as numPackets
+   * segments of gso bytes. Returns the result of sendmsg.
+   */
+  ssize_t write(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf,
+      int gso,
+      size_t numPackets);
+
+ private:
+  folly::NetworkSocket sock_;
+  std::chrono::nanoseconds packetInterval_{0};
+  TimePoint nextDepartureTime_;
+};
+
+} // namespace quic
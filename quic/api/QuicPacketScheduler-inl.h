@@ -57,6 +57,9 @@ folly::Optional<PacketNum> AckScheduler::writeAcksImpl(
                  ackingTime - receivedTime)
            : 0us);
   AckFrameMetaData meta(ackState_.acks, ackDelay, ackDelayExponentToUse);
+  if (!ackState_.ecnCountsRecvd.empty()) {
+    meta.ecnCounts = ackState_.ecnCountsRecvd;
+  }
   auto ackWriteResult = writeAckFrame(meta, builder);
   if (!ackWriteResult) {
     return folly::none;
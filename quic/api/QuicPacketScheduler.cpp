@@ -8,27 +8,8 @@
 
 #include <quic/api/QuicPacketScheduler.h>
 
-namespace {
-
-quic::StreamFrameMetaData makeStreamFrameMetaDataFromStreamBuffer(
-    quic::StreamId id,
-    const quic::StreamBuffer& buffer);
-
-quic::StreamFrameMetaData makeStreamFrameMetaDataFromStreamBuffer(
-    quic::StreamId id,
-    const quic::StreamBuffer& buffer) {
-  quic::StreamFrameMetaData streamMeta;
-  // It's very tricky to get the stream data without the length right,
-  // so don't support it for now.
-  streamMeta.hasMoreFrames = true;
-  streamMeta.id = id;
-  streamMeta.offset = buffer.offset;
-  streamMeta.fin = buffer.eof;
-  streamMeta.data = buffer.data.front() ? buffer.data.front()->clone()
-                                        : folly::IOBuf::create(0);
-  return streamMeta;
-}
-} // namespace
+#include <folly/sorted_vector_types.h>
+#include <quic/state/QuicStreamUtilities.h>
 
 namespace quic {
 
@@ -103,6 +84,11 @@ FrameScheduler::Builder& FrameScheduler::Builder::simpleFrames() {
   return *this;
 }
 
+FrameScheduler::Builder& FrameScheduler::Builder::datagramFrames() {
+  datagramFrameScheduler_ = true;
+  return *this;
+}
+
 FrameScheduler FrameScheduler::Builder::build() && {
   auto scheduler = FrameScheduler(name_);
   if (retransmissionScheduler_) {
@@ -131,6 +117,9 @@ FrameScheduler FrameScheduler::Builder::build() && {
   if (simpleFrameScheduler_) {
     scheduler.simpleFrameScheduler_.emplace(SimpleFrameScheduler(conn_));
   }
+  if (datagramFrameScheduler_) {
+    scheduler.datagramFrameScheduler_.emplace(DatagramFrameScheduler(conn_));
+  }
   return scheduler;
 }
 
@@ -189,6 +178,10 @@ FrameScheduler::scheduleFramesForPacket(
       simpleFrameScheduler_->hasPendingSimpleFrames()) {
     simpleFrameScheduler_->writeSimpleFrames(wrapper);
   }
+  if (datagramFrameScheduler_ &&
+      datagramFrameScheduler_->hasPendingDatagramFrames()) {
+    datagramFrameScheduler_->writeDatagramFrames(wrapper);
+  }
   return std::make_pair(folly::none, std::move(builder).buildPacket());
 }
 
@@ -207,7 +200,9 @@ bool FrameScheduler::hasImmediateData() const {
        windowUpdateScheduler_->hasPendingWindowUpdates()) ||
       (blockedScheduler_ && blockedScheduler_->hasPendingBlockedFrames()) ||
       (simpleFrameScheduler_ &&
-       simpleFrameScheduler_->hasPendingSimpleFrames());
+       simpleFrameScheduler_->hasPendingSimpleFrames()) ||
+      (datagramFrameScheduler_ &&
+       datagramFrameScheduler_->hasPendingDatagramFrames());
 }
 
 std::string FrameScheduler::name() const {
@@ -223,12 +218,15 @@ void RetransmissionScheduler::writeRetransmissionStreams(
   for (auto streamId : conn_.streamManager->lossStreams()) {
     auto stream = conn_.streamManager->findStream(streamId);
     CHECK(stream);
-    for (auto buffer = stream->lossBuffer.cbegin();
-         buffer != stream->lossBuffer.cend();
-         ++buffer) {
-      auto streamMeta =
-          makeStreamFrameMetaDataFromStreamBuffer(stream->id, *buffer);
-      auto res = writeStreamFrame(streamMeta, builder);
+    // Contiguous lost data is merged into one buffer as it is marked lost, so
+    // every buffer goes out in as large a frame as the packet fits. The frame
+    // is written straight from the buffer, which is only cloned for the bytes
+    // that make it into the packet.
+    for (const auto& buffer : stream->lossBuffer) {
+      StreamFrameMetaData streamMeta(
+          stream->id, buffer.offset, buffer.eof, nullptr /* data */, true);
+      auto res =
+          writeStreamFrameFromBuffer(streamMeta, buffer.data.front(), builder);
       if (!res) {
         // Finish assembling a packet
         break;
@@ -250,17 +248,97 @@ StreamFrameScheduler::StreamFrameScheduler(const QuicConnectionStateBase& conn)
 
 void StreamFrameScheduler::writeStreams(PacketBuilderInterface& builder) {
   uint64_t connWritableBytes = getSendConnFlowControlBytesWire(conn_);
-  MiddleStartingIterationWrapper wrapper(
-      conn_.streamManager->writableStreams(),
-      conn_.schedulingState.lastScheduledStream);
-  auto writableStreamItr = wrapper.cbegin();
-  while (writableStreamItr != wrapper.cend() && connWritableBytes > 0) {
-    auto res =
-        writeNextStreamFrame(builder, writableStreamItr, connWritableBytes);
+  std::vector<StreamId> dueStreams;
+  if (conn_.streamManager->hasDeadlines() &&
+      !writeDueStreams(builder, connWritableBytes, dueStreams)) {
+    return;
+  }
+  auto& writableStreams = conn_.streamManager->writableStreams();
+  // Urgency levels are served strictly in order, a level only gets to write
+  // once every stream of the more urgent levels is done or blocked.
+  for (size_t urgency = 0;
+       urgency < writableStreams.size() && connWritableBytes > 0;
+       ++urgency) {
+    const auto& level = writableStreams[urgency];
+    if (level.empty()) {
+      continue;
+    }
+    MiddleStartingIterationWrapper wrapper(
+        level, conn_.schedulingState.nextScheduledStream[urgency]);
+    auto writableStreamItr = wrapper.cbegin();
+    while (writableStreamItr != wrapper.cend() && connWritableBytes > 0) {
+      if (std::find(
+              dueStreams.begin(), dueStreams.end(), *writableStreamItr) !=
+          dueStreams.end()) {
+        ++writableStreamItr;
+        continue;
+      }
+      auto res =
+          writeNextStreamFrame(builder, writableStreamItr, connWritableBytes);
+      if (!res) {
+        return;
+      }
+    }
+  }
+}
+
+bool StreamFrameScheduler::writeDueStreams(
+    PacketBuilderInterface& builder,
+    uint64_t& connWritableBytes,
+    std::vector<StreamId>& writtenStreams) {
+  // Data that could no longer make it within srtt/2 was already expired by
+  // the transport, the rest is due if waiting for another round trip would
+  // make it miss its deadline.
+  auto dueBy = loopClockNow(conn_) + conn_.lossState.srtt;
+  std::vector<std::pair<TimePoint, const QuicStreamState*>> dueStreams;
+  for (auto id : conn_.streamManager->deadlineStreams()) {
+    if (!conn_.streamManager->writableContains(id)) {
+      continue;
+    }
+    auto stream = conn_.streamManager->findStream(id);
+    CHECK(stream);
+    auto nextDeadline = std::find_if(
+        stream->writeDeadlines.begin(),
+        stream->writeDeadlines.end(),
+        [&](const auto& deadline) {
+          return deadline.endOffset > stream->currentWriteOffset;
+        });
+    if (nextDeadline != stream->writeDeadlines.end() &&
+        nextDeadline->deadline <= dueBy) {
+      dueStreams.emplace_back(nextDeadline->deadline, stream);
+    }
+  }
+  std::sort(
+      dueStreams.begin(),
+      dueStreams.end(),
+      [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+  for (const auto& dueStream : dueStreams) {
+    if (connWritableBytes == 0) {
+      return false;
+    }
+    const auto& stream = *dueStream.second;
+    auto pendingBytes = std::min<uint64_t>(
+        getSendStreamFlowControlBytesWire(stream),
+        stream.writeBuffer.chainLength());
+    auto streamMeta = makeStreamFrameMetaData(
+        stream,
+        std::min(pendingBytes, connWritableBytes),
+        builder.remainingSpaceInPkt());
+    auto res = writeStreamFrame(streamMeta, builder);
     if (!res) {
-      break;
+      return false;
+    }
+    VLOG(4) << "Wrote due stream frame stream=" << streamMeta.id
+            << " offset=" << streamMeta.offset
+            << " bytesWritten=" << res->bytesWritten
+            << " finWritten=" << res->finWritten << " " << conn_;
+    connWritableBytes -= res->bytesWritten;
+    if (res->bytesWritten < pendingBytes) {
+      return false;
     }
+    writtenStreams.push_back(stream.id);
   }
+  return true;
 }
 
 bool StreamFrameScheduler::hasPendingData() const {
@@ -279,7 +357,26 @@ bool StreamFrameScheduler::writeNextStreamFrame(
   // stream to be in writableList
   DCHECK(stream->hasWritableData());
 
-  auto streamMeta = makeStreamFrameMetaData(*stream, true, connWritableBytes);
+  // With weighted fair queueing a stream sends at most the rest of its
+  // quantum before the next stream gets its turn.
+  bool weighted = conn_.transportSettings.streamSchedulingMode ==
+      StreamSchedulingMode::WeightedFairQueueing;
+  uint64_t quantumLeft = weighted ? getStreamSchedulingQuantumLeft(*stream)
+                                  : std::numeric_limits<uint64_t>::max();
+  // The stream flow control is only looked at once per frame.
+  auto pendingBytes = std::min<uint64_t>(
+      getSendStreamFlowControlBytesWire(*stream),
+      stream->writeBuffer.chainLength());
+  auto rateLeft = getStreamSendRateBytesLeft(*stream, loopClockNow(conn_));
+  if (rateLeft == 0 && pendingBytes > 0) {
+    // Used up its rate within this write loop.
+    ++writableStreamItr;
+    return true;
+  }
+  auto streamMeta = makeStreamFrameMetaData(
+      *stream,
+      std::min({pendingBytes, connWritableBytes, quantumLeft, rateLeft}),
+      builder.remainingSpaceInPkt());
   auto res = writeStreamFrame(streamMeta, builder);
   if (!res) {
     // Finish assembling a packet
@@ -293,10 +390,8 @@ bool StreamFrameScheduler::writeNextStreamFrame(
   // bytesWritten < min(flowControlBytes, writeBuffer) means that we haven't
   // written all writable bytes in this stream due to short of room in the
   // packet.
-  if (res->bytesWritten ==
-      std::min<uint64_t>(
-          getSendStreamFlowControlBytesWire(*stream),
-          stream->writeBuffer.chainLength())) {
+  if (res->bytesWritten == pendingBytes || res->bytesWritten >= quantumLeft ||
+      res->bytesWritten >= rateLeft) {
     ++writableStreamItr;
   }
   return true;
@@ -304,12 +399,13 @@ bool StreamFrameScheduler::writeNextStreamFrame(
 
 StreamFrameMetaData StreamFrameScheduler::makeStreamFrameMetaData(
     const QuicStreamState& streamData,
-    bool /*hasMoreData*/,
-    uint64_t connWritableBytes) {
-  uint64_t writableBytes = std::min(
-      getSendStreamFlowControlBytesWire(streamData), connWritableBytes);
+    uint64_t writableBytes,
+    uint64_t spaceLeftInPkt) {
   StreamFrameMetaData streamMeta;
-  streamMeta.hasMoreFrames = true;
+  // A frame with enough data to fill the rest of the packet is the last one
+  // in it, so it can do without a length field.
+  streamMeta.hasMoreFrames = writableBytes < spaceLeftInPkt ||
+      writableBytes < kMinStreamFrameDataWithoutLength;
   streamMeta.id = streamData.id;
   streamMeta.offset = streamData.currentWriteOffset;
   if (streamData.writeBuffer.front()) {
@@ -355,7 +451,7 @@ SimpleFrameScheduler::SimpleFrameScheduler(const QuicConnectionStateBase& conn)
 
 bool SimpleFrameScheduler::hasPendingSimpleFrames() const {
   return conn_.pendingEvents.pathChallenge ||
-      !conn_.pendingEvents.frames.empty();
+      !conn_.pendingEvents.frames.empty() || conn_.pendingEvents.sendPing;
 }
 
 bool SimpleFrameScheduler::writeSimpleFrames(PacketBuilderInterface& builder) {
@@ -366,6 +462,12 @@ bool SimpleFrameScheduler::writeSimpleFrames(PacketBuilderInterface& builder) {
   }
 
   bool framesWritten = false;
+  if (conn_.pendingEvents.sendPing) {
+    if (!writeFrame(PingFrame(), builder)) {
+      return false;
+    }
+    framesWritten = true;
+  }
   for (auto& frame : conn_.pendingEvents.frames) {
     auto bytesWritten = writeSimpleFrame(QuicSimpleFrame(frame), builder);
     if (!bytesWritten) {
@@ -376,13 +478,38 @@ bool SimpleFrameScheduler::writeSimpleFrames(PacketBuilderInterface& builder) {
   return framesWritten;
 }
 
+DatagramFrameScheduler::DatagramFrameScheduler(
+    const QuicConnectionStateBase& conn)
+    : conn_(conn) {}
+
+bool DatagramFrameScheduler::hasPendingDatagramFrames() const {
+  return !conn_.datagramState.writeBuffer.empty();
+}
+
+bool DatagramFrameScheduler::writeDatagramFrames(
+    PacketBuilderInterface& builder) {
+  bool framesWritten = false;
+  for (const auto& datagram : conn_.datagramState.writeBuffer) {
+    auto len = datagram->computeChainDataLength();
+    auto bytesWritten =
+        writeFrame(DatagramFrame(len, datagram->clone()), builder);
+    if (!bytesWritten) {
+      break;
+    }
+    VLOG(4) << "Wrote datagram len=" << len << " " << conn_;
+    framesWritten = true;
+  }
+  return framesWritten;
+}
+
 WindowUpdateScheduler::WindowUpdateScheduler(
     const QuicConnectionStateBase& conn)
     : conn_(conn) {}
 
 bool WindowUpdateScheduler::hasPendingWindowUpdates() const {
   return conn_.streamManager->hasWindowUpdates() ||
-      conn_.pendingEvents.connWindowUpdate;
+      conn_.pendingEvents.connWindowUpdate ||
+      conn_.streamManager->hasStreamLimitUpdates();
 }
 
 void WindowUpdateScheduler::writeWindowUpdates(
@@ -395,7 +522,24 @@ void WindowUpdateScheduler::writeWindowUpdates(
       VLOG(4) << "Wrote max_data=" << maximumData << " " << conn_;
     }
   }
+  for (bool bidirectional : {true, false}) {
+    auto maxStreams = bidirectional
+        ? conn_.streamManager->remoteBidirectionalStreamLimitUpdate()
+        : conn_.streamManager->remoteUnidirectionalStreamLimitUpdate();
+    if (maxStreams &&
+        writeFrame(MaxStreamsFrame(*maxStreams, bidirectional), builder)) {
+      VLOG(4) << "Wrote max_streams=" << *maxStreams
+              << " bidirectional=" << bidirectional << " " << conn_;
+    }
+  }
+  // Deferred updates are batched up, cap how much of the packet they take.
+  uint64_t updatesLeft = conn_.transportSettings.deferWindowUpdates
+      ? conn_.transportSettings.maxWindowUpdatesPerPacket
+      : std::numeric_limits<uint64_t>::max();
   for (const auto& windowUpdateStream : conn_.streamManager->windowUpdates()) {
+    if (updatesLeft == 0) {
+      break;
+    }
     auto stream = conn_.streamManager->findStream(windowUpdateStream);
     if (!stream) {
       continue;
@@ -406,6 +550,7 @@ void WindowUpdateScheduler::writeWindowUpdates(
     if (!bytes) {
       break;
     }
+    --updatesLeft;
     VLOG(4) << "Wrote max_stream_data stream=" << stream->id
             << " maximumData=" << maximumData << " " << conn_;
   }
@@ -538,55 +683,120 @@ CloningScheduler::scheduleFramesForPacket(
     return frameScheduler_.scheduleFramesForPacket(
         std::move(builder), writableBytes);
   }
-  // Look for an outstanding packet that's no larger than the writableBytes
-  for (auto iter = conn_.outstandingPackets.rbegin();
-       iter != conn_.outstandingPackets.rend();
-       ++iter) {
+  // Packets worth cloning: AppData packets that carry more than acks, and that
+  // have either never been cloned or whose PacketEvent is still outstanding,
+  // i.e. none of its copies has been acked or lost yet.
+  auto isCloneCandidate = [&](const OutstandingPacket& packet) {
     auto opPnSpace = folly::variant_match(
-        iter->packet.header,
+        packet.packet.header,
         [](const auto& h) { return h.getPacketNumberSpace(); });
-    if (opPnSpace != PacketNumberSpace::AppData) {
-      continue;
+    // We shouldn't clone Handshake packet. For PureAcks, cloning them bring
+    // perf down as shown by load test.
+    if (opPnSpace != PacketNumberSpace::AppData || packet.isHandshake ||
+        packet.pureAck) {
+      return false;
+    }
+    // If the packet is already a clone that has been processed, we don't clone
+    // it again.
+    if (packet.associatedEvent &&
+        conn_.outstandingPacketEvents.count(*packet.associatedEvent) == 0) {
+      return false;
     }
+    // The writableBytes here is an optimization. If the writableBytes is too
+    // small for this packet. rebuildFromPacket should fail anyway.
+    // TODO: This isn't the ideal way to solve the wrong writableBytes problem.
+    return packet.encodedSize <= writableBytes + cipherOverhead_;
+  };
+  auto builderPnSpace = folly::variant_match(
+      builder.getPacketHeader(),
+      [](const auto& h) { return h.getPacketNumberSpace(); });
+  CHECK_EQ(builderPnSpace, PacketNumberSpace::AppData);
+  auto tryClone = [&](OutstandingPacket& packet)
+      -> folly::Optional<std::pair<
+          folly::Optional<PacketEvent>,
+          folly::Optional<RegularQuicPacketBuilder::Packet>>> {
     // Reusing the RegularQuicPacketBuilder throughout loop bodies will lead to
     // frames belong to different original packets being written into the same
     // clone packet. So re-create a RegularQuicPacketBuilder every time.
     // TODO: We can avoid the copy & rebuild of the header by creating an
     // independent header builder.
-    auto builderPnSpace = folly::variant_match(
-        builder.getPacketHeader(),
-        [](const auto& h) { return h.getPacketNumberSpace(); });
-    CHECK_EQ(builderPnSpace, PacketNumberSpace::AppData);
     RegularQuicPacketBuilder regularBuilder(
         conn_.udpSendPacketLen,
         builder.getPacketHeader(),
         getAckState(conn_, builderPnSpace).largestAckedByPeer,
         conn_.version.value_or(*conn_.originalVersion));
     PacketRebuilder rebuilder(regularBuilder, conn_);
-    // We shouldn't clone Handshake packet. For PureAcks, cloning them bring
-    // perf down as shown by load test.
-    if (iter->isHandshake || iter->pureAck) {
+    // Rebuilder will write the rest of frames
+    auto rebuildResult = rebuilder.rebuildFromPacket(packet);
+    if (!rebuildResult) {
+      return folly::none;
+    }
+    return std::make_pair(
+        std::move(rebuildResult), std::move(regularBuilder).buildPacket());
+  };
+
+  // The oldest data is the most likely to be lost and to hold up the peer, so
+  // clone oldest first, and prefer packets that have never been cloned: their
+  // data hasn't been probed yet.
+  bool hasClonedCandidates = false;
+  for (auto& packet : conn_.outstandingPackets) {
+    if (!isCloneCandidate(packet)) {
       continue;
     }
-    // If the packet is already a clone that has been processed, we don't clone
-    // it again.
-    if (iter->associatedEvent &&
-        conn_.outstandingPacketEvents.count(*iter->associatedEvent) == 0) {
+    if (packet.associatedEvent) {
+      hasClonedCandidates = true;
       continue;
     }
+    auto result = tryClone(packet);
+    if (result) {
+      return std::move(*result);
+    }
+  }
+  if (!hasClonedCandidates) {
+    return std::make_pair(folly::none, folly::none);
+  }
 
-    // The writableBytes here is an optimization. If the writableBytes is too
-    // small for this packet. rebuildFromPacket should fail anyway.
-    // TODO: This isn't the ideal way to solve the wrong writableBytes problem.
-    if (iter->encodedSize > writableBytes + cipherOverhead_) {
+  // Everything left has been cloned already. Count the outstanding copies of
+  // each PacketEvent, so that the same data isn't sent again and again over
+  // consecutive PTOs.
+  folly::sorted_vector_map<PacketEvent, uint64_t> copies;
+  for (const auto& packet : conn_.outstandingPackets) {
+    if (packet.associatedEvent) {
+      ++copies[*packet.associatedEvent];
+    }
+  }
+  bool overBudget = false;
+  for (auto& packet : conn_.outstandingPackets) {
+    if (!packet.associatedEvent || !isCloneCandidate(packet)) {
       continue;
     }
-
-    // Rebuilder will write the rest of frames
-    auto rebuildResult = rebuilder.rebuildFromPacket(*iter);
-    if (rebuildResult) {
+    auto& numCopies = copies[*packet.associatedEvent];
+    if (numCopies == 0) {
+      // Another copy of this event has been tried already.
+      continue;
+    }
+    // One of the copies is the original packet.
+    if (numCopies > conn_.transportSettings.maxClonesPerPacket) {
+      overBudget = true;
+      numCopies = 0;
+      continue;
+    }
+    numCopies = 0;
+    auto result = tryClone(packet);
+    if (result) {
+      return std::move(*result);
+    }
+  }
+  if (overBudget) {
+    // The probe still has to elicit an ack from the peer.
+    RegularQuicPacketBuilder regularBuilder(
+        conn_.udpSendPacketLen,
+        builder.getPacketHeader(),
+        getAckState(conn_, builderPnSpace).largestAckedByPeer,
+        conn_.version.value_or(*conn_.originalVersion));
+    if (writeFrame(PingFrame(), regularBuilder) != 0) {
       return std::make_pair(
-          std::move(rebuildResult), std::move(regularBuilder).buildPacket());
+          folly::none, std::move(regularBuilder).buildPacket());
     }
   }
   return std::make_pair(folly::none, folly::none);
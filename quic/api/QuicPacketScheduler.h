@@ -110,7 +110,11 @@ class StreamFrameScheduler {
           const MapType::key_type& start)
           : streams_(streams) {
         itr_ = streams_->lower_bound(start);
-        checkForWrapAround();
+        if (itr_ == streams_->cend()) {
+          // Every stream is below the start, begin from the lowest one.
+          itr_ = streams_->cbegin();
+          wrappedAround_ = streams_->empty();
+        }
       }
 
       const MapType::value_type& dereference() const {
@@ -176,10 +180,26 @@ class StreamFrameScheduler {
       WritableStreamItr& writableStreamItr,
       uint64_t& connWritableBytes);
 
+  /**
+   * Writes the streams whose next unsent data has a deadline within the next
+   * srtt, earliest deadline first. The ids of those streams are added to
+   * writtenStreams once all their writable data is in the packet.
+   *
+   * Return: false if the packet or the connection flow control window is full.
+   */
+  bool writeDueStreams(
+      PacketBuilderInterface& builder,
+      uint64_t& connWritableBytes,
+      std::vector<StreamId>& writtenStreams);
+
+  /**
+   * Builds the metadata of a frame carrying up to writableBytes of the
+   * stream's pending data, which must already be limited by flow control.
+   */
   StreamFrameMetaData makeStreamFrameMetaData(
       const QuicStreamState& streamData,
-      bool hasMoreData,
-      uint64_t connWritableBytes);
+      uint64_t writableBytes,
+      uint64_t spaceLeftInPkt);
 
   const QuicConnectionStateBase& conn_;
 };
@@ -250,6 +270,22 @@ class SimpleFrameScheduler {
   const QuicConnectionStateBase& conn_;
 };
 
+/*
+ * Datagrams are written in the order the app wrote them. They are removed
+ * from the write buffer once sent and never retransmitted or cloned.
+ */
+class DatagramFrameScheduler {
+ public:
+  explicit DatagramFrameScheduler(const QuicConnectionStateBase& conn);
+
+  bool hasPendingDatagramFrames() const;
+
+  bool writeDatagramFrames(PacketBuilderInterface& builder);
+
+ private:
+  const QuicConnectionStateBase& conn_;
+};
+
 class WindowUpdateScheduler {
  public:
   explicit WindowUpdateScheduler(const QuicConnectionStateBase& conn);
@@ -328,6 +364,7 @@ class FrameScheduler : public QuicPacketScheduler {
     Builder& blockedFrames();
     Builder& cryptoFrames();
     Builder& simpleFrames();
+    Builder& datagramFrames();
 
     FrameScheduler build() &&;
 
@@ -346,6 +383,7 @@ class FrameScheduler : public QuicPacketScheduler {
     bool blockedScheduler_{false};
     bool cryptoStreamScheduler_{false};
     bool simpleFrameScheduler_{false};
+    bool datagramFrameScheduler_{false};
   };
 
   explicit FrameScheduler(const std::string& name);
@@ -374,6 +412,7 @@ class FrameScheduler : public QuicPacketScheduler {
   folly::Optional<BlockedScheduler> blockedScheduler_;
   folly::Optional<CryptoStreamScheduler> cryptoStreamScheduler_;
   folly::Optional<SimpleFrameScheduler> simpleFrameScheduler_;
+  folly::Optional<DatagramFrameScheduler> datagramFrameScheduler_;
   std::string name_;
 };
 
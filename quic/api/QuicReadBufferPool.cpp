@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicReadBufferPool.h>
+
+#include <glog/logging.h>
+#include <quic/common/BufferArena.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace quic {
+
+namespace {
+// Every pooled buffer is preceded by a header that keeps the pool state alive
+// for as long as the buffer exists.
+template <class State>
+struct BufferHeader {
+  std::shared_ptr<State> state;
+  bool fromArena;
+};
+
+constexpr size_t kHeaderAlignment = alignof(std::max_align_t);
+
+template <class State>
+constexpr size_t headerSize() {
+  return (sizeof(BufferHeader<State>) + kHeaderAlignment - 1) /
+      kHeaderAlignment * kHeaderAlignment;
+}
+} // namespace
+
+void QuicReadBufferPool::BufferDeleter::operator()(uint8_t* buf) const
+    noexcept {
+  QuicReadBufferPool::recycle(buf);
+}
+
+QuicReadBufferPool::QuicReadBufferPool(
+    size_t bufferSize,
+    size_t maxFreeBuffers,
+    size_t copyThreshold,
+    BufferArena* arena)
+    : state_(std::make_shared<State>(bufferSize, maxFreeBuffers)),
+      copyThreshold_(copyThreshold),
+      arena_(arena) {
+  state_->freeBuffers.reserve(maxFreeBuffers);
+}
+
+QuicReadBufferPool::~QuicReadBufferPool() {
+  std::vector<uint8_t*> freeBuffers;
+  {
+    std::lock_guard<std::mutex> guard(state_->mutex);
+    state_->closed = true;
+    freeBuffers.swap(state_->freeBuffers);
+  }
+  for (auto buf : freeBuffers) {
+    destroy(buf);
+  }
+}
+
+QuicReadBufferPool::PooledBuffer QuicReadBufferPool::acquire() {
+  {
+    std::lock_guard<std::mutex> guard(state_->mutex);
+    if (!state_->freeBuffers.empty()) {
+      auto buf = state_->freeBuffers.back();
+      state_->freeBuffers.pop_back();
+      return PooledBuffer(buf);
+    }
+  }
+  auto size = headerSize<State>() + state_->bufferSize;
+  auto raw =
+      static_cast<uint8_t*>(arena_ ? arena_->allocate(size) : nullptr);
+  bool fromArena = raw != nullptr;
+  if (!raw) {
+    raw = static_cast<uint8_t*>(::malloc(size));
+  }
+  if (!raw) {
+    throw std::bad_alloc();
+  }
+  new (raw) BufferHeader<State>{state_, fromArena};
+  return PooledBuffer(raw + headerSize<State>());
+}
+
+std::unique_ptr<folly::IOBuf> QuicReadBufferPool::toIOBuf(
+    PooledBuffer& buf,
+    size_t length) {
+  DCHECK(buf);
+  DCHECK_LE(length, state_->bufferSize);
+  if (length <= copyThreshold_) {
+    return folly::IOBuf::copyBuffer(buf.get(), length);
+  }
+  auto raw = buf.release();
+  return folly::IOBuf::takeOwnership(
+      raw, state_->bufferSize, length, &QuicReadBufferPool::freeIOBuf);
+}
+
+size_t QuicReadBufferPool::bufferSize() const noexcept {
+  return state_->bufferSize;
+}
+
+size_t QuicReadBufferPool::numFreeBuffers() const {
+  std::lock_guard<std::mutex> guard(state_->mutex);
+  return state_->freeBuffers.size();
+}
+
+void QuicReadBufferPool::recycle(uint8_t* buf) noexcept {
+  auto header =
+      reinterpret_cast<BufferHeader<State>*>(buf - headerSize<State>());
+  auto& state = *header->state;
+  {
+    std::lock_guard<std::mutex> guard(state.mutex);
+    if (!state.closed && state.freeBuffers.size() < state.maxFreeBuffers) {
+      state.freeBuffers.push_back(buf);
+      return;
+    }
+  }
+  // Destroy outside of the lock since this may drop the last reference to
+  // the state.
+  destroy(buf);
+}
+
+void QuicReadBufferPool::freeIOBuf(void* buf, void* /* userData */) noexcept {
+  recycle(static_cast<uint8_t*>(buf));
+}
+
+void QuicReadBufferPool::destroy(uint8_t* buf) noexcept {
+  auto raw = buf - headerSize<State>();
+  auto header = reinterpret_cast<BufferHeader<State>*>(raw);
+  bool fromArena = header->fromArena;
+  header->~BufferHeader<State>();
+  if (fromArena) {
+    BufferArena::deallocate(raw);
+  } else {
+    ::free(raw);
+  }
+}
+
+} // namespace quic
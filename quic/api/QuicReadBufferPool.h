@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace quic {
+
+class BufferArena;
+
+/**
+ * Pool of fixed size receive buffers. Reads go into a pooled buffer which is
+ * then either copied into a right sized IOBuf, for small datagrams such as
+ * pure acks, or handed over without copying to an IOBuf that returns the
+ * buffer to the pool once it and all of its clones are freed.
+ *
+ * Buffers can be freed from any thread and may outlive the pool itself.
+ */
+class QuicReadBufferPool {
+ public:
+  struct BufferDeleter {
+    void operator()(uint8_t* buf) const noexcept;
+  };
+  using PooledBuffer = std::unique_ptr<uint8_t, BufferDeleter>;
+
+  /**
+   * bufferSize: size of each pooled buffer.
+   * maxFreeBuffers: maximum number of idle buffers kept for reuse.
+   * copyThreshold: datagrams up to this size are copied out of the pooled
+   * buffer so that long lived data does not pin large buffers.
+   * arena: where the buffers are allocated from, while it has room. The heap
+   * is used otherwise.
+   */
+  QuicReadBufferPool(
+      size_t bufferSize,
+      size_t maxFreeBuffers,
+      size_t copyThreshold,
+      BufferArena* arena = nullptr);
+
+  ~QuicReadBufferPool();
+
+  QuicReadBufferPool(const QuicReadBufferPool&) = delete;
+  QuicReadBufferPool& operator=(const QuicReadBufferPool&) = delete;
+
+  /**
+   * Returns a buffer of bufferSize() bytes, recycled if one is available.
+   */
+  PooledBuffer acquire();
+
+  /**
+   * Turns the first length bytes of a pooled buffer into an IOBuf. If the
+   * data is copied, buf is left untouched so it can be reused for the next
+   * read, otherwise ownership of the buffer moves to the returned IOBuf and
+   * buf is reset.
+   */
+  std::unique_ptr<folly::IOBuf> toIOBuf(PooledBuffer& buf, size_t length);
+
+  size_t bufferSize() const noexcept;
+
+  size_t numFreeBuffers() const;
+
+ private:
+  struct State {
+    State(size_t bufferSizeIn, size_t maxFreeBuffersIn)
+        : bufferSize(bufferSizeIn), maxFreeBuffers(maxFreeBuffersIn) {}
+
+    const size_t bufferSize;
+    const size_t maxFreeBuffers;
+    mutable std::mutex mutex;
+    std::vector<uint8_t*> freeBuffers;
+    bool closed{false};
+  };
+
+  static void recycle(uint8_t* buf) noexcept;
+  static void freeIOBuf(void* buf, void* userData) noexcept;
+  static void destroy(uint8_t* buf) noexcept;
+
+  std::shared_ptr<State> state_;
+  size_t copyThreshold_;
+  BufferArena* arena_;
+};
+
+} // namespace quic
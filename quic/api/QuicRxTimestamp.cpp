@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicRxTimestamp.h>
+
+#include <folly/net/NetOps.h>
+
+#include <cstring>
+
+namespace quic {
+
+bool setSocketRxTimestamps(
+    FOLLY_MAYBE_UNUSED folly::NetworkSocket sock,
+    FOLLY_MAYBE_UNUSED bool enabled) noexcept {
+#ifdef SO_TIMESTAMPNS
+  int val = enabled ? 1 : 0;
+  return folly::netops::setsockopt(
+             sock, SOL_SOCKET, SO_TIMESTAMPNS, &val, sizeof(val)) == 0;
+#else
+  return false;
+#endif
+}
+
+TimePoint getRxTimestamp(
+    FOLLY_MAYBE_UNUSED const struct msghdr& msg,
+    TimePoint receiveTime,
+    FOLLY_MAYBE_UNUSED std::chrono::system_clock::time_point
+        systemReceiveTime) noexcept {
+#ifdef SO_TIMESTAMPNS
+  if (!msg.msg_control) {
+    return receiveTime;
+  }
+  for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&msg), cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPNS) {
+      continue;
+    }
+    struct timespec ts;
+    memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+    auto kernelTime = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::seconds(ts.tv_sec) +
+            std::chrono::nanoseconds(ts.tv_nsec)));
+    // A timestamp in the future or from too long ago means the wall clock
+    // stepped since the datagram arrived.
+    if (kernelTime > systemReceiveTime ||
+        systemReceiveTime - kernelTime > kMaxRxTimestampAge) {
+      return receiveTime;
+    }
+    return receiveTime -
+        std::chrono::duration_cast<Clock::duration>(
+               systemReceiveTime - kernelTime);
+  }
+#endif
+  return receiveTime;
+}
+
+} // namespace quic
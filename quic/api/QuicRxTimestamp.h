@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/net/NetworkSocket.h>
+#include <folly/portability/Sockets.h>
+#include <quic/QuicConstants.h>
+
+#include <chrono>
+
+namespace quic {
+
+// Size of the control buffer needed to receive the kernel timestamp cmsg.
+constexpr size_t kRxTimestampControlSize = 32;
+
+/**
+ * Asks the kernel to stamp received datagrams with the time they arrived on
+ * the socket, with nanosecond resolution. Returns false if the platform or
+ * the kernel does not support it.
+ */
+bool setSocketRxTimestamps(folly::NetworkSocket sock, bool enabled) noexcept;
+
+/**
+ * Returns the time a datagram arrived, as reported by the kernel in the
+ * control messages of a recvmsg call. The kernel reports wall clock time,
+ * which is converted to Clock using receiveTime and systemReceiveTime, the
+ * Clock and system clock times read when the datagram was read. Returns
+ * receiveTime if the message carries no timestamp or if the wall clock
+ * stepped in between.
+ */
+TimePoint getRxTimestamp(
+    const struct msghdr& msg,
+    TimePoint receiveTime,
+    std::chrono::system_clock::time_point systemReceiveTime) noexcept;
+
+} // namespace quic
@@ -10,8 +10,10 @@
 
 #include <folly/Expected.h>
 #include <folly/Optional.h>
+#include <folly/Range.h>
 #include <folly/io/IOBuf.h>
 #include <quic/QuicConstants.h>
+#include <quic/api/QuicStreamWriteSource.h>
 #include <quic/codec/Types.h>
 #include <quic/state/StateData.h>
 
@@ -106,6 +108,35 @@ class QuicSocket {
     uint32_t totalPTOCount;
     PacketNum largestPacketAckedByPeer;
     PacketNum largestPacketSent;
+    // Estimate of the bytes the connection holds in its buffers.
+    uint64_t bufferedBytes;
+    // Pacing rate in bytes per second, 0 when the connection isn't paced.
+    uint64_t pacingRate{0};
+    // Bytes of the outstanding packets, acks only excluded.
+    uint64_t bytesInFlight{0};
+    uint64_t outstandingPackets{0};
+    uint64_t outstandingHandshakePackets{0};
+    uint64_t outstandingClonedPackets{0};
+    // Retransmissions by cause, on top of packetsRetransmitted and
+    // timeoutBasedLoss. Losses detected as spurious by a later ack.
+    uint32_t spuriousLosses{0};
+    uint64_t totalStreamBytesCloned{0};
+    uint64_t totalBytesCloned{0};
+    // Time the peer's connection flow control blocked the writes.
+    std::chrono::microseconds connFlowControlBlockedTime{0us};
+    // Intervals of received packets still to be acked, per space.
+    uint64_t initialAckIntervals{0};
+    uint64_t handshakeAckIntervals{0};
+    uint64_t appDataAckIntervals{0};
+    // Break down of bufferedBytes: received and not read by the app, written
+    // by the app and not sent, and outstanding packets.
+    uint64_t readBufferedBytes{0};
+    uint64_t writeBufferedBytes{0};
+    uint64_t outstandingPacketBytes{0};
+    uint64_t numStreams{0};
+    // Time spent limited by each WriteLimiter, indexed by it.
+    std::array<std::chrono::microseconds, kNumWriteLimiters>
+        writeLimitedTime{};
   };
 
   /**
@@ -121,6 +152,26 @@ class QuicSocket {
 
     // Is the stream head-of-line blocked?
     bool isHolb{false};
+
+    // Bytes received and not yet read by the app
+    uint64_t readBufferedBytes{0};
+
+    // Bytes written and not yet acked, including those kept for
+    // retransmission
+    uint64_t writeBufferedBytes{0};
+
+    // Time the peer's stream flow control blocked the writes.
+    std::chrono::microseconds flowControlBlockedTime{0us};
+
+    // Is the stream blocked by the peer's stream flow control?
+    bool isFlowControlBlocked{false};
+
+    // Gaps opened in the data received, see QuicStreamState::readGapCount.
+    uint32_t readGapCount{0};
+
+    // Most bytes of the stream reassembly held behind a gap, see
+    // QuicStreamState::maxReassemblyBytes.
+    uint64_t maxReassemblyBytes{0};
   };
 
   /**
@@ -388,6 +439,14 @@ class QuicSocket {
         StreamId id,
         std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
             error) noexcept = 0;
+
+    /**
+     * Called instead of readAvailable on streams with push delivery, with the
+     * data received in order and whether it ends the stream. The data is
+     * credited to flow control once this returns.
+     */
+    virtual void onDataPushed(StreamId /* id */, Buf /* data */, bool /* eof */)
+        noexcept {}
   };
 
   /**
@@ -405,6 +464,40 @@ class QuicSocket {
    */
   virtual void unsetAllReadCallbacks() = 0;
 
+  /**
+   * Callback class for receiving data on the streams of a connection that
+   * have no ReadCallback of their own.
+   */
+  class ConnectionReadCallback {
+   public:
+    virtual ~ConnectionReadCallback() = default;
+
+    /**
+     * Called once per read loop with the streams that have data or EOF
+     * available to read. The ids are only valid during the call.
+     */
+    virtual void readAvailable(folly::Range<const StreamId*> ids) noexcept = 0;
+
+    /**
+     * Called from the transport layer when there is an error on one of the
+     * streams. The stream is not reported again.
+     */
+    virtual void readError(
+        StreamId id,
+        std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+            error) noexcept = 0;
+  };
+
+  /**
+   * Set the callback reading all the streams that have no ReadCallback, for
+   * applications with too many streams to register a callback for each.
+   * Streams with a ReadCallback keep using it, and can be paused with it.
+   * It should be set before the streams receive data, the streams that
+   * received data before only get reported once they receive more. Errors
+   * of the connection itself go to the ConnectionCallback only.
+   */
+  virtual void setConnectionReadCallback(ConnectionReadCallback* cb) = 0;
+
   /**
    * Convenience function that sets the read callbacks of all streams to be
    * nullptr.
@@ -438,6 +531,17 @@ class QuicSocket {
   virtual folly::Expected<folly::Unit, LocalErrorCode> resumeRead(
       StreamId id) = 0;
 
+  /**
+   * Enables or disables push delivery on the given stream. With push
+   * delivery, data received in order is handed to the read callback's
+   * onDataPushed right after the packets carrying it are processed, instead
+   * of waiting for the callback to read it. Errors are still reported with
+   * readError, and pauseRead holds the data back as usual.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> setReadPushDelivery(
+      StreamId id,
+      bool enabled) = 0;
+
   /**
    * Initiates sending of a StopSending frame for a given stream to the peer.
    * This is called a "solicited reset". On receipt of the StopSending frame
@@ -464,6 +568,28 @@ class QuicSocket {
       StreamId id,
       size_t maxLen) = 0;
 
+  /**
+   * Zero copy read: returns all the contiguous data available on the stream,
+   * chained as the buffers it was decrypted into, and the EOF marker. Unlike
+   * read(), the bytes are not credited to the peer's flow control until they
+   * are given back with releaseRead(), so that an app forwarding them
+   * elsewhere can hold them until they're written out.
+   *
+   * Bytes that were never released are credited to the connection once the
+   * stream is closed.
+   */
+  virtual folly::Expected<std::pair<Buf, bool>, LocalErrorCode> readZeroCopy(
+      StreamId id) = 0;
+
+  /**
+   * Credits amount bytes returned by readZeroCopy() to the peer's flow
+   * control, in the order they were read. Returns INVALID_OPERATION if the
+   * stream has fewer unreleased bytes than amount.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> releaseRead(
+      StreamId id,
+      size_t amount) = 0;
+
   /**
    * ===== Peek/Consume API =====
    */
@@ -645,6 +771,21 @@ class QuicSocket {
   virtual folly::Expected<StreamId, LocalErrorCode> createUnidirectionalStream(
       bool replaySafe = true) = 0;
 
+  /**
+   * Creates numStreams bidirectional streams at once, e.g. to open all the
+   * streams of a batch of requests, which is cheaper than creating them one
+   * by one. Either all of them are created or none, if the peer's stream
+   * limit doesn't allow for all of them.
+   */
+  virtual folly::Expected<std::vector<StreamId>, LocalErrorCode>
+  createBidirectionalStreams(uint64_t numStreams) = 0;
+
+  /**
+   * Same as createBidirectionalStreams, for unidirectional streams.
+   */
+  virtual folly::Expected<std::vector<StreamId>, LocalErrorCode>
+  createUnidirectionalStreams(uint64_t numStreams) = 0;
+
   /**
    * Returns the number of bidirectional streams that can be opened.
    */
@@ -738,6 +879,34 @@ class QuicSocket {
   virtual folly::Expected<folly::Unit, LocalErrorCode>
   notifyPendingWriteOnStream(StreamId id, WriteCallback* wcb) = 0;
 
+  /**
+   * Bytes that can be written to the connection right now without being held
+   * back: the least of the connection flow control window and the transport
+   * buffer space available, less what is reserved by any stream. This is the
+   * maxToSend of onConnectionWriteReady.
+   */
+  virtual uint64_t getMaxWritableOnConnection() = 0;
+
+  /**
+   * Bytes that can be written to the given stream right now without being
+   * held back, by the stream or connection flow control or the transport
+   * buffer space, including the stream's own reservation. This is the
+   * maxToSend of onStreamWriteReady.
+   */
+  virtual folly::Expected<uint64_t, LocalErrorCode> getMaxWritableOnStream(
+      StreamId id) = 0;
+
+  /**
+   * Reserves up to bytes of what the stream can write right now, so that
+   * writes to other streams can't take it. Returns the number of bytes
+   * reserved, which replace any earlier reservation of the stream; 0 bytes
+   * releases it. Writes to the stream use up its reservation first, and it
+   * is released when the stream closes.
+   */
+  virtual folly::Expected<uint64_t, LocalErrorCode> reserveWriteSpace(
+      StreamId id,
+      uint64_t bytes) = 0;
+
   /**
    * Callback class for receiving ack notifications
    */
@@ -775,6 +944,13 @@ class QuicSocket {
    * If EOF was true or a delivery callback was set they also need to be
    * passed again later.  See notifyPendingWrite to register for a callback.
    *
+   * A deadline is the time by which the data should reach the peer. Data due
+   * within the next srtt is written ahead of other streams, and once the data
+   * can no longer arrive in time, i.e. the deadline is less than srtt/2 away,
+   * it is expired with sendDataExpired semantics instead of being sent. The
+   * expiry needs partial reliability to be negotiated; a missed deadline
+   * expires all the stream data before it as well.
+   *
    * An error code is present if there was an error with the write.
    */
   using WriteResult = folly::Expected<Buf, LocalErrorCode>;
@@ -783,6 +959,47 @@ class QuicSocket {
       Buf data,
       bool eof,
       bool cork,
+      DeliveryCallback* cb = nullptr,
+      folly::Optional<TimePoint> deadline = folly::none) = 0;
+
+  /**
+   * A single write in a batch passed to writeChains.
+   */
+  struct StreamWrite {
+    StreamId id;
+    Buf data;
+    bool eof{false};
+    DeliveryCallback* cb{nullptr};
+  };
+
+  /**
+   * Write data to several streams at once.  Equivalent to calling writeChain
+   * for each of the writes in order, but the write loop is scheduled once for
+   * the whole batch instead of once per write.
+   *
+   * The batch is checked before any of it is written: if one of the writes
+   * would fail, e.g. because its stream is closed or an earlier write in the
+   * batch sent its EOF, nothing is written and the error is returned.  The
+   * data of every write is consumed on success.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> writeChains(
+      folly::Range<StreamWrite*> writes) = 0;
+
+  /**
+   * Write the data of source, then eof if set, to the given stream. The data
+   * is read from the source as the transport sends it, so that only about a
+   * congestion window of it is buffered at any time rather than all of it.
+   * The source is released once all its data is buffered, or when the stream
+   * or the transport closes.
+   *
+   * Other writes to the stream fail with INVALID_OPERATION until then. The
+   * delivery callback, if any, is registered for the end of the source's
+   * data, or its eof.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> writeFromSource(
+      StreamId id,
+      std::unique_ptr<StreamWriteSource> source,
+      bool eof,
       DeliveryCallback* cb = nullptr) = 0;
 
   /**
@@ -794,6 +1011,19 @@ class QuicSocket {
       uint64_t offset,
       DeliveryCallback* cb) = 0;
 
+  /**
+   * Set a callback to be told how far the peer acknowledged the stream,
+   * instead of registering one delivery callback per offset. After ACKs are
+   * processed, onDeliveryAck is invoked at most once with the highest offset
+   * up to which all the stream data, and the EOF, was acknowledged, if it
+   * moved since the last invocation. onCanceled is invoked with the first
+   * offset that wasn't reported as delivered if the stream is reset or the
+   * connection closes. Passing nullptr unsets the callback without invoking
+   * it. Works alongside callbacks registered per offset.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode>
+  setAggregatedDeliveryCallback(StreamId id, DeliveryCallback* cb) = 0;
+
   /**
    * Close the stream for writing.  Equivalent to writeChain(id, nullptr, true).
    */
@@ -843,6 +1073,48 @@ class QuicSocket {
       PingCallback* callback,
       std::chrono::milliseconds pingTimeout) = 0;
 
+  /**
+   * Callback class for received datagrams
+   */
+  class DatagramCallback {
+   public:
+    virtual ~DatagramCallback() = default;
+
+    /**
+     * Notifies that new datagrams can be read with readDatagrams()
+     */
+    virtual void onDatagramsAvailable() noexcept = 0;
+  };
+
+  /**
+   * Set the callback invoked when datagrams are received. Datagrams are only
+   * exchanged when TransportSettings::datagramsEnabled is set on both ends.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> setDatagramCallback(
+      DatagramCallback* cb) = 0;
+
+  /**
+   * The largest datagram that can be written, 0 if the peer does not accept
+   * datagrams.
+   */
+  virtual uint16_t getDatagramSizeLimit() const = 0;
+
+  /**
+   * Queue a datagram for sending. Datagrams are unreliable: they are sent at
+   * most once, are never retransmitted and are not subject to flow control.
+   * Fails with INVALID_WRITE_DATA if the datagram is larger than
+   * getDatagramSizeLimit() or the write buffer is full.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> writeDatagram(
+      Buf buf) = 0;
+
+  /**
+   * Returns up to atMost received datagrams in arrival order, or all of them
+   * if atMost is 0.
+   */
+  virtual folly::Expected<std::vector<Buf>, LocalErrorCode> readDatagrams(
+      size_t atMost = 0) = 0;
+
   /**
    * Get information on the state of the quic connection. Should only be used
    * for logging.
@@ -883,5 +1155,39 @@ class QuicSocket {
    * createStream() or receiving onNewBidirectionalStream()
    */
   virtual folly::Optional<LocalErrorCode> setControlStream(StreamId id) = 0;
+
+  /**
+   * Set the priority of a stream. Data of streams with a lower urgency, in
+   * [0, kMaxPriorityUrgency], is always sent before data of streams with a
+   * higher one. Within the same urgency incremental streams are interleaved
+   * packet by packet, while non-incremental ones are sent one after another
+   * in stream id order. Streams start with urgency kDefaultPriorityUrgency
+   * and are not incremental.
+   */
+  virtual folly::Optional<LocalErrorCode>
+  setStreamPriority(StreamId id, uint8_t urgency, bool incremental) = 0;
+
+  /**
+   * Set the weight of a stream for weighted fair queueing, see
+   * TransportSettings::streamSchedulingMode. Each turn a stream sends up to
+   * its weight times a packet worth of bytes, so streams of the same urgency
+   * share the bandwidth in proportion to their weights. The weight has to be
+   * at least 1, streams start with kDefaultStreamWeight.
+   */
+  virtual folly::Optional<LocalErrorCode> setStreamWeight(
+      StreamId id,
+      uint16_t weight) = 0;
+
+  /**
+   * Cap the rate the stream sends new data at, in bytes per second, 0 for no
+   * cap. Data over the rate stays in the stream's write buffer, and the
+   * stream is scheduled again once the rate lets it send, without the write
+   * looper running for it meanwhile. The stream can send a pacing tick worth
+   * of its rate at once, and at least a packet. Retransmissions are not
+   * limited.
+   */
+  virtual folly::Optional<LocalErrorCode> setStreamSendRate(
+      StreamId id,
+      uint64_t bytesPerSecond) = 0;
 };
 } // namespace quic
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicSocketCoro.h>
+
+#if FOLLY_HAS_COROUTINES
+
+#include <folly/io/IOBufQueue.h>
+
+#include <utility>
+
+namespace quic {
+
+void QuicCoroSocket::Waiter::wake() {
+  auto waiting = std::exchange(handle, nullptr);
+  if (waiting) {
+    waiting.resume();
+  } else {
+    signaled = true;
+  }
+}
+
+QuicCoroSocket::QuicCoroSocket(std::shared_ptr<QuicSocket> sock)
+    : sock_(std::move(sock)) {
+  sock_->setConnectionCallback(this);
+}
+
+QuicCoroSocket::~QuicCoroSocket() {
+  // Closing cancels the stream callbacks, which fail the waiting coroutines.
+  sock_->closeNow(folly::none);
+  wakeAll(LocalErrorCode::SHUTTING_DOWN);
+}
+
+folly::coro::Task<QuicCoroSocket::Result<StreamId>> QuicCoroSocket::accept() {
+  while (newStreams_.empty()) {
+    if (connectionError_) {
+      co_return folly::makeUnexpected(*connectionError_);
+    }
+    co_await WaitAwaitable(acceptWaiter_);
+  }
+  auto id = newStreams_.front();
+  newStreams_.pop_front();
+  co_return id;
+}
+
+folly::coro::Task<QuicCoroSocket::Result<std::pair<Buf, bool>>>
+QuicCoroSocket::read(StreamId id, size_t maxLen) {
+  while (true) {
+    auto result = sock_->read(id, maxLen);
+    if (result.hasError()) {
+      co_return folly::makeUnexpected(QuicErrorCode(result.error()));
+    }
+    if (result->first || result->second) {
+      co_return std::move(result.value());
+    }
+    auto& waiters = getStreamWaiters(id);
+    if (waiters.read.error) {
+      co_return folly::makeUnexpected(*waiters.read.error);
+    }
+    if (!waiters.readCallbackSet) {
+      auto set = sock_->setReadCallback(id, this);
+      if (set.hasError()) {
+        co_return folly::makeUnexpected(QuicErrorCode(set.error()));
+      }
+      waiters.readCallbackSet = true;
+    } else {
+      sock_->resumeRead(id);
+    }
+    co_await WaitAwaitable(waiters.read);
+  }
+}
+
+folly::coro::Task<QuicCoroSocket::Result<folly::Unit>>
+QuicCoroSocket::write(StreamId id, Buf data, bool eof) {
+  folly::IOBufQueue pending{folly::IOBufQueue::cacheChainLength()};
+  pending.append(std::move(data));
+  while (!pending.empty()) {
+    auto& waiters = getStreamWaiters(id);
+    auto notify = sock_->notifyPendingWriteOnStream(id, this);
+    if (notify.hasError()) {
+      co_return folly::makeUnexpected(QuicErrorCode(notify.error()));
+    }
+    co_await WaitAwaitable(waiters.write);
+    if (waiters.write.error) {
+      co_return folly::makeUnexpected(*waiters.write.error);
+    }
+    auto maxToSend = waiters.write.value;
+    if (maxToSend == 0) {
+      continue;
+    }
+    bool last = pending.chainLength() <= maxToSend;
+    auto piece = last ? pending.move() : pending.split(maxToSend);
+    auto result = sock_->writeChain(id, std::move(piece), last && eof, false);
+    if (result.hasError()) {
+      co_return folly::makeUnexpected(QuicErrorCode(result.error()));
+    }
+    if (last) {
+      waiters.eofWritten = eof;
+      co_return folly::unit;
+    }
+  }
+  if (eof) {
+    // Only the EOF is left, which flow control doesn't hold back.
+    auto result = sock_->writeChain(id, nullptr, true, false);
+    if (result.hasError()) {
+      co_return folly::makeUnexpected(QuicErrorCode(result.error()));
+    }
+    getStreamWaiters(id).eofWritten = true;
+  }
+  co_return folly::unit;
+}
+
+folly::coro::Task<QuicCoroSocket::Result<folly::Unit>>
+QuicCoroSocket::waitForDelivery(StreamId id) {
+  auto writeOffset = sock_->getStreamWriteOffset(id);
+  if (writeOffset.hasError()) {
+    co_return folly::makeUnexpected(QuicErrorCode(writeOffset.error()));
+  }
+  auto buffered = sock_->getStreamWriteBufferedBytes(id);
+  if (buffered.hasError()) {
+    co_return folly::makeUnexpected(QuicErrorCode(buffered.error()));
+  }
+  auto& waiters = getStreamWaiters(id);
+  // The EOF takes up the offset right after the data.
+  uint64_t end = *writeOffset + *buffered;
+  if (!waiters.eofWritten) {
+    if (end == 0) {
+      co_return folly::unit;
+    }
+    end--;
+  }
+  auto registered = sock_->registerDeliveryCallback(id, end, this);
+  if (registered.hasError()) {
+    co_return folly::makeUnexpected(QuicErrorCode(registered.error()));
+  }
+  co_await WaitAwaitable(waiters.delivery);
+  if (waiters.delivery.error) {
+    co_return folly::makeUnexpected(*waiters.delivery.error);
+  }
+  co_return folly::unit;
+}
+
+void QuicCoroSocket::onNewBidirectionalStream(StreamId id) noexcept {
+  onNewStream(id);
+}
+
+void QuicCoroSocket::onNewUnidirectionalStream(StreamId id) noexcept {
+  onNewStream(id);
+}
+
+void QuicCoroSocket::onStopSending(
+    StreamId id,
+    ApplicationErrorCode error) noexcept {
+  VLOG(4) << "StopSending on stream=" << id << " error=" << error;
+}
+
+void QuicCoroSocket::onConnectionEnd() noexcept {
+  wakeAll(LocalErrorCode::NO_ERROR);
+}
+
+void QuicCoroSocket::onConnectionError(
+    std::pair<QuicErrorCode, std::string> error) noexcept {
+  wakeAll(error.first);
+}
+
+QuicCoroSocket::StreamWaiters& QuicCoroSocket::getStreamWaiters(StreamId id) {
+  return streams_[id];
+}
+
+void QuicCoroSocket::onNewStream(StreamId id) {
+  newStreams_.push_back(id);
+  acceptWaiter_.wake();
+}
+
+void QuicCoroSocket::wakeAll(QuicErrorCode error) {
+  if (!connectionError_) {
+    connectionError_ = error;
+  }
+  acceptWaiter_.wake();
+  // A resumed coroutine may add streams.
+  std::vector<StreamId> ids;
+  for (const auto& stream : streams_) {
+    ids.push_back(stream.first);
+  }
+  for (auto id : ids) {
+    auto it = streams_.find(id);
+    if (it == streams_.end()) {
+      continue;
+    }
+    auto& waiters = it->second;
+    for (auto waiter : {&waiters.read, &waiters.write, &waiters.delivery}) {
+      if (waiter->handle) {
+        waiter->error = error;
+        waiter->wake();
+      }
+    }
+  }
+}
+
+void QuicCoroSocket::readAvailable(StreamId id) noexcept {
+  auto& waiter = getStreamWaiters(id).read;
+  if (!waiter.handle) {
+    // Nobody reads the stream right now, stop the read looper from calling
+    // back until somebody does.
+    sock_->pauseRead(id);
+    return;
+  }
+  waiter.wake();
+}
+
+void QuicCoroSocket::readError(
+    StreamId id,
+    std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+        error) noexcept {
+  auto& waiter = getStreamWaiters(id).read;
+  waiter.error = error.first;
+  waiter.wake();
+}
+
+void QuicCoroSocket::onStreamWriteReady(
+    StreamId id,
+    uint64_t maxToSend) noexcept {
+  auto& waiter = getStreamWaiters(id).write;
+  waiter.value = maxToSend;
+  waiter.wake();
+}
+
+void QuicCoroSocket::onStreamWriteError(
+    StreamId id,
+    std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+        error) noexcept {
+  auto& waiter = getStreamWaiters(id).write;
+  waiter.error = error.first;
+  waiter.wake();
+}
+
+void QuicCoroSocket::onDeliveryAck(
+    StreamId id,
+    uint64_t /* offset */,
+    std::chrono::microseconds /* rtt */) {
+  getStreamWaiters(id).delivery.wake();
+}
+
+void QuicCoroSocket::onCanceled(StreamId id, uint64_t /* offset */) {
+  auto& waiter = getStreamWaiters(id).delivery;
+  waiter.error = LocalErrorCode::CONNECTION_ABANDONED;
+  waiter.wake();
+}
+
+} // namespace quic
+
+#endif // FOLLY_HAS_COROUTINES
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Portability.h>
+
+#if FOLLY_HAS_COROUTINES
+
+#include <folly/Expected.h>
+#include <folly/experimental/coro/Task.h>
+#include <quic/api/QuicSocket.h>
+
+#include <deque>
+#include <experimental/coroutine>
+#include <memory>
+#include <unordered_map>
+
+namespace quic {
+
+/**
+ * folly::coro interface over a QuicSocket, so that a request handler can be
+ * written as a coroutine instead of a state machine driven by the socket's
+ * callbacks.
+ *
+ * It becomes the connection callback of the socket and owns the socket,
+ * which it closes when destroyed. At most one coroutine may wait for each
+ * kind of event on a stream at a time: one read, one write and one delivery.
+ *
+ * A suspended coroutine is resumed right from the transport callback that
+ * completes its wait, i.e. from the read and write loopers, rather than
+ * being rescheduled on the event base. The coroutines must therefore run on
+ * the event base of the socket, e.g. by scheduling them on it.
+ */
+class QuicCoroSocket : public QuicSocket::ConnectionCallback,
+                       private QuicSocket::ReadCallback,
+                       private QuicSocket::WriteCallback,
+                       private QuicSocket::DeliveryCallback {
+ public:
+  template <class T>
+  using Result = folly::Expected<T, QuicErrorCode>;
+
+  explicit QuicCoroSocket(std::shared_ptr<QuicSocket> sock);
+
+  ~QuicCoroSocket() override;
+
+  QuicSocket& getSocket() const {
+    return *sock_;
+  }
+
+  /**
+   * Waits for the next stream opened by the peer. Fails once the connection
+   * ended.
+   */
+  folly::coro::Task<Result<StreamId>> accept();
+
+  /**
+   * Waits until there is data or EOF on the stream, then reads up to maxLen
+   * bytes of it, 0 meaning all of it. Returns the data and the EOF marker,
+   * like QuicSocket::read.
+   */
+  folly::coro::Task<Result<std::pair<Buf, bool>>> read(
+      StreamId id,
+      size_t maxLen = 0);
+
+  /**
+   * Writes data, then eof if set, to the stream, in as many pieces as flow
+   * control and the send buffer let the transport take at a time. Completes
+   * once the transport took all of it.
+   */
+  folly::coro::Task<Result<folly::Unit>> write(
+      StreamId id,
+      Buf data,
+      bool eof);
+
+  /**
+   * Waits until the peer acknowledged everything written to the stream so
+   * far, including its EOF if it was written.
+   */
+  folly::coro::Task<Result<folly::Unit>> waitForDelivery(StreamId id);
+
+  // ConnectionCallback
+  void onNewBidirectionalStream(StreamId id) noexcept override;
+  void onNewUnidirectionalStream(StreamId id) noexcept override;
+  void onStopSending(StreamId id, ApplicationErrorCode error) noexcept
+      override;
+  void onConnectionEnd() noexcept override;
+  void onConnectionError(
+      std::pair<QuicErrorCode, std::string> error) noexcept override;
+
+ private:
+  // What a suspended coroutine waits for.
+  struct Waiter {
+    std::experimental::coroutine_handle<> handle;
+    // Set if the event came before the coroutine suspended.
+    bool signaled{false};
+    folly::Optional<QuicErrorCode> error;
+    // maxToSend for writes.
+    uint64_t value{0};
+
+    void wake();
+  };
+
+  class WaitAwaitable {
+   public:
+    explicit WaitAwaitable(Waiter& waiter) : waiter_(&waiter) {}
+
+    bool await_ready() const noexcept {
+      return waiter_->signaled;
+    }
+
+    void await_suspend(std::experimental::coroutine_handle<> handle) noexcept {
+      waiter_->handle = handle;
+    }
+
+    void await_resume() noexcept {
+      waiter_->signaled = false;
+    }
+
+    // The waiter is resumed on the event base the coroutine already runs
+    // on, so Task doesn't need to go through its executor.
+    friend WaitAwaitable co_viaIfAsync(
+        folly::Executor::KeepAlive<>,
+        WaitAwaitable&& awaitable) noexcept {
+      return std::move(awaitable);
+    }
+
+   private:
+    Waiter* waiter_;
+  };
+
+  struct StreamWaiters {
+    Waiter read;
+    Waiter write;
+    Waiter delivery;
+    bool readCallbackSet{false};
+    bool eofWritten{false};
+  };
+
+  StreamWaiters& getStreamWaiters(StreamId id);
+
+  void onNewStream(StreamId id);
+
+  // Fails every waiting coroutine with error.
+  void wakeAll(QuicErrorCode error);
+
+  // ReadCallback
+  void readAvailable(StreamId id) noexcept override;
+  void readError(
+      StreamId id,
+      std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override;
+
+  // WriteCallback
+  void onStreamWriteReady(StreamId id, uint64_t maxToSend) noexcept override;
+  void onStreamWriteError(
+      StreamId id,
+      std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override;
+
+  // DeliveryCallback
+  void onDeliveryAck(
+      StreamId id,
+      uint64_t offset,
+      std::chrono::microseconds rtt) override;
+  void onCanceled(StreamId id, uint64_t offset) override;
+
+  std::shared_ptr<QuicSocket> sock_;
+  std::deque<StreamId> newStreams_;
+  Waiter acceptWaiter_;
+  folly::Optional<QuicErrorCode> connectionError_;
+  std::unordered_map<StreamId, StreamWaiters> streams_;
+};
+
+} // namespace quic
+
+#endif // FOLLY_HAS_COROUTINES
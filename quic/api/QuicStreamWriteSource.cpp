@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicStreamWriteSource.h>
+
+namespace quic {
+
+MmapStreamWriteSource::MmapStreamWriteSource(folly::File file)
+    : mapping_(std::make_shared<folly::MemoryMapping>(std::move(file))) {}
+
+uint64_t MmapStreamWriteSource::length() const {
+  return mapping_->range().size();
+}
+
+std::unique_ptr<folly::IOBuf> MmapStreamWriteSource::read(
+    uint64_t offset,
+    uint64_t len) {
+  auto range = mapping_->range().subpiece(offset, len);
+  auto buf = folly::IOBuf::takeOwnership(
+      const_cast<uint8_t*>(range.data()),
+      range.size(),
+      [](void*, void* userData) {
+        delete static_cast<std::shared_ptr<folly::MemoryMapping>*>(userData);
+      },
+      new std::shared_ptr<folly::MemoryMapping>(mapping_));
+  // The mapping is read only.
+  buf->markExternallySharedOne();
+  return buf;
+}
+
+CallbackStreamWriteSource::CallbackStreamWriteSource(
+    uint64_t length,
+    ReadFn readFn)
+    : length_(length), readFn_(std::move(readFn)) {}
+
+uint64_t CallbackStreamWriteSource::length() const {
+  return length_;
+}
+
+std::unique_ptr<folly::IOBuf> CallbackStreamWriteSource::read(
+    uint64_t offset,
+    uint64_t len) {
+  return readFn_(offset, len);
+}
+
+} // namespace quic
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/File.h>
+#include <folly/Function.h>
+#include <folly/io/IOBuf.h>
+#include <folly/system/MemoryMapping.h>
+
+#include <memory>
+
+namespace quic {
+
+/**
+ * Data a stream writes lazily, see QuicSocket::writeFromSource. The transport
+ * only pulls from the source what it is about to send, about a congestion
+ * window's worth at a time, instead of buffering the whole object.
+ */
+class StreamWriteSource {
+ public:
+  virtual ~StreamWriteSource() = default;
+
+  // Number of bytes the source writes to the stream.
+  virtual uint64_t length() const = 0;
+
+  /**
+   * Returns the len bytes at offset of the source. Called on the event base
+   * of the transport, with offsets increasing and never past length().
+   */
+  virtual std::unique_ptr<folly::IOBuf> read(uint64_t offset, uint64_t len) = 0;
+};
+
+/**
+ * A file mapped in memory. The buffers it returns reference the mapping
+ * rather than copies of it, and keep it alive until they are released.
+ */
+class MmapStreamWriteSource : public StreamWriteSource {
+ public:
+  explicit MmapStreamWriteSource(folly::File file);
+
+  uint64_t length() const override;
+
+  std::unique_ptr<folly::IOBuf> read(uint64_t offset, uint64_t len) override;
+
+ private:
+  std::shared_ptr<folly::MemoryMapping> mapping_;
+};
+
+/**
+ * Data provided by the app through a callback, e.g. to read from a cache.
+ */
+class CallbackStreamWriteSource : public StreamWriteSource {
+ public:
+  using ReadFn =
+      folly::Function<std::unique_ptr<folly::IOBuf>(uint64_t, uint64_t)>;
+
+  CallbackStreamWriteSource(uint64_t length, ReadFn readFn);
+
+  uint64_t length() const override;
+
+  std::unique_ptr<folly::IOBuf> read(uint64_t offset, uint64_t len) override;
+
+ private:
+  uint64_t length_;
+  ReadFn readFn_;
+};
+
+} // namespace quic
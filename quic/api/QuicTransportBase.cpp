@@ -8,12 +8,16 @@
 
 #include <quic/api/QuicTransportBase.h>
 
+#include <folly/Indestructible.h>
 #include <folly/ScopeGuard.h>
+#include <folly/io/async/EventBaseLocal.h>
 #include <quic/api/LoopDetectorCallback.h>
 #include <quic/api/QuicTransportFunctions.h>
 #include <quic/common/TimeUtil.h>
+#include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/logging/QLoggerConstants.h>
 #include <quic/loss/QuicLossFunctions.h>
+#include <quic/state/AckHandlers.h>
 #include <quic/state/QuicPacingFunctions.h>
 #include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
@@ -21,6 +25,29 @@
 #include <quic/state/SimpleFrameFunctions.h>
 #include <quic/state/stream/StreamStateMachine.h>
 
+#include <unordered_set>
+
+namespace {
+// Number of transports with data to write on each EventBase.
+folly::EventBaseLocal<uint64_t>& activeWriters() {
+  static folly::Indestructible<folly::EventBaseLocal<uint64_t>> writers;
+  return *writers;
+}
+
+// Snapshot of streams, starting from the first one at or after from and
+// wrapping around.
+std::vector<quic::StreamId> streamsFrom(
+    const std::set<quic::StreamId>& streams,
+    quic::StreamId from) {
+  std::vector<quic::StreamId> snapshot;
+  snapshot.reserve(streams.size());
+  auto start = streams.lower_bound(from);
+  snapshot.insert(snapshot.end(), start, streams.end());
+  snapshot.insert(snapshot.end(), streams.begin(), start);
+  return snapshot;
+}
+} // namespace
+
 namespace quic {
 
 QuicTransportBase::QuicTransportBase(
@@ -32,6 +59,8 @@ QuicTransportBase::QuicTransportBase(
       ackTimeout_(this),
       pathValidationTimeout_(this),
       idleTimeout_(this),
+      keepaliveTimeout_(this),
+      streamSendRateTimeout_(this),
       drainTimeout_(this),
       readLooper_(new FunctionLooper(
           evb,
@@ -47,7 +76,11 @@ QuicTransportBase::QuicTransportBase(
           LooperType::WriteLooper)) {
   writeLooper_->setPacingFunction([this]() -> auto {
     if (isConnectionPaced(*conn_)) {
-      conn_->congestionController->markPacerTimeoutScheduled(Clock::now());
+      if (conn_->pacer) {
+        return conn_->pacer->getTimeUntilNextWrite(loopClockNow(*conn_));
+      }
+      conn_->congestionController->markPacerTimeoutScheduled(
+          loopClockNow(*conn_));
       return conn_->congestionController->getPacingInterval();
     }
     return 0us;
@@ -62,6 +95,42 @@ void QuicTransportBase::setPacingTimer(
       conn_->congestionController->setMinimalPacingInterval(
           writeLooper_->getTimerTickInterval().value());
     }
+    if (conn_->pacer) {
+      conn_->pacer->setMinimalInterval(
+          writeLooper_->getTimerTickInterval().value());
+    }
+  }
+}
+
+void QuicTransportBase::setLoopClock(LoopClock* loopClock) noexcept {
+  conn_->loopClock = loopClock;
+}
+
+void QuicTransportBase::setBufferArena(BufferArena* arena) noexcept {
+  conn_->bufferArena = arena;
+}
+
+void QuicTransportBase::setPacingTimerWheel(
+    PacingTimerWheel* pacingTimerWheel) noexcept {
+  writeLooper_->setPacingTimerWheel(pacingTimerWheel);
+  auto tickInterval = writeLooper_->getTimerTickInterval();
+  if (conn_->congestionController && tickInterval) {
+    conn_->congestionController->setMinimalPacingInterval(*tickInterval);
+  }
+  if (conn_->pacer && tickInterval) {
+    conn_->pacer->setMinimalInterval(*tickInterval);
+  }
+}
+
+void QuicTransportBase::setWriteScheduler(
+    QuicWriteScheduler* writeScheduler) noexcept {
+  bool wasScheduled = writeScheduler_ && writeScheduler_->isScheduled(*this);
+  if (wasScheduled) {
+    writeScheduler_->unschedule(*this);
+  }
+  writeScheduler_ = writeScheduler;
+  if (wasScheduled) {
+    updateWriteLooper(false);
   }
 }
 
@@ -69,6 +138,9 @@ void QuicTransportBase::setCongestionControllerFactory(
     std::shared_ptr<CongestionControllerFactory> ccFactory) {
   CHECK(ccFactory);
   ccFactory_ = ccFactory;
+  if (conn_) {
+    conn_->congestionControllerFactory = ccFactory_;
+  }
 }
 
 folly::EventBase* QuicTransportBase::getEventBase() const {
@@ -125,6 +197,32 @@ QuicTransportBase::~QuicTransportBase() {
   }
 }
 
+QuicTransportBase::LoopTimeGuard::LoopTimeGuard(QuicTransportBase& transport)
+    : transport_(transport) {
+  auto sampleRate = transport_.conn_->transportSettings.loopTimeSampleRate;
+  if (sampleRate == 0 || transport_.inLoopCallback_) {
+    return;
+  }
+  outermost_ = true;
+  transport_.inLoopCallback_ = true;
+  if (transport_.conn_->loopTime.callbacks++ % sampleRate == 0) {
+    start_ = Clock::now();
+  }
+}
+
+QuicTransportBase::LoopTimeGuard::~LoopTimeGuard() {
+  if (!outermost_) {
+    return;
+  }
+  transport_.inLoopCallback_ = false;
+  if (start_) {
+    transport_.conn_->loopTime.estimated +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - *start_) *
+        transport_.conn_->transportSettings.loopTimeSampleRate;
+  }
+}
+
 bool QuicTransportBase::good() const {
   return hasWriteCipher() && !error();
 }
@@ -252,6 +350,19 @@ void QuicTransportBase::closeImpl(
         totalCryptoDataRecvd);
   }
 
+  if (conn_->infoCallback) {
+    if (conn_->lossState.mrtt != std::chrono::microseconds::max()) {
+      conn_->infoCallback->onConnectionRtt(
+          conn_->lossState.srtt, conn_->lossState.mrtt);
+    }
+    conn_->infoCallback->onConnectionLatencies(conn_->latencies);
+    auto writeLimitedTime = getWriteLimitedTime(*conn_, Clock::now());
+    for (size_t i = 0; i < kNumWriteLimiters; ++i) {
+      conn_->infoCallback->onWriteLimitedTime(
+          static_cast<WriteLimiter>(i), writeLimitedTime[i]);
+    }
+  }
+
   // TODO: truncate the error code string to be 1MSS only.
   closeState_ = CloseState::CLOSED;
   updatePacingOnClose(*conn_);
@@ -265,11 +376,13 @@ void QuicTransportBase::closeImpl(
   }
   bool isReset = false;
   bool isAbandon = false;
+  bool isShutdown = false;
   folly::variant_match(
       cancelCode.first,
       [&](const LocalErrorCode& err) {
         isReset = err == LocalErrorCode::CONNECTION_RESET;
         isAbandon = err == LocalErrorCode::CONNECTION_ABANDONED;
+        isShutdown = err == LocalErrorCode::SHUTTING_DOWN;
       },
       [](const auto&) {});
   VLOG_IF(4, isReset) << "Closing transport due to stateless reset " << *this;
@@ -320,10 +433,21 @@ void QuicTransportBase::closeImpl(
   if (idleTimeout_.isScheduled()) {
     idleTimeout_.cancelTimeout();
   }
+  if (keepaliveTimeout_.isScheduled()) {
+    keepaliveTimeout_.cancelTimeout();
+  }
+  if (streamSendRateTimeout_.isScheduled()) {
+    streamSendRateTimeout_.cancelTimeout();
+  }
   VLOG(10) << "Stopping read looper due to immediate close " << *this;
   readLooper_->stop();
   peekLooper_->stop();
   writeLooper_->stop();
+  if (writeScheduler_) {
+    writeScheduler_->unschedule(*this);
+    writeScheduler_ = nullptr;
+  }
+  setActiveWriter(false);
 
   // TODO: invoke connection close callbacks.
   cancelAllAppCallbacks(cancelCode);
@@ -348,19 +472,19 @@ void QuicTransportBase::closeImpl(
   conn_->ackStates.handshakeAckState.acks.clear();
   conn_->ackStates.appDataAckState.acks.clear();
 
+  bool noError = folly::variant_match(
+      cancelCode.first,
+      [](const LocalErrorCode& err) {
+        return err == LocalErrorCode::NO_ERROR ||
+            err == LocalErrorCode::IDLE_TIMEOUT;
+      },
+      [](const TransportErrorCode& err) {
+        return err == TransportErrorCode::NO_ERROR;
+      },
+      [](const auto&) { return false; });
   // connCallback_ could be null if start() was never invoked and the
   // transport was destroyed or if the app initiated close.
   if (connCallback_) {
-    bool noError = folly::variant_match(
-        cancelCode.first,
-        [](const LocalErrorCode& err) {
-          return err == LocalErrorCode::NO_ERROR ||
-              err == LocalErrorCode::IDLE_TIMEOUT;
-        },
-        [](const TransportErrorCode& err) {
-          return err == TransportErrorCode::NO_ERROR;
-        },
-        [](const auto&) { return false; });
     if (noError) {
       connCallback_->onConnectionEnd();
     } else {
@@ -390,14 +514,17 @@ void QuicTransportBase::closeImpl(
       LOG(ERROR) << "close threw exception " << ex.what() << " " << *this;
     }
   }
+  if (!noError && !isShutdown) {
+    // Last, so that the capture ends with the close sent, if any.
+    triggerPacketCapture(PacketCaptureTrigger::AbnormalClose);
+  }
   drainConnection = drainConnection && !isReset && !isAbandon;
-  if (drainConnection) {
+  auto drainTimeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+      kDrainFactor * calculatePTO(*conn_));
+  if (drainConnection && !handOffDrain(drainTimeout)) {
     // We ever drain once, and the object ever gets created once.
     DCHECK(!drainTimeout_.isScheduled());
-    getEventBase()->timer().scheduleTimeout(
-        &drainTimeout_,
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            kDrainFactor * calculatePTO(*conn_)));
+    getEventBase()->timer().scheduleTimeout(&drainTimeout_, drainTimeout);
   } else {
     drainTimeoutExpired();
   }
@@ -484,12 +611,17 @@ QuicSocket::TransportInfo QuicTransportBase::getTransportInfo() const {
   if (conn_->congestionController) {
     writableBytes = conn_->congestionController->getWritableBytes();
     congestionWindow = conn_->congestionController->getCongestionWindow();
-    // Do not collect pacing stats for Cubic, since getPacingRate() call
-    // modifies some internal state. TODO(yangchi): Remove this check after
-    // changing Cubic implementation.
-    if (conn_->congestionController->type() != CongestionControlType::Cubic &&
+    if (conn_->pacer && isConnectionPaced(*conn_)) {
+      burstSize = conn_->pacer->getPacingBurstSize();
+      pacingInterval = conn_->pacer->getPacingInterval();
+    } else if (
+        // Do not collect pacing stats for Cubic, since getPacingRate() call
+        // modifies some internal state. TODO(yangchi): Remove this check
+        // after changing Cubic implementation.
+        conn_->congestionController->type() != CongestionControlType::Cubic &&
         isConnectionPaced(*conn_)) {
-      burstSize = conn_->congestionController->getPacingRate(Clock::now());
+      burstSize =
+          conn_->congestionController->getPacingRate(loopClockNow(*conn_));
       pacingInterval = conn_->congestionController->getPacingInterval();
     }
   }
@@ -515,6 +647,44 @@ QuicSocket::TransportInfo QuicTransportBase::getTransportInfo() const {
   transportInfo.largestPacketAckedByPeer =
       conn_->ackStates.appDataAckState.largestAckedByPeer;
   transportInfo.largestPacketSent = conn_->lossState.largestSent;
+  transportInfo.bufferedBytes = getConnectionBufferedBytes(*conn_);
+  if (pacingInterval.count() > 0 && conn_->pacer &&
+      isConnectionPaced(*conn_)) {
+    transportInfo.pacingRate = burstSize * conn_->udpSendPacketLen *
+        std::chrono::microseconds::period::den /
+        pacingInterval.count();
+  }
+  for (const auto& packet : conn_->outstandingPackets) {
+    if (!packet.pureAck) {
+      transportInfo.bytesInFlight += packet.encodedSize;
+    }
+  }
+  transportInfo.outstandingPackets = conn_->outstandingPackets.size();
+  transportInfo.outstandingHandshakePackets =
+      conn_->outstandingHandshakePacketsCount;
+  transportInfo.outstandingClonedPackets =
+      conn_->outstandingClonedPacketsCount;
+  transportInfo.spuriousLosses = conn_->lossState.spuriousLossCount;
+  transportInfo.totalStreamBytesCloned =
+      conn_->lossState.totalStreamBytesCloned;
+  transportInfo.totalBytesCloned = conn_->lossState.totalBytesCloned;
+  transportInfo.connFlowControlBlockedTime =
+      getConnFlowControlBlockedTime(*conn_, Clock::now());
+  transportInfo.initialAckIntervals =
+      conn_->ackStates.initialAckState.acks.size();
+  transportInfo.handshakeAckIntervals =
+      conn_->ackStates.handshakeAckState.acks.size();
+  transportInfo.appDataAckIntervals =
+      conn_->ackStates.appDataAckState.acks.size();
+  transportInfo.readBufferedBytes =
+      conn_->flowControlState.sumMaxObservedOffset -
+      conn_->flowControlState.sumCurReadOffset;
+  transportInfo.writeBufferedBytes =
+      conn_->flowControlState.sumCurStreamBufferLen;
+  transportInfo.outstandingPacketBytes =
+      conn_->outstandingPackets.size() * conn_->udpSendPacketLen;
+  transportInfo.numStreams = conn_->streamManager->streams().size();
+  transportInfo.writeLimitedTime = getWriteLimitedTime(*conn_, Clock::now());
   return transportInfo;
 }
 
@@ -572,7 +742,7 @@ QuicTransportBase::setConnectionFlowControlWindow(uint64_t windowSize) {
     return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
   }
   conn_->flowControlState.windowSize = windowSize;
-  maybeSendConnWindowUpdate(*conn_, Clock::now());
+  maybeSendConnWindowUpdate(*conn_, loopClockNow(*conn_));
   updateWriteLooper(true);
   return folly::unit;
 }
@@ -592,7 +762,7 @@ QuicTransportBase::setStreamFlowControlWindow(
     return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
   }
   stream->flowControlState.windowSize = windowSize;
-  maybeSendStreamWindowUpdate(*stream, Clock::now());
+  maybeSendStreamWindowUpdate(*stream, loopClockNow(*conn_));
   updateWriteLooper(true);
   return folly::unit;
 }
@@ -618,6 +788,13 @@ void QuicTransportBase::unsetAllReadCallbacks() {
   }
 }
 
+void QuicTransportBase::setConnectionReadCallback(
+    ConnectionReadCallback* cb) {
+  VLOG(4) << "Setting connection read callback=" << cb << " " << *this;
+  connReadCallback_ = closeState_ == CloseState::OPEN ? cb : nullptr;
+  updateReadLooper();
+}
+
 void QuicTransportBase::unsetAllPeekCallbacks() {
   for (auto& streamCallbackPair : peekCallbacks_) {
     setPeekCallbackInternal(streamCallbackPair.first, nullptr);
@@ -629,6 +806,10 @@ void QuicTransportBase::unsetAllDeliveryCallbacks() {
   for (auto& streamCallbackPair : deliveryCallbacksCopy) {
     cancelDeliveryCallbacksForStream(streamCallbackPair.first);
   }
+  auto aggregatedDeliveryCallbacksCopy = aggregatedDeliveryCallbacks_;
+  for (auto& streamCallbackPair : aggregatedDeliveryCallbacksCopy) {
+    cancelDeliveryCallbacksForStream(streamCallbackPair.first);
+  }
 }
 
 folly::Expected<folly::Unit, LocalErrorCode>
@@ -710,18 +891,97 @@ QuicTransportBase::pauseOrResumeRead(StreamId id, bool resume) {
   return folly::unit;
 }
 
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setReadPushDelivery(StreamId id, bool enabled) {
+  VLOG(4) << __func__ << " " << *this << " stream=" << id
+          << " enabled=" << enabled;
+  if (isSendingStream(conn_->nodeType, id)) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  auto readCb = readCallbacks_.find(id);
+  if (readCb == readCallbacks_.end()) {
+    return folly::makeUnexpected(LocalErrorCode::APP_ERROR);
+  }
+  readCb->second.pushDelivery = enabled;
+  return folly::unit;
+}
+
+void QuicTransportBase::pushReadData(StreamId id, ReadCallback* readCb) {
+  auto result = readZeroCopy(id);
+  if (result.hasError()) {
+    return;
+  }
+  auto data = std::move(result.value().first);
+  auto len = data ? data->computeChainDataLength() : 0;
+  readCb->onDataPushed(id, std::move(data), result.value().second);
+  if (len > 0 && closeState_ == CloseState::OPEN) {
+    // The stream can be gone if the callback reset it, nothing to credit then.
+    releaseRead(id, len);
+  }
+}
+
+void QuicTransportBase::invokePushReadCallbacks() {
+  // Pushing data can change the readable streams, so iterate over a snapshot.
+  auto readableListCopy =
+      streamsFrom(conn_->streamManager->readableStreams(), 0);
+  for (const auto& streamId : readableListCopy) {
+    if (closeState_ != CloseState::OPEN) {
+      break;
+    }
+    auto callback = readCallbacks_.find(streamId);
+    if (callback == readCallbacks_.end() || !callback->second.readCb ||
+        !callback->second.resumed || !callback->second.pushDelivery) {
+      continue;
+    }
+    auto stream = conn_->streamManager->getStream(streamId);
+    // Errors are left to the read looper, like for the other callbacks.
+    if (!stream || stream->streamReadError || !stream->hasReadableData()) {
+      continue;
+    }
+    VLOG(10) << "pushing read data on stream=" << streamId << " " << *this;
+    pushReadData(streamId, callback->second.readCb);
+  }
+}
+
 void QuicTransportBase::invokeReadDataAndCallbacks() {
   auto self = sharedGuard();
+  LoopTimeGuard loopTimeGuard(*this);
+  invokingReadCallbacks_ = true;
   SCOPE_EXIT {
     self->checkForClosedStream();
     self->updateReadLooper();
+    // Acks held back for the callbacks go out now, with what they wrote.
     self->updateWriteLooper(true);
+    self->invokingReadCallbacks_ = false;
   };
-  auto readableListCopy = self->conn_->streamManager->readableStreams();
+  // The callbacks can change the readable streams, so iterate over a snapshot.
+  // A vector keeps the ids in the same order without allocating a node per
+  // stream on every loop.
+  auto readableListCopy = streamsFrom(
+      self->conn_->streamManager->readableStreams(), nextReadStream_);
+  auto budget = conn_->transportSettings.streamCallbacksPerLoop;
+  uint64_t invoked = 0;
+  // Streams without a callback of their own, for the connection callback.
+  std::vector<StreamId> connReadableStreams;
   for (const auto& streamId : readableListCopy) {
+    if (budget && invoked == budget) {
+      // The looper keeps running while there are readable streams.
+      nextReadStream_ = streamId;
+      break;
+    }
     auto callback = self->readCallbacks_.find(streamId);
     if (callback == self->readCallbacks_.end()) {
-      self->conn_->streamManager->readableStreams().erase(streamId);
+      if (self->connReadCallback_) {
+        connReadableStreams.push_back(streamId);
+      } else {
+        self->conn_->streamManager->readableStreams().erase(streamId);
+      }
       continue;
     }
     auto readCb = callback->second.readCb;
@@ -739,15 +999,55 @@ void QuicTransportBase::invokeReadDataAndCallbacks() {
       peekCallbacks_.erase(streamId);
       VLOG(10) << "invoking read error callbacks on stream=" << streamId << " "
                << *this;
+      invoked++;
       readCb->readError(
           streamId, std::make_pair(*stream->streamReadError, folly::none));
     } else if (
         readCb && callback->second.resumed && stream->hasReadableData()) {
       VLOG(10) << "invoking read callbacks on stream=" << streamId << " "
                << *this;
-      readCb->readAvailable(streamId);
+      invoked++;
+      if (callback->second.pushDelivery) {
+        pushReadData(streamId, readCb);
+      } else {
+        readCb->readAvailable(streamId);
+      }
     }
   }
+  invokeConnectionReadCallback(std::move(connReadableStreams));
+}
+
+void QuicTransportBase::invokeConnectionReadCallback(
+    std::vector<StreamId> streamIds) {
+  // Errors are reported one stream at a time, the rest in a single batch.
+  size_t numReadable = 0;
+  for (auto streamId : streamIds) {
+    if (!connReadCallback_) {
+      return;
+    }
+    auto stream = conn_->streamManager->findStream(streamId);
+    if (!stream) {
+      conn_->streamManager->readableStreams().erase(streamId);
+      continue;
+    }
+    if (stream->streamReadError) {
+      conn_->streamManager->readableStreams().erase(streamId);
+      conn_->streamManager->peekableStreams().erase(streamId);
+      peekCallbacks_.erase(streamId);
+      VLOG(10) << "invoking connection read error callback on stream="
+               << streamId << " " << *this;
+      connReadCallback_->readError(
+          streamId, std::make_pair(*stream->streamReadError, folly::none));
+    } else if (stream->hasReadableData()) {
+      streamIds[numReadable++] = streamId;
+    }
+  }
+  if (connReadCallback_ && numReadable > 0) {
+    VLOG(10) << "invoking connection read callback on " << numReadable
+             << " streams " << *this;
+    connReadCallback_->readAvailable(
+        folly::Range<const StreamId*>(streamIds.data(), numReadable));
+  }
 }
 
 void QuicTransportBase::updateReadLooper() {
@@ -759,10 +1059,11 @@ void QuicTransportBase::updateReadLooper() {
   auto iter = std::find_if(
       conn_->streamManager->readableStreams().begin(),
       conn_->streamManager->readableStreams().end(),
-      [& readCallbacks = readCallbacks_](StreamId s) {
+      [& readCallbacks = readCallbacks_,
+       connReadCallback = connReadCallback_](StreamId s) {
         auto readCb = readCallbacks.find(s);
         if (readCb == readCallbacks.end()) {
-          return false;
+          return connReadCallback != nullptr;
         }
         // TODO: if the stream has an error and it is also paused we should
         // still return an error
@@ -846,6 +1147,7 @@ QuicTransportBase::pauseOrResumePeek(StreamId id, bool resume) {
 
 void QuicTransportBase::invokePeekDataAndCallbacks() {
   auto self = sharedGuard();
+  LoopTimeGuard loopTimeGuard(*this);
   SCOPE_EXIT {
     self->checkForClosedStream();
     self->updatePeekLooper();
@@ -856,10 +1158,18 @@ void QuicTransportBase::invokePeekDataAndCallbacks() {
   // is called and decremented when peek is done. once counter transitions
   // to 0 we can execute "consume" calls that were done during "peek", for that,
   // we would need to keep stack of them.
-  auto peekableListCopy = self->conn_->streamManager->peekableStreams();
+  auto peekableListCopy = streamsFrom(
+      self->conn_->streamManager->peekableStreams(), nextPeekStream_);
   VLOG(10) << __func__
            << " peekableListCopy.size()=" << peekableListCopy.size();
+  auto budget = conn_->transportSettings.streamCallbacksPerLoop;
+  uint64_t invoked = 0;
   for (const auto& streamId : peekableListCopy) {
+    if (budget && invoked == budget) {
+      // The rest stay peekable, so the looper runs again.
+      nextPeekStream_ = streamId;
+      break;
+    }
     auto callback = self->peekCallbacks_.find(streamId);
     // This is a likely bug. Need to think more on whether events can
     // be dropped
@@ -879,6 +1189,7 @@ void QuicTransportBase::invokePeekDataAndCallbacks() {
     if (peekCb && !stream->streamReadError && stream->hasPeekableData()) {
       VLOG(10) << "invoking peek callbacks on stream=" << streamId << " "
                << *this;
+      invoked++;
 
       peekDataFromQuicStream(
           *stream,
@@ -1114,33 +1425,104 @@ void QuicTransportBase::updateWriteLooper(bool thisIteration) {
     VLOG(10) << nodeToString(conn_->nodeType)
              << " stopping write looper because conn closed " << *this;
     writeLooper_->stop();
+    if (writeScheduler_) {
+      writeScheduler_->unschedule(*this);
+      writeScheduler_ = nullptr;
+    }
+    setActiveWriter(false);
     return;
   }
+  if (conn_->streamManager->hasRateLimited() &&
+      !streamSendRateTimeout_.isScheduled()) {
+    updateStreamSendRateTimeout();
+  }
   // TODO: Also listens to write event from libevent. Only schedule write when
   // the socket itself is writable.
   auto writeDataReason = shouldWriteData(*conn_);
+  if (writeDataReason == WriteDataReason::ACK &&
+      conn_->transportSettings.coalesceAcksWithReads &&
+      !invokingReadCallbacks_ && readLooper_->isRunning() &&
+      hasOnlyAppDataAckToWrite(*conn_)) {
+    // The read looper is about to run and writes the acks once the
+    // callbacks return, along with the app's response if they write one.
+    VLOG(10) << nodeToString(conn_->nodeType)
+             << " holding back acks for the read callbacks " << *this;
+    writeDataReason = WriteDataReason::NO_WRITE;
+  }
   if (writeDataReason != WriteDataReason::NO_WRITE) {
     VLOG(10) << nodeToString(conn_->nodeType)
              << " running write looper thisIteration=" << thisIteration << " "
              << *this;
-    writeLooper_->run(thisIteration);
+    if (writeScheduler_ && !isConnectionPaced(*conn_)) {
+      writeLooper_->stop();
+      writeScheduler_->schedule(*this, thisIteration);
+    } else {
+      if (writeScheduler_) {
+        writeScheduler_->unschedule(*this);
+      }
+      writeLooper_->run(thisIteration);
+    }
+    setActiveWriter(true);
     conn_->debugState.needsWriteLoopDetect =
         (conn_->loopDetectorCallback != nullptr);
   } else {
     VLOG(10) << nodeToString(conn_->nodeType) << " stopping write looper "
              << *this;
     writeLooper_->stop();
+    if (writeScheduler_) {
+      writeScheduler_->unschedule(*this);
+    }
+    setActiveWriter(false);
     conn_->debugState.needsWriteLoopDetect = false;
     conn_->debugState.currentEmptyLoopCount = 0;
   }
   conn_->debugState.writeDataReason = writeDataReason;
 }
 
+void QuicTransportBase::onScheduledWrite() noexcept {
+  // Same as an unpaced run of the write looper.
+  writeSocketDataAndCatch();
+}
+
+void QuicTransportBase::setActiveWriter(bool active) {
+  auto evb = getEventBase();
+  if (activeWriter_ == active || !evb) {
+    return;
+  }
+  auto& numWriters = activeWriters().getOrCreate(*evb, 0);
+  if (active) {
+    ++numWriters;
+  } else {
+    DCHECK_GT(numWriters, 0);
+    --numWriters;
+  }
+  activeWriter_ = active;
+}
+
+uint64_t QuicTransportBase::getNumActiveWriters() const {
+  auto evb = getEventBase();
+  auto numWriters = evb ? activeWriters().get(*evb) : nullptr;
+  return numWriters ? *numWriters : 1;
+}
+
 void QuicTransportBase::cancelDeliveryCallbacksForStream(StreamId streamId) {
   if (isReceivingStream(conn_->nodeType, streamId)) {
     return;
   }
   conn_->streamManager->removeDeliverable(streamId);
+  auto aggregatedCallbackIter = aggregatedDeliveryCallbacks_.find(streamId);
+  if (aggregatedCallbackIter != aggregatedDeliveryCallbacks_.end()) {
+    auto aggregatedCallback = aggregatedCallbackIter->second;
+    aggregatedDeliveryCallbacks_.erase(aggregatedCallbackIter);
+    aggregatedCallback.deliveryCb->onCanceled(
+        streamId,
+        aggregatedCallback.deliveredOffset
+            ? *aggregatedCallback.deliveredOffset + 1
+            : 0);
+    if (closeState_ != CloseState::OPEN) {
+      return;
+    }
+  }
   auto deliveryCallbackIter = deliveryCallbacks_.find(streamId);
   if (deliveryCallbackIter == deliveryCallbacks_.end()) {
     return;
@@ -1202,6 +1584,22 @@ void QuicTransportBase::cancelDeliveryCallbacksForStream(
 folly::Expected<std::pair<Buf, bool>, LocalErrorCode> QuicTransportBase::read(
     StreamId id,
     size_t maxLen) {
+  return readImpl(id, [maxLen](QuicStreamState& stream) {
+    return readDataFromQuicStream(stream, maxLen);
+  });
+}
+
+folly::Expected<std::pair<Buf, bool>, LocalErrorCode>
+QuicTransportBase::readZeroCopy(StreamId id) {
+  return readImpl(id, [](QuicStreamState& stream) {
+    return readDataFromQuicStreamWithoutCredit(stream);
+  });
+}
+
+folly::Expected<std::pair<Buf, bool>, LocalErrorCode>
+QuicTransportBase::readImpl(
+    StreamId id,
+    folly::FunctionRef<std::pair<Buf, bool>(QuicStreamState&)> readFn) {
   if (isSendingStream(conn_->nodeType, id)) {
     return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
   }
@@ -1228,7 +1626,7 @@ folly::Expected<std::pair<Buf, bool>, LocalErrorCode> QuicTransportBase::read(
       // by the stream existence check, but might as well check this.
       return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
     }
-    auto result = readDataFromQuicStream(*stream, maxLen);
+    auto result = readFn(*stream);
     if (result.second) {
       VLOG(10) << "Delivered eof to app for stream=" << stream->id << " "
                << *this;
@@ -1297,6 +1695,30 @@ folly::Expected<folly::Unit, LocalErrorCode> QuicTransportBase::peek(
   return folly::makeExpected<LocalErrorCode>(folly::Unit());
 }
 
+folly::Expected<folly::Unit, LocalErrorCode> QuicTransportBase::releaseRead(
+    StreamId id,
+    size_t amount) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  SCOPE_EXIT {
+    updateWriteLooper(true);
+  };
+  if (!conn_->streamManager->streamExists(id)) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  auto stream = conn_->streamManager->getStream(id);
+  if (!stream) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
+  }
+  if (stream->flowControlState.unreleasedReadBytes < amount) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  updateFlowControlOnReadRelease(*stream, amount, loopClockNow(*conn_));
+  return folly::unit;
+}
+
 folly::Expected<folly::Unit, LocalErrorCode> QuicTransportBase::consume(
     StreamId id,
     size_t amount) {
@@ -1442,6 +1864,10 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
     if (closeState_ != CloseState::OPEN) {
       break;
     }
+    invokeAggregatedDeliveryCallback(*stream);
+    if (closeState_ != CloseState::OPEN) {
+      break;
+    }
     auto deliveryCallbacksForAckedStream = deliveryCallbacks_.find(streamId);
     if (deliveryCallbacksForAckedStream != deliveryCallbacks_.end() &&
         deliveryCallbacksForAckedStream->second.empty()) {
@@ -1453,6 +1879,11 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
   invokeDataExpiredCallbacks();
   invokeDataRejectedCallbacks();
 
+  if (closeState_ == CloseState::OPEN && datagramCallback_ &&
+      !conn_->datagramState.readBuffer.empty()) {
+    datagramCallback_->onDatagramsAvailable();
+  }
+
   // Iterate over streams that changed their flow control window and give
   // their registered listeners their updates.
   // We don't really need flow control notifications when we are closed.
@@ -1528,12 +1959,19 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
       }
     }
   }
+
+  // Data received in order goes to the push callbacks right away rather than
+  // on the next read loop.
+  if (closeState_ == CloseState::OPEN) {
+    invokePushReadCallbacks();
+  }
 }
 
 void QuicTransportBase::onNetworkData(
     const folly::SocketAddress& peer,
     NetworkData&& networkData) noexcept {
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  LoopTimeGuard loopTimeGuard(*this);
   SCOPE_EXIT {
     checkForClosedStream();
     updateReadLooper();
@@ -1545,8 +1983,45 @@ void QuicTransportBase::onNetworkData(
       conn_->lossState.totalBytesRecvd +=
           networkData.data->computeChainDataLength();
     }
+    for (const auto& datagram : networkData.batch) {
+      conn_->lossState.totalBytesRecvd += datagram->computeChainDataLength();
+    }
+    if (conn_->packetCapture) {
+      if (networkData.data) {
+        conn_->packetCapture->record(
+            PacketCaptureRing::Direction::Received,
+            networkData.receiveTimePoint,
+            peer,
+            *networkData.data);
+      }
+      for (const auto& datagram : networkData.batch) {
+        conn_->packetCapture->record(
+            PacketCaptureRing::Direction::Received,
+            networkData.receiveTimePoint,
+            peer,
+            *datagram);
+      }
+    }
     auto originalAckVersion = currentAckStateVersion(*conn_);
+    folly::Optional<TimePoint> readStart;
+    if (conn_->infoCallback) {
+      readStart = Clock::now();
+    }
+    if (!networkData.batch.empty()) {
+      startAckBatch(*conn_);
+    }
+    SCOPE_EXIT {
+      conn_->ackBatch.clear();
+    };
     onReadData(peer, std::move(networkData));
+    if (closeState_ != CloseState::CLOSED) {
+      flushAckBatch(*conn_, markPacketLoss);
+    }
+    if (readStart) {
+      conn_->latencies.readLoop.add(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              Clock::now() - *readStart));
+    }
     processCallbacksAfterNetworkData();
     if (closeState_ != CloseState::CLOSED) {
       if (currentAckStateVersion(*conn_) != originalAckVersion) {
@@ -1591,7 +2066,16 @@ void QuicTransportBase::setIdleTimer() {
   if (closeState_ == CloseState::CLOSED) {
     return;
   }
+  lastIdleTimerReset_ = loopClockNow(*conn_);
+  if (conn_->transportSettings.keepaliveInterval.count() > 0 &&
+      !keepaliveTimeout_.isScheduled()) {
+    scheduleKeepaliveTimeout(conn_->transportSettings.keepaliveInterval);
+  }
   if (idleTimeout_.isScheduled()) {
+    if (conn_->transportSettings.lazyIdleTimeout) {
+      // Checked when the timer fires.
+      return;
+    }
     idleTimeout_.cancelTimeout();
   }
   if (conn_->transportSettings.idleTimeout >
@@ -1627,6 +2111,29 @@ QuicTransportBase::createStreamInternal(bool bidirectional) {
   }
 }
 
+folly::Expected<std::vector<StreamId>, LocalErrorCode>
+QuicTransportBase::createStreamsInternal(
+    bool bidirectional,
+    uint64_t numStreams) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (bidirectional) {
+    return conn_->streamManager->openNextBidirectionalStreams(numStreams);
+  }
+  return conn_->streamManager->openNextUnidirectionalStreams(numStreams);
+}
+
+folly::Expected<std::vector<StreamId>, LocalErrorCode>
+QuicTransportBase::createBidirectionalStreams(uint64_t numStreams) {
+  return createStreamsInternal(true, numStreams);
+}
+
+folly::Expected<std::vector<StreamId>, LocalErrorCode>
+QuicTransportBase::createUnidirectionalStreams(uint64_t numStreams) {
+  return createStreamsInternal(false, numStreams);
+}
+
 folly::Expected<StreamId, LocalErrorCode>
 QuicTransportBase::createBidirectionalStream(bool /*replaySafe*/) {
   return createStreamInternal(true);
@@ -1738,8 +2245,62 @@ QuicTransportBase::notifyPendingWriteOnStream(StreamId id, WriteCallback* wcb) {
   return folly::unit;
 }
 
+uint64_t QuicTransportBase::getMaxWritableOnConnection() {
+  return maxWritableOnConn();
+}
+
+folly::Expected<uint64_t, LocalErrorCode>
+QuicTransportBase::getMaxWritableOnStream(StreamId id) {
+  if (isReceivingStream(conn_->nodeType, id)) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  auto stream = CHECK_NOTNULL(conn_->streamManager->getStream(id));
+  if (!stream->writable()) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
+  }
+  return maxWritableOnStream(*stream);
+}
+
+folly::Expected<uint64_t, LocalErrorCode> QuicTransportBase::reserveWriteSpace(
+    StreamId id,
+    uint64_t bytes) {
+  if (isReceivingStream(conn_->nodeType, id)) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  auto stream = CHECK_NOTNULL(conn_->streamManager->getStream(id));
+  if (!stream->writable()) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
+  }
+  releaseWriteReservation(id);
+  auto reserved = std::min(bytes, maxWritableOnStream(*stream));
+  if (reserved > 0) {
+    writeReservations_.emplace(id, reserved);
+    totalWriteReservations_ += reserved;
+  }
+  return reserved;
+}
+
 uint64_t QuicTransportBase::maxWritableOnStream(const QuicStreamState& stream) {
-  auto connWritableBytes = maxWritableOnConn();
+  // The stream can use its own reservation but not the others'.
+  auto connWritableBytes = std::min(
+      getSendConnFlowControlBytesAPI(*conn_), bufferSpaceAvailable());
+  auto reservedByOthers = totalWriteReservations_;
+  auto reservationIt = writeReservations_.find(stream.id);
+  if (reservationIt != writeReservations_.end()) {
+    reservedByOthers -= reservationIt->second;
+  }
+  connWritableBytes = connWritableBytes > reservedByOthers
+      ? connWritableBytes - reservedByOthers
+      : 0;
   auto streamFlowControlBytes = getSendStreamFlowControlBytesAPI(stream);
   auto flowControlAllowedBytes =
       std::min(streamFlowControlBytes, connWritableBytes);
@@ -1749,7 +2310,31 @@ uint64_t QuicTransportBase::maxWritableOnStream(const QuicStreamState& stream) {
 uint64_t QuicTransportBase::maxWritableOnConn() {
   auto connWritableBytes = getSendConnFlowControlBytesAPI(*conn_);
   auto availableBufferSpace = bufferSpaceAvailable();
-  return std::min(connWritableBytes, availableBufferSpace);
+  auto writable = std::min(connWritableBytes, availableBufferSpace);
+  return writable > totalWriteReservations_
+      ? writable - totalWriteReservations_
+      : 0;
+}
+
+void QuicTransportBase::consumeWriteReservation(StreamId id, uint64_t bytes) {
+  auto it = writeReservations_.find(id);
+  if (it == writeReservations_.end()) {
+    return;
+  }
+  auto consumed = std::min(it->second, bytes);
+  it->second -= consumed;
+  totalWriteReservations_ -= consumed;
+  if (it->second == 0) {
+    writeReservations_.erase(it);
+  }
+}
+
+void QuicTransportBase::releaseWriteReservation(StreamId id) {
+  auto it = writeReservations_.find(id);
+  if (it != writeReservations_.end()) {
+    totalWriteReservations_ -= it->second;
+    writeReservations_.erase(it);
+  }
 }
 
 QuicSocket::WriteResult QuicTransportBase::writeChain(
@@ -1757,7 +2342,8 @@ QuicSocket::WriteResult QuicTransportBase::writeChain(
     Buf data,
     bool eof,
     bool /*cork*/,
-    DeliveryCallback* cb) {
+    DeliveryCallback* cb,
+    folly::Optional<TimePoint> deadline) {
   if (isReceivingStream(conn_->nodeType, id)) {
     return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
   }
@@ -1775,17 +2361,10 @@ QuicSocket::WriteResult QuicTransportBase::writeChain(
     if (!stream || !stream->writable()) {
       return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
     }
-    // Register DeliveryCallback for the data + eof offset.
-    if (cb) {
-      auto dataLength =
-          (data ? data->computeChainDataLength() : 0) + (eof ? 1 : 0);
-      if (dataLength) {
-        auto currentLargestWriteOffset = getLargestWriteOffsetSeen(*stream);
-        registerDeliveryCallback(
-            id, currentLargestWriteOffset + dataLength - 1, cb);
-      }
+    if (writeSources_.count(id)) {
+      return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
     }
-    writeDataToQuicStream(*stream, std::move(data), eof);
+    writeToStream(*stream, std::move(data), eof, cb, deadline);
     updateWriteLooper(true);
   } catch (const QuicTransportException& ex) {
     VLOG(4) << __func__ << " streamId=" << id << " " << ex.what() << " "
@@ -1810,6 +2389,195 @@ QuicSocket::WriteResult QuicTransportBase::writeChain(
   return nullptr;
 }
 
+folly::Expected<folly::Unit, LocalErrorCode> QuicTransportBase::writeChains(
+    folly::Range<StreamWrite*> writes) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  try {
+    // Check the whole batch before writing any of it, so that a failed batch
+    // can be retried as a whole.
+    std::vector<QuicStreamState*> streams;
+    streams.reserve(writes.size());
+    std::unordered_set<StreamId> finishedStreams;
+    for (const auto& write : writes) {
+      if (isReceivingStream(conn_->nodeType, write.id)) {
+        return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+      }
+      if (!conn_->streamManager->streamExists(write.id)) {
+        return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+      }
+      auto stream = conn_->streamManager->getStream(write.id);
+      if (!stream || !stream->writable() ||
+          finishedStreams.count(write.id)) {
+        return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
+      }
+      if (writeSources_.count(write.id)) {
+        return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+      }
+      if (write.eof) {
+        finishedStreams.insert(write.id);
+      }
+      streams.push_back(stream);
+    }
+    for (size_t i = 0; i < writes.size(); ++i) {
+      auto& write = writes[i];
+      writeToStream(
+          *streams[i], std::move(write.data), write.eof, write.cb, folly::none);
+    }
+    updateWriteLooper(true);
+  } catch (const QuicTransportException& ex) {
+    VLOG(4) << __func__ << " " << ex.what() << " " << *this;
+    closeImpl(
+        std::make_pair(QuicErrorCode(ex.errorCode()), std::string(ex.what())));
+    return folly::makeUnexpected(LocalErrorCode::TRANSPORT_ERROR);
+  } catch (const QuicInternalException& ex) {
+    VLOG(4) << __func__ << " " << ex.what() << " " << *this;
+    closeImpl(
+        std::make_pair(QuicErrorCode(ex.errorCode()), std::string(ex.what())));
+    return folly::makeUnexpected(ex.errorCode());
+  } catch (const std::exception& ex) {
+    VLOG(4) << __func__ << " " << ex.what() << " " << *this;
+    closeImpl(std::make_pair(
+        QuicErrorCode(TransportErrorCode::INTERNAL_ERROR),
+        std::string(ex.what())));
+    return folly::makeUnexpected(LocalErrorCode::INTERNAL_ERROR);
+  }
+  return folly::unit;
+}
+
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::writeFromSource(
+    StreamId id,
+    std::unique_ptr<StreamWriteSource> source,
+    bool eof,
+    DeliveryCallback* cb) {
+  if (isReceivingStream(conn_->nodeType, id) || !source) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  try {
+    if (!conn_->streamManager->streamExists(id)) {
+      return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+    }
+    auto stream = conn_->streamManager->getStream(id);
+    if (!stream || !stream->writable()) {
+      return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
+    }
+    if (writeSources_.count(id)) {
+      return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+    }
+    auto dataLength = source->length() + (eof ? 1 : 0);
+    if (cb && dataLength) {
+      registerDeliveryCallback(
+          id, getLargestWriteOffsetSeen(*stream) + dataLength - 1, cb);
+    }
+    auto& sourceData = writeSources_[id];
+    sourceData.source = std::move(source);
+    sourceData.eof = eof;
+    fillFromWriteSources();
+    updateWriteLooper(true);
+  } catch (const QuicTransportException& ex) {
+    VLOG(4) << __func__ << " streamId=" << id << " " << ex.what() << " "
+            << *this;
+    closeImpl(
+        std::make_pair(QuicErrorCode(ex.errorCode()), std::string(ex.what())));
+    return folly::makeUnexpected(LocalErrorCode::TRANSPORT_ERROR);
+  } catch (const QuicInternalException& ex) {
+    VLOG(4) << __func__ << " streamId=" << id << " " << ex.what() << " "
+            << *this;
+    closeImpl(
+        std::make_pair(QuicErrorCode(ex.errorCode()), std::string(ex.what())));
+    return folly::makeUnexpected(ex.errorCode());
+  } catch (const std::exception& ex) {
+    VLOG(4) << __func__ << " streamId=" << id << " " << ex.what() << " "
+            << *this;
+    closeImpl(std::make_pair(
+        QuicErrorCode(TransportErrorCode::INTERNAL_ERROR),
+        std::string(ex.what())));
+    return folly::makeUnexpected(LocalErrorCode::INTERNAL_ERROR);
+  }
+  return folly::unit;
+}
+
+void QuicTransportBase::fillFromWriteSources() {
+  uint64_t budget = conn_->udpSendPacketLen;
+  if (conn_->congestionController) {
+    budget = std::max(
+        budget, conn_->congestionController->getWritableBytes());
+  }
+  for (auto it = writeSources_.begin(); it != writeSources_.end();) {
+    auto stream = conn_->streamManager->findStream(it->first);
+    if (!stream || !stream->writable()) {
+      it = writeSources_.erase(it);
+      continue;
+    }
+    auto& sourceData = it->second;
+    auto buffered = stream->writeBuffer.chainLength();
+    auto remaining = sourceData.source->length() - sourceData.offset;
+    if (buffered < budget && remaining > 0) {
+      auto len = std::min(budget - buffered, remaining);
+      auto data = sourceData.source->read(sourceData.offset, len);
+      if (!data || data->computeChainDataLength() != len) {
+        throw QuicInternalException(
+            "Stream write source returned short data",
+            LocalErrorCode::INTERNAL_ERROR);
+      }
+      sourceData.offset += len;
+      remaining -= len;
+      writeToStream(
+          *stream,
+          std::move(data),
+          remaining == 0 && sourceData.eof,
+          nullptr,
+          folly::none);
+    } else if (remaining == 0 && sourceData.eof) {
+      // Empty source.
+      writeToStream(*stream, nullptr, true, nullptr, folly::none);
+    }
+    if (remaining == 0) {
+      it = writeSources_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void QuicTransportBase::writeToStream(
+    QuicStreamState& stream,
+    Buf data,
+    bool eof,
+    DeliveryCallback* cb,
+    folly::Optional<TimePoint> deadline) {
+  // Register DeliveryCallback for the data + eof offset.
+  if (cb) {
+    auto dataLength =
+        (data ? data->computeChainDataLength() : 0) + (eof ? 1 : 0);
+    if (dataLength) {
+      auto currentLargestWriteOffset = getLargestWriteOffsetSeen(stream);
+      registerDeliveryCallback(
+          stream.id, currentLargestWriteOffset + dataLength - 1, cb);
+    }
+  }
+  auto writeOffset = getLargestWriteOffsetSeen(stream);
+  if (eof) {
+    // Nothing is written after the EOF, so it releases the rest.
+    releaseWriteReservation(stream.id);
+  } else if (data && !writeReservations_.empty()) {
+    consumeWriteReservation(stream.id, data->computeChainDataLength());
+  }
+  writeDataToQuicStream(stream, std::move(data), eof);
+  auto endOffset = getLargestWriteOffsetSeen(stream);
+  if (deadline && endOffset > writeOffset) {
+    stream.writeDeadlines.push_back({endOffset, *deadline});
+    conn_->streamManager->addDeadline(stream.id);
+  }
+}
+
 folly::Expected<folly::Unit, LocalErrorCode>
 QuicTransportBase::registerDeliveryCallback(
     StreamId id,
@@ -1867,6 +2635,50 @@ QuicTransportBase::registerDeliveryCallback(
   return folly::unit;
 }
 
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setAggregatedDeliveryCallback(
+    StreamId id,
+    DeliveryCallback* cb) {
+  if (isReceivingStream(conn_->nodeType, id)) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  if (!cb) {
+    aggregatedDeliveryCallbacks_.erase(id);
+    return folly::unit;
+  }
+  auto it = aggregatedDeliveryCallbacks_.find(id);
+  if (it == aggregatedDeliveryCallbacks_.end()) {
+    aggregatedDeliveryCallbacks_.emplace(
+        id, AggregatedDeliveryCallbackData(cb));
+  } else {
+    it->second.deliveryCb = cb;
+  }
+  return folly::unit;
+}
+
+void QuicTransportBase::invokeAggregatedDeliveryCallback(
+    const QuicStreamState& stream) {
+  auto it = aggregatedDeliveryCallbacks_.find(stream.id);
+  if (it == aggregatedDeliveryCallbacks_.end()) {
+    return;
+  }
+  auto nextOffsetToDeliver = getStreamNextOffsetToDeliver(stream);
+  auto& deliveredOffset = it->second.deliveredOffset;
+  if (nextOffsetToDeliver == 0 ||
+      (deliveredOffset && *deliveredOffset + 1 >= nextOffsetToDeliver)) {
+    return;
+  }
+  deliveredOffset = nextOffsetToDeliver - 1;
+  it->second.deliveryCb->onDeliveryAck(
+      stream.id, *deliveredOffset, conn_->lossState.srtt);
+}
+
 folly::Optional<LocalErrorCode> QuicTransportBase::shutdownWrite(StreamId id) {
   if (isReceivingStream(conn_->nodeType, id)) {
     return LocalErrorCode::INVALID_OPERATION;
@@ -1905,6 +2717,7 @@ folly::Expected<folly::Unit, LocalErrorCode> QuicTransportBase::resetStream(
     // Invoke state machine
     invokeStreamSendStateMachine(
         *conn_, *stream, StreamEvents::SendReset(errorCode));
+    releaseWriteReservation(id);
     for (auto pendingResetIt = conn_->pendingEvents.resets.begin();
          closeState_ == CloseState::OPEN &&
          pendingResetIt != conn_->pendingEvents.resets.end();
@@ -1952,6 +2765,16 @@ void QuicTransportBase::checkForClosedStream() {
       ++itr;
       continue;
     }
+    // Or the connection read callback has yet to read it up to its EOF.
+    if (connReadCallback_ && readCbIt == readCallbacks_.end()) {
+      auto stream = conn_->streamManager->findStream(*itr);
+      if (stream && !stream->streamReadError && stream->hasReadableData()) {
+        VLOG(10) << "Not closing stream=" << *itr
+                 << " because it has unread data for the connection callback";
+        ++itr;
+        continue;
+      }
+    }
     // We may be in the active peek cb when we close the stream
     auto peekCbIt = peekCallbacks_.find(*itr);
     if (peekCbIt != peekCallbacks_.end() &&
@@ -1979,9 +2802,19 @@ void QuicTransportBase::checkForClosedStream() {
         stream->id,
         stream->totalHolbTime.count(),
         stream->holbCount);
+    if (stream->maxOffsetObserved > 0) {
+      QUIC_STATS(
+          conn_->infoCallback,
+          onStreamReassembly,
+          stream->totalHolbTime,
+          stream->readGapCount,
+          stream->maxReassemblyBytes);
+    }
     conn_->streamManager->removeClosedStream(*itr);
     readCallbacks_.erase(*itr);
     peekCallbacks_.erase(*itr);
+    aggregatedDeliveryCallbacks_.erase(*itr);
+    releaseWriteReservation(*itr);
     itr = conn_->streamManager->closedStreams().erase(itr);
   } // while
 
@@ -1995,15 +2828,69 @@ void QuicTransportBase::sendPing(
     PingCallback* /*callback*/,
     std::chrono::milliseconds /*pingTimeout*/) {}
 
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setDatagramCallback(DatagramCallback* cb) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  datagramCallback_ = cb;
+  return folly::unit;
+}
+
+uint16_t QuicTransportBase::getDatagramSizeLimit() const {
+  return folly::to<uint16_t>(std::min<uint64_t>(
+      quic::getDatagramSizeLimit(*conn_),
+      std::numeric_limits<uint16_t>::max()));
+}
+
+folly::Expected<folly::Unit, LocalErrorCode> QuicTransportBase::writeDatagram(
+    Buf buf) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (!buf || buf->computeChainDataLength() > getDatagramSizeLimit() ||
+      conn_->datagramState.writeBuffer.size() >=
+          conn_->transportSettings.datagramWriteBufferSize) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_WRITE_DATA);
+  }
+  conn_->datagramState.writeBuffer.push_back(std::move(buf));
+  updateWriteLooper(true);
+  return folly::unit;
+}
+
+folly::Expected<std::vector<Buf>, LocalErrorCode>
+QuicTransportBase::readDatagrams(size_t atMost) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  auto& readBuffer = conn_->datagramState.readBuffer;
+  if (atMost == 0 || atMost > readBuffer.size()) {
+    atMost = readBuffer.size();
+  }
+  std::vector<Buf> datagrams;
+  datagrams.reserve(atMost);
+  for (size_t i = 0; i < atMost; ++i) {
+    datagrams.push_back(std::move(readBuffer.front()));
+    readBuffer.pop_front();
+  }
+  return datagrams;
+}
+
 void QuicTransportBase::lossTimeoutExpired() noexcept {
   CHECK_NE(closeState_, CloseState::CLOSED);
   // onLossDetectionAlarm will set packetToSend in pending events
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  LoopTimeGuard loopTimeGuard(*this);
   try {
     onLossDetectionAlarm(*conn_, markPacketLoss);
     // TODO: remove this trace when Pacing is ready to land
     QUIC_TRACE(fst_trace, *conn_, "LossTimeoutExpired");
     pacedWriteDataToSocket(false);
+    auto ptoThreshold = conn_->transportSettings.packetCapturePtoThreshold;
+    if (ptoThreshold > 0 && conn_->lossState.ptoCount == ptoThreshold) {
+      // Once per storm, the count only grows until something is acked.
+      triggerPacketCapture(PacketCaptureTrigger::PtoStorm);
+    }
   } catch (const QuicTransportException& ex) {
     VLOG(4) << __func__ << " " << ex.what() << " " << *this;
     closeImpl(
@@ -2024,6 +2911,7 @@ void QuicTransportBase::ackTimeoutExpired() noexcept {
   CHECK_NE(closeState_, CloseState::CLOSED);
   VLOG(10) << __func__ << " " << *this;
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  LoopTimeGuard loopTimeGuard(*this);
   updateAckStateOnAckTimeout(*conn_);
   pacedWriteDataToSocket(false);
 }
@@ -2037,6 +2925,7 @@ void QuicTransportBase::pathValidationTimeoutExpired() noexcept {
   // TODO junqiw probing is not supported, so pathValidation==connMigration
   // We decide to close conn when pathValidation to migrated path fails.
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  LoopTimeGuard loopTimeGuard(*this);
   closeImpl(std::make_pair(
       QuicErrorCode(TransportErrorCode::INVALID_MIGRATION),
       std::string("Path validation timed out")));
@@ -2045,6 +2934,7 @@ void QuicTransportBase::pathValidationTimeoutExpired() noexcept {
 void QuicTransportBase::idleTimeoutExpired(bool drain) noexcept {
   VLOG(4) << __func__ << " " << *this;
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  LoopTimeGuard loopTimeGuard(*this);
   // idle timeout is expired, just close the connection and drain or
   // send connection close immediately depending on 'drain'
   DCHECK_NE(closeState_, CloseState::CLOSED);
@@ -2056,6 +2946,83 @@ void QuicTransportBase::idleTimeoutExpired(bool drain) noexcept {
       !drain /* sendCloseImmediately */);
 }
 
+void QuicTransportBase::idleTimerExpired() noexcept {
+  auto idleTimeout = conn_->transportSettings.idleTimeout;
+  if (conn_->transportSettings.lazyIdleTimeout &&
+      closeState_ != CloseState::CLOSED) {
+    auto idleFor = std::chrono::duration_cast<std::chrono::milliseconds>(
+        loopClockNow(*conn_) - lastIdleTimerReset_);
+    if (idleFor < idleTimeout) {
+      auto remaining = idleTimeout - idleFor;
+      VLOG(10) << __func__ << " rearming for " << remaining.count() << "ms "
+               << *this;
+      getEventBase()->timer().scheduleTimeout(&idleTimeout_, remaining);
+      return;
+    }
+  }
+  idleTimeoutExpired(true /* drain */);
+}
+
+void QuicTransportBase::keepaliveTimeoutExpired() noexcept {
+  auto interval = conn_->transportSettings.keepaliveInterval;
+  if (closeState_ != CloseState::OPEN || interval.count() <= 0) {
+    return;
+  }
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  // Anything ack eliciting sent meanwhile did the job of the PING.
+  auto quietFor = std::chrono::duration_cast<std::chrono::milliseconds>(
+      loopClockNow(*conn_) -
+      conn_->lossState.lastRetransmittablePacketSentTime);
+  if (quietFor < interval) {
+    scheduleKeepaliveTimeout(interval - quietFor);
+    return;
+  }
+  VLOG(10) << __func__ << " sending keepalive PING " << *this;
+  conn_->pendingEvents.sendPing = true;
+  updateWriteLooper(true);
+  scheduleKeepaliveTimeout(interval);
+}
+
+void QuicTransportBase::scheduleKeepaliveTimeout(
+    std::chrono::milliseconds timeout) {
+  if (closeState_ == CloseState::CLOSED) {
+    return;
+  }
+  // Firing a little early is harmless, while firing late may let the NAT
+  // binding expire. A timeout shorter than the alignment can't be rounded
+  // down without firing right away.
+  if (timeout >= kKeepaliveAlignment) {
+    auto deadline = std::chrono::duration_cast<std::chrono::milliseconds>(
+        (loopClockNow(*conn_) + timeout).time_since_epoch());
+    timeout -= deadline % kKeepaliveAlignment;
+  }
+  auto& wheelTimer = getEventBase()->timer();
+  wheelTimer.scheduleTimeout(
+      &keepaliveTimeout_, timeMax(timeout, wheelTimer.getTickInterval()));
+}
+
+void QuicTransportBase::streamSendRateTimeoutExpired() noexcept {
+  if (closeState_ != CloseState::OPEN) {
+    return;
+  }
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  updateWriteLooper(true);
+}
+
+void QuicTransportBase::updateStreamSendRateTimeout() {
+  auto delay = conn_->streamManager->refreshRateLimitedStreams();
+  if (delay.count() == 0) {
+    return;
+  }
+  // Rounded up, the streams are not writable before the delay is over.
+  auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+      delay + std::chrono::milliseconds(1) - std::chrono::microseconds(1));
+  auto& wheelTimer = getEventBase()->timer();
+  wheelTimer.scheduleTimeout(
+      &streamSendRateTimeout_,
+      timeMax(timeout, wheelTimer.getTickInterval()));
+}
+
 void QuicTransportBase::scheduleLossTimeout(std::chrono::milliseconds timeout) {
   if (closeState_ == CloseState::CLOSED) {
     return;
@@ -2073,8 +3040,11 @@ void QuicTransportBase::scheduleAckTimeout() {
     if (!ackTimeout_.isScheduled()) {
       auto factoredRtt = std::chrono::duration_cast<std::chrono::microseconds>(
           kAckTimerFactor * conn_->lossState.srtt);
-      auto timeout =
-          timeMax(kMinAckTimeout, timeMin(kMaxAckTimeout, factoredRtt));
+      // The peer may have asked for a different max ack delay with an
+      // ACK_FREQUENCY frame, it defaults to kMaxAckTimeout.
+      auto timeout = timeMin(
+          conn_->ackFrequencyState.maxAckDelay,
+          timeMax(kMinAckTimeout, factoredRtt));
       auto timeoutMs =
           std::chrono::duration_cast<std::chrono::milliseconds>(timeout);
       VLOG(10) << __func__ << " timeout=" << timeoutMs.count() << "ms"
@@ -2151,16 +3121,26 @@ void QuicTransportBase::cancelAllAppCallbacks(
     updateWriteLooper(true);
   };
   conn_->streamManager->clearActionable();
+  writeSources_.clear();
+  writeReservations_.clear();
+  totalWriteReservations_ = 0;
   // Move the whole delivery callback map:
   auto deliveryCallbacks = std::move(deliveryCallbacks_);
   // Invoke onCanceled on the copy
   cancelDeliveryCallbacks(deliveryCallbacks);
+  auto aggregatedDeliveryCallbacks = std::move(aggregatedDeliveryCallbacks_);
+  for (auto& cb : aggregatedDeliveryCallbacks) {
+    cb.second.deliveryCb->onCanceled(
+        cb.first,
+        cb.second.deliveredOffset ? *cb.second.deliveredOffset + 1 : 0);
+  }
   // TODO: this will become simpler when we change the underlying data
   // structure of read callbacks.
   // TODO: this approach will make the app unable to setReadCallback to
   // nullptr during the loop. Need to fix that.
   // TODO: setReadCallback to nullptr closes the stream, so the app
   // may just do that...
+  connReadCallback_ = nullptr;
   auto readCallbacksCopy = readCallbacks_;
   for (auto& cb : readCallbacksCopy) {
     readCallbacks_.erase(cb.first);
@@ -2189,10 +3169,64 @@ void QuicTransportBase::cancelAllAppCallbacks(
   }
 }
 
+void QuicTransportBase::updateKernelPacing() {
+  if (!conn_->transportSettings.pacingEnabled ||
+      !conn_->transportSettings.kernelPacingEnabled || kernelPacingFailed_) {
+    return;
+  }
+  if (!kernelPacer_ ||
+      kernelPacer_->getNetworkSocket() != socket_->getNetworkSocket()) {
+    // The socket can change during happy eyeballs.
+    kernelPacer_ = KernelPacer::create(socket_->getNetworkSocket());
+    conn_->kernelPacer = kernelPacer_.get();
+    if (!kernelPacer_) {
+      VLOG(2) << "Failed to enable kernel pacing, using timer pacing " << *this;
+      kernelPacingFailed_ = true;
+      return;
+    }
+  }
+  if (isConnectionKernelPaced(*conn_)) {
+    if (conn_->pacer) {
+      kernelPacer_->setPacingRate(
+          conn_->pacer->getPacingInterval(),
+          conn_->pacer->getPacingBurstSize());
+    } else {
+      kernelPacer_->setPacingRate(
+          conn_->congestionController->getPacingInterval(),
+          conn_->congestionController->getPacingRate(loopClockNow(*conn_)));
+    }
+  }
+}
+
 void QuicTransportBase::writeSocketData() {
+  LoopTimeGuard loopTimeGuard(*this);
+  if (socket_ && closeState_ == CloseState::OPEN &&
+      conn_->streamManager->hasDeadlines()) {
+    expireMissedWriteDeadlines();
+  }
   if (socket_) {
+    updateKernelPacing();
     auto packetsBefore = conn_->outstandingPackets.size();
+    auto writeStart = Clock::now();
+    startWriteLoopBudget(*conn_, getNumActiveWriters(), writeStart);
+    if (closeState_ == CloseState::OPEN && !writeSources_.empty()) {
+      fillFromWriteSources();
+    }
+    SCOPE_EXIT {
+      clearWriteLoopBudget(*conn_);
+      if (conn_->infoCallback) {
+        conn_->latencies.writeLoop.add(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - writeStart));
+      }
+    };
     writeData();
+    // Whatever is still held back for coalescing can't wait for more packets.
+    flushCoalescedPackets(*socket_, *conn_);
+    if (closeState_ == CloseState::OPEN && !writeSources_.empty()) {
+      // Keep a packet of the sources buffered for when the window opens.
+      fillFromWriteSources();
+    }
     if (closeState_ != CloseState::CLOSED) {
       setLossDetectionAlarm(*conn_, *this);
       auto packetsAfter = conn_->outstandingPackets.size();
@@ -2221,16 +3255,11 @@ void QuicTransportBase::writeSocketData() {
         conn_->receivedNewPacketBeforeWrite = false;
       }
       // Check if we are app-limited after finish this round of sending
-      auto currentSendBufLen = conn_->flowControlState.sumCurStreamBufferLen;
-      auto lossBufferEmpty = !conn_->streamManager->hasLoss() &&
-          conn_->cryptoState->initialStream.lossBuffer.empty() &&
-          conn_->cryptoState->handshakeStream.lossBuffer.empty() &&
-          conn_->cryptoState->oneRttStream.lossBuffer.empty();
-      if (conn_->congestionController &&
-          currentSendBufLen < conn_->udpSendPacketLen && lossBufferEmpty &&
-          conn_->congestionController->getWritableBytes()) {
+      if (isAppLimited(*conn_)) {
         conn_->congestionController->setAppLimited();
       }
+      auto now = loopClockNow(*conn_);
+      updateWriteLimiter(*conn_, getWriteLimiter(*conn_, now), now);
     }
   }
   // Writing data could write out an ack which could cause us to cancel
@@ -2241,6 +3270,49 @@ void QuicTransportBase::writeSocketData() {
   updateWriteLooper(false);
 }
 
+void QuicTransportBase::expireMissedWriteDeadlines() {
+  auto deliveredBy = loopClockNow(*conn_) + conn_->lossState.srtt / 2;
+  // Delivery callbacks can change the set, so iterate over a copy.
+  std::vector<StreamId> deadlineStreams(
+      conn_->streamManager->deadlineStreams().begin(),
+      conn_->streamManager->deadlineStreams().end());
+  for (auto id : deadlineStreams) {
+    auto stream = conn_->streamManager->findStream(id);
+    if (!stream) {
+      conn_->streamManager->removeDeadline(id);
+      continue;
+    }
+    auto& deadlines = stream->writeDeadlines;
+    // The minimum retransmittable offset only moves forward, so the last
+    // missed deadline decides how far the stream gets expired.
+    auto missed = std::find_if(
+        deadlines.rbegin(), deadlines.rend(), [&](const auto& deadline) {
+          return deadline.deadline < deliveredBy;
+        });
+    if (missed == deadlines.rend()) {
+      continue;
+    }
+    auto expireOffset = missed->endOffset;
+    deadlines.erase(deadlines.begin(), missed.base());
+    if (deadlines.empty()) {
+      conn_->streamManager->removeDeadline(id);
+    }
+    if (!conn_->partialReliabilityEnabled ||
+        getStreamNextOffsetToDeliver(*stream) >= expireOffset) {
+      continue;
+    }
+    VLOG(10) << __func__ << " stream=" << id
+             << " expiring until offset=" << expireOffset << " " << *this;
+    auto newOffset = advanceMinimumRetransmittableOffset(stream, expireOffset);
+    if (newOffset) {
+      cancelDeliveryCallbacksForStream(id, *newOffset);
+      if (closeState_ != CloseState::OPEN) {
+        return;
+      }
+    }
+  }
+}
+
 void QuicTransportBase::writeSocketDataAndCatch() {
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
   try {
@@ -2287,7 +3359,67 @@ void QuicTransportBase::cancelDeliveryCallbacks(
 void QuicTransportBase::setTransportSettings(
     TransportSettings transportSettings) {
   conn_->transportSettings = std::move(transportSettings);
-  setCongestionControl(transportSettings.defaultCongestionController);
+  if (conn_->transportSettings.pacingEnabled &&
+      conn_->transportSettings.tokenBucketPacerEnabled) {
+    if (!conn_->pacer) {
+      conn_->pacer = std::make_unique<TokenBucketPacer>(
+          *conn_,
+          writeLooper_->getTimerTickInterval().value_or(
+              conn_->transportSettings.pacingTimerTickInterval));
+    }
+  } else {
+    conn_->pacer.reset();
+  }
+  if (!conn_->transportSettings.congestionControlParams.empty()) {
+    // The controller reads its parameters when it's constructed.
+    conn_->congestionController.reset();
+  }
+  setCongestionControl(conn_->transportSettings.defaultCongestionController);
+  updateQLoggerFilter();
+  auto captureDatagrams = conn_->transportSettings.packetCaptureDatagrams;
+  auto snapLength = conn_->transportSettings.packetCaptureSnapLength;
+  if (captureDatagrams == 0) {
+    conn_->packetCapture.reset();
+  } else if (
+      !conn_->packetCapture ||
+      conn_->packetCapture->capacity() != captureDatagrams ||
+      conn_->packetCapture->snapLength() != snapLength) {
+    conn_->packetCapture =
+        std::make_unique<PacketCaptureRing>(captureDatagrams, snapLength);
+  }
+}
+
+folly::Optional<Buf> QuicTransportBase::dumpPacketCapture() const {
+  if (!conn_->packetCapture) {
+    return folly::none;
+  }
+  folly::SocketAddress local;
+  if (socket_ && socket_->isBound()) {
+    local = socket_->address();
+  }
+  return encodePacketCapture(*conn_->packetCapture, local, getKeyLog());
+}
+
+std::string QuicTransportBase::getKeyLog() const {
+  return "";
+}
+
+void QuicTransportBase::triggerPacketCapture(PacketCaptureTrigger trigger) {
+  if (!packetCaptureCallback_ || !conn_->packetCapture) {
+    return;
+  }
+  VLOG(4) << "Packet capture on " << toString(trigger) << " " << *this;
+  auto capture = dumpPacketCapture();
+  packetCaptureCallback_->onPacketCapture(
+      trigger, conn_->clientConnectionId, std::move(*capture));
+}
+
+void QuicTransportBase::updateQLoggerFilter() {
+  if (conn_->qLogger) {
+    conn_->qLogger->enabledEvents = conn_->transportSettings.qLogEvents;
+    conn_->qLogger->packetSampleRate =
+        std::max<uint32_t>(conn_->transportSettings.qLogPacketSampleRate, 1);
+  }
 }
 
 const TransportSettings& QuicTransportBase::getTransportSettings() const {
@@ -2346,10 +3478,21 @@ void QuicTransportBase::detachEventBase() {
   ackTimeout_.cancelTimeout();
   pathValidationTimeout_.cancelTimeout();
   idleTimeout_.cancelTimeout();
+  keepaliveTimeout_.cancelTimeout();
+  streamSendRateTimeout_.cancelTimeout();
   drainTimeout_.cancelTimeout();
   readLooper_->detachEventBase();
   peekLooper_->detachEventBase();
   writeLooper_->detachEventBase();
+  writeLooper_->setPacingTimerWheel(nullptr);
+  // The loop clock and the write scheduler belong to the EventBase being
+  // detached from.
+  conn_->loopClock = nullptr;
+  if (writeScheduler_) {
+    writeScheduler_->unschedule(*this);
+    writeScheduler_ = nullptr;
+  }
+  setActiveWriter(false);
   evb_ = nullptr;
 }
 
@@ -2363,6 +3506,64 @@ folly::Optional<LocalErrorCode> QuicTransportBase::setControlStream(
   return folly::none;
 }
 
+folly::Optional<LocalErrorCode> QuicTransportBase::setStreamPriority(
+    StreamId id,
+    uint8_t urgency,
+    bool incremental) {
+  if (closeState_ != CloseState::OPEN) {
+    return LocalErrorCode::CONNECTION_CLOSED;
+  }
+  if (urgency > kMaxPriorityUrgency) {
+    return LocalErrorCode::INVALID_OPERATION;
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return LocalErrorCode::STREAM_NOT_EXISTS;
+  }
+  auto stream = CHECK_NOTNULL(conn_->streamManager->getStream(id));
+  conn_->streamManager->setStreamPriority(
+      *stream, Priority(urgency, incremental));
+  return folly::none;
+}
+
+folly::Optional<LocalErrorCode> QuicTransportBase::setStreamWeight(
+    StreamId id,
+    uint16_t weight) {
+  if (closeState_ != CloseState::OPEN) {
+    return LocalErrorCode::CONNECTION_CLOSED;
+  }
+  if (weight == 0) {
+    return LocalErrorCode::INVALID_OPERATION;
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return LocalErrorCode::STREAM_NOT_EXISTS;
+  }
+  auto stream = CHECK_NOTNULL(conn_->streamManager->getStream(id));
+  stream->weight = weight;
+  return folly::none;
+}
+
+folly::Optional<LocalErrorCode> QuicTransportBase::setStreamSendRate(
+    StreamId id,
+    uint64_t bytesPerSecond) {
+  if (isReceivingStream(conn_->nodeType, id)) {
+    return LocalErrorCode::INVALID_OPERATION;
+  }
+  if (closeState_ != CloseState::OPEN) {
+    return LocalErrorCode::CONNECTION_CLOSED;
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return LocalErrorCode::STREAM_NOT_EXISTS;
+  }
+  auto stream = CHECK_NOTNULL(conn_->streamManager->getStream(id));
+  stream->sendRate = bytesPerSecond;
+  // Starts with a full burst.
+  stream->sendRateTokens = 0;
+  stream->sendRateUpdateTime = TimePoint();
+  conn_->streamManager->updateWritableStreams(*stream);
+  updateWriteLooper(true);
+  return folly::none;
+}
+
 void QuicTransportBase::runOnEvbAsync(
     folly::Function<void(std::shared_ptr<QuicTransportBase>)> func) {
   auto evb = getEventBase();
@@ -2391,7 +3592,7 @@ void QuicTransportBase::pacedWriteDataToSocket(bool /* fromTimer */) {
   }
 
   // We are in the middle of a pacing interval. Leave it be.
-  if (writeLooper_->isScheduled()) {
+  if (writeLooper_->isPacingTimeoutPending()) {
     // The next burst is already scheduled. Since the burst size doesn't depend
     // on much data we currently have in buffer at all, no need to change
     // anything.
@@ -2417,7 +3618,14 @@ QuicTransportBase::getStreamTransportInfo(StreamId id) const {
   return StreamTransportInfo{
       .totalHeadOfLineBlockedTime = stream->totalHolbTime,
       .holbCount = stream->holbCount,
-      .isHolb = bool(stream->lastHolbTime)};
+      .isHolb = bool(stream->lastHolbTime),
+      .readBufferedBytes = getStreamReadBufferedBytes(*stream),
+      .writeBufferedBytes = getStreamWriteBufferedBytes(*stream),
+      .flowControlBlockedTime =
+          getStreamFlowControlBlockedTime(*stream, Clock::now()),
+      .isFlowControlBlocked = bool(stream->flowControlState.blockedSince),
+      .readGapCount = stream->readGapCount,
+      .maxReassemblyBytes = stream->maxReassemblyBytes};
 }
 
 void QuicTransportBase::describe(std::ostream& os) const {
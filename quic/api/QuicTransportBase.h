@@ -9,16 +9,21 @@
 #pragma once
 
 #include <folly/ExceptionWrapper.h>
+#include <folly/Function.h>
 #include <folly/io/async/AsyncUDPSocket.h>
 #include <folly/io/async/HHWheelTimer.h>
 #include <quic/QuicException.h>
+#include <quic/api/QuicKernelPacing.h>
 #include <quic/api/QuicSocket.h>
+#include <quic/api/QuicWriteScheduler.h>
 #include <quic/common/FunctionLooper.h>
+#include <quic/common/LoopClock.h>
 #include <quic/common/Timers.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
 #include <quic/congestion_control/Copa.h>
 #include <quic/congestion_control/NewReno.h>
 #include <quic/congestion_control/QuicCubic.h>
+#include <quic/congestion_control/TokenBucketPacer.h>
 #include <quic/state/StateData.h>
 
 namespace quic {
@@ -33,7 +38,8 @@ enum class CloseState { OPEN, GRACEFUL_CLOSING, CLOSED };
  *    This is needed in order for QUIC to be able to live beyond the lifetime
  *    of the object that holds it to send graceful close messages to the peer.
  */
-class QuicTransportBase : public QuicSocket {
+class QuicTransportBase : public QuicSocket,
+                          private QuicWriteScheduler::Writer {
  public:
   QuicTransportBase(
       folly::EventBase* evb,
@@ -43,6 +49,35 @@ class QuicTransportBase : public QuicSocket {
 
   void setPacingTimer(TimerHighRes::SharedPtr pacingTimer) noexcept;
 
+  /**
+   * Paces with a timer wheel shared with the other transports of the
+   * EventBase instead of the pacing timer. Pass nullptr to go back to the
+   * pacing timer.
+   */
+  void setPacingTimerWheel(PacingTimerWheel* pacingTimerWheel) noexcept;
+
+  /**
+   * Reads the time once per iteration of the EventBase loop, from a clock
+   * shared with the other transports of the EventBase, rather than once per
+   * packet. Pass nullptr to read the clock every time again.
+   */
+  void setLoopClock(LoopClock* loopClock) noexcept;
+
+  /**
+   * Allocates the buffers of packets built with
+   * TransportSettings::contiguousPacketBuffers from arena, shared with the
+   * other transports of the EventBase. Pass nullptr to use the heap again.
+   */
+  void setBufferArena(BufferArena* arena) noexcept;
+
+  /**
+   * Hands the unpaced writes of this transport over to a write scheduler
+   * shared with the other transports of the EventBase. Paced writes keep
+   * using the transport's own write looper. Pass nullptr to go back to the
+   * write looper.
+   */
+  void setWriteScheduler(QuicWriteScheduler* writeScheduler) noexcept;
+
   folly::EventBase* getEventBase() const override;
 
   folly::Optional<ConnectionId> getClientConnectionId() const override;
@@ -109,10 +144,14 @@ class QuicTransportBase : public QuicSocket {
       StreamId id,
       ReadCallback* cb) override;
   void unsetAllReadCallbacks() override;
+  void setConnectionReadCallback(ConnectionReadCallback* cb) override;
   void unsetAllPeekCallbacks() override;
   void unsetAllDeliveryCallbacks() override;
   folly::Expected<folly::Unit, LocalErrorCode> pauseRead(StreamId id) override;
   folly::Expected<folly::Unit, LocalErrorCode> resumeRead(StreamId id) override;
+  folly::Expected<folly::Unit, LocalErrorCode> setReadPushDelivery(
+      StreamId id,
+      bool enabled) override;
   folly::Expected<folly::Unit, LocalErrorCode> stopSending(
       StreamId id,
       ApplicationErrorCode error) override;
@@ -121,6 +160,13 @@ class QuicTransportBase : public QuicSocket {
       StreamId id,
       size_t maxLen) override;
 
+  folly::Expected<std::pair<Buf, bool>, LocalErrorCode> readZeroCopy(
+      StreamId id) override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> releaseRead(
+      StreamId id,
+      size_t amount) override;
+
   folly::Expected<folly::Unit, LocalErrorCode> setPeekCallback(
       StreamId id,
       PeekCallback* cb) override;
@@ -162,6 +208,10 @@ class QuicTransportBase : public QuicSocket {
       bool replaySafe = true) override;
   folly::Expected<StreamId, LocalErrorCode> createUnidirectionalStream(
       bool replaySafe = true) override;
+  folly::Expected<std::vector<StreamId>, LocalErrorCode>
+  createBidirectionalStreams(uint64_t numStreams) override;
+  folly::Expected<std::vector<StreamId>, LocalErrorCode>
+  createUnidirectionalStreams(uint64_t numStreams) override;
   uint64_t getNumOpenableBidirectionalStreams() const override;
   uint64_t getNumOpenableUnidirectionalStreams() const override;
   bool isClientStream(StreamId stream) noexcept override;
@@ -176,11 +226,30 @@ class QuicTransportBase : public QuicSocket {
   folly::Expected<folly::Unit, LocalErrorCode> notifyPendingWriteOnConnection(
       WriteCallback* wcb) override;
 
+  uint64_t getMaxWritableOnConnection() override;
+
+  folly::Expected<uint64_t, LocalErrorCode> getMaxWritableOnStream(
+      StreamId id) override;
+
+  folly::Expected<uint64_t, LocalErrorCode> reserveWriteSpace(
+      StreamId id,
+      uint64_t bytes) override;
+
   WriteResult writeChain(
       StreamId id,
       Buf data,
       bool eof,
       bool cork,
+      DeliveryCallback* cb = nullptr,
+      folly::Optional<TimePoint> deadline = folly::none) override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> writeChains(
+      folly::Range<StreamWrite*> writes) override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> writeFromSource(
+      StreamId id,
+      std::unique_ptr<StreamWriteSource> source,
+      bool eof,
       DeliveryCallback* cb = nullptr) override;
 
   folly::Expected<folly::Unit, LocalErrorCode> registerDeliveryCallback(
@@ -188,6 +257,10 @@ class QuicTransportBase : public QuicSocket {
       uint64_t offset,
       DeliveryCallback* cb) override;
 
+  folly::Expected<folly::Unit, LocalErrorCode> setAggregatedDeliveryCallback(
+      StreamId id,
+      DeliveryCallback* cb) override;
+
   folly::Optional<LocalErrorCode> shutdownWrite(StreamId id) override;
 
   folly::Expected<folly::Unit, LocalErrorCode> resetStream(
@@ -201,6 +274,16 @@ class QuicTransportBase : public QuicSocket {
   void sendPing(PingCallback* callback, std::chrono::milliseconds pingTimeout)
       override;
 
+  folly::Expected<folly::Unit, LocalErrorCode> setDatagramCallback(
+      DatagramCallback* cb) override;
+
+  uint16_t getDatagramSizeLimit() const override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> writeDatagram(Buf buf) override;
+
+  folly::Expected<std::vector<Buf>, LocalErrorCode> readDatagrams(
+      size_t atMost = 0) override;
+
   const QuicConnectionStateBase* getState() const override {
     return conn_.get();
   }
@@ -229,6 +312,16 @@ class QuicTransportBase : public QuicSocket {
 
   folly::Optional<LocalErrorCode> setControlStream(StreamId id) override;
 
+  folly::Optional<LocalErrorCode>
+  setStreamPriority(StreamId id, uint8_t urgency, bool incremental) override;
+
+  folly::Optional<LocalErrorCode> setStreamWeight(StreamId id, uint16_t weight)
+      override;
+
+  folly::Optional<LocalErrorCode> setStreamSendRate(
+      StreamId id,
+      uint64_t bytesPerSecond) override;
+
   /**
    * Invoke onCanceled for all the delivery callbacks in the deliveryCallbacks
    * passed in. This is supposed to be a copy of the real deque of the delivery
@@ -300,6 +393,15 @@ class QuicTransportBase : public QuicSocket {
    */
   virtual void unbindConnection() = 0;
 
+  /**
+   * Invoked when the connection closes and is about to drain for
+   * drainTimeout. Returns true if the connection drains without the
+   * transport, which is then unbound right away.
+   */
+  virtual bool handOffDrain(std::chrono::milliseconds /* drainTimeout */) {
+    return false;
+  }
+
   /**
    * Returns whether or not the connection has a write cipher. This will be used
    * to decide to return the onTransportReady() callbacks.
@@ -397,7 +499,7 @@ class QuicTransportBase : public QuicSocket {
         : transport_(transport) {}
 
     void timeoutExpired() noexcept override {
-      transport_->idleTimeoutExpired(true /* drain */);
+      transport_->idleTimerExpired();
     }
 
     void callbackCanceled() noexcept override {
@@ -410,6 +512,46 @@ class QuicTransportBase : public QuicSocket {
     QuicTransportBase* transport_;
   };
 
+  class KeepaliveTimeout : public folly::HHWheelTimer::Callback {
+   public:
+    ~KeepaliveTimeout() override = default;
+
+    explicit KeepaliveTimeout(QuicTransportBase* transport)
+        : transport_(transport) {}
+
+    void timeoutExpired() noexcept override {
+      transport_->keepaliveTimeoutExpired();
+    }
+
+    void callbackCanceled() noexcept override {
+      // ignore, the keepalive is only needed while the connection is used.
+      return;
+    }
+
+   private:
+    QuicTransportBase* transport_;
+  };
+
+  class StreamSendRateTimeout : public folly::HHWheelTimer::Callback {
+   public:
+    ~StreamSendRateTimeout() override = default;
+
+    explicit StreamSendRateTimeout(QuicTransportBase* transport)
+        : transport_(transport) {}
+
+    void timeoutExpired() noexcept override {
+      transport_->streamSendRateTimeoutExpired();
+    }
+
+    void callbackCanceled() noexcept override {
+      // ignore, the streams are looked at again on the next write.
+      return;
+    }
+
+   private:
+    QuicTransportBase* transport_;
+  };
+
   // DrainTimeout is a bit different from other timeouts. It needs to hold a
   // shared_ptr to the transport, since if a DrainTimeout is scheduled,
   // transport cannot die.
@@ -428,6 +570,20 @@ class QuicTransportBase : public QuicSocket {
     QuicTransportBase* transport_;
   };
 
+  // Accounts for the event base callback it is scoped to in
+  // conn_->loopTime. Callbacks nested in another one, e.g. a write from a
+  // timer, are part of the outer one.
+  class LoopTimeGuard {
+   public:
+    explicit LoopTimeGuard(QuicTransportBase& transport);
+    ~LoopTimeGuard();
+
+   private:
+    QuicTransportBase& transport_;
+    bool outermost_{false};
+    folly::Optional<TimePoint> start_;
+  };
+
   void scheduleLossTimeout(std::chrono::milliseconds timeout);
   void cancelLossTimeout();
   bool isLossTimeoutScheduled() const;
@@ -443,24 +599,56 @@ class QuicTransportBase : public QuicSocket {
 
   void setQLogger(std::shared_ptr<QLogger> qLogger) {
     conn_->qLogger = std::move(qLogger);
+    updateQLoggerFilter();
   }
 
   void setLoopDetectorCallback(std::shared_ptr<LoopDetectorCallback> callback) {
     conn_->loopDetectorCallback = std::move(callback);
   }
 
+  /**
+   * Where the packet capture of the connection goes on a PTO storm or an
+   * abnormal close, see TransportSettings::packetCaptureDatagrams.
+   */
+  void setPacketCaptureCallback(
+      std::shared_ptr<PacketCaptureCallback> callback) {
+    packetCaptureCallback_ = std::move(callback);
+  }
+
+  /**
+   * The last datagrams of the connection as a pcapng file, see
+   * encodePacketCapture, with the secrets to decrypt them if the transport
+   * keeps them. None unless TransportSettings::packetCaptureDatagrams is set.
+   */
+  folly::Optional<Buf> dumpPacketCapture() const;
+
   virtual void cancelAllAppCallbacks(
       std::pair<QuicErrorCode, std::string> error) noexcept;
 
  protected:
   void processCallbacksAfterNetworkData();
   void invokeReadDataAndCallbacks();
+  // Reports streamIds, streams without a read callback, to connReadCallback_.
+  void invokeConnectionReadCallback(std::vector<StreamId> streamIds);
+  void invokePushReadCallbacks();
   void invokePeekDataAndCallbacks();
   void invokeDataExpiredCallbacks();
   void invokeDataRejectedCallbacks();
   void updateReadLooper();
   void updatePeekLooper();
   void updateWriteLooper(bool thisIteration);
+  // Applies the qlog filter of the transport settings to the qlogger.
+  void updateQLoggerFilter();
+  // The secrets of the connection in the NSS key log format, empty if the
+  // transport doesn't keep them.
+  virtual std::string getKeyLog() const;
+  // Hands the packet capture of the connection to packetCaptureCallback_.
+  void triggerPacketCapture(PacketCaptureTrigger trigger);
+  void onScheduledWrite() noexcept override;
+  // Count this transport among the transports of its EventBase that have data
+  // to write, which share TransportSettings::writeLoopTimeBudget.
+  void setActiveWriter(bool active);
+  uint64_t getNumActiveWriters() const;
 
   void runOnEvbAsync(
       folly::Function<void(std::shared_ptr<QuicTransportBase>)> func);
@@ -469,9 +657,16 @@ class QuicTransportBase : public QuicSocket {
       folly::Optional<std::pair<QuicErrorCode, std::string>> error,
       bool drainConnection = true,
       bool sendCloseImmediately = true);
+  // read() and readZeroCopy(), readFn reads from the stream.
+  folly::Expected<std::pair<Buf, bool>, LocalErrorCode> readImpl(
+      StreamId id,
+      folly::FunctionRef<std::pair<Buf, bool>(QuicStreamState&)> readFn);
   folly::Expected<folly::Unit, LocalErrorCode> pauseOrResumeRead(
       StreamId id,
       bool resume);
+  // Hands the readable data of the stream to readCb's onDataPushed, and
+  // credits it to flow control once it returns.
+  void pushReadData(StreamId id, ReadCallback* readCb);
   folly::Expected<folly::Unit, LocalErrorCode> pauseOrResumePeek(
       StreamId id,
       bool resume);
@@ -484,6 +679,21 @@ class QuicTransportBase : public QuicSocket {
       PeekCallback* cb) noexcept;
   folly::Expected<StreamId, LocalErrorCode> createStreamInternal(
       bool bidirectional);
+  folly::Expected<std::vector<StreamId>, LocalErrorCode>
+  createStreamsInternal(bool bidirectional, uint64_t numStreams);
+  // Buffers a write on an open stream, registering its delivery callback and
+  // deadline. Does not schedule the write loop.
+  void writeToStream(
+      QuicStreamState& stream,
+      Buf data,
+      bool eof,
+      DeliveryCallback* cb,
+      folly::Optional<TimePoint> deadline);
+
+  // Tops up the write buffer of the streams written from a source to what the
+  // congestion controller lets the connection send, and at least a packet so
+  // that they stay writable. Releases the sources that are done.
+  void fillFromWriteSources();
 
   /**
    * write data to socket
@@ -503,6 +713,13 @@ class QuicTransportBase : public QuicSocket {
    */
   void writeSocketDataAndCatch();
 
+  /**
+   * Expires the stream data whose write deadline can no longer be met, that
+   * is data which would not reach the peer before its deadline even if it
+   * were sent right now.
+   */
+  void expireMissedWriteDeadlines();
+
   /**
    * Paced write data to socket when connection is paced.
    *
@@ -514,16 +731,38 @@ class QuicTransportBase : public QuicSocket {
    */
   void pacedWriteDataToSocket(bool fromTimer);
 
+  /**
+   * Sets up kernel pacing on the current socket if enabled in the transport
+   * settings, and hands the congestion controller's pacing rate to it.
+   */
+  void updateKernelPacing();
+
   uint64_t maxWritableOnStream(const QuicStreamState&);
   uint64_t maxWritableOnConn();
+  // Takes written bytes of the stream off its write reservation.
+  void consumeWriteReservation(StreamId id, uint64_t bytes);
+  void releaseWriteReservation(StreamId id);
+  // Tells the stream's aggregated delivery callback about newly acked data.
+  void invokeAggregatedDeliveryCallback(const QuicStreamState& stream);
 
   void lossTimeoutExpired() noexcept;
   void ackTimeoutExpired() noexcept;
   void pathValidationTimeoutExpired() noexcept;
   void idleTimeoutExpired(bool drain) noexcept;
+  // Expires the idle timeout unless it was pushed back lazily, see
+  // TransportSettings::lazyIdleTimeout.
+  void idleTimerExpired() noexcept;
+  void keepaliveTimeoutExpired() noexcept;
+  void streamSendRateTimeoutExpired() noexcept;
   void drainTimeoutExpired() noexcept;
 
   void setIdleTimer();
+  // Arms the keepalive timer timeout from now, rounded down to
+  // kKeepaliveAlignment.
+  void scheduleKeepaliveTimeout(std::chrono::milliseconds timeout);
+  // Makes the rate limited streams that can send writable, and arms the
+  // timeout for the next of the others.
+  void updateStreamSendRateTimeout();
   void scheduleAckTimeout();
   void schedulePathValidationTimeout();
 
@@ -537,6 +776,7 @@ class QuicTransportBase : public QuicSocket {
     ReadCallback* readCb;
     bool resumed{true};
     bool deliveredEOM{false};
+    bool pushDelivery{false};
 
     ReadCallbackData(ReadCallback* readCallback) : readCb(readCallback) {}
   };
@@ -548,6 +788,14 @@ class QuicTransportBase : public QuicSocket {
     PeekCallbackData(PeekCallback* peekCallback) : peekCb(peekCallback) {}
   };
 
+  struct AggregatedDeliveryCallbackData {
+    DeliveryCallback* deliveryCb;
+    // Last offset the callback was told about.
+    folly::Optional<uint64_t> deliveredOffset;
+
+    AggregatedDeliveryCallbackData(DeliveryCallback* cb) : deliveryCb(cb) {}
+  };
+
   struct DataExpiredCallbackData {
     DataExpiredCallback* dataExpiredCb;
     bool resumed{true};
@@ -562,15 +810,32 @@ class QuicTransportBase : public QuicSocket {
     DataRejectedCallbackData(DataRejectedCallback* cb) : dataRejectedCb(cb) {}
   };
 
+  struct WriteSourceData {
+    std::unique_ptr<StreamWriteSource> source;
+    // Offset in the source of the next byte to buffer.
+    uint64_t offset{0};
+    bool eof{false};
+  };
+
   // Map of streamID to tupl
   std::unordered_map<StreamId, ReadCallbackData> readCallbacks_;
+  // Reads the streams that are not in readCallbacks_.
+  ConnectionReadCallback* connReadCallback_{nullptr};
   std::unordered_map<StreamId, PeekCallbackData> peekCallbacks_;
   std::unordered_map<
       StreamId,
       std::deque<std::pair<uint64_t, DeliveryCallback*>>>
       deliveryCallbacks_;
+  std::unordered_map<StreamId, AggregatedDeliveryCallbackData>
+      aggregatedDeliveryCallbacks_;
   std::unordered_map<StreamId, DataExpiredCallbackData> dataExpiredCallbacks_;
   std::unordered_map<StreamId, DataRejectedCallbackData> dataRejectedCallbacks_;
+  std::unordered_map<StreamId, WriteSourceData> writeSources_;
+  // Bytes reserved with reserveWriteSpace, per stream and in total.
+  std::unordered_map<StreamId, uint64_t> writeReservations_;
+  uint64_t totalWriteReservations_{0};
+
+  DatagramCallback* datagramCallback_{nullptr};
 
   WriteCallback* connWriteCallback_{nullptr};
   std::map<StreamId, WriteCallback*> pendingWriteCallbacks_;
@@ -581,10 +846,28 @@ class QuicTransportBase : public QuicSocket {
   AckTimeout ackTimeout_;
   PathValidationTimeout pathValidationTimeout_;
   IdleTimeout idleTimeout_;
+  KeepaliveTimeout keepaliveTimeout_;
+  StreamSendRateTimeout streamSendRateTimeout_;
+  // Last time the idle timer was reset.
+  TimePoint lastIdleTimerReset_;
   DrainTimeout drainTimeout_;
   FunctionLooper::Ptr readLooper_;
   FunctionLooper::Ptr peekLooper_;
+  // Streams the read and peek loops start from when the previous loop ran
+  // out of its callback budget.
+  StreamId nextReadStream_{0};
+  StreamId nextPeekStream_{0};
+  // Set while the read looper runs, when held back acks can't wait anymore.
+  bool invokingReadCallbacks_{false};
   FunctionLooper::Ptr writeLooper_;
+  bool activeWriter_{false};
+  QuicWriteScheduler* writeScheduler_{nullptr};
+  bool inLoopCallback_{false};
+  std::shared_ptr<PacketCaptureCallback> packetCaptureCallback_;
+
+  // Kernel pacing state of socket_, see TransportSettings::kernelPacingEnabled
+  std::unique_ptr<KernelPacer> kernelPacer_;
+  bool kernelPacingFailed_{false};
 
   // TODO: This is silly. We need a better solution.
   // Uninitialied local address as a fallback answer when socket isn't bound.
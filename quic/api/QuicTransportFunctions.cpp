@@ -16,11 +16,14 @@
 #include <quic/codec/QuicPacketBuilder.h>
 #include <quic/codec/QuicWriteCodec.h>
 #include <quic/codec/Types.h>
+#include <quic/common/TimeUtil.h>
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/happyeyeballs/QuicHappyEyeballsFunctions.h>
 #include <quic/logging/QuicLogger.h>
+#include <quic/state/QuicFecFunctions.h>
 #include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
+#include <quic/state/QuicStreamUtilities.h>
 #include <quic/state/SimpleFrameFunctions.h>
 
 namespace {
@@ -78,6 +81,91 @@ bool toWriteAppDataAcks(const quic::QuicConnectionStateBase& conn) {
       conn.ackStates.appDataAckState.needsToSendAckImmediately);
 }
 
+quic::Sample getHeaderProtectionSample(
+    const folly::IOBuf& header,
+    const folly::IOBuf& encryptedBody) {
+  auto packetNumberLength = quic::parsePacketNumberLength(header.data()[0]);
+  quic::Sample sample;
+  size_t sampleBytesToUse =
+      quic::kMaxPacketNumEncodingSize - packetNumberLength;
+  folly::io::Cursor sampleCursor(&encryptedBody);
+  // If there were less than 4 bytes in the packet number, some of the payload
+  // bytes will also be skipped during sampling.
+  sampleCursor.skip(sampleBytesToUse);
+  CHECK(sampleCursor.canAdvance(sample.size())) << "Not enough sample bytes";
+  sampleCursor.pull(sample.data(), sample.size());
+  return sample;
+}
+
+/**
+ * Returns the initial byte and the packet number bytes of the header, which
+ * are the parts covered by header protection.
+ */
+std::pair<folly::MutableByteRange, folly::MutableByteRange>
+getHeaderProtectedRanges(folly::IOBuf& header) {
+  auto packetNumberLength = quic::parsePacketNumberLength(header.data()[0]);
+  // This should already be a single buffer.
+  header.coalesce();
+  folly::MutableByteRange initialByteRange(header.writableData(), 1);
+  folly::MutableByteRange packetNumByteRange(
+      header.writableData() + header.length() - packetNumberLength,
+      packetNumberLength);
+  return std::make_pair(initialByteRange, packetNumByteRange);
+}
+
+void encryptPacketHeaderWithMask(
+    quic::HeaderForm headerForm,
+    folly::IOBuf& header,
+    const quic::HeaderProtectionMask& headerMask,
+    const quic::PacketNumberCipher& headerCipher) {
+  auto ranges = getHeaderProtectedRanges(header);
+  if (headerForm == quic::HeaderForm::Short) {
+    headerCipher.encryptShortHeaderWithMask(
+        headerMask, ranges.first, ranges.second);
+  } else {
+    headerCipher.encryptLongHeaderWithMask(
+        headerMask, ranges.first, ranges.second);
+  }
+}
+
+/**
+ * Bytes of a pacing burst of the connection, which pacing aware batching
+ * writes as a single GSO batch. 0 if the batches are not sized to the pacer.
+ */
+uint64_t getPacedBatchBytes(const quic::QuicConnectionStateBase& connection) {
+  if (!connection.transportSettings.pacingAwareBatching ||
+      connection.transportSettings.batchingMode !=
+          quic::QuicBatchingMode::BATCHING_MODE_GSO ||
+      !connection.pacer ||
+      (!quic::isConnectionPaced(connection) &&
+       !quic::isConnectionKernelPaced(connection))) {
+    return 0;
+  }
+  return std::min(
+      connection.pacer->getPacingBurstSize() * connection.udpSendPacketLen,
+      quic::kMaxGSOBatchBytes);
+}
+
+std::unique_ptr<quic::BatchWriter> makeBatchWriter(
+    folly::AsyncUDPSocket& sock,
+    const quic::QuicConnectionStateBase& connection) {
+  auto batchSize = connection.transportSettings.maxBatchSize;
+  auto pacedBatchBytes = getPacedBatchBytes(connection);
+  if (pacedBatchBytes) {
+    // The burst bounds the batch rather than maxBatchSize.
+    batchSize = quic::kMaxGSOSegments;
+  }
+  return quic::BatchWriterFactory::makeBatchWriter(
+      sock,
+      connection.transportSettings.batchingMode,
+      batchSize,
+      connection.sharedPacketBatch,
+      connection.zeroCopySendTracker,
+      quic::isConnectionKernelPaced(connection) ? connection.kernelPacer
+                                                : nullptr,
+      pacedBatchBytes);
+}
+
 } // namespace
 
 namespace quic {
@@ -118,11 +206,17 @@ void handleRetransmissionWritten(
     bool frameFin,
     PacketNum packetNum) {
   conn.lossState.totalBytesRetransmitted += frameLen;
-  auto lossBufferIter = std::find_if(
+  // The loss buffer is sorted by offset.
+  auto lossBufferIter = std::lower_bound(
       stream.lossBuffer.begin(),
       stream.lossBuffer.end(),
-      [&](const auto& buffer) { return frameOffset == buffer.offset; });
-  CHECK(lossBufferIter != stream.lossBuffer.end());
+      frameOffset,
+      [](const auto& buffer, const auto& offset) {
+        return buffer.offset < offset;
+      });
+  CHECK(
+      lossBufferIter != stream.lossBuffer.end() &&
+      lossBufferIter->offset == frameOffset);
   VLOG(10) << nodeToString(conn.nodeType) << " sent retransmission"
            << " packetNum=" << packetNum << " " << conn;
   auto bufferLen = lossBufferIter->data.chainLength();
@@ -168,17 +262,23 @@ bool handleStreamWritten(
     return true;
   }
 
-  // If the data is in retx buffer, this is a clone write
-  auto retxBufferIter = std::find_if(
-      stream.retransmissionBuffer.begin(),
-      stream.retransmissionBuffer.end(),
-      [&](const auto& buffer) {
-        return frameOffset == buffer.offset &&
-            frameLen == buffer.data.chainLength() && frameFin == buffer.eof;
-      });
-  if (retxBufferIter != stream.retransmissionBuffer.end()) {
-    conn.lossState.totalStreamBytesCloned += frameLen;
-    return false;
+  // If the data is in retx buffer, this is a clone write. The retx buffer is
+  // sorted by offset, so only the buffers at frameOffset need to be checked.
+  for (auto retxBufferIter = std::lower_bound(
+           stream.retransmissionBuffer.begin(),
+           stream.retransmissionBuffer.end(),
+           frameOffset,
+           [](const auto& buffer, const auto& offset) {
+             return buffer.offset < offset;
+           });
+       retxBufferIter != stream.retransmissionBuffer.end() &&
+       retxBufferIter->offset == frameOffset;
+       ++retxBufferIter) {
+    if (frameLen == retxBufferIter->data.chainLength() &&
+        frameFin == retxBufferIter->eof) {
+      conn.lossState.totalStreamBytesCloned += frameLen;
+      return false;
+    }
   }
 
   // If it's neither new data nor clone data, then it is a retransmission and
@@ -206,7 +306,7 @@ void updateConnection(
   VLOG(10) << nodeToString(conn.nodeType) << " sent packetNum=" << packetNum
            << " in space=" << packetNumberSpace << " size=" << encodedSize
            << " " << conn;
-  if (conn.qLogger) {
+  if (conn.qLogger && conn.qLogger->samplePacket(QLogEventType::PacketSent)) {
     conn.qLogger->addPacket(packet, encodedSize);
   }
   for (const auto& frame : packet.frames) {
@@ -227,9 +327,24 @@ void updateConnection(
           if (newStreamDataWritten) {
             updateFlowControlOnWriteToSocket(*stream, writeStreamFrame.len);
             maybeWriteBlockAfterSocketWrite(*stream);
+            updateStreamSendRate(
+                *stream, writeStreamFrame.len, loopClockNow(conn));
             conn.streamManager->updateWritableStreams(*stream);
+            if (conn.transportSettings.streamSchedulingMode ==
+                StreamSchedulingMode::WeightedFairQueueing) {
+              updateStreamSchedulingQuantum(*stream, writeStreamFrame.len);
+            } else if (stream->priority.incremental) {
+              // The next packet starts from the stream after this one in its
+              // urgency level.
+              auto urgency = stream->priority.urgency;
+              conn.schedulingState.nextScheduledStream[urgency] =
+                  stream->id + 1;
+            }
           }
           conn.streamManager->updateLossStreams(*stream);
+          if (packetNumberSpace == PacketNumberSpace::AppData) {
+            fecOnStreamFrameWritten(conn, *stream, writeStreamFrame, packetNum);
+          }
         },
         [&](const WriteCryptoFrame& writeCryptoFrame) {
           retransmittable = true;
@@ -264,6 +379,9 @@ void updateConnection(
               conn,
               getAckState(conn, packetNumberSpace),
               largestAckedPacketWritten);
+          if (conn.infoCallback) {
+            conn.latencies.ackDelay.add(writeAckFrame.ackDelay);
+          }
         },
         [&](const RstStreamFrame& rstStreamFrame) {
           retransmittable = true;
@@ -304,6 +422,12 @@ void updateConnection(
           onStreamWindowUpdateSent(
               *stream, packetNum, maxStreamDataFrame.maximumData, sentTime);
         },
+        [&](const MaxStreamsFrame& maxStreamsFrame) {
+          retransmittable = true;
+          conn.streamManager->onStreamLimitUpdateSent(
+              maxStreamsFrame.isForBidirectionalStream(),
+              maxStreamsFrame.maxStreams);
+        },
         [&](const StreamDataBlockedFrame& streamBlockedFrame) {
           VLOG(10) << nodeToString(conn.nodeType)
                    << " sent blocked stream frame packetNum=" << packetNum
@@ -327,8 +451,26 @@ void updateConnection(
             updateSimpleFrameOnPacketSent(conn, simpleFrame);
           }
         },
+        [&](const PingFrame&) {
+          retransmittable = true;
+          // PINGs of cloned packets were written for loss recovery.
+          if (!packetEvent.hasValue()) {
+            conn.pendingEvents.sendPing = false;
+          }
+        },
+        [&](const DatagramFrame&) {
+          // Datagrams are ack eliciting and count against the congestion
+          // window, but are dropped once sent rather than retransmitted.
+          retransmittable = true;
+          DCHECK(!packetEvent.hasValue());
+          DCHECK(!conn.datagramState.writeBuffer.empty());
+          conn.datagramState.writeBuffer.pop_front();
+        },
         [&](const auto&) { retransmittable = true; });
   }
+  if (packetNumberSpace == PacketNumberSpace::AppData) {
+    fecOnPacketWritten(conn);
+  }
 
   // TODO: Now pureAck is equivalent to non retransmittable packet. This might
   // change in the future.
@@ -343,14 +485,6 @@ void updateConnection(
   pkt.isAppLimited = conn.congestionController
       ? conn.congestionController->isAppLimited()
       : false;
-  if (conn.lossState.lastAckedTime.hasValue() &&
-      conn.lossState.lastAckedPacketSentTime.hasValue()) {
-    pkt.lastAckedPacketInfo.emplace(
-        *conn.lossState.lastAckedPacketSentTime,
-        *conn.lossState.lastAckedTime,
-        conn.lossState.totalBytesSentAtLastAck,
-        conn.lossState.totalBytesAckedAtLastAck);
-  }
   if (packetEvent) {
     DCHECK(conn.outstandingPacketEvents.count(*packetEvent));
     // CloningScheduler doesn't clone handshake packets or pureAck, and the
@@ -371,7 +505,17 @@ void updateConnection(
       (int)isHandshake,
       (int)pureAck,
       pkt.isAppLimited);
+  QUIC_PROBE(
+      packet_written,
+      conn,
+      static_cast<uint8_t>(packetNumberSpace),
+      packetNum,
+      encodedSize,
+      retransmittable);
   conn.lossState.largestSent = std::max(conn.lossState.largestSent, packetNum);
+  if (conn.pacer && !pureAck) {
+    conn.pacer->onPacketSent();
+  }
   if (conn.congestionController && !pureAck) {
     conn.congestionController->onPacketSent(pkt);
     // An approximation of the app being blocked. The app
@@ -423,6 +567,48 @@ void updateConnection(
     conn.pendingEvents.setLossDetectionAlarm = retransmittable;
   }
   conn.lossState.totalBytesSent += encodedSize;
+  auto& bytesLeft = conn.writeLoopBudget.bytesLeft;
+  if (bytesLeft) {
+    *bytesLeft -= std::min<uint64_t>(*bytesLeft, encodedSize);
+  }
+}
+
+void startWriteLoopBudget(
+    QuicConnectionStateBase& conn,
+    uint64_t numWriters,
+    TimePoint now) {
+  clearWriteLoopBudget(conn);
+  const auto& settings = conn.transportSettings;
+  numWriters = std::max<uint64_t>(numWriters, 1);
+  if (settings.writeLoopTimeBudget.count() > 0) {
+    std::chrono::microseconds timeSlice(
+        settings.writeLoopTimeBudget.count() / numWriters);
+    conn.writeLoopBudget.deadline =
+        now + timeMax(kMinWriteLoopTimeSlice, timeSlice);
+  }
+  if (settings.writeLoopBytesBudget > 0) {
+    // Always leave room for at least one full packet.
+    conn.writeLoopBudget.bytesLeft = std::max<uint64_t>(
+        conn.udpSendPacketLen, settings.writeLoopBytesBudget / numWriters);
+  }
+}
+
+void clearWriteLoopBudget(QuicConnectionStateBase& conn) {
+  conn.writeLoopBudget.deadline = folly::none;
+  conn.writeLoopBudget.bytesLeft = folly::none;
+}
+
+bool writeLoopBudgetExhausted(const QuicConnectionStateBase& conn) {
+  const auto& budget = conn.writeLoopBudget;
+  return (budget.bytesLeft && *budget.bytesLeft == 0) ||
+      (budget.deadline && Clock::now() >= *budget.deadline);
+}
+
+uint64_t getWritePacketLimit(const QuicConnectionStateBase& conn) {
+  if (conn.writeLoopBudget.deadline || conn.writeLoopBudget.bytesLeft) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return conn.transportSettings.writeConnectionDataPacketsLimit;
 }
 
 uint64_t congestionControlWritableBytes(const QuicConnectionStateBase& conn) {
@@ -525,7 +711,8 @@ uint64_t writeQuicDataToSocket(
                                            .windowUpdateFrames()
                                            .blockedFrames()
                                            .cryptoFrames()
-                                           .simpleFrames())
+                                           .simpleFrames()
+                                           .datagramFrames())
                                  .build();
   written += writeConnectionDataToSocket(
       sock,
@@ -540,6 +727,19 @@ uint64_t writeQuicDataToSocket(
       aead,
       headerCipher,
       version);
+  auto probeSize = getPmtuProbeSize(connection, loopClockNow(connection));
+  if (probeSize && written < packetLimit &&
+      congestionControlWritableBytes(connection) >= *probeSize) {
+    written += writePmtuProbeToSocket(
+        sock,
+        connection,
+        srcConnId,
+        dstConnId,
+        aead,
+        headerCipher,
+        version,
+        *probeSize);
+  }
   VLOG_IF(10, written > 0) << nodeToString(connection.nodeType)
                            << " written data to socket packets=" << written
                            << " " << connection;
@@ -639,7 +839,8 @@ uint64_t writeQuicDataExceptCryptoStreamToSocket(
                                            .resetFrames()
                                            .windowUpdateFrames()
                                            .blockedFrames()
-                                           .simpleFrames())
+                                           .simpleFrames()
+                                           .datagramFrames())
                                  .build();
   written += writeConnectionDataToSocket(
       socket,
@@ -709,7 +910,7 @@ uint64_t writeZeroRttDataToSocket(
   return written;
 }
 
-void writeCloseCommon(
+Buf writeCloseCommon(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
     PacketHeader&& header,
@@ -755,7 +956,7 @@ void writeCloseCommon(
   }
   if (written == 0) {
     LOG(ERROR) << "Close frame too large " << connection;
-    return;
+    return nullptr;
   }
   auto packet = std::move(packetBuilder).buildPacket();
   auto body =
@@ -768,7 +969,8 @@ void writeCloseCommon(
   auto packetBuf = std::move(packet.header);
   packetBuf->prependChain(std::move(body));
   auto packetSize = packetBuf->computeChainDataLength();
-  if (connection.qLogger) {
+  if (connection.qLogger &&
+      connection.qLogger->samplePacket(QLogEventType::PacketSent)) {
     connection.qLogger->addPacket(packet.packet, packetSize);
   }
   QUIC_TRACE(
@@ -779,14 +981,38 @@ void writeCloseCommon(
       (uint64_t)packetSize,
       (int)false,
       (int)false);
+  QUIC_PROBE(
+      packet_written,
+      connection,
+      static_cast<uint8_t>(pnSpace),
+      packetNum,
+      packetSize,
+      false);
   VLOG(10) << nodeToString(connection.nodeType)
            << " sent close packetNum=" << packetNum << " in space=" << pnSpace
            << " " << connection;
   // Increment the sequence number.
   // TODO: Do not increase pn if write fails
   increaseNextPacketNum(connection, pnSpace);
+  if (connection.packetCapture) {
+    connection.packetCapture->record(
+        PacketCaptureRing::Direction::Sent,
+        loopClockNow(connection),
+        connection.peerAddress,
+        *packetBuf);
+  }
   // best effort writing to the socket, ignore any errors.
-  auto ret = sock.write(connection.peerAddress, packetBuf);
+  ssize_t ret;
+  if (connection.sharedPacketBatch &&
+      connection.sharedPacketBatch->canBatch(sock)) {
+    // Sent with the closes of the other connections, e.g. on shutdown. The
+    // batch shares the packet rather than copying it.
+    connection.sharedPacketBatch->enqueue(
+        connection.peerAddress, packetBuf->clone());
+    ret = packetSize;
+  } else {
+    ret = sock.write(connection.peerAddress, packetBuf);
+  }
   connection.lossState.totalBytesSent += packetSize;
   if (ret < 0) {
     VLOG(4) << "Error writing connection close " << folly::errnoStr(errno)
@@ -794,9 +1020,10 @@ void writeCloseCommon(
   } else {
     QUIC_STATS(connection.infoCallback, onWrite, ret);
   }
+  return packetBuf;
 }
 
-void writeLongClose(
+Buf writeLongClose(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
     const ConnectionId& srcConnId,
@@ -809,7 +1036,7 @@ void writeLongClose(
   if (!connection.serverConnectionId) {
     // It's possible that servers encountered an error before binding to a
     // connection id.
-    return;
+    return nullptr;
   }
   LongHeader header(
       headerType,
@@ -818,7 +1045,7 @@ void writeLongClose(
       getNextPacketNum(
           connection, longHeaderTypeToPacketNumberSpace(headerType)),
       version);
-  writeCloseCommon(
+  return writeCloseCommon(
       sock,
       connection,
       std::move(header),
@@ -827,7 +1054,7 @@ void writeLongClose(
       headerCipher);
 }
 
-void writeShortClose(
+Buf writeShortClose(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
     const ConnectionId& connId,
@@ -838,7 +1065,7 @@ void writeShortClose(
       ProtectionType::KeyPhaseZero,
       connId,
       getNextPacketNum(connection, PacketNumberSpace::AppData));
-  writeCloseCommon(
+  return writeCloseCommon(
       sock,
       connection,
       std::move(header),
@@ -853,28 +1080,12 @@ void encryptPacketHeader(
     folly::IOBuf& encryptedBody,
     const PacketNumberCipher& headerCipher) {
   // Header encryption.
-  auto packetNumberLength = parsePacketNumberLength(header.data()[0]);
-  Sample sample;
-  size_t sampleBytesToUse = kMaxPacketNumEncodingSize - packetNumberLength;
-  folly::io::Cursor sampleCursor(&encryptedBody);
-  // If there were less than 4 bytes in the packet number, some of the payload
-  // bytes will also be skipped during sampling.
-  sampleCursor.skip(sampleBytesToUse);
-  CHECK(sampleCursor.canAdvance(sample.size())) << "Not enough sample bytes";
-  sampleCursor.pull(sample.data(), sample.size());
-
-  // This should already be a single buffer.
-  header.coalesce();
-  folly::MutableByteRange initialByteRange(header.writableData(), 1);
-  folly::MutableByteRange packetNumByteRange(
-      header.writableData() + header.length() - packetNumberLength,
-      packetNumberLength);
+  auto sample = getHeaderProtectionSample(header, encryptedBody);
+  auto ranges = getHeaderProtectedRanges(header);
   if (headerForm == HeaderForm::Short) {
-    headerCipher.encryptShortHeader(
-        sample, initialByteRange, packetNumByteRange);
+    headerCipher.encryptShortHeader(sample, ranges.first, ranges.second);
   } else {
-    headerCipher.encryptLongHeader(
-        sample, initialByteRange, packetNumByteRange);
+    headerCipher.encryptLongHeader(sample, ranges.first, ranges.second);
   }
 }
 
@@ -896,13 +1107,16 @@ uint64_t writeConnectionDataToSocket(
            << " writing data using scheduler=" << scheduler.name() << " "
            << connection;
 
-  auto batchWriter = BatchWriterFactory::makeBatchWriter(
-      sock,
-      connection.transportSettings.batchingMode,
-      connection.transportSettings.maxBatchSize);
+  if (connection.coalescedPackets &&
+      connection.coalescedPackets->computeChainDataLength() +
+              kMinCoalescedPacketRoom >
+          connection.udpSendPacketLen) {
+    // The datagram got too small for the held packets to take any more.
+    flushCoalescedPackets(sock, connection);
+  }
 
   IOBufQuicBatch ioBufBatch(
-      std::move(batchWriter),
+      makeBatchWriter(sock, connection),
       sock,
       connection.peerAddress,
       connection,
@@ -915,7 +1129,88 @@ uint64_t writeConnectionDataToSocket(
   if (!scheduler.hasData()) {
     connection.debugState.noWriteReason = NoWriteReason::EMPTY_SCHEDULER;
   }
-  while (scheduler.hasData() && ioBufBatch.getPktSent() < packetLimit) {
+  // All the packets of the write loop are sent at the time it starts.
+  auto writeTime = preciseLoopClockNow(connection);
+
+  // Packets that are already accounted for in the connection state but still
+  // have to be encrypted and written, see
+  // TransportSettings::maxEncryptBatchSize. Their packet numbers are
+  // consecutive, starting at firstPendingPacketNum.
+  auto encryptBatchSize = std::max<uint32_t>(
+      connection.transportSettings.maxEncryptBatchSize, 1);
+  // Initial and Handshake packets may be held back to share their datagram
+  // with the packets written after them. Those are built with the room left
+  // in the datagram, which is only known once the held packet is encrypted.
+  bool canCoalesce = connection.transportSettings.coalescePackets &&
+      pnSpace != PacketNumberSpace::AppData;
+  if (canCoalesce) {
+    encryptBatchSize = 1;
+  }
+  // Size of the packets the next packet built is going to be sent with.
+  uint64_t coalescedLen = connection.coalescedPackets
+      ? connection.coalescedPackets->computeChainDataLength()
+      : 0;
+  auto writePacket = [&](Buf packetBuf) {
+    if (connection.coalescedPackets) {
+      auto datagram = std::move(connection.coalescedPackets);
+      datagram->prependChain(std::move(packetBuf));
+      packetBuf = std::move(datagram);
+    }
+    auto datagramSize = packetBuf->computeChainDataLength();
+    if (canCoalesce &&
+        datagramSize + kMinCoalescedPacketRoom <= connection.udpSendPacketLen) {
+      connection.coalescedPackets = std::move(packetBuf);
+      coalescedLen = datagramSize;
+      return true;
+    }
+    return ioBufBatch.write(std::move(packetBuf), datagramSize);
+  };
+  std::vector<AeadBatchEntry> pendingBodies;
+  std::vector<std::pair<HeaderForm, Buf>> pendingHeaders;
+  PacketNum firstPendingPacketNum = 0;
+  auto writePendingPackets = [&]() {
+    if (pendingBodies.empty()) {
+      return true;
+    }
+    aead.encryptBatch(folly::range(pendingBodies), firstPendingPacketNum);
+    // All the header protection masks are computed with one cipher call.
+    std::vector<Sample> samples;
+    samples.reserve(pendingBodies.size());
+    for (size_t i = 0; i < pendingBodies.size(); ++i) {
+      samples.push_back(getHeaderProtectionSample(
+          *pendingHeaders[i].second, *pendingBodies[i].data));
+    }
+    std::vector<HeaderProtectionMask> masks(samples.size());
+    headerCipher.masks(folly::range(samples), folly::range(masks));
+    // Once a write fails the rest of the batch is dropped. The packets are
+    // already outstanding, so loss recovery takes care of them.
+    bool ret = true;
+    for (size_t i = 0; i < pendingBodies.size() && ret; ++i) {
+      auto& header = pendingHeaders[i].second;
+      auto& body = pendingBodies[i].data;
+      encryptPacketHeaderWithMask(
+          pendingHeaders[i].first, *header, masks[i], headerCipher);
+      auto packetBuf =
+          joinPacketHeaderAndBody(std::move(header), std::move(body));
+      auto encodedSize = packetBuf->computeChainDataLength();
+      ret = writePacket(std::move(packetBuf));
+      if (ret) {
+        QUIC_STATS(connection.infoCallback, onWrite, encodedSize);
+        QUIC_STATS(connection.infoCallback, onPacketSent);
+      }
+    }
+    pendingBodies.clear();
+    pendingHeaders.clear();
+    return ret;
+  };
+
+  while (scheduler.hasData() &&
+         ioBufBatch.getPktSent() + pendingBodies.size() < packetLimit) {
+    if (writeLoopBudgetExhausted(connection)) {
+      // Leave the rest to the next loop so other transports get their turn.
+      connection.debugState.noWriteReason = NoWriteReason::WRITE_BUDGET;
+      break;
+    }
     auto packetNum = getNextPacketNum(connection, pnSpace);
     auto header = builder(
         srcConnId,
@@ -923,8 +1218,10 @@ uint64_t writeConnectionDataToSocket(
         packetNum,
         version,
         token ? token->clone() : nullptr);
-    uint32_t writableBytes = folly::to<uint32_t>(std::min<uint64_t>(
-        connection.udpSendPacketLen, writableBytesFunc(connection)));
+    auto packetLen = connection.udpSendPacketLen - coalescedLen;
+    coalescedLen = 0;
+    uint32_t writableBytes = folly::to<uint32_t>(
+        std::min<uint64_t>(packetLen, writableBytesFunc(connection)));
     uint64_t cipherOverhead = aead.getCipherOverhead();
     if (writableBytes < cipherOverhead) {
       writableBytes = 0;
@@ -932,39 +1229,73 @@ uint64_t writeConnectionDataToSocket(
       writableBytes -= cipherOverhead;
     }
     RegularQuicPacketBuilder pktBuilder(
-        connection.udpSendPacketLen,
+        packetLen,
         std::move(header),
         getAckState(connection, pnSpace).largestAckedByPeer,
         connection.version.value_or(*connection.originalVersion));
     pktBuilder.setCipherOverhead(cipherOverhead);
+    if (connection.transportSettings.contiguousPacketBuffers) {
+      pktBuilder.useContiguousBuffer(connection.bufferArena);
+    }
     auto result =
         scheduler.scheduleFramesForPacket(std::move(pktBuilder), writableBytes);
     auto& packet = result.second;
     if (!packet || packet->packet.frames.empty()) {
+      connection.debugState.noWriteReason = writePendingPackets()
+          ? NoWriteReason::NO_FRAME
+          : NoWriteReason::SOCKET_FAILURE;
       ioBufBatch.flush();
-      connection.debugState.noWriteReason = NoWriteReason::NO_FRAME;
       return ioBufBatch.getPktSent();
     }
     if (!packet->body) {
       // No more space remaining.
+      connection.debugState.noWriteReason = writePendingPackets()
+          ? NoWriteReason::NO_BODY
+          : NoWriteReason::SOCKET_FAILURE;
       ioBufBatch.flush();
-      connection.debugState.noWriteReason = NoWriteReason::NO_BODY;
       return ioBufBatch.getPktSent();
     }
-    auto body =
-        aead.encrypt(std::move(packet->body), packet->header.get(), packetNum);
-
     HeaderForm headerForm = folly::variant_match(
         packet->packet.header,
         [](const LongHeader&) { return HeaderForm::Long; },
         [](const ShortHeader&) { return HeaderForm::Short; });
+
+    if (encryptBatchSize > 1) {
+      // Defer the encryption, the size of the packet is known up front since
+      // the aead adds a fixed overhead.
+      auto encodedSize = packet->header->computeChainDataLength() +
+          packet->body->computeChainDataLength() + cipherOverhead;
+      if (pendingBodies.empty()) {
+        firstPendingPacketNum = packetNum;
+      }
+      DCHECK_EQ(firstPendingPacketNum + pendingBodies.size(), packetNum);
+      AeadBatchEntry entry;
+      entry.data = std::move(packet->body);
+      entry.associatedData = packet->header.get();
+      pendingBodies.push_back(std::move(entry));
+      pendingHeaders.emplace_back(headerForm, std::move(packet->header));
+      updateConnection(
+          connection,
+          std::move(result.first),
+          std::move(result.second->packet),
+          writeTime,
+          folly::to<uint32_t>(encodedSize));
+      if (pendingBodies.size() >= encryptBatchSize && !writePendingPackets()) {
+        connection.debugState.noWriteReason = NoWriteReason::SOCKET_FAILURE;
+        return ioBufBatch.getPktSent();
+      }
+      continue;
+    }
+
+    auto body =
+        aead.encrypt(std::move(packet->body), packet->header.get(), packetNum);
     encryptPacketHeader(headerForm, *packet->header, *body, headerCipher);
 
-    auto packetBuf = std::move(packet->header);
-    packetBuf->prependChain(std::move(body));
+    auto packetBuf =
+        joinPacketHeaderAndBody(std::move(packet->header), std::move(body));
     auto encodedSize = packetBuf->computeChainDataLength();
 
-    bool ret = ioBufBatch.write(std::move(packetBuf), encodedSize);
+    bool ret = writePacket(std::move(packetBuf));
 
     if (ret) {
       // update stats and connection
@@ -976,7 +1307,7 @@ uint64_t writeConnectionDataToSocket(
         connection,
         std::move(result.first),
         std::move(result.second->packet),
-        Clock::now(),
+        writeTime,
         folly::to<uint32_t>(encodedSize));
 
     // if ioBufBatch.write returns false
@@ -987,10 +1318,103 @@ uint64_t writeConnectionDataToSocket(
     }
   }
 
+  if (!writePendingPackets()) {
+    connection.debugState.noWriteReason = NoWriteReason::SOCKET_FAILURE;
+    return ioBufBatch.getPktSent();
+  }
   ioBufBatch.flush();
   return ioBufBatch.getPktSent();
 }
 
+uint64_t writePmtuProbeToSocket(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection,
+    const ConnectionId& srcConnId,
+    const ConnectionId& dstConnId,
+    const Aead& aead,
+    const PacketNumberCipher& headerCipher,
+    QuicVersion version,
+    uint64_t probeSize) {
+  auto packetNum = getNextPacketNum(connection, PacketNumberSpace::AppData);
+  auto header =
+      ShortHeaderBuilder()(srcConnId, dstConnId, packetNum, version, nullptr);
+  RegularQuicPacketBuilder builder(
+      probeSize,
+      std::move(header),
+      getAckState(connection, PacketNumberSpace::AppData).largestAckedByPeer,
+      connection.version.value_or(*connection.originalVersion));
+  builder.setCipherOverhead(aead.getCipherOverhead());
+  if (writeFrame(PingFrame(), builder) == 0) {
+    return 0;
+  }
+  // PADDING frames are single zero bytes, so the padding is written in one go
+  // rather than as one frame per byte.
+  auto paddingLen = builder.remainingSpaceInPkt();
+  if (paddingLen > 0) {
+    auto padding = folly::IOBuf::create(paddingLen);
+    memset(padding->writableTail(), 0, paddingLen);
+    padding->append(paddingLen);
+    builder.insert(std::move(padding));
+    builder.appendFrame(PaddingFrame());
+  }
+  auto packet = std::move(builder).buildPacket();
+  auto body =
+      aead.encrypt(std::move(packet.body), packet.header.get(), packetNum);
+  encryptPacketHeader(HeaderForm::Short, *packet.header, *body, headerCipher);
+  auto packetBuf =
+      joinPacketHeaderAndBody(std::move(packet.header), std::move(body));
+  auto encodedSize = packetBuf->computeChainDataLength();
+
+  IOBufQuicBatch ioBufBatch(
+      makeBatchWriter(sock, connection),
+      sock,
+      connection.peerAddress,
+      connection,
+      connection.happyEyeballsState);
+  ioBufBatch.setContinueOnNetworkUnreachable(
+      connection.transportSettings.continueOnNetworkUnreachable);
+  VLOG(10) << nodeToString(connection.nodeType)
+           << " sending path MTU probe size=" << encodedSize << " "
+           << connection;
+  bool ret = ioBufBatch.write(std::move(packetBuf), encodedSize) &&
+      ioBufBatch.flush();
+  if (ret) {
+    QUIC_STATS(connection.infoCallback, onWrite, encodedSize);
+    QUIC_STATS(connection.infoCallback, onPacketSent);
+  }
+  // A probe that can't be sent counts as lost once loss detection gets to it,
+  // just like one dropped by the path.
+  updateConnection(
+      connection,
+      folly::none,
+      std::move(packet.packet),
+      loopClockNow(connection),
+      folly::to<uint32_t>(encodedSize));
+  onPmtuProbeSent(connection, packetNum, probeSize);
+  return ioBufBatch.getPktSent();
+}
+
+void flushCoalescedPackets(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection) {
+  if (!connection.coalescedPackets) {
+    return;
+  }
+  IOBufQuicBatch ioBufBatch(
+      makeBatchWriter(sock, connection),
+      sock,
+      connection.peerAddress,
+      connection,
+      connection.happyEyeballsState);
+  ioBufBatch.setContinueOnNetworkUnreachable(
+      connection.transportSettings.continueOnNetworkUnreachable);
+  auto datagram = std::move(connection.coalescedPackets);
+  auto datagramSize = datagram->computeChainDataLength();
+  if (ioBufBatch.write(std::move(datagram), datagramSize)) {
+    ioBufBatch.flush();
+  }
+}
+
 uint64_t writeProbingDataToSocket(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
@@ -1035,6 +1459,12 @@ WriteDataReason shouldWriteData(const QuicConnectionStateBase& conn) {
              << conn;
     return WriteDataReason::ACK;
   }
+  // Check for pending data before asking the congestion controller: an idle
+  // connection has nothing to write and isn't blocked by cwnd either.
+  auto nonAckDataReason = hasNonAckDataToWrite(conn);
+  if (nonAckDataReason == WriteDataReason::NO_WRITE) {
+    return WriteDataReason::NO_WRITE;
+  }
   const size_t minimumDataSize = std::max(
       kLongHeaderHeaderSize + kCipherOverheadHeuristic, sizeof(Sample));
   if (conn.writableBytesLimit &&
@@ -1049,7 +1479,40 @@ WriteDataReason shouldWriteData(const QuicConnectionStateBase& conn) {
     QUIC_STATS(conn.infoCallback, onCwndBlocked);
     return WriteDataReason::NO_WRITE;
   }
-  return hasNonAckDataToWrite(conn);
+  return nonAckDataReason;
+}
+
+WriteLimiter getWriteLimiter(
+    const QuicConnectionStateBase& conn,
+    TimePoint now) {
+  if (conn.flowControlState.sumCurStreamBufferLen == 0 &&
+      !conn.streamManager->hasLoss()) {
+    return WriteLimiter::App;
+  }
+  if (getSendConnFlowControlBytesWire(conn) == 0) {
+    return WriteLimiter::ConnFlowControl;
+  }
+  if (!conn.streamManager->hasWritable() && !conn.streamManager->hasLoss()) {
+    return WriteLimiter::StreamFlowControl;
+  }
+  const size_t minimumDataSize = std::max(
+      kLongHeaderHeaderSize + kCipherOverheadHeuristic, sizeof(Sample));
+  if (conn.writableBytesLimit &&
+      (*conn.writableBytesLimit <= conn.lossState.totalBytesSent ||
+       *conn.writableBytesLimit - conn.lossState.totalBytesSent <=
+           minimumDataSize)) {
+    return WriteLimiter::Cwnd;
+  }
+  if (conn.congestionController &&
+      conn.congestionController->getWritableBytes() <= minimumDataSize) {
+    return WriteLimiter::Cwnd;
+  }
+  if (conn.pacer && isConnectionPaced(conn) &&
+      conn.pacer->getTimeUntilNextWrite(now) >
+          std::chrono::microseconds::zero()) {
+    return WriteLimiter::Pacing;
+  }
+  return WriteLimiter::None;
 }
 
 bool hasAckDataToWrite(const QuicConnectionStateBase& conn) {
@@ -1071,6 +1534,12 @@ bool hasAckDataToWrite(const QuicConnectionStateBase& conn) {
   return writeAcks;
 }
 
+bool hasOnlyAppDataAckToWrite(const QuicConnectionStateBase& conn) {
+  return !conn.pendingEvents.numProbePackets && toWriteAppDataAcks(conn) &&
+      !toWriteInitialAcks(conn) && !toWriteHandshakeAcks(conn) &&
+      hasNonAckDataToWrite(conn) == WriteDataReason::NO_WRITE;
+}
+
 WriteDataReason hasNonAckDataToWrite(const QuicConnectionStateBase& conn) {
   if (cryptoHasWritableData(conn)) {
     VLOG(10) << nodeToString(conn.nodeType)
@@ -1086,12 +1555,18 @@ WriteDataReason hasNonAckDataToWrite(const QuicConnectionStateBase& conn) {
   if (!conn.pendingEvents.resets.empty()) {
     return WriteDataReason::RESET;
   }
-  if (conn.streamManager->hasWindowUpdates()) {
+  // Deferred window updates go out with whatever is sent next.
+  bool windowUpdatesDue = !conn.transportSettings.deferWindowUpdates ||
+      conn.pendingEvents.urgentWindowUpdate;
+  if (windowUpdatesDue && conn.streamManager->hasWindowUpdates()) {
     return WriteDataReason::STREAM_WINDOW_UPDATE;
   }
-  if (conn.pendingEvents.connWindowUpdate) {
+  if (windowUpdatesDue && conn.pendingEvents.connWindowUpdate) {
     return WriteDataReason::CONN_WINDOW_UPDATE;
   }
+  if (conn.streamManager->hasStreamLimitUpdates()) {
+    return WriteDataReason::STREAM_LIMIT_UPDATE;
+  }
   if (conn.streamManager->hasBlocked()) {
     return WriteDataReason::BLOCKED;
   }
@@ -1108,6 +1583,33 @@ WriteDataReason hasNonAckDataToWrite(const QuicConnectionStateBase& conn) {
   if ((conn.pendingEvents.pathChallenge != folly::none)) {
     return WriteDataReason::PATHCHALLENGE;
   }
+  if (!conn.datagramState.writeBuffer.empty()) {
+    return WriteDataReason::DATAGRAM;
+  }
+  if (conn.pendingEvents.sendPing) {
+    return WriteDataReason::PING;
+  }
   return WriteDataReason::NO_WRITE;
 }
+
+bool isAppLimited(const QuicConnectionStateBase& conn) {
+  if (!conn.congestionController ||
+      conn.congestionController->getWritableBytes() < conn.udpSendPacketLen) {
+    return false;
+  }
+  if (conn.writableBytesLimit &&
+      *conn.writableBytesLimit <=
+          conn.lossState.totalBytesSent + conn.udpSendPacketLen) {
+    return false;
+  }
+  if (conn.pendingEvents.numProbePackets || conn.streamManager->hasLoss() ||
+      !conn.cryptoState->initialStream.lossBuffer.empty() ||
+      !conn.cryptoState->handshakeStream.lossBuffer.empty() ||
+      !conn.cryptoState->oneRttStream.lossBuffer.empty()) {
+    return false;
+  }
+  // Data waiting for a write budget, the pacer or the packet limit of the
+  // write loop could have been sent.
+  return hasNonAckDataToWrite(conn) == WriteDataReason::NO_WRITE;
+}
 } // namespace quic
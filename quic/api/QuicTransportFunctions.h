@@ -96,9 +96,52 @@ uint64_t writeZeroRttDataToSocket(
  * TODO: We should probably split "should" and "can" into two APIs.
  */
 WriteDataReason shouldWriteData(const QuicConnectionStateBase& conn);
+
+/**
+ * What is keeping the connection from writing more stream data at now, if
+ * anything, for updateWriteLimiter.
+ */
+WriteLimiter getWriteLimiter(
+    const QuicConnectionStateBase& conn,
+    TimePoint now);
 bool hasAckDataToWrite(const QuicConnectionStateBase& conn);
 WriteDataReason hasNonAckDataToWrite(const QuicConnectionStateBase& conn);
 
+/**
+ * Whether the next packet written would only carry an ack of app data
+ * packets, i.e. there are no probes, handshake acks or other data to write.
+ */
+bool hasOnlyAppDataAckToWrite(const QuicConnectionStateBase& conn);
+
+/**
+ * Whether the connection is limited by the application rather than by the
+ * congestion controller, i.e. the schedulers have nothing left to write while
+ * the congestion window still has room for a full packet. Acks don't count,
+ * and neither does data that is held back by the amplification limit or whose
+ * loss is still to be retransmitted.
+ */
+bool isAppLimited(const QuicConnectionStateBase& conn);
+
+/**
+ * Start the write budget of a write, splitting the per loop budgets of
+ * TransportSettings between numWriters transports. Does nothing if the budgets
+ * are disabled.
+ */
+void startWriteLoopBudget(
+    QuicConnectionStateBase& conn,
+    uint64_t numWriters,
+    TimePoint now);
+
+void clearWriteLoopBudget(QuicConnectionStateBase& conn);
+
+bool writeLoopBudgetExhausted(const QuicConnectionStateBase& conn);
+
+/**
+ * The number of packets an unpaced connection may write. Unlimited while a
+ * write budget is in place, since the budget bounds the write instead.
+ */
+uint64_t getWritePacketLimit(const QuicConnectionStateBase& conn);
+
 /**
  * Invoked when the written stream data was new stream data.
  */
@@ -149,7 +192,11 @@ uint64_t congestionControlWritableBytes(const QuicConnectionStateBase& conn);
 
 uint64_t unlimitedWritableBytes(const QuicConnectionStateBase&);
 
-void writeCloseCommon(
+/**
+ * Writes a packet with a close frame, and returns it, or nullptr if the
+ * frame didn't fit.
+ */
+Buf writeCloseCommon(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
     PacketHeader&& header,
@@ -160,8 +207,9 @@ void writeCloseCommon(
 /**
  * Writes a LongHeader packet with a close frame.
  * The close frame type written depends on the type of error in closeDetails.
+ * Returns the packet written, if any.
  */
-void writeLongClose(
+Buf writeLongClose(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
     const ConnectionId& srcConnId,
@@ -175,8 +223,9 @@ void writeLongClose(
 /**
  * Write a short header packet with a close frame.
  * The close frame type written depends on the type of error in closeDetails.
+ * Returns the packet written, if any.
  */
-void writeShortClose(
+Buf writeShortClose(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
     const ConnectionId& connId,
@@ -218,6 +267,29 @@ uint64_t writeConnectionDataToSocket(
     QuicVersion version,
     Buf token = nullptr);
 
+/**
+ * Writes a PING packet padded to probeSize to search the path MTU, see
+ * QuicConnectionStateBase::PmtuDiscoveryState. The probe is tracked as an
+ * outstanding packet. Returns the number of packets written.
+ */
+uint64_t writePmtuProbeToSocket(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection,
+    const ConnectionId& srcConnId,
+    const ConnectionId& dstConnId,
+    const Aead& aead,
+    const PacketNumberCipher& headerCipher,
+    QuicVersion version,
+    uint64_t probeSize);
+
+/**
+ * Sends the packets held back in connection.coalescedPackets, if any. They
+ * otherwise only go out together with the next packet written.
+ */
+void flushCoalescedPackets(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection);
+
 uint64_t writeProbingDataToSocket(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicWriteScheduler.h>
+
+#include <quic/api/QuicBatchWriter.h>
+
+namespace quic {
+
+QuicWriteScheduler::QuicWriteScheduler(
+    folly::EventBase* evb,
+    SharedPacketBatch* sharedBatch)
+    : evb_(evb), sharedBatch_(sharedBatch) {}
+
+QuicWriteScheduler::~QuicWriteScheduler() {
+  queue_.clear();
+  pass_.clear();
+  cancelLoopCallback();
+}
+
+void QuicWriteScheduler::schedule(Writer& writer, bool thisIteration) {
+  if (!isScheduled(writer)) {
+    queue_.push_back(writer);
+  }
+  if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this, thisIteration);
+  }
+}
+
+void QuicWriteScheduler::unschedule(Writer& writer) {
+  if (isScheduled(writer)) {
+    writer.writeSchedulerHook_.unlink();
+  }
+}
+
+bool QuicWriteScheduler::isScheduled(const Writer& writer) const {
+  return writer.writeSchedulerHook_.is_linked();
+}
+
+void QuicWriteScheduler::runLoopCallback() noexcept {
+  // Writers queued while the pass runs, including the ones that still have
+  // data after their turn, wait for the next pass.
+  pass_.splice(pass_.end(), queue_);
+  while (!pass_.empty()) {
+    auto& writer = pass_.front();
+    pass_.pop_front();
+    writer.onScheduledWrite();
+  }
+  if (sharedBatch_) {
+    sharedBatch_->flush();
+  }
+}
+
+} // namespace quic
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/IntrusiveList.h>
+#include <folly/io/async/EventBase.h>
+
+namespace quic {
+
+class SharedPacketBatch;
+
+/**
+ * Write scheduler shared by all the connections of a worker. Instead of each
+ * connection running its own write looper, connections with data to send
+ * queue themselves here and the scheduler services all of them in a single
+ * loop callback per event loop iteration.
+ *
+ * Connections are serviced round robin: each one gets to write once per pass,
+ * bounded by its own write budget, and a connection that still has data after
+ * its turn goes to the back of the queue for the next pass. Connections that
+ * queue themselves while a pass is running are serviced in the next one. When
+ * a SharedPacketBatch is given, the packets of the whole pass are flushed
+ * together once all the connections had their turn.
+ */
+class QuicWriteScheduler : public folly::EventBase::LoopCallback {
+ public:
+  class Writer {
+   public:
+    virtual ~Writer() = default;
+
+    // Called when it is the writer's turn to write.
+    virtual void onScheduledWrite() noexcept = 0;
+
+   private:
+    friend class QuicWriteScheduler;
+    folly::IntrusiveListHook writeSchedulerHook_;
+  };
+
+  QuicWriteScheduler(
+      folly::EventBase* evb,
+      SharedPacketBatch* sharedBatch = nullptr);
+  ~QuicWriteScheduler() override;
+
+  /**
+   * Queues the writer for the next pass. Does nothing if the writer is
+   * already queued. With thisIteration set, the pass runs in the current loop
+   * iteration when possible.
+   */
+  void schedule(Writer& writer, bool thisIteration = false);
+
+  // Removes the writer from the queue, if it is queued.
+  void unschedule(Writer& writer);
+
+  bool isScheduled(const Writer& writer) const;
+
+  // number of writers waiting for their turn
+  size_t size() const {
+    return queue_.size() + pass_.size();
+  }
+
+  void runLoopCallback() noexcept override;
+
+ private:
+  using WriterList =
+      folly::IntrusiveList<Writer, &Writer::writeSchedulerHook_>;
+
+  folly::EventBase* evb_;
+  SharedPacketBatch* sharedBatch_;
+  // Writers waiting for the next pass.
+  WriterList queue_;
+  // Writers that haven't had their turn in the running pass.
+  WriterList pass_;
+};
+
+} // namespace quic
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicZeroCopy.h>
+
+#include <folly/net/NetOps.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#endif
+
+namespace quic {
+
+std::unique_ptr<ZeroCopySendTracker> ZeroCopySendTracker::create(
+    FOLLY_MAYBE_UNUSED folly::NetworkSocket sock,
+    FOLLY_MAYBE_UNUSED size_t threshold) {
+#ifdef SO_ZEROCOPY
+  int val = 1;
+  if (folly::netops::setsockopt(
+          sock, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) == 0) {
+    return std::make_unique<ZeroCopySendTracker>(sock, threshold);
+  }
+#endif
+  return nullptr;
+}
+
+ZeroCopySendTracker::ZeroCopySendTracker(
+    folly::NetworkSocket sock,
+    size_t threshold)
+    : sock_(sock), threshold_(threshold) {}
+
+ssize_t ZeroCopySendTracker::writeGSO(
+    FOLLY_MAYBE_UNUSED const folly::SocketAddress& address,
+    FOLLY_MAYBE_UNUSED const std::unique_ptr<folly::IOBuf>& buf,
+    FOLLY_MAYBE_UNUSED int gso) {
+#ifdef MSG_ZEROCOPY
+  sockaddr_storage addr;
+  std::vector<iovec> iov;
+  for (auto range : *buf) {
+    if (!range.empty()) {
+      iov.push_back({const_cast<uint8_t*>(range.data()), range.size()});
+    }
+  }
+  char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+  msghdr msg = {};
+  msg.msg_name = &addr;
+  msg.msg_namelen = address.getAddress(&addr);
+  msg.msg_iov = iov.data();
+  msg.msg_iovlen = iov.size();
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  auto cm = CMSG_FIRSTHDR(&msg);
+  cm->cmsg_level = SOL_UDP;
+  cm->cmsg_type = UDP_SEGMENT;
+  cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+  auto gsoSize = static_cast<uint16_t>(gso);
+  memcpy(CMSG_DATA(cm), &gsoSize, sizeof(gsoSize));
+
+  auto ret = folly::netops::sendmsg(sock_, &msg, MSG_ZEROCOPY);
+  if (ret >= 0) {
+    // Only successful sends consume a completion sequence number.
+    pending_.emplace_back(nextSeq_++, buf->clone());
+  }
+  return ret;
+#else
+  errno = ENOTSUP;
+  return -1;
+#endif
+}
+
+bool ZeroCopySendTracker::onErrMessage(FOLLY_MAYBE_UNUSED const cmsghdr& cmsg) {
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+  if (!((cmsg.cmsg_level == SOL_IP && cmsg.cmsg_type == IP_RECVERR) ||
+        (cmsg.cmsg_level == SOL_IPV6 && cmsg.cmsg_type == IPV6_RECVERR))) {
+    return false;
+  }
+  const struct sock_extended_err* serr =
+      reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(&cmsg));
+  if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+    return false;
+  }
+  // The completion covers the inclusive range [ee_info, ee_data], which may
+  // wrap around.
+  uint32_t lo = serr->ee_info;
+  uint32_t hi = serr->ee_data;
+  pending_.erase(
+      std::remove_if(
+          pending_.begin(),
+          pending_.end(),
+          [lo, hi](const auto& entry) {
+            return entry.first - lo <= hi - lo;
+          }),
+      pending_.end());
+  return true;
+#else
+  return false;
+#endif
+}
+
+} // namespace quic
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+#include <folly/net/NetworkSocket.h>
+#include <folly/portability/Sockets.h>
+
+#include <deque>
+
+namespace quic {
+
+/**
+ * Sends large GSO batches with MSG_ZEROCOPY on one socket and keeps their
+ * buffers alive until the kernel reports, through the socket error queue,
+ * that it no longer references them.
+ */
+class ZeroCopySendTracker {
+ public:
+  /**
+   * Turns SO_ZEROCOPY on for the socket. Returns nullptr if the platform or
+   * the kernel does not support it.
+   */
+  static std::unique_ptr<ZeroCopySendTracker> create(
+      folly::NetworkSocket sock,
+      size_t threshold);
+
+  ZeroCopySendTracker(folly::NetworkSocket sock, size_t threshold);
+
+  folly::NetworkSocket getNetworkSocket() const {
+    return sock_;
+  }
+
+  // returns true if a batch of the given size should be sent with zero copy
+  bool shouldUseZeroCopy(size_t size) const {
+    return size >= threshold_;
+  }
+
+  /**
+   * Writes buf in segments of gso bytes with MSG_ZEROCOPY. A reference to
+   * the buffer is held until its completion is received. Returns the result
+   * of sendmsg.
+   */
+  ssize_t writeGSO(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf,
+      int gso);
+
+  /**
+   * Processes a message from the socket error queue. Returns true if it was a
+   * zero copy completion, in which case the completed buffers are released.
+   */
+  bool onErrMessage(const cmsghdr& cmsg);
+
+  // number of buffers still referenced by the kernel
+  size_t numPendingBuffers() const {
+    return pending_.size();
+  }
+
+ private:
+  folly::NetworkSocket sock_;
+  size_t threshold_;
+  // sequence number the kernel assigns to the next zero copy send
+  uint32_t nextSeq_{0};
+  std::deque<std::pair<uint32_t, std::unique_ptr<folly::IOBuf>>> pending_;
+};
+
+} // namespace quic
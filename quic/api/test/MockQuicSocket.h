@@ -66,6 +66,7 @@ class MockQuicSocket : public QuicSocket {
       getStreamFlowControl,
       folly::Expected<FlowControlState, LocalErrorCode>(StreamId));
   MOCK_METHOD0(unsetAllReadCallbacks, void());
+  MOCK_METHOD1(setConnectionReadCallback, void(ConnectionReadCallback*));
   MOCK_METHOD0(unsetAllPeekCallbacks, void());
   MOCK_METHOD0(unsetAllDeliveryCallbacks, void());
   MOCK_METHOD1(cancelDeliveryCallbacksForStream, void(StreamId));
@@ -97,6 +98,9 @@ class MockQuicSocket : public QuicSocket {
   MOCK_METHOD1(
       resumeRead,
       folly::Expected<folly::Unit, LocalErrorCode>(StreamId));
+  MOCK_METHOD2(
+      setReadPushDelivery,
+      folly::Expected<folly::Unit, LocalErrorCode>(StreamId, bool));
   MOCK_METHOD2(
       stopSending,
       folly::Expected<folly::Unit, LocalErrorCode>(
@@ -115,12 +119,31 @@ class MockQuicSocket : public QuicSocket {
   using ReadResult =
       folly::Expected<std::pair<folly::IOBuf*, bool>, LocalErrorCode>;
   MOCK_METHOD2(readNaked, ReadResult(StreamId, size_t));
+  folly::Expected<std::pair<Buf, bool>, LocalErrorCode> readZeroCopy(
+      StreamId id) override {
+    auto res = readZeroCopyNaked(id);
+    if (res.hasError()) {
+      return folly::makeUnexpected(res.error());
+    } else {
+      return std::pair<Buf, bool>(Buf(res.value().first), res.value().second);
+    }
+  }
+  MOCK_METHOD1(readZeroCopyNaked, ReadResult(StreamId));
+  MOCK_METHOD2(
+      releaseRead,
+      folly::Expected<folly::Unit, LocalErrorCode>(StreamId, size_t));
   MOCK_METHOD1(
       createBidirectionalStream,
       folly::Expected<StreamId, LocalErrorCode>(bool));
   MOCK_METHOD1(
       createUnidirectionalStream,
       folly::Expected<StreamId, LocalErrorCode>(bool));
+  MOCK_METHOD1(
+      createBidirectionalStreams,
+      folly::Expected<std::vector<StreamId>, LocalErrorCode>(uint64_t));
+  MOCK_METHOD1(
+      createUnidirectionalStreams,
+      folly::Expected<std::vector<StreamId>, LocalErrorCode>(uint64_t));
   MOCK_CONST_METHOD0(getNumOpenableBidirectionalStreams, uint64_t());
   MOCK_CONST_METHOD0(getNumOpenableUnidirectionalStreams, uint64_t());
   GMOCK_METHOD1_(, noexcept, , isClientStream, bool(StreamId));
@@ -133,12 +156,20 @@ class MockQuicSocket : public QuicSocket {
   MOCK_METHOD2(
       notifyPendingWriteOnStream,
       folly::Expected<folly::Unit, LocalErrorCode>(StreamId, WriteCallback*));
+  MOCK_METHOD0(getMaxWritableOnConnection, uint64_t());
+  MOCK_METHOD1(
+      getMaxWritableOnStream,
+      folly::Expected<uint64_t, LocalErrorCode>(StreamId));
+  MOCK_METHOD2(
+      reserveWriteSpace,
+      folly::Expected<uint64_t, LocalErrorCode>(StreamId, uint64_t));
   folly::Expected<Buf, LocalErrorCode> writeChain(
       StreamId id,
       Buf data,
       bool eof,
       bool cork,
-      DeliveryCallback* cb) override {
+      DeliveryCallback* cb,
+      folly::Optional<TimePoint> /*deadline*/) override {
     SharedBuf sharedData(data.release());
     auto res = writeChain(id, sharedData, eof, cork, cb);
     if (res.hasError()) {
@@ -151,12 +182,35 @@ class MockQuicSocket : public QuicSocket {
   MOCK_METHOD5(
       writeChain,
       WriteResult(StreamId, SharedBuf, bool, bool, DeliveryCallback*));
+  MOCK_METHOD1(
+      writeChains,
+      folly::Expected<folly::Unit, LocalErrorCode>(
+          folly::Range<StreamWrite*>));
+  folly::Expected<folly::Unit, LocalErrorCode> writeFromSource(
+      StreamId id,
+      std::unique_ptr<StreamWriteSource> source,
+      bool eof,
+      DeliveryCallback* cb) override {
+    return writeFromSourceNaked(id, source.get(), eof, cb);
+  }
+  MOCK_METHOD4(
+      writeFromSourceNaked,
+      folly::Expected<folly::Unit, LocalErrorCode>(
+          StreamId,
+          StreamWriteSource*,
+          bool,
+          DeliveryCallback*));
   MOCK_METHOD3(
       registerDeliveryCallback,
       folly::Expected<folly::Unit, LocalErrorCode>(
           StreamId,
           uint64_t,
           DeliveryCallback*));
+  MOCK_METHOD2(
+      setAggregatedDeliveryCallback,
+      folly::Expected<folly::Unit, LocalErrorCode>(
+          StreamId,
+          DeliveryCallback*));
 
   MOCK_METHOD1(shutdownWrite, folly::Optional<LocalErrorCode>(StreamId));
   MOCK_METHOD2(
@@ -173,6 +227,15 @@ class MockQuicSocket : public QuicSocket {
   MOCK_METHOD1(attachEventBase, void(folly::EventBase*));
   MOCK_METHOD0(detachEventBase, void());
   MOCK_METHOD1(setControlStream, folly::Optional<LocalErrorCode>(StreamId));
+  MOCK_METHOD3(
+      setStreamPriority,
+      folly::Optional<LocalErrorCode>(StreamId, uint8_t, bool));
+  MOCK_METHOD2(
+      setStreamWeight,
+      folly::Optional<LocalErrorCode>(StreamId, uint16_t));
+  MOCK_METHOD2(
+      setStreamSendRate,
+      folly::Optional<LocalErrorCode>(StreamId, uint64_t));
 
   MOCK_METHOD2(
       setPeekCallback,
@@ -228,6 +291,34 @@ class MockQuicSocket : public QuicSocket {
           StreamId,
           uint64_t offset));
 
+  MOCK_METHOD1(
+      setDatagramCallback,
+      folly::Expected<folly::Unit, LocalErrorCode>(DatagramCallback*));
+  MOCK_CONST_METHOD0(getDatagramSizeLimit, uint16_t());
+  folly::Expected<folly::Unit, LocalErrorCode> writeDatagram(
+      Buf buf) override {
+    SharedBuf sharedBuf(buf.release());
+    return writeDatagramRaw(sharedBuf);
+  }
+  MOCK_METHOD1(
+      writeDatagramRaw,
+      folly::Expected<folly::Unit, LocalErrorCode>(SharedBuf));
+  folly::Expected<std::vector<Buf>, LocalErrorCode> readDatagrams(
+      size_t atMost) override {
+    auto res = readDatagramsNaked(atMost);
+    if (res.hasError()) {
+      return folly::makeUnexpected(res.error());
+    }
+    std::vector<Buf> datagrams;
+    for (auto datagram : res.value()) {
+      datagrams.emplace_back(datagram);
+    }
+    return datagrams;
+  }
+  using ReadDatagramsResult =
+      folly::Expected<std::vector<folly::IOBuf*>, LocalErrorCode>;
+  MOCK_METHOD1(readDatagramsNaked, ReadDatagramsResult(size_t));
+
   ConnectionCallback* cb_;
 
   folly::Function<bool(const folly::Optional<std::string>&, const Buf&)>
@@ -29,15 +29,28 @@ class MockQuicStats : public QuicTransportStatsCallback {
   MOCK_METHOD0(onForwardedPacketProcessed, void());
   MOCK_METHOD0(onNewConnection, void());
   MOCK_METHOD1(onConnectionClose, void(folly::Optional<ConnectionCloseReason>));
+  MOCK_METHOD1(onHandshakeDuration, void(std::chrono::microseconds));
+  MOCK_METHOD2(
+      onConnectionRtt,
+      void(std::chrono::microseconds, std::chrono::microseconds));
+  MOCK_METHOD1(onConnectionLatencies, void(const ConnectionLatencies&));
+  MOCK_METHOD2(
+      onWriteLimitedTime,
+      void(WriteLimiter, std::chrono::microseconds));
   MOCK_METHOD0(onNewQuicStream, void());
   MOCK_METHOD0(onQuicStreamClosed, void());
   MOCK_METHOD0(onQuicStreamReset, void());
+  MOCK_METHOD3(
+      onStreamReassembly,
+      void(std::chrono::microseconds, uint32_t, uint64_t));
   MOCK_METHOD0(onConnFlowControlUpdate, void());
   MOCK_METHOD0(onConnFlowControlBlocked, void());
   MOCK_METHOD0(onStreamFlowControlUpdate, void());
   MOCK_METHOD0(onStreamFlowControlBlocked, void());
   MOCK_METHOD0(onCwndBlocked, void());
   MOCK_METHOD0(onPTO, void());
+  MOCK_METHOD0(onStatelessReset, void());
+  MOCK_METHOD1(onAckRangesPruned, void(uint64_t));
   MOCK_METHOD1(onRead, void(size_t));
   MOCK_METHOD1(onWrite, void(size_t));
 };
@@ -61,6 +61,32 @@ class MockReadCallback : public QuicSocket::ReadCallback {
       void(
           StreamId,
           std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>));
+  void onDataPushed(StreamId id, Buf data, bool eof) noexcept override {
+    onDataPushedRaw(id, data.get(), eof);
+  }
+  GMOCK_METHOD3_(
+      ,
+      noexcept,
+      ,
+      onDataPushedRaw,
+      void(StreamId, const folly::IOBuf*, bool));
+};
+
+class MockConnectionReadCallback : public QuicSocket::ConnectionReadCallback {
+ public:
+  ~MockConnectionReadCallback() override = default;
+  void readAvailable(folly::Range<const StreamId*> ids) noexcept override {
+    readAvailableIds(std::vector<StreamId>(ids.begin(), ids.end()));
+  }
+  GMOCK_METHOD1_(, noexcept, , readAvailableIds, void(std::vector<StreamId>));
+  GMOCK_METHOD2_(
+      ,
+      noexcept,
+      ,
+      readError,
+      void(
+          StreamId,
+          std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>));
 };
 
 class MockPeekCallback : public QuicSocket::PeekCallback {
@@ -159,6 +159,51 @@ TEST(QuicBatchWriter, TestBatchingGSOBatchNum) {
   }
 }
 
+TEST(QuicBatchWriter, TestBatchingGSOMaxBytes) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  // room for kBatchNum buffers and a bit, well below the max buffers
+  auto batchWriter = quic::BatchWriterFactory::makeBatchWriter(
+      sock,
+      quic::QuicBatchingMode::BATCHING_MODE_GSO,
+      kMaxGSOSegments,
+      nullptr,
+      nullptr,
+      nullptr,
+      kBatchNum * kStrLen + kStrLenLT);
+  CHECK(batchWriter);
+  std::string strTest(kStrLen, 'A');
+  if (sock.getGSO() >= 0) {
+    for (size_t i = 0; i < kNumLoops; i++) {
+      CHECK(batchWriter->empty());
+      for (auto j = 0; j < kBatchNum - 1; j++) {
+        auto buf = folly::IOBuf::copyBuffer(strTest);
+        EXPECT_FALSE(batchWriter->append(std::move(buf), kStrLen));
+      }
+      // the next buffer would not fit anymore
+      auto buf = folly::IOBuf::copyBuffer(strTest);
+      EXPECT_TRUE(batchWriter->append(std::move(buf), kStrLen));
+      EXPECT_EQ(batchWriter->size(), static_cast<size_t>(kBatchNum * kStrLen));
+      batchWriter->reset();
+    }
+
+    // a single buffer that uses up the bytes is flushed on its own
+    auto batchWriterSmall = quic::BatchWriterFactory::makeBatchWriter(
+        sock,
+        quic::QuicBatchingMode::BATCHING_MODE_GSO,
+        kMaxGSOSegments,
+        nullptr,
+        nullptr,
+        nullptr,
+        kStrLen);
+    auto buf = folly::IOBuf::copyBuffer(strTest);
+    EXPECT_TRUE(batchWriterSmall->append(std::move(buf), kStrLen));
+  }
+}
+
 TEST(QuicBatchWriter, TestBatchingSendmmsg) {
   folly::EventBase evb;
   folly::AsyncUDPSocket sock(&evb);
@@ -192,5 +237,71 @@ TEST(QuicBatchWriter, TestBatchingSendmmsg) {
   }
 }
 
+TEST(QuicBatchWriter, TestSharedPacketBatch) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  folly::AsyncUDPSocket peer1(&evb);
+  peer1.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer2(&evb);
+  peer2.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  SharedPacketBatch sharedBatch(&evb, sock, kNumLoops);
+  std::string strTest(kStrLen, 'A');
+  for (auto peer : {&peer1, &peer2}) {
+    auto batchWriter = quic::BatchWriterFactory::makeBatchWriter(
+        sock,
+        quic::QuicBatchingMode::BATCHING_MODE_NONE,
+        kBatchNum,
+        &sharedBatch);
+    CHECK(batchWriter);
+    size_t size = 0;
+    for (auto j = 0; j < kBatchNum - 1; j++) {
+      EXPECT_FALSE(
+          batchWriter->append(folly::IOBuf::copyBuffer(strTest), kStrLen));
+      size += kStrLen;
+    }
+    EXPECT_EQ(
+        static_cast<size_t>(batchWriter->write(sock, peer->address())), size);
+    batchWriter->reset();
+  }
+  // nothing is written until the end of the loop
+  EXPECT_EQ(sharedBatch.size(), static_cast<size_t>(2 * (kBatchNum - 1)));
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_TRUE(sharedBatch.size() == 0);
+
+  char data[kStrLenGT];
+  for (auto peer : {&peer1, &peer2}) {
+    for (auto j = 0; j < kBatchNum - 1; j++) {
+      auto ret = ::recv(
+          peer->getNetworkSocket().toFd(), data, sizeof(data), MSG_DONTWAIT);
+      EXPECT_EQ(ret, kStrLen);
+    }
+  }
+}
+
+TEST(QuicBatchWriter, TestSharedPacketBatchOtherSocket) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket otherSock(&evb);
+  otherSock.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  SharedPacketBatch sharedBatch(&evb, sock, kNumLoops);
+  auto batchWriter = quic::BatchWriterFactory::makeBatchWriter(
+      otherSock,
+      quic::QuicBatchingMode::BATCHING_MODE_NONE,
+      kBatchNum,
+      &sharedBatch);
+  std::string strTest(kStrLen, 'A');
+  batchWriter->append(folly::IOBuf::copyBuffer(strTest), kStrLen);
+  // packets for a different socket are written directly
+  EXPECT_EQ(batchWriter->write(otherSock, sock.address()), kStrLen);
+  EXPECT_TRUE(sharedBatch.size() == 0);
+}
+
 } // namespace testing
 } // namespace quic
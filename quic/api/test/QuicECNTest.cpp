@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicECN.h>
+
+#include <folly/net/NetOps.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+namespace quic {
+namespace testing {
+
+TEST(QuicECNTest, NoControlMessage) {
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  EXPECT_EQ(getECNCodepoint(msg), ECNCodepoint::NotECT);
+}
+
+#ifdef __linux__
+TEST(QuicECNTest, ReadTos) {
+  alignas(struct cmsghdr) char control[kECNControlSize];
+  memset(control, 0, sizeof(control));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  auto cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = IPPROTO_IP;
+  cmsg->cmsg_type = IP_TOS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(uint8_t));
+  // Only the two low bits are the ECN codepoint, the rest is the DSCP.
+  uint8_t tos = 0xb8 | static_cast<uint8_t>(ECNCodepoint::CE);
+  memcpy(CMSG_DATA(cmsg), &tos, sizeof(tos));
+  msg.msg_controllen = CMSG_SPACE(sizeof(uint8_t));
+  EXPECT_EQ(getECNCodepoint(msg), ECNCodepoint::CE);
+}
+
+TEST(QuicECNTest, ReadTrafficClass) {
+  alignas(struct cmsghdr) char control[kECNControlSize];
+  memset(control, 0, sizeof(control));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  auto cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = IPPROTO_IPV6;
+  cmsg->cmsg_type = IPV6_TCLASS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  int tclass = static_cast<int>(ECNCodepoint::ECT0);
+  memcpy(CMSG_DATA(cmsg), &tclass, sizeof(tclass));
+  msg.msg_controllen = CMSG_SPACE(sizeof(int));
+  EXPECT_EQ(getECNCodepoint(msg), ECNCodepoint::ECT0);
+}
+
+TEST(QuicECNTest, SetSocketECN) {
+  auto sock = folly::netops::socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_NE(sock, folly::NetworkSocket());
+  ASSERT_TRUE(setSocketECN(sock, AF_INET, true));
+  int tos = 0;
+  socklen_t len = sizeof(tos);
+  ASSERT_EQ(
+      folly::netops::getsockopt(sock, IPPROTO_IP, IP_TOS, &tos, &len), 0);
+  EXPECT_EQ(tos, static_cast<int>(ECNCodepoint::ECT0));
+
+  ASSERT_TRUE(setSocketECN(sock, AF_INET, false));
+  ASSERT_EQ(
+      folly::netops::getsockopt(sock, IPPROTO_IP, IP_TOS, &tos, &len), 0);
+  EXPECT_EQ(tos, 0);
+  folly::netops::close(sock);
+}
+#endif
+
+} // namespace testing
+} // namespace quic
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicGRO.h>
+
+#include <gtest/gtest.h>
+
+namespace quic {
+namespace testing {
+
+std::unique_ptr<folly::IOBuf> makeCoalescedBuf(size_t len) {
+  auto buf = folly::IOBuf::create(len);
+  for (size_t i = 0; i < len; ++i) {
+    buf->writableData()[i] = static_cast<uint8_t>(i);
+  }
+  buf->append(len);
+  return buf;
+}
+
+TEST(QuicGROTest, SplitEvenSegments) {
+  constexpr size_t kSegmentSize = 100;
+  auto buf = makeCoalescedBuf(kSegmentSize * 4);
+  const uint8_t* start = buf->data();
+  std::vector<std::unique_ptr<folly::IOBuf>> packets;
+  splitGROBuffer(std::move(buf), kSegmentSize, packets);
+  ASSERT_EQ(packets.size(), 4);
+  for (size_t i = 0; i < packets.size(); ++i) {
+    EXPECT_EQ(packets[i]->length(), kSegmentSize);
+    // The packets are views into the same buffer.
+    EXPECT_EQ(packets[i]->data(), start + i * kSegmentSize);
+    EXPECT_FALSE(packets[i]->isChained());
+  }
+  EXPECT_TRUE(packets[0]->isShared());
+}
+
+TEST(QuicGROTest, SplitShortLastSegment) {
+  constexpr size_t kSegmentSize = 100;
+  auto buf = makeCoalescedBuf(kSegmentSize * 2 + 30);
+  std::vector<std::unique_ptr<folly::IOBuf>> packets;
+  splitGROBuffer(std::move(buf), kSegmentSize, packets);
+  ASSERT_EQ(packets.size(), 3);
+  EXPECT_EQ(packets[0]->length(), kSegmentSize);
+  EXPECT_EQ(packets[1]->length(), kSegmentSize);
+  EXPECT_EQ(packets[2]->length(), 30);
+  EXPECT_EQ(packets[2]->data()[0], static_cast<uint8_t>(kSegmentSize * 2));
+}
+
+TEST(QuicGROTest, NoSegmentSize) {
+  auto buf = makeCoalescedBuf(500);
+  auto rawBuf = buf.get();
+  std::vector<std::unique_ptr<folly::IOBuf>> packets;
+  splitGROBuffer(std::move(buf), 0, packets);
+  ASSERT_EQ(packets.size(), 1);
+  EXPECT_EQ(packets[0].get(), rawBuf);
+  EXPECT_EQ(packets[0]->length(), 500);
+}
+
+TEST(QuicGROTest, NoControlMessage) {
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  EXPECT_EQ(getGROSegmentSize(msg), 0);
+}
+
+} // namespace testing
+} // namespace quic
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicKernelPacing.h>
+
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+TEST(KernelPacerTest, DepartureTimes) {
+  KernelPacer pacer(folly::NetworkSocket{});
+  // 10 packets every 10ms
+  pacer.setPacingRate(10ms, 10);
+  auto now = Clock::now();
+  EXPECT_EQ(pacer.getDepartureTime(now, 1), now);
+  EXPECT_EQ(pacer.getDepartureTime(now, 4), now + 1ms);
+  // the 4 packet batch delays the next one by 4ms
+  EXPECT_EQ(pacer.getDepartureTime(now, 1), now + 5ms);
+  EXPECT_EQ(pacer.getDepartureTime(now + 2ms, 1), now + 6ms);
+}
+
+TEST(KernelPacerTest, NoCatchUpAfterIdle) {
+  KernelPacer pacer(folly::NetworkSocket{});
+  pacer.setPacingRate(10ms, 10);
+  auto now = Clock::now();
+  EXPECT_EQ(pacer.getDepartureTime(now, 2), now);
+  EXPECT_EQ(pacer.getDepartureTime(now + 100ms, 1), now + 100ms);
+  EXPECT_EQ(pacer.getDepartureTime(now + 100ms, 1), now + 101ms);
+}
+
+TEST(KernelPacerTest, RateChange) {
+  KernelPacer pacer(folly::NetworkSocket{});
+  pacer.setPacingRate(10ms, 10);
+  auto now = Clock::now();
+  EXPECT_EQ(pacer.getDepartureTime(now, 1), now);
+  pacer.setPacingRate(10ms, 5);
+  EXPECT_EQ(pacer.getDepartureTime(now, 1), now + 1ms);
+  EXPECT_EQ(pacer.getDepartureTime(now, 1), now + 3ms);
+  pacer.setPacingRate(10ms, 0);
+  EXPECT_EQ(pacer.getDepartureTime(now, 1), now + 5ms);
+  EXPECT_EQ(pacer.getDepartureTime(now, 1), now + 5ms);
+}
+
+TEST(KernelPacerTest, Write) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  auto pacer = KernelPacer::create(sock.getNetworkSocket());
+  if (!pacer) {
+    return;
+  }
+  auto buf = folly::IOBuf::copyBuffer("hello");
+  EXPECT_EQ(pacer->write(sock.address(), buf, 0, 1), 5);
+  auto gsoBuf = folly::IOBuf::copyBuffer(std::string(20, 'a'));
+  EXPECT_EQ(pacer->write(sock.address(), gsoBuf, 10, 2), 20);
+}
+
+} // namespace test
+} // namespace quic
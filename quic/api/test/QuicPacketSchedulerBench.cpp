@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicPacketScheduler.h>
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <quic/codec/QuicPacketBuilder.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/QuicStreamFunctions.h>
+
+using namespace quic;
+using namespace quic::test;
+
+/**
+ * Microbenchmarks for the packet schedulers. Every benchmark sets up a
+ * connection once and then schedules a single packet per iteration. None of
+ * the schedulers measured here mutate the connection, so the state is the same
+ * for every iteration.
+ */
+
+namespace {
+
+constexpr size_t kSmallWriteSize = 10;
+constexpr size_t kSmallWritesPerStream = 16;
+
+std::unique_ptr<QuicServerConnectionState> makeConn(size_t numStreams) {
+  auto conn = std::make_unique<QuicServerConnectionState>();
+  conn->streamManager->setMaxLocalBidirectionalStreams(numStreams);
+  conn->flowControlState.peerAdvertisedMaxOffset =
+      std::numeric_limits<uint64_t>::max();
+  conn->flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+      kDefaultStreamWindowSize;
+  return conn;
+}
+
+// Each stream gets many small writes, which is the worst case for the
+// stream write buffers.
+std::unique_ptr<QuicServerConnectionState> makeConnWithSmallWrites(
+    size_t numStreams) {
+  auto conn = makeConn(numStreams);
+  for (size_t i = 0; i < numStreams; ++i) {
+    auto stream = conn->streamManager->createNextBidirectionalStream().value();
+    for (size_t j = 0; j < kSmallWritesPerStream; ++j) {
+      writeDataToQuicStream(
+          *stream, buildRandomInputData(kSmallWriteSize), false);
+    }
+  }
+  return conn;
+}
+
+// Every stream has lost data waiting to be retransmitted, in pieces the size
+// of the small writes.
+std::unique_ptr<QuicServerConnectionState> makeConnWithLosses(
+    size_t numStreams) {
+  auto conn = makeConn(numStreams);
+  for (size_t i = 0; i < numStreams; ++i) {
+    auto stream = conn->streamManager->createNextBidirectionalStream().value();
+    for (size_t j = 0; j < kSmallWritesPerStream; ++j) {
+      stream->lossBuffer.emplace_back(
+          buildRandomInputData(kSmallWriteSize), j * kSmallWriteSize, false);
+    }
+    conn->streamManager->addLoss(stream->id);
+  }
+  return conn;
+}
+
+// Fills the outstanding packets with packets that were already cloned and
+// whose clones are gone, followed by a single packet worth cloning. The
+// CloningScheduler has to skip over all the others to find it.
+void addOutstandingPackets(
+    QuicServerConnectionState& conn,
+    size_t numPackets) {
+  for (size_t i = 0; i < numPackets; ++i) {
+    PacketNum packetNum = getNextPacketNum(conn, PacketNumberSpace::AppData);
+    ShortHeader header(
+        ProtectionType::KeyPhaseOne, getTestConnectionId(), packetNum);
+    RegularQuicWritePacket packet(std::move(header));
+    packet.frames.push_back(
+        MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+    conn.outstandingPackets.emplace_back(
+        packet, Clock::now(), 0, false, false, 0);
+    if (i + 1 < numPackets) {
+      conn.outstandingPackets.back().associatedEvent = packetNum;
+    }
+    increaseNextPacketNum(conn, PacketNumberSpace::AppData);
+  }
+}
+
+RegularQuicPacketBuilder makeBuilder(QuicServerConnectionState& conn) {
+  ShortHeader header(
+      ProtectionType::KeyPhaseZero,
+      getTestConnectionId(),
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  return RegularQuicPacketBuilder(
+      conn.udpSendPacketLen,
+      std::move(header),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+}
+
+FrameScheduler makeFrameScheduler(const QuicServerConnectionState& conn) {
+  return FrameScheduler::Builder(
+             conn,
+             EncryptionLevel::AppData,
+             PacketNumberSpace::AppData,
+             "BenchScheduler")
+      .streamRetransmissions()
+      .streamFrames()
+      .ackFrames()
+      .resetFrames()
+      .windowUpdateFrames()
+      .blockedFrames()
+      .cryptoFrames()
+      .simpleFrames()
+      .build();
+}
+
+} // namespace
+
+// The cost of building an empty packet, which every other benchmark includes.
+BENCHMARK(BuildEmptyPacket, iters) {
+  std::unique_ptr<QuicServerConnectionState> conn;
+  BENCHMARK_SUSPEND {
+    conn = makeConn(1);
+  }
+  while (iters--) {
+    auto builder = makeBuilder(*conn);
+    folly::doNotOptimizeAway(std::move(builder).buildPacket());
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+void writeStreams(uint32_t iters, size_t numStreams) {
+  std::unique_ptr<QuicServerConnectionState> conn;
+  BENCHMARK_SUSPEND {
+    conn = makeConnWithSmallWrites(numStreams);
+  }
+  StreamFrameScheduler scheduler(*conn);
+  while (iters--) {
+    auto builder = makeBuilder(*conn);
+    scheduler.writeStreams(builder);
+    folly::doNotOptimizeAway(std::move(builder).buildPacket());
+  }
+}
+
+BENCHMARK_PARAM(writeStreams, 1)
+BENCHMARK_PARAM(writeStreams, 100)
+BENCHMARK_PARAM(writeStreams, 10000)
+
+BENCHMARK_DRAW_LINE();
+
+void scheduleFramesForPacket(uint32_t iters, size_t numStreams) {
+  std::unique_ptr<QuicServerConnectionState> conn;
+  BENCHMARK_SUSPEND {
+    conn = makeConnWithSmallWrites(numStreams);
+  }
+  auto scheduler = makeFrameScheduler(*conn);
+  while (iters--) {
+    folly::doNotOptimizeAway(scheduler.scheduleFramesForPacket(
+        makeBuilder(*conn), conn->udpSendPacketLen));
+  }
+}
+
+BENCHMARK_PARAM(scheduleFramesForPacket, 1)
+BENCHMARK_PARAM(scheduleFramesForPacket, 100)
+BENCHMARK_PARAM(scheduleFramesForPacket, 10000)
+
+BENCHMARK_DRAW_LINE();
+
+void scheduleLostFramesForPacket(uint32_t iters, size_t numStreams) {
+  std::unique_ptr<QuicServerConnectionState> conn;
+  BENCHMARK_SUSPEND {
+    conn = makeConnWithLosses(numStreams);
+  }
+  auto scheduler = makeFrameScheduler(*conn);
+  while (iters--) {
+    folly::doNotOptimizeAway(scheduler.scheduleFramesForPacket(
+        makeBuilder(*conn), conn->udpSendPacketLen));
+  }
+}
+
+BENCHMARK_PARAM(scheduleLostFramesForPacket, 1)
+BENCHMARK_PARAM(scheduleLostFramesForPacket, 100)
+BENCHMARK_PARAM(scheduleLostFramesForPacket, 10000)
+
+BENCHMARK_DRAW_LINE();
+
+void clonePacket(uint32_t iters, size_t numOutstanding) {
+  std::unique_ptr<QuicServerConnectionState> conn;
+  BENCHMARK_SUSPEND {
+    conn = makeConn(1);
+    addOutstandingPackets(*conn, numOutstanding);
+  }
+  FrameScheduler noopScheduler("frame");
+  CloningScheduler scheduler(noopScheduler, *conn, "CopyCat", 0);
+  while (iters--) {
+    folly::doNotOptimizeAway(scheduler.scheduleFramesForPacket(
+        makeBuilder(*conn), conn->udpSendPacketLen));
+  }
+}
+
+BENCHMARK_PARAM(clonePacket, 1)
+BENCHMARK_PARAM(clonePacket, 100)
+BENCHMARK_PARAM(clonePacket, 10000)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -285,6 +285,95 @@ TEST_F(QuicPacketSchedulerTest, StreamFrameNoSpace) {
   EXPECT_EQ(builder.remainingSpaceInPkt(), originalSpace);
 }
 
+TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerPacksSmallStreams) {
+  QuicServerConnectionState conn;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  conn.flowControlState.peerAdvertisedMaxOffset = kDefaultConnectionWindowSize;
+  conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+      kDefaultStreamWindowSize;
+  for (int i = 0; i < 10; ++i) {
+    auto stream = conn.streamManager->createNextBidirectionalStream().value();
+    writeDataToQuicStream(*stream, buildRandomInputData(5), false);
+  }
+
+  StreamFrameScheduler scheduler(conn);
+  ShortHeader shortHeader(
+      ProtectionType::KeyPhaseZero,
+      getTestConnectionId(),
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      conn.udpSendPacketLen,
+      std::move(shortHeader),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+  auto originalSpace = builder.remainingSpaceInPkt();
+  scheduler.writeStreams(builder);
+  // Type, stream id and a 1 byte length for each of the 5 byte frames.
+  EXPECT_EQ(originalSpace - 10 * (3 + 5), builder.remainingSpaceInPkt());
+  auto packet = std::move(builder).buildPacket().packet;
+  EXPECT_EQ(10u, packet.frames.size());
+}
+
+TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerOmitsLastFrameLength) {
+  QuicServerConnectionState conn;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  conn.flowControlState.peerAdvertisedMaxOffset = kDefaultConnectionWindowSize;
+  conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+      kDefaultStreamWindowSize;
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(
+      *stream, buildRandomInputData(conn.udpSendPacketLen * 2), false);
+
+  StreamFrameScheduler scheduler(conn);
+  ShortHeader shortHeader(
+      ProtectionType::KeyPhaseZero,
+      getTestConnectionId(),
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      conn.udpSendPacketLen,
+      std::move(shortHeader),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+  auto originalSpace = builder.remainingSpaceInPkt();
+  scheduler.writeStreams(builder);
+  EXPECT_EQ(0, builder.remainingSpaceInPkt());
+  auto packet = std::move(builder).buildPacket().packet;
+  ASSERT_EQ(1u, packet.frames.size());
+  auto& frame = boost::get<WriteStreamFrame>(packet.frames.front());
+  // Only the type and the stream id precede the data.
+  EXPECT_EQ(originalSpace - 2, frame.len);
+}
+
+TEST_F(QuicPacketSchedulerTest, RetransmissionSchedulerMergesLostRanges) {
+  QuicServerConnectionState conn;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  // Three frames lost in a burst, and one further away.
+  for (uint64_t offset = 0; offset < 300; offset += 100) {
+    insertIntoLossBuffer(
+        *stream, StreamBuffer(buildRandomInputData(100), offset));
+  }
+  insertIntoLossBuffer(*stream, StreamBuffer(buildRandomInputData(100), 400));
+  conn.streamManager->updateLossStreams(*stream);
+
+  RetransmissionScheduler scheduler(conn);
+  ShortHeader shortHeader(
+      ProtectionType::KeyPhaseZero,
+      getTestConnectionId(),
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      conn.udpSendPacketLen,
+      std::move(shortHeader),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+  scheduler.writeRetransmissionStreams(builder);
+  auto packet = std::move(builder).buildPacket().packet;
+  ASSERT_EQ(2u, packet.frames.size());
+  auto& merged = boost::get<WriteStreamFrame>(packet.frames[0]);
+  EXPECT_EQ(0u, merged.offset);
+  EXPECT_EQ(300u, merged.len);
+  auto& other = boost::get<WriteStreamFrame>(packet.frames[1]);
+  EXPECT_EQ(400u, other.offset);
+  EXPECT_EQ(100u, other.len);
+}
+
 TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerStreamNotExists) {
   QuicServerConnectionState conn;
   auto connId = getTestConnectionId();
@@ -455,6 +544,121 @@ TEST_F(QuicPacketSchedulerTest, DoNotClonePureAck) {
   EXPECT_EQ(expected, *result.first);
 }
 
+TEST_F(QuicPacketSchedulerTest, CloneOldestUnclonedPacketFirst) {
+  QuicClientConnectionState conn;
+  FrameScheduler noopScheduler("frame");
+  CloningScheduler cloningScheduler(noopScheduler, conn, "CopyCat", 0);
+  // The oldest packet has been cloned already, so its data has been probed
+  PacketNum cloned = addOutstandingPacket(conn);
+  conn.outstandingPackets.back().associatedEvent = cloned;
+  conn.outstandingPacketEvents.insert(cloned);
+  conn.outstandingPackets.back().packet.frames.push_back(
+      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+  PacketNum expected = addOutstandingPacket(conn);
+  conn.outstandingPackets.back().packet.frames.push_back(
+      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+  addOutstandingPacket(conn);
+  conn.outstandingPackets.back().packet.frames.push_back(
+      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+
+  ShortHeader header(
+      ProtectionType::KeyPhaseOne,
+      conn.clientConnectionId.value_or(getTestConnectionId()),
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      conn.udpSendPacketLen,
+      std::move(header),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+  auto result = cloningScheduler.scheduleFramesForPacket(
+      std::move(builder), kDefaultUDPSendPacketLen);
+  EXPECT_TRUE(result.first.hasValue() && result.second.hasValue());
+  EXPECT_EQ(expected, *result.first);
+}
+
+TEST_F(QuicPacketSchedulerTest, CloneBudgetExhaustedSendsPing) {
+  QuicClientConnectionState conn;
+  conn.transportSettings.maxClonesPerPacket = 1;
+  FrameScheduler noopScheduler("frame");
+  CloningScheduler cloningScheduler(noopScheduler, conn, "CopyCat", 0);
+  // An original packet and its clone are both outstanding
+  PacketNum original = addOutstandingPacket(conn);
+  conn.outstandingPackets.back().associatedEvent = original;
+  conn.outstandingPacketEvents.insert(original);
+  conn.outstandingPackets.back().packet.frames.push_back(
+      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+  addOutstandingPacket(conn);
+  conn.outstandingPackets.back().associatedEvent = original;
+  conn.outstandingPackets.back().packet.frames.push_back(
+      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+
+  ShortHeader header(
+      ProtectionType::KeyPhaseOne,
+      conn.clientConnectionId.value_or(getTestConnectionId()),
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      conn.udpSendPacketLen,
+      std::move(header),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+  auto result = cloningScheduler.scheduleFramesForPacket(
+      std::move(builder), kDefaultUDPSendPacketLen);
+  EXPECT_FALSE(result.first.hasValue());
+  ASSERT_TRUE(result.second.hasValue());
+  ASSERT_EQ(result.second->packet.frames.size(), 1);
+  EXPECT_NE(boost::get<PingFrame>(&result.second->packet.frames[0]), nullptr);
+}
+
+TEST_F(QuicPacketSchedulerTest, DatagramFrameScheduler) {
+  QuicClientConnectionState conn;
+  auto scheduler = std::move(FrameScheduler::Builder(
+                                 conn,
+                                 EncryptionLevel::AppData,
+                                 PacketNumberSpace::AppData,
+                                 "frame")
+                                 .datagramFrames())
+                       .build();
+  EXPECT_FALSE(scheduler.hasData());
+  conn.datagramState.writeBuffer.push_back(folly::IOBuf::copyBuffer("one"));
+  conn.datagramState.writeBuffer.push_back(folly::IOBuf::copyBuffer("two"));
+  EXPECT_TRUE(scheduler.hasImmediateData());
+
+  ShortHeader header(
+      ProtectionType::KeyPhaseOne,
+      conn.clientConnectionId.value_or(getTestConnectionId()),
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      conn.udpSendPacketLen,
+      std::move(header),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+  auto result = scheduler.scheduleFramesForPacket(
+      std::move(builder), kDefaultUDPSendPacketLen);
+  ASSERT_TRUE(result.second.hasValue());
+  auto& frames = result.second->packet.frames;
+  ASSERT_EQ(frames.size(), 2);
+  EXPECT_EQ(boost::get<DatagramFrame>(frames[0]).length, 3);
+  EXPECT_EQ(boost::get<DatagramFrame>(frames[1]).length, 3);
+}
+
+TEST_F(QuicPacketSchedulerTest, DoNotCloneDatagrams) {
+  QuicClientConnectionState conn;
+  FrameScheduler noopScheduler("frame");
+  CloningScheduler cloningScheduler(noopScheduler, conn, "CopyCat", 0);
+  addOutstandingPacket(conn);
+  conn.outstandingPackets.back().packet.frames.push_back(
+      DatagramFrame(10, nullptr));
+
+  ShortHeader header(
+      ProtectionType::KeyPhaseOne,
+      conn.clientConnectionId.value_or(getTestConnectionId()),
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      conn.udpSendPacketLen,
+      std::move(header),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+  auto result = cloningScheduler.scheduleFramesForPacket(
+      std::move(builder), kDefaultUDPSendPacketLen);
+  EXPECT_FALSE(result.first.hasValue());
+}
+
 TEST_F(QuicPacketSchedulerTest, CloneSchedulerHasDataIgnoresNonAppData) {
   QuicClientConnectionState conn;
   FrameScheduler noopScheduler("frame");
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicReadBufferPool.h>
+
+#include <gtest/gtest.h>
+#include <quic/QuicConstants.h>
+#include <quic/common/BufferArena.h>
+
+#include <thread>
+
+namespace quic {
+namespace testing {
+
+constexpr size_t kBufferSize = 1500;
+constexpr size_t kMaxFreeBuffers = 2;
+constexpr size_t kCopyThreshold = 100;
+
+TEST(QuicReadBufferPoolTest, SmallDatagramIsCopied) {
+  QuicReadBufferPool pool(kBufferSize, kMaxFreeBuffers, kCopyThreshold);
+  auto pooled = pool.acquire();
+  auto raw = pooled.get();
+  memset(raw, 'a', kCopyThreshold);
+  auto buf = pool.toIOBuf(pooled, kCopyThreshold);
+  // The pooled buffer stays with the caller for the next read.
+  EXPECT_EQ(pooled.get(), raw);
+  EXPECT_NE(buf->data(), raw);
+  EXPECT_EQ(buf->length(), kCopyThreshold);
+  EXPECT_EQ(buf->data()[0], 'a');
+}
+
+TEST(QuicReadBufferPoolTest, LargeDatagramIsRecycled) {
+  QuicReadBufferPool pool(kBufferSize, kMaxFreeBuffers, kCopyThreshold);
+  auto pooled = pool.acquire();
+  auto raw = pooled.get();
+  auto buf = pool.toIOBuf(pooled, kBufferSize);
+  EXPECT_FALSE(pooled);
+  EXPECT_EQ(buf->data(), raw);
+  EXPECT_EQ(buf->length(), kBufferSize);
+  EXPECT_EQ(pool.numFreeBuffers(), 0);
+
+  // Clones keep the buffer alive.
+  auto clone = buf->clone();
+  buf.reset();
+  EXPECT_EQ(pool.numFreeBuffers(), 0);
+  clone.reset();
+  EXPECT_EQ(pool.numFreeBuffers(), 1);
+
+  auto recycled = pool.acquire();
+  EXPECT_EQ(recycled.get(), raw);
+  EXPECT_EQ(pool.numFreeBuffers(), 0);
+}
+
+TEST(QuicReadBufferPoolTest, MaxFreeBuffers) {
+  QuicReadBufferPool pool(kBufferSize, kMaxFreeBuffers, kCopyThreshold);
+  std::vector<QuicReadBufferPool::PooledBuffer> buffers;
+  for (size_t i = 0; i < kMaxFreeBuffers + 2; ++i) {
+    buffers.push_back(pool.acquire());
+  }
+  buffers.clear();
+  EXPECT_EQ(pool.numFreeBuffers(), kMaxFreeBuffers);
+}
+
+TEST(QuicReadBufferPoolTest, BufferOutlivesPool) {
+  std::unique_ptr<folly::IOBuf> buf;
+  {
+    QuicReadBufferPool pool(kBufferSize, kMaxFreeBuffers, kCopyThreshold);
+    auto pooled = pool.acquire();
+    memset(pooled.get(), 'b', kBufferSize);
+    buf = pool.toIOBuf(pooled, kBufferSize);
+  }
+  EXPECT_EQ(buf->data()[kBufferSize - 1], 'b');
+  buf.reset();
+}
+
+TEST(QuicReadBufferPoolTest, FreeFromOtherThread) {
+  QuicReadBufferPool pool(kBufferSize, kMaxFreeBuffers, kCopyThreshold);
+  auto pooled = pool.acquire();
+  auto buf = pool.toIOBuf(pooled, kBufferSize);
+  std::thread t([b = std::move(buf)]() mutable { b.reset(); });
+  t.join();
+  EXPECT_EQ(pool.numFreeBuffers(), 1);
+}
+
+TEST(QuicReadBufferPoolTest, BuffersFromArena) {
+  // Room for a single buffer and its header.
+  BufferArena arena(kBufferArenaChunkSize / 2, kBufferArenaChunkSize);
+  {
+    QuicReadBufferPool pool(
+        kBufferSize, kMaxFreeBuffers, kCopyThreshold, &arena);
+    auto fromArena = pool.acquire();
+    EXPECT_EQ(arena.allocate(kBufferSize), nullptr);
+    // The heap takes over once the arena is full.
+    auto fromHeap = pool.acquire();
+    EXPECT_TRUE(fromHeap);
+  }
+  // Destroying the pool gave the buffer back to the arena.
+  auto buf = arena.allocate(kBufferSize);
+  EXPECT_NE(buf, nullptr);
+  BufferArena::deallocate(buf);
+}
+
+} // namespace testing
+} // namespace quic
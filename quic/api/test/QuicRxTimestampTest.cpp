@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicRxTimestamp.h>
+
+#include <folly/net/NetOps.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace testing {
+
+TEST(QuicRxTimestampTest, NoControlMessage) {
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  auto now = Clock::now();
+  EXPECT_EQ(getRxTimestamp(msg, now, std::chrono::system_clock::now()), now);
+}
+
+#ifdef SO_TIMESTAMPNS
+namespace {
+
+void setTimestamp(
+    struct msghdr& msg,
+    char* control,
+    std::chrono::system_clock::time_point time) {
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_control = control;
+  msg.msg_controllen = kRxTimestampControlSize;
+  auto cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_TIMESTAMPNS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(struct timespec));
+  auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      time.time_since_epoch());
+  struct timespec ts;
+  ts.tv_sec = sinceEpoch.count() / 1000000000;
+  ts.tv_nsec = sinceEpoch.count() % 1000000000;
+  memcpy(CMSG_DATA(cmsg), &ts, sizeof(ts));
+  msg.msg_controllen = CMSG_SPACE(sizeof(struct timespec));
+}
+
+} // namespace
+
+TEST(QuicRxTimestampTest, ReadTimestamp) {
+  alignas(struct cmsghdr) char control[kRxTimestampControlSize];
+  memset(control, 0, sizeof(control));
+  struct msghdr msg;
+  auto now = Clock::now();
+  auto systemNow = std::chrono::system_clock::now();
+  // The datagram waited in the socket while the event loop was busy.
+  setTimestamp(msg, control, systemNow - 300us);
+  auto receiveTime = getRxTimestamp(msg, now, systemNow);
+  EXPECT_EQ(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          now - receiveTime),
+      300us);
+}
+
+TEST(QuicRxTimestampTest, WallClockStepped) {
+  alignas(struct cmsghdr) char control[kRxTimestampControlSize];
+  memset(control, 0, sizeof(control));
+  struct msghdr msg;
+  auto now = Clock::now();
+  auto systemNow = std::chrono::system_clock::now();
+  setTimestamp(msg, control, systemNow + 1ms);
+  EXPECT_EQ(getRxTimestamp(msg, now, systemNow), now);
+  setTimestamp(msg, control, systemNow - kMaxRxTimestampAge - 1ms);
+  EXPECT_EQ(getRxTimestamp(msg, now, systemNow), now);
+}
+
+TEST(QuicRxTimestampTest, SetSocketRxTimestamps) {
+  auto sock = folly::netops::socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_NE(sock, folly::NetworkSocket());
+  ASSERT_TRUE(setSocketRxTimestamps(sock, true));
+  int val = 0;
+  socklen_t len = sizeof(val);
+  ASSERT_EQ(
+      folly::netops::getsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &val, &len),
+      0);
+  EXPECT_EQ(val, 1);
+  folly::netops::close(sock);
+}
+#endif
+
+} // namespace testing
+} // namespace quic
@@ -383,6 +383,22 @@ TEST_F(QuicTransportImplTest, AckTimeoutExpiredWillResetTimeoutFlag) {
   EXPECT_FALSE(transport->transportConn->pendingEvents.scheduleAckTimeout);
 }
 
+TEST_F(QuicTransportImplTest, LoopTimeCountsOutermostCallbacks) {
+  auto& loopTime = transport->transportConn->loopTime;
+  transport->invokeAckTimeout();
+  EXPECT_EQ(0, loopTime.callbacks);
+
+  transport->transportConn->transportSettings.loopTimeSampleRate = 1;
+  // The ack timeout writes, which is accounted for with the timeout.
+  transport->invokeAckTimeout();
+  EXPECT_EQ(1, loopTime.callbacks);
+  auto stream = transport->createBidirectionalStream().value();
+  transport->addDataToStream(
+      stream, StreamBuffer(folly::IOBuf::copyBuffer("hello"), 0));
+  EXPECT_EQ(2, loopTime.callbacks);
+  EXPECT_GE(loopTime.estimated.count(), 0);
+}
+
 TEST_F(QuicTransportImplTest, IdleTimeoutExpiredDestroysTransport) {
   EXPECT_CALL(connCallback, onConnectionEnd()).WillOnce(Invoke([&]() {
     transport = nullptr;
@@ -461,6 +477,67 @@ TEST_F(QuicTransportImplTest, ReadCallbackDataAvailable) {
   transport.reset();
 }
 
+TEST_F(QuicTransportImplTest, ReadCallbackBudget) {
+  transport->transportConn->transportSettings.streamCallbacksPerLoop = 2;
+  std::vector<StreamId> streams;
+  MockReadCallback readCb;
+  for (int i = 0; i < 3; ++i) {
+    streams.push_back(transport->createBidirectionalStream().value());
+    transport->setReadCallback(streams.back(), &readCb);
+    transport->addDataToStream(
+        streams.back(),
+        StreamBuffer(folly::IOBuf::copyBuffer("actual stream data"), 0));
+  }
+
+  EXPECT_CALL(readCb, readAvailable(streams[0]));
+  EXPECT_CALL(readCb, readAvailable(streams[1]));
+  transport->driveReadCallbacks();
+
+  // The next loop starts with the stream that was left out.
+  {
+    InSequence s;
+    EXPECT_CALL(readCb, readAvailable(streams[2]));
+    EXPECT_CALL(readCb, readAvailable(streams[0]));
+  }
+  transport->driveReadCallbacks();
+  transport.reset();
+}
+
+TEST_F(QuicTransportImplTest, ConnectionReadCallback) {
+  auto stream1 = transport->createBidirectionalStream().value();
+  auto stream2 = transport->createBidirectionalStream().value();
+  auto stream3 = transport->createBidirectionalStream().value();
+
+  MockReadCallback readCb1;
+  MockConnectionReadCallback connReadCb;
+  transport->setReadCallback(stream1, &readCb1);
+  transport->setConnectionReadCallback(&connReadCb);
+
+  for (auto stream : {stream1, stream2, stream3}) {
+    transport->addDataToStream(
+        stream,
+        StreamBuffer(folly::IOBuf::copyBuffer("actual stream data"), 0));
+  }
+
+  // The streams with a callback of their own keep using it.
+  EXPECT_CALL(readCb1, readAvailable(stream1));
+  EXPECT_CALL(
+      connReadCb, readAvailableIds(std::vector<StreamId>({stream2, stream3})));
+  transport->driveReadCallbacks();
+
+  // Once read, a stream is not reported anymore.
+  transport->read(stream2, 0);
+  EXPECT_CALL(readCb1, readAvailable(stream1));
+  EXPECT_CALL(connReadCb, readAvailableIds(std::vector<StreamId>({stream3})));
+  transport->driveReadCallbacks();
+
+  transport->setConnectionReadCallback(nullptr);
+  EXPECT_CALL(readCb1, readAvailable(stream1));
+  EXPECT_CALL(connReadCb, readAvailableIds(_)).Times(0);
+  transport->driveReadCallbacks();
+  transport.reset();
+}
+
 TEST_F(QuicTransportImplTest, ReadCallbackChangeReadCallback) {
   auto stream1 = transport->createBidirectionalStream().value();
 
@@ -620,6 +697,87 @@ TEST_F(QuicTransportImplTest, ReadData) {
   transport.reset();
 }
 
+TEST_F(QuicTransportImplTest, ReadZeroCopy) {
+  auto stream1 = transport->createBidirectionalStream().value();
+  auto& conn = transport->getConnectionState();
+  auto readData1 = folly::IOBuf::copyBuffer("actual stream ");
+  auto readData2 = folly::IOBuf::copyBuffer("data");
+  auto received1 = readData1.get();
+  auto received2 = readData2.get();
+  transport->addDataToStream(stream1, StreamBuffer(std::move(readData1), 0));
+  transport->addDataToStream(stream1, StreamBuffer(std::move(readData2), 14));
+
+  auto result = transport->readZeroCopy(stream1);
+  ASSERT_FALSE(result.hasError());
+  auto& data = result.value().first;
+  EXPECT_FALSE(result.value().second);
+  // The received buffers themselves are handed out.
+  EXPECT_EQ(data.get(), received1);
+  EXPECT_EQ(data->next(), received2);
+  EXPECT_EQ(data->computeChainDataLength(), 18);
+
+  auto stream = transport->getStream(stream1);
+  EXPECT_EQ(stream->currentReadOffset, 18);
+  EXPECT_EQ(stream->flowControlState.unreleasedReadBytes, 18);
+  EXPECT_EQ(conn.flowControlState.sumCurReadOffset, 0);
+
+  EXPECT_EQ(
+      transport->releaseRead(stream1, 19).error(),
+      LocalErrorCode::INVALID_OPERATION);
+  EXPECT_FALSE(transport->releaseRead(stream1, 14).hasError());
+  EXPECT_EQ(stream->flowControlState.unreleasedReadBytes, 4);
+  EXPECT_EQ(conn.flowControlState.sumCurReadOffset, 14);
+  EXPECT_FALSE(transport->releaseRead(stream1, 4).hasError());
+  EXPECT_EQ(stream->flowControlState.unreleasedReadBytes, 0);
+  EXPECT_EQ(conn.flowControlState.sumCurReadOffset, 18);
+  transport.reset();
+}
+
+TEST_F(QuicTransportImplTest, ReadPushDelivery) {
+  auto stream1 = transport->createBidirectionalStream().value();
+  auto& conn = transport->getConnectionState();
+  MockReadCallback readCb1;
+  EXPECT_EQ(
+      transport->setReadPushDelivery(stream1, true).error(),
+      LocalErrorCode::APP_ERROR);
+  transport->setReadCallback(stream1, &readCb1);
+  EXPECT_FALSE(transport->setReadPushDelivery(stream1, true).hasError());
+
+  // Data received in order is pushed right away, and credited on return.
+  auto readData = folly::IOBuf::copyBuffer("actual stream data");
+  auto received = readData.get();
+  EXPECT_CALL(readCb1, readAvailable(_)).Times(0);
+  EXPECT_CALL(readCb1, onDataPushedRaw(stream1, received, false))
+      .WillOnce(Invoke([&](auto, auto, auto) {
+        auto stream = transport->getStream(stream1);
+        EXPECT_EQ(stream->flowControlState.unreleasedReadBytes, 18);
+      }));
+  transport->addDataToStream(stream1, StreamBuffer(std::move(readData), 0));
+  auto stream = transport->getStream(stream1);
+  EXPECT_EQ(stream->currentReadOffset, 18);
+  EXPECT_EQ(stream->flowControlState.unreleasedReadBytes, 0);
+  EXPECT_EQ(conn.flowControlState.sumCurReadOffset, 18);
+  EXPECT_TRUE(stream->readBuffer.empty());
+  Mock::VerifyAndClearExpectations(&readCb1);
+
+  // Paused streams hold the data back until they are resumed.
+  transport->pauseRead(stream1);
+  EXPECT_CALL(readCb1, onDataPushedRaw(_, _, _)).Times(0);
+  transport->addDataToStream(
+      stream1, StreamBuffer(folly::IOBuf::copyBuffer("more"), 18, true));
+  Mock::VerifyAndClearExpectations(&readCb1);
+
+  transport->resumeRead(stream1);
+  EXPECT_CALL(readCb1, onDataPushedRaw(stream1, _, true))
+      .WillOnce(Invoke([](auto, auto data, auto) {
+        EXPECT_TRUE(folly::IOBufEqualTo()(
+            *data, *folly::IOBuf::copyBuffer("more")));
+      }));
+  transport->driveReadCallbacks();
+  EXPECT_EQ(conn.flowControlState.sumCurReadOffset, 22);
+  transport.reset();
+}
+
 // TODO The finest copypasta around. We need a better story for parameterizing
 // unidirectional vs. bidirectional.
 TEST_F(QuicTransportImplTest, UnidirectionalReadData) {
@@ -1099,6 +1257,41 @@ TEST_F(QuicTransportImplTest, DeliveryCallbackUnsetOne) {
   transport->close(folly::none);
 }
 
+TEST_F(QuicTransportImplTest, AggregatedDeliveryCallback) {
+  auto stream = transport->createBidirectionalStream().value();
+  auto stream2 = transport->createBidirectionalStream().value();
+  MockDeliveryCallback dcb;
+  EXPECT_FALSE(
+      transport->setAggregatedDeliveryCallback(stream, &dcb).hasError());
+  auto streamState = transport->getStream(stream);
+
+  // Fake that the data was delivered and trigger the callbacks with data on
+  // another stream.
+  streamState->currentWriteOffset = 10;
+  transport->transportConn->streamManager->addDeliverable(stream);
+  EXPECT_CALL(dcb, onDeliveryAck(stream, 9, _));
+  transport->addDataToStream(
+      stream2, StreamBuffer(IOBuf::copyBuffer("hello"), 0));
+  Mock::VerifyAndClearExpectations(&dcb);
+
+  // Nothing new was acked.
+  transport->transportConn->streamManager->addDeliverable(stream);
+  EXPECT_CALL(dcb, onDeliveryAck(_, _, _)).Times(0);
+  transport->addDataToStream(
+      stream2, StreamBuffer(IOBuf::copyBuffer("world"), 5));
+  Mock::VerifyAndClearExpectations(&dcb);
+
+  streamState->currentWriteOffset = 20;
+  transport->transportConn->streamManager->addDeliverable(stream);
+  EXPECT_CALL(dcb, onDeliveryAck(stream, 19, _));
+  transport->addDataToStream(
+      stream2, StreamBuffer(IOBuf::copyBuffer("!"), 10));
+  Mock::VerifyAndClearExpectations(&dcb);
+
+  EXPECT_CALL(dcb, onCanceled(stream, 20));
+  transport->close(folly::none);
+}
+
 TEST_F(QuicTransportImplTest, DeliveryCallbackOnSendDataExpire) {
   InSequence enforceOrder;
 
@@ -1445,6 +1638,82 @@ TEST_F(QuicTransportImplTest, AsyncStreamFlowControlWrite) {
   EXPECT_TRUE(streamState->latestMaxStreamDataPacket.hasValue());
 }
 
+TEST_F(QuicTransportImplTest, WriteFromSource) {
+  auto stream = transport->createBidirectionalStream().value();
+  auto streamState = transport->getStream(stream);
+  auto& conn = transport->getConnectionState();
+  transport->writeLooper()->stop();
+  constexpr uint64_t kSourceLength = 100000;
+  auto data = buildRandomInputData(kSourceLength);
+  std::vector<std::pair<uint64_t, uint64_t>> reads;
+  auto source = std::make_unique<CallbackStreamWriteSource>(
+      kSourceLength, [&](uint64_t offset, uint64_t len) {
+        reads.emplace_back(offset, len);
+        folly::io::Cursor cursor(data.get());
+        cursor.skip(offset);
+        Buf buf;
+        cursor.clone(buf, len);
+        return buf;
+      });
+  NiceMock<MockDeliveryCallback> deliveryCb;
+  EXPECT_FALSE(
+      transport->writeFromSource(stream, std::move(source), true, &deliveryCb)
+          .hasError());
+
+  // Only a packet is read ahead without a congestion window.
+  ASSERT_EQ(reads.size(), 1);
+  EXPECT_EQ(reads[0].first, 0);
+  EXPECT_EQ(reads[0].second, conn.udpSendPacketLen);
+  EXPECT_EQ(streamState->writeBuffer.chainLength(), conn.udpSendPacketLen);
+  EXPECT_FALSE(streamState->finalWriteOffset.hasValue());
+  EXPECT_EQ(
+      transport->writeChain(stream, IOBuf::copyBuffer("hello"), false, false)
+          .error(),
+      LocalErrorCode::INVALID_OPERATION);
+
+  EXPECT_CALL(deliveryCb, onCanceled(stream, kSourceLength));
+  transport.reset();
+}
+
+TEST_F(QuicTransportImplTest, ReserveWriteSpace) {
+  auto stream1 = transport->createBidirectionalStream().value();
+  auto stream2 = transport->createBidirectionalStream().value();
+  transport->writeLooper()->stop();
+  auto connWritable = transport->getMaxWritableOnConnection();
+  ASSERT_GT(connWritable, 1000);
+  EXPECT_EQ(
+      transport->getMaxWritableOnStream(stream1).value(),
+      std::min(connWritable, kDefaultStreamWindowSize));
+
+  EXPECT_EQ(transport->reserveWriteSpace(stream1, 1000).value(), 1000);
+  EXPECT_EQ(transport->getMaxWritableOnConnection(), connWritable - 1000);
+  EXPECT_EQ(
+      transport->getMaxWritableOnStream(stream1).value(),
+      std::min(connWritable, kDefaultStreamWindowSize));
+  EXPECT_EQ(
+      transport->getMaxWritableOnStream(stream2).value(),
+      std::min(connWritable - 1000, kDefaultStreamWindowSize));
+
+  // A write takes its bytes off the reservation.
+  transport->writeChain(stream1, buildRandomInputData(400), false, false);
+  EXPECT_EQ(transport->getMaxWritableOnConnection(), connWritable - 1000);
+
+  // Reserving again replaces the reservation.
+  EXPECT_EQ(transport->reserveWriteSpace(stream1, 100).value(), 100);
+  EXPECT_EQ(transport->getMaxWritableOnConnection(), connWritable - 500);
+  EXPECT_EQ(transport->reserveWriteSpace(stream1, 0).value(), 0);
+  EXPECT_EQ(transport->getMaxWritableOnConnection(), connWritable - 400);
+
+  // Resetting the stream releases its reservation.
+  EXPECT_EQ(transport->reserveWriteSpace(stream2, 200).value(), 200);
+  transport->resetStream(stream2, GenericApplicationErrorCode::UNKNOWN);
+  EXPECT_EQ(transport->getMaxWritableOnConnection(), connWritable - 400);
+  EXPECT_EQ(
+      transport->reserveWriteSpace(stream2, 200).error(),
+      LocalErrorCode::STREAM_CLOSED);
+  transport.reset();
+}
+
 TEST_F(QuicTransportImplTest, ExceptionInWriteLooperDoesNotCrash) {
   auto stream = transport->createBidirectionalStream().value();
   transport->setReadCallback(stream, nullptr);
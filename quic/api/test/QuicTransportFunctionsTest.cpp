@@ -402,6 +402,28 @@ TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionPacketSorting) {
           lastHeader, [](const auto& h) { return h.getPacketNumberSpace(); }));
 }
 
+TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionSamplesQLogPackets) {
+  auto conn = createConn();
+  auto qLogger = std::make_shared<quic::FileQLogger>();
+  qLogger->packetSampleRate = 2;
+  conn->qLogger = qLogger;
+  for (int i = 0; i < 3; i++) {
+    auto packet = buildEmptyPacket(*conn, PacketNumberSpace::AppData);
+    updateConnection(
+        *conn, folly::none, packet.packet, TimePoint{}, getEncodedSize(packet));
+  }
+  // The first and the third.
+  EXPECT_EQ(2, qLogger->logs.size());
+
+  qLogger->logs.clear();
+  qLogger->enabledEvents &=
+      ~(1u << static_cast<uint32_t>(QLogEventType::PacketSent));
+  auto packet = buildEmptyPacket(*conn, PacketNumberSpace::AppData);
+  updateConnection(
+      *conn, folly::none, packet.packet, TimePoint{}, getEncodedSize(packet));
+  EXPECT_TRUE(qLogger->logs.empty());
+}
+
 TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionFinOnly) {
   auto conn = createConn();
   conn->qLogger = std::make_shared<quic::FileQLogger>();
@@ -604,6 +626,20 @@ TEST_F(QuicTransportFunctionsTest, TestPaddingPureAckPacketIsStillPureAck) {
   EXPECT_EQ(event->frames.size(), 2);
 }
 
+TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionRecordsAckDelay) {
+  auto conn = createConn();
+  auto packet = buildEmptyPacket(*conn, PacketNumberSpace::AppData);
+  WriteAckFrame ackFrame;
+  ackFrame.ackBlocks.insert(100);
+  ackFrame.ackDelay = 300us;
+  packet.packet.frames.push_back(std::move(ackFrame));
+  updateConnection(
+      *conn, folly::none, packet.packet, TimePoint(), getEncodedSize(packet));
+  EXPECT_EQ(1, conn->latencies.ackDelay.count);
+  EXPECT_EQ(300us, conn->latencies.ackDelay.max);
+  EXPECT_EQ(1, conn->latencies.ackDelay.buckets[9]);
+}
+
 TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionHandshakeCounter) {
   auto conn = createConn();
   conn->qLogger = std::make_shared<quic::FileQLogger>();
@@ -783,11 +819,6 @@ TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionWithBytesStats) {
   auto packet = buildEmptyPacket(*conn, PacketNumberSpace::Handshake);
   conn->lossState.totalBytesSent = 13579;
   conn->lossState.totalBytesAcked = 8642;
-  auto currentTime = Clock::now();
-  conn->lossState.lastAckedTime = currentTime - 123s;
-  conn->lossState.lastAckedPacketSentTime = currentTime - 234s;
-  conn->lossState.totalBytesSentAtLastAck = 10000;
-  conn->lossState.totalBytesAckedAtLastAck = 5000;
   updateConnection(*conn, folly::none, packet.packet, TimePoint(), 555);
 
   // verify QLogger contains correct packet information
@@ -804,24 +835,6 @@ TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionWithBytesStats) {
       13579 + 555,
       getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
           ->totalBytesSent);
-  EXPECT_TRUE(getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-                  ->lastAckedPacketInfo.hasValue());
-  EXPECT_EQ(
-      currentTime - 123s,
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-          ->lastAckedPacketInfo->ackTime);
-  EXPECT_EQ(
-      currentTime -= 234s,
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-          ->lastAckedPacketInfo->sentTime);
-  EXPECT_EQ(
-      10000,
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-          ->lastAckedPacketInfo->totalBytesSent);
-  EXPECT_EQ(
-      5000,
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-          ->lastAckedPacketInfo->totalBytesAcked);
 }
 
 TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionWithCloneResult) {
@@ -981,6 +994,62 @@ TEST_F(QuicTransportFunctionsTest, WriteQuicDataToSocketWithCC) {
       conn->transportSettings.writeConnectionDataPacketsLimit);
 }
 
+TEST_F(QuicTransportFunctionsTest, StartWriteLoopBudget) {
+  auto conn = createConn();
+  auto now = Clock::now();
+  startWriteLoopBudget(*conn, 4, now);
+  EXPECT_FALSE(conn->writeLoopBudget.deadline.hasValue());
+  EXPECT_FALSE(conn->writeLoopBudget.bytesLeft.hasValue());
+  EXPECT_EQ(
+      conn->transportSettings.writeConnectionDataPacketsLimit,
+      getWritePacketLimit(*conn));
+
+  conn->transportSettings.writeLoopTimeBudget = 2000us;
+  conn->transportSettings.writeLoopBytesBudget = conn->udpSendPacketLen * 20;
+  startWriteLoopBudget(*conn, 4, now);
+  EXPECT_EQ(now + 500us, *conn->writeLoopBudget.deadline);
+  EXPECT_EQ(conn->udpSendPacketLen * 5, *conn->writeLoopBudget.bytesLeft);
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), getWritePacketLimit(*conn));
+
+  // Everyone gets at least a minimal slice and a full packet
+  startWriteLoopBudget(*conn, 1000, now);
+  EXPECT_EQ(now + kMinWriteLoopTimeSlice, *conn->writeLoopBudget.deadline);
+  EXPECT_EQ(conn->udpSendPacketLen, *conn->writeLoopBudget.bytesLeft);
+
+  clearWriteLoopBudget(*conn);
+  EXPECT_FALSE(writeLoopBudgetExhausted(*conn));
+}
+
+TEST_F(QuicTransportFunctionsTest, WriteQuicDataToSocketWithBytesBudget) {
+  auto conn = createConn();
+  conn->congestionController.reset();
+  EventBase evb;
+  auto socket = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb);
+  auto rawSocket = socket.get();
+  auto stream1 = conn->streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(
+      *stream1, buildRandomInputData(conn->udpSendPacketLen * 10), false);
+  EXPECT_CALL(*rawSocket, write(_, _))
+      .WillRepeatedly(Invoke([](const SocketAddress&,
+                                const std::unique_ptr<folly::IOBuf>& iobuf) {
+        return iobuf->computeChainDataLength();
+      }));
+  conn->transportSettings.writeLoopBytesBudget = conn->udpSendPacketLen * 2;
+  startWriteLoopBudget(*conn, 1, Clock::now());
+  auto written = writeQuicDataToSocket(
+      *rawSocket,
+      *conn,
+      *conn->clientConnectionId,
+      *conn->serverConnectionId,
+      *aead,
+      *headerCipher,
+      getVersion(*conn),
+      getWritePacketLimit(*conn));
+  EXPECT_GE(written, 2);
+  EXPECT_LT(written, 10);
+  EXPECT_EQ(NoWriteReason::WRITE_BUDGET, conn->debugState.noWriteReason);
+}
+
 TEST_F(QuicTransportFunctionsTest, WriteQuicDataToSocketLimitTest) {
   auto conn = createConn();
   auto mockCongestionController = std::make_unique<MockCongestionController>();
@@ -1074,6 +1143,60 @@ TEST_F(QuicTransportFunctionsTest, WriteQuicDataToSocketLimitTest) {
           conn->transportSettings.writeConnectionDataPacketsLimit));
 }
 
+TEST_F(QuicTransportFunctionsTest, WriteQuicDataToSocketEncryptBatch) {
+  auto conn = createConn();
+  conn->congestionController.reset();
+  conn->udpSendPacketLen = 100;
+  conn->transportSettings.maxEncryptBatchSize = 4;
+  EventBase evb;
+  auto socket = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb);
+  auto rawSocket = socket.get();
+  auto stream1 = conn->streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(*stream1, buildRandomInputData(500), true);
+
+  // Appends a fake tag so the deferred size accounting has to include it.
+  auto batchAead = createNoOpAead();
+  ON_CALL(*batchAead, getCipherOverhead()).WillByDefault(Return(16));
+  std::vector<uint64_t> seqNums;
+  EXPECT_CALL(*batchAead, _encrypt(_, _, _))
+      .WillRepeatedly(Invoke([&](auto& buf, auto, auto seqNum) {
+        seqNums.push_back(seqNum);
+        auto ciphertext = buf->clone();
+        ciphertext->prependChain(IOBuf::create(16));
+        ciphertext->prev()->append(16);
+        return ciphertext;
+      }));
+  std::vector<uint64_t> writtenSizes;
+  EXPECT_CALL(*rawSocket, write(_, _))
+      .WillRepeatedly(Invoke([&](const SocketAddress&,
+                                 const std::unique_ptr<folly::IOBuf>& iobuf) {
+        writtenSizes.push_back(iobuf->computeChainDataLength());
+        return iobuf->computeChainDataLength();
+      }));
+  auto numWritten = writeQuicDataToSocket(
+      *rawSocket,
+      *conn,
+      *conn->clientConnectionId,
+      *conn->serverConnectionId,
+      *batchAead,
+      *headerCipher,
+      getVersion(*conn),
+      conn->transportSettings.writeConnectionDataPacketsLimit);
+  EXPECT_GT(numWritten, 4u);
+  ASSERT_EQ(numWritten, writtenSizes.size());
+  ASSERT_EQ(numWritten, conn->outstandingPackets.size());
+  ASSERT_EQ(numWritten, seqNums.size());
+  for (size_t i = 0; i < numWritten; ++i) {
+    auto& packet = conn->outstandingPackets[i];
+    EXPECT_EQ(writtenSizes[i], packet.encodedSize);
+    EXPECT_EQ(
+        seqNums[i],
+        folly::variant_match(
+            packet.packet.header,
+            [](const auto& h) { return h.getPacketSequenceNum(); }));
+  }
+}
+
 TEST_F(
     QuicTransportFunctionsTest,
     WriteQuicDataToSocketWhenInFlightBytesAreLimited) {
@@ -1483,6 +1606,125 @@ TEST_F(QuicTransportFunctionsTest, TestCryptoWritingIsHandshakeInOutstanding) {
                   ->isHandshake);
 }
 
+TEST_F(QuicTransportFunctionsTest, CoalesceInitialWithOneRttPacket) {
+  auto conn = createConn();
+  conn->transportSettings.coalescePackets = true;
+  auto cryptoStream = &conn->cryptoState->initialStream;
+  writeDataToQuicStream(*cryptoStream, buildRandomInputData(200));
+  auto stream = conn->streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(*stream, buildRandomInputData(100), true);
+  EventBase evb;
+  auto socket = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb);
+  auto rawSocket = socket.get();
+
+  // The Initial packet leaves room in its datagram, so it is held back.
+  EXPECT_CALL(*rawSocket, write(_, _)).Times(0);
+  writeCryptoAndAckDataToSocket(
+      *rawSocket,
+      *conn,
+      *conn->clientConnectionId,
+      *conn->serverConnectionId,
+      LongHeader::Types::Initial,
+      *conn->initialWriteCipher,
+      *conn->initialHeaderCipher,
+      getVersion(*conn),
+      conn->transportSettings.writeConnectionDataPacketsLimit);
+  ASSERT_TRUE(conn->coalescedPackets);
+  auto initialSize = conn->coalescedPackets->computeChainDataLength();
+  EXPECT_EQ(1, conn->outstandingPackets.size());
+  Mock::VerifyAndClearExpectations(rawSocket);
+
+  size_t datagramSize = 0;
+  EXPECT_CALL(*rawSocket, write(_, _))
+      .WillOnce(Invoke([&](const SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& iobuf) {
+        datagramSize = iobuf->computeChainDataLength();
+        return datagramSize;
+      }));
+  writeQuicDataToSocket(
+      *rawSocket,
+      *conn,
+      *conn->clientConnectionId,
+      *conn->serverConnectionId,
+      *aead,
+      *headerCipher,
+      getVersion(*conn),
+      conn->transportSettings.writeConnectionDataPacketsLimit);
+  EXPECT_FALSE(conn->coalescedPackets);
+  EXPECT_EQ(2, conn->outstandingPackets.size());
+  EXPECT_GT(datagramSize, initialSize);
+  EXPECT_LE(datagramSize, conn->udpSendPacketLen);
+}
+
+TEST_F(QuicTransportFunctionsTest, FlushCoalescedPackets) {
+  auto conn = createConn();
+  conn->transportSettings.coalescePackets = true;
+  auto cryptoStream = &conn->cryptoState->initialStream;
+  writeDataToQuicStream(*cryptoStream, buildRandomInputData(200));
+  EventBase evb;
+  auto socket = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb);
+  auto rawSocket = socket.get();
+  EXPECT_CALL(*rawSocket, write(_, _)).Times(0);
+  writeCryptoAndAckDataToSocket(
+      *rawSocket,
+      *conn,
+      *conn->clientConnectionId,
+      *conn->serverConnectionId,
+      LongHeader::Types::Initial,
+      *conn->initialWriteCipher,
+      *conn->initialHeaderCipher,
+      getVersion(*conn),
+      conn->transportSettings.writeConnectionDataPacketsLimit);
+  Mock::VerifyAndClearExpectations(rawSocket);
+
+  EXPECT_CALL(*rawSocket, write(_, _))
+      .WillOnce(Invoke([&](const SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& iobuf) {
+        return iobuf->computeChainDataLength();
+      }));
+  flushCoalescedPackets(*rawSocket, *conn);
+  EXPECT_FALSE(conn->coalescedPackets);
+}
+
+TEST_F(QuicTransportFunctionsTest, WritePmtuProbe) {
+  auto conn = createConn();
+  conn->udpSendPacketLen = 1200;
+  startPmtuDiscovery(*conn, 1500);
+  EventBase evb;
+  auto socket = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb);
+  auto rawSocket = socket.get();
+  auto probeSize = getPmtuProbeSize(*conn, Clock::now());
+  ASSERT_TRUE(probeSize.hasValue());
+  size_t datagramSize = 0;
+  EXPECT_CALL(*rawSocket, write(_, _))
+      .WillOnce(Invoke([&](const SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& iobuf) {
+        datagramSize = iobuf->computeChainDataLength();
+        return datagramSize;
+      }));
+  EXPECT_EQ(
+      1,
+      writeQuicDataToSocket(
+          *rawSocket,
+          *conn,
+          *conn->clientConnectionId,
+          *conn->serverConnectionId,
+          *aead,
+          *headerCipher,
+          getVersion(*conn),
+          conn->transportSettings.writeConnectionDataPacketsLimit));
+  EXPECT_EQ(datagramSize, *probeSize);
+  ASSERT_EQ(1, conn->outstandingPackets.size());
+  auto& probe = conn->outstandingPackets.front();
+  EXPECT_EQ(probe.encodedSize, *probeSize);
+  auto probePacketNum = folly::variant_match(
+      probe.packet.header,
+      [](const auto& h) { return h.getPacketSequenceNum(); });
+  EXPECT_EQ(conn->pmtuDiscoveryState.probePacketNum, probePacketNum);
+  // The probe is in flight, no other one goes out.
+  EXPECT_FALSE(getPmtuProbeSize(*conn, Clock::now()).hasValue());
+}
+
 TEST_F(QuicTransportFunctionsTest, WritePureAckWhenNoWritableBytes) {
   auto conn = createConn();
   auto mockCongestionController = std::make_unique<MockCongestionController>();
@@ -1584,6 +1826,25 @@ TEST_F(QuicTransportFunctionsTest, ShouldWriteDataTest) {
   EXPECT_EQ(WriteDataReason::NO_WRITE, shouldWriteData(*conn));
 }
 
+TEST_F(QuicTransportFunctionsTest, ShouldWriteDataIdleSkipsCongestionCheck) {
+  auto conn = createConn();
+  conn->oneRttWriteCipher = test::createNoOpAead();
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn->congestionController = std::move(mockCongestionController);
+
+  EXPECT_CALL(*rawCongestionController, getWritableBytes()).Times(0);
+  EXPECT_CALL(*transportInfoCb_, onCwndBlocked()).Times(0);
+  EXPECT_EQ(WriteDataReason::NO_WRITE, shouldWriteData(*conn));
+  Mock::VerifyAndClearExpectations(rawCongestionController);
+
+  auto stream1 = conn->streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(*stream1, IOBuf::copyBuffer("0123456789"), false);
+  EXPECT_CALL(*rawCongestionController, getWritableBytes())
+      .WillOnce(Return(1500));
+  EXPECT_EQ(WriteDataReason::STREAM, shouldWriteData(*conn));
+}
+
 TEST_F(QuicTransportFunctionsTest, ShouldWriteStreamsNoCipher) {
   auto conn = createConn();
   auto mockCongestionController = std::make_unique<MockCongestionController>();
@@ -1693,6 +1954,49 @@ TEST_F(QuicTransportFunctionsTest, HasControlFramesToWrite) {
   EXPECT_EQ(WriteDataReason::BLOCKED, hasNonAckDataToWrite(*conn));
 }
 
+TEST_F(QuicTransportFunctionsTest, DeferredWindowUpdatesToWrite) {
+  auto conn = createConn();
+  conn->oneRttWriteCipher = test::createNoOpAead();
+  conn->transportSettings.deferWindowUpdates = true;
+  auto stream = conn->streamManager->createNextBidirectionalStream().value();
+  conn->streamManager->queueWindowUpdate(stream->id);
+  conn->pendingEvents.connWindowUpdate = true;
+  EXPECT_EQ(WriteDataReason::NO_WRITE, hasNonAckDataToWrite(*conn));
+
+  conn->pendingEvents.urgentWindowUpdate = true;
+  EXPECT_EQ(
+      WriteDataReason::STREAM_WINDOW_UPDATE, hasNonAckDataToWrite(*conn));
+}
+
+TEST_F(QuicTransportFunctionsTest, DeferredWindowUpdatesPerPacket) {
+  auto conn = createConn();
+  conn->transportSettings.deferWindowUpdates = true;
+  conn->transportSettings.maxWindowUpdatesPerPacket = 2;
+  for (int i = 0; i < 5; ++i) {
+    auto stream = conn->streamManager->createNextBidirectionalStream().value();
+    conn->streamManager->queueWindowUpdate(stream->id);
+  }
+  ShortHeader shortHeader(
+      ProtectionType::KeyPhaseZero,
+      *conn->serverConnectionId,
+      getNextPacketNum(*conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      conn->udpSendPacketLen,
+      std::move(shortHeader),
+      conn->ackStates.appDataAckState.largestAckedByPeer);
+  WindowUpdateScheduler scheduler(*conn);
+  scheduler.writeWindowUpdates(builder);
+  auto packet = std::move(builder).buildPacket();
+  EXPECT_EQ(
+      2,
+      std::count_if(
+          packet.packet.frames.begin(),
+          packet.packet.frames.end(),
+          [](const auto& frame) {
+            return boost::get<MaxStreamDataFrame>(&frame) != nullptr;
+          }));
+}
+
 TEST_F(QuicTransportFunctionsTest, FlowControlBlocked) {
   auto conn = createConn();
   conn->flowControlState.peerAdvertisedMaxOffset = 1000;
@@ -1704,7 +2008,8 @@ TEST_F(QuicTransportFunctionsTest, HasAppDataToWrite) {
   auto conn = createConn();
   conn->flowControlState.peerAdvertisedMaxOffset = 1000;
   conn->flowControlState.sumCurWriteOffset = 800;
-  conn->streamManager->addWritable(0);
+  auto stream = conn->streamManager->createNextBidirectionalStream().value();
+  conn->streamManager->addWritable(*stream);
   EXPECT_EQ(WriteDataReason::NO_WRITE, hasNonAckDataToWrite(*conn));
 
   conn->oneRttWriteCipher = test::createNoOpAead();
@@ -1742,6 +2047,47 @@ TEST_F(QuicTransportFunctionsTest, ClearBlockedFromPendingEvents) {
       getLastOutstandingPacket(*conn, PacketNumberSpace::Handshake)->pureAck);
 }
 
+TEST_F(QuicTransportFunctionsTest, HasPingToWrite) {
+  auto conn = createConn();
+  conn->pendingEvents.sendPing = true;
+  EXPECT_EQ(WriteDataReason::NO_WRITE, hasNonAckDataToWrite(*conn));
+
+  conn->oneRttWriteCipher = test::createNoOpAead();
+  EXPECT_EQ(WriteDataReason::PING, hasNonAckDataToWrite(*conn));
+}
+
+TEST_F(QuicTransportFunctionsTest, ClearPingFromPendingEvents) {
+  auto conn = createConn();
+  auto packet = buildEmptyPacket(*conn, PacketNumberSpace::AppData);
+  packet.packet.frames.push_back(PingFrame());
+  conn->pendingEvents.sendPing = true;
+  updateConnection(
+      *conn, folly::none, packet.packet, TimePoint(), getEncodedSize(packet));
+  EXPECT_FALSE(conn->pendingEvents.sendPing);
+  EXPECT_EQ(0, conn->outstandingPureAckPacketsCount);
+  EXPECT_FALSE(
+      getLastOutstandingPacket(*conn, PacketNumberSpace::AppData)->pureAck);
+}
+
+TEST_F(QuicTransportFunctionsTest, StreamLimitUpdateToWrite) {
+  auto conn = createConn();
+  conn->oneRttWriteCipher = test::createNoOpAead();
+  conn->streamManager->setInitialMaxRemoteStreams(2, 2);
+  auto stream = conn->streamManager->getStream(0);
+  stream->send.state = StreamSendStates::Closed();
+  stream->recv.state = StreamReceiveStates::Closed();
+  conn->streamManager->removeClosedStream(0);
+  EXPECT_EQ(WriteDataReason::STREAM_LIMIT_UPDATE, hasNonAckDataToWrite(*conn));
+
+  auto packet = buildEmptyPacket(*conn, PacketNumberSpace::AppData);
+  packet.packet.frames.push_back(MaxStreamsFrame(3, true));
+  updateConnection(
+      *conn, folly::none, packet.packet, TimePoint(), getEncodedSize(packet));
+  EXPECT_FALSE(conn->streamManager->hasStreamLimitUpdates());
+  EXPECT_FALSE(
+      getLastOutstandingPacket(*conn, PacketNumberSpace::AppData)->pureAck);
+}
+
 TEST_F(QuicTransportFunctionsTest, ClonedBlocked) {
   auto conn = createConn();
   auto packetEvent = conn->ackStates.appDataAckState.nextPacketNum;
@@ -21,6 +21,7 @@
 #include <quic/handshake/test/Mocks.h>
 #include <quic/server/state/ServerStateMachine.h>
 #include <quic/state/QuicStreamFunctions.h>
+#include <quic/state/QuicStreamUtilities.h>
 #include <quic/state/test/Mocks.h>
 
 using namespace folly;
@@ -451,6 +452,46 @@ TEST_F(QuicTransportTest, AppLimited) {
   transport_->close(folly::none);
 }
 
+TEST_F(QuicTransportTest, AppLimitedWhenFlowControlBlocked) {
+  auto& conn = transport_->getConnectionState();
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  EXPECT_CALL(*rawCongestionController, getWritableBytes())
+      .WillRepeatedly(Return(5000));
+  // A large buffer that the peer doesn't let us send isn't held back by cwnd.
+  conn.flowControlState.peerAdvertisedMaxOffset =
+      conn.flowControlState.sumCurWriteOffset;
+
+  auto stream = transport_->createBidirectionalStream().value();
+  auto buf = buildRandomInputData(100 * 2000);
+  transport_->writeChain(stream, buf->clone(), false, false, nullptr);
+  EXPECT_CALL(*socket_, write(_, _)).WillRepeatedly(Invoke(bufLength));
+  EXPECT_CALL(*rawCongestionController, setAppLimited()).Times(AtLeast(1));
+  loopForWrites();
+  transport_->close(folly::none);
+}
+
+TEST_F(QuicTransportTest, NotAppLimitedWhenWriteLoopLimited) {
+  auto& conn = transport_->getConnectionState();
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  EXPECT_CALL(*rawCongestionController, getWritableBytes())
+      .WillRepeatedly(Return(5000));
+  // The write loop stops short of the end of the buffered data.
+  conn.transportSettings.writeConnectionDataPacketsLimit = 1;
+
+  auto stream = transport_->createBidirectionalStream().value();
+  auto buf = buildRandomInputData(conn.udpSendPacketLen / 2 * 3);
+  transport_->writeChain(stream, buf->clone(), false, false, nullptr);
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  EXPECT_CALL(*rawCongestionController, setAppLimited()).Times(0);
+  loopForWrites();
+  EXPECT_EQ(1, conn.outstandingPackets.size());
+  transport_->close(folly::none);
+}
+
 TEST_F(QuicTransportTest, WriteSmall) {
   // Testing writing a small buffer that could be fit in a single packet
   auto stream = transport_->createBidirectionalStream().value();
@@ -569,6 +610,49 @@ TEST_F(QuicTransportTest, WriteMultipleStreams) {
   verifyCorrectness(conn, 0, s2, *buf2);
 }
 
+TEST_F(QuicTransportTest, WriteChains) {
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto s2 = transport_->createBidirectionalStream().value();
+  auto buf = buildRandomInputData(20);
+  auto buf2 = buildRandomInputData(20);
+  std::vector<QuicSocket::StreamWrite> writes;
+  writes.push_back({s1, buf->clone(), false, nullptr});
+  writes.push_back({s2, buf2->clone(), true, nullptr});
+  // Both writes go out in a single packet.
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  EXPECT_TRUE(transport_->writeChains(folly::range(writes)).hasValue());
+  loopForWrites();
+  auto& conn = transport_->getConnectionState();
+  EXPECT_EQ(1, conn.outstandingPackets.size());
+  verifyCorrectness(conn, 0, s1, *buf);
+  verifyCorrectness(conn, 0, s2, *buf2, true);
+}
+
+TEST_F(QuicTransportTest, WriteChainsInvalid) {
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto s2 = transport_->createBidirectionalStream().value();
+  std::vector<QuicSocket::StreamWrite> writes;
+  writes.push_back({s1, buildRandomInputData(20), false, nullptr});
+  writes.push_back({s2 + 4, buildRandomInputData(20), false, nullptr});
+  EXPECT_CALL(*socket_, write(_, _)).Times(0);
+  auto res = transport_->writeChains(folly::range(writes));
+  EXPECT_EQ(LocalErrorCode::STREAM_NOT_EXISTS, res.error());
+
+  // Nothing after an EOF on the same stream.
+  writes.clear();
+  writes.push_back({s1, buildRandomInputData(20), true, nullptr});
+  writes.push_back({s1, buildRandomInputData(20), false, nullptr});
+  res = transport_->writeChains(folly::range(writes));
+  EXPECT_EQ(LocalErrorCode::STREAM_CLOSED, res.error());
+  loopForWrites();
+
+  // None of the failed batches were written.
+  auto& conn = transport_->getConnectionState();
+  EXPECT_TRUE(conn.streamManager->findStream(s1)->writeBuffer.empty());
+  EXPECT_FALSE(conn.streamManager->findStream(s1)->finalWriteOffset);
+  EXPECT_NE(nullptr, writes[0].data);
+}
+
 TEST_F(QuicTransportTest, WriteFlowControl) {
   auto& conn = transport_->getConnectionState();
   auto streamId = transport_->createBidirectionalStream().value();
@@ -783,6 +867,47 @@ TEST_F(QuicTransportTest, WriteImmediateAcks) {
   EXPECT_EQ(WriteDataReason::NO_WRITE, shouldWriteData(conn));
 }
 
+TEST_F(QuicTransportTest, CoalesceAcksWithReads) {
+  auto& conn = transport_->getConnectionState();
+  conn.transportSettings.coalesceAcksWithReads = true;
+  auto streamId = transport_->createBidirectionalStream().value();
+  auto stream = conn.streamManager->getStream(streamId);
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(folly::IOBuf::copyBuffer("request"), 0));
+  conn.streamManager->updateReadableStreams(*stream);
+  NiceMock<MockReadCallback> readCb;
+  transport_->setReadCallback(streamId, &readCb);
+  conn.ackStates.appDataAckState.needsToSendAckImmediately = true;
+  addAckStatesWithCurrentTimestamps(conn.ackStates.appDataAckState, 10, 15);
+  // The ack waits for the read callback.
+  transport_->updateWriteLooper(true);
+  EXPECT_EQ(WriteDataReason::NO_WRITE, conn.debugState.writeDataReason);
+
+  EXPECT_CALL(readCb, readAvailable(streamId)).WillOnce(Invoke([&](auto id) {
+    transport_->read(id, 0);
+    transport_->writeChain(
+        id, folly::IOBuf::copyBuffer("response"), true, false);
+  }));
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  loopForWrites();
+  ASSERT_EQ(conn.outstandingPackets.size(), 1);
+  auto& packet =
+      getFirstOutstandingPacket(conn, PacketNumberSpace::AppData)->packet;
+  bool ackFound = false;
+  for (auto& ackFrame : all_frames<WriteAckFrame>(packet.frames)) {
+    EXPECT_EQ(15, ackFrame.ackBlocks.back().end);
+    ackFound = true;
+  }
+  EXPECT_TRUE(ackFound);
+  bool streamFound = false;
+  for (auto& streamFrame : all_frames<WriteStreamFrame>(packet.frames)) {
+    EXPECT_EQ(streamId, streamFrame.streamId);
+    streamFound = true;
+  }
+  EXPECT_TRUE(streamFound);
+  EXPECT_FALSE(conn.ackStates.appDataAckState.needsToSendAckImmediately);
+}
+
 TEST_F(QuicTransportTest, NotWriteAcksIfNoData) {
   auto& conn = transport_->getConnectionState();
 
@@ -2308,7 +2433,7 @@ TEST_F(QuicTransportTest, WriteStreamFromMiddleOfMap) {
   conn.outstandingPackets.clear();
 
   // Start from stream2 instead of stream1
-  conn.schedulingState.lastScheduledStream = s2;
+  conn.schedulingState.nextScheduledStream[kDefaultPriorityUrgency] = s2;
   writableBytes = kDefaultUDPSendPacketLen - 100;
 
   EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
@@ -2331,7 +2456,7 @@ TEST_F(QuicTransportTest, WriteStreamFromMiddleOfMap) {
   conn.outstandingPackets.clear();
 
   // Test wrap around
-  conn.schedulingState.lastScheduledStream = s2;
+  conn.schedulingState.nextScheduledStream[kDefaultPriorityUrgency] = s2;
   writableBytes = kDefaultUDPSendPacketLen;
   EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
   writeQuicDataToSocket(
@@ -2357,6 +2482,300 @@ TEST_F(QuicTransportTest, WriteStreamFromMiddleOfMap) {
   transport_->close(folly::none);
 }
 
+TEST_F(QuicTransportTest, SetStreamPriority) {
+  auto& conn = transport_->getConnectionState();
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto stream1 = conn.streamManager->getStream(s1);
+  writeDataToQuicStream(*stream1, buildRandomInputData(100), false);
+  EXPECT_EQ(kDefaultPriorityUrgency, stream1->priority.urgency);
+  EXPECT_FALSE(stream1->priority.incremental);
+
+  EXPECT_FALSE(transport_->setStreamPriority(s1, 0, true).hasValue());
+  EXPECT_EQ(0, stream1->priority.urgency);
+  EXPECT_TRUE(stream1->priority.incremental);
+  auto& writableStreams = conn.streamManager->writableStreams();
+  EXPECT_EQ(1u, writableStreams[0].count(s1));
+  EXPECT_EQ(0u, writableStreams[kDefaultPriorityUrgency].count(s1));
+
+  EXPECT_EQ(
+      LocalErrorCode::INVALID_OPERATION,
+      transport_->setStreamPriority(s1, kMaxPriorityUrgency + 1, false));
+  EXPECT_EQ(
+      LocalErrorCode::STREAM_NOT_EXISTS,
+      transport_->setStreamPriority(s1 + 4, 0, false));
+  transport_->close(folly::none);
+}
+
+TEST_F(QuicTransportTest, WriteStreamsInUrgencyOrder) {
+  auto& conn = transport_->getConnectionState();
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto s2 = transport_->createBidirectionalStream().value();
+  // The later stream is the more urgent one.
+  transport_->setStreamPriority(s2, 0, false);
+
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  uint64_t writableBytes = kDefaultUDPSendPacketLen;
+  EXPECT_CALL(*rawCongestionController, getWritableBytes())
+      .WillRepeatedly(Invoke([&]() {
+        auto res = writableBytes;
+        writableBytes = 0;
+        return res;
+      }));
+
+  auto stream1 = conn.streamManager->getStream(s1);
+  writeDataToQuicStream(*stream1, buildRandomInputData(100), false);
+  auto stream2 = conn.streamManager->getStream(s2);
+  writeDataToQuicStream(
+      *stream2, buildRandomInputData(kDefaultUDPSendPacketLen), false);
+
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  writeQuicDataToSocket(
+      *socket_,
+      conn,
+      *conn.clientConnectionId,
+      *conn.serverConnectionId,
+      *aead_,
+      *headerCipher_,
+      transport_->getVersion(),
+      conn.transportSettings.writeConnectionDataPacketsLimit);
+  ASSERT_EQ(1, conn.outstandingPackets.size());
+  auto& packet = *getFirstOutstandingPacket(conn, PacketNumberSpace::AppData);
+  ASSERT_EQ(1, packet.packet.frames.size());
+  auto streamFrame =
+      boost::get<WriteStreamFrame>(&packet.packet.frames.front());
+  ASSERT_TRUE(streamFrame);
+  EXPECT_EQ(s2, streamFrame->streamId);
+  EXPECT_EQ(0u, stream1->currentWriteOffset);
+  transport_->close(folly::none);
+}
+
+TEST_F(QuicTransportTest, WriteIncrementalStreamsRoundRobin) {
+  auto& conn = transport_->getConnectionState();
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto s2 = transport_->createBidirectionalStream().value();
+  transport_->setStreamPriority(s1, kDefaultPriorityUrgency, true);
+  transport_->setStreamPriority(s2, kDefaultPriorityUrgency, true);
+
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  uint64_t writableBytes = 0;
+  EXPECT_CALL(*rawCongestionController, getWritableBytes())
+      .WillRepeatedly(Invoke([&]() {
+        auto res = writableBytes;
+        writableBytes = 0;
+        return res;
+      }));
+
+  auto stream1 = conn.streamManager->getStream(s1);
+  writeDataToQuicStream(
+      *stream1, buildRandomInputData(kDefaultUDPSendPacketLen * 3), false);
+  auto stream2 = conn.streamManager->getStream(s2);
+  writeDataToQuicStream(
+      *stream2, buildRandomInputData(kDefaultUDPSendPacketLen * 3), false);
+
+  EXPECT_CALL(*socket_, write(_, _)).WillRepeatedly(Invoke(bufLength));
+  std::vector<StreamId> expectedOrder = {s1, s2, s1, s2};
+  for (auto expectedStream : expectedOrder) {
+    writableBytes = kDefaultUDPSendPacketLen;
+    conn.outstandingPackets.clear();
+    writeQuicDataToSocket(
+        *socket_,
+        conn,
+        *conn.clientConnectionId,
+        *conn.serverConnectionId,
+        *aead_,
+        *headerCipher_,
+        transport_->getVersion(),
+        conn.transportSettings.writeConnectionDataPacketsLimit);
+    ASSERT_EQ(1, conn.outstandingPackets.size());
+    auto& packet =
+        *getFirstOutstandingPacket(conn, PacketNumberSpace::AppData);
+    ASSERT_EQ(1, packet.packet.frames.size());
+    auto streamFrame =
+        boost::get<WriteStreamFrame>(&packet.packet.frames.front());
+    ASSERT_TRUE(streamFrame);
+    EXPECT_EQ(expectedStream, streamFrame->streamId);
+  }
+  transport_->close(folly::none);
+}
+
+TEST_F(QuicTransportTest, WriteStreamsWeightedFairQueueing) {
+  auto& conn = transport_->getConnectionState();
+  conn.transportSettings.streamSchedulingMode =
+      StreamSchedulingMode::WeightedFairQueueing;
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto s2 = transport_->createBidirectionalStream().value();
+  EXPECT_FALSE(transport_->setStreamWeight(s1, 2).hasValue());
+  EXPECT_EQ(
+      LocalErrorCode::INVALID_OPERATION, transport_->setStreamWeight(s2, 0));
+
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  uint64_t writableBytes = 0;
+  EXPECT_CALL(*rawCongestionController, getWritableBytes())
+      .WillRepeatedly(Invoke([&]() {
+        auto res = writableBytes;
+        writableBytes = 0;
+        return res;
+      }));
+
+  auto stream1 = conn.streamManager->getStream(s1);
+  writeDataToQuicStream(
+      *stream1, buildRandomInputData(kDefaultUDPSendPacketLen * 40), false);
+  auto stream2 = conn.streamManager->getStream(s2);
+  writeDataToQuicStream(
+      *stream2, buildRandomInputData(kDefaultUDPSendPacketLen * 40), false);
+
+  EXPECT_CALL(*socket_, write(_, _)).WillRepeatedly(Invoke(bufLength));
+  // The first turn belongs to the weighted stream, which writes two packets
+  // worth of bytes before the other stream starts.
+  for (int i = 0; i < 30; ++i) {
+    writableBytes = kDefaultUDPSendPacketLen;
+    writeQuicDataToSocket(
+        *socket_,
+        conn,
+        *conn.clientConnectionId,
+        *conn.serverConnectionId,
+        *aead_,
+        *headerCipher_,
+        transport_->getVersion(),
+        conn.transportSettings.writeConnectionDataPacketsLimit);
+    if (i == 0) {
+      EXPECT_EQ(0u, stream2->currentWriteOffset);
+    }
+  }
+  EXPECT_NEAR(
+      double(stream1->currentWriteOffset) / stream2->currentWriteOffset,
+      2.0,
+      0.3);
+  transport_->close(folly::none);
+}
+
+TEST_F(QuicTransportTest, WriteStreamsSendRate) {
+  auto& conn = transport_->getConnectionState();
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto s2 = transport_->createBidirectionalStream().value();
+  // Slow enough for a burst to be a single packet.
+  EXPECT_FALSE(transport_->setStreamSendRate(s1, 1000).hasValue());
+
+  auto stream1 = conn.streamManager->getStream(s1);
+  writeDataToQuicStream(
+      *stream1, buildRandomInputData(conn.udpSendPacketLen * 4), false);
+  auto stream2 = conn.streamManager->getStream(s2);
+  writeDataToQuicStream(
+      *stream2, buildRandomInputData(conn.udpSendPacketLen * 2), false);
+
+  EXPECT_CALL(*socket_, write(_, _)).WillRepeatedly(Invoke(bufLength));
+  writeQuicDataToSocket(
+      *socket_,
+      conn,
+      *conn.clientConnectionId,
+      *conn.serverConnectionId,
+      *aead_,
+      *headerCipher_,
+      transport_->getVersion(),
+      conn.transportSettings.writeConnectionDataPacketsLimit);
+  EXPECT_GT(stream1->currentWriteOffset, 0u);
+  EXPECT_LE(stream1->currentWriteOffset, conn.udpSendPacketLen);
+  EXPECT_EQ(stream2->currentWriteOffset, conn.udpSendPacketLen * 2);
+
+  // The limited stream waits out of the writable streams.
+  EXPECT_FALSE(conn.streamManager->writableContains(s1));
+  EXPECT_EQ(1u, conn.streamManager->rateLimitedStreams().count(s1));
+  EXPECT_GT(getStreamSendRateDelay(*stream1, Clock::now()).count(), 0);
+
+  // Lifting the limit makes it writable again.
+  EXPECT_FALSE(transport_->setStreamSendRate(s1, 0).hasValue());
+  EXPECT_TRUE(conn.streamManager->writableContains(s1));
+  EXPECT_FALSE(conn.streamManager->hasRateLimited());
+  transport_->close(folly::none);
+}
+
+TEST_F(QuicTransportTest, WriteDueStreamsFirst) {
+  auto& conn = transport_->getConnectionState();
+  conn.lossState.srtt = 10ms;
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto s2 = transport_->createBidirectionalStream().value();
+  transport_->setStreamPriority(s1, 0, false);
+
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  uint64_t writableBytes = kDefaultUDPSendPacketLen;
+  EXPECT_CALL(*rawCongestionController, getWritableBytes())
+      .WillRepeatedly(Invoke([&]() {
+        auto res = writableBytes;
+        writableBytes = 0;
+        return res;
+      }));
+
+  auto stream1 = conn.streamManager->getStream(s1);
+  writeDataToQuicStream(
+      *stream1, buildRandomInputData(kDefaultUDPSendPacketLen), false);
+  // Due within an srtt, but still deliverable.
+  transport_->writeChain(
+      s2, buildRandomInputData(100), false, false, nullptr, Clock::now() + 8ms);
+  EXPECT_TRUE(conn.streamManager->hasDeadlines());
+
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  writeQuicDataToSocket(
+      *socket_,
+      conn,
+      *conn.clientConnectionId,
+      *conn.serverConnectionId,
+      *aead_,
+      *headerCipher_,
+      transport_->getVersion(),
+      conn.transportSettings.writeConnectionDataPacketsLimit);
+  ASSERT_EQ(1, conn.outstandingPackets.size());
+  auto& packet = *getFirstOutstandingPacket(conn, PacketNumberSpace::AppData);
+  ASSERT_EQ(2, packet.packet.frames.size());
+  auto streamFrame =
+      boost::get<WriteStreamFrame>(&packet.packet.frames.front());
+  ASSERT_TRUE(streamFrame);
+  EXPECT_EQ(s2, streamFrame->streamId);
+  EXPECT_EQ(100, streamFrame->len);
+  auto streamFrame2 =
+      boost::get<WriteStreamFrame>(&packet.packet.frames.back());
+  ASSERT_TRUE(streamFrame2);
+  EXPECT_EQ(s1, streamFrame2->streamId);
+  transport_->close(folly::none);
+}
+
+TEST_F(QuicTransportTest, ExpireMissedWriteDeadline) {
+  auto& conn = transport_->getConnectionState();
+  conn.partialReliabilityEnabled = true;
+  conn.lossState.srtt = 10ms;
+  auto streamId = transport_->createBidirectionalStream().value();
+  auto stream = conn.streamManager->getStream(streamId);
+  // Even if sent right away it would arrive after the deadline.
+  transport_->writeChain(
+      streamId,
+      buildRandomInputData(100),
+      false,
+      false,
+      nullptr,
+      Clock::now() + 1ms);
+  EXPECT_CALL(*socket_, write(_, _)).WillRepeatedly(Invoke(bufLength));
+  loopForWrites();
+
+  EXPECT_EQ(100u, stream->minimumRetransmittableOffset);
+  EXPECT_EQ(100u, stream->currentWriteOffset);
+  EXPECT_TRUE(stream->writeBuffer.empty());
+  EXPECT_TRUE(stream->writeDeadlines.empty());
+  EXPECT_FALSE(conn.streamManager->hasDeadlines());
+  for (const auto& packet : conn.outstandingPackets) {
+    for (const auto& frame : packet.packet.frames) {
+      EXPECT_FALSE(boost::get<WriteStreamFrame>(&frame));
+    }
+  }
+  transport_->close(folly::none);
+}
+
 TEST_F(QuicTransportTest, NoStream) {
   auto& conn = transport_->getConnectionState();
   EventBase evb;
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicWriteScheduler.h>
+
+#include <gtest/gtest.h>
+
+namespace quic {
+namespace testing {
+
+class TestWriter : public QuicWriteScheduler::Writer {
+ public:
+  TestWriter(
+      QuicWriteScheduler& scheduler,
+      std::vector<int>& order,
+      int id,
+      size_t numWrites)
+      : scheduler_(scheduler),
+        order_(order),
+        id_(id),
+        numWritesLeft_(numWrites) {}
+
+  void onScheduledWrite() noexcept override {
+    order_.push_back(id_);
+    if (--numWritesLeft_ > 0) {
+      scheduler_.schedule(*this);
+    }
+    if (onWrite) {
+      onWrite();
+    }
+  }
+
+  std::function<void()> onWrite;
+
+ private:
+  QuicWriteScheduler& scheduler_;
+  std::vector<int>& order_;
+  int id_;
+  size_t numWritesLeft_;
+};
+
+TEST(QuicWriteSchedulerTest, RoundRobinOncePerLoop) {
+  folly::EventBase evb;
+  QuicWriteScheduler scheduler(&evb);
+  std::vector<int> order;
+  TestWriter writer1(scheduler, order, 1, 3);
+  TestWriter writer2(scheduler, order, 2, 1);
+  TestWriter writer3(scheduler, order, 3, 2);
+  scheduler.schedule(writer1);
+  scheduler.schedule(writer2);
+  scheduler.schedule(writer3);
+  // Scheduling twice doesn't give a writer another turn.
+  scheduler.schedule(writer1);
+  EXPECT_EQ(scheduler.size(), 3);
+
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(order, std::vector<int>({1, 2, 3}));
+  EXPECT_EQ(scheduler.size(), 2);
+
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(order, std::vector<int>({1, 2, 3, 1, 3}));
+
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(order, std::vector<int>({1, 2, 3, 1, 3, 1}));
+  EXPECT_EQ(scheduler.size(), 0);
+  EXPECT_FALSE(scheduler.isLoopCallbackScheduled());
+}
+
+TEST(QuicWriteSchedulerTest, UnscheduleDuringPass) {
+  folly::EventBase evb;
+  QuicWriteScheduler scheduler(&evb);
+  std::vector<int> order;
+  TestWriter writer1(scheduler, order, 1, 1);
+  TestWriter writer2(scheduler, order, 2, 1);
+  writer1.onWrite = [&] { scheduler.unschedule(writer2); };
+  scheduler.schedule(writer1);
+  scheduler.schedule(writer2);
+  EXPECT_TRUE(scheduler.isScheduled(writer2));
+
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(order, std::vector<int>({1}));
+  EXPECT_FALSE(scheduler.isScheduled(writer2));
+  EXPECT_EQ(scheduler.size(), 0);
+}
+
+} // namespace testing
+} // namespace quic
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicZeroCopy.h>
+
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+namespace quic {
+namespace test {
+
+class ZeroCopySendTrackerTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    sock_ = std::make_unique<folly::AsyncUDPSocket>(&evb_);
+    sock_->bind(folly::SocketAddress("127.0.0.1", 0));
+    tracker_ =
+        ZeroCopySendTracker::create(sock_->getNetworkSocket(), kThreshold);
+  }
+
+  // Builds an error queue message like the one the kernel sends once the
+  // zero copy sends in [lo, hi] have completed.
+  const cmsghdr& completion(uint32_t lo, uint32_t hi, uint8_t origin) {
+    memset(control_, 0, sizeof(control_));
+    auto cmsg = reinterpret_cast<cmsghdr*>(control_);
+    cmsg->cmsg_level = SOL_IP;
+    cmsg->cmsg_type = IP_RECVERR;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(sock_extended_err));
+    sock_extended_err serr = {};
+    serr.ee_origin = origin;
+    serr.ee_info = lo;
+    serr.ee_data = hi;
+    memcpy(CMSG_DATA(cmsg), &serr, sizeof(serr));
+    return *cmsg;
+  }
+
+ protected:
+  static constexpr size_t kThreshold = 100;
+  folly::EventBase evb_;
+  std::unique_ptr<folly::AsyncUDPSocket> sock_;
+  std::unique_ptr<ZeroCopySendTracker> tracker_;
+  alignas(cmsghdr) char control_[CMSG_SPACE(sizeof(sock_extended_err))];
+};
+
+TEST_F(ZeroCopySendTrackerTest, Threshold) {
+  if (!tracker_) {
+    return;
+  }
+  EXPECT_FALSE(tracker_->shouldUseZeroCopy(kThreshold - 1));
+  EXPECT_TRUE(tracker_->shouldUseZeroCopy(kThreshold));
+}
+
+TEST_F(ZeroCopySendTrackerTest, HoldBuffersUntilCompletion) {
+  if (!tracker_) {
+    return;
+  }
+  auto buf = folly::IOBuf::copyBuffer(std::string(200, 'a'));
+  for (auto i = 0; i < 3; i++) {
+    ASSERT_GE(tracker_->writeGSO(sock_->address(), buf, 100), 0);
+  }
+  EXPECT_EQ(tracker_->numPendingBuffers(), 3);
+
+  // not a zero copy completion
+  EXPECT_FALSE(tracker_->onErrMessage(completion(0, 2, 0)));
+  EXPECT_EQ(tracker_->numPendingBuffers(), 3);
+
+  EXPECT_TRUE(
+      tracker_->onErrMessage(completion(0, 1, SO_EE_ORIGIN_ZEROCOPY)));
+  EXPECT_EQ(tracker_->numPendingBuffers(), 1);
+  EXPECT_TRUE(
+      tracker_->onErrMessage(completion(2, 2, SO_EE_ORIGIN_ZEROCOPY)));
+  EXPECT_EQ(tracker_->numPendingBuffers(), 0);
+}
+
+} // namespace test
+} // namespace quic
+
+#endif
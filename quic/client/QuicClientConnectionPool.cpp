@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/QuicClientConnectionPool.h>
+
+#include <folly/hash/Hash.h>
+
+#include <atomic>
+
+namespace quic {
+
+size_t QuicConnectionPoolKeyHash::operator()(
+    const QuicConnectionPoolKey& key) const {
+  return folly::hash::hash_combine(key.host, key.port, key.alpn);
+}
+
+/**
+ * A connection of the pool and its connection callback. The fields guarded
+ * by the pool's mutex are what requests from other threads look at, the
+ * transport itself is only touched on evb.
+ */
+class QuicClientConnectionPool::PooledConnection
+    : public QuicSocket::ConnectionCallback,
+      public folly::HHWheelTimer::Callback,
+      public std::enable_shared_from_this<PooledConnection> {
+ public:
+  PooledConnection(
+      QuicClientConnectionPool& pool,
+      folly::EventBase* evbIn,
+      QuicConnectionPoolKey keyIn)
+      : evb(evbIn), key(std::move(keyIn)), pool_(pool) {}
+
+  void start() {
+    if (abandoned) {
+      // The pool closed before this ran and may be gone already.
+      return;
+    }
+    transport = pool_.transportFactory_(evb, key);
+    if (!transport) {
+      pool_.onConnectionClosed(
+          this,
+          std::make_pair(
+              QuicErrorCode(LocalErrorCode::CONNECT_FAILED),
+              std::string("No transport for the pooled connection")));
+      return;
+    }
+    transport->start(this);
+  }
+
+  void scheduleRefresh() {
+    evb->timer().scheduleTimeout(this, pool_.options_.refreshInterval);
+  }
+
+  void onNewBidirectionalStream(StreamId id) noexcept override {
+    // Requests are only ever sent by us.
+    VLOG(4) << "Pooled connection rejects peer stream=" << id;
+    transport->stopSending(id, GenericApplicationErrorCode::UNKNOWN);
+  }
+
+  void onNewUnidirectionalStream(StreamId id) noexcept override {
+    VLOG(4) << "Pooled connection rejects peer stream=" << id;
+    transport->stopSending(id, GenericApplicationErrorCode::UNKNOWN);
+  }
+
+  void onStopSending(StreamId id, ApplicationErrorCode error) noexcept
+      override {
+    VLOG(4) << "Pooled connection got StopSending stream=" << id
+            << " error=" << error;
+  }
+
+  void onTransportReady() noexcept override {
+    pool_.onConnectionReady(this);
+  }
+
+  void onConnectionEnd() noexcept override {
+    pool_.onConnectionClosed(
+        this,
+        std::make_pair(
+            QuicErrorCode(LocalErrorCode::CONNECTION_CLOSED),
+            std::string("Pooled connection closed")));
+  }
+
+  void onConnectionError(
+      std::pair<QuicErrorCode, std::string> error) noexcept override {
+    pool_.onConnectionClosed(this, std::move(error));
+  }
+
+  void timeoutExpired() noexcept override {
+    {
+      std::lock_guard<std::mutex> guard(pool_.mutex_);
+      if (closed) {
+        return;
+      }
+      openableStreams = transport->getNumOpenableBidirectionalStreams();
+    }
+    scheduleRefresh();
+  }
+
+  void callbackCanceled() noexcept override {}
+
+  folly::EventBase* const evb;
+  const QuicConnectionPoolKey key;
+  // Only used on evb.
+  std::shared_ptr<QuicClientTransport> transport;
+
+  // Guarded by the pool's mutex.
+  bool ready{false};
+  bool closed{false};
+  // Streams the transport can open, less the requests handed out since it
+  // was last refreshed.
+  uint64_t openableStreams{0};
+  TimePoint lastUsed;
+  std::chrono::milliseconds idleTimeout{0};
+  // Requests waiting for the handshake.
+  std::vector<Callback*> waiters;
+  // Set by closeAll, which may run before start on an idle event base.
+  std::atomic<bool> abandoned{false};
+
+ private:
+  QuicClientConnectionPool& pool_;
+};
+
+QuicClientConnectionPool::QuicClientConnectionPool(
+    std::vector<folly::EventBase*> evbs,
+    TransportFactory transportFactory,
+    Options options)
+    : evbs_(std::move(evbs)),
+      transportFactory_(std::move(transportFactory)),
+      options_(std::move(options)) {
+  CHECK(!evbs_.empty());
+  CHECK_GT(options_.maxConnectionsPerKey, 0u);
+}
+
+QuicClientConnectionPool::~QuicClientConnectionPool() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    closing_ = true;
+  }
+  closeAll();
+}
+
+void QuicClientConnectionPool::getConnection(
+    const QuicConnectionPoolKey& key,
+    Callback* callback) {
+  CHECK(callback);
+  std::shared_ptr<PooledConnection> chosen;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (closing_) {
+      failRequest(
+          callback,
+          std::make_pair(
+              QuicErrorCode(LocalErrorCode::SHUTTING_DOWN),
+              std::string("Connection pool closing")));
+      return;
+    }
+    auto& connections = connections_[key];
+    auto now = Clock::now();
+    PooledConnection* connecting = nullptr;
+    for (auto& conn : connections) {
+      if (!conn->ready) {
+        connecting = connecting ? connecting : conn.get();
+        continue;
+      }
+      if (conn->openableStreams <= options_.minOpenableStreams) {
+        continue;
+      }
+      if (conn->idleTimeout.count() > 0 &&
+          now - conn->lastUsed + options_.idleTimeoutMargin >=
+              conn->idleTimeout) {
+        continue;
+      }
+      conn->openableStreams--;
+      conn->lastUsed = now;
+      chosen = conn;
+      break;
+    }
+    if (!chosen) {
+      if (connecting) {
+        connecting->waiters.push_back(callback);
+      } else if (connections.size() < options_.maxConnectionsPerKey) {
+        startConnection(key)->waiters.push_back(callback);
+      } else {
+        failRequest(
+            callback,
+            std::make_pair(
+                QuicErrorCode(LocalErrorCode::STREAM_LIMIT_EXCEEDED),
+                std::string("All pooled connections are busy")));
+      }
+      return;
+    }
+  }
+  handOut(std::move(chosen), key, callback);
+}
+
+void QuicClientConnectionPool::prewarm(
+    const QuicConnectionPoolKey& key,
+    size_t numConnections) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (closing_) {
+    return;
+  }
+  numConnections = std::min(numConnections, options_.maxConnectionsPerKey);
+  while (connections_[key].size() < numConnections) {
+    startConnection(key);
+  }
+}
+
+void QuicClientConnectionPool::closeAll() {
+  std::vector<std::shared_ptr<PooledConnection>> closing;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto& entry : connections_) {
+      closing.insert(closing.end(), entry.second.begin(), entry.second.end());
+    }
+    connections_.clear();
+  }
+  for (auto& conn : closing) {
+    conn->abandoned = true;
+    conn->evb->runImmediatelyOrRunInEventBaseThreadAndWait([&] {
+      std::vector<Callback*> waiters;
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        conn->closed = true;
+        waiters.swap(conn->waiters);
+      }
+      conn->cancelTimeout();
+      if (conn->transport) {
+        conn->transport->closeNow(folly::none);
+        conn->transport.reset();
+      }
+      for (auto waiter : waiters) {
+        waiter->onConnectionError(std::make_pair(
+            QuicErrorCode(LocalErrorCode::SHUTTING_DOWN),
+            std::string("Connection pool closing")));
+      }
+    });
+  }
+}
+
+size_t QuicClientConnectionPool::getNumConnections(
+    const QuicConnectionPoolKey& key) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = connections_.find(key);
+  return it == connections_.end() ? 0 : it->second.size();
+}
+
+std::shared_ptr<QuicClientConnectionPool::PooledConnection>
+QuicClientConnectionPool::startConnection(const QuicConnectionPoolKey& key) {
+  auto evb = evbs_[nextEvb_++ % evbs_.size()];
+  auto conn = std::make_shared<PooledConnection>(*this, evb, key);
+  connections_[key].push_back(conn);
+  evb->runInEventBaseThread([conn] { conn->start(); });
+  return conn;
+}
+
+void QuicClientConnectionPool::failRequest(
+    Callback* callback,
+    std::pair<QuicErrorCode, std::string> error) {
+  evbs_[nextEvb_++ % evbs_.size()]->runInEventBaseThread(
+      [callback, error = std::move(error)]() mutable {
+        callback->onConnectionError(std::move(error));
+      });
+}
+
+void QuicClientConnectionPool::handOut(
+    std::shared_ptr<PooledConnection> conn,
+    const QuicConnectionPoolKey& key,
+    Callback* callback) {
+  auto evb = conn->evb;
+  evb->runImmediatelyOrRunInEventBaseThread(
+      [this, conn = std::move(conn), key, callback] {
+        auto transport = conn->transport;
+        if (transport && transport->good() &&
+            transport->getNumOpenableBidirectionalStreams() > 0) {
+          callback->onConnectionReady(std::move(transport));
+          return;
+        }
+        // The peer hasn't raised the stream limit since the last refresh, or
+        // the connection is going away.
+        {
+          std::lock_guard<std::mutex> guard(mutex_);
+          conn->openableStreams = 0;
+        }
+        getConnection(key, callback);
+      });
+}
+
+void QuicClientConnectionPool::onConnectionReady(PooledConnection* conn) {
+  auto self = conn->shared_from_this();
+  auto transport = conn->transport;
+  std::vector<Callback*> ready;
+  std::vector<Callback*> retry;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (conn->closed) {
+      return;
+    }
+    conn->ready = true;
+    conn->lastUsed = Clock::now();
+    conn->idleTimeout = transport->getTransportSettings().idleTimeout;
+    conn->openableStreams = transport->getNumOpenableBidirectionalStreams();
+    for (auto waiter : conn->waiters) {
+      if (conn->openableStreams > options_.minOpenableStreams) {
+        conn->openableStreams--;
+        ready.push_back(waiter);
+      } else {
+        retry.push_back(waiter);
+      }
+    }
+    conn->waiters.clear();
+  }
+  conn->scheduleRefresh();
+  for (auto waiter : ready) {
+    waiter->onConnectionReady(transport);
+  }
+  // More requests waited than the connection has streams for.
+  for (auto waiter : retry) {
+    getConnection(conn->key, waiter);
+  }
+}
+
+void QuicClientConnectionPool::onConnectionClosed(
+    PooledConnection* conn,
+    std::pair<QuicErrorCode, std::string> error) {
+  auto self = conn->shared_from_this();
+  std::vector<Callback*> waiters;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (conn->closed) {
+      return;
+    }
+    conn->closed = true;
+    waiters.swap(conn->waiters);
+    auto it = connections_.find(conn->key);
+    if (it != connections_.end()) {
+      it->second.remove(self);
+      if (it->second.empty()) {
+        connections_.erase(it);
+      }
+    }
+  }
+  conn->cancelTimeout();
+  for (auto waiter : waiters) {
+    waiter->onConnectionError(error);
+  }
+  // The transport is still calling into conn, both are released once it's
+  // done.
+  conn->evb->runInLoop([self] {});
+}
+
+} // namespace quic
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/client/QuicClientTransport.h>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/HHWheelTimer.h>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace quic {
+
+struct QuicConnectionPoolKey {
+  std::string host;
+  uint16_t port{0};
+  std::string alpn;
+
+  bool operator==(const QuicConnectionPoolKey& other) const {
+    return host == other.host && port == other.port && alpn == other.alpn;
+  }
+};
+
+struct QuicConnectionPoolKeyHash {
+  size_t operator()(const QuicConnectionPoolKey& key) const;
+};
+
+/**
+ * Pool of client connections shared by the requests to the same
+ * (host, port, ALPN), the QUIC equivalent of an HTTP/2 session pool.
+ *
+ * A request gets an established transport for as long as the transport can
+ * open more bidirectional streams than minOpenableStreams and it was used
+ * recently enough not to be close to its idle timeout. Otherwise it goes to
+ * another connection of the same key, or to a new one once all of them are
+ * busy, up to maxConnectionsPerKey. Connections that are not handed out any
+ * more are left to finish their streams and idle out.
+ *
+ * The connections are spread round robin over a shared set of event bases.
+ * The pool can be used from any thread, but each transport and the callbacks
+ * about it only ever run on the event base of the transport.
+ */
+class QuicClientConnectionPool {
+ public:
+  /**
+   * Makes a transport for key on evb, with its peer address, hostname, fizz
+   * context (and so ALPN) and transport settings set but not started. Runs on
+   * evb.
+   */
+  using TransportFactory = std::function<std::shared_ptr<QuicClientTransport>(
+      folly::EventBase* evb,
+      const QuicConnectionPoolKey& key)>;
+
+  class Callback {
+   public:
+    virtual ~Callback() = default;
+
+    /**
+     * The transport to open the request's stream on. Invoked on the event
+     * base of the transport, the stream should be created right away since
+     * it was counted against the transport's stream limit.
+     */
+    virtual void onConnectionReady(
+        std::shared_ptr<QuicClientTransport> transport) noexcept = 0;
+
+    /**
+     * Invoked when the connection the request waited for failed, on the event
+     * base that connection was on.
+     */
+    virtual void onConnectionError(
+        std::pair<QuicErrorCode, std::string> error) noexcept = 0;
+  };
+
+  struct Options {
+    size_t maxConnectionsPerKey{kDefaultConnectionPoolMaxConnectionsPerKey};
+    // Streams every pooled connection keeps in reserve, a connection with no
+    // more openable streams than this is not handed out any more.
+    uint64_t minOpenableStreams{0};
+    // A connection that was not handed out for longer than its idle timeout
+    // minus this margin may be closed any moment, so it is not reused.
+    std::chrono::milliseconds idleTimeoutMargin{
+        kDefaultConnectionPoolIdleTimeoutMargin};
+    // How often each connection refreshes the streams it can open, which the
+    // peer raises with MAX_STREAMS as requests finish.
+    std::chrono::milliseconds refreshInterval{
+        kDefaultConnectionPoolRefreshInterval};
+  };
+
+  QuicClientConnectionPool(
+      std::vector<folly::EventBase*> evbs,
+      TransportFactory transportFactory,
+      Options options);
+
+  // Closes all the pooled connections and waits for them.
+  ~QuicClientConnectionPool();
+
+  /**
+   * Hands a connection for key to callback, which must stay alive until it
+   * is invoked.
+   */
+  void getConnection(const QuicConnectionPoolKey& key, Callback* callback);
+
+  /**
+   * Starts connections for key until there are numConnections of them, ready
+   * or still connecting, so that the first requests skip the handshake.
+   */
+  void prewarm(const QuicConnectionPoolKey& key, size_t numConnections);
+
+  /**
+   * Closes all the pooled connections, the requests that are waiting for one
+   * get LocalErrorCode::SHUTTING_DOWN.
+   */
+  void closeAll();
+
+  // Connections of key, ready or still connecting.
+  size_t getNumConnections(const QuicConnectionPoolKey& key) const;
+
+ private:
+  class PooledConnection;
+  using Connections = std::list<std::shared_ptr<PooledConnection>>;
+
+  // Must be called with mutex_ held.
+  std::shared_ptr<PooledConnection> startConnection(
+      const QuicConnectionPoolKey& key);
+
+  // Reports error to callback on one of the event bases.
+  void failRequest(
+      Callback* callback,
+      std::pair<QuicErrorCode, std::string> error);
+
+  // Hands conn to callback on its event base, or goes back to getConnection
+  // if conn turned out to be unusable in the meantime.
+  void handOut(
+      std::shared_ptr<PooledConnection> conn,
+      const QuicConnectionPoolKey& key,
+      Callback* callback);
+
+  void onConnectionReady(PooledConnection* conn);
+
+  void onConnectionClosed(
+      PooledConnection* conn,
+      std::pair<QuicErrorCode, std::string> error);
+
+  const std::vector<folly::EventBase*> evbs_;
+  const TransportFactory transportFactory_;
+  const Options options_;
+  mutable std::mutex mutex_;
+  std::unordered_map<
+      QuicConnectionPoolKey,
+      Connections,
+      QuicConnectionPoolKeyHash>
+      connections_;
+  size_t nextEvb_{0};
+  bool closing_{false};
+};
+
+} // namespace quic
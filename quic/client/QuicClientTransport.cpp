@@ -8,17 +8,24 @@
 
 #include <quic/client/QuicClientTransport.h>
 
+#include <folly/net/NetOps.h>
 #include <folly/portability/Sockets.h>
 
+#include <quic/api/QuicECN.h>
+#include <quic/api/QuicGRO.h>
+#include <quic/api/QuicRxTimestamp.h>
 #include <quic/api/QuicTransportFunctions.h>
 #include <quic/client/handshake/ClientTransportParametersExtension.h>
 #include <quic/client/state/ClientStateMachine.h>
 #include <quic/flowcontrol/QuicFlowController.h>
+#include <quic/handshake/CertCompression.h>
 #include <quic/happyeyeballs/QuicHappyEyeballsFunctions.h>
 #include <quic/logging/QLoggerConstants.h>
 #include <quic/loss/QuicLossFunctions.h>
 #include <quic/state/AckHandlers.h>
+#include <quic/state/QuicFecFunctions.h>
 #include <quic/state/QuicPacingFunctions.h>
+#include <quic/state/QuicStreamFunctions.h>
 
 namespace fsp = folly::portability::sockets;
 
@@ -68,6 +75,7 @@ QuicClientTransport::~QuicClientTransport() {
     sock->pauseRead();
     sock->close();
   }
+  closeStandbyPath();
 }
 
 void QuicClientTransport::processUDPData(
@@ -75,20 +83,33 @@ void QuicClientTransport::processUDPData(
     NetworkData&& networkData) {
   folly::IOBufQueue udpData{folly::IOBufQueue::cacheChainLength()};
   udpData.append(std::move(networkData.data));
-  for (uint16_t processedPackets = 0;
-       !udpData.empty() && processedPackets < kMaxNumCoalescedPackets;
-       processedPackets++) {
-    processPacketData(peer, networkData.receiveTimePoint, udpData);
-  }
-  VLOG_IF(4, !udpData.empty())
-      << "Leaving " << udpData.chainLength()
-      << " bytes unprocessed after attempting to process "
-      << kMaxNumCoalescedPackets << " packets.";
+  for (size_t datagram = 0; datagram <= networkData.batch.size();
+       ++datagram) {
+    if (datagram > 0) {
+      if (closeState_ == CloseState::CLOSED) {
+        // One of the previous datagrams closed the connection.
+        return;
+      }
+      udpData.move();
+      udpData.append(std::move(networkData.batch[datagram - 1]));
+    }
+    for (uint16_t processedPackets = 0;
+         !udpData.empty() && processedPackets < kMaxNumCoalescedPackets;
+         processedPackets++) {
+      processPacketData(
+          peer, networkData.receiveTimePoint, networkData.ecn, udpData);
+    }
+    VLOG_IF(4, !udpData.empty())
+        << "Leaving " << udpData.chainLength()
+        << " bytes unprocessed after attempting to process "
+        << kMaxNumCoalescedPackets << " packets.";
+  }
 }
 
 void QuicClientTransport::processPacketData(
     const folly::SocketAddress& peer,
     TimePoint receiveTimePoint,
+    ECNCodepoint ecn,
     folly::IOBufQueue& packetQueue) {
   auto packetSize = packetQueue.chainLength();
   if (packetSize == 0) {
@@ -106,6 +127,7 @@ void QuicClientTransport::processPacketData(
           return false;
         }
         VLOG(4) << "Received Stateless Reset " << *this;
+        QUIC_STATS(conn_->infoCallback, onStatelessReset);
         conn_->peerConnectionError = std::make_pair(
             QuicErrorCode(LocalErrorCode::CONNECTION_RESET),
             toString(LocalErrorCode::CONNECTION_RESET));
@@ -115,15 +137,27 @@ void QuicClientTransport::processPacketData(
       [&](auto&) { return false; });
   if (!parseSuccess) {
     if (conn_->qLogger) {
-      conn_->qLogger->addPacketDrop(packetSize, kParse.str());
+      conn_->qLogger->addPacketDrop(packetSize, kParse);
     }
     QUIC_TRACE(packet_drop, *conn_, "parse");
     return;
   }
 
   if (happyEyeballsEnabled_) {
+    bool happyEyeballsFinished = conn_->happyEyeballsState.finished;
     happyEyeballsOnDataReceived(
         *conn_, happyEyeballsConnAttemptDelayTimeout_, socket_, peer);
+    auto& secondSocket = conn_->happyEyeballsState.secondSocket;
+    if (!happyEyeballsFinished && secondSocket &&
+        conn_->transportSettings.standbyPathEnabled) {
+      setStandbyPath(
+          *clientConn_,
+          std::move(secondSocket),
+          conn_->happyEyeballsState.secondPeerAddress);
+    }
+    if (!zeroCopySendSetUp_) {
+      setUpZeroCopySend();
+    }
   }
 
   auto& packet = boost::get<QuicPacket>(parsedPacket);
@@ -145,7 +179,7 @@ void QuicClientTransport::processPacketData(
   if (!regularOptional) {
     VLOG(4) << "Dropping non-regular packet " << *conn_;
     if (conn_->qLogger) {
-      conn_->qLogger->addPacketDrop(packetSize, kNonRegular.str());
+      conn_->qLogger->addPacketDrop(packetSize, kNonRegular);
     }
     QUIC_TRACE(packet_drop, *conn_, "non_regular");
     return;
@@ -201,7 +235,8 @@ void QuicClientTransport::processPacketData(
 
     clientConn_->retryToken_ = header.getToken()->clone();
 
-    if (conn_->qLogger) {
+    if (conn_->qLogger &&
+        conn_->qLogger->samplePacket(QLogEventType::PacketReceived)) {
       conn_->qLogger->addPacket(*regularOptional, packetSize);
     }
 
@@ -226,7 +261,8 @@ void QuicClientTransport::processPacketData(
       protectionLevel == ProtectionType::KeyPhaseOne;
 
   auto& regularPacket = *regularOptional;
-  if (conn_->qLogger) {
+  if (conn_->qLogger &&
+      conn_->qLogger->samplePacket(QLogEventType::PacketReceived)) {
     conn_->qLogger->addPacket(regularPacket, packetSize);
   }
   if (!isProtectedPacket) {
@@ -243,6 +279,12 @@ void QuicClientTransport::processPacketData(
     }
   }
   QUIC_TRACE(packet_recvd, *conn_, toString(pnSpace), packetNum, packetSize);
+  QUIC_PROBE(
+      packet_received,
+      *conn_,
+      static_cast<uint8_t>(pnSpace),
+      packetNum,
+      packetSize);
 
   // We got a packet that was not the version negotiation packet, that means
   // that the version is now bound to the new packet.
@@ -282,12 +324,33 @@ void QuicClientTransport::processPacketData(
     throw QuicTransportException(
         "Invalid connection id", TransportErrorCode::PROTOCOL_VIOLATION);
   }
+  if (exceedsReassemblyBudget(*conn_, regularPacket)) {
+    // Not acked, the peer sends the data again once it is declared lost.
+    VLOG(10) << "drop over the reassembly budget packet=" << packetNum << " "
+             << *this;
+    if (conn_->qLogger) {
+      conn_->qLogger->addPacketDrop(
+          packetSize,
+          QuicTransportStatsCallback::toString(
+              QuicTransportStatsCallback::PacketDropReason::
+                  REASSEMBLY_BUDGET_EXCEEDED));
+    }
+    QUIC_STATS(
+        conn_->infoCallback,
+        onPacketDropped,
+        QuicTransportStatsCallback::PacketDropReason::
+            REASSEMBLY_BUDGET_EXCEEDED);
+    return;
+  }
   auto& ackState = getAckState(*conn_, pnSpace);
   auto outOfOrder =
       updateLargestReceivedPacketNum(ackState, packetNum, receiveTimePoint);
+  updateECNCountsRecvd(ackState, ecn);
+  pruneAckRanges(*conn_, ackState, receiveTimePoint);
 
   bool pktHasRetransmittableData = false;
   bool pktHasCryptoData = false;
+  bool handshakeConfirmed = false;
 
   for (auto& quicFrame : regularPacket.frames) {
     folly::variant_match(
@@ -317,6 +380,7 @@ void QuicClientTransport::processPacketData(
                   // TODO: replace this with a better solution later.
                   cancelHandshakeCryptoStreamRetransmissions(
                       *conn_->cryptoState);
+                  handshakeConfirmed = true;
                 }
                 folly::variant_match(
                     packetFrame,
@@ -396,6 +460,7 @@ void QuicClientTransport::processPacketData(
                    << " len=" << frame.data->computeChainDataLength()
                    << " fin=" << frame.fin << " packetNum=" << packetNum << " "
                    << *this;
+          fecOnStreamFrameReceived(*conn_, packetNum, frame);
           auto stream = conn_->streamManager->getStream(frame.streamId);
           pktHasRetransmittableData = true;
           if (!stream) {
@@ -491,6 +556,10 @@ void QuicClientTransport::processPacketData(
           updateSimpleFrameOnPacketReceived(
               *conn_, simpleFrame, packetNum, false);
         },
+        [&](DatagramFrame& datagramFrame) {
+          pktHasRetransmittableData = true;
+          handleDatagram(*conn_, datagramFrame);
+        },
         [&](auto&) {});
   }
 
@@ -627,7 +696,19 @@ void QuicClientTransport::processPacketData(
       protectionLevel == ProtectionType::KeyPhaseOne) {
     DCHECK(conn_->oneRttWriteCipher);
     clientConn_->clientHandshakeLayer->onRecvOneRttProtectedData();
-    conn_->readCodec->onHandshakeDone(receiveTimePoint);
+    if (!conn_->readCodec->getHandshakeDoneTime()) {
+      conn_->readCodec->onHandshakeDone(receiveTimePoint);
+      QUIC_STATS(
+          conn_->infoCallback,
+          onHandshakeDuration,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              receiveTimePoint - conn_->connectionTime));
+    }
+  }
+  // Not from the ack visitor, which runs while the outstanding packets are
+  // being walked.
+  if (handshakeConfirmed && conn_->transportSettings.discardHandshakeSpaces) {
+    discardHandshakeSpaces(*conn_);
   }
   updateAckSendStateOnRecvPacket(
       *conn_,
@@ -645,14 +726,20 @@ void QuicClientTransport::onReadData(
     // TODO: we might want to process network data if we decide that we should
     // exit draining state early
     if (conn_->qLogger) {
-      conn_->qLogger->addPacketDrop(0, kAlreadyClosed.str());
+      conn_->qLogger->addPacketDrop(0, kAlreadyClosed);
     }
     QUIC_TRACE(packet_drop, *conn_, "already_closed");
     return;
   }
   processUDPData(peer, std::move(networkData));
+  if (clientConn_->cachedPathMetrics) {
+    maybeCarefulResume(*clientConn_, Clock::now());
+  }
   if (!transportReadyNotified_ && hasWriteCipher()) {
     transportReadyNotified_ = true;
+    if (happyEyeballsEnabled_ && happyEyeballsCache_ && hostname_) {
+      happyEyeballsCache_->put(*hostname_, conn_->peerAddress);
+    }
     CHECK_NOTNULL(connCallback_)->onTransportReady();
   }
 
@@ -708,10 +795,20 @@ void QuicClientTransport::writeData() {
     return;
   }
 
+  if (shouldFailOverToStandbyPath(*clientConn_)) {
+    VLOG(4) << "Failing over from peer=" << conn_->peerAddress
+            << " to peer="
+            << clientConn_->standbyPath->congestionAndRtt.peerAddress << " "
+            << *this;
+    failOverToStandbyPath(*clientConn_, socket_, Clock::now());
+  }
+
+  auto now = loopClockNow(*conn_);
   uint64_t packetLimit =
       (isConnectionPaced(*conn_)
-           ? conn_->congestionController->getPacingRate(Clock::now())
-           : conn_->transportSettings.writeConnectionDataPacketsLimit);
+           ? (conn_->pacer ? conn_->pacer->updateAndGetWriteBatchSize(now)
+                           : conn_->congestionController->getPacingRate(now))
+           : getWritePacketLimit(*conn_));
   CryptoStreamScheduler initialScheduler(
       *conn_, *getCryptoStream(*conn_->cryptoState, EncryptionLevel::Initial));
   CryptoStreamScheduler handshakeScheduler(
@@ -833,6 +930,13 @@ void QuicClientTransport::startCryptoHandshake() {
   folly::Optional<fizz::client::CachedPsk> cachedPsk;
   if (quicCachedPsk) {
     cachedPsk = std::move(quicCachedPsk->cachedPsk);
+    if (conn_->transportSettings.pskPathMetricsEnabled &&
+        quicCachedPsk->pathMetrics) {
+      seedFromCachedPathMetrics(
+          *clientConn_,
+          *quicCachedPsk->pathMetrics,
+          std::chrono::system_clock::now());
+    }
   }
 
   QuicFizzFactory fizzFactory;
@@ -848,6 +952,9 @@ void QuicClientTransport::startCryptoHandshake() {
 
   // Add partial reliability parameter to customTransportParameters_.
   setPartialReliabilityTransportParameter();
+  setDatagramTransportParameter();
+  setAckFrequencyTransportParameter();
+  setFecTransportParameter();
 
   auto paramsExtension = std::make_shared<ClientTransportParametersExtension>(
       folly::none,
@@ -860,6 +967,10 @@ void QuicClientTransport::startCryptoHandshake() {
       conn_->transportSettings.maxRecvPacketSize,
       customTransportParameters_);
   auto handshakeLayer = clientConn_->clientHandshakeLayer;
+  if (conn_->transportSettings.certCompressionEnabled) {
+    handshakeLayer->setCertDecompressionManager(
+        getDefaultCertDecompressionManager());
+  }
   handshakeLayer->connect(
       ctx_,
       verifier_,
@@ -961,9 +1072,40 @@ void QuicClientTransport::onNewCachedPsk(
     }
   }
 
+  if (conn_->transportSettings.pskPathMetricsEnabled) {
+    quicCachedPsk.pathMetrics =
+        getPathMetrics(*clientConn_, std::chrono::system_clock::now());
+    if (!quicCachedPsk.pathMetrics) {
+      // Keep what the previous connections learned.
+      auto previous = pskCache_->getPsk(*hostname_);
+      if (previous) {
+        quicCachedPsk.pathMetrics = std::move(previous->pathMetrics);
+      }
+    }
+  }
+
   pskCache_->putPsk(*hostname_, std::move(quicCachedPsk));
 }
 
+void QuicClientTransport::cachePathMetrics() {
+  if (!conn_->transportSettings.pskPathMetricsEnabled || !pskCache_ ||
+      !hostname_) {
+    return;
+  }
+  auto pathMetrics =
+      getPathMetrics(*clientConn_, std::chrono::system_clock::now());
+  if (!pathMetrics) {
+    return;
+  }
+  // Only servers that issued a ticket have an entry to update.
+  auto quicCachedPsk = pskCache_->getPsk(*hostname_);
+  if (!quicCachedPsk) {
+    return;
+  }
+  quicCachedPsk->pathMetrics = std::move(pathMetrics);
+  pskCache_->putPsk(*hostname_, std::move(*quicCachedPsk));
+}
+
 bool QuicClientTransport::hasWriteCipher() const {
   return clientConn_->oneRttWriteCipher || clientConn_->zeroRttWriteCipher;
 }
@@ -979,6 +1121,9 @@ bool QuicClientTransport::isTLSResumed() const {
 void QuicClientTransport::errMessage(
     FOLLY_MAYBE_UNUSED const cmsghdr& cmsg) noexcept {
 #ifdef FOLLY_HAVE_MSG_ERRQUEUE
+  if (zeroCopySendTracker_ && zeroCopySendTracker_->onErrMessage(cmsg)) {
+    return;
+  }
   if ((cmsg.cmsg_level == SOL_IP && cmsg.cmsg_type == IP_RECVERR) ||
       (cmsg.cmsg_level == SOL_IPV6 && cmsg.cmsg_type == IPV6_RECVERR)) {
     const struct sock_extended_err* serr =
@@ -1003,6 +1148,21 @@ void QuicClientTransport::errMessage(
 void QuicClientTransport::getReadBuffer(void** buf, size_t* len) noexcept {
   DCHECK(conn_) << "trying to receive packets without a connection";
   auto readBufferSize = conn_->transportSettings.maxRecvPacketSize;
+  if (conn_->transportSettings.readBufferPoolSize > 0) {
+    if (!readBufferPool_) {
+      readBufferPool_ = std::make_unique<QuicReadBufferPool>(
+          readBufferSize,
+          conn_->transportSettings.readBufferPoolSize,
+          conn_->transportSettings.readBufferCopyThreshold);
+    }
+    // A pooled buffer that was not consumed by the previous read is reused.
+    if (!pooledReadBuffer_) {
+      pooledReadBuffer_ = readBufferPool_->acquire();
+    }
+    *buf = pooledReadBuffer_.get();
+    *len = readBufferPool_->bufferSize();
+    return;
+  }
   readBuffer_ = folly::IOBuf::create(readBufferSize);
   *buf = readBuffer_->writableData();
   *len = readBufferSize;
@@ -1013,34 +1173,289 @@ void QuicClientTransport::onDataAvailable(
     size_t len,
     bool truncated) noexcept {
   VLOG(10) << "Got data from socket peer=" << server << " len=" << len;
-  // TODO: we can get better receive time accuracy than this, with
-  // SO_TIMESTAMP or SIOCGSTAMP.
-  auto packetReceiveTime = Clock::now();
+  // Reads only get the kernel receive time with recvmsg, see
+  // shouldOnlyNotify.
+  auto packetReceiveTime = preciseLoopClockNow(*conn_);
   Buf data = std::move(readBuffer_);
   if (truncated) {
     // This is an error, drop the packet.
     if (conn_->qLogger) {
-      conn_->qLogger->addPacketDrop(len, kUdpTruncated.str());
+      conn_->qLogger->addPacketDrop(len, kUdpTruncated);
     }
     QUIC_TRACE(packet_drop, *conn_, "udp_truncated");
     return;
   }
-  data->append(len);
+  if (pooledReadBuffer_) {
+    data = readBufferPool_->toIOBuf(pooledReadBuffer_, len);
+  } else {
+    data->append(len);
+  }
+  onUDPDatagram(server, std::move(data), packetReceiveTime);
+}
+
+void QuicClientTransport::onUDPDatagram(
+    const folly::SocketAddress& server,
+    Buf data,
+    TimePoint receiveTimePoint,
+    ECNCodepoint ecn) {
+  auto len = data->computeChainDataLength();
   QUIC_TRACE(udp_recvd, *conn_, (uint64_t)len);
   if (conn_->qLogger) {
     conn_->qLogger->addDatagramReceived(len);
   }
-  NetworkData networkData(std::move(data), packetReceiveTime);
+  NetworkData networkData(std::move(data), receiveTimePoint, ecn);
   onNetworkData(server, std::move(networkData));
 }
 
+bool QuicClientTransport::shouldOnlyNotify() {
+#if FOLLY_HAVE_RECVMMSG
+  if (conn_->transportSettings.maxRecvBatchSize > 1) {
+    return true;
+  }
+#endif
+  return groEnabled_ || ecnEnabled_ || rxTimestampsEnabled_;
+}
+
+void QuicClientTransport::onNotifyDataAvailable(
+    folly::AsyncUDPSocket& sock) noexcept {
+  DCHECK(conn_) << "trying to receive packets without a connection";
+#if FOLLY_HAVE_RECVMMSG
+  if (conn_->transportSettings.maxRecvBatchSize > 1) {
+    recvmmsgBatch(sock);
+    return;
+  }
+#endif
+  const size_t readBufferSize = std::max<size_t>(
+      conn_->transportSettings.maxRecvPacketSize, kDefaultGROReadBufferSize);
+  Buf readBuffer = folly::IOBuf::create(readBufferSize);
+  struct sockaddr_storage addrStorage;
+  struct iovec vec;
+  vec.iov_base = readBuffer->writableData();
+  vec.iov_len = readBufferSize;
+  char control[kGROControlSize + kECNControlSize + kRxTimestampControlSize];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = reinterpret_cast<void*>(&addrStorage);
+  msg.msg_namelen = sizeof(addrStorage);
+  msg.msg_iov = &vec;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t ret =
+      folly::netops::recvmsg(sock.getNetworkSocket(), &msg, MSG_DONTWAIT);
+  if (ret < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      VLOG(4) << "recvmsg failed errno=" << errno << " " << *this;
+    }
+    return;
+  }
+  auto packetReceiveTime = preciseLoopClockNow(*conn_);
+  if (rxTimestampsEnabled_) {
+    packetReceiveTime = getRxTimestamp(
+        msg, packetReceiveTime, std::chrono::system_clock::now());
+  }
+  folly::SocketAddress server;
+  server.setFromSockaddr(
+      reinterpret_cast<sockaddr*>(&addrStorage), msg.msg_namelen);
+  VLOG(10) << "Got data from socket peer=" << server << " len=" << ret;
+  if (msg.msg_flags & MSG_TRUNC) {
+    // This is an error, drop the packet.
+    if (conn_->qLogger) {
+      conn_->qLogger->addPacketDrop(ret, kUdpTruncated);
+    }
+    QUIC_TRACE(packet_drop, *conn_, "udp_truncated");
+    return;
+  }
+  readBuffer->append(ret);
+  // GRO only coalesces datagrams with the same TOS.
+  auto ecn = ecnEnabled_ ? getECNCodepoint(msg) : ECNCodepoint::NotECT;
+  std::vector<Buf> packets;
+  splitGROBuffer(std::move(readBuffer), getGROSegmentSize(msg), packets);
+  for (auto& packet : packets) {
+    onUDPDatagram(server, std::move(packet), packetReceiveTime, ecn);
+  }
+}
+
+void QuicClientTransport::RecvmmsgStorage::resize(size_t numPackets) {
+  if (msgs.size() != numPackets) {
+    msgs.resize(numPackets);
+    impl.resize(numPackets);
+  }
+}
+
+void QuicClientTransport::recvmmsgBatch(folly::AsyncUDPSocket& sock) noexcept {
+#if FOLLY_HAVE_RECVMMSG
+  const size_t numPackets = conn_->transportSettings.maxRecvBatchSize;
+  const size_t readBufferSize = groEnabled_
+      ? std::max<size_t>(
+            conn_->transportSettings.maxRecvPacketSize,
+            kDefaultGROReadBufferSize)
+      : conn_->transportSettings.maxRecvPacketSize;
+  recvmmsgStorage_.resize(numPackets);
+  auto& msgs = recvmmsgStorage_.msgs;
+  for (size_t i = 0; i < numPackets; ++i) {
+    auto& impl = recvmmsgStorage_.impl[i];
+    if (!impl.readBuffer || impl.readBuffer->capacity() < readBufferSize) {
+      impl.readBuffer = folly::IOBuf::create(readBufferSize);
+    }
+    impl.iovec.iov_base = impl.readBuffer->writableData();
+    impl.iovec.iov_len = readBufferSize;
+    auto& msg = msgs[i].msg_hdr;
+    msg.msg_name = reinterpret_cast<void*>(&impl.addr);
+    msg.msg_namelen = sizeof(impl.addr);
+    msg.msg_iov = &impl.iovec;
+    msg.msg_iovlen = 1;
+    if (groEnabled_ || ecnEnabled_ || rxTimestampsEnabled_) {
+      msg.msg_control = impl.control;
+      msg.msg_controllen = sizeof(impl.control);
+    } else {
+      msg.msg_control = nullptr;
+      msg.msg_controllen = 0;
+    }
+    msg.msg_flags = 0;
+  }
+
+  int numMsgsRecvd = ::recvmmsg(
+      sock.getNetworkSocket().toFd(),
+      msgs.data(),
+      numPackets,
+      MSG_DONTWAIT,
+      nullptr);
+  if (numMsgsRecvd <= 0) {
+    if (numMsgsRecvd < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      VLOG(4) << "recvmmsg failed errno=" << errno << " " << *this;
+    }
+    return;
+  }
+  // All the datagrams of a batch share one receive time.
+  auto packetReceiveTime = preciseLoopClockNow(*conn_);
+  auto systemReceiveTime = rxTimestampsEnabled_
+      ? std::chrono::system_clock::now()
+      : std::chrono::system_clock::time_point();
+  folly::Optional<folly::SocketAddress> batchPeer;
+  NetworkData networkData;
+  auto flush = [&] {
+    if (batchPeer && networkData.data) {
+      onNetworkData(*batchPeer, std::move(networkData));
+    }
+    networkData = NetworkData();
+  };
+  std::vector<Buf> packets;
+  for (int i = 0; i < numMsgsRecvd; ++i) {
+    auto& impl = recvmmsgStorage_.impl[i];
+    const auto& msg = msgs[i];
+    folly::SocketAddress server;
+    server.setFromSockaddr(
+        reinterpret_cast<sockaddr*>(&impl.addr), msg.msg_hdr.msg_namelen);
+    VLOG(10) << "Got data from socket peer=" << server
+             << " len=" << msg.msg_len;
+    if (msg.msg_hdr.msg_flags & MSG_TRUNC) {
+      // This is an error, drop the packet. The read buffer is reused.
+      if (conn_->qLogger) {
+        conn_->qLogger->addPacketDrop(msg.msg_len, kUdpTruncated);
+      }
+      QUIC_TRACE(packet_drop, *conn_, "udp_truncated");
+      continue;
+    }
+    Buf data = std::move(impl.readBuffer);
+    data->append(msg.msg_len);
+    // GRO only coalesces datagrams with the same TOS.
+    auto ecn =
+        ecnEnabled_ ? getECNCodepoint(msg.msg_hdr) : ECNCodepoint::NotECT;
+    if (batchPeer != server || networkData.ecn != ecn) {
+      flush();
+      batchPeer = server;
+      // The datagrams of a NetworkData share the kernel receive time of the
+      // first one.
+      networkData.receiveTimePoint = rxTimestampsEnabled_
+          ? getRxTimestamp(msg.msg_hdr, packetReceiveTime, systemReceiveTime)
+          : packetReceiveTime;
+      networkData.ecn = ecn;
+    }
+    packets.clear();
+    splitGROBuffer(
+        std::move(data),
+        groEnabled_ ? getGROSegmentSize(msg.msg_hdr) : 0,
+        packets);
+    for (auto& packet : packets) {
+      auto len = packet->computeChainDataLength();
+      QUIC_TRACE(udp_recvd, *conn_, (uint64_t)len);
+      if (conn_->qLogger) {
+        conn_->qLogger->addDatagramReceived(len);
+      }
+      if (!networkData.data) {
+        networkData.data = std::move(packet);
+      } else {
+        networkData.batch.push_back(std::move(packet));
+      }
+    }
+  }
+  flush();
+#else
+  (void)sock;
+#endif
+}
+
+void QuicClientTransport::setUpECN() {
+  ecnEnabled_ = setSocketECN(
+      socket_->getNetworkSocket(), socket_->address().getFamily(), true);
+  auto& secondSocket = conn_->happyEyeballsState.secondSocket;
+  if (ecnEnabled_ && secondSocket) {
+    ecnEnabled_ = setSocketECN(
+        secondSocket->getNetworkSocket(),
+        secondSocket->address().getFamily(),
+        true);
+  }
+  if (!ecnEnabled_) {
+    VLOG(2) << "Failed to enable ECN " << *this;
+    // Our packets can't be expected to be ECT(0) marked.
+    conn_->transportSettings.enableECN = false;
+  }
+}
+
 void QuicClientTransport::
     happyEyeballsConnAttemptDelayTimeoutExpired() noexcept {
   QUIC_TRACE(happy_eyeballs, *conn_, "delay timer expired");
   happyEyeballsStartSecondSocket(conn_->happyEyeballsState);
 }
 
+void QuicClientTransport::useHappyEyeballsCache() {
+  auto cached = happyEyeballsCache_->get(*hostname_);
+  if (!cached) {
+    return;
+  }
+  auto& happyEyeballsState = conn_->happyEyeballsState;
+  if (*cached == happyEyeballsState.v4PeerAddress ||
+      *cached == happyEyeballsState.v6PeerAddress) {
+    // Only the address that won last time is tried, there is no second
+    // socket to race it with.
+    QUIC_TRACE(happy_eyeballs, *conn_, "cache hit", cached->getAddressStr());
+    if (cached->getFamily() == AF_INET) {
+      happyEyeballsState.v6PeerAddress = folly::SocketAddress();
+    } else {
+      happyEyeballsState.v4PeerAddress = folly::SocketAddress();
+    }
+    happyEyeballsState.secondSocket.reset();
+    happyEyeballsCacheHit_ = true;
+  }
+  // The server's addresses changed, still the family is a good first guess.
+  happyEyeballsCachedFamily_ = cached->getFamily();
+}
+
 void QuicClientTransport::start(ConnectionCallback* cb) {
+  if (happyEyeballsEnabled_ && happyEyeballsCachedFamily_ == AF_UNSPEC &&
+      happyEyeballsCache_ && hostname_) {
+    useHappyEyeballsCache();
+  }
+  if (happyEyeballsEnabled_ && happyEyeballsCachedFamily_ == AF_UNSPEC &&
+      conn_->transportSettings.pskPathMetricsEnabled && pskCache_ &&
+      hostname_) {
+    auto quicCachedPsk = pskCache_->getPsk(*hostname_);
+    if (quicCachedPsk && quicCachedPsk->pathMetrics) {
+      happyEyeballsCachedFamily_ = quicCachedPsk->pathMetrics->peerFamily;
+    }
+  }
   if (happyEyeballsEnabled_) {
     // TODO Supply v4 delay amount from somewhere when we want to tune this
     startHappyEyeballs(
@@ -1070,6 +1485,27 @@ void QuicClientTransport::start(ConnectionCallback* cb) {
   try {
     happyEyeballsSetUpSocket(
         *socket_, conn_->peerAddress, conn_->transportSettings, this, this);
+    if (conn_->transportSettings.receiveGROEnabled) {
+      groEnabled_ = setSocketGRO(socket_->getNetworkSocket(), true);
+      if (conn_->happyEyeballsState.secondSocket) {
+        groEnabled_ |= setSocketGRO(
+            conn_->happyEyeballsState.secondSocket->getNetworkSocket(), true);
+      }
+    }
+    if (conn_->transportSettings.enableECN) {
+      setUpECN();
+    }
+    if (conn_->transportSettings.rxTimestampsEnabled) {
+      rxTimestampsEnabled_ =
+          setSocketRxTimestamps(socket_->getNetworkSocket(), true);
+      if (conn_->happyEyeballsState.secondSocket) {
+        rxTimestampsEnabled_ |= setSocketRxTimestamps(
+            conn_->happyEyeballsState.secondSocket->getNetworkSocket(), true);
+      }
+    }
+    if (!happyEyeballsEnabled_) {
+      setUpZeroCopySend();
+    }
     startCryptoHandshake();
   } catch (const QuicTransportException& ex) {
     runOnEvbAsync([ex](auto self) {
@@ -1094,6 +1530,20 @@ void QuicClientTransport::start(ConnectionCallback* cb) {
   }
 }
 
+void QuicClientTransport::setUpZeroCopySend() {
+  zeroCopySendSetUp_ = true;
+  if (!conn_->transportSettings.zeroCopySendEnabled ||
+      !conn_->transportSettings.enableSocketErrMsgCallback) {
+    return;
+  }
+  zeroCopySendTracker_ = ZeroCopySendTracker::create(
+      socket_->getNetworkSocket(),
+      conn_->transportSettings.zeroCopySendThreshold);
+  VLOG_IF(2, !zeroCopySendTracker_)
+      << "Failed to enable zero copy sends " << *this;
+  conn_->zeroCopySendTracker = zeroCopySendTracker_.get();
+}
+
 void QuicClientTransport::addNewPeerAddress(folly::SocketAddress peerAddress) {
   CHECK(peerAddress.isInitialized());
 
@@ -1122,6 +1572,11 @@ void QuicClientTransport::setHappyEyeballsCachedFamily(
   happyEyeballsCachedFamily_ = cachedFamily;
 }
 
+void QuicClientTransport::setHappyEyeballsCache(
+    std::shared_ptr<QuicHappyEyeballsCache> happyEyeballsCache) {
+  happyEyeballsCache_ = std::move(happyEyeballsCache);
+}
+
 void QuicClientTransport::addNewSocket(
     std::unique_ptr<folly::AsyncUDPSocket> socket) {
   happyEyeballsAddSocket(*conn_, std::move(socket));
@@ -1190,8 +1645,55 @@ void QuicClientTransport::setPartialReliabilityTransportParameter() {
   }
 }
 
+void QuicClientTransport::setDatagramTransportParameter() {
+  if (!conn_->transportSettings.datagramsEnabled) {
+    return;
+  }
+  // Not a private parameter, so it skips the checks of
+  // setCustomTransportParameter.
+  CustomIntegralTransportParameter datagramParam(
+      kMaxDatagramFrameSizeParameterId, kMaxDatagramFrameSize);
+  customTransportParameters_.push_back(datagramParam.encode());
+}
+
+void QuicClientTransport::setAckFrequencyTransportParameter() {
+  if (!conn_->transportSettings.ackFrequencyEnabled) {
+    return;
+  }
+  CustomIntegralTransportParameter minAckDelayParam(
+      kMinAckDelayParameterId, kMinAckDelay.count());
+  customTransportParameters_.push_back(minAckDelayParam.encode());
+}
+
+void QuicClientTransport::setFecTransportParameter() {
+  if (!conn_->transportSettings.fecEnabled) {
+    return;
+  }
+  auto fecParam =
+      std::make_unique<CustomIntegralTransportParameter>(kFecParameterId, 1);
+  if (!setCustomTransportParameter(std::move(fecParam))) {
+    LOG(ERROR) << "failed to set fec transport setting";
+  }
+}
+
 void QuicClientTransport::closeTransport() {
   happyEyeballsConnAttemptDelayTimeout_.cancelTimeout();
+  if (happyEyeballsCacheHit_ && !transportReadyNotified_) {
+    // The cached address might be unreachable now, the next connection races
+    // both families again.
+    happyEyeballsCache_->remove(*hostname_);
+  }
+  cachePathMetrics();
+  closeStandbyPath();
+}
+
+void QuicClientTransport::closeStandbyPath() {
+  if (clientConn_->standbyPath && clientConn_->standbyPath->socket) {
+    auto sock = std::move(clientConn_->standbyPath->socket);
+    sock->pauseRead();
+    sock->close();
+  }
+  clientConn_->standbyPath = folly::none;
 }
 
 void QuicClientTransport::unbindConnection() {
@@ -11,9 +11,15 @@
 #include <folly/Random.h>
 #include <folly/SocketAddress.h>
 #include <folly/io/async/AsyncUDPSocket.h>
+#include <quic/api/QuicECN.h>
+#include <quic/api/QuicGRO.h>
+#include <quic/api/QuicReadBufferPool.h>
+#include <quic/api/QuicRxTimestamp.h>
 #include <quic/api/QuicTransportBase.h>
+#include <quic/api/QuicZeroCopy.h>
 #include <quic/client/handshake/QuicPskCache.h>
 #include <quic/client/state/ClientStateMachine.h>
+#include <quic/happyeyeballs/QuicHappyEyeballsCache.h>
 
 #include <sys/socket.h>
 
@@ -78,6 +84,15 @@ class QuicClientTransport
   void setHappyEyeballsEnabled(bool happyEyeballsEnabled);
   virtual void setHappyEyeballsCachedFamily(sa_family_t cachedFamily);
 
+  /**
+   * Set the cache of the addresses happy eyeballs settled on, usually shared
+   * by all the connections of the application. A connection to a hostname
+   * with a fresh entry only tries the cached address, and the address the
+   * handshake completes on is cached.
+   */
+  void setHappyEyeballsCache(
+      std::shared_ptr<QuicHappyEyeballsCache> happyEyeballsCache);
+
   /**
    * Set the cache that remembers psk and server transport parameters from
    * last connection. This is useful for session resumption and 0-rtt.
@@ -150,24 +165,86 @@ class QuicClientTransport
       size_t len,
       bool truncated) noexcept override;
 
+  // Used when GRO or ECN is enabled so that we can read the segment size and
+  // TOS cmsgs, and for batched reads.
+  bool shouldOnlyNotify() override;
+  void onNotifyDataAvailable(folly::AsyncUDPSocket& sock) noexcept override;
+
+  /**
+   * Reads up to maxRecvBatchSize datagrams from sock in a single recvmmsg
+   * call. Consecutive datagrams from the same peer with the same ECN
+   * codepoint, GRO coalesced ones split first, are handed to the transport as
+   * one NetworkData batch, so that acks and callbacks are processed once for
+   * all of them.
+   */
+  void recvmmsgBatch(folly::AsyncUDPSocket& sock) noexcept;
+
+  /**
+   * Hands a single received datagram to the transport.
+   */
+  void onUDPDatagram(
+      const folly::SocketAddress& server,
+      Buf data,
+      TimePoint receiveTimePoint,
+      ECNCodepoint ecn = ECNCodepoint::NotECT);
+
   void processUDPData(
       const folly::SocketAddress& peer,
       NetworkData&& networkData);
 
+  /**
+   * Turns on zero copy sends for socket_ if enabled in the transport settings.
+   * Must be called once the socket used for the connection is final.
+   */
+  void setUpZeroCopySend();
+
+  /**
+   * Turns on ECN on our sockets, or off in the transport settings if any of
+   * them does not support it.
+   */
+  void setUpECN();
+
   void processPacketData(
       const folly::SocketAddress& peer,
       TimePoint receiveTimePoint,
+      ECNCodepoint ecn,
       folly::IOBufQueue& packetQueue);
 
   void startCryptoHandshake();
 
   void happyEyeballsConnAttemptDelayTimeoutExpired() noexcept;
 
+  // Applies the happy eyeballs cache entry of hostname_ before start.
+  void useHappyEyeballsCache();
+
   // From ClientHandshake::HandshakeCallback
   void onNewCachedPsk(
       fizz::client::NewCachedPsk& newCachedPsk) noexcept override;
 
   Buf readBuffer_;
+  // Optional pool of receive buffers, used instead of readBuffer_ when
+  // readBufferPoolSize is set.
+  std::unique_ptr<QuicReadBufferPool> readBufferPool_;
+  QuicReadBufferPool::PooledBuffer pooledReadBuffer_;
+  // Storage for batched reads, reused across read events.
+  struct RecvmmsgStorage {
+    struct impl_ {
+      struct sockaddr_storage addr;
+      struct iovec iovec;
+      // Control data for the GRO segment size, the ECN codepoint and the
+      // kernel receive time.
+      char control
+          [kGROControlSize + kECNControlSize + kRxTimestampControlSize];
+      // Buffers that are not consumed by a read are kept for the next one.
+      Buf readBuffer;
+    };
+
+    void resize(size_t numPackets);
+
+    std::vector<struct mmsghdr> msgs;
+    std::vector<impl_> impl;
+  };
+  RecvmmsgStorage recvmmsgStorage_;
   folly::Optional<std::string> hostname_;
   std::shared_ptr<const fizz::client::FizzClientContext> ctx_;
   std::shared_ptr<const fizz::CertificateVerifier> verifier_;
@@ -188,7 +265,14 @@ class QuicClientTransport
       uint64_t peerAdvertisedInitialMaxStreamUni);
   folly::Optional<QuicCachedPsk> getPsk();
   void removePsk();
+  // Saves the path metrics of this connection in its psk cache entry.
+  void cachePathMetrics();
+  // Closes the socket of the standby path, if any.
+  void closeStandbyPath();
   void setPartialReliabilityTransportParameter();
+  void setDatagramTransportParameter();
+  void setAckFrequencyTransportParameter();
+  void setFecTransportParameter();
 
  private:
   bool replaySafeNotified_{false};
@@ -196,7 +280,20 @@ class QuicClientTransport
   // up when the caller invokes a terminal call to the transport.
   std::shared_ptr<QuicClientTransport> selfOwning_;
   bool happyEyeballsEnabled_{false};
+  // Whether UDP GRO is enabled on any of our sockets.
+  bool groEnabled_{false};
+  // Whether our sockets mark packets with ECT(0) and report the ECN codepoints
+  // of received ones.
+  bool ecnEnabled_{false};
+  // Whether our sockets report the kernel receive time of datagrams.
+  bool rxTimestampsEnabled_{false};
+  // Tracks zero copy sends on socket_ once it is final.
+  std::unique_ptr<ZeroCopySendTracker> zeroCopySendTracker_;
+  bool zeroCopySendSetUp_{false};
   sa_family_t happyEyeballsCachedFamily_{AF_UNSPEC};
+  std::shared_ptr<QuicHappyEyeballsCache> happyEyeballsCache_;
+  // Whether the race was skipped for the cached address.
+  bool happyEyeballsCacheHit_{false};
   std::shared_ptr<QuicPskCache> pskCache_;
   QuicClientConnectionState* clientConn_;
   std::vector<TransportParameter> customTransportParameters_;
@@ -32,6 +32,9 @@ void ClientHandshake::connect(
   ctx->setCompatibilityMode(false);
   // Since Draft-17, EOED should not be sent
   ctx->setOmitEarlyRecordLayer(true);
+  if (certDecompressionManager_) {
+    ctx->setCertDecompressionManager(certDecompressionManager_);
+  }
   processActions(machine_.processConnect(
       state_,
       std::move(ctx),
@@ -41,6 +44,11 @@ void ClientHandshake::connect(
       transportParams));
 }
 
+void ClientHandshake::setCertDecompressionManager(
+    std::shared_ptr<fizz::CertDecompressionManager> manager) {
+  certDecompressionManager_ = std::move(manager);
+}
+
 void ClientHandshake::doHandshake(
     std::unique_ptr<folly::IOBuf> data,
     EncryptionLevel encryptionLevel) {
@@ -12,6 +12,7 @@
 #include <fizz/client/EarlyDataRejectionPolicy.h>
 #include <fizz/client/FizzClientContext.h>
 #include <fizz/client/PskCache.h>
+#include <fizz/compression/CertDecompressionManager.h>
 #include <fizz/protocol/DefaultCertificateVerifier.h>
 
 #include <folly/io/IOBufQueue.h>
@@ -52,6 +53,13 @@ class ClientHandshake : public Handshake {
           transportParams,
       HandshakeCallback* callback);
 
+  /**
+   * Offers certificate compression with the decompressors of manager, in the
+   * ClientHello of the next connect. Replaces the manager of the context.
+   */
+  void setCertDecompressionManager(
+      std::shared_ptr<fizz::CertDecompressionManager> manager);
+
   /**
    * Takes input bytes from the network and processes then in the handshake.
    * This can change the state of the transport which may result in ciphers
@@ -222,6 +230,7 @@ class ClientHandshake : public Handshake {
 
   ActionMoveVisitor visitor_;
   std::shared_ptr<const fizz::client::FizzClientContext> fizzClientContext_;
+  std::shared_ptr<fizz::CertDecompressionManager> certDecompressionManager_;
   folly::Optional<std::string> pskIdentity_;
 
   std::shared_ptr<ClientTransportParametersExtension> transportParams_;
@@ -12,7 +12,9 @@
 
 #include <fizz/client/PskCache.h>
 #include <folly/Optional.h>
+#include <folly/portability/Sockets.h>
 
+#include <chrono>
 #include <cstdint>
 #include <string>
 
@@ -30,10 +32,26 @@ struct CachedServerTransportParameters {
   uint64_t initialMaxStreamsUni;
 };
 
+/**
+ * What a client learned about the path to a server, updated when its
+ * connections close. A resumed connection starts from the rtt, and jumps its
+ * cwnd towards the saved one once its first rtt sample matches minRtt.
+ */
+struct CachedPathMetrics {
+  std::chrono::microseconds srtt{0us};
+  std::chrono::microseconds rttvar{0us};
+  std::chrono::microseconds minRtt{0us};
+  uint64_t cwndBytes{0};
+  // Address family happy eyeballs settled on.
+  sa_family_t peerFamily{AF_UNSPEC};
+  std::chrono::system_clock::time_point updateTime;
+};
+
 struct QuicCachedPsk {
   fizz::client::CachedPsk cachedPsk;
   CachedServerTransportParameters transportParams;
   std::string appParams;
+  folly::Optional<CachedPathMetrics> pathMetrics;
 };
 
 class QuicPskCache {
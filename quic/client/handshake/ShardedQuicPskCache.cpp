@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/handshake/ShardedQuicPskCache.h>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+ShardedQuicPskCache::ShardedQuicPskCache(size_t maxEntries, size_t numShards) {
+  CHECK_GT(numShards, 0);
+  CHECK_GE(maxEntries, numShards);
+  auto shardEntries = (maxEntries + numShards - 1) / numShards;
+  shards_.reserve(numShards);
+  for (size_t i = 0; i < numShards; i++) {
+    shards_.push_back(std::make_unique<Shard>(shardEntries));
+  }
+}
+
+folly::Optional<QuicCachedPsk> ShardedQuicPskCache::getPsk(
+    const std::string& identity) {
+  auto& shard = shardOf(identity);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto it = shard.entries.find(identity);
+  if (it == shard.entries.end()) {
+    return folly::none;
+  }
+  return it->second;
+}
+
+void ShardedQuicPskCache::putPsk(
+    const std::string& identity,
+    QuicCachedPsk psk) {
+  auto& shard = shardOf(identity);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  shard.entries.set(identity, std::move(psk));
+}
+
+void ShardedQuicPskCache::removePsk(const std::string& identity) {
+  auto& shard = shardOf(identity);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  shard.entries.erase(identity);
+}
+
+size_t ShardedQuicPskCache::size() const {
+  size_t total = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->mutex);
+    total += shard->entries.size();
+  }
+  return total;
+}
+
+ShardedQuicPskCache::Shard& ShardedQuicPskCache::shardOf(
+    const std::string& identity) {
+  return *shards_[std::hash<std::string>()(identity) % shards_.size()];
+}
+
+} // namespace quic
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/client/handshake/QuicPskCache.h>
+
+#include <folly/container/EvictingCacheMap.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Bounded, thread safe PSK cache for many concurrent connections, possibly on
+ * different threads.
+ *
+ * Identities are spread over numShards LRU maps by hash, each behind its own
+ * mutex, so connections to different servers rarely wait on each other. Each
+ * shard holds up to maxEntries / numShards PSKs and evicts its least recently
+ * used one beyond that.
+ */
+class ShardedQuicPskCache : public QuicPskCache {
+ public:
+  explicit ShardedQuicPskCache(
+      size_t maxEntries,
+      size_t numShards = kDefaultPskCacheShards);
+
+  ~ShardedQuicPskCache() override = default;
+
+  folly::Optional<QuicCachedPsk> getPsk(const std::string& identity) override;
+
+  void putPsk(const std::string& identity, QuicCachedPsk psk) override;
+
+  void removePsk(const std::string& identity) override;
+
+  size_t size() const;
+
+ private:
+  struct Shard {
+    explicit Shard(size_t maxEntries) : entries(maxEntries) {}
+
+    mutable std::mutex mutex;
+    folly::EvictingCacheMap<std::string, QuicCachedPsk> entries;
+  };
+
+  Shard& shardOf(const std::string& identity);
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // namespace quic
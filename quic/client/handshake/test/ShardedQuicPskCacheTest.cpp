@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/handshake/ShardedQuicPskCache.h>
+
+#include <folly/Conv.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace quic;
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+
+QuicCachedPsk makePsk(const std::string& appParams) {
+  QuicCachedPsk psk;
+  psk.appParams = appParams;
+  return psk;
+}
+
+} // namespace
+
+TEST(ShardedQuicPskCacheTest, PutGetRemove) {
+  ShardedQuicPskCache cache(100, 4);
+  EXPECT_FALSE(cache.getPsk("a.com").hasValue());
+  cache.putPsk("a.com", makePsk("a"));
+  cache.putPsk("b.com", makePsk("b"));
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ("a", cache.getPsk("a.com")->appParams);
+  EXPECT_EQ("b", cache.getPsk("b.com")->appParams);
+
+  // Replaces the entry.
+  cache.putPsk("a.com", makePsk("a2"));
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ("a2", cache.getPsk("a.com")->appParams);
+
+  cache.removePsk("a.com");
+  EXPECT_FALSE(cache.getPsk("a.com").hasValue());
+  EXPECT_EQ(1, cache.size());
+  // Removing what isn't there is fine.
+  cache.removePsk("a.com");
+}
+
+TEST(ShardedQuicPskCacheTest, PathMetricsKept) {
+  ShardedQuicPskCache cache(100);
+  auto psk = makePsk("a");
+  CachedPathMetrics metrics;
+  metrics.srtt = std::chrono::microseconds(50000);
+  metrics.cwndBytes = 100000;
+  metrics.peerFamily = AF_INET6;
+  psk.pathMetrics = metrics;
+  cache.putPsk("a.com", std::move(psk));
+  auto cached = cache.getPsk("a.com");
+  ASSERT_TRUE(cached->pathMetrics.hasValue());
+  EXPECT_EQ(metrics.srtt, cached->pathMetrics->srtt);
+  EXPECT_EQ(metrics.cwndBytes, cached->pathMetrics->cwndBytes);
+  EXPECT_EQ(AF_INET6, cached->pathMetrics->peerFamily);
+}
+
+TEST(ShardedQuicPskCacheTest, EvictsLeastRecentlyUsed) {
+  // A single shard, so that the eviction order is the LRU one.
+  ShardedQuicPskCache cache(2, 1);
+  cache.putPsk("a.com", makePsk("a"));
+  cache.putPsk("b.com", makePsk("b"));
+  // Makes b.com the least recently used.
+  EXPECT_TRUE(cache.getPsk("a.com").hasValue());
+  cache.putPsk("c.com", makePsk("c"));
+  EXPECT_EQ(2, cache.size());
+  EXPECT_TRUE(cache.getPsk("a.com").hasValue());
+  EXPECT_FALSE(cache.getPsk("b.com").hasValue());
+  EXPECT_TRUE(cache.getPsk("c.com").hasValue());
+}
+
+TEST(ShardedQuicPskCacheTest, Bounded) {
+  ShardedQuicPskCache cache(64, 8);
+  for (size_t i = 0; i < 1000; i++) {
+    cache.putPsk(folly::to<std::string>(i, ".com"), makePsk("x"));
+  }
+  EXPECT_LE(cache.size(), 64);
+  EXPECT_GT(cache.size(), 0);
+}
+
+TEST(ShardedQuicPskCacheTest, ConcurrentAccess) {
+  ShardedQuicPskCache cache(10000);
+  constexpr size_t kThreads = 8;
+  constexpr size_t kPerThread = 500;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; t++) {
+    threads.emplace_back([&cache, t] {
+      for (size_t i = 0; i < kPerThread; i++) {
+        auto identity = folly::to<std::string>(t, "-", i, ".com");
+        cache.putPsk(identity, makePsk(identity));
+        auto psk = cache.getPsk(identity);
+        EXPECT_TRUE(psk.hasValue());
+        if (i % 2) {
+          cache.removePsk(identity);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(kThreads * kPerThread / 2, cache.size());
+  EXPECT_EQ("3-100.com", cache.getPsk("3-100.com")->appParams);
+}
+
+} // namespace test
+} // namespace quic
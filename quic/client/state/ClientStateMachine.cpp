@@ -10,6 +10,7 @@
 
 #include <folly/io/async/AsyncSocketException.h>
 #include <quic/client/handshake/ClientHandshake.h>
+#include <quic/congestion_control/CongestionControllerFactory.h>
 #include <quic/congestion_control/QuicCubic.h>
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/handshake/TransportParameters.h>
@@ -85,6 +86,15 @@ void processServerInitialParams(
   auto partialReliability = getIntegerParameter(
       static_cast<TransportParameterId>(kPartialReliabilityParameterId),
       serverParams.parameters);
+  auto maxDatagramFrameSize = getIntegerParameter(
+      static_cast<TransportParameterId>(kMaxDatagramFrameSizeParameterId),
+      serverParams.parameters);
+  auto minAckDelay = getIntegerParameter(
+      static_cast<TransportParameterId>(kMinAckDelayParameterId),
+      serverParams.parameters);
+  auto fec = getIntegerParameter(
+      static_cast<TransportParameterId>(kFecParameterId),
+      serverParams.parameters);
 
   if (!packetSize || *packetSize == 0) {
     packetSize = kDefaultMaxUDPPayload;
@@ -127,9 +137,10 @@ void processServerInitialParams(
   }
   conn.peerAckDelayExponent =
       ackDelayExponent.value_or(kDefaultAckDelayExponent);
-  // TODO: udpSendPacketLen should also be limited by PMTU
   if (conn.transportSettings.canIgnorePathMTU) {
     conn.udpSendPacketLen = *packetSize;
+  } else if (conn.transportSettings.pmtuDiscoveryEnabled) {
+    startPmtuDiscovery(conn, *packetSize);
   }
 
   if (partialReliability && *partialReliability != 0 &&
@@ -138,6 +149,13 @@ void processServerInitialParams(
   }
   VLOG(10) << "conn.partialReliabilityEnabled="
            << conn.partialReliabilityEnabled;
+  conn.datagramState.maxWriteFrameSize = maxDatagramFrameSize.value_or(0);
+  if (minAckDelay) {
+    conn.ackFrequencyState.peerMinAckDelay =
+        std::chrono::microseconds(*minAckDelay);
+  }
+  conn.fecState.enabled =
+      conn.transportSettings.fecEnabled && fec && *fec != 0;
 
   conn.statelessResetToken = std::move(statelessResetToken);
   // Update the existing streams, because we allow streams to be created before
@@ -175,6 +193,112 @@ void updateTransportParamsFromCachedEarlyParams(
       transportParams.initialMaxStreamsUni);
 }
 
+folly::Optional<CachedPathMetrics> getPathMetrics(
+    const QuicClientConnectionState& conn,
+    std::chrono::system_clock::time_point now) {
+  // lrtt is only set by an actual rtt sample, unlike the srtt which may have
+  // been seeded from the cache.
+  if (conn.lossState.lrtt == 0us || !conn.congestionController) {
+    return folly::none;
+  }
+  CachedPathMetrics metrics;
+  metrics.srtt = conn.lossState.srtt;
+  metrics.rttvar = conn.lossState.rttvar;
+  metrics.minRtt = conn.lossState.mrtt;
+  metrics.cwndBytes = conn.congestionController->getCongestionWindow();
+  metrics.peerFamily = conn.peerAddress.getFamily();
+  metrics.updateTime = now;
+  return metrics;
+}
+
+bool seedFromCachedPathMetrics(
+    QuicClientConnectionState& conn,
+    const CachedPathMetrics& metrics,
+    std::chrono::system_clock::time_point now) {
+  if (metrics.updateTime > now ||
+      now - metrics.updateTime > kCarefulResumeMaxTicketAge ||
+      metrics.srtt == 0us) {
+    return false;
+  }
+  conn.lossState.srtt = metrics.srtt;
+  conn.lossState.rttvar = metrics.rttvar;
+  conn.cachedPathMetrics = metrics;
+  return true;
+}
+
+void maybeCarefulResume(QuicClientConnectionState& conn, TimePoint now) {
+  if (!conn.cachedPathMetrics || conn.lossState.lrtt == 0us) {
+    return;
+  }
+  auto savedRtt = conn.cachedPathMetrics->minRtt;
+  auto lrtt = conn.lossState.lrtt;
+  if (conn.congestionController &&
+      lrtt >= savedRtt / kCarefulResumeRttLowerDivisor &&
+      lrtt <= savedRtt * kCarefulResumeRttUpperFactor) {
+    conn.congestionController->carefulResume(
+        conn.cachedPathMetrics->cwndBytes, now);
+  }
+  conn.cachedPathMetrics = folly::none;
+}
+
+void setStandbyPath(
+    QuicClientConnectionState& conn,
+    std::unique_ptr<folly::AsyncUDPSocket> socket,
+    const folly::SocketAddress& peerAddress) {
+  QuicClientConnectionState::StandbyPath standbyPath;
+  standbyPath.socket = std::move(socket);
+  standbyPath.congestionAndRtt.peerAddress = peerAddress;
+  conn.standbyPath = std::move(standbyPath);
+}
+
+bool shouldFailOverToStandbyPath(const QuicClientConnectionState& conn) {
+  return conn.standbyPath && conn.standbyPath->socket &&
+      conn.transportSettings.standbyPathFailoverPtoCount > 0 &&
+      conn.lossState.ptoCount >=
+      conn.transportSettings.standbyPathFailoverPtoCount;
+}
+
+void failOverToStandbyPath(
+    QuicClientConnectionState& conn,
+    std::unique_ptr<folly::AsyncUDPSocket>& socket,
+    TimePoint now) {
+  CHECK(conn.standbyPath);
+  auto& standbyState = conn.standbyPath->congestionAndRtt;
+  CongestionAndRttState currentState;
+  currentState.peerAddress = conn.peerAddress;
+  currentState.recordTime = now;
+  currentState.congestionController = std::move(conn.congestionController);
+  currentState.srtt = conn.lossState.srtt;
+  currentState.lrtt = conn.lossState.lrtt;
+  currentState.rttvar = conn.lossState.rttvar;
+
+  conn.peerAddress = standbyState.peerAddress;
+  if (standbyState.congestionController) {
+    conn.congestionController = std::move(standbyState.congestionController);
+    conn.lossState.srtt = standbyState.srtt;
+    conn.lossState.lrtt = standbyState.lrtt;
+    conn.lossState.rttvar = standbyState.rttvar;
+  } else {
+    conn.congestionController = conn.congestionControllerFactory
+        ? conn.congestionControllerFactory->makeCongestionController(
+              conn, conn.transportSettings.defaultCongestionController)
+        : std::make_unique<Cubic>(conn);
+    conn.lossState.srtt = 0us;
+    conn.lossState.lrtt = 0us;
+    conn.lossState.rttvar = 0us;
+  }
+  // The packets of the other family might not fit the new path.
+  auto defaultPacketLen = conn.peerAddress.getFamily() == AF_INET6
+      ? kDefaultV6UDPSendPacketLen
+      : kDefaultV4UDPSendPacketLen;
+  conn.udpSendPacketLen = std::min(conn.udpSendPacketLen, defaultPacketLen);
+  // The probes on the new path go out without the backoff of the old one.
+  conn.lossState.ptoCount = 0;
+  socket.swap(conn.standbyPath->socket);
+  standbyState = std::move(currentState);
+  ++conn.numPathFailovers;
+}
+
 void ClientInvalidStateHandler(QuicClientConnectionState& state) {
   state.state = ClientStates::Error();
 }
@@ -56,6 +56,24 @@ struct QuicClientConnectionState : public QuicConnectionStateBase {
   uint64_t peerAdvertisedInitialMaxStreamsBidi{0};
   uint64_t peerAdvertisedInitialMaxStreamsUni{0};
 
+  // Path metrics of the resumed psk, until the first rtt sample decides on
+  // the careful resume of the cwnd.
+  folly::Optional<CachedPathMetrics> cachedPathMetrics;
+
+  // Path over the address family that lost happy eyeballs, kept to fail over
+  // to when the current path stops getting acks. See
+  // TransportSettings::standbyPathEnabled.
+  struct StandbyPath {
+    std::unique_ptr<folly::AsyncUDPSocket> socket;
+    // The peer address of the path, with its congestion state and rtt from
+    // the last time it was in use. A path never used has no controller yet.
+    CongestionAndRttState congestionAndRtt;
+  };
+  folly::Optional<StandbyPath> standbyPath;
+
+  // Number of times the client failed over from one path to the other.
+  uint32_t numPathFailovers{0};
+
   // Packet number in which client initial was sent. Receipt of data on the
   // crypto stream from the server can implicitly ack the client initial packet.
   // TODO: use this to get rid of the data in the crypto stream.
@@ -104,4 +122,54 @@ void updateTransportParamsFromCachedEarlyParams(
     QuicClientConnectionState& conn,
     const CachedServerTransportParameters& transportParams);
 
+/**
+ * The path metrics of conn to cache, none until it has an rtt sample.
+ */
+folly::Optional<CachedPathMetrics> getPathMetrics(
+    const QuicClientConnectionState& conn,
+    std::chrono::system_clock::time_point now);
+
+/**
+ * Seeds the rtt of a resuming connection from cached metrics no older than
+ * kCarefulResumeMaxTicketAge, and keeps them for maybeCarefulResume.
+ * Returns whether the metrics were used.
+ */
+bool seedFromCachedPathMetrics(
+    QuicClientConnectionState& conn,
+    const CachedPathMetrics& metrics,
+    std::chrono::system_clock::time_point now);
+
+/**
+ * Once conn has its first rtt sample, jumps the cwnd towards the cached one
+ * if the sample matches the cached min rtt. The cached metrics are dropped
+ * either way.
+ */
+void maybeCarefulResume(QuicClientConnectionState& conn, TimePoint now);
+
+/**
+ * Keeps socket, to peerAddress, as the standby path of conn.
+ */
+void setStandbyPath(
+    QuicClientConnectionState& conn,
+    std::unique_ptr<folly::AsyncUDPSocket> socket,
+    const folly::SocketAddress& peerAddress);
+
+/**
+ * Whether conn has a standby path, and the current one went
+ * standbyPathFailoverPtoCount PTOs in a row without an ack.
+ */
+bool shouldFailOverToStandbyPath(const QuicClientConnectionState& conn);
+
+/**
+ * Makes the standby path of conn the current one, and the current one, whose
+ * socket is socket, the standby. The congestion state and rtt of the current
+ * path are kept with it, the standby one gets back its own, or fresh ones if
+ * it was never used. Outstanding packets are left to be probed on the new
+ * path.
+ */
+void failOverToStandbyPath(
+    QuicClientConnectionState& conn,
+    std::unique_ptr<folly::AsyncUDPSocket>& socket,
+    TimePoint now);
+
 } // namespace quic
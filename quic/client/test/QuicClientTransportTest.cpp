@@ -6,6 +6,7 @@
  *
  */
 #include <quic/client/QuicClientTransport.h>
+#include <quic/client/QuicClientConnectionPool.h>
 #include <quic/server/QuicServer.h>
 
 #include <quic/api/test/Mocks.h>
@@ -1037,6 +1038,74 @@ TEST_P(
   EXPECT_FALSE(client->isPartiallyReliableTransport());
 }
 
+class TestConnectionPoolCallback : public QuicClientConnectionPool::Callback {
+ public:
+  explicit TestConnectionPoolCallback(folly::Function<void()> onDoneIn)
+      : onDone(std::move(onDoneIn)) {}
+
+  void onConnectionReady(
+      std::shared_ptr<QuicClientTransport> transportIn) noexcept override {
+    transport = std::move(transportIn);
+    onDone();
+  }
+
+  void onConnectionError(
+      std::pair<QuicErrorCode, std::string> errorIn) noexcept override {
+    error = std::move(errorIn);
+    onDone();
+  }
+
+  folly::Function<void()> onDone;
+  std::shared_ptr<QuicClientTransport> transport;
+  folly::Optional<std::pair<QuicErrorCode, std::string>> error;
+};
+
+TEST_P(QuicClientTransportIntegrationTest, ConnectionPoolReusesConnection) {
+  QuicClientConnectionPool::Options options;
+  options.maxConnectionsPerKey = 2;
+  QuicClientConnectionPool pool(
+      {&eventbase_},
+      [&](folly::EventBase*, const QuicConnectionPoolKey&) {
+        return createClient();
+      },
+      options);
+  QuicConnectionPoolKey key{hostname, serverAddr.getPort(), "h1q-fb"};
+
+  size_t done = 0;
+  auto onDone = [&] {
+    if (++done == 2) {
+      eventbase_.terminateLoopSoon();
+    }
+  };
+  TestConnectionPoolCallback first(onDone);
+  TestConnectionPoolCallback second(onDone);
+  pool.getConnection(key, &first);
+  pool.getConnection(key, &second);
+  // Both requests wait for the same handshake.
+  EXPECT_EQ(pool.getNumConnections(key), 1);
+  eventbase_.loopForever();
+  ASSERT_TRUE(first.transport);
+  EXPECT_FALSE(first.error);
+  EXPECT_EQ(first.transport, second.transport);
+
+  // Once the connection is up, requests are handed it right away.
+  TestConnectionPoolCallback third([] {});
+  pool.getConnection(key, &third);
+  EXPECT_EQ(third.transport, first.transport);
+  auto streamId = third.transport->createBidirectionalStream();
+  EXPECT_TRUE(streamId.hasValue());
+  EXPECT_EQ(pool.getNumConnections(key), 1);
+
+  // Prewarming never goes past maxConnectionsPerKey.
+  QuicConnectionPoolKey otherKey{hostname, serverAddr.getPort(), "hq"};
+  pool.prewarm(otherKey, 5);
+  EXPECT_EQ(pool.getNumConnections(otherKey), 2);
+
+  pool.closeAll();
+  EXPECT_EQ(pool.getNumConnections(key), 0);
+  EXPECT_EQ(pool.getNumConnections(otherKey), 0);
+}
+
 INSTANTIATE_TEST_CASE_P(
     QuicClientTransportIntegrationTests,
     QuicClientTransportIntegrationTest,
@@ -2330,6 +2399,96 @@ TEST_F(
   fatalWriteErrorOnBothAfterSecondStarts(serverAddrV6, serverAddrV4);
 }
 
+TEST_F(QuicClientTransportHappyEyeballsTest, CachedAddressSkipsRace) {
+  std::string hostname = "TestHost";
+  auto cache = std::make_shared<QuicHappyEyeballsCache>();
+  cache->put(hostname, serverAddrV4);
+  client->setHostname(hostname);
+  client->setHappyEyeballsCache(cache);
+  auto& conn = client->getConn();
+
+  EXPECT_CALL(*sock, write(serverAddrV4, _))
+      .WillRepeatedly(Invoke(
+          [&](const SocketAddress&, const std::unique_ptr<folly::IOBuf>& buf) {
+            socketWrites.push_back(buf->clone());
+            return buf->computeChainDataLength();
+          }));
+  client->start(&clientConnCallback);
+  setConnectionIds();
+  // The second socket is gone, nothing races the cached address.
+  EXPECT_EQ(conn.peerAddress, serverAddrV4);
+  EXPECT_EQ(conn.happyEyeballsState.secondSocket, nullptr);
+  EXPECT_TRUE(conn.happyEyeballsState.finished);
+  EXPECT_FALSE(client->happyEyeballsConnAttemptDelayTimeout().isScheduled());
+
+  EXPECT_CALL(clientConnCallback, onTransportReady());
+  EXPECT_CALL(clientConnCallback, onReplaySafe());
+  performFakeHandshake(serverAddrV4);
+  EXPECT_EQ(*cache->get(hostname), serverAddrV4);
+}
+
+TEST_F(QuicClientTransportHappyEyeballsTest, WinnerIsCached) {
+  std::string hostname = "TestHost";
+  auto cache = std::make_shared<QuicHappyEyeballsCache>();
+  client->setHostname(hostname);
+  client->setHappyEyeballsCache(cache);
+  firstWinBeforeSecondStart(serverAddrV6, serverAddrV4);
+  EXPECT_EQ(*cache->get(hostname), serverAddrV6);
+}
+
+TEST_F(QuicClientTransportHappyEyeballsTest, StandbyPathFailover) {
+  client->getNonConstConn().transportSettings.standbyPathEnabled = true;
+  auto& conn = client->getConn();
+  auto saveWrite = [&](const SocketAddress&,
+                       const std::unique_ptr<folly::IOBuf>& buf) {
+    socketWrites.push_back(buf->clone());
+    return buf->computeChainDataLength();
+  };
+  EXPECT_CALL(*sock, write(serverAddrV6, _)).WillRepeatedly(Invoke(saveWrite));
+  EXPECT_CALL(*secondSock, write(_, _)).Times(0);
+  client->start(&clientConnCallback);
+  setConnectionIds();
+
+  // The socket that lost stays open as the standby path.
+  EXPECT_CALL(clientConnCallback, onTransportReady());
+  EXPECT_CALL(clientConnCallback, onReplaySafe());
+  EXPECT_CALL(*secondSock, close()).Times(0);
+  performFakeHandshake(serverAddrV6);
+  EXPECT_TRUE(conn.happyEyeballsState.finished);
+  EXPECT_EQ(conn.happyEyeballsState.secondSocket, nullptr);
+  ASSERT_TRUE(conn.standbyPath.hasValue());
+  EXPECT_EQ(conn.standbyPath->congestionAndRtt.peerAddress, serverAddrV4);
+  auto oldCongestionController = conn.congestionController.get();
+
+  // Once the current path missed enough PTOs the writes move to the standby
+  // path, with congestion state of its own.
+  Mock::VerifyAndClearExpectations(sock);
+  Mock::VerifyAndClearExpectations(secondSock);
+  EXPECT_CALL(*sock, write(_, _)).Times(0);
+  EXPECT_CALL(*secondSock, write(serverAddrV4, _))
+      .Times(AtLeast(1))
+      .WillRepeatedly(Invoke(saveWrite));
+  client->getNonConstConn().lossState.ptoCount =
+      kDefaultStandbyPathFailoverPtoCount;
+  auto streamId = client->createBidirectionalStream().value();
+  client->writeChain(streamId, folly::IOBuf::copyBuffer("hello"), true, false);
+  loopForWrites();
+  EXPECT_EQ(conn.peerAddress, serverAddrV4);
+  EXPECT_EQ(1u, conn.numPathFailovers);
+  EXPECT_EQ(0u, conn.lossState.ptoCount);
+  EXPECT_NE(conn.congestionController.get(), oldCongestionController);
+  ASSERT_TRUE(conn.standbyPath.hasValue());
+  EXPECT_EQ(conn.standbyPath->congestionAndRtt.peerAddress, serverAddrV6);
+  EXPECT_EQ(
+      conn.standbyPath->congestionAndRtt.congestionController.get(),
+      oldCongestionController);
+
+  EXPECT_CALL(*sock, pauseRead()).Times(AtLeast(1));
+  EXPECT_CALL(*sock, close()).Times(AtLeast(1));
+  client->closeNow(folly::none);
+  EXPECT_FALSE(conn.standbyPath.hasValue());
+}
+
 TEST_F(QuicClientTransportHappyEyeballsTest, V4FirstAndV4WinBeforeV6Start) {
   client->setHappyEyeballsCachedFamily(AF_INET);
   firstWinBeforeSecondStart(serverAddrV4, serverAddrV6);
@@ -2507,6 +2666,56 @@ TEST_F(QuicClientTransportAfterStartTest, ReadStream) {
   client->close(folly::none);
 }
 
+TEST_F(QuicClientTransportAfterStartTest, ReadStreamBatch) {
+  StreamId streamId = client->createBidirectionalStream().value();
+
+  client->setReadCallback(streamId, &readCb);
+  auto first = IOBuf::copyBuffer("hello");
+  auto second = IOBuf::copyBuffer(" world");
+  auto expected = IOBuf::copyBuffer("hello world");
+  // Both datagrams of the batch are processed before the app is notified.
+  EXPECT_CALL(readCb, readAvailable(streamId)).WillOnce(Invoke([&](auto) {
+    auto readData = client->read(streamId, 1000);
+    EXPECT_TRUE(folly::IOBufEqualTo()((*readData).first, expected));
+    EXPECT_TRUE(readData->second);
+  }));
+  auto packet1 = packetToBuf(createStreamPacket(
+      *serverChosenConnId /* src */,
+      *originalConnId /* dest */,
+      appDataPacketNum++,
+      streamId,
+      *first,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      folly::none,
+      false /* eof */));
+  auto packet2 = packetToBuf(createStreamPacket(
+      *serverChosenConnId /* src */,
+      *originalConnId /* dest */,
+      appDataPacketNum++,
+      streamId,
+      *second,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      folly::none,
+      true /* eof */,
+      folly::none,
+      first->length() /* offset */));
+  auto packet2Len = packet2->computeChainDataLength();
+  auto bytesRecvd = client->getConn().lossState.totalBytesRecvd;
+  NetworkData networkData(std::move(packet1), Clock::now());
+  networkData.batch.push_back(std::move(packet2));
+  auto packet1Len = networkData.data->computeChainDataLength();
+  client->onNetworkData(serverAddr, std::move(networkData));
+  EXPECT_EQ(
+      client->getConn().lossState.totalBytesRecvd,
+      bytesRecvd + packet1Len + packet2Len);
+  EXPECT_EQ(
+      *client->getConn().ackStates.appDataAckState.largestReceivedPacketNum,
+      appDataPacketNum - 1);
+  client->close(folly::none);
+}
+
 TEST_F(QuicClientTransportAfterStartTest, ReadStreamCoalesced) {
   StreamId streamId = client->createBidirectionalStream().value();
   auto qLogger = std::make_shared<FileQLogger>();
@@ -16,6 +16,9 @@ namespace {
 // Minimum required length (in bytes) for the destination connection-id
 constexpr size_t kMinInitialDestinationConnIdLength = 8;
 
+// Maximum number of ACK blocks whose fields are decoded in one go.
+constexpr size_t kAckBlockDecodeBatch = 16;
+
 template <class T>
 inline std::string toHex(
     const typename std::enable_if<std::is_unsigned<T>::value, T>::type& type) {
@@ -24,28 +27,47 @@ inline std::string toHex(
       "0x", folly::hexlify(folly::ByteRange(&be, sizeof(be))));
 }
 
-quic::PacketNum nextAckedPacketGap(quic::PacketNum packetNum, uint64_t gap) {
+folly::Unexpected<quic::QuicTransportError> frameEncodingError(
+    const char* message,
+    quic::FrameType frameType) {
+  return folly::makeUnexpected(quic::QuicTransportError(
+      message, quic::TransportErrorCode::FRAME_ENCODING_ERROR, frameType));
+}
+
+// Replaces the error of a frame decoder with the generic one parseFrame has
+// always reported for the frame type.
+template <class T>
+quic::DecodeResult<quic::QuicFrame> toQuicFrame(
+    quic::DecodeResult<T>&& result,
+    uint64_t frameTypeValue) {
+  if (UNLIKELY(result.hasError())) {
+    return folly::makeUnexpected(quic::QuicTransportError(
+        folly::to<std::string>(
+            "Frame format invalid, type=", toHex<uint8_t>(frameTypeValue)),
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        static_cast<quic::FrameType>(frameTypeValue)));
+  }
+  return quic::QuicFrame(std::move(result.value()));
+}
+
+folly::Optional<quic::PacketNum> nextAckedPacketGap(
+    quic::PacketNum packetNum,
+    uint64_t gap) {
   // Gap cannot overflow because of the definition of quic integer encoding, so
   // we can just add to gap.
   uint64_t adjustedGap = gap + 2;
   if (UNLIKELY(packetNum < adjustedGap)) {
-    throw quic::QuicTransportException(
-        "Bad gap",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK);
+    return folly::none;
   }
   return packetNum - adjustedGap;
 }
 
-quic::PacketNum nextAckedPacketLen(
+folly::Optional<quic::PacketNum> nextAckedPacketLen(
     quic::PacketNum packetNum,
     uint64_t ackBlockLen) {
   // Going to allow 0 as a valid value.
   if (UNLIKELY(packetNum < ackBlockLen)) {
-    throw quic::QuicTransportException(
-        "Bad block len",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK);
+    return folly::none;
   }
   return packetNum - ackBlockLen;
 }
@@ -66,39 +88,27 @@ PingFrame decodePingFrame(folly::io::Cursor& /* cursor */) {
   return PingFrame();
 }
 
-ReadAckFrame decodeAckFrame(
+DecodeResult<ReadAckFrame> decodeAckFrame(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
     const CodecParameters& params) {
   ReadAckFrame frame;
   auto largestAckedInt = decodeQuicInteger(cursor);
   if (UNLIKELY(!largestAckedInt)) {
-    throw QuicTransportException(
-        "Bad largest acked",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK);
+    return frameEncodingError("Bad largest acked", FrameType::ACK);
   }
   auto largestAcked = folly::to<PacketNum>(largestAckedInt->first);
   auto ackDelay = decodeQuicInteger(cursor);
   if (UNLIKELY(!ackDelay)) {
-    throw QuicTransportException(
-        "Bad ack delay",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK);
+    return frameEncodingError("Bad ack delay", FrameType::ACK);
   }
   auto additionalAckBlocks = decodeQuicInteger(cursor);
   if (UNLIKELY(!additionalAckBlocks)) {
-    throw QuicTransportException(
-        "Bad ack block count",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK);
+    return frameEncodingError("Bad ack block count", FrameType::ACK);
   }
   auto firstAckBlockLen = decodeQuicInteger(cursor);
   if (UNLIKELY(!firstAckBlockLen)) {
-    throw QuicTransportException(
-        "Bad first block",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK);
+    return frameEncodingError("Bad first block", FrameType::ACK);
   }
   // Using default ack delay for long header packets. Before negotiating
   // and ack delay, the sender has to use something, so they use the default
@@ -115,94 +125,111 @@ ReadAckFrame decodeAckFrame(
   DCHECK_LT(leftShift, sizeof(delayOverflowMask) * 8);
   delayOverflowMask = delayOverflowMask << leftShift;
   if (UNLIKELY((ackDelay->first & delayOverflowMask) != 0)) {
-    throw QuicTransportException(
-        "Decoded ack delay overflows",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK);
+    return frameEncodingError("Decoded ack delay overflows", FrameType::ACK);
   }
   uint64_t adjustedAckDelay = ackDelay->first << ackDelayExponentToUse;
   if (UNLIKELY(
           adjustedAckDelay >
           std::numeric_limits<std::chrono::microseconds::rep>::max())) {
-    throw QuicTransportException(
-        "Bad ack delay",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK);
+    return frameEncodingError("Bad ack delay", FrameType::ACK);
   }
-  PacketNum currentPacketNum =
+  auto firstBlockStart =
       nextAckedPacketLen(largestAcked, firstAckBlockLen->first);
+  if (UNLIKELY(!firstBlockStart)) {
+    return frameEncodingError("Bad block len", FrameType::ACK);
+  }
+  PacketNum currentPacketNum = *firstBlockStart;
   frame.largestAcked = largestAcked;
   frame.ackDelay = std::chrono::microseconds(adjustedAckDelay);
   frame.ackBlocks.emplace_back(currentPacketNum, largestAcked);
-  for (uint64_t numBlocks = 0; numBlocks < additionalAckBlocks->first;
-       ++numBlocks) {
-    auto currentGap = decodeQuicInteger(cursor);
-    if (UNLIKELY(!currentGap)) {
-      throw QuicTransportException(
-          "Bad gap",
-          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-          quic::FrameType::ACK);
+  // Gap and length fields, decoded for several blocks at a time when they are
+  // in the same buffer.
+  std::array<uint64_t, 2 * kAckBlockDecodeBatch> blockFields;
+  uint64_t numBlocks = 0;
+  while (numBlocks < additionalAckBlocks->first) {
+    size_t batch = std::min<uint64_t>(
+        additionalAckBlocks->first - numBlocks, kAckBlockDecodeBatch);
+    auto bytesUsed = decodeQuicIntegers(
+        cursor.peekBytes(),
+        folly::range(blockFields.data(), blockFields.data() + 2 * batch));
+    if (bytesUsed) {
+      cursor.skip(*bytesUsed);
+    } else {
+      // The blocks span buffers or the frame is truncated, go one block at a
+      // time through the cursor.
+      batch = 1;
+      auto currentGap = decodeQuicInteger(cursor);
+      if (UNLIKELY(!currentGap)) {
+        return frameEncodingError("Bad gap", FrameType::ACK);
+      }
+      auto blockLen = decodeQuicInteger(cursor);
+      if (UNLIKELY(!blockLen)) {
+        return frameEncodingError("Bad block len", FrameType::ACK);
+      }
+      blockFields[0] = currentGap->first;
+      blockFields[1] = blockLen->first;
     }
-    auto blockLen = decodeQuicInteger(cursor);
-    if (UNLIKELY(!blockLen)) {
-      throw QuicTransportException(
-          "Bad block len",
-          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-          quic::FrameType::ACK);
+    for (size_t i = 0; i < batch; ++i) {
+      auto nextEndPacket =
+          nextAckedPacketGap(currentPacketNum, blockFields[2 * i]);
+      if (UNLIKELY(!nextEndPacket)) {
+        return frameEncodingError("Bad gap", FrameType::ACK);
+      }
+      auto nextStartPacket =
+          nextAckedPacketLen(*nextEndPacket, blockFields[2 * i + 1]);
+      if (UNLIKELY(!nextStartPacket)) {
+        return frameEncodingError("Bad block len", FrameType::ACK);
+      }
+      currentPacketNum = *nextStartPacket;
+      // We don't need to add the entry when the block length is zero since we
+      // already would have processed it in the previous iteration.
+      frame.ackBlocks.emplace_back(currentPacketNum, *nextEndPacket);
     }
-    PacketNum nextEndPacket =
-        nextAckedPacketGap(currentPacketNum, currentGap->first);
-    currentPacketNum = nextAckedPacketLen(nextEndPacket, blockLen->first);
-    // We don't need to add the entry when the block length is zero since we
-    // already would have processed it in the previous iteration.
-    frame.ackBlocks.emplace_back(currentPacketNum, nextEndPacket);
+    numBlocks += batch;
   }
   return frame;
 }
 
-ReadAckFrame decodeAckFrameWithECN(
+DecodeResult<ReadAckFrame> decodeAckFrameWithECN(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
     const CodecParameters& params) {
-  // TODO this is incomplete
   auto readAckFrame = decodeAckFrame(cursor, header, params);
-  // TODO we simply ignore ECN blocks in ACK-ECN frames for now.
+  if (UNLIKELY(readAckFrame.hasError())) {
+    return readAckFrame;
+  }
   auto ect_0 = decodeQuicInteger(cursor);
   if (UNLIKELY(!ect_0)) {
-    throw QuicTransportException(
-        "Bad ECT(0) value",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK_ECN);
+    return frameEncodingError("Bad ECT(0) value", FrameType::ACK_ECN);
   }
   auto ect_1 = decodeQuicInteger(cursor);
   if (UNLIKELY(!ect_1)) {
-    throw QuicTransportException(
-        "Bad ECT(1) value",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK_ECN);
+    return frameEncodingError("Bad ECT(1) value", FrameType::ACK_ECN);
   }
   auto ect_ce = decodeQuicInteger(cursor);
   if (UNLIKELY(!ect_ce)) {
-    throw QuicTransportException(
-        "Bad ECT-CE value",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::ACK_ECN);
+    return frameEncodingError("Bad ECT-CE value", FrameType::ACK_ECN);
   }
+  readAckFrame->ecnCounts.emplace();
+  readAckFrame->ecnCounts->ect0 = ect_0->first;
+  readAckFrame->ecnCounts->ect1 = ect_1->first;
+  readAckFrame->ecnCounts->ce = ect_ce->first;
   return readAckFrame;
 }
 
-RstStreamFrame decodeRstStreamFrame(
+DecodeResult<RstStreamFrame> decodeRstStreamFrame(
     folly::io::Cursor& cursor,
     const CodecParameters& params) {
   auto streamId = decodeQuicInteger(cursor);
   if (UNLIKELY(!streamId)) {
-    throw QuicTransportException(
-        "Bad streamId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::RST_STREAM);
+    return frameEncodingError("Bad streamId", FrameType::RST_STREAM);
   }
   ApplicationErrorCode errorCode;
   if (params.version == QuicVersion::MVFST_OLD) {
+    if (!cursor.canAdvance(sizeof(ApplicationErrorCode))) {
+      return frameEncodingError(
+          "Cannot decode error code", FrameType::RST_STREAM);
+    }
     errorCode = static_cast<ApplicationErrorCode>(
         cursor.readBE<ApplicationErrorCode>());
   } else {
@@ -210,35 +237,31 @@ RstStreamFrame decodeRstStreamFrame(
     if (varCode) {
       errorCode = static_cast<ApplicationErrorCode>(varCode->first);
     } else {
-      throw QuicTransportException(
-          "Cannot decode error code",
-          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-          quic::FrameType::RST_STREAM);
+      return frameEncodingError(
+          "Cannot decode error code", FrameType::RST_STREAM);
     }
   }
   auto offset = decodeQuicInteger(cursor);
   if (UNLIKELY(!offset)) {
-    throw QuicTransportException(
-        "Bad offset",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::RST_STREAM);
+    return frameEncodingError("Bad offset", FrameType::RST_STREAM);
   }
   return RstStreamFrame(
       folly::to<StreamId>(streamId->first), errorCode, offset->first);
 }
 
-StopSendingFrame decodeStopSendingFrame(
+DecodeResult<StopSendingFrame> decodeStopSendingFrame(
     folly::io::Cursor& cursor,
     const CodecParameters& params) {
   auto streamId = decodeQuicInteger(cursor);
   if (UNLIKELY(!streamId)) {
-    throw QuicTransportException(
-        "Bad streamId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::STOP_SENDING);
+    return frameEncodingError("Bad streamId", FrameType::STOP_SENDING);
   }
   ApplicationErrorCode errorCode;
   if (params.version == QuicVersion::MVFST_OLD) {
+    if (!cursor.canAdvance(sizeof(ApplicationErrorCode))) {
+      return frameEncodingError(
+          "Cannot decode error code", FrameType::STOP_SENDING);
+    }
     errorCode = static_cast<ApplicationErrorCode>(
         cursor.readBE<ApplicationErrorCode>());
   } else {
@@ -246,82 +269,57 @@ StopSendingFrame decodeStopSendingFrame(
     if (varCode) {
       errorCode = static_cast<ApplicationErrorCode>(varCode->first);
     } else {
-      throw QuicTransportException(
-          "Cannot decode error code",
-          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-          quic::FrameType::STOP_SENDING);
+      return frameEncodingError(
+          "Cannot decode error code", FrameType::STOP_SENDING);
     }
   }
   return StopSendingFrame(folly::to<StreamId>(streamId->first), errorCode);
 }
 
-ReadCryptoFrame decodeCryptoFrame(folly::io::Cursor& cursor) {
+DecodeResult<ReadCryptoFrame> decodeCryptoFrame(folly::io::Cursor& cursor) {
   auto optionalOffset = decodeQuicInteger(cursor);
   if (!optionalOffset) {
-    throw QuicTransportException(
-        "Invalid offset",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::CRYPTO_FRAME);
+    return frameEncodingError("Invalid offset", FrameType::CRYPTO_FRAME);
   }
   uint64_t offset = optionalOffset->first;
 
   auto dataLength = decodeQuicInteger(cursor);
   if (!dataLength) {
-    throw QuicTransportException(
-        "Invalid length",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::CRYPTO_FRAME);
+    return frameEncodingError("Invalid length", FrameType::CRYPTO_FRAME);
   }
   Buf data;
   if (cursor.totalLength() < dataLength->first) {
-    throw QuicTransportException(
-        "Length mismatch",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::CRYPTO_FRAME);
+    return frameEncodingError("Length mismatch", FrameType::CRYPTO_FRAME);
   }
-  // If dataLength > data's actual length then the cursor will throw.
   cursor.clone(data, dataLength->first);
   return ReadCryptoFrame(offset, std::move(data));
 }
 
-ReadNewTokenFrame decodeNewTokenFrame(folly::io::Cursor& cursor) {
+DecodeResult<ReadNewTokenFrame> decodeNewTokenFrame(folly::io::Cursor& cursor) {
   auto tokenLength = decodeQuicInteger(cursor);
   if (!tokenLength) {
-    throw QuicTransportException(
-        "Invalid length",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::NEW_TOKEN);
+    return frameEncodingError("Invalid length", FrameType::NEW_TOKEN);
   }
   Buf token;
   if (cursor.totalLength() < tokenLength->first) {
-    throw QuicTransportException(
-        "Length mismatch",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::NEW_TOKEN);
+    return frameEncodingError("Length mismatch", FrameType::NEW_TOKEN);
   }
-  // If tokenLength > token's actual length then the cursor will throw.
   cursor.clone(token, tokenLength->first);
   return ReadNewTokenFrame(std::move(token));
 }
 
-ReadStreamFrame decodeStreamFrame(
+DecodeResult<ReadStreamFrame> decodeStreamFrame(
     folly::io::Cursor& cursor,
     StreamTypeField frameTypeField) {
   auto streamId = decodeQuicInteger(cursor);
   if (!streamId) {
-    throw QuicTransportException(
-        "Invalid stream id",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::STREAM);
+    return frameEncodingError("Invalid stream id", FrameType::STREAM);
   }
   uint64_t offset = 0;
   if (frameTypeField.hasOffset()) {
     auto optionalOffset = decodeQuicInteger(cursor);
     if (!optionalOffset) {
-      throw QuicTransportException(
-          "Invalid offset",
-          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-          quic::FrameType::STREAM);
+      return frameEncodingError("Invalid offset", FrameType::STREAM);
     }
     offset = optionalOffset->first;
   }
@@ -330,21 +328,14 @@ ReadStreamFrame decodeStreamFrame(
   if (frameTypeField.hasDataLength()) {
     dataLength = decodeQuicInteger(cursor);
     if (!dataLength) {
-      throw QuicTransportException(
-          "Invalid length",
-          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-          quic::FrameType::STREAM);
+      return frameEncodingError("Invalid length", FrameType::STREAM);
     }
   }
   Buf data;
   if (dataLength.hasValue()) {
     if (cursor.totalLength() < dataLength->first) {
-      throw QuicTransportException(
-          "Length mismatch",
-          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-          quic::FrameType::STREAM);
+      return frameEncodingError("Length mismatch", FrameType::STREAM);
     }
-    // If dataLength > data's actual length then the cursor will throw.
     cursor.clone(data, dataLength->first);
   } else {
     // Missing Data Length field doesn't mean no data. It means the rest of the
@@ -355,222 +346,202 @@ ReadStreamFrame decodeStreamFrame(
       folly::to<StreamId>(streamId->first), offset, std::move(data), fin);
 }
 
-MaxDataFrame decodeMaxDataFrame(folly::io::Cursor& cursor) {
+DecodeResult<MaxDataFrame> decodeMaxDataFrame(folly::io::Cursor& cursor) {
   auto maximumData = decodeQuicInteger(cursor);
   if (UNLIKELY(!maximumData)) {
-    throw QuicTransportException(
-        "Bad Max Data",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::MAX_DATA);
+    return frameEncodingError("Bad Max Data", FrameType::MAX_DATA);
   }
   return MaxDataFrame(maximumData->first);
 }
 
-MaxStreamDataFrame decodeMaxStreamDataFrame(folly::io::Cursor& cursor) {
+DecodeResult<MaxStreamDataFrame> decodeMaxStreamDataFrame(
+    folly::io::Cursor& cursor) {
   auto streamId = decodeQuicInteger(cursor);
   if (UNLIKELY(!streamId)) {
-    throw QuicTransportException(
-        "Invalid streamId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::MAX_STREAM_DATA);
+    return frameEncodingError("Invalid streamId", FrameType::MAX_STREAM_DATA);
   }
   auto offset = decodeQuicInteger(cursor);
   if (UNLIKELY(!offset)) {
-    throw QuicTransportException(
-        "Invalid offset",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::MAX_STREAM_DATA);
+    return frameEncodingError("Invalid offset", FrameType::MAX_STREAM_DATA);
   }
   return MaxStreamDataFrame(
       folly::to<StreamId>(streamId->first), offset->first);
 }
 
-MaxStreamsFrame decodeBiDiMaxStreamsFrame(folly::io::Cursor& cursor) {
+DecodeResult<MaxStreamsFrame> decodeBiDiMaxStreamsFrame(
+    folly::io::Cursor& cursor) {
   auto streamCount = decodeQuicInteger(cursor);
   if (UNLIKELY(!streamCount)) {
-    throw QuicTransportException(
-        "Invalid Bi-directional streamId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::MAX_STREAMS_BIDI);
+    return frameEncodingError(
+        "Invalid Bi-directional streamId", FrameType::MAX_STREAMS_BIDI);
   }
   return MaxStreamsFrame(streamCount->first, true /* isBidirectional*/);
 }
 
-MaxStreamsFrame decodeUniMaxStreamsFrame(folly::io::Cursor& cursor) {
+DecodeResult<MaxStreamsFrame> decodeUniMaxStreamsFrame(
+    folly::io::Cursor& cursor) {
   auto streamCount = decodeQuicInteger(cursor);
   if (UNLIKELY(!streamCount)) {
-    throw QuicTransportException(
-        "Invalid Uni-directional streamId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::MAX_STREAMS_UNI);
+    return frameEncodingError(
+        "Invalid Uni-directional streamId", FrameType::MAX_STREAMS_UNI);
   }
   return MaxStreamsFrame(streamCount->first, false /* isUnidirectional */);
 }
 
-DataBlockedFrame decodeDataBlockedFrame(folly::io::Cursor& cursor) {
+DecodeResult<DataBlockedFrame> decodeDataBlockedFrame(
+    folly::io::Cursor& cursor) {
   auto dataLimit = decodeQuicInteger(cursor);
   if (UNLIKELY(!dataLimit)) {
-    throw QuicTransportException(
-        "Bad offset",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::DATA_BLOCKED);
+    return frameEncodingError("Bad offset", FrameType::DATA_BLOCKED);
   }
   return DataBlockedFrame(dataLimit->first);
 }
 
-StreamDataBlockedFrame decodeStreamDataBlockedFrame(folly::io::Cursor& cursor) {
+DecodeResult<StreamDataBlockedFrame> decodeStreamDataBlockedFrame(
+    folly::io::Cursor& cursor) {
   auto streamId = decodeQuicInteger(cursor);
   if (UNLIKELY(!streamId)) {
-    throw QuicTransportException(
-        "Bad streamId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::STREAM_DATA_BLOCKED);
+    return frameEncodingError("Bad streamId", FrameType::STREAM_DATA_BLOCKED);
   }
   auto dataLimit = decodeQuicInteger(cursor);
   if (UNLIKELY(!dataLimit)) {
-    throw QuicTransportException(
-        "Bad offset",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::STREAM_DATA_BLOCKED);
+    return frameEncodingError("Bad offset", FrameType::STREAM_DATA_BLOCKED);
   }
   return StreamDataBlockedFrame(
       folly::to<StreamId>(streamId->first), dataLimit->first);
 }
 
-StreamsBlockedFrame decodeBiDiStreamsBlockedFrame(folly::io::Cursor& cursor) {
+DecodeResult<StreamsBlockedFrame> decodeBiDiStreamsBlockedFrame(
+    folly::io::Cursor& cursor) {
   auto streamId = decodeQuicInteger(cursor);
   if (UNLIKELY(!streamId)) {
-    throw QuicTransportException(
-        "Bad Bi-Directional streamId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::STREAMS_BLOCKED_BIDI);
+    return frameEncodingError(
+        "Bad Bi-Directional streamId", FrameType::STREAMS_BLOCKED_BIDI);
   }
   return StreamsBlockedFrame(
       folly::to<StreamId>(streamId->first), true /* isBidirectional */);
 }
 
-StreamsBlockedFrame decodeUniStreamsBlockedFrame(folly::io::Cursor& cursor) {
+DecodeResult<StreamsBlockedFrame> decodeUniStreamsBlockedFrame(
+    folly::io::Cursor& cursor) {
   auto streamId = decodeQuicInteger(cursor);
   if (UNLIKELY(!streamId)) {
-    throw QuicTransportException(
-        "Bad Uni-direcitonal streamId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::STREAMS_BLOCKED_UNI);
+    return frameEncodingError(
+        "Bad Uni-direcitonal streamId", FrameType::STREAMS_BLOCKED_UNI);
   }
   return StreamsBlockedFrame(
       folly::to<StreamId>(streamId->first), false /* isBidirectional */);
 }
 
-NewConnectionIdFrame decodeNewConnectionIdFrame(folly::io::Cursor& cursor) {
+DecodeResult<NewConnectionIdFrame> decodeNewConnectionIdFrame(
+    folly::io::Cursor& cursor) {
   auto sequence = decodeQuicInteger(cursor);
-  if (UNLIKELY(!sequence)) {
-    throw QuicTransportException(
-        "Bad sequence",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::NEW_CONNECTION_ID);
+  if (UNLIKELY(
+          !sequence ||
+          sequence->first > std::numeric_limits<uint16_t>::max())) {
+    return frameEncodingError("Bad sequence", FrameType::NEW_CONNECTION_ID);
   }
   if (!cursor.canAdvance(sizeof(uint8_t))) {
-    throw QuicTransportException(
+    return frameEncodingError(
         "Not enough input bytes to read Dest. ConnectionId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::NEW_CONNECTION_ID);
+        FrameType::NEW_CONNECTION_ID);
   }
   auto connIdLen = cursor.readBE<uint8_t>();
   if (UNLIKELY(cursor.totalLength() < connIdLen)) {
-    throw QuicTransportException(
-        "Bad connid",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::NEW_CONNECTION_ID);
+    return frameEncodingError("Bad connid", FrameType::NEW_CONNECTION_ID);
   }
   if (connIdLen < kMinConnectionIdSize || connIdLen > kMaxConnectionIdSize) {
-    throw QuicTransportException(
-        "ConnectionId invalid length",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::NEW_CONNECTION_ID);
+    return frameEncodingError(
+        "ConnectionId invalid length", FrameType::NEW_CONNECTION_ID);
   }
   ConnectionId connId(cursor, connIdLen);
   StatelessResetToken statelessResetToken;
+  if (!cursor.canAdvance(statelessResetToken.size())) {
+    return frameEncodingError(
+        "Not enough input bytes to read stateless reset token",
+        FrameType::NEW_CONNECTION_ID);
+  }
   cursor.pull(statelessResetToken.data(), statelessResetToken.size());
   return NewConnectionIdFrame(
-      folly::to<uint16_t>(sequence->first),
+      static_cast<uint16_t>(sequence->first),
       std::move(connId),
       std::move(statelessResetToken));
 }
 
-NoopFrame decodeRetireConnectionIdFrame(folly::io::Cursor& cursor) {
-  // TODO we parse this frame, but return NoopFrame. Add proper support for it!
+DecodeResult<RetireConnectionIdFrame> decodeRetireConnectionIdFrame(
+    folly::io::Cursor& cursor) {
   auto sequenceNum = decodeQuicInteger(cursor);
   if (UNLIKELY(!sequenceNum)) {
-    throw QuicTransportException(
-        // TODO change the error code
-        "Bad sequence num",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::RETIRE_CONNECTION_ID);
+    return frameEncodingError(
+        "Bad sequence num", FrameType::RETIRE_CONNECTION_ID);
   }
-  return NoopFrame();
+  return RetireConnectionIdFrame(sequenceNum->first);
 }
 
-PathChallengeFrame decodePathChallengeFrame(folly::io::Cursor& cursor) {
+DecodeResult<PathChallengeFrame> decodePathChallengeFrame(
+    folly::io::Cursor& cursor) {
   // just parse and ignore expected data
   // A PATH_CHALLENGE frame contains 8 bytes
   if (!cursor.canAdvance(sizeof(uint64_t))) {
-    throw QuicTransportException(
+    return frameEncodingError(
         "Not enough input bytes to read path challenge frame.",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::PATH_CHALLENGE);
+        FrameType::PATH_CHALLENGE);
   }
   auto pathData = cursor.readBE<uint64_t>();
   return PathChallengeFrame(pathData);
 }
 
-PathResponseFrame decodePathResponseFrame(folly::io::Cursor& cursor) {
+DecodeResult<PathResponseFrame> decodePathResponseFrame(
+    folly::io::Cursor& cursor) {
   // just parse and ignore expected data
   // Its format is identical to the PATH_CHALLENGE frame
   if (!cursor.canAdvance(sizeof(uint64_t))) {
-    throw QuicTransportException(
+    return frameEncodingError(
         "Not enough input bytes to read path response frame.",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::PATH_RESPONSE);
+        FrameType::PATH_RESPONSE);
   }
   auto pathData = cursor.readBE<uint64_t>();
   return PathResponseFrame(pathData);
 }
 
-ConnectionCloseFrame decodeConnectionCloseFrame(
+DecodeResult<ConnectionCloseFrame> decodeConnectionCloseFrame(
     folly::io::Cursor& cursor,
     const CodecParameters& params) {
   TransportErrorCode errorCode{};
   if (params.version == QuicVersion::MVFST_OLD) {
-    auto detailedCode =
-        cursor.readBE<std::underlying_type<TransportErrorCode>::type>();
+    using ErrorCodeType = std::underlying_type<TransportErrorCode>::type;
+    if (!cursor.canAdvance(sizeof(ErrorCodeType))) {
+      return frameEncodingError(
+          "Failed to parse error code.", FrameType::CONNECTION_CLOSE);
+    }
+    auto detailedCode = cursor.readBE<ErrorCodeType>();
     errorCode = static_cast<TransportErrorCode>(detailedCode);
   } else {
     auto varCode = decodeQuicInteger(cursor);
     if (varCode) {
       errorCode = static_cast<TransportErrorCode>(varCode->first);
     } else {
-      throw QuicTransportException(
-          "Failed to parse error code.",
-          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-          quic::FrameType::CONNECTION_CLOSE);
+      return frameEncodingError(
+          "Failed to parse error code.", FrameType::CONNECTION_CLOSE);
     }
   }
   auto frameTypeField = decodeQuicInteger(cursor);
   if (UNLIKELY(!frameTypeField || frameTypeField->second != sizeof(uint8_t))) {
-    throw QuicTransportException(
+    return frameEncodingError(
         "Bad connection close triggering frame type value",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::CONNECTION_CLOSE);
+        FrameType::CONNECTION_CLOSE);
   }
   FrameType triggeringFrameType = static_cast<FrameType>(frameTypeField->first);
   auto reasonPhraseLength = decodeQuicInteger(cursor);
   if (UNLIKELY(
           !reasonPhraseLength ||
           reasonPhraseLength->first > kMaxReasonPhraseLength)) {
-    throw QuicTransportException(
-        "Bad reason phrase length",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::CONNECTION_CLOSE);
+    return frameEncodingError(
+        "Bad reason phrase length", FrameType::CONNECTION_CLOSE);
+  }
+  if (UNLIKELY(!cursor.canAdvance(reasonPhraseLength->first))) {
+    return frameEncodingError(
+        "Reason phrase length mismatch", FrameType::CONNECTION_CLOSE);
   }
   auto reasonPhrase =
       cursor.readFixedString(folly::to<size_t>(reasonPhraseLength->first));
@@ -578,11 +549,15 @@ ConnectionCloseFrame decodeConnectionCloseFrame(
       errorCode, std::move(reasonPhrase), triggeringFrameType);
 }
 
-ApplicationCloseFrame decodeApplicationCloseFrame(
+DecodeResult<ApplicationCloseFrame> decodeApplicationCloseFrame(
     folly::io::Cursor& cursor,
     const CodecParameters& params) {
   ApplicationErrorCode errorCode{};
   if (params.version == QuicVersion::MVFST_OLD) {
+    if (!cursor.canAdvance(sizeof(ApplicationErrorCode))) {
+      return frameEncodingError(
+          "Failed to parse error code.", FrameType::APPLICATION_CLOSE);
+    }
     auto detailedCode = cursor.readBE<ApplicationErrorCode>();
     errorCode = static_cast<ApplicationErrorCode>(detailedCode);
   } else {
@@ -590,47 +565,41 @@ ApplicationCloseFrame decodeApplicationCloseFrame(
     if (varCode) {
       errorCode = static_cast<ApplicationErrorCode>(varCode->first);
     } else {
-      throw QuicTransportException(
-          "Failed to parse error code.",
-          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-          quic::FrameType::APPLICATION_CLOSE);
+      return frameEncodingError(
+          "Failed to parse error code.", FrameType::APPLICATION_CLOSE);
     }
   }
   auto reasonPhraseLength = decodeQuicInteger(cursor);
   if (UNLIKELY(
           !reasonPhraseLength ||
           reasonPhraseLength->first > kMaxReasonPhraseLength)) {
-    throw QuicTransportException(
-        "Bad reason phrase length",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::APPLICATION_CLOSE);
+    return frameEncodingError(
+        "Bad reason phrase length", FrameType::APPLICATION_CLOSE);
+  }
+  if (UNLIKELY(!cursor.canAdvance(reasonPhraseLength->first))) {
+    return frameEncodingError(
+        "Reason phrase length mismatch", FrameType::APPLICATION_CLOSE);
   }
   auto reasonPhrase =
       cursor.readFixedString(folly::to<size_t>(reasonPhraseLength->first));
   return ApplicationCloseFrame(errorCode, std::move(reasonPhrase));
 }
 
-MinStreamDataFrame decodeMinStreamDataFrame(folly::io::Cursor& cursor) {
+DecodeResult<MinStreamDataFrame> decodeMinStreamDataFrame(
+    folly::io::Cursor& cursor) {
   auto streamId = decodeQuicInteger(cursor);
   if (UNLIKELY(!streamId)) {
-    throw QuicTransportException(
-        "Invalid streamId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::MIN_STREAM_DATA);
+    return frameEncodingError("Invalid streamId", FrameType::MIN_STREAM_DATA);
   }
   auto maximumData = decodeQuicInteger(cursor);
   if (UNLIKELY(!maximumData)) {
-    throw QuicTransportException(
-        "Invalid maximumData",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::MIN_STREAM_DATA);
+    return frameEncodingError(
+        "Invalid maximumData", FrameType::MIN_STREAM_DATA);
   }
   auto minimumStreamOffset = decodeQuicInteger(cursor);
   if (UNLIKELY(!minimumStreamOffset)) {
-    throw QuicTransportException(
-        "Invalid minimumStreamOffset",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::MIN_STREAM_DATA);
+    return frameEncodingError(
+        "Invalid minimumStreamOffset", FrameType::MIN_STREAM_DATA);
   }
   return MinStreamDataFrame(
       folly::to<StreamId>(streamId->first),
@@ -638,133 +607,288 @@ MinStreamDataFrame decodeMinStreamDataFrame(folly::io::Cursor& cursor) {
       minimumStreamOffset->first);
 }
 
-ExpiredStreamDataFrame decodeExpiredStreamDataFrame(folly::io::Cursor& cursor) {
+DecodeResult<ExpiredStreamDataFrame> decodeExpiredStreamDataFrame(
+    folly::io::Cursor& cursor) {
   auto streamId = decodeQuicInteger(cursor);
   if (UNLIKELY(!streamId)) {
-    throw QuicTransportException(
-        "Invalid streamId",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::EXPIRED_STREAM_DATA);
+    return frameEncodingError(
+        "Invalid streamId", FrameType::EXPIRED_STREAM_DATA);
   }
   auto minimumStreamOffset = decodeQuicInteger(cursor);
   if (UNLIKELY(!minimumStreamOffset)) {
-    throw QuicTransportException(
-        "Invalid minimumStreamOffset",
-        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-        quic::FrameType::EXPIRED_STREAM_DATA);
+    return frameEncodingError(
+        "Invalid minimumStreamOffset", FrameType::EXPIRED_STREAM_DATA);
   }
   return ExpiredStreamDataFrame(
       folly::to<StreamId>(streamId->first), minimumStreamOffset->first);
 }
 
-QuicFrame parseFrame(
+DecodeResult<AckFrequencyFrame> decodeAckFrequencyFrame(
+    folly::io::Cursor& cursor) {
+  auto sequenceNumber = decodeQuicInteger(cursor);
+  if (UNLIKELY(!sequenceNumber)) {
+    return frameEncodingError(
+        "Invalid sequence number", FrameType::ACK_FREQUENCY);
+  }
+  auto packetTolerance = decodeQuicInteger(cursor);
+  if (UNLIKELY(!packetTolerance || packetTolerance->first == 0)) {
+    return frameEncodingError(
+        "Invalid packet tolerance", FrameType::ACK_FREQUENCY);
+  }
+  auto maxAckDelay = decodeQuicInteger(cursor);
+  if (UNLIKELY(!maxAckDelay)) {
+    return frameEncodingError(
+        "Invalid max ack delay", FrameType::ACK_FREQUENCY);
+  }
+  if (!cursor.canAdvance(sizeof(uint8_t))) {
+    return frameEncodingError(
+        "Not enough input bytes to read ignore order",
+        FrameType::ACK_FREQUENCY);
+  }
+  auto ignoreOrder = cursor.readBE<uint8_t>();
+  if (UNLIKELY(ignoreOrder > 1)) {
+    return frameEncodingError("Invalid ignore order", FrameType::ACK_FREQUENCY);
+  }
+  return AckFrequencyFrame(
+      sequenceNumber->first,
+      packetTolerance->first,
+      std::chrono::microseconds(maxAckDelay->first),
+      ignoreOrder == 1);
+}
+
+DecodeResult<FecRepairFrame> decodeFecRepairFrame(folly::io::Cursor& cursor) {
+  auto firstPacketNum = decodeQuicInteger(cursor);
+  if (UNLIKELY(!firstPacketNum)) {
+    return frameEncodingError(
+        "Invalid first packet number", FrameType::FEC_REPAIR);
+  }
+  auto numPackets = decodeQuicInteger(cursor);
+  if (UNLIKELY(!numPackets)) {
+    return frameEncodingError(
+        "Invalid number of packets", FrameType::FEC_REPAIR);
+  }
+  auto numSourceFrames = decodeQuicInteger(cursor);
+  if (UNLIKELY(!numSourceFrames || numSourceFrames->first == 0)) {
+    return frameEncodingError(
+        "Invalid number of source frames", FrameType::FEC_REPAIR);
+  }
+  auto repairDataLen = decodeQuicInteger(cursor);
+  if (UNLIKELY(!repairDataLen)) {
+    return frameEncodingError(
+        "Invalid repair data length", FrameType::FEC_REPAIR);
+  }
+  if (UNLIKELY(cursor.totalLength() < repairDataLen->first)) {
+    return frameEncodingError("Length mismatch", FrameType::FEC_REPAIR);
+  }
+  if (UNLIKELY(
+          firstPacketNum->first + numPackets->first < firstPacketNum->first)) {
+    return frameEncodingError(
+        "Invalid packet number range", FrameType::FEC_REPAIR);
+  }
+  Buf repairData;
+  cursor.clone(repairData, repairDataLen->first);
+  return FecRepairFrame(
+      firstPacketNum->first,
+      firstPacketNum->first + numPackets->first,
+      numSourceFrames->first,
+      std::move(repairData));
+}
+
+DecodeResult<DatagramFrame> decodeDatagramFrame(
+    folly::io::Cursor& cursor,
+    bool hasLen) {
+  size_t length = cursor.totalLength();
+  if (hasLen) {
+    auto dataLength = decodeQuicInteger(cursor);
+    if (UNLIKELY(!dataLength)) {
+      return frameEncodingError(
+          "Invalid datagram len", FrameType::DATAGRAM_LEN);
+    }
+    if (UNLIKELY(cursor.totalLength() < dataLength->first)) {
+      return frameEncodingError("Length mismatch", FrameType::DATAGRAM_LEN);
+    }
+    length = dataLength->first;
+  }
+  Buf data;
+  cursor.clone(data, length);
+  return DatagramFrame(length, std::move(data));
+}
+
+DecodeResult<QuicFrame> parseFrame(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
     const CodecParameters& params) {
   if (!cursor.canAdvance(sizeof(FrameType))) {
-    throw QuicTransportException(
+    return folly::makeUnexpected(QuicTransportError(
         "Quic frame parsing: cursor cannot advance",
-        TransportErrorCode::FRAME_ENCODING_ERROR);
+        TransportErrorCode::FRAME_ENCODING_ERROR));
   }
   auto initialByte = decodeQuicInteger(cursor);
   // TODO add an new api to determine whether the frametype is encoded minimally
   if (UNLIKELY(!initialByte)) {
-    throw QuicTransportException(
-        "Invalid frame-type field", TransportErrorCode::FRAME_ENCODING_ERROR);
-  }
-  FrameType frameType = static_cast<FrameType>(initialByte->first);
-  try {
-    switch (frameType) {
-      case FrameType::PADDING:
-        return QuicFrame(decodePaddingFrame(cursor));
-      case FrameType::PING:
-        return QuicFrame(decodePingFrame(cursor));
-      case FrameType::ACK:
-        return QuicFrame(decodeAckFrame(cursor, header, params));
-      case FrameType::ACK_ECN:
-        return QuicFrame(decodeAckFrameWithECN(cursor, header, params));
-      case FrameType::RST_STREAM:
-        return QuicFrame(decodeRstStreamFrame(cursor, params));
-      case FrameType::STOP_SENDING:
-        return QuicFrame(decodeStopSendingFrame(cursor, params));
-      case FrameType::CRYPTO_FRAME:
-        return QuicFrame(decodeCryptoFrame(cursor));
-      case FrameType::NEW_TOKEN:
-        return QuicFrame(decodeNewTokenFrame(cursor));
-      case FrameType::STREAM:
-        // Stream frames are special and have several values.
-        break;
-      case FrameType::MAX_DATA:
-        return QuicFrame(decodeMaxDataFrame(cursor));
-      case FrameType::MAX_STREAM_DATA:
-        return QuicFrame(decodeMaxStreamDataFrame(cursor));
-      case FrameType::MAX_STREAMS_BIDI:
-        return QuicFrame(decodeBiDiMaxStreamsFrame(cursor));
-      case FrameType::MAX_STREAMS_UNI:
-        return QuicFrame(decodeUniMaxStreamsFrame(cursor));
-      case FrameType::DATA_BLOCKED:
-        return QuicFrame(decodeDataBlockedFrame(cursor));
-      case FrameType::STREAM_DATA_BLOCKED:
-        return QuicFrame(decodeStreamDataBlockedFrame(cursor));
-      case FrameType::STREAMS_BLOCKED_BIDI:
-        return QuicFrame(decodeBiDiStreamsBlockedFrame(cursor));
-      case FrameType::STREAMS_BLOCKED_UNI:
-        return QuicFrame(decodeUniStreamsBlockedFrame(cursor));
-      case FrameType::NEW_CONNECTION_ID:
-        return QuicFrame(decodeNewConnectionIdFrame(cursor));
-      case FrameType::RETIRE_CONNECTION_ID:
-        return QuicFrame(decodeRetireConnectionIdFrame(cursor));
-      case FrameType::PATH_CHALLENGE:
-        return QuicFrame(decodePathChallengeFrame(cursor));
-      case FrameType::PATH_RESPONSE:
-        return QuicFrame(decodePathResponseFrame(cursor));
-      case FrameType::CONNECTION_CLOSE:
-        return QuicFrame(decodeConnectionCloseFrame(cursor, params));
-      case FrameType::APPLICATION_CLOSE:
-        return QuicFrame(decodeApplicationCloseFrame(cursor, params));
-      case FrameType::MIN_STREAM_DATA:
-        return QuicFrame(decodeMinStreamDataFrame(cursor));
-      case FrameType::EXPIRED_STREAM_DATA:
-        return QuicFrame(decodeExpiredStreamDataFrame(cursor));
-    }
-    auto streamFieldType = StreamTypeField::tryStream(initialByte->first);
-    if (streamFieldType) {
-      return QuicFrame(decodeStreamFrame(cursor, *streamFieldType));
-    }
-  } catch (const std::exception& e) {
-    throw QuicTransportException(
-        folly::to<std::string>(
-            "Frame format invalid, type=", toHex<uint8_t>(initialByte->first)),
-        TransportErrorCode::FRAME_ENCODING_ERROR,
-        frameType);
-  }
-  throw QuicTransportException(
+    return folly::makeUnexpected(QuicTransportError(
+        "Invalid frame-type field", TransportErrorCode::FRAME_ENCODING_ERROR));
+  }
+  uint64_t frameTypeValue = initialByte->first;
+  FrameType frameType = static_cast<FrameType>(frameTypeValue);
+  switch (frameType) {
+    case FrameType::PADDING:
+      return QuicFrame(decodePaddingFrame(cursor));
+    case FrameType::PING:
+      return QuicFrame(decodePingFrame(cursor));
+    case FrameType::ACK:
+      return toQuicFrame(
+          decodeAckFrame(cursor, header, params), frameTypeValue);
+    case FrameType::ACK_ECN:
+      return toQuicFrame(
+          decodeAckFrameWithECN(cursor, header, params), frameTypeValue);
+    case FrameType::RST_STREAM:
+      return toQuicFrame(decodeRstStreamFrame(cursor, params), frameTypeValue);
+    case FrameType::STOP_SENDING:
+      return toQuicFrame(
+          decodeStopSendingFrame(cursor, params), frameTypeValue);
+    case FrameType::CRYPTO_FRAME:
+      return toQuicFrame(decodeCryptoFrame(cursor), frameTypeValue);
+    case FrameType::NEW_TOKEN:
+      return toQuicFrame(decodeNewTokenFrame(cursor), frameTypeValue);
+    case FrameType::STREAM:
+      // Stream frames are special and have several values.
+      break;
+    case FrameType::MAX_DATA:
+      return toQuicFrame(decodeMaxDataFrame(cursor), frameTypeValue);
+    case FrameType::MAX_STREAM_DATA:
+      return toQuicFrame(decodeMaxStreamDataFrame(cursor), frameTypeValue);
+    case FrameType::MAX_STREAMS_BIDI:
+      return toQuicFrame(decodeBiDiMaxStreamsFrame(cursor), frameTypeValue);
+    case FrameType::MAX_STREAMS_UNI:
+      return toQuicFrame(decodeUniMaxStreamsFrame(cursor), frameTypeValue);
+    case FrameType::DATA_BLOCKED:
+      return toQuicFrame(decodeDataBlockedFrame(cursor), frameTypeValue);
+    case FrameType::STREAM_DATA_BLOCKED:
+      return toQuicFrame(decodeStreamDataBlockedFrame(cursor), frameTypeValue);
+    case FrameType::STREAMS_BLOCKED_BIDI:
+      return toQuicFrame(decodeBiDiStreamsBlockedFrame(cursor), frameTypeValue);
+    case FrameType::STREAMS_BLOCKED_UNI:
+      return toQuicFrame(decodeUniStreamsBlockedFrame(cursor), frameTypeValue);
+    case FrameType::NEW_CONNECTION_ID:
+      return toQuicFrame(decodeNewConnectionIdFrame(cursor), frameTypeValue);
+    case FrameType::RETIRE_CONNECTION_ID:
+      return toQuicFrame(decodeRetireConnectionIdFrame(cursor), frameTypeValue);
+    case FrameType::PATH_CHALLENGE:
+      return toQuicFrame(decodePathChallengeFrame(cursor), frameTypeValue);
+    case FrameType::PATH_RESPONSE:
+      return toQuicFrame(decodePathResponseFrame(cursor), frameTypeValue);
+    case FrameType::CONNECTION_CLOSE:
+      return toQuicFrame(
+          decodeConnectionCloseFrame(cursor, params), frameTypeValue);
+    case FrameType::APPLICATION_CLOSE:
+      return toQuicFrame(
+          decodeApplicationCloseFrame(cursor, params), frameTypeValue);
+    case FrameType::DATAGRAM:
+      return toQuicFrame(
+          decodeDatagramFrame(cursor, false /* hasLen */), frameTypeValue);
+    case FrameType::DATAGRAM_LEN:
+      return toQuicFrame(
+          decodeDatagramFrame(cursor, true /* hasLen */), frameTypeValue);
+    case FrameType::ACK_FREQUENCY:
+      return toQuicFrame(decodeAckFrequencyFrame(cursor), frameTypeValue);
+    case FrameType::FEC_REPAIR:
+      return toQuicFrame(decodeFecRepairFrame(cursor), frameTypeValue);
+    case FrameType::MIN_STREAM_DATA:
+      return toQuicFrame(decodeMinStreamDataFrame(cursor), frameTypeValue);
+    case FrameType::EXPIRED_STREAM_DATA:
+      return toQuicFrame(decodeExpiredStreamDataFrame(cursor), frameTypeValue);
+  }
+  auto streamFieldType = StreamTypeField::tryStream(initialByte->first);
+  if (streamFieldType) {
+    return toQuicFrame(
+        decodeStreamFrame(cursor, *streamFieldType), frameTypeValue);
+  }
+  return folly::makeUnexpected(QuicTransportError(
       folly::to<std::string>(
-          "Unknown frame, type=", toHex<uint8_t>(initialByte->first)),
+          "Unknown frame, type=", toHex<uint8_t>(frameTypeValue)),
       TransportErrorCode::FRAME_ENCODING_ERROR,
-      frameType);
+      frameType));
 }
 
 // Parse packet
 
-static std::vector<QuicFrame> framesDecodeHelper(
-    folly::io::Cursor& cursor,
-    const PacketHeader& header,
-    const CodecParameters& params) {
-  std::vector<QuicFrame> frames;
+DecodeResult<RegularQuicPacket> decodeRegularPacket(
+    PacketHeader&& header,
+    const CodecParameters& params,
+    folly::io::Cursor& cursor) {
+  RegularQuicPacket packet(std::move(header));
   while (cursor.totalLength()) {
-    auto frame = parseFrame(cursor, header, params);
-    frames.push_back(std::move(frame));
+    auto frame = parseFrame(cursor, packet.header, params);
+    if (UNLIKELY(frame.hasError())) {
+      return folly::makeUnexpected(std::move(frame.error()));
+    }
+    packet.frames.push_back(std::move(frame.value()));
   }
-  return frames;
+  return packet;
 }
 
-RegularQuicPacket decodeRegularPacket(
-    PacketHeader&& header,
+DecodeResult<RegularQuicPacket> decodeShortHeaderPacket(
+    ShortHeader&& header,
     const CodecParameters& params,
     folly::io::Cursor& cursor) {
   RegularQuicPacket packet(std::move(header));
-  packet.frames = framesDecodeHelper(cursor, header, params);
+  while (cursor.totalLength()) {
+    auto bytes = cursor.peekBytes();
+    folly::Optional<StreamTypeField> streamFieldType;
+    bool isAck = false;
+    uint8_t frameTypeByte = 0;
+    if (LIKELY(!bytes.empty())) {
+      // All the frame types handled inline are encoded in a single byte.
+      frameTypeByte = bytes[0];
+      streamFieldType = StreamTypeField::tryStream(frameTypeByte);
+      isAck = frameTypeByte == static_cast<uint8_t>(FrameType::ACK);
+    }
+    if (!bytes.empty() &&
+        frameTypeByte == static_cast<uint8_t>(FrameType::PADDING)) {
+      // A run of padding is reported as a single frame.
+      size_t paddingLength = 1;
+      while (paddingLength < bytes.size() && bytes[paddingLength] == 0) {
+        paddingLength++;
+      }
+      cursor.skip(paddingLength);
+      if (packet.frames.empty() ||
+          !boost::get<PaddingFrame>(&packet.frames.back())) {
+        packet.frames.push_back(PaddingFrame());
+      }
+      continue;
+    }
+    if (!streamFieldType && !isAck) {
+      auto frame = parseFrame(cursor, packet.header, params);
+      if (UNLIKELY(frame.hasError())) {
+        return folly::makeUnexpected(std::move(frame.error()));
+      }
+      packet.frames.push_back(std::move(frame.value()));
+      continue;
+    }
+    cursor.skip(sizeof(frameTypeByte));
+    bool decoded = false;
+    if (isAck) {
+      auto ackFrame = decodeAckFrame(cursor, packet.header, params);
+      if (LIKELY(ackFrame.hasValue())) {
+        packet.frames.push_back(std::move(ackFrame.value()));
+        decoded = true;
+      }
+    } else {
+      auto streamFrame = decodeStreamFrame(cursor, *streamFieldType);
+      if (LIKELY(streamFrame.hasValue())) {
+        packet.frames.push_back(std::move(streamFrame.value()));
+        decoded = true;
+      }
+    }
+    if (UNLIKELY(!decoded)) {
+      return folly::makeUnexpected(QuicTransportError(
+          folly::to<std::string>(
+              "Frame format invalid, type=", toHex<uint8_t>(frameTypeByte)),
+          TransportErrorCode::FRAME_ENCODING_ERROR,
+          isAck ? FrameType::ACK : FrameType::STREAM));
+    }
+  }
   return packet;
 }
 
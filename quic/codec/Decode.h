@@ -8,12 +8,22 @@
 
 #pragma once
 
+#include <folly/Expected.h>
 #include <folly/io/Cursor.h>
+#include <quic/QuicException.h>
 #include <quic/codec/PacketNumber.h>
 #include <quic/codec/Types.h>
 
 namespace quic {
 
+/**
+ * Result of decoding a frame or a packet. Malformed input comes from the
+ * network, so it is reported as a value rather than thrown on the packet
+ * processing path.
+ */
+template <class T>
+using DecodeResult = folly::Expected<T, QuicTransportError>;
+
 /**
  * Connection level parameters needed by the codec to decode the packet
  * successfully.
@@ -51,92 +61,129 @@ folly::Optional<VersionNegotiationPacket> decodeVersionNegotiation(
 /**
  * Decodes a single regular QUIC packet from the cursor.
  * The packet in the cursor must be at least 1 QUIC packet.
- * Throws with a QuicException if the data in the cursor is not a complete QUIC
- * packet or the packet could not be decoded correctly.
+ * Returns an error if the data in the cursor is not a complete QUIC packet or
+ * the packet could not be decoded correctly.
  */
-RegularQuicPacket decodeRegularPacket(
+DecodeResult<RegularQuicPacket> decodeRegularPacket(
     PacketHeader&& header,
     const CodecParameters& params,
     folly::io::Cursor& cursor);
 
 /**
- * Parses a single frame from the cursor. Throws a QuicException if the frame
- * could not be parsed.
+ * Same as decodeRegularPacket for 1-RTT packets. STREAM, ACK and PADDING
+ * frames, which make up most of the traffic, are decoded inline without
+ * going through parseFrame. A run of PADDING frames is reported as a single
+ * PaddingFrame.
+ */
+DecodeResult<RegularQuicPacket> decodeShortHeaderPacket(
+    ShortHeader&& header,
+    const CodecParameters& params,
+    folly::io::Cursor& cursor);
+
+/**
+ * Parses a single frame from the cursor. Returns an error if the frame could
+ * not be parsed.
  */
-QuicFrame parseFrame(
+DecodeResult<QuicFrame> parseFrame(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
     const CodecParameters& params);
 
 /**
- * The following functions decode frames. They throw an QuicException when error
- * occurs.
+ * The following functions decode frames. They return an error, with the type
+ * of the frame that failed, when the frame is malformed.
  */
 PaddingFrame decodePaddingFrame(folly::io::Cursor&);
 
-RstStreamFrame decodeRstStreamFrame(
+DecodeResult<RstStreamFrame> decodeRstStreamFrame(
     folly::io::Cursor& cursor,
     const CodecParameters& params);
 
-ConnectionCloseFrame decodeConnectionCloseFrame(
+DecodeResult<ConnectionCloseFrame> decodeConnectionCloseFrame(
     folly::io::Cursor& cursor,
     const CodecParameters& params);
 
-ApplicationCloseFrame decodeApplicationCloseFrame(
+DecodeResult<ApplicationCloseFrame> decodeApplicationCloseFrame(
     folly::io::Cursor& cursor,
     const CodecParameters& params);
 
-MaxDataFrame decodeMaxDataFrame(folly::io::Cursor& cursor);
+DecodeResult<MaxDataFrame> decodeMaxDataFrame(folly::io::Cursor& cursor);
 
-MaxStreamDataFrame decodeMaxStreamDataFrame(folly::io::Cursor& cursor);
+DecodeResult<MaxStreamDataFrame> decodeMaxStreamDataFrame(
+    folly::io::Cursor& cursor);
 
-ExpiredStreamDataFrame decodeExpiredStreamDataFrame(folly::io::Cursor& cursor);
+DecodeResult<ExpiredStreamDataFrame> decodeExpiredStreamDataFrame(
+    folly::io::Cursor& cursor);
 
-MinStreamDataFrame decodeMinStreamDataFrame(folly::io::Cursor& cursor);
+DecodeResult<MinStreamDataFrame> decodeMinStreamDataFrame(
+    folly::io::Cursor& cursor);
 
-MaxStreamsFrame decodeBiDiMaxStreamsFrame(folly::io::Cursor& cursor);
+DecodeResult<MaxStreamsFrame> decodeBiDiMaxStreamsFrame(
+    folly::io::Cursor& cursor);
 
-MaxStreamsFrame decodeUniMaxStreamsFrame(folly::io::Cursor& cursor);
+DecodeResult<MaxStreamsFrame> decodeUniMaxStreamsFrame(
+    folly::io::Cursor& cursor);
 
 PingFrame decodePingFrame(folly::io::Cursor& cursor);
 
-DataBlockedFrame decodeDataBlockedFrame(folly::io::Cursor& cursor);
+DecodeResult<DataBlockedFrame> decodeDataBlockedFrame(
+    folly::io::Cursor& cursor);
 
-StreamDataBlockedFrame decodeStreamDataBlockedFrame(folly::io::Cursor& cursor);
+DecodeResult<StreamDataBlockedFrame> decodeStreamDataBlockedFrame(
+    folly::io::Cursor& cursor);
 
-StreamsBlockedFrame decodeBiDiStreamsBlockedFrame(folly::io::Cursor& cursor);
+DecodeResult<StreamsBlockedFrame> decodeBiDiStreamsBlockedFrame(
+    folly::io::Cursor& cursor);
 
-StreamsBlockedFrame decodeUniStreamsBlockedFrame(folly::io::Cursor& cursor);
+DecodeResult<StreamsBlockedFrame> decodeUniStreamsBlockedFrame(
+    folly::io::Cursor& cursor);
 
-NewConnectionIdFrame decodeNewConnectionIdFrame(folly::io::Cursor& cursor);
+DecodeResult<NewConnectionIdFrame> decodeNewConnectionIdFrame(
+    folly::io::Cursor& cursor);
 
-NoopFrame decodeRetireConnectionIdFrame(folly::io::Cursor& cursor);
+DecodeResult<RetireConnectionIdFrame> decodeRetireConnectionIdFrame(
+    folly::io::Cursor& cursor);
 
-StopSendingFrame decodeStopSendingFrame(
+DecodeResult<StopSendingFrame> decodeStopSendingFrame(
     folly::io::Cursor& cursor,
     const CodecParameters& params);
 
-PathChallengeFrame decodePathChallengeFrame(folly::io::Cursor& cursor);
+DecodeResult<PathChallengeFrame> decodePathChallengeFrame(
+    folly::io::Cursor& cursor);
 
-PathResponseFrame decodePathResponseFrame(folly::io::Cursor& cursor);
+DecodeResult<PathResponseFrame> decodePathResponseFrame(
+    folly::io::Cursor& cursor);
 
-ReadAckFrame decodeAckFrame(
+DecodeResult<ReadAckFrame> decodeAckFrame(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
     const CodecParameters& params);
 
-ReadAckFrame decodeAckFrameWithECN(
+DecodeResult<ReadAckFrame> decodeAckFrameWithECN(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
     const CodecParameters& params);
 
-ReadStreamFrame decodeStreamFrame(
+DecodeResult<ReadStreamFrame> decodeStreamFrame(
     folly::io::Cursor& cursor,
     StreamTypeField frameTypeField);
 
-ReadCryptoFrame decodeCryptoFrame(folly::io::Cursor& cursor);
+DecodeResult<ReadCryptoFrame> decodeCryptoFrame(folly::io::Cursor& cursor);
 
-ReadNewTokenFrame decodeNewTokenFrame(folly::io::Cursor& cursor);
+DecodeResult<ReadNewTokenFrame> decodeNewTokenFrame(folly::io::Cursor& cursor);
+
+DecodeResult<AckFrequencyFrame> decodeAckFrequencyFrame(
+    folly::io::Cursor& cursor);
+
+DecodeResult<FecRepairFrame> decodeFecRepairFrame(folly::io::Cursor& cursor);
+
+/**
+ * Decode a DATAGRAM frame. Without a length field the datagram extends to the
+ * end of the packet.
+ */
+DecodeResult<DatagramFrame> decodeDatagramFrame(
+    folly::io::Cursor& cursor,
+    bool hasLen);
 
 /**
  * Parse the Invariant fields in Long Header.
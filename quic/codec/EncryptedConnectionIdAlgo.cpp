@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/codec/EncryptedConnectionIdAlgo.h>
+
+#include <folly/Random.h>
+#include <glog/logging.h>
+#include <quic/QuicException.h>
+
+#include <openssl/evp.h>
+
+#include <cstring>
+
+namespace {
+
+constexpr size_t kAesBlockSize = 16;
+constexpr uint8_t kFeistelRounds = 4;
+constexpr uint8_t kConfigIdBitsMask = 0xc0;
+constexpr uint8_t kRandomBitsMask = 0x3f;
+// Offsets in the routing block.
+constexpr size_t kHostIdOffset = 0;
+constexpr size_t kWorkerIdOffset = 2;
+constexpr size_t kProcessIdOffset = 3;
+constexpr uint8_t kProcessIdBitMask = 0x80;
+
+} // namespace
+
+namespace quic {
+
+EncryptedConnectionIdDecoder::EncryptedConnectionIdDecoder(
+    const EncryptedConnectionIdKey& key,
+    uint8_t configId,
+    size_t connIdSize)
+    : configId_(configId), connIdSize_(connIdSize) {
+  if (configId_ > kMaxEncryptedConnectionIdConfigId) {
+    throw QuicInternalException(
+        "Invalid connection id config id", LocalErrorCode::INTERNAL_ERROR);
+  }
+  if (connIdSize_ < kMinEncryptedConnectionIdSize ||
+      connIdSize_ > kMaxConnectionIdSize) {
+    throw QuicInternalException(
+        "Invalid encrypted connection id size",
+        LocalErrorCode::INTERNAL_ERROR);
+  }
+  ctx_.reset(EVP_CIPHER_CTX_new());
+  if (ctx_ == nullptr) {
+    throw std::runtime_error("Unable to allocate an EVP_CIPHER_CTX object");
+  }
+  if (EVP_EncryptInit_ex(
+          ctx_.get(), EVP_aes_128_ecb(), nullptr, key.data(), nullptr) != 1) {
+    throw std::runtime_error("Init error");
+  }
+}
+
+folly::Optional<uint8_t> EncryptedConnectionIdDecoder::getConfigId(
+    const ConnectionId& id) {
+  if (id.size() == 0) {
+    return folly::none;
+  }
+  return (id.data()[0] & kConfigIdBitsMask) >> 6;
+}
+
+bool EncryptedConnectionIdDecoder::canDecode(const ConnectionId& id) const {
+  return id.size() == connIdSize_ && getConfigId(id) == configId_;
+}
+
+void EncryptedConnectionIdDecoder::feistelRound(
+    uint8_t round,
+    folly::ByteRange input,
+    folly::MutableByteRange output) const {
+  // AES of the round number, the input length and the input, xored into the
+  // output. Both halves are shorter than kAesBlockSize - 2.
+  std::array<uint8_t, kAesBlockSize> in{};
+  std::array<uint8_t, kAesBlockSize> out;
+  in[0] = round;
+  in[1] = input.size();
+  memcpy(in.data() + 2, input.data(), input.size());
+  int outLen = 0;
+  if (EVP_EncryptUpdate(
+          ctx_.get(), out.data(), &outLen, in.data(), in.size()) != 1 ||
+      outLen != out.size()) {
+    throw std::runtime_error("Encryption error");
+  }
+  for (size_t i = 0; i < output.size(); i++) {
+    output[i] ^= out[i];
+  }
+}
+
+void EncryptedConnectionIdDecoder::encryptBlock(
+    folly::MutableByteRange block) const {
+  CHECK_EQ(block.size(), connIdSize_ - 1);
+  auto right = block.subpiece(block.size() - block.size() / 2);
+  auto left = block.subpiece(0, block.size() - right.size());
+  for (uint8_t round = 0; round < kFeistelRounds; round++) {
+    if (round % 2 == 0) {
+      feistelRound(round, left, right);
+    } else {
+      feistelRound(round, right, left);
+    }
+  }
+}
+
+folly::Optional<ServerConnectionIdParams> EncryptedConnectionIdDecoder::decode(
+    const ConnectionId& id) const {
+  if (!canDecode(id)) {
+    return folly::none;
+  }
+  std::array<uint8_t, kMaxConnectionIdSize> block;
+  folly::MutableByteRange blockRange(block.data(), id.size() - 1);
+  memcpy(blockRange.data(), id.data() + 1, blockRange.size());
+  // The rounds in reverse order undo the encryption.
+  auto right = blockRange.subpiece(blockRange.size() - blockRange.size() / 2);
+  auto left = blockRange.subpiece(0, blockRange.size() - right.size());
+  for (uint8_t round = kFeistelRounds; round-- > 0;) {
+    if (round % 2 == 0) {
+      feistelRound(round, left, right);
+    } else {
+      feistelRound(round, right, left);
+    }
+  }
+  uint16_t hostId = (block[kHostIdOffset] << 8) | block[kHostIdOffset + 1];
+  ServerConnectionIdParams params(
+      hostId,
+      (block[kProcessIdOffset] & kProcessIdBitMask) ? 1 : 0,
+      block[kWorkerIdOffset]);
+  params.clientConnId.assign(id);
+  return params;
+}
+
+EncryptedConnectionIdAlgo::EncryptedConnectionIdAlgo(
+    const EncryptedConnectionIdKey& key,
+    uint8_t configId,
+    size_t connIdSize)
+    : decoder_(key, configId, connIdSize) {}
+
+bool EncryptedConnectionIdAlgo::canParse(const ConnectionId& id) const {
+  return decoder_.canDecode(id);
+}
+
+ServerConnectionIdParams EncryptedConnectionIdAlgo::parseConnectionId(
+    const ConnectionId& id) {
+  auto params = decoder_.decode(id);
+  if (!params) {
+    throw QuicInternalException(
+        "Connection id can't be decoded", LocalErrorCode::INTERNAL_ERROR);
+  }
+  return std::move(*params);
+}
+
+ConnectionId EncryptedConnectionIdAlgo::encodeConnectionId(
+    const ServerConnectionIdParams& params) {
+  std::vector<uint8_t> connIdData(decoder_.getConnectionIdSize());
+  folly::Random::secureRandom(connIdData.data(), connIdData.size());
+  connIdData[0] =
+      (decoder_.getConfigId() << 6) | (connIdData[0] & kRandomBitsMask);
+  folly::MutableByteRange block(connIdData.data() + 1, connIdData.size() - 1);
+  block[kHostIdOffset] = params.hostId >> 8;
+  block[kHostIdOffset + 1] = params.hostId & 0xff;
+  block[kWorkerIdOffset] = params.workerId;
+  block[kProcessIdOffset] &= ~kProcessIdBitMask;
+  if (params.processId) {
+    block[kProcessIdOffset] |= kProcessIdBitMask;
+  }
+  decoder_.encryptBlock(block);
+  return ConnectionId(std::move(connIdData));
+}
+
+} // namespace quic
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/ssl/OpenSSLPtrTypes.h>
+#include <quic/QuicConstants.h>
+#include <quic/codec/ConnectionIdAlgo.h>
+#include <quic/codec/QuicConnectionId.h>
+
+#include <array>
+
+namespace quic {
+
+constexpr size_t kEncryptedConnectionIdKeyLength = 16;
+// The first octet, 25 bits of routing fields and 31 random bits.
+constexpr size_t kMinEncryptedConnectionIdSize = 8;
+// The config id 3 is reserved for connection ids no load balancer can route,
+// as in QUIC-LB.
+constexpr uint8_t kMaxEncryptedConnectionIdConfigId = 2;
+
+using EncryptedConnectionIdKey =
+    std::array<uint8_t, kEncryptedConnectionIdKeyLength>;
+
+/**
+ * Stateless decoder of the connection ids of EncryptedConnectionIdAlgo, for
+ * the servers and for an L4 load balancer sharing the key.
+ *
+ * Following the block cipher connection ids of QUIC-LB, the schema is:
+ *
+ *   0     1      2 ... 7   8 ...
+ *  | CONFIG ID  | RANDOM  | E(routing block) |
+ *
+ * The first octet is in the clear: 2 bits of config id, so that the load
+ * balancer can tell which key encrypted the rest during a key rotation, and
+ * 6 random bits. The routing block is the rest of the connection id and holds
+ * the host id in 16 bits, the worker id in 8 bits, the process id in 1 bit,
+ * and random bits after that. The block is encrypted with a 4 round Feistel
+ * network whose round function is AES-128, which works for blocks shorter
+ * than an AES block.
+ *
+ * Routing costs 4 AES block encryptions, and observers can neither link the
+ * connection ids of a connection nor tell which host they go to. The routing
+ * fields don't shrink as the connection ids get longer, so the length can grow
+ * past kDefaultConnectionIdSize once the short header parsing supports it.
+ *
+ * Not thread safe, each thread needs its own.
+ */
+class EncryptedConnectionIdDecoder {
+ public:
+  /**
+   * Throws QuicInternalException if configId is above
+   * kMaxEncryptedConnectionIdConfigId or connIdSize is not between
+   * kMinEncryptedConnectionIdSize and kMaxConnectionIdSize.
+   */
+  EncryptedConnectionIdDecoder(
+      const EncryptedConnectionIdKey& key,
+      uint8_t configId,
+      size_t connIdSize = kDefaultConnectionIdSize);
+
+  // The config id in the first octet of id, none if id is empty.
+  static folly::Optional<uint8_t> getConfigId(const ConnectionId& id);
+
+  // Whether id has the length and config id of this decoder.
+  bool canDecode(const ConnectionId& id) const;
+
+  // The routing fields of id, none if it can't be decoded.
+  folly::Optional<ServerConnectionIdParams> decode(
+      const ConnectionId& id) const;
+
+  // Encrypts the routing block in place, used by EncryptedConnectionIdAlgo.
+  void encryptBlock(folly::MutableByteRange block) const;
+
+  uint8_t getConfigId() const {
+    return configId_;
+  }
+
+  size_t getConnectionIdSize() const {
+    return connIdSize_;
+  }
+
+ private:
+  void feistelRound(
+      uint8_t round,
+      folly::ByteRange input,
+      folly::MutableByteRange output) const;
+
+  uint8_t configId_;
+  size_t connIdSize_;
+  folly::ssl::EvpCipherCtxUniquePtr ctx_;
+};
+
+/**
+ * ConnectionIdAlgo encrypting the routing fields of the connection ids, see
+ * EncryptedConnectionIdDecoder for the schema. The load balancer and the
+ * servers of a pool must share the key, config id and length.
+ */
+class EncryptedConnectionIdAlgo : public ConnectionIdAlgo {
+ public:
+  EncryptedConnectionIdAlgo(
+      const EncryptedConnectionIdKey& key,
+      uint8_t configId,
+      size_t connIdSize = kDefaultConnectionIdSize);
+
+  ~EncryptedConnectionIdAlgo() override = default;
+
+  bool canParse(const ConnectionId& id) const override;
+
+  /**
+   * Parses ServerConnectionIdParams from the given connection id. Throws
+   * QuicInternalException if canParse() is false.
+   */
+  ServerConnectionIdParams parseConnectionId(const ConnectionId& id) override;
+
+  ConnectionId encodeConnectionId(
+      const ServerConnectionIdParams& params) override;
+
+ private:
+  EncryptedConnectionIdDecoder decoder_;
+};
+
+class EncryptedConnectionIdAlgoFactory : public ConnectionIdAlgoFactory {
+ public:
+  EncryptedConnectionIdAlgoFactory(
+      const EncryptedConnectionIdKey& key,
+      uint8_t configId,
+      size_t connIdSize = kDefaultConnectionIdSize)
+      : key_(key), configId_(configId), connIdSize_(connIdSize) {}
+
+  ~EncryptedConnectionIdAlgoFactory() override = default;
+
+  std::unique_ptr<ConnectionIdAlgo> make() override {
+    return std::make_unique<EncryptedConnectionIdAlgo>(
+        key_, configId_, connIdSize_);
+  }
+
+ private:
+  EncryptedConnectionIdKey key_;
+  uint8_t configId_;
+  size_t connIdSize_;
+};
+
+} // namespace quic
@@ -8,6 +8,8 @@
 
 #include <quic/codec/PacketNumber.h>
 
+#include <algorithm>
+
 namespace quic {
 
 PacketNumEncodingResult::PacketNumEncodingResult(
@@ -18,6 +20,13 @@ PacketNumEncodingResult::PacketNumEncodingResult(
 PacketNumEncodingResult encodePacketNumber(
     PacketNum packetNum,
     PacketNum largestAckedPacketNum) {
+  return truncatePacketNumber(
+      packetNum, packetNumberLength(packetNum, largestAckedPacketNum));
+}
+
+size_t packetNumberLength(
+    PacketNum packetNum,
+    PacketNum largestAckedPacketNum) {
   DCHECK(
       (!packetNum && !largestAckedPacketNum) ||
       packetNum > largestAckedPacketNum);
@@ -36,6 +45,14 @@ PacketNumEncodingResult encodePacketNumber(
             largestAckedPacketNum),
         LocalErrorCode::PACKET_NUMBER_ENCODING);
   }
+  return lengthInBytes;
+}
+
+PacketNumEncodingResult truncatePacketNumber(
+    PacketNum packetNum,
+    size_t lengthInBytes) {
+  DCHECK_GE(lengthInBytes, 1);
+  DCHECK_LE(lengthInBytes, sizeof(uint32_t));
   // We need a mask that's all 1 for lengthInBytes bytes. Left shift a 1 by that
   // many bits and then -1 will give us that. Or if lengthInBytes is 8, then ~0
   // will just do it.
@@ -67,4 +84,30 @@ PacketNum decodePacketNumber(
   return candidate;
 }
 
+PacketNumberDecoder::PacketNumberDecoder(PacketNum expectedNextPacketNum) {
+  for (size_t i = 0; i < windows_.size(); ++i) {
+    auto& window = windows_[i];
+    window.size = 1ULL << (8 * (i + 1));
+    PacketNum halfWindow = window.size >> 1;
+    window.base = expectedNextPacketNum & ~(window.size - 1);
+    // The same bounds as decodePacketNumber checks.
+    window.addBelow = expectedNextPacketNum > halfWindow
+        ? expectedNextPacketNum - halfWindow + 1
+        : 0;
+    window.subtractAbove =
+        std::max(expectedNextPacketNum + halfWindow, window.size);
+  }
+}
+
+void decodePacketNumbers(
+    folly::Range<const PacketNumEncodingResult*> encoded,
+    PacketNum expectedNextPacketNum,
+    folly::Range<PacketNum*> decoded) {
+  DCHECK_EQ(encoded.size(), decoded.size());
+  PacketNumberDecoder decoder(expectedNextPacketNum);
+  for (size_t i = 0; i < encoded.size(); ++i) {
+    decoded[i] = decoder.decode(encoded[i].result, encoded[i].length);
+  }
+}
+
 } // namespace quic
@@ -8,8 +8,11 @@
 
 #pragma once
 
+#include <folly/Range.h>
 #include <quic/codec/Types.h>
 
+#include <array>
+
 namespace quic {
 
 /**
@@ -33,4 +36,71 @@ PacketNumEncodingResult encodePacketNumber(
     PacketNum packetNum,
     PacketNum largestAckedPacketNum);
 
+/**
+ * Returns the number of bytes packetNum is encoded in, given the largest
+ * packet number the peer acked. Throws if it takes more than 4 bytes.
+ *
+ * The length that fits the last packet of a burst fits every earlier one as
+ * well, so a burst only needs to work it out once and then encode each of
+ * its packets with truncatePacketNumber.
+ */
+size_t packetNumberLength(
+    PacketNum packetNum,
+    PacketNum largestAckedPacketNum);
+
+/**
+ * Encodes packetNum in packetNumBytes bytes, which must be between 1 and 4.
+ */
+PacketNumEncodingResult truncatePacketNumber(
+    PacketNum packetNum,
+    size_t packetNumBytes);
+
+/**
+ * Decodes the packet numbers of packets that are decoded against the same
+ * expected next packet number, like the packets of one connection read in
+ * a batch. The window of each packet number length is worked out once, so
+ * decoding a packet number is a lookup and two comparisons.
+ */
+class PacketNumberDecoder {
+ public:
+  explicit PacketNumberDecoder(PacketNum expectedNextPacketNum);
+
+  // Same as decodePacketNumber with the expected next packet number.
+  PacketNum decode(uint64_t encodedPacketNum, size_t packetNumBytes) const {
+    DCHECK_GE(packetNumBytes, 1);
+    DCHECK_LE(packetNumBytes, windows_.size());
+    const auto& window = windows_[packetNumBytes - 1];
+    PacketNum candidate = window.base | encodedPacketNum;
+    if (candidate < window.addBelow) {
+      return candidate + window.size;
+    }
+    if (candidate > window.subtractAbove) {
+      return candidate - window.size;
+    }
+    return candidate;
+  }
+
+ private:
+  struct Window {
+    // The expected packet number with the encoded bits cleared.
+    PacketNum base{0};
+    PacketNum size{0};
+    // Candidates below this are a window ahead, 0 if none are.
+    PacketNum addBelow{0};
+    // Candidates above this are a window behind.
+    PacketNum subtractAbove{0};
+  };
+
+  std::array<Window, sizeof(uint32_t)> windows_;
+};
+
+/**
+ * Decodes each of encoded into decoded, which must be as long, against the
+ * same expected next packet number.
+ */
+void decodePacketNumbers(
+    folly::Range<const PacketNumEncodingResult*> encoded,
+    PacketNum expectedNextPacketNum,
+    folly::Range<PacketNum*> decoded);
+
 } // namespace quic
@@ -38,7 +38,14 @@ void PacketNumberCipher::cipherHeader(
     folly::MutableByteRange packetNumberBytes,
     uint8_t initialByteMask,
     uint8_t /* packetNumLengthMask */) const {
-  HeaderProtectionMask headerMask = mask(sample);
+  applyMask(mask(sample), initialByte, packetNumberBytes, initialByteMask);
+}
+
+void PacketNumberCipher::applyMask(
+    const HeaderProtectionMask& headerMask,
+    folly::MutableByteRange initialByte,
+    folly::MutableByteRange packetNumberBytes,
+    uint8_t initialByteMask) {
   // Mask size should be > packet number length + 1.
   DCHECK_GE(headerMask.size(), kMaxPacketNumEncodingSize + 1);
   size_t packetNumLength = parsePacketNumberLength(*initialByte.data());
@@ -48,6 +55,15 @@ void PacketNumberCipher::cipherHeader(
   }
 }
 
+void PacketNumberCipher::masks(
+    folly::Range<const Sample*> samples,
+    folly::Range<HeaderProtectionMask*> outMasks) const {
+  CHECK_EQ(samples.size(), outMasks.size());
+  for (size_t i = 0; i < samples.size(); ++i) {
+    outMasks[i] = mask(folly::range(samples[i]));
+  }
+}
+
 void PacketNumberCipher::decryptLongHeader(
     folly::ByteRange sample,
     folly::MutableByteRange initialByte,
@@ -96,6 +112,22 @@ void PacketNumberCipher::encryptShortHeader(
       ShortHeader::kPacketNumLenMask);
 }
 
+void PacketNumberCipher::encryptLongHeaderWithMask(
+    const HeaderProtectionMask& headerMask,
+    folly::MutableByteRange initialByte,
+    folly::MutableByteRange packetNumberBytes) const {
+  applyMask(
+      headerMask, initialByte, packetNumberBytes, LongHeader::kTypeBitsMask);
+}
+
+void PacketNumberCipher::encryptShortHeaderWithMask(
+    const HeaderProtectionMask& headerMask,
+    folly::MutableByteRange initialByte,
+    folly::MutableByteRange packetNumberBytes) const {
+  applyMask(
+      headerMask, initialByte, packetNumberBytes, ShortHeader::kTypeBitsMask);
+}
+
 void Aes128PacketNumberCipher::setKey(folly::ByteRange key) {
   encryptCtx_.reset(EVP_CIPHER_CTX_new());
   if (encryptCtx_ == nullptr) {
@@ -125,6 +157,28 @@ HeaderProtectionMask Aes128PacketNumberCipher::mask(
   return outMask;
 }
 
+void Aes128PacketNumberCipher::masks(
+    folly::Range<const Sample*> samples,
+    folly::Range<HeaderProtectionMask*> outMasks) const {
+  static_assert(
+      sizeof(Sample) == sizeof(HeaderProtectionMask), "block size mismatch");
+  CHECK_EQ(samples.size(), outMasks.size());
+  if (samples.empty()) {
+    return;
+  }
+  int inLen = static_cast<int>(samples.size() * sizeof(Sample));
+  int outLen = 0;
+  if (EVP_EncryptUpdate(
+          encryptCtx_.get(),
+          outMasks.begin()->data(),
+          &outLen,
+          samples.begin()->data(),
+          inLen) != 1 ||
+      outLen != inLen) {
+    throw std::runtime_error("Encryption error");
+  }
+}
+
 size_t Aes128PacketNumberCipher::keyLength() const {
   return kAES128KeyLength;
 }
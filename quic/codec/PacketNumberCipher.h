@@ -25,6 +25,15 @@ class PacketNumberCipher {
 
   virtual HeaderProtectionMask mask(folly::ByteRange sample) const = 0;
 
+  /**
+   * Computes the masks of a batch of samples, outMasks must be as large as
+   * samples. The default calls mask() for each sample, ciphers that can
+   * pipeline several blocks should override this.
+   */
+  virtual void masks(
+      folly::Range<const Sample*> samples,
+      folly::Range<HeaderProtectionMask*> outMasks) const;
+
   /**
    * Decrypts a long header from a sample.
    * sample should be 16 bytes long.
@@ -67,6 +76,20 @@ class PacketNumberCipher {
       folly::MutableByteRange initialByte,
       folly::MutableByteRange packetNumberBytes) const;
 
+  /**
+   * Same as encryptLongHeader and encryptShortHeader, with a mask that was
+   * already computed from the sample, e.g. by masks().
+   */
+  void encryptLongHeaderWithMask(
+      const HeaderProtectionMask& headerMask,
+      folly::MutableByteRange initialByte,
+      folly::MutableByteRange packetNumberBytes) const;
+
+  void encryptShortHeaderWithMask(
+      const HeaderProtectionMask& headerMask,
+      folly::MutableByteRange initialByte,
+      folly::MutableByteRange packetNumberBytes) const;
+
   /**
    * Returns the length of key needed for the pn cipher.
    */
@@ -86,6 +109,13 @@ class PacketNumberCipher {
       folly::MutableByteRange packetNumberBytes,
       uint8_t initialByteMask,
       uint8_t packetNumLengthMask) const;
+
+ private:
+  static void applyMask(
+      const HeaderProtectionMask& headerMask,
+      folly::MutableByteRange initialByte,
+      folly::MutableByteRange packetNumberBytes,
+      uint8_t initialByteMask);
 };
 
 class Aes128PacketNumberCipher : public PacketNumberCipher {
@@ -96,6 +126,12 @@ class Aes128PacketNumberCipher : public PacketNumberCipher {
 
   HeaderProtectionMask mask(folly::ByteRange sample) const override;
 
+  // AES-ECB has no chaining, so all the samples go through a single
+  // EVP_EncryptUpdate call which lets AES-NI pipeline the blocks.
+  void masks(
+      folly::Range<const Sample*> samples,
+      folly::Range<HeaderProtectionMask*> outMasks) const override;
+
   size_t keyLength() const override;
 
  private:
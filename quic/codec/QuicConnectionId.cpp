@@ -10,6 +10,8 @@
 #include <glog/logging.h>
 #include <quic/QuicConstants.h>
 
+#include <algorithm>
+
 namespace quic {
 
 uint8_t* ConnectionId::data() {
@@ -21,25 +23,26 @@ const uint8_t* ConnectionId::data() const {
 }
 
 uint8_t ConnectionId::size() const {
-  return static_cast<uint8_t>(connid.size());
+  return connidLen;
 }
 
 std::string ConnectionId::hex() const {
-  return folly::hexlify(connid);
+  return folly::hexlify(folly::ByteRange(connid.data(), connidLen));
 }
 
-ConnectionId::ConnectionId(const std::vector<uint8_t>& connidIn)
-    : connid(connidIn) {
+ConnectionId::ConnectionId(const std::vector<uint8_t>& connidIn) {
   static_assert(
       std::numeric_limits<uint8_t>::max() > kMaxConnectionIdSize,
       "Max connection size is too big");
-  if (connid.size() != 0 &&
-      (connid.size() < kMinConnectionIdSize ||
-       connid.size() > kMaxConnectionIdSize)) {
+  if (connidIn.size() != 0 &&
+      (connidIn.size() < kMinConnectionIdSize ||
+       connidIn.size() > kMaxConnectionIdSize)) {
     // We can't throw a transport error here because of the dependency. This is
     // sad because this will cause an internal error downstream.
     throw std::runtime_error("ConnectionId invalid size");
   }
+  connidLen = static_cast<uint8_t>(connidIn.size());
+  std::copy(connidIn.begin(), connidIn.end(), connid.begin());
 }
 
 ConnectionId::ConnectionId(folly::io::Cursor& cursor, size_t len) {
@@ -52,19 +55,33 @@ ConnectionId::ConnectionId(folly::io::Cursor& cursor, size_t len) {
     // sad because this will cause an internal error downstream.
     throw std::runtime_error("ConnectionId invalid size");
   }
-  connid.resize(len);
+  connidLen = static_cast<uint8_t>(len);
   cursor.pull(connid.data(), len);
 }
 
+ConnectionId::ConnectionId(const ConnectionIdView& view) {
+  if (view.size() != 0 &&
+      (view.size() < kMinConnectionIdSize ||
+       view.size() > kMaxConnectionIdSize)) {
+    throw std::runtime_error("ConnectionId invalid size");
+  }
+  connidLen = view.size();
+  memcpy(connid.data(), view.data(), connidLen);
+}
+
 ConnectionId ConnectionId::createWithoutChecks(
     const std::vector<uint8_t>& connidIn) {
+  // The size is not validated, but it still has to fit in the inline storage.
+  CHECK_LE(connidIn.size(), kMaxConnectionIdSize);
   ConnectionId connid;
-  connid.connid = connidIn;
+  connid.connidLen = static_cast<uint8_t>(connidIn.size());
+  std::copy(connidIn.begin(), connidIn.end(), connid.connid.begin());
   return connid;
 }
 
 bool ConnectionId::operator==(const ConnectionId& other) const {
-  return connid == other.connid;
+  return connidLen == other.connidLen &&
+      memcmp(connid.data(), other.connid.data(), connidLen) == 0;
 }
 
 bool ConnectionId::operator!=(const ConnectionId& other) const {
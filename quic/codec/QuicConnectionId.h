@@ -8,13 +8,16 @@
 
 #pragma once
 
+#include <folly/Likely.h>
 #include <folly/Optional.h>
 #include <folly/String.h>
 #include <folly/hash/Hash.h>
 #include <folly/io/Cursor.h>
 #include <folly/io/IOBuf.h>
+#include <quic/QuicConstants.h>
 
 #include <array>
+#include <cstring>
 
 namespace quic {
 
@@ -22,6 +25,10 @@ constexpr size_t kMinConnectionIdSize = 4;
 constexpr size_t kMaxConnectionIdSize = 20;
 // set conn id version at the first 4 bits
 constexpr uint8_t kShortVersionId = 0x1;
+// 2^64 divided by the golden ratio, made odd.
+constexpr uint64_t kConnectionIdHashMultiplier = 0x9e3779b97f4a7c15;
+
+struct ConnectionIdView;
 
 struct ConnectionId {
   uint8_t* data();
@@ -34,6 +41,8 @@ struct ConnectionId {
 
   explicit ConnectionId(folly::io::Cursor& cursor, size_t len);
 
+  explicit ConnectionId(const ConnectionIdView& view);
+
   bool operator==(const ConnectionId& other) const;
   bool operator!=(const ConnectionId& other) const;
 
@@ -47,11 +56,66 @@ struct ConnectionId {
  private:
   ConnectionId() = default;
 
-  std::vector<uint8_t> connid;
+  // Stored inline so that copying a connection id, which happens for every
+  // packet that is routed or built, does not allocate.
+  std::array<uint8_t, kMaxConnectionIdSize> connid{};
+  uint8_t connidLen{0};
 };
 
+/**
+ * A connection id in a buffer owned by someone else, e.g. the packet being
+ * parsed. It is only valid as long as that buffer is, and is turned into a
+ * ConnectionId once the id has to be kept.
+ */
+struct ConnectionIdView {
+  ConnectionIdView(const uint8_t* dataIn, uint8_t sizeIn)
+      : data_(dataIn), size_(sizeIn) {}
+
+  /* implicit */ ConnectionIdView(const ConnectionId& connId)
+      : data_(connId.data()), size_(connId.size()) {}
+
+  const uint8_t* data() const {
+    return data_;
+  }
+
+  uint8_t size() const {
+    return size_;
+  }
+
+  bool operator==(const ConnectionIdView& other) const {
+    return size_ == other.size_ && memcmp(data_, other.data_, size_) == 0;
+  }
+
+  bool operator!=(const ConnectionIdView& other) const {
+    return !operator==(other);
+  }
+
+  std::string hex() const {
+    return folly::hexlify(folly::ByteRange(data_, size_));
+  }
+
+ private:
+  const uint8_t* data_;
+  uint8_t size_;
+};
+
+/**
+ * Hashes connection ids and views of them alike, so that a view can be
+ * looked up in a table keyed by connection id.
+ */
 struct ConnectionIdHash {
-  size_t operator()(const ConnectionId& connId) const {
+  size_t operator()(const ConnectionIdView& connId) const {
+    static_assert(
+        kDefaultConnectionIdSize == sizeof(uint64_t),
+        "Server connection ids are hashed as a single word");
+    if (LIKELY(connId.size() == kDefaultConnectionIdSize)) {
+      // The connection ids the server hands out are random where it matters
+      // and routing hashes one per received datagram, so a multiply-shift of
+      // the single word is enough.
+      uint64_t word;
+      memcpy(&word, connId.data(), sizeof(word));
+      return (word * kConnectionIdHashMultiplier) >> 32;
+    }
     return folly::hash::fnv32_buf(connId.data(), connId.size());
   }
 };
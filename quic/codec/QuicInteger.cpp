@@ -8,6 +8,9 @@
 
 #include <quic/codec/QuicInteger.h>
 #include <folly/Conv.h>
+#include <folly/Likely.h>
+
+#include <cstring>
 
 namespace quic {
 
@@ -53,9 +56,95 @@ folly::Expected<size_t, TransportErrorCode> encodeQuicInteger(
   return folly::makeUnexpected(TransportErrorCode::INTERNAL_ERROR);
 }
 
+folly::Expected<size_t, TransportErrorCode> encodeQuicInteger(
+    uint64_t value,
+    uint8_t* out) {
+  if (value <= kOneByteLimit) {
+    *out = static_cast<uint8_t>(value);
+    return sizeof(uint8_t);
+  } else if (value <= kTwoByteLimit) {
+    uint16_t modified =
+        folly::Endian::big(static_cast<uint16_t>(value | 0x4000));
+    memcpy(out, &modified, sizeof(modified));
+    return sizeof(modified);
+  } else if (value <= kFourByteLimit) {
+    uint32_t modified =
+        folly::Endian::big(static_cast<uint32_t>(value | 0x80000000));
+    memcpy(out, &modified, sizeof(modified));
+    return sizeof(modified);
+  } else if (value <= kEightByteLimit) {
+    uint64_t modified = folly::Endian::big(value | 0xC000000000000000);
+    memcpy(out, &modified, sizeof(modified));
+    return sizeof(modified);
+  }
+  return folly::makeUnexpected(TransportErrorCode::INTERNAL_ERROR);
+}
+
+folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
+    folly::ByteRange data) {
+  if (data.empty()) {
+    return folly::none;
+  }
+  const uint8_t firstByte = data[0];
+  switch (firstByte >> 6) {
+    case 0:
+      return std::make_pair((uint64_t)firstByte, (size_t)1);
+    case 1: {
+      if (data.size() < sizeof(uint16_t)) {
+        return folly::none;
+      }
+      uint16_t value =
+          folly::Endian::big(folly::loadUnaligned<uint16_t>(data.data()));
+      return std::make_pair((uint64_t)(value & kTwoByteLimit), sizeof(value));
+    }
+    case 2: {
+      if (data.size() < sizeof(uint32_t)) {
+        return folly::none;
+      }
+      uint32_t value =
+          folly::Endian::big(folly::loadUnaligned<uint32_t>(data.data()));
+      return std::make_pair((uint64_t)(value & kFourByteLimit), sizeof(value));
+    }
+    default: {
+      if (data.size() < sizeof(uint64_t)) {
+        return folly::none;
+      }
+      uint64_t value =
+          folly::Endian::big(folly::loadUnaligned<uint64_t>(data.data()));
+      return std::make_pair(value & kEightByteLimit, sizeof(value));
+    }
+  }
+}
+
+folly::Optional<size_t> decodeQuicIntegers(
+    folly::ByteRange data,
+    folly::Range<uint64_t*> out) {
+  size_t bytesUsed = 0;
+  for (auto& value : out) {
+    auto decoded = decodeQuicInteger(data.subpiece(bytesUsed));
+    if (!decoded) {
+      return folly::none;
+    }
+    value = decoded->first;
+    bytesUsed += decoded->second;
+  }
+  return bytesUsed;
+}
+
 folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
     folly::io::Cursor& cursor,
     uint64_t atMost) {
+  // Fast path when the integer is entirely in the current buffer.
+  auto bytes = cursor.peekBytes();
+  if (LIKELY(!bytes.empty())) {
+    size_t length = decodeQuicIntegerLength(bytes[0]);
+    if (LIKELY(length <= bytes.size() && length <= atMost)) {
+      auto result = decodeQuicInteger(bytes);
+      cursor.skip(length);
+      return result;
+    }
+  }
+
   size_t numBytes = 0;
   size_t advanceLen = 0;
   uint64_t result = 0;
@@ -125,6 +214,16 @@ size_t QuicInteger::encode(folly::io::QueueAppender& appender) const {
   return size.value();
 }
 
+size_t QuicInteger::encode(uint8_t* out) const {
+  auto size = encodeQuicInteger(value_, out);
+  if (size.hasError()) {
+    LOG(ERROR) << "Value too large value=" << value_;
+    throw QuicTransportException(
+        folly::to<std::string>("Value too large ", value_), size.error());
+  }
+  return size.value();
+}
+
 uint64_t QuicInteger::getValue() const {
   return value_;
 }
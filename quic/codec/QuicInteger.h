@@ -29,6 +29,14 @@ folly::Expected<size_t, TransportErrorCode> encodeQuicInteger(
     uint64_t value,
     folly::io::QueueAppender& appender);
 
+/**
+ * Same as above, but writes the encoded integer to out, which must have room
+ * for at least sizeof(uint64_t) bytes.
+ */
+folly::Expected<size_t, TransportErrorCode> encodeQuicInteger(
+    uint64_t value,
+    uint8_t* out);
+
 /**
  * Reads an integer out of the cursor and returns a pair with the integer and
  * the numbers of bytes read, or folly::none if there are not enough bytes to
@@ -38,6 +46,23 @@ folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
     folly::io::Cursor& cursor,
     uint64_t atMost = std::numeric_limits<uint64_t>::max());
 
+/**
+ * Same as above for a contiguous buffer. The 2, 4 and 8 byte encodings are
+ * decoded with a single unaligned load. Returns folly::none if data does not
+ * start with a complete integer.
+ */
+folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
+    folly::ByteRange data);
+
+/**
+ * Decodes out.size() consecutive integers from a contiguous buffer, e.g. the
+ * gap and length fields of a list of ACK blocks. Returns the number of bytes
+ * used, or folly::none if data does not hold all of them.
+ */
+folly::Optional<size_t> decodeQuicIntegers(
+    folly::ByteRange data,
+    folly::Range<uint64_t*> out);
+
 /**
  * Returns the length of a quic integer given the first byte
  */
@@ -62,6 +87,12 @@ class QuicInteger {
    */
   size_t encode(folly::io::QueueAppender& appender) const;
 
+  /**
+   * Encodes a QUIC integer to out, which must have room for at least
+   * sizeof(uint64_t) bytes.
+   */
+  size_t encode(uint8_t* out) const;
+
   /**
    * Returns the number of bytes needed to represent the QUIC integer in
    * its encoded form.
@@ -10,6 +10,7 @@
 
 #include <folly/Random.h>
 #include <quic/codec/PacketNumber.h>
+#include <quic/common/BufferArena.h>
 
 namespace {
 
@@ -179,6 +180,12 @@ void RegularQuicPacketBuilder::appendBytes(
 
 void RegularQuicPacketBuilder::insert(std::unique_ptr<folly::IOBuf> buf) {
   remainingBytes_ -= buf->computeChainDataLength();
+  if (contiguous_) {
+    for (auto range : *buf) {
+      bodyAppender_.push(range.data(), range.size());
+    }
+    return;
+  }
   bodyAppender_.insert(std::move(buf));
 }
 
@@ -213,7 +220,19 @@ RegularQuicPacketBuilder::Packet RegularQuicPacketBuilder::buildPacket() && {
         packetNumberEncoding_->result,
         packetNumberEncoding_->length);
   }
-  return Packet(std::move(packet_), header_.move(), outputQueue_.move());
+  auto header = header_.move();
+  auto body = outputQueue_.move();
+  if (contiguous_ && header && body && !body->isChained() &&
+      !header->isChained() && body->headroom() >= header->length()) {
+    // Move the header into the body's headroom so that the whole packet
+    // ends up in one buffer. The header only references that memory, so the
+    // body stays unshared.
+    auto headerLen = header->length();
+    memcpy(body->writableData() - headerLen, header->data(), headerLen);
+    header =
+        folly::IOBuf::wrapBuffer(body->writableData() - headerLen, headerLen);
+  }
+  return Packet(std::move(packet_), std::move(header), std::move(body));
 }
 
 void RegularQuicPacketBuilder::writeHeaderBytes(
@@ -279,10 +298,69 @@ void RegularQuicPacketBuilder::setCipherOverhead(uint8_t overhead) noexcept {
   cipherOverhead_ = overhead;
 }
 
+void RegularQuicPacketBuilder::useContiguousBuffer(BufferArena* arena) {
+  DCHECK(outputQueue_.empty());
+  auto capacity = kContiguousPacketHeadroom + remainingBytes_ + cipherOverhead_;
+  auto buf =
+      arena ? arena->createIOBuf(capacity) : folly::IOBuf::create(capacity);
+  buf->advance(kContiguousPacketHeadroom);
+  outputQueue_.append(std::move(buf));
+  contiguous_ = true;
+}
+
 QuicVersion RegularQuicPacketBuilder::getVersion() const {
   return version_;
 }
 
+Buf joinPacketHeaderAndBody(Buf header, Buf body) {
+  if (!body->isChained() && !header->isChained() &&
+      body->headroom() >= header->length() &&
+      body->data() - header->length() == header->data()) {
+    body->prepend(header->length());
+    return body;
+  }
+  header->prependChain(std::move(body));
+  return header;
+}
+
+CachedVersionNegotiationPacket::CachedVersionNegotiationPacket(
+    const std::vector<QuicVersion>& versions) {
+  constexpr size_t kMaxHeaderSize = sizeof(uint8_t) + sizeof(QuicVersionType) +
+      2 * (sizeof(uint8_t) + kMaxConnectionIdSize);
+  size_t maxVersions =
+      (kDefaultUDPSendPacketLen - kMaxHeaderSize) / sizeof(QuicVersionType);
+  size_t numVersions = std::min(versions.size(), maxVersions);
+  encodedVersions_.resize(numVersions * sizeof(QuicVersionType));
+  for (size_t i = 0; i < numVersions; ++i) {
+    auto version =
+        folly::Endian::big(static_cast<QuicVersionType>(versions[i]));
+    memcpy(
+        encodedVersions_.data() + i * sizeof(QuicVersionType),
+        &version,
+        sizeof(version));
+  }
+}
+
+Buf CachedVersionNegotiationPacket::build(
+    const ConnectionId& sourceConnectionId,
+    const ConnectionId& destinationConnectionId) const {
+  size_t headerSize = sizeof(uint8_t) + sizeof(QuicVersionType) +
+      sizeof(uint8_t) + destinationConnectionId.size() + sizeof(uint8_t) +
+      sourceConnectionId.size();
+  auto buf = folly::IOBuf::create(headerSize + encodedVersions_.size());
+  folly::io::Appender appender(buf.get(), 0);
+  // Same packet type as VersionNegotiationPacketBuilder.
+  appender.writeBE<uint8_t>(kHeaderFormMask);
+  appender.writeBE(
+      static_cast<QuicVersionType>(QuicVersion::VERSION_NEGOTIATION));
+  appender.writeBE<uint8_t>(destinationConnectionId.size());
+  appender.push(destinationConnectionId.data(), destinationConnectionId.size());
+  appender.writeBE<uint8_t>(sourceConnectionId.size());
+  appender.push(sourceConnectionId.data(), sourceConnectionId.size());
+  appender.push(encodedVersions_.data(), encodedVersions_.size());
+  return buf;
+}
+
 StatelessResetPacketBuilder::StatelessResetPacketBuilder(
     uint16_t maxPacketSize,
     const StatelessResetToken& resetToken) {
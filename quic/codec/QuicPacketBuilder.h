@@ -15,12 +15,20 @@
 
 namespace quic {
 
+class BufferArena;
+
 // We reserve 2 bytes for packet length in the long headers
 constexpr auto kReservedPacketLenSize = sizeof(uint16_t);
 
 // We reserve 4 bytes for packet number in the long headers.
 constexpr auto kReservedPacketNumSize = kMaxPacketNumEncodingSize;
 
+// A stream frame only goes without a length field when nothing follows it in
+// the packet. Bodies too small for the header protection sample get padding
+// appended, so such a frame must carry at least this much data.
+constexpr uint64_t kMinStreamFrameDataWithoutLength =
+    kMaxPacketNumEncodingSize + sizeof(Sample);
+
 // Note a full PacketNum has 64 bits, but LongHeader only uses 32 bits of them
 // This is based on Draft-22
 constexpr auto kLongHeaderHeaderSize = sizeof(uint8_t) /* Type bytes */ +
@@ -39,6 +47,9 @@ constexpr auto kCipherOverheadHeuristic = 16;
 // IOBufQueue growth byte size for in PacketBuilder:
 constexpr size_t kAppenderGrowthSize = 100;
 
+// Room reserved in front of the body of a contiguous packet for its header.
+constexpr size_t kContiguousPacketHeadroom = 64;
+
 class PacketBuilderInterface {
  public:
   virtual ~PacketBuilderInterface() = default;
@@ -122,6 +133,18 @@ class RegularQuicPacketBuilder : public PacketBuilderInterface {
 
   void setCipherOverhead(uint8_t overhead) noexcept;
 
+  /**
+   * Builds the packet into a single preallocated buffer: the body is written
+   * with room for the header in front and for the cipher overhead behind, and
+   * inserted data is copied instead of chained. The built header then points
+   * into that buffer, and an unshared body can be encrypted in place. Must be
+   * called after setCipherOverhead and before writing any frame.
+   *
+   * The buffer comes from arena if it is set, and the packet fits in one of
+   * its buffers.
+   */
+  void useContiguousBuffer(BufferArena* arena = nullptr);
+
   QuicVersion getVersion() const override;
 
  private:
@@ -144,8 +167,16 @@ class RegularQuicPacketBuilder : public PacketBuilderInterface {
   uint32_t cipherOverhead_{0};
   folly::Optional<PacketNumEncodingResult> packetNumberEncoding_;
   QuicVersion version_;
+  bool contiguous_{false};
 };
 
+/**
+ * Joins the header and the encrypted body of a packet. If the header was
+ * built in the headroom of a contiguous body this just exposes it, otherwise
+ * the body is chained to the header.
+ */
+Buf joinPacketHeaderAndBody(Buf header, Buf body);
+
 class VersionNegotiationPacketBuilder {
  public:
   explicit VersionNegotiationPacketBuilder(
@@ -175,6 +206,26 @@ class VersionNegotiationPacketBuilder {
   folly::io::QueueAppender appender_;
 };
 
+/**
+ * Version negotiation packets for a fixed list of versions. The versions are
+ * encoded once, so that answering a packet only means writing the connection
+ * ids in front of them. Builds the same packets as
+ * VersionNegotiationPacketBuilder, except that the list is cut to fit after
+ * connection ids of the maximum size.
+ */
+class CachedVersionNegotiationPacket {
+ public:
+  explicit CachedVersionNegotiationPacket(
+      const std::vector<QuicVersion>& versions);
+
+  Buf build(
+      const ConnectionId& sourceConnectionId,
+      const ConnectionId& destinationConnectionId) const;
+
+ private:
+  std::vector<uint8_t> encodedVersions_;
+};
+
 class StatelessResetPacketBuilder {
  public:
   StatelessResetPacketBuilder(
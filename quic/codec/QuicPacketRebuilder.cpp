@@ -65,19 +65,25 @@ folly::Optional<PacketEvent> PacketRebuilder::rebuildFromPacket(
               });
           AckFrameMetaData meta(
               ackFrame.ackBlocks, ackFrame.ackDelay, ackDelayExponent);
+          meta.ecnCounts = ackFrame.ecnCounts;
           auto ackWriteResult = writeAckFrame(meta, builder_);
           return ackWriteResult.hasValue();
         },
         [&](const WriteStreamFrame& streamFrame) {
           auto stream = conn_.streamManager->getStream(streamFrame.streamId);
           if (stream && retransmittable(*stream)) {
+            // Nothing is written after the last frame of the packet, so it
+            // can do without a length field.
+            bool omitLength = std::next(iter) == packet.packet.frames.cend() &&
+                streamFrame.len >= kMinStreamFrameDataWithoutLength;
             StreamFrameMetaData meta(
                 streamFrame.streamId,
                 streamFrame.offset,
                 streamFrame.fin,
-                cloneRetransmissionBuffer(streamFrame, stream),
-                true);
-            auto streamWriteResult = writeStreamFrame(meta, builder_);
+                nullptr /* data */,
+                !omitLength);
+            auto streamWriteResult = writeStreamFrameFromBuffer(
+                meta, getRetransmissionBuffer(streamFrame, stream), builder_);
             bool ret = streamWriteResult.hasValue() &&
                 streamWriteResult->bytesWritten == streamFrame.len &&
                 streamWriteResult->finWritten == streamFrame.fin;
@@ -136,6 +142,10 @@ folly::Optional<PacketEvent> PacketRebuilder::rebuildFromPacket(
         [&](const PaddingFrame& paddingFrame) {
           return writeFrame(paddingFrame, builder_) != 0;
         },
+        [&](const DatagramFrame&) {
+          // Datagrams are unreliable, a clone goes without them.
+          return true;
+        },
         [&](const QuicSimpleFrame& simpleFrame) {
           auto updatedSimpleFrame =
               updateSimpleFrameOnPacketClone(conn_, simpleFrame);
@@ -196,7 +206,7 @@ Buf PacketRebuilder::cloneCryptoRetransmissionBuffer(
   return iter->data.front()->clone();
 }
 
-Buf PacketRebuilder::cloneRetransmissionBuffer(
+const folly::IOBuf* PacketRebuilder::getRetransmissionBuffer(
     const WriteStreamFrame& frame,
     const QuicStreamState* stream) {
   /**
@@ -225,7 +235,7 @@ Buf PacketRebuilder::cloneRetransmissionBuffer(
       DCHECK(!frame.len || !iter->data.empty())
           << "WriteStreamFrame cloning: frame is not empty but StreamBuffer has"
           << " empty data. " << conn_;
-      return (frame.len ? iter->data.front()->clone() : nullptr);
+      return (frame.len ? iter->data.front() : nullptr);
     }
   }
   return nullptr;
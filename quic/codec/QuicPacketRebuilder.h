@@ -51,7 +51,11 @@ class PacketRebuilder {
       const WriteCryptoFrame& frame,
       const QuicCryptoStream& stream);
 
-  Buf cloneRetransmissionBuffer(
+  /**
+   * Returns the data of the retransmission buffer entry that frame was
+   * written from. The rebuilt frame references it without cloning it first.
+   */
+  const folly::IOBuf* getRetransmissionBuffer(
       const WriteStreamFrame& frame,
       const QuicStreamState* stream);
 
@@ -16,6 +16,78 @@ quic::ConnectionId zeroConnId() {
   std::vector<uint8_t> zeroData(quic::kDefaultConnectionIdSize, 0);
   return quic::ConnectionId(zeroData);
 }
+
+/**
+ * Splits a packet of len bytes off the front of the queue. Unlike
+ * IOBufQueue::split, the returned buffer does not share its IOBuf with what is
+ * left in the queue. It is a view over the same receive buffer which it keeps
+ * alive, so coalesced packets are neither copied nor prevented from being
+ * decrypted in place.
+ */
+quic::Buf splitPacketView(folly::IOBufQueue& queue, size_t len) {
+  const folly::IOBuf* front = queue.front();
+  if (queue.chainLength() == len) {
+    return queue.move();
+  }
+  if (front->length() < len) {
+    // The packet spans several buffers.
+    return queue.split(len);
+  }
+  auto keepAlive = front->cloneOne().release();
+  auto packet = folly::IOBuf::takeOwnership(
+      const_cast<uint8_t*>(front->data()),
+      len,
+      [](void* /* buf */, void* userData) {
+        delete static_cast<folly::IOBuf*>(userData);
+      },
+      keepAlive);
+  queue.trimStart(len);
+  return packet;
+}
+
+/**
+ * Splits the header off a packet by copying it out. This leaves the IOBuf of
+ * the body unshared, so the aead can decrypt it in place.
+ */
+std::pair<quic::Buf, quic::Buf> splitPacketHeader(
+    quic::Buf packet,
+    size_t headerLen) {
+  if (packet->isChained() || packet->length() < headerLen) {
+    folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+    queue.append(std::move(packet));
+    auto header = queue.split(headerLen);
+    return std::make_pair(std::move(header), queue.move());
+  }
+  auto header = folly::IOBuf::copyBuffer(packet->data(), headerLen);
+  packet->trimStart(headerLen);
+  return std::make_pair(std::move(header), std::move(packet));
+}
+
+/**
+ * Returns whether the packet ends with token. The bytes are compared in
+ * constant time so that the check does not reveal how much of a forged token
+ * is right.
+ */
+bool endsWithStatelessResetToken(
+    const folly::IOBuf& packet,
+    size_t packetLength,
+    const quic::StatelessResetToken& token) {
+  quic::StatelessResetToken tail;
+  const uint8_t* tailData;
+  if (!packet.isChained()) {
+    tailData = packet.data() + packetLength - tail.size();
+  } else {
+    folly::io::Cursor cursor(&packet);
+    cursor.skip(packetLength - tail.size());
+    cursor.pull(tail.data(), tail.size());
+    tailData = tail.data();
+  }
+  uint8_t diff = 0;
+  for (size_t i = 0; i < token.size(); ++i) {
+    diff |= tailData[i] ^ token[i];
+  }
+  return diff == 0;
+}
 } // namespace
 
 namespace quic {
@@ -82,7 +154,7 @@ CodecResult QuicReadCodec::parseLongHeaderPacket(
     queue.clear();
     return CodecResult(folly::none);
   }
-  auto currentPacketData = queue.split(currentPacketLen);
+  auto currentPacketData = splitPacketView(queue, currentPacketLen);
   cursor.reset(currentPacketData.get());
   cursor.skip(packetNumberOffset);
   // Sample starts after the max packet number size. This ensures that we
@@ -114,6 +186,7 @@ CodecResult QuicReadCodec::parseLongHeaderPacket(
           VLOG(4) << nodeToString(nodeType_)
                   << " dropping initial packet for exceeding key timeout"
                   << connIdToHex();
+          releaseRetiredCiphers(Clock::now());
           return CodecResult(folly::none);
         }
       }
@@ -131,6 +204,7 @@ CodecResult QuicReadCodec::parseLongHeaderPacket(
           VLOG(4) << nodeToString(nodeType_)
                   << " dropping zero rtt packet for exceeding key timeout"
                   << connIdToHex();
+          releaseRetiredCiphers(Clock::now());
           return CodecResult(folly::none);
         }
       }
@@ -180,39 +254,40 @@ CodecResult QuicReadCodec::parseLongHeaderPacket(
       initialByteRange.data()[0], packetNumberByteRange, expectedNextPacketNum);
 
   longHeader.setPacketNumber(packetNum.first);
-  folly::IOBufQueue decryptQueue{folly::IOBufQueue::cacheChainLength()};
-  decryptQueue.append(std::move(currentPacketData));
   size_t aadLen = packetNumberOffset + packetNum.second;
-  auto headerData = decryptQueue.split(aadLen);
-  // parsing verifies that packetLength >= packet number length.
-  auto encryptedData = decryptQueue.splitAtMost(
-      parsedLongHeader->packetLength.packetLength - packetNum.second);
-  if (!encryptedData) {
+  auto splitData = splitPacketHeader(std::move(currentPacketData), aadLen);
+  auto headerData = std::move(splitData.first);
+  // parsing verifies that packetLength >= packet number length, and the
+  // packet was split at exactly its length.
+  auto encryptedData = std::move(splitData.second);
+  if (!encryptedData || encryptedData->empty()) {
     // There should normally be some integrity tag at least in the data,
     // however allowing the aead to process the data even if the tag is not
     // present helps with writing tests.
     encryptedData = folly::IOBuf::create(0);
   }
 
-  Buf decrypted;
-  auto decryptAttempt = cipher->tryDecrypt(
-      std::move(encryptedData), headerData.get(), packetNum.first);
-  if (!decryptAttempt) {
+  if (!cipher->tryDecryptInPlace(
+          encryptedData, headerData.get(), packetNum.first)) {
     VLOG(4) << "Unable to decrypt packet=" << packetNum.first
             << " packetNumLen=" << parsePacketNumberLength(initialByte)
             << " protectionType=" << toString(protectionType) << " "
             << connIdToHex();
     return CodecResult(folly::none);
   }
-  decrypted = std::move(*decryptAttempt);
-
+  auto decrypted = std::move(encryptedData);
   if (!decrypted) {
     // TODO better way of handling this (tests break without this)
     decrypted = folly::IOBuf::create(0);
   }
 
   folly::io::Cursor packetCursor(decrypted.get());
-  return decodeRegularPacket(std::move(longHeader), params_, packetCursor);
+  auto packet =
+      decodeRegularPacket(std::move(longHeader), params_, packetCursor);
+  if (UNLIKELY(packet.hasError())) {
+    throwTransportError(packet.error());
+  }
+  return std::move(packet.value());
 }
 
 CodecResult QuicReadCodec::parsePacket(
@@ -281,42 +356,33 @@ CodecResult QuicReadCodec::parsePacket(
     return folly::none;
   }
 
-  // Back in the queue so we can split.
-  // TODO: this will share the buffer. We should be able to supply an unshared
-  // buffer.
-  queue.append(std::move(data));
   size_t aadLen = packetNumberOffset + packetNum.second;
-  auto headerData = queue.split(aadLen);
-  auto encryptedData = queue.move();
-  if (!encryptedData) {
+  auto splitData = splitPacketHeader(std::move(data), aadLen);
+  auto headerData = std::move(splitData.first);
+  auto encryptedData = std::move(splitData.second);
+  if (!encryptedData || encryptedData->empty()) {
     // There should normally be some integrity tag at least in the data,
     // however allowing the aead to process the data even if the tag is not
     // present helps with writing tests.
     encryptedData = folly::IOBuf::create(0);
   }
   Buf decrypted;
-  // TODO: small optimization we can do here: only read the token if
-  // decryption fails
-  folly::Optional<StatelessResetToken> token;
-  auto encryptedDataLength = encryptedData->computeChainDataLength();
-  if (statelessResetToken_ &&
-      encryptedDataLength > sizeof(StatelessResetToken)) {
-    token = StatelessResetToken();
-    // We want to avoid cloning the IOBuf which would prevent in-place
-    // decryption
-    folly::io::Cursor statelessTokenCursor(encryptedData.get());
-    // TODO: we could possibly use headroom or tailroom of the iobuf to avoid
-    // extra allocations
-    statelessTokenCursor.skip(
-        encryptedDataLength - sizeof(StatelessResetToken));
-    statelessTokenCursor.pull(token->data(), token->size());
-  }
-  auto decryptAttempt = oneRttReadCipher_->tryDecrypt(
-      std::move(encryptedData), headerData.get(), packetNum.first);
-  if (!decryptAttempt) {
+  // The token has to be checked before decrypting in place overwrites it. It
+  // is only compared against our own token, so packets that merely fail to
+  // decrypt, e.g. after a NAT rebinding, are dropped here without being handed
+  // up as resets.
+  bool isStatelessReset = false;
+  if (statelessResetToken_) {
+    auto encryptedDataLength = encryptedData->computeChainDataLength();
+    isStatelessReset = encryptedDataLength > sizeof(StatelessResetToken) &&
+        endsWithStatelessResetToken(
+            *encryptedData, encryptedDataLength, *statelessResetToken_);
+  }
+  if (!oneRttReadCipher_->tryDecryptInPlace(
+          encryptedData, headerData.get(), packetNum.first)) {
     // Can't return the data now, already consumed it to try decrypting it.
-    if (token) {
-      return StatelessReset(*token);
+    if (isStatelessReset) {
+      return StatelessReset(*statelessResetToken_);
     }
     auto protectionType = shortHeader->getProtectionType();
     VLOG(10) << "Unable to decrypt packet=" << packetNum.first
@@ -324,14 +390,22 @@ CodecResult QuicReadCodec::parsePacket(
              << connIdToHex();
     return CodecResult(folly::none);
   }
-  decrypted = std::move(*decryptAttempt);
+  decrypted = std::move(encryptedData);
   if (!decrypted) {
     // TODO better way of handling this (tests break without this)
     decrypted = folly::IOBuf::create(0);
   }
 
   folly::io::Cursor packetCursor(decrypted.get());
-  return decodeRegularPacket(std::move(*shortHeader), params_, packetCursor);
+  // A malformed packet that decrypted comes from a peer that has the keys,
+  // which the caller closes the connection for. Frame errors are only thrown
+  // from here, once per packet.
+  auto packet = decodeShortHeaderPacket(
+      std::move(*shortHeader), params_, packetCursor);
+  if (UNLIKELY(packet.hasError())) {
+    throwTransportError(packet.error());
+  }
+  return std::move(packet.value());
 }
 
 const Aead* QuicReadCodec::getOneRttReadCipher() const {
@@ -442,6 +516,28 @@ folly::Optional<TimePoint> QuicReadCodec::getHandshakeDoneTime() {
   return handshakeDoneTime_;
 }
 
+void QuicReadCodec::releaseRetiredCiphers(TimePoint now) {
+  if (!handshakeDoneTime_) {
+    return;
+  }
+  auto timeBetween = now - *handshakeDoneTime_;
+  if (timeBetween > kTimeToRetainInitialKeys) {
+    initialReadCipher_.reset();
+    initialHeaderCipher_.reset();
+  }
+  if (timeBetween > kTimeToRetainZeroRttKeys) {
+    zeroRttReadCipher_.reset();
+    zeroRttHeaderCipher_.reset();
+  }
+}
+
+void QuicReadCodec::discardHandshakeCiphers() {
+  initialReadCipher_.reset();
+  initialHeaderCipher_.reset();
+  handshakeReadCipher_.reset();
+  handshakeHeaderCipher_.reset();
+}
+
 std::string QuicReadCodec::connIdToHex() {
   static ConnectionId zeroConn = zeroConnId();
   const auto& serverId = serverConnectionId_.value_or(zeroConn);
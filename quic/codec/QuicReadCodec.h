@@ -12,6 +12,7 @@
 #include <quic/codec/Decode.h>
 #include <quic/codec/PacketNumber.h>
 #include <quic/codec/Types.h>
+#include <quic/common/BlockRecycler.h>
 #include <quic/handshake/HandshakeLayer.h>
 #include <quic/state/AckStates.h>
 
@@ -43,6 +44,15 @@ class QuicReadCodec {
  public:
   virtual ~QuicReadCodec() = default;
 
+  // Recycled with the rest of the connection, see BlockRecycler.
+  static void* operator new(size_t size) {
+    return BlockRecycler::allocate(size);
+  }
+
+  static void operator delete(void* p, size_t size) noexcept {
+    BlockRecycler::deallocate(p, size);
+  }
+
   explicit QuicReadCodec(QuicNodeType nodeType);
 
   /**
@@ -96,6 +106,21 @@ class QuicReadCodec {
 
   folly::Optional<TimePoint> getHandshakeDoneTime();
 
+  /**
+   * Releases the Initial and 0-rtt read and header ciphers once the handshake
+   * has been done for longer than they are retained, after which the packets
+   * they protect are dropped without being decrypted anyway. Called when such
+   * a packet is dropped, the transports may call it on their own timers.
+   */
+  void releaseRetiredCiphers(TimePoint now);
+
+  /**
+   * Releases the Initial and Handshake read and header ciphers right away,
+   * once the handshake is confirmed. Packets of those spaces can't be
+   * decrypted afterwards.
+   */
+  void discardHandshakeCiphers();
+
  private:
   CodecResult parseLongHeaderPacket(
       folly::IOBufQueue& queue,
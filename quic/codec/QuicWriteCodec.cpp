@@ -9,6 +9,7 @@
 #include <quic/codec/QuicWriteCodec.h>
 
 #include <algorithm>
+#include <array>
 #include <limits>
 
 #include <quic/QuicConstants.h>
@@ -26,18 +27,75 @@ bool packetSpaceCheck(uint64_t limit, size_t require);
 bool packetSpaceCheck(uint64_t limit, size_t require) {
   return (folly::to<uint64_t>(require) <= limit);
 }
+
+// Room for a frame type and four 8 byte QUIC integers, which covers the
+// fixed part of every frame the encoder below is used for.
+constexpr size_t kMaxEncodedFrameFieldsSize = 1 + 4 * sizeof(uint64_t);
+
+/**
+ * Collects the encoded fields of a frame on the stack, so that they go into
+ * the packet with a single push instead of one builder call, and one
+ * appender bounds check, per field.
+ */
+class FrameFieldsEncoder {
+ public:
+  void writeBE(uint8_t value) {
+    DCHECK_LT(size_, buf_.size());
+    buf_[size_++] = value;
+  }
+
+  void write(const quic::QuicInteger& quicInteger) {
+    DCHECK_LE(size_ + sizeof(uint64_t), buf_.size());
+    size_ += quicInteger.encode(buf_.data() + size_);
+  }
+
+  void writeTo(quic::PacketBuilderInterface& builder) const {
+    builder.push(buf_.data(), size_);
+  }
+
+ private:
+  std::array<uint8_t, kMaxEncodedFrameFieldsSize> buf_;
+  size_t size_{0};
+};
+
+/**
+ * Frame types below 0x40 encode to a single byte, which lets frames without
+ * fields be written from a constant.
+ */
+template <quic::FrameType type>
+struct SingleByteFrame {
+  static_assert(
+      static_cast<uint64_t>(type) <= quic::kOneByteLimit,
+      "frame type must fit in one byte");
+  static constexpr uint8_t kEncoded = static_cast<uint8_t>(type);
+
+  static void writeTo(quic::PacketBuilderInterface& builder) {
+    builder.push(&kEncoded, sizeof(kEncoded));
+  }
+};
+
+template <quic::FrameType type>
+constexpr uint8_t SingleByteFrame<type>::kEncoded;
 } // namespace
 
 namespace quic {
 
-folly::Optional<StreamFrameWriteResult> writeStreamFrame(
+namespace {
+
+/**
+ * Shared implementation of writeStreamFrame and writeStreamFrameFromBuffer.
+ * With keepWrittenData the written range is cloned once more into the result,
+ * otherwise it is only referenced from the packet.
+ */
+folly::Optional<StreamFrameWriteResult> writeStreamFrameImpl(
     const StreamFrameMetaData& streamFrameMetaData,
+    const folly::IOBuf* data,
+    bool keepWrittenData,
     PacketBuilderInterface& builder) {
   if (!builder.remainingSpaceInPkt()) {
     return folly::none;
   }
-  if ((!streamFrameMetaData.data ||
-       streamFrameMetaData.data->computeChainDataLength() == 0) &&
+  if ((!data || data->computeChainDataLength() == 0) &&
       !streamFrameMetaData.fin) {
     VLOG(2) << "No data or FIN supplied while writing stream "
             << streamFrameMetaData.id;
@@ -49,13 +107,18 @@ folly::Optional<StreamFrameWriteResult> writeStreamFrame(
   QuicInteger streamId(streamFrameMetaData.id);
   QuicInteger offset(streamFrameMetaData.offset);
 
+  uint64_t dataInStream = 0;
+  if (data) {
+    dataInStream = data->computeChainDataLength();
+  }
   size_t headerSize = sizeof(FrameType::STREAM) + streamId.getSize();
   if (LIKELY(streamFrameMetaData.hasMoreFrames)) {
     initialByte.setLength();
-    // We use the size remaining for simplicity here. 2 bytes should be enough
-    // for almost anything. We could save 1 byte by deciding whether or not we
-    // have < 100 bytes to write, however that seems a bit overkill.
-    auto size = getQuicIntegerSize(builder.remainingSpaceInPkt());
+    // The length can't exceed either the data or the space left, so size the
+    // field for the smaller of the two. A tiny frame then only needs 1 byte,
+    // which lets it fit into the tail of an almost full packet.
+    auto size = getQuicIntegerSize(
+        std::min<uint64_t>(builder.remainingSpaceInPkt(), dataInStream));
     if (size.hasError()) {
       throw QuicTransportException(
           folly::to<std::string>(
@@ -78,10 +141,6 @@ folly::Optional<StreamFrameWriteResult> writeStreamFrame(
     return folly::none;
   }
   spaceLeftInPkt -= headerSize;
-  uint64_t dataInStream = 0;
-  if (streamFrameMetaData.data) {
-    dataInStream = streamFrameMetaData.data->computeChainDataLength();
-  }
   auto dataCanWrite = std::min<uint64_t>(spaceLeftInPkt, dataInStream);
   bool canWrite = (dataInStream > 0 && dataCanWrite > 0) ||
       (dataInStream == 0 && streamFrameMetaData.fin);
@@ -101,17 +160,19 @@ folly::Optional<StreamFrameWriteResult> writeStreamFrame(
     initialByte.setFin();
     writtenFin = true;
   }
-  builder.writeBE(initialByte.build().fieldValue());
-  builder.write(streamId);
+  FrameFieldsEncoder header;
+  header.writeBE(initialByte.build().fieldValue());
+  header.write(streamId);
   if (streamFrameMetaData.offset != 0) {
-    builder.write(offset);
+    header.write(offset);
   }
   if (LIKELY(streamFrameMetaData.hasMoreFrames)) {
-    builder.write(actualLength);
+    header.write(actualLength);
   }
+  header.writeTo(builder);
   Buf bufToWrite;
   if (dataCanWrite > 0) {
-    folly::io::Cursor cursor(streamFrameMetaData.data.get());
+    folly::io::Cursor cursor(data);
     cursor.clone(bufToWrite, dataCanWrite);
   } else {
     bufToWrite = folly::IOBuf::create(0);
@@ -119,7 +180,11 @@ folly::Optional<StreamFrameWriteResult> writeStreamFrame(
   VLOG(4) << "writing frame stream=" << streamFrameMetaData.id
           << " offset=" << streamFrameMetaData.offset
           << " data=" << dataCanWrite << " fin=" << writtenFin;
-  builder.insert(bufToWrite->clone());
+  if (keepWrittenData) {
+    builder.insert(bufToWrite->clone());
+  } else {
+    builder.insert(std::move(bufToWrite));
+  }
   builder.appendFrame(WriteStreamFrame(
       streamFrameMetaData.id,
       streamFrameMetaData.offset,
@@ -129,6 +194,22 @@ folly::Optional<StreamFrameWriteResult> writeStreamFrame(
       dataCanWrite, writtenFin, std::move(bufToWrite));
   return folly::make_optional(std::move(result));
 }
+} // namespace
+
+folly::Optional<StreamFrameWriteResult> writeStreamFrame(
+    const StreamFrameMetaData& streamFrameMetaData,
+    PacketBuilderInterface& builder) {
+  return writeStreamFrameImpl(
+      streamFrameMetaData, streamFrameMetaData.data.get(), true, builder);
+}
+
+folly::Optional<StreamFrameWriteResult> writeStreamFrameFromBuffer(
+    const StreamFrameMetaData& streamFrameMetaData,
+    const folly::IOBuf* data,
+    PacketBuilderInterface& builder) {
+  DCHECK(!streamFrameMetaData.data);
+  return writeStreamFrameImpl(streamFrameMetaData, data, false, builder);
+}
 
 folly::Optional<WriteCryptoFrame>
 writeCryptoFrame(uint64_t offsetIn, Buf data, PacketBuilderInterface& builder) {
@@ -158,9 +239,11 @@ writeCryptoFrame(uint64_t offsetIn, Buf data, PacketBuilderInterface& builder) {
   data->coalesce();
   data->trimEnd(dataLength - writeableData);
 
-  builder.write(intFrameType);
-  builder.write(offsetInteger);
-  builder.write(lengthVarInt);
+  FrameFieldsEncoder header;
+  header.write(intFrameType);
+  header.write(offsetInteger);
+  header.write(lengthVarInt);
+  header.writeTo(builder);
   builder.insert(std::move(data));
   builder.appendFrame(WriteCryptoFrame(offsetIn, lengthVarInt.getValue()));
   return WriteCryptoFrame(offsetIn, lengthVarInt.getValue());
@@ -202,7 +285,15 @@ size_t fillFrameWithAckBlocks(
     bytesLimit -= additionalSize;
     previousNumAckBlockInt = numAckBlocksInt;
     currentSeqNum = currBlock.start;
-    ackFrame.ackBlocks.insert(currBlock.start, currBlock.end);
+  }
+  // The blocks are sized from the largest down, but they are added from the
+  // smallest one that fits upwards, so that every insert appends to the
+  // interval set instead of shifting what is already there.
+  auto firstBlock =
+      ackBlocks.cbegin() + (ackBlocks.size() - 1 - numAdditionalAckBlocks);
+  for (auto blockItr = firstBlock; blockItr != ackBlocks.cend() - 1;
+       ++blockItr) {
+    ackFrame.ackBlocks.insert(blockItr->start, blockItr->end);
   }
   return numAdditionalAckBlocks;
 }
@@ -238,10 +329,19 @@ folly::Optional<AckFrameWriteResult> writeAckFrame(
 
   // Required fields are Type, LargestAcked, AckDelay, AckBlockCount,
   // firstAckBlockLength
-  QuicInteger encodedintFrameType(static_cast<uint8_t>(FrameType::ACK));
+  auto& ecnCounts = ackFrameMetaData.ecnCounts;
+  QuicInteger encodedintFrameType(static_cast<uint8_t>(
+      ecnCounts ? FrameType::ACK_ECN : FrameType::ACK));
   auto headerSize = encodedintFrameType.getSize() +
       largestAckedPacketInt.getSize() + ackDelayInt.getSize() +
       minAdditionalAckBlockCount.getSize() + firstAckBlockLengthInt.getSize();
+  // The ECN counts follow the ack blocks, their space is reserved up front.
+  QuicInteger ect0Int(ecnCounts ? ecnCounts->ect0 : 0);
+  QuicInteger ect1Int(ecnCounts ? ecnCounts->ect1 : 0);
+  QuicInteger ceInt(ecnCounts ? ecnCounts->ce : 0);
+  if (ecnCounts) {
+    headerSize += ect0Int.getSize() + ect1Int.getSize() + ceInt.getSize();
+  }
   if (spaceLeft < headerSize) {
     return folly::none;
   }
@@ -251,11 +351,13 @@ folly::Optional<AckFrameWriteResult> writeAckFrame(
       fillFrameWithAckBlocks(ackFrameMetaData.ackBlocks, ackFrame, spaceLeft);
 
   QuicInteger numAdditionalAckBlocksInt(numAdditionalAckBlocks);
-  builder.write(encodedintFrameType);
-  builder.write(largestAckedPacketInt);
-  builder.write(ackDelayInt);
-  builder.write(numAdditionalAckBlocksInt);
-  builder.write(firstAckBlockLengthInt);
+  FrameFieldsEncoder header;
+  header.write(encodedintFrameType);
+  header.write(largestAckedPacketInt);
+  header.write(ackDelayInt);
+  header.write(numAdditionalAckBlocksInt);
+  header.write(firstAckBlockLengthInt);
+  header.writeTo(builder);
 
   PacketNum currentSeqNum = ackFrameMetaData.ackBlocks.back().start;
   for (auto it = ackFrame.ackBlocks.crbegin(); it != ackFrame.ackBlocks.crend();
@@ -269,12 +371,18 @@ folly::Optional<AckFrameWriteResult> writeAckFrame(
     builder.write(currentBlockLenInt);
     currentSeqNum = it->start;
   }
+  if (ecnCounts) {
+    builder.write(ect0Int);
+    builder.write(ect1Int);
+    builder.write(ceInt);
+  }
   // also the largest ack block since we already accounted for the space to
   // write to it.
   ackFrame.ackBlocks.insert(
       ackFrameMetaData.ackBlocks.back().start,
       ackFrameMetaData.ackBlocks.back().end);
   ackFrame.ackDelay = ackFrameMetaData.ackDelay;
+  ackFrame.ecnCounts = ecnCounts;
   builder.appendFrame(std::move(ackFrame));
   return AckFrameWriteResult(
       beginningSpace - builder.remainingSpaceInPkt(),
@@ -402,6 +510,73 @@ size_t writeSimpleFrame(
         }
         // no space left in packet
         return size_t(0);
+      },
+      [&](RetireConnectionIdFrame& retireConnectionIdFrame) {
+        QuicInteger frameType(
+            static_cast<FrameTypeType>(FrameType::RETIRE_CONNECTION_ID));
+        QuicInteger sequence(retireConnectionIdFrame.sequenceId);
+        auto retireConnectionIdFrameSize =
+            frameType.getSize() + sequence.getSize();
+        if (packetSpaceCheck(spaceLeft, retireConnectionIdFrameSize)) {
+          builder.write(frameType);
+          builder.write(sequence);
+          builder.appendFrame(std::move(retireConnectionIdFrame));
+          return retireConnectionIdFrameSize;
+        }
+        // no space left in packet
+        return size_t(0);
+      },
+      [&](AckFrequencyFrame& ackFrequencyFrame) {
+        QuicInteger frameType(
+            static_cast<FrameTypeType>(FrameType::ACK_FREQUENCY));
+        QuicInteger sequenceNumber(ackFrequencyFrame.sequenceNumber);
+        QuicInteger packetTolerance(ackFrequencyFrame.packetTolerance);
+        QuicInteger maxAckDelay(ackFrequencyFrame.maxAckDelay.count());
+        auto ackFrequencyFrameSize = frameType.getSize() +
+            sequenceNumber.getSize() + packetTolerance.getSize() +
+            maxAckDelay.getSize() + sizeof(uint8_t);
+        if (packetSpaceCheck(spaceLeft, ackFrequencyFrameSize)) {
+          builder.write(frameType);
+          builder.write(sequenceNumber);
+          builder.write(packetTolerance);
+          builder.write(maxAckDelay);
+          builder.writeBE(
+              static_cast<uint8_t>(ackFrequencyFrame.ignoreOrder ? 1 : 0));
+          builder.appendFrame(std::move(ackFrequencyFrame));
+          return ackFrequencyFrameSize;
+        }
+        // no space left in packet
+        return size_t(0);
+      },
+      [&](FecRepairFrame& fecRepairFrame) {
+        QuicInteger frameType(
+            static_cast<FrameTypeType>(FrameType::FEC_REPAIR));
+        QuicInteger firstPacketNum(fecRepairFrame.firstPacketNum);
+        QuicInteger numPackets(
+            fecRepairFrame.lastPacketNum - fecRepairFrame.firstPacketNum);
+        QuicInteger numSourceFrames(fecRepairFrame.numSourceFrames);
+        uint64_t repairDataLen = fecRepairFrame.repairData
+            ? fecRepairFrame.repairData->computeChainDataLength()
+            : 0;
+        QuicInteger repairDataLenInt(repairDataLen);
+        auto fecRepairFrameSize = frameType.getSize() +
+            firstPacketNum.getSize() + numPackets.getSize() +
+            numSourceFrames.getSize() + repairDataLenInt.getSize() +
+            repairDataLen;
+        if (packetSpaceCheck(spaceLeft, fecRepairFrameSize)) {
+          builder.write(frameType);
+          builder.write(firstPacketNum);
+          builder.write(numPackets);
+          builder.write(numSourceFrames);
+          builder.write(repairDataLenInt);
+          if (fecRepairFrame.repairData) {
+            builder.insert(fecRepairFrame.repairData->clone());
+          }
+          builder.appendFrame(std::move(fecRepairFrame));
+          return fecRepairFrameSize;
+        }
+        // no space left in packet
+        return size_t(0);
       });
 }
 
@@ -413,20 +588,20 @@ size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder) {
   return folly::variant_match(
       frame,
       [&](PaddingFrame& paddingFrame) {
-        QuicInteger intFrameType(static_cast<uint8_t>(FrameType::PADDING));
-        if (packetSpaceCheck(spaceLeft, intFrameType.getSize())) {
-          builder.write(intFrameType);
+        using Encoded = SingleByteFrame<FrameType::PADDING>;
+        if (packetSpaceCheck(spaceLeft, sizeof(Encoded::kEncoded))) {
+          Encoded::writeTo(builder);
           builder.appendFrame(std::move(paddingFrame));
-          return intFrameType.getSize();
+          return sizeof(Encoded::kEncoded);
         }
         return size_t(0);
       },
       [&](PingFrame& pingFrame) {
-        QuicInteger intFrameType(static_cast<uint8_t>(FrameType::PING));
-        if (packetSpaceCheck(spaceLeft, intFrameType.getSize())) {
-          builder.write(intFrameType);
+        using Encoded = SingleByteFrame<FrameType::PING>;
+        if (packetSpaceCheck(spaceLeft, sizeof(Encoded::kEncoded))) {
+          Encoded::writeTo(builder);
           builder.appendFrame(std::move(pingFrame));
-          return intFrameType.getSize();
+          return sizeof(Encoded::kEncoded);
         }
         // no space left in packet
         return size_t(0);
@@ -463,8 +638,10 @@ size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder) {
         QuicInteger maximumData(maxDataFrame.maximumData);
         auto frameSize = intFrameType.getSize() + maximumData.getSize();
         if (packetSpaceCheck(spaceLeft, frameSize)) {
-          builder.write(intFrameType);
-          builder.write(maximumData);
+          FrameFieldsEncoder fields;
+          fields.write(intFrameType);
+          fields.write(maximumData);
+          fields.writeTo(builder);
           builder.appendFrame(std::move(maxDataFrame));
           return frameSize;
         }
@@ -479,9 +656,11 @@ size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder) {
         auto maxStreamDataFrameSize =
             intFrameType.getSize() + streamId.getSize() + maximumData.getSize();
         if (packetSpaceCheck(spaceLeft, maxStreamDataFrameSize)) {
-          builder.write(intFrameType);
-          builder.write(streamId);
-          builder.write(maximumData);
+          FrameFieldsEncoder fields;
+          fields.write(intFrameType);
+          fields.write(streamId);
+          fields.write(maximumData);
+          fields.writeTo(builder);
           builder.appendFrame(std::move(maxStreamDataFrame));
           return maxStreamDataFrameSize;
         }
@@ -620,8 +799,27 @@ size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder) {
       [&](QuicSimpleFrame& simpleFrame) {
         return writeSimpleFrame(std::move(simpleFrame), builder);
       },
+      [&](DatagramFrame& datagramFrame) {
+        QuicInteger frameType(static_cast<uint8_t>(FrameType::DATAGRAM_LEN));
+        QuicInteger length(datagramFrame.length);
+        auto datagramFrameSize =
+            frameType.getSize() + length.getSize() + datagramFrame.length;
+        if (packetSpaceCheck(spaceLeft, datagramFrameSize)) {
+          builder.write(frameType);
+          builder.write(length);
+          if (datagramFrame.data) {
+            builder.insert(std::move(datagramFrame.data));
+          }
+          // The data is never retransmitted, so the packet only records the
+          // length.
+          builder.appendFrame(DatagramFrame(datagramFrame.length, nullptr));
+          return datagramFrameSize;
+        }
+        // no space left in packet
+        return size_t(0);
+      },
       [&](auto&) -> size_t {
-        // TODO add support for: RETIRE_CONNECTION_ID and NEW_TOKEN frames
+        // TODO add support for NEW_TOKEN frames
         auto errorStr = folly::to<std::string>(
             "Unknown / unsupported frame type received at ", __func__);
         VLOG(2) << errorStr;
@@ -22,6 +22,8 @@ struct AckFrameMetaData {
   std::chrono::microseconds ackDelay;
   // The ack delay exponent to use.
   uint8_t ackDelayExponent;
+  // When set, the frame is written as an ACK_ECN frame carrying these counts.
+  folly::Optional<ECNCounts> ecnCounts;
 
   AckFrameMetaData(
       const IntervalSet<PacketNum>& acksIn,
@@ -108,6 +110,19 @@ folly::Optional<StreamFrameWriteResult> writeStreamFrame(
     const StreamFrameMetaData& streamFrameMetaData,
     PacketBuilderInterface& builder);
 
+/**
+ * Write a StreamFrame into builder for data the caller keeps owning, such as
+ * a retransmission buffer when a packet is cloned. streamFrameMetaData must
+ * not carry data of its own.
+ *
+ * Behaves like writeStreamFrame, except that the written range is only
+ * referenced from the packet, so the result carries no writtenData.
+ */
+folly::Optional<StreamFrameWriteResult> writeStreamFrameFromBuffer(
+    const StreamFrameMetaData& streamFrameMetaData,
+    const folly::IOBuf* data,
+    PacketBuilderInterface& builder);
+
 /**
  * Write a CryptoFrame into builder. The builder may not be able to accept all
  * the bytes that are supplied to writeCryptoFrame.
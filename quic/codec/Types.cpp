@@ -314,6 +314,14 @@ std::string toString(FrameType frame) {
       return "CONNECTION_CLOSE";
     case FrameType::APPLICATION_CLOSE:
       return "APPLICATION_CLOSE";
+    case FrameType::DATAGRAM:
+      return "DATAGRAM";
+    case FrameType::DATAGRAM_LEN:
+      return "DATAGRAM_LEN";
+    case FrameType::ACK_FREQUENCY:
+      return "ACK_FREQUENCY";
+    case FrameType::FEC_REPAIR:
+      return "FEC_REPAIR";
     case FrameType::MIN_STREAM_DATA:
       return "MIN_STREAM_DATA";
     case FrameType::EXPIRED_STREAM_DATA:
@@ -12,6 +12,7 @@
 #include <folly/Conv.h>
 #include <folly/Optional.h>
 #include <folly/Overload.h>
+#include <folly/small_vector.h>
 #include <folly/io/Cursor.h>
 #include <folly/io/IOBuf.h>
 #include <quic/QuicConstants.h>
@@ -69,6 +70,10 @@ struct AckBlock {
       : startPacket(start), endPacket(end) {}
 };
 
+// ACKs arrive on almost every packet a sender reads and usually carry a few
+// blocks, so those are stored inline.
+using ReadAckBlocks = folly::small_vector<AckBlock, kInlineReadAckBlocks>;
+
 /**
  0                   1                   2                   3
  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -89,12 +94,28 @@ struct AckBlock {
  |                    Additional ACK Block (i)                 ...
  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  */
+/**
+ * Number of packets received with each ECN codepoint in a packet number space,
+ * as carried by an ACK_ECN frame.
+ */
+struct ECNCounts {
+  uint64_t ect0{0};
+  uint64_t ect1{0};
+  uint64_t ce{0};
+
+  bool empty() const {
+    return ect0 == 0 && ect1 == 0 && ce == 0;
+  }
+};
+
 struct ReadAckFrame {
   PacketNum largestAcked;
   std::chrono::microseconds ackDelay;
   // Should have at least 1 block.
   // These are ordered in descending order by start packet.
-  std::vector<AckBlock> ackBlocks;
+  ReadAckBlocks ackBlocks;
+  // Only set for ACK_ECN frames.
+  folly::Optional<ECNCounts> ecnCounts;
 
   bool operator==(const ReadAckFrame& /*rhs*/) const {
     // Can't compare ackBlocks, function is just here to appease compiler.
@@ -106,6 +127,8 @@ struct WriteAckFrame {
   IntervalSet<PacketNum> ackBlocks;
   // Delay in sending ack from time that packet was received.
   std::chrono::microseconds ackDelay;
+  // Set when the frame was written as an ACK_ECN frame.
+  folly::Optional<ECNCounts> ecnCounts;
 
   bool operator==(const WriteAckFrame& /*rhs*/) const {
     // Can't compare ackBlocks, function is just here to appease compiler.
@@ -386,6 +409,85 @@ struct ExpiredStreamDataFrame {
   }
 };
 
+struct AckFrequencyFrame {
+  // Increases with every ACK_FREQUENCY frame sent, so the receiver can ignore
+  // stale requests that arrive out of order.
+  uint64_t sequenceNumber;
+  // Number of ack-eliciting packets the receiver may get before it has to
+  // send an ACK.
+  uint64_t packetTolerance;
+  std::chrono::microseconds maxAckDelay;
+  // Whether the receiver may skip acking out of order packets immediately.
+  bool ignoreOrder;
+
+  AckFrequencyFrame(
+      uint64_t sequenceNumberIn,
+      uint64_t packetToleranceIn,
+      std::chrono::microseconds maxAckDelayIn,
+      bool ignoreOrderIn)
+      : sequenceNumber(sequenceNumberIn),
+        packetTolerance(packetToleranceIn),
+        maxAckDelay(maxAckDelayIn),
+        ignoreOrder(ignoreOrderIn) {}
+
+  bool operator==(const AckFrequencyFrame& rhs) const {
+    return sequenceNumber == rhs.sequenceNumber &&
+        packetTolerance == rhs.packetTolerance &&
+        maxAckDelay == rhs.maxAckDelay && ignoreOrder == rhs.ignoreOrder;
+  }
+};
+
+/**
+ * XOR of the symbols of numSourceFrames stream frames sent in the packets
+ * from firstPacketNum to lastPacketNum, see quic/state/QuicFecFunctions.h.
+ */
+struct FecRepairFrame {
+  PacketNum firstPacketNum;
+  PacketNum lastPacketNum;
+  uint64_t numSourceFrames;
+  Buf repairData;
+
+  FecRepairFrame(
+      PacketNum firstPacketNumIn,
+      PacketNum lastPacketNumIn,
+      uint64_t numSourceFramesIn,
+      Buf repairDataIn)
+      : firstPacketNum(firstPacketNumIn),
+        lastPacketNum(lastPacketNumIn),
+        numSourceFrames(numSourceFramesIn),
+        repairData(std::move(repairDataIn)) {}
+
+  // Stuff stored in a variant type needs to be copyable.
+  FecRepairFrame(const FecRepairFrame& other)
+      : firstPacketNum(other.firstPacketNum),
+        lastPacketNum(other.lastPacketNum),
+        numSourceFrames(other.numSourceFrames) {
+    if (other.repairData) {
+      repairData = other.repairData->clone();
+    }
+  }
+
+  FecRepairFrame(FecRepairFrame&& other) noexcept = default;
+
+  FecRepairFrame& operator=(const FecRepairFrame& other) {
+    firstPacketNum = other.firstPacketNum;
+    lastPacketNum = other.lastPacketNum;
+    numSourceFrames = other.numSourceFrames;
+    repairData = other.repairData ? other.repairData->clone() : nullptr;
+    return *this;
+  }
+
+  FecRepairFrame& operator=(FecRepairFrame&& other) = default;
+
+  bool operator==(const FecRepairFrame& rhs) const {
+    folly::IOBufEqualTo eq;
+    return firstPacketNum == rhs.firstPacketNum &&
+        lastPacketNum == rhs.lastPacketNum &&
+        numSourceFrames == rhs.numSourceFrames &&
+        eq(repairData, rhs.repairData);
+  }
+};
+
 struct MaxStreamsFrame {
   // A count of the cumulative number of streams
   uint64_t maxStreams;
@@ -475,6 +577,10 @@ struct RetireConnectionIdFrame {
 
   explicit RetireConnectionIdFrame(uint64_t sequenceIn)
       : sequenceId(sequenceIn) {}
+
+  bool operator==(const RetireConnectionIdFrame& rhs) const {
+    return sequenceId == rhs.sequenceId;
+  }
 };
 
 struct PathChallengeFrame {
@@ -541,6 +647,41 @@ struct ApplicationCloseFrame {
   }
 };
 
+/**
+ * Unreliable application data. A DATAGRAM frame is never retransmitted, so the
+ * written form only keeps the length and drops the data once it is in the
+ * packet.
+ */
+struct DatagramFrame {
+  size_t length;
+  Buf data;
+
+  explicit DatagramFrame(size_t lengthIn, Buf dataIn)
+      : length(lengthIn), data(std::move(dataIn)) {}
+
+  // Stuff stored in a variant type needs to be copyable.
+  DatagramFrame(const DatagramFrame& other) : length(other.length) {
+    if (other.data) {
+      data = other.data->clone();
+    }
+  }
+
+  DatagramFrame(DatagramFrame&& other) noexcept = default;
+
+  DatagramFrame& operator=(const DatagramFrame& other) {
+    length = other.length;
+    data = other.data ? other.data->clone() : nullptr;
+    return *this;
+  }
+
+  DatagramFrame& operator=(DatagramFrame&& other) = default;
+
+  bool operator==(const DatagramFrame& other) const {
+    folly::IOBufEqualTo eq;
+    return length == other.length && eq(data, other.data);
+  }
+};
+
 // Frame to represent ones we skip
 struct NoopFrame {};
 
@@ -560,7 +701,10 @@ using QuicSimpleFrame = boost::variant<
     ExpiredStreamDataFrame,
     PathChallengeFrame,
     PathResponseFrame,
-    NewConnectionIdFrame>;
+    NewConnectionIdFrame,
+    RetireConnectionIdFrame,
+    AckFrequencyFrame,
+    FecRepairFrame>;
 
 // Types of frames that can be read.
 using QuicFrame = boost::variant<
@@ -580,6 +724,7 @@ using QuicFrame = boost::variant<
     ReadCryptoFrame,
     ReadNewTokenFrame,
     QuicSimpleFrame,
+    DatagramFrame,
     NoopFrame>;
 
 // Types of frames which are written.
@@ -598,7 +743,8 @@ using QuicWriteFrame = boost::variant<
     WriteAckFrame,
     WriteStreamFrame,
     WriteCryptoFrame,
-    QuicSimpleFrame>;
+    QuicSimpleFrame,
+    DatagramFrame>;
 
 enum class HeaderForm : bool {
   Long = 1,
@@ -210,7 +210,7 @@ TEST_F(DecodeTest, ValidAckFrame) {
       firstAckBlockLength,
       ackBlocks);
   folly::io::Cursor cursor(result.get());
-  auto ackFrame = decodeAckFrame(
+  auto ackFrame = *decodeAckFrame(
       cursor,
       makeHeader(),
       CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
@@ -234,7 +234,7 @@ TEST_F(DecodeTest, AckFrameLargestAckExceedsRange) {
       {},
       true);
   folly::io::Cursor cursor(result.get());
-  auto ackFrame = decodeAckFrame(
+  auto ackFrame = *decodeAckFrame(
       cursor,
       makeHeader(),
       CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
@@ -256,12 +256,11 @@ TEST_F(DecodeTest, AckFrameLargestAckInvalid) {
       {},
       true);
   folly::io::Cursor cursor(result.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor,
-          makeHeader(),
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded = decodeAckFrame(
+      cursor,
+      makeHeader(),
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded.hasError());
 }
 
 TEST_F(DecodeTest, AckFrameDelayEncodingInvalid) {
@@ -279,12 +278,11 @@ TEST_F(DecodeTest, AckFrameDelayEncodingInvalid) {
       false,
       true);
   folly::io::Cursor cursor(result.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor,
-          makeHeader(),
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded = decodeAckFrame(
+      cursor,
+      makeHeader(),
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded.hasError());
 }
 
 TEST_F(DecodeTest, AckFrameDelayExceedsRange) {
@@ -296,12 +294,11 @@ TEST_F(DecodeTest, AckFrameDelayExceedsRange) {
   auto result = createAckFrame(
       largestAcked, ackDelay, numAdditionalBlocks, firstAckBlockLength);
   folly::io::Cursor cursor(result.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor,
-          makeHeader(),
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded = decodeAckFrame(
+      cursor,
+      makeHeader(),
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded.hasError());
 }
 
 TEST_F(DecodeTest, AckFrameAdditionalBlocksUnderflow) {
@@ -320,12 +317,11 @@ TEST_F(DecodeTest, AckFrameAdditionalBlocksUnderflow) {
       firstAckBlockLength,
       ackBlocks);
   folly::io::Cursor cursor(result.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor,
-          makeHeader(),
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded = decodeAckFrame(
+      cursor,
+      makeHeader(),
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded.hasError());
 }
 
 TEST_F(DecodeTest, AckFrameAdditionalBlocksOverflow) {
@@ -346,10 +342,11 @@ TEST_F(DecodeTest, AckFrameAdditionalBlocksOverflow) {
       firstAckBlockLength,
       ackBlocks);
   folly::io::Cursor cursor(result.get());
-  decodeAckFrame(
+  auto decoded = decodeAckFrame(
       cursor,
       makeHeader(),
       CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded.hasValue());
 }
 
 TEST_F(DecodeTest, AckFrameMissingFields) {
@@ -371,52 +368,47 @@ TEST_F(DecodeTest, AckFrameMissingFields) {
       ackBlocks);
   folly::io::Cursor cursor1(result1.get());
 
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor1,
-          header,
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded1 = decodeAckFrame(
+      cursor1,
+      header,
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded1.hasError());
 
   auto result2 = createAckFrame(
       largestAcked, ackDelay, folly::none, firstAckBlockLength, ackBlocks);
   folly::io::Cursor cursor2(result2.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor2,
-          header,
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded2 = decodeAckFrame(
+      cursor2,
+      header,
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded2.hasError());
 
   auto result3 = createAckFrame(
       largestAcked, ackDelay, folly::none, firstAckBlockLength, ackBlocks);
   folly::io::Cursor cursor3(result3.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor3,
-          header,
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded3 = decodeAckFrame(
+      cursor3,
+      header,
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded3.hasError());
 
   auto result4 = createAckFrame(
       largestAcked, ackDelay, numAdditionalBlocks, folly::none, ackBlocks);
   folly::io::Cursor cursor4(result4.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor4,
-          header,
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded4 = decodeAckFrame(
+      cursor4,
+      header,
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded4.hasError());
 
   auto result5 = createAckFrame(
       largestAcked, ackDelay, numAdditionalBlocks, firstAckBlockLength, {});
   folly::io::Cursor cursor5(result5.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor5,
-          header,
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded5 = decodeAckFrame(
+      cursor5,
+      header,
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded5.hasError());
 }
 
 TEST_F(DecodeTest, AckFrameFirstBlockLengthInvalid) {
@@ -428,12 +420,11 @@ TEST_F(DecodeTest, AckFrameFirstBlockLengthInvalid) {
   auto result = createAckFrame(
       largestAcked, ackDelay, numAdditionalBlocks, firstAckBlockLength);
   folly::io::Cursor cursor(result.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor,
-          makeHeader(),
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded = decodeAckFrame(
+      cursor,
+      makeHeader(),
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded.hasError());
 }
 
 TEST_F(DecodeTest, AckFrameBlockLengthInvalid) {
@@ -453,12 +444,11 @@ TEST_F(DecodeTest, AckFrameBlockLengthInvalid) {
       firstAckBlockLength,
       ackBlocks);
   folly::io::Cursor cursor(result.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor,
-          makeHeader(),
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded = decodeAckFrame(
+      cursor,
+      makeHeader(),
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded.hasError());
 }
 
 TEST_F(DecodeTest, AckFrameBlockGapInvalid) {
@@ -478,12 +468,11 @@ TEST_F(DecodeTest, AckFrameBlockGapInvalid) {
       firstAckBlockLength,
       ackBlocks);
   folly::io::Cursor cursor(result.get());
-  EXPECT_THROW(
-      decodeAckFrame(
-          cursor,
-          makeHeader(),
-          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
-      QuicTransportException);
+  auto decoded = decodeAckFrame(
+      cursor,
+      makeHeader(),
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(decoded.hasError());
 }
 
 TEST_F(DecodeTest, AckFrameBlockLengthZero) {
@@ -505,7 +494,7 @@ TEST_F(DecodeTest, AckFrameBlockLengthZero) {
       ackBlocks);
   folly::io::Cursor cursor(result.get());
 
-  auto readAckFrame = decodeAckFrame(
+  auto readAckFrame = *decodeAckFrame(
       cursor,
       makeHeader(),
       CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
@@ -528,7 +517,7 @@ TEST_F(DecodeTest, StreamDecodeSuccess) {
   auto streamFrame = createStreamFrame(
       streamId, offset, length, folly::IOBuf::copyBuffer("a"));
   folly::io::Cursor cursor(streamFrame.get());
-  auto decodedFrame = decodeStreamFrame(cursor, streamType);
+  auto decodedFrame = *decodeStreamFrame(cursor, streamType);
   EXPECT_EQ(decodedFrame.offset, 10);
   EXPECT_EQ(decodedFrame.data->computeChainDataLength(), 1);
   EXPECT_EQ(decodedFrame.streamId, 10);
@@ -542,7 +531,7 @@ TEST_F(DecodeTest, StreamLengthStreamIdInvalid) {
   auto streamFrame = createStreamFrame<uint8_t>(
       streamId, folly::none, folly::none, nullptr, true);
   folly::io::Cursor cursor(streamFrame.get());
-  EXPECT_THROW(decodeStreamFrame(cursor, streamType), QuicTransportException);
+  EXPECT_TRUE(decodeStreamFrame(cursor, streamType).hasError());
 }
 
 TEST_F(DecodeTest, StreamOffsetNotPresent) {
@@ -553,7 +542,7 @@ TEST_F(DecodeTest, StreamOffsetNotPresent) {
   auto streamFrame = createStreamFrame(
       streamId, folly::none, length, folly::IOBuf::copyBuffer("a"));
   folly::io::Cursor cursor(streamFrame.get());
-  EXPECT_THROW(decodeStreamFrame(cursor, streamType), QuicTransportException);
+  EXPECT_TRUE(decodeStreamFrame(cursor, streamType).hasError());
 }
 
 TEST_F(DecodeTest, StreamIncorrectDataLength) {
@@ -565,7 +554,7 @@ TEST_F(DecodeTest, StreamIncorrectDataLength) {
   auto streamFrame = createStreamFrame(
       streamId, offset, length, folly::IOBuf::copyBuffer("a"));
   folly::io::Cursor cursor(streamFrame.get());
-  EXPECT_THROW(decodeStreamFrame(cursor, streamType), QuicTransportException);
+  EXPECT_TRUE(decodeStreamFrame(cursor, streamType).hasError());
 }
 
 TEST_F(DecodeTest, CryptoDecodeSuccess) {
@@ -574,7 +563,7 @@ TEST_F(DecodeTest, CryptoDecodeSuccess) {
   auto cryptoFrame =
       createCryptoFrame(offset, length, folly::IOBuf::copyBuffer("a"));
   folly::io::Cursor cursor(cryptoFrame.get());
-  auto decodedFrame = decodeCryptoFrame(cursor);
+  auto decodedFrame = *decodeCryptoFrame(cursor);
   EXPECT_EQ(decodedFrame.offset, 10);
   EXPECT_EQ(decodedFrame.data->computeChainDataLength(), 1);
 }
@@ -584,14 +573,14 @@ TEST_F(DecodeTest, CryptoOffsetNotPresent) {
   auto cryptoFrame =
       createCryptoFrame(folly::none, length, folly::IOBuf::copyBuffer("a"));
   folly::io::Cursor cursor(cryptoFrame.get());
-  EXPECT_THROW(decodeCryptoFrame(cursor), QuicTransportException);
+  EXPECT_TRUE(decodeCryptoFrame(cursor).hasError());
 }
 
 TEST_F(DecodeTest, CryptoLengthNotPresent) {
   QuicInteger offset(0);
   auto cryptoFrame = createCryptoFrame(offset, folly::none, nullptr);
   folly::io::Cursor cursor(cryptoFrame.get());
-  EXPECT_THROW(decodeCryptoFrame(cursor), QuicTransportException);
+  EXPECT_TRUE(decodeCryptoFrame(cursor).hasError());
 }
 
 TEST_F(DecodeTest, CryptoIncorrectDataLength) {
@@ -600,7 +589,7 @@ TEST_F(DecodeTest, CryptoIncorrectDataLength) {
   auto cryptoFrame =
       createCryptoFrame(offset, length, folly::IOBuf::copyBuffer("a"));
   folly::io::Cursor cursor(cryptoFrame.get());
-  EXPECT_THROW(decodeCryptoFrame(cursor), QuicTransportException);
+  EXPECT_TRUE(decodeCryptoFrame(cursor).hasError());
 }
 
 TEST_F(DecodeTest, PaddingFrameTest) {
@@ -631,7 +620,7 @@ TEST_F(DecodeTest, NewTokenDecodeSuccess) {
   auto newTokenFrame =
       createNewTokenFrame(length, folly::IOBuf::copyBuffer("a"));
   folly::io::Cursor cursor(newTokenFrame.get());
-  auto decodedFrame = decodeNewTokenFrame(cursor);
+  auto decodedFrame = *decodeNewTokenFrame(cursor);
   EXPECT_EQ(decodedFrame.token->computeChainDataLength(), 1);
 }
 
@@ -639,7 +628,7 @@ TEST_F(DecodeTest, NewTokenLengthNotPresent) {
   auto newTokenFrame =
       createNewTokenFrame(folly::none, folly::IOBuf::copyBuffer("a"));
   folly::io::Cursor cursor(newTokenFrame.get());
-  EXPECT_THROW(decodeNewTokenFrame(cursor), QuicTransportException);
+  EXPECT_TRUE(decodeNewTokenFrame(cursor).hasError());
 }
 
 TEST_F(DecodeTest, NewTokenIncorrectDataLength) {
@@ -647,7 +636,7 @@ TEST_F(DecodeTest, NewTokenIncorrectDataLength) {
   auto newTokenFrame =
       createNewTokenFrame(length, folly::IOBuf::copyBuffer("a"));
   folly::io::Cursor cursor(newTokenFrame.get());
-  EXPECT_THROW(decodeNewTokenFrame(cursor), QuicTransportException);
+  EXPECT_TRUE(decodeNewTokenFrame(cursor).hasError());
 }
 
 std::unique_ptr<folly::IOBuf> createMinOrExpiredStreamDataFrame(
@@ -675,12 +664,12 @@ TEST_F(DecodeTest, DecodeMinStreamDataFrame) {
   QuicInteger minimumStreamOffset(100);
   auto noOffset = createMinOrExpiredStreamDataFrame(streamId, maximumData);
   folly::io::Cursor cursor0(noOffset.get());
-  EXPECT_THROW(decodeMinStreamDataFrame(cursor0), QuicTransportException);
+  EXPECT_TRUE(decodeMinStreamDataFrame(cursor0).hasError());
 
   auto minStreamDataFrame = createMinOrExpiredStreamDataFrame(
       streamId, maximumData, minimumStreamOffset);
   folly::io::Cursor cursor(minStreamDataFrame.get());
-  auto result = decodeMinStreamDataFrame(cursor);
+  auto result = *decodeMinStreamDataFrame(cursor);
   EXPECT_EQ(result.streamId, 10);
   EXPECT_EQ(result.maximumData, 1000);
   EXPECT_EQ(result.minimumStreamOffset, 100);
@@ -691,15 +680,166 @@ TEST_F(DecodeTest, DecodeExpiredStreamDataFrame) {
   QuicInteger offset(100);
   auto noOffset = createMinOrExpiredStreamDataFrame(streamId);
   folly::io::Cursor cursor0(noOffset.get());
-  EXPECT_THROW(decodeExpiredStreamDataFrame(cursor0), QuicTransportException);
+  EXPECT_TRUE(decodeExpiredStreamDataFrame(cursor0).hasError());
 
   auto expiredStreamDataFrame =
       createMinOrExpiredStreamDataFrame(streamId, folly::none, offset);
   folly::io::Cursor cursor(expiredStreamDataFrame.get());
-  auto result = decodeExpiredStreamDataFrame(cursor);
+  auto result = *decodeExpiredStreamDataFrame(cursor);
   EXPECT_EQ(result.streamId, 10);
   EXPECT_EQ(result.minimumStreamOffset, 100);
 }
 
+TEST_F(DecodeTest, DecodeAckFrequencyFrame) {
+  folly::IOBufQueue bufQueue;
+  folly::io::QueueAppender wcursor(&bufQueue, 10);
+  QuicInteger(3).encode(wcursor);
+  QuicInteger(16).encode(wcursor);
+  QuicInteger(25000).encode(wcursor);
+  wcursor.writeBE<uint8_t>(1);
+  auto ackFrequencyFrame = bufQueue.move();
+
+  folly::io::Cursor cursor(ackFrequencyFrame.get());
+  auto result = *decodeAckFrequencyFrame(cursor);
+  EXPECT_EQ(result.sequenceNumber, 3);
+  EXPECT_EQ(result.packetTolerance, 16);
+  EXPECT_EQ(result.maxAckDelay, 25000us);
+  EXPECT_TRUE(result.ignoreOrder);
+}
+
+TEST_F(DecodeTest, DecodeAckFrequencyFrameZeroTolerance) {
+  folly::IOBufQueue bufQueue;
+  folly::io::QueueAppender wcursor(&bufQueue, 10);
+  QuicInteger(0).encode(wcursor);
+  QuicInteger(0).encode(wcursor);
+  QuicInteger(25000).encode(wcursor);
+  wcursor.writeBE<uint8_t>(0);
+  auto ackFrequencyFrame = bufQueue.move();
+
+  folly::io::Cursor cursor(ackFrequencyFrame.get());
+  EXPECT_TRUE(decodeAckFrequencyFrame(cursor).hasError());
+}
+
+TEST_F(DecodeTest, DecodeFecRepairFrame) {
+  folly::IOBufQueue bufQueue;
+  folly::io::QueueAppender wcursor(&bufQueue, 10);
+  QuicInteger(1000).encode(wcursor);
+  QuicInteger(5).encode(wcursor);
+  QuicInteger(4).encode(wcursor);
+  QuicInteger(3).encode(wcursor);
+  wcursor.push((const uint8_t*)"abc", 3);
+  auto fecRepairFrame = bufQueue.move();
+
+  folly::io::Cursor cursor(fecRepairFrame.get());
+  auto result = *decodeFecRepairFrame(cursor);
+  EXPECT_EQ(result.firstPacketNum, 1000);
+  EXPECT_EQ(result.lastPacketNum, 1005);
+  EXPECT_EQ(result.numSourceFrames, 4);
+  EXPECT_TRUE(folly::IOBufEqualTo()(
+      *result.repairData, *folly::IOBuf::copyBuffer("abc")));
+}
+
+TEST_F(DecodeTest, DecodeFecRepairFrameTruncated) {
+  folly::IOBufQueue bufQueue;
+  folly::io::QueueAppender wcursor(&bufQueue, 10);
+  QuicInteger(1000).encode(wcursor);
+  QuicInteger(5).encode(wcursor);
+  QuicInteger(4).encode(wcursor);
+  QuicInteger(10).encode(wcursor);
+  wcursor.push((const uint8_t*)"abc", 3);
+  auto fecRepairFrame = bufQueue.move();
+
+  folly::io::Cursor cursor(fecRepairFrame.get());
+  EXPECT_TRUE(decodeFecRepairFrame(cursor).hasError());
+}
+
+TEST_F(DecodeTest, DecodeDatagramFrame) {
+  folly::IOBufQueue bufQueue;
+  folly::io::QueueAppender wcursor(&bufQueue, 10);
+  QuicInteger(5).encode(wcursor);
+  wcursor.push((const uint8_t*)"hello", 5);
+  wcursor.push((const uint8_t*)"trail", 5);
+  auto datagramFrame = bufQueue.move();
+
+  folly::io::Cursor cursor(datagramFrame.get());
+  auto result = *decodeDatagramFrame(cursor, true /* hasLen */);
+  EXPECT_EQ(result.length, 5);
+  EXPECT_EQ(result.data->moveToFbString().toStdString(), "hello");
+
+  // Without a length the datagram takes the rest of the packet.
+  auto rest = *decodeDatagramFrame(cursor, false /* hasLen */);
+  EXPECT_EQ(rest.length, 5);
+  EXPECT_EQ(rest.data->moveToFbString().toStdString(), "trail");
+  EXPECT_EQ(cursor.totalLength(), 0);
+}
+
+TEST_F(DecodeTest, DecodeDatagramFrameIncorrectDataLength) {
+  folly::IOBufQueue bufQueue;
+  folly::io::QueueAppender wcursor(&bufQueue, 10);
+  QuicInteger(10).encode(wcursor);
+  wcursor.push((const uint8_t*)"a", 1);
+  auto datagramFrame = bufQueue.move();
+  folly::io::Cursor cursor(datagramFrame.get());
+  EXPECT_TRUE(decodeDatagramFrame(cursor, true).hasError());
+}
+
+TEST_F(DecodeTest, DecodeShortHeaderPacket) {
+  auto streamType =
+      StreamTypeField::Builder().setFin().setOffset().setLength().build();
+  folly::IOBufQueue payload;
+  folly::io::QueueAppender wcursor(&payload, 100);
+  QuicInteger(static_cast<UnderlyingFrameType>(FrameType::ACK))
+      .encode(wcursor);
+  wcursor.insert(createAckFrame(
+      QuicInteger(1000), QuicInteger(100), QuicInteger(0), QuicInteger(10)));
+  QuicInteger(streamType.fieldValue()).encode(wcursor);
+  wcursor.insert(createStreamFrame(
+      QuicInteger(10),
+      QuicInteger(10),
+      QuicInteger(1),
+      folly::IOBuf::copyBuffer("a")));
+  // Goes through the generic parser.
+  QuicInteger(static_cast<UnderlyingFrameType>(FrameType::MAX_DATA))
+      .encode(wcursor);
+  QuicInteger(5000).encode(wcursor);
+  for (int i = 0; i < 5; ++i) {
+    QuicInteger(static_cast<UnderlyingFrameType>(FrameType::PADDING))
+        .encode(wcursor);
+  }
+  auto data = payload.move();
+  folly::io::Cursor cursor(data.get());
+  auto packet =
+      *decodeShortHeaderPacket(makeHeader(), CodecParameters(), cursor);
+  ASSERT_EQ(packet.frames.size(), 4);
+  auto& ackFrame = boost::get<ReadAckFrame>(packet.frames[0]);
+  EXPECT_EQ(ackFrame.largestAcked, 1000);
+  auto& streamFrame = boost::get<ReadStreamFrame>(packet.frames[1]);
+  EXPECT_EQ(streamFrame.streamId, 10);
+  EXPECT_EQ(streamFrame.offset, 10);
+  EXPECT_TRUE(streamFrame.fin);
+  EXPECT_EQ(boost::get<MaxDataFrame>(packet.frames[2]).maximumData, 5000);
+  EXPECT_NE(boost::get<PaddingFrame>(&packet.frames[3]), nullptr);
+}
+
+TEST_F(DecodeTest, DecodeShortHeaderPacketBadStreamFrame) {
+  auto streamType = StreamTypeField::Builder().setLength().build();
+  folly::IOBufQueue payload;
+  folly::io::QueueAppender wcursor(&payload, 100);
+  QuicInteger(streamType.fieldValue()).encode(wcursor);
+  // The length is larger than the data left in the packet.
+  wcursor.insert(createStreamFrame(
+      QuicInteger(10),
+      folly::none,
+      QuicInteger(100),
+      folly::IOBuf::copyBuffer("a")));
+  auto data = payload.move();
+  folly::io::Cursor cursor(data.get());
+  auto decoded =
+      decodeShortHeaderPacket(makeHeader(), CodecParameters(), cursor);
+  ASSERT_TRUE(decoded.hasError());
+  EXPECT_EQ(decoded.error().code, TransportErrorCode::FRAME_ENCODING_ERROR);
+  EXPECT_EQ(decoded.error().frameType, FrameType::STREAM);
+}
+
 } // namespace test
 } // namespace quic
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/codec/EncryptedConnectionIdAlgo.h>
+
+#include <folly/Random.h>
+#include <folly/portability/GTest.h>
+#include <quic/QuicException.h>
+
+#include <set>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class EncryptedConnectionIdAlgoTest : public Test {
+ protected:
+  void SetUp() override {
+    folly::Random::secureRandom(key_.data(), key_.size());
+  }
+
+  EncryptedConnectionIdKey key_;
+};
+
+TEST_F(EncryptedConnectionIdAlgoTest, EncodeParse) {
+  EncryptedConnectionIdAlgo algo(key_, 1);
+  for (uint16_t i = 0; i <= 255; i++) {
+    uint16_t hostId = folly::Random::rand32();
+    uint8_t processId = i % 2;
+    ServerConnectionIdParams params(hostId, processId, i);
+    auto connId = algo.encodeConnectionId(params);
+    EXPECT_EQ(kDefaultConnectionIdSize, connId.size());
+    EXPECT_EQ(1, EncryptedConnectionIdDecoder::getConfigId(connId));
+    ASSERT_TRUE(algo.canParse(connId));
+    auto parsed = algo.parseConnectionId(connId);
+    EXPECT_EQ(hostId, parsed.hostId);
+    EXPECT_EQ(processId, parsed.processId);
+    EXPECT_EQ(i, parsed.workerId);
+    EXPECT_EQ(connId, *parsed.clientConnId);
+  }
+}
+
+TEST_F(EncryptedConnectionIdAlgoTest, LongerConnectionIds) {
+  for (size_t size = kMinEncryptedConnectionIdSize;
+       size <= kMaxConnectionIdSize;
+       size++) {
+    EncryptedConnectionIdAlgo algo(key_, 0, size);
+    ServerConnectionIdParams params(0xabcd, 1, 42);
+    auto connId = algo.encodeConnectionId(params);
+    EXPECT_EQ(size, connId.size());
+    auto parsed = algo.parseConnectionId(connId);
+    EXPECT_EQ(0xabcd, parsed.hostId);
+    EXPECT_EQ(1, parsed.processId);
+    EXPECT_EQ(42, parsed.workerId);
+  }
+}
+
+TEST_F(EncryptedConnectionIdAlgoTest, RoutingFieldsNotInTheClear) {
+  EncryptedConnectionIdAlgo algo(key_, 0);
+  ServerConnectionIdParams params(0x1234, 0, 7);
+  std::set<std::string> connIds;
+  for (int i = 0; i < 100; i++) {
+    connIds.insert(algo.encodeConnectionId(params).hex());
+  }
+  // The same routing fields give unlinkable connection ids.
+  EXPECT_EQ(100, connIds.size());
+}
+
+TEST_F(EncryptedConnectionIdAlgoTest, StatelessDecoder) {
+  EncryptedConnectionIdAlgo algo(key_, 2);
+  EncryptedConnectionIdDecoder decoder(key_, 2);
+  ServerConnectionIdParams params(300, 1, 3);
+  auto connId = algo.encodeConnectionId(params);
+  auto decoded = decoder.decode(connId);
+  ASSERT_TRUE(decoded.hasValue());
+  EXPECT_EQ(300, decoded->hostId);
+  EXPECT_EQ(1, decoded->processId);
+  EXPECT_EQ(3, decoded->workerId);
+
+  // Another key decodes to something else.
+  EncryptedConnectionIdKey otherKey = key_;
+  otherKey[0] ^= 0x1;
+  EncryptedConnectionIdDecoder otherDecoder(otherKey, 2);
+  auto otherDecoded = otherDecoder.decode(connId);
+  ASSERT_TRUE(otherDecoded.hasValue());
+  EXPECT_FALSE(
+      otherDecoded->hostId == 300 && otherDecoded->workerId == 3 &&
+      otherDecoded->processId == 1);
+}
+
+TEST_F(EncryptedConnectionIdAlgoTest, CannotParseOtherConnectionIds) {
+  EncryptedConnectionIdAlgo algo(key_, 1);
+  EncryptedConnectionIdAlgo otherConfig(key_, 2);
+  ServerConnectionIdParams params(1, 0, 1);
+  auto connId = otherConfig.encodeConnectionId(params);
+  EXPECT_FALSE(algo.canParse(connId));
+  EXPECT_THROW(algo.parseConnectionId(connId), QuicInternalException);
+
+  EncryptedConnectionIdAlgo longer(key_, 1, kDefaultConnectionIdSize + 1);
+  EXPECT_FALSE(algo.canParse(longer.encodeConnectionId(params)));
+}
+
+TEST_F(EncryptedConnectionIdAlgoTest, InvalidConfig) {
+  EXPECT_THROW(
+      EncryptedConnectionIdAlgo(key_, kMaxEncryptedConnectionIdConfigId + 1),
+      QuicInternalException);
+  EXPECT_THROW(
+      EncryptedConnectionIdAlgo(key_, 0, kMinEncryptedConnectionIdSize - 1),
+      QuicInternalException);
+  EXPECT_THROW(
+      EncryptedConnectionIdAlgo(key_, 0, kMaxConnectionIdSize + 1),
+      QuicInternalException);
+}
+
+} // namespace test
+} // namespace quic
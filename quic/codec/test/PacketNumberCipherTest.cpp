@@ -112,6 +112,40 @@ TEST_P(LongPacketNumberCipherTest, TestEncrypt) {
   EXPECT_EQ(folly::hexlify(initialByte), GetParam().initialByte);
 }
 
+TEST_P(LongPacketNumberCipherTest, TestEncryptWithBatchMasks) {
+  auto key = folly::unhexlify(GetParam().key);
+  cipher_.setKey(folly::range(key));
+  std::array<uint8_t, 1> initialByte;
+  std::array<uint8_t, 4> packetNumberBytes;
+
+  auto initialByteString = folly::unhexlify(GetParam().decryptedInitialByte);
+  auto sampleString = folly::unhexlify(GetParam().sample);
+  auto packetNumberBytesString =
+      folly::unhexlify(GetParam().decryptedPacketNumberBytes);
+
+  // The batch has to produce the same mask for every copy of the sample.
+  std::vector<Sample> samples(3);
+  for (auto& sample : samples) {
+    memcpy(sample.data(), sampleString.data(), sample.size());
+  }
+  std::vector<HeaderProtectionMask> masks(samples.size());
+  cipher_.masks(folly::range(samples), folly::range(masks));
+  for (auto& headerMask : masks) {
+    EXPECT_EQ(cipher_.mask(folly::range(samples[0])), headerMask);
+
+    memcpy(initialByte.data(), initialByteString.data(), initialByte.size());
+    memcpy(
+        packetNumberBytes.data(),
+        packetNumberBytesString.data(),
+        packetNumberBytes.size());
+    cipher_.encryptLongHeaderWithMask(
+        headerMask, folly::range(initialByte), folly::range(packetNumberBytes));
+
+    EXPECT_EQ(folly::hexlify(packetNumberBytes), GetParam().packetNumberBytes);
+    EXPECT_EQ(folly::hexlify(initialByte), GetParam().initialByte);
+  }
+}
+
 INSTANTIATE_TEST_CASE_P(
     LongPacketNumberCipherTests,
     LongPacketNumberCipherTest,
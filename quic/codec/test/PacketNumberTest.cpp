@@ -65,6 +65,27 @@ TEST_P(Packet32DecodeTest, Decode) {
   EXPECT_EQ(GetParam().expected, decoded) << std::hex << decoded;
 }
 
+TEST_P(Packet8DecodeTest, Decoder) {
+  PacketNumberDecoder decoder(GetParam().largestReceivedPacketNum + 1);
+  EXPECT_EQ(
+      GetParam().expected,
+      decoder.decode(GetParam().encoded, sizeof(GetParam().encoded)));
+}
+
+TEST_P(Packet16DecodeTest, Decoder) {
+  PacketNumberDecoder decoder(GetParam().largestReceivedPacketNum + 1);
+  EXPECT_EQ(
+      GetParam().expected,
+      decoder.decode(GetParam().encoded, sizeof(GetParam().encoded)));
+}
+
+TEST_P(Packet32DecodeTest, Decoder) {
+  PacketNumberDecoder decoder(GetParam().largestReceivedPacketNum + 1);
+  auto decoded =
+      decoder.decode(GetParam().encoded, sizeof(GetParam().encoded));
+  EXPECT_EQ(GetParam().expected, decoded) << std::hex << decoded;
+}
+
 INSTANTIATE_TEST_CASE_P(
     Packet8DecodeTests,
     Packet8DecodeTest,
@@ -107,5 +128,24 @@ TEST_F(EncodingTest, Draft17Example) {
   EXPECT_EQ(3, encodePacketNumber(0xace8fe, 0xabe8bc).length);
 }
 
+TEST_F(EncodingTest, Burst) {
+  PacketNum largestAcked = 0xabe8bc;
+  PacketNum first = 0xac5c02;
+  PacketNum last = 0xace8fe;
+  auto length = packetNumberLength(last, largestAcked);
+  EXPECT_EQ(3u, length);
+  std::vector<PacketNumEncodingResult> encoded;
+  for (auto packetNum = first; packetNum <= last; packetNum += 0x1000) {
+    encoded.push_back(truncatePacketNumber(packetNum, length));
+    EXPECT_EQ(packetNum & 0xffffff, encoded.back().result);
+  }
+  std::vector<PacketNum> decoded(encoded.size());
+  decodePacketNumbers(
+      folly::range(encoded), largestAcked + 1, folly::range(decoded));
+  for (size_t i = 0; i < decoded.size(); ++i) {
+    EXPECT_EQ(first + i * 0x1000, decoded[i]);
+  }
+}
+
 } // namespace test
 } // namespace quic
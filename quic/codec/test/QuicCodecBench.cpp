@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/codec/Decode.h>
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include <folly/io/Cursor.h>
+
+#include <quic/codec/PacketNumberCipher.h>
+#include <quic/codec/QuicInteger.h>
+#include <quic/codec/QuicPacketBuilder.h>
+#include <quic/codec/QuicReadCodec.h>
+#include <quic/codec/QuicWriteCodec.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/handshake/HandshakeLayer.h>
+#include <quic/handshake/QuicFizzFactory.h>
+
+using namespace quic;
+using namespace quic::test;
+
+/**
+ * Microbenchmarks for the codec: parsing whole packets through the read codec,
+ * decoding the individual frames and QUIC integers, building packets and
+ * header protection. The packets are protected with the real initial ciphers
+ * rather than the no-op test ones, so that parsing a packet includes the
+ * decryption it pays for on a real connection.
+ */
+
+namespace {
+
+constexpr size_t kStreamDataSize = 1000;
+constexpr size_t kNumSamples = 16;
+constexpr StreamId kStreamId = 4;
+
+CodecParameters makeCodecParameters() {
+  return CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST);
+}
+
+PacketHeader makeShortHeader(PacketNum packetNum = 0) {
+  return ShortHeader(
+      ProtectionType::KeyPhaseZero, getTestConnectionId(), packetNum);
+}
+
+RegularQuicPacketBuilder makeBuilder() {
+  return RegularQuicPacketBuilder(
+      kDefaultUDPSendPacketLen,
+      makeShortHeader(),
+      0 /* largestAcked */,
+      QuicVersion::MVFST);
+}
+
+// The codec a server reads the client's packets with. Both the Initial and
+// the 1-rtt packets are protected with the client Initial keys, which is as
+// expensive as the 1-rtt keys with the same cipher suite.
+std::unique_ptr<QuicReadCodec> makeServerCodec(const ConnectionId& connId) {
+  QuicFizzFactory fizzFactory;
+  auto codec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
+  codec->setCodecParameters(makeCodecParameters());
+  codec->setClientConnectionId(connId);
+  codec->setInitialReadCipher(
+      getClientInitialCipher(&fizzFactory, connId, QuicVersion::MVFST));
+  codec->setInitialHeaderCipher(
+      makeClientInitialHeaderCipher(&fizzFactory, connId, QuicVersion::MVFST));
+  codec->setOneRttReadCipher(
+      getClientInitialCipher(&fizzFactory, connId, QuicVersion::MVFST));
+  codec->setOneRttHeaderCipher(
+      makeClientInitialHeaderCipher(&fizzFactory, connId, QuicVersion::MVFST));
+  return codec;
+}
+
+Buf makeProtectedPacket(bool longHeader) {
+  auto connId = getTestConnectionId();
+  QuicFizzFactory fizzFactory;
+  auto aead = getClientInitialCipher(&fizzFactory, connId, QuicVersion::MVFST);
+  auto headerCipher =
+      makeClientInitialHeaderCipher(&fizzFactory, connId, QuicVersion::MVFST);
+  PacketNum packetNum = 10;
+  auto data = buildRandomInputData(kStreamDataSize);
+  auto packet = longHeader
+      ? createInitialCryptoPacket(
+            connId,
+            connId,
+            packetNum,
+            QuicVersion::MVFST,
+            *data,
+            *aead,
+            0 /* largestAcked */)
+      : createStreamPacket(
+            connId,
+            connId,
+            packetNum,
+            kStreamId,
+            *data,
+            aead->getCipherOverhead(),
+            0 /* largestAcked */);
+  return packetToBufCleartext(packet, *aead, *headerCipher, packetNum);
+}
+
+void ParsePacket(uint32_t iters, bool longHeader) {
+  std::unique_ptr<QuicReadCodec> codec;
+  Buf packet;
+  AckStates ackStates;
+  BENCHMARK_SUSPEND {
+    codec = makeServerCodec(getTestConnectionId());
+    packet = makeProtectedPacket(longHeader);
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    // Decryption is in place, every iteration needs a copy of its own.
+    folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+    BENCHMARK_SUSPEND {
+      queue.append(packet->cloneCoalesced());
+    }
+    folly::doNotOptimizeAway(codec->parsePacket(queue, ackStates));
+  }
+}
+
+Buf frameToBuf(QuicWriteFrame frame) {
+  auto builder = makeBuilder();
+  writeFrame(std::move(frame), builder);
+  return std::move(builder).buildPacket().body;
+}
+
+Buf makeAckFrame(size_t numBlocks) {
+  auto builder = makeBuilder();
+  IntervalSet<PacketNum> acks;
+  for (size_t i = 0; i < numBlocks; ++i) {
+    acks.insert(i * 10, i * 10 + 5);
+  }
+  AckFrameMetaData meta(
+      acks, std::chrono::microseconds(100), kDefaultAckDelayExponent);
+  writeAckFrame(meta, builder);
+  return std::move(builder).buildPacket().body;
+}
+
+Buf makeAck() {
+  return makeAckFrame(10);
+}
+
+Buf makeStream() {
+  auto builder = makeBuilder();
+  StreamFrameMetaData meta(
+      kStreamId,
+      0 /* offset */,
+      false /* fin */,
+      buildRandomInputData(kStreamDataSize),
+      true /* hasMoreFrames */);
+  writeStreamFrame(meta, builder);
+  return std::move(builder).buildPacket().body;
+}
+
+Buf makeCrypto() {
+  auto builder = makeBuilder();
+  writeCryptoFrame(0, buildRandomInputData(kStreamDataSize), builder);
+  return std::move(builder).buildPacket().body;
+}
+
+Buf makePadding() {
+  return frameToBuf(PaddingFrame());
+}
+
+Buf makePing() {
+  return frameToBuf(PingFrame());
+}
+
+Buf makeRstStream() {
+  return frameToBuf(RstStreamFrame(kStreamId, 0, 1000));
+}
+
+Buf makeConnectionClose() {
+  return frameToBuf(
+      ConnectionCloseFrame(TransportErrorCode::NO_ERROR, "no error"));
+}
+
+Buf makeMaxData() {
+  return frameToBuf(MaxDataFrame(1000000));
+}
+
+Buf makeMaxStreamData() {
+  return frameToBuf(MaxStreamDataFrame(kStreamId, 1000000));
+}
+
+Buf makeMaxStreams() {
+  return frameToBuf(MaxStreamsFrame(100, true));
+}
+
+Buf makeDataBlocked() {
+  return frameToBuf(DataBlockedFrame(1000000));
+}
+
+Buf makeStreamDataBlocked() {
+  return frameToBuf(StreamDataBlockedFrame(kStreamId, 1000000));
+}
+
+Buf makeStopSending() {
+  return frameToBuf(QuicSimpleFrame(StopSendingFrame(kStreamId, 0)));
+}
+
+Buf makePathChallenge() {
+  return frameToBuf(QuicSimpleFrame(PathChallengeFrame(0x1234)));
+}
+
+Buf makeNewConnectionId() {
+  StatelessResetToken token{};
+  return frameToBuf(QuicSimpleFrame(
+      NewConnectionIdFrame(1, getTestConnectionId(1), token)));
+}
+
+void ParseFrame(uint32_t iters, Buf (*makeFrame)()) {
+  Buf frame;
+  PacketHeader header = makeShortHeader();
+  auto params = makeCodecParameters();
+  BENCHMARK_SUSPEND {
+    frame = makeFrame();
+    frame->coalesce();
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::io::Cursor cursor(frame.get());
+    folly::doNotOptimizeAway(parseFrame(cursor, header, params));
+  }
+}
+
+void DecodeAckFrame(uint32_t iters, size_t numBlocks) {
+  Buf frame;
+  PacketHeader header = makeShortHeader();
+  auto params = makeCodecParameters();
+  BENCHMARK_SUSPEND {
+    frame = makeAckFrame(numBlocks);
+    frame->coalesce();
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::io::Cursor cursor(frame.get());
+    // Skip the frame type, decodeAckFrame starts after it.
+    cursor.skip(1);
+    folly::doNotOptimizeAway(decodeAckFrame(cursor, header, params));
+  }
+}
+
+// A value taking encodedSize bytes.
+uint64_t quicIntegerValue(size_t encodedSize) {
+  switch (encodedSize) {
+    case 1:
+      return 37;
+    case 2:
+      return 15293;
+    case 4:
+      return 494878333;
+    default:
+      return 151288809941952652;
+  }
+}
+
+void EncodeQuicInteger(uint32_t iters, size_t encodedSize) {
+  auto value = quicIntegerValue(encodedSize);
+  std::array<uint8_t, 8> out;
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(encodeQuicInteger(value, out.data()));
+  }
+}
+
+void DecodeQuicInteger(uint32_t iters, size_t encodedSize) {
+  std::array<uint8_t, 8> data;
+  auto size = encodeQuicInteger(quicIntegerValue(encodedSize), data.data());
+  CHECK(size.hasValue());
+  auto range = folly::ByteRange(data.data(), *size);
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(decodeQuicInteger(range));
+  }
+}
+
+void DecodeQuicIntegerFromCursor(uint32_t iters, size_t encodedSize) {
+  auto buf = folly::IOBuf::create(8);
+  auto size =
+      encodeQuicInteger(quicIntegerValue(encodedSize), buf->writableData());
+  CHECK(size.hasValue());
+  buf->append(*size);
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::io::Cursor cursor(buf.get());
+    folly::doNotOptimizeAway(decodeQuicInteger(cursor));
+  }
+}
+
+void BuildPacket(uint32_t iters, size_t numStreamFrames) {
+  Buf data;
+  BENCHMARK_SUSPEND {
+    // Leave space for the frame headers so that every frame fits.
+    data = buildRandomInputData(
+        kDefaultUDPSendPacketLen / (numStreamFrames + 1));
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    auto builder = makeBuilder();
+    for (size_t j = 0; j < numStreamFrames; ++j) {
+      StreamFrameMetaData meta(
+          kStreamId + j * 4,
+          0 /* offset */,
+          false /* fin */,
+          data->clone(),
+          true /* hasMoreFrames */);
+      writeStreamFrame(meta, builder);
+    }
+    folly::doNotOptimizeAway(std::move(builder).buildPacket());
+  }
+}
+
+std::unique_ptr<PacketNumberCipher> makeHeaderCipher() {
+  auto cipher = std::make_unique<Aes128PacketNumberCipher>();
+  std::array<uint8_t, 16> key{};
+  cipher->setKey(folly::range(key));
+  return cipher;
+}
+
+void headerProtectionMask(uint32_t iters) {
+  std::unique_ptr<PacketNumberCipher> cipher;
+  Sample sample{};
+  BENCHMARK_SUSPEND {
+    cipher = makeHeaderCipher();
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    sample[0] = static_cast<uint8_t>(i);
+    folly::doNotOptimizeAway(cipher->mask(folly::range(sample)));
+  }
+}
+
+// Iterations are batches of kNumSamples masks.
+void headerProtectionMasks(uint32_t iters) {
+  std::unique_ptr<PacketNumberCipher> cipher;
+  std::array<Sample, kNumSamples> samples{};
+  std::array<HeaderProtectionMask, kNumSamples> masks;
+  BENCHMARK_SUSPEND {
+    cipher = makeHeaderCipher();
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    samples[0][0] = static_cast<uint8_t>(i);
+    cipher->masks(folly::range(samples), folly::range(masks));
+    folly::doNotOptimizeAway(masks);
+  }
+}
+
+void headerProtectionShortHeader(uint32_t iters) {
+  std::unique_ptr<PacketNumberCipher> cipher;
+  Sample sample{};
+  std::array<uint8_t, 1> initialByte{0x40};
+  std::array<uint8_t, 4> packetNumberBytes{};
+  BENCHMARK_SUSPEND {
+    cipher = makeHeaderCipher();
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    sample[0] = static_cast<uint8_t>(i);
+    cipher->encryptShortHeader(
+        folly::range(sample),
+        folly::range(initialByte),
+        folly::range(packetNumberBytes));
+    cipher->decryptShortHeader(
+        folly::range(sample),
+        folly::range(initialByte),
+        folly::range(packetNumberBytes));
+  }
+  folly::doNotOptimizeAway(packetNumberBytes);
+}
+
+} // namespace
+
+BENCHMARK_NAMED_PARAM(ParsePacket, ShortHeader, false)
+BENCHMARK_NAMED_PARAM(ParsePacket, LongHeader, true)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(ParseFrame, Padding, makePadding)
+BENCHMARK_NAMED_PARAM(ParseFrame, Ping, makePing)
+BENCHMARK_NAMED_PARAM(ParseFrame, Ack, makeAck)
+BENCHMARK_NAMED_PARAM(ParseFrame, RstStream, makeRstStream)
+BENCHMARK_NAMED_PARAM(ParseFrame, StopSending, makeStopSending)
+BENCHMARK_NAMED_PARAM(ParseFrame, Crypto, makeCrypto)
+BENCHMARK_NAMED_PARAM(ParseFrame, Stream, makeStream)
+BENCHMARK_NAMED_PARAM(ParseFrame, MaxData, makeMaxData)
+BENCHMARK_NAMED_PARAM(ParseFrame, MaxStreamData, makeMaxStreamData)
+BENCHMARK_NAMED_PARAM(ParseFrame, MaxStreams, makeMaxStreams)
+BENCHMARK_NAMED_PARAM(ParseFrame, DataBlocked, makeDataBlocked)
+BENCHMARK_NAMED_PARAM(ParseFrame, StreamDataBlocked, makeStreamDataBlocked)
+BENCHMARK_NAMED_PARAM(ParseFrame, NewConnectionId, makeNewConnectionId)
+BENCHMARK_NAMED_PARAM(ParseFrame, PathChallenge, makePathChallenge)
+BENCHMARK_NAMED_PARAM(ParseFrame, ConnectionClose, makeConnectionClose)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(DecodeAckFrame, 1Block, 1)
+BENCHMARK_NAMED_PARAM(DecodeAckFrame, 10Blocks, 10)
+BENCHMARK_NAMED_PARAM(DecodeAckFrame, 100Blocks, 100)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(EncodeQuicInteger, 1Byte, 1)
+BENCHMARK_NAMED_PARAM(EncodeQuicInteger, 2Bytes, 2)
+BENCHMARK_NAMED_PARAM(EncodeQuicInteger, 4Bytes, 4)
+BENCHMARK_NAMED_PARAM(EncodeQuicInteger, 8Bytes, 8)
+BENCHMARK_NAMED_PARAM(DecodeQuicInteger, 1Byte, 1)
+BENCHMARK_NAMED_PARAM(DecodeQuicInteger, 2Bytes, 2)
+BENCHMARK_NAMED_PARAM(DecodeQuicInteger, 4Bytes, 4)
+BENCHMARK_NAMED_PARAM(DecodeQuicInteger, 8Bytes, 8)
+BENCHMARK_NAMED_PARAM(DecodeQuicIntegerFromCursor, 1Byte, 1)
+BENCHMARK_NAMED_PARAM(DecodeQuicIntegerFromCursor, 8Bytes, 8)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(BuildPacket, 1StreamFrame, 1)
+BENCHMARK_NAMED_PARAM(BuildPacket, 10StreamFrames, 10)
+BENCHMARK_NAMED_PARAM(BuildPacket, 50StreamFrames, 50)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(HeaderProtectionMask, iters) {
+  headerProtectionMask(iters);
+}
+
+BENCHMARK(HeaderProtectionMasks, iters) {
+  headerProtectionMasks(iters);
+}
+
+BENCHMARK(HeaderProtectionShortHeader, iters) {
+  headerProtectionShortHeader(iters);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -53,6 +53,48 @@ TEST_P(ConnectionIdLengthTest, EncodeDecode) {
   EXPECT_EQ(length, GetParam().lengthByte);
 }
 
+TEST(ConnectionIdTest, CompareAndHash) {
+  ConnectionId connId({1, 2, 3, 4, 5, 6, 7, 8});
+  ConnectionId sameConnId({1, 2, 3, 4, 5, 6, 7, 8});
+  ConnectionId otherConnId({1, 2, 3, 4, 5, 6, 7, 9});
+  ConnectionId prefixConnId({1, 2, 3, 4, 5, 6, 7});
+  ConnectionIdHash hash;
+  EXPECT_EQ(connId, sameConnId);
+  EXPECT_EQ(hash(connId), hash(sameConnId));
+  EXPECT_NE(connId, otherConnId);
+  EXPECT_NE(hash(connId), hash(otherConnId));
+  EXPECT_NE(connId, prefixConnId);
+  EXPECT_EQ(connId.hex(), "0102030405060708");
+  EXPECT_EQ(prefixConnId.size(), 7);
+
+  ConnectionId longConnId(std::vector<uint8_t>(kMaxConnectionIdSize, 0xff));
+  EXPECT_EQ(longConnId.size(), kMaxConnectionIdSize);
+  EXPECT_EQ(longConnId, ConnectionId(longConnId));
+  EXPECT_THROW(
+      ConnectionId(std::vector<uint8_t>(kMaxConnectionIdSize + 1, 0xff)),
+      std::runtime_error);
+}
+
+TEST(ConnectionIdTest, View) {
+  ConnectionId connId({1, 2, 3, 4, 5, 6, 7, 8});
+  std::vector<uint8_t> packet = {0x40, 1, 2, 3, 4, 5, 6, 7, 8, 0xff};
+  ConnectionIdView view(packet.data() + 1, kDefaultConnectionIdSize);
+  ConnectionIdHash hash;
+  EXPECT_EQ(view, ConnectionIdView(connId));
+  EXPECT_EQ(hash(view), hash(connId));
+  EXPECT_EQ(view.hex(), connId.hex());
+  EXPECT_EQ(ConnectionId(view), connId);
+  ConnectionIdView shiftedView(packet.data() + 2, kDefaultConnectionIdSize);
+  EXPECT_NE(shiftedView, view);
+
+  ConnectionId shortConnId({1, 2, 3, 4, 5});
+  ConnectionIdView shortView(packet.data() + 1, 5);
+  EXPECT_EQ(ConnectionId(shortView), shortConnId);
+  EXPECT_EQ(hash(shortView), hash(shortConnId));
+  EXPECT_THROW(
+      ConnectionId(ConnectionIdView(packet.data(), 2)), std::runtime_error);
+}
+
 INSTANTIATE_TEST_CASE_P(
     ConnectionIdLengthTests,
     ConnectionIdLengthTest,
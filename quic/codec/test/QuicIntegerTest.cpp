@@ -6,6 +6,8 @@
  *
  */
 
+#include <array>
+
 #include <folly/Expected.h>
 #include <folly/Optional.h>
 #include <folly/String.h>
@@ -73,6 +75,37 @@ TEST_P(QuicIntegerDecodeTest, DecodeAtMost) {
   }
 }
 
+TEST_P(QuicIntegerDecodeTest, DecodeRange) {
+  std::string encodedBytes = folly::unhexlify(GetParam().hexEncoded);
+  folly::ByteRange data = folly::ByteRange(folly::StringPiece(encodedBytes));
+  for (size_t length = 0; length < data.size(); ++length) {
+    EXPECT_FALSE(decodeQuicInteger(data.subpiece(0, length)).hasValue());
+  }
+  auto decodedValue = decodeQuicInteger(data);
+  if (GetParam().error) {
+    EXPECT_FALSE(decodedValue.hasValue());
+    return;
+  }
+  EXPECT_EQ(decodedValue->first, GetParam().decoded);
+  EXPECT_EQ(decodedValue->second, GetParam().encodedLength);
+
+  // The same integer three times in a row.
+  std::string repeated = encodedBytes + encodedBytes + encodedBytes;
+  std::array<uint64_t, 3> values;
+  auto bytesUsed = decodeQuicIntegers(
+      folly::ByteRange(folly::StringPiece(repeated)), folly::range(values));
+  ASSERT_TRUE(bytesUsed.hasValue());
+  EXPECT_EQ(*bytesUsed, repeated.size());
+  for (auto value : values) {
+    EXPECT_EQ(value, GetParam().decoded);
+  }
+  repeated.pop_back();
+  EXPECT_FALSE(decodeQuicIntegers(
+                   folly::ByteRange(folly::StringPiece(repeated)),
+                   folly::range(values))
+                   .hasValue());
+}
+
 TEST_P(QuicIntegerEncodeTest, Encode) {
   IOBufQueue queue;
   folly::io::QueueAppender appender(&queue, 10);
@@ -92,6 +125,19 @@ TEST_P(QuicIntegerEncodeTest, Encode) {
   EXPECT_EQ(*written, encodedValue.size() / 2);
 }
 
+TEST_P(QuicIntegerEncodeTest, EncodeToBuffer) {
+  std::array<uint8_t, sizeof(uint64_t)> buf;
+  auto written = encodeQuicInteger(GetParam().decoded, buf.data());
+  if (GetParam().error) {
+    EXPECT_TRUE(written.hasError());
+    EXPECT_EQ(written.error(), TransportErrorCode::INTERNAL_ERROR);
+    return;
+  }
+  auto encodedValue = folly::hexlify(
+      folly::ByteRange(buf.data(), buf.data() + written.value()));
+  EXPECT_EQ(encodedValue, GetParam().hexEncoded);
+}
+
 TEST_P(QuicIntegerEncodeTest, GetSize) {
   auto size = getQuicIntegerSize(GetParam().decoded);
   if (GetParam().error) {
@@ -111,6 +111,24 @@ TEST_F(QuicPacketBuilderTest, SimpleVersionNegotiationPacket) {
   EXPECT_EQ(decodedVersionNegotiationPacket.versions, versions);
 }
 
+TEST_F(QuicPacketBuilderTest, CachedVersionNegotiationPacket) {
+  auto versions = versionList({1, 2, 3, 4, 5, 6, 7});
+  CachedVersionNegotiationPacket cached(versions);
+  auto srcConnId = getTestConnectionId(0), destConnId = getTestConnectionId(1);
+  auto built = VersionNegotiationPacketBuilder(srcConnId, destConnId, versions)
+                   .buildPacket();
+  auto cachedBuf = cached.build(srcConnId, destConnId);
+  EXPECT_TRUE(folly::IOBufEqualTo()(built.second, cachedBuf));
+
+  // The same cache answers packets with other connection ids.
+  ConnectionId shortConnId({1, 2, 3, 4});
+  auto otherBuilt =
+      VersionNegotiationPacketBuilder(shortConnId, srcConnId, versions)
+          .buildPacket();
+  EXPECT_TRUE(folly::IOBufEqualTo()(
+      otherBuilt.second, cached.build(shortConnId, srcConnId)));
+}
+
 TEST_F(QuicPacketBuilderTest, SimpleRetryPacket) {
   LongHeader headerIn(
       LongHeader::Types::Retry,
@@ -356,3 +374,49 @@ TEST_F(QuicPacketBuilderTest, PacketBuilderWrapper) {
   EXPECT_CALL(builder, remainingSpaceInPkt()).WillRepeatedly(Return(50));
   EXPECT_EQ(0, wrapper.remainingSpaceInPkt());
 }
+
+TEST_F(QuicPacketBuilderTest, ContiguousBuffer) {
+  auto connId = getTestConnectionId();
+  PacketNum pktNum = 222;
+  size_t cipherOverhead = 16;
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen,
+      PacketHeader(ShortHeader(ProtectionType::KeyPhaseZero, connId, pktNum)),
+      0 /* largestAcked */);
+  builder.setCipherOverhead(cipherOverhead);
+  builder.useContiguousBuffer();
+  writeFrame(PaddingFrame(), builder);
+  auto data = folly::IOBuf::copyBuffer("hello");
+  data->prependChain(folly::IOBuf::copyBuffer("world"));
+  builder.insert(std::move(data));
+  auto builtOut = std::move(builder).buildPacket();
+
+  // inserted data is copied into the single body buffer
+  ASSERT_FALSE(builtOut.body->isChained());
+  EXPECT_FALSE(builtOut.body->isShared());
+  EXPECT_GE(builtOut.body->tailroom(), cipherOverhead);
+  // the header lives right in front of the body
+  ASSERT_FALSE(builtOut.header->isChained());
+  EXPECT_EQ(
+      builtOut.header->data() + builtOut.header->length(),
+      builtOut.body->data());
+
+  auto headerLen = builtOut.header->length();
+  auto bodyLen = builtOut.body->length();
+  auto expected = builtOut.header->clone();
+  expected->prependChain(builtOut.body->clone());
+  auto joined = joinPacketHeaderAndBody(
+      std::move(builtOut.header), std::move(builtOut.body));
+  EXPECT_FALSE(joined->isChained());
+  EXPECT_EQ(joined->length(), headerLen + bodyLen);
+  folly::IOBufEqualTo eq;
+  EXPECT_TRUE(eq(*joined, *expected));
+}
+
+TEST_F(QuicPacketBuilderTest, JoinSeparateHeaderAndBody) {
+  auto header = folly::IOBuf::copyBuffer("header");
+  auto body = folly::IOBuf::copyBuffer("body");
+  auto joined = joinPacketHeaderAndBody(std::move(header), std::move(body));
+  EXPECT_TRUE(joined->isChained());
+  EXPECT_EQ(joined->computeChainDataLength(), 10);
+}
@@ -32,6 +32,12 @@ bool isReset(const CodecResult& result) {
 
 class QuicReadCodecTest : public Test {};
 
+Buf appendStatelessResetToken(Buf packet, const StatelessResetToken& token) {
+  packet->prependChain(folly::IOBuf::copyBuffer(token.data(), token.size()));
+  packet->coalesce();
+  return packet;
+}
+
 std::unique_ptr<QuicReadCodec> makeUnencryptedCodec() {
   auto codec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
   codec->setCodecParameters(
@@ -349,7 +355,8 @@ TEST_F(QuicReadCodecTest, FailToDecryptLeadsToReset) {
       true,
       ProtectionType::KeyPhaseZero);
   AckStates ackStates;
-  auto packetQueue = bufToQueue(packetToBuf(streamPacket));
+  auto packetQueue =
+      bufToQueue(appendStatelessResetToken(packetToBuf(streamPacket), tok));
   auto packet = codec->parsePacket(packetQueue, ackStates);
   EXPECT_TRUE(isReset(packet));
 }
@@ -383,11 +390,49 @@ TEST_F(QuicReadCodecTest, ShortPacketAutoPaddedIsReset) {
       true,
       ProtectionType::KeyPhaseZero);
   AckStates ackStates;
-  auto packetQueue = bufToQueue(packetToBuf(streamPacket));
+  auto packetQueue =
+      bufToQueue(appendStatelessResetToken(packetToBuf(streamPacket), tok));
   auto packet = codec->parsePacket(packetQueue, ackStates);
   EXPECT_TRUE(isReset(packet));
 }
 
+TEST_F(QuicReadCodecTest, FailToDecryptWrongTokenNoReset) {
+  auto connId = getTestConnectionId();
+  auto aead = std::make_unique<MockAead>();
+  auto rawAead = aead.get();
+
+  StatelessResetToken tok(
+      {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16});
+  auto fakeToken = std::make_unique<StatelessResetToken>(tok);
+  auto codec = makeEncryptedCodec(
+      connId, std::move(aead), nullptr, std::move(fakeToken));
+  EXPECT_CALL(*rawAead, _tryDecrypt(_, _, _))
+      .Times(1)
+      .WillOnce(Invoke([](auto&, const auto&, auto) { return folly::none; }));
+  PacketNum packetNum = 1;
+  StreamId streamId = 2;
+  auto data = folly::IOBuf::create(30);
+  data->append(30);
+  auto streamPacket = createStreamPacket(
+      connId,
+      connId,
+      packetNum,
+      streamId,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      folly::none,
+      true,
+      ProtectionType::KeyPhaseZero);
+  StatelessResetToken otherTok = tok;
+  otherTok.back() ^= 0xff;
+  AckStates ackStates;
+  auto packetQueue = bufToQueue(
+      appendStatelessResetToken(packetToBuf(streamPacket), otherTok));
+  auto packet = codec->parsePacket(packetQueue, ackStates);
+  EXPECT_FALSE(isReset(packet));
+}
+
 TEST_F(QuicReadCodecTest, FailToDecryptLongHeaderNoReset) {
   auto connId = getTestConnectionId();
   auto aead = std::make_unique<MockAead>();
@@ -565,3 +610,88 @@ TEST_F(QuicReadCodecTest, TestZeroRttPacketsAfterHandshakeDone) {
   codec->onHandshakeDone(Clock::now() - kTimeToRetainZeroRttKeys * 2);
   EXPECT_FALSE(parseSuccess(codec->parsePacket(packetQueue, ackStates)));
 }
+
+TEST_F(QuicReadCodecTest, RetiredCiphersReleased) {
+  auto connId = getTestConnectionId();
+  auto codec = makeEncryptedCodec(connId, createNoOpAead(), createNoOpAead());
+  auto now = Clock::now();
+  codec->releaseRetiredCiphers(now);
+  EXPECT_NE(nullptr, codec->getInitialCipher());
+  EXPECT_NE(nullptr, codec->getZeroRttReadCipher());
+
+  codec->onHandshakeDone(now);
+  codec->releaseRetiredCiphers(now + 1s);
+  EXPECT_NE(nullptr, codec->getInitialCipher());
+  EXPECT_NE(nullptr, codec->getZeroRttReadCipher());
+
+  codec->releaseRetiredCiphers(now + kTimeToRetainZeroRttKeys * 2);
+  EXPECT_EQ(nullptr, codec->getInitialCipher());
+  EXPECT_EQ(nullptr, codec->getInitialHeaderCipher());
+  EXPECT_EQ(nullptr, codec->getZeroRttReadCipher());
+  EXPECT_EQ(nullptr, codec->getZeroRttHeaderCipher());
+  EXPECT_NE(nullptr, codec->getOneRttReadCipher());
+}
+
+TEST_F(QuicReadCodecTest, TestCoalescedPacketsInOneBuffer) {
+  auto connId = getTestConnectionId();
+  StreamId streamId = 2;
+
+  auto data = folly::IOBuf::copyBuffer("hello");
+  auto zeroRttPacket = createStreamPacket(
+      connId,
+      connId,
+      1,
+      streamId,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      std::make_pair(LongHeader::Types::ZeroRtt, QuicVersion::MVFST));
+  auto oneRttPacket = createStreamPacket(
+      connId, connId, 2, streamId, *data, 0 /* cipherOverhead */, 0);
+
+  auto buf = packetToBuf(zeroRttPacket);
+  buf->prependChain(packetToBuf(oneRttPacket));
+  // Coalesced packets arrive in a single receive buffer.
+  buf->coalesce();
+
+  auto codec = makeEncryptedCodec(connId, createNoOpAead(), createNoOpAead());
+  AckStates ackStates;
+  auto packetQueue = bufToQueue(std::move(buf));
+  auto res = codec->parsePacket(packetQueue, ackStates);
+  EXPECT_TRUE(parseSuccess(res));
+  EXPECT_FALSE(packetQueue.empty());
+  EXPECT_TRUE(parseSuccess(codec->parsePacket(packetQueue, ackStates)));
+  EXPECT_TRUE(packetQueue.empty());
+
+  auto& regularPacket =
+      boost::get<RegularQuicPacket>(boost::get<QuicPacket>(res));
+  ASSERT_EQ(regularPacket.frames.size(), 1u);
+  auto streamFrame = boost::get<ReadStreamFrame>(regularPacket.frames[0]);
+  EXPECT_EQ(streamFrame.streamId, streamId);
+  EXPECT_TRUE(folly::IOBufEqualTo()(*streamFrame.data, *data));
+}
+
+TEST_F(QuicReadCodecTest, StreamDataIsDecryptedInReceiveBuffer) {
+  auto connId = getTestConnectionId();
+  StreamId streamId = 2;
+
+  auto data = folly::IOBuf::copyBuffer("hello");
+  auto streamPacket = createStreamPacket(
+      connId, connId, 1, streamId, *data, 0 /* cipherOverhead */, 0);
+  auto buf = packetToBuf(streamPacket);
+  buf->coalesce();
+  auto receiveBuffer = folly::ByteRange(buf->data(), buf->length());
+
+  AckStates ackStates;
+  auto packetQueue = bufToQueue(std::move(buf));
+  auto res = makeEncryptedCodec(connId, createNoOpAead())
+                 ->parsePacket(packetQueue, ackStates);
+  ASSERT_TRUE(parseSuccess(res));
+  auto& regularPacket =
+      boost::get<RegularQuicPacket>(boost::get<QuicPacket>(res));
+  ASSERT_EQ(regularPacket.frames.size(), 1u);
+  auto streamFrame = boost::get<ReadStreamFrame>(regularPacket.frames[0]);
+  ASSERT_FALSE(streamFrame.data->isChained());
+  EXPECT_GE(streamFrame.data->data(), receiveBuffer.begin());
+  EXPECT_LE(streamFrame.data->tail(), receiveBuffer.end());
+}
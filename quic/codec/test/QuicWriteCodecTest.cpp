@@ -28,7 +28,7 @@ ShortHeader buildTestShortHeader() {
 }
 
 QuicFrame parseQuicFrame(folly::io::Cursor& cursor) {
-  return quic::parseFrame(
+  return *quic::parseFrame(
       cursor,
       buildTestShortHeader(),
       CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
@@ -144,6 +144,52 @@ TEST_F(QuicWriteCodecTest, WriteStreamFrameToEmptyPacket) {
   EXPECT_TRUE(folly::IOBufEqualTo()(inputBuf, decodedStreamFrame.data));
 }
 
+TEST_F(QuicWriteCodecTest, WriteStreamFrameLengthSizedForData) {
+  MockQuicPacketBuilder pktBuilder;
+  // 1 byte for type
+  // 1 byte for stream id
+  // 1 byte for length, since the data is shorter than 64 bytes
+  // => 3 bytes, so all the data fits
+  pktBuilder.remaining_ = 65;
+  setupCommonExpects(pktBuilder);
+  auto inputBuf = buildRandomInputData(62);
+  StreamFrameMetaData streamFrameMetaData(
+      1, 0, false, inputBuf->clone(), true);
+  auto result = writeStreamFrame(streamFrameMetaData, pktBuilder);
+  ASSERT_TRUE(result.hasValue());
+  EXPECT_EQ(62, result->bytesWritten);
+  EXPECT_EQ(0, pktBuilder.remainingSpaceInPkt());
+}
+
+TEST_F(QuicWriteCodecTest, WriteStreamFrameFromBuffer) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+
+  auto inputBuf = buildRandomInputData(10);
+  inputBuf->prependChain(buildRandomInputData(5));
+  StreamId streamId = 1;
+  uint64_t offset = 100;
+  StreamFrameMetaData streamFrameMetaData(
+      streamId, offset, true /* fin */, nullptr, true /* hasMoreFrames */);
+  auto streamFrameWriteResult = writeStreamFrameFromBuffer(
+      streamFrameMetaData, inputBuf.get(), pktBuilder);
+  ASSERT_TRUE(streamFrameWriteResult.hasValue());
+  EXPECT_EQ(15, streamFrameWriteResult->bytesWritten);
+  EXPECT_TRUE(streamFrameWriteResult->finWritten);
+  EXPECT_EQ(nullptr, streamFrameWriteResult->writtenData);
+  // The source buffer is left untouched.
+  EXPECT_EQ(15, inputBuf->computeChainDataLength());
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor cursor(wireBuf.get());
+  auto decodedStreamFrame = boost::get<ReadStreamFrame>(parseQuicFrame(cursor));
+  EXPECT_EQ(decodedStreamFrame.streamId, streamId);
+  EXPECT_EQ(decodedStreamFrame.offset, offset);
+  EXPECT_TRUE(decodedStreamFrame.fin);
+  EXPECT_TRUE(folly::IOBufEqualTo()(inputBuf, decodedStreamFrame.data));
+}
+
 TEST_F(QuicWriteCodecTest, WriteStreamFrameToPartialPacket) {
   MockQuicPacketBuilder pktBuilder;
   // 1000 bytes already gone in this packet
@@ -258,7 +304,7 @@ TEST_F(QuicWriteCodecTest, WriteTwoStreamFrames) {
   // Verify the on wire bytes via decoder:
   auto wireBuf = std::move(builtOut.second);
   folly::io::Cursor cursor(wireBuf.get());
-  auto decodedStreamFrame1 = boost::get<ReadStreamFrame>(quic::parseFrame(
+  auto decodedStreamFrame1 = boost::get<ReadStreamFrame>(*quic::parseFrame(
       cursor,
       regularPacket.header,
       CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)));
@@ -267,7 +313,7 @@ TEST_F(QuicWriteCodecTest, WriteTwoStreamFrames) {
   EXPECT_EQ(decodedStreamFrame1.data->computeChainDataLength(), 30);
   EXPECT_TRUE(folly::IOBufEqualTo()(inputBuf, decodedStreamFrame1.data));
   // Read another one from wire output:
-  auto decodedStreamFrame2 = boost::get<ReadStreamFrame>(quic::parseFrame(
+  auto decodedStreamFrame2 = boost::get<ReadStreamFrame>(*quic::parseFrame(
       cursor,
       regularPacket.header,
       CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)));
@@ -398,7 +444,7 @@ TEST_F(QuicWriteCodecTest, WriteStreamSpaceForOneByte) {
 
   auto wireBuf = std::move(builtOut.second);
   folly::io::Cursor cursor(wireBuf.get());
-  auto decodedStreamFrame = boost::get<ReadStreamFrame>(quic::parseFrame(
+  auto decodedStreamFrame = boost::get<ReadStreamFrame>(*quic::parseFrame(
       cursor,
       regularPacket.header,
       CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)));
@@ -439,7 +485,7 @@ TEST_F(QuicWriteCodecTest, WriteFinToEmptyPacket) {
 
   auto wireBuf = std::move(builtOut.second);
   folly::io::Cursor cursor(wireBuf.get());
-  auto decodedStreamFrame = boost::get<ReadStreamFrame>(quic::parseFrame(
+  auto decodedStreamFrame = boost::get<ReadStreamFrame>(*quic::parseFrame(
       cursor,
       regularPacket.header,
       CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)));
@@ -659,6 +705,47 @@ TEST_F(QuicWriteCodecTest, WriteSimpleAckFrame) {
   EXPECT_EQ(decodedAckFrame.ackBlocks[1].endPacket, 400);
 }
 
+TEST_F(QuicWriteCodecTest, WriteAckEcnFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  auto ackDelay = 111us;
+  IntervalSet<PacketNum> ackBlocks = {{501, 1000}, {101, 400}};
+  AckFrameMetaData meta(ackBlocks, ackDelay, kDefaultAckDelayExponent);
+  meta.ecnCounts = ECNCounts{10, 0, 300};
+
+  // The 11 bytes of the simple ack frame, plus 1 byte for the ECT(0) count,
+  // 1 byte for the ECT(1) count and 2 bytes for the CE count.
+  auto result = *writeAckFrame(meta, pktBuilder);
+  EXPECT_EQ(15, result.bytesWritten);
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  WriteAckFrame ackFrame =
+      boost::get<WriteAckFrame>(builtOut.first.frames.back());
+  ASSERT_TRUE(ackFrame.ecnCounts.hasValue());
+  EXPECT_EQ(ackFrame.ecnCounts->ce, 300);
+
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor cursor(wireBuf.get());
+  auto decodedAckFrame = boost::get<ReadAckFrame>(parseQuicFrame(cursor));
+  EXPECT_EQ(decodedAckFrame.largestAcked, 1000);
+  EXPECT_EQ(decodedAckFrame.ackBlocks.size(), 2);
+  ASSERT_TRUE(decodedAckFrame.ecnCounts.hasValue());
+  EXPECT_EQ(decodedAckFrame.ecnCounts->ect0, 10);
+  EXPECT_EQ(decodedAckFrame.ecnCounts->ect1, 0);
+  EXPECT_EQ(decodedAckFrame.ecnCounts->ce, 300);
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(QuicWriteCodecTest, AckEcnFrameNoSpaceForCounts) {
+  MockQuicPacketBuilder pktBuilder;
+  // Enough for the simple ack frame, but not for the counts.
+  pktBuilder.remaining_ = 7;
+  setupCommonExpects(pktBuilder);
+  IntervalSet<PacketNum> ackBlocks = {{501, 1000}};
+  AckFrameMetaData meta(ackBlocks, 111us, kDefaultAckDelayExponent);
+  meta.ecnCounts = ECNCounts{100, 0, 300};
+  EXPECT_FALSE(writeAckFrame(meta, pktBuilder).hasValue());
+}
+
 TEST_F(QuicWriteCodecTest, WriteAckFrameWillSaveAckDelay) {
   MockQuicPacketBuilder pktBuilder;
   setupCommonExpects(pktBuilder);
@@ -728,7 +815,7 @@ TEST_F(QuicWriteCodecTest, WriteWithDifferentAckDelayExponent) {
   auto builtOut = std::move(pktBuilder).buildPacket();
   auto wireBuf = std::move(builtOut.second);
   folly::io::Cursor cursor(wireBuf.get());
-  auto decodedAckFrame = boost::get<ReadAckFrame>(quic::parseFrame(
+  auto decodedAckFrame = boost::get<ReadAckFrame>(*quic::parseFrame(
       cursor,
       builtOut.first.header,
       CodecParameters(ackDelayExponent, QuicVersion::MVFST)));
@@ -749,7 +836,7 @@ TEST_F(QuicWriteCodecTest, WriteExponentInLongHeaderPacket) {
   auto builtOut = std::move(pktBuilder).buildLongHeaderPacket();
   auto wireBuf = std::move(builtOut.second);
   folly::io::Cursor cursor(wireBuf.get());
-  auto decodedAckFrame = boost::get<ReadAckFrame>(quic::parseFrame(
+  auto decodedAckFrame = boost::get<ReadAckFrame>(*quic::parseFrame(
       cursor,
       builtOut.first.header,
       CodecParameters(ackDelayExponent, QuicVersion::MVFST)));
@@ -1315,6 +1402,35 @@ TEST_F(QuicWriteCodecTest, WriteNewConnId) {
   EXPECT_TRUE(cursor.isAtEnd());
 }
 
+TEST_F(QuicWriteCodecTest, WriteRetireConnId) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  RetireConnectionIdFrame retireConnId(3);
+  auto bytesWritten = writeSimpleFrame(retireConnId, pktBuilder);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  EXPECT_EQ(bytesWritten, 2);
+  auto resultRetireConnIdFrame = boost::get<RetireConnectionIdFrame>(
+      boost::get<QuicSimpleFrame>(regularPacket.frames[0]));
+  EXPECT_EQ(resultRetireConnIdFrame.sequenceId, 3);
+
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor cursor(wireBuf.get());
+  auto wireRetireConnIdFrame = boost::get<RetireConnectionIdFrame>(
+      boost::get<QuicSimpleFrame>(parseQuicFrame(cursor)));
+  EXPECT_EQ(3, wireRetireConnIdFrame.sequenceId);
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(QuicWriteCodecTest, NoSpaceForRetireConnId) {
+  MockQuicPacketBuilder pktBuilder;
+  pktBuilder.remaining_ = 1;
+  setupCommonExpects(pktBuilder);
+  RetireConnectionIdFrame retireConnId(3);
+  EXPECT_EQ(0, writeSimpleFrame(retireConnId, pktBuilder));
+}
+
 TEST_F(QuicWriteCodecTest, WriteStopSending) {
   MockQuicPacketBuilder pktBuilder;
   setupCommonExpects(pktBuilder);
@@ -1373,6 +1489,66 @@ TEST_F(QuicWriteCodecTest, WriteExpiredStreamDataFrame) {
   EXPECT_TRUE(cursor.isAtEnd());
 }
 
+TEST_F(QuicWriteCodecTest, WriteAckFrequencyFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  AckFrequencyFrame ackFrequencyFrame(5, 20, 10000us, false);
+  auto bytesWritten = writeFrame(ackFrequencyFrame, pktBuilder);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  // 2 bytes frame type, 1 byte each for sequence number, packet tolerance and
+  // ignore order, 2 bytes max ack delay.
+  EXPECT_EQ(bytesWritten, 7);
+  auto result = boost::get<AckFrequencyFrame>(
+      boost::get<QuicSimpleFrame>(regularPacket.frames[0]));
+  EXPECT_EQ(ackFrequencyFrame, result);
+
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor cursor(wireBuf.get());
+  auto wireAckFrequencyFrame = boost::get<AckFrequencyFrame>(
+      boost::get<QuicSimpleFrame>(parseQuicFrame(cursor)));
+  EXPECT_EQ(ackFrequencyFrame, wireAckFrequencyFrame);
+
+  // At last, verify there is nothing left in the wire format bytes:
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(QuicWriteCodecTest, WriteFecRepairFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  FecRepairFrame fecRepairFrame(
+      100, 110, 8, folly::IOBuf::copyBuffer("repair data"));
+  auto bytesWritten = writeFrame(fecRepairFrame, pktBuilder);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  // 2 bytes frame type and first packet number, 1 byte each for the number of
+  // packets, of source frames and the repair data length, 11 bytes of data.
+  EXPECT_EQ(bytesWritten, 18);
+  auto result = boost::get<FecRepairFrame>(
+      boost::get<QuicSimpleFrame>(regularPacket.frames[0]));
+  EXPECT_EQ(fecRepairFrame, result);
+
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor cursor(wireBuf.get());
+  auto wireFecRepairFrame = boost::get<FecRepairFrame>(
+      boost::get<QuicSimpleFrame>(parseQuicFrame(cursor)));
+  EXPECT_EQ(fecRepairFrame, wireFecRepairFrame);
+
+  // At last, verify there is nothing left in the wire format bytes:
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(QuicWriteCodecTest, NoSpaceForFecRepairFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  pktBuilder.remaining_ = 10;
+  setupCommonExpects(pktBuilder);
+  FecRepairFrame fecRepairFrame(
+      100, 110, 8, folly::IOBuf::copyBuffer("repair data"));
+  EXPECT_EQ(0, writeFrame(fecRepairFrame, pktBuilder));
+}
+
 TEST_F(QuicWriteCodecTest, WriteMinStreamDataFrame) {
   MockQuicPacketBuilder pktBuilder;
   setupCommonExpects(pktBuilder);
@@ -1450,5 +1626,40 @@ TEST_F(QuicWriteCodecTest, WritePathResponse) {
   EXPECT_EQ(wirePathResponseFrame.pathData, pathData);
   EXPECT_TRUE(cursor.isAtEnd());
 }
+
+TEST_F(QuicWriteCodecTest, WriteDatagram) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+
+  auto data = folly::IOBuf::copyBuffer("datagram");
+  auto bytesWritten =
+      writeFrame(DatagramFrame(data->length(), data->clone()), pktBuilder);
+  // frame type, 1 byte length and the data.
+  EXPECT_EQ(bytesWritten, 2 + data->length());
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  auto& result = boost::get<DatagramFrame>(regularPacket.frames[0]);
+  EXPECT_EQ(result.length, data->length());
+  // The packet doesn't hold on to the data since it is never retransmitted.
+  EXPECT_EQ(result.data, nullptr);
+
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor cursor(wireBuf.get());
+  auto wireDatagramFrame = boost::get<DatagramFrame>(parseQuicFrame(cursor));
+  EXPECT_EQ(wireDatagramFrame.length, data->length());
+  EXPECT_TRUE(folly::IOBufEqualTo()(wireDatagramFrame.data, data));
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(QuicWriteCodecTest, NoSpaceForDatagram) {
+  MockQuicPacketBuilder pktBuilder;
+  pktBuilder.remaining_ = 5;
+  setupCommonExpects(pktBuilder);
+  auto data = folly::IOBuf::copyBuffer("datagram");
+  EXPECT_EQ(
+      writeFrame(DatagramFrame(data->length(), std::move(data)), pktBuilder),
+      0);
+}
 } // namespace test
 } // namespace quic
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Per thread free lists of memory blocks by size, for the objects each
+ * connection is made of, such as its transport, connection state, stream
+ * manager, codec and loopers. Under high connection churn, the new
+ * connections are built from the blocks the closed ones left behind instead
+ * of going through the allocator for each of their objects.
+ *
+ * Each thread keeps up to its own limit of blocks of each size, see
+ * setRecycledBlocksPerSize. Threads that didn't set a limit allocate and free
+ * as usual. A block can be freed on any thread, where it is kept if that
+ * thread recycles blocks of its size.
+ */
+class BlockRecycler {
+ public:
+  static void* allocate(size_t size) {
+    if (maxBlocks() > 0) {
+      auto list = freeLists().find(size);
+      if (list && !list->blocks.empty()) {
+        auto block = list->blocks.back();
+        list->blocks.pop_back();
+        return block;
+      }
+    }
+    return ::operator new(size);
+  }
+
+  static void deallocate(void* block, size_t size) noexcept {
+    if (maxBlocks() > 0) {
+      auto list = freeLists().findOrAdd(size);
+      if (list && list->blocks.size() < maxBlocks()) {
+        // Reserved up to the limit when the list was added, so this can't
+        // throw.
+        list->blocks.push_back(block);
+        return;
+      }
+    }
+    ::operator delete(block);
+  }
+
+  /**
+   * Number of blocks of each size the calling thread keeps, 0 to stop
+   * recycling on it. Blocks above the limit are freed.
+   */
+  static void setRecycledBlocksPerSize(size_t blocks) {
+    if (blocks == maxBlocks()) {
+      return;
+    }
+    if (blocks == 0 && !freeListsCreated()) {
+      return;
+    }
+    auto& lists = freeLists();
+    maxBlocks() = blocks;
+    lists.trim(blocks);
+  }
+
+  // Blocks of the given size the calling thread keeps, for tests.
+  static size_t numRecycledBlocks(size_t size) {
+    if (!freeListsCreated()) {
+      return 0;
+    }
+    auto list = freeLists().find(size);
+    return list ? list->blocks.size() : 0;
+  }
+
+ private:
+  // Sizes recycled per thread. The objects of a connection only come in a
+  // few sizes, any other ones are allocated as usual.
+  static constexpr size_t kMaxSizes = 16;
+
+  struct FreeList {
+    size_t size;
+    std::vector<void*> blocks;
+  };
+
+  struct FreeLists {
+    FreeLists() {
+      freeListsCreated() = true;
+      lists.reserve(kMaxSizes);
+    }
+
+    ~FreeLists() {
+      // Blocks freed after this, by other thread locals, are not kept.
+      maxBlocks() = 0;
+      trim(0);
+    }
+
+    FreeList* find(size_t size) {
+      for (auto& list : lists) {
+        if (list.size == size) {
+          return &list;
+        }
+      }
+      return nullptr;
+    }
+
+    FreeList* findOrAdd(size_t size) noexcept {
+      auto list = find(size);
+      if (list || lists.size() >= kMaxSizes) {
+        return list;
+      }
+      try {
+        FreeList newList{size, {}};
+        newList.blocks.reserve(maxBlocks());
+        lists.push_back(std::move(newList));
+      } catch (const std::bad_alloc&) {
+        return nullptr;
+      }
+      return &lists.back();
+    }
+
+    void trim(size_t blocks) {
+      for (auto& list : lists) {
+        while (list.blocks.size() > blocks) {
+          ::operator delete(list.blocks.back());
+          list.blocks.pop_back();
+        }
+        list.blocks.reserve(blocks);
+      }
+    }
+
+    std::vector<FreeList> lists;
+  };
+
+  // Trivially destructible, so that they can still be read once the free
+  // lists of the thread are destroyed.
+  static size_t& maxBlocks() {
+    static thread_local size_t maxBlocks{0};
+    return maxBlocks;
+  }
+
+  static bool& freeListsCreated() {
+    static thread_local bool created{false};
+    return created;
+  }
+
+  static FreeLists& freeLists() {
+    static thread_local FreeLists lists;
+    return lists;
+  }
+};
+
+/**
+ * Allocator recycling its single object allocations through BlockRecycler,
+ * e.g. for std::allocate_shared, which allocates the object along with its
+ * control block.
+ */
+template <class T>
+struct RecyclingAllocator {
+  using value_type = T;
+
+  RecyclingAllocator() = default;
+
+  template <class U>
+  RecyclingAllocator(const RecyclingAllocator<U>&) noexcept {}
+
+  T* allocate(size_t n) {
+    static_assert(
+        alignof(T) <= alignof(std::max_align_t),
+        "Blocks only have the default alignment");
+    return static_cast<T*>(BlockRecycler::allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) noexcept {
+    BlockRecycler::deallocate(p, n * sizeof(T));
+  }
+
+  template <class U>
+  bool operator==(const RecyclingAllocator<U>&) const noexcept {
+    return true;
+  }
+
+  template <class U>
+  bool operator!=(const RecyclingAllocator<U>&) const noexcept {
+    return false;
+  }
+};
+
+} // namespace quic
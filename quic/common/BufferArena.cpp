@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/BufferArena.h>
+
+#include <glog/logging.h>
+#include <quic/QuicConstants.h>
+
+#include <sys/mman.h>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+namespace quic {
+
+namespace {
+// Every chunk starts with a pointer to the state of its arena, so a buffer
+// finds its arena from its address alone.
+constexpr size_t kChunkHeaderSize = 64;
+
+uintptr_t chunkOf(const void* buf) {
+  return reinterpret_cast<uintptr_t>(buf) & ~(kBufferArenaChunkSize - 1);
+}
+} // namespace
+
+struct BufferArena::State {
+  struct Chunk {
+    void* data;
+    bool hugeTlb;
+  };
+
+  State(size_t bufferSizeIn, size_t maxBytes)
+      : bufferSize(bufferSizeIn),
+        maxChunks(maxBytes / kBufferArenaChunkSize) {}
+
+  ~State() {
+    for (const auto& chunk : chunks) {
+      if (chunk.hugeTlb) {
+        ::munmap(chunk.data, kBufferArenaChunkSize);
+      } else {
+        ::free(chunk.data);
+      }
+    }
+  }
+
+  void release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  // Maps a chunk and splits it into free buffers. Must be called with the
+  // mutex held.
+  bool addChunk() {
+    if (chunks.size() >= maxChunks) {
+      return false;
+    }
+    void* data = nullptr;
+    bool hugeTlb = false;
+#ifdef MAP_HUGETLB
+    // Huge pages come aligned to their size.
+    data = ::mmap(
+        nullptr,
+        kBufferArenaChunkSize,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+        -1,
+        0);
+    if (data == MAP_FAILED) {
+      data = nullptr;
+    } else {
+      hugeTlb = true;
+    }
+#endif
+    if (!data) {
+      if (::posix_memalign(
+              &data, kBufferArenaChunkSize, kBufferArenaChunkSize) != 0) {
+        VLOG(4) << "Failed to allocate a buffer arena chunk";
+        return false;
+      }
+#ifdef MADV_HUGEPAGE
+      // Without reserved huge pages, transparent ones are the next best.
+      ::madvise(data, kBufferArenaChunkSize, MADV_HUGEPAGE);
+#endif
+    }
+    *static_cast<State**>(data) = this;
+    chunks.push_back({data, hugeTlb});
+    auto base = static_cast<uint8_t*>(data);
+    for (size_t offset = kChunkHeaderSize;
+         offset + bufferSize <= kBufferArenaChunkSize;
+         offset += bufferSize) {
+      freeBuffers.push_back(base + offset);
+    }
+    return true;
+  }
+
+  const size_t bufferSize;
+  const size_t maxChunks;
+  // One reference for the arena, and one for each buffer handed out.
+  std::atomic<size_t> refs{1};
+  mutable std::mutex mutex;
+  std::vector<Chunk> chunks;
+  std::vector<void*> freeBuffers;
+};
+
+BufferArena::BufferArena(size_t bufferSize, size_t maxBytes)
+    : state_(new State(
+          // Buffers keep the alignment of the chunk header.
+          (bufferSize + kChunkHeaderSize - 1) / kChunkHeaderSize *
+              kChunkHeaderSize,
+          maxBytes)) {
+  CHECK_GT(bufferSize, 0u);
+  CHECK_LE(state_->bufferSize + kChunkHeaderSize, kBufferArenaChunkSize);
+}
+
+BufferArena::~BufferArena() {
+  state_->release();
+}
+
+void* BufferArena::allocate(size_t size) {
+  if (size > state_->bufferSize) {
+    return nullptr;
+  }
+  void* buf;
+  {
+    std::lock_guard<std::mutex> guard(state_->mutex);
+    if (state_->freeBuffers.empty() && !state_->addChunk()) {
+      return nullptr;
+    }
+    buf = state_->freeBuffers.back();
+    state_->freeBuffers.pop_back();
+  }
+  state_->refs.fetch_add(1, std::memory_order_relaxed);
+  return buf;
+}
+
+void BufferArena::deallocate(void* buf) noexcept {
+  auto state = *reinterpret_cast<State**>(chunkOf(buf));
+  {
+    std::lock_guard<std::mutex> guard(state->mutex);
+    state->freeBuffers.push_back(buf);
+  }
+  // Outside of the lock since this may drop the last reference to the state.
+  state->release();
+}
+
+std::unique_ptr<folly::IOBuf> BufferArena::createIOBuf(size_t capacity) {
+  auto buf = allocate(capacity);
+  if (!buf) {
+    return folly::IOBuf::create(capacity);
+  }
+  return folly::IOBuf::takeOwnership(
+      buf, state_->bufferSize, 0, &BufferArena::freeIOBuf);
+}
+
+size_t BufferArena::bufferSize() const noexcept {
+  return state_->bufferSize;
+}
+
+size_t BufferArena::numChunks() const {
+  std::lock_guard<std::mutex> guard(state_->mutex);
+  return state_->chunks.size();
+}
+
+bool BufferArena::usesHugeTlb() const {
+  std::lock_guard<std::mutex> guard(state_->mutex);
+  return !state_->chunks.empty() && state_->chunks.front().hugeTlb;
+}
+
+void BufferArena::freeIOBuf(void* buf, void* /* userData */) noexcept {
+  deallocate(buf);
+}
+
+} // namespace quic
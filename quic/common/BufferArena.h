@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+
+#include <memory>
+
+namespace quic {
+
+/**
+ * Fixed size buffers for packet I/O, carved out of kBufferArenaChunkSize
+ * chunks so that the short lived buffers of a worker share a few TLB
+ * entries instead of spreading over the pages of the heap.
+ *
+ * Chunks are explicit huge pages when the system has some reserved, and
+ * otherwise aligned allocations advised to be backed by transparent huge
+ * pages. They are allocated as needed, up to maxBytes of them, and are only
+ * given back to the system once the arena and all of its buffers are gone.
+ *
+ * Buffers can be freed from any thread and may outlive the arena itself.
+ */
+class BufferArena {
+ public:
+  // bufferSize: size of each buffer, at most kBufferArenaChunkSize.
+  BufferArena(size_t bufferSize, size_t maxBytes);
+  ~BufferArena();
+
+  BufferArena(const BufferArena&) = delete;
+  BufferArena& operator=(const BufferArena&) = delete;
+
+  /**
+   * Returns a buffer of bufferSize() bytes, or nullptr if size is larger
+   * than that or the arena is full. It must be freed with deallocate.
+   */
+  void* allocate(size_t size);
+
+  static void deallocate(void* buf) noexcept;
+
+  /**
+   * Returns an empty IOBuf with at least capacity bytes of tailroom, from a
+   * buffer of the arena if it fits in one and the arena is not full, from
+   * the heap otherwise.
+   */
+  std::unique_ptr<folly::IOBuf> createIOBuf(size_t capacity);
+
+  size_t bufferSize() const noexcept;
+
+  size_t numChunks() const;
+
+  // Whether the chunks are explicit huge pages, rather than transparent ones.
+  bool usesHugeTlb() const;
+
+ private:
+  struct State;
+
+  static void freeIOBuf(void* buf, void* userData) noexcept;
+
+  State* state_;
+};
+
+} // namespace quic
@@ -23,6 +23,16 @@ void FunctionLooper::setPacingTimer(
   pacingTimer_ = std::move(pacingTimer);
 }
 
+void FunctionLooper::setPacingTimerWheel(
+    PacingTimerWheel* pacingTimerWheel) noexcept {
+  bool wasPending = isPacingTimeoutPending();
+  cancelPacingTimeouts();
+  pacingTimerWheel_ = pacingTimerWheel;
+  if (wasPending && running_ && evb_) {
+    evb_->runInLoop(this);
+  }
+}
+
 void FunctionLooper::setPacingFunction(
     folly::Function<std::chrono::microseconds()>&& pacingFunc) {
   pacingFunc_ = std::move(pacingFunc);
@@ -48,16 +58,33 @@ void FunctionLooper::commonLoopBody(bool fromTimer) noexcept {
 }
 
 bool FunctionLooper::schedulePacingTimeout(bool /* fromTimer */) noexcept {
-  if (pacingFunc_ && pacingTimer_ && !isScheduled()) {
+  if (pacingFunc_ && isPaced() && !isPacingTimeoutPending()) {
     auto nextPacingTime = (*pacingFunc_)();
     if (nextPacingTime != 0us) {
-      pacingTimer_->scheduleTimeout(this, nextPacingTime);
+      if (pacingTimerWheel_) {
+        pacingTimerWheel_->scheduleTimeout(*this, nextPacingTime);
+      } else {
+        pacingTimer_->scheduleTimeout(this, nextPacingTime);
+      }
       return true;
     }
   }
   return false;
 }
 
+bool FunctionLooper::isPaced() const noexcept {
+  return pacingTimerWheel_ || pacingTimer_;
+}
+
+bool FunctionLooper::isPacingTimeoutPending() const noexcept {
+  return isScheduled() || isPacingTimeoutScheduled();
+}
+
+void FunctionLooper::cancelPacingTimeouts() noexcept {
+  cancelTimeout();
+  cancelPacingTimeout();
+}
+
 void FunctionLooper::runLoopCallback() noexcept {
   folly::DelayedDestruction::DestructorGuard dg(this);
   commonLoopBody(false);
@@ -68,12 +95,12 @@ void FunctionLooper::run(bool thisIteration) noexcept {
   running_ = true;
   // Caller can call run() in func_. But if we are in pacing mode, we should
   // prevent such loop.
-  if (pacingTimer_ && inLoopBody_) {
+  if (isPaced() && inLoopBody_) {
     VLOG(4) << __func__ << ": " << type_
             << " in loop body and using pacing - not rescheduling";
     return;
   }
-  if (isLoopCallbackScheduled() || isScheduled()) {
+  if (isLoopCallbackScheduled() || isPacingTimeoutPending()) {
     VLOG(10) << __func__ << ": " << type_ << " already scheduled";
     return;
   }
@@ -84,7 +111,7 @@ void FunctionLooper::stop() noexcept {
   VLOG(10) << __func__ << ": " << type_;
   running_ = false;
   cancelLoopCallback();
-  cancelTimeout();
+  cancelPacingTimeouts();
 }
 
 bool FunctionLooper::isRunning() const {
@@ -102,7 +129,7 @@ void FunctionLooper::detachEventBase() {
   VLOG(10) << __func__ << ": " << type_;
   DCHECK(evb_ && evb_->isInEventBaseThread());
   stop();
-  cancelTimeout();
+  cancelPacingTimeouts();
   evb_ = nullptr;
 }
 
@@ -115,8 +142,16 @@ void FunctionLooper::callbackCanceled() noexcept {
   return;
 }
 
+void FunctionLooper::pacingTimeoutExpired() noexcept {
+  folly::DelayedDestruction::DestructorGuard dg(this);
+  commonLoopBody(true);
+}
+
 folly::Optional<std::chrono::microseconds>
 FunctionLooper::getTimerTickInterval() noexcept {
+  if (pacingTimerWheel_) {
+    return pacingTimerWheel_->getSlotInterval();
+  }
   if (pacingTimer_) {
     return pacingTimer_->getTickInterval();
   }
@@ -11,6 +11,8 @@
 
 #include <folly/Function.h>
 #include <folly/io/async/EventBase.h>
+#include <quic/common/BlockRecycler.h>
+#include <quic/common/PacingTimerWheel.h>
 #include <quic/common/Timers.h>
 
 namespace quic {
@@ -29,11 +31,21 @@ std::ostream& operator<<(std::ostream& /* out */, const LooperType& /*rhs*/);
  */
 class FunctionLooper : public folly::EventBase::LoopCallback,
                        public folly::DelayedDestruction,
-                       public TimerHighRes::Callback {
+                       public TimerHighRes::Callback,
+                       public PacingTimerWheel::Callback {
  public:
   using Ptr =
       std::unique_ptr<FunctionLooper, folly::DelayedDestruction::Destructor>;
 
+  // Recycled with the rest of the connection, see BlockRecycler.
+  static void* operator new(size_t size) {
+    return BlockRecycler::allocate(size);
+  }
+
+  static void operator delete(void* p, size_t size) noexcept {
+    BlockRecycler::deallocate(p, size);
+  }
+
   explicit FunctionLooper(
       folly::EventBase* evb,
       folly::Function<void(bool)>&& func,
@@ -41,6 +53,12 @@ class FunctionLooper : public folly::EventBase::LoopCallback,
 
   void setPacingTimer(TimerHighRes::SharedPtr pacingTimer) noexcept;
 
+  /**
+   * Paces with a timer wheel shared with other loopers instead of the pacing
+   * timer. Pass nullptr to go back to the pacing timer.
+   */
+  void setPacingTimerWheel(PacingTimerWheel* pacingTimerWheel) noexcept;
+
   void runLoopCallback() noexcept override;
 
   /**
@@ -79,17 +97,25 @@ class FunctionLooper : public folly::EventBase::LoopCallback,
 
   void callbackCanceled() noexcept override;
 
+  void pacingTimeoutExpired() noexcept override;
+
   folly::Optional<std::chrono::microseconds> getTimerTickInterval() noexcept;
 
+  // Whether a paced run is scheduled, on the pacing timer or the wheel.
+  bool isPacingTimeoutPending() const noexcept;
+
  private:
   ~FunctionLooper() override = default;
   void commonLoopBody(bool fromTimer) noexcept;
   bool schedulePacingTimeout(bool fromTimer) noexcept;
+  bool isPaced() const noexcept;
+  void cancelPacingTimeouts() noexcept;
 
   folly::EventBase* evb_;
   folly::Function<void(bool)> func_;
   folly::Optional<folly::Function<std::chrono::microseconds()>> pacingFunc_;
   TimerHighRes::SharedPtr pacingTimer_;
+  PacingTimerWheel* pacingTimerWheel_{nullptr};
   bool running_{false};
   bool inLoopBody_{false};
   const LooperType type_;
@@ -27,6 +27,23 @@ template <
     template <typename I, typename = std::allocator<I>> class Container>
 void IntervalSet<T, Unit, Container>::insert(
     const Interval<T, Unit>& interval) {
+  // Fast path for in order insertion, where the interval can only go after
+  // the last one or be merged into it.
+  if (container_type::empty() ||
+      container_type::back().end + interval_type::unitValue() <
+          interval.start) {
+    insertVersion_++;
+    container_type::push_back(interval);
+    return;
+  }
+  auto& last = container_type::back();
+  if (last.start <= interval.start) {
+    if (interval.end > last.end) {
+      insertVersion_++;
+      last.end = interval.end;
+    }
+    return;
+  }
   auto intersectionRange = intersectingRange(interval);
   auto firstIt = intersectionRange.first;
   auto endIt = intersectionRange.second;
@@ -13,13 +13,23 @@
 #include <exception>
 #include <queue>
 #include <stdexcept>
+#include <vector>
 
 #include <folly/Likely.h>
+#include <folly/small_vector.h>
 
 namespace quic {
 
 constexpr uint64_t kDefaultIntervalSetVersion = 0;
 
+// Number of intervals an IntervalSet holds before it allocates. A single
+// interval is what an ACK state without reordering holds, and it takes the
+// same space as an empty std::vector.
+constexpr size_t kInlineIntervals = 1;
+
+template <typename I, typename = std::allocator<I>>
+using IntervalSmallVector = folly::small_vector<I, kInlineIntervals>;
+
 template <typename T, T Unit = (T)1>
 struct Interval {
   T start;
@@ -48,12 +58,18 @@ struct Interval {
  * but consumption only takes place at the beginning or the end. This
  * simplyfies the internal implementation. Also, still for the sake of
  * simplicity, it only exposes const iterator to users.
+ *
+ * The intervals are stored in a small vector by default. Sets are small (ACK
+ * blocks), and WriteAckFrame embeds one in every outstanding packet that
+ * carries an ACK, where a std::deque would cost several times the footprint
+ * and an allocation on construction. The first interval is stored inline, so
+ * tracking packets that arrive in order never allocates.
  */
 template <
     typename T,
     T Unit = (T)1,
     template <typename I, typename = std::allocator<I>> class Container =
-        std::deque>
+        IntervalSmallVector>
 class IntervalSet : private Container<Interval<T, Unit>> {
  public:
   using interval_type = Interval<T, Unit>;
@@ -91,9 +107,12 @@ class IntervalSet : private Container<Interval<T, Unit>> {
   using container_type::empty;
   using container_type::front;
   using container_type::pop_back;
-  using container_type::pop_front;
   using container_type::size;
 
+  void pop_front() {
+    container_type::erase(container_type::begin());
+  }
+
  private:
   /**
    * Helper function to find the intersecting range in this interval set
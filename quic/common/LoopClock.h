@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/QuicConstants.h>
+
+namespace quic {
+
+/**
+ * Time of the current iteration of an EventBase loop, read from Clock at
+ * most once per iteration instead of once per packet, acked packet and
+ * timer. Everything done within an iteration, e.g. all the packets of a
+ * receive batch or of a write loop, sees the same time.
+ *
+ * preciseNow() reads the clock again, for the points where the time has to
+ * be accurate: when a batch of packets is received and when a write loop
+ * starts. Later now() calls of the iteration return that time.
+ */
+class LoopClock : private folly::EventBase::LoopCallback {
+ public:
+  explicit LoopClock(folly::EventBase* evb) : evb_(evb) {}
+
+  ~LoopClock() override = default;
+
+  LoopClock(const LoopClock&) = delete;
+  LoopClock& operator=(const LoopClock&) = delete;
+
+  TimePoint now() {
+    if (!cached_) {
+      return preciseNow();
+    }
+    return *cached_;
+  }
+
+  TimePoint preciseNow() {
+    cached_ = Clock::now();
+    if (!isLoopCallbackScheduled()) {
+      // Loop callbacks run at the end of the iteration.
+      evb_->runInLoop(this);
+    }
+    return *cached_;
+  }
+
+ private:
+  void runLoopCallback() noexcept override {
+    cached_ = folly::none;
+  }
+
+  folly::EventBase* evb_;
+  folly::Optional<TimePoint> cached_;
+};
+
+} // namespace quic
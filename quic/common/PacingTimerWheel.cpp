@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/PacingTimerWheel.h>
+
+#include <glog/logging.h>
+
+#include <limits>
+
+namespace quic {
+
+namespace {
+constexpr uint64_t kSlotMask = PacingTimerWheel::kSlots - 1;
+constexpr uint64_t kNoWakeup = std::numeric_limits<uint64_t>::max();
+
+constexpr size_t levelShift(size_t level) {
+  return PacingTimerWheel::kSlotBits * level;
+}
+} // namespace
+
+PacingTimerWheel::Callback::~Callback() {
+  cancelPacingTimeout();
+}
+
+void PacingTimerWheel::Callback::cancelPacingTimeout() {
+  if (wheel_) {
+    wheel_->remove(*this);
+  }
+}
+
+PacingTimerWheel::PacingTimerWheel(
+    folly::EventBase* evb,
+    std::chrono::microseconds slotInterval)
+    : slotInterval_(slotInterval),
+      timer_(TimerHighRes::newTimer(evb, slotInterval)),
+      startTime_(Clock::now()) {
+  CHECK_GT(slotInterval_.count(), 0);
+}
+
+PacingTimerWheel::~PacingTimerWheel() {
+  cancelTimeout();
+  for (auto& level : slots_) {
+    for (auto& slot : level) {
+      while (!slot.empty()) {
+        auto& callback = slot.front();
+        slot.pop_front();
+        callback.wheel_ = nullptr;
+      }
+    }
+  }
+  count_ = 0;
+  timer_.reset();
+}
+
+void PacingTimerWheel::scheduleTimeout(
+    Callback& callback,
+    std::chrono::microseconds timeout) {
+  callback.cancelPacingTimeout();
+  auto expireTime = Clock::now() + timeout - startTime_;
+  auto expireUs =
+      std::chrono::duration_cast<std::chrono::microseconds>(expireTime);
+  // Rounded up, so the callback never fires before its timeout.
+  uint64_t expireTick =
+      (expireUs.count() + slotInterval_.count() - 1) / slotInterval_.count();
+  callback.expireTick_ = std::max(expireTick, currentTick_ + 1);
+  callback.wheel_ = this;
+  insert(callback);
+  ++count_;
+  if (!inTimeoutExpired_) {
+    scheduleWakeup();
+  }
+}
+
+void PacingTimerWheel::setBatchCallback(folly::Function<void()> batchCallback) {
+  batchCallback_ = std::move(batchCallback);
+}
+
+uint64_t PacingTimerWheel::tickFor(TimePoint time) const {
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      time - startTime_);
+  return elapsed.count() / slotInterval_.count();
+}
+
+void PacingTimerWheel::insert(Callback& callback) {
+  DCHECK_GE(callback.expireTick_, currentTick_);
+  uint64_t diff = callback.expireTick_ - currentTick_;
+  for (size_t level = 0; level < kLevels; ++level) {
+    if (diff < (uint64_t(1) << levelShift(level + 1))) {
+      auto index = (callback.expireTick_ >> levelShift(level)) & kSlotMask;
+      slots_[level][index].push_back(callback);
+      return;
+    }
+  }
+  // Too far out, park it in the last slot of the top level the wheel
+  // reaches, it goes back in from there when that slot cascades.
+  uint64_t lastTick = currentTick_ + (uint64_t(1) << levelShift(kLevels)) - 1;
+  auto index = (lastTick >> levelShift(kLevels - 1)) & kSlotMask;
+  slots_[kLevels - 1][index].push_back(callback);
+}
+
+void PacingTimerWheel::remove(Callback& callback) {
+  DCHECK_EQ(callback.wheel_, this);
+  callback.hook_.unlink();
+  callback.wheel_ = nullptr;
+  --count_;
+  if (count_ == 0 && !inTimeoutExpired_) {
+    cancelTimeout();
+  }
+}
+
+void PacingTimerWheel::cascade(uint64_t tick) {
+  for (size_t level = kLevels - 1; level > 0; --level) {
+    if (tick & ((uint64_t(1) << levelShift(level)) - 1)) {
+      continue;
+    }
+    auto index = (tick >> levelShift(level)) & kSlotMask;
+    CallbackList callbacks;
+    callbacks.splice(callbacks.end(), slots_[level][index]);
+    while (!callbacks.empty()) {
+      auto& callback = callbacks.front();
+      callbacks.pop_front();
+      insert(callback);
+    }
+  }
+}
+
+void PacingTimerWheel::advanceTo(uint64_t tick, CallbackList& expired) {
+  while (currentTick_ < tick) {
+    auto nextTick = nextWakeupTick();
+    if (nextTick > tick) {
+      // Nothing to do in between.
+      currentTick_ = tick;
+      return;
+    }
+    currentTick_ = nextTick;
+    cascade(currentTick_);
+    expired.splice(expired.end(), slots_[0][currentTick_ & kSlotMask]);
+  }
+}
+
+uint64_t PacingTimerWheel::nextWakeupTick() const {
+  if (count_ == 0) {
+    return kNoWakeup;
+  }
+  uint64_t next = kNoWakeup;
+  for (uint64_t i = 1; i <= kSlots; ++i) {
+    auto tick = currentTick_ + i;
+    if (!slots_[0][tick & kSlotMask].empty()) {
+      next = tick;
+      break;
+    }
+  }
+  // A higher level slot needs a wakeup when it cascades, at the first tick
+  // after currentTick_ starting its span.
+  for (size_t level = 1; level < kLevels; ++level) {
+    auto shift = levelShift(level);
+    auto ring = (currentTick_ >> shift) & ~kSlotMask;
+    for (uint64_t index = 0; index < kSlots; ++index) {
+      if (slots_[level][index].empty()) {
+        continue;
+      }
+      uint64_t tick = (ring | index) << shift;
+      if (tick <= currentTick_) {
+        tick += uint64_t(1) << levelShift(level + 1);
+      }
+      next = std::min(next, tick);
+    }
+  }
+  return next;
+}
+
+void PacingTimerWheel::scheduleWakeup() {
+  auto nextTick = nextWakeupTick();
+  if (nextTick == kNoWakeup) {
+    cancelTimeout();
+    return;
+  }
+  if (isScheduled() && wakeupTick_ == nextTick) {
+    return;
+  }
+  auto wakeupTime = startTime_ + nextTick * slotInterval_;
+  auto now = Clock::now();
+  auto delay = wakeupTime > now
+      ? std::chrono::duration_cast<std::chrono::microseconds>(wakeupTime - now)
+      : std::chrono::microseconds::zero();
+  wakeupTick_ = nextTick;
+  timer_->scheduleTimeout(this, delay);
+}
+
+void PacingTimerWheel::timeoutExpired() noexcept {
+  inTimeoutExpired_ = true;
+  CallbackList expired;
+  advanceTo(tickFor(Clock::now()), expired);
+  bool fired = !expired.empty();
+  while (!expired.empty()) {
+    auto& callback = expired.front();
+    expired.pop_front();
+    callback.wheel_ = nullptr;
+    --count_;
+    callback.pacingTimeoutExpired();
+  }
+  if (fired && batchCallback_) {
+    batchCallback_();
+  }
+  inTimeoutExpired_ = false;
+  scheduleWakeup();
+}
+
+} // namespace quic
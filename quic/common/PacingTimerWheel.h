@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+
+#include <folly/Function.h>
+#include <folly/IntrusiveList.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/QuicConstants.h>
+#include <quic/common/Timers.h>
+
+namespace quic {
+
+/**
+ * Pacing timer shared by all the connections of a worker. It is a
+ * hierarchical timing wheel of kLevels levels of kSlots slots each, where a
+ * level 0 slot is slotInterval long, usually tens of microseconds, and a slot
+ * of every higher level spans a whole ring of the level below it. Timeouts
+ * further out than the wheel spans are kept in the last slot of the top
+ * level, and cascade down from there.
+ *
+ * The wheel arms a single timer for the next slot with callbacks due, and
+ * fires all of them in one wakeup. The batch callback runs once all of them
+ * wrote, so a worker can flush the packets of the whole slot with one
+ * sendmmsg.
+ */
+class PacingTimerWheel : private TimerHighRes::Callback {
+ public:
+  static constexpr size_t kSlotBits = 6;
+  static constexpr size_t kSlots = 1 << kSlotBits;
+  static constexpr size_t kLevels = 4;
+
+  class Callback {
+   public:
+    virtual ~Callback();
+
+    virtual void pacingTimeoutExpired() noexcept = 0;
+
+    bool isPacingTimeoutScheduled() const {
+      return hook_.is_linked();
+    }
+
+    void cancelPacingTimeout();
+
+   private:
+    friend class PacingTimerWheel;
+    folly::IntrusiveListHook hook_;
+    PacingTimerWheel* wheel_{nullptr};
+    uint64_t expireTick_{0};
+  };
+
+  PacingTimerWheel(
+      folly::EventBase* evb,
+      std::chrono::microseconds slotInterval);
+  ~PacingTimerWheel() override;
+
+  /**
+   * Schedules callback to fire in timeout, rounded up to the next slot. A
+   * callback that is already scheduled is moved.
+   */
+  void scheduleTimeout(Callback& callback, std::chrono::microseconds timeout);
+
+  // Called after each wakeup, once all the callbacks due in it fired.
+  void setBatchCallback(folly::Function<void()> batchCallback);
+
+  std::chrono::microseconds getSlotInterval() const {
+    return slotInterval_;
+  }
+
+  // number of scheduled callbacks
+  size_t size() const {
+    return count_;
+  }
+
+ private:
+  using CallbackList = folly::IntrusiveList<Callback, &Callback::hook_>;
+
+  void timeoutExpired() noexcept override;
+  void callbackCanceled() noexcept override {}
+
+  uint64_t tickFor(TimePoint time) const;
+  // Puts the callback in the slot for its expireTick_, relative to
+  // currentTick_.
+  void insert(Callback& callback);
+  void remove(Callback& callback);
+  // Moves the callbacks of the higher level slots starting at tick down.
+  void cascade(uint64_t tick);
+  // Advances the wheel up to tick, moving the callbacks due to expired.
+  void advanceTo(uint64_t tick, CallbackList& expired);
+  // First tick after currentTick_ at which the wheel has work to do.
+  uint64_t nextWakeupTick() const;
+  void scheduleWakeup();
+
+  std::chrono::microseconds slotInterval_;
+  TimerHighRes::UniquePtr timer_;
+  TimePoint startTime_;
+  // Last tick whose slot was processed.
+  uint64_t currentTick_{0};
+  size_t count_{0};
+  // Tick the timer is armed for, if it is armed.
+  uint64_t wakeupTick_{0};
+  bool inTimeoutExpired_{false};
+  std::array<std::array<CallbackList, kSlots>, kLevels> slots_;
+  folly::Function<void()> batchCallback_;
+};
+
+} // namespace quic
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/BlockRecycler.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+struct Recycled {
+  static void* operator new(size_t size) {
+    return BlockRecycler::allocate(size);
+  }
+
+  static void operator delete(void* p, size_t size) noexcept {
+    BlockRecycler::deallocate(p, size);
+  }
+
+  uint64_t data[8];
+};
+} // namespace
+
+class BlockRecyclerTest : public Test {
+ public:
+  void TearDown() override {
+    // The limit is per thread, and the tests share theirs.
+    BlockRecycler::setRecycledBlocksPerSize(0);
+  }
+};
+
+TEST_F(BlockRecyclerTest, NotRecycledWithoutLimit) {
+  auto block = BlockRecycler::allocate(64);
+  BlockRecycler::deallocate(block, 64);
+  EXPECT_EQ(0u, BlockRecycler::numRecycledBlocks(64));
+}
+
+TEST_F(BlockRecyclerTest, RecyclesUpToLimit) {
+  BlockRecycler::setRecycledBlocksPerSize(2);
+  void* blocks[3];
+  for (auto& block : blocks) {
+    block = BlockRecycler::allocate(64);
+  }
+  for (auto block : blocks) {
+    BlockRecycler::deallocate(block, 64);
+  }
+  EXPECT_EQ(2u, BlockRecycler::numRecycledBlocks(64));
+  // Blocks of another size are not handed out.
+  auto other = BlockRecycler::allocate(128);
+  EXPECT_EQ(2u, BlockRecycler::numRecycledBlocks(64));
+  BlockRecycler::deallocate(other, 128);
+  EXPECT_EQ(1u, BlockRecycler::numRecycledBlocks(128));
+
+  auto reused = BlockRecycler::allocate(64);
+  EXPECT_TRUE(reused == blocks[0] || reused == blocks[1]);
+  EXPECT_EQ(1u, BlockRecycler::numRecycledBlocks(64));
+  BlockRecycler::deallocate(reused, 64);
+
+  BlockRecycler::setRecycledBlocksPerSize(1);
+  EXPECT_EQ(1u, BlockRecycler::numRecycledBlocks(64));
+  BlockRecycler::setRecycledBlocksPerSize(0);
+  EXPECT_EQ(0u, BlockRecycler::numRecycledBlocks(64));
+  EXPECT_EQ(0u, BlockRecycler::numRecycledBlocks(128));
+}
+
+TEST_F(BlockRecyclerTest, ClassAllocations) {
+  BlockRecycler::setRecycledBlocksPerSize(4);
+  auto object = new Recycled();
+  auto raw = object;
+  delete object;
+  EXPECT_EQ(1u, BlockRecycler::numRecycledBlocks(sizeof(Recycled)));
+  auto unique = std::make_unique<Recycled>();
+  EXPECT_EQ(raw, unique.get());
+  EXPECT_EQ(0u, BlockRecycler::numRecycledBlocks(sizeof(Recycled)));
+}
+
+TEST_F(BlockRecyclerTest, AllocateShared) {
+  BlockRecycler::setRecycledBlocksPerSize(4);
+  auto shared =
+      std::allocate_shared<Recycled>(RecyclingAllocator<Recycled>());
+  auto raw = shared.get();
+  shared.reset();
+  // Made from the block of the control block and object that were freed.
+  shared = std::allocate_shared<Recycled>(RecyclingAllocator<Recycled>());
+  EXPECT_EQ(raw, shared.get());
+}
+
+TEST_F(BlockRecyclerTest, FreedOnThreadWithoutLimit) {
+  BlockRecycler::setRecycledBlocksPerSize(4);
+  auto block = BlockRecycler::allocate(64);
+  std::thread([block] {
+    BlockRecycler::deallocate(block, 64);
+    EXPECT_EQ(0u, BlockRecycler::numRecycledBlocks(64));
+  }).join();
+  EXPECT_EQ(0u, BlockRecycler::numRecycledBlocks(64));
+}
+
+} // namespace test
+} // namespace quic
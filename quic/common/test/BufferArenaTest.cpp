@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/BufferArena.h>
+
+#include <gtest/gtest.h>
+#include <quic/QuicConstants.h>
+
+#include <cstring>
+#include <thread>
+
+using namespace folly;
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+TEST(BufferArenaTest, ReusesBuffers) {
+  BufferArena arena(1500, kBufferArenaChunkSize);
+  // Rounded up to keep the buffers aligned.
+  EXPECT_EQ(1536u, arena.bufferSize());
+  EXPECT_EQ(0u, arena.numChunks());
+
+  auto first = arena.allocate(1000);
+  ASSERT_NE(nullptr, first);
+  EXPECT_EQ(1u, arena.numChunks());
+  EXPECT_EQ(nullptr, arena.allocate(arena.bufferSize() + 1));
+  BufferArena::deallocate(first);
+  EXPECT_EQ(first, arena.allocate(arena.bufferSize()));
+  BufferArena::deallocate(first);
+}
+
+TEST(BufferArenaTest, FallsBackToHeapWhenFull) {
+  BufferArena arena(kBufferArenaChunkSize / 2, kBufferArenaChunkSize);
+  // Only one buffer fits next to the chunk header.
+  auto buf = arena.createIOBuf(100);
+  EXPECT_EQ(arena.bufferSize(), buf->capacity());
+  EXPECT_EQ(0u, buf->length());
+  auto heapBuf = arena.createIOBuf(100);
+  EXPECT_EQ(1u, arena.numChunks());
+  EXPECT_EQ(nullptr, arena.allocate(100));
+
+  // Large buffers come from the heap as well.
+  auto largeBuf = arena.createIOBuf(arena.bufferSize() + 1);
+  EXPECT_GE(largeBuf->capacity(), arena.bufferSize() + 1);
+
+  buf.reset();
+  auto reused = arena.allocate(100);
+  EXPECT_NE(nullptr, reused);
+  BufferArena::deallocate(reused);
+}
+
+TEST(BufferArenaTest, BuffersOutliveArena) {
+  std::unique_ptr<IOBuf> buf;
+  {
+    BufferArena arena(2048, kBufferArenaChunkSize);
+    buf = arena.createIOBuf(2048);
+  }
+  buf->append(buf->tailroom());
+  memset(buf->writableData(), 0xab, buf->length());
+  // Freed on another thread, after the arena.
+  std::thread([buf = std::move(buf)]() mutable { buf.reset(); }).join();
+}
+
+} // namespace test
+} // namespace quic
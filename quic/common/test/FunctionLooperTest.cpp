@@ -254,6 +254,36 @@ TEST(FunctionLooperTest, TimerTickSizeAfterNewEvb) {
   EXPECT_EQ(123ms, looper->getTimerTickInterval());
 }
 
+TEST(FunctionLooperTest, PacingTimerWheel) {
+  EventBase evb;
+  PacingTimerWheel wheel(&evb, 100us);
+  std::vector<bool> fromTimerVec;
+  auto func = [&](bool fromTimer) { fromTimerVec.push_back(fromTimer); };
+  auto pacingFunc = [&]() -> auto { return 3600000ms; };
+  FunctionLooper::Ptr looper(
+      new FunctionLooper(&evb, std::move(func), LooperType::WriteLooper));
+  looper->setPacingTimerWheel(&wheel);
+  looper->setPacingFunction(std::move(pacingFunc));
+  EXPECT_EQ(100us, looper->getTimerTickInterval());
+  looper->run();
+  evb.loopOnce();
+  EXPECT_EQ(1, fromTimerVec.size());
+  EXPECT_FALSE(fromTimerVec.back());
+  EXPECT_TRUE(looper->isPacingTimeoutScheduled());
+  EXPECT_FALSE(looper->isScheduled());
+  EXPECT_EQ(1, wheel.size());
+
+  looper->cancelPacingTimeout();
+  looper->pacingTimeoutExpired();
+  EXPECT_EQ(2, fromTimerVec.size());
+  EXPECT_TRUE(fromTimerVec.back());
+  EXPECT_TRUE(looper->isPacingTimeoutScheduled());
+
+  looper->stop();
+  EXPECT_FALSE(looper->isPacingTimeoutScheduled());
+  EXPECT_EQ(0, wheel.size());
+}
+
 TEST(FunctionLooperTest, NoLoopCallbackInPacingMode) {
   EventBase evb;
   TimerHighRes::SharedPtr pacingTimer(TimerHighRes::newTimer(&evb, 1ms));
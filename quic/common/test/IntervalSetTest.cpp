@@ -40,6 +40,16 @@ TEST(IntervalSet, insertAtFront) {
   EXPECT_GT(version3, version2);
 }
 
+TEST(IntervalSet, dequeContainer) {
+  IntervalSet<int, 1, std::deque> set;
+  set.insert(4, 5);
+  set.insert(1, 2);
+  EXPECT_EQ(set.front(), Interval<int>(1, 2));
+  set.pop_front();
+  EXPECT_EQ(set.front(), Interval<int>(4, 5));
+  EXPECT_EQ(set.size(), 1);
+}
+
 TEST(IntervalSet, insertAtBack) {
   IntervalSet<int> set;
   set.insert(1, 2);
@@ -170,6 +180,32 @@ TEST(IntervalSet, insertVersionDoesNotChange) {
   EXPECT_EQ(version2, version1);
 }
 
+TEST(IntervalSet, insertInOrder) {
+  IntervalSet<int> set;
+  for (int point = 1; point <= 10; point++) {
+    auto version = set.insertVersion();
+    set.insert(point);
+    EXPECT_GT(set.insertVersion(), version);
+  }
+  EXPECT_EQ(set.size(), 1);
+  EXPECT_EQ(set.front(), Interval<int>(1, 10));
+
+  // Duplicates of the tail don't change the set.
+  auto version = set.insertVersion();
+  set.insert(10);
+  set.insert(5, 10);
+  EXPECT_EQ(set.insertVersion(), version);
+  EXPECT_EQ(set.front(), Interval<int>(1, 10));
+
+  // Overlapping the tail extends it, a gap starts a new interval.
+  set.insert(8, 12);
+  EXPECT_EQ(set.back(), Interval<int>(1, 12));
+  set.insert(14);
+  EXPECT_EQ(set.size(), 2);
+  EXPECT_EQ(set.back(), Interval<int>(14, 14));
+  EXPECT_GT(set.insertVersion(), version);
+}
+
 TEST(IntervalSet, withdrawBeforeFront) {
   IntervalSet<int> set;
   set.insert(4, 5);
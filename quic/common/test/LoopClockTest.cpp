@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/LoopClock.h>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace folly;
+using namespace quic;
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+TEST(LoopClockTest, SameTimeWithinIteration) {
+  EventBase evb;
+  LoopClock clock(&evb);
+  auto first = clock.now();
+  std::this_thread::sleep_for(1ms);
+  EXPECT_EQ(first, clock.now());
+
+  auto precise = clock.preciseNow();
+  EXPECT_GT(precise, first);
+  EXPECT_EQ(precise, clock.now());
+}
+
+TEST(LoopClockTest, RefreshedNextIteration) {
+  EventBase evb;
+  LoopClock clock(&evb);
+  auto first = clock.now();
+  std::this_thread::sleep_for(1ms);
+  evb.loopOnce();
+  EXPECT_GT(clock.now(), first);
+}
+
+} // namespace test
+} // namespace quic
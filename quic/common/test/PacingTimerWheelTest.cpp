@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/PacingTimerWheel.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace folly;
+using namespace quic;
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+namespace {
+
+class TestCallback : public PacingTimerWheel::Callback {
+ public:
+  TestCallback(int id, std::vector<int>& fired) : id_(id), fired_(fired) {}
+
+  void pacingTimeoutExpired() noexcept override {
+    fired_.push_back(id_);
+    if (onExpired) {
+      onExpired();
+    }
+  }
+
+  folly::Function<void()> onExpired;
+
+ private:
+  int id_;
+  std::vector<int>& fired_;
+};
+
+} // namespace
+
+class PacingTimerWheelTest : public Test {
+ protected:
+  void loopUntil(folly::Function<bool()> done) {
+    auto deadline = Clock::now() + 5s;
+    while (!done() && Clock::now() < deadline) {
+      evb_.loopOnce(EVLOOP_NONBLOCK);
+    }
+  }
+
+  EventBase evb_;
+  std::vector<int> fired_;
+};
+
+TEST_F(PacingTimerWheelTest, FiresInOrder) {
+  PacingTimerWheel wheel(&evb_, 100us);
+  TestCallback first(1, fired_);
+  TestCallback second(2, fired_);
+  TestCallback third(3, fired_);
+  wheel.scheduleTimeout(third, 20ms);
+  wheel.scheduleTimeout(first, 1ms);
+  wheel.scheduleTimeout(second, 10ms);
+  EXPECT_EQ(3, wheel.size());
+  EXPECT_TRUE(first.isPacingTimeoutScheduled());
+
+  auto start = Clock::now();
+  loopUntil([&] { return fired_.size() == 3; });
+  EXPECT_GE(Clock::now() - start, 20ms);
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), fired_);
+  EXPECT_EQ(0, wheel.size());
+  EXPECT_FALSE(first.isPacingTimeoutScheduled());
+}
+
+TEST_F(PacingTimerWheelTest, SameSlotBatched) {
+  PacingTimerWheel wheel(&evb_, 1ms);
+  size_t batches = 0;
+  size_t firedAtFirstBatch = 0;
+  wheel.setBatchCallback([&] {
+    if (batches++ == 0) {
+      firedAtFirstBatch = fired_.size();
+    }
+  });
+  TestCallback first(1, fired_);
+  TestCallback second(2, fired_);
+  wheel.scheduleTimeout(first, 5ms);
+  wheel.scheduleTimeout(second, 5ms);
+  loopUntil([&] { return fired_.size() == 2; });
+  EXPECT_EQ(1, batches);
+  EXPECT_EQ(2, firedAtFirstBatch);
+}
+
+TEST_F(PacingTimerWheelTest, CancelAndReschedule) {
+  PacingTimerWheel wheel(&evb_, 100us);
+  TestCallback first(1, fired_);
+  TestCallback second(2, fired_);
+  wheel.scheduleTimeout(first, 2ms);
+  wheel.scheduleTimeout(second, 1ms);
+  first.cancelPacingTimeout();
+  EXPECT_FALSE(first.isPacingTimeoutScheduled());
+  EXPECT_EQ(1, wheel.size());
+  // Moves the callback instead of scheduling it twice.
+  wheel.scheduleTimeout(second, 3ms);
+  EXPECT_EQ(1, wheel.size());
+  loopUntil([&] { return !fired_.empty(); });
+  EXPECT_EQ(std::vector<int>({2}), fired_);
+  EXPECT_EQ(0, wheel.size());
+}
+
+TEST_F(PacingTimerWheelTest, CascadesFromHigherLevels) {
+  // Beyond the first level, which spans kSlots slots.
+  PacingTimerWheel wheel(&evb_, 10us);
+  TestCallback near(1, fired_);
+  TestCallback far(2, fired_);
+  wheel.scheduleTimeout(far, 30ms);
+  wheel.scheduleTimeout(near, 100us);
+  auto start = Clock::now();
+  loopUntil([&] { return fired_.size() == 2; });
+  EXPECT_GE(Clock::now() - start, 30ms);
+  EXPECT_EQ(std::vector<int>({1, 2}), fired_);
+}
+
+TEST_F(PacingTimerWheelTest, RescheduleFromCallback) {
+  PacingTimerWheel wheel(&evb_, 100us);
+  TestCallback callback(1, fired_);
+  callback.onExpired = [&] {
+    if (fired_.size() < 3) {
+      wheel.scheduleTimeout(callback, 1ms);
+    }
+  };
+  wheel.scheduleTimeout(callback, 1ms);
+  loopUntil([&] { return fired_.size() == 3; });
+  EXPECT_EQ(3, fired_.size());
+  EXPECT_FALSE(callback.isPacingTimeoutScheduled());
+}
+
+TEST_F(PacingTimerWheelTest, DestroyedCallbackIsRemoved) {
+  PacingTimerWheel wheel(&evb_, 100us);
+  {
+    TestCallback callback(1, fired_);
+    wheel.scheduleTimeout(callback, 1ms);
+    EXPECT_EQ(1, wheel.size());
+  }
+  EXPECT_EQ(0, wheel.size());
+}
+
+} // namespace test
+} // namespace quic
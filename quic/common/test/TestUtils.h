@@ -118,10 +118,7 @@ Buf packetToBufCleartext(
 
 template <typename T, typename S>
 bool isState(const S& s) {
-  return folly::variant_match(
-      s.state,
-      [](const T&) { return true; },
-      [](const auto&) { return false; });
+  return matchesStates<std::decay_t<decltype(s.state)>, T>(s.state);
 }
 
 std::shared_ptr<fizz::server::FizzServerContext> createServerCtx();
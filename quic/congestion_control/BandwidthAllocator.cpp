@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/BandwidthAllocator.h>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace quic {
+
+BandwidthAllocator::Share::Share(BandwidthAllocator& allocator)
+    : allocator_(allocator), index_(allocator.shares_.size()) {
+  allocator_.shares_.push_back(this);
+}
+
+BandwidthAllocator::Share::~Share() {
+  auto& shares = allocator_.shares_;
+  DCHECK_EQ(shares[index_], this);
+  shares[index_] = shares.back();
+  shares[index_]->index_ = index_;
+  shares.pop_back();
+}
+
+BandwidthAllocator::BandwidthAllocator(uint64_t bytesPerSecond)
+    : budget_(bytesPerSecond) {
+  CHECK_GT(budget_, 0);
+}
+
+void BandwidthAllocator::maybeUpdate(TimePoint now) {
+  if (lastUpdate_ && now - *lastUpdate_ < kBandwidthAllocationInterval) {
+    return;
+  }
+  update(now);
+}
+
+void BandwidthAllocator::update(TimePoint now) {
+  lastUpdate_ = now;
+  std::vector<uint64_t> demands;
+  demands.reserve(shares_.size());
+  for (const auto share : shares_) {
+    if (share->demand_ > 0 &&
+        now - share->lastActive_ < kBandwidthAllocationIdleTimeout) {
+      demands.push_back(share->demand_);
+    }
+  }
+  std::sort(demands.begin(), demands.end());
+  // Water filling: hand out the smallest demands in full for as long as the
+  // budget left covers them for all the connections still to be served.
+  folly::Optional<uint64_t> fairShare;
+  uint64_t left = budget_;
+  for (size_t i = 0; i < demands.size(); ++i) {
+    uint64_t remaining = demands.size() - i;
+    if (demands[i] > left / remaining) {
+      fairShare = left / remaining;
+      break;
+    }
+    left -= demands[i];
+  }
+  if (fairShare != fairShare_) {
+    fairShare_ = fairShare;
+    generation_++;
+  }
+}
+
+} // namespace quic
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <folly/Optional.h>
+
+#include <vector>
+
+namespace quic {
+
+/**
+ * Splits an egress budget, in bytes per second, between the connections of a
+ * server worker. The split is max-min fair: connections that want less than
+ * an equal share get what they want, and the rest split what is left evenly.
+ * Connections are only capped while their demands add up to more than the
+ * budget. Only to be used on the worker's thread.
+ */
+class BandwidthAllocator {
+ public:
+  /**
+   * A connection's claim on the budget, for as long as it lives.
+   */
+  class Share {
+   public:
+    explicit Share(BandwidthAllocator& allocator);
+    ~Share();
+
+    Share(const Share&) = delete;
+    Share& operator=(const Share&) = delete;
+
+    // Rate the connection's congestion controller asks for.
+    void setDemand(uint64_t bytesPerSecond) {
+      demand_ = bytesPerSecond;
+    }
+
+    // The connection is writing at now.
+    void markActive(TimePoint now) {
+      lastActive_ = now;
+    }
+
+   private:
+    friend class BandwidthAllocator;
+
+    BandwidthAllocator& allocator_;
+    size_t index_;
+    uint64_t demand_{0};
+    TimePoint lastActive_;
+  };
+
+  explicit BandwidthAllocator(uint64_t bytesPerSecond);
+
+  BandwidthAllocator(const BandwidthAllocator&) = delete;
+  BandwidthAllocator& operator=(const BandwidthAllocator&) = delete;
+
+  /**
+   * Recomputes the fair share from the demands of the connections active
+   * within kBandwidthAllocationIdleTimeout, if the last time was at least
+   * kBandwidthAllocationInterval ago.
+   */
+  void maybeUpdate(TimePoint now);
+
+  // Most a connection may send at, none while the budget isn't exceeded.
+  folly::Optional<uint64_t> getFairShare() const {
+    return fairShare_;
+  }
+
+  // Changes whenever the fair share does.
+  uint64_t getGeneration() const {
+    return generation_;
+  }
+
+  size_t getNumShares() const {
+    return shares_.size();
+  }
+
+  uint64_t getBudget() const {
+    return budget_;
+  }
+
+ private:
+  void update(TimePoint now);
+
+  uint64_t budget_;
+  std::vector<Share*> shares_;
+  folly::Optional<uint64_t> fairShare_;
+  folly::Optional<TimePoint> lastUpdate_;
+  uint64_t generation_{0};
+};
+
+} // namespace quic
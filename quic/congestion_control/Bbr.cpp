@@ -39,7 +39,38 @@ BbrCongestionController::BbrCongestionController(
       recoveryWindow_(
           conn.udpSendPacketLen * conn.transportSettings.maxCwndInMss),
       // TODO: experiment with longer window len for ack aggregation filter
-      maxAckHeightFilter_(kBandwidthWindowLength, 0, 0) {}
+      maxAckHeightFilter_(kBandwidthWindowLength, 0, 0) {
+  const auto& params = conn.transportSettings.congestionControlParams.bbr;
+  if (params.startupGain) {
+    if (*params.startupGain > 1.0f) {
+      startupGain_ = *params.startupGain;
+    } else {
+      LOG(WARNING) << "BBR: ignoring out of range startupGain="
+                   << *params.startupGain;
+    }
+  }
+  if (params.probeBwCwndGain) {
+    if (*params.probeBwCwndGain > 0.0f) {
+      probeBwCwndGain_ = *params.probeBwCwndGain;
+    } else {
+      LOG(WARNING) << "BBR: ignoring out of range probeBwCwndGain="
+                   << *params.probeBwCwndGain;
+    }
+  }
+  cwndGain_ = startupGain_;
+  pacingGain_ = startupGain_;
+  if ((params.startupGain || params.probeBwCwndGain) && conn_.qLogger) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        inflightBytes_,
+        getCongestionWindow(),
+        kCongestionControlParams,
+        folly::to<std::string>(
+            "startupGain=",
+            startupGain_,
+            " probeBwCwndGain=",
+            probeBwCwndGain_));
+  }
+}
 
 void BbrCongestionController::setConnectionEmulation(uint8_t) noexcept {
   /* unsupported for BBR */
@@ -98,11 +129,12 @@ void BbrCongestionController::onPacketLoss(const LossEvent& loss) {
 
   if (loss.persistentCongestion) {
     recoveryWindow_ = conn_.udpSendPacketLen * kMinCwndInMssForBbr;
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
           inflightBytes_,
           getCongestionWindow(),
-          kPersistentCongestion.str(),
+          kPersistentCongestion,
           bbrStateToString(state_),
           bbrRecoveryStateToString(recoveryState_));
     }
@@ -154,6 +186,7 @@ void BbrCongestionController::onPacketAckOrLoss(
   if (lossEvent) {
     subtractAndCheckUnderflow(inflightBytes_, lossEvent->lostBytes);
   }
+  auto prevState = state_;
   if (lossEvent) {
     onPacketLoss(*lossEvent);
   }
@@ -161,6 +194,14 @@ void BbrCongestionController::onPacketAckOrLoss(
     CHECK(!ackEvent->ackedPackets.empty());
     onPacketAcked(*ackEvent, prevInflightBytes, lossEvent.hasValue());
   }
+  if (state_ != prevState) {
+    QUIC_PROBE(
+        cc_state_change,
+        conn_,
+        static_cast<uint8_t>(type()),
+        static_cast<uint8_t>(prevState),
+        static_cast<uint8_t>(state_));
+  }
 }
 
 void BbrCongestionController::onPacketAcked(
@@ -228,11 +269,12 @@ void BbrCongestionController::onPacketAcked(
 
   updateCwnd(ack.ackedBytes, excessiveBytes);
   updatePacing();
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
         inflightBytes_,
         getCongestionWindow(),
-        kCongestionPacketAck.str(),
+        kCongestionPacketAck,
         bbrStateToString(state_),
         bbrRecoveryStateToString(recoveryState_));
   }
@@ -275,8 +317,12 @@ void BbrCongestionController::updatePacing() noexcept {
   // TODO: slower pacing if we are in STARTUP and loss has happened
   std::tie(pacingInterval_, pacingBurstSize_) = calculatePacingRate(
       conn_, pacingWindow_, kMinCwndInMssForBbr, minimalPacingInterval_, mrtt);
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(pacingWindow_, mrtt);
+  }
 
-  if (conn_.transportSettings.pacingEnabled && conn_.qLogger) {
+  if (conn_.transportSettings.pacingEnabled && conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::PacingMetricUpdate)) {
     conn_.qLogger->addPacingMetricUpdate(pacingBurstSize_, pacingInterval_);
   }
 }
@@ -372,8 +418,8 @@ void BbrCongestionController::handleAckInProbeRtt(
 
 void BbrCongestionController::transitToStartup() noexcept {
   state_ = BbrState::Startup;
-  pacingGain_ = kStartupGain;
-  cwndGain_ = kStartupGain;
+  pacingGain_ = startupGain_;
+  cwndGain_ = startupGain_;
 }
 
 void BbrCongestionController::transitToProbeRtt() noexcept {
@@ -389,13 +435,13 @@ void BbrCongestionController::transitToProbeRtt() noexcept {
 
 void BbrCongestionController::transitToDrain() noexcept {
   state_ = BbrState::Drain;
-  pacingGain_ = 1.0f / kStartupGain;
-  cwndGain_ = kStartupGain;
+  pacingGain_ = 1.0f / startupGain_;
+  cwndGain_ = startupGain_;
 }
 
 void BbrCongestionController::transitToProbeBw(TimePoint congestionEventTime) {
   state_ = BbrState::ProbeBw;
-  cwndGain_ = kProbeBwGain;
+  cwndGain_ = probeBwCwndGain_;
 
   pacingGain_ = kPacingGainCycles[pickRandomCycle()];
   cycleStart_ = congestionEventTime;
@@ -510,7 +556,7 @@ void BbrCongestionController::setAppIdle(
     bool idle,
     TimePoint /* eventTime */) noexcept {
   if (conn_.qLogger) {
-    conn_.qLogger->addAppIdleUpdate(kAppIdle.str(), idle);
+    conn_.qLogger->addAppIdleUpdate(kAppIdle, idle);
   }
   QUIC_TRACE(bbr_appidle, conn_, idle);
   /*
@@ -534,6 +580,10 @@ bool BbrCongestionController::isAppLimited() const noexcept {
   return bandwidthSampler_ ? bandwidthSampler_->isAppLimited() : false;
 }
 
+bool BbrCongestionController::inSlowStart() const noexcept {
+  return state_ == BbrCongestionController::BbrState::Startup;
+}
+
 uint64_t BbrCongestionController::getCongestionWindow() const noexcept {
   if (state_ == BbrCongestionController::BbrState::ProbeRtt) {
     if (config_.largeProbeRttCwnd) {
@@ -608,7 +658,7 @@ bool BbrCongestionController::canBePaced() const noexcept {
   return true;
 }
 
-std::string bbrStateToString(BbrCongestionController::BbrState state) {
+folly::StringPiece bbrStateToString(BbrCongestionController::BbrState state) {
   switch (state) {
     case BbrCongestionController::BbrState::Startup:
       return "Startup";
@@ -622,7 +672,7 @@ std::string bbrStateToString(BbrCongestionController::BbrState state) {
   return "BadBbrState";
 }
 
-std::string bbrRecoveryStateToString(
+folly::StringPiece bbrRecoveryStateToString(
     BbrCongestionController::RecoveryState recoveryState) {
   switch (recoveryState) {
     case BbrCongestionController::RecoveryState::NOT_RECOVERY:
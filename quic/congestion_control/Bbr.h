@@ -200,6 +200,8 @@ class BbrCongestionController : public CongestionController {
 
   bool isAppLimited() const noexcept override;
 
+  bool inSlowStart() const noexcept override;
+
   uint64_t getPacingRate(TimePoint currentTime) noexcept override;
   std::chrono::microseconds getPacingInterval() const noexcept override;
   void markPacerTimeoutScheduled(TimePoint) noexcept override;
@@ -297,6 +299,10 @@ class BbrCongestionController : public CongestionController {
   uint64_t pacingBurstSize_{0};
   std::chrono::microseconds pacingInterval_;
 
+  // Gains of Startup and ProbeBw, see CongestionControlParams::BbrParams.
+  float startupGain_{kStartupGain};
+  float probeBwCwndGain_{kProbeBwGain};
+
   float cwndGain_{kStartupGain};
   float pacingGain_{kStartupGain};
 
@@ -350,8 +356,8 @@ class BbrCongestionController : public CongestionController {
 
 std::ostream& operator<<(std::ostream& os, const BbrCongestionController& bbr);
 
-std::string bbrStateToString(BbrCongestionController::BbrState state);
+folly::StringPiece bbrStateToString(BbrCongestionController::BbrState state);
 
-std::string bbrRecoveryStateToString(
+folly::StringPiece bbrRecoveryStateToString(
     BbrCongestionController::RecoveryState recoveryState);
 } // namespace quic
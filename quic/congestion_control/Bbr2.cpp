@@ -0,0 +1,675 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/Bbr2.h>
+
+#include <folly/Random.h>
+#include <quic/QuicConstants.h>
+#include <quic/congestion_control/CongestionControlFunctions.h>
+#include <quic/logging/QLoggerConstants.h>
+#include <quic/logging/QuicLogger.h>
+
+using namespace std::chrono_literals;
+
+namespace quic {
+
+Bbr2CongestionController::Bbr2CongestionController(
+    QuicConnectionStateBase& conn)
+    : conn_(conn),
+      cwnd_(conn.udpSendPacketLen * conn.transportSettings.initCwndInMss),
+      initialCwnd_(
+          conn.udpSendPacketLen * conn.transportSettings.initCwndInMss) {}
+
+void Bbr2CongestionController::setRttSampler(
+    std::unique_ptr<BbrCongestionController::MinRttSampler> sampler) noexcept {
+  minRttSampler_ = std::move(sampler);
+}
+
+void Bbr2CongestionController::setBandwidthSampler(
+    std::unique_ptr<BbrCongestionController::BandwidthSampler>
+        sampler) noexcept {
+  bandwidthSampler_ = std::move(sampler);
+}
+
+void Bbr2CongestionController::setConnectionEmulation(uint8_t) noexcept {
+  /* unsupported for BBR */
+}
+
+CongestionControlType Bbr2CongestionController::type() const noexcept {
+  return CongestionControlType::BBR2;
+}
+
+bool Bbr2CongestionController::updateRoundTripCounter(
+    TimePoint largestAckedSentTime) noexcept {
+  if (largestAckedSentTime > endOfRoundTrip_) {
+    roundTripCounter_++;
+    endOfRoundTrip_ = Clock::now();
+    return true;
+  }
+  return false;
+}
+
+void Bbr2CongestionController::onPacketSent(const OutstandingPacket& packet) {
+  if (!inflightBytes_ && isAppLimited()) {
+    exitingQuiescene_ = true;
+  }
+  addAndCheckOverflow(inflightBytes_, packet.encodedSize);
+  if (inflightBytes_ + conn_.udpSendPacketLen > getCongestionWindow()) {
+    cwndLimitedInRound_ = true;
+  }
+}
+
+void Bbr2CongestionController::onPacketAckOrLoss(
+    folly::Optional<AckEvent> ackEvent,
+    folly::Optional<LossEvent> lossEvent) {
+  auto prevInflightBytes = inflightBytes_;
+  auto prevState = state_;
+  if (ackEvent) {
+    subtractAndCheckUnderflow(inflightBytes_, ackEvent->ackedBytes);
+  }
+  if (lossEvent) {
+    subtractAndCheckUnderflow(inflightBytes_, lossEvent->lostBytes);
+    onPacketLoss(*lossEvent, prevInflightBytes);
+  }
+  if (ackEvent && ackEvent->largestAckedPacket.hasValue()) {
+    CHECK(!ackEvent->ackedPackets.empty());
+    onPacketAcked(*ackEvent);
+  } else if (lossEvent) {
+    // Apply the bounds the loss may have lowered.
+    updateCwnd(0);
+  }
+  if (state_ != prevState) {
+    QUIC_PROBE(
+        cc_state_change,
+        conn_,
+        static_cast<uint8_t>(type()),
+        static_cast<uint8_t>(prevState),
+        static_cast<uint8_t>(state_));
+  }
+}
+
+void Bbr2CongestionController::onPacketLoss(
+    const LossEvent& loss,
+    uint64_t prevInflightBytes) {
+  addAndCheckOverflow(lostBytesInRound_, loss.lostBytes);
+  lossEventsInRound_++;
+  if (probingBandwidth_ && lossTooHigh()) {
+    handleInflightTooHigh(prevInflightBytes);
+  }
+  if (loss.persistentCongestion) {
+    inflightLo_ = conn_.udpSendPacketLen * kMinCwndInMssForBbr;
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+      conn_.qLogger->addCongestionMetricUpdate(
+          inflightBytes_,
+          getCongestionWindow(),
+          kPersistentCongestion,
+          bbr2StateToString(state_));
+    }
+  }
+}
+
+void Bbr2CongestionController::onPacketAcked(const AckEvent& ack) {
+  if (ack.mrttSample && minRttSampler_) {
+    minRttSampler_->newRttSample(ack.mrttSample.value(), ack.ackTime);
+  }
+  bool newRoundTrip = updateRoundTripCounter(ack.ackedPackets.back().time);
+  bool lastAckedPacketAppLimited = ack.ackedPackets.back().isAppLimited;
+  if (bandwidthSampler_) {
+    bandwidthSampler_->onPacketAcked(ack, roundTripCounter_);
+  }
+  addAndCheckOverflow(ackedBytesInRound_, ack.ackedBytes);
+  ackedPacketsInRound_ += ack.ackedPackets.size();
+  ceMarksInRound_ += ack.ecnCeCount;
+
+  if (newRoundTrip) {
+    if (!lastAckedPacketAppLimited) {
+      detectBottleneckBandwidth(lastAckedPacketAppLimited);
+    }
+    onRoundEnd(ack.ackTime);
+  }
+
+  if (state_ == State::Startup && btlbwFound_) {
+    transitToDrain();
+  }
+  if (state_ == State::Drain && inflightBytes_ <= calculateTargetCwnd(1.0)) {
+    transitToProbeBwDown(ack.ackTime);
+  }
+  if (inProbeBw()) {
+    updateProbeBwPhase(ack.ackTime, newRoundTrip);
+  }
+  if (shouldProbeRtt()) {
+    transitToProbeRtt();
+  }
+  exitingQuiescene_ = false;
+  if (state_ == State::ProbeRtt) {
+    handleAckInProbeRtt(newRoundTrip, ack.ackTime);
+  }
+
+  updateCwnd(ack.ackedBytes);
+  updatePacing();
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        inflightBytes_,
+        getCongestionWindow(),
+        kCongestionPacketAck,
+        bbr2StateToString(state_));
+  }
+}
+
+void Bbr2CongestionController::onRoundEnd(TimePoint ackTime) {
+  if (ackedPacketsInRound_) {
+    auto ceFraction = (float)ceMarksInRound_ / ackedPacketsInRound_;
+    ecnAlpha_ =
+        (1 - kBbr2EcnAlphaGain) * ecnAlpha_ + kBbr2EcnAlphaGain * ceFraction;
+  }
+  if (state_ == State::Startup && !btlbwFound_ &&
+      ((lossEventsInRound_ >= kBbr2StartupFullLossCount && lossTooHigh()) ||
+       ecnTooHigh())) {
+    // Startup found where the path starts dropping or marking packets, which
+    // is as much as it can fill.
+    btlbwFound_ = true;
+    inflightHi_ = std::max(
+        calculateTargetCwnd(1.0),
+        std::max(inflightAtRoundStart_, ackedBytesInRound_));
+  }
+  if (probingBandwidth_ && ecnTooHigh()) {
+    handleInflightTooHigh(std::max(inflightAtRoundStart_, ackedBytesInRound_));
+  }
+  if (state_ == State::ProbeBwUp) {
+    probeInflightHiUpward();
+  }
+  adaptLowerBounds(ackTime);
+  resetRound(ackTime);
+}
+
+void Bbr2CongestionController::resetRound(TimePoint roundStart) noexcept {
+  roundStart_ = roundStart;
+  inflightAtRoundStart_ = inflightBytes_;
+  ackedBytesInRound_ = 0;
+  lostBytesInRound_ = 0;
+  lossEventsInRound_ = 0;
+  ackedPacketsInRound_ = 0;
+  ceMarksInRound_ = 0;
+  cwndLimitedInRound_ = false;
+}
+
+bool Bbr2CongestionController::lossTooHigh() const noexcept {
+  // Early in a round only a few bytes have been acked, so compare against
+  // what was in flight when the round started as well.
+  auto roundBytes = std::max(
+      ackedBytesInRound_ + lostBytesInRound_, inflightAtRoundStart_);
+  return lostBytesInRound_ > roundBytes * kBbr2LossThreshold;
+}
+
+bool Bbr2CongestionController::ecnTooHigh() const noexcept {
+  return ackedPacketsInRound_ &&
+      ceMarksInRound_ > ackedPacketsInRound_ * kBbr2EcnThreshold;
+}
+
+void Bbr2CongestionController::handleInflightTooHigh(
+    uint64_t prevInflightBytes) {
+  // Only the first congested round of a probe sets the bound.
+  probingBandwidth_ = false;
+  if (!isAppLimited()) {
+    inflightHi_ = std::max(
+        prevInflightBytes,
+        static_cast<uint64_t>(calculateTargetCwnd(1.0) * kBbr2Beta));
+  }
+  if (state_ == State::ProbeBwUp) {
+    transitToProbeBwDown(Clock::now());
+  }
+}
+
+void Bbr2CongestionController::adaptLowerBounds(TimePoint ackTime) {
+  // The bounds are for when the flow isn't probing. A probe pushes the path
+  // into congestion on purpose, and inflightHi takes care of that.
+  if (state_ == State::Startup || state_ == State::ProbeBwRefill ||
+      state_ == State::ProbeBwUp) {
+    return;
+  }
+  if (!lostBytesInRound_ && !ceMarksInRound_) {
+    return;
+  }
+  if (lostBytesInRound_) {
+    auto elapsed =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            ackTime - roundStart_);
+    auto latestBandwidth = elapsed > 0us
+        ? Bandwidth(ackedBytesInRound_, elapsed)
+        : maxBandwidth();
+    auto reducedBandwidth = bwLo_.value_or(maxBandwidth()) * kBbr2Beta;
+    bwLo_ = latestBandwidth > reducedBandwidth ? latestBandwidth
+                                               : reducedBandwidth;
+    inflightLo_ = std::max(
+        ackedBytesInRound_,
+        static_cast<uint64_t>(inflightLo_.value_or(cwnd_) * kBbr2Beta));
+  }
+  if (ceMarksInRound_) {
+    // Back off in proportion to how much of the traffic gets marked.
+    inflightLo_ = static_cast<uint64_t>(
+        inflightLo_.value_or(cwnd_) * (1 - ecnAlpha_ * kBbr2EcnFactor));
+  }
+  inflightLo_ =
+      std::max(*inflightLo_, conn_.udpSendPacketLen * kMinCwndInMssForBbr);
+}
+
+void Bbr2CongestionController::resetLowerBounds() noexcept {
+  inflightLo_ = folly::none;
+  bwLo_ = folly::none;
+}
+
+void Bbr2CongestionController::probeInflightHiUpward() noexcept {
+  if (!inflightHi_ || !cwndLimitedInRound_) {
+    return;
+  }
+  // Grow exponentially, by 1, 2, 4... packets per round, to find the new
+  // bound quickly if the path got a lot faster.
+  uint64_t growth = static_cast<uint64_t>(conn_.udpSendPacketLen)
+      << std::min<uint32_t>(probeUpRounds_, 30);
+  addAndCheckOverflow(*inflightHi_, growth);
+  probeUpRounds_++;
+}
+
+void Bbr2CongestionController::detectBottleneckBandwidth(
+    bool appLimitedSample) {
+  if (btlbwFound_) {
+    return;
+  }
+  if (appLimitedSample) {
+    return;
+  }
+
+  auto bandwidthTarget = previousStartupBandwidth_ * kExpectedStartupGrowth;
+  auto realBandwidth = maxBandwidth();
+  if (realBandwidth >= bandwidthTarget) {
+    previousStartupBandwidth_ = realBandwidth;
+    slowStartupRoundCounter_ = 0;
+    return;
+  }
+
+  if (++slowStartupRoundCounter_ >= kStartupSlowGrowRoundLimit) {
+    btlbwFound_ = true;
+  }
+}
+
+void Bbr2CongestionController::updateProbeBwPhase(
+    TimePoint ackTime,
+    bool newRoundTrip) {
+  switch (state_) {
+    case State::ProbeBwDown:
+      if (isTimeToProbe(ackTime)) {
+        transitToProbeBwRefill();
+      } else if (
+          inflightBytes_ <=
+          std::min(inflightWithHeadroom(), calculateTargetCwnd(1.0))) {
+        transitToProbeBwCruise();
+      }
+      break;
+    case State::ProbeBwCruise:
+      if (isTimeToProbe(ackTime)) {
+        transitToProbeBwRefill();
+      }
+      break;
+    case State::ProbeBwRefill:
+      // Refill the pipe for a round before probing above it.
+      if (newRoundTrip && roundTripCounter_ > refillRound_) {
+        transitToProbeBwUp(ackTime);
+      }
+      break;
+    case State::ProbeBwUp:
+      if (ackTime - probeUpStart_ > minRtt() &&
+          inflightBytes_ >= calculateTargetCwnd(kBbr2ProbeBwUpGain)) {
+        transitToProbeBwDown(ackTime);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+bool Bbr2CongestionController::isTimeToProbe(TimePoint ackTime) const
+    noexcept {
+  if (ackTime - cycleStart_ >= probeWait_) {
+    return true;
+  }
+  auto bdpInPackets = calculateTargetCwnd(1.0) / conn_.udpSendPacketLen;
+  return roundTripCounter_ - cycleStartRound_ >=
+      std::min(kBbr2MaxRoundsBetweenProbes, bdpInPackets);
+}
+
+bool Bbr2CongestionController::shouldProbeRtt() noexcept {
+  return state_ != State::ProbeRtt && minRttSampler_ &&
+      minRttSampler_->minRttExpired() && !exitingQuiescene_;
+}
+
+void Bbr2CongestionController::handleAckInProbeRtt(
+    bool newRoundTrip,
+    TimePoint ackTime) noexcept {
+  DCHECK(state_ == State::ProbeRtt);
+  // Wait for inflightBytes_ to drop to the ProbeRtt cwnd, then stay there for
+  // max(1 RTT Round, kProbeRttDuration).
+  if (!earliestTimeToExitProbeRtt_ &&
+      inflightBytes_ < getCongestionWindow() + conn_.udpSendPacketLen) {
+    earliestTimeToExitProbeRtt_ = ackTime + kProbeRttDuration;
+    probeRttRound_ = folly::none;
+  } else if (earliestTimeToExitProbeRtt_) {
+    if (!probeRttRound_ && newRoundTrip) {
+      probeRttRound_ = roundTripCounter_;
+    } else if (
+        newRoundTrip && roundTripCounter_ > *probeRttRound_ &&
+        *earliestTimeToExitProbeRtt_ < ackTime) {
+      if (minRttSampler_) {
+        minRttSampler_->timestampMinRtt(ackTime);
+      }
+      resetLowerBounds();
+      if (btlbwFound_) {
+        transitToProbeBwDown(ackTime);
+        transitToProbeBwCruise();
+      } else {
+        transitToStartup();
+      }
+    }
+  }
+}
+
+void Bbr2CongestionController::transitToStartup() noexcept {
+  state_ = State::Startup;
+  pacingGain_ = kStartupGain;
+  cwndGain_ = kBbr2CwndGain;
+}
+
+void Bbr2CongestionController::transitToDrain() noexcept {
+  state_ = State::Drain;
+  pacingGain_ = 1.0f / kStartupGain;
+  cwndGain_ = kBbr2CwndGain;
+}
+
+void Bbr2CongestionController::transitToProbeBwDown(TimePoint eventTime) {
+  state_ = State::ProbeBwDown;
+  pacingGain_ = kBbr2ProbeBwDownGain;
+  cwndGain_ = kBbr2CwndGain;
+  cycleStart_ = eventTime;
+  cycleStartRound_ = roundTripCounter_;
+  probeWait_ = kBbr2ProbeWaitBase +
+      std::chrono::milliseconds(
+                   folly::Random::rand32(kBbr2ProbeWaitJitter.count()));
+  probingBandwidth_ = false;
+  probeUpRounds_ = 0;
+}
+
+void Bbr2CongestionController::transitToProbeBwCruise() noexcept {
+  state_ = State::ProbeBwCruise;
+  pacingGain_ = 1.0f;
+}
+
+void Bbr2CongestionController::transitToProbeBwRefill() noexcept {
+  resetLowerBounds();
+  state_ = State::ProbeBwRefill;
+  pacingGain_ = 1.0f;
+  refillRound_ = roundTripCounter_;
+  probingBandwidth_ = true;
+  probeUpRounds_ = 0;
+}
+
+void Bbr2CongestionController::transitToProbeBwUp(
+    TimePoint eventTime) noexcept {
+  state_ = State::ProbeBwUp;
+  pacingGain_ = kBbr2ProbeBwUpGain;
+  probeUpStart_ = eventTime;
+}
+
+void Bbr2CongestionController::transitToProbeRtt() noexcept {
+  state_ = State::ProbeRtt;
+  pacingGain_ = 1.0f;
+  earliestTimeToExitProbeRtt_ = folly::none;
+  probeRttRound_ = folly::none;
+  if (bandwidthSampler_) {
+    bandwidthSampler_->onAppLimited();
+  }
+}
+
+bool Bbr2CongestionController::inProbeBw() const noexcept {
+  return state_ == State::ProbeBwDown || state_ == State::ProbeBwCruise ||
+      state_ == State::ProbeBwRefill || state_ == State::ProbeBwUp;
+}
+
+uint64_t Bbr2CongestionController::calculateTargetCwnd(float gain) const
+    noexcept {
+  auto bandwidthEst = maxBandwidth();
+  auto minRttEst = minRtt();
+  if (!bandwidthEst || minRttEst == 0us) {
+    return boundedCwnd(
+        gain * initialCwnd_,
+        conn_.udpSendPacketLen,
+        conn_.transportSettings.maxCwndInMss,
+        kMinCwndInMssForBbr);
+  }
+  uint64_t bdp = bandwidthEst * minRttEst;
+  return boundedCwnd(
+      bdp * gain,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      kMinCwndInMssForBbr);
+}
+
+uint64_t Bbr2CongestionController::inflightWithHeadroom() const noexcept {
+  if (!inflightHi_) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  uint64_t headroom = std::max<uint64_t>(
+      conn_.udpSendPacketLen, (1 - kBbr2InflightHeadroom) * *inflightHi_);
+  uint64_t minCwnd = conn_.udpSendPacketLen * kMinCwndInMssForBbr;
+  return *inflightHi_ > headroom + minCwnd ? *inflightHi_ - headroom
+                                           : minCwnd;
+}
+
+uint64_t Bbr2CongestionController::probeRttCwnd() const noexcept {
+  return calculateTargetCwnd(kBbr2ProbeRttCwndGain);
+}
+
+void Bbr2CongestionController::updateCwnd(uint64_t ackedBytes) noexcept {
+  auto targetCwnd = calculateTargetCwnd(cwndGain_);
+  if (btlbwFound_) {
+    cwnd_ = std::min(targetCwnd, cwnd_ + ackedBytes);
+  } else if (
+      cwnd_ < targetCwnd || conn_.lossState.totalBytesAcked < initialCwnd_) {
+    cwnd_ += ackedBytes;
+  }
+
+  // Bound the window with what the model learned from congestion.
+  uint64_t cap = std::numeric_limits<uint64_t>::max();
+  if (inflightHi_) {
+    if (state_ == State::ProbeBwCruise || state_ == State::ProbeRtt) {
+      cap = inflightWithHeadroom();
+    } else if (inProbeBw()) {
+      cap = *inflightHi_;
+    }
+  }
+  if (inflightLo_) {
+    cap = std::min(cap, *inflightLo_);
+  }
+  cwnd_ = boundedCwnd(
+      std::min(cwnd_, cap),
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      kMinCwndInMssForBbr);
+}
+
+void Bbr2CongestionController::updatePacing() noexcept {
+  auto bandwidthEstimate = bandwidth();
+  if (!bandwidthEstimate) {
+    return;
+  }
+  auto mrtt = minRtt();
+  if (mrtt == 0us || mrtt < minimalPacingInterval_) {
+    return;
+  }
+  uint64_t targetPacingWindow =
+      bandwidthEstimate * (pacingGain_ * kBbr2PacingMargin) * mrtt;
+  if (btlbwFound_) {
+    pacingWindow_ = targetPacingWindow;
+  } else if (
+      !pacingWindow_ &&
+      conn_.lossState.mrtt != std::chrono::microseconds::max() &&
+      conn_.lossState.mrtt != 0us &&
+      conn_.lossState.mrtt >= minimalPacingInterval_) {
+    pacingWindow_ = initialCwnd_;
+    mrtt = conn_.lossState.mrtt;
+  } else {
+    pacingWindow_ = std::max(pacingWindow_, targetPacingWindow);
+  }
+  std::tie(pacingInterval_, pacingBurstSize_) = calculatePacingRate(
+      conn_, pacingWindow_, kMinCwndInMssForBbr, minimalPacingInterval_, mrtt);
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(pacingWindow_, mrtt);
+  }
+
+  if (conn_.transportSettings.pacingEnabled && conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::PacingMetricUpdate)) {
+    conn_.qLogger->addPacingMetricUpdate(pacingBurstSize_, pacingInterval_);
+  }
+}
+
+std::chrono::microseconds Bbr2CongestionController::minRtt() const noexcept {
+  return minRttSampler_ ? minRttSampler_->minRtt() : 0us;
+}
+
+Bandwidth Bbr2CongestionController::maxBandwidth() const noexcept {
+  return bandwidthSampler_ ? bandwidthSampler_->getBandwidth() : Bandwidth();
+}
+
+Bandwidth Bbr2CongestionController::bandwidth() const noexcept {
+  auto bandwidthEst = maxBandwidth();
+  if (bwLo_ && *bwLo_ && *bwLo_ < bandwidthEst) {
+    return *bwLo_;
+  }
+  return bandwidthEst;
+}
+
+uint64_t Bbr2CongestionController::getWritableBytes() const noexcept {
+  return getCongestionWindow() > inflightBytes_
+      ? getCongestionWindow() - inflightBytes_
+      : 0;
+}
+
+uint64_t Bbr2CongestionController::getCongestionWindow() const noexcept {
+  if (state_ == State::ProbeRtt) {
+    return std::min(cwnd_, probeRttCwnd());
+  }
+  return cwnd_;
+}
+
+void Bbr2CongestionController::setAppIdle(
+    bool idle,
+    TimePoint /* eventTime */) noexcept {
+  if (conn_.qLogger) {
+    conn_.qLogger->addAppIdleUpdate(kAppIdle, idle);
+  }
+}
+
+void Bbr2CongestionController::setAppLimited() {
+  if (inflightBytes_ > getCongestionWindow()) {
+    return;
+  }
+  if (bandwidthSampler_) {
+    bandwidthSampler_->onAppLimited();
+  }
+}
+
+bool Bbr2CongestionController::isAppLimited() const noexcept {
+  return bandwidthSampler_ ? bandwidthSampler_->isAppLimited() : false;
+}
+
+bool Bbr2CongestionController::inSlowStart() const noexcept {
+  return state_ == State::Startup;
+}
+
+void Bbr2CongestionController::onRemoveBytesFromInflight(
+    uint64_t bytesToRemove) {
+  subtractAndCheckUnderflow(inflightBytes_, bytesToRemove);
+}
+
+uint64_t Bbr2CongestionController::getPacingRate(
+    TimePoint /* currentTime */) noexcept {
+  return pacingBurstSize_;
+}
+
+std::chrono::microseconds Bbr2CongestionController::getPacingInterval() const
+    noexcept {
+  return pacingInterval_;
+}
+
+void Bbr2CongestionController::markPacerTimeoutScheduled(TimePoint) noexcept {
+  /* This API is going away */
+}
+
+void Bbr2CongestionController::setMinimalPacingInterval(
+    std::chrono::microseconds interval) noexcept {
+  minimalPacingInterval_ = interval;
+}
+
+bool Bbr2CongestionController::canBePaced() const noexcept {
+  if (!bandwidth() || 0us == minRtt()) {
+    return false;
+  }
+  if (conn_.lossState.srtt < minimalPacingInterval_) {
+    return false;
+  }
+  return true;
+}
+
+Bbr2CongestionController::State Bbr2CongestionController::state() const
+    noexcept {
+  return state_;
+}
+
+folly::Optional<uint64_t> Bbr2CongestionController::inflightHi() const
+    noexcept {
+  return inflightHi_;
+}
+
+folly::Optional<uint64_t> Bbr2CongestionController::inflightLo() const
+    noexcept {
+  return inflightLo_;
+}
+
+folly::StringPiece bbr2StateToString(Bbr2CongestionController::State state) {
+  switch (state) {
+    case Bbr2CongestionController::State::Startup:
+      return "Startup";
+    case Bbr2CongestionController::State::Drain:
+      return "Drain";
+    case Bbr2CongestionController::State::ProbeBwDown:
+      return "ProbeBwDown";
+    case Bbr2CongestionController::State::ProbeBwCruise:
+      return "ProbeBwCruise";
+    case Bbr2CongestionController::State::ProbeBwRefill:
+      return "ProbeBwRefill";
+    case Bbr2CongestionController::State::ProbeBwUp:
+      return "ProbeBwUp";
+    case Bbr2CongestionController::State::ProbeRtt:
+      return "ProbeRtt";
+  }
+  return "BadBbr2State";
+}
+
+std::ostream& operator<<(
+    std::ostream& os,
+    const Bbr2CongestionController& bbr) {
+  os << "Bbr2: state=" << bbr2StateToString(bbr.state_)
+     << ", cwnd=" << bbr.cwnd_ << ", pacingGain_=" << bbr.pacingGain_
+     << ", inflightHi=" << bbr.inflightHi_.value_or(0)
+     << ", inflightLo=" << bbr.inflightLo_.value_or(0)
+     << ", minRtt=" << bbr.minRtt().count()
+     << "us, bandwidth=" << bbr.bandwidth();
+  return os;
+}
+
+} // namespace quic
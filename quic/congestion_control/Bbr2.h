@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/congestion_control/Bbr.h>
+
+namespace quic {
+
+// Pacing gain while ProbeBw drains the queue left by probing.
+constexpr float kBbr2ProbeBwDownGain = 0.9f;
+// Pacing gain while ProbeBw probes for more bandwidth.
+constexpr float kBbr2ProbeBwUpGain = 1.25f;
+// Cwnd gain in every state but ProbeRtt.
+constexpr float kBbr2CwndGain = 2.0f;
+// Cwnd during ProbeRtt, as a fraction of the BDP.
+constexpr float kBbr2ProbeRttCwndGain = 0.5f;
+// Highest loss rate, i.e. lost / (lost + acked) bytes, tolerated in a round.
+constexpr float kBbr2LossThreshold = 0.02f;
+// Highest fraction of CE marked packets tolerated in a round.
+constexpr float kBbr2EcnThreshold = 0.5f;
+// Gain of the moving average of the fraction of CE marked packets.
+constexpr float kBbr2EcnAlphaGain = 1.0f / 16;
+// How far inflightLo backs off for a moving average of 1.0 above.
+constexpr float kBbr2EcnFactor = 1.0f / 3;
+// Multiplicative decrease of the bounds on a congestion signal.
+constexpr float kBbr2Beta = 0.7f;
+// Part of inflightHi used while cruising, the rest is left to other flows.
+constexpr float kBbr2InflightHeadroom = 0.85f;
+// Pacing rate as a fraction of the bandwidth estimate, to keep the queue
+// from growing at the estimated rate.
+constexpr float kBbr2PacingMargin = 0.99f;
+// Startup gives up on growing after this many losses in a lossy round.
+constexpr uint32_t kBbr2StartupFullLossCount = 6;
+// Time between two bandwidth probes is the base plus a random part of up to
+// the jitter, so that flows sharing a bottleneck don't probe in lockstep.
+constexpr std::chrono::milliseconds kBbr2ProbeWaitBase{2000};
+constexpr std::chrono::milliseconds kBbr2ProbeWaitJitter{1000};
+// Probe after at most this many rounds as well, so a flow with a small BDP
+// probes about as often as Reno would grow its window.
+constexpr uint64_t kBbr2MaxRoundsBetweenProbes = 63;
+// How long a min rtt sample lasts before ProbeRtt needs a new one.
+constexpr std::chrono::seconds kBbr2ProbeRttInterval{5};
+
+/**
+ * BBRv2, following draft-cardwell-iccrg-bbr-congestion-control-02.
+ *
+ * On top of the bandwidth and min rtt model of BBR, it bounds inflight bytes
+ * from above with inflightHi, which is set on a round with too much loss or
+ * too many CE marks while probing, and from below with inflightLo and bwLo,
+ * which back off on every congested round and reset on the next probe.
+ * ProbeBw probes bandwidth at most every 2-3 seconds through its Down, Cruise,
+ * Refill and Up phases, instead of cycling through pacing gains every min
+ * rtt.
+ *
+ * It reuses the samplers of BbrCongestionController.
+ */
+class Bbr2CongestionController : public CongestionController {
+ public:
+  enum class State : uint8_t {
+    Startup,
+    Drain,
+    ProbeBwDown,
+    ProbeBwCruise,
+    ProbeBwRefill,
+    ProbeBwUp,
+    ProbeRtt,
+  };
+
+  explicit Bbr2CongestionController(QuicConnectionStateBase& conn);
+
+  void setRttSampler(
+      std::unique_ptr<BbrCongestionController::MinRttSampler> sampler) noexcept;
+  void setBandwidthSampler(
+      std::unique_ptr<BbrCongestionController::BandwidthSampler>
+          sampler) noexcept;
+
+  void onRemoveBytesFromInflight(uint64_t bytesToRemove) override;
+  void onPacketSent(const OutstandingPacket&) override;
+  void onPacketAckOrLoss(
+      folly::Optional<AckEvent> ackEvent,
+      folly::Optional<LossEvent> lossEvent) override;
+  uint64_t getWritableBytes() const noexcept override;
+
+  uint64_t getCongestionWindow() const noexcept override;
+  void setConnectionEmulation(uint8_t) noexcept override;
+  CongestionControlType type() const noexcept override;
+  void setAppIdle(bool idle, TimePoint eventTime) noexcept override;
+  void setAppLimited() override;
+
+  bool isAppLimited() const noexcept override;
+
+  bool inSlowStart() const noexcept override;
+
+  uint64_t getPacingRate(TimePoint currentTime) noexcept override;
+  std::chrono::microseconds getPacingInterval() const noexcept override;
+  void markPacerTimeoutScheduled(TimePoint) noexcept override;
+  void setMinimalPacingInterval(
+      std::chrono::microseconds interval) noexcept override;
+  bool canBePaced() const noexcept override;
+
+  State state() const noexcept;
+  folly::Optional<uint64_t> inflightHi() const noexcept;
+  folly::Optional<uint64_t> inflightLo() const noexcept;
+
+ private:
+  void onPacketAcked(const AckEvent& ack);
+  void onPacketLoss(const LossEvent& loss, uint64_t prevInflightBytes);
+
+  /*
+   * Return if we are at the start of a new round trip.
+   */
+  bool updateRoundTripCounter(TimePoint largestAckedSentTime) noexcept;
+  // Called at the end of every round with the congestion signals of the
+  // round.
+  void onRoundEnd(TimePoint ackTime);
+  void resetRound(TimePoint roundStart) noexcept;
+
+  bool lossTooHigh() const noexcept;
+  bool ecnTooHigh() const noexcept;
+  // React to a round showing that inflight bytes of prevInflightBytes
+  // congest the path.
+  void handleInflightTooHigh(uint64_t prevInflightBytes);
+  void adaptLowerBounds(TimePoint ackTime);
+  void resetLowerBounds() noexcept;
+  void probeInflightHiUpward() noexcept;
+
+  void detectBottleneckBandwidth(bool appLimitedSample);
+  void updateProbeBwPhase(TimePoint ackTime, bool newRoundTrip);
+  bool isTimeToProbe(TimePoint ackTime) const noexcept;
+  bool shouldProbeRtt() noexcept;
+  void handleAckInProbeRtt(bool newRoundTrip, TimePoint ackTime) noexcept;
+
+  void transitToDrain() noexcept;
+  void transitToProbeBwDown(TimePoint eventTime);
+  void transitToProbeBwCruise() noexcept;
+  void transitToProbeBwRefill() noexcept;
+  void transitToProbeBwUp(TimePoint eventTime) noexcept;
+  void transitToProbeRtt() noexcept;
+  void transitToStartup() noexcept;
+
+  bool inProbeBw() const noexcept;
+  uint64_t calculateTargetCwnd(float gain) const noexcept;
+  uint64_t inflightWithHeadroom() const noexcept;
+  uint64_t probeRttCwnd() const noexcept;
+  void updateCwnd(uint64_t ackedBytes) noexcept;
+  void updatePacing() noexcept;
+  std::chrono::microseconds minRtt() const noexcept;
+  Bandwidth maxBandwidth() const noexcept;
+  // The bandwidth the model paces at, bounded by bwLo.
+  Bandwidth bandwidth() const noexcept;
+
+  QuicConnectionStateBase& conn_;
+  State state_{State::Startup};
+
+  // Number of round trips the connection has witnessed
+  uint64_t roundTripCounter_{0};
+  // When a packet with send time later than endOfRoundTrip_ is acked, the
+  // current round strip is ended.
+  TimePoint endOfRoundTrip_;
+  // Cwnd in bytes
+  uint64_t cwnd_;
+  // Initial cwnd in bytes
+  uint64_t initialCwnd_;
+  // inflight bytes
+  uint64_t inflightBytes_{0};
+  // Number of bytes we expect to send over on RTT when paced write.
+  uint64_t pacingWindow_{0};
+  uint64_t pacingBurstSize_{0};
+  std::chrono::microseconds pacingInterval_{0};
+
+  float cwndGain_{kBbr2CwndGain};
+  float pacingGain_{kStartupGain};
+
+  std::unique_ptr<BbrCongestionController::MinRttSampler> minRttSampler_;
+  std::unique_ptr<BbrCongestionController::BandwidthSampler> bandwidthSampler_;
+
+  // Whether we have found the bottleneck link bandwidth
+  bool btlbwFound_{false};
+  Bandwidth previousStartupBandwidth_;
+  // Counter of continuous round trips in STARTUP that bandwidth isn't growing
+  // fast enough
+  uint8_t slowStartupRoundCounter_{0};
+
+  // Long term upper bound of inflight bytes.
+  folly::Optional<uint64_t> inflightHi_;
+  // Short term lower bounds of inflight bytes and bandwidth.
+  folly::Optional<uint64_t> inflightLo_;
+  folly::Optional<Bandwidth> bwLo_;
+
+  // Congestion signals of the current round.
+  TimePoint roundStart_;
+  uint64_t inflightAtRoundStart_{0};
+  uint64_t ackedBytesInRound_{0};
+  uint64_t lostBytesInRound_{0};
+  uint32_t lossEventsInRound_{0};
+  uint64_t ackedPacketsInRound_{0};
+  uint64_t ceMarksInRound_{0};
+  bool cwndLimitedInRound_{false};
+  // Moving average of the fraction of CE marked packets per round.
+  float ecnAlpha_{0.0f};
+
+  // When the current ProbeBw cycle, which starts with ProbeBwDown, started.
+  TimePoint cycleStart_;
+  uint64_t cycleStartRound_{0};
+  std::chrono::microseconds probeWait_{kBbr2ProbeWaitBase};
+  // Round in which ProbeBwRefill started.
+  uint64_t refillRound_{0};
+  // Time ProbeBwUp started.
+  TimePoint probeUpStart_;
+  // Number of rounds inflightHi grew during the current ProbeBwUp.
+  uint32_t probeUpRounds_{0};
+  // Whether congestion signals are still compared against inflightHi in the
+  // current probe, until the first round with too much loss or CE marks.
+  bool probingBandwidth_{false};
+
+  // See the ProbeRtt members of BbrCongestionController.
+  folly::Optional<TimePoint> earliestTimeToExitProbeRtt_;
+  folly::Optional<uint64_t> probeRttRound_;
+
+  // The connection was very inactive and we are leaving that.
+  bool exitingQuiescene_{false};
+
+  std::chrono::microseconds minimalPacingInterval_{
+      folly::HHWheelTimerHighRes::DEFAULT_TICK_INTERVAL};
+
+  friend std::ostream& operator<<(
+      std::ostream& os,
+      const Bbr2CongestionController& bbr);
+};
+
+std::ostream& operator<<(std::ostream& os, const Bbr2CongestionController& bbr);
+
+folly::StringPiece bbr2StateToString(Bbr2CongestionController::State state);
+} // namespace quic
@@ -32,77 +32,149 @@ void BbrBandwidthSampler::onPacketAcked(
           conn_,
           *ackEvent.largestAckedPacket,
           appLimitedExitTarget_.time_since_epoch().count());
-      if (conn_.qLogger) {
+      if (conn_.qLogger &&
+          conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
         conn_.qLogger->addCongestionMetricUpdate(
             getBandwidth().bytes,
             getBandwidth().bytes,
-            kCongestionAppUnlimited.str());
+            kCongestionAppUnlimited);
       }
     }
   }
-  // TODO: If i'm smart enough, maybe we don't have to loop through the acked
-  // packets. Can we calculate the bandwidth based on aggregated stats?
-  for (auto const& outstandingPacket : ackEvent.ackedPackets) {
-    if (outstandingPacket.encodedSize == 0) {
-      continue;
+  if (conn_.transportSettings.bbrPerAckBandwidthSample) {
+    // The filter only keeps the max, and the packet sent last measures the
+    // delivery rate over the most recent interval, so one sample per ack is
+    // enough.
+    const OutstandingPacket* lastSentPacket = nullptr;
+    for (auto const& outstandingPacket : ackEvent.ackedPackets) {
+      if (outstandingPacket.encodedSize != 0 &&
+          (!lastSentPacket ||
+           outstandingPacket.totalBytesSent > lastSentPacket->totalBytesSent)) {
+        lastSentPacket = &outstandingPacket;
+      }
+    }
+    if (lastSentPacket) {
+      onSample(
+          measureBandwidth(ackEvent, *lastSentPacket),
+          lastSentPacket->isAppLimited,
+          rttCounter);
     }
-    folly::Optional<Bandwidth> sendRate, ackRate;
-    if (outstandingPacket.lastAckedPacketInfo) {
-      // TODO: I think I can DCHECK this condition:
-      if (outstandingPacket.time >
-          outstandingPacket.lastAckedPacketInfo->sentTime) {
-        DCHECK_GE(
-            outstandingPacket.totalBytesSent,
-            outstandingPacket.lastAckedPacketInfo->totalBytesSent);
-        sendRate.emplace(
-            outstandingPacket.totalBytesSent -
-                outstandingPacket.lastAckedPacketInfo->totalBytesSent,
-            std::chrono::duration_cast<std::chrono::microseconds>(
-                outstandingPacket.time -
-                outstandingPacket.lastAckedPacketInfo->sentTime));
+  } else {
+    for (auto const& outstandingPacket : ackEvent.ackedPackets) {
+      if (outstandingPacket.encodedSize == 0) {
+        continue;
       }
+      onSample(
+          measureBandwidth(ackEvent, outstandingPacket),
+          outstandingPacket.isAppLimited,
+          rttCounter);
+    }
+  }
+  recordAckedState();
+}
 
-      if (ackEvent.ackTime > outstandingPacket.lastAckedPacketInfo->ackTime) {
-        DCHECK_GE(
-            conn_.lossState.totalBytesAcked,
-            outstandingPacket.lastAckedPacketInfo->totalBytesAcked);
-        ackRate.emplace(
-            conn_.lossState.totalBytesAcked -
-                outstandingPacket.lastAckedPacketInfo->totalBytesAcked,
-            std::chrono::duration_cast<std::chrono::microseconds>(
-                ackEvent.ackTime -
-                outstandingPacket.lastAckedPacketInfo->ackTime));
-      }
-    } else if (ackEvent.ackTime > outstandingPacket.time) {
-      // No previous ack info from outstanding packet, fallback to bytes/lrtt.
-      // This is a per packet delivery rate. Given there can be multiple packets
-      // inflight during the time, this is clearly under estimating bandwidth.
-      // But it's better than nothing.
-      //
-      // Note that this if condition:
-      //   ack.Event.ackTime > outstandingPackcet.time
-      // will almost always be true unless your network is very very fast, or
-      // your clock is broken, or isn't steady. Anyway, in the rare cases that
-      // it isn't true, divide by zero will crash.
+Bandwidth BbrBandwidthSampler::measureBandwidth(
+    const CongestionController::AckEvent& ackEvent,
+    const OutstandingPacket& outstandingPacket) const {
+  folly::Optional<Bandwidth> sendRate, ackRate;
+  auto ackedState = findAckedState(outstandingPacket);
+  if (ackedState) {
+    // TODO: I think I can DCHECK this condition:
+    if (outstandingPacket.time > ackedState->sentTime) {
+      DCHECK_GE(outstandingPacket.totalBytesSent, ackedState->totalBytesSent);
       sendRate.emplace(
-          outstandingPacket.encodedSize,
+          outstandingPacket.totalBytesSent - ackedState->totalBytesSent,
           std::chrono::duration_cast<std::chrono::microseconds>(
-              ackEvent.ackTime - outstandingPacket.time));
+              outstandingPacket.time - ackedState->sentTime));
     }
-    Bandwidth measuredBandwidth;
-    if (sendRate && ackRate) {
-      measuredBandwidth = *sendRate >= *ackRate ? *sendRate : *ackRate;
-    } else if (sendRate) {
-      measuredBandwidth = *sendRate;
-    } else if (ackRate) {
-      measuredBandwidth = *ackRate;
-    }
-    // If a sample is from a packet sent during app-limited period, we should
-    // still use this sample if it's >= current best value.
-    if (measuredBandwidth >= windowedFilter_.GetBest() ||
-        !outstandingPacket.isAppLimited) {
-      windowedFilter_.Update(measuredBandwidth, rttCounter);
+
+    if (ackEvent.ackTime > ackedState->ackTime) {
+      DCHECK_GE(conn_.lossState.totalBytesAcked, ackedState->totalBytesAcked);
+      ackRate.emplace(
+          conn_.lossState.totalBytesAcked - ackedState->totalBytesAcked,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              ackEvent.ackTime - ackedState->ackTime));
     }
+  } else if (ackEvent.ackTime > outstandingPacket.time) {
+    // No previous ack info from outstanding packet, fallback to bytes/lrtt.
+    // This is a per packet delivery rate. Given there can be multiple packets
+    // inflight during the time, this is clearly under estimating bandwidth.
+    // But it's better than nothing.
+    //
+    // Note that this if condition:
+    //   ack.Event.ackTime > outstandingPackcet.time
+    // will almost always be true unless your network is very very fast, or
+    // your clock is broken, or isn't steady. Anyway, in the rare cases that
+    // it isn't true, divide by zero will crash.
+    sendRate.emplace(
+        outstandingPacket.encodedSize,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            ackEvent.ackTime - outstandingPacket.time));
+  }
+  Bandwidth measuredBandwidth;
+  if (sendRate && ackRate) {
+    measuredBandwidth = *sendRate >= *ackRate ? *sendRate : *ackRate;
+  } else if (sendRate) {
+    measuredBandwidth = *sendRate;
+  } else if (ackRate) {
+    measuredBandwidth = *ackRate;
+  }
+  return measuredBandwidth;
+}
+
+void BbrBandwidthSampler::onSample(
+    Bandwidth measuredBandwidth,
+    bool appLimited,
+    uint64_t rttCounter) {
+  latestSample_ = Sample{measuredBandwidth, appLimited};
+  // If a sample is from a packet sent during app-limited period, we should
+  // still use this sample if it's >= current best value.
+  if (measuredBandwidth >= windowedFilter_.GetBest() || !appLimited) {
+    windowedFilter_.Update(measuredBandwidth, rttCounter);
+  }
+}
+
+const BbrBandwidthSampler::AckedState* BbrBandwidthSampler::findAckedState(
+    const OutstandingPacket& packet) const {
+  // The last state recorded before the packet was sent.
+  auto it = std::lower_bound(
+      ackedStates_.begin(),
+      ackedStates_.end(),
+      packet.totalBytesSent,
+      [](const AckedState& state, uint64_t totalBytesSent) {
+        return state.totalBytesSent < totalBytesSent;
+      });
+  if (it == ackedStates_.begin()) {
+    return nullptr;
+  }
+  return &*std::prev(it);
+}
+
+void BbrBandwidthSampler::recordAckedState() {
+  if (!conn_.lossState.lastAckedTime ||
+      !conn_.lossState.lastAckedPacketSentTime) {
+    return;
+  }
+  AckedState ackedState{*conn_.lossState.lastAckedPacketSentTime,
+                        *conn_.lossState.lastAckedTime,
+                        conn_.lossState.totalBytesSentAtLastAck,
+                        conn_.lossState.totalBytesAckedAtLastAck};
+  if (!ackedStates_.empty() &&
+      ackedStates_.back().totalBytesSent >= ackedState.totalBytesSent) {
+    // Nothing was sent since the previous ack, the packets sent next measure
+    // against this one.
+    ackedStates_.back() = ackedState;
+  } else {
+    ackedStates_.push_back(ackedState);
+  }
+  // The oldest outstanding packet was sent first, and the packets sent after
+  // it can't need a state older than its.
+  uint64_t oldestTotalBytesSent = conn_.outstandingPackets.empty()
+      ? std::numeric_limits<uint64_t>::max()
+      : conn_.outstandingPackets.front().totalBytesSent;
+  while (ackedStates_.size() > 1 &&
+         ackedStates_[1].totalBytesSent < oldestTotalBytesSent) {
+    ackedStates_.pop_front();
   }
 }
 
@@ -111,15 +183,26 @@ void BbrBandwidthSampler::onAppLimited() {
   appLimitedExitTarget_ = Clock::now();
   QUIC_TRACE(
       bbr_applimited, conn_, appLimitedExitTarget_.time_since_epoch().count());
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
         getBandwidth().bytes,
         getBandwidth().bytes,
-        kCongestionAppLimited.str());
+        kCongestionAppLimited);
   }
 }
 
 bool BbrBandwidthSampler::isAppLimited() const noexcept {
   return appLimited_;
 }
+
+const folly::Optional<BbrBandwidthSampler::Sample>&
+BbrBandwidthSampler::getLatestSample() const noexcept {
+  return latestSample_;
+}
+
+size_t BbrBandwidthSampler::getAckedStatesSize() const noexcept {
+  return ackedStates_.size();
+}
+
 } // namespace quic
@@ -13,6 +13,8 @@
 #include <quic/congestion_control/third_party/windowed_filter.h>
 #include <quic/state/StateData.h>
 
+#include <deque>
+
 namespace quic {
 
 class BbrBandwidthSampler : public BbrCongestionController::BandwidthSampler {
@@ -36,7 +38,55 @@ class BbrBandwidthSampler : public BbrCongestionController::BandwidthSampler {
 
   bool isAppLimited() const noexcept override;
 
+  struct Sample {
+    Bandwidth bandwidth;
+    // Whether the acked packet was sent while the connection was app-limited.
+    // Such a sample only measures how fast the app was sending.
+    bool appLimited{false};
+  };
+
+  /**
+   * The latest bandwidth sample, whether or not it made it into the
+   * bandwidth filter.
+   */
+  const folly::Optional<Sample>& getLatestSample() const noexcept;
+
+  // for unit test
+  size_t getAckedStatesSize() const noexcept;
+
  private:
+  /**
+   * The connection's delivery state right after an ack: the last acked packet
+   * and the byte counters. Every packet sent until the next ack measures its
+   * delivery rate against it. Packets don't carry it, the sampler keeps one
+   * per ack, and finds the one of a packet by the packet's totalBytesSent.
+   */
+  struct AckedState {
+    TimePoint sentTime;
+    TimePoint ackTime;
+    // Total sent bytes on this connection when the last acked packet is acked.
+    uint64_t totalBytesSent;
+    // Total acked bytes on this connection when last acked packet is acked,
+    // including the last acked packet.
+    uint64_t totalBytesAcked;
+  };
+
+  // The AckedState a packet was sent with, or nullptr if it was sent before
+  // the first ack, or its AckedState is gone.
+  const AckedState* findAckedState(const OutstandingPacket& packet) const;
+
+  // The delivery rate of the packet since its AckedState, or a per packet
+  // rate over the rtt without one.
+  Bandwidth measureBandwidth(
+      const CongestionController::AckEvent& ackEvent,
+      const OutstandingPacket& packet) const;
+
+  void onSample(Bandwidth bandwidth, bool appLimited, uint64_t rttCounter);
+
+  // Records the current ack, and drops the states no outstanding packet
+  // was sent with anymore.
+  void recordAckedState();
+
   QuicConnectionStateBase& conn_;
   WindowedFilter<Bandwidth, MaxFilter<Bandwidth>, uint64_t, uint64_t>
       windowedFilter_;
@@ -45,6 +95,11 @@ class BbrBandwidthSampler : public BbrCongestionController::BandwidthSampler {
   // When a packet with a send time later than appLimitedExitTarget_ is acked,
   // an app-limited connection is considered no longer app-limited.
   TimePoint appLimitedExitTarget_;
+
+  folly::Optional<Sample> latestSample_;
+
+  // Increasing totalBytesSent.
+  std::deque<AckedState> ackedStates_;
 };
 
 } // namespace quic
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CarefulResume.h>
+
+namespace quic {
+
+folly::Optional<uint64_t> CarefulResume::start(
+    uint64_t savedCwndBytes,
+    uint64_t cwndBytes,
+    TimePoint now) {
+  uint64_t jumpCwndBytes = savedCwndBytes / 2;
+  if (jumpCwndBytes <= cwndBytes) {
+    return folly::none;
+  }
+  phase_ = Phase::Unvalidated;
+  jumpTime_ = now;
+  lastUnvalidatedSentTime_ = now;
+  pipeSize_ = 0;
+  return jumpCwndBytes;
+}
+
+void CarefulResume::onPacketSent(const OutstandingPacket& packet) noexcept {
+  if (phase_ == Phase::Unvalidated) {
+    lastUnvalidatedSentTime_ = packet.time;
+  }
+}
+
+void CarefulResume::onPacketAcked(
+    const CongestionController::AckEvent& ack) noexcept {
+  if (phase_ == Phase::Normal || ack.ackedPackets.empty()) {
+    return;
+  }
+  for (const auto& packet : ack.ackedPackets) {
+    if (packet.time >= jumpTime_) {
+      pipeSize_ += packet.encodedSize;
+    }
+  }
+  auto largestAckedSentTime = ack.ackedPackets.back().time;
+  if (phase_ == Phase::Unvalidated && largestAckedSentTime >= jumpTime_) {
+    VLOG(10) << "Careful resume: validating";
+    phase_ = Phase::Validating;
+  }
+  if (phase_ == Phase::Validating &&
+      largestAckedSentTime >= lastUnvalidatedSentTime_) {
+    VLOG(10) << "Careful resume: validated, pipeSize=" << pipeSize_;
+    phase_ = Phase::Normal;
+  }
+}
+
+folly::Optional<uint64_t> CarefulResume::onPacketLoss(
+    const CongestionController::LossEvent& loss) noexcept {
+  if (phase_ == Phase::Normal || !loss.largestLostSentTime ||
+      *loss.largestLostSentTime < jumpTime_) {
+    return folly::none;
+  }
+  VLOG(10) << "Careful resume: safe retreat, pipeSize=" << pipeSize_;
+  phase_ = Phase::Normal;
+  return pipeSize_ / 2;
+}
+
+CarefulResume::Phase CarefulResume::phase() const noexcept {
+  return phase_;
+}
+
+} // namespace quic
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/StateData.h>
+
+#include <folly/Optional.h>
+
+namespace quic {
+
+/**
+ * Careful resume, following draft-ietf-tsvwg-careful-resume. A congestion
+ * controller in slow start jumps its cwnd to half the cwnd of an earlier
+ * connection on the same path, and keeps track of whether the path still
+ * carries it:
+ *
+ *  -   Unvalidated: packets sent after the jump, until the first of them is
+ *      acked.
+ *  -   Validating: until the last packet sent while Unvalidated is acked.
+ *  -   Normal: the jump is validated, or was never taken.
+ *
+ * A loss of a packet sent after the jump before it is validated means the
+ * saved cwnd no longer fits the path. The controller then retreats to half of
+ * what was acked since the jump.
+ */
+class CarefulResume {
+ public:
+  enum class Phase : uint8_t {
+    Normal,
+    Unvalidated,
+    Validating,
+  };
+
+  /**
+   * Starts a resume from savedCwndBytes. Returns the cwnd to jump to, or none
+   * if it is no larger than cwndBytes.
+   */
+  folly::Optional<uint64_t>
+  start(uint64_t savedCwndBytes, uint64_t cwndBytes, TimePoint now);
+
+  void onPacketSent(const OutstandingPacket& packet) noexcept;
+
+  void onPacketAcked(const CongestionController::AckEvent& ack) noexcept;
+
+  /**
+   * Returns the cwnd to retreat to if the loss hits packets sent after the
+   * jump before it was validated. The resume is over either way then.
+   */
+  folly::Optional<uint64_t> onPacketLoss(
+      const CongestionController::LossEvent& loss) noexcept;
+
+  Phase phase() const noexcept;
+
+ private:
+  Phase phase_{Phase::Normal};
+  TimePoint jumpTime_;
+  // Send time of the last packet sent while Unvalidated.
+  TimePoint lastUnvalidatedSentTime_;
+  // Bytes acked of the packets sent since the jump.
+  uint64_t pipeSize_{0};
+};
+
+} // namespace quic
@@ -10,10 +10,28 @@
 
 #include <quic/QuicConstants.h>
 #include <quic/common/TimeUtil.h>
+
+#include <folly/lang/Bits.h>
+
 #include <algorithm>
 
 namespace quic {
 
+namespace {
+// ceil(cbrt(i) * 256) for i in [0, 64].
+constexpr uint16_t kCbrtTable[] = {
+    0, 256, 323, 370, 407, 438, 466, 490,
+    512, 533, 552, 570, 587, 602, 617, 632,
+    646, 659, 671, 684, 695, 707, 718, 729,
+    739, 749, 759, 768, 778, 787, 796, 805,
+    813, 822, 830, 838, 846, 854, 861, 869,
+    876, 883, 890, 897, 904, 911, 918, 924,
+    931, 937, 944, 950, 956, 962, 968, 974,
+    980, 986, 991, 997, 1003, 1008, 1014, 1019,
+    1024,
+};
+} // namespace
+
 uint64_t boundedCwnd(
     uint64_t cwndBytes,
     uint64_t packetLength,
@@ -48,4 +66,23 @@ std::pair<std::chrono::microseconds, uint64_t> calculatePacingRate(
       timeMax(minimalInterval, rtt * burstPerInterval / cwndInPackets);
   return std::make_pair(interval, burstPerInterval);
 }
+
+uint64_t fixedPointCbrt(uint64_t x) noexcept {
+  if (x == 0) {
+    return 0;
+  }
+  // Shift x right by a multiple of 3 bits so that at most 6 bits are left,
+  // the table then gives an upper bound of their cube root.
+  uint64_t bits = folly::findLastSet(x);
+  uint64_t shift = bits > 6 ? (bits - 4) / 3 : 0;
+  uint64_t top = x >> (shift * 3);
+  uint64_t root = ((uint64_t(kCbrtTable[top + 1]) << shift) >> 8) + 1;
+  while (true) {
+    uint64_t next = (2 * root + x / (root * root)) / 3;
+    if (next >= root) {
+      return root;
+    }
+    root = next;
+  }
+}
 } // namespace quic
@@ -28,6 +28,13 @@ std::pair<std::chrono::microseconds, uint64_t> calculatePacingRate(
     std::chrono::microseconds minimalInterval,
     std::chrono::microseconds rtt);
 
+/**
+ * Cube root of x, rounded down. The seed comes from a table of cube roots of
+ * the top bits of x and is refined with integer Newton iterations, which
+ * converge to the exact result from above.
+ */
+uint64_t fixedPointCbrt(uint64_t x) noexcept;
+
 template <class T1, class T2>
 void addAndCheckOverflow(T1& value, const T2& toAdd) {
   if (UNLIKELY(std::numeric_limits<T1>::max() - toAdd < value)) {
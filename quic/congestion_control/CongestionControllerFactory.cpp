@@ -9,6 +9,7 @@
 #include <quic/congestion_control/CongestionControllerFactory.h>
 
 #include <quic/congestion_control/Bbr.h>
+#include <quic/congestion_control/Bbr2.h>
 #include <quic/congestion_control/BbrBandwidthSampler.h>
 #include <quic/congestion_control/BbrRttSampler.h>
 #include <quic/congestion_control/Copa.h>
@@ -42,6 +43,14 @@ DefaultCongestionControllerFactory::makeCongestionController(
       congestionController = std::move(bbr);
       break;
     }
+    case CongestionControlType::BBR2: {
+      auto bbr2 = std::make_unique<Bbr2CongestionController>(conn);
+      bbr2->setRttSampler(
+          std::make_unique<BbrRttSampler>(kBbr2ProbeRttInterval));
+      bbr2->setBandwidthSampler(std::make_unique<BbrBandwidthSampler>(conn));
+      congestionController = std::move(bbr2);
+      break;
+    }
     case CongestionControlType::None:
       break;
   }
@@ -24,6 +24,10 @@ Copa::Copa(QuicConnectionStateBase& conn)
       standingRTTFilter_(
           100000, /*100ms*/
           0us,
+          0),
+      maxRTTFilter_(
+          400000, /*400ms*/
+          0us,
           0) {
   VLOG(10) << __func__ << " writable=" << getWritableBytes()
            << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
@@ -31,6 +35,24 @@ Copa::Copa(QuicConnectionStateBase& conn)
   if (conn_.transportSettings.latencyFactor.hasValue()) {
     latencyFactor_ = conn_.transportSettings.latencyFactor.value();
   }
+  const auto& params = conn_.transportSettings.congestionControlParams.copa;
+  if (params.latencyFactor) {
+    if (*params.latencyFactor > 0) {
+      latencyFactor_ = *params.latencyFactor;
+    } else {
+      LOG(WARNING) << "Copa: ignoring out of range latencyFactor="
+                   << *params.latencyFactor;
+    }
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+      conn_.qLogger->addCongestionMetricUpdate(
+          bytesInFlight_,
+          getCongestionWindow(),
+          kCongestionControlParams,
+          folly::to<std::string>("latencyFactor=", latencyFactor_));
+    }
+  }
+  defaultLatencyFactor_ = latencyFactor_;
 }
 
 void Copa::onRemoveBytesFromInflight(uint64_t bytes) {
@@ -38,9 +60,10 @@ void Copa::onRemoveBytesFromInflight(uint64_t bytes) {
   VLOG(10) << __func__ << " writable=" << getWritableBytes()
            << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
            << conn_;
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
-        bytesInFlight_, getCongestionWindow(), kRemoveInflight.str());
+        bytesInFlight_, getCongestionWindow(), kRemoveInflight);
   }
 }
 
@@ -55,9 +78,10 @@ void Copa::onPacketSent(const OutstandingPacket& packet) {
                   packet.packet.header,
                   [](auto& h) { return h.getPacketSequenceNum(); })
            << " " << conn_;
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
-        bytesInFlight_, getCongestionWindow(), kCongestionPacketSent.str());
+        bytesInFlight_, getCongestionWindow(), kCongestionPacketSent);
   }
 }
 
@@ -125,6 +149,83 @@ void Copa::changeDirection(
   velocityState_.lastRecordedCwndBytes = cwndBytes_;
 }
 
+/**
+ * Copa's default mode keeps the queue nearly empty, so it should see the
+ * queue empty at least once every 5 rtts. If it does not, a buffer filling
+ * flow is competing for the bottleneck, and Copa would give all of it away.
+ * In competitive mode 1 / latencyFactor increases by 1 every rtt without
+ * loss, and halves on loss, but latencyFactor never gets above its default.
+ */
+void Copa::updateMode(
+    const TimePoint ackTime,
+    std::chrono::microseconds rttMin,
+    std::chrono::microseconds rttStanding) {
+  maxRTTFilter_.SetWindowLength(
+      kCopaMaxRTTWindowRtts * conn_.lossState.srtt.count());
+  maxRTTFilter_.Update(
+      conn_.lossState.lrtt,
+      duration_cast<microseconds>(ackTime.time_since_epoch()).count());
+  auto rttMax = maxRTTFilter_.GetBest();
+  if (rttStanding <= rttMin ||
+      (rttStanding - rttMin).count() <=
+          kCopaQueueEmptyFraction * (rttMax - rttMin).count()) {
+    modeState_.queueEmptied = true;
+  }
+  if (!modeState_.checkStartTime) {
+    modeState_.checkStartTime = ackTime;
+  } else if (
+      ackTime - *modeState_.checkStartTime >=
+      kCopaModeCheckRtts * conn_.lossState.srtt) {
+    setMode(
+        modeState_.queueEmptied ? Mode::Default : Mode::Competitive, ackTime);
+    modeState_.checkStartTime = ackTime;
+    modeState_.queueEmptied = false;
+  }
+  if (modeState_.mode != Mode::Competitive) {
+    return;
+  }
+  if (!modeState_.lastAdjustTime) {
+    modeState_.lastAdjustTime = ackTime;
+    return;
+  }
+  if (ackTime - *modeState_.lastAdjustTime < conn_.lossState.srtt) {
+    return;
+  }
+  if (!modeState_.lossSinceAdjust) {
+    latencyFactor_ = 1.0 /
+        std::min(
+            1.0 / latencyFactor_ + 1, kCopaMaxCompetitiveInverseLatencyFactor);
+    VLOG(10) << __func__ << " competitive latencyFactor=" << latencyFactor_
+             << " " << conn_;
+  }
+  modeState_.lastAdjustTime = ackTime;
+  modeState_.lossSinceAdjust = false;
+}
+
+void Copa::setMode(Mode mode, const TimePoint now) {
+  if (modeState_.mode == mode) {
+    return;
+  }
+  VLOG(10) << __func__ << " mode change to competitive="
+           << (mode == Mode::Competitive) << " " << conn_;
+  modeState_.mode = mode;
+  modeState_.lastAdjustTime = now;
+  modeState_.lossSinceAdjust = false;
+  if (mode == Mode::Default) {
+    latencyFactor_ = defaultLatencyFactor_;
+  }
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        bytesInFlight_,
+        getCongestionWindow(),
+        mode == Mode::Competitive ? kCopaCompetitiveMode
+                                  : kCopaDefaultMode);
+  }
+  QUIC_TRACE(
+      copa_mode, conn_, mode == Mode::Competitive, latencyFactor_, cwndBytes_);
+}
+
 void Copa::onPacketAckOrLoss(
     folly::Optional<AckEvent> ack,
     folly::Optional<LossEvent> loss) {
@@ -166,9 +267,10 @@ void Copa::onPacketAcked(const AckEvent& ack) {
            << " packetsRetransmitted=" << conn_.lossState.rtxCount << " "
            << conn_;
 
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
-        bytesInFlight_, getCongestionWindow(), kCongestionPacketAck.str());
+        bytesInFlight_, getCongestionWindow(), kCongestionPacketAck);
   }
 
   auto delayInMicroSec =
@@ -190,6 +292,10 @@ void Copa::onPacketAcked(const AckEvent& ack) {
            << " estimated queuing delay microsec =" << delayInMicroSec << " "
            << conn_;
 
+  if (conn_.transportSettings.copaCompetitiveModeEnabled) {
+    updateMode(ack.ackTime, rttMin, microseconds(rttStandingMicroSec));
+  }
+
   bool increaseCwnd = false;
   if (delayInMicroSec == 0) {
     // taking care of inf targetRate case here, this happens in beginning where
@@ -269,20 +375,29 @@ void Copa::onPacketLoss(const LossEvent& loss) {
   VLOG(10) << __func__ << " lostBytes=" << loss.lostBytes
            << " lostPackets=" << loss.lostPackets << " cwnd=" << cwndBytes_
            << " inflight=" << bytesInFlight_ << " " << conn_;
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
-        bytesInFlight_, getCongestionWindow(), kCongestionPacketLoss.str());
+        bytesInFlight_, getCongestionWindow(), kCongestionPacketLoss);
   }
   DCHECK(loss.largestLostPacketNum.hasValue());
   subtractAndCheckUnderflow(bytesInFlight_, loss.lostBytes);
+  if (modeState_.mode == Mode::Competitive && !modeState_.lossSinceAdjust) {
+    // Halve 1 / latencyFactor, at most once per rtt.
+    latencyFactor_ = std::min(latencyFactor_ * 2, defaultLatencyFactor_);
+    modeState_.lossSinceAdjust = true;
+    VLOG(10) << __func__ << " competitive latencyFactor=" << latencyFactor_
+             << " " << conn_;
+  }
   if (loss.persistentCongestion) {
     // TODO See if we should go to slowStart here
     VLOG(10) << __func__ << " writable=" << getWritableBytes()
              << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
              << conn_;
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
-          bytesInFlight_, getCongestionWindow(), kPersistentCongestion.str());
+          bytesInFlight_, getCongestionWindow(), kPersistentCongestion);
     }
     cwndBytes_ = conn_.transportSettings.minCwndInMss * conn_.udpSendPacketLen;
     updatePacing();
@@ -301,7 +416,7 @@ uint64_t Copa::getCongestionWindow() const noexcept {
   return cwndBytes_;
 }
 
-bool Copa::inSlowStart() {
+bool Copa::inSlowStart() const noexcept {
   return isSlowStart_;
 }
 
@@ -318,13 +433,17 @@ void Copa::updatePacing() noexcept {
       conn_.transportSettings.minCwndInMss,
       minimalPacingInterval_,
       conn_.lossState.srtt);
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(cwndBytes_ * 2, conn_.lossState.srtt);
+  }
   if (pacingInterval_ == std::chrono::milliseconds::zero()) {
     return;
   }
   if (conn_.transportSettings.pacingEnabled) {
     VLOG(10) << "updatePacing pacingInterval_ = " << pacingInterval_.count()
              << ", pacingBurstSize_ " << pacingBurstSize_ << " " << conn_;
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::PacingMetricUpdate)) {
       conn_.qLogger->addPacingMetricUpdate(pacingBurstSize_, pacingInterval_);
     }
   }
@@ -362,6 +481,14 @@ void Copa::setAppIdle(bool, TimePoint) noexcept { /* unsupported */
 void Copa::setAppLimited() { /* unsupported */
 }
 
+Copa::Mode Copa::getMode() const noexcept {
+  return modeState_.mode;
+}
+
+double Copa::getLatencyFactor() const noexcept {
+  return latencyFactor_;
+}
+
 bool Copa::isAppLimited() const noexcept {
   return false; // not supported
 }
@@ -19,6 +19,15 @@ namespace quic {
 
 using namespace std::chrono_literals;
 constexpr std::chrono::microseconds kMinRTTWindowLength{10s};
+// Competitive mode: Copa switches to it when the queue didn't empty once in
+// kCopaModeCheckRtts rtts. The queue counts as empty when the standing rtt is
+// within kCopaQueueEmptyFraction of the rtt range seen over the last
+// kCopaMaxRTTWindowRtts rtts.
+constexpr uint32_t kCopaModeCheckRtts = 5;
+constexpr uint32_t kCopaMaxRTTWindowRtts = 4;
+constexpr double kCopaQueueEmptyFraction = 0.1;
+// Bound on 1 / latencyFactor in competitive mode.
+constexpr double kCopaMaxCompetitiveInverseLatencyFactor = 32;
 
 /**
  * Algorithm description https://fb.quip.com/kgubABy1yuYR
@@ -38,7 +47,7 @@ class Copa : public CongestionController {
   uint64_t getCongestionWindow() const noexcept override;
   CongestionControlType type() const noexcept override;
 
-  bool inSlowStart();
+  bool inSlowStart() const noexcept override;
 
   uint64_t getBytesInFlight() const noexcept;
 
@@ -59,6 +68,18 @@ class Copa : public CongestionController {
 
   bool isAppLimited() const noexcept override;
 
+  enum class Mode {
+    // latencyFactor is the configured one.
+    Default,
+    // A buffer filling flow shares the bottleneck, latencyFactor is adjusted
+    // with AIMD on 1 / latencyFactor to compete with it.
+    Competitive,
+  };
+
+  Mode getMode() const noexcept;
+
+  double getLatencyFactor() const noexcept;
+
  private:
   void onPacketAcked(const AckEvent&);
   void onPacketLoss(const LossEvent&);
@@ -82,6 +103,25 @@ class Copa : public CongestionController {
   void changeDirection(
       VelocityState::Direction newDirection,
       const TimePoint ackTime);
+  // Mode switching, with TransportSettings::copaCompetitiveModeEnabled.
+  void updateMode(
+      const TimePoint ackTime,
+      std::chrono::microseconds rttMin,
+      std::chrono::microseconds rttStanding);
+  void setMode(Mode mode, const TimePoint now);
+
+  struct ModeState {
+    Mode mode{Mode::Default};
+    // Start of the current queue empty check, kCopaModeCheckRtts rtts long.
+    folly::Optional<TimePoint> checkStartTime;
+    // Whether the queue emptied since checkStartTime.
+    bool queueEmptied{false};
+    // Last time latencyFactor was adjusted in competitive mode.
+    folly::Optional<TimePoint> lastAdjustTime;
+    // Whether there was a loss since lastAdjustTime.
+    bool lossSinceAdjust{false};
+  };
+
   QuicConnectionStateBase& conn_;
   uint64_t bytesInFlight_{0};
   uint64_t cwndBytes_;
@@ -104,6 +144,13 @@ class Copa : public CongestionController {
       uint64_t>
       standingRTTFilter_; // To get min RTT over srtt/2
 
+  WindowedFilter<
+      std::chrono::microseconds,
+      MaxFilter<std::chrono::microseconds>,
+      uint64_t,
+      uint64_t>
+      maxRTTFilter_; // To get max RTT over kCopaMaxRTTWindowRtts srtts
+
   VelocityState velocityState_;
   /**
    * latencyFactor_ determines how latency sensitive the algorithm is. Lower
@@ -111,6 +158,9 @@ class Copa : public CongestionController {
    * it will minimize delay at expense of throughput.
    */
   double latencyFactor_{0.50};
+  // latencyFactor_ of the default mode.
+  double defaultLatencyFactor_{0.50};
+  ModeState modeState_;
 
   uint64_t pacingBurstSize_{0};
   std::chrono::microseconds pacingInterval_;
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/FairSharePacer.h>
+
+namespace quic {
+
+FairSharePacer::FairSharePacer(
+    std::unique_ptr<Pacer> pacer,
+    std::shared_ptr<BandwidthAllocator> allocator)
+    : pacer_(std::move(pacer)),
+      allocator_(std::move(allocator)),
+      share_(*allocator_),
+      generation_(allocator_->getGeneration()) {
+  CHECK(pacer_);
+}
+
+void FairSharePacer::refreshPacingRate(
+    uint64_t cwndBytes,
+    std::chrono::microseconds rtt) {
+  cwndBytes_ = cwndBytes;
+  rtt_ = rtt;
+  share_.setDemand(
+      rtt.count() > 0 ? cwndBytes * 1000000 / rtt.count() : 0);
+  applyRate();
+}
+
+void FairSharePacer::applyRate() {
+  generation_ = allocator_->getGeneration();
+  auto cwndBytes = cwndBytes_;
+  auto fairShare = allocator_->getFairShare();
+  if (fairShare && rtt_.count() > 0) {
+    // Never 0, which would turn pacing off. The pacer doesn't go below
+    // minCwndInMss either way.
+    cwndBytes = std::max<uint64_t>(
+        1, std::min(cwndBytes, *fairShare * rtt_.count() / 1000000));
+  }
+  pacer_->refreshPacingRate(cwndBytes, rtt_);
+}
+
+void FairSharePacer::setMinimalInterval(std::chrono::microseconds interval) {
+  pacer_->setMinimalInterval(interval);
+}
+
+std::chrono::microseconds FairSharePacer::getTimeUntilNextWrite(
+    TimePoint currentTime) const {
+  return pacer_->getTimeUntilNextWrite(currentTime);
+}
+
+uint64_t FairSharePacer::updateAndGetWriteBatchSize(TimePoint currentTime) {
+  share_.markActive(currentTime);
+  allocator_->maybeUpdate(currentTime);
+  if (generation_ != allocator_->getGeneration() && cwndBytes_ > 0) {
+    applyRate();
+  }
+  return pacer_->updateAndGetWriteBatchSize(currentTime);
+}
+
+void FairSharePacer::onPacketSent() {
+  pacer_->onPacketSent();
+}
+
+std::chrono::microseconds FairSharePacer::getPacingInterval() const {
+  return pacer_->getPacingInterval();
+}
+
+uint64_t FairSharePacer::getPacingBurstSize() const {
+  return pacer_->getPacingBurstSize();
+}
+
+} // namespace quic
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/congestion_control/BandwidthAllocator.h>
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+/**
+ * Pacer capping the target rate of the congestion controller to the
+ * connection's fair share of a BandwidthAllocator, before handing it to the
+ * pacer it wraps. Packets beyond the share wait in the connection instead of
+ * piling up in the qdisc of the host.
+ */
+class FairSharePacer : public Pacer {
+ public:
+  FairSharePacer(
+      std::unique_ptr<Pacer> pacer,
+      std::shared_ptr<BandwidthAllocator> allocator);
+
+  void refreshPacingRate(uint64_t cwndBytes, std::chrono::microseconds rtt)
+      override;
+
+  void setMinimalInterval(std::chrono::microseconds interval) override;
+
+  std::chrono::microseconds getTimeUntilNextWrite(
+      TimePoint currentTime) const override;
+
+  uint64_t updateAndGetWriteBatchSize(TimePoint currentTime) override;
+
+  void onPacketSent() override;
+
+  std::chrono::microseconds getPacingInterval() const override;
+  uint64_t getPacingBurstSize() const override;
+
+ private:
+  // Hands the target rate, capped to the current fair share, to pacer_.
+  void applyRate();
+
+  std::unique_ptr<Pacer> pacer_;
+  // Declared before share_, which it must outlive.
+  std::shared_ptr<BandwidthAllocator> allocator_;
+  BandwidthAllocator::Share share_;
+  uint64_t cwndBytes_{0};
+  std::chrono::microseconds rtt_{0us};
+  uint64_t generation_{0};
+};
+
+} // namespace quic
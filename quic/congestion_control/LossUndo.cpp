@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/LossUndo.h>
+
+namespace quic {
+
+void LossUndo::onReduction(
+    const CongestionController::LossEvent& loss) noexcept {
+  reductionTime_ = loss.lossTime;
+  lostPackets_ = loss.lostPackets;
+  spuriousPackets_ = 0;
+}
+
+void LossUndo::onLoss(const CongestionController::LossEvent& loss) noexcept {
+  if (reductionTime_) {
+    lostPackets_ += loss.lostPackets;
+  }
+}
+
+bool LossUndo::onSpuriousLoss(TimePoint lossTime) noexcept {
+  // Packets lost before the reduction were already accounted for by an
+  // earlier episode.
+  if (!reductionTime_ || lossTime < *reductionTime_) {
+    return false;
+  }
+  if (++spuriousPackets_ < lostPackets_) {
+    return false;
+  }
+  reset();
+  return true;
+}
+
+void LossUndo::reset() noexcept {
+  reductionTime_.clear();
+  lostPackets_ = 0;
+  spuriousPackets_ = 0;
+}
+
+} // namespace quic
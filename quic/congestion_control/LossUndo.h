@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/StateData.h>
+
+#include <folly/Optional.h>
+
+namespace quic {
+
+/**
+ * Keeps track of whether a window reduction of a congestion controller was
+ * caused by spurious losses only, in which case it can be undone. The
+ * reduction starts an episode, the losses of the same recovery are added to
+ * it, and it can be undone once as many of its lost packets were acked after
+ * all, see CongestionController::onSpuriousLoss.
+ */
+class LossUndo {
+ public:
+  /**
+   * A loss reduced the window. Starts a new episode.
+   */
+  void onReduction(const CongestionController::LossEvent& loss) noexcept;
+
+  /**
+   * A loss within the recovery of the last reduction.
+   */
+  void onLoss(const CongestionController::LossEvent& loss) noexcept;
+
+  /**
+   * Returns true if the reduction can be undone: all its lost packets were
+   * spurious. The episode is over then.
+   */
+  bool onSpuriousLoss(TimePoint lossTime) noexcept;
+
+  /**
+   * The window got reduced for something else than a loss, there's nothing
+   * to undo anymore.
+   */
+  void reset() noexcept;
+
+ private:
+  // lossTime of the LossEvent that caused the reduction.
+  folly::Optional<TimePoint> reductionTime_;
+  uint64_t lostPackets_{0};
+  uint64_t spuriousPackets_{0};
+};
+
+} // namespace quic
@@ -30,14 +30,16 @@ void NewReno::onRemoveBytesFromInflight(uint64_t bytes) {
   VLOG(10) << __func__ << " writable=" << getWritableBytes()
            << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
            << conn_;
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
-        bytesInFlight_, getCongestionWindow(), kRemoveInflight.str());
+        bytesInFlight_, getCongestionWindow(), kRemoveInflight);
   }
 }
 
 void NewReno::onPacketSent(const OutstandingPacket& packet) {
   addAndCheckOverflow(bytesInFlight_, packet.encodedSize);
+  carefulResume_.onPacketSent(packet);
   VLOG(10) << __func__ << " writable=" << getWritableBytes()
            << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_
            << " packetNum="
@@ -45,21 +47,24 @@ void NewReno::onPacketSent(const OutstandingPacket& packet) {
                   packet.packet.header,
                   [](auto& h) { return h.getPacketSequenceNum(); })
            << " " << conn_;
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
-        bytesInFlight_, getCongestionWindow(), kCongestionPacketSent.str());
+        bytesInFlight_, getCongestionWindow(), kCongestionPacketSent);
   }
 }
 
 void NewReno::onAckEvent(const AckEvent& ack) {
   DCHECK(ack.largestAckedPacket.hasValue() && !ack.ackedPackets.empty());
   subtractAndCheckUnderflow(bytesInFlight_, ack.ackedBytes);
+  carefulResume_.onPacketAcked(ack);
   VLOG(10) << __func__ << " writable=" << getWritableBytes()
            << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
            << conn_;
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
-        bytesInFlight_, getCongestionWindow(), kCongestionPacketAck.str());
+        bytesInFlight_, getCongestionWindow(), kCongestionPacketAck);
   }
   for (const auto& packet : ack.ackedPackets) {
     onPacketAcked(packet);
@@ -94,8 +99,44 @@ void NewReno::onPacketAckOrLoss(
     onPacketLoss(*lossEvent);
   }
   if (ackEvent && ackEvent->largestAckedPacket.hasValue()) {
+    if (ackEvent->ecnCeCount > 0) {
+      onPacketsMarkedCE(*ackEvent);
+    }
     onAckEvent(*ackEvent);
   }
+  updatePacing();
+}
+
+void NewReno::onPacketsMarkedCE(const AckEvent& ack) {
+  // CE marks are a congestion event for the largest newly acked packet, just
+  // like a loss of it would be (RFC 9002 section 7.1). Inflight bytes are
+  // left to the ack.
+  DCHECK(!ack.ackedPackets.empty());
+  if (!endOfRecovery_ || *endOfRecovery_ < ack.ackedPackets.back().time) {
+    enterRecovery();
+    lossUndo_.reset();
+    VLOG(10) << __func__ << " exit slow start, ssthresh=" << ssthresh_
+             << " ce=" << ack.ecnCeCount << " writable=" << getWritableBytes()
+             << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
+             << conn_;
+  }
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        bytesInFlight_, getCongestionWindow(), kCongestionEcnCe);
+  }
+}
+
+void NewReno::enterRecovery() {
+  endOfRecovery_ = Clock::now();
+  cwndBytes_ = (cwndBytes_ >> kRenoLossReductionFactorShift);
+  cwndBytes_ = boundedCwnd(
+      cwndBytes_,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      conn_.transportSettings.minCwndInMss);
+  // This causes us to exit slow start.
+  ssthresh_ = cwndBytes_;
 }
 
 void NewReno::onPacketLoss(const LossEvent& loss) {
@@ -104,38 +145,67 @@ void NewReno::onPacketLoss(const LossEvent& loss) {
       loss.largestLostSentTime.hasValue());
   subtractAndCheckUnderflow(bytesInFlight_, loss.lostBytes);
   if (!endOfRecovery_ || *endOfRecovery_ < *loss.largestLostSentTime) {
-    endOfRecovery_ = Clock::now();
-    cwndBytes_ = (cwndBytes_ >> kRenoLossReductionFactorShift);
-    cwndBytes_ = boundedCwnd(
-        cwndBytes_,
-        conn_.udpSendPacketLen,
-        conn_.transportSettings.maxCwndInMss,
-        conn_.transportSettings.minCwndInMss);
-    // This causes us to exit slow start.
-    ssthresh_ = cwndBytes_;
+    undoCwndBytes_ = cwndBytes_;
+    undoSsthresh_ = ssthresh_;
+    lossUndo_.onReduction(loss);
+    enterRecovery();
     VLOG(10) << __func__ << " exit slow start, ssthresh=" << ssthresh_
              << " packetNum=" << *loss.largestLostPacketNum
              << " writable=" << getWritableBytes() << " cwnd=" << cwndBytes_
              << " inflight=" << bytesInFlight_ << " " << conn_;
   } else {
+    lossUndo_.onLoss(loss);
     VLOG(10) << __func__ << " packetNum=" << *loss.largestLostPacketNum
              << " writable=" << getWritableBytes() << " cwnd=" << cwndBytes_
              << " inflight=" << bytesInFlight_ << " " << conn_;
   }
+  auto retreatCwnd = carefulResume_.onPacketLoss(loss);
+  if (retreatCwnd) {
+    lossUndo_.reset();
+    cwndBytes_ = std::min(
+        cwndBytes_,
+        boundedCwnd(
+            *retreatCwnd,
+            conn_.udpSendPacketLen,
+            conn_.transportSettings.maxCwndInMss,
+            conn_.transportSettings.minCwndInMss));
+    ssthresh_ = cwndBytes_;
+  }
 
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
-        bytesInFlight_, getCongestionWindow(), kCongestionPacketLoss.str());
+        bytesInFlight_, getCongestionWindow(), kCongestionPacketLoss);
   }
   if (loss.persistentCongestion) {
     VLOG(10) << __func__ << " writable=" << getWritableBytes()
              << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
              << conn_;
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
-          bytesInFlight_, getCongestionWindow(), kPersistentCongestion.str());
+          bytesInFlight_, getCongestionWindow(), kPersistentCongestion);
     }
     cwndBytes_ = conn_.transportSettings.minCwndInMss * conn_.udpSendPacketLen;
+    lossUndo_.reset();
+  }
+}
+
+void NewReno::onSpuriousLoss(TimePoint lossTime) {
+  if (!lossUndo_.onSpuriousLoss(lossTime)) {
+    return;
+  }
+  cwndBytes_ = std::max(cwndBytes_, undoCwndBytes_);
+  ssthresh_ = undoSsthresh_;
+  endOfRecovery_ = folly::none;
+  updatePacing();
+  VLOG(10) << __func__ << " undo, ssthresh=" << ssthresh_
+           << " writable=" << getWritableBytes() << " cwnd=" << cwndBytes_
+           << " inflight=" << bytesInFlight_ << " " << conn_;
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        bytesInFlight_, getCongestionWindow(), kCongestionLossUndo);
   }
 }
 
@@ -155,6 +225,29 @@ bool NewReno::inSlowStart() const noexcept {
   return cwndBytes_ < ssthresh_;
 }
 
+bool NewReno::carefulResume(uint64_t savedCwndBytes, TimePoint now) {
+  if (!inSlowStart() || endOfRecovery_) {
+    return false;
+  }
+  auto jumpCwnd = carefulResume_.start(savedCwndBytes, cwndBytes_, now);
+  if (!jumpCwnd) {
+    return false;
+  }
+  cwndBytes_ = boundedCwnd(
+      *jumpCwnd,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      conn_.transportSettings.minCwndInMss);
+  VLOG(10) << __func__ << " cwnd=" << cwndBytes_ << " " << conn_;
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        bytesInFlight_, getCongestionWindow(), kCarefulResume);
+  }
+  updatePacing();
+  return true;
+}
+
 CongestionControlType NewReno::type() const noexcept {
   return CongestionControlType::NewReno;
 }
@@ -162,8 +255,14 @@ CongestionControlType NewReno::type() const noexcept {
 void NewReno::setConnectionEmulation(uint8_t) noexcept {}
 
 bool NewReno::canBePaced() const noexcept {
-  // Pacing is not supported on NewReno currently
-  return false;
+  // NewReno only paces with a Pacer.
+  return conn_.pacer != nullptr;
+}
+
+void NewReno::updatePacing() noexcept {
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(cwndBytes_, conn_.lossState.srtt);
+  }
 }
 
 uint64_t NewReno::getBytesInFlight() const noexcept {
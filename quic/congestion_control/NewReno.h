@@ -9,6 +9,8 @@
 #pragma once
 
 #include <quic/QuicException.h>
+#include <quic/congestion_control/CarefulResume.h>
+#include <quic/congestion_control/LossUndo.h>
 #include <quic/state/StateData.h>
 
 #include <limits>
@@ -32,7 +34,7 @@ class NewReno : public CongestionController {
 
   CongestionControlType type() const noexcept override;
 
-  bool inSlowStart() const noexcept;
+  bool inSlowStart() const noexcept override;
 
   uint64_t getBytesInFlight() const noexcept;
 
@@ -46,10 +48,20 @@ class NewReno : public CongestionController {
 
   bool isAppLimited() const noexcept override;
 
+  bool carefulResume(uint64_t savedCwndBytes, TimePoint now) override;
+
+  void onSpuriousLoss(TimePoint lossTime) override;
+
  private:
   void onPacketLoss(const LossEvent&);
+  void onPacketsMarkedCE(const AckEvent&);
+  // Halves the cwnd and starts a recovery period that ends with the first
+  // packet sent from now on.
+  void enterRecovery();
   void onAckEvent(const AckEvent&);
   void onPacketAcked(const OutstandingPacket&);
+  // Reports the cwnd to the pacer of the connection, if it has one.
+  void updatePacing() noexcept;
 
  private:
   QuicConnectionStateBase& conn_;
@@ -57,5 +69,11 @@ class NewReno : public CongestionController {
   uint64_t ssthresh_;
   uint64_t cwndBytes_;
   folly::Optional<TimePoint> endOfRecovery_;
+  CarefulResume carefulResume_;
+  LossUndo lossUndo_;
+  // cwnd and ssthresh before the last loss driven recovery, restored if all its
+  // losses were spurious.
+  uint64_t undoCwndBytes_{0};
+  uint64_t undoSsthresh_{0};
 };
 } // namespace quic
@@ -13,6 +13,33 @@
 
 namespace quic {
 
+namespace {
+// (t - K) ^ 3 fits in an int64_t for |t - K| up to this many milliseconds.
+constexpr int64_t kMaxCubicTimeDeltaMs = (int64_t(1) << 21) - 1;
+// 1000 ^ 3 / kTimeScalingFactor, for (t - K) in milliseconds.
+constexpr int64_t kCubicDeltaDivisor = 2500000000;
+
+/**
+ * kTimeScalingFactor * (t - K) ^ 3 packets of packetLen bytes, in integers.
+ * Rounds towards zero, where the floating point version rounds down.
+ */
+int64_t fixedPointCubicCwndDelta(int64_t timeDeltaMs, uint64_t packetLen) {
+  if (UNLIKELY(timeDeltaMs > kMaxCubicTimeDeltaMs)) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  if (UNLIKELY(timeDeltaMs < -kMaxCubicTimeDeltaMs)) {
+    return -std::numeric_limits<int64_t>::max();
+  }
+  int64_t cube = timeDeltaMs * timeDeltaMs * timeDeltaMs;
+  auto mss = static_cast<int64_t>(packetLen);
+  if (std::abs(cube) <= std::numeric_limits<int64_t>::max() / mss) {
+    return cube * mss / kCubicDeltaDivisor;
+  }
+  // Large enough that dividing first loses no more than a packet length.
+  return cube / kCubicDeltaDivisor * mss;
+}
+} // namespace
+
 Cubic::Cubic(
     QuicConnectionStateBase& conn,
     uint64_t initSsthresh,
@@ -27,8 +54,26 @@ Cubic::Cubic(
       conn.transportSettings.maxCwndInMss * conn.udpSendPacketLen,
       conn.transportSettings.initCwndInMss * conn.udpSendPacketLen);
   steadyState_.tcpFriendly = tcpFriendly;
+  steadyState_.fixedPointMath = conn.transportSettings.cubicFixedPointMath;
   steadyState_.estRenoCwnd = cwndBytes_;
   hystartState_.ackTrain = ackTrain;
+  hystartState_.plusPlus = conn.transportSettings.cubicHystartPlusPlus;
+  const auto& params = conn.transportSettings.congestionControlParams.cubic;
+  if (params.beta) {
+    if (*params.beta > 0 && *params.beta < 1) {
+      steadyState_.baseReductionFactor = *params.beta;
+    } else {
+      LOG(WARNING) << "Quic Cubic: ignoring out of range beta=" << *params.beta;
+    }
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+      conn_.qLogger->addCongestionMetricUpdate(
+          inflightBytes_,
+          getCongestionWindow(),
+          kCongestionControlParams,
+          folly::to<std::string>("beta=", steadyState_.baseReductionFactor));
+    }
+  }
   calculateReductionFactors();
 }
 
@@ -63,8 +108,10 @@ void Cubic::onPersistentCongestion() {
   quiescenceStart_ = folly::none;
   hystartState_.found = Cubic::HystartFound::No;
   hystartState_.inRttRound = false;
+  hystartState_.cssBaselineMinRtt = folly::none;
 
   state_ = CubicStates::Hystart;
+  lossUndo_.reset();
 
   QUIC_TRACE(
       cubic_persistent_congestion,
@@ -73,12 +120,13 @@ void Cubic::onPersistentCongestion() {
       cwndBytes_,
       inflightBytes_,
       steadyState_.lastMaxCwndBytes.value_or(0));
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
         inflightBytes_,
         getCongestionWindow(),
-        kPersistentCongestion.str(),
-        cubicStateToString(state_).str());
+        kPersistentCongestion,
+        cubicStateToString(state_));
   }
 }
 
@@ -90,6 +138,7 @@ void Cubic::onPacketSent(const OutstandingPacket& packet) {
         LocalErrorCode::INFLIGHT_BYTES_OVERFLOW);
   }
   inflightBytes_ += packet.encodedSize;
+  carefulResume_.onPacketSent(packet);
 }
 
 void Cubic::onPacketLoss(const LossEvent& loss) {
@@ -101,15 +150,8 @@ void Cubic::onPacketLoss(const LossEvent& loss) {
   // If the loss occurred past the endOfRecovery then we need to move the
   // endOfRecovery back and invoke the state machine, otherwise ignore the loss
   // as it was already accounted for in a recovery period.
-  if (*loss.largestLostSentTime >=
-      recoveryState_.endOfRecovery.value_or(*loss.largestLostSentTime)) {
-    recoveryState_.endOfRecovery = Clock::now();
-    cubicReduction(loss.lossTime);
-    if (state_ == CubicStates::Hystart || state_ == CubicStates::Steady) {
-      state_ = CubicStates::FastRecovery;
-    }
-    ssthresh_ = cwndBytes_;
-    updatePacing();
+  if (enterRecovery(*loss.largestLostSentTime, loss.lossTime)) {
+    lossUndo_.onReduction(loss);
     QUIC_TRACE(
         cubic_loss,
         conn_,
@@ -117,30 +159,128 @@ void Cubic::onPacketLoss(const LossEvent& loss) {
         cwndBytes_,
         inflightBytes_,
         steadyState_.lastMaxCwndBytes.value_or(0));
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
           inflightBytes_,
           getCongestionWindow(),
-          kCubicLoss.str(),
-          cubicStateToString(state_).str());
+          kCubicLoss,
+          cubicStateToString(state_));
     }
 
   } else {
+    lossUndo_.onLoss(loss);
     QUIC_TRACE(fst_trace, conn_, "cubic_skip_loss");
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
           inflightBytes_,
           getCongestionWindow(),
-          kCubicSkipLoss.str(),
-          cubicStateToString(state_).str());
+          kCubicSkipLoss,
+          cubicStateToString(state_));
     }
   }
+  auto retreatCwnd = carefulResume_.onPacketLoss(loss);
+  if (retreatCwnd) {
+    lossUndo_.reset();
+    cwndBytes_ = std::min(
+        cwndBytes_,
+        boundedCwnd(
+            *retreatCwnd,
+            conn_.udpSendPacketLen,
+            conn_.transportSettings.maxCwndInMss,
+            conn_.transportSettings.minCwndInMss));
+    ssthresh_ = cwndBytes_;
+    // Grow back from the retreat, not towards the cwnd of the jump.
+    steadyState_.lastMaxCwndBytes = cwndBytes_;
+    updatePacing();
+  }
 
   if (loss.persistentCongestion) {
     onPersistentCongestion();
   }
 }
 
+void Cubic::onPacketsMarkedCE(const AckEvent& ack) {
+  quiescenceStart_ = folly::none;
+  // CE marks are a congestion event for the largest newly acked packet, just
+  // like a loss of it would be (RFC 9002 section 7.1).
+  if (enterRecovery(ack.ackedPackets.back().time, ack.ackTime)) {
+    lossUndo_.reset();
+    QUIC_TRACE(
+        cubic_loss,
+        conn_,
+        cubicStateToString(state_).data(),
+        cwndBytes_,
+        inflightBytes_,
+        steadyState_.lastMaxCwndBytes.value_or(0));
+  }
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        inflightBytes_,
+        getCongestionWindow(),
+        kCubicEcnCe,
+        cubicStateToString(state_));
+  }
+}
+
+bool Cubic::enterRecovery(
+    TimePoint largestSentTime,
+    TimePoint eventTime) noexcept {
+  if (largestSentTime <
+      recoveryState_.endOfRecovery.value_or(largestSentTime)) {
+    return false;
+  }
+  recoveryState_.endOfRecovery = Clock::now();
+  cubicReduction(eventTime);
+  if (state_ == CubicStates::Hystart || state_ == CubicStates::Steady) {
+    state_ = CubicStates::FastRecovery;
+  }
+  ssthresh_ = cwndBytes_;
+  updatePacing();
+  return true;
+}
+
+void Cubic::onSpuriousLoss(TimePoint lossTime) {
+  if (!lossUndo_.onSpuriousLoss(lossTime)) {
+    return;
+  }
+  DCHECK(lossCwndBytes_.hasValue() && lossSsthresh_.hasValue());
+  auto prevState = state_;
+  cwndBytes_ = std::max(cwndBytes_, *lossCwndBytes_);
+  recoveryState_.endOfRecovery = folly::none;
+  if (*lossSsthresh_ == std::numeric_limits<uint64_t>::max()) {
+    // The reduction ended slow start, which goes on.
+    ssthresh_ = *lossSsthresh_;
+    state_ = CubicStates::Hystart;
+  } else {
+    // Back at the origin of the cubic curve with the restored cwnd, the same
+    // way slow start exits into Steady.
+    ssthresh_ = cwndBytes_;
+    state_ = CubicStates::Steady;
+    steadyState_.lastMaxCwndBytes = folly::none;
+  }
+  steadyState_.lastReductionTime = folly::none;
+  updatePacing();
+  if (state_ != prevState) {
+    QUIC_PROBE(
+        cc_state_change,
+        conn_,
+        static_cast<uint8_t>(type()),
+        static_cast<uint8_t>(prevState),
+        static_cast<uint8_t>(state_));
+  }
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        inflightBytes_,
+        getCongestionWindow(),
+        kCongestionLossUndo,
+        cubicStateToString(state_));
+  }
+}
+
 void Cubic::onRemoveBytesFromInflight(uint64_t bytes) {
   DCHECK_LE(bytes, inflightBytes_);
   inflightBytes_ -= bytes;
@@ -151,12 +291,13 @@ void Cubic::onRemoveBytesFromInflight(uint64_t bytes) {
       cwndBytes_,
       inflightBytes_,
       steadyState_.lastMaxCwndBytes.value_or(0));
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
         inflightBytes_,
         getCongestionWindow(),
-        kRemoveInflight.str(),
-        cubicStateToString(state_).str());
+        kRemoveInflight,
+        cubicStateToString(state_));
   }
 }
 
@@ -200,7 +341,7 @@ void Cubic::setAppIdle(bool idle, TimePoint eventTime) noexcept {
                 .count()
           : -1);
   if (conn_.qLogger) {
-    conn_.qLogger->addAppIdleUpdate(kAppIdle.str(), idle);
+    conn_.qLogger->addAppIdleUpdate(kAppIdle, idle);
   }
   bool currentAppIdle = isAppIdle();
   if (!currentAppIdle && idle) {
@@ -227,6 +368,41 @@ bool Cubic::isAppLimited() const noexcept {
   return isAppIdle();
 }
 
+bool Cubic::inSlowStart() const noexcept {
+  return state_ == CubicStates::Hystart;
+}
+
+bool Cubic::carefulResume(uint64_t savedCwndBytes, TimePoint now) {
+  if (state_ != CubicStates::Hystart || recoveryState_.endOfRecovery) {
+    return false;
+  }
+  auto jumpCwnd = carefulResume_.start(savedCwndBytes, cwndBytes_, now);
+  if (!jumpCwnd) {
+    return false;
+  }
+  cwndBytes_ = boundedCwnd(
+      *jumpCwnd,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      conn_.transportSettings.minCwndInMss);
+  updatePacing();
+  VLOG(10) << "Cubic careful resume, cwnd=" << cwndBytes_;
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        inflightBytes_,
+        getCongestionWindow(),
+        kCarefulResume,
+        cubicStateToString(state_));
+  }
+  return true;
+}
+
+bool Cubic::inConservativeSlowStart() const noexcept {
+  return state_ == CubicStates::Hystart &&
+      hystartState_.cssBaselineMinRtt.hasValue();
+}
+
 bool Cubic::isAppIdle() const noexcept {
   return quiescenceStart_.hasValue();
 }
@@ -238,7 +414,7 @@ void Cubic::calculateReductionFactors() noexcept {
       (numEmulatedConnections_ - 1 + kDefaultLastMaxReductionFactor) /
       numEmulatedConnections_;
   steadyState_.reductionFactor =
-      (numEmulatedConnections_ - 1 + kDefaultCubicReductionFactor) /
+      (numEmulatedConnections_ - 1 + steadyState_.baseReductionFactor) /
       numEmulatedConnections_;
   if (steadyState_.tcpFriendly) {
     // Every RTT, one "emulated" connection should increase by:
@@ -252,8 +428,8 @@ void Cubic::calculateReductionFactors() noexcept {
 }
 
 void Cubic::updateTimeToOrigin() noexcept {
-  // TODO: is there a faster way to do cbrt? We should benchmark a few
-  // alternatives.
+  // With fixedPointMath the cbrt is done in integers by fixedPointCbrt, see
+  // CubicBench for how the two compare.
   // TODO: there is a tradeoff between precalculate and cache the result of
   // kDefaultCubicReductionFactor / kTimeScalingFactor, and calculate it every
   // time, as multiplication before division may be a little more accurate.
@@ -278,7 +454,10 @@ void Cubic::updateTimeToOrigin() noexcept {
    */
   // 2500 = kTimeScalingFactor * 1000
   auto bytesToOrigin = *steadyState_.lastMaxCwndBytes - cwndBytes_;
-  if (UNLIKELY(
+  if (steadyState_.fixedPointMath) {
+    steadyState_.timeToOrigin = static_cast<double>(fixedPointCbrt(
+        bytesToOrigin * 1000 * 1000 / conn_.udpSendPacketLen * 2500));
+  } else if (UNLIKELY(
           bytesToOrigin * 1000 * 1000 / conn_.udpSendPacketLen * 2500 >
           std::numeric_limits<double>::max())) {
     LOG(WARNING) << "Quic Cubic: timeToOrigin calculation overflow";
@@ -300,7 +479,12 @@ int64_t Cubic::calculateCubicCwndDelta(TimePoint ackTime) noexcept {
       ackTime - *steadyState_.lastReductionTime);
   int64_t delta = 0;
   double timeElapsedCount = static_cast<double>(timeElapsed.count());
-  if (UNLIKELY(
+  if (steadyState_.fixedPointMath) {
+    delta = fixedPointCubicCwndDelta(
+        timeElapsed.count() -
+            static_cast<int64_t>(steadyState_.timeToOrigin),
+        conn_.udpSendPacketLen);
+  } else if (UNLIKELY(
           std::pow((timeElapsedCount - steadyState_.timeToOrigin), 3) >
           std::numeric_limits<double>::max())) {
     // (timeElapsed - timeToOrigin) ^ 3 will overflow/underflow, cut delta
@@ -327,12 +511,13 @@ int64_t Cubic::calculateCubicCwndDelta(TimePoint ackTime) noexcept {
       delta,
       static_cast<uint64_t>(steadyState_.timeToOrigin),
       static_cast<uint64_t>(timeElapsedCount));
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
         inflightBytes_,
         getCongestionWindow(),
-        kCubicSteadyCwnd.str(),
-        cubicStateToString(state_).str());
+        kCubicSteadyCwnd,
+        cubicStateToString(state_));
   }
   return delta;
 }
@@ -392,28 +577,42 @@ void Cubic::onPacketAckOrLoss(
   // largestLostPacketNum isn't a folly::none. But we should probably also check
   // against it here anyway just in case the loss code is changed in the
   // furture.
+  auto prevState = state_;
   if (lossEvent) {
     onPacketLoss(*lossEvent);
   }
   if (ackEvent && ackEvent->largestAckedPacket.hasValue()) {
     CHECK(!ackEvent->ackedPackets.empty());
+    if (ackEvent->ecnCeCount > 0) {
+      onPacketsMarkedCE(*ackEvent);
+    }
     onPacketAcked(*ackEvent);
   }
+  if (state_ != prevState) {
+    QUIC_PROBE(
+        cc_state_change,
+        conn_,
+        static_cast<uint8_t>(type()),
+        static_cast<uint8_t>(prevState),
+        static_cast<uint8_t>(state_));
+  }
 }
 
 void Cubic::onPacketAcked(const AckEvent& ack) {
   auto currentCwnd = cwndBytes_;
   DCHECK_LE(ack.ackedBytes, inflightBytes_);
   inflightBytes_ -= ack.ackedBytes;
+  carefulResume_.onPacketAcked(ack);
   if (recoveryState_.endOfRecovery.hasValue() &&
       *recoveryState_.endOfRecovery >= ack.ackedPackets.back().time) {
     QUIC_TRACE(fst_trace, conn_, "cubic_skip_ack");
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
           inflightBytes_,
           getCongestionWindow(),
-          kCubicSkipAck.str(),
-          cubicStateToString(state_).str());
+          kCubicSkipAck,
+          cubicStateToString(state_));
     }
     return;
   }
@@ -431,12 +630,13 @@ void Cubic::onPacketAcked(const AckEvent& ack) {
   updatePacing();
   if (cwndBytes_ == currentCwnd) {
     QUIC_TRACE(fst_trace, conn_, "cwnd_no_change", quiescenceStart_.hasValue());
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
           inflightBytes_,
           getCongestionWindow(),
-          kCwndNoChange.str(),
-          cubicStateToString(state_).str());
+          kCwndNoChange,
+          cubicStateToString(state_));
     }
   }
   QUIC_TRACE(
@@ -446,12 +646,13 @@ void Cubic::onPacketAcked(const AckEvent& ack) {
       cwndBytes_,
       inflightBytes_,
       steadyState_.lastMaxCwndBytes.value_or(0));
-  if (conn_.qLogger) {
+  if (conn_.qLogger &&
+      conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
     conn_.qLogger->addCongestionMetricUpdate(
         inflightBytes_,
         getCongestionWindow(),
-        kCongestionPacketAck.str(),
-        cubicStateToString(state_).str());
+        kCongestionPacketAck,
+        cubicStateToString(state_));
   }
 }
 
@@ -466,6 +667,21 @@ void Cubic::startHystartRttRound(TimePoint time) noexcept {
   hystartState_.found = HystartFound::No;
 }
 
+void Cubic::exitSlowStart() noexcept {
+  hystartState_.inRttRound = false;
+  ssthresh_ = cwndBytes_;
+  /* Now we exit slow start, reset currSampledRtt to be maximal value so
+   * that next time we go back to slow start, we won't be using a very old
+   * sampled RTT as the lastSampledRtt:
+   */
+  hystartState_.currSampledRtt = folly::none;
+  hystartState_.cssBaselineMinRtt = folly::none;
+  steadyState_.lastMaxCwndBytes = folly::none;
+  steadyState_.lastReductionTime = folly::none;
+  quiescenceStart_ = folly::none;
+  state_ = CubicStates::Steady;
+}
+
 bool Cubic::isRecovered(TimePoint packetSentTime) noexcept {
   CHECK(recoveryState_.endOfRecovery.hasValue());
   return packetSentTime > *recoveryState_.endOfRecovery;
@@ -551,6 +767,10 @@ void Cubic::updatePacing() noexcept {
       conn_.transportSettings.minCwndInMss,
       minimalPacingInterval_,
       conn_.lossState.srtt);
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(
+        cwndBytes_ * pacingGain(), conn_.lossState.srtt);
+  }
   if (pacingInterval_ == std::chrono::milliseconds::zero()) {
     return;
   }
@@ -558,7 +778,8 @@ void Cubic::updatePacing() noexcept {
     pacingInterval_ = minimalPacingInterval_;
   }
   if (conn_.transportSettings.pacingEnabled) {
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::PacingMetricUpdate)) {
       conn_.qLogger->addPacingMetricUpdate(pacingBurstSize_, pacingInterval_);
     }
     QUIC_TRACE(
@@ -570,6 +791,10 @@ void Cubic::updatePacing() noexcept {
 }
 
 void Cubic::onPacketAckedInHystart(const AckEvent& ack) {
+  if (hystartState_.plusPlus) {
+    onPacketAckedInHystartPlusPlus(ack);
+    return;
+  }
   if (!hystartState_.inRttRound) {
     startHystartRttRound(ack.ackTime);
   }
@@ -602,17 +827,7 @@ void Cubic::onPacketAckedInHystart(const AckEvent& ack) {
                << (*exitReason == Cubic::ExitReason::SSTHRESH
                        ? "cwnd > ssthresh"
                        : "found exit point");
-      hystartState_.inRttRound = false;
-      ssthresh_ = cwndBytes_;
-      /* Now we exit slow start, reset currSampledRtt to be maximal value so
-       * that next time we go back to slow start, we won't be using a very old
-       * sampled RTT as the lastSampledRtt:
-       */
-      hystartState_.currSampledRtt = folly::none;
-      steadyState_.lastMaxCwndBytes = folly::none;
-      steadyState_.lastReductionTime = folly::none;
-      quiescenceStart_ = folly::none;
-      state_ = CubicStates::Steady;
+      exitSlowStart();
     } else {
       // No exit yet, but we may still need to end this RTT round
       VLOG(20) << "Cubic Hystart, mayEndHystartRttRound, largestAckedPacketNum="
@@ -697,6 +912,86 @@ void Cubic::onPacketAckedInHystart(const AckEvent& ack) {
   }
 }
 
+/**
+ * HyStart++, RFC 9406. The min rtt of the first kHystartPlusPlusRttSamples
+ * acks of a round is compared with the previous round's. An increase moves
+ * slow start to conservative slow start (CSS), which grows cwnd by a quarter
+ * as fast. If a later round's min rtt falls below the one that started CSS
+ * the increase was spurious and slow start resumes, otherwise slow start ends
+ * after kCssRounds rounds of CSS. Unlike Hystart this doesn't wait for cwnd
+ * to reach kLowSsthreshInMss, CSS keeps growing cwnd anyway.
+ */
+void Cubic::onPacketAckedInHystartPlusPlus(const AckEvent& ack) {
+  if (!hystartState_.inRttRound) {
+    startHystartRttRound(ack.ackTime);
+  }
+  uint64_t increase = hystartState_.cssBaselineMinRtt
+      ? ack.ackedBytes / kCssGrowthDivisor
+      : ack.ackedBytes;
+  if (UNLIKELY(
+          std::numeric_limits<decltype(cwndBytes_)>::max() - cwndBytes_ <
+          increase)) {
+    throw QuicInternalException(
+        "Cubic HyStart++: cwnd overflow", LocalErrorCode::CWND_OVERFLOW);
+  }
+  VLOG(15) << "Cubic HyStart++ increase cwnd=" << cwndBytes_ << ", by "
+           << increase;
+  cwndBytes_ = boundedCwnd(
+      cwndBytes_ + increase,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      conn_.transportSettings.minCwndInMss);
+  if (cwndBytes_ >= ssthresh_) {
+    VLOG(15) << "Cubic exit slow start, reason = cwnd > ssthresh";
+    exitSlowStart();
+    return;
+  }
+
+  if (hystartState_.ackCount < kHystartPlusPlusRttSamples) {
+    hystartState_.currSampledRtt = std::min(
+        conn_.lossState.lrtt,
+        hystartState_.currSampledRtt.value_or(conn_.lossState.lrtt));
+    ++hystartState_.ackCount;
+  }
+  if (hystartState_.ackCount >= kHystartPlusPlusRttSamples) {
+    if (!hystartState_.cssBaselineMinRtt) {
+      if (hystartState_.lastSampledRtt) {
+        auto rttThresh = std::max(
+            kHystartPlusPlusMinRttThresh,
+            std::min(
+                kHystartPlusPlusMaxRttThresh,
+                *hystartState_.lastSampledRtt /
+                    kHystartPlusPlusRttThreshDivisor));
+        if (*hystartState_.currSampledRtt >=
+            *hystartState_.lastSampledRtt + rttThresh) {
+          VLOG(20) << "Cubic HyStart++: enter conservative slow start, "
+                   << "currSampledRtt="
+                   << hystartState_.currSampledRtt->count()
+                   << "us, lastSampledRtt="
+                   << hystartState_.lastSampledRtt->count() << "us";
+          hystartState_.cssBaselineMinRtt = hystartState_.currSampledRtt;
+          hystartState_.cssRounds = 0;
+        }
+      }
+    } else if (
+        *hystartState_.currSampledRtt < *hystartState_.cssBaselineMinRtt) {
+      VLOG(20) << "Cubic HyStart++: spurious delay increase, resume slow "
+               << "start";
+      hystartState_.cssBaselineMinRtt = folly::none;
+    }
+  }
+
+  if (ack.ackedPackets.back().time > hystartState_.rttRoundEndTarget) {
+    hystartState_.inRttRound = false;
+    if (hystartState_.cssBaselineMinRtt &&
+        ++hystartState_.cssRounds >= kCssRounds) {
+      VLOG(15) << "Cubic exit slow start, reason = conservative slow start "
+               << "ended";
+      exitSlowStart();
+    }
+  }
+}
+
 /**
  * Note: The Cubic paper, and linux/chromium implementation differ on the
  * definition of "time to origin", or the variable K in the paper. In the paper,
@@ -714,12 +1009,13 @@ void Cubic::onPacketAckedInHystart(const AckEvent& ack) {
 void Cubic::onPacketAckedInSteady(const AckEvent& ack) {
   if (isAppLimited()) {
     QUIC_TRACE(fst_trace, conn_, "ack_in_quiescence");
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
           inflightBytes_,
           getCongestionWindow(),
-          kAckInQuiescence.str(),
-          cubicStateToString(state_).str());
+          kAckInQuiescence,
+          cubicStateToString(state_));
     }
     return;
   }
@@ -735,12 +1031,13 @@ void Cubic::onPacketAckedInSteady(const AckEvent& ack) {
     // lastMaxCwndBytes won't be set when we transit from Hybrid to Steady. In
     // that case, we are at the "origin" already.
     QUIC_TRACE(fst_trace, conn_, "reset_timetoorigin");
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
           inflightBytes_,
           getCongestionWindow(),
-          kResetTimeToOrigin.str(),
-          cubicStateToString(state_).str());
+          kResetTimeToOrigin,
+          cubicStateToString(state_));
     }
     steadyState_.timeToOrigin = 0.0;
     steadyState_.lastMaxCwndBytes = cwndBytes_;
@@ -756,12 +1053,13 @@ void Cubic::onPacketAckedInSteady(const AckEvent& ack) {
   if (!steadyState_.lastReductionTime) {
     QUIC_TRACE(fst_trace, conn_, "reset_lastreductiontime");
     steadyState_.lastReductionTime = ack.ackTime;
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
           inflightBytes_,
           getCongestionWindow(),
-          kResetLastReductionTime.str(),
-          cubicStateToString(state_).str());
+          kResetLastReductionTime,
+          cubicStateToString(state_));
     }
   }
   uint64_t newCwnd = calculateCubicCwnd(calculateCubicCwndDelta(ack.ackTime));
@@ -786,12 +1084,13 @@ void Cubic::onPacketAckedInSteady(const AckEvent& ack) {
         conn_.transportSettings.maxCwndInMss,
         conn_.transportSettings.minCwndInMss);
     cwndBytes_ = std::max(cwndBytes_, steadyState_.estRenoCwnd);
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
           inflightBytes_,
           getCongestionWindow(),
-          kRenoCwndEstimation.str(),
-          cubicStateToString(state_).str());
+          kRenoCwndEstimation,
+          cubicStateToString(state_));
     }
   }
 }
@@ -812,12 +1111,13 @@ void Cubic::onPacketAckedInRecovery(const AckEvent& ack) {
     DCHECK(steadyState_.lastReductionTime.hasValue());
     updateTimeToOrigin();
     cwndBytes_ = calculateCubicCwnd(calculateCubicCwndDelta(ack.ackTime));
-    if (conn_.qLogger) {
+    if (conn_.qLogger &&
+        conn_.qLogger->isEnabled(QLogEventType::CongestionMetricUpdate)) {
       conn_.qLogger->addCongestionMetricUpdate(
           inflightBytes_,
           getCongestionWindow(),
-          kPacketAckedInRecovery.str(),
-          cubicStateToString(state_).str());
+          kPacketAckedInRecovery,
+          cubicStateToString(state_));
     }
   }
 }
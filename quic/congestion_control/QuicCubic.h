@@ -9,7 +9,9 @@
 #pragma once
 
 #include <quic/QuicException.h>
+#include <quic/congestion_control/CarefulResume.h>
 #include <quic/congestion_control/CongestionControlFunctions.h>
+#include <quic/congestion_control/LossUndo.h>
 #include <quic/logging/QuicLogger.h>
 #include <quic/state/StateData.h>
 
@@ -102,6 +104,15 @@ class Cubic : public CongestionController {
 
   bool isAppLimited() const noexcept override;
 
+  bool inSlowStart() const noexcept override;
+
+  bool carefulResume(uint64_t savedCwndBytes, TimePoint now) override;
+
+  void onSpuriousLoss(TimePoint lossTime) override;
+
+  // Whether HyStart++ slowed slow start down to conservative slow start.
+  bool inConservativeSlowStart() const noexcept;
+
   CongestionControlType type() const noexcept override;
 
   void markPacerTimeoutScheduled(TimePoint currentTime) noexcept override;
@@ -120,17 +131,23 @@ class Cubic : public CongestionController {
   bool isAppIdle() const noexcept;
   void onPacketAcked(const AckEvent& ack);
   void onPacketAckedInHystart(const AckEvent& ack);
+  void onPacketAckedInHystartPlusPlus(const AckEvent& ack);
   void onPacketAckedInSteady(const AckEvent& ack);
   void onPacketAckedInRecovery(const AckEvent& ack);
 
   void onPacketLoss(const LossEvent& loss);
   void onPacketLossInRecovery(const LossEvent& loss);
+  void onPacketsMarkedCE(const AckEvent& ack);
+  // Reduces the cwnd and starts a recovery period, unless largestSentTime
+  // falls within the current one. Returns whether a new one was started.
+  bool enterRecovery(TimePoint largestSentTime, TimePoint eventTime) noexcept;
   void onPersistentCongestion();
 
   float pacingGain() const noexcept;
   void updatePacing() noexcept;
 
   void startHystartRttRound(TimePoint time) noexcept;
+  void exitSlowStart() noexcept;
 
   void cubicReduction(TimePoint lossTime) noexcept;
   void calculateReductionFactors() noexcept;
@@ -173,6 +190,14 @@ class Cubic : public CongestionController {
     // When a packet with sent time >= rttRoundEndTarget is acked, end the
     // current RTT round
     TimePoint rttRoundEndTarget;
+    // If HyStart++ is used instead of AckTrain and DelayIncrease. It reuses
+    // currSampledRtt, lastSampledRtt and ackCount for its rtt rounds.
+    bool plusPlus{false};
+    // Min rtt of the round that started conservative slow start. Set while in
+    // conservative slow start
+    folly::Optional<std::chrono::microseconds> cssBaselineMinRtt;
+    // Number of rounds completed in conservative slow start
+    uint8_t cssRounds{0};
   };
 
   struct SteadyState {
@@ -181,11 +206,16 @@ class Cubic : public CongestionController {
     // The cwnd value that timeToOrigin is calculated based on
     folly::Optional<uint64_t> originPoint;
     bool tcpFriendly{true};
+    // If timeToOrigin and the cwnd delta are computed in integers. The
+    // timeToOrigin is then rounded down to whole milliseconds.
+    bool fixedPointMath{false};
     folly::Optional<TimePoint> lastReductionTime;
     // This is Wmax, it could be different from lossCwndBytes if cwnd never
     // reaches last lastMaxCwndBytes before loss event:
     folly::Optional<uint64_t> lastMaxCwndBytes;
     uint64_t estRenoCwnd;
+    // Reduction factor of a single emulated connection.
+    float baseReductionFactor{kDefaultCubicReductionFactor};
     // cache reduction/increase factors based on numEmulatedConnections_
     float reductionFactor;
     float lastMaxReductionFactor;
@@ -203,6 +233,8 @@ class Cubic : public CongestionController {
   HystartState hystartState_;
   SteadyState steadyState_;
   RecoveryState recoveryState_;
+  CarefulResume carefulResume_;
+  LossUndo lossUndo_;
 
   // When spreadAcrossRtt_ is set to true, the pacing writes will be distributed
   // evenly across an RTT. Otherwise, we will use the first N number of pacing
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/TokenBucketPacer.h>
+
+#include <quic/common/TimeUtil.h>
+#include <quic/congestion_control/CongestionControlFunctions.h>
+
+#include <cmath>
+
+namespace quic {
+
+TokenBucketPacer::TokenBucketPacer(
+    const QuicConnectionStateBase& conn,
+    std::chrono::microseconds minimalInterval)
+    : conn_(conn), minimalInterval_(minimalInterval) {}
+
+void TokenBucketPacer::refreshPacingRate(
+    uint64_t cwndBytes,
+    std::chrono::microseconds rtt) {
+  cwndBytes_ = cwndBytes;
+  rtt_ = rtt;
+  updatePacing();
+}
+
+void TokenBucketPacer::setMinimalInterval(std::chrono::microseconds interval) {
+  if (interval != 0us) {
+    minimalInterval_ = interval;
+    updatePacing();
+  }
+}
+
+void TokenBucketPacer::updatePacing() {
+  if (rtt_ == 0us || cwndBytes_ == 0) {
+    interval_ = 0us;
+    return;
+  }
+  bool wasPacing = interval_ != 0us;
+  std::tie(interval_, burstSize_) = calculatePacingRate(
+      conn_,
+      cwndBytes_,
+      conn_.transportSettings.minCwndInMss,
+      minimalInterval_,
+      rtt_);
+  if (interval_ != 0us && !wasPacing) {
+    // The first burst goes out right away.
+    tokens_ = burstSize_;
+    lastUpdateTime_.clear();
+  }
+  tokens_ = std::min(tokens_, maxTokens());
+}
+
+double TokenBucketPacer::maxTokens() const {
+  return std::max(burstSize_, conn_.transportSettings.maxBurstPackets);
+}
+
+double TokenBucketPacer::tokensAt(TimePoint currentTime) const {
+  if (!lastUpdateTime_ || currentTime <= *lastUpdateTime_) {
+    return tokens_;
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      currentTime - *lastUpdateTime_);
+  return std::min(
+      maxTokens(),
+      tokens_ +
+          static_cast<double>(burstSize_) * elapsed.count() /
+              interval_.count());
+}
+
+std::chrono::microseconds TokenBucketPacer::getTimeUntilNextWrite(
+    TimePoint currentTime) const {
+  if (interval_ == 0us) {
+    return 0us;
+  }
+  auto tokens = tokensAt(currentTime);
+  if (tokens >= burstSize_) {
+    return minimalInterval_;
+  }
+  auto timeToBurst = std::chrono::microseconds(static_cast<uint64_t>(std::ceil(
+      (burstSize_ - tokens) * interval_.count() / burstSize_)));
+  return timeMax(minimalInterval_, timeToBurst);
+}
+
+uint64_t TokenBucketPacer::updateAndGetWriteBatchSize(TimePoint currentTime) {
+  if (interval_ == 0us) {
+    return conn_.transportSettings.writeConnectionDataPacketsLimit;
+  }
+  tokens_ = tokensAt(currentTime);
+  lastUpdateTime_ = currentTime;
+  return static_cast<uint64_t>(tokens_);
+}
+
+void TokenBucketPacer::onPacketSent() {
+  if (interval_ != 0us) {
+    tokens_ = std::max(0.0, tokens_ - 1);
+  }
+}
+
+std::chrono::microseconds TokenBucketPacer::getPacingInterval() const {
+  return interval_;
+}
+
+uint64_t TokenBucketPacer::getPacingBurstSize() const {
+  return interval_ == 0us
+      ? conn_.transportSettings.writeConnectionDataPacketsLimit
+      : burstSize_;
+}
+
+} // namespace quic
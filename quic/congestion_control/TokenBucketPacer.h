@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+/**
+ * Pacer with a token bucket of packets. Tokens accumulate at the target rate
+ * of the congestion controller, a burst worth of them per pacing interval as
+ * calculatePacingRate sizes it, and every packet sent takes one. Tokens left
+ * over, because a timer fired late or the connection had less to write, are
+ * kept as burst credit up to maxBurstPackets.
+ */
+class TokenBucketPacer : public Pacer {
+ public:
+  TokenBucketPacer(
+      const QuicConnectionStateBase& conn,
+      std::chrono::microseconds minimalInterval);
+
+  void refreshPacingRate(uint64_t cwndBytes, std::chrono::microseconds rtt)
+      override;
+
+  void setMinimalInterval(std::chrono::microseconds interval) override;
+
+  std::chrono::microseconds getTimeUntilNextWrite(
+      TimePoint currentTime) const override;
+
+  uint64_t updateAndGetWriteBatchSize(TimePoint currentTime) override;
+
+  void onPacketSent() override;
+
+  std::chrono::microseconds getPacingInterval() const override;
+  uint64_t getPacingBurstSize() const override;
+
+  double tokens() const {
+    return tokens_;
+  }
+
+ private:
+  void updatePacing();
+  double tokensAt(TimePoint currentTime) const;
+  double maxTokens() const;
+
+  const QuicConnectionStateBase& conn_;
+  std::chrono::microseconds minimalInterval_;
+  uint64_t cwndBytes_{0};
+  std::chrono::microseconds rtt_{0us};
+  // 0 while the rate is too high to pace with minimalInterval_.
+  std::chrono::microseconds interval_{0us};
+  uint64_t burstSize_{0};
+  double tokens_{0};
+  folly::Optional<TimePoint> lastUpdateTime_;
+};
+
+} // namespace quic
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/BandwidthAllocator.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/congestion_control/FairSharePacer.h>
+#include <quic/congestion_control/TokenBucketPacer.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+TEST(BandwidthAllocatorTest, UncappedUnderBudget) {
+  BandwidthAllocator allocator(1000);
+  BandwidthAllocator::Share a(allocator);
+  BandwidthAllocator::Share b(allocator);
+  auto now = Clock::now();
+  a.setDemand(400);
+  a.markActive(now);
+  b.setDemand(600);
+  b.markActive(now);
+  allocator.maybeUpdate(now);
+  EXPECT_FALSE(allocator.getFairShare().hasValue());
+}
+
+TEST(BandwidthAllocatorTest, MaxMinFair) {
+  BandwidthAllocator allocator(1000);
+  BandwidthAllocator::Share a(allocator);
+  BandwidthAllocator::Share b(allocator);
+  BandwidthAllocator::Share c(allocator);
+  auto now = Clock::now();
+  for (auto share : {&a, &b, &c}) {
+    share->markActive(now);
+  }
+  a.setDemand(100);
+  b.setDemand(300);
+  c.setDemand(1000);
+  auto generation = allocator.getGeneration();
+  allocator.maybeUpdate(now);
+  // a and b get what they want, c the rest.
+  ASSERT_TRUE(allocator.getFairShare().hasValue());
+  EXPECT_EQ(*allocator.getFairShare(), 600u);
+  EXPECT_NE(allocator.getGeneration(), generation);
+
+  // Not recomputed before kBandwidthAllocationInterval.
+  b.setDemand(1000);
+  allocator.maybeUpdate(now + kBandwidthAllocationInterval / 2);
+  EXPECT_EQ(*allocator.getFairShare(), 600u);
+  allocator.maybeUpdate(now + kBandwidthAllocationInterval);
+  EXPECT_EQ(*allocator.getFairShare(), 450u);
+}
+
+TEST(BandwidthAllocatorTest, IdleAndRemovedShares) {
+  BandwidthAllocator allocator(1000);
+  BandwidthAllocator::Share a(allocator);
+  auto now = Clock::now();
+  a.setDemand(1000);
+  a.markActive(now);
+  {
+    BandwidthAllocator::Share b(allocator);
+    b.setDemand(1000);
+    b.markActive(now);
+    BandwidthAllocator::Share c(allocator);
+    c.setDemand(1000);
+    EXPECT_EQ(allocator.getNumShares(), 3u);
+    // c never wrote, it doesn't take a share.
+    allocator.maybeUpdate(now);
+    EXPECT_EQ(*allocator.getFairShare(), 500u);
+  }
+  EXPECT_EQ(allocator.getNumShares(), 1u);
+  now += kBandwidthAllocationInterval;
+  allocator.maybeUpdate(now);
+  EXPECT_FALSE(allocator.getFairShare().hasValue());
+
+  // An idle connection leaves its share to the others.
+  BandwidthAllocator::Share d(allocator);
+  d.setDemand(1000);
+  d.markActive(now);
+  now += kBandwidthAllocationInterval;
+  allocator.maybeUpdate(now);
+  EXPECT_EQ(*allocator.getFairShare(), 500u);
+  now += kBandwidthAllocationIdleTimeout;
+  a.markActive(now);
+  allocator.maybeUpdate(now);
+  EXPECT_FALSE(allocator.getFairShare().hasValue());
+}
+
+TEST(BandwidthAllocatorTest, FairSharePacerCapsRate) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  conn.udpSendPacketLen = 1000;
+  auto allocator = std::make_shared<BandwidthAllocator>(500 * 1000);
+  FairSharePacer pacer1(
+      std::make_unique<TokenBucketPacer>(conn, 1ms), allocator);
+  FairSharePacer pacer2(
+      std::make_unique<TokenBucketPacer>(conn, 1ms), allocator);
+  EXPECT_EQ(allocator->getNumShares(), 2u);
+
+  // 1MB/s each: a packet per ms.
+  pacer1.refreshPacingRate(100 * 1000, 100ms);
+  pacer2.refreshPacingRate(100 * 1000, 100ms);
+  EXPECT_EQ(pacer1.getPacingInterval(), 1ms);
+
+  // Only the first one writes: it gets the whole budget.
+  auto now = Clock::now();
+  pacer1.updateAndGetWriteBatchSize(now);
+  EXPECT_EQ(pacer1.getPacingInterval(), 2ms);
+
+  // Both write: half the budget each.
+  pacer2.updateAndGetWriteBatchSize(now);
+  now += kBandwidthAllocationInterval;
+  pacer1.updateAndGetWriteBatchSize(now);
+  EXPECT_EQ(pacer1.getPacingInterval(), 4ms);
+  pacer2.updateAndGetWriteBatchSize(now);
+  EXPECT_EQ(pacer2.getPacingInterval(), 4ms);
+
+  // A lower target than the share isn't raised.
+  pacer1.refreshPacingRate(10 * 1000, 100ms);
+  EXPECT_EQ(pacer1.getPacingInterval(), 10ms);
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/Bbr2.h>
+
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+
+using namespace quic;
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+namespace {
+
+class MockBandwidthSampler : public BbrCongestionController::BandwidthSampler {
+ public:
+  ~MockBandwidthSampler() override {}
+
+  MOCK_CONST_METHOD0(getBandwidth, Bandwidth());
+  MOCK_CONST_METHOD0(isAppLimited, bool());
+
+  MOCK_METHOD2(
+      onPacketAcked,
+      void(const CongestionController::AckEvent&, uint64_t));
+  MOCK_METHOD0(onAppLimited, void());
+};
+
+} // namespace
+
+class Bbr2Test : public Test {
+ protected:
+  void SetUp() override {
+    conn_.udpSendPacketLen = 1000;
+    bbr_ = std::make_unique<Bbr2CongestionController>(conn_);
+    auto bandwidthSampler = std::make_unique<MockBandwidthSampler>();
+    EXPECT_CALL(*bandwidthSampler, getBandwidth())
+        .WillRepeatedly(Return(Bandwidth(1000, 1000us)));
+    EXPECT_CALL(*bandwidthSampler, isAppLimited())
+        .WillRepeatedly(Return(false));
+    bbr_->setBandwidthSampler(std::move(bandwidthSampler));
+  }
+
+  OutstandingPacket send(TimePoint sentTime = Clock::now()) {
+    auto packet = makeTestingWritePacket(
+        nextPacketNum_++, 1000, totalBytesSent_ + 1000, false, sentTime);
+    totalBytesSent_ += 1000;
+    bbr_->onPacketSent(packet);
+    return packet;
+  }
+
+  // Sends a packet and acks it. The packet is sent after the current round
+  // started, so its ack ends the round.
+  void sendAndAck(uint64_t ecnCeCount = 0) {
+    auto sentTime = Clock::now() + 1ms;
+    auto packet = send(sentTime);
+    auto ack =
+        makeAck(nextPacketNum_ - 1, 1000, sentTime + 1ms, sentTime);
+    ack.ecnCeCount = ecnCeCount;
+    bbr_->onPacketAckOrLoss(ack, folly::none);
+    conn_.lossState.totalBytesAcked += 1000;
+  }
+
+  void lose(uint64_t lostBytes) {
+    CongestionController::LossEvent loss;
+    loss.lostBytes = lostBytes;
+    loss.lostPackets = 1;
+    bbr_->onPacketAckOrLoss(folly::none, loss);
+  }
+
+  // Fills a round with too many losses, which ends Startup.
+  void exitStartupOnLoss() {
+    sendAndAck();
+    for (int i = 0; i < 10; ++i) {
+      send();
+    }
+    for (uint32_t i = 0; i < kBbr2StartupFullLossCount; ++i) {
+      lose(1000);
+    }
+    sendAndAck();
+  }
+
+  QuicConnectionStateBase conn_{QuicNodeType::Client};
+  std::unique_ptr<Bbr2CongestionController> bbr_;
+  PacketNum nextPacketNum_{0};
+  uint64_t totalBytesSent_{0};
+};
+
+TEST_F(Bbr2Test, InitStates) {
+  EXPECT_EQ(CongestionControlType::BBR2, bbr_->type());
+  EXPECT_EQ(Bbr2CongestionController::State::Startup, bbr_->state());
+  EXPECT_TRUE(bbr_->inSlowStart());
+  EXPECT_EQ(
+      1000 * conn_.transportSettings.initCwndInMss,
+      bbr_->getCongestionWindow());
+  EXPECT_EQ(bbr_->getWritableBytes(), bbr_->getCongestionWindow());
+  EXPECT_FALSE(bbr_->inflightHi().hasValue());
+  EXPECT_FALSE(bbr_->inflightLo().hasValue());
+}
+
+TEST_F(Bbr2Test, StartupExitsOnLoss) {
+  sendAndAck();
+  for (int i = 0; i < 10; ++i) {
+    send();
+  }
+  // One loss short of ending Startup.
+  for (uint32_t i = 0; i < kBbr2StartupFullLossCount - 1; ++i) {
+    lose(1000);
+  }
+  sendAndAck();
+  EXPECT_EQ(Bbr2CongestionController::State::Startup, bbr_->state());
+  EXPECT_FALSE(bbr_->inflightHi().hasValue());
+
+  for (int i = 0; i < 10; ++i) {
+    send();
+  }
+  for (uint32_t i = 0; i < kBbr2StartupFullLossCount; ++i) {
+    lose(1000);
+  }
+  sendAndAck();
+  EXPECT_FALSE(bbr_->inSlowStart());
+  // The inflight bytes are below the BDP, so Drain ends right away. They are
+  // above the headroom ProbeBwDown drains to though.
+  EXPECT_EQ(Bbr2CongestionController::State::ProbeBwDown, bbr_->state());
+  ASSERT_TRUE(bbr_->inflightHi().hasValue());
+  EXPECT_EQ(1000 * conn_.transportSettings.initCwndInMss, *bbr_->inflightHi());
+  EXPECT_LE(bbr_->getCongestionWindow(), *bbr_->inflightHi());
+}
+
+TEST_F(Bbr2Test, StartupExitsOnEcn) {
+  sendAndAck();
+  sendAndAck(1);
+  EXPECT_FALSE(bbr_->inSlowStart());
+  EXPECT_TRUE(bbr_->inflightHi().hasValue());
+}
+
+TEST_F(Bbr2Test, LowerBoundsBackOffOnLossAndEcn) {
+  exitStartupOnLoss();
+  ASSERT_EQ(Bbr2CongestionController::State::ProbeBwCruise, bbr_->state());
+  auto cwnd = bbr_->getCongestionWindow();
+
+  send();
+  lose(1000);
+  sendAndAck();
+  ASSERT_TRUE(bbr_->inflightLo().hasValue());
+  auto inflightLo = static_cast<uint64_t>(cwnd * kBbr2Beta);
+  EXPECT_EQ(inflightLo, *bbr_->inflightLo());
+  EXPECT_EQ(inflightLo, bbr_->getCongestionWindow());
+
+  // A CE marked round backs off a bit further.
+  sendAndAck(1);
+  inflightLo = static_cast<uint64_t>(
+      inflightLo * (1 - kBbr2EcnAlphaGain * kBbr2EcnFactor));
+  EXPECT_EQ(inflightLo, *bbr_->inflightLo());
+  EXPECT_EQ(inflightLo, bbr_->getCongestionWindow());
+}
+
+TEST_F(Bbr2Test, ProbeUpBacksOffOnLoss) {
+  exitStartupOnLoss();
+  send();
+  lose(1000);
+  sendAndAck();
+  ASSERT_TRUE(bbr_->inflightLo().hasValue());
+
+  // With a BDP of initCwndInMss packets, ProbeBw probes after as many rounds.
+  for (uint64_t i = 0; i < conn_.transportSettings.initCwndInMss - 2; ++i) {
+    sendAndAck();
+    EXPECT_EQ(Bbr2CongestionController::State::ProbeBwCruise, bbr_->state());
+  }
+  sendAndAck();
+  EXPECT_EQ(Bbr2CongestionController::State::ProbeBwRefill, bbr_->state());
+  // The probe starts over from the long term bound.
+  EXPECT_FALSE(bbr_->inflightLo().hasValue());
+  sendAndAck();
+  EXPECT_EQ(Bbr2CongestionController::State::ProbeBwUp, bbr_->state());
+
+  send();
+  lose(1000);
+  EXPECT_EQ(Bbr2CongestionController::State::ProbeBwDown, bbr_->state());
+  ASSERT_TRUE(bbr_->inflightHi().hasValue());
+  EXPECT_EQ(
+      static_cast<uint64_t>(
+          1000 * conn_.transportSettings.initCwndInMss * kBbr2Beta),
+      *bbr_->inflightHi());
+}
+
+} // namespace test
+} // namespace quic
@@ -21,6 +21,37 @@ namespace test {
 
 class BbrBandwidthSamplerTest : public Test {
  protected:
+  OutstandingPacket
+  sendPacket(PacketNum pn, uint64_t size, TimePoint time, bool appLimited) {
+    conn_.lossState.totalBytesSent += size;
+    auto packet = makeTestingWritePacket(
+        pn, size, conn_.lossState.totalBytesSent, false, time);
+    packet.isAppLimited = appLimited;
+    return packet;
+  }
+
+  // Updates the loss state the way processAckFrame does, and hands the
+  // packets to the sampler in the same order.
+  void ackPackets(
+      BbrBandwidthSampler& sampler,
+      std::vector<OutstandingPacket> packets,
+      TimePoint ackTime,
+      uint64_t rttCounter = 0) {
+    CongestionController::AckEvent ackEvent;
+    ackEvent.ackTime = ackTime;
+    for (auto& packet : packets) {
+      conn_.lossState.totalBytesAcked += packet.encodedSize;
+      conn_.lossState.totalBytesSentAtLastAck = conn_.lossState.totalBytesSent;
+      conn_.lossState.totalBytesAckedAtLastAck =
+          conn_.lossState.totalBytesAcked;
+      conn_.lossState.lastAckedPacketSentTime = packet.time;
+      conn_.lossState.lastAckedTime = ackTime;
+      ackEvent.ackedBytes += packet.encodedSize;
+      ackEvent.ackedPackets.push_back(std::move(packet));
+    }
+    sampler.onPacketAcked(ackEvent, rttCounter);
+  }
+
   QuicConnectionStateBase conn_{QuicNodeType::Client};
 };
 
@@ -42,82 +73,129 @@ TEST_F(BbrBandwidthSamplerTest, NoPreviousAckedPacket) {
 
 TEST_F(BbrBandwidthSamplerTest, RateCalculation) {
   BbrBandwidthSampler sampler(conn_);
-  CongestionController::AckEvent ackEvent;
-  ackEvent.ackedBytes = 5000;
-  conn_.lossState.totalBytesAcked = 5000;
-  auto ackTime = Clock::now();
-  ackEvent.ackTime = ackTime;
-  auto lastAckedPacketSentTime = ackTime - 200us;
-  auto lastAckedPacketAckTime = ackTime - 100us;
-  for (PacketNum pn = 0; pn < 5; pn++) {
-    auto packet = makeTestingWritePacket(pn, 1000, 1000 + 1000 * pn, false);
-    packet.lastAckedPacketInfo.emplace(
-        lastAckedPacketSentTime, lastAckedPacketAckTime, 0, 0);
-    packet.time = ackTime - 50us;
-    ackEvent.ackedPackets.push_back(packet);
-  }
+  auto sendTime = Clock::now();
+  ackPackets(sampler, {sendPacket(0, 1000, sendTime, false)}, sendTime + 100us);
+  // The first packet had no acked state, it's measured over its rtt.
+  EXPECT_EQ(
+      Bandwidth(1000, std::chrono::microseconds(100)), sampler.getBandwidth());
 
-  sampler.onPacketAcked(ackEvent, 0);
+  std::vector<OutstandingPacket> packets;
+  for (PacketNum pn = 1; pn < 6; pn++) {
+    packets.push_back(sendPacket(pn, 1000, sendTime + 150us, false));
+  }
+  ackPackets(sampler, std::move(packets), sendTime + 200us);
+  // 5000 bytes acked within 100us of the first ack.
   EXPECT_EQ(
       Bandwidth(5000, std::chrono::microseconds(100)), sampler.getBandwidth());
 }
 
+TEST_F(BbrBandwidthSamplerTest, PerAckSample) {
+  auto sendTime = Clock::now();
+  auto sendAndAck = [&](BbrBandwidthSampler& sampler) {
+    ackPackets(
+        sampler, {sendPacket(0, 1000, sendTime, false)}, sendTime + 100us);
+    // Acked in reverse, with a send rate above the ack rate.
+    std::vector<OutstandingPacket> packets;
+    for (PacketNum pn = 1; pn < 6; pn++) {
+      packets.insert(
+          packets.begin(),
+          sendPacket(pn, 1000, sendTime + 100us + 10us * pn, false));
+    }
+    ackPackets(sampler, std::move(packets), sendTime + 1100us);
+  };
+
+  BbrBandwidthSampler perPacketSampler(conn_);
+  sendAndAck(perPacketSampler);
+  // The last sample is from the packet sent first.
+  EXPECT_EQ(
+      Bandwidth(1000, std::chrono::microseconds(110)),
+      perPacketSampler.getLatestSample()->bandwidth);
+  EXPECT_EQ(
+      Bandwidth(5000, std::chrono::microseconds(150)),
+      perPacketSampler.getBandwidth());
+
+  conn_.lossState = LossState();
+  conn_.transportSettings.bbrPerAckBandwidthSample = true;
+  BbrBandwidthSampler perAckSampler(conn_);
+  sendAndAck(perAckSampler);
+  // The only sample is from the packet sent last, same best bandwidth.
+  EXPECT_EQ(
+      Bandwidth(5000, std::chrono::microseconds(150)),
+      perAckSampler.getLatestSample()->bandwidth);
+  EXPECT_EQ(perPacketSampler.getBandwidth(), perAckSampler.getBandwidth());
+}
+
+TEST_F(BbrBandwidthSamplerTest, AckedStatesPruned) {
+  BbrBandwidthSampler sampler(conn_);
+  auto sendTime = Clock::now();
+  // Still outstanding, it keeps the states sent after it.
+  conn_.outstandingPackets.push_back(sendPacket(0, 1000, sendTime, false));
+  ackPackets(
+      sampler, {sendPacket(1, 1000, sendTime + 10us, false)}, sendTime + 100us);
+  ackPackets(
+      sampler,
+      {sendPacket(2, 1000, sendTime + 110us, false)},
+      sendTime + 200us);
+  EXPECT_EQ(2, sampler.getAckedStatesSize());
+
+  conn_.outstandingPackets.clear();
+  ackPackets(
+      sampler,
+      {sendPacket(3, 1000, sendTime + 210us, false)},
+      sendTime + 300us);
+  EXPECT_EQ(1, sampler.getAckedStatesSize());
+}
+
+TEST_F(BbrBandwidthSamplerTest, LatestSampleTaggedAppLimited) {
+  BbrBandwidthSampler sampler(conn_);
+  EXPECT_FALSE(sampler.getLatestSample().hasValue());
+  auto sendTime = Clock::now();
+  ackPackets(sampler, {sendPacket(0, 1000, sendTime, false)}, sendTime + 100us);
+  ackPackets(
+      sampler, {sendPacket(1, 1000, sendTime + 150us, true)}, sendTime + 200us);
+  ASSERT_TRUE(sampler.getLatestSample().hasValue());
+  EXPECT_TRUE(sampler.getLatestSample()->appLimited);
+  EXPECT_EQ(
+      Bandwidth(1000, std::chrono::microseconds(100)),
+      sampler.getLatestSample()->bandwidth);
+
+  ackPackets(
+      sampler,
+      {sendPacket(2, 1000, sendTime + 250us, false)},
+      sendTime + 300us);
+  EXPECT_FALSE(sampler.getLatestSample()->appLimited);
+}
+
 TEST_F(BbrBandwidthSamplerTest, SampleExpiration) {
   BbrBandwidthSampler sampler(conn_);
-  CongestionController::AckEvent ackEvent;
-  conn_.lossState.totalBytesAcked = 1000;
-  ackEvent.ackedBytes = 1000;
-  auto ackTime = Clock::now();
-  ackEvent.ackTime = ackTime;
-  auto lastAckedPacketSentTime = ackTime - 200us;
-  auto lastAckedPacketAckTime = ackTime - 100us;
-  PacketNum pn = 1;
-  auto packet = makeTestingWritePacket(pn, 1000, 2000, false);
-  packet.lastAckedPacketInfo.emplace(
-      lastAckedPacketSentTime, lastAckedPacketAckTime, 1000, 1000);
-  packet.time = ackTime - 50us;
-  ackEvent.ackedPackets.push_back(packet);
-  sampler.onPacketAcked(ackEvent, 0);
+  auto sendTime = Clock::now();
+  ackPackets(sampler, {sendPacket(0, 1000, sendTime, false)}, sendTime + 100us);
   auto firstBandwidthSample = sampler.getBandwidth();
 
-  pn++;
-  conn_.lossState.totalBytesAcked = 2000;
-  auto packet2 = makeTestingWritePacket(pn, 500, 2500, false);
-  packet2.lastAckedPacketInfo.emplace(packet.time, ackTime, 2000, 1000);
-  auto ackTime2 = ackTime + 150us;
-  CongestionController::AckEvent ackEvent2;
-  ackEvent2.ackTime = ackTime2;
-  packet2.time = ackTime + 110us;
-  ackEvent2.ackedPackets.push_back(packet2);
-  sampler.onPacketAcked(ackEvent2, kBandwidthWindowLength / 4 + 1);
-  auto secondBandwidthSample = sampler.getBandwidth();
+  ackPackets(
+      sampler,
+      {sendPacket(1, 1000, sendTime + 150us, false)},
+      sendTime + 400us,
+      kBandwidthWindowLength / 4 + 1);
+  auto secondBandwidthSample = *sampler.getLatestSample();
+  EXPECT_LT(secondBandwidthSample.bandwidth, firstBandwidthSample);
   EXPECT_EQ(firstBandwidthSample, sampler.getBandwidth());
 
-  pn++;
-  conn_.lossState.totalBytesAcked = 2500;
-  auto packet3 = makeTestingWritePacket(pn, 200, 2700, false);
-  packet3.lastAckedPacketInfo.emplace(packet2.time, ackTime2, 2500, 2000);
-  auto ackTime3 = ackTime + 250us;
-  CongestionController::AckEvent ackEvent3;
-  ackEvent3.ackTime = ackTime3;
-  packet3.time = ackTime + 210us;
-  ackEvent3.ackedPackets.push_back(packet3);
-  sampler.onPacketAcked(ackEvent3, kBandwidthWindowLength / 2 + 1);
+  ackPackets(
+      sampler,
+      {sendPacket(2, 1000, sendTime + 450us, false)},
+      sendTime + 1000us,
+      kBandwidthWindowLength / 2 + 1);
   EXPECT_EQ(firstBandwidthSample, sampler.getBandwidth());
 
-  pn++;
-  conn_.lossState.totalBytesAcked = 2700;
-  auto packet4 = makeTestingWritePacket(pn, 100, 2800, false);
-  packet4.lastAckedPacketInfo.emplace(packet3.time, ackTime3, 2700, 2500);
-  auto ackTime4 = ackTime + 350us;
-  CongestionController::AckEvent ackEvent4;
-  ackEvent4.ackTime = ackTime4;
-  packet4.time = ackTime + 310us;
-  ackEvent4.ackedPackets.push_back(packet4);
-  sampler.onPacketAcked(ackEvent4, kBandwidthWindowLength + 1);
-  // The bandwidth we got from packet1 has expired. Packet2 should have
+  ackPackets(
+      sampler,
+      {sendPacket(3, 1000, sendTime + 1050us, false)},
+      sendTime + 2000us,
+      kBandwidthWindowLength + 1);
+  // The bandwidth we got from packet0 has expired. Packet1 should have
   // generated the current max:
-  EXPECT_EQ(secondBandwidthSample, sampler.getBandwidth());
+  EXPECT_EQ(secondBandwidthSample.bandwidth, sampler.getBandwidth());
 }
 
 TEST_F(BbrBandwidthSamplerTest, AppLimited) {
@@ -154,37 +232,18 @@ TEST_F(BbrBandwidthSamplerTest, AppLimited) {
 }
 
 TEST_F(BbrBandwidthSamplerTest, AppLimitedOutstandingPacket) {
-  QuicConnectionStateBase conn(QuicNodeType::Client);
-  BbrBandwidthSampler sampler(conn);
-  CongestionController::AckEvent ackEvent;
-  ackEvent.ackedBytes = 1000;
-  auto ackTime = Clock::now();
-  ackEvent.ackTime = ackTime;
-  auto lastAckedPacketSentTime = ackTime - 200us;
-  auto lastAckedPacketAckTime = ackTime - 100us;
-  PacketNum pn = 0;
-  auto packet = makeTestingWritePacket(pn, 1000, 1000 + 1000 * pn, false);
-  packet.isAppLimited = true;
-  packet.lastAckedPacketInfo.emplace(
-      lastAckedPacketSentTime, lastAckedPacketAckTime, 0, 0);
-  packet.time = ackTime - 50us;
-  ackEvent.ackedPackets.push_back(packet);
+  BbrBandwidthSampler sampler(conn_);
+  auto sendTime = Clock::now();
   // AppLimited packet, but sample is larger than current best
-  sampler.onPacketAcked(ackEvent, 0);
+  ackPackets(sampler, {sendPacket(0, 1000, sendTime, true)}, sendTime + 100us);
   EXPECT_LT(0, sampler.getBandwidth().bytes);
   auto bandwidth = sampler.getBandwidth();
 
-  pn++;
-  auto packet1 = makeTestingWritePacket(pn, 1000, 1000 + 1000 * pn, false);
-  packet1.isAppLimited = true;
-  packet1.lastAckedPacketInfo.emplace(packet.time, ackTime, 1000, 0);
-  packet1.time = ackTime + 500us;
-  CongestionController::AckEvent ackEvent1;
-  ackEvent1.ackedBytes = 1000;
-  ackEvent1.ackTime = ackTime + 2000us;
-  ackEvent1.ackedPackets.push_back(packet1);
   // AppLImited packet, bandwidth sampler is less than current best
-  sampler.onPacketAcked(ackEvent1, 0);
+  ackPackets(
+      sampler,
+      {sendPacket(1, 1000, sendTime + 150us, true)},
+      sendTime + 2000us);
   EXPECT_EQ(bandwidth, sampler.getBandwidth());
 }
 } // namespace test
@@ -746,5 +746,33 @@ TEST_F(BbrTest, AppIdle) {
   EXPECT_TRUE(event->idle);
 }
 
+TEST_F(BbrTest, GainParams) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  auto qLogger = std::make_shared<FileQLogger>();
+  conn.qLogger = qLogger;
+  conn.transportSettings.congestionControlParams.bbr.startupGain = 2.0f;
+  conn.transportSettings.congestionControlParams.bbr.probeBwCwndGain = 2.5f;
+  BbrCongestionController::BbrConfig config;
+  BbrCongestionController bbr(conn, config);
+
+  // Out of range, Startup needs to grow.
+  conn.transportSettings.congestionControlParams.bbr.startupGain = 0.5f;
+  BbrCongestionController defaultGainBbr(conn, config);
+
+  std::vector<int> indices =
+      getQLogEventIndices(QLogEventType::CongestionMetricUpdate, qLogger);
+  ASSERT_EQ(2, indices.size());
+  auto tmp = std::move(qLogger->logs[indices[0]]);
+  auto event = dynamic_cast<QLogCongestionMetricUpdateEvent*>(tmp.get());
+  EXPECT_EQ(event->congestionEvent, kCongestionControlParams.str());
+  EXPECT_EQ(event->state, "startupGain=2 probeBwCwndGain=2.5");
+  auto tmp2 = std::move(qLogger->logs[indices[1]]);
+  auto event2 = dynamic_cast<QLogCongestionMetricUpdateEvent*>(tmp2.get());
+  EXPECT_EQ(
+      event2->state,
+      folly::to<std::string>(
+          "startupGain=", kStartupGain, " probeBwCwndGain=2.5"));
+}
+
 } // namespace test
 } // namespace quic
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CarefulResume.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/NewReno.h>
+#include <quic/congestion_control/QuicCubic.h>
+
+using namespace quic;
+using namespace quic::test;
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+class CarefulResumeTest : public Test {};
+
+TEST_F(CarefulResumeTest, NoJumpBelowCwnd) {
+  CarefulResume resume;
+  EXPECT_FALSE(resume.start(20000, 10000, Clock::now()).hasValue());
+  EXPECT_EQ(CarefulResume::Phase::Normal, resume.phase());
+}
+
+TEST_F(CarefulResumeTest, Validated) {
+  CarefulResume resume;
+  auto now = Clock::now();
+  auto jump = resume.start(100000, 10000, now);
+  ASSERT_TRUE(jump.hasValue());
+  EXPECT_EQ(50000, *jump);
+  EXPECT_EQ(CarefulResume::Phase::Unvalidated, resume.phase());
+
+  auto packet1 = makeTestingWritePacket(0, 1000, 1000, false, now + 1ms);
+  resume.onPacketSent(packet1);
+  auto packet2 = makeTestingWritePacket(1, 1000, 2000, false, now + 2ms);
+  resume.onPacketSent(packet2);
+
+  resume.onPacketAcked(makeAck(0, 1000, now + 10ms, now + 1ms));
+  EXPECT_EQ(CarefulResume::Phase::Validating, resume.phase());
+  // Packets sent while validating don't extend the validation.
+  auto packet3 = makeTestingWritePacket(2, 1000, 3000, false, now + 11ms);
+  resume.onPacketSent(packet3);
+  resume.onPacketAcked(makeAck(1, 1000, now + 12ms, now + 2ms));
+  EXPECT_EQ(CarefulResume::Phase::Normal, resume.phase());
+
+  // No retreat once validated.
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet3);
+  EXPECT_FALSE(resume.onPacketLoss(loss).hasValue());
+}
+
+TEST_F(CarefulResumeTest, SafeRetreat) {
+  CarefulResume resume;
+  auto now = Clock::now();
+  ASSERT_TRUE(resume.start(100000, 10000, now).hasValue());
+  auto packet1 = makeTestingWritePacket(0, 1000, 1000, false, now + 1ms);
+  resume.onPacketSent(packet1);
+  auto packet2 = makeTestingWritePacket(1, 1000, 2000, false, now + 2ms);
+  resume.onPacketSent(packet2);
+  auto packet3 = makeTestingWritePacket(2, 1000, 3000, false, now + 3ms);
+  resume.onPacketSent(packet3);
+  resume.onPacketAcked(makeAck(0, 1000, now + 10ms, now + 1ms));
+  resume.onPacketAcked(makeAck(1, 1000, now + 11ms, now + 2ms));
+
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet3);
+  auto retreat = resume.onPacketLoss(loss);
+  ASSERT_TRUE(retreat.hasValue());
+  EXPECT_EQ(1000, *retreat);
+  EXPECT_EQ(CarefulResume::Phase::Normal, resume.phase());
+}
+
+TEST_F(CarefulResumeTest, LossBeforeJump) {
+  CarefulResume resume;
+  auto now = Clock::now();
+  auto packet = makeTestingWritePacket(0, 1000, 1000, false, now - 1ms);
+  ASSERT_TRUE(resume.start(100000, 10000, now).hasValue());
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet);
+  EXPECT_FALSE(resume.onPacketLoss(loss).hasValue());
+  EXPECT_EQ(CarefulResume::Phase::Unvalidated, resume.phase());
+}
+
+TEST_F(CarefulResumeTest, NewRenoJumpAndRetreat) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  NewReno reno(conn);
+  auto initCwnd = reno.getCongestionWindow();
+  auto now = Clock::now();
+  EXPECT_TRUE(reno.carefulResume(initCwnd * 10, now));
+  EXPECT_EQ(initCwnd * 5, reno.getCongestionWindow());
+
+  auto packet1 = makeTestingWritePacket(0, 1000, 1000, false, now + 1ms);
+  reno.onPacketSent(packet1);
+  auto packet2 = makeTestingWritePacket(1, 1000, 2000, false, now + 2ms);
+  reno.onPacketSent(packet2);
+  reno.onPacketAckOrLoss(makeAck(0, 1000, now + 10ms, now + 1ms), folly::none);
+
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet2);
+  reno.onPacketAckOrLoss(folly::none, loss);
+  EXPECT_EQ(
+      conn.transportSettings.minCwndInMss * conn.udpSendPacketLen,
+      reno.getCongestionWindow());
+  // Only one resume per connection.
+  EXPECT_FALSE(reno.carefulResume(initCwnd * 10, now + 20ms));
+}
+
+TEST_F(CarefulResumeTest, CubicJumpOnlyInSlowStart) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  Cubic cubic(conn);
+  auto initCwnd = cubic.getCongestionWindow();
+  auto now = Clock::now();
+  EXPECT_FALSE(cubic.carefulResume(initCwnd, now));
+  EXPECT_EQ(initCwnd, cubic.getCongestionWindow());
+  EXPECT_TRUE(cubic.carefulResume(initCwnd * 4, now));
+  EXPECT_EQ(initCwnd * 2, cubic.getCongestionWindow());
+
+  auto packet = makeTestingWritePacket(0, 1000, 1000, false, now + 1ms);
+  cubic.onPacketSent(packet);
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet);
+  cubic.onPacketAckOrLoss(folly::none, loss);
+  EXPECT_EQ(CubicStates::FastRecovery, cubic.state());
+  EXPECT_FALSE(cubic.carefulResume(initCwnd * 4, now + 10ms));
+}
+
+} // namespace test
+} // namespace quic
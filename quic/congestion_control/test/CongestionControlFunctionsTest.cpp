@@ -63,6 +63,20 @@ TEST_F(CongestionControlFunctionsTest, RttSmallerThanInterval) {
       conn.transportSettings.writeConnectionDataPacketsLimit, result.second);
 }
 
+TEST_F(CongestionControlFunctionsTest, FixedPointCbrt) {
+  EXPECT_EQ(0, fixedPointCbrt(0));
+  for (uint64_t x = 1; x < 100000; ++x) {
+    auto root = fixedPointCbrt(x);
+    EXPECT_LE(root * root * root, x);
+    EXPECT_GT((root + 1) * (root + 1) * (root + 1), x);
+  }
+  for (uint64_t root = 47; root < 2642245; root += 9973) {
+    EXPECT_EQ(root, fixedPointCbrt(root * root * root));
+    EXPECT_EQ(root - 1, fixedPointCbrt(root * root * root - 1));
+  }
+  // 2642245 ^ 3 is the largest cube below 2 ^ 64.
+  EXPECT_EQ(2642245, fixedPointCbrt(std::numeric_limits<uint64_t>::max()));
+}
 
 } // namespace test
 } // namespace quic
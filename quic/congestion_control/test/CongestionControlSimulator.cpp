@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/test/CongestionControlSimulator.h>
+
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/congestion_control/TokenBucketPacer.h>
+#include <quic/loss/QuicLossFunctions.h>
+#include <quic/state/AckHandlers.h>
+#include <quic/state/QuicStateFunctions.h>
+
+namespace quic {
+namespace test {
+
+namespace {
+// Ack blocks the receiver remembers, and puts in each ack.
+constexpr size_t kMaxSimulatedAckBlocks = 32;
+// Bound on the PTO backoff.
+constexpr uint32_t kMaxSimulatedPtoBackoff = 7;
+} // namespace
+
+CongestionControlSimulator::CongestionControlSimulator(
+    SimulatedLink link,
+    CongestionControlType type,
+    TransportSettings transportSettings,
+    uint64_t seed)
+    : link_(link), conn_(QuicNodeType::Client), rng_(seed) {
+  CHECK_GT(link_.bandwidthBytesPerSec, 0);
+  for (const auto& change : link_.changes) {
+    CHECK_GT(change.bandwidthBytesPerSec, 0);
+  }
+  conn_.transportSettings = std::move(transportSettings);
+  conn_.transportSettings.defaultCongestionController = type;
+  DefaultCongestionControllerFactory factory;
+  conn_.congestionController = factory.makeCongestionController(conn_, type);
+  CHECK(conn_.congestionController);
+  if (conn_.transportSettings.pacingEnabled &&
+      conn_.transportSettings.tokenBucketPacerEnabled) {
+    conn_.pacer = std::make_unique<TokenBucketPacer>(
+        conn_, conn_.transportSettings.pacingTimerTickInterval);
+  }
+  result_.type = type;
+}
+
+SimulationResult CongestionControlSimulator::run(
+    std::chrono::microseconds duration) {
+  now_ = Clock::now();
+  lastProgressTime_ = now_;
+  linkBusyUntil_ = now_;
+  lastArrivalTime_ = now_;
+  start_ = now_;
+  auto end = now_ + duration;
+  applyLinkChanges();
+  scheduleWrite(now_);
+  while (!events_.empty() && events_.top().time <= end) {
+    auto event = events_.top();
+    events_.pop();
+    now_ = event.time;
+    applyLinkChanges();
+    switch (event.type) {
+      case EventType::Write:
+        onWrite();
+        break;
+      case EventType::Receive:
+        onReceive(event);
+        break;
+      case EventType::Ack:
+        onAck(event);
+        break;
+      case EventType::LossTimer:
+        if (lossTimerTime_ && *lossTimerTime_ == now_) {
+          lossTimerTime_.clear();
+          onLossTimer();
+        }
+        break;
+    }
+    maybeScheduleTimers();
+  }
+  auto elapsedUs =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start_);
+  if (elapsedUs.count() > 0) {
+    result_.throughputBytesPerSec =
+        conn_.lossState.totalBytesAcked * 1000000 / elapsedUs.count();
+  }
+  if (deliveredPackets_ > 0) {
+    result_.avgQueueingDelay = totalQueueingDelay_ / deliveredPackets_;
+  }
+  if (result_.packetsSent > 0) {
+    result_.retransmissionRate =
+        static_cast<double>(result_.packetsLost) / result_.packetsSent;
+  }
+  return result_;
+}
+
+void CongestionControlSimulator::applyLinkChanges() {
+  while (nextLinkChange_ < link_.changes.size() &&
+         start_ + link_.changes[nextLinkChange_].time <= now_) {
+    const auto& change = link_.changes[nextLinkChange_++];
+    link_.bandwidthBytesPerSec = change.bandwidthBytesPerSec;
+    link_.oneWayDelay = change.oneWayDelay;
+    link_.lossRate = change.lossRate;
+  }
+}
+
+void CongestionControlSimulator::schedule(Event event) {
+  event.seq = seq_++;
+  events_.push(std::move(event));
+}
+
+void CongestionControlSimulator::scheduleWrite(TimePoint time) {
+  if (nextWriteTime_) {
+    return;
+  }
+  nextWriteTime_ = time;
+  Event event{};
+  event.time = time;
+  event.type = EventType::Write;
+  schedule(std::move(event));
+}
+
+void CongestionControlSimulator::onWrite() {
+  nextWriteTime_.clear();
+  auto& congestionController = *conn_.congestionController;
+  bool paced = conn_.transportSettings.pacingEnabled &&
+      congestionController.canBePaced() &&
+      congestionController.getPacingInterval() !=
+          std::chrono::microseconds::zero();
+  uint64_t burst = std::numeric_limits<uint64_t>::max();
+  if (paced) {
+    burst = conn_.pacer ? conn_.pacer->updateAndGetWriteBatchSize(now_)
+                        : congestionController.getPacingRate(now_);
+  }
+  uint64_t sent = 0;
+  while (sent < burst &&
+         congestionController.getWritableBytes() >= conn_.udpSendPacketLen) {
+    sendPacket();
+    sent++;
+  }
+  if (paced && sent == burst) {
+    // Cwnd allowing, the next burst goes out once the pacing interval is
+    // over, the same way the write looper's pacing timer does it.
+    congestionController.markPacerTimeoutScheduled(now_);
+    auto interval = conn_.pacer ? conn_.pacer->getTimeUntilNextWrite(now_)
+                                : congestionController.getPacingInterval();
+    scheduleWrite(now_ + interval);
+  }
+}
+
+void CongestionControlSimulator::sendPacket() {
+  auto packetNum = conn_.ackStates.appDataAckState.nextPacketNum;
+  auto size = conn_.udpSendPacketLen;
+  RegularQuicWritePacket packet(ShortHeader(
+      ProtectionType::KeyPhaseZero, getTestConnectionId(), packetNum));
+  packet.frames.push_back(
+      WriteStreamFrame(0, conn_.lossState.totalBytesSent, size, false));
+  OutstandingPacket pkt(
+      std::move(packet),
+      now_,
+      size,
+      false,
+      false,
+      conn_.lossState.totalBytesSent + size);
+  pkt.isAppLimited = false;
+  increaseNextPacketNum(conn_, PacketNumberSpace::AppData);
+  conn_.lossState.largestSent =
+      std::max(conn_.lossState.largestSent, packetNum);
+  conn_.lossState.totalBytesSent += size;
+  if (conn_.pacer) {
+    conn_.pacer->onPacketSent();
+  }
+  conn_.congestionController->onPacketSent(pkt);
+  conn_.outstandingPackets.push_back(std::move(pkt));
+  if (conn_.outstandingPackets.size() == 1) {
+    // The PTO counts from the first packet in flight.
+    lastProgressTime_ = now_;
+  }
+  result_.packetsSent++;
+
+  // Into the bottleneck.
+  if (link_.lossRate > 0 && lossDistribution_(rng_) < link_.lossRate) {
+    result_.packetsDropped++;
+    return;
+  }
+  auto transmitTime = std::chrono::nanoseconds(
+      size * 1000 * 1000 * 1000 / link_.bandwidthBytesPerSec);
+  auto queueingDelay = linkBusyUntil_ > now_
+      ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+            linkBusyUntil_ - now_)
+      : std::chrono::nanoseconds::zero();
+  uint64_t queuedBytes = static_cast<uint64_t>(queueingDelay.count()) *
+      link_.bandwidthBytesPerSec / (1000 * 1000 * 1000);
+  if (queuedBytes + size > link_.bufferBytes) {
+    result_.packetsDropped++;
+    return;
+  }
+  linkBusyUntil_ = now_ + queueingDelay + transmitTime;
+  auto arrivalTime = linkBusyUntil_ + link_.oneWayDelay;
+  if (link_.jitter > 0us) {
+    arrivalTime += std::chrono::microseconds(static_cast<uint64_t>(
+        lossDistribution_(rng_) * link_.jitter.count()));
+  }
+  arrivalTime = std::max(arrivalTime, lastArrivalTime_);
+  lastArrivalTime_ = arrivalTime;
+  Event event{};
+  event.time = arrivalTime;
+  event.type = EventType::Receive;
+  event.packetNum = packetNum;
+  event.queueingDelay =
+      std::chrono::duration_cast<std::chrono::microseconds>(queueingDelay);
+  schedule(std::move(event));
+}
+
+void CongestionControlSimulator::onReceive(const Event& event) {
+  received_.insert(event.packetNum);
+  while (received_.size() > kMaxSimulatedAckBlocks) {
+    received_.pop_front();
+  }
+  totalQueueingDelay_ += event.queueingDelay;
+  result_.maxQueueingDelay =
+      std::max(result_.maxQueueingDelay, event.queueingDelay);
+  deliveredPackets_++;
+
+  Event ack{};
+  ack.time = now_ + link_.oneWayDelay;
+  ack.type = EventType::Ack;
+  ack.ackFrame.largestAcked = received_.back().end;
+  ack.ackFrame.ackDelay = 0us;
+  for (auto it = received_.crbegin(); it != received_.crend(); ++it) {
+    ack.ackFrame.ackBlocks.emplace_back(it->start, it->end);
+  }
+  schedule(std::move(ack));
+}
+
+void CongestionControlSimulator::onAck(const Event& event) {
+  auto bytesAcked = conn_.lossState.totalBytesAcked;
+  processAckFrame(
+      conn_,
+      PacketNumberSpace::AppData,
+      event.ackFrame,
+      [](const auto&, const auto&, const auto&) {},
+      [&](auto&, auto&, bool, PacketNum) { result_.packetsLost++; },
+      now_);
+  if (conn_.lossState.totalBytesAcked != bytesAcked) {
+    lastProgressTime_ = now_;
+  }
+  scheduleWrite(now_);
+}
+
+void CongestionControlSimulator::onLossTimer() {
+  auto lossTime = getLossTime(conn_, PacketNumberSpace::AppData);
+  if (lossTime && *lossTime <= now_) {
+    auto lossEvent = detectLossPackets(
+        conn_,
+        conn_.ackStates.appDataAckState.largestAckedByPeer,
+        [&](auto&, auto&, bool, PacketNum) { result_.packetsLost++; },
+        now_,
+        PacketNumberSpace::AppData);
+    if (lossEvent) {
+      lossEvent->persistentCongestion =
+          isPersistentCongestion(conn_, *lossEvent);
+      conn_.congestionController->onPacketAckOrLoss(
+          folly::none, std::move(lossEvent));
+    }
+    scheduleWrite(now_);
+    return;
+  }
+  onPTO();
+}
+
+void CongestionControlSimulator::onPTO() {
+  if (conn_.outstandingPackets.empty()) {
+    return;
+  }
+  CongestionController::LossEvent lossEvent(now_);
+  for (auto& pkt : conn_.outstandingPackets) {
+    lossEvent.addLostPacket(pkt);
+    result_.packetsLost++;
+  }
+  conn_.outstandingPackets.clear();
+  conn_.lossState.rtxCount += lossEvent.lostPackets;
+  conn_.lossState.ptoCount++;
+  getLossTime(conn_, PacketNumberSpace::AppData).clear();
+  lossEvent.persistentCongestion = isPersistentCongestion(conn_, lossEvent);
+  conn_.congestionController->onPacketAckOrLoss(
+      folly::none, std::move(lossEvent));
+  lastProgressTime_ = now_;
+  scheduleWrite(now_);
+}
+
+void CongestionControlSimulator::maybeScheduleTimers() {
+  if (conn_.outstandingPackets.empty()) {
+    lossTimerTime_.clear();
+    return;
+  }
+  auto pto = conn_.lossState.srtt == 0us ? 2 * kDefaultInitialRtt
+                                         : calculatePTO(conn_);
+  pto *= 1 << std::min(conn_.lossState.ptoCount, kMaxSimulatedPtoBackoff);
+  TimePoint timerTime = std::max(lastProgressTime_ + pto, now_);
+  auto lossTime = getLossTime(conn_, PacketNumberSpace::AppData);
+  if (lossTime) {
+    timerTime = std::min(timerTime, std::max(*lossTime, now_));
+  }
+  if (lossTimerTime_ == timerTime) {
+    return;
+  }
+  lossTimerTime_ = timerTime;
+  Event event{};
+  event.time = timerTime;
+  event.type = EventType::LossTimer;
+  schedule(std::move(event));
+}
+
+} // namespace test
+} // namespace quic
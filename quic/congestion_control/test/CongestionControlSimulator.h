@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+#include <quic/common/IntervalSet.h>
+#include <quic/state/StateData.h>
+
+#include <queue>
+#include <random>
+
+namespace quic {
+namespace test {
+
+/**
+ * Bottleneck link of the simulation: a drop tail queue of bufferBytes drained
+ * at bandwidth, followed by a propagation delay of oneWayDelay each way.
+ * Packets entering the link are dropped at random with lossRate, and their
+ * forward delay gets up to jitter more. Jitter never reorders packets.
+ *
+ * The bandwidth, delay and loss rate can change over the run, see changes.
+ * Packets already in the queue keep the departure time they got.
+ */
+struct SimulatedLink {
+  struct Change {
+    // From the start of the run.
+    std::chrono::microseconds time{0us};
+    uint64_t bandwidthBytesPerSec{0};
+    std::chrono::microseconds oneWayDelay{0us};
+    double lossRate{0};
+  };
+
+  uint64_t bandwidthBytesPerSec{10 * 1000 * 1000 / 8};
+  std::chrono::microseconds oneWayDelay{20ms};
+  uint64_t bufferBytes{64 * 1000};
+  double lossRate{0};
+  std::chrono::microseconds jitter{0us};
+  // Applied in order, each one once the run gets to its time.
+  std::vector<Change> changes;
+};
+
+struct SimulationResult {
+  CongestionControlType type;
+  // Bytes acked over the whole run, per second.
+  uint64_t throughputBytesPerSec{0};
+  // Time the delivered packets spent in the bottleneck queue.
+  std::chrono::microseconds avgQueueingDelay{0us};
+  std::chrono::microseconds maxQueueingDelay{0us};
+  uint64_t packetsSent{0};
+  // Packets the link dropped, and packets the sender declared lost.
+  uint64_t packetsDropped{0};
+  uint64_t packetsLost{0};
+  // Packets declared lost over packets sent.
+  double retransmissionRate{0};
+};
+
+/**
+ * Deterministic, in-process simulation of a bulk transfer over a
+ * SimulatedLink, running on a virtual clock.
+ *
+ * The sender is a real QuicConnectionStateBase with a real congestion
+ * controller. Sent packets are tracked as outstanding packets the same way
+ * the transport does it, and acks go through processAckFrame, so the rtt
+ * estimation, the loss detection and the congestion controller callbacks are
+ * the production ones. The receiver acks every packet right away. The loss
+ * timer runs detectLossPackets. When the sender has nothing acked for a PTO,
+ * all the outstanding packets are declared lost, the simulation doesn't send
+ * probes.
+ *
+ * The same seed always gives the same result.
+ */
+class CongestionControlSimulator {
+ public:
+  CongestionControlSimulator(
+      SimulatedLink link,
+      CongestionControlType type,
+      TransportSettings transportSettings = TransportSettings(),
+      uint64_t seed = 0);
+
+  SimulationResult run(std::chrono::microseconds duration);
+
+  // for unit test
+  const QuicConnectionStateBase& getConn() const {
+    return conn_;
+  }
+
+ private:
+  enum class EventType {
+    // The sender may write.
+    Write,
+    // A packet reaches the receiver.
+    Receive,
+    // An ack reaches the sender.
+    Ack,
+    LossTimer,
+  };
+
+  struct Event {
+    TimePoint time;
+    // Breaks the ties between events at the same time, in insertion order.
+    uint64_t seq;
+    EventType type;
+    PacketNum packetNum;
+    // For Receive, the time the packet waited in the queue.
+    std::chrono::microseconds queueingDelay;
+    // For Ack.
+    ReadAckFrame ackFrame;
+
+    bool operator>(const Event& other) const {
+      return time == other.time ? seq > other.seq : time > other.time;
+    }
+  };
+
+  void schedule(Event event);
+  void onWrite();
+  void sendPacket();
+  void onReceive(const Event& event);
+  void onAck(const Event& event);
+  void onLossTimer();
+  void onPTO();
+  void scheduleWrite(TimePoint time);
+  void maybeScheduleTimers();
+  void applyLinkChanges();
+
+  SimulatedLink link_;
+  QuicConnectionStateBase conn_;
+  std::mt19937_64 rng_;
+  std::uniform_real_distribution<double> lossDistribution_{0, 1};
+
+  TimePoint now_;
+  TimePoint start_;
+  // The first change of link_ not applied yet.
+  size_t nextLinkChange_{0};
+  uint64_t seq_{0};
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+
+  // Set while a Write event is scheduled.
+  folly::Optional<TimePoint> nextWriteTime_;
+  // Time of the LossTimer event that is current, the others are stale.
+  folly::Optional<TimePoint> lossTimerTime_;
+  // Last time something got acked, or the first packet went in flight. The
+  // PTO counts from there.
+  TimePoint lastProgressTime_;
+
+  // Time at which the link is done sending the packets queued so far.
+  TimePoint linkBusyUntil_;
+  // The latest arrival time at the receiver, so that jitter doesn't reorder.
+  TimePoint lastArrivalTime_;
+
+  // Packets received so far, for the ack blocks.
+  IntervalSet<PacketNum> received_;
+  std::chrono::microseconds totalQueueingDelay_{0us};
+  uint64_t deliveredPackets_{0};
+
+  SimulationResult result_;
+};
+
+} // namespace test
+} // namespace quic
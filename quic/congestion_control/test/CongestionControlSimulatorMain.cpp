@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/test/CongestionControlSimulator.h>
+#include <quic/congestion_control/test/QLogPathModel.h>
+
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/init/Init.h>
+#include <folly/lang/Assume.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+#include <iostream>
+
+DEFINE_uint64(bandwidth_kbps, 10000, "Bottleneck bandwidth in kbit/s");
+DEFINE_uint64(delay_ms, 20, "One way propagation delay in ms");
+DEFINE_uint64(buffer_kb, 64, "Bottleneck buffer in KB");
+DEFINE_double(loss, 0, "Random loss rate of the bottleneck, from 0 to 1");
+DEFINE_uint64(jitter_ms, 0, "Max jitter added to the forward delay in ms");
+DEFINE_uint64(duration_s, 30, "Simulated time in seconds");
+DEFINE_uint64(seed, 0, "Seed of the random loss and jitter");
+DEFINE_bool(pacing, false, "Whether the controllers that can be paced are");
+DEFINE_string(
+    qlog,
+    "",
+    "qlog of a sender to infer the path from, instead of the link flags, "
+    "see inferPathFromQLog. The run lasts as long as the trace");
+DEFINE_uint64(qlog_interval_ms, 1000, "Path of the qlog inferred per interval");
+
+using namespace quic;
+using namespace quic::test;
+
+/**
+ * Runs a bulk transfer over the same simulated bottleneck with every
+ * congestion controller, and prints how each one did. Same flags, same
+ * numbers: the simulation runs on a virtual clock.
+ *
+ * With --qlog, the bottleneck replays the path of a connection captured in
+ * production instead, its bandwidth, delay and loss changing over time the
+ * way they did for it.
+ */
+
+namespace {
+
+const char* typeName(CongestionControlType type) {
+  switch (type) {
+    case CongestionControlType::Cubic:
+      return "Cubic";
+    case CongestionControlType::NewReno:
+      return "NewReno";
+    case CongestionControlType::Copa:
+      return "Copa";
+    case CongestionControlType::BBR:
+      return "BBR";
+    case CongestionControlType::BBR2:
+      return "BBR2";
+    case CongestionControlType::None:
+      return "None";
+  }
+  folly::assume_unreachable();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+  folly::Init init(&argc, &argv);
+
+  SimulatedLink link;
+  link.bandwidthBytesPerSec = FLAGS_bandwidth_kbps * 1000 / 8;
+  link.oneWayDelay = std::chrono::milliseconds(FLAGS_delay_ms);
+  link.bufferBytes = FLAGS_buffer_kb * 1000;
+  link.lossRate = FLAGS_loss;
+  link.jitter = std::chrono::milliseconds(FLAGS_jitter_ms);
+  std::chrono::microseconds duration = std::chrono::seconds(FLAGS_duration_s);
+  // What the utilization is of.
+  uint64_t bandwidth = link.bandwidthBytesPerSec;
+  if (!FLAGS_qlog.empty()) {
+    std::string data;
+    if (!folly::readFile(FLAGS_qlog.c_str(), data)) {
+      LOG(ERROR) << "Can't read --qlog=" << FLAGS_qlog;
+      return 1;
+    }
+    auto events = parseQLogEvents(data);
+    if (!events) {
+      LOG(ERROR) << "Can't parse the qlog events of " << FLAGS_qlog;
+      return 1;
+    }
+    auto path = inferPathFromQLog(
+        *events, std::chrono::milliseconds(FLAGS_qlog_interval_ms));
+    if (!path) {
+      LOG(ERROR) << "No rtt or delivery rate sample in " << FLAGS_qlog;
+      return 1;
+    }
+    link = std::move(path->link);
+    duration = path->duration;
+    bandwidth = path->avgBandwidthBytesPerSec;
+    std::cout << folly::sformat(
+                     "path: {:.1f}s, {} kbps avg, {} changes, buffer {} KB, "
+                     "{} random and {} queue losses",
+                     duration.count() / 1000000.0,
+                     bandwidth * 8 / 1000,
+                     link.changes.size(),
+                     link.bufferBytes / 1000,
+                     path->randomLosses,
+                     path->congestionLosses)
+              << std::endl;
+    if (duration.count() <= 0) {
+      LOG(ERROR) << "Trace too short to replay: " << FLAGS_qlog;
+      return 1;
+    }
+  }
+  TransportSettings transportSettings;
+  transportSettings.pacingEnabled = FLAGS_pacing;
+
+  std::cout << folly::sformat(
+                   "{:<8} {:>12} {:>12} {:>12} {:>10} {:>10}",
+                   "cc",
+                   "kbps",
+                   "util %",
+                   "avg queue ms",
+                   "max q ms",
+                   "rtx %")
+            << std::endl;
+  for (auto type : {CongestionControlType::Cubic,
+                    CongestionControlType::NewReno,
+                    CongestionControlType::Copa,
+                    CongestionControlType::BBR,
+                    CongestionControlType::BBR2}) {
+    CongestionControlSimulator simulator(
+        link, type, transportSettings, FLAGS_seed);
+    auto result = simulator.run(duration);
+    std::cout << folly::sformat(
+                     "{:<8} {:>12} {:>12.1f} {:>12.2f} {:>10.2f} {:>10.3f}",
+                     typeName(type),
+                     result.throughputBytesPerSec * 8 / 1000,
+                     100.0 * result.throughputBytesPerSec / bandwidth,
+                     result.avgQueueingDelay.count() / 1000.0,
+                     result.maxQueueingDelay.count() / 1000.0,
+                     100.0 * result.retransmissionRate)
+              << std::endl;
+  }
+  return 0;
+}
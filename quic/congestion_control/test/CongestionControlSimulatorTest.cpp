@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/test/CongestionControlSimulator.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+class CongestionControlSimulatorTest
+    : public TestWithParam<CongestionControlType> {};
+
+TEST_P(CongestionControlSimulatorTest, FillsCleanLink) {
+  SimulatedLink link;
+  // One BDP of buffer.
+  link.bufferBytes = link.bandwidthBytesPerSec * 2 * link.oneWayDelay.count() /
+      1000000;
+  CongestionControlSimulator simulator(link, GetParam());
+  auto result = simulator.run(10s);
+  EXPECT_GT(result.throughputBytesPerSec, link.bandwidthBytesPerSec / 2);
+  EXPECT_LE(result.throughputBytesPerSec, link.bandwidthBytesPerSec);
+  EXPECT_LE(
+      result.maxQueueingDelay,
+      std::chrono::microseconds(
+          link.bufferBytes * 1000000 / link.bandwidthBytesPerSec));
+  EXPECT_LE(result.packetsLost, result.packetsSent);
+}
+
+TEST_P(CongestionControlSimulatorTest, Deterministic) {
+  SimulatedLink link;
+  link.lossRate = 0.01;
+  link.jitter = 5ms;
+  CongestionControlSimulator simulator1(
+      link, GetParam(), TransportSettings(), 42);
+  auto result1 = simulator1.run(5s);
+  CongestionControlSimulator simulator2(
+      link, GetParam(), TransportSettings(), 42);
+  auto result2 = simulator2.run(5s);
+  EXPECT_EQ(result1.packetsSent, result2.packetsSent);
+  EXPECT_EQ(result1.packetsDropped, result2.packetsDropped);
+  EXPECT_EQ(result1.packetsLost, result2.packetsLost);
+  EXPECT_EQ(result1.throughputBytesPerSec, result2.throughputBytesPerSec);
+  EXPECT_EQ(result1.avgQueueingDelay, result2.avgQueueingDelay);
+  EXPECT_GT(result1.packetsDropped, 0);
+  EXPECT_GT(result1.retransmissionRate, 0);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    CongestionControlSimulatorTests,
+    CongestionControlSimulatorTest,
+    Values(
+        CongestionControlType::Cubic,
+        CongestionControlType::NewReno,
+        CongestionControlType::Copa,
+        CongestionControlType::BBR,
+        CongestionControlType::BBR2));
+
+TEST(CongestionControlSimulatorLinkTest, NoLossWithDeepBuffer) {
+  SimulatedLink link;
+  // Deeper than the max cwnd.
+  link.bufferBytes = 10 * 1000 * 1000;
+  CongestionControlSimulator simulator(link, CongestionControlType::NewReno);
+  auto result = simulator.run(5s);
+  EXPECT_EQ(0, result.packetsDropped);
+  EXPECT_EQ(0, result.packetsLost);
+  EXPECT_EQ(0, result.retransmissionRate);
+  // The queue builds up instead.
+  EXPECT_GT(result.avgQueueingDelay, 0us);
+}
+
+TEST(CongestionControlSimulatorLinkTest, RandomLoss) {
+  SimulatedLink link;
+  link.bufferBytes = 10 * 1000 * 1000;
+  link.lossRate = 0.05;
+  CongestionControlSimulator simulator(link, CongestionControlType::Cubic);
+  auto result = simulator.run(5s);
+  EXPECT_GT(result.packetsDropped, 0);
+  EXPECT_GT(result.packetsLost, 0);
+  EXPECT_NEAR(
+      0.05,
+      static_cast<double>(result.packetsDropped) / result.packetsSent,
+      0.02);
+}
+
+TEST(CongestionControlSimulatorLinkTest, LinkChanges) {
+  SimulatedLink link;
+  link.bufferBytes = 10 * 1000 * 1000;
+  // Turns lossy halfway through.
+  link.changes.push_back(SimulatedLink::Change{
+      2500ms, link.bandwidthBytesPerSec, link.oneWayDelay, 0.05});
+  CongestionControlSimulator simulator(link, CongestionControlType::NewReno);
+  auto result = simulator.run(5s);
+  EXPECT_GT(result.packetsDropped, 0);
+  EXPECT_LT(
+      static_cast<double>(result.packetsDropped) / result.packetsSent, 0.05);
+}
+
+} // namespace test
+} // namespace quic
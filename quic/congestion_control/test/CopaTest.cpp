@@ -466,5 +466,111 @@ TEST_F(CopaTest, NoLargestAckedPacketNoCrash) {
   EXPECT_EQ(event->congestionEvent, kCongestionPacketLoss.str());
 }
 
+TEST_F(CopaTest, CompetitiveMode) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.copaCompetitiveModeEnabled = true;
+  auto qLogger = std::make_shared<FileQLogger>();
+  conn.qLogger = qLogger;
+  Copa copa(conn);
+  auto packetSize = conn.udpSendPacketLen;
+  auto now = Clock::now();
+  PacketNum packetNum = 0;
+  uint64_t totalSent = 0;
+  conn.lossState.srtt = 10ms;
+  auto sendAndAck = [&](std::chrono::microseconds lrtt) {
+    totalSent += packetSize;
+    copa.onPacketSent(createPacket(++packetNum, packetSize, totalSent));
+    now += 10ms;
+    conn.lossState.lrtt = lrtt;
+    copa.onPacketAckOrLoss(
+        createAckEvent(packetNum, packetSize, now), folly::none);
+  };
+
+  // The queue empties, Copa stays in the default mode.
+  for (int i = 0; i < 10; i++) {
+    sendAndAck(50ms);
+  }
+  EXPECT_EQ(Copa::Mode::Default, copa.getMode());
+  EXPECT_EQ(0.5, copa.getLatencyFactor());
+
+  // The queue never empties over 5 rtts.
+  for (int i = 0; i < 6; i++) {
+    sendAndAck(100ms);
+  }
+  EXPECT_EQ(Copa::Mode::Competitive, copa.getMode());
+  std::vector<int> indices =
+      getQLogEventIndices(QLogEventType::CongestionMetricUpdate, qLogger);
+  auto modeEvents = std::count_if(indices.begin(), indices.end(), [&](int i) {
+    auto event = dynamic_cast<QLogCongestionMetricUpdateEvent*>(
+        qLogger->logs[i].get());
+    return event->congestionEvent == kCopaCompetitiveMode.str();
+  });
+  EXPECT_EQ(1, modeEvents);
+
+  // 1 / latencyFactor increases by 1 every rtt without loss.
+  for (int i = 0; i < 6; i++) {
+    sendAndAck(100ms);
+  }
+  EXPECT_NEAR(1.0 / 8, copa.getLatencyFactor(), 0.001);
+
+  // And halves on loss.
+  totalSent += packetSize;
+  copa.onPacketSent(createPacket(++packetNum, packetSize, totalSent));
+  auto loss = createLossEvent({std::make_pair(packetNum, packetSize)});
+  copa.onPacketAckOrLoss(folly::none, loss);
+  EXPECT_NEAR(1.0 / 4, copa.getLatencyFactor(), 0.001);
+
+  // Back to the default mode once the queue empties again.
+  for (int i = 0; i < 5; i++) {
+    sendAndAck(50ms);
+  }
+  EXPECT_EQ(Copa::Mode::Default, copa.getMode());
+  EXPECT_EQ(0.5, copa.getLatencyFactor());
+}
+
+TEST_F(CopaTest, CompetitiveModeDisabled) {
+  QuicServerConnectionState conn;
+  Copa copa(conn);
+  auto packetSize = conn.udpSendPacketLen;
+  auto now = Clock::now();
+  conn.lossState.srtt = 10ms;
+  conn.lossState.lrtt = 50ms;
+  copa.onPacketSent(createPacket(1, packetSize, packetSize));
+  now += 10ms;
+  copa.onPacketAckOrLoss(createAckEvent(1, packetSize, now), folly::none);
+  for (PacketNum packetNum = 2; packetNum < 20; packetNum++) {
+    copa.onPacketSent(
+        createPacket(packetNum, packetSize, packetNum * packetSize));
+    now += 10ms;
+    conn.lossState.lrtt = 100ms;
+    copa.onPacketAckOrLoss(
+        createAckEvent(packetNum, packetSize, now), folly::none);
+  }
+  EXPECT_EQ(Copa::Mode::Default, copa.getMode());
+  EXPECT_EQ(0.5, copa.getLatencyFactor());
+}
+
+TEST_F(CopaTest, LatencyFactorParam) {
+  QuicServerConnectionState conn;
+  auto qLogger = std::make_shared<FileQLogger>();
+  conn.qLogger = qLogger;
+  conn.transportSettings.latencyFactor = 0.25;
+  conn.transportSettings.congestionControlParams.copa.latencyFactor = 0.1;
+  Copa copa(conn);
+  EXPECT_EQ(0.1, copa.getLatencyFactor());
+
+  std::vector<int> indices =
+      getQLogEventIndices(QLogEventType::CongestionMetricUpdate, qLogger);
+  ASSERT_EQ(1, indices.size());
+  auto tmp = std::move(qLogger->logs[indices[0]]);
+  auto event = dynamic_cast<QLogCongestionMetricUpdateEvent*>(tmp.get());
+  EXPECT_EQ(event->congestionEvent, kCongestionControlParams.str());
+  EXPECT_EQ(event->state, "latencyFactor=0.1");
+
+  conn.transportSettings.congestionControlParams.copa.latencyFactor = -1;
+  Copa defaultCopa(conn);
+  EXPECT_EQ(0.25, defaultCopa.getLatencyFactor());
+}
+
 } // namespace test
 } // namespace quic
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/QuicCubic.h>
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/test/TestingCubic.h>
+
+#include <cmath>
+
+using namespace quic;
+using namespace quic::test;
+using namespace std::chrono_literals;
+
+/**
+ * Compares Cubic's floating point window math against the fixed point one,
+ * both for the cube root alone and for a whole ack in Steady state.
+ */
+
+namespace {
+
+// The time to origin cube roots are of bytesToOrigin / mss * 2.5e9, so a few
+// packets to a few thousand packets.
+constexpr uint64_t kCbrtInputBase = 2500000000;
+constexpr uint64_t kCbrtInputRange = 4096;
+
+void ackInSteady(uint32_t iters, bool fixedPointMath) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  std::unique_ptr<TestingCubic> cubic;
+  folly::Optional<OutstandingPacket> ackedPacket;
+  folly::Optional<CongestionController::AckEvent> ack;
+  BENCHMARK_SUSPEND {
+    conn.transportSettings.cubicFixedPointMath = fixedPointMath;
+    cubic = std::make_unique<TestingCubic>(conn);
+    cubic->setStateForTest(CubicStates::Steady);
+    auto packet = makeTestingWritePacket(0, 1000, 1000);
+    cubic->onPacketSent(packet);
+    CongestionController::LossEvent loss(Clock::now());
+    loss.addLostPacket(packet);
+    cubic->onPacketAckOrLoss(folly::none, std::move(loss));
+    ackedPacket = makeTestingWritePacket(1, 1000, 2000);
+    ack = makeAck(1, 1000, ackedPacket->time + 1ms, ackedPacket->time);
+  }
+  auto firstAckTime = ack->ackTime;
+  for (uint32_t i = 0; i < iters; ++i) {
+    // Every ack is for the same packet, sent again right before. The ack
+    // times go up to 10 seconds after the loss.
+    cubic->onPacketSent(*ackedPacket);
+    ack->ackTime = firstAckTime + (i % 10000) * 1ms;
+    cubic->onPacketAckOrLoss(*ack, folly::none);
+  }
+  folly::doNotOptimizeAway(cubic->getCongestionWindow());
+}
+
+} // namespace
+
+BENCHMARK(FloatingPointCbrt, iters) {
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(::cbrt(
+        static_cast<double>(kCbrtInputBase * (i % kCbrtInputRange + 1))));
+  }
+}
+
+BENCHMARK_RELATIVE(FixedPointCbrt, iters) {
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(
+        fixedPointCbrt(kCbrtInputBase * (i % kCbrtInputRange + 1)));
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(FloatingPointAckInSteady, iters) {
+  ackInSteady(iters, false);
+}
+
+BENCHMARK_RELATIVE(FixedPointAckInSteady, iters) {
+  ackInSteady(iters, true);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -13,12 +13,43 @@
 using namespace quic;
 using namespace quic::test;
 using namespace testing;
+using namespace std::chrono_literals;
 
 namespace quic {
 namespace test {
 
 class CubicHystartTest : public Test {};
 
+class CubicHystartPlusPlusTest : public Test {
+ protected:
+  void SetUp() override {
+    conn_.transportSettings.cubicHystartPlusPlus = true;
+    cubic_ = std::make_unique<Cubic>(conn_);
+  }
+
+  // Acks a round of kHystartPlusPlusRttSamples packets that all see an rtt
+  // of rtt. The last packet is sent after the round started, so its ack ends
+  // the round.
+  void ackRound(std::chrono::microseconds rtt) {
+    conn_.lossState.lrtt = rtt;
+    for (uint8_t i = 0; i < kHystartPlusPlusRttSamples; ++i) {
+      auto sentTime = i + 1 < kHystartPlusPlusRttSamples ? Clock::now() - 1s
+                                                         : Clock::now() + 1s;
+      auto packet = makeTestingWritePacket(
+          packetNum_, 1000, totalSent_ + 1000, false, sentTime);
+      totalSent_ += 1000;
+      cubic_->onPacketSent(packet);
+      cubic_->onPacketAckOrLoss(
+          makeAck(packetNum_++, 1000, Clock::now(), sentTime), folly::none);
+    }
+  }
+
+  QuicConnectionStateBase conn_{QuicNodeType::Client};
+  std::unique_ptr<Cubic> cubic_;
+  PacketNum packetNum_{0};
+  uint64_t totalSent_{0};
+};
+
 TEST_F(CubicHystartTest, SendAndAck) {
   QuicConnectionStateBase conn(QuicNodeType::Client);
   conn.udpSendPacketLen = 100;
@@ -318,5 +349,66 @@ TEST_F(CubicHystartTest, ReduceByCubicReductionFactor) {
   EXPECT_EQ(initCwnd * 0.9, cubic.getWritableBytes());
   EXPECT_EQ(CubicStates::FastRecovery, cubic.state());
 }
+
+TEST_F(CubicHystartPlusPlusTest, ConservativeSlowStartThenSteady) {
+  auto cwnd = cubic_->getCongestionWindow();
+  ackRound(10ms);
+  ackRound(10ms);
+  EXPECT_EQ(
+      cwnd + 2 * 1000 * kHystartPlusPlusRttSamples,
+      cubic_->getCongestionWindow());
+  EXPECT_FALSE(cubic_->inConservativeSlowStart());
+
+  // The increase has to be at least kHystartPlusPlusMinRttThresh.
+  ackRound(13ms);
+  EXPECT_FALSE(cubic_->inConservativeSlowStart());
+  ackRound(18ms);
+  EXPECT_TRUE(cubic_->inConservativeSlowStart());
+  EXPECT_TRUE(cubic_->inSlowStart());
+
+  // The round that found the increase counts as the first CSS round.
+  cwnd = cubic_->getCongestionWindow();
+  for (uint8_t i = 1; i < kCssRounds - 1; ++i) {
+    ackRound(18ms);
+    EXPECT_TRUE(cubic_->inConservativeSlowStart());
+  }
+  EXPECT_EQ(
+      cwnd +
+          (kCssRounds - 2) * 1000 * kHystartPlusPlusRttSamples /
+              kCssGrowthDivisor,
+      cubic_->getCongestionWindow());
+  ackRound(18ms);
+  EXPECT_EQ(CubicStates::Steady, cubic_->state());
+  EXPECT_FALSE(cubic_->inConservativeSlowStart());
+}
+
+TEST_F(CubicHystartPlusPlusTest, SpuriousDelayIncreaseResumesSlowStart) {
+  ackRound(10ms);
+  ackRound(20ms);
+  ASSERT_TRUE(cubic_->inConservativeSlowStart());
+
+  ackRound(15ms);
+  EXPECT_FALSE(cubic_->inConservativeSlowStart());
+  EXPECT_EQ(CubicStates::Hystart, cubic_->state());
+  auto cwnd = cubic_->getCongestionWindow();
+  ackRound(15ms);
+  EXPECT_EQ(
+      cwnd + 1000 * kHystartPlusPlusRttSamples, cubic_->getCongestionWindow());
+  EXPECT_EQ(CubicStates::Hystart, cubic_->state());
+}
+
+TEST_F(CubicHystartPlusPlusTest, LossInConservativeSlowStart) {
+  ackRound(10ms);
+  ackRound(20ms);
+  ASSERT_TRUE(cubic_->inConservativeSlowStart());
+
+  auto packet = makeTestingWritePacket(packetNum_++, 1000, totalSent_ + 1000);
+  cubic_->onPacketSent(packet);
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet);
+  cubic_->onPacketAckOrLoss(folly::none, std::move(loss));
+  EXPECT_EQ(CubicStates::FastRecovery, cubic_->state());
+  EXPECT_FALSE(cubic_->inConservativeSlowStart());
+}
 } // namespace test
 } // namespace quic
@@ -41,6 +41,21 @@ TEST_F(CubicTest, AckIncreaseWritable) {
   EXPECT_EQ(initCwnd, cubic.getWritableBytes());
 }
 
+TEST_F(CubicTest, EcnCeMarksReduceCwnd) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  Cubic cubic(conn);
+  auto initCwnd = cubic.getCongestionWindow();
+  auto packet = makeTestingWritePacket(0, 1000, 1000);
+  cubic.onPacketSent(packet);
+  auto ack = makeAck(0, 1000, Clock::now(), packet.time);
+  ack.ecnCeCount = 1;
+  cubic.onPacketAckOrLoss(ack, folly::none);
+  EXPECT_EQ(CubicStates::FastRecovery, cubic.state());
+  EXPECT_LT(cubic.getCongestionWindow(), initCwnd);
+  // The acked bytes still leave the inflight bytes.
+  EXPECT_EQ(cubic.getCongestionWindow(), cubic.getWritableBytes());
+}
+
 TEST_F(CubicTest, PersistentCongestion) {
   QuicConnectionStateBase conn(QuicNodeType::Client);
   auto qLogger = std::make_shared<FileQLogger>();
@@ -339,5 +354,133 @@ TEST_F(CubicTest, RttSmallerThanInterval) {
       conn.transportSettings.writeConnectionDataPacketsLimit,
       cubic.getPacingRate(Clock::now()));
 }
+TEST_F(CubicTest, FixedPointMath) {
+  // The cwnd after each of a series of acks following a loss.
+  auto cwndsAfterLoss = [](bool fixedPointMath) {
+    QuicConnectionStateBase conn(QuicNodeType::Client);
+    conn.udpSendPacketLen = 1500;
+    conn.transportSettings.cubicFixedPointMath = fixedPointMath;
+    TestingCubic cubic(conn);
+    cubic.setStateForTest(CubicStates::Steady);
+
+    auto packet = makeTestingWritePacket(0, 1000, 1000);
+    cubic.onPacketSent(packet);
+    auto reductionTime = Clock::now();
+    CongestionController::LossEvent loss(reductionTime);
+    loss.addLostPacket(packet);
+    cubic.onPacketAckOrLoss(folly::none, std::move(loss));
+
+    std::vector<uint64_t> cwnds;
+    for (PacketNum packetNum = 1; packetNum <= 30; ++packetNum) {
+      auto ackedPacket =
+          makeTestingWritePacket(packetNum, 1000, 1000 * (packetNum + 1));
+      cubic.onPacketSent(ackedPacket);
+      cubic.onPacketAckOrLoss(
+          makeAck(
+              packetNum,
+              1000,
+              reductionTime + packetNum * 100ms,
+              ackedPacket.time),
+          folly::none);
+      cwnds.push_back(cubic.getCongestionWindow());
+    }
+    return cwnds;
+  };
+
+  auto floatingPointCwnds = cwndsAfterLoss(false);
+  auto fixedPointCwnds = cwndsAfterLoss(true);
+  ASSERT_EQ(floatingPointCwnds.size(), fixedPointCwnds.size());
+  // The time to origin is rounded down to a millisecond, which is a few bytes
+  // of growth at most this soon after the loss.
+  for (size_t i = 0; i < fixedPointCwnds.size(); ++i) {
+    EXPECT_NEAR(floatingPointCwnds[i], fixedPointCwnds[i], 15) << i;
+  }
+}
+
+TEST_F(CubicTest, BetaParam) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  auto qLogger = std::make_shared<FileQLogger>();
+  conn.qLogger = qLogger;
+  conn.transportSettings.congestionControlParams.cubic.beta = 0.5;
+  Cubic cubic(conn);
+  cubic.setConnectionEmulation(1);
+  auto initCwnd = cubic.getCongestionWindow();
+  auto packet = makeTestingWritePacket(0, 1000, 1000);
+  cubic.onPacketSent(packet);
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet);
+  cubic.onPacketAckOrLoss(folly::none, std::move(loss));
+  EXPECT_EQ(initCwnd / 2, cubic.getCongestionWindow());
+
+  std::vector<int> indices =
+      getQLogEventIndices(QLogEventType::CongestionMetricUpdate, qLogger);
+  ASSERT_FALSE(indices.empty());
+  auto tmp = std::move(qLogger->logs[indices[0]]);
+  auto event = dynamic_cast<QLogCongestionMetricUpdateEvent*>(tmp.get());
+  EXPECT_EQ(event->congestionEvent, kCongestionControlParams.str());
+  EXPECT_EQ(event->state, "beta=0.5");
+}
+
+TEST_F(CubicTest, OutOfRangeBetaIgnored) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  conn.transportSettings.congestionControlParams.cubic.beta = 1.5;
+  Cubic cubic(conn);
+  cubic.setConnectionEmulation(1);
+  auto initCwnd = cubic.getCongestionWindow();
+  auto packet = makeTestingWritePacket(0, 1000, 1000);
+  cubic.onPacketSent(packet);
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet);
+  cubic.onPacketAckOrLoss(folly::none, std::move(loss));
+  EXPECT_EQ(
+      static_cast<uint64_t>(initCwnd * kDefaultCubicReductionFactor),
+      cubic.getCongestionWindow());
+}
+
+TEST_F(CubicTest, SpuriousLossUndo) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  Cubic cubic(conn);
+  auto initCwnd = cubic.getCongestionWindow();
+  auto packet1 = makeTestingWritePacket(0, 1000, 1000);
+  auto packet2 = makeTestingWritePacket(1, 1000, 2000);
+  cubic.onPacketSent(packet1);
+  cubic.onPacketSent(packet2);
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet1);
+  loss.addLostPacket(packet2);
+  auto lossTime = loss.lossTime;
+  cubic.onPacketAckOrLoss(folly::none, std::move(loss));
+  EXPECT_EQ(CubicStates::FastRecovery, cubic.state());
+  EXPECT_LT(cubic.getCongestionWindow(), initCwnd);
+
+  // Undone only once both of the lost packets are acked after all.
+  cubic.onSpuriousLoss(lossTime);
+  EXPECT_EQ(CubicStates::FastRecovery, cubic.state());
+  EXPECT_LT(cubic.getCongestionWindow(), initCwnd);
+  cubic.onSpuriousLoss(lossTime);
+  EXPECT_EQ(CubicStates::Hystart, cubic.state());
+  EXPECT_EQ(initCwnd, cubic.getCongestionWindow());
+  EXPECT_EQ(initCwnd, cubic.getWritableBytes());
+
+  // Nothing left to undo.
+  cubic.onSpuriousLoss(lossTime);
+  EXPECT_EQ(initCwnd, cubic.getCongestionWindow());
+}
+
+TEST_F(CubicTest, NoUndoAfterPersistentCongestion) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  Cubic cubic(conn);
+  auto packet = makeTestingWritePacket(0, 1000, 1000);
+  cubic.onPacketSent(packet);
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet);
+  loss.persistentCongestion = true;
+  auto lossTime = loss.lossTime;
+  cubic.onPacketAckOrLoss(folly::none, std::move(loss));
+  auto cwnd = cubic.getCongestionWindow();
+  cubic.onSpuriousLoss(lossTime);
+  EXPECT_EQ(cwnd, cubic.getCongestionWindow());
+}
+
 } // namespace test
 } // namespace quic
@@ -12,6 +12,7 @@
 #include <quic/common/test/TestUtils.h>
 
 using namespace testing;
+using namespace std::chrono_literals;
 
 namespace quic {
 namespace test {
@@ -175,6 +176,39 @@ TEST_F(NewRenoTest, TestSteadyStateAck) {
           ((kDefaultUDPSendPacketLen * ackedSize) / newWritableBytes2));
 }
 
+TEST_F(NewRenoTest, EcnCeMarksReduceCwnd) {
+  QuicServerConnectionState conn;
+  NewReno reno(conn);
+  auto originalCwnd = reno.getCongestionWindow();
+
+  uint64_t ackedSize = 10;
+  auto packet1 = createPacket(1, ackedSize, Clock::now() - 10ms);
+  auto packet2 = createPacket(2, ackedSize, Clock::now() - 10ms);
+  reno.onPacketSent(packet1);
+  reno.onPacketSent(packet2);
+  auto ack1 = createAckEvent(1, ackedSize, packet1.time);
+  ack1.ecnCeCount = 1;
+  reno.onPacketAckOrLoss(ack1, folly::none);
+  EXPECT_FALSE(reno.inSlowStart());
+  EXPECT_EQ(originalCwnd / 2, reno.getCongestionWindow());
+  EXPECT_EQ(ackedSize, reno.getBytesInFlight());
+
+  // Marks on packets sent before the recovery started are already accounted
+  // for.
+  auto ack2 = createAckEvent(2, ackedSize, packet2.time);
+  ack2.ecnCeCount = 1;
+  reno.onPacketAckOrLoss(ack2, folly::none);
+  EXPECT_EQ(originalCwnd / 2, reno.getCongestionWindow());
+  EXPECT_EQ(0, reno.getBytesInFlight());
+
+  auto packet3 = createPacket(3, ackedSize, Clock::now() + 1ms);
+  reno.onPacketSent(packet3);
+  auto ack3 = createAckEvent(3, ackedSize, packet3.time);
+  ack3.ecnCeCount = 1;
+  reno.onPacketAckOrLoss(ack3, folly::none);
+  EXPECT_LT(reno.getCongestionWindow(), originalCwnd / 2);
+}
+
 TEST_F(NewRenoTest, TestWritableBytes) {
   QuicServerConnectionState conn;
   NewReno reno(conn);
@@ -223,5 +257,26 @@ TEST_F(NewRenoTest, RemoveBytesWithoutLossOrAck) {
   reno.onRemoveBytesFromInflight(2);
   EXPECT_EQ(reno.getWritableBytes(), originalWritableBytes - ackedSize + 2);
 }
+
+TEST_F(NewRenoTest, SpuriousLossUndo) {
+  QuicServerConnectionState conn;
+  NewReno reno(conn);
+  auto initCwnd = reno.getCongestionWindow();
+  auto pkt = createPacket(1, 1000, Clock::now());
+  reno.onPacketSent(pkt);
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(pkt);
+  auto lossTime = loss.lossTime;
+  reno.onPacketAckOrLoss(folly::none, loss);
+  EXPECT_FALSE(reno.inSlowStart());
+  EXPECT_LT(reno.getCongestionWindow(), initCwnd);
+
+  // A loss from before the reduction doesn't undo it.
+  reno.onSpuriousLoss(lossTime - 1ms);
+  EXPECT_LT(reno.getCongestionWindow(), initCwnd);
+  reno.onSpuriousLoss(lossTime);
+  EXPECT_TRUE(reno.inSlowStart());
+  EXPECT_EQ(initCwnd, reno.getCongestionWindow());
+}
 } // namespace test
 } // namespace quic
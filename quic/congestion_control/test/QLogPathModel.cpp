@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/test/QLogPathModel.h>
+
+#include <folly/String.h>
+#include <folly/json.h>
+#include <quic/logging/QLoggerConstants.h>
+#include <quic/logging/QLoggerTypes.h>
+
+#include <algorithm>
+#include <map>
+
+namespace quic {
+namespace test {
+
+namespace {
+
+struct SentPacket {
+  std::chrono::microseconds time;
+  uint64_t size;
+  // Bytes delivered when it was sent, and when the last of them was acked.
+  uint64_t delivered;
+  std::chrono::microseconds deliveredTime;
+};
+
+struct Interval {
+  // Bytes per second.
+  uint64_t maxBandwidth{0};
+  folly::Optional<std::chrono::microseconds> minRtt;
+  uint64_t sentPackets{0};
+  uint64_t randomLosses{0};
+};
+
+bool isEvent(const folly::dynamic& event) {
+  return event.isArray() && event.size() >= 5 && event[2].isString() &&
+      event[4].isObject();
+}
+
+std::string stringField(const folly::dynamic& object, folly::StringPiece key) {
+  return object.getDefault(key, "").asString();
+}
+
+std::chrono::microseconds eventTime(const folly::dynamic& event) {
+  // FileQLogger writes the relative time as a string.
+  return std::chrono::microseconds(
+      event[0].isString() ? folly::to<int64_t>(event[0].getString())
+                          : event[0].asInt());
+}
+
+} // namespace
+
+folly::Optional<std::vector<folly::dynamic>> parseQLogEvents(
+    folly::StringPiece data) {
+  std::vector<folly::dynamic> events;
+  try {
+    auto qlog = folly::parseJson(data);
+    if (!qlog.isObject()) {
+      return folly::none;
+    }
+    if (auto event = qlog.get_ptr("event")) {
+      // A single line of StreamingQLogger.
+      if (isEvent(*event)) {
+        events.push_back(*event);
+      }
+      return std::move(events);
+    }
+    auto traces = qlog.get_ptr("traces");
+    if (!traces || !traces->isArray()) {
+      return folly::none;
+    }
+    for (const auto& trace : *traces) {
+      auto traceEvents = trace.isObject() ? trace.get_ptr("events") : nullptr;
+      if (!traceEvents || !traceEvents->isArray()) {
+        continue;
+      }
+      for (const auto& event : *traceEvents) {
+        if (isEvent(event)) {
+          events.push_back(event);
+        }
+      }
+    }
+    return std::move(events);
+  } catch (const std::exception&) {
+    // More than one JSON value, one event per line then.
+  }
+  std::vector<folly::StringPiece> lines;
+  folly::split('\n', data, lines);
+  try {
+    for (auto line : lines) {
+      line = folly::trimWhitespace(line);
+      if (line.empty()) {
+        continue;
+      }
+      auto parsed = folly::parseJson(line);
+      auto event = parsed.isObject() ? parsed.get_ptr("event") : nullptr;
+      if (!event) {
+        return folly::none;
+      }
+      if (isEvent(*event)) {
+        events.push_back(*event);
+      }
+    }
+  } catch (const std::exception& ex) {
+    VLOG(4) << "Failed to parse qlog: " << ex.what();
+    return folly::none;
+  }
+  return std::move(events);
+}
+
+folly::Optional<QLogPath> inferPathFromQLog(
+    const std::vector<folly::dynamic>& events,
+    std::chrono::microseconds interval) {
+  CHECK_GT(interval.count(), 0);
+  std::vector<const folly::dynamic*> sorted;
+  for (const auto& event : events) {
+    sorted.push_back(&event);
+  }
+  std::stable_sort(
+      sorted.begin(), sorted.end(), [](const auto* lhs, const auto* rhs) {
+        return eventTime(*lhs) < eventTime(*rhs);
+      });
+  if (sorted.empty()) {
+    return folly::none;
+  }
+
+  QLogPath path;
+  auto firstTime = eventTime(*sorted.front());
+  auto lastTime = eventTime(*sorted.back());
+  std::vector<Interval> intervals((lastTime - firstTime) / interval + 1);
+  std::map<PacketNum, SentPacket> sent;
+  uint64_t delivered = 0;
+  folly::Optional<std::chrono::microseconds> deliveredTime;
+  // The latest estimates, to tell the losses of the queue from the others.
+  uint64_t bandwidth = 0;
+  folly::Optional<std::chrono::microseconds> minRtt;
+  uint64_t bytesInFlight = 0;
+  std::vector<uint64_t> excessBytes;
+  auto ackType = toString(FrameType::ACK);
+
+  for (const auto* eventPtr : sorted) {
+    const auto& event = *eventPtr;
+    auto time = eventTime(event);
+    auto& current = intervals[(time - firstTime) / interval];
+    const auto& type = event[2].getString();
+    const auto& data = event[4];
+    try {
+      if (type == toString(QLogEventType::PacketSent)) {
+        if (stringField(data, "packet_type") != kShortHeaderPacketType) {
+          continue;
+        }
+        const auto& header = data["header"];
+        if (!deliveredTime) {
+          deliveredTime = time;
+        }
+        sent[header["packet_number"].asInt()] = SentPacket{
+            time,
+            static_cast<uint64_t>(header["packet_size"].asInt()),
+            delivered,
+            *deliveredTime};
+        current.sentPackets++;
+      } else if (type == toString(QLogEventType::PacketReceived)) {
+        if (stringField(data, "packet_type") != kShortHeaderPacketType) {
+          continue;
+        }
+        for (const auto& frame :
+             data.getDefault("frames", folly::dynamic::array())) {
+          if (stringField(frame, "frame_type") != ackType) {
+            continue;
+          }
+          // The largest packet newly acked gives the samples.
+          folly::Optional<std::pair<PacketNum, SentPacket>> largestAcked;
+          for (const auto& range : frame["acked_ranges"]) {
+            auto it = sent.lower_bound(range[0].asInt());
+            auto end = sent.upper_bound(range[1].asInt());
+            while (it != end) {
+              delivered += it->second.size;
+              if (!largestAcked || it->first > largestAcked->first) {
+                largestAcked = std::make_pair(it->first, it->second);
+              }
+              it = sent.erase(it);
+            }
+          }
+          if (!largestAcked) {
+            continue;
+          }
+          deliveredTime = time;
+          auto rtt = time - largestAcked->second.time;
+          std::chrono::microseconds ackDelay(frame["ack_delay"].asInt());
+          if (rtt > ackDelay) {
+            rtt -= ackDelay;
+          }
+          current.minRtt = current.minRtt ? std::min(*current.minRtt, rtt)
+                                          : rtt;
+          minRtt = current.minRtt;
+          auto elapsed = time - largestAcked->second.deliveredTime;
+          if (elapsed.count() > 0) {
+            current.maxBandwidth = std::max<uint64_t>(
+                current.maxBandwidth,
+                (delivered - largestAcked->second.delivered) * 1000000 /
+                    elapsed.count());
+            bandwidth = current.maxBandwidth;
+          }
+        }
+      } else if (type == toString(QLogEventType::PacketsLost)) {
+        auto lost = static_cast<uint64_t>(data["lost_packets"].asInt());
+        auto bdp = minRtt ? bandwidth * minRtt->count() / 1000000 : 0;
+        if (bdp > 0 && bytesInFlight > bdp) {
+          path.congestionLosses += lost;
+          excessBytes.push_back(bytesInFlight - bdp);
+        } else {
+          path.randomLosses += lost;
+          current.randomLosses += lost;
+        }
+      } else if (type == toString(QLogEventType::CongestionMetricUpdate)) {
+        bytesInFlight = data["bytes_in_flight"].asInt();
+      }
+    } catch (const std::exception& ex) {
+      VLOG(4) << "Skipping malformed qlog event: " << ex.what();
+    }
+  }
+
+  auto firstBandwidth = std::find_if(
+      intervals.begin(), intervals.end(), [](const Interval& i) {
+        return i.maxBandwidth > 0;
+      });
+  auto firstRtt = std::find_if(
+      intervals.begin(), intervals.end(), [](const Interval& i) {
+        return i.minRtt.hasValue();
+      });
+  if (firstBandwidth == intervals.end() || firstRtt == intervals.end()) {
+    return folly::none;
+  }
+
+  // The intervals before the first samples take their values.
+  uint64_t intervalBandwidth = firstBandwidth->maxBandwidth;
+  auto intervalRtt = *firstRtt->minRtt;
+  uint64_t totalBandwidth = 0;
+  SimulatedLink::Change last;
+  for (size_t i = 0; i < intervals.size(); i++) {
+    const auto& current = intervals[i];
+    if (current.maxBandwidth > 0) {
+      intervalBandwidth = current.maxBandwidth;
+    }
+    if (current.minRtt) {
+      intervalRtt = *current.minRtt;
+    }
+    SimulatedLink::Change change{
+        interval * i,
+        intervalBandwidth,
+        intervalRtt / 2,
+        current.sentPackets > 0
+            ? std::min(
+                  1.0,
+                  static_cast<double>(current.randomLosses) /
+                      current.sentPackets)
+            : 0};
+    totalBandwidth += intervalBandwidth;
+    if (i == 0) {
+      path.link.bandwidthBytesPerSec = change.bandwidthBytesPerSec;
+      path.link.oneWayDelay = change.oneWayDelay;
+      path.link.lossRate = change.lossRate;
+    } else if (
+        change.bandwidthBytesPerSec != last.bandwidthBytesPerSec ||
+        change.oneWayDelay != last.oneWayDelay ||
+        change.lossRate != last.lossRate) {
+      path.link.changes.push_back(change);
+    }
+    last = change;
+  }
+  path.avgBandwidthBytesPerSec = totalBandwidth / intervals.size();
+  path.duration = lastTime - firstTime;
+
+  if (excessBytes.empty()) {
+    path.link.bufferBytes =
+        path.avgBandwidthBytesPerSec * minRtt->count() / 1000000;
+  } else {
+    auto median = excessBytes.begin() + excessBytes.size() / 2;
+    std::nth_element(excessBytes.begin(), median, excessBytes.end());
+    path.link.bufferBytes = *median;
+  }
+  path.link.bufferBytes =
+      std::max<uint64_t>(path.link.bufferBytes, kDefaultUDPSendPacketLen);
+  return std::move(path);
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/congestion_control/test/CongestionControlSimulator.h>
+
+#include <folly/Optional.h>
+#include <folly/dynamic.h>
+
+namespace quic {
+namespace test {
+
+struct QLogPath {
+  // Starts with the first interval of the trace, the others are its
+  // changes.
+  SimulatedLink link;
+  // From the first to the last event of the trace.
+  std::chrono::microseconds duration{0us};
+  uint64_t avgBandwidthBytesPerSec{0};
+  // Losses taken as random over all of them, the others overflowed the
+  // bottleneck queue.
+  uint64_t randomLosses{0};
+  uint64_t congestionLosses{0};
+};
+
+/**
+ * The events of a qlog, as FileQLogger writes them, or one event per line
+ * as StreamingQLogger does. Each is an array of relative time, category,
+ * event type, trigger and data. Returns none if data is neither.
+ */
+folly::Optional<std::vector<folly::dynamic>> parseQLogEvents(
+    folly::StringPiece data);
+
+/**
+ * Infers the path a connection sent over from the events of its qlog,
+ * logged by the sender, as the link of the congestion control simulator.
+ * The path is taken to be constant over each interval of the trace.
+ *
+ * From the 1-RTT packets of PACKET_SENT, and the acks of PACKET_RECEIVED:
+ * - the bandwidth of an interval is its largest delivery rate, bytes acked
+ *   over the time since the acked packet was sent;
+ * - the one way delay is half its smallest rtt sample, taken without the
+ *   ack delay.
+ * The loss rate is the packets of PACKETS_LOST over the packets sent. A loss
+ * counts as random unless the bytes in flight of the last
+ * CONGESTION_METRIC_UPDATE exceeded the bandwidth delay product, in which
+ * case it went over the bottleneck queue: the buffer is the median of those
+ * excess bytes, one bandwidth delay product without any.
+ *
+ * Intervals without samples keep the values of the previous one. A sender
+ * that was application limited never measured the whole bandwidth of the
+ * path, so this can only be a lower bound then. Returns none if the trace
+ * has no delivery rate and rtt sample.
+ */
+folly::Optional<QLogPath> inferPathFromQLog(
+    const std::vector<folly::dynamic>& events,
+    std::chrono::microseconds interval = 1s);
+
+} // namespace test
+} // namespace quic
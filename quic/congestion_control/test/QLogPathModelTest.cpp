@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/test/QLogPathModel.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+namespace {
+// In the format of QLogEvent::toDynamic.
+folly::dynamic makeEvent(
+    std::chrono::microseconds time,
+    folly::StringPiece type,
+    folly::dynamic data) {
+  return folly::dynamic::array(
+      folly::to<std::string>(time.count()),
+      "TRANSPORT",
+      type,
+      "DEFAULT",
+      std::move(data));
+}
+
+folly::dynamic makeSent(std::chrono::microseconds time, PacketNum packetNum) {
+  return makeEvent(
+      time,
+      "PACKET_SENT",
+      folly::dynamic::object("packet_type", "1RTT")(
+          "header",
+          folly::dynamic::object("packet_number", packetNum)(
+              "packet_size", 1000)));
+}
+
+folly::dynamic makeAck(std::chrono::microseconds time, PacketNum packetNum) {
+  return makeEvent(
+      time,
+      "PACKET_RECEIVED",
+      folly::dynamic::object("packet_type", "1RTT")(
+          "frames",
+          folly::dynamic::array(folly::dynamic::object("frame_type", "ACK")(
+              "ack_delay", 0)(
+              "acked_ranges",
+              folly::dynamic::array(
+                  folly::dynamic::array(packetNum, packetNum))))));
+}
+
+folly::dynamic makeInflight(
+    std::chrono::microseconds time,
+    uint64_t bytesInFlight) {
+  return makeEvent(
+      time,
+      "CONGESTION_METRIC_UPDATE",
+      folly::dynamic::object("bytes_in_flight", bytesInFlight));
+}
+
+folly::dynamic makeLost(std::chrono::microseconds time, uint64_t lost) {
+  return makeEvent(
+      time, "PACKETS_LOST", folly::dynamic::object("lost_packets", lost));
+}
+} // namespace
+
+TEST(QLogPathModelTest, ParsesFileAndStreamingQLogs) {
+  auto event = makeSent(1ms, 0);
+  auto file = folly::toJson(folly::dynamic::object(
+      "traces",
+      folly::dynamic::array(folly::dynamic::object(
+          "events", folly::dynamic::array(event, event)))));
+  auto events = parseQLogEvents(file);
+  ASSERT_TRUE(events.hasValue());
+  EXPECT_EQ(2u, events->size());
+
+  std::string lines;
+  for (int i = 0; i < 3; i++) {
+    lines += folly::toJson(folly::dynamic::object("dcid", "")("event", event));
+    lines += "\n";
+  }
+  events = parseQLogEvents(lines);
+  ASSERT_TRUE(events.hasValue());
+  EXPECT_EQ(3u, events->size());
+  EXPECT_EQ(event, events->front());
+
+  EXPECT_FALSE(parseQLogEvents("not a qlog").hasValue());
+}
+
+TEST(QLogPathModelTest, InfersPath) {
+  std::vector<folly::dynamic> events;
+  // A packet a millisecond, acked 50ms later: 1MB/s over a 50ms rtt.
+  for (PacketNum i = 0; i < 2000; i++) {
+    events.push_back(makeSent(std::chrono::milliseconds(i), i));
+  }
+  for (PacketNum i = 0; i < 2000; i++) {
+    events.push_back(makeAck(std::chrono::milliseconds(i + 50), i));
+  }
+  // Lost well within the bandwidth delay product, then over it.
+  events.push_back(makeInflight(499ms, 10000));
+  events.push_back(makeLost(500ms, 5));
+  events.push_back(makeInflight(1499ms, 80000));
+  events.push_back(makeLost(1500ms, 2));
+
+  auto path = inferPathFromQLog(events, 1s);
+  ASSERT_TRUE(path.hasValue());
+  EXPECT_EQ(2049ms, path->duration);
+  EXPECT_EQ(1000000u, path->avgBandwidthBytesPerSec);
+  EXPECT_EQ(1000000u, path->link.bandwidthBytesPerSec);
+  EXPECT_EQ(25ms, path->link.oneWayDelay);
+  EXPECT_DOUBLE_EQ(0.005, path->link.lossRate);
+  // 30KB over the 50KB bandwidth delay product.
+  EXPECT_EQ(30000u, path->link.bufferBytes);
+  EXPECT_EQ(5u, path->randomLosses);
+  EXPECT_EQ(2u, path->congestionLosses);
+  // The loss rate drops after the first second, the rest stays.
+  ASSERT_EQ(1u, path->link.changes.size());
+  EXPECT_EQ(1s, path->link.changes[0].time);
+  EXPECT_EQ(1000000u, path->link.changes[0].bandwidthBytesPerSec);
+  EXPECT_EQ(25ms, path->link.changes[0].oneWayDelay);
+  EXPECT_EQ(0, path->link.changes[0].lossRate);
+
+  // A replay of it runs.
+  CongestionControlSimulator simulator(
+      path->link, CongestionControlType::Cubic);
+  auto result = simulator.run(path->duration);
+  EXPECT_GT(result.throughputBytesPerSec, 0u);
+}
+
+TEST(QLogPathModelTest, NoSamples) {
+  std::vector<folly::dynamic> events;
+  EXPECT_FALSE(inferPathFromQLog(events).hasValue());
+  events.push_back(makeSent(0ms, 0));
+  events.push_back(makeSent(1ms, 1));
+  EXPECT_FALSE(inferPathFromQLog(events).hasValue());
+}
+
+} // namespace test
+} // namespace quic
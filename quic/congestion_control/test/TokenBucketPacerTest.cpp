@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/TokenBucketPacer.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/NewReno.h>
+
+using namespace quic;
+using namespace quic::test;
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+class TokenBucketPacerTest : public Test {
+ protected:
+  void SetUp() override {
+    conn_.udpSendPacketLen = 1000;
+    conn_.transportSettings.maxBurstPackets = 10;
+    pacer_ = std::make_unique<TokenBucketPacer>(conn_, 1ms);
+  }
+
+  QuicConnectionStateBase conn_{QuicNodeType::Client};
+  std::unique_ptr<TokenBucketPacer> pacer_;
+};
+
+TEST_F(TokenBucketPacerTest, NotPacedWithoutRate) {
+  auto now = Clock::now();
+  EXPECT_EQ(0us, pacer_->getTimeUntilNextWrite(now));
+  EXPECT_EQ(
+      conn_.transportSettings.writeConnectionDataPacketsLimit,
+      pacer_->updateAndGetWriteBatchSize(now));
+
+  // A rtt below the minimal interval can't be paced either.
+  pacer_->refreshPacingRate(100 * 1000, 500us);
+  EXPECT_EQ(0us, pacer_->getPacingInterval());
+  EXPECT_EQ(0us, pacer_->getTimeUntilNextWrite(now));
+}
+
+TEST_F(TokenBucketPacerTest, BurstsAtTargetRate) {
+  // 100 packets per 100ms, bursts of one packet per ms.
+  pacer_->refreshPacingRate(100 * 1000, 100ms);
+  EXPECT_EQ(1ms, pacer_->getPacingInterval());
+  EXPECT_EQ(1, pacer_->getPacingBurstSize());
+
+  auto now = Clock::now();
+  // The first burst has its tokens right away.
+  EXPECT_EQ(1, pacer_->updateAndGetWriteBatchSize(now));
+  pacer_->onPacketSent();
+  EXPECT_EQ(0, pacer_->updateAndGetWriteBatchSize(now));
+  EXPECT_EQ(1ms, pacer_->getTimeUntilNextWrite(now));
+
+  EXPECT_EQ(1, pacer_->updateAndGetWriteBatchSize(now + 1ms));
+  pacer_->onPacketSent();
+  // Half a burst later, the other half is still missing.
+  EXPECT_EQ(0, pacer_->updateAndGetWriteBatchSize(now + 1500us));
+  EXPECT_EQ(1ms, pacer_->getTimeUntilNextWrite(now + 1500us));
+}
+
+TEST_F(TokenBucketPacerTest, LateTimerGivesBurstCredit) {
+  pacer_->refreshPacingRate(100 * 1000, 100ms);
+  auto now = Clock::now();
+  EXPECT_EQ(1, pacer_->updateAndGetWriteBatchSize(now));
+  pacer_->onPacketSent();
+  // The timer fired 3 intervals late, the missed bursts go out at once.
+  EXPECT_EQ(4, pacer_->updateAndGetWriteBatchSize(now + 4ms));
+  // But no more than maxBurstPackets after a long pause.
+  EXPECT_EQ(
+      conn_.transportSettings.maxBurstPackets,
+      pacer_->updateAndGetWriteBatchSize(now + 1s));
+  EXPECT_EQ(1ms, pacer_->getTimeUntilNextWrite(now + 1s));
+}
+
+TEST_F(TokenBucketPacerTest, RateChange) {
+  pacer_->refreshPacingRate(100 * 1000, 100ms);
+  auto now = Clock::now();
+  EXPECT_EQ(1, pacer_->updateAndGetWriteBatchSize(now));
+  pacer_->onPacketSent();
+  // Ten times the rate, ten times the tokens per interval.
+  pacer_->refreshPacingRate(1000 * 1000, 100ms);
+  EXPECT_EQ(10, pacer_->getPacingBurstSize());
+  EXPECT_EQ(10, pacer_->updateAndGetWriteBatchSize(now + 1ms));
+}
+
+TEST_F(TokenBucketPacerTest, NewRenoReportsItsCwnd) {
+  conn_.pacer = std::make_unique<TokenBucketPacer>(conn_, 1ms);
+  NewReno reno(conn_);
+  EXPECT_TRUE(reno.canBePaced());
+  conn_.lossState.srtt = 100ms;
+  auto packet = makeTestingWritePacket(0, 1000, 1000);
+  reno.onPacketSent(packet);
+  reno.onPacketAckOrLoss(
+      makeAck(0, 1000, Clock::now() + 1ms, packet.time), folly::none);
+  auto cwndInPackets = reno.getCongestionWindow() / conn_.udpSendPacketLen;
+  EXPECT_EQ(
+      std::min(
+          conn_.transportSettings.maxBurstPackets,
+          (cwndInPackets + 99) / 100),
+      conn_.pacer->getPacingBurstSize());
+  EXPECT_NE(0us, conn_.pacer->getPacingInterval());
+}
+
+} // namespace test
+} // namespace quic
@@ -7,7 +7,9 @@
  */
 
 #include <quic/flowcontrol/QuicFlowController.h>
+#include <quic/flowcontrol/ReceiveWindowBudget.h>
 #include <quic/logging/QuicLogger.h>
+#include <quic/state/QuicStreamUtilities.h>
 
 #include <quic/QuicConstants.h>
 #include <quic/QuicException.h>
@@ -53,22 +55,160 @@ inline void incrementWithOverFlowCheck(T& num, T diff) {
   num += diff;
 }
 
+// Whether the peer is close to being blocked by the advertised offset.
+bool isWindowUpdateUrgent(
+    uint64_t maxOffsetObserved,
+    uint64_t advertisedMaxOffset,
+    uint64_t windowSize) {
+  auto windowLeft = advertisedMaxOffset > maxOffsetObserved
+      ? advertisedMaxOffset - maxOffsetObserved
+      : 0;
+  return windowLeft * kUrgentWindowUpdateFraction < windowSize;
+}
+
+void clearUrgentWindowUpdate(QuicConnectionStateBase& conn) {
+  if (!conn.pendingEvents.connWindowUpdate &&
+      !conn.streamManager->hasWindowUpdates()) {
+    conn.pendingEvents.urgentWindowUpdate = false;
+  }
+}
+
+// Whether the window needs to grow: the update is due because the peer used up
+// the window, within flowControlRttFrequency * RTT of the last update.
+bool isWindowTooSmall(
+    const std::chrono::microseconds& srtt,
+    const TransportSettings& transportSettings,
+    const folly::Optional<TimePoint>& lastSendTime,
+    const TimePoint& updateTime) {
+  return transportSettings.autotuneReceiveWindow && srtt.count() != 0 &&
+      lastSendTime && updateTime >= *lastSendTime &&
+      (updateTime - *lastSendTime) <=
+      transportSettings.flowControlRttFrequency * srtt;
+}
+
+bool underMemoryPressure(const QuicConnectionStateBase& conn) {
+  return conn.receiveWindowBudget &&
+      conn.receiveWindowBudget->underMemoryPressure();
+}
+
+void autotuneConnWindow(QuicConnectionStateBase& conn, TimePoint updateTime) {
+  auto& flowControlState = conn.flowControlState;
+  if (underMemoryPressure(conn)) {
+    // Only gives back what auto-tuning added.
+    auto shrink = std::min(
+        flowControlState.reservedWindowBytes, flowControlState.windowSize / 2);
+    if (shrink > 0) {
+      flowControlState.windowSize -= shrink;
+      flowControlState.reservedWindowBytes -= shrink;
+      conn.receiveWindowBudget->release(shrink);
+      VLOG(4) << "Shrunk conn window under memory pressure window="
+              << flowControlState.windowSize;
+    }
+    return;
+  }
+  if (!isWindowTooSmall(
+          conn.lossState.srtt,
+          conn.transportSettings,
+          flowControlState.timeOfLastFlowControlUpdate,
+          updateTime)) {
+    return;
+  }
+  auto maxWindowSize = conn.transportSettings.maxReceiveConnectionWindowSize;
+  if (flowControlState.windowSize >= maxWindowSize) {
+    return;
+  }
+  auto growth = std::min(
+      flowControlState.windowSize, maxWindowSize - flowControlState.windowSize);
+  if (conn.receiveWindowBudget) {
+    growth = conn.receiveWindowBudget->reserve(growth);
+    flowControlState.reservedWindowBytes += growth;
+  }
+  flowControlState.windowSize += growth;
+  VLOG(4) << "Grew conn window to window=" << flowControlState.windowSize;
+}
+
+uint64_t initialStreamWindowSize(const QuicStreamState& stream) {
+  const auto& transportSettings = stream.conn.transportSettings;
+  if (isUnidirectionalStream(stream.id)) {
+    return transportSettings.advertisedInitialUniStreamWindowSize;
+  }
+  return isLocalStream(stream.conn.nodeType, stream.id)
+      ? transportSettings.advertisedInitialBidiLocalStreamWindowSize
+      : transportSettings.advertisedInitialBidiRemoteStreamWindowSize;
+}
+
+void autotuneStreamWindow(QuicStreamState& stream, TimePoint updateTime) {
+  auto& flowControlState = stream.flowControlState;
+  if (underMemoryPressure(stream.conn)) {
+    auto windowSize = std::max(
+        flowControlState.windowSize / 2, initialStreamWindowSize(stream));
+    if (windowSize < flowControlState.windowSize) {
+      flowControlState.windowSize = windowSize;
+      VLOG(4) << "Shrunk stream window under memory pressure stream="
+              << stream.id << " window=" << flowControlState.windowSize;
+    }
+    return;
+  }
+  if (!isWindowTooSmall(
+          stream.conn.lossState.srtt,
+          stream.conn.transportSettings,
+          flowControlState.timeOfLastFlowControlUpdate,
+          updateTime)) {
+    return;
+  }
+  // A stream window larger than the connection's can't be used up anyway.
+  auto maxWindowSize = std::min(
+      stream.conn.transportSettings.maxReceiveStreamWindowSize,
+      stream.conn.flowControlState.windowSize);
+  if (flowControlState.windowSize >= maxWindowSize) {
+    return;
+  }
+  flowControlState.windowSize =
+      std::min(flowControlState.windowSize * 2, maxWindowSize);
+  VLOG(4) << "Grew stream window stream=" << stream.id
+          << " window=" << flowControlState.windowSize;
+}
+
+// The read offset the peer gets flow control credit for.
+inline uint64_t getCreditedReadOffset(const QuicStreamState& stream) {
+  DCHECK_GE(
+      stream.currentReadOffset, stream.flowControlState.unreleasedReadBytes);
+  return stream.currentReadOffset - stream.flowControlState.unreleasedReadBytes;
+}
+
 inline uint64_t calculateMaximumData(const QuicStreamState& stream) {
   return std::max(
-      stream.currentReadOffset + stream.flowControlState.windowSize,
+      getCreditedReadOffset(stream) + stream.flowControlState.windowSize,
       stream.flowControlState.advertisedMaxOffset);
 }
+
+std::chrono::microseconds getBlockedTime(
+    const folly::Optional<TimePoint>& blockedSince,
+    std::chrono::microseconds totalBlockedTime,
+    TimePoint now) {
+  if (blockedSince && now > *blockedSince) {
+    totalBlockedTime +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - *blockedSince);
+  }
+  return totalBlockedTime;
+}
 } // namespace
 
 bool maybeSendConnWindowUpdate(
     QuicConnectionStateBase& conn,
     TimePoint updateTime) {
+  auto& flowControlState = conn.flowControlState;
+  bool urgent = isWindowUpdateUrgent(
+      flowControlState.sumMaxObservedOffset,
+      flowControlState.advertisedMaxOffset,
+      flowControlState.windowSize);
   if (conn.pendingEvents.connWindowUpdate) {
     // There is a pending flow control event already, and no point sending
     // again.
+    conn.pendingEvents.urgentWindowUpdate |= urgent;
     return false;
   }
-  auto& flowControlState = conn.flowControlState;
   auto newAdvertisedOffset = calculateNewWindowUpdate(
       flowControlState.sumCurReadOffset,
       flowControlState.advertisedMaxOffset,
@@ -78,7 +218,10 @@ bool maybeSendConnWindowUpdate(
       flowControlState.timeOfLastFlowControlUpdate,
       updateTime);
   if (newAdvertisedOffset) {
+    // The frame is generated when it is written, with the tuned window.
+    autotuneConnWindow(conn, updateTime);
     conn.pendingEvents.connWindowUpdate = true;
+    conn.pendingEvents.urgentWindowUpdate |= urgent;
     QUIC_STATS(conn.infoCallback, onConnFlowControlUpdate);
     QUIC_TRACE(
         flow_control_event, conn, "tx_conn", newAdvertisedOffset.value());
@@ -94,11 +237,16 @@ bool maybeSendStreamWindowUpdate(
   if (!stream.shouldSendFlowControl()) {
     return false;
   }
+  bool urgent = isWindowUpdateUrgent(
+      stream.maxOffsetObserved,
+      flowControlState.advertisedMaxOffset,
+      flowControlState.windowSize);
   if (stream.conn.streamManager->pendingWindowUpdate(stream.id)) {
+    stream.conn.pendingEvents.urgentWindowUpdate |= urgent;
     return false;
   }
   auto newAdvertisedOffset = calculateNewWindowUpdate(
-      stream.currentReadOffset,
+      getCreditedReadOffset(stream),
       flowControlState.advertisedMaxOffset,
       flowControlState.windowSize,
       stream.conn.lossState.srtt,
@@ -106,9 +254,11 @@ bool maybeSendStreamWindowUpdate(
       flowControlState.timeOfLastFlowControlUpdate,
       updateTime);
   if (newAdvertisedOffset) {
+    autotuneStreamWindow(stream, updateTime);
     VLOG(10) << "Queued flow control update for stream=" << stream.id
              << " offset=" << *newAdvertisedOffset;
     stream.conn.streamManager->queueWindowUpdate(stream.id);
+    stream.conn.pendingEvents.urgentWindowUpdate |= urgent;
     QUIC_STATS(stream.conn.infoCallback, onStreamFlowControlUpdate);
     return true;
   }
@@ -141,14 +291,8 @@ void updateFlowControlOnStreamData(
       curMaxOffsetObserved - previousMaxOffsetObserved);
 }
 
-void updateFlowControlOnRead(
-    QuicStreamState& stream,
-    uint64_t lastReadOffset,
-    TimePoint readTime) {
-  DCHECK_GE(stream.currentReadOffset, lastReadOffset);
-  auto diff = stream.currentReadOffset - lastReadOffset;
-  incrementWithOverFlowCheck(
-      stream.conn.flowControlState.sumCurReadOffset, diff);
+namespace {
+void maybeSendWindowUpdatesOnRead(QuicStreamState& stream, TimePoint readTime) {
   if (maybeSendConnWindowUpdate(stream.conn, readTime)) {
     VLOG(4) << "Read trigger conn window update "
             << " readOffset=" << stream.conn.flowControlState.sumCurReadOffset
@@ -162,6 +306,29 @@ void updateFlowControlOnRead(
             << " window=" << stream.flowControlState.windowSize;
   }
 }
+} // namespace
+
+void updateFlowControlOnRead(
+    QuicStreamState& stream,
+    uint64_t lastReadOffset,
+    TimePoint readTime) {
+  DCHECK_GE(stream.currentReadOffset, lastReadOffset);
+  auto diff = stream.currentReadOffset - lastReadOffset;
+  incrementWithOverFlowCheck(
+      stream.conn.flowControlState.sumCurReadOffset, diff);
+  maybeSendWindowUpdatesOnRead(stream, readTime);
+}
+
+void updateFlowControlOnReadRelease(
+    QuicStreamState& stream,
+    uint64_t amount,
+    TimePoint releaseTime) {
+  DCHECK_GE(stream.flowControlState.unreleasedReadBytes, amount);
+  stream.flowControlState.unreleasedReadBytes -= amount;
+  incrementWithOverFlowCheck(
+      stream.conn.flowControlState.sumCurReadOffset, amount);
+  maybeSendWindowUpdatesOnRead(stream, releaseTime);
+}
 
 void updateFlowControlOnWriteToSocket(
     QuicStreamState& stream,
@@ -178,7 +345,15 @@ void updateFlowControlOnWriteToSocket(
         "conn_blocked",
         stream.id,
         stream.conn.flowControlState.sumCurWriteOffset);
+    QUIC_PROBE(
+        conn_blocked,
+        stream.conn,
+        stream.id,
+        stream.conn.flowControlState.sumCurWriteOffset);
     QUIC_STATS(stream.conn.infoCallback, onConnFlowControlBlocked);
+    if (!stream.conn.flowControlState.blockedSince) {
+      stream.conn.flowControlState.blockedSince = loopClockNow(stream.conn);
+    }
   }
 }
 
@@ -201,7 +376,15 @@ void maybeWriteBlockAfterAPIWrite(QuicStreamState& stream) {
         "stream_blocked",
         stream.id,
         stream.flowControlState.peerAdvertisedMaxOffset);
+    QUIC_PROBE(
+        stream_blocked,
+        stream.conn,
+        stream.id,
+        stream.flowControlState.peerAdvertisedMaxOffset);
     QUIC_STATS(stream.conn.infoCallback, onStreamFlowControlBlocked);
+    if (!stream.flowControlState.blockedSince) {
+      stream.flowControlState.blockedSince = loopClockNow(stream.conn);
+    }
   }
 }
 
@@ -222,7 +405,15 @@ void maybeWriteBlockAfterSocketWrite(QuicStreamState& stream) {
         "stream_blocked",
         stream.id,
         stream.flowControlState.peerAdvertisedMaxOffset);
+    QUIC_PROBE(
+        stream_blocked,
+        stream.conn,
+        stream.id,
+        stream.flowControlState.peerAdvertisedMaxOffset);
     QUIC_STATS(stream.conn.infoCallback, onStreamFlowControlBlocked);
+    if (!stream.flowControlState.blockedSince) {
+      stream.flowControlState.blockedSince = loopClockNow(stream.conn);
+    }
   }
 }
 
@@ -231,6 +422,14 @@ void handleStreamWindowUpdate(
     uint64_t maximumData,
     PacketNum packetNum) {
   if (stream.flowControlState.peerAdvertisedMaxOffset <= maximumData) {
+    if (stream.flowControlState.blockedSince &&
+        stream.flowControlState.peerAdvertisedMaxOffset < maximumData) {
+      stream.flowControlState.totalBlockedTime +=
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              loopClockNow(stream.conn) -
+              *stream.flowControlState.blockedSince);
+      stream.flowControlState.blockedSince = folly::none;
+    }
     stream.flowControlState.peerAdvertisedMaxOffset = maximumData;
     if (stream.flowControlState.peerAdvertisedMaxOffset >
         stream.currentWriteOffset + stream.writeBuffer.chainLength()) {
@@ -254,6 +453,13 @@ void handleConnWindowUpdate(
     const MaxDataFrame& frame,
     PacketNum packetNum) {
   if (conn.flowControlState.peerAdvertisedMaxOffset <= frame.maximumData) {
+    if (conn.flowControlState.blockedSince &&
+        conn.flowControlState.peerAdvertisedMaxOffset < frame.maximumData) {
+      conn.flowControlState.totalBlockedTime +=
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              loopClockNow(conn) - *conn.flowControlState.blockedSince);
+      conn.flowControlState.blockedSince = folly::none;
+    }
     conn.flowControlState.peerAdvertisedMaxOffset = frame.maximumData;
     QUIC_TRACE(
         flow_control_event, conn, "rx_conn", frame.maximumData, packetNum);
@@ -349,6 +555,7 @@ void onConnWindowUpdateSent(
   conn.flowControlState.advertisedMaxOffset = maximumDataSent;
   conn.flowControlState.timeOfLastFlowControlUpdate = sentTime;
   conn.pendingEvents.connWindowUpdate = false;
+  clearUrgentWindowUpdate(conn);
   VLOG(4) << "sent window for conn";
 }
 
@@ -362,11 +569,14 @@ void onStreamWindowUpdateSent(
   stream.flowControlState.advertisedMaxOffset = maximumDataSent;
   stream.flowControlState.timeOfLastFlowControlUpdate = sentTime;
   stream.conn.streamManager->removeWindowUpdate(stream.id);
+  clearUrgentWindowUpdate(stream.conn);
   VLOG(4) << "sent window for stream=" << stream.id;
 }
 
 void onConnWindowUpdateLost(QuicConnectionStateBase& conn) {
   conn.pendingEvents.connWindowUpdate = true;
+  // The peer might be waiting for it already.
+  conn.pendingEvents.urgentWindowUpdate = true;
   VLOG(4) << "Loss triggered conn window update";
 }
 
@@ -375,6 +585,7 @@ void onStreamWindowUpdateLost(QuicStreamState& stream) {
     return;
   }
   stream.conn.streamManager->queueWindowUpdate(stream.id);
+  stream.conn.pendingEvents.urgentWindowUpdate = true;
   VLOG(4) << "Loss triggered stream window update stream=" << stream.id;
 }
 
@@ -382,6 +593,24 @@ void onBlockedLost(QuicStreamState& stream) {
   maybeWriteBlockAfterSocketWrite(stream);
 }
 
+std::chrono::microseconds getConnFlowControlBlockedTime(
+    const QuicConnectionStateBase& conn,
+    TimePoint now) {
+  return getBlockedTime(
+      conn.flowControlState.blockedSince,
+      conn.flowControlState.totalBlockedTime,
+      now);
+}
+
+std::chrono::microseconds getStreamFlowControlBlockedTime(
+    const QuicStreamState& stream,
+    TimePoint now) {
+  return getBlockedTime(
+      stream.flowControlState.blockedSince,
+      stream.flowControlState.totalBlockedTime,
+      now);
+}
+
 void updateFlowControlList(QuicStreamState& stream) {
   stream.conn.streamManager->queueFlowControlUpdated(stream.id);
 }
@@ -395,6 +624,15 @@ void updateFlowControlStateWithSettings(
       transportSettings.advertisedInitialConnectionWindowSize;
 }
 
+void releaseReceiveWindowBudget(QuicConnectionStateBase& conn) {
+  if (conn.receiveWindowBudget) {
+    conn.receiveWindowBudget->release(
+        conn.flowControlState.reservedWindowBytes);
+  }
+  conn.flowControlState.reservedWindowBytes = 0;
+  conn.receiveWindowBudget = nullptr;
+}
+
 MaxDataFrame generateMaxDataFrame(const QuicConnectionStateBase& conn) {
   return MaxDataFrame(std::max(
       conn.flowControlState.sumCurReadOffset + conn.flowControlState.windowSize,
@@ -34,6 +34,15 @@ void updateFlowControlOnRead(
     uint64_t lastReadOffset,
     TimePoint readTime);
 
+/**
+ * Credits amount bytes that were read earlier without flow control credit,
+ * see readDataFromQuicStreamWithoutCredit.
+ */
+void updateFlowControlOnReadRelease(
+    QuicStreamState& stream,
+    uint64_t amount,
+    TimePoint releaseTime);
+
 void updateFlowControlOnWriteToSocket(QuicStreamState& stream, uint64_t length);
 
 void updateFlowControlOnWriteToStream(QuicStreamState& stream, uint64_t length);
@@ -116,6 +125,22 @@ uint64_t getRecvStreamFlowControlBytes(const QuicStreamState& stream);
  */
 uint64_t getRecvConnFlowControlBytes(const QuicConnectionStateBase& conn);
 
+/**
+ * Time the connection has spent blocked by the peer's flow control, up to now
+ * if it still is.
+ */
+std::chrono::microseconds getConnFlowControlBlockedTime(
+    const QuicConnectionStateBase& conn,
+    TimePoint now);
+
+/**
+ * Time the stream has spent blocked by the peer's flow control, up to now if
+ * it still is.
+ */
+std::chrono::microseconds getStreamFlowControlBlockedTime(
+    const QuicStreamState& stream,
+    TimePoint now);
+
 /**
  * Updates the flow control list with the stream. Callers should ensure that
  * this is only invoked when the flow control changes.
@@ -129,6 +154,12 @@ void updateFlowControlStateWithSettings(
     QuicConnectionStateBase::ConnectionFlowControlState& flowControlState,
     const TransportSettings& transportSettings);
 
+/**
+ * Gives the window growth of the connection back to its receive window budget
+ * and detaches it from the budget. The window keeps its size.
+ */
+void releaseReceiveWindowBudget(QuicConnectionStateBase& conn);
+
 /**
  * Generate a new MaxDataFrame with the latest flow control state and window
  * size of conn.
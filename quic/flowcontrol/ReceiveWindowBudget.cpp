@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/flowcontrol/ReceiveWindowBudget.h>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace quic {
+
+ReceiveWindowBudget::ReceiveWindowBudget(uint64_t maxBytes)
+    : maxBytes_(maxBytes) {}
+
+uint64_t ReceiveWindowBudget::reserve(uint64_t bytes) noexcept {
+  if (underMemoryPressure_ || reservedBytes_ >= maxBytes_) {
+    return 0;
+  }
+  auto reserved = std::min(bytes, maxBytes_ - reservedBytes_);
+  reservedBytes_ += reserved;
+  return reserved;
+}
+
+void ReceiveWindowBudget::release(uint64_t bytes) noexcept {
+  DCHECK_GE(reservedBytes_, bytes);
+  reservedBytes_ -= std::min(reservedBytes_, bytes);
+}
+
+void ReceiveWindowBudget::setMemoryPressure(bool underMemoryPressure) noexcept {
+  underMemoryPressure_ = underMemoryPressure;
+}
+
+} // namespace quic
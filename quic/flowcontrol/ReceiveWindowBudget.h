@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace quic {
+
+/**
+ * Bytes by which the connections of a server worker may grow their receive
+ * windows beyond the initial connection window, with
+ * TransportSettings::autotuneReceiveWindow. Under memory pressure no more bytes
+ * are handed out and the connections shrink their windows back at their next
+ * window update.
+ */
+class ReceiveWindowBudget {
+ public:
+  explicit ReceiveWindowBudget(uint64_t maxBytes);
+
+  ReceiveWindowBudget(const ReceiveWindowBudget&) = delete;
+  ReceiveWindowBudget& operator=(const ReceiveWindowBudget&) = delete;
+
+  /**
+   * Reserves up to bytes out of the budget, returns the number of bytes
+   * reserved, which is 0 under memory pressure.
+   */
+  uint64_t reserve(uint64_t bytes) noexcept;
+
+  void release(uint64_t bytes) noexcept;
+
+  void setMemoryPressure(bool underMemoryPressure) noexcept;
+
+  bool underMemoryPressure() const noexcept {
+    return underMemoryPressure_;
+  }
+
+  uint64_t getReservedBytes() const noexcept {
+    return reservedBytes_;
+  }
+
+  uint64_t getMaxBytes() const noexcept {
+    return maxBytes_;
+  }
+
+ private:
+  uint64_t maxBytes_;
+  uint64_t reservedBytes_{0};
+  bool underMemoryPressure_{false};
+};
+
+} // namespace quic
@@ -10,6 +10,7 @@
 #include <quic/client/state/ClientStateMachine.h>
 #include <quic/common/test/TestUtils.h>
 #include <quic/flowcontrol/QuicFlowController.h>
+#include <quic/flowcontrol/ReceiveWindowBudget.h>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -199,6 +200,31 @@ TEST_F(QuicFlowControlTest, MaybeSendStreamWindowUpdate) {
   EXPECT_TRUE(conn_.streamManager->pendingWindowUpdate(stream.id));
 }
 
+TEST_F(QuicFlowControlTest, StreamWindowUpdateUrgency) {
+  StreamId id = 3;
+  QuicStreamState stream(id, conn_);
+  stream.currentReadOffset = 300;
+  stream.maxOffsetObserved = 300;
+  stream.flowControlState.windowSize = 500;
+  stream.flowControlState.advertisedMaxOffset = 500;
+
+  // The peer still has plenty of window, the update can wait.
+  EXPECT_CALL(*transportInfoCb_, onStreamFlowControlUpdate()).Times(1);
+  EXPECT_TRUE(maybeSendStreamWindowUpdate(stream, Clock::now()));
+  EXPECT_FALSE(conn_.pendingEvents.urgentWindowUpdate);
+
+  // Close to being blocked, the queued update becomes urgent.
+  stream.maxOffsetObserved = 420;
+  EXPECT_FALSE(maybeSendStreamWindowUpdate(stream, Clock::now()));
+  EXPECT_TRUE(conn_.pendingEvents.urgentWindowUpdate);
+
+  onStreamWindowUpdateSent(stream, 1, 800, Clock::now());
+  EXPECT_FALSE(conn_.pendingEvents.urgentWindowUpdate);
+
+  onStreamWindowUpdateLost(stream);
+  EXPECT_TRUE(conn_.pendingEvents.urgentWindowUpdate);
+}
+
 TEST_F(QuicFlowControlTest, MaybeSendStreamWindowUpdateTimeElapsed) {
   StreamId id = 3;
   QuicStreamState stream(id, conn_);
@@ -697,6 +723,51 @@ TEST_F(QuicFlowControlTest, HandleConnWindowUpdate) {
   EXPECT_EQ(conn_.flowControlState.peerAdvertisedMaxOffset, 300);
 }
 
+TEST_F(QuicFlowControlTest, StreamFlowControlBlockedTime) {
+  StreamId id = 3;
+  QuicStreamState stream(id, conn_);
+  stream.currentWriteOffset = 400;
+  stream.flowControlState.peerAdvertisedMaxOffset = 400;
+  stream.writeBuffer.append(IOBuf::copyBuffer("1234"));
+  auto now = Clock::now();
+  EXPECT_EQ(0us, getStreamFlowControlBlockedTime(stream, now));
+
+  EXPECT_CALL(*transportInfoCb_, onStreamFlowControlBlocked());
+  maybeWriteBlockAfterSocketWrite(stream);
+  ASSERT_TRUE(stream.flowControlState.blockedSince);
+  auto blockedSince = *stream.flowControlState.blockedSince;
+  EXPECT_EQ(
+      10ms, getStreamFlowControlBlockedTime(stream, blockedSince + 10ms));
+
+  // The same offset doesn't unblock the stream.
+  handleStreamWindowUpdate(stream, 400, 2);
+  EXPECT_TRUE(stream.flowControlState.blockedSince);
+  handleStreamWindowUpdate(stream, 500, 3);
+  EXPECT_FALSE(stream.flowControlState.blockedSince);
+  auto blockedTime = stream.flowControlState.totalBlockedTime;
+  EXPECT_EQ(blockedTime, getStreamFlowControlBlockedTime(stream, now + 1s));
+}
+
+TEST_F(QuicFlowControlTest, ConnFlowControlBlockedTime) {
+  StreamId id = 3;
+  QuicStreamState stream(id, conn_);
+  conn_.flowControlState.peerAdvertisedMaxOffset = 400;
+  conn_.flowControlState.sumCurWriteOffset = 300;
+  conn_.flowControlState.sumCurStreamBufferLen = 100;
+
+  EXPECT_CALL(*transportInfoCb_, onConnFlowControlBlocked());
+  updateFlowControlOnWriteToSocket(stream, 100);
+  ASSERT_TRUE(conn_.flowControlState.blockedSince);
+  auto blockedSince = *conn_.flowControlState.blockedSince;
+  EXPECT_EQ(10ms, getConnFlowControlBlockedTime(conn_, blockedSince + 10ms));
+
+  handleConnWindowUpdate(conn_, MaxDataFrame(500), 2);
+  EXPECT_FALSE(conn_.flowControlState.blockedSince);
+  EXPECT_EQ(
+      conn_.flowControlState.totalBlockedTime,
+      getConnFlowControlBlockedTime(conn_, blockedSince + 1s));
+}
+
 TEST_F(QuicFlowControlTest, WritableList) {
   StreamId id = 3;
   QuicStreamState stream(id, conn_);
@@ -852,5 +923,111 @@ TEST_F(QuicFlowControlTest, OnStreamWindowUpdateSentWithoutPendingEvent) {
   EXPECT_FALSE(conn_.streamManager->pendingWindowUpdate(id));
 }
 
+TEST_F(QuicFlowControlTest, AutotuneConnWindowGrows) {
+  conn_.transportSettings.autotuneReceiveWindow = true;
+  conn_.transportSettings.maxReceiveConnectionWindowSize = 1500;
+  conn_.flowControlState.windowSize = 500;
+  conn_.flowControlState.advertisedMaxOffset = 400;
+  conn_.flowControlState.sumCurReadOffset = 300;
+  conn_.lossState.srtt = 100us;
+  auto lastUpdate = Clock::now();
+  conn_.flowControlState.timeOfLastFlowControlUpdate = lastUpdate;
+
+  // The window was used up within 2 rtts, it doubles.
+  EXPECT_CALL(*transportInfoCb_, onConnFlowControlUpdate()).Times(3);
+  EXPECT_TRUE(maybeSendConnWindowUpdate(conn_, lastUpdate + 100us));
+  EXPECT_EQ(1000, conn_.flowControlState.windowSize);
+  EXPECT_EQ(1300, generateMaxDataFrame(conn_).maximumData);
+  onConnWindowUpdateSent(conn_, 1, 1300, lastUpdate + 100us);
+
+  // Up to the max window size.
+  conn_.flowControlState.sumCurReadOffset = 1000;
+  EXPECT_TRUE(maybeSendConnWindowUpdate(conn_, lastUpdate + 200us));
+  EXPECT_EQ(1500, conn_.flowControlState.windowSize);
+  onConnWindowUpdateSent(conn_, 2, 2500, lastUpdate + 200us);
+
+  // Not when the update is only due after 2 rtts.
+  conn_.transportSettings.maxReceiveConnectionWindowSize = 10000;
+  conn_.flowControlState.sumCurReadOffset = 1100;
+  EXPECT_TRUE(maybeSendConnWindowUpdate(conn_, lastUpdate + 500us));
+  EXPECT_EQ(1500, conn_.flowControlState.windowSize);
+}
+
+TEST_F(QuicFlowControlTest, AutotuneConnWindowDisabled) {
+  conn_.flowControlState.windowSize = 500;
+  conn_.flowControlState.advertisedMaxOffset = 400;
+  conn_.flowControlState.sumCurReadOffset = 300;
+  conn_.lossState.srtt = 100us;
+  auto lastUpdate = Clock::now();
+  conn_.flowControlState.timeOfLastFlowControlUpdate = lastUpdate;
+  EXPECT_CALL(*transportInfoCb_, onConnFlowControlUpdate()).Times(1);
+  EXPECT_TRUE(maybeSendConnWindowUpdate(conn_, lastUpdate + 100us));
+  EXPECT_EQ(500, conn_.flowControlState.windowSize);
+}
+
+TEST_F(QuicFlowControlTest, AutotuneConnWindowBudget) {
+  ReceiveWindowBudget budget(300);
+  conn_.receiveWindowBudget = &budget;
+  conn_.transportSettings.autotuneReceiveWindow = true;
+  conn_.flowControlState.windowSize = 500;
+  conn_.flowControlState.advertisedMaxOffset = 400;
+  conn_.flowControlState.sumCurReadOffset = 300;
+  conn_.lossState.srtt = 100us;
+  auto lastUpdate = Clock::now();
+  conn_.flowControlState.timeOfLastFlowControlUpdate = lastUpdate;
+
+  // Only grows by what is left in the budget.
+  EXPECT_CALL(*transportInfoCb_, onConnFlowControlUpdate()).Times(2);
+  EXPECT_TRUE(maybeSendConnWindowUpdate(conn_, lastUpdate + 100us));
+  EXPECT_EQ(800, conn_.flowControlState.windowSize);
+  EXPECT_EQ(300, conn_.flowControlState.reservedWindowBytes);
+  EXPECT_EQ(300, budget.getReservedBytes());
+  onConnWindowUpdateSent(conn_, 1, 1100, lastUpdate + 100us);
+
+  // Under memory pressure, the growth is given back.
+  budget.setMemoryPressure(true);
+  conn_.flowControlState.sumCurReadOffset = 900;
+  EXPECT_TRUE(maybeSendConnWindowUpdate(conn_, lastUpdate + 200us));
+  EXPECT_EQ(500, conn_.flowControlState.windowSize);
+  EXPECT_EQ(0, conn_.flowControlState.reservedWindowBytes);
+  EXPECT_EQ(0, budget.getReservedBytes());
+}
+
+TEST_F(QuicFlowControlTest, ReleaseReceiveWindowBudget) {
+  ReceiveWindowBudget budget(1000);
+  EXPECT_EQ(600, budget.reserve(600));
+  EXPECT_EQ(400, budget.reserve(600));
+  EXPECT_EQ(0, budget.reserve(1));
+  conn_.receiveWindowBudget = &budget;
+  conn_.flowControlState.reservedWindowBytes = 600;
+  releaseReceiveWindowBudget(conn_);
+  EXPECT_EQ(400, budget.getReservedBytes());
+  EXPECT_EQ(0, conn_.flowControlState.reservedWindowBytes);
+  EXPECT_EQ(nullptr, conn_.receiveWindowBudget);
+}
+
+TEST_F(QuicFlowControlTest, AutotuneStreamWindow) {
+  conn_.transportSettings.autotuneReceiveWindow = true;
+  conn_.flowControlState.windowSize = 1500;
+  StreamId id = 4;
+  QuicStreamState stream(id, conn_);
+  stream.currentReadOffset = 300;
+  stream.flowControlState.windowSize = 500;
+  stream.flowControlState.advertisedMaxOffset = 400;
+  conn_.lossState.srtt = 100us;
+  auto lastUpdate = Clock::now();
+  stream.flowControlState.timeOfLastFlowControlUpdate = lastUpdate;
+
+  EXPECT_CALL(*transportInfoCb_, onStreamFlowControlUpdate()).Times(2);
+  EXPECT_TRUE(maybeSendStreamWindowUpdate(stream, lastUpdate + 100us));
+  EXPECT_EQ(1000, stream.flowControlState.windowSize);
+  onStreamWindowUpdateSent(stream, 1, 1300, lastUpdate + 100us);
+
+  // Capped at the connection window.
+  stream.currentReadOffset = 1000;
+  EXPECT_TRUE(maybeSendStreamWindowUpdate(stream, lastUpdate + 200us));
+  EXPECT_EQ(1500, stream.flowControlState.windowSize);
+}
+
 } // namespace test
 } // namespace quic
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <folly/Optional.h>
+#include <folly/Range.h>
 #include <folly/io/IOBuf.h>
 
 namespace quic {
@@ -18,6 +19,15 @@ struct TrafficKey {
   std::unique_ptr<folly::IOBuf> iv;
 };
 
+/**
+ * One packet of a batch passed to Aead::encryptBatch.
+ */
+struct AeadBatchEntry {
+  // plaintext on input, replaced by the ciphertext.
+  std::unique_ptr<folly::IOBuf> data;
+  const folly::IOBuf* associatedData{nullptr};
+};
+
 /**
  * Interface for aead algorithms (RFC 5116).
  */
@@ -33,6 +43,21 @@ class Aead {
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const = 0;
 
+  /**
+   * Encrypts a batch of plaintexts in place, entry i uses the sequence number
+   * firstSeqNum + i. Backends that can interleave several packets, such as
+   * multi-buffer AES-GCM, should override this. The default encrypts the
+   * entries one at a time. Will throw on error.
+   */
+  virtual void encryptBatch(
+      folly::Range<AeadBatchEntry*> entries,
+      uint64_t firstSeqNum) const {
+    for (auto& entry : entries) {
+      entry.data =
+          encrypt(std::move(entry.data), entry.associatedData, firstSeqNum++);
+    }
+  }
+
   /**
    * Decrypt ciphertext. Will throw if the ciphertext does not decrypt
    * successfully.
@@ -57,6 +82,28 @@ class Aead {
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const = 0;
 
+  /**
+   * Decrypts ciphertext in place, overwriting it with the plaintext and
+   * trimming the tag, so the plaintext stays in the receive buffer. Returns
+   * false if the ciphertext does not decrypt successfully, in which case the
+   * contents of ciphertext are unspecified. May still throw from errors
+   * unrelated to ciphertext.
+   *
+   * The default goes through tryDecrypt, which decrypts in place as long as
+   * ciphertext is not shared.
+   */
+  virtual bool tryDecryptInPlace(
+      std::unique_ptr<folly::IOBuf>& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const {
+    auto plaintext = tryDecrypt(std::move(ciphertext), associatedData, seqNum);
+    if (!plaintext) {
+      return false;
+    }
+    ciphertext = std::move(*plaintext);
+    return true;
+  }
+
   /**
    * Returns the number of bytes the aead will add to the plaintext (size of
    * ciphertext - size of plaintext).
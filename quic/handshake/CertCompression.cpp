@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/CertCompression.h>
+
+#include <fizz/compression/BrotliCertificateCompressor.h>
+#include <fizz/compression/BrotliCertificateDecompressor.h>
+#include <fizz/compression/ZlibCertificateCompressor.h>
+#include <fizz/compression/ZlibCertificateDecompressor.h>
+#include <quic/QuicConstants.h>
+
+namespace quic {
+
+std::vector<std::shared_ptr<fizz::CertificateCompressor>>
+makeDefaultCertCompressors() {
+  return {std::make_shared<fizz::BrotliCertificateCompressor>(),
+          std::make_shared<fizz::ZlibCertificateCompressor>(
+              kCertCompressionZlibLevel)};
+}
+
+std::shared_ptr<fizz::CertDecompressionManager>
+getDefaultCertDecompressionManager() {
+  static auto manager = [] {
+    auto decompressionManager =
+        std::make_shared<fizz::CertDecompressionManager>();
+    decompressionManager->setDecompressors(
+        {std::make_shared<fizz::BrotliCertificateDecompressor>(),
+         std::make_shared<fizz::ZlibCertificateDecompressor>()});
+    return decompressionManager;
+  }();
+  return manager;
+}
+
+} // namespace quic
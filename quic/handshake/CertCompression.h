@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <fizz/compression/CertDecompressionManager.h>
+#include <fizz/compression/CertificateCompressor.h>
+
+#include <memory>
+#include <vector>
+
+namespace quic {
+
+/**
+ * TLS certificate compression (RFC 8879). A 4KB chain takes several packets,
+ * and before the client address is validated the server can only send three
+ * times what it received, so an uncompressed chain often costs a round trip.
+ */
+
+// Brotli and zlib compressors, in order of preference.
+std::vector<std::shared_ptr<fizz::CertificateCompressor>>
+makeDefaultCertCompressors();
+
+// Brotli and zlib decompressors, shared by every client connection.
+std::shared_ptr<fizz::CertDecompressionManager>
+getDefaultCertDecompressionManager();
+
+} // namespace quic
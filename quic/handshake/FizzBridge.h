@@ -10,6 +10,7 @@
 
 #include <fizz/crypto/aead/Aead.h>
 #include <fizz/protocol/Types.h>
+#include <folly/Function.h>
 #include <quic/QuicConstants.h>
 #include <quic/handshake/Aead.h>
 
@@ -29,6 +30,28 @@ class FizzAead final : public Aead {
     return std::unique_ptr<FizzAead>(new FizzAead(std::move(fizzAeadIn)));
   }
 
+  using ReleaseCallback = folly::Function<void(std::unique_ptr<fizz::Aead>)>;
+
+  /**
+   * Same as above, the fizz aead is handed to onRelease instead of being
+   * destroyed with the FizzAead, so that it can be re-keyed and reused.
+   */
+  static std::unique_ptr<FizzAead> wrap(
+      std::unique_ptr<fizz::Aead> fizzAeadIn,
+      ReleaseCallback onRelease) {
+    auto aead = wrap(std::move(fizzAeadIn));
+    if (aead) {
+      aead->onRelease_ = std::move(onRelease);
+    }
+    return aead;
+  }
+
+  ~FizzAead() override {
+    if (onRelease_) {
+      onRelease_(std::move(fizzAead));
+    }
+  }
+
   /**
    * Simply forward all calls to fizz::Aead.
    */
@@ -61,6 +84,7 @@ class FizzAead final : public Aead {
 
  private:
   std::unique_ptr<fizz::Aead> fizzAead;
+  ReleaseCallback onRelease_;
   FizzAead(std::unique_ptr<fizz::Aead> fizzAeadIn)
       : fizzAead(std::move(fizzAeadIn)) {}
 };
@@ -16,18 +16,18 @@
 
 namespace quic {
 
+namespace {
+
 Buf makeInitialTrafficSecret(
-    fizz::Factory* factory,
+    fizz::KeyDerivation& deriver,
     folly::StringPiece label,
     const ConnectionId& clientDestinationConnId,
     QuicVersion version) {
-  auto deriver =
-      factory->makeKeyDeriver(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
   auto connIdRange = folly::range(clientDestinationConnId);
   auto salt =
       version == QuicVersion::MVFST_OLD ? kQuicDraft17Salt : kQuicDraft22Salt;
-  auto initialSecret = deriver->hkdfExtract(salt, connIdRange);
-  auto trafficSecret = deriver->expandLabel(
+  auto initialSecret = deriver.hkdfExtract(salt, connIdRange);
+  auto trafficSecret = deriver.expandLabel(
       folly::range(initialSecret),
       label,
       folly::IOBuf::create(0),
@@ -35,6 +35,19 @@ Buf makeInitialTrafficSecret(
   return trafficSecret;
 }
 
+} // namespace
+
+Buf makeInitialTrafficSecret(
+    fizz::Factory* factory,
+    folly::StringPiece label,
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  auto deriver =
+      factory->makeKeyDeriver(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
+  return makeInitialTrafficSecret(
+      *deriver, label, clientDestinationConnId, version);
+}
+
 Buf makeServerInitialTrafficSecret(
     fizz::Factory* factory,
     const ConnectionId& clientDestinationConnId,
@@ -51,29 +64,43 @@ Buf makeClientInitialTrafficSecret(
       factory, kClientInitialLabel, clientDestinationConnId, version);
 }
 
-std::unique_ptr<Aead> makeInitialAead(
+fizz::TrafficKey makeInitialTrafficKey(
     fizz::Factory* factory,
     folly::StringPiece label,
     const ConnectionId& clientDestinationConnId,
-    QuicVersion version) {
-  auto trafficSecret = makeInitialTrafficSecret(
-      factory, label, clientDestinationConnId, version);
+    QuicVersion version,
+    size_t keyLength,
+    size_t ivLength) {
   auto deriver =
       factory->makeKeyDeriver(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
-  auto aead = factory->makeAead(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
+  auto trafficSecret = makeInitialTrafficSecret(
+      *deriver, label, clientDestinationConnId, version);
   auto key = deriver->expandLabel(
       trafficSecret->coalesce(),
       kQuicKeyLabel,
       folly::IOBuf::create(0),
-      aead->keyLength());
+      keyLength);
   auto iv = deriver->expandLabel(
       trafficSecret->coalesce(),
       kQuicIVLabel,
       folly::IOBuf::create(0),
-      aead->ivLength());
+      ivLength);
+  return {std::move(key), std::move(iv)};
+}
 
-  fizz::TrafficKey trafficKey = {std::move(key), std::move(iv)};
-  aead->setKey(std::move(trafficKey));
+std::unique_ptr<Aead> makeInitialAead(
+    fizz::Factory* factory,
+    folly::StringPiece label,
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  auto aead = factory->makeAead(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
+  aead->setKey(makeInitialTrafficKey(
+      factory,
+      label,
+      clientDestinationConnId,
+      version,
+      aead->keyLength(),
+      aead->ivLength()));
   return FizzAead::wrap(std::move(aead));
 }
 
@@ -45,6 +45,18 @@ constexpr folly::StringPiece kQuicDraft22Salt =
 constexpr folly::StringPiece kClientInitialLabel = "client in";
 constexpr folly::StringPiece kServerInitialLabel = "server in";
 
+/**
+ * Derives the key and iv of the Initial aead for label, with a single key
+ * deriver for the traffic secret and the key schedule.
+ */
+fizz::TrafficKey makeInitialTrafficKey(
+    fizz::Factory* factory,
+    folly::StringPiece label,
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version,
+    size_t keyLength,
+    size_t ivLength);
+
 // TODO remove version parameter when we don't need to support MVFST_OLD anymore
 std::unique_ptr<Aead> makeInitialAead(
     fizz::Factory* factory,
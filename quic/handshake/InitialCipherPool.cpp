@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/InitialCipherPool.h>
+
+#include <quic/handshake/FizzBridge.h>
+#include <quic/handshake/HandshakeLayer.h>
+
+namespace quic {
+
+InitialCipherPool::InitialCipherPool(size_t maxSize) : maxSize_(maxSize) {}
+
+std::unique_ptr<Aead> InitialCipherPool::makeInitialAead(
+    fizz::Factory* factory,
+    folly::StringPiece label,
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  std::unique_ptr<fizz::Aead> aead;
+  if (aeads_.empty()) {
+    aead = factory->makeAead(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
+  } else {
+    aead = std::move(aeads_.back());
+    aeads_.pop_back();
+  }
+  aead->setKey(makeInitialTrafficKey(
+      factory,
+      label,
+      clientDestinationConnId,
+      version,
+      aead->keyLength(),
+      aead->ivLength()));
+  std::weak_ptr<InitialCipherPool> weakPool = shared_from_this();
+  return FizzAead::wrap(
+      std::move(aead),
+      [weakPool = std::move(weakPool)](std::unique_ptr<fizz::Aead> released) {
+        auto pool = weakPool.lock();
+        if (pool) {
+          pool->release(std::move(released));
+        }
+      });
+}
+
+std::unique_ptr<Aead> InitialCipherPool::getClientInitialCipher(
+    fizz::Factory* factory,
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  return makeInitialAead(
+      factory, kClientInitialLabel, clientDestinationConnId, version);
+}
+
+std::unique_ptr<Aead> InitialCipherPool::getServerInitialCipher(
+    fizz::Factory* factory,
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  return makeInitialAead(
+      factory, kServerInitialLabel, clientDestinationConnId, version);
+}
+
+size_t InitialCipherPool::size() const {
+  return aeads_.size();
+}
+
+void InitialCipherPool::release(std::unique_ptr<fizz::Aead> aead) {
+  if (aead && aeads_.size() < maxSize_) {
+    aeads_.push_back(std::move(aead));
+  }
+}
+
+} // namespace quic
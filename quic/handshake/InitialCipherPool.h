@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <fizz/crypto/aead/Aead.h>
+#include <fizz/protocol/Factory.h>
+
+#include <quic/QuicConstants.h>
+#include <quic/codec/QuicConnectionId.h>
+#include <quic/handshake/Aead.h>
+
+#include <memory>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Reuses the aeads of the Initial ciphers across connections.
+ *
+ * Every connection makes an Initial read and write cipher, and drops them
+ * shortly after the handshake. Instead of allocating and initializing a new
+ * cipher context each time, the ciphers made by the pool hand their fizz aead
+ * back to it when destroyed, and the next Initial cipher re-keys one of those.
+ * The pool keeps up to maxSize of them.
+ *
+ * Must be owned by a shared_ptr, the ciphers only hold a weak reference and
+ * outliving the pool is fine. Not thread safe: the pool and its ciphers are
+ * used on the thread of the connections, such as a server worker's.
+ */
+class InitialCipherPool
+    : public std::enable_shared_from_this<InitialCipherPool> {
+ public:
+  explicit InitialCipherPool(size_t maxSize = kDefaultInitialCipherPoolSize);
+
+  // Same as makeInitialAead in HandshakeLayer.h, with a pooled aead.
+  std::unique_ptr<Aead> makeInitialAead(
+      fizz::Factory* factory,
+      folly::StringPiece label,
+      const ConnectionId& clientDestinationConnId,
+      QuicVersion version);
+
+  std::unique_ptr<Aead> getClientInitialCipher(
+      fizz::Factory* factory,
+      const ConnectionId& clientDestinationConnId,
+      QuicVersion version);
+
+  std::unique_ptr<Aead> getServerInitialCipher(
+      fizz::Factory* factory,
+      const ConnectionId& clientDestinationConnId,
+      QuicVersion version);
+
+  // Released aeads waiting to be reused.
+  size_t size() const;
+
+ private:
+  void release(std::unique_ptr<fizz::Aead> aead);
+
+  size_t maxSize_;
+  std::vector<std::unique_ptr<fizz::Aead>> aeads_;
+};
+
+} // namespace quic
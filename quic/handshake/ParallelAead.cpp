@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/ParallelAead.h>
+
+#include <folly/ExceptionWrapper.h>
+#include <folly/synchronization/Baton.h>
+#include <glog/logging.h>
+
+#include <atomic>
+
+namespace quic {
+
+ParallelAead::ParallelAead(
+    std::unique_ptr<Aead> aead,
+    std::vector<std::unique_ptr<Aead>> helperAeads,
+    std::shared_ptr<folly::Executor> executor,
+    size_t minPacketsPerHelper)
+    : aead_(std::move(aead)),
+      helperAeads_(std::move(helperAeads)),
+      executor_(std::move(executor)),
+      minPacketsPerHelper_(std::max<size_t>(minPacketsPerHelper, 1)) {
+  CHECK(aead_);
+  CHECK(executor_ || helperAeads_.empty());
+  for (const auto& helperAead : helperAeads_) {
+    CHECK(helperAead);
+    CHECK_EQ(helperAead->getCipherOverhead(), aead_->getCipherOverhead());
+  }
+}
+
+std::unique_ptr<folly::IOBuf> ParallelAead::encrypt(
+    std::unique_ptr<folly::IOBuf>&& plaintext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  return aead_->encrypt(std::move(plaintext), associatedData, seqNum);
+}
+
+void ParallelAead::encryptBatch(
+    folly::Range<AeadBatchEntry*> entries,
+    uint64_t firstSeqNum) const {
+  auto numChunks = std::min(
+      helperAeads_.size() + 1, entries.size() / minPacketsPerHelper_);
+  if (numChunks <= 1) {
+    aead_->encryptBatch(entries, firstSeqNum);
+    return;
+  }
+  // The first chunks take the remainder, one packet each.
+  auto chunkSize = entries.size() / numChunks;
+  auto remainder = entries.size() % numChunks;
+  auto chunkEnd = [&](size_t chunk) {
+    return (chunk + 1) * chunkSize + std::min(chunk + 1, remainder);
+  };
+
+  std::atomic<size_t> pending{numChunks - 1};
+  folly::Baton<> done;
+  std::vector<folly::exception_wrapper> errors(numChunks);
+  for (size_t chunk = 1; chunk < numChunks; ++chunk) {
+    auto begin = chunkEnd(chunk - 1);
+    auto end = chunkEnd(chunk);
+    executor_->add([&, chunk, begin, end] {
+      try {
+        helperAeads_[chunk - 1]->encryptBatch(
+            entries.subpiece(begin, end - begin), firstSeqNum + begin);
+      } catch (const std::exception& ex) {
+        errors[chunk] = folly::exception_wrapper(std::current_exception(), ex);
+      }
+      if (--pending == 0) {
+        done.post();
+      }
+    });
+  }
+  try {
+    aead_->encryptBatch(entries.subpiece(0, chunkEnd(0)), firstSeqNum);
+  } catch (const std::exception& ex) {
+    errors[0] = folly::exception_wrapper(std::current_exception(), ex);
+  }
+  // The helpers reference the entries, wait for them before throwing.
+  done.wait();
+  for (auto& error : errors) {
+    if (error) {
+      error.throw_exception();
+    }
+  }
+}
+
+std::unique_ptr<folly::IOBuf> ParallelAead::decrypt(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  return aead_->decrypt(std::move(ciphertext), associatedData, seqNum);
+}
+
+folly::Optional<std::unique_ptr<folly::IOBuf>> ParallelAead::tryDecrypt(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  return aead_->tryDecrypt(std::move(ciphertext), associatedData, seqNum);
+}
+
+bool ParallelAead::tryDecryptInPlace(
+    std::unique_ptr<folly::IOBuf>& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  return aead_->tryDecryptInPlace(ciphertext, associatedData, seqNum);
+}
+
+size_t ParallelAead::getCipherOverhead() const {
+  return aead_->getCipherOverhead();
+}
+
+} // namespace quic
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Executor.h>
+#include <quic/QuicConstants.h>
+#include <quic/handshake/Aead.h>
+
+#include <memory>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Aead that spreads the packets of a batch over helper threads, so that the
+ * encryption of a single connection isn't bound to the thread that owns it.
+ *
+ * The batch is split in contiguous chunks, one encrypted inline with the
+ * wrapped aead and the others on executor, each with its own helper aead
+ * keyed like the wrapped one, since aeads keep per call state. encryptBatch
+ * returns once every chunk is done, with the entries still in their order,
+ * so the packets are written in packet number order as before. Single
+ * packets and decryption stay on the calling thread.
+ */
+class ParallelAead : public Aead {
+ public:
+  ParallelAead(
+      std::unique_ptr<Aead> aead,
+      std::vector<std::unique_ptr<Aead>> helperAeads,
+      std::shared_ptr<folly::Executor> executor,
+      size_t minPacketsPerHelper = kDefaultMinPacketsPerEncryptHelper);
+
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  void encryptBatch(folly::Range<AeadBatchEntry*> entries, uint64_t firstSeqNum)
+      const override;
+
+  std::unique_ptr<folly::IOBuf> decrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  bool tryDecryptInPlace(
+      std::unique_ptr<folly::IOBuf>& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  size_t getCipherOverhead() const override;
+
+ private:
+  std::unique_ptr<Aead> aead_;
+  std::vector<std::unique_ptr<Aead>> helperAeads_;
+  std::shared_ptr<folly::Executor> executor_;
+  size_t minPacketsPerHelper_;
+};
+
+} // namespace quic
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/InitialCipherPool.h>
+
+#include <gtest/gtest.h>
+
+#include <quic/common/test/TestUtils.h>
+#include <quic/handshake/HandshakeLayer.h>
+#include <quic/handshake/QuicFizzFactory.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class InitialCipherPoolTest : public Test {
+ protected:
+  // Whether what encryptor encrypts, decryptor decrypts.
+  bool roundTrips(const Aead& encryptor, const Aead& decryptor) {
+    auto aad = IOBuf::copyBuffer("header");
+    auto ciphertext =
+        encryptor.encrypt(IOBuf::copyBuffer("initial"), aad.get(), 7);
+    auto plaintext = decryptor.tryDecrypt(std::move(ciphertext), aad.get(), 7);
+    return plaintext &&
+        (*plaintext)->moveToFbString().toStdString() == "initial";
+  }
+
+  QuicFizzFactory factory_;
+  QuicVersion version_{QuicVersion::MVFST};
+};
+
+TEST_F(InitialCipherPoolTest, SameKeysAsUnpooled) {
+  auto pool = std::make_shared<InitialCipherPool>();
+  auto connId = getTestConnectionId(1);
+  auto pooled = pool->getServerInitialCipher(&factory_, connId, version_);
+  auto unpooled = getServerInitialCipher(&factory_, connId, version_);
+  EXPECT_TRUE(roundTrips(*pooled, *unpooled));
+  EXPECT_TRUE(roundTrips(*unpooled, *pooled));
+  auto client = pool->getClientInitialCipher(&factory_, connId, version_);
+  EXPECT_FALSE(roundTrips(*client, *unpooled));
+}
+
+TEST_F(InitialCipherPoolTest, ReleasedAeadRekeyed) {
+  auto pool = std::make_shared<InitialCipherPool>();
+  auto first = pool->getServerInitialCipher(
+      &factory_, getTestConnectionId(1), version_);
+  EXPECT_EQ(0, pool->size());
+  first.reset();
+  EXPECT_EQ(1, pool->size());
+
+  auto connId = getTestConnectionId(2);
+  auto second = pool->getServerInitialCipher(&factory_, connId, version_);
+  EXPECT_EQ(0, pool->size());
+  auto unpooled = getServerInitialCipher(&factory_, connId, version_);
+  EXPECT_TRUE(roundTrips(*second, *unpooled));
+}
+
+TEST_F(InitialCipherPoolTest, Bounded) {
+  auto pool = std::make_shared<InitialCipherPool>(2);
+  std::vector<std::unique_ptr<Aead>> ciphers;
+  for (int i = 0; i < 4; i++) {
+    ciphers.push_back(pool->getClientInitialCipher(
+        &factory_, getTestConnectionId(i), version_));
+  }
+  ciphers.clear();
+  EXPECT_EQ(2, pool->size());
+}
+
+TEST_F(InitialCipherPoolTest, CipherOutlivesPool) {
+  auto pool = std::make_shared<InitialCipherPool>();
+  auto cipher = pool->getClientInitialCipher(
+      &factory_, getTestConnectionId(1), version_);
+  pool.reset();
+  auto unpooled =
+      getClientInitialCipher(&factory_, getTestConnectionId(1), version_);
+  EXPECT_TRUE(roundTrips(*cipher, *unpooled));
+  cipher.reset();
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/ParallelAead.h>
+
+#include <gtest/gtest.h>
+
+#include <folly/Conv.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/handshake/HandshakeLayer.h>
+#include <quic/handshake/QuicFizzFactory.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class ParallelAeadTest : public Test {
+ protected:
+  std::unique_ptr<Aead> makeAead() {
+    return getClientInitialCipher(&factory_, getTestConnectionId(1), version_);
+  }
+
+  std::unique_ptr<ParallelAead> makeParallelAead(size_t numHelpers) {
+    std::vector<std::unique_ptr<Aead>> helperAeads;
+    for (size_t i = 0; i < numHelpers; ++i) {
+      helperAeads.push_back(makeAead());
+    }
+    return std::make_unique<ParallelAead>(
+        makeAead(), std::move(helperAeads), executor_, 2);
+  }
+
+  QuicFizzFactory factory_;
+  QuicVersion version_{QuicVersion::MVFST};
+  std::shared_ptr<CPUThreadPoolExecutor> executor_{
+      std::make_shared<CPUThreadPoolExecutor>(3)};
+};
+
+TEST_F(ParallelAeadTest, SameCiphertextsAsSerial) {
+  auto serial = makeAead();
+  auto parallel = makeParallelAead(3);
+  // Not a multiple of the number of chunks, the first chunks get one more.
+  constexpr size_t kNumPackets = 11;
+  constexpr uint64_t kFirstSeqNum = 100;
+  std::vector<std::unique_ptr<IOBuf>> headers;
+  std::vector<AeadBatchEntry> entries(kNumPackets);
+  for (size_t i = 0; i < kNumPackets; ++i) {
+    headers.push_back(IOBuf::copyBuffer(folly::to<std::string>("header", i)));
+    entries[i].data = IOBuf::copyBuffer(folly::to<std::string>("packet", i));
+    entries[i].associatedData = headers.back().get();
+  }
+  parallel->encryptBatch(folly::range(entries), kFirstSeqNum);
+
+  IOBufEqualTo eq;
+  for (size_t i = 0; i < kNumPackets; ++i) {
+    auto expected = serial->encrypt(
+        IOBuf::copyBuffer(folly::to<std::string>("packet", i)),
+        headers[i].get(),
+        kFirstSeqNum + i);
+    EXPECT_TRUE(eq(*expected, *entries[i].data)) << "packet " << i;
+  }
+}
+
+TEST_F(ParallelAeadTest, SmallBatchNoHelpers) {
+  auto serial = makeAead();
+  auto parallel = makeParallelAead(0);
+  auto header = IOBuf::copyBuffer("header");
+  std::vector<AeadBatchEntry> entries(4);
+  for (auto& entry : entries) {
+    entry.data = IOBuf::copyBuffer("packet");
+    entry.associatedData = header.get();
+  }
+  parallel->encryptBatch(folly::range(entries), 0);
+  auto plaintext = serial->tryDecrypt(
+      std::move(entries.back().data), header.get(), entries.size() - 1);
+  ASSERT_TRUE(plaintext.hasValue());
+  EXPECT_EQ((*plaintext)->moveToFbString().toStdString(), "packet");
+}
+
+} // namespace test
+} // namespace quic
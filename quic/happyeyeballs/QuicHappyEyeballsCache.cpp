@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/happyeyeballs/QuicHappyEyeballsCache.h>
+
+namespace quic {
+
+QuicHappyEyeballsCache::QuicHappyEyeballsCache(
+    std::chrono::seconds ttl,
+    size_t maxEntries)
+    : ttl_(ttl), entries_(maxEntries) {}
+
+folly::Optional<folly::SocketAddress> QuicHappyEyeballsCache::get(
+    const std::string& hostname,
+    TimePoint now) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = entries_.find(hostname);
+  if (it == entries_.end()) {
+    return folly::none;
+  }
+  if (now - it->second.updateTime > ttl_) {
+    entries_.erase(hostname);
+    return folly::none;
+  }
+  return it->second.address;
+}
+
+void QuicHappyEyeballsCache::put(
+    const std::string& hostname,
+    const folly::SocketAddress& address,
+    TimePoint now) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  entries_.set(hostname, Entry{address, now});
+}
+
+void QuicHappyEyeballsCache::remove(const std::string& hostname) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  entries_.erase(hostname);
+}
+
+size_t QuicHappyEyeballsCache::size() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return entries_.size();
+}
+
+} // namespace quic
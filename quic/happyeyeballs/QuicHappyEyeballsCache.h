@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <mutex>
+#include <string>
+
+namespace quic {
+
+/**
+ * Thread safe cache of the peer address happy eyeballs settled on, per
+ * hostname, to share across client connections. A connection to a hostname
+ * with a fresh entry connects to that address right away, without racing the
+ * other address family.
+ *
+ * Entries expire ttl after they were last put, and the least recently used
+ * one is evicted beyond maxEntries.
+ */
+class QuicHappyEyeballsCache {
+ public:
+  explicit QuicHappyEyeballsCache(
+      std::chrono::seconds ttl = kDefaultHappyEyeballsCacheTtl,
+      size_t maxEntries = kDefaultHappyEyeballsCacheSize);
+
+  /**
+   * Returns the address cached for hostname if it has not expired by now.
+   */
+  folly::Optional<folly::SocketAddress> get(
+      const std::string& hostname,
+      TimePoint now = Clock::now());
+
+  void put(
+      const std::string& hostname,
+      const folly::SocketAddress& address,
+      TimePoint now = Clock::now());
+
+  void remove(const std::string& hostname);
+
+  size_t size() const;
+
+ private:
+  struct Entry {
+    folly::SocketAddress address;
+    TimePoint updateTime;
+  };
+
+  const std::chrono::seconds ttl_;
+  mutable std::mutex mutex_;
+  folly::EvictingCacheMap<std::string, Entry> entries_;
+};
+
+} // namespace quic
@@ -189,9 +189,14 @@ void happyEyeballsOnDataReceived(
   // If second socket won, update main socket and peerAddress
   if (connection.peerAddress.getFamily() != peerAddress.getFamily()) {
     socket.swap(connection.happyEyeballsState.secondSocket);
+    connection.happyEyeballsState.secondPeerAddress = connection.peerAddress;
     connection.originalPeerAddress = peerAddress;
     connection.peerAddress = peerAddress;
   }
+  // The losing socket is left to the transport to keep as a standby path.
+  if (connection.transportSettings.standbyPathEnabled) {
+    return;
+  }
   connection.happyEyeballsState.secondSocket->pauseRead();
   connection.happyEyeballsState.secondSocket->close();
   connection.happyEyeballsState.secondSocket.reset();
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/happyeyeballs/QuicHappyEyeballsCache.h>
+
+#include <gtest/gtest.h>
+
+using namespace quic;
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+TEST(QuicHappyEyeballsCacheTest, PutGetRemove) {
+  QuicHappyEyeballsCache cache;
+  folly::SocketAddress v4("127.0.0.1", 443);
+  folly::SocketAddress v6("::1", 443);
+  EXPECT_FALSE(cache.get("a.com").hasValue());
+  cache.put("a.com", v6);
+  cache.put("b.com", v4);
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(v6, *cache.get("a.com"));
+  EXPECT_EQ(v4, *cache.get("b.com"));
+
+  // The latest winner replaces the entry.
+  cache.put("a.com", v4);
+  EXPECT_EQ(v4, *cache.get("a.com"));
+
+  cache.remove("a.com");
+  EXPECT_FALSE(cache.get("a.com").hasValue());
+  EXPECT_EQ(1, cache.size());
+}
+
+TEST(QuicHappyEyeballsCacheTest, Expires) {
+  QuicHappyEyeballsCache cache(std::chrono::seconds(10));
+  folly::SocketAddress v6("::1", 443);
+  auto now = Clock::now();
+  cache.put("a.com", v6, now);
+  EXPECT_TRUE(cache.get("a.com", now + std::chrono::seconds(10)).hasValue());
+  EXPECT_FALSE(cache.get("a.com", now + std::chrono::seconds(11)).hasValue());
+  // Expired entries are dropped when they are looked up.
+  EXPECT_EQ(0, cache.size());
+}
+
+TEST(QuicHappyEyeballsCacheTest, EvictsLeastRecentlyUsed) {
+  QuicHappyEyeballsCache cache(kDefaultHappyEyeballsCacheTtl, 2);
+  folly::SocketAddress v6("::1", 443);
+  cache.put("a.com", v6);
+  cache.put("b.com", v6);
+  EXPECT_TRUE(cache.get("a.com").hasValue());
+  cache.put("c.com", v6);
+  EXPECT_EQ(2, cache.size());
+  EXPECT_TRUE(cache.get("a.com").hasValue());
+  EXPECT_FALSE(cache.get("b.com").hasValue());
+  EXPECT_TRUE(cache.get("c.com").hasValue());
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,787 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/logging/BinaryQLogger.h>
+
+#include <folly/io/Cursor.h>
+#include <folly/lang/Bits.h>
+#include <quic/codec/QuicInteger.h>
+
+#include <algorithm>
+#include <typeinfo>
+
+namespace quic {
+
+namespace {
+
+enum class FrameTag : uint8_t {
+  Padding = 0,
+  RstStream = 1,
+  ConnectionClose = 2,
+  ApplicationClose = 3,
+  MaxData = 4,
+  MaxStreamData = 5,
+  MaxStreams = 6,
+  StreamsBlocked = 7,
+  Ping = 8,
+  DataBlocked = 9,
+  StreamDataBlocked = 10,
+  Ack = 11,
+  Stream = 12,
+  Crypto = 13,
+  StopSending = 14,
+  MinStreamData = 15,
+  ExpiredStreamData = 16,
+  PathChallenge = 17,
+  PathResponse = 18,
+  NewConnectionId = 19,
+  ReadNewToken = 20,
+};
+
+std::atomic<uint64_t> nextLogId{0};
+
+void appendInt(std::string& out, uint64_t value) {
+  uint8_t buf[sizeof(uint64_t)];
+  // Nothing logged gets near 2^62, clamp rather than lose the event.
+  auto size = encodeQuicInteger(std::min(value, kEightByteLimit), buf);
+  out.append(reinterpret_cast<const char*>(buf), *size);
+}
+
+void appendBytes(std::string& out, const uint8_t* data, size_t len) {
+  out.append(reinterpret_cast<const char*>(data), len);
+}
+
+void appendConnectionId(
+    std::string& out,
+    const folly::Optional<ConnectionId>& connId) {
+  appendInt(out, connId.hasValue());
+  if (connId) {
+    appendInt(out, connId->size());
+    appendBytes(out, connId->data(), connId->size());
+  }
+}
+
+void appendRecord(std::string& out, const std::string& body) {
+  appendInt(out, body.size());
+  out.append(body);
+}
+
+std::string recordHeader(BinaryQLogger::RecordType type, uint64_t logId) {
+  std::string body;
+  appendInt(body, static_cast<uint64_t>(type));
+  appendInt(body, logId);
+  return body;
+}
+
+class EventEncoder {
+ public:
+  EventEncoder(
+      uint64_t logId,
+      const std::unordered_map<std::string, uint64_t>& strings)
+      : logId_(logId),
+        strings_(strings),
+        body_(recordHeader(BinaryQLogger::RecordType::Event, logId)) {}
+
+  void encode(const QLogEvent& event);
+
+  // The strings the event uses that the logger has not written yet.
+  std::vector<std::string>& newStrings() {
+    return newStrings_;
+  }
+
+  // The String records, followed by the Event one.
+  std::string finish() && {
+    appendRecord(stringRecords_, body_);
+    return std::move(stringRecords_);
+  }
+
+ private:
+  void encodeFrame(const QLogFrame& frame);
+
+  void putInt(uint64_t value) {
+    appendInt(body_, value);
+  }
+
+  void putTag(FrameTag tag) {
+    putInt(static_cast<uint64_t>(tag));
+  }
+
+  void putFixed64(uint64_t value) {
+    value = folly::Endian::big(value);
+    appendBytes(
+        body_, reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+  }
+
+  void putString(const std::string& str);
+
+  uint64_t logId_;
+  const std::unordered_map<std::string, uint64_t>& strings_;
+  std::vector<std::string> newStrings_;
+  std::string stringRecords_;
+  std::string body_;
+};
+
+void EventEncoder::putString(const std::string& str) {
+  auto it = strings_.find(str);
+  if (it != strings_.end()) {
+    putInt(it->second);
+    return;
+  }
+  auto newIt = std::find(newStrings_.begin(), newStrings_.end(), str);
+  uint64_t index = strings_.size() + (newIt - newStrings_.begin());
+  if (newIt == newStrings_.end()) {
+    newStrings_.push_back(str);
+    auto record = recordHeader(BinaryQLogger::RecordType::String, logId_);
+    appendInt(record, index);
+    appendInt(record, str.size());
+    record.append(str);
+    appendRecord(stringRecords_, record);
+  }
+  putInt(index);
+}
+
+void EventEncoder::encode(const QLogEvent& event) {
+  putInt(static_cast<uint64_t>(event.eventType));
+  putInt(event.refTime.count());
+  switch (event.eventType) {
+    case QLogEventType::PacketReceived:
+    case QLogEventType::PacketSent: {
+      if (typeid(event) == typeid(QLogVersionNegotiationEvent)) {
+        const auto& vn = static_cast<const QLogVersionNegotiationEvent&>(event);
+        putInt(1);
+        putString(vn.packetType);
+        putInt(vn.packetSize);
+        if (!vn.versionLog) {
+          putInt(0);
+          return;
+        }
+        putInt(vn.versionLog->versions.size());
+        for (auto version : vn.versionLog->versions) {
+          putInt(static_cast<uint32_t>(version));
+        }
+        return;
+      }
+      const auto& packet = static_cast<const QLogPacketEvent&>(event);
+      putInt(0);
+      putString(packet.packetType);
+      putInt(packet.packetNum);
+      putInt(packet.packetSize);
+      putInt(packet.frames.size());
+      for (const auto& frame : packet.frames) {
+        encodeFrame(*frame);
+      }
+      return;
+    }
+    case QLogEventType::ConnectionClose: {
+      const auto& e = static_cast<const QLogConnectionCloseEvent&>(event);
+      putString(e.error);
+      putString(e.reason);
+      putInt(e.drainConnection);
+      putInt(e.sendCloseImmediately);
+      return;
+    }
+    case QLogEventType::TransportSummary: {
+      const auto& e = static_cast<const QLogTransportSummaryEvent&>(event);
+      putInt(e.totalBytesSent);
+      putInt(e.totalBytesRecvd);
+      putInt(e.sumCurWriteOffset);
+      putInt(e.sumMaxObservedOffset);
+      putInt(e.sumCurStreamBufferLen);
+      putInt(e.totalBytesRetransmitted);
+      putInt(e.totalStreamBytesCloned);
+      putInt(e.totalBytesCloned);
+      putInt(e.totalCryptoDataWritten);
+      putInt(e.totalCryptoDataRecvd);
+      return;
+    }
+    case QLogEventType::CongestionMetricUpdate: {
+      const auto& e =
+          static_cast<const QLogCongestionMetricUpdateEvent&>(event);
+      putInt(e.bytesInFlight);
+      putInt(e.currentCwnd);
+      putString(e.congestionEvent);
+      putString(e.state);
+      putString(e.recoveryState);
+      return;
+    }
+    case QLogEventType::PacingMetricUpdate: {
+      const auto& e = static_cast<const QLogPacingMetricUpdateEvent&>(event);
+      putInt(e.pacingBurstSize);
+      putInt(e.pacingInterval.count());
+      return;
+    }
+    case QLogEventType::AppIdleUpdate: {
+      const auto& e = static_cast<const QLogAppIdleUpdateEvent&>(event);
+      putString(e.idleEvent);
+      putInt(e.idle);
+      return;
+    }
+    case QLogEventType::PacketDrop: {
+      const auto& e = static_cast<const QLogPacketDropEvent&>(event);
+      putInt(e.packetSize);
+      putString(e.dropReason);
+      return;
+    }
+    case QLogEventType::DatagramReceived: {
+      const auto& e = static_cast<const QLogDatagramReceivedEvent&>(event);
+      putInt(e.dataLen);
+      return;
+    }
+    case QLogEventType::LossAlarm: {
+      const auto& e = static_cast<const QLogLossAlarmEvent&>(event);
+      putInt(e.largestSent);
+      putInt(e.alarmCount);
+      putInt(e.outstandingPackets);
+      putString(e.type);
+      return;
+    }
+    case QLogEventType::PacketsLost: {
+      const auto& e = static_cast<const QLogPacketsLostEvent&>(event);
+      putInt(e.largestLostPacketNum);
+      putInt(e.lostBytes);
+      putInt(e.lostPackets);
+      return;
+    }
+    case QLogEventType::TransportStateUpdate: {
+      const auto& e = static_cast<const QLogTransportStateUpdateEvent&>(event);
+      putString(e.update);
+      return;
+    }
+  }
+}
+
+void EventEncoder::encodeFrame(const QLogFrame& frame) {
+  // Most frequent first.
+  const auto& type = typeid(frame);
+  if (type == typeid(StreamFrameLog)) {
+    const auto& f = static_cast<const StreamFrameLog&>(frame);
+    putTag(FrameTag::Stream);
+    putInt(f.streamId);
+    putInt(f.offset);
+    putInt(f.len);
+    putInt(f.fin);
+  } else if (type == typeid(WriteAckFrameLog)) {
+    const auto& f = static_cast<const WriteAckFrameLog&>(frame);
+    putTag(FrameTag::Ack);
+    putInt(f.ackBlocks.size());
+    for (auto it = f.ackBlocks.cbegin(); it != f.ackBlocks.cend(); ++it) {
+      putInt(it->start);
+      putInt(it->end);
+    }
+    putInt(f.ackDelay.count());
+  } else if (type == typeid(ReadAckFrameLog)) {
+    const auto& f = static_cast<const ReadAckFrameLog&>(frame);
+    putTag(FrameTag::Ack);
+    putInt(f.ackBlocks.size());
+    for (const auto& block : f.ackBlocks) {
+      putInt(block.startPacket);
+      putInt(block.endPacket);
+    }
+    putInt(f.ackDelay.count());
+  } else if (type == typeid(PaddingFrameLog)) {
+    putTag(FrameTag::Padding);
+  } else if (type == typeid(CryptoFrameLog)) {
+    const auto& f = static_cast<const CryptoFrameLog&>(frame);
+    putTag(FrameTag::Crypto);
+    putInt(f.offset);
+    putInt(f.len);
+  } else if (type == typeid(MaxStreamDataFrameLog)) {
+    const auto& f = static_cast<const MaxStreamDataFrameLog&>(frame);
+    putTag(FrameTag::MaxStreamData);
+    putInt(f.streamId);
+    putInt(f.maximumData);
+  } else if (type == typeid(MaxDataFrameLog)) {
+    const auto& f = static_cast<const MaxDataFrameLog&>(frame);
+    putTag(FrameTag::MaxData);
+    putInt(f.maximumData);
+  } else if (type == typeid(PingFrameLog)) {
+    putTag(FrameTag::Ping);
+  } else if (type == typeid(RstStreamFrameLog)) {
+    const auto& f = static_cast<const RstStreamFrameLog&>(frame);
+    putTag(FrameTag::RstStream);
+    putInt(f.streamId);
+    putInt(f.errorCode);
+    putInt(f.offset);
+  } else if (type == typeid(ConnectionCloseFrameLog)) {
+    const auto& f = static_cast<const ConnectionCloseFrameLog&>(frame);
+    putTag(FrameTag::ConnectionClose);
+    putInt(static_cast<uint64_t>(f.errorCode));
+    putString(f.reasonPhrase);
+    putInt(static_cast<uint64_t>(f.closingFrameType));
+  } else if (type == typeid(ApplicationCloseFrameLog)) {
+    const auto& f = static_cast<const ApplicationCloseFrameLog&>(frame);
+    putTag(FrameTag::ApplicationClose);
+    putInt(f.errorCode);
+    putString(f.reasonPhrase);
+  } else if (type == typeid(MaxStreamsFrameLog)) {
+    const auto& f = static_cast<const MaxStreamsFrameLog&>(frame);
+    putTag(FrameTag::MaxStreams);
+    putInt(f.maxStreams);
+    putInt(f.isForBidirectional);
+  } else if (type == typeid(StreamsBlockedFrameLog)) {
+    const auto& f = static_cast<const StreamsBlockedFrameLog&>(frame);
+    putTag(FrameTag::StreamsBlocked);
+    putInt(f.streamLimit);
+    putInt(f.isForBidirectional);
+  } else if (type == typeid(DataBlockedFrameLog)) {
+    const auto& f = static_cast<const DataBlockedFrameLog&>(frame);
+    putTag(FrameTag::DataBlocked);
+    putInt(f.dataLimit);
+  } else if (type == typeid(StreamDataBlockedFrameLog)) {
+    const auto& f = static_cast<const StreamDataBlockedFrameLog&>(frame);
+    putTag(FrameTag::StreamDataBlocked);
+    putInt(f.streamId);
+    putInt(f.dataLimit);
+  } else if (type == typeid(StopSendingFrameLog)) {
+    const auto& f = static_cast<const StopSendingFrameLog&>(frame);
+    putTag(FrameTag::StopSending);
+    putInt(f.streamId);
+    putInt(f.errorCode);
+  } else if (type == typeid(MinStreamDataFrameLog)) {
+    const auto& f = static_cast<const MinStreamDataFrameLog&>(frame);
+    putTag(FrameTag::MinStreamData);
+    putInt(f.streamId);
+    putInt(f.maximumData);
+    putInt(f.minimumStreamOffset);
+  } else if (type == typeid(ExpiredStreamDataFrameLog)) {
+    const auto& f = static_cast<const ExpiredStreamDataFrameLog&>(frame);
+    putTag(FrameTag::ExpiredStreamData);
+    putInt(f.streamId);
+    putInt(f.minimumStreamOffset);
+  } else if (type == typeid(PathChallengeFrameLog)) {
+    const auto& f = static_cast<const PathChallengeFrameLog&>(frame);
+    putTag(FrameTag::PathChallenge);
+    putFixed64(f.pathData);
+  } else if (type == typeid(PathResponseFrameLog)) {
+    const auto& f = static_cast<const PathResponseFrameLog&>(frame);
+    putTag(FrameTag::PathResponse);
+    putFixed64(f.pathData);
+  } else if (type == typeid(NewConnectionIdFrameLog)) {
+    const auto& f = static_cast<const NewConnectionIdFrameLog&>(frame);
+    putTag(FrameTag::NewConnectionId);
+    putInt(f.sequence);
+    appendBytes(body_, f.token.data(), f.token.size());
+  } else if (type == typeid(ReadNewTokenFrameLog)) {
+    putTag(FrameTag::ReadNewToken);
+  } else {
+    LOG(DFATAL) << "Unknown qlog frame " << type.name();
+    putTag(FrameTag::Padding);
+  }
+}
+
+// Throws on malformed or short input, decodeBinaryQLog catches it.
+class Reader {
+ public:
+  explicit Reader(const folly::IOBuf& buf) : cursor_(&buf) {}
+
+  void setStrings(const std::vector<std::string>& strings) {
+    strings_ = &strings;
+  }
+
+  uint64_t getInt() {
+    auto value = decodeQuicInteger(cursor_);
+    if (!value) {
+      throw std::runtime_error("truncated integer");
+    }
+    return value->first;
+  }
+
+  bool getBool() {
+    return getInt() != 0;
+  }
+
+  std::chrono::microseconds getMicros() {
+    return std::chrono::microseconds(getInt());
+  }
+
+  uint64_t getFixed64() {
+    return cursor_.readBE<uint64_t>();
+  }
+
+  std::string getBytes(size_t len) {
+    if (!cursor_.canAdvance(len)) {
+      throw std::runtime_error("truncated bytes");
+    }
+    return cursor_.readFixedString(len);
+  }
+
+  // An interned string.
+  const std::string& getString() {
+    if (!strings_) {
+      throw std::runtime_error("no strings");
+    }
+    return strings_->at(getInt());
+  }
+
+  folly::Optional<ConnectionId> getConnectionId() {
+    if (!getBool()) {
+      return folly::none;
+    }
+    auto len = getInt();
+    return ConnectionId(cursor_, len);
+  }
+
+  StatelessResetToken getToken() {
+    StatelessResetToken token;
+    cursor_.pull(token.data(), token.size());
+    return token;
+  }
+
+ private:
+  folly::io::Cursor cursor_;
+  const std::vector<std::string>* strings_{nullptr};
+};
+
+std::unique_ptr<QLogFrame> decodeFrame(Reader& reader) {
+  switch (static_cast<FrameTag>(reader.getInt())) {
+    case FrameTag::Padding:
+      return std::make_unique<PaddingFrameLog>();
+    case FrameTag::RstStream: {
+      StreamId streamId = reader.getInt();
+      auto errorCode = static_cast<ApplicationErrorCode>(reader.getInt());
+      uint64_t offset = reader.getInt();
+      return std::make_unique<RstStreamFrameLog>(streamId, errorCode, offset);
+    }
+    case FrameTag::ConnectionClose: {
+      auto errorCode = static_cast<TransportErrorCode>(reader.getInt());
+      std::string reasonPhrase = reader.getString();
+      auto closingFrameType = static_cast<FrameType>(reader.getInt());
+      return std::make_unique<ConnectionCloseFrameLog>(
+          errorCode, std::move(reasonPhrase), closingFrameType);
+    }
+    case FrameTag::ApplicationClose: {
+      auto errorCode = static_cast<ApplicationErrorCode>(reader.getInt());
+      std::string reasonPhrase = reader.getString();
+      return std::make_unique<ApplicationCloseFrameLog>(
+          errorCode, std::move(reasonPhrase));
+    }
+    case FrameTag::MaxData:
+      return std::make_unique<MaxDataFrameLog>(reader.getInt());
+    case FrameTag::MaxStreamData: {
+      StreamId streamId = reader.getInt();
+      uint64_t maximumData = reader.getInt();
+      return std::make_unique<MaxStreamDataFrameLog>(streamId, maximumData);
+    }
+    case FrameTag::MaxStreams: {
+      uint64_t maxStreams = reader.getInt();
+      bool isForBidirectional = reader.getBool();
+      return std::make_unique<MaxStreamsFrameLog>(
+          maxStreams, isForBidirectional);
+    }
+    case FrameTag::StreamsBlocked: {
+      uint64_t streamLimit = reader.getInt();
+      bool isForBidirectional = reader.getBool();
+      return std::make_unique<StreamsBlockedFrameLog>(
+          streamLimit, isForBidirectional);
+    }
+    case FrameTag::Ping:
+      return std::make_unique<PingFrameLog>();
+    case FrameTag::DataBlocked:
+      return std::make_unique<DataBlockedFrameLog>(reader.getInt());
+    case FrameTag::StreamDataBlocked: {
+      StreamId streamId = reader.getInt();
+      uint64_t dataLimit = reader.getInt();
+      return std::make_unique<StreamDataBlockedFrameLog>(streamId, dataLimit);
+    }
+    case FrameTag::Ack: {
+      // Write and read acks log the same, both come back as read ones.
+      ReadAckBlocks ackBlocks;
+      auto numBlocks = reader.getInt();
+      for (uint64_t i = 0; i < numBlocks; i++) {
+        PacketNum start = reader.getInt();
+        PacketNum end = reader.getInt();
+        ackBlocks.emplace_back(start, end);
+      }
+      auto ackDelay = reader.getMicros();
+      return std::make_unique<ReadAckFrameLog>(ackBlocks, ackDelay);
+    }
+    case FrameTag::Stream: {
+      StreamId streamId = reader.getInt();
+      uint64_t offset = reader.getInt();
+      uint64_t len = reader.getInt();
+      bool fin = reader.getBool();
+      return std::make_unique<StreamFrameLog>(streamId, offset, len, fin);
+    }
+    case FrameTag::Crypto: {
+      uint64_t offset = reader.getInt();
+      uint64_t len = reader.getInt();
+      return std::make_unique<CryptoFrameLog>(offset, len);
+    }
+    case FrameTag::StopSending: {
+      StreamId streamId = reader.getInt();
+      auto errorCode = static_cast<ApplicationErrorCode>(reader.getInt());
+      return std::make_unique<StopSendingFrameLog>(streamId, errorCode);
+    }
+    case FrameTag::MinStreamData: {
+      StreamId streamId = reader.getInt();
+      uint64_t maximumData = reader.getInt();
+      uint64_t minimumStreamOffset = reader.getInt();
+      return std::make_unique<MinStreamDataFrameLog>(
+          streamId, maximumData, minimumStreamOffset);
+    }
+    case FrameTag::ExpiredStreamData: {
+      StreamId streamId = reader.getInt();
+      uint64_t minimumStreamOffset = reader.getInt();
+      return std::make_unique<ExpiredStreamDataFrameLog>(
+          streamId, minimumStreamOffset);
+    }
+    case FrameTag::PathChallenge:
+      return std::make_unique<PathChallengeFrameLog>(reader.getFixed64());
+    case FrameTag::PathResponse:
+      return std::make_unique<PathResponseFrameLog>(reader.getFixed64());
+    case FrameTag::NewConnectionId: {
+      auto sequence = static_cast<uint16_t>(reader.getInt());
+      auto token = reader.getToken();
+      return std::make_unique<NewConnectionIdFrameLog>(sequence, token);
+    }
+    case FrameTag::ReadNewToken:
+      return std::make_unique<ReadNewTokenFrameLog>();
+  }
+  throw std::runtime_error("unknown frame");
+}
+
+std::unique_ptr<QLogEvent> decodeEvent(Reader& reader) {
+  auto eventType = static_cast<QLogEventType>(reader.getInt());
+  auto refTime = reader.getMicros();
+  std::unique_ptr<QLogEvent> event;
+  switch (eventType) {
+    case QLogEventType::PacketReceived:
+    case QLogEventType::PacketSent: {
+      if (reader.getBool()) {
+        auto vn = std::make_unique<QLogVersionNegotiationEvent>();
+        vn->packetType = reader.getString();
+        vn->packetSize = reader.getInt();
+        std::vector<QuicVersion> versions;
+        auto numVersions = reader.getInt();
+        for (uint64_t i = 0; i < numVersions; i++) {
+          versions.push_back(static_cast<QuicVersion>(reader.getInt()));
+        }
+        vn->versionLog = std::make_unique<VersionNegotiationLog>(versions);
+        event = std::move(vn);
+        break;
+      }
+      auto packet = std::make_unique<QLogPacketEvent>();
+      packet->packetType = reader.getString();
+      packet->packetNum = reader.getInt();
+      packet->packetSize = reader.getInt();
+      auto numFrames = reader.getInt();
+      for (uint64_t i = 0; i < numFrames; i++) {
+        packet->frames.push_back(decodeFrame(reader));
+      }
+      event = std::move(packet);
+      break;
+    }
+    case QLogEventType::ConnectionClose: {
+      std::string error = reader.getString();
+      std::string reason = reader.getString();
+      bool drainConnection = reader.getBool();
+      bool sendCloseImmediately = reader.getBool();
+      event = std::make_unique<QLogConnectionCloseEvent>(
+          std::move(error),
+          std::move(reason),
+          drainConnection,
+          sendCloseImmediately,
+          refTime);
+      break;
+    }
+    case QLogEventType::TransportSummary: {
+      uint64_t values[10];
+      for (auto& value : values) {
+        value = reader.getInt();
+      }
+      event = std::make_unique<QLogTransportSummaryEvent>(
+          values[0],
+          values[1],
+          values[2],
+          values[3],
+          values[4],
+          values[5],
+          values[6],
+          values[7],
+          values[8],
+          values[9],
+          refTime);
+      break;
+    }
+    case QLogEventType::CongestionMetricUpdate: {
+      uint64_t bytesInFlight = reader.getInt();
+      uint64_t currentCwnd = reader.getInt();
+      std::string congestionEvent = reader.getString();
+      std::string state = reader.getString();
+      std::string recoveryState = reader.getString();
+      event = std::make_unique<QLogCongestionMetricUpdateEvent>(
+          bytesInFlight,
+          currentCwnd,
+          std::move(congestionEvent),
+          std::move(state),
+          std::move(recoveryState),
+          refTime);
+      break;
+    }
+    case QLogEventType::PacingMetricUpdate: {
+      uint64_t pacingBurstSize = reader.getInt();
+      auto pacingInterval = reader.getMicros();
+      event = std::make_unique<QLogPacingMetricUpdateEvent>(
+          pacingBurstSize, pacingInterval, refTime);
+      break;
+    }
+    case QLogEventType::AppIdleUpdate: {
+      std::string idleEvent = reader.getString();
+      bool idle = reader.getBool();
+      event = std::make_unique<QLogAppIdleUpdateEvent>(
+          std::move(idleEvent), idle, refTime);
+      break;
+    }
+    case QLogEventType::PacketDrop: {
+      size_t packetSize = reader.getInt();
+      std::string dropReason = reader.getString();
+      event = std::make_unique<QLogPacketDropEvent>(
+          packetSize, std::move(dropReason), refTime);
+      break;
+    }
+    case QLogEventType::DatagramReceived:
+      event =
+          std::make_unique<QLogDatagramReceivedEvent>(reader.getInt(), refTime);
+      break;
+    case QLogEventType::LossAlarm: {
+      PacketNum largestSent = reader.getInt();
+      uint64_t alarmCount = reader.getInt();
+      uint64_t outstandingPackets = reader.getInt();
+      std::string type = reader.getString();
+      event = std::make_unique<QLogLossAlarmEvent>(
+          largestSent,
+          alarmCount,
+          outstandingPackets,
+          std::move(type),
+          refTime);
+      break;
+    }
+    case QLogEventType::PacketsLost: {
+      PacketNum largestLostPacketNum = reader.getInt();
+      uint64_t lostBytes = reader.getInt();
+      uint64_t lostPackets = reader.getInt();
+      event = std::make_unique<QLogPacketsLostEvent>(
+          largestLostPacketNum, lostBytes, lostPackets, refTime);
+      break;
+    }
+    case QLogEventType::TransportStateUpdate:
+      event = std::make_unique<QLogTransportStateUpdateEvent>(
+          reader.getString(), refTime);
+      break;
+    default:
+      throw std::runtime_error("unknown event");
+  }
+  event->eventType = eventType;
+  event->refTime = refTime;
+  return event;
+}
+
+struct DecodedLog {
+  FileQLogger* logger;
+  std::vector<std::string> strings;
+};
+
+void decodeRecord(
+    const folly::IOBuf& body,
+    std::vector<std::unique_ptr<FileQLogger>>& loggers,
+    std::unordered_map<uint64_t, DecodedLog>& logs) {
+  Reader reader(body);
+  auto type = static_cast<BinaryQLogger::RecordType>(reader.getInt());
+  auto logId = reader.getInt();
+  auto it = logs.find(logId);
+  if (it == logs.end()) {
+    loggers.push_back(std::make_unique<FileQLogger>());
+    it = logs.emplace(logId, DecodedLog{loggers.back().get(), {}}).first;
+  }
+  auto& log = it->second;
+  reader.setStrings(log.strings);
+  switch (type) {
+    case BinaryQLogger::RecordType::Connection:
+      log.logger->dcid = reader.getConnectionId();
+      log.logger->scid = reader.getConnectionId();
+      log.logger->protocolType = reader.getBytes(reader.getInt());
+      return;
+    case BinaryQLogger::RecordType::String: {
+      if (reader.getInt() != log.strings.size()) {
+        throw std::runtime_error("string out of order");
+      }
+      auto str = reader.getBytes(reader.getInt());
+      log.strings.push_back(std::move(str));
+      return;
+    }
+    case BinaryQLogger::RecordType::Event:
+      log.logger->logs.push_back(decodeEvent(reader));
+      return;
+  }
+  throw std::runtime_error("unknown record");
+}
+
+} // namespace
+
+BinaryQLogger::BinaryQLogger(
+    std::shared_ptr<QLogWriter> writer,
+    std::string protocolTypeIn)
+    : FileQLogger(std::move(protocolTypeIn)),
+      writer_(std::move(writer)),
+      logId_(nextLogId++) {}
+
+void BinaryQLogger::handleEvent(std::unique_ptr<QLogEvent> event) {
+  std::string records;
+  bool connectionChanged =
+      !connectionWritten_ || writtenDcid_ != dcid || writtenScid_ != scid;
+  if (connectionChanged) {
+    auto record = recordHeader(RecordType::Connection, logId_);
+    appendConnectionId(record, dcid);
+    appendConnectionId(record, scid);
+    appendInt(record, protocolType.size());
+    record.append(protocolType);
+    appendRecord(records, record);
+  }
+  EventEncoder encoder(logId_, strings_);
+  encoder.encode(*event);
+  auto newStrings = std::move(encoder.newStrings());
+  records.append(std::move(encoder).finish());
+  if (!writer_->writeRaw(std::move(records))) {
+    // Whatever it defined goes again with the next event.
+    return;
+  }
+  for (auto& str : newStrings) {
+    auto index = strings_.size();
+    strings_.emplace(std::move(str), index);
+  }
+  if (connectionChanged) {
+    connectionWritten_ = true;
+    writtenDcid_ = dcid;
+    writtenScid_ = scid;
+  }
+}
+
+folly::Optional<std::vector<std::unique_ptr<FileQLogger>>> decodeBinaryQLog(
+    const folly::IOBuf& data) {
+  std::vector<std::unique_ptr<FileQLogger>> loggers;
+  std::unordered_map<uint64_t, DecodedLog> logs;
+  folly::io::Cursor cursor(&data);
+  try {
+    while (!cursor.isAtEnd()) {
+      auto size = decodeQuicInteger(cursor);
+      if (!size || !cursor.canAdvance(size->first)) {
+        // The writer went away in the middle of the record.
+        break;
+      }
+      Buf body;
+      cursor.clone(body, size->first);
+      decodeRecord(*body, loggers, logs);
+    }
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "Malformed binary qlog: " << ex.what();
+    return folly::none;
+  }
+  return std::move(loggers);
+}
+
+} // namespace quic
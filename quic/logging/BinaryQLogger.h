@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/logging/StreamingQLogger.h>
+
+#include <unordered_map>
+
+namespace quic {
+
+/**
+ * A QLogger writing events in a compact binary encoding, without building a
+ * folly::dynamic per event. decodeBinaryQLog turns them back into events,
+ * e.g. to convert them to qlog JSON offline with quic/logging/tools.
+ *
+ * The encoding is a sequence of records, each one the size of its body
+ * followed by the body. A body starts with the record type and the log id,
+ * which is unique to a logger within the process, so that the loggers of a
+ * worker can share a QLogWriter:
+ *   Connection: dcid, scid and protocol type, again whenever they change.
+ *   String: its index and bytes. Strings are interned per logger, events
+ *     refer to them by index.
+ *   Event: QLogEventType, relative time, then the fields of the event.
+ * Integers are QUIC variable length integers, except path data and reset
+ * tokens which are written as is.
+ */
+class BinaryQLogger : public FileQLogger {
+ public:
+  enum class RecordType : uint8_t {
+    Connection = 0,
+    String = 1,
+    Event = 2,
+  };
+
+  explicit BinaryQLogger(
+      std::shared_ptr<QLogWriter> writer,
+      std::string protocolTypeIn = kHTTP3ProtocolType.str());
+
+  ~BinaryQLogger() override = default;
+
+ protected:
+  void handleEvent(std::unique_ptr<QLogEvent> event) override;
+
+ private:
+  std::shared_ptr<QLogWriter> writer_;
+  uint64_t logId_;
+  std::unordered_map<std::string, uint64_t> strings_;
+  bool connectionWritten_{false};
+  folly::Optional<ConnectionId> writtenDcid_;
+  folly::Optional<ConnectionId> writtenScid_;
+};
+
+/**
+ * Decodes a binary qlog into one FileQLogger per logger that wrote to it, in
+ * the order of their first record. A record cut short at the end of data, as
+ * left by a process that died while writing, is ignored. Returns none if
+ * data is malformed.
+ */
+folly::Optional<std::vector<std::unique_ptr<FileQLogger>>> decodeBinaryQLog(
+    const folly::IOBuf& data);
+
+} // namespace quic
@@ -17,20 +17,20 @@ namespace quic {
 void FileQLogger::addPacket(
     const RegularQuicPacket& regularPacket,
     uint64_t packetSize) {
-  logs.push_back(createPacketEvent(regularPacket, packetSize));
+  handleEvent(createPacketEvent(regularPacket, packetSize));
 }
 
 void FileQLogger::addPacket(
     const RegularQuicWritePacket& writePacket,
     uint64_t packetSize) {
-  logs.push_back(createPacketEvent(writePacket, packetSize));
+  handleEvent(createPacketEvent(writePacket, packetSize));
 }
 
 void FileQLogger::addPacket(
     const VersionNegotiationPacket& versionPacket,
     uint64_t packetSize,
     bool isPacketRecvd) {
-  logs.push_back(createPacketEvent(versionPacket, packetSize, isPacketRecvd));
+  handleEvent(createPacketEvent(versionPacket, packetSize, isPacketRecvd));
 }
 
 void FileQLogger::addConnectionClose(
@@ -40,7 +40,7 @@ void FileQLogger::addConnectionClose(
     bool sendCloseImmediately) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
-  logs.push_back(std::make_unique<quic::QLogConnectionCloseEvent>(
+  handleEvent(std::make_unique<quic::QLogConnectionCloseEvent>(
       std::move(error),
       std::move(reason),
       drainConnection,
@@ -62,7 +62,7 @@ void FileQLogger::addTransportSummary(
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogTransportSummaryEvent>(
+  handleEvent(std::make_unique<quic::QLogTransportSummaryEvent>(
       totalBytesSent,
       totalBytesRecvd,
       sumCurWriteOffset,
@@ -79,18 +79,18 @@ void FileQLogger::addTransportSummary(
 void FileQLogger::addCongestionMetricUpdate(
     uint64_t bytesInFlight,
     uint64_t currentCwnd,
-    std::string congestionEvent,
-    std::string state,
-    std::string recoveryState) {
+    folly::StringPiece congestionEvent,
+    folly::StringPiece state,
+    folly::StringPiece recoveryState) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogCongestionMetricUpdateEvent>(
+  handleEvent(std::make_unique<quic::QLogCongestionMetricUpdateEvent>(
       bytesInFlight,
       currentCwnd,
-      std::move(congestionEvent),
-      std::move(state),
-      std::move(recoveryState),
+      congestionEvent.str(),
+      state.str(),
+      recoveryState.str(),
       refTime));
 }
 
@@ -100,31 +100,33 @@ void FileQLogger::addPacingMetricUpdate(
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogPacingMetricUpdateEvent>(
+  handleEvent(std::make_unique<quic::QLogPacingMetricUpdateEvent>(
       pacingBurstSizeIn, pacingIntervalIn, refTime));
 }
 
-void FileQLogger::addAppIdleUpdate(std::string idleEvent, bool idle) {
+void FileQLogger::addAppIdleUpdate(folly::StringPiece idleEvent, bool idle) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogAppIdleUpdateEvent>(
-      std::move(idleEvent), idle, refTime));
+  handleEvent(std::make_unique<quic::QLogAppIdleUpdateEvent>(
+      idleEvent.str(), idle, refTime));
 }
 
-void FileQLogger::addPacketDrop(size_t packetSize, std::string dropReason) {
+void FileQLogger::addPacketDrop(
+    size_t packetSize,
+    folly::StringPiece dropReason) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogPacketDropEvent>(
-      packetSize, std::move(dropReason), refTime));
+  handleEvent(std::make_unique<quic::QLogPacketDropEvent>(
+      packetSize, dropReason.str(), refTime));
 }
 
 void FileQLogger::addDatagramReceived(uint64_t dataLen) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(
+  handleEvent(
       std::make_unique<quic::QLogDatagramReceivedEvent>(dataLen, refTime));
 }
 
@@ -136,7 +138,7 @@ void FileQLogger::addLossAlarm(
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogLossAlarmEvent>(
+  handleEvent(std::make_unique<quic::QLogLossAlarmEvent>(
       largestSent, alarmCount, outstandingPackets, std::move(type), refTime));
 }
 
@@ -147,16 +149,20 @@ void FileQLogger::addPacketsLost(
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogPacketsLostEvent>(
+  handleEvent(std::make_unique<quic::QLogPacketsLostEvent>(
       largestLostPacketNum, lostBytes, lostPackets, refTime));
 }
 
-void FileQLogger::addTransportStateUpdate(std::string update) {
+void FileQLogger::addTransportStateUpdate(folly::StringPiece update) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogTransportStateUpdateEvent>(
-      std::move(update), refTime));
+  handleEvent(std::make_unique<quic::QLogTransportStateUpdateEvent>(
+      update.str(), refTime));
+}
+
+void FileQLogger::handleEvent(std::unique_ptr<QLogEvent> event) {
+  logs.push_back(std::move(event));
 }
 
 folly::dynamic FileQLogger::toDynamic() const {
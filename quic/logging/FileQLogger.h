@@ -50,14 +50,15 @@ class FileQLogger : public QLogger {
   void addCongestionMetricUpdate(
       uint64_t bytesInFlight,
       uint64_t currentCwnd,
-      std::string congestionEvent,
-      std::string state = "",
-      std::string recoveryState = "") override;
+      folly::StringPiece congestionEvent,
+      folly::StringPiece state = "",
+      folly::StringPiece recoveryState = "") override;
   void addPacingMetricUpdate(
       uint64_t pacingBurstSizeIn,
       std::chrono::microseconds pacingIntervalIn) override;
-  void addAppIdleUpdate(std::string idleEvent, bool idle) override;
-  void addPacketDrop(size_t packetSize, std::string dropReasonIn) override;
+  void addAppIdleUpdate(folly::StringPiece idleEvent, bool idle) override;
+  void addPacketDrop(size_t packetSize, folly::StringPiece dropReasonIn)
+      override;
   void addDatagramReceived(uint64_t dataLen) override;
   void addLossAlarm(
       PacketNum largestSent,
@@ -68,8 +69,12 @@ class FileQLogger : public QLogger {
       PacketNum largestLostPacketNum,
       uint64_t lostBytes,
       uint64_t lostPackets) override;
-  void addTransportStateUpdate(std::string update) override;
+  void addTransportStateUpdate(folly::StringPiece update) override;
   void outputLogsToFile(const std::string& path, bool prettyJson);
   folly::dynamic toDynamic() const;
+
+ protected:
+  // Every event goes through here, the default keeps it in logs.
+  virtual void handleEvent(std::unique_ptr<QLogEvent> event);
 };
 } // namespace quic
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/logging/PacketCapture.h>
+
+#include <folly/io/Cursor.h>
+#include <folly/lang/Assume.h>
+
+#include <array>
+#include <cstring>
+
+namespace quic {
+
+namespace {
+
+// pcapng, see draft-ietf-opsawg-pcapng.
+constexpr uint32_t kSectionHeaderBlock = 0x0A0D0D0A;
+constexpr uint32_t kByteOrderMagic = 0x1A2B3C4D;
+constexpr uint32_t kInterfaceDescriptionBlock = 0x00000001;
+constexpr uint32_t kEnhancedPacketBlock = 0x00000006;
+constexpr uint32_t kDecryptionSecretsBlock = 0x0000000A;
+constexpr uint32_t kTlsKeyLogSecrets = 0x544c534b;
+// Packets start with their IP header, either version.
+constexpr uint16_t kLinkTypeRaw = 101;
+constexpr uint16_t kEpbFlagsOption = 2;
+constexpr uint32_t kEpbInbound = 1;
+constexpr uint32_t kEpbOutbound = 2;
+constexpr size_t kPacketCaptureGrowth = 16 * 1024;
+
+constexpr size_t kIPv4HeaderLen = 20;
+constexpr size_t kIPv6HeaderLen = 40;
+constexpr size_t kUdpHeaderLen = 8;
+constexpr uint8_t kUdpProtocol = 17;
+constexpr uint8_t kHopLimit = 64;
+
+using Appender = folly::io::Appender;
+
+size_t paddingFor(size_t len) {
+  return (4 - len % 4) % 4;
+}
+
+void writePadding(Appender& appender, size_t len) {
+  for (size_t i = 0; i < paddingFor(len); i++) {
+    appender.writeBE<uint8_t>(0);
+  }
+}
+
+folly::IPAddress captureAddress(const folly::IPAddress& ip) {
+  return ip.isIPv4Mapped() ? ip.createIPv4() : ip;
+}
+
+// The local address in the family of peerIp, unspecified if the socket is
+// bound to the other family.
+folly::IPAddress localAddressFor(
+    const folly::SocketAddress& local,
+    const folly::IPAddress& peerIp) {
+  if (local.isInitialized() &&
+      (local.getFamily() == AF_INET || local.getFamily() == AF_INET6)) {
+    auto ip = captureAddress(local.getIPAddress());
+    if (ip.family() == peerIp.family()) {
+      return ip;
+    }
+  }
+  return peerIp.isV4() ? folly::IPAddress("0.0.0.0") : folly::IPAddress("::");
+}
+
+uint16_t ipv4Checksum(const uint8_t* header, size_t len) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i + 1 < len; i += 2) {
+    sum += (header[i] << 8) | header[i + 1];
+  }
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return static_cast<uint16_t>(~sum);
+}
+
+void putBE16(uint8_t* dst, uint16_t value) {
+  dst[0] = value >> 8;
+  dst[1] = value & 0xff;
+}
+
+// Writes the IP and UDP headers of a datagram of length bytes from src to
+// dst into header, and returns their length.
+size_t writeHeaders(
+    std::array<uint8_t, kIPv6HeaderLen + kUdpHeaderLen>& header,
+    const folly::IPAddress& src,
+    uint16_t srcPort,
+    const folly::IPAddress& dst,
+    uint16_t dstPort,
+    uint32_t length) {
+  header.fill(0);
+  uint16_t udpLength = kUdpHeaderLen + length;
+  size_t ipLen;
+  if (src.isV4()) {
+    ipLen = kIPv4HeaderLen;
+    header[0] = 0x45;
+    putBE16(&header[2], kIPv4HeaderLen + udpLength);
+    // Don't fragment.
+    header[6] = 0x40;
+    header[8] = kHopLimit;
+    header[9] = kUdpProtocol;
+    std::memcpy(&header[12], src.bytes(), src.byteCount());
+    std::memcpy(&header[16], dst.bytes(), dst.byteCount());
+    putBE16(&header[10], ipv4Checksum(header.data(), kIPv4HeaderLen));
+  } else {
+    ipLen = kIPv6HeaderLen;
+    header[0] = 0x60;
+    putBE16(&header[4], udpLength);
+    header[6] = kUdpProtocol;
+    header[7] = kHopLimit;
+    std::memcpy(&header[8], src.bytes(), src.byteCount());
+    std::memcpy(&header[24], dst.bytes(), dst.byteCount());
+  }
+  // The UDP checksum is left out, the payload may be truncated anyway.
+  putBE16(&header[ipLen], srcPort);
+  putBE16(&header[ipLen + 2], dstPort);
+  putBE16(&header[ipLen + 4], udpLength);
+  return ipLen + kUdpHeaderLen;
+}
+
+} // namespace
+
+folly::StringPiece toString(PacketCaptureTrigger trigger) {
+  switch (trigger) {
+    case PacketCaptureTrigger::Requested:
+      return "requested";
+    case PacketCaptureTrigger::PtoStorm:
+      return "pto_storm";
+    case PacketCaptureTrigger::AbnormalClose:
+      return "abnormal_close";
+  }
+  folly::assume_unreachable();
+}
+
+PacketCaptureRing::PacketCaptureRing(size_t maxDatagrams, size_t snapLength)
+    : snapLength_(snapLength),
+      entries_(maxDatagrams),
+      data_(maxDatagrams * snapLength) {}
+
+void PacketCaptureRing::record(
+    Direction direction,
+    TimePoint time,
+    const folly::SocketAddress& peer,
+    const folly::IOBuf& datagram) {
+  if (entries_.empty()) {
+    return;
+  }
+  auto& entry = entries_[next_];
+  auto dst = data_.data() + next_ * snapLength_;
+  size_t length = 0;
+  size_t captured = 0;
+  for (const auto range : datagram) {
+    auto len = std::min(range.size(), snapLength_ - captured);
+    std::memcpy(dst + captured, range.data(), len);
+    captured += len;
+    length += range.size();
+  }
+  entry.time = time;
+  entry.peer = peer;
+  entry.length = length;
+  entry.captured = captured;
+  entry.direction = direction;
+  next_ = (next_ + 1) % entries_.size();
+  numRecorded_++;
+}
+
+std::vector<PacketCaptureRing::Datagram> PacketCaptureRing::getDatagrams()
+    const {
+  std::vector<Datagram> datagrams;
+  size_t count = std::min<uint64_t>(numRecorded_, entries_.size());
+  // Once the ring wrapped, the oldest entry is the one written next.
+  size_t first = numRecorded_ > entries_.size() ? next_ : 0;
+  datagrams.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    auto index = (first + i) % entries_.size();
+    const auto& entry = entries_[index];
+    datagrams.push_back(Datagram{
+        entry.time,
+        entry.direction,
+        entry.peer,
+        entry.length,
+        folly::ByteRange(
+            data_.data() + index * snapLength_, entry.captured)});
+  }
+  return datagrams;
+}
+
+std::unique_ptr<folly::IOBuf> encodePacketCapture(
+    const PacketCaptureRing& ring,
+    const folly::SocketAddress& local,
+    folly::StringPiece keyLog) {
+  auto buf = folly::IOBuf::create(kPacketCaptureGrowth);
+  Appender appender(buf.get(), kPacketCaptureGrowth);
+
+  appender.writeBE<uint32_t>(kSectionHeaderBlock);
+  appender.writeBE<uint32_t>(28);
+  appender.writeBE<uint32_t>(kByteOrderMagic);
+  appender.writeBE<uint16_t>(1);
+  appender.writeBE<uint16_t>(0);
+  // Section length not known.
+  appender.writeBE<int64_t>(-1);
+  appender.writeBE<uint32_t>(28);
+
+  // Timestamps are in microseconds, the default resolution.
+  appender.writeBE<uint32_t>(kInterfaceDescriptionBlock);
+  appender.writeBE<uint32_t>(20);
+  appender.writeBE<uint16_t>(kLinkTypeRaw);
+  appender.writeBE<uint16_t>(0);
+  appender.writeBE<uint32_t>(0);
+  appender.writeBE<uint32_t>(20);
+
+  if (!keyLog.empty()) {
+    uint32_t blockLen = 20 + keyLog.size() + paddingFor(keyLog.size());
+    appender.writeBE<uint32_t>(kDecryptionSecretsBlock);
+    appender.writeBE<uint32_t>(blockLen);
+    appender.writeBE<uint32_t>(kTlsKeyLogSecrets);
+    appender.writeBE<uint32_t>(keyLog.size());
+    appender.push(
+        reinterpret_cast<const uint8_t*>(keyLog.data()), keyLog.size());
+    writePadding(appender, keyLog.size());
+    appender.writeBE<uint32_t>(blockLen);
+  }
+
+  // Datagram times are on the steady clock, pcapng wants them on the wall
+  // clock.
+  auto steadyNow = Clock::now();
+  auto wallNow = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  std::array<uint8_t, kIPv6HeaderLen + kUdpHeaderLen> header;
+  for (const auto& datagram : ring.getDatagrams()) {
+    if (!datagram.peer.isInitialized() ||
+        (datagram.peer.getFamily() != AF_INET &&
+         datagram.peer.getFamily() != AF_INET6)) {
+      continue;
+    }
+    auto peerIp = captureAddress(datagram.peer.getIPAddress());
+    auto localIp = localAddressFor(local, peerIp);
+    uint16_t localPort = local.isInitialized() ? local.getPort() : 0;
+    bool sent = datagram.direction == PacketCaptureRing::Direction::Sent;
+    auto headerLen = sent
+        ? writeHeaders(
+              header,
+              localIp,
+              localPort,
+              peerIp,
+              datagram.peer.getPort(),
+              datagram.length)
+        : writeHeaders(
+              header,
+              peerIp,
+              datagram.peer.getPort(),
+              localIp,
+              localPort,
+              datagram.length);
+    uint32_t capturedLen = headerLen + datagram.data.size();
+    uint32_t blockLen = 44 + capturedLen + paddingFor(capturedLen);
+    uint64_t time = (wallNow -
+                     std::chrono::duration_cast<std::chrono::microseconds>(
+                         steadyNow - datagram.time))
+                        .count();
+    appender.writeBE<uint32_t>(kEnhancedPacketBlock);
+    appender.writeBE<uint32_t>(blockLen);
+    // Interface id.
+    appender.writeBE<uint32_t>(0);
+    appender.writeBE<uint32_t>(time >> 32);
+    appender.writeBE<uint32_t>(time & 0xffffffff);
+    appender.writeBE<uint32_t>(capturedLen);
+    appender.writeBE<uint32_t>(headerLen + datagram.length);
+    appender.push(header.data(), headerLen);
+    appender.push(datagram.data.data(), datagram.data.size());
+    writePadding(appender, capturedLen);
+    appender.writeBE<uint16_t>(kEpbFlagsOption);
+    appender.writeBE<uint16_t>(4);
+    appender.writeBE<uint32_t>(sent ? kEpbOutbound : kEpbInbound);
+    // End of options.
+    appender.writeBE<uint32_t>(0);
+    appender.writeBE<uint32_t>(blockLen);
+  }
+  return buf;
+}
+
+} // namespace quic
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+#include <quic/QuicConstants.h>
+#include <quic/codec/QuicConnectionId.h>
+
+#include <vector>
+
+namespace quic {
+
+enum class PacketCaptureTrigger : uint8_t {
+  // dumped by the application, see QuicTransportBase::dumpPacketCapture
+  Requested,
+  // packetCapturePtoThreshold consecutive PTOs
+  PtoStorm,
+  // closed with an error, either side
+  AbnormalClose,
+};
+
+folly::StringPiece toString(PacketCaptureTrigger trigger);
+
+/**
+ * The last datagrams a connection sent and received, up to snapLength bytes
+ * of each.
+ *
+ * Storage for all of them is allocated up front, so recording a datagram
+ * copies its first bytes over the oldest one and never allocates. A
+ * connection without a ring pays a null check per datagram.
+ */
+class PacketCaptureRing {
+ public:
+  enum class Direction : uint8_t {
+    Received,
+    Sent,
+  };
+
+  struct Datagram {
+    TimePoint time;
+    Direction direction;
+    folly::SocketAddress peer;
+    // length on the wire
+    uint32_t length;
+    // the first bytes of it, up to snapLength
+    folly::ByteRange data;
+  };
+
+  PacketCaptureRing(size_t maxDatagrams, size_t snapLength);
+
+  void record(
+      Direction direction,
+      TimePoint time,
+      const folly::SocketAddress& peer,
+      const folly::IOBuf& datagram);
+
+  // The datagrams held, oldest first. They point into the ring, and are
+  // only valid until the next record.
+  std::vector<Datagram> getDatagrams() const;
+
+  // Datagrams the ring holds once full.
+  size_t capacity() const {
+    return entries_.size();
+  }
+
+  size_t snapLength() const {
+    return snapLength_;
+  }
+
+  // Datagrams recorded since the ring was made, including the ones it
+  // wrapped over.
+  uint64_t numRecorded() const {
+    return numRecorded_;
+  }
+
+ private:
+  struct Entry {
+    TimePoint time;
+    folly::SocketAddress peer;
+    uint32_t length{0};
+    uint32_t captured{0};
+    Direction direction{Direction::Received};
+  };
+
+  size_t snapLength_;
+  std::vector<Entry> entries_;
+  // snapLength bytes for each entry
+  std::vector<uint8_t> data_;
+  // entry the next datagram goes to
+  size_t next_{0};
+  uint64_t numRecorded_{0};
+};
+
+/**
+ * Encodes the datagrams of ring as a pcapng file, which Wireshark reads
+ * along with the keys to decrypt them.
+ *
+ * Each datagram gets an IP and UDP header between local and peer, and the
+ * direction it went in. keyLog, the secrets of the connection in the NSS key
+ * log format, goes in a Decryption Secrets Block ahead of them. Only the
+ * datagrams that were captured whole can be decrypted.
+ */
+std::unique_ptr<folly::IOBuf> encodePacketCapture(
+    const PacketCaptureRing& ring,
+    const folly::SocketAddress& local,
+    folly::StringPiece keyLog);
+
+/**
+ * Where a transport hands its packet capture over when something goes
+ * wrong on its connection, see PacketCaptureTrigger. Called on the thread of
+ * the transport.
+ */
+class PacketCaptureCallback {
+ public:
+  virtual ~PacketCaptureCallback() = default;
+
+  // capture is encoded with encodePacketCapture. connId is the connection
+  // id of the client, if known.
+  virtual void onPacketCapture(
+      PacketCaptureTrigger trigger,
+      const folly::Optional<ConnectionId>& connId,
+      std::unique_ptr<folly::IOBuf> capture) noexcept = 0;
+};
+
+} // namespace quic
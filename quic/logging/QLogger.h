@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <folly/Range.h>
 #include <quic/logging/QLoggerTypes.h>
 
 namespace quic {
@@ -19,6 +20,9 @@ class QLogger {
   std::chrono::steady_clock::time_point refTimePoint{
       std::chrono::steady_clock::now()};
   std::string protocolType;
+  // Set from TransportSettings::qLogEvents and qLogPacketSampleRate.
+  uint32_t enabledEvents{kQLogAllEvents};
+  uint32_t packetSampleRate{1};
   QLogger() = default;
   virtual ~QLogger() = default;
   virtual void addPacket(
@@ -50,14 +54,16 @@ class QLogger {
   virtual void addCongestionMetricUpdate(
       uint64_t bytesInFlight,
       uint64_t currentCwnd,
-      std::string congestionEvent,
-      std::string state = "",
-      std::string recoveryState = "") = 0;
+      folly::StringPiece congestionEvent,
+      folly::StringPiece state = "",
+      folly::StringPiece recoveryState = "") = 0;
   virtual void addPacingMetricUpdate(
       uint64_t pacingBurstSizeIn,
       std::chrono::microseconds pacingIntervalIn) = 0;
-  virtual void addAppIdleUpdate(std::string idleEvent, bool idle) = 0;
-  virtual void addPacketDrop(size_t packetSize, std::string dropReasonIn) = 0;
+  virtual void addAppIdleUpdate(folly::StringPiece idleEvent, bool idle) = 0;
+  virtual void addPacketDrop(
+      size_t packetSize,
+      folly::StringPiece dropReasonIn) = 0;
   virtual void addDatagramReceived(uint64_t dataLen) = 0;
   virtual void addLossAlarm(
       PacketNum largestSent,
@@ -68,7 +74,24 @@ class QLogger {
       PacketNum largestLostPacketNum,
       uint64_t lostBytes,
       uint64_t lostPackets) = 0;
-  virtual void addTransportStateUpdate(std::string update) = 0;
+  virtual void addTransportStateUpdate(folly::StringPiece update) = 0;
+
+  /**
+   * Whether events of the type are logged. Checked by the callers of the
+   * frequent events before building their arguments.
+   */
+  bool isEnabled(QLogEventType type) const {
+    return enabledEvents & (1u << static_cast<uint32_t>(type));
+  }
+
+  /**
+   * Same as isEnabled for a packet event, also counting the packet toward
+   * packetSampleRate: true for one packet in packetSampleRate.
+   */
+  bool samplePacket(QLogEventType type) {
+    return isEnabled(type) && packetsSeen_++ % packetSampleRate == 0;
+  }
+
   std::unique_ptr<QLogPacketEvent> createPacketEvent(
       const RegularQuicPacket& regularPacket,
       uint64_t packetSize);
@@ -81,5 +104,8 @@ class QLogger {
       const VersionNegotiationPacket& versionPacket,
       uint64_t packetSize,
       bool isPacketRecvd);
+
+ private:
+  uint64_t packetsSeen_{0};
 };
 } // namespace quic
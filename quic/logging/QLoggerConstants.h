@@ -10,6 +10,8 @@
 
 #include <folly/String.h>
 
+#include <chrono>
+
 namespace quic {
 constexpr folly::StringPiece kShortHeaderPacketType = "1RTT";
 constexpr folly::StringPiece kVersionNegotiationPacketType =
@@ -37,8 +39,16 @@ constexpr folly::StringPiece kCongestionPacketSent =
     "congestion on packet sent";
 constexpr folly::StringPiece kCopaCheckAndUpdateDirection =
     "copa check and update direction";
+constexpr folly::StringPiece kCopaCompetitiveMode = "copa competitive mode";
+constexpr folly::StringPiece kCopaDefaultMode = "copa default mode";
 constexpr folly::StringPiece kCongestionPacketLoss = "congestion packet loss";
+constexpr folly::StringPiece kCongestionEcnCe = "congestion ecn ce";
+constexpr folly::StringPiece kCubicEcnCe = "cubic ecn ce";
+constexpr folly::StringPiece kCarefulResume = "careful resume";
+constexpr folly::StringPiece kCongestionLossUndo = "congestion loss undo";
 constexpr folly::StringPiece kCongestionAppLimited = "congestion app limited";
+constexpr folly::StringPiece kCongestionControlParams =
+    "congestion control params";
 constexpr folly::StringPiece kCongestionAppUnlimited =
     "congestion app unlimited";
 constexpr uint64_t kDefaultCwnd = 12320;
@@ -56,5 +66,11 @@ constexpr folly::StringPiece kBufferUnavailable = "buffer unavailable";
 constexpr folly::StringPiece kReset = "reset";
 constexpr folly::StringPiece kPtoAlarm = "pto alarm";
 constexpr folly::StringPiece kHandshakeAlarm = "handshake alarm";
+constexpr folly::StringPiece kWriteLimited = "write limited: ";
+
+// Events a QLogWriter buffers before dropping new ones, and how often its
+// thread writes them out.
+constexpr size_t kDefaultQLogWriterCapacity = 10000;
+constexpr std::chrono::milliseconds kDefaultQLogWriterFlushInterval{100};
 
 } // namespace quic
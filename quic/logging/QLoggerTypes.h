@@ -154,11 +154,11 @@ class StreamDataBlockedFrameLog : public QLogFrame {
 
 class ReadAckFrameLog : public QLogFrame {
  public:
-  std::vector<AckBlock> ackBlocks;
+  ReadAckBlocks ackBlocks;
   std::chrono::microseconds ackDelay;
 
   ReadAckFrameLog(
-      const std::vector<AckBlock>& ackBlocksIn,
+      const ReadAckBlocks& ackBlocksIn,
       std::chrono::microseconds ackDelayIn)
       : ackBlocks{ackBlocksIn}, ackDelay{ackDelayIn} {}
   ~ReadAckFrameLog() override = default;
@@ -102,6 +102,12 @@ void quicTraceLogger(std::string name, const T& conn, Args&&... args) {
         TAKE_ATMOST_8(__VA_ARGS__));                                          \
   } while (false);
 
+// Static tracepoint for the hot paths, without the logging of QUIC_TRACE: it
+// is a nop unless a tracer such as bpftrace is attached. Its first argument is
+// the address of the connection state, to tell connections apart, followed by
+// up to 7 integer or pointer arguments, which are evaluated regardless.
+#define QUIC_PROBE(name, conn, ...) FOLLY_SDT(quic, name, &(conn), __VA_ARGS__)
+
 #define QUIC_TRACE_SOCK(name, sock, ...)                \
   if (sock && sock->getState()) {                       \
     QUIC_TRACE(name, *(sock)->getState(), __VA_ARGS__); \
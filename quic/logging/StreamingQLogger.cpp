@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/logging/StreamingQLogger.h>
+
+#include <folly/json.h>
+
+namespace quic {
+
+QLogWriter::QLogWriter(
+    const std::string& path,
+    size_t capacity,
+    std::chrono::milliseconds flushInterval)
+    // One slot of a ProducerConsumerQueue is always left empty.
+    : lines_(capacity + 1),
+      file_(path, std::ios::app | std::ios::binary),
+      flushInterval_(flushInterval) {
+  if (!file_) {
+    LOG(ERROR) << "Error: Can't write to provided path: " << path;
+  }
+  thread_ = std::thread([this] { run(); });
+}
+
+QLogWriter::~QLogWriter() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stop_ = true;
+  }
+  stopCv_.notify_one();
+  thread_.join();
+}
+
+bool QLogWriter::write(std::string line) {
+  line.push_back('\n');
+  return writeRaw(std::move(line));
+}
+
+bool QLogWriter::writeRaw(std::string data) {
+  if (!lines_.write(std::move(data))) {
+    droppedLines_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void QLogWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    stopCv_.wait_for(lock, flushInterval_);
+    lock.unlock();
+    drain();
+    lock.lock();
+  }
+}
+
+void QLogWriter::drain() {
+  std::string line;
+  bool wrote = false;
+  while (lines_.read(line)) {
+    file_ << line;
+    wrote = true;
+  }
+  if (wrote) {
+    file_.flush();
+  }
+}
+
+void StreamingQLogger::handleEvent(std::unique_ptr<QLogEvent> event) {
+  folly::dynamic line = folly::dynamic::object;
+  line["dcid"] = dcid.hasValue() ? dcid->hex() : "";
+  line["scid"] = scid.hasValue() ? scid->hex() : "";
+  line["protocol_type"] = protocolType;
+  line["event"] = event->toDynamic();
+  writer_->write(folly::toJson(line));
+}
+
+} // namespace quic
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/ProducerConsumerQueue.h>
+#include <quic/logging/FileQLogger.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace quic {
+
+/**
+ * Appends lines to a file from a thread of its own, so that writing qlog
+ * events costs the event loop a copy into a bounded ring. A line that does
+ * not fit in the ring is dropped and counted.
+ *
+ * Lines must all be written from the same thread, e.g. one writer per
+ * worker shared by the connections of the worker.
+ */
+class QLogWriter {
+ public:
+  explicit QLogWriter(
+      const std::string& path,
+      size_t capacity = kDefaultQLogWriterCapacity,
+      std::chrono::milliseconds flushInterval =
+          kDefaultQLogWriterFlushInterval);
+
+  // Writes out the lines still in the ring.
+  ~QLogWriter();
+
+  bool write(std::string line);
+
+  // Same as write without the line terminator, for encodings framing their
+  // records themselves.
+  bool writeRaw(std::string data);
+
+  uint64_t droppedLines() const {
+    return droppedLines_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void run();
+  void drain();
+
+  folly::ProducerConsumerQueue<std::string> lines_;
+  std::ofstream file_;
+  std::chrono::milliseconds flushInterval_;
+  std::atomic<uint64_t> droppedLines_{0};
+
+  std::mutex mutex_;
+  std::condition_variable stopCv_;
+  bool stop_{false};
+  std::thread thread_;
+};
+
+/**
+ * A QLogger that writes each event out as it happens, instead of keeping
+ * all of them until the connection is gone: memory stays constant however
+ * long the connection runs.
+ *
+ * Events go to a QLogWriter one JSON object per line (NDJSON), with the
+ * connection ids in each line since a writer is shared by connections:
+ *   {"dcid":"...","scid":"...","protocol_type":"...","event":[...]}
+ * where event is in the event_fields format of FileQLogger's output.
+ * logs is always empty.
+ */
+class StreamingQLogger : public FileQLogger {
+ public:
+  explicit StreamingQLogger(
+      std::shared_ptr<QLogWriter> writer,
+      std::string protocolTypeIn = kHTTP3ProtocolType.str())
+      : FileQLogger(std::move(protocolTypeIn)), writer_(std::move(writer)) {}
+
+  ~StreamingQLogger() override = default;
+
+ protected:
+  void handleEvent(std::unique_ptr<QLogEvent> event) override;
+
+ private:
+  std::shared_ptr<QLogWriter> writer_;
+};
+
+} // namespace quic
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/logging/PacketCapture.h>
+
+#include <folly/io/Cursor.h>
+#include <gtest/gtest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+std::unique_ptr<folly::IOBuf> makeDatagram(uint8_t fill, size_t len) {
+  auto buf = folly::IOBuf::create(len);
+  memset(buf->writableData(), fill, len);
+  buf->append(len);
+  return buf;
+}
+} // namespace
+
+class PacketCaptureTest : public Test {
+ public:
+  folly::SocketAddress peer_{"1.2.3.4", 4433};
+  folly::SocketAddress local_{"5.6.7.8", 443};
+  TimePoint now_{Clock::now()};
+};
+
+TEST_F(PacketCaptureTest, KeepsLastDatagrams) {
+  PacketCaptureRing ring(2, 8);
+  EXPECT_TRUE(ring.getDatagrams().empty());
+  for (uint8_t i = 0; i < 3; i++) {
+    ring.record(
+        i % 2 ? PacketCaptureRing::Direction::Sent
+              : PacketCaptureRing::Direction::Received,
+        now_ + std::chrono::milliseconds(i),
+        peer_,
+        *makeDatagram(i, 4 + i));
+  }
+  EXPECT_EQ(3u, ring.numRecorded());
+  auto datagrams = ring.getDatagrams();
+  ASSERT_EQ(2u, datagrams.size());
+  EXPECT_EQ(PacketCaptureRing::Direction::Sent, datagrams[0].direction);
+  EXPECT_EQ(5u, datagrams[0].length);
+  EXPECT_EQ(5u, datagrams[0].data.size());
+  EXPECT_EQ(1, datagrams[0].data[0]);
+  EXPECT_EQ(PacketCaptureRing::Direction::Received, datagrams[1].direction);
+  EXPECT_EQ(now_ + std::chrono::milliseconds(2), datagrams[1].time);
+  EXPECT_EQ(peer_, datagrams[1].peer);
+  EXPECT_EQ(2, datagrams[1].data[5]);
+}
+
+TEST_F(PacketCaptureTest, TruncatesChains) {
+  PacketCaptureRing ring(4, 8);
+  auto datagram = makeDatagram(1, 6);
+  datagram->prependChain(makeDatagram(2, 6));
+  ring.record(PacketCaptureRing::Direction::Sent, now_, peer_, *datagram);
+  auto datagrams = ring.getDatagrams();
+  ASSERT_EQ(1u, datagrams.size());
+  EXPECT_EQ(12u, datagrams[0].length);
+  ASSERT_EQ(8u, datagrams[0].data.size());
+  EXPECT_EQ(1, datagrams[0].data[5]);
+  EXPECT_EQ(2, datagrams[0].data[6]);
+}
+
+TEST_F(PacketCaptureTest, EncodesPcapng) {
+  PacketCaptureRing ring(4, 16);
+  ring.record(
+      PacketCaptureRing::Direction::Received,
+      now_,
+      peer_,
+      *makeDatagram(1, 10));
+  ring.record(
+      PacketCaptureRing::Direction::Sent, now_, peer_, *makeDatagram(2, 20));
+  std::string keyLog = "CLIENT_TRAFFIC_SECRET_0 00 01\n";
+  auto capture = encodePacketCapture(ring, local_, keyLog);
+  folly::io::Cursor cursor(capture.get());
+
+  EXPECT_EQ(0x0A0D0D0Au, cursor.readBE<uint32_t>());
+  cursor.skip(24);
+  // Interface with raw IP packets.
+  EXPECT_EQ(1u, cursor.readBE<uint32_t>());
+  cursor.skip(4);
+  EXPECT_EQ(101, cursor.readBE<uint16_t>());
+  cursor.skip(10);
+
+  EXPECT_EQ(0x0Au, cursor.readBE<uint32_t>());
+  auto secretsLen = cursor.readBE<uint32_t>();
+  EXPECT_EQ(0u, secretsLen % 4);
+  EXPECT_EQ(0x544c534bu, cursor.readBE<uint32_t>());
+  EXPECT_EQ(keyLog.size(), cursor.readBE<uint32_t>());
+  EXPECT_EQ(keyLog, cursor.readFixedString(keyLog.size()));
+  cursor.skip(secretsLen - 16 - keyLog.size());
+
+  // Received from the peer, whole.
+  EXPECT_EQ(6u, cursor.readBE<uint32_t>());
+  auto blockLen = cursor.readBE<uint32_t>();
+  cursor.skip(12);
+  EXPECT_EQ(38u, cursor.readBE<uint32_t>());
+  EXPECT_EQ(38u, cursor.readBE<uint32_t>());
+  EXPECT_EQ(0x45, cursor.read<uint8_t>());
+  cursor.skip(11);
+  EXPECT_EQ(
+      peer_.getIPAddress().asV4().toLongHBO(), cursor.readBE<uint32_t>());
+  EXPECT_EQ(
+      local_.getIPAddress().asV4().toLongHBO(), cursor.readBE<uint32_t>());
+  EXPECT_EQ(peer_.getPort(), cursor.readBE<uint16_t>());
+  EXPECT_EQ(local_.getPort(), cursor.readBE<uint16_t>());
+  EXPECT_EQ(18, cursor.readBE<uint16_t>());
+  cursor.skip(2 + 10 + 2);
+  EXPECT_EQ(2, cursor.readBE<uint16_t>());
+  EXPECT_EQ(4, cursor.readBE<uint16_t>());
+  EXPECT_EQ(1u, cursor.readBE<uint32_t>());
+  cursor.skip(4);
+  EXPECT_EQ(blockLen, cursor.readBE<uint32_t>());
+
+  // Sent to the peer, truncated.
+  EXPECT_EQ(6u, cursor.readBE<uint32_t>());
+  blockLen = cursor.readBE<uint32_t>();
+  cursor.skip(12);
+  EXPECT_EQ(44u, cursor.readBE<uint32_t>());
+  EXPECT_EQ(48u, cursor.readBE<uint32_t>());
+  cursor.skip(44);
+  EXPECT_EQ(2, cursor.readBE<uint16_t>());
+  EXPECT_EQ(4, cursor.readBE<uint16_t>());
+  EXPECT_EQ(2u, cursor.readBE<uint32_t>());
+  cursor.skip(4);
+  EXPECT_EQ(blockLen, cursor.readBE<uint32_t>());
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(PacketCaptureTest, EncodesMappedAddresses) {
+  PacketCaptureRing ring(1, 16);
+  folly::SocketAddress mappedPeer("::ffff:1.2.3.4", 4433);
+  ring.record(
+      PacketCaptureRing::Direction::Received,
+      now_,
+      mappedPeer,
+      *makeDatagram(1, 4));
+  // Bound to any address of both families.
+  auto capture =
+      encodePacketCapture(ring, folly::SocketAddress("::", 443), "");
+  folly::io::Cursor cursor(capture.get());
+  // Section header and interface, no secrets.
+  cursor.skip(28 + 20);
+  EXPECT_EQ(6u, cursor.readBE<uint32_t>());
+  cursor.skip(24);
+  EXPECT_EQ(0x45, cursor.read<uint8_t>());
+  cursor.skip(11);
+  EXPECT_EQ(
+      peer_.getIPAddress().asV4().toLongHBO(), cursor.readBE<uint32_t>());
+  EXPECT_EQ(0u, cursor.readBE<uint32_t>());
+}
+
+} // namespace test
+} // namespace quic
@@ -8,11 +8,16 @@
 
 #include <quic/logging/QLogger.h>
 
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/experimental/TestUtil.h>
 #include <folly/json.h>
 #include <gtest/gtest.h>
 #include <quic/common/test/TestUtils.h>
 #include <quic/congestion_control/Bbr.h>
+#include <quic/logging/BinaryQLogger.h>
 #include <quic/logging/FileQLogger.h>
+#include <quic/logging/StreamingQLogger.h>
 
 using namespace quic;
 using namespace testing;
@@ -925,4 +930,100 @@ TEST_F(QLoggerTest, TransportStateUpdateFollyDynamic) {
   EXPECT_EQ(expected, gotEvents);
 }
 
+TEST_F(QLoggerTest, StreamingQLoggerWritesLines) {
+  folly::test::TemporaryDirectory dir;
+  auto path = (dir.path() / "qlog").string();
+  {
+    auto writer = std::make_shared<QLogWriter>(path);
+    StreamingQLogger q(writer);
+    q.dcid = getTestConnectionId(0);
+    q.addTransportStateUpdate("transport ready");
+    q.addPacketDrop(100, "parse");
+    EXPECT_TRUE(q.logs.empty());
+  }
+
+  std::string contents;
+  ASSERT_TRUE(folly::readFile(path.c_str(), contents));
+  std::vector<folly::StringPiece> lines;
+  folly::split('\n', folly::trimWhitespace(contents), lines);
+  ASSERT_EQ(2, lines.size());
+  auto first = folly::parseJson(lines[0]);
+  EXPECT_EQ(getTestConnectionId(0).hex(), first["dcid"].asString());
+  EXPECT_EQ("TRANSPORT_STATE_UPDATE", first["event"][2].asString());
+  auto second = folly::parseJson(lines[1]);
+  EXPECT_EQ("PACKET_DROP", second["event"][2].asString());
+}
+
+TEST_F(QLoggerTest, QLogWriterDropsWhenFull) {
+  folly::test::TemporaryDirectory dir;
+  auto path = (dir.path() / "qlog").string();
+  {
+    QLogWriter writer(path, 1, std::chrono::hours(1));
+    EXPECT_TRUE(writer.write("a"));
+    EXPECT_FALSE(writer.write("b"));
+    EXPECT_EQ(1, writer.droppedLines());
+  }
+  std::string contents;
+  ASSERT_TRUE(folly::readFile(path.c_str(), contents));
+  EXPECT_EQ("a\n", contents);
+}
+
+TEST_F(QLoggerTest, BinaryQLoggerRoundTrip) {
+  folly::test::TemporaryDirectory dir;
+  auto path = (dir.path() / "qlog").string();
+  RegularQuicWritePacket packet =
+      createRegularQuicWritePacket(streamId, offset, len, fin);
+  FileQLogger expected;
+  expected.dcid = getTestConnectionId(0);
+  auto logEvents = [&](FileQLogger& q) {
+    q.addPacket(packet, 10);
+    q.addCongestionMetricUpdate(20, 30, kPersistentCongestion.str());
+    q.addPacketDrop(100, kParse.str());
+    q.addPacketDrop(200, kParse.str());
+    q.addConnectionClose(kNoError.str(), kGracefulExit.str(), true, false);
+  };
+  logEvents(expected);
+  {
+    auto writer = std::make_shared<QLogWriter>(path);
+    BinaryQLogger q(writer);
+    q.dcid = getTestConnectionId(0);
+    logEvents(q);
+    // Another connection sharing the writer.
+    BinaryQLogger other(writer);
+    other.dcid = getTestConnectionId(1);
+    other.addTransportStateUpdate("transport ready");
+  }
+
+  std::string contents;
+  ASSERT_TRUE(folly::readFile(path.c_str(), contents));
+  auto buf = folly::IOBuf::wrapBufferAsValue(contents.data(), contents.size());
+  auto loggers = decodeBinaryQLog(buf);
+  ASSERT_TRUE(loggers.hasValue());
+  ASSERT_EQ(2, loggers->size());
+  auto& decoded = *(*loggers)[0];
+  EXPECT_EQ(getTestConnectionId(0), *decoded.dcid);
+  EXPECT_EQ(getTestConnectionId(1), *(*loggers)[1]->dcid);
+  EXPECT_EQ(1, (*loggers)[1]->logs.size());
+
+  auto expectedDynamic = expected.toDynamic();
+  auto decodedDynamic = decoded.toDynamic();
+  auto& expectedEvents = expectedDynamic["traces"][0]["events"];
+  auto& decodedEvents = decodedDynamic["traces"][0]["events"];
+  ASSERT_EQ(expectedEvents.size(), decodedEvents.size());
+  for (size_t i = 0; i < expectedEvents.size(); i++) {
+    // hardcode reference time
+    expectedEvents[i][0] = "0";
+    decodedEvents[i][0] = "0";
+  }
+  EXPECT_EQ(expectedDynamic, decodedDynamic);
+
+  // The record being written when the process died is left out.
+  auto truncated = folly::IOBuf::wrapBufferAsValue(
+      contents.data(), contents.size() - 1);
+  loggers = decodeBinaryQLog(truncated);
+  ASSERT_TRUE(loggers.hasValue());
+  EXPECT_EQ(expected.logs.size(), (*loggers)[0]->logs.size());
+  EXPECT_TRUE((*loggers)[1]->logs.empty());
+}
+
 } // namespace quic::test
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <glog/logging.h>
+
+#include <folly/FileUtil.h>
+#include <folly/init/Init.h>
+#include <folly/portability/GFlags.h>
+
+#include <quic/logging/BinaryQLogger.h>
+
+DEFINE_string(input, "", "Binary qlog file to convert");
+DEFINE_string(output_dir, ".", "Directory to write the <dcid>.qlog files to");
+DEFINE_bool(pretty, false, "Pretty print the JSON");
+
+int main(int argc, char* argv[]) {
+#if FOLLY_HAVE_LIBGFLAGS
+  // Enable glog logging to stderr by default.
+  gflags::SetCommandLineOptionWithMode(
+      "logtostderr", "1", gflags::SET_FLAGS_DEFAULT);
+#endif
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+  folly::Init init(&argc, &argv);
+
+  std::string data;
+  if (FLAGS_input.empty() || !folly::readFile(FLAGS_input.c_str(), data)) {
+    LOG(ERROR) << "Can't read --input=" << FLAGS_input;
+    return 1;
+  }
+  auto buf = folly::IOBuf::wrapBufferAsValue(data.data(), data.size());
+  auto loggers = quic::decodeBinaryQLog(buf);
+  if (!loggers) {
+    return 1;
+  }
+  for (const auto& logger : *loggers) {
+    // One file per connection, as FileQLogger writes them.
+    logger->outputLogsToFile(FLAGS_output_dir, FLAGS_pretty);
+  }
+  LOG(INFO) << "Converted " << loggers->size() << " connections";
+  return 0;
+}
@@ -27,6 +27,100 @@ bool isPersistentCongestion(
       pto * kPersistentCongestionThreshold;
 }
 
+bool isPersistentCongestion(
+    const QuicConnectionStateBase& conn,
+    const CongestionController::LossEvent& lossEvent) noexcept {
+  if (conn.lossState.srtt == 0us) {
+    return false;
+  }
+  return lossEvent.longestLostPeriod >=
+      calculatePTO(conn) * kPersistentCongestionThreshold;
+}
+
+void trackLostPacket(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    PacketNumberSpace pnSpace,
+    TimePoint lossTime,
+    PacketNum largestAcked,
+    bool lostByTime,
+    bool lostByReordering) {
+  auto& lostPackets = conn.lossState.lostPackets;
+  if (lostPackets.size() == kMaxTrackedLostPackets) {
+    lostPackets.pop_front();
+  }
+  lostPackets.push_back(LossState::LostPacket{packetNum,
+                                              pnSpace,
+                                              lossTime,
+                                              largestAcked,
+                                              lostByTime,
+                                              lostByReordering});
+}
+
+void onLossEventForReordering(QuicConnectionStateBase& conn) {
+  if (++conn.lossState.lossEventsSinceSpuriousLoss <
+      kReorderingThresholdResetLossEvents) {
+    return;
+  }
+  conn.lossState.lossEventsSinceSpuriousLoss = 0;
+  conn.lossState.reorderingThreshold = kReorderingThreshold;
+  conn.lossState.timeReorderingThreshold = kTimeReorderingThreshold;
+}
+
+void detectSpuriousLosses(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    const ReadAckFrame& frame,
+    TimePoint ackTime) {
+  auto& lostPackets = conn.lossState.lostPackets;
+  auto pto = calculatePTO(conn);
+  bool timeThresholdRaised = false;
+  auto isAcked = [&](PacketNum packetNum) {
+    return std::any_of(
+        frame.ackBlocks.begin(),
+        frame.ackBlocks.end(),
+        [packetNum](const AckBlock& block) {
+          return packetNum >= block.startPacket &&
+              packetNum <= block.endPacket;
+        });
+  };
+  auto it = lostPackets.begin();
+  while (it != lostPackets.end()) {
+    if (it->pnSpace != pnSpace) {
+      ++it;
+      continue;
+    }
+    if (!isAcked(it->packetNum)) {
+      // An ack this late would not help anymore, the packet was
+      // retransmitted and the congestion controller moved on.
+      it = ackTime - it->lossTime > pto ? lostPackets.erase(it) : it + 1;
+      continue;
+    }
+    VLOG(10) << __func__ << " spurious loss packetNum=" << it->packetNum
+             << " " << conn;
+    if (it->lostByReordering) {
+      conn.lossState.reorderingThreshold = std::max(
+          conn.lossState.reorderingThreshold,
+          static_cast<uint32_t>(std::min<uint64_t>(
+              kMaxReorderingThreshold, it->largestAcked - it->packetNum)));
+    }
+    if (it->lostByTime && !timeThresholdRaised) {
+      // Once per ack, the packets of one loss event were late together.
+      conn.lossState.timeReorderingThreshold = std::min(
+          kMaxTimeReorderingThreshold,
+          conn.lossState.timeReorderingThreshold + 1);
+      timeThresholdRaised = true;
+    }
+    conn.lossState.spuriousLossCount++;
+    conn.lossState.lossEventsSinceSpuriousLoss = 0;
+    auto lossTime = it->lossTime;
+    it = lostPackets.erase(it);
+    if (conn.congestionController) {
+      conn.congestionController->onSpuriousLoss(lossTime);
+    }
+  }
+}
+
 void onPTOAlarm(QuicConnectionStateBase& conn) {
   VLOG(10) << __func__ << " " << conn;
   QUIC_TRACE(
@@ -35,6 +129,11 @@ void onPTOAlarm(QuicConnectionStateBase& conn) {
       conn.lossState.largestSent,
       conn.lossState.ptoCount,
       (uint64_t)conn.outstandingPackets.size());
+  QUIC_PROBE(
+      pto_fired,
+      conn,
+      conn.lossState.ptoCount,
+      conn.outstandingPackets.size());
   QUIC_STATS(conn.infoCallback, onPTO);
   conn.lossState.ptoCount++;
   conn.lossState.totalPTOCount++;
@@ -82,6 +181,11 @@ void markPacketLoss(
             onConnWindowUpdateLost(conn);
           }
         },
+        [&](MaxStreamsFrame& frame) {
+          // Like window updates, only the latest limit needs to be sent again.
+          conn.streamManager->onStreamLimitUpdateLost(
+              frame.isForBidirectionalStream(), frame.maxStreams);
+        },
         // For other frame types, we only process them if the packet is not a
         // processed clone.
         [&](WriteStreamFrame& frame) {
@@ -110,15 +214,7 @@ void markPacketLoss(
           if (!ackFrameMatchesRetransmitBuffer(*stream, frame, *bufferItr)) {
             return;
           }
-          stream->lossBuffer.insert(
-              std::upper_bound(
-                  stream->lossBuffer.begin(),
-                  stream->lossBuffer.end(),
-                  bufferItr->offset,
-                  [](const auto& offset, const auto& buffer) {
-                    return offset < buffer.offset;
-                  }),
-              std::move(*bufferItr));
+          insertIntoLossBuffer(*stream, std::move(*bufferItr));
           stream->retransmissionBuffer.erase(bufferItr);
           conn.streamManager->updateLossStreams(*stream);
         },
@@ -42,6 +42,48 @@ bool isPersistentCongestion(
     TimePoint lostPeriodStart,
     TimePoint lostPeriodEnd) noexcept;
 
+/**
+ * Whether the longest lost period of the loss event, over which every packet
+ * sent was lost, is long enough for a persistent congestion. Costs the same
+ * however many packets the event has.
+ */
+bool isPersistentCongestion(
+    const QuicConnectionStateBase& conn,
+    const CongestionController::LossEvent& lossEvent) noexcept;
+
+/**
+ * Remembers a packet declared lost by detectLossPackets, to detect an ack of
+ * it later as a spurious loss.
+ */
+void trackLostPacket(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    PacketNumberSpace pnSpace,
+    TimePoint lossTime,
+    PacketNum largestAcked,
+    bool lostByTime,
+    bool lostByReordering);
+
+/**
+ * Called for every non empty LossEvent with spurious loss detection, puts the
+ * reordering thresholds back to their defaults after
+ * kReorderingThresholdResetLossEvents loss events without a spurious loss.
+ */
+void onLossEventForReordering(QuicConnectionStateBase& conn);
+
+/**
+ * Finds the tracked lost packets that the ack frame acks. Like RACK, the
+ * reordering threshold a spurious loss exceeded grows so that the same
+ * reordering isn't declared lost again, and the congestion controller hears
+ * about each of them to undo its response to the loss. Tracked packets older
+ * than a PTO are forgotten.
+ */
+void detectSpuriousLosses(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    const ReadAckFrame& frame,
+    TimePoint ackTime);
+
 inline std::ostream& operator<<(
     std::ostream& os,
     const LossState::AlarmMethod& alarmMethod) {
@@ -213,14 +255,22 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
     PacketNumberSpace pnSpace) {
   getLossTime(conn, pnSpace).clear();
   std::chrono::microseconds delayUntilLost =
-      std::max(conn.lossState.srtt, conn.lossState.lrtt) * 9 / 8;
+      std::max(conn.lossState.srtt, conn.lossState.lrtt) *
+      conn.lossState.timeReorderingThreshold / 8;
   VLOG(10) << __func__ << " outstanding=" << conn.outstandingPackets.size()
            << " largestAcked=" << largestAcked
            << " delayUntilLost=" << delayUntilLost.count() << "us"
            << " " << conn;
   CongestionController::LossEvent lossEvent(lossTime);
   // Note that time based loss detection is also within the same PNSpace.
+  // Lost packets are removed the same way acked packets are: packets of other
+  // spaces are moved over the holes left by lost ones, and the holes
+  // [remainingIt, skippedIt) are erased once at the end. The walk stops at the
+  // first packet that is not lost, so its cost is the number of lost packets
+  // plus the interleaved packets of other spaces.
   auto iter = getFirstOutstandingPacket(conn, pnSpace);
+  auto remainingIt = iter;
+  auto skippedIt = iter;
   bool shouldSetTimer = false;
   while (iter != conn.outstandingPackets.end()) {
     auto& pkt = *iter;
@@ -237,18 +287,40 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
       iter++;
       continue;
     }
-    bool lost = (lossTime - pkt.time) > delayUntilLost;
-    lost = lost ||
+    bool lostByTime = (lossTime - pkt.time) > delayUntilLost;
+    bool lostByReordering =
         (largestAcked - currentPacketNum) > conn.lossState.reorderingThreshold;
-    if (!lost) {
+    if (!lostByTime && !lostByReordering) {
       // We can exit early here because if packet N doesn't meet the
       // threshold, then packet N + 1 will not either.
       shouldSetTimer = true;
       break;
     }
-    if (!pkt.pureAck) {
+    remainingIt = remainingIt == skippedIt
+        ? iter
+        : std::move(skippedIt, iter, remainingIt);
+    if (pnSpace == PacketNumberSpace::AppData &&
+        onPmtuPacketLost(conn, currentPacketNum, pkt.encodedSize, lossTime)) {
+      // A lost path MTU probe is not a congestion signal, it only leaves the
+      // bytes in flight.
+      if (conn.congestionController) {
+        conn.congestionController->onRemoveBytesFromInflight(pkt.encodedSize);
+      }
+      lossEvent.skipLostPacket(currentPacketNum);
+    } else if (!pkt.pureAck) {
       lossEvent.addLostPacket(pkt);
+      if (conn.transportSettings.spuriousLossDetectionEnabled) {
+        trackLostPacket(
+            conn,
+            currentPacketNum,
+            pnSpace,
+            lossTime,
+            largestAcked,
+            lostByTime,
+            lostByReordering);
+      }
     } else {
+      lossEvent.skipLostPacket(currentPacketNum);
       DCHECK_GT(conn.outstandingPureAckPacketsCount, 0);
       --conn.outstandingPureAckPacketsCount;
     }
@@ -272,16 +344,20 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
     VLOG(10) << __func__ << " lost packetNum=" << currentPacketNum
              << " pureAck=" << pkt.pureAck << " handshake=" << pkt.isHandshake
              << " " << conn;
-    iter = conn.outstandingPackets.erase(iter);
+    skippedIt = ++iter;
   }
-
-  auto earliest = getFirstOutstandingPacket(conn, pnSpace);
-  for (; earliest != conn.outstandingPackets.end();
-       earliest = getNextOutstandingPacket(conn, pnSpace, earliest + 1)) {
-    if (!earliest->pureAck &&
-        (!earliest->associatedEvent ||
-         conn.outstandingPacketEvents.count(*earliest->associatedEvent))) {
-      break;
+  // Everything in this space before the erased range was lost, so the search
+  // for the earliest packet to arm the timer on can start right after it.
+  auto earliest = conn.outstandingPackets.erase(remainingIt, skippedIt);
+  if (shouldSetTimer) {
+    for (earliest = getNextOutstandingPacket(conn, pnSpace, earliest);
+         earliest != conn.outstandingPackets.end();
+         earliest = getNextOutstandingPacket(conn, pnSpace, earliest + 1)) {
+      if (!earliest->pureAck &&
+          (!earliest->associatedEvent ||
+           conn.outstandingPacketEvents.count(*earliest->associatedEvent))) {
+        break;
+      }
     }
   }
   if (shouldSetTimer && earliest != conn.outstandingPackets.end()) {
@@ -307,8 +383,18 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
         *lossEvent.largestLostPacketNum,
         lossEvent.lostBytes,
         lossEvent.lostPackets);
+    QUIC_PROBE(
+        loss_declared,
+        conn,
+        static_cast<uint8_t>(pnSpace),
+        *lossEvent.largestLostPacketNum,
+        lossEvent.lostBytes,
+        lossEvent.lostPackets);
 
     conn.lossState.rtxCount += lossEvent.lostPackets;
+    if (conn.transportSettings.spuriousLossDetectionEnabled) {
+      onLossEventForReordering(conn);
+    }
     if (conn.congestionController) {
       return lossEvent;
     }
@@ -400,11 +486,8 @@ void onLossDetectionAlarm(
         now,
         lossTimeAndSpace.second);
     if (conn.congestionController && lossEvent) {
-      DCHECK(lossEvent->largestLostSentTime && lossEvent->smallestLostSentTime);
-      lossEvent->persistentCongestion = isPersistentCongestion(
-          conn,
-          *lossEvent->smallestLostSentTime,
-          *lossEvent->largestLostSentTime);
+      lossEvent->persistentCongestion =
+          isPersistentCongestion(conn, *lossEvent);
       conn.congestionController->onPacketAckOrLoss(
           folly::none, std::move(lossEvent));
     }
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/loss/QuicLossFunctions.h>
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/QuicCubic.h>
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/AckHandlers.h>
+
+using namespace quic;
+using namespace quic::test;
+using namespace std::chrono_literals;
+
+/**
+ * Per-ack and per-alarm costs of the loss recovery hot paths as the number of
+ * outstanding packets grows. The ack benchmarks are in steady state: every
+ * iteration acks the next packets in flight and sends as many new ones as
+ * were acked or lost, so that the number of outstanding packets stays the
+ * same, as on a connection with a full window.
+ */
+
+namespace {
+
+constexpr uint64_t kPacketSize = 1000;
+
+// Which packets the peer never acks.
+enum class LossPattern {
+  None,
+  // One packet in every 100.
+  Sparse,
+  // Ten packets in a row in every 1000.
+  Burst,
+};
+
+bool isLost(LossPattern pattern, PacketNum packetNum) {
+  switch (pattern) {
+    case LossPattern::None:
+      return false;
+    case LossPattern::Sparse:
+      return packetNum % 100 == 0;
+    case LossPattern::Burst:
+      return packetNum % 1000 < 10;
+  }
+  folly::assume_unreachable();
+}
+
+struct LossBenchConnection {
+  explicit LossBenchConnection(size_t numOutstanding) {
+    conn = std::make_unique<QuicServerConnectionState>();
+    conn->congestionController = std::make_unique<Cubic>(*conn);
+    // Losses are only declared by packet threshold, time based loss detection
+    // would declare the whole window lost in a benchmark this long.
+    conn->lossState.srtt = 10s;
+    stream = conn->streamManager->createNextBidirectionalStream().value();
+    data = buildRandomInputData(kPacketSize);
+    for (size_t i = 0; i < numOutstanding; ++i) {
+      send();
+    }
+  }
+
+  void send() {
+    auto packetNum = nextPacketNum++;
+    auto offset = packetNum * kPacketSize;
+    RegularQuicWritePacket packet =
+        createNewPacket(packetNum, PacketNumberSpace::AppData);
+    packet.frames.emplace_back(
+        WriteStreamFrame(stream->id, offset, kPacketSize, false));
+    conn->lossState.totalBytesSent += kPacketSize;
+    conn->outstandingPackets.emplace_back(
+        std::move(packet),
+        Clock::now(),
+        kPacketSize,
+        false,
+        false,
+        conn->lossState.totalBytesSent);
+    conn->congestionController->onPacketSent(conn->outstandingPackets.back());
+    conn->lossState.largestSent = packetNum;
+  }
+
+  std::unique_ptr<QuicServerConnectionState> conn;
+  QuicStreamState* stream{nullptr};
+  Buf data;
+  PacketNum nextPacketNum{0};
+  PacketNum nextToAck{0};
+};
+
+const AckVisitor noopAckVisitor =
+    [](const OutstandingPacket&, const QuicWriteFrame&, const ReadAckFrame&) {
+    };
+
+const LossVisitor noopLossVisitor =
+    [](QuicConnectionStateBase&, RegularQuicWritePacket&, bool, PacketNum) {};
+
+// Iterations are single acks for the next packet the pattern doesn't lose.
+void processAck(uint32_t iters, size_t numOutstanding, LossPattern pattern) {
+  folly::Optional<LossBenchConnection> bench;
+  BENCHMARK_SUSPEND {
+    bench.emplace(numOutstanding);
+  }
+  auto& conn = *bench->conn;
+  for (uint32_t i = 0; i < iters; ++i) {
+    while (isLost(pattern, bench->nextToAck)) {
+      bench->nextToAck++;
+    }
+    ReadAckFrame ackFrame;
+    ackFrame.largestAcked = bench->nextToAck;
+    ackFrame.ackBlocks.emplace_back(bench->nextToAck, bench->nextToAck);
+    bench->nextToAck++;
+    auto outstandingBefore = conn.outstandingPackets.size();
+    processAckFrame(
+        conn,
+        PacketNumberSpace::AppData,
+        ackFrame,
+        noopAckVisitor,
+        noopLossVisitor,
+        Clock::now());
+    BENCHMARK_SUSPEND {
+      for (auto j = conn.outstandingPackets.size(); j < outstandingBefore;
+           ++j) {
+        bench->send();
+      }
+    }
+  }
+}
+
+// Iterations are loss alarms firing with numOutstanding packets outstanding.
+void lossAlarm(uint32_t iters, size_t numOutstanding, bool pto) {
+  folly::Optional<LossBenchConnection> bench;
+  BENCHMARK_SUSPEND {
+    bench.emplace(numOutstanding);
+    // The oldest packet is within the reordering threshold of the largest
+    // acked one, so the alarm finds no loss and re-arms the timer, as it does
+    // when it fires for a packet that was only reordered.
+    auto& conn = *bench->conn;
+    getAckState(conn, PacketNumberSpace::AppData).largestAckedByPeer =
+        conn.lossState.reorderingThreshold;
+  }
+  auto& conn = *bench->conn;
+  for (uint32_t i = 0; i < iters; ++i) {
+    if (pto) {
+      conn.lossState.currentAlarmMethod = LossState::AlarmMethod::PTO;
+      conn.lossState.ptoCount = 0;
+    } else {
+      conn.lossState.currentAlarmMethod =
+          LossState::AlarmMethod::EarlyRetransmitOrReordering;
+      getLossTime(conn, PacketNumberSpace::AppData) = Clock::now();
+    }
+    onLossDetectionAlarm(conn, noopLossVisitor);
+  }
+}
+
+// Iterations are markPacketLoss calls on a stream with numOutstanding
+// buffers waiting for an ack.
+void markLoss(uint32_t iters, size_t numOutstanding) {
+  folly::Optional<LossBenchConnection> bench;
+  BENCHMARK_SUSPEND {
+    bench.emplace(numOutstanding);
+    for (size_t i = 0; i < numOutstanding; ++i) {
+      bench->stream->retransmissionBuffer.emplace_back(
+          bench->data->clone(), i * kPacketSize, false);
+    }
+  }
+  auto& conn = *bench->conn;
+  auto& stream = *bench->stream;
+  for (uint32_t i = 0; i < iters; ++i) {
+    // Spread the losses over the window.
+    auto index = (i * 7919) % numOutstanding;
+    auto& packet = conn.outstandingPackets[index];
+    markPacketLoss(conn, packet.packet, false, index);
+    BENCHMARK_SUSPEND {
+      auto& lost = stream.lossBuffer.back();
+      stream.retransmissionBuffer.insert(
+          std::lower_bound(
+              stream.retransmissionBuffer.begin(),
+              stream.retransmissionBuffer.end(),
+              lost.offset,
+              [](const auto& buffer, const auto& offset) {
+                return buffer.offset < offset;
+              }),
+          std::move(lost));
+      stream.lossBuffer.pop_back();
+    }
+  }
+}
+
+} // namespace
+
+BENCHMARK_NAMED_PARAM(processAck, 1k_NoLoss, 1000, LossPattern::None)
+BENCHMARK_NAMED_PARAM(processAck, 10k_NoLoss, 10000, LossPattern::None)
+BENCHMARK_NAMED_PARAM(processAck, 100k_NoLoss, 100000, LossPattern::None)
+BENCHMARK_NAMED_PARAM(processAck, 1k_Sparse, 1000, LossPattern::Sparse)
+BENCHMARK_NAMED_PARAM(processAck, 10k_Sparse, 10000, LossPattern::Sparse)
+BENCHMARK_NAMED_PARAM(processAck, 100k_Sparse, 100000, LossPattern::Sparse)
+BENCHMARK_NAMED_PARAM(processAck, 1k_Burst, 1000, LossPattern::Burst)
+BENCHMARK_NAMED_PARAM(processAck, 10k_Burst, 10000, LossPattern::Burst)
+BENCHMARK_NAMED_PARAM(processAck, 100k_Burst, 100000, LossPattern::Burst)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(lossAlarm, 1k_Reordering, 1000, false)
+BENCHMARK_NAMED_PARAM(lossAlarm, 10k_Reordering, 10000, false)
+BENCHMARK_NAMED_PARAM(lossAlarm, 100k_Reordering, 100000, false)
+BENCHMARK_NAMED_PARAM(lossAlarm, 1k_PTO, 1000, true)
+BENCHMARK_NAMED_PARAM(lossAlarm, 100k_PTO, 100000, true)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(markLoss, 1k, 1000)
+BENCHMARK_NAMED_PARAM(markLoss, 10k, 10000)
+BENCHMARK_NAMED_PARAM(markLoss, 100k, 100000)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
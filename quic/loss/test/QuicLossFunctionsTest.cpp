@@ -209,7 +209,7 @@ PacketNum QuicLossFunctionsTest::sendPacket(
         });
     if (it != conn.outstandingPackets.end()) {
       if (!it->associatedEvent) {
-        conn.outstandingPacketEvents.emplace(*associatedEvent);
+        conn.outstandingPacketEvents.insert(*associatedEvent);
         conn.outstandingClonedPacketsCount++;
         it->associatedEvent = *associatedEvent;
       }
@@ -780,6 +780,51 @@ TEST_F(QuicLossFunctionsTest, TestTimeReordering) {
   EXPECT_TRUE(conn->lossState.appDataLossTime);
 }
 
+TEST_F(QuicLossFunctionsTest, TestReorderingWithInterleavedSpaces) {
+  std::vector<PacketNum> lostPackets;
+  auto conn = createConn();
+  conn->lossState.srtt = 10s;
+  conn->lossState.lrtt = 10s;
+  PacketNum largestSent = 0;
+  for (int i = 0; i < 6; ++i) {
+    sendPacket(
+        *conn, TimePoint(i * 100ms), false, folly::none, PacketType::Handshake);
+    largestSent = sendPacket(
+        *conn, TimePoint(i * 100ms), false, folly::none, PacketType::OneRtt);
+  }
+  EXPECT_EQ(12, conn->outstandingPackets.size());
+  detectLossPackets<decltype(testingLossMarkFunc(lostPackets))>(
+      *conn,
+      largestSent,
+      testingLossMarkFunc(lostPackets),
+      TimePoint(600ms),
+      PacketNumberSpace::AppData);
+  // Only the AppData packets past the reordering threshold are lost.
+  EXPECT_THAT(lostPackets, ElementsAre(1u, 2u));
+  EXPECT_EQ(10, conn->outstandingPackets.size());
+  EXPECT_TRUE(conn->lossState.appDataLossTime.hasValue());
+
+  // The handshake packets moved over the holes are still all there in order.
+  std::vector<PacketNum> handshakePackets;
+  for (auto iter =
+           getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake);
+       iter != conn->outstandingPackets.end();
+       iter = getNextOutstandingPacket(
+           *conn, PacketNumberSpace::Handshake, iter + 1)) {
+    handshakePackets.push_back(folly::variant_match(
+        iter->packet.header,
+        [](const auto& h) { return h.getPacketSequenceNum(); }));
+  }
+  EXPECT_THAT(handshakePackets, ElementsAre(1u, 2u, 3u, 4u, 5u, 6u));
+  auto firstAppData =
+      getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData);
+  EXPECT_EQ(
+      3,
+      folly::variant_match(firstAppData->packet.header, [](const auto& h) {
+        return h.getPacketSequenceNum();
+      }));
+}
+
 TEST_F(QuicLossFunctionsTest, LossTimePreemptsCryptoTimer) {
   std::vector<PacketNum> lostPackets;
   auto conn = createConn();
@@ -1421,6 +1466,98 @@ TEST_F(QuicLossFunctionsTest, TimeThreshold) {
       PacketNumberSpace::AppData);
 }
 
+TEST_F(QuicLossFunctionsTest, SpuriousLossAdaptsReorderingThreshold) {
+  std::vector<PacketNum> lostPacket;
+  auto conn = createConn();
+  conn->transportSettings.spuriousLossDetectionEnabled = true;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn->congestionController = std::move(mockCongestionController);
+  EXPECT_CALL(*rawCongestionController, onPacketSent(_))
+      .WillRepeatedly(Return());
+  conn->lossState.srtt = 100ms;
+  auto now = Clock::now();
+  PacketNum largestSent = 0;
+  for (int i = 0; i < 10; ++i) {
+    largestSent =
+        sendPacket(*conn, now, false, folly::none, PacketType::OneRtt);
+  }
+  // Packets 1 to 6 are more than 3 packets below the largest acked.
+  auto lossEvent = detectLossPackets<decltype(testingLossMarkFunc(lostPacket))>(
+      *conn,
+      largestSent,
+      testingLossMarkFunc(lostPacket),
+      now,
+      PacketNumberSpace::AppData);
+  ASSERT_TRUE(lossEvent);
+  EXPECT_EQ(6, lossEvent->lostPackets);
+  ASSERT_EQ(6, conn->lossState.lostPackets.size());
+  EXPECT_TRUE(conn->lossState.lostPackets.front().lostByReordering);
+  EXPECT_FALSE(conn->lossState.lostPackets.front().lostByTime);
+
+  // Packet 2 shows up after all, 8 packets late.
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 2;
+  ackFrame.ackBlocks.emplace_back(2, 2);
+  EXPECT_CALL(*rawCongestionController, onSpuriousLoss(now)).Times(1);
+  detectSpuriousLosses(*conn, PacketNumberSpace::AppData, ackFrame, now + 1ms);
+  EXPECT_EQ(8, conn->lossState.reorderingThreshold);
+  EXPECT_EQ(kTimeReorderingThreshold, conn->lossState.timeReorderingThreshold);
+  EXPECT_EQ(1, conn->lossState.spuriousLossCount);
+  EXPECT_EQ(5, conn->lossState.lostPackets.size());
+
+  // Packets of other spaces are left alone, and the ones older than a PTO
+  // are forgotten.
+  detectSpuriousLosses(
+      *conn, PacketNumberSpace::Handshake, ackFrame, now + 10s);
+  EXPECT_EQ(5, conn->lossState.lostPackets.size());
+  detectSpuriousLosses(*conn, PacketNumberSpace::AppData, ackFrame, now + 10s);
+  EXPECT_TRUE(conn->lossState.lostPackets.empty());
+}
+
+TEST_F(QuicLossFunctionsTest, SpuriousLossByTimeRaisesTimeThreshold) {
+  auto conn = createConn();
+  conn->lossState.srtt = 100ms;
+  auto now = Clock::now();
+  trackLostPacket(*conn, 1, PacketNumberSpace::AppData, now, 2, true, false);
+  trackLostPacket(*conn, 2, PacketNumberSpace::AppData, now, 3, true, false);
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 2;
+  ackFrame.ackBlocks.emplace_back(1, 2);
+  detectSpuriousLosses(*conn, PacketNumberSpace::AppData, ackFrame, now);
+  // Once per ack.
+  EXPECT_EQ(
+      kTimeReorderingThreshold + 1, conn->lossState.timeReorderingThreshold);
+  EXPECT_EQ(kReorderingThreshold, conn->lossState.reorderingThreshold);
+  EXPECT_EQ(2, conn->lossState.spuriousLossCount);
+}
+
+TEST_F(QuicLossFunctionsTest, TrackedLostPacketsCapped) {
+  auto conn = createConn();
+  auto now = Clock::now();
+  for (PacketNum packetNum = 0; packetNum < kMaxTrackedLostPackets + 10;
+       packetNum++) {
+    trackLostPacket(
+        *conn, packetNum, PacketNumberSpace::AppData, now, 100, false, true);
+  }
+  EXPECT_EQ(kMaxTrackedLostPackets, conn->lossState.lostPackets.size());
+  EXPECT_EQ(10, conn->lossState.lostPackets.front().packetNum);
+}
+
+TEST_F(QuicLossFunctionsTest, ReorderingThresholdsReset) {
+  auto conn = createConn();
+  conn->lossState.reorderingThreshold = 10;
+  conn->lossState.timeReorderingThreshold = 12;
+  for (uint32_t i = 0; i < kReorderingThresholdResetLossEvents - 1; i++) {
+    onLossEventForReordering(*conn);
+  }
+  EXPECT_EQ(10, conn->lossState.reorderingThreshold);
+  EXPECT_EQ(12, conn->lossState.timeReorderingThreshold);
+  onLossEventForReordering(*conn);
+  EXPECT_EQ(kReorderingThreshold, conn->lossState.reorderingThreshold);
+  EXPECT_EQ(kTimeReorderingThreshold, conn->lossState.timeReorderingThreshold);
+}
+
 TEST_P(QuicLossFunctionsTest, CappedShiftNoCrash) {
   auto conn = createConn();
   conn->lossState.handshakeAlarmCount =
@@ -1462,6 +1599,50 @@ TEST_F(QuicLossFunctionsTest, PersistentCongestion) {
   EXPECT_FALSE(isPersistentCongestion(*conn, currentTime - 100us, currentTime));
 }
 
+TEST_F(QuicLossFunctionsTest, PersistentCongestionLostPeriod) {
+  auto conn = createConn();
+  conn->lossState.srtt = 1s;
+  auto pto = calculatePTO(*conn);
+  auto start = Clock::now();
+  // One packet every PTO, the loss event spans the threshold.
+  CongestionController::LossEvent continuous;
+  for (PacketNum packetNum = 0; packetNum <= kPersistentCongestionThreshold;
+       packetNum++) {
+    continuous.addLostPacket(makeTestingWritePacket(
+        packetNum, 100, 100, false, start + pto * packetNum));
+  }
+  EXPECT_EQ(pto * kPersistentCongestionThreshold, continuous.longestLostPeriod);
+  EXPECT_TRUE(isPersistentCongestion(*conn, continuous));
+
+  // Same sent times, but a packet in the middle was acked.
+  CongestionController::LossEvent acked;
+  for (PacketNum packetNum = 0; packetNum <= kPersistentCongestionThreshold;
+       packetNum++) {
+    if (packetNum == 1) {
+      continue;
+    }
+    acked.addLostPacket(makeTestingWritePacket(
+        packetNum, 100, 100, false, start + pto * packetNum));
+  }
+  EXPECT_EQ(
+      *acked.largestLostSentTime - *acked.smallestLostSentTime,
+      pto * kPersistentCongestionThreshold);
+  EXPECT_FALSE(isPersistentCongestion(*conn, acked));
+
+  // A lost pure ack doesn't break the period.
+  CongestionController::LossEvent pureAck;
+  for (PacketNum packetNum = 0; packetNum <= kPersistentCongestionThreshold;
+       packetNum++) {
+    if (packetNum == 1) {
+      pureAck.skipLostPacket(packetNum);
+      continue;
+    }
+    pureAck.addLostPacket(makeTestingWritePacket(
+        packetNum, 100, 100, false, start + pto * packetNum));
+  }
+  EXPECT_TRUE(isPersistentCongestion(*conn, pureAck));
+}
+
 INSTANTIATE_TEST_CASE_P(
     QuicLossFunctionsTests,
     QuicLossFunctionsTest,
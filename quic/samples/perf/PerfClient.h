@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <glog/logging.h>
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+
+#include <quic/api/QuicSocket.h>
+#include <quic/client/QuicClientTransport.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/samples/perf/PerfCommon.h>
+#include <quic/server/QuicImpairedUDPSocket.h>
+
+#include <thread>
+#include <unordered_map>
+
+namespace quic {
+namespace samples {
+
+struct PerfClientOptions {
+  uint32_t numConnections{1};
+  // Requests kept outstanding on each connection.
+  uint32_t numStreams{1};
+  uint32_t numThreads{1};
+  uint64_t requestSize{kPerfRequestHeaderSize};
+  uint64_t responseSize{1024 * 1024};
+  std::chrono::seconds duration{10};
+  // Connections only do the handshake and then stay idle, to measure how the
+  // server scales with the number of connections.
+  bool idle{false};
+  // Connections started per second, 0 to start them all at once.
+  uint32_t connectRate{0};
+  // Impairs the datagrams of the connections, see QuicImpairedUDPSocket.
+  folly::Optional<QuicImpairedUDPSocket::Options> impairment;
+};
+
+struct PerfClientStats {
+  uint64_t connected{0};
+  uint64_t requests{0};
+  uint64_t bytesSent{0};
+  uint64_t bytesReceived{0};
+  uint64_t errors{0};
+  // Time from writing a request to receiving the end of its response.
+  std::vector<std::chrono::microseconds> latencies;
+
+  void merge(const PerfClientStats& other) {
+    connected += other.connected;
+    requests += other.requests;
+    bytesSent += other.bytesSent;
+    bytesReceived += other.bytesReceived;
+    errors += other.errors;
+    latencies.insert(
+        latencies.end(), other.latencies.begin(), other.latencies.end());
+  }
+};
+
+/**
+ * One connection of the perf client, keeping numStreams requests outstanding
+ * until it's stopped. Must only be used from the thread of its evb.
+ */
+class PerfClientConnection : public quic::QuicSocket::ConnectionCallback,
+                             public quic::QuicSocket::ReadCallback,
+                             public quic::QuicSocket::WriteCallback {
+ public:
+  PerfClientConnection(
+      folly::EventBase* evb,
+      const PerfClientOptions& options,
+      const folly::IOBuf& chunk)
+      : evb_(evb), options_(options), chunk_(chunk) {}
+
+  ~PerfClientConnection() override = default;
+
+  void start(const folly::SocketAddress& addr, TransportSettings settings) {
+    std::unique_ptr<folly::AsyncUDPSocket> sock;
+    if (options_.impairment) {
+      sock = std::make_unique<QuicImpairedUDPSocket>(
+          evb_, *options_.impairment);
+    } else {
+      sock = std::make_unique<folly::AsyncUDPSocket>(evb_);
+    }
+    quicClient_ =
+        std::make_shared<quic::QuicClientTransport>(evb_, std::move(sock));
+    quicClient_->setHostname("perf.com");
+    quicClient_->setCertificateVerifier(test::createTestCertificateVerifier());
+    quicClient_->setCongestionControllerFactory(
+        std::make_shared<DefaultCongestionControllerFactory>());
+    quicClient_->addNewPeerAddress(addr);
+    quicClient_->setTransportSettings(std::move(settings));
+    quicClient_->start(this);
+  }
+
+  void stop() {
+    running_ = false;
+    if (quicClient_) {
+      quicClient_->closeNow(folly::none);
+    }
+  }
+
+  const PerfClientStats& getStats() const {
+    return stats_;
+  }
+
+  void onTransportReady() noexcept override {
+    stats_.connected++;
+    if (options_.idle) {
+      return;
+    }
+    for (uint32_t i = 0; i < options_.numStreams; ++i) {
+      startRequest();
+    }
+  }
+
+  void onNewBidirectionalStream(quic::StreamId id) noexcept override {
+    quicClient_->setReadCallback(id, this);
+  }
+
+  void onNewUnidirectionalStream(quic::StreamId id) noexcept override {
+    quicClient_->setReadCallback(id, this);
+  }
+
+  void onStopSending(
+      quic::StreamId id,
+      quic::ApplicationErrorCode /* error */) noexcept override {
+    VLOG(4) << "PerfClient got StopSending stream id=" << id;
+  }
+
+  void onConnectionEnd() noexcept override {
+    VLOG(4) << "PerfClient connection end";
+  }
+
+  void onConnectionError(
+      std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
+    if (running_) {
+      LOG(ERROR) << "PerfClient error: " << toString(error.first);
+      stats_.errors++;
+    }
+  }
+
+  void readAvailable(quic::StreamId id) noexcept override {
+    auto res = quicClient_->read(id, 0);
+    if (res.hasError()) {
+      LOG(ERROR) << "PerfClient failed read from stream=" << id
+                 << ", error=" << toString(res.error());
+      return;
+    }
+    if (res->first) {
+      stats_.bytesReceived += res->first->computeChainDataLength();
+    }
+    if (!res->second) {
+      return;
+    }
+    auto requestIt = requests_.find(id);
+    if (requestIt != requests_.end()) {
+      stats_.requests++;
+      stats_.latencies.push_back(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              Clock::now() - requestIt->second.startTime));
+      requests_.erase(requestIt);
+    }
+    if (running_) {
+      startRequest();
+    }
+  }
+
+  void readError(
+      quic::StreamId id,
+      std::pair<quic::QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    if (running_) {
+      LOG(ERROR) << "PerfClient failed read from stream=" << id
+                 << ", error=" << toString(error);
+      stats_.errors++;
+    }
+    requests_.erase(id);
+  }
+
+  void onStreamWriteReady(
+      quic::StreamId id,
+      uint64_t /* maxToSend */) noexcept override {
+    sendRequest(id);
+  }
+
+  void onStreamWriteError(
+      quic::StreamId id,
+      std::pair<quic::QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    if (running_) {
+      LOG(ERROR) << "PerfClient write error with stream=" << id
+                 << " error=" << toString(error);
+      stats_.errors++;
+    }
+    requests_.erase(id);
+  }
+
+ private:
+  struct Request {
+    TimePoint startTime;
+    folly::IOBufQueue pending{folly::IOBufQueue::cacheChainLength()};
+  };
+
+  void startRequest() {
+    auto streamId = quicClient_->createBidirectionalStream();
+    if (streamId.hasError()) {
+      // Out of streams, the next MAX_STREAMS will be soon enough.
+      VLOG(4) << "PerfClient can't create stream: "
+              << toString(streamId.error());
+      return;
+    }
+    quicClient_->setReadCallback(*streamId, this);
+    auto& request = requests_[*streamId];
+    request.startTime = Clock::now();
+    request.pending.append(makePerfRequest(
+        chunk_, options_.requestSize, options_.responseSize));
+    sendRequest(*streamId);
+  }
+
+  void sendRequest(quic::StreamId id) {
+    auto requestIt = requests_.find(id);
+    if (requestIt == requests_.end()) {
+      return;
+    }
+    auto& pending = requestIt->second.pending;
+    auto pendingLen = pending.chainLength();
+    if (pendingLen == 0) {
+      return;
+    }
+    auto res = quicClient_->writeChain(id, pending.move(), true, false);
+    if (res.hasError()) {
+      LOG(ERROR) << "PerfClient writeChain error=" << toString(res.error());
+      stats_.errors++;
+      requests_.erase(requestIt);
+    } else if (res.value()) {
+      stats_.bytesSent += pendingLen - res.value()->computeChainDataLength();
+      pending.append(std::move(res.value()));
+      quicClient_->notifyPendingWriteOnStream(id, this);
+    } else {
+      stats_.bytesSent += pendingLen;
+    }
+  }
+
+  folly::EventBase* evb_;
+  const PerfClientOptions& options_;
+  const folly::IOBuf& chunk_;
+  bool running_{true};
+  std::shared_ptr<quic::QuicClientTransport> quicClient_;
+  std::unordered_map<quic::StreamId, Request> requests_;
+  PerfClientStats stats_;
+};
+
+/**
+ * The client side of the perf tool: numConnections connections, spread over
+ * numThreads event base threads, each keeping numStreams requests
+ * outstanding. Reports requests per second, goodput, latency percentiles and
+ * the CPU per GB of the whole process once the duration is over.
+ */
+class PerfClient {
+ public:
+  PerfClient(
+      const std::string& host,
+      uint16_t port,
+      PerfClientOptions options,
+      TransportSettings settings)
+      : host_(host),
+        port_(port),
+        options_(std::move(options)),
+        settings_(std::move(settings)),
+        chunk_(makePerfPayloadChunk()) {}
+
+  void start() {
+    folly::SocketAddress addr(host_.c_str(), port_);
+    std::vector<std::unique_ptr<folly::ScopedEventBaseThread>> threads;
+    for (uint32_t i = 0; i < std::max<uint32_t>(options_.numThreads, 1); ++i) {
+      threads.push_back(std::make_unique<folly::ScopedEventBaseThread>(
+          folly::to<std::string>("PerfClient", i)));
+    }
+    std::vector<std::pair<
+        folly::EventBase*,
+        std::unique_ptr<PerfClientConnection>>>
+        connections;
+    for (uint32_t i = 0; i < options_.numConnections; ++i) {
+      auto evb = threads[i % threads.size()]->getEventBase();
+      connections.emplace_back(
+          evb, std::make_unique<PerfClientConnection>(evb, options_, *chunk_));
+    }
+    LOG(INFO) << "PerfClient connecting to " << addr.describe() << " with "
+              << options_.numConnections << " connections";
+
+    auto startTime = Clock::now();
+    auto startCpuTime = getProcessCpuTime();
+    for (auto& connection : connections) {
+      auto conn = connection.second.get();
+      connection.first->runInEventBaseThreadAndWait(
+          [&] { conn->start(addr, settings_); });
+      if (options_.connectRate > 0) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(1000000 / options_.connectRate));
+      }
+    }
+    std::this_thread::sleep_for(options_.duration);
+
+    PerfClientStats stats;
+    for (auto& connection : connections) {
+      auto conn = connection.second.get();
+      connection.first->runInEventBaseThreadAndWait([&] {
+        conn->stop();
+        stats.merge(conn->getStats());
+      });
+    }
+    auto cpuTime = getProcessCpuTime() - startCpuTime;
+    auto seconds =
+        std::chrono::duration<double>(Clock::now() - startTime).count();
+    auto bytes = stats.bytesSent + stats.bytesReceived;
+    LOG(INFO) << "connected=" << stats.connected
+              << " requests=" << stats.requests << " errors=" << stats.errors
+              << " requests/s=" << stats.requests / seconds
+              << " goodput Mb/s=" << bytes * 8 / seconds / 1e6
+              << " p50 latency us=" << percentile(stats.latencies, 50).count()
+              << " p99 latency us=" << percentile(stats.latencies, 99).count()
+              << " CPU s/GB=" << cpuPerGB(cpuTime, bytes);
+
+    for (auto& connection : connections) {
+      connection.first->runInEventBaseThreadAndWait(
+          [&] { connection.second.reset(); });
+    }
+  }
+
+ private:
+  std::string host_;
+  uint16_t port_;
+  PerfClientOptions options_;
+  TransportSettings settings_;
+  Buf chunk_;
+};
+
+} // namespace samples
+} // namespace quic
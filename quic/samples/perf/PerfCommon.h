@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/portability/SysResource.h>
+#include <folly/portability/Unistd.h>
+
+#include <quic/codec/Types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+namespace quic {
+namespace samples {
+
+/**
+ * The perf protocol: every request is a bidirectional stream on which the
+ * client writes the size of the response it wants as a 64 bit integer,
+ * followed by the rest of the request and a FIN. The server answers once the
+ * request is complete with that many bytes and a FIN.
+ */
+constexpr size_t kPerfRequestHeaderSize = sizeof(uint64_t);
+
+// Size of the chunk payloads are made of.
+constexpr size_t kPerfPayloadChunkSize = 64 * 1024;
+
+/**
+ * Returns size bytes of payload, as clones of chunk so that the payload isn't
+ * copied or even touched before the transport encrypts it.
+ */
+inline Buf makePerfPayload(const folly::IOBuf& chunk, size_t size) {
+  Buf payload;
+  while (size > 0) {
+    auto piece = chunk.cloneOne();
+    piece->trimEnd(piece->length() - std::min(size, piece->length()));
+    size -= piece->length();
+    if (payload) {
+      payload->prependChain(std::move(piece));
+    } else {
+      payload = std::move(piece);
+    }
+  }
+  return payload ? std::move(payload) : folly::IOBuf::create(0);
+}
+
+inline Buf makePerfPayloadChunk() {
+  auto chunk = folly::IOBuf::create(kPerfPayloadChunkSize);
+  memset(chunk->writableData(), 'a', kPerfPayloadChunkSize);
+  chunk->append(kPerfPayloadChunkSize);
+  return chunk;
+}
+
+inline Buf makePerfRequest(
+    const folly::IOBuf& chunk,
+    uint64_t requestSize,
+    uint64_t responseSize) {
+  auto request = folly::IOBuf::create(kPerfRequestHeaderSize);
+  folly::io::Appender appender(request.get(), 0);
+  appender.writeBE<uint64_t>(responseSize);
+  if (requestSize > kPerfRequestHeaderSize) {
+    request->prependChain(
+        makePerfPayload(chunk, requestSize - kPerfRequestHeaderSize));
+  }
+  return request;
+}
+
+/**
+ * CPU time, user and system, used by the process so far.
+ */
+inline std::chrono::microseconds getProcessCpuTime() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return std::chrono::microseconds::zero();
+  }
+  auto toMicros = [](const struct timeval& tv) {
+    return std::chrono::seconds(tv.tv_sec) +
+        std::chrono::microseconds(tv.tv_usec);
+  };
+  return toMicros(usage.ru_utime) + toMicros(usage.ru_stime);
+}
+
+/**
+ * Resident set size of the process in bytes, 0 where /proc isn't available.
+ */
+inline uint64_t getProcessRss() {
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size = 0;
+  uint64_t resident = 0;
+  if (!(statm >> size >> resident)) {
+    return 0;
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * CPU seconds per GB transferred.
+ */
+inline double cpuPerGB(std::chrono::microseconds cpuTime, uint64_t bytes) {
+  if (bytes == 0) {
+    return 0;
+  }
+  return std::chrono::duration<double>(cpuTime).count() / (bytes / 1e9);
+}
+
+/**
+ * Returns the pct percentile of latencies, which it sorts.
+ */
+inline std::chrono::microseconds percentile(
+    std::vector<std::chrono::microseconds>& latencies,
+    double pct) {
+  if (latencies.empty()) {
+    return std::chrono::microseconds::zero();
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto index = static_cast<size_t>(pct / 100 * (latencies.size() - 1));
+  return latencies[index];
+}
+
+} // namespace samples
+} // namespace quic
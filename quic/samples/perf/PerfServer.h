@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <glog/logging.h>
+
+#include <folly/io/IOBufQueue.h>
+
+#include <quic/common/test/TestUtils.h>
+#include <quic/samples/perf/PerfCommon.h>
+#include <quic/server/QuicImpairedUDPSocketFactory.h>
+#include <quic/server/QuicServer.h>
+#include <quic/server/QuicServerTransport.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace quic {
+namespace samples {
+
+// Shared by the handlers of all the workers.
+struct PerfServerStats {
+  std::atomic<int64_t> connections{0};
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> bytesReceived{0};
+  std::atomic<uint64_t> bytesSent{0};
+};
+
+/**
+ * Answers the perf requests of one connection, see PerfCommon.h.
+ */
+class PerfHandler : public quic::QuicSocket::ConnectionCallback,
+                    public quic::QuicSocket::ReadCallback,
+                    public quic::QuicSocket::WriteCallback {
+ public:
+  PerfHandler(
+      folly::EventBase* evbIn,
+      const folly::IOBuf& chunk,
+      PerfServerStats& stats)
+      : evb(evbIn), chunk_(chunk), stats_(stats) {}
+
+  void setQuicSocket(std::shared_ptr<quic::QuicSocket> socket) {
+    sock = socket;
+  }
+
+  void onNewBidirectionalStream(quic::StreamId id) noexcept override {
+    sock->setReadCallback(id, this);
+  }
+
+  void onNewUnidirectionalStream(quic::StreamId id) noexcept override {
+    sock->setReadCallback(id, this);
+  }
+
+  void onStopSending(
+      quic::StreamId id,
+      quic::ApplicationErrorCode error) noexcept override {
+    VLOG(4) << "Got StopSending stream id=" << id << " error=" << error;
+  }
+
+  void onConnectionEnd() noexcept override {
+    VLOG(4) << "Socket closed";
+    onClose();
+  }
+
+  void onConnectionError(
+      std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
+    VLOG(4) << "Socket error=" << toString(error.first);
+    onClose();
+  }
+
+  void readAvailable(quic::StreamId id) noexcept override {
+    auto res = sock->read(id, 0);
+    if (res.hasError()) {
+      LOG(ERROR) << "Got error=" << toString(res.error());
+      return;
+    }
+    auto& request = requests_[id];
+    if (res->first) {
+      auto dataLen = res->first->computeChainDataLength();
+      stats_.bytesReceived += dataLen;
+      // Only the header is needed, the rest of the request is dropped.
+      if (request.header.chainLength() < kPerfRequestHeaderSize) {
+        request.header.append(std::move(res->first));
+      }
+    }
+    if (!res->second) {
+      return;
+    }
+    if (request.header.chainLength() < kPerfRequestHeaderSize) {
+      LOG(ERROR) << "Request too short on stream=" << id;
+      sock->resetStream(id, GenericApplicationErrorCode::UNKNOWN);
+      requests_.erase(id);
+      return;
+    }
+    folly::io::Cursor cursor(request.header.front());
+    auto responseSize = cursor.readBE<uint64_t>();
+    stats_.requests++;
+    request.header.move();
+    request.response.append(makePerfPayload(chunk_, responseSize));
+    respond(id);
+  }
+
+  void readError(
+      quic::StreamId id,
+      std::pair<quic::QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    VLOG(4) << "Got read error on stream=" << id
+            << " error=" << toString(error);
+    requests_.erase(id);
+  }
+
+  void onStreamWriteReady(
+      quic::StreamId id,
+      uint64_t /* maxToSend */) noexcept override {
+    respond(id);
+  }
+
+  void onStreamWriteError(
+      quic::StreamId id,
+      std::pair<quic::QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    VLOG(4) << "write error with stream=" << id
+            << " error=" << toString(error);
+    requests_.erase(id);
+  }
+
+  folly::EventBase* getEventBase() {
+    return evb;
+  }
+
+  folly::EventBase* evb;
+  std::shared_ptr<quic::QuicSocket> sock;
+
+ private:
+  struct Request {
+    folly::IOBufQueue header{folly::IOBufQueue::cacheChainLength()};
+    folly::IOBufQueue response{folly::IOBufQueue::cacheChainLength()};
+  };
+
+  void onClose() {
+    if (!closed_) {
+      closed_ = true;
+      stats_.connections--;
+    }
+  }
+
+  void respond(quic::StreamId id) {
+    auto requestIt = requests_.find(id);
+    if (requestIt == requests_.end()) {
+      return;
+    }
+    auto& response = requestIt->second.response;
+    auto responseLen = response.chainLength();
+    auto data = response.move();
+    if (!data) {
+      data = folly::IOBuf::create(0);
+    }
+    auto res = sock->writeChain(id, std::move(data), true, false, nullptr);
+    if (res.hasError()) {
+      LOG(ERROR) << "write error=" << toString(res.error());
+      requests_.erase(requestIt);
+    } else if (res.value()) {
+      stats_.bytesSent += responseLen - res.value()->computeChainDataLength();
+      response.append(std::move(res.value()));
+      sock->notifyPendingWriteOnStream(id, this);
+    } else {
+      stats_.bytesSent += responseLen;
+      requests_.erase(requestIt);
+    }
+  }
+
+  const folly::IOBuf& chunk_;
+  PerfServerStats& stats_;
+  bool closed_{false};
+  std::unordered_map<quic::StreamId, Request> requests_;
+};
+
+class PerfServerTransportFactory : public quic::QuicServerTransportFactory {
+ public:
+  ~PerfServerTransportFactory() override {
+    while (!handlers_.empty()) {
+      auto& handler = handlers_.back();
+      handler->getEventBase()->runImmediatelyOrRunInEventBaseThreadAndWait(
+          [this] {
+            std::lock_guard<std::mutex> guard(mutex_);
+            handlers_.pop_back();
+          });
+    }
+  }
+
+  PerfServerTransportFactory(
+      const folly::IOBuf& chunk,
+      PerfServerStats& stats)
+      : chunk_(chunk), stats_(stats) {}
+
+  quic::QuicServerTransport::Ptr make(
+      folly::EventBase* evb,
+      std::unique_ptr<folly::AsyncUDPSocket> sock,
+      const folly::SocketAddress&,
+      std::shared_ptr<const fizz::server::FizzServerContext>
+          ctx) noexcept override {
+    CHECK_EQ(evb, sock->getEventBase());
+    auto handler = std::make_unique<PerfHandler>(evb, chunk_, stats_);
+    auto transport =
+        quic::QuicServerTransport::make(evb, std::move(sock), *handler, ctx);
+    handler->setQuicSocket(transport);
+    stats_.connections++;
+    // Every worker makes its transports here.
+    std::lock_guard<std::mutex> guard(mutex_);
+    handlers_.push_back(std::move(handler));
+    return transport;
+  }
+
+ private:
+  const folly::IOBuf& chunk_;
+  PerfServerStats& stats_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<PerfHandler>> handlers_;
+};
+
+/**
+ * The server side of the perf tool. It logs the requests, goodput and CPU
+ * per GB of every report interval, along with the open connections and the
+ * memory and CPU they take, for the --idle clients.
+ */
+class PerfServer {
+ public:
+  PerfServer(
+      const std::string& host,
+      uint16_t port,
+      TransportSettings settings,
+      std::chrono::milliseconds reportInterval)
+      : host_(host),
+        port_(port),
+        reportInterval_(reportInterval),
+        chunk_(makePerfPayloadChunk()),
+        server_(QuicServer::createQuicServer()) {
+    server_->setQuicServerTransportFactory(
+        std::make_unique<PerfServerTransportFactory>(*chunk_, stats_));
+    server_->setFizzContext(quic::test::createServerCtx());
+    server_->setTransportSettings(std::move(settings));
+  }
+
+  // Impairs the datagrams of the server, see QuicImpairedUDPSocket.
+  void setImpairment(const QuicImpairedUDPSocket::Options& options) {
+    server_->setListenerSocketFactory(
+        std::make_unique<QuicImpairedUDPSocketFactory>(options));
+    server_->setQuicUDPSocketFactory(
+        std::make_unique<QuicImpairedUDPSocketFactory>(options));
+  }
+
+  void start() {
+    folly::SocketAddress addr(host_.c_str(), port_);
+    addr.setFromHostPort(host_, port_);
+    server_->start(addr, 0);
+    LOG(INFO) << "Perf server started at: " << addr.describe();
+    lastReportTime_ = Clock::now();
+    lastCpuTime_ = getProcessCpuTime();
+    baseRss_ = getProcessRss();
+    scheduleReport();
+    eventbase_.loopForever();
+  }
+
+ private:
+  void scheduleReport() {
+    eventbase_.runAfterDelay([this] { report(); }, reportInterval_.count());
+  }
+
+  void report() {
+    auto now = Clock::now();
+    auto cpuTime = getProcessCpuTime();
+    auto requests = stats_.requests.exchange(0);
+    auto bytes =
+        stats_.bytesReceived.exchange(0) + stats_.bytesSent.exchange(0);
+    auto seconds = std::chrono::duration<double>(now - lastReportTime_).count();
+    auto connections = std::max<int64_t>(stats_.connections, 0);
+    auto rss = getProcessRss();
+    LOG(INFO) << "requests/s=" << requests / seconds
+              << " goodput Mb/s=" << bytes * 8 / seconds / 1e6
+              << " CPU s/GB=" << cpuPerGB(cpuTime - lastCpuTime_, bytes);
+    if (connections > 0) {
+      auto cpuUs = std::chrono::duration<double, std::micro>(
+                       cpuTime - lastCpuTime_)
+                       .count();
+      LOG(INFO) << "connections=" << connections << " RSS MB=" << rss / 1e6
+                << " bytes/connection="
+                << (rss > baseRss_ ? rss - baseRss_ : 0) / connections
+                << " CPU us/s/connection=" << cpuUs / seconds / connections;
+    }
+    lastReportTime_ = now;
+    lastCpuTime_ = cpuTime;
+    scheduleReport();
+  }
+
+  std::string host_;
+  uint16_t port_;
+  std::chrono::milliseconds reportInterval_;
+  folly::EventBase eventbase_;
+  Buf chunk_;
+  PerfServerStats stats_;
+  TimePoint lastReportTime_;
+  std::chrono::microseconds lastCpuTime_{0};
+  uint64_t baseRss_{0};
+  std::shared_ptr<quic::QuicServer> server_;
+};
+
+} // namespace samples
+} // namespace quic
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <glog/logging.h>
+
+#include <fizz/crypto/Utils.h>
+#include <folly/init/Init.h>
+#include <folly/portability/GFlags.h>
+
+#include <quic/samples/perf/PerfClient.h>
+#include <quic/samples/perf/PerfServer.h>
+
+DEFINE_string(host, "::1", "Perf server hostname/IP");
+DEFINE_int32(port, 6666, "Perf server port");
+DEFINE_string(mode, "server", "Mode to run in: 'client' or 'server'");
+DEFINE_int32(connections, 1, "Number of client connections");
+DEFINE_int32(streams, 1, "Requests outstanding on each client connection");
+DEFINE_int32(threads, 1, "Number of client event base threads");
+DEFINE_int64(request_size, 8, "Bytes of each request, at least 8");
+DEFINE_int64(response_size, 1024 * 1024, "Bytes of each response");
+DEFINE_int32(duration, 10, "Seconds the client runs for");
+DEFINE_int32(report_interval_ms, 1000, "Server report interval");
+DEFINE_bool(idle, false, "Client connections stay idle after the handshake");
+DEFINE_int32(connect_rate, 0, "Client connections per second, 0 for no limit");
+DEFINE_int64(
+    idle_timeout_ms,
+    quic::kDefaultIdleTimeout.count(),
+    "Idle timeout, raise it to keep --idle connections open");
+DEFINE_int32(
+    batching_mode,
+    static_cast<int32_t>(quic::QuicBatchingMode::BATCHING_MODE_NONE),
+    "QuicBatchingMode: 0 none, 1 GSO, 2 sendmmsg");
+DEFINE_int32(
+    max_batch_size,
+    quic::kDefaultQuicMaxBatchSize,
+    "Packets per batch with batching");
+DEFINE_bool(gso, false, "Same as --batching_mode=1");
+DEFINE_bool(pacing, false, "Enable pacing");
+DEFINE_string(
+    cc,
+    "cubic",
+    "Congestion controller: cubic, newreno, copa, bbr, bbr2 or none");
+DEFINE_int64(
+    conn_flow_control,
+    quic::kDefaultConnectionWindowSize,
+    "Connection flow control window");
+DEFINE_int64(
+    stream_flow_control,
+    quic::kDefaultStreamWindowSize,
+    "Stream flow control window");
+
+DEFINE_double(impair_loss, 0, "Probability for a sent datagram to be lost");
+DEFINE_double(
+    impair_reorder,
+    0,
+    "Probability for a sent datagram to be held for --impair_reorder_ms");
+DEFINE_int32(impair_reorder_ms, 0, "Delay of the reordered datagrams");
+DEFINE_double(
+    impair_duplicate,
+    0,
+    "Probability for a sent datagram to be duplicated");
+DEFINE_int32(impair_delay_ms, 0, "Delay added to the sent datagrams");
+DEFINE_int32(impair_jitter_ms, 0, "Uniform jitter added to the delay");
+DEFINE_int64(impair_rate, 0, "Send rate limit in bytes/s, 0 for no limit");
+DEFINE_int64(
+    impair_queue_bytes,
+    64 * 1024,
+    "Bytes queued for the rate limit before datagrams get dropped");
+DEFINE_uint32(impair_seed, 0, "Seed of the impairments");
+
+using namespace quic::samples;
+
+namespace {
+
+folly::Optional<quic::CongestionControlType> congestionControlFromString(
+    const std::string& cc) {
+  if (cc == "cubic") {
+    return quic::CongestionControlType::Cubic;
+  } else if (cc == "newreno") {
+    return quic::CongestionControlType::NewReno;
+  } else if (cc == "copa") {
+    return quic::CongestionControlType::Copa;
+  } else if (cc == "bbr") {
+    return quic::CongestionControlType::BBR;
+  } else if (cc == "bbr2") {
+    return quic::CongestionControlType::BBR2;
+  } else if (cc == "none") {
+    return quic::CongestionControlType::None;
+  }
+  return folly::none;
+}
+
+// The impairments of the sent datagrams, if any are enabled. Since both ends
+// apply them on send, each direction of the path can be impaired on its own.
+folly::Optional<quic::QuicImpairedUDPSocket::Options> impairmentFromFlags() {
+  quic::QuicImpairedUDPSocket::Impairment impairment;
+  impairment.loss = FLAGS_impair_loss;
+  impairment.reorder = FLAGS_impair_reorder;
+  impairment.reorderDelay = std::chrono::milliseconds(FLAGS_impair_reorder_ms);
+  impairment.duplicate = FLAGS_impair_duplicate;
+  impairment.delay = std::chrono::milliseconds(FLAGS_impair_delay_ms);
+  impairment.jitter = std::chrono::milliseconds(FLAGS_impair_jitter_ms);
+  impairment.rate = std::max<int64_t>(FLAGS_impair_rate, 0);
+  impairment.queueBytes = std::max<int64_t>(FLAGS_impair_queue_bytes, 0);
+  if (impairment.loss <= 0 && impairment.reorder <= 0 &&
+      impairment.duplicate <= 0 && impairment.delay.count() <= 0 &&
+      impairment.jitter.count() <= 0 && impairment.rate == 0) {
+    return folly::none;
+  }
+  quic::QuicImpairedUDPSocket::Options options;
+  options.send = impairment;
+  options.seed = FLAGS_impair_seed;
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+#if FOLLY_HAVE_LIBGFLAGS
+  // Enable glog logging to stderr by default.
+  gflags::SetCommandLineOptionWithMode(
+      "logtostderr", "1", gflags::SET_FLAGS_DEFAULT);
+#endif
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+  folly::Init init(&argc, &argv);
+  fizz::CryptoUtils::init();
+
+  auto cc = congestionControlFromString(FLAGS_cc);
+  if (!cc) {
+    LOG(ERROR) << "Unknown congestion controller: " << FLAGS_cc;
+    return -1;
+  }
+  quic::TransportSettings settings;
+  settings.defaultCongestionController = *cc;
+  settings.pacingEnabled = FLAGS_pacing;
+  settings.idleTimeout = std::chrono::milliseconds(FLAGS_idle_timeout_ms);
+  settings.batchingMode = FLAGS_gso
+      ? quic::QuicBatchingMode::BATCHING_MODE_GSO
+      : quic::getQuicBatchingMode(FLAGS_batching_mode);
+  settings.maxBatchSize = FLAGS_max_batch_size;
+  settings.advertisedInitialConnectionWindowSize = FLAGS_conn_flow_control;
+  settings.advertisedInitialBidiLocalStreamWindowSize =
+      FLAGS_stream_flow_control;
+  settings.advertisedInitialBidiRemoteStreamWindowSize =
+      FLAGS_stream_flow_control;
+  settings.advertisedInitialUniStreamWindowSize = FLAGS_stream_flow_control;
+
+  auto impairment = impairmentFromFlags();
+  if (FLAGS_mode == "server") {
+    PerfServer server(
+        FLAGS_host,
+        FLAGS_port,
+        std::move(settings),
+        std::chrono::milliseconds(FLAGS_report_interval_ms));
+    if (impairment) {
+      server.setImpairment(*impairment);
+    }
+    server.start();
+  } else if (FLAGS_mode == "client") {
+    if (FLAGS_host.empty() || FLAGS_port == 0) {
+      LOG(ERROR) << "PerfClient expected --host and --port";
+      return -2;
+    }
+    if (FLAGS_request_size < static_cast<int64_t>(kPerfRequestHeaderSize)) {
+      LOG(ERROR) << "PerfClient expected --request_size of at least "
+                 << kPerfRequestHeaderSize;
+      return -2;
+    }
+    PerfClientOptions options;
+    options.numConnections = FLAGS_connections;
+    options.numStreams = FLAGS_streams;
+    options.numThreads = FLAGS_threads;
+    options.requestSize = FLAGS_request_size;
+    options.responseSize = FLAGS_response_size;
+    options.duration = std::chrono::seconds(FLAGS_duration);
+    options.idle = FLAGS_idle;
+    options.connectRate = FLAGS_connect_rate;
+    options.impairment = impairment;
+    PerfClient client(
+        FLAGS_host, FLAGS_port, std::move(options), std::move(settings));
+    client.start();
+  } else {
+    LOG(ERROR) << "Unknown mode specified: " << FLAGS_mode;
+    return -1;
+  }
+  return 0;
+}
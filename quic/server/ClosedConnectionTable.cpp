@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/ClosedConnectionTable.h>
+
+#include <folly/hash/Hash.h>
+#include <glog/logging.h>
+
+#include <cstring>
+
+namespace quic {
+
+namespace {
+// The close packet is sent again after this many packets at most, so that
+// the record of a closed connection keeps answering a peer that goes on.
+constexpr uint32_t kMaxPacketsPerClose = 1024;
+} // namespace
+
+size_t ClosedConnectionTable::SourceIdentityHash::operator()(
+    const SourceIdentity& sid) const {
+  return folly::hash::hash_combine(
+      ConnectionIdHash()(sid.second), sid.first.hash());
+}
+
+void ClosedConnectionTable::Record::timeoutExpired() noexcept {
+  // May destroy this.
+  table_.remove(*this);
+}
+
+ClosedConnectionTable::ClosedConnectionTable(folly::HHWheelTimer& timer)
+    : timer_(timer) {}
+
+void ClosedConnectionTable::add(
+    const std::vector<ConnectionId>& connIds,
+    const folly::Optional<SourceIdentity>& source,
+    const folly::SocketAddress& peer,
+    const folly::IOBuf* closePacket,
+    std::chrono::milliseconds timeout) {
+  if (connIds.empty() && !source) {
+    return;
+  }
+  auto record = std::make_shared<Record>(*this);
+  record->connIds = connIds;
+  record->source = source;
+  record->peer = peer;
+  if (closePacket) {
+    // A compact copy, rather than sharing the buffers the packet was built
+    // in.
+    auto len = closePacket->computeChainDataLength();
+    record->closePacket = folly::IOBuf::create(len);
+    for (const auto& range : *closePacket) {
+      std::memcpy(
+          record->closePacket->writableTail(), range.data(), range.size());
+      record->closePacket->append(range.size());
+    }
+  }
+  for (const auto& connId : connIds) {
+    auto it = byConnectionId_.find(connId);
+    if (it != byConnectionId_.end() && it->second != record) {
+      // A stale record, it no longer answers for connId.
+      remove(*it->second);
+    }
+    byConnectionId_[connId] = record;
+  }
+  if (source) {
+    auto it = bySource_.find(*source);
+    if (it != bySource_.end()) {
+      remove(*it->second);
+    }
+    bySource_[*source] = record;
+  }
+  numRecords_++;
+  timer_.scheduleTimeout(record.get(), timeout);
+}
+
+bool ClosedConnectionTable::onPacket(
+    const ConnectionId& connId,
+    const folly::Optional<SourceIdentity>& source,
+    folly::AsyncUDPSocket& sock) {
+  auto cit = byConnectionId_.find(connId);
+  if (cit != byConnectionId_.end()) {
+    onRecordPacket(*cit->second, sock);
+    return true;
+  }
+  if (source) {
+    auto sit = bySource_.find(*source);
+    if (sit != bySource_.end()) {
+      onRecordPacket(*sit->second, sock);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClosedConnectionTable::onRecordPacket(
+    Record& record,
+    folly::AsyncUDPSocket& sock) {
+  if (!record.closePacket ||
+      ++record.packetsSinceClose < record.packetsPerClose) {
+    return;
+  }
+  record.packetsSinceClose = 0;
+  record.packetsPerClose =
+      std::min(record.packetsPerClose * 2, kMaxPacketsPerClose);
+  VLOG(10) << "Sending close again to closed connection peer="
+           << record.peer;
+  // Best effort, like the close packet of the transport.
+  if (sock.write(record.peer, record.closePacket) < 0) {
+    VLOG(4) << "Error writing connection close to peer=" << record.peer;
+  }
+}
+
+void ClosedConnectionTable::remove(Record& record) {
+  // Keeps the record alive until it is out of the maps.
+  std::shared_ptr<Record> guard;
+  for (const auto& connId : record.connIds) {
+    auto it = byConnectionId_.find(connId);
+    if (it != byConnectionId_.end() && it->second.get() == &record) {
+      guard = std::move(it->second);
+      byConnectionId_.erase(it);
+    }
+  }
+  if (record.source) {
+    auto it = bySource_.find(*record.source);
+    if (it != bySource_.end() && it->second.get() == &record) {
+      guard = std::move(it->second);
+      bySource_.erase(it);
+    }
+  }
+  record.cancelTimeout();
+  DCHECK_GT(numRecords_, 0u);
+  numRecords_--;
+}
+
+} // namespace quic
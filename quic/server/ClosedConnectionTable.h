@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/codec/QuicConnectionId.h>
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/HHWheelTimer.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace quic {
+
+/**
+ * The connections of a server worker that are draining after they closed,
+ * with TransportSettings::closedConnectionRecordsEnabled. Rather than their
+ * whole transport, each one only keeps a record of its connection ids, its
+ * peer and its encoded CONNECTION_CLOSE packet, until its drain timeout
+ * fires on the worker's timer wheel.
+ *
+ * The packets of the peer are answered with the close packet again, after a
+ * number of them that doubles with every answer, so that a peer which keeps
+ * sending can't make the worker send as much. A record without a close
+ * packet, e.g. the one of a connection closed by its peer, only drops them.
+ */
+class ClosedConnectionTable {
+ public:
+  // Source address and connection id chosen by the peer.
+  using SourceIdentity = std::pair<folly::SocketAddress, ConnectionId>;
+
+  explicit ClosedConnectionTable(folly::HHWheelTimer& timer);
+
+  ClosedConnectionTable(const ClosedConnectionTable&) = delete;
+  ClosedConnectionTable& operator=(const ClosedConnectionTable&) = delete;
+
+  /**
+   * Adds the record of a closed connection for timeout. The packets of the
+   * connection are recognized by its connIds, and by source if it can still
+   * send long header packets the worker routes by address. closePacket is
+   * copied, it can be nullptr.
+   */
+  void add(
+      const std::vector<ConnectionId>& connIds,
+      const folly::Optional<SourceIdentity>& source,
+      const folly::SocketAddress& peer,
+      const folly::IOBuf* closePacket,
+      std::chrono::milliseconds timeout);
+
+  /**
+   * Returns whether the packet with connId, or source when it is set, belongs
+   * to a closed connection, in which case it is consumed, and the close packet
+   * is sent again on sock if it is due.
+   */
+  bool onPacket(
+      const ConnectionId& connId,
+      const folly::Optional<SourceIdentity>& source,
+      folly::AsyncUDPSocket& sock);
+
+  // Number of closed connections.
+  size_t size() const {
+    return numRecords_;
+  }
+
+ private:
+  struct SourceIdentityHash {
+    size_t operator()(const SourceIdentity& sid) const;
+  };
+
+  class Record : public folly::HHWheelTimer::Callback {
+   public:
+    explicit Record(ClosedConnectionTable& table) : table_(table) {}
+
+    void timeoutExpired() noexcept override;
+    // The timer is gone along with the worker, the table goes next.
+    void callbackCanceled() noexcept override {}
+
+    std::vector<ConnectionId> connIds;
+    folly::Optional<SourceIdentity> source;
+    folly::SocketAddress peer;
+    std::unique_ptr<folly::IOBuf> closePacket;
+    // Packets received since the close packet was last sent, and how many
+    // get it sent again.
+    uint32_t packetsSinceClose{0};
+    uint32_t packetsPerClose{1};
+
+   private:
+    ClosedConnectionTable& table_;
+  };
+
+  void remove(Record& record);
+
+  void onRecordPacket(Record& record, folly::AsyncUDPSocket& sock);
+
+  folly::HHWheelTimer& timer_;
+  std::unordered_map<ConnectionId, std::shared_ptr<Record>, ConnectionIdHash>
+      byConnectionId_;
+  std::unordered_map<
+      SourceIdentity,
+      std::shared_ptr<Record>,
+      SourceIdentityHash>
+      bySource_;
+  size_t numRecords_{0};
+};
+
+} // namespace quic
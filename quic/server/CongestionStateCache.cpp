@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/CongestionStateCache.h>
+
+#include <algorithm>
+
+namespace quic {
+
+CongestionStateCache::CongestionStateCache(
+    size_t maxEntries,
+    std::chrono::seconds ttl)
+    : entries_(maxEntries), ttl_(ttl) {}
+
+void CongestionStateCache::update(
+    const folly::IPAddress& peer,
+    const QuicConnectionStateBase& conn,
+    TimePoint now) {
+  // lrtt is only set by an actual rtt sample, unlike the srtt which may have
+  // been seeded from this cache.
+  if (conn.lossState.lrtt == 0us || !conn.congestionController) {
+    return;
+  }
+  CachedCongestionState state;
+  state.srtt = conn.lossState.srtt;
+  state.rttvar = conn.lossState.rttvar;
+  state.minRtt = conn.lossState.mrtt;
+  state.cwndBytes = conn.congestionController->getCongestionWindow();
+  state.updateTime = now;
+  entries_.set(subnetOf(peer), state);
+}
+
+folly::Optional<CachedCongestionState> CongestionStateCache::get(
+    const folly::IPAddress& peer,
+    TimePoint now) {
+  auto subnet = subnetOf(peer);
+  auto it = entries_.find(subnet);
+  if (it == entries_.end()) {
+    return folly::none;
+  }
+  if (now - it->second.updateTime > ttl_) {
+    entries_.erase(subnet);
+    return folly::none;
+  }
+  return it->second;
+}
+
+size_t CongestionStateCache::size() const noexcept {
+  return entries_.size();
+}
+
+folly::IPAddress CongestionStateCache::subnetOf(const folly::IPAddress& peer) {
+  if (peer.isIPv4Mapped()) {
+    return peer.createIPv4().mask(kCongestionStateCacheV4PrefixLen);
+  }
+  return peer.mask(
+      peer.isV4() ? kCongestionStateCacheV4PrefixLen
+                  : kCongestionStateCacheV6PrefixLen);
+}
+
+void seedCongestionState(
+    QuicConnectionStateBase& conn,
+    const CachedCongestionState& state) {
+  conn.lossState.srtt = state.srtt;
+  conn.lossState.rttvar = state.rttvar;
+  auto& settings = conn.transportSettings;
+  settings.initCwndInMss = std::min(
+      std::max(settings.initCwndInMss, state.cwndBytes / conn.udpSendPacketLen),
+      settings.maxCwndInMss);
+}
+
+} // namespace quic
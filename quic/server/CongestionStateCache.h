@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/StateData.h>
+
+#include <folly/IPAddress.h>
+#include <folly/Optional.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <chrono>
+
+namespace quic {
+
+/**
+ * Path state a connection had when it closed.
+ */
+struct CachedCongestionState {
+  std::chrono::microseconds srtt{0us};
+  std::chrono::microseconds rttvar{0us};
+  std::chrono::microseconds minRtt{0us};
+  uint64_t cwndBytes{0};
+  TimePoint updateTime;
+};
+
+/**
+ * Bounded LRU cache of the path state of closed connections, keyed by the
+ * subnet of the peer, much like the TCP metrics cache. New connections to a
+ * known subnet start from its rtt and cwnd instead of kDefaultInitialRtt and
+ * initCwndInMss.
+ *
+ * Not thread safe, each server worker owns one for its connections.
+ */
+class CongestionStateCache {
+ public:
+  CongestionStateCache(size_t maxEntries, std::chrono::seconds ttl);
+
+  CongestionStateCache(const CongestionStateCache&) = delete;
+  CongestionStateCache& operator=(const CongestionStateCache&) = delete;
+
+  /**
+   * Remembers the path state of conn, a connection to peer. Connections that
+   * never got an rtt sample are ignored.
+   */
+  void update(
+      const folly::IPAddress& peer,
+      const QuicConnectionStateBase& conn,
+      TimePoint now);
+
+  /**
+   * The path state of the subnet of peer, unless it is older than the ttl.
+   */
+  folly::Optional<CachedCongestionState> get(
+      const folly::IPAddress& peer,
+      TimePoint now);
+
+  size_t size() const noexcept;
+
+  /**
+   * The key of peer: its /kCongestionStateCacheV4PrefixLen for IPv4 and
+   * /kCongestionStateCacheV6PrefixLen for IPv6.
+   */
+  static folly::IPAddress subnetOf(const folly::IPAddress& peer);
+
+ private:
+  folly::EvictingCacheMap<folly::IPAddress, CachedCongestionState> entries_;
+  std::chrono::seconds ttl_;
+};
+
+/**
+ * Seeds the rtt and initial cwnd of a new connection from the state of an
+ * earlier one. The seeded cwnd is never below initCwndInMss or above
+ * maxCwndInMss, and the congestion controller only picks it up when it is
+ * created afterwards.
+ */
+void seedCongestionState(
+    QuicConnectionStateBase& conn,
+    const CachedCongestionState& state);
+
+} // namespace quic
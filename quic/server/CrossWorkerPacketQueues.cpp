@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/CrossWorkerPacketQueues.h>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+CrossWorkerPacketQueues::CrossWorkerPacketQueues(
+    size_t numWorkers,
+    size_t capacity)
+    : numWorkers_(numWorkers),
+      pending_(std::make_unique<std::atomic<bool>[]>(numWorkers)) {
+  CHECK_GT(capacity, 0);
+  queues_.reserve(numWorkers_ * numWorkers_);
+  for (size_t i = 0; i < numWorkers_ * numWorkers_; i++) {
+    // One slot of a ProducerConsumerQueue is always left empty.
+    queues_.push_back(
+        std::make_unique<folly::ProducerConsumerQueue<ForwardedPacket>>(
+            capacity + 1));
+  }
+  for (size_t i = 0; i < numWorkers_; i++) {
+    pending_[i].store(false);
+  }
+}
+
+bool CrossWorkerPacketQueues::push(
+    size_t src,
+    size_t dst,
+    ForwardedPacket& packet) {
+  auto& queue = *queues_[src * numWorkers_ + dst];
+  if (queue.isFull()) {
+    return false;
+  }
+  return queue.write(std::move(packet));
+}
+
+bool CrossWorkerPacketQueues::markPending(size_t dst) {
+  return !pending_[dst].exchange(true);
+}
+
+} // namespace quic
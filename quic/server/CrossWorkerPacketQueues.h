@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/server/QuicServerPacketRouter.h>
+#include <quic/state/StateData.h>
+
+#include <folly/ProducerConsumerQueue.h>
+#include <folly/SocketAddress.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace quic {
+
+struct ForwardedPacket {
+  folly::SocketAddress client;
+  RoutingData routingData;
+  NetworkData networkData;
+
+  ForwardedPacket(
+      const folly::SocketAddress& clientIn,
+      RoutingData&& routingDataIn,
+      NetworkData&& networkDataIn)
+      : client(clientIn),
+        routingData(std::move(routingDataIn)),
+        networkData(std::move(networkDataIn)) {}
+};
+
+/**
+ * Packets a worker forwards to another worker, one single producer single
+ * consumer ring per pair of workers. The source worker's thread pushes, the
+ * destination worker's thread drains all of its rings in one go, and the
+ * destination only needs to be woken up for the first packet of a burst.
+ */
+class CrossWorkerPacketQueues {
+ public:
+  // Each ring holds up to capacity packets.
+  CrossWorkerPacketQueues(size_t numWorkers, size_t capacity);
+
+  /**
+   * Queues the packet from the worker src to the worker dst. Only called on
+   * src's thread. Returns false, and leaves the packet alone, if the ring is
+   * full.
+   */
+  bool push(size_t src, size_t dst, ForwardedPacket& packet);
+
+  /**
+   * Marks dst as having packets to drain. Returns true if dst was not marked
+   * yet, in which case the caller schedules drain(dst) on dst's thread.
+   */
+  bool markPending(size_t dst);
+
+  /**
+   * Hands all the packets queued for dst to fn, until the rings are empty.
+   * Only called on dst's thread.
+   */
+  template <typename Fn>
+  size_t drain(size_t dst, Fn&& fn) {
+    // Cleared first, so that a packet pushed from now on schedules another
+    // drain.
+    pending_[dst].store(false);
+    size_t drained = 0;
+    for (size_t src = 0; src < numWorkers_; src++) {
+      auto& queue = *queues_[src * numWorkers_ + dst];
+      while (auto packet = queue.frontPtr()) {
+        fn(std::move(*packet));
+        queue.popFront();
+        drained++;
+      }
+    }
+    return drained;
+  }
+
+  size_t getNumWorkers() const {
+    return numWorkers_;
+  }
+
+ private:
+  size_t numWorkers_;
+  // Indexed by src * numWorkers_ + dst.
+  std::vector<std::unique_ptr<folly::ProducerConsumerQueue<ForwardedPacket>>>
+      queues_;
+  std::unique_ptr<std::atomic<bool>[]> pending_;
+};
+
+} // namespace quic
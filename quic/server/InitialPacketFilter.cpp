@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/InitialPacketFilter.h>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace quic {
+
+RateLimiterBucket::RateLimiterBucket(
+    uint32_t rate,
+    uint32_t burst,
+    TimePoint now)
+    : rate_(rate),
+      burst_(std::max<uint32_t>(burst, 1)),
+      tokens_(burst_),
+      lastRefill_(now) {}
+
+bool RateLimiterBucket::consume(TimePoint now) {
+  if (now > lastRefill_) {
+    std::chrono::duration<double> elapsed = now - lastRefill_;
+    tokens_ = std::min(burst_, tokens_ + elapsed.count() * rate_);
+    lastRefill_ = now;
+  }
+  if (tokens_ < 1) {
+    return false;
+  }
+  tokens_ -= 1;
+  return true;
+}
+
+InitialPacketFilter::InitialPacketFilter(
+    uint32_t initialsPerPrefixRate,
+    uint32_t initialsPerPrefixBurst,
+    uint32_t newConnectionsRate,
+    uint32_t newConnectionsBurst,
+    size_t tableSize)
+    : initialsPerPrefixRate_(initialsPerPrefixRate),
+      initialsPerPrefixBurst_(initialsPerPrefixBurst) {
+  if (initialsPerPrefixRate_ > 0) {
+    CHECK_GT(tableSize, 0);
+    prefixEntries_.resize(tableSize);
+  }
+  if (newConnectionsRate > 0) {
+    newConnections_.emplace(
+        newConnectionsRate, newConnectionsBurst, Clock::now());
+  }
+}
+
+bool InitialPacketFilter::allowInitial(
+    const folly::IPAddress& client,
+    TimePoint now) {
+  if (prefixEntries_.empty()) {
+    return true;
+  }
+  auto prefix = prefixOf(client);
+  auto& entry = prefixEntries_[prefix.hash() % prefixEntries_.size()];
+  if (!entry || entry->prefix != prefix) {
+    entry = PrefixEntry{prefix,
+                        RateLimiterBucket(
+                            initialsPerPrefixRate_,
+                            initialsPerPrefixBurst_,
+                            now)};
+  }
+  return entry->bucket.consume(now);
+}
+
+bool InitialPacketFilter::admitNewConnection(TimePoint now) {
+  return !newConnections_ || newConnections_->consume(now);
+}
+
+folly::IPAddress InitialPacketFilter::prefixOf(
+    const folly::IPAddress& client) {
+  if (client.isIPv4Mapped()) {
+    return client.createIPv4().mask(kInitialFilterV4PrefixLen);
+  }
+  return client.mask(
+      client.isV4() ? kInitialFilterV4PrefixLen : kInitialFilterV6PrefixLen);
+}
+
+} // namespace quic
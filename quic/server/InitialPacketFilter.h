@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <folly/IPAddress.h>
+#include <folly/Optional.h>
+
+#include <vector>
+
+namespace quic {
+
+/**
+ * Token bucket of rate tokens per second, holding up to burst tokens. Starts
+ * full.
+ */
+class RateLimiterBucket {
+ public:
+  RateLimiterBucket(uint32_t rate, uint32_t burst, TimePoint now);
+
+  // Takes one token if there is one.
+  bool consume(TimePoint now);
+
+ private:
+  double rate_;
+  double burst_;
+  double tokens_;
+  TimePoint lastRefill_;
+};
+
+/**
+ * Cheap admission control a server worker runs before it spends anything on
+ * an Initial packet.
+ *
+ * Initials are rate limited per source prefix, the /kInitialFilterV4PrefixLen
+ * of IPv4 or /kInitialFilterV6PrefixLen of IPv6 peers, with one token bucket
+ * each. The buckets live in a fixed size direct mapped table: a prefix hashing
+ * to the slot of another one takes it over with a full bucket, so lookups
+ * never allocate and the table stays the same size whatever the number of
+ * sources. Independently, the creation of new connections is limited by one
+ * token bucket for the worker.
+ *
+ * Not thread safe, each worker owns one and only uses it from its event base,
+ * so no locks are involved.
+ */
+class InitialPacketFilter {
+ public:
+  /**
+   * A rate of 0 disables the corresponding limit.
+   */
+  InitialPacketFilter(
+      uint32_t initialsPerPrefixRate,
+      uint32_t initialsPerPrefixBurst,
+      uint32_t newConnectionsRate,
+      uint32_t newConnectionsBurst,
+      size_t tableSize = kInitialFilterTableSize);
+
+  InitialPacketFilter(const InitialPacketFilter&) = delete;
+  InitialPacketFilter& operator=(const InitialPacketFilter&) = delete;
+
+  // Whether an Initial from client is within the rate of its prefix.
+  bool allowInitial(const folly::IPAddress& client, TimePoint now);
+
+  // Whether the worker may create a new connection.
+  bool admitNewConnection(TimePoint now);
+
+  static folly::IPAddress prefixOf(const folly::IPAddress& client);
+
+ private:
+  struct PrefixEntry {
+    folly::IPAddress prefix;
+    RateLimiterBucket bucket;
+  };
+
+  uint32_t initialsPerPrefixRate_;
+  uint32_t initialsPerPrefixBurst_;
+  std::vector<folly::Optional<PrefixEntry>> prefixEntries_;
+  folly::Optional<RateLimiterBucket> newConnections_;
+};
+
+} // namespace quic
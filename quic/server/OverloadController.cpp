@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/OverloadController.h>
+
+#include <quic/QuicConstants.h>
+
+#include <folly/lang/Assume.h>
+#include <glog/logging.h>
+
+namespace quic {
+
+folly::StringPiece overloadLevelToString(OverloadLevel level) {
+  switch (level) {
+    case OverloadLevel::NONE:
+      return "NONE";
+    case OverloadLevel::RETRY:
+      return "RETRY";
+    case OverloadLevel::REJECT_NEW_CONNECTIONS:
+      return "REJECT_NEW_CONNECTIONS";
+    case OverloadLevel::REDUCE_ACK_FREQUENCY:
+      return "REDUCE_ACK_FREQUENCY";
+    case OverloadLevel::CAP_WRITES:
+      return "CAP_WRITES";
+  }
+  folly::assume_unreachable();
+}
+
+OverloadController::OverloadController(std::chrono::microseconds baseLatency)
+    : baseLatency_(baseLatency) {
+  CHECK_GT(baseLatency_.count(), 0);
+}
+
+std::chrono::microseconds OverloadController::threshold(
+    OverloadLevel level) const {
+  return baseLatency_ * static_cast<uint8_t>(level);
+}
+
+OverloadLevel OverloadController::onLoopLatency(
+    std::chrono::microseconds latency) {
+  auto current = static_cast<uint8_t>(level_);
+  if (level_ != OverloadLevel::CAP_WRITES) {
+    auto next = static_cast<OverloadLevel>(current + 1);
+    if (latency >= threshold(next)) {
+      level_ = next;
+      return level_;
+    }
+  }
+  if (level_ != OverloadLevel::NONE &&
+      latency * 100 < threshold(level_) * kOverloadRecoveryPercent) {
+    level_ = static_cast<OverloadLevel>(current - 1);
+  }
+  return level_;
+}
+
+} // namespace quic
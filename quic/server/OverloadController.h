@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+
+#include <chrono>
+#include <cstdint>
+
+namespace quic {
+
+/**
+ * How much load an overloaded server sheds. Each level also does what the
+ * ones below it do.
+ */
+enum class OverloadLevel : uint8_t {
+  NONE = 0,
+  // New connections without an address validation token get a Retry. Needs
+  // retryTokenSecret.
+  RETRY = 1,
+  // New connections are rejected, like with rejectNewConnections.
+  REJECT_NEW_CONNECTIONS = 2,
+  // Peers supporting ACK_FREQUENCY are asked to ack less often. Needs
+  // ackFrequencyEnabled.
+  REDUCE_ACK_FREQUENCY = 3,
+  // Connections write at most overloadWritePacketsLimit packets at a time.
+  CAP_WRITES = 4,
+};
+
+folly::StringPiece overloadLevelToString(OverloadLevel level);
+
+/**
+ * Picks the overload level from the loop latency of the server. Level n is
+ * entered once the latency reaches n times the base latency, one level per
+ * sample so that load is shed gradually, and left one level per sample once
+ * the latency falls below kOverloadRecoveryPercent of the level's threshold,
+ * so that the level doesn't flap around a threshold.
+ */
+class OverloadController {
+ public:
+  explicit OverloadController(std::chrono::microseconds baseLatency);
+
+  // Updates the level with a new sample, and returns it.
+  OverloadLevel onLoopLatency(std::chrono::microseconds latency);
+
+  OverloadLevel getLevel() const {
+    return level_;
+  }
+
+ private:
+  // Latency from which level is entered.
+  std::chrono::microseconds threshold(OverloadLevel level) const;
+
+  std::chrono::microseconds baseLatency_;
+  OverloadLevel level_{OverloadLevel::NONE};
+};
+
+} // namespace quic
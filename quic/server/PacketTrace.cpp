@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/PacketTrace.h>
+
+#include <folly/io/Cursor.h>
+#include <quic/server/state/ConnectionStateSerializer.h>
+
+namespace quic {
+
+namespace {
+
+constexpr uint8_t kPacketTraceFormatVersion = 1;
+constexpr size_t kPacketTraceGrowth = 16 * 1024;
+
+} // namespace
+
+PacketTraceRecorder::PacketTraceRecorder(size_t maxBytes)
+    : maxBytes_(maxBytes) {}
+
+bool PacketTraceRecorder::start(const QuicServerConnectionState& conn) {
+  return startFromState(serializeConnectionState(conn));
+}
+
+bool PacketTraceRecorder::start(
+    const QuicServerConnectionState& conn,
+    const OneRttSecrets& secrets) {
+  return startFromState(serializeConnectionState(conn, secrets));
+}
+
+bool PacketTraceRecorder::startFromState(folly::Optional<Buf> state) {
+  if (!state) {
+    return false;
+  }
+  trace_.connectionState = std::move(*state);
+  trace_.datagrams.clear();
+  recordedBytes_ = 0;
+  startTime_ = Clock::now();
+  recording_ = true;
+  return true;
+}
+
+void PacketTraceRecorder::onNetworkData(
+    const folly::SocketAddress& peer,
+    const NetworkData& networkData) {
+  if (!recording_ || !networkData.data) {
+    return;
+  }
+  auto len = networkData.data->computeChainDataLength();
+  if (recordedBytes_ + len > maxBytes_) {
+    VLOG(4) << "Packet trace full after " << trace_.datagrams.size()
+            << " datagrams";
+    recording_ = false;
+    return;
+  }
+  recordedBytes_ += len;
+  trace_.datagrams.push_back(PacketTrace::Datagram{
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          networkData.receiveTimePoint - startTime_),
+      peer,
+      networkData.ecn,
+      // Shares the received buffer rather than copying it.
+      networkData.data->clone()});
+}
+
+bool PacketTraceRecorder::isRecording() const {
+  return recording_;
+}
+
+size_t PacketTraceRecorder::recordedBytes() const {
+  return recordedBytes_;
+}
+
+folly::Optional<Buf> PacketTraceRecorder::finish() {
+  recording_ = false;
+  if (!trace_.connectionState) {
+    return folly::none;
+  }
+  auto buf = folly::IOBuf::create(kPacketTraceGrowth);
+  folly::io::Appender appender(buf.get(), kPacketTraceGrowth);
+  appender.writeBE<uint8_t>(kPacketTraceFormatVersion);
+  auto state = trace_.connectionState->coalesce();
+  appender.writeBE<uint32_t>(state.size());
+  appender.push(state.data(), state.size());
+  appender.writeBE<uint64_t>(trace_.datagrams.size());
+  for (const auto& datagram : trace_.datagrams) {
+    appender.writeBE<int64_t>(datagram.time.count());
+    auto ip = datagram.peer.getIPAddress().bytes();
+    auto ipLen = datagram.peer.getIPAddress().byteCount();
+    appender.writeBE<uint8_t>(ipLen);
+    appender.push(ip, ipLen);
+    appender.writeBE<uint16_t>(datagram.peer.getPort());
+    appender.writeBE<uint8_t>(static_cast<uint8_t>(datagram.ecn));
+    appender.writeBE<uint32_t>(datagram.data->computeChainDataLength());
+    for (const auto& range : *datagram.data) {
+      appender.push(range.data(), range.size());
+    }
+  }
+  trace_ = PacketTrace();
+  return std::move(buf);
+}
+
+folly::Optional<PacketTrace> decodePacketTrace(const folly::IOBuf& data) {
+  try {
+    folly::io::Cursor cursor(&data);
+    if (cursor.readBE<uint8_t>() != kPacketTraceFormatVersion) {
+      VLOG(4) << "Unknown packet trace format";
+      return folly::none;
+    }
+    PacketTrace trace;
+    cursor.clone(trace.connectionState, cursor.readBE<uint32_t>());
+    auto numDatagrams = cursor.readBE<uint64_t>();
+    for (uint64_t i = 0; i < numDatagrams; i++) {
+      PacketTrace::Datagram datagram;
+      datagram.time = std::chrono::microseconds(cursor.readBE<int64_t>());
+      std::vector<uint8_t> ip(cursor.readBE<uint8_t>());
+      cursor.pull(ip.data(), ip.size());
+      auto port = cursor.readBE<uint16_t>();
+      datagram.peer = folly::SocketAddress(
+          folly::IPAddress::fromBinary(folly::range(ip)), port);
+      auto ecn = cursor.readBE<uint8_t>();
+      if (ecn > static_cast<uint8_t>(ECNCodepoint::CE)) {
+        VLOG(4) << "Invalid ECN codepoint in packet trace";
+        return folly::none;
+      }
+      datagram.ecn = static_cast<ECNCodepoint>(ecn);
+      cursor.clone(datagram.data, cursor.readBE<uint32_t>());
+      trace.datagrams.push_back(std::move(datagram));
+    }
+    return std::move(trace);
+  } catch (const std::exception& ex) {
+    VLOG(4) << "Failed to decode packet trace: " << ex.what();
+    return folly::none;
+  }
+}
+
+bool replayPacketTrace(
+    QuicServerConnectionState& conn,
+    const PacketTrace& trace,
+    TimePoint start) {
+  if (!trace.connectionState ||
+      !restoreConnectionState(conn, *trace.connectionState)) {
+    return false;
+  }
+  for (const auto& datagram : trace.datagrams) {
+    if (conn.state != ServerState::Open) {
+      break;
+    }
+    ServerEvents::ReadData readData;
+    readData.peer = datagram.peer;
+    readData.networkData = NetworkData(
+        datagram.data->clone(), start + datagram.time, datagram.ecn);
+    onServerReadData(conn, readData);
+  }
+  return true;
+}
+
+} // namespace quic
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/server/handshake/ServerHandshake.h>
+#include <quic/server/state/ServerStateMachine.h>
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+
+#include <vector>
+
+namespace quic {
+
+/**
+ * The datagrams a server connection read, with the connection state they
+ * start from.
+ *
+ * The state is the one of serializeConnectionState, which carries the 1-RTT
+ * secrets the datagrams are decrypted with. Since it can only be taken on an
+ * established, quiescent connection, a trace starts in the middle of a
+ * connection, never with its handshake.
+ */
+struct PacketTrace {
+  struct Datagram {
+    // Receive time, relative to the start of the trace.
+    std::chrono::microseconds time;
+    folly::SocketAddress peer;
+    ECNCodepoint ecn;
+    Buf data;
+  };
+
+  Buf connectionState;
+  std::vector<Datagram> datagrams;
+};
+
+/**
+ * Records the datagrams read by a QuicServerTransport, see
+ * QuicServerTransport::startPacketTrace.
+ *
+ * Recording only keeps a reference to the received buffers, the trace is
+ * encoded once it is finished. It stops once the datagrams recorded add up
+ * to maxBytes.
+ */
+class PacketTraceRecorder {
+ public:
+  explicit PacketTraceRecorder(size_t maxBytes = kDefaultPacketTraceMaxBytes);
+
+  /**
+   * Starts the trace from the state of conn. Returns false if the state of
+   * conn cannot be serialized, in which case nothing is recorded.
+   */
+  bool start(const QuicServerConnectionState& conn);
+
+  // Same as above with the given secrets, see serializeConnectionState.
+  bool start(
+      const QuicServerConnectionState& conn,
+      const OneRttSecrets& secrets);
+
+  // Records the datagram of networkData, if recording.
+  void onNetworkData(
+      const folly::SocketAddress& peer,
+      const NetworkData& networkData);
+
+  bool isRecording() const;
+
+  // Bytes of the datagrams recorded so far.
+  size_t recordedBytes() const;
+
+  /**
+   * Stops recording, and returns the encoded trace, or none if it was never
+   * started.
+   */
+  folly::Optional<Buf> finish();
+
+ private:
+  bool startFromState(folly::Optional<Buf> state);
+
+  size_t maxBytes_;
+  bool recording_{false};
+  TimePoint startTime_;
+  size_t recordedBytes_{0};
+  PacketTrace trace_;
+};
+
+/**
+ * Parses a trace encoded by PacketTraceRecorder. Returns none if it is
+ * malformed.
+ */
+folly::Optional<PacketTrace> decodePacketTrace(const folly::IOBuf& data);
+
+/**
+ * Restores the connection state of trace onto conn, a fresh connection
+ * state, and makes it read the datagrams of trace, as if they were received
+ * start plus their time into the trace. Only the read path runs: nothing is
+ * written, and no timer fires, so replaying the same trace always does the
+ * same work.
+ *
+ * Returns false if the connection state cannot be restored. Throws whatever
+ * reading the datagrams throws, on which the transport would have closed
+ * the connection.
+ */
+bool replayPacketTrace(
+    QuicServerConnectionState& conn,
+    const PacketTrace& trace,
+    TimePoint start);
+
+} // namespace quic
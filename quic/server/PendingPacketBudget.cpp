@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/PendingPacketBudget.h>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace quic {
+
+PendingPacketBudget::PendingPacketBudget(uint64_t maxBytes)
+    : maxBytes_(maxBytes) {}
+
+bool PendingPacketBudget::reserve(uint64_t bytes) noexcept {
+  if (bytes > maxBytes_ - std::min(maxBytes_, reservedBytes_)) {
+    return false;
+  }
+  reservedBytes_ += bytes;
+  return true;
+}
+
+void PendingPacketBudget::release(uint64_t bytes) noexcept {
+  DCHECK_GE(reservedBytes_, bytes);
+  reservedBytes_ -= std::min(reservedBytes_, bytes);
+}
+
+} // namespace quic
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace quic {
+
+/**
+ * Bytes of 0-rtt and 1-rtt packets the connections of a server worker may
+ * buffer together while they can't decrypt them yet, with
+ * TransportSettings::pendingPacketBudgetBytes. This bounds what a storm of
+ * connections that never finish their handshake holds on to, on top of
+ * maxPacketsToBuffer per connection.
+ */
+class PendingPacketBudget {
+ public:
+  explicit PendingPacketBudget(uint64_t maxBytes);
+
+  PendingPacketBudget(const PendingPacketBudget&) = delete;
+  PendingPacketBudget& operator=(const PendingPacketBudget&) = delete;
+
+  // Reserves bytes out of the budget, returns false if they don't all fit.
+  bool reserve(uint64_t bytes) noexcept;
+
+  void release(uint64_t bytes) noexcept;
+
+  uint64_t getReservedBytes() const noexcept {
+    return reservedBytes_;
+  }
+
+  uint64_t getMaxBytes() const noexcept {
+    return maxBytes_;
+  }
+
+ private:
+  uint64_t maxBytes_;
+  uint64_t reservedBytes_{0};
+};
+
+} // namespace quic
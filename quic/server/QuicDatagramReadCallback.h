@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+
+namespace quic {
+
+/**
+ * Implemented by socket read callbacks that can take received datagrams in
+ * buffers owned by the socket, instead of having them copied into the one
+ * from getReadBuffer. Sockets that receive into memory of their own, like
+ * the UMEM of an AF_XDP socket, hand those buffers to callbacks that
+ * implement it, and fall back to the ReadCallback interface otherwise.
+ */
+class QuicDatagramReadCallback {
+ public:
+  virtual ~QuicDatagramReadCallback() = default;
+
+  virtual void onDatagram(
+      const folly::SocketAddress& peer,
+      std::unique_ptr<folly::IOBuf> data) noexcept = 0;
+};
+
+} // namespace quic
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicImpairedUDPSocket.h>
+
+#include <folly/Optional.h>
+#include <folly/io/Cursor.h>
+#include <glog/logging.h>
+
+#include <cstring>
+
+namespace quic {
+
+QuicImpairedUDPSocket::QuicImpairedUDPSocket(
+    folly::EventBase* evb,
+    Options options)
+    : folly::AsyncUDPSocket(evb),
+      options_(options),
+      rng_(options.seed),
+      send_(options.send),
+      receive_(options.receive),
+      readProxy_(*this),
+      readBuffer_(options.maxPacketSize),
+      deliveryTimeout_(*this, evb) {}
+
+QuicImpairedUDPSocket::~QuicImpairedUDPSocket() = default;
+
+void QuicImpairedUDPSocket::resumeRead(ReadCallback* cob) {
+  readCallback_ = cob;
+  if (cob->shouldOnlyNotify()) {
+    // The callback reads from the fd itself, which this can't intercept.
+    folly::AsyncUDPSocket::resumeRead(cob);
+  } else {
+    folly::AsyncUDPSocket::resumeRead(&readProxy_);
+  }
+  scheduleDelivery();
+}
+
+void QuicImpairedUDPSocket::pauseRead() {
+  readCallback_ = nullptr;
+  folly::AsyncUDPSocket::pauseRead();
+  scheduleDelivery();
+}
+
+ssize_t QuicImpairedUDPSocket::write(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>& buf) {
+  auto len = buf->computeChainDataLength();
+  // Shares the buffer of the caller rather than copying it.
+  impair(send_, Datagram{address, buf->clone()});
+  deliver();
+  return len;
+}
+
+int QuicImpairedUDPSocket::writem(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>* bufs,
+    size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    impair(send_, Datagram{address, bufs[i]->clone()});
+  }
+  deliver();
+  return static_cast<int>(count);
+}
+
+ssize_t QuicImpairedUDPSocket::writeGSO(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>& buf,
+    int gso) {
+  if (gso <= 0) {
+    return write(address, buf);
+  }
+  auto len = buf->computeChainDataLength();
+  folly::io::Cursor cursor(buf.get());
+  for (size_t left = len; left > 0;) {
+    auto segmentLen = std::min(left, static_cast<size_t>(gso));
+    std::unique_ptr<folly::IOBuf> segment;
+    cursor.clone(segment, segmentLen);
+    impair(send_, Datagram{address, std::move(segment)});
+    left -= segmentLen;
+  }
+  deliver();
+  return len;
+}
+
+bool QuicImpairedUDPSocket::chance(double probability) {
+  if (probability <= 0) {
+    return false;
+  }
+  return std::uniform_real_distribution<double>(0, 1)(rng_) < probability;
+}
+
+bool QuicImpairedUDPSocket::impair(Direction& dir, Datagram dgram) {
+  const auto& impairment = dir.impairment;
+  if (chance(impairment.loss)) {
+    dir.dropped++;
+    return false;
+  }
+  auto now = Clock::now();
+  auto sendTime = now;
+  if (impairment.rate > 0) {
+    auto len = dgram.buf->computeChainDataLength();
+    auto start = std::max(now, dir.nextDeparture);
+    auto queued = std::chrono::duration_cast<std::chrono::microseconds>(
+                      start - now)
+                      .count() *
+        impairment.rate / 1000000;
+    if (queued + len > impairment.queueBytes) {
+      dir.dropped++;
+      return false;
+    }
+    dir.nextDeparture =
+        start + std::chrono::microseconds(len * 1000000 / impairment.rate);
+    sendTime = dir.nextDeparture;
+  }
+  sendTime += impairment.delay;
+  if (impairment.jitter.count() > 0) {
+    sendTime += std::chrono::microseconds(
+        std::uniform_int_distribution<int64_t>(
+            0, impairment.jitter.count())(rng_));
+  }
+  if (chance(impairment.reorder)) {
+    sendTime += impairment.reorderDelay;
+  }
+  if (chance(impairment.duplicate)) {
+    dir.pending.emplace(
+        sendTime, Datagram{dgram.peer, dgram.buf->clone(), dgram.truncated});
+  }
+  // Datagrams due at the same time keep their order.
+  dir.pending.emplace(sendTime, std::move(dgram));
+  return true;
+}
+
+void QuicImpairedUDPSocket::deliver() {
+  auto now = Clock::now();
+  while (!send_.pending.empty() && send_.pending.begin()->first <= now) {
+    auto dgram = std::move(send_.pending.begin()->second);
+    send_.pending.erase(send_.pending.begin());
+    if (folly::AsyncUDPSocket::write(dgram.peer, dgram.buf) < 0) {
+      VLOG(4) << "Impaired socket write failed, errno=" << errno;
+    }
+  }
+  while (readCallback_ && !receive_.pending.empty() &&
+         receive_.pending.begin()->first <= now) {
+    auto dgram = std::move(receive_.pending.begin()->second);
+    receive_.pending.erase(receive_.pending.begin());
+    void* buf = nullptr;
+    size_t len = 0;
+    readCallback_->getReadBuffer(&buf, &len);
+    auto data = dgram.buf->coalesce();
+    if (!buf || len == 0) {
+      continue;
+    }
+    auto copied = std::min(len, data.size());
+    std::memcpy(buf, data.data(), copied);
+    readCallback_->onDataAvailable(
+        dgram.peer, copied, dgram.truncated || copied < data.size());
+  }
+  scheduleDelivery();
+}
+
+void QuicImpairedUDPSocket::scheduleDelivery() {
+  folly::Optional<TimePoint> next;
+  if (!send_.pending.empty()) {
+    next = send_.pending.begin()->first;
+  }
+  if (readCallback_ && !receive_.pending.empty() &&
+      (!next || receive_.pending.begin()->first < *next)) {
+    next = receive_.pending.begin()->first;
+  }
+  if (!next) {
+    deliveryTimeout_.cancelTimeout();
+    return;
+  }
+  // Rounded up to the millisecond granularity of the event base timers.
+  auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+      *next - Clock::now() + std::chrono::milliseconds(1) -
+      std::chrono::microseconds(1));
+  deliveryTimeout_.scheduleTimeout(
+      std::max(delay, std::chrono::milliseconds(0)));
+}
+
+void QuicImpairedUDPSocket::ReadProxy::getReadBuffer(
+    void** buf,
+    size_t* len) noexcept {
+  *buf = sock_.readBuffer_.data();
+  *len = sock_.readBuffer_.size();
+}
+
+void QuicImpairedUDPSocket::ReadProxy::onDataAvailable(
+    const folly::SocketAddress& client,
+    size_t len,
+    bool truncated) noexcept {
+  sock_.impair(
+      sock_.receive_,
+      Datagram{
+          client,
+          folly::IOBuf::copyBuffer(sock_.readBuffer_.data(), len),
+          truncated});
+  sock_.deliver();
+}
+
+void QuicImpairedUDPSocket::ReadProxy::onReadError(
+    const folly::AsyncSocketException& ex) noexcept {
+  if (sock_.readCallback_) {
+    sock_.readCallback_->onReadError(ex);
+  }
+}
+
+void QuicImpairedUDPSocket::ReadProxy::onReadClosed() noexcept {
+  if (sock_.readCallback_) {
+    sock_.readCallback_->onReadClosed();
+  }
+}
+
+} // namespace quic
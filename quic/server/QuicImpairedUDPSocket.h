@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/QuicConstants.h>
+
+#include <map>
+#include <random>
+
+namespace quic {
+
+/**
+ * AsyncUDPSocket that impairs the datagrams going through it, to measure the
+ * whole stack under loss, reordering, duplication, delay and rate limits
+ * without netem.
+ *
+ * Each direction applies its own Impairment to every datagram, in order:
+ * it is dropped with probability loss, then queued behind the previous
+ * datagrams at rate bytes per second, and dropped if that queue holds more
+ * than queueBytes. It is then held for delay plus a uniform jitter, and for
+ * reorderDelay more with probability reorder, so that the datagrams behind
+ * it overtake it. Last, it is duplicated with probability duplicate.
+ *
+ * GSO writes are split into their segments, which are impaired and sent one
+ * by one. Writes are assumed to succeed, the same as a UDP send that gets
+ * dropped in the network.
+ *
+ * Received datagrams are copied and delivered to the read callback through
+ * getReadBuffer and onDataAvailable once due. Since the datagrams have to be
+ * read through this socket for that, receive impairments are not applied to
+ * read callbacks that only want to be notified, such as transports and
+ * workers reading in batches, or with GRO or ECN. Neither are send
+ * impairments applied to what is written to the fd directly, by the kernel
+ * pacer or zero copy writes.
+ */
+class QuicImpairedUDPSocket : public folly::AsyncUDPSocket {
+ public:
+  struct Impairment {
+    // probability for a datagram to be dropped
+    double loss{0};
+    // probability for a datagram to be sent twice
+    double duplicate{0};
+    // probability for a datagram to be held for reorderDelay more
+    double reorder{0};
+    std::chrono::microseconds delay{0};
+    // upper bound of the uniform delay added on top of delay
+    std::chrono::microseconds jitter{0};
+    std::chrono::microseconds reorderDelay{0};
+    // bytes per second, 0 for no rate limit
+    uint64_t rate{0};
+    // bytes that can wait for the rate limit before being dropped
+    uint64_t queueBytes{64 * 1024};
+  };
+
+  struct Options {
+    Impairment send;
+    Impairment receive;
+    uint32_t seed{0};
+    // largest datagram payload that can be received
+    size_t maxPacketSize{1500};
+  };
+
+  QuicImpairedUDPSocket(folly::EventBase* evb, Options options);
+  ~QuicImpairedUDPSocket() override;
+
+  void resumeRead(ReadCallback* cob) override;
+  void pauseRead() override;
+
+  ssize_t write(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf) override;
+  int writem(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>* bufs,
+      size_t count) override;
+  ssize_t writeGSO(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf,
+      int gso) override;
+
+  // datagrams dropped, in each direction
+  uint64_t sendDropped() const {
+    return send_.dropped;
+  }
+
+  uint64_t receiveDropped() const {
+    return receive_.dropped;
+  }
+
+ private:
+  struct Datagram {
+    folly::SocketAddress peer;
+    std::unique_ptr<folly::IOBuf> buf;
+    bool truncated{false};
+  };
+
+  struct Direction {
+    explicit Direction(const Impairment& impairmentIn)
+        : impairment(impairmentIn) {}
+
+    Impairment impairment;
+    // when the rate limit lets the next datagram through
+    TimePoint nextDeparture;
+    uint64_t dropped{0};
+    std::multimap<TimePoint, Datagram> pending;
+  };
+
+  class ReadProxy : public ReadCallback {
+   public:
+    explicit ReadProxy(QuicImpairedUDPSocket& sock) : sock_(sock) {}
+
+    void getReadBuffer(void** buf, size_t* len) noexcept override;
+    void onDataAvailable(
+        const folly::SocketAddress& client,
+        size_t len,
+        bool truncated) noexcept override;
+    void onReadError(const folly::AsyncSocketException& ex) noexcept override;
+    void onReadClosed() noexcept override;
+
+   private:
+    QuicImpairedUDPSocket& sock_;
+  };
+
+  class DeliveryTimeout : public folly::AsyncTimeout {
+   public:
+    DeliveryTimeout(QuicImpairedUDPSocket& sock, folly::EventBase* evb)
+        : folly::AsyncTimeout(evb), sock_(sock) {}
+
+    void timeoutExpired() noexcept override {
+      sock_.deliver();
+    }
+
+   private:
+    QuicImpairedUDPSocket& sock_;
+  };
+
+  bool chance(double probability);
+
+  // queues dgram to go through dir, returns false if it was dropped
+  bool impair(Direction& dir, Datagram dgram);
+
+  // sends and delivers the datagrams which are due
+  void deliver();
+  void scheduleDelivery();
+
+  Options options_;
+  std::mt19937 rng_;
+  Direction send_;
+  Direction receive_;
+  ReadProxy readProxy_;
+  ReadCallback* readCallback_{nullptr};
+  std::vector<uint8_t> readBuffer_;
+  DeliveryTimeout deliveryTimeout_;
+};
+
+} // namespace quic
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/server/QuicImpairedUDPSocket.h>
+#include <quic/server/QuicUDPSocketFactory.h>
+
+#include <mutex>
+
+namespace quic {
+
+/**
+ * Creates sockets impairing their datagrams, see QuicImpairedUDPSocket. It
+ * can be used both as the listener socket factory, when fd is -1, and as the
+ * new connection socket factory, in which case the sockets share the
+ * listening fd. Each socket gets its own seed, derived from the one of the
+ * options.
+ */
+class QuicImpairedUDPSocketFactory : public QuicUDPSocketFactory {
+ public:
+  explicit QuicImpairedUDPSocketFactory(
+      QuicImpairedUDPSocket::Options options = QuicImpairedUDPSocket::Options())
+      : options_(options) {}
+  ~QuicImpairedUDPSocketFactory() override {}
+
+  std::unique_ptr<folly::AsyncUDPSocket> make(folly::EventBase* evb, int fd)
+      override {
+    auto options = options_;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      options.seed += numSockets_++;
+    }
+    auto sock = std::make_unique<QuicImpairedUDPSocket>(evb, options);
+    if (fd != -1) {
+      sock->setFD(
+          folly::NetworkSocket::fromFd(fd),
+          folly::AsyncUDPSocket::FDOwnership::SHARED);
+      sock->dontFragment(true);
+    } else {
+      sock->setReusePort(true);
+    }
+    return sock;
+  }
+
+ private:
+  QuicImpairedUDPSocket::Options options_;
+  std::mutex mutex_;
+  uint32_t numSockets_{0};
+};
+} // namespace quic
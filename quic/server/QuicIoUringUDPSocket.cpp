@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicIoUringUDPSocket.h>
+
+#if MVFST_HAVE_LIBURING
+
+#include <folly/Exception.h>
+#include <folly/io/async/AsyncSocketException.h>
+#include <sys/eventfd.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+namespace {
+// user_data of the multishot recvmsg and of its cancellation. Sends use the
+// address of their PendingSend, which can never collide with these.
+constexpr uint64_t kRecvUserData = 1;
+constexpr uint64_t kCancelUserData = 2;
+constexpr int kBufferGroupId = 0;
+} // namespace
+
+namespace quic {
+
+QuicIoUringUDPSocket::CompletionHandler::CompletionHandler(
+    QuicIoUringUDPSocket& sock,
+    int fd)
+    : folly::EventHandler(sock.evb_, folly::NetworkSocket::fromFd(fd)),
+      sock_(sock) {}
+
+void QuicIoUringUDPSocket::CompletionHandler::handlerReady(
+    uint16_t /*events*/) noexcept {
+  uint64_t count;
+  // Resets the eventfd, the CQ is drained regardless of the value read.
+  auto ret = ::read(sock_.eventFd_, &count, sizeof(count));
+  (void)ret;
+  sock_.processCompletions();
+}
+
+QuicIoUringUDPSocket::QuicIoUringUDPSocket(
+    folly::EventBase* evb,
+    Options options)
+    : folly::AsyncUDPSocket(evb),
+      evb_(evb),
+      options_(options),
+      submitCallback_(*this) {
+  CHECK_EQ(options_.numBuffers & (options_.numBuffers - 1), 0)
+      << "numBuffers must be a power of 2";
+  int ret = io_uring_queue_init(options_.ringEntries, &ring_, 0);
+  if (ret < 0) {
+    folly::throwSystemErrorExplicit(-ret, "io_uring_queue_init() failed");
+  }
+  bufRing_ = io_uring_setup_buf_ring(
+      &ring_, options_.numBuffers, kBufferGroupId, 0, &ret);
+  if (!bufRing_) {
+    io_uring_queue_exit(&ring_);
+    folly::throwSystemErrorExplicit(-ret, "io_uring_setup_buf_ring() failed");
+  }
+  // Every buffer holds the recvmsg header and the peer address in front of
+  // the payload.
+  bufferSize_ = sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage) +
+      options_.maxPacketSize;
+  bufferStorage_.resize(bufferSize_ * options_.numBuffers);
+  for (uint16_t bid = 0; bid < options_.numBuffers; ++bid) {
+    io_uring_buf_ring_add(
+        bufRing_,
+        bufferStorage_.data() + bid * bufferSize_,
+        bufferSize_,
+        bid,
+        io_uring_buf_ring_mask(options_.numBuffers),
+        bid);
+  }
+  io_uring_buf_ring_advance(bufRing_, options_.numBuffers);
+
+  recvMsg_ = {};
+  recvMsg_.msg_namelen = sizeof(sockaddr_storage);
+
+  eventFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  folly::checkUnixError(eventFd_, "eventfd() failed");
+  io_uring_register_eventfd(&ring_, eventFd_);
+  completionHandler_ = std::make_unique<CompletionHandler>(*this, eventFd_);
+  completionHandler_->registerHandler(
+      folly::EventHandler::READ | folly::EventHandler::PERSIST);
+}
+
+QuicIoUringUDPSocket::~QuicIoUringUDPSocket() {
+  pauseRead();
+  submit();
+  // Wait for the kernel to let go of the send buffers and the read buffers
+  // before tearing down the ring.
+  while (inflightSends_ > 0 || recvArmed_) {
+    io_uring_cqe* cqe = nullptr;
+    if (io_uring_wait_cqe(&ring_, &cqe) < 0) {
+      break;
+    }
+    processCompletions();
+  }
+  completionHandler_->unregisterHandler();
+  completionHandler_.reset();
+  io_uring_free_buf_ring(
+      &ring_, bufRing_, options_.numBuffers, kBufferGroupId);
+  io_uring_queue_exit(&ring_);
+  ::close(eventFd_);
+}
+
+io_uring_sqe* QuicIoUringUDPSocket::getSqe() {
+  auto sqe = io_uring_get_sqe(&ring_);
+  if (!sqe) {
+    // The submission queue is full, flush it and try again.
+    io_uring_submit(&ring_);
+    sqe = io_uring_get_sqe(&ring_);
+  }
+  return sqe;
+}
+
+void QuicIoUringUDPSocket::scheduleSubmit() {
+  if (!submitCallback_.isLoopCallbackScheduled()) {
+    evb_->runInLoop(&submitCallback_);
+  }
+}
+
+void QuicIoUringUDPSocket::submit() {
+  submitCallback_.cancelLoopCallback();
+  if (io_uring_sq_ready(&ring_) > 0) {
+    io_uring_submit(&ring_);
+  }
+}
+
+void QuicIoUringUDPSocket::resumeRead(ReadCallback* cob) {
+  CHECK(cob);
+  ringReadCallback_ = cob;
+  if (!recvArmed_) {
+    armRecv();
+    submit();
+  }
+}
+
+void QuicIoUringUDPSocket::pauseRead() {
+  ringReadCallback_ = nullptr;
+  if (!recvArmed_) {
+    return;
+  }
+  auto sqe = getSqe();
+  if (sqe) {
+    io_uring_prep_cancel64(sqe, kRecvUserData, 0);
+    io_uring_sqe_set_data64(sqe, kCancelUserData);
+    scheduleSubmit();
+  }
+}
+
+void QuicIoUringUDPSocket::armRecv() {
+  auto sqe = getSqe();
+  if (!sqe) {
+    return;
+  }
+  io_uring_prep_recvmsg_multishot(sqe, getNetworkSocket().toFd(), &recvMsg_, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufferGroupId;
+  io_uring_sqe_set_data64(sqe, kRecvUserData);
+  recvArmed_ = true;
+}
+
+ssize_t QuicIoUringUDPSocket::write(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>& buf) {
+  return queueSend(address, buf->clone(), 0);
+}
+
+int QuicIoUringUDPSocket::writem(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>* bufs,
+    size_t count) {
+  int written = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (queueSend(address, bufs[i]->clone(), 0) < 0) {
+      break;
+    }
+    written++;
+  }
+  return written > 0 ? written : -1;
+}
+
+ssize_t QuicIoUringUDPSocket::writeGSO(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>& buf,
+    int gso) {
+  return queueSend(address, buf->clone(), gso);
+}
+
+ssize_t QuicIoUringUDPSocket::queueSend(
+    const folly::SocketAddress& address,
+    std::unique_ptr<folly::IOBuf> buf,
+    int gso) {
+  auto sqe = getSqe();
+  if (!sqe) {
+    errno = EAGAIN;
+    return -1;
+  }
+  auto send = std::make_unique<PendingSend>();
+  send->msg = {};
+  send->msg.msg_namelen = address.getAddress(&send->addr);
+  send->msg.msg_name = &send->addr;
+  ssize_t len = 0;
+  for (auto range : *buf) {
+    if (!range.empty()) {
+      send->iov.push_back({const_cast<uint8_t*>(range.data()), range.size()});
+      len += range.size();
+    }
+  }
+  send->msg.msg_iov = send->iov.data();
+  send->msg.msg_iovlen = send->iov.size();
+  if (gso > 0) {
+    send->msg.msg_control = send->control;
+    send->msg.msg_controllen = sizeof(send->control);
+    auto cm = CMSG_FIRSTHDR(&send->msg);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    auto gsoSize = static_cast<uint16_t>(gso);
+    memcpy(CMSG_DATA(cm), &gsoSize, sizeof(gsoSize));
+  }
+  send->buf = std::move(buf);
+  io_uring_prep_sendmsg(sqe, getNetworkSocket().toFd(), &send->msg, 0);
+  io_uring_sqe_set_data(sqe, send.release());
+  inflightSends_++;
+  scheduleSubmit();
+  return len;
+}
+
+void QuicIoUringUDPSocket::processCompletions() {
+  io_uring_cqe* cqe;
+  unsigned head;
+  unsigned count = 0;
+  io_uring_for_each_cqe(&ring_, head, cqe) {
+    count++;
+    auto userData = io_uring_cqe_get_data64(cqe);
+    if (userData == kRecvUserData) {
+      onRecvCompletion(*cqe);
+    } else if (userData != kCancelUserData) {
+      std::unique_ptr<PendingSend> send(
+          reinterpret_cast<PendingSend*>(io_uring_cqe_get_data(cqe)));
+      inflightSends_--;
+      VLOG_IF(4, cqe->res < 0) << "io_uring sendmsg failed err=" << -cqe->res;
+    }
+  }
+  io_uring_cq_advance(&ring_, count);
+  if (!recvArmed_ && ringReadCallback_) {
+    armRecv();
+  }
+  submit();
+}
+
+void QuicIoUringUDPSocket::onRecvCompletion(const io_uring_cqe& cqe) {
+  if (!(cqe.flags & IORING_CQE_F_MORE)) {
+    // The multishot request terminated, it gets re-armed after the batch.
+    recvArmed_ = false;
+  }
+  if (cqe.res == -ENOBUFS || cqe.res == -ECANCELED) {
+    return;
+  }
+  if (cqe.res < 0) {
+    if (ringReadCallback_) {
+      ringReadCallback_->onReadError(folly::AsyncSocketException(
+          folly::AsyncSocketException::INTERNAL_ERROR,
+          "io_uring recvmsg failed",
+          -cqe.res));
+    }
+    return;
+  }
+  if (!(cqe.flags & IORING_CQE_F_BUFFER)) {
+    return;
+  }
+  uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+  auto data = bufferStorage_.data() + bid * bufferSize_;
+  auto out = io_uring_recvmsg_validate(data, cqe.res, &recvMsg_);
+  if (out && ringReadCallback_) {
+    auto payload =
+        static_cast<uint8_t*>(io_uring_recvmsg_payload(out, &recvMsg_));
+    size_t payloadLen =
+        io_uring_recvmsg_payload_length(out, cqe.res, &recvMsg_);
+    folly::SocketAddress peer;
+    peer.setFromSockaddr(
+        static_cast<sockaddr*>(io_uring_recvmsg_name(out)),
+        std::min<socklen_t>(out->namelen, sizeof(sockaddr_storage)));
+
+    void* readBuf = nullptr;
+    size_t readLen = 0;
+    ringReadCallback_->getReadBuffer(&readBuf, &readLen);
+    if (readBuf) {
+      bool truncated = (out->flags & MSG_TRUNC) || payloadLen > readLen;
+      size_t len = std::min(payloadLen, readLen);
+      memcpy(readBuf, payload, len);
+      ringReadCallback_->onDataAvailable(peer, len, truncated);
+    }
+  }
+  recycleBuffer(bid);
+}
+
+void QuicIoUringUDPSocket::recycleBuffer(uint16_t bid) {
+  io_uring_buf_ring_add(
+      bufRing_,
+      bufferStorage_.data() + bid * bufferSize_,
+      bufferSize_,
+      bid,
+      io_uring_buf_ring_mask(options_.numBuffers),
+      0);
+  io_uring_buf_ring_advance(bufRing_, 1);
+}
+
+} // namespace quic
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#if MVFST_HAVE_LIBURING
+
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventHandler.h>
+#include <folly/portability/Sockets.h>
+#include <liburing.h>
+
+namespace quic {
+
+/**
+ * AsyncUDPSocket that does its I/O through an io_uring instead of epoll
+ * readiness plus one syscall per datagram.
+ *
+ * Reads use a single multishot recvmsg backed by a provided buffer ring, so
+ * the kernel keeps delivering datagrams without being re-armed. Writes are
+ * queued as sendmsg submissions and handed to the kernel with one
+ * io_uring_submit at the end of the event loop iteration. Completions are
+ * signalled through an eventfd registered with the EventBase.
+ *
+ * Datagrams are still delivered through the regular ReadCallback interface,
+ * so they are copied from the ring buffer into the callback's read buffer.
+ * Writes are assumed to succeed once queued, the same as a UDP send that
+ * gets dropped in the network.
+ */
+class QuicIoUringUDPSocket : public folly::AsyncUDPSocket {
+ public:
+  struct Options {
+    // number of submission queue entries
+    uint32_t ringEntries{256};
+    // number of buffers in the provided buffer ring, must be a power of 2
+    uint16_t numBuffers{256};
+    // largest datagram payload that can be received
+    size_t maxPacketSize{1500};
+  };
+
+  QuicIoUringUDPSocket(folly::EventBase* evb, Options options);
+  ~QuicIoUringUDPSocket() override;
+
+  void resumeRead(ReadCallback* cob) override;
+  void pauseRead() override;
+  bool isReading() const override {
+    return ringReadCallback_ != nullptr;
+  }
+
+  ssize_t write(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf) override;
+  int writem(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>* bufs,
+      size_t count) override;
+  ssize_t writeGSO(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf,
+      int gso) override;
+
+  // submits all the queued operations to the kernel
+  void submit();
+
+ private:
+  struct PendingSend {
+    sockaddr_storage addr;
+    msghdr msg;
+    std::vector<iovec> iov;
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    std::unique_ptr<folly::IOBuf> buf;
+  };
+
+  class CompletionHandler : public folly::EventHandler {
+   public:
+    CompletionHandler(QuicIoUringUDPSocket& sock, int fd);
+    void handlerReady(uint16_t events) noexcept override;
+
+   private:
+    QuicIoUringUDPSocket& sock_;
+  };
+
+  class SubmitCallback : public folly::EventBase::LoopCallback {
+   public:
+    explicit SubmitCallback(QuicIoUringUDPSocket& sock) : sock_(sock) {}
+    void runLoopCallback() noexcept override {
+      sock_.submit();
+    }
+
+   private:
+    QuicIoUringUDPSocket& sock_;
+  };
+
+  io_uring_sqe* getSqe();
+  void scheduleSubmit();
+  void armRecv();
+  ssize_t queueSend(
+      const folly::SocketAddress& address,
+      std::unique_ptr<folly::IOBuf> buf,
+      int gso);
+  void processCompletions();
+  void onRecvCompletion(const io_uring_cqe& cqe);
+  void recycleBuffer(uint16_t bid);
+
+  folly::EventBase* evb_;
+  Options options_;
+  io_uring ring_;
+  io_uring_buf_ring* bufRing_{nullptr};
+  size_t bufferSize_{0};
+  std::vector<uint8_t> bufferStorage_;
+  msghdr recvMsg_;
+  int eventFd_{-1};
+  std::unique_ptr<CompletionHandler> completionHandler_;
+  SubmitCallback submitCallback_;
+  ReadCallback* ringReadCallback_{nullptr};
+  bool recvArmed_{false};
+  size_t inflightSends_{0};
+};
+
+} // namespace quic
+
+#endif
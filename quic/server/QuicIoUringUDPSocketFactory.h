@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#if MVFST_HAVE_LIBURING
+
+#include <quic/server/QuicIoUringUDPSocket.h>
+#include <quic/server/QuicUDPSocketFactory.h>
+
+namespace quic {
+
+/**
+ * Creates io_uring backed sockets. It can be used both as the listener socket
+ * factory, when fd is -1, and as the new connection socket factory, in which
+ * case the sockets share the listening fd.
+ */
+class QuicIoUringUDPSocketFactory : public QuicUDPSocketFactory {
+ public:
+  explicit QuicIoUringUDPSocketFactory(
+      QuicIoUringUDPSocket::Options options = QuicIoUringUDPSocket::Options())
+      : options_(options) {}
+  ~QuicIoUringUDPSocketFactory() override {}
+
+  std::unique_ptr<folly::AsyncUDPSocket> make(folly::EventBase* evb, int fd)
+      override {
+    auto sock = std::make_unique<QuicIoUringUDPSocket>(evb, options_);
+    if (fd != -1) {
+      sock->setFD(
+          folly::NetworkSocket::fromFd(fd),
+          folly::AsyncUDPSocket::FDOwnership::SHARED);
+      sock->dontFragment(true);
+    } else {
+      sock->setReusePort(true);
+    }
+    return sock;
+  }
+
+ private:
+  QuicIoUringUDPSocket::Options options_;
+};
+} // namespace quic
+
+#endif
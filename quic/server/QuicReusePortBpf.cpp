@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicReusePortBpf.h>
+
+#include <folly/net/NetOps.h>
+#include <folly/portability/Sockets.h>
+#include <quic/QuicConstants.h>
+#include <quic/codec/Types.h>
+
+#ifdef __linux__
+#include <linux/filter.h>
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+#ifndef BPF_MOD
+#define BPF_MOD 0x90
+#endif
+#endif
+
+namespace quic {
+
+#ifdef __linux__
+namespace {
+// Offset of the destination connection id in a short header packet.
+constexpr uint32_t kShortHeaderConnIdOffset = 1;
+// A socket index out of the group, the kernel then falls back to the hash.
+constexpr uint32_t kReusePortFallback = 0xffffffff;
+} // namespace
+#endif
+
+bool attachReusePortBpfSteering(
+    FOLLY_MAYBE_UNUSED folly::NetworkSocket sock,
+    FOLLY_MAYBE_UNUSED uint8_t numWorkers) {
+#ifdef __linux__
+  if (numWorkers == 0) {
+    return false;
+  }
+  // The program runs on the UDP payload. Out of bounds loads would return 0,
+  // i.e. the first socket, so the length is checked first. The worker id are
+  // the bits 18 - 25 of the connection id, see DefaultConnectionIdAlgo.
+  sock_filter code[] = {
+      // A = packet length
+      BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+      // Fallback if there is no room for a connection id.
+      BPF_JUMP(
+          BPF_JMP | BPF_JGE | BPF_K,
+          kShortHeaderConnIdOffset + kDefaultConnectionIdSize,
+          0,
+          11),
+      // Fallback for long headers.
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),
+      BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, kHeaderFormMask, 9, 0),
+      // X = first 6 bits of the worker id
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, kShortHeaderConnIdOffset + 2),
+      BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x3f),
+      BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 2),
+      BPF_STMT(BPF_MISC | BPF_TAX, 0),
+      // A = X | last 2 bits of the worker id
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, kShortHeaderConnIdOffset + 3),
+      BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 6),
+      BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+      // Same as getWorkerToRouteTo in QuicServer.
+      BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, numWorkers),
+      BPF_STMT(BPF_RET | BPF_A, 0),
+      BPF_STMT(BPF_RET | BPF_K, kReusePortFallback),
+  };
+  sock_fprog prog = {sizeof(code) / sizeof(code[0]), code};
+  return folly::netops::setsockopt(
+             sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) ==
+      0;
+#else
+  return false;
+#endif
+}
+
+} // namespace quic
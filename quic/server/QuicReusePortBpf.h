@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/net/NetworkSocket.h>
+
+#include <cstdint>
+
+namespace quic {
+
+/**
+ * Attaches a SO_REUSEPORT socket selection program to the reuse port group of
+ * sock. The program reads the worker id from the destination connection id
+ * of short header packets, laid out by DefaultConnectionIdAlgo, and hands the
+ * packet to the socket at index workerId % numWorkers in the group. That is
+ * the worker QuicServer would forward the packet to, so packets of migrated
+ * or rebound clients don't take the hop to another worker's thread.
+ *
+ * Long header packets and packets too short to hold a connection id are left
+ * to the kernel's 4-tuple hash.
+ *
+ * The sockets in a reuse port group are indexed in the order they were bound
+ * in, so the sockets of the workers must be bound in worker id order. The
+ * program applies to the whole group, it is enough to attach it to one of
+ * its sockets.
+ *
+ * Returns false if the platform or the kernel does not support it.
+ */
+bool attachReusePortBpfSteering(folly::NetworkSocket sock, uint8_t numWorkers);
+
+} // namespace quic
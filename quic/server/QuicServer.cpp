@@ -10,13 +10,18 @@
 
 #include <folly/Random.h>
 #include <folly/io/async/EventBaseManager.h>
+#include <folly/synchronization/Baton.h>
 #include <quic/codec/DefaultConnectionIdAlgo.h>
 #include <quic/codec/QuicHeaderCodec.h>
+#include <quic/server/QuicReusePortBpf.h>
+#include <quic/server/QuicServerCpuAffinity.h>
 #include <quic/server/QuicReusePortUDPSocketFactory.h>
 #include <quic/server/QuicServer.h>
 #include <quic/server/QuicServerTransport.h>
 #include <quic/server/QuicSharedUDPSocketFactory.h>
 
+#include <tuple>
+
 namespace quic {
 
 namespace {
@@ -26,9 +31,17 @@ size_t getWorkerToRouteTo(
     const RoutingData& routingData,
     size_t numWorkers,
     ConnectionIdAlgo* connIdAlgo) {
+  if (routingData.connIdParams) {
+    return routingData.connIdParams->workerId % numWorkers;
+  }
   return connIdAlgo->parseConnectionId(routingData.destinationConnId).workerId %
       numWorkers;
 }
+
+bool isLessLoaded(const WorkerLoad& load, const WorkerLoad& other) {
+  return std::tie(load.loopLatency, load.numConnections) <
+      std::tie(other.loopLatency, other.numConnections);
+}
 } // namespace
 
 QuicServer::QuicServer() {
@@ -60,6 +73,24 @@ void QuicServer::setCongestionControllerFactory(
   ccFactory_ = std::move(ccFactory);
 }
 
+void QuicServer::setHandshakeExecutor(
+    std::shared_ptr<folly::Executor> executor) {
+  CHECK(!initialized_)
+      << " Handshake executor must be set before the server is initialized.";
+  CHECK(executor);
+  handshakeExecutor_ = std::move(executor);
+}
+
+void QuicServer::setEncryptExecutor(
+    std::shared_ptr<folly::Executor> executor,
+    size_t numHelpers) {
+  CHECK(!initialized_)
+      << " Encrypt executor must be set before the server is initialized.";
+  CHECK(executor);
+  encryptExecutor_ = std::move(executor);
+  numEncryptHelpers_ = numHelpers;
+}
+
 void QuicServer::setSupportedVersion(const std::vector<QuicVersion>& versions) {
   supportedVersions_ = versions;
 }
@@ -81,7 +112,7 @@ void QuicServer::start(const folly::SocketAddress& address, size_t maxWorkers) {
   CHECK_LE(maxWorkers, std::numeric_limits<uint8_t>::max());
   size_t numCpu = std::thread::hardware_concurrency();
   if (maxWorkers == 0) {
-    maxWorkers = numCpu;
+    maxWorkers = workerCpus_.empty() ? numCpu : workerCpus_.size();
   }
   auto numWorkers = std::min(numCpu, maxWorkers);
   std::vector<folly::EventBase*> evbs;
@@ -116,6 +147,7 @@ void QuicServer::initialize(
     std::array<uint8_t, kStatelessResetTokenSecretLength> secret;
     folly::Random::secureRandom(secret.data(), secret.size());
     transportSettings_.statelessResetTokenSecret = secret;
+    transportSettingsSnapshot_.reset();
   }
 
   // it the connid algo factory is not set, use default impl
@@ -128,6 +160,14 @@ void QuicServer::initialize(
   if (!ccFactory_) {
     ccFactory_ = std::make_shared<DefaultCongestionControllerFactory>();
   }
+  if (transportSettings_.crossWorkerQueueSize > 0) {
+    packetQueues_ = std::make_unique<CrossWorkerPacketQueues>(
+        evbs.size(), transportSettings_.crossWorkerQueueSize);
+  }
+  if (transportSettings_.overloadLoopLatency.count() > 0) {
+    overloadController_ = std::make_unique<OverloadController>(
+        transportSettings_.overloadLoopLatency);
+  }
   initializeWorkers(evbs, useDefaultTransport);
   bindWorkersToSocket(address, evbs);
 }
@@ -162,7 +202,19 @@ void QuicServer::initializeWorkers(
     }
     worker->setConnectionIdAlgo(connIdAlgoFactory_->make());
     worker->setCongestionControllerFactory(ccFactory_);
+    if (handshakeExecutor_) {
+      worker->setHandshakeExecutor(handshakeExecutor_);
+    }
+    if (encryptExecutor_) {
+      worker->setEncryptExecutor(encryptExecutor_, numEncryptHelpers_);
+    }
     worker->setWorkerId(workers_.size());
+    if (traceLoggerFactory_) {
+      worker->setTraceLogger(traceLoggerFactory_->make(workers_.size()));
+    }
+    if (packetCaptureCallback_) {
+      worker->setPacketCaptureCallback(packetCaptureCallback_);
+    }
     worker->setTransportSettingsOverrideFn(transportSettingsOverrideFn_);
     workers_.push_back(std::move(worker));
     evbToWorkers_.emplace(workerEvb, workers_.back().get());
@@ -173,10 +225,11 @@ std::unique_ptr<QuicServerWorker> QuicServer::newWorkerWithoutSocket() {
   auto worker = std::make_unique<QuicServerWorker>(this->shared_from_this());
   worker->setNewConnectionSocketFactory(socketFactory_.get());
   worker->setSupportedVersions(supportedVersions_);
-  worker->setTransportSettings(transportSettings_);
+  worker->setTransportSettings(getTransportSettingsSnapshot());
   worker->rejectNewConnections(rejectNewConnections_);
   worker->setProcessId(processId_);
   worker->setHostId(hostId_);
+  worker->setTakeoverProtocolVersion(takeoverProtocol_);
   return worker;
 }
 
@@ -197,10 +250,21 @@ void QuicServer::bindWorkersToSocket(
           if (self->shutdown_) {
             return;
           }
-          auto workerSocket = self->listenerSocketFactory_->make(workerEvb, -1);
           auto it = self->evbToWorkers_.find(workerEvb);
           CHECK(it != self->evbToWorkers_.end());
           auto worker = it->second;
+          folly::Optional<int> cpu;
+          if (!self->workerCpus_.empty()) {
+            cpu = self->workerCpus_[idx % self->workerCpus_.size()];
+            // Pinned before the worker allocates anything, so that its
+            // memory is on the cpu's NUMA node. Not running means that this
+            // is the caller's thread.
+            if (!workerEvb->isRunning() || !pinCurrentThreadToCpu(*cpu)) {
+              LOG(WARNING) << "Failed to pin workerId="
+                           << (int)worker->getWorkerId() << " to cpu=" << *cpu;
+            }
+          }
+          auto workerSocket = self->listenerSocketFactory_->make(workerEvb, -1);
           int takeoverOverFd = -1;
           if (self->listeningFDs_.size() > idx) {
             takeoverOverFd = self->listeningFDs_[idx];
@@ -223,7 +287,17 @@ void QuicServer::bindWorkersToSocket(
             worker->setSocket(std::move(workerSocket));
             worker->bind(address);
           }
+          if (cpu &&
+              !setSocketIncomingCpu(
+                  folly::NetworkSocket::fromFd(worker->getFD()), *cpu)) {
+            LOG(WARNING) << "Failed to set the incoming cpu of workerId="
+                         << (int)worker->getWorkerId();
+          }
           if (idx == (numWorkers - 1)) {
+            // The workers are bound one after the other, in worker id order.
+            if (self->reusePortBpfSteering_ && takeoverOverFd < 0) {
+              self->attachReusePortBpfSteering(worker, numWorkers);
+            }
             VLOG(4) << "Initialized all workers in the eventbase";
             self->initialized_ = true;
             self->startCv_.notify_all();
@@ -292,10 +366,9 @@ void QuicServer::routeDataToWorker(
     // barrier.
     VLOG(4) << "Dropping data since quic-server is not initialized";
     if (workerPtr_) {
-      QUIC_STATS(
-          workerPtr_->getTransportInfoCallback(),
-          onPacketDropped,
-          QuicTransportStatsCallback::PacketDropReason::WORKER_NOT_INITIALIZED);
+      workerPtr_->onPacketDropped(
+          QuicTransportStatsCallback::PacketDropReason::WORKER_NOT_INITIALIZED,
+          client);
     }
     return;
   }
@@ -303,10 +376,9 @@ void QuicServer::routeDataToWorker(
   if (shutdown_) {
     VLOG(4) << "Dropping data since quic server is shutdown";
     if (workerPtr_) {
-      QUIC_STATS(
-          workerPtr_->getTransportInfoCallback(),
-          onPacketDropped,
-          QuicTransportStatsCallback::PacketDropReason::SERVER_SHUTDOWN);
+      workerPtr_->onPacketDropped(
+          QuicTransportStatsCallback::PacketDropReason::SERVER_SHUTDOWN,
+          client);
     }
     return;
   }
@@ -325,13 +397,51 @@ void QuicServer::routeDataToWorker(
   auto workerToRunOn =
       getWorkerToRouteTo(routingData, workers_.size(), connIdAlgo_.get());
   auto& worker = workers_[workerToRunOn];
+  if (workerPtr_ && workerPtr_->getTraceLogger() &&
+      worker.get() != workerPtr_.get()) {
+    workerPtr_->getTraceLogger()->onPacketRouted(
+        client, routingData.destinationConnId, workerToRunOn);
+  }
   VLOG_IF(4, !worker->getEventBase()->isInEventBaseThread())
       << " Routing to worker in different EVB, to workerId=" << workerToRunOn;
-  worker->getEventBase()->runInEventBaseThread(
+  if (packetQueues_ && workerPtr_) {
+    ForwardedPacket packet(
+        client, std::move(routingData), std::move(networkData));
+    if (packetQueues_->push(
+            workerPtr_->getWorkerId(), workerToRunOn, packet)) {
+      // Only the first packet of a burst wakes the worker up.
+      if (packetQueues_->markPending(workerToRunOn)) {
+        worker->getEventBase()->runInEventBaseThread(
+            [server = this->shared_from_this(),
+             w = worker.get(),
+             workerToRunOn] {
+              server->drainForwardedPackets(w, workerToRunOn);
+            });
+      }
+      return;
+    }
+    // The ring is full, this one goes on its own.
+    routingData = std::move(packet.routingData);
+    networkData = std::move(packet.networkData);
+  }
+  routeDataToWorkerId(
+      workerToRunOn, client, std::move(routingData), std::move(networkData));
+}
+
+void QuicServer::routeDataToWorkerId(
+    uint8_t workerId,
+    const folly::SocketAddress& client,
+    RoutingData&& routingData,
+    NetworkData&& networkData) {
+  if (shutdown_ || workerId >= workers_.size()) {
+    VLOG(4) << "Dropping data routed to workerId=" << (uint32_t)workerId;
+    return;
+  }
+  workers_[workerId]->getEventBase()->runInEventBaseThread(
       [server = this->shared_from_this(),
        cl = client,
        routingData = std::move(routingData),
-       w = worker.get(),
+       w = workers_[workerId].get(),
        buf = std::move(networkData)]() mutable {
         if (server->shutdown_) {
           return;
@@ -340,6 +450,161 @@ void QuicServer::routeDataToWorker(
       });
 }
 
+folly::Optional<uint8_t> QuicServer::pickWorkerForNewConnection(
+    uint8_t workerId) {
+  if (!initialized_ || workerId >= workers_.size()) {
+    return folly::none;
+  }
+  auto firstHandshake = firstHandshakeWorker();
+  if (firstHandshake < workers_.size()) {
+    // Handshakes only run on the handshake workers, data workers hand them
+    // all their new connections.
+    if (workerId >= firstHandshake &&
+        !transportSettings_.newConnectionLoadBalancing) {
+      return folly::none;
+    }
+    auto picked = pickLeastLoadedWorker(firstHandshake, workers_.size());
+    if (picked == workerId) {
+      return folly::none;
+    }
+    return picked;
+  }
+  const auto hotLoopLatency = transportSettings_.workerHotLoopLatency;
+  if (workers_[workerId]->getLoad().loopLatency < hotLoopLatency) {
+    return folly::none;
+  }
+  uint8_t coolest = workerId;
+  auto coolestLoad = workers_[workerId]->getLoad();
+  for (size_t i = 0; i < workers_.size(); i++) {
+    auto load = workers_[i]->getLoad();
+    if (isLessLoaded(load, coolestLoad)) {
+      coolest = i;
+      coolestLoad = load;
+    }
+  }
+  // No point in moving to a worker that is just as hot.
+  if (coolest == workerId || coolestLoad.loopLatency >= hotLoopLatency) {
+    return folly::none;
+  }
+  return coolest;
+}
+
+folly::Optional<uint8_t> QuicServer::pickDataWorker(uint8_t workerId) {
+  if (!initialized_ || workerId >= workers_.size()) {
+    return folly::none;
+  }
+  auto firstHandshake = firstHandshakeWorker();
+  if (workerId < firstHandshake) {
+    return folly::none;
+  }
+  return pickLeastLoadedWorker(0, firstHandshake);
+}
+
+void QuicServer::setHandshakeRoute(
+    uint8_t workerId,
+    const ConnectionId& connId,
+    folly::Optional<uint8_t> handshakeWorkerId) {
+  if (shutdown_ || workerId >= workers_.size()) {
+    return;
+  }
+  workers_[workerId]->getEventBase()->runInEventBaseThread(
+      [server = this->shared_from_this(),
+       w = workers_[workerId].get(),
+       connId,
+       handshakeWorkerId] {
+        if (server->shutdown_) {
+          return;
+        }
+        w->setHandshakeRoute(connId, handshakeWorkerId);
+      });
+}
+
+void QuicServer::handOffConnection(
+    uint8_t workerId,
+    QuicServerWorker::ConnectionHandOff&& handOff) {
+  if (shutdown_ || workerId >= workers_.size()) {
+    VLOG(4) << "Dropping connection handed to workerId=" << (uint32_t)workerId;
+    return;
+  }
+  workers_[workerId]->getEventBase()->runInEventBaseThread(
+      [server = this->shared_from_this(),
+       w = workers_[workerId].get(),
+       handOff = std::move(handOff)]() mutable {
+        if (server->shutdown_) {
+          return;
+        }
+        w->adoptConnection(std::move(handOff));
+      });
+}
+
+size_t QuicServer::firstHandshakeWorker() const {
+  auto numHandshakeWorkers = transportSettings_.numHandshakeWorkers;
+  // A pool leaving no data worker is the same as no pool.
+  if (numHandshakeWorkers == 0 || numHandshakeWorkers >= workers_.size()) {
+    return workers_.size();
+  }
+  return workers_.size() - numHandshakeWorkers;
+}
+
+uint8_t QuicServer::pickLeastLoadedWorker(size_t begin, size_t end) {
+  DCHECK_LT(begin, end);
+  if (transportSettings_.workerLoadReportInterval.count() == 0) {
+    // Without load reports, they are all equally loaded.
+    return begin +
+        nextPickedWorker_.fetch_add(1, std::memory_order_relaxed) %
+        (end - begin);
+  }
+  uint8_t picked = begin;
+  auto pickedLoad = workers_[begin]->getLoad();
+  for (size_t i = begin + 1; i < end; i++) {
+    auto load = workers_[i]->getLoad();
+    if (isLessLoaded(load, pickedLoad)) {
+      picked = i;
+      pickedLoad = load;
+    }
+  }
+  return picked;
+}
+
+void QuicServer::onWorkerLoadSampled(uint8_t /* workerId */) {
+  if (!initialized_ || !overloadController_) {
+    return;
+  }
+  std::chrono::microseconds totalLatency{0};
+  for (const auto& worker : workers_) {
+    totalLatency += worker->getLoad().loopLatency;
+  }
+  auto latency = totalLatency / workers_.size();
+  std::lock_guard<std::mutex> guard(overloadMutex_);
+  auto level = overloadController_->onLoopLatency(latency);
+  if (level == overloadLevel_.load()) {
+    return;
+  }
+  LOG(WARNING) << "Server overloadLevel=" << overloadLevelToString(level)
+               << " loopLatency=" << latency.count() << "us";
+  overloadLevel_ = level;
+  runOnAllWorkers(
+      [level](auto worker) mutable { worker->setOverloadLevel(level); });
+}
+
+OverloadLevel QuicServer::getOverloadLevel() const {
+  return overloadLevel_.load();
+}
+
+void QuicServer::drainForwardedPackets(
+    QuicServerWorker* worker,
+    size_t workerIdx) {
+  packetQueues_->drain(workerIdx, [&](ForwardedPacket&& packet) {
+    if (shutdown_) {
+      return;
+    }
+    worker->dispatchPacketData(
+        packet.client,
+        std::move(packet.routingData),
+        std::move(packet.networkData));
+  });
+}
+
 void QuicServer::handleWorkerError(LocalErrorCode error) {
   shutdown(error);
 }
@@ -367,16 +632,25 @@ void QuicServer::shutdown(LocalErrorCode error) {
     DCHECK(!worker->getEventBase()->isInEventBaseThread());
   }
   shutdown_ = true;
-  for (auto& worker : workers_) {
-    worker->getEventBase()->runInEventBaseThreadAndWait([&] {
+  // The workers close their connections at the same time, rather than one
+  // worker after the other.
+  std::vector<folly::Baton<>> shutdownDone(workers_.size());
+  for (size_t i = 0; i < workers_.size(); i++) {
+    auto worker = workers_[i].get();
+    auto done = &shutdownDone[i];
+    worker->getEventBase()->runInEventBaseThread([this, worker, error, done] {
       worker->shutdownAllConnections(error);
       workerPtr_.reset();
+      done->post();
     });
+  }
+  for (size_t i = 0; i < workers_.size(); i++) {
+    shutdownDone[i].wait();
     // protecting the erase in map with the mutex since
     // the erase could potentally affect concurrent accesses from other threads
     std::lock_guard<std::mutex> guard(startMutex_);
-    evbToWorkers_.erase(worker->getEventBase());
-    evbToAcceptors_.erase(worker->getEventBase());
+    evbToWorkers_.erase(workers_[i]->getEventBase());
+    evbToAcceptors_.erase(workers_[i]->getEventBase());
   }
   startCv_.notify_all();
 }
@@ -401,6 +675,35 @@ void QuicServer::runOnAllWorkers(std::function<void(QuicServerWorker*)> func) {
   }
 }
 
+void QuicServer::setReusePortBpfSteering(bool enabled) noexcept {
+  CHECK(!initialized_)
+      << "Reuse port steering must be set before initializing Quic server";
+  reusePortBpfSteering_ = enabled;
+}
+
+void QuicServer::setWorkerCpus(std::vector<int> cpus) noexcept {
+  CHECK(!initialized_)
+      << "Worker cpus must be set before initializing Quic server";
+  workerCpus_ = std::move(cpus);
+}
+
+void QuicServer::attachReusePortBpfSteering(
+    QuicServerWorker* worker,
+    size_t numWorkers) {
+  // The program knows the DefaultConnectionIdAlgo layout only.
+  if (!dynamic_cast<DefaultConnectionIdAlgo*>(connIdAlgo_.get())) {
+    LOG(WARNING) << "Reuse port steering needs DefaultConnectionIdAlgo";
+    return;
+  }
+  if (!quic::attachReusePortBpfSteering(
+          folly::NetworkSocket::fromFd(worker->getFD()), numWorkers)) {
+    LOG(WARNING) << "Failed to attach reuse port steering program";
+    return;
+  }
+  VLOG(4) << "Attached reuse port steering program for " << numWorkers
+          << " workers";
+}
+
 void QuicServer::setHostId(uint16_t hostId) noexcept {
   CHECK(!initialized_) << "Host id must be set before initializing Quic server";
   hostId_ = hostId;
@@ -448,12 +751,22 @@ void QuicServer::setFizzContext(
 }
 
 void QuicServer::setTransportSettings(TransportSettings transportSettings) {
-  transportSettings_ = transportSettings;
-  runOnAllWorkers([transportSettings](auto worker) mutable {
-    worker->setTransportSettings(transportSettings);
+  transportSettings_ = std::move(transportSettings);
+  transportSettingsSnapshot_.reset();
+  // All the workers switch to the same snapshot, not to copies of it.
+  runOnAllWorkers([snapshot = getTransportSettingsSnapshot()](auto worker) {
+    worker->setTransportSettings(snapshot);
   });
 }
 
+const TransportSettingsSnapshot& QuicServer::getTransportSettingsSnapshot() {
+  if (!transportSettingsSnapshot_) {
+    transportSettingsSnapshot_ =
+        std::make_shared<const TransportSettings>(transportSettings_);
+  }
+  return transportSettingsSnapshot_;
+}
+
 void QuicServer::rejectNewConnections(bool reject) {
   rejectNewConnections_ = reject;
   runOnAllWorkers(
@@ -462,6 +775,7 @@ void QuicServer::rejectNewConnections(bool reject) {
 
 void QuicServer::enablePartialReliability(bool enabled) {
   transportSettings_.partialReliabilityEnabled = enabled;
+  transportSettingsSnapshot_.reset();
   runOnAllWorkers([enabled](auto worker) mutable {
     worker->enablePartialReliability(enabled);
   });
@@ -479,10 +793,12 @@ void QuicServer::setEventBaseObserver(
   });
 };
 
-void QuicServer::startPacketForwarding(const folly::SocketAddress& destAddr) {
+void QuicServer::startPacketForwarding(
+    const folly::SocketAddress& destAddr,
+    TakeoverProtocolVersion peerVersion) {
   if (initialized_) {
-    runOnAllWorkers([destAddr](auto worker) mutable {
-      worker->startPacketForwarding(destAddr);
+    runOnAllWorkers([destAddr, peerVersion](auto worker) mutable {
+      worker->startPacketForwarding(destAddr, peerVersion);
     });
   }
 }
@@ -515,6 +831,63 @@ void QuicServer::setTransportStatsCallbackFactory(
   transportStatsFactory_ = std::move(statsFactory);
 }
 
+void QuicServer::setWorkerTraceLoggerFactory(
+    std::unique_ptr<WorkerTraceLoggerFactory> traceLoggerFactory) {
+  CHECK(traceLoggerFactory);
+  traceLoggerFactory_ = std::move(traceLoggerFactory);
+}
+
+void QuicServer::setPacketCaptureCallback(
+    std::shared_ptr<PacketCaptureCallback> callback) {
+  packetCaptureCallback_ = std::move(callback);
+}
+
+QuicTransportStats QuicServer::getTransportStats() {
+  QuicTransportStats stats;
+  if (!initialized_ || shutdown_) {
+    return stats;
+  }
+  for (auto& worker : workers_) {
+    DCHECK(!worker->getEventBase()->isInEventBaseThread());
+    worker->getEventBase()->runInEventBaseThreadAndWait([&] {
+      auto accumulator = dynamic_cast<QuicTransportStatsAccumulator*>(
+          worker->getTransportInfoCallback());
+      if (accumulator) {
+        stats.merge(accumulator->getStats());
+      }
+    });
+  }
+  return stats;
+}
+
+std::vector<QuicServerWorker::TransportLoopTime>
+QuicServer::getTopTransportsByLoopTime(size_t n) {
+  std::vector<QuicServerWorker::TransportLoopTime> loopTimes;
+  if (!initialized_ || shutdown_) {
+    return loopTimes;
+  }
+  for (auto& worker : workers_) {
+    DCHECK(!worker->getEventBase()->isInEventBaseThread());
+    worker->getEventBase()->runInEventBaseThreadAndWait([&] {
+      auto workerLoopTimes = worker->getTopTransportsByLoopTime(n);
+      loopTimes.insert(
+          loopTimes.end(),
+          std::make_move_iterator(workerLoopTimes.begin()),
+          std::make_move_iterator(workerLoopTimes.end()));
+    });
+  }
+  std::sort(
+      loopTimes.begin(),
+      loopTimes.end(),
+      [](const auto& lhs, const auto& rhs) {
+        return lhs.loopTime > rhs.loopTime;
+      });
+  if (loopTimes.size() > n) {
+    loopTimes.resize(n);
+  }
+  return loopTimes;
+}
+
 void QuicServer::setConnectionIdAlgoFactory(
     std::unique_ptr<ConnectionIdAlgoFactory> connIdAlgoFactory) {
   CHECK(!initialized_);
@@ -576,6 +949,13 @@ TakeoverProtocolVersion QuicServer::getTakeoverProtocolVersion() const
   return workers_[0]->getTakeoverProtocolVersion();
 }
 
+void QuicServer::setTakeoverProtocolVersion(
+    TakeoverProtocolVersion version) noexcept {
+  CHECK(!initialized_)
+      << "Takeover protocol must be set before initializing Quic server";
+  takeoverProtocol_ = version;
+}
+
 int QuicServer::getTakeoverHandlerSocketFD() const {
   CHECK(takeoverHandlerInitialized_) << "TakeoverHanders are not initialized. ";
   return workers_[0]->getTakeoverHandlerSocketFD();
@@ -18,9 +18,13 @@
 #include <quic/QuicConstants.h>
 #include <quic/codec/ConnectionIdAlgo.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/server/CrossWorkerPacketQueues.h>
+#include <quic/server/OverloadController.h>
 #include <quic/server/QuicServerTransportFactory.h>
 #include <quic/server/QuicServerWorker.h>
 #include <quic/server/QuicUDPSocketFactory.h>
+#include <quic/server/WorkerTraceLogger.h>
+#include <quic/state/QuicTransportStatsAccumulator.h>
 #include <quic/state/QuicTransportStatsCallback.h>
 
 namespace quic {
@@ -97,6 +101,29 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   void setCongestionControllerFactory(
       std::shared_ptr<CongestionControllerFactory> ccFactory);
 
+  /**
+   * Set an executor, e.g. a folly::CPUThreadPoolExecutor, to run the
+   * certificate signature, the key exchange and the key derivation of the
+   * handshakes on. Without it they run inline on the worker's event base, so
+   * a flood of Initials delays the established connections of the worker.
+   * This must be set before the server is started.
+   */
+  void setHandshakeExecutor(std::shared_ptr<folly::Executor> executor);
+
+  /**
+   * Set an executor with numHelpers threads or more, e.g. a
+   * folly::CPUThreadPoolExecutor, to encrypt the 1-RTT packets of each
+   * connection on, numHelpers threads at a time, next to its worker thread.
+   * Packet building, ACK processing and all the other connection state stay
+   * on the worker. Only batches of packets are spread, so this needs
+   * TransportSettings::maxEncryptBatchSize to be larger than 1, and it pays
+   * off for connections that send more than a core can encrypt.
+   * This must be set before the server is started.
+   */
+  void setEncryptExecutor(
+      std::shared_ptr<folly::Executor> executor,
+      size_t numHelpers);
+
   /**
    * Set list of supported QUICVersion for this server. These versions will be
    * used during the 'Version-Negotiation' phase with the client.
@@ -137,6 +164,27 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
    */
   void setHostId(uint16_t hostId) noexcept;
 
+  /**
+   * Steer the packets to the worker that owns their connection in the
+   * kernel, with a SO_REUSEPORT program attached to the listening sockets,
+   * instead of forwarding them between the workers. Only works with the
+   * default listener socket factory and ConnectionIdAlgo, and when the
+   * sockets are not taken over.
+   * Note that this function must be called before initialize(..)
+   */
+  void setReusePortBpfSteering(bool enabled) noexcept;
+
+  /**
+   * Run worker i on cpus[i % cpus.size()]: its thread is pinned to the cpu
+   * before it allocates its buffers, so they are on the cpu's NUMA node, and
+   * its listening socket gets SO_INCOMING_CPU. With the NIC RX queues mapped
+   * to the same cpus, packets can stay on one cpu from the queue to the
+   * transport. start() then runs one worker per cpu unless maxWorkers is
+   * set.
+   * Note that this function must be called before initialize(..)
+   */
+  void setWorkerCpus(std::vector<int> cpus) noexcept;
+
   /**
    * Set initial flow control settings for the connection.
    */
@@ -191,6 +239,52 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
       RoutingData&& routingData,
       NetworkData&& networkData);
 
+  /**
+   * Dispatches the data on the worker with the given id, e.g. the Initial of
+   * a new connection a more loaded worker hands over.
+   */
+  void routeDataToWorkerId(
+      uint8_t workerId,
+      const folly::SocketAddress& client,
+      RoutingData&& routingData,
+      NetworkData&& networkData);
+
+  /**
+   * With newConnectionLoadBalancing, whether a new connection arriving at
+   * the given worker goes to the least loaded worker instead: only if the
+   * given worker's loop latency is at least workerHotLoopLatency, and the
+   * least loaded one's is not.
+   */
+  folly::Optional<uint8_t> pickWorkerForNewConnection(uint8_t workerId);
+
+  /**
+   * With numHandshakeWorkers, the least loaded data worker, if the given
+   * worker is a handshake worker.
+   */
+  folly::Optional<uint8_t> pickDataWorker(uint8_t workerId);
+
+  void setHandshakeRoute(
+      uint8_t workerId,
+      const ConnectionId& connId,
+      folly::Optional<uint8_t> handshakeWorkerId);
+
+  void handOffConnection(
+      uint8_t workerId,
+      QuicServerWorker::ConnectionHandOff&& handOff);
+
+  /**
+   * With overloadLoopLatency, updates the overload level of the server from
+   * the average loop latency of its workers, and hands it to all of them
+   * when it changes.
+   */
+  void onWorkerLoadSampled(uint8_t workerId);
+
+  /**
+   * Current overload level of the server, NONE unless overloadLoopLatency is
+   * set. Thread safe.
+   */
+  OverloadLevel getOverloadLevel() const;
+
   /**
    * Set an EventBaseObserver for server and all its workers. This only works
    * after server is already start()-ed, no-op otherwise.
@@ -225,9 +319,13 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   /*
    * Setup and initialize the listening socket of the old server from the given
    * address to forward misrouted packets belonging to that server during
-   * the takeover process
+   * the takeover process. peerVersion is the old server's
+   * getTakeoverProtocolVersion(), the packets are forwarded with the newest
+   * version both servers speak.
    */
-  void startPacketForwarding(const folly::SocketAddress& destAddr);
+  void startPacketForwarding(
+      const folly::SocketAddress& destAddr,
+      TakeoverProtocolVersion peerVersion = TakeoverProtocolVersion::V0);
 
   /*
    * Disable packet forwarding, even if the packet has no connection id
@@ -265,6 +363,13 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
 
   TakeoverProtocolVersion getTakeoverProtocolVersion() const noexcept;
 
+  /**
+   * Set the newest takeover protocol version this server speaks, V0 by
+   * default. It accepts packets forwarded with any version up to it.
+   * Note that this function must be called before initialize(..)
+   */
+  void setTakeoverProtocolVersion(TakeoverProtocolVersion version) noexcept;
+
   /**
    * Factory to create per worker callback for various transport stats (such as
    * packet received, dropped etc). QuicServer calls 'make' during the
@@ -280,6 +385,42 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   void setTransportStatsCallbackFactory(
       std::unique_ptr<QuicTransportStatsCallbackFactory> statsFactory);
 
+  /**
+   * Set the factory making the trace logger of each worker, see
+   * WorkerTraceLogger. Must be set before the workers are initialized.
+   */
+  void setWorkerTraceLoggerFactory(
+      std::unique_ptr<WorkerTraceLoggerFactory> traceLoggerFactory);
+
+  /**
+   * Set where the connections hand their packet capture over, see
+   * TransportSettings::packetCaptureDatagrams. Shared by the workers, so it
+   * is called from all of their threads. Must be set before the workers are
+   * initialized.
+   */
+  void setPacketCaptureCallback(
+      std::shared_ptr<PacketCaptureCallback> callback);
+
+  /**
+   * Returns the stats of all the workers merged, when their callbacks are
+   * QuicTransportStatsAccumulator, e.g. made by
+   * QuicTransportStatsAccumulatorFactory. Workers with another callback are
+   * skipped.
+   * Each worker's stats are read on its event base, so this is meant to be
+   * called periodically by an exporter, and never from a worker thread.
+   */
+  QuicTransportStats getTransportStats();
+
+  /**
+   * The n connections that spent the most time in their worker's event base,
+   * across all workers, most first. Needs
+   * TransportSettings::loopTimeSampleRate, all the times are zero otherwise.
+   * Meant for debugging, e.g. to find the client slowing its worker down, and
+   * never to be called from a worker thread.
+   */
+  std::vector<QuicServerWorker::TransportLoopTime> getTopTransportsByLoopTime(
+      size_t n);
+
   /**
    * Factory to create per worker ConnectionIdAlgo instance
    * NOTE: it must be set before calling 'start()' or 'initialize(..)'
@@ -304,20 +445,40 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
 
   std::unique_ptr<QuicServerWorker> newWorkerWithoutSocket();
 
+  // The snapshot of transportSettings_ the workers share.
+  const TransportSettingsSnapshot& getTransportSettingsSnapshot();
+
   void runOnAllWorkers(std::function<void(QuicServerWorker*)> func);
 
   void bindWorkersToSocket(
       const folly::SocketAddress& address,
       const std::vector<folly::EventBase*>& evbs);
 
+  void attachReusePortBpfSteering(QuicServerWorker* worker, size_t numWorkers);
+
+  // Runs on the worker's thread.
+  void drainForwardedPackets(QuicServerWorker* worker, size_t workerIdx);
+
+  // Id of the first handshake worker, the number of workers if there are
+  // none. The workers before it are the data workers.
+  size_t firstHandshakeWorker() const;
+
+  // Least loaded of the workers in [begin, end), or the next one in turn
+  // without load reports.
+  uint8_t pickLeastLoadedWorker(size_t begin, size_t end);
+
   std::vector<QuicVersion> supportedVersions_{
       {QuicVersion::MVFST, QuicVersion::MVFST_OLD, QuicVersion::QUIC_DRAFT}};
   std::atomic<bool> shutdown_{true};
   std::shared_ptr<const fizz::server::FizzServerContext> ctx_;
   TransportSettings transportSettings_;
+  // Made from transportSettings_ when first needed, reset when it changes.
+  TransportSettingsSnapshot transportSettingsSnapshot_;
   std::mutex startMutex_;
   std::atomic<bool> initialized_{false};
   std::atomic<bool> workersInitialized_{false};
+  // See pickLeastLoadedWorker.
+  std::atomic<size_t> nextPickedWorker_{0};
   std::condition_variable startCv_;
   std::atomic<bool> takeoverHandlerInitialized_{false};
   std::vector<std::unique_ptr<folly::ScopedEventBaseThread>> workerEvbs_;
@@ -337,6 +498,11 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   std::unique_ptr<QuicUDPSocketFactory> socketFactory_;
   // factory used to create specific instance of Congestion control algorithm
   std::shared_ptr<CongestionControllerFactory> ccFactory_;
+  // executor the expensive part of the handshakes runs on, if any
+  std::shared_ptr<folly::Executor> handshakeExecutor_;
+  // executor the 1-RTT packets are encrypted on, if any
+  std::shared_ptr<folly::Executor> encryptExecutor_;
+  size_t numEncryptHelpers_{0};
 
   std::shared_ptr<folly::EventBaseObserver> evbObserver_;
   folly::Optional<std::string> healthCheckToken_;
@@ -344,13 +510,25 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   std::vector<int> listeningFDs_;
   ProcessId processId_{ProcessId::ZERO};
   uint16_t hostId_{0};
+  bool reusePortBpfSteering_{false};
+  std::vector<int> workerCpus_;
+  TakeoverProtocolVersion takeoverProtocol_{TakeoverProtocolVersion::V0};
   bool rejectNewConnections_{false};
+  // Only set with overloadLoopLatency, and used under overloadMutex_.
+  std::unique_ptr<OverloadController> overloadController_;
+  std::mutex overloadMutex_;
+  std::atomic<OverloadLevel> overloadLevel_{OverloadLevel::NONE};
   // factory to create per worker QuicTransportStatsCallback
   std::unique_ptr<QuicTransportStatsCallbackFactory> transportStatsFactory_;
+  // factory to create per worker WorkerTraceLogger
+  std::unique_ptr<WorkerTraceLoggerFactory> traceLoggerFactory_;
+  std::shared_ptr<PacketCaptureCallback> packetCaptureCallback_;
   // factory to create per worker ConnectionIdAlgo
   std::unique_ptr<ConnectionIdAlgoFactory> connIdAlgoFactory_;
   // Impl of ConnectionIdAlgo to make routing decisions from ConnectionId
   std::unique_ptr<ConnectionIdAlgo> connIdAlgo_;
+  // Packets forwarded between the workers, if crossWorkerQueueSize is set
+  std::unique_ptr<CrossWorkerPacketQueues> packetQueues_;
   // Used to override certain transport parameters, given the client address
   TransportSettingsOverrideFn transportSettingsOverrideFn_;
 };
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicServerCpuAffinity.h>
+
+#include <folly/net/NetOps.h>
+#include <folly/portability/Sockets.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+#endif
+
+namespace quic {
+
+bool pinCurrentThreadToCpu(FOLLY_MAYBE_UNUSED int cpu) {
+#ifdef __linux__
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+  return false;
+#endif
+}
+
+bool setSocketIncomingCpu(
+    FOLLY_MAYBE_UNUSED folly::NetworkSocket sock,
+    FOLLY_MAYBE_UNUSED int cpu) {
+#ifdef __linux__
+  return folly::netops::setsockopt(
+             sock, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) == 0;
+#else
+  return false;
+#endif
+}
+
+} // namespace quic
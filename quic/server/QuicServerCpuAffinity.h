@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/net/NetworkSocket.h>
+
+namespace quic {
+
+/**
+ * Pins the calling thread to the given cpu. Memory the thread touches first
+ * from then on is allocated on the cpu's NUMA node by the kernel's default
+ * policy, so buffers a worker allocates once pinned stay local to it.
+ *
+ * Returns false if the platform does not support it or the cpu is not
+ * allowed for the process.
+ */
+bool pinCurrentThreadToCpu(int cpu);
+
+/**
+ * Sets SO_INCOMING_CPU on sock. The kernel favors sockets whose cpu is the
+ * one that processed the packet, i.e. the cpu the NIC RX queue interrupts,
+ * when it scores candidate sockets. Within a reuse port group the socket is
+ * still picked by the group's hash or program. Returns false if the platform
+ * does not support it.
+ */
+bool setSocketIncomingCpu(folly::NetworkSocket sock, int cpu);
+
+} // namespace quic
@@ -6,13 +6,18 @@
  *
  */
 
+#include <folly/IPAddress.h>
 #include <folly/io/Cursor.h>
 #include <folly/system/ThreadId.h>
 #include <quic/QuicConstants.h>
+#include <quic/codec/QuicInteger.h>
 
 #include <quic/server/QuicServerPacketRouter.h>
 #include <quic/server/QuicServerWorker.h>
 
+#include <algorithm>
+#include <array>
+
 namespace quic {
 
 /* Set max for the allocation of buffer to extract TakeoverProtocol related
@@ -20,15 +25,50 @@ namespace quic {
  */
 constexpr uint16_t kMaxBufSizeForTakeoverEncapsulation = 64;
 
+/* V1 datagram header: version (4B) and the receive time the packets are
+ * relative to (8B). Each packet then has: the length of the client's IP
+ * address (1B), the address, the port (2B), the receive time offset and the
+ * packet length as QUIC integers, and the packet.
+ */
+constexpr size_t kTakeoverBatchHeaderSize =
+    sizeof(TakeoverProtocolVersion) + sizeof(uint64_t);
+constexpr size_t kMaxTakeoverBatchEntryHeaderSize =
+    sizeof(uint8_t) + 16 + sizeof(uint16_t) + 2 * sizeof(uint64_t);
+
+namespace {
+
+/**
+ * Returns the len bytes at offset of buf, as a buffer of its own that keeps
+ * buf alive. Not being shared, it can be decrypted in place.
+ */
+Buf makePacketView(const Buf& buf, size_t offset, size_t len) {
+  auto keepAlive = buf->cloneOne().release();
+  return folly::IOBuf::takeOwnership(
+      const_cast<uint8_t*>(buf->data()) + offset,
+      len,
+      [](void* /* buf */, void* userData) {
+        delete static_cast<folly::IOBuf*>(userData);
+      },
+      keepAlive);
+}
+
+void appendQuicInteger(folly::IOBuf& buf, uint64_t value) {
+  auto written = encodeQuicInteger(value, buf.writableTail());
+  CHECK(written.hasValue());
+  buf.append(*written);
+}
+
+} // namespace
+
 TakeoverHandlerCallback::TakeoverHandlerCallback(
     QuicServerWorker* worker,
     TakeoverPacketHandler& takeoverPktHandler,
-    const TransportSettings& transportSettings,
+    TransportSettingsSnapshot transportSettings,
     const folly::SocketAddress& address,
     std::unique_ptr<folly::AsyncUDPSocket> socket)
     : worker_(worker),
       takeoverPktHandler_(takeoverPktHandler),
-      transportSettings_(transportSettings),
+      transportSettings_(std::move(transportSettings)),
       address_(address),
       socket_(std::move(socket)) {}
 
@@ -57,12 +97,15 @@ int TakeoverHandlerCallback::getSocketFD() {
 }
 
 void TakeoverHandlerCallback::getReadBuffer(void** buf, size_t* len) noexcept {
-  readBuffer_ = folly::IOBuf::create(
-      transportSettings_.maxRecvPacketSize +
-      kMaxBufSizeForTakeoverEncapsulation);
-  *buf = readBuffer_->writableData();
-  *len = transportSettings_.maxRecvPacketSize +
+  size_t readBufferSize = transportSettings_->maxRecvPacketSize +
       kMaxBufSizeForTakeoverEncapsulation;
+  if (takeoverPktHandler_.getTakeoverProtocolVersion() >=
+      TakeoverProtocolVersion::V1) {
+    readBufferSize = std::max<size_t>(readBufferSize, kMaxTakeoverBatchSize);
+  }
+  readBuffer_ = folly::IOBuf::create(readBufferSize);
+  *buf = readBuffer_->writableData();
+  *len = readBufferSize;
 }
 
 void TakeoverHandlerCallback::onDataAvailable(
@@ -105,22 +148,36 @@ void TakeoverHandlerCallback::onReadClosed() noexcept {
 }
 
 void TakeoverPacketHandler::setDestination(
-    const folly::SocketAddress& destAddr) {
+    const folly::SocketAddress& destAddr,
+    TakeoverProtocolVersion peerVersion) {
   pktForwardDestAddr_ = folly::SocketAddress(destAddr);
   packetForwardingEnabled_ = true;
+  forwardingProtocol_ = std::min(takeoverProtocol_, peerVersion);
 }
 
 void TakeoverPacketHandler::forwardPacketToAnotherServer(
     const folly::SocketAddress& peerAddress,
     Buf data,
     const TimePoint& packetReceiveTime) {
+  if (forwardingProtocol_ == TakeoverProtocolVersion::V1) {
+    batchPacket(peerAddress, std::move(data), packetReceiveTime);
+    return;
+  }
+  forwardPacketV0(peerAddress, std::move(data), packetReceiveTime);
+}
+
+void TakeoverPacketHandler::forwardPacketV0(
+    const folly::SocketAddress& peerAddress,
+    Buf data,
+    const TimePoint& packetReceiveTime) {
   // create buffer for the peerAddress address and clientPacketReceiveTime
   // Serialize: version (4B), socket(2 + 16)B and time of ack (8B)
   auto bufSize = sizeof(TakeoverProtocolVersion) + sizeof(uint16_t) +
       peerAddress.getActualSize() + sizeof(uint64_t);
   Buf writeBuffer = folly::IOBuf::create(bufSize);
   folly::io::Appender appender(writeBuffer.get(), bufSize);
-  appender.writeBE<uint32_t>(static_cast<uint32_t>(takeoverProtocol_));
+  appender.writeBE<uint32_t>(
+      static_cast<uint32_t>(TakeoverProtocolVersion::V0));
   sockaddr_storage addrStorage;
   uint16_t socklen = peerAddress.getAddress(&addrStorage);
   appender.writeBE<uint16_t>(socklen);
@@ -131,6 +188,60 @@ void TakeoverPacketHandler::forwardPacketToAnotherServer(
   forwardPacket(std::move(writeBuffer));
 }
 
+void TakeoverPacketHandler::batchPacket(
+    const folly::SocketAddress& peerAddress,
+    Buf data,
+    const TimePoint& packetReceiveTime) {
+  auto packetLen = data->computeChainDataLength();
+  auto entrySize = kMaxTakeoverBatchEntryHeaderSize + packetLen;
+  if (kTakeoverBatchHeaderSize + entrySize > kMaxTakeoverBatchSize) {
+    // Too big to ever fit in a batch.
+    forwardPacketV0(peerAddress, std::move(data), packetReceiveTime);
+    return;
+  }
+  if (pendingBatch_ &&
+      pendingBatch_->length() + entrySize > kMaxTakeoverBatchSize) {
+    flushBatch();
+  }
+  if (!pendingBatch_) {
+    pendingBatch_ = folly::IOBuf::create(kMaxTakeoverBatchSize);
+    pendingBatchTime_ = packetReceiveTime;
+    folly::io::Appender appender(pendingBatch_.get(), 0);
+    appender.writeBE<uint32_t>(
+        static_cast<uint32_t>(TakeoverProtocolVersion::V1));
+    appender.writeBE<uint64_t>(pendingBatchTime_.time_since_epoch().count());
+    worker_->getEventBase()->runInLoop(this);
+  }
+  auto ip = peerAddress.getIPAddress();
+  folly::io::Appender appender(pendingBatch_.get(), 0);
+  appender.writeBE<uint8_t>(ip.byteCount());
+  appender.push(ip.bytes(), ip.byteCount());
+  appender.writeBE<uint16_t>(peerAddress.getPort());
+  // Packets read later in the loop may carry an earlier receive time.
+  appendQuicInteger(
+      *pendingBatch_,
+      packetReceiveTime > pendingBatchTime_
+          ? (packetReceiveTime - pendingBatchTime_).count()
+          : 0);
+  appendQuicInteger(*pendingBatch_, packetLen);
+  for (auto range : *data) {
+    memcpy(pendingBatch_->writableTail(), range.data(), range.size());
+    pendingBatch_->append(range.size());
+  }
+}
+
+void TakeoverPacketHandler::flushBatch() {
+  if (!pendingBatch_) {
+    return;
+  }
+  cancelLoopCallback();
+  forwardPacket(std::move(pendingBatch_));
+}
+
+void TakeoverPacketHandler::runLoopCallback() noexcept {
+  flushBatch();
+}
+
 TakeoverPacketHandler::TakeoverPacketHandler(QuicServerWorker* worker)
     : worker_(worker) {}
 
@@ -173,7 +284,12 @@ void TakeoverPacketHandler::processForwardedPacket(
   }
   uint32_t protocol =
       cursor.readBE<std::underlying_type<TakeoverProtocolVersion>::type>();
-  if (protocol != static_cast<uint32_t>(takeoverProtocol_)) {
+  if (protocol == static_cast<uint32_t>(TakeoverProtocolVersion::V1) &&
+      takeoverProtocol_ >= TakeoverProtocolVersion::V1) {
+    processForwardedBatch(std::move(data), cursor - data.get());
+    return;
+  }
+  if (protocol != static_cast<uint32_t>(TakeoverProtocolVersion::V0)) {
     VLOG(4) << "Unexpected takeover protocol version=" << protocol;
     return;
   }
@@ -222,8 +338,49 @@ void TakeoverPacketHandler::processForwardedPacket(
       peerAddress, std::move(data), clientPacketReceiveTime);
 }
 
+void TakeoverPacketHandler::processForwardedBatch(Buf data, size_t offset) {
+  // The packets are handed out as views of the datagram.
+  data->coalesce();
+  folly::io::Cursor cursor(data.get());
+  cursor.skip(offset);
+  if (!cursor.canAdvance(sizeof(uint64_t))) {
+    VLOG(4) << "Malformed batch received without receive time. Dropping.";
+    return;
+  }
+  TimePoint batchReceiveTime(Clock::duration(cursor.readBE<uint64_t>()));
+  while (!cursor.isAtEnd()) {
+    uint8_t addrLen = cursor.read<uint8_t>();
+    std::array<uint8_t, 16> addrBytes;
+    if (addrLen > addrBytes.size() ||
+        !cursor.canAdvance(addrLen + sizeof(uint16_t))) {
+      VLOG(4) << "Malformed batch received. Dropping the rest.";
+      return;
+    }
+    cursor.pull(addrBytes.data(), addrLen);
+    uint16_t port = cursor.readBE<uint16_t>();
+    auto ip = folly::IPAddress::tryFromBinary(
+        folly::ByteRange(addrBytes.data(), addrLen));
+    auto timeOffset = decodeQuicInteger(cursor);
+    auto packetLen = timeOffset ? decodeQuicInteger(cursor) : folly::none;
+    if (ip.hasError() || !packetLen || !cursor.canAdvance(packetLen->first)) {
+      VLOG(4) << "Malformed batch received. Dropping the rest.";
+      return;
+    }
+    auto packet = makePacketView(
+        data, cursor - data.get(), static_cast<size_t>(packetLen->first));
+    cursor.skip(packetLen->first);
+    QUIC_STATS(worker_->getInfoCallback(), onForwardedPacketProcessed);
+    worker_->handleNetworkData(
+        folly::SocketAddress(ip.value(), port),
+        std::move(packet),
+        batchReceiveTime + Clock::duration(timeOffset->first));
+  }
+}
+
 void TakeoverPacketHandler::stop() {
   packetForwardingEnabled_ = false;
+  cancelLoopCallback();
+  pendingBatch_.reset();
   pktForwardingSocket_.reset();
 }
 } // namespace quic
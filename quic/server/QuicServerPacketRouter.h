@@ -30,7 +30,12 @@ enum class ProcessId : uint8_t { ZERO = 0x0, ONE = 0x1 };
  * Version of the 'takeover' protocol
  */
 enum class TakeoverProtocolVersion : uint32_t {
+  // One datagram per forwarded packet, prefixed with the client's sockaddr
+  // and the receive time.
   V0 = 0x00000001,
+  // Forwarded packets batched into datagrams of up to kMaxTakeoverBatchSize,
+  // with a compact header per packet.
+  V1 = 0x00000002,
 };
 
 struct RoutingData {
@@ -46,6 +51,15 @@ struct RoutingData {
   // Source connection may not be present for short header packets.
   folly::Optional<ConnectionId> sourceConnId;
 
+  // Routing info decoded from destinationConnId by the worker that read the
+  // packet, so that the connection id is only parsed once per datagram. Not
+  // set for packets that use the client's connection id.
+  folly::Optional<ServerConnectionIdParams> connIdParams;
+
+  // Set on the packets of a new connection a more loaded worker handed over,
+  // so that they are not handed over again.
+  bool redirected{false};
+
   RoutingData(
       HeaderForm headerFormIn,
       bool isInitialIn,
@@ -66,14 +80,20 @@ struct RoutingData {
  * another quic server (on the same host) and process the packets forwarded by
  * another quic server.
  */
-class TakeoverPacketHandler {
+class TakeoverPacketHandler : private folly::EventBase::LoopCallback {
  public:
   explicit TakeoverPacketHandler(QuicServerWorker* worker);
   virtual ~TakeoverPacketHandler();
 
   void setSocketFactory(QuicUDPSocketFactory* factory);
 
-  void setDestination(const folly::SocketAddress& destAddr);
+  /**
+   * Forwards to destAddr with the newest version both this handler and the
+   * peer, which accepts up to peerVersion, speak.
+   */
+  void setDestination(
+      const folly::SocketAddress& destAddr,
+      TakeoverProtocolVersion peerVersion = TakeoverProtocolVersion::V0);
 
   void forwardPacketToAnotherServer(
       const folly::SocketAddress& peerAddress,
@@ -84,8 +104,16 @@ class TakeoverPacketHandler {
 
   void stop();
 
+  /**
+   * The newest version this handler speaks. It accepts forwarded packets of
+   * any version up to it.
+   */
   TakeoverProtocolVersion getTakeoverProtocolVersion() const noexcept {
-    return TakeoverProtocolVersion::V0;
+    return takeoverProtocol_;
+  }
+
+  void setTakeoverProtocolVersion(TakeoverProtocolVersion version) noexcept {
+    takeoverProtocol_ = version;
   }
 
   TakeoverProtocolVersion takeoverProtocol_{TakeoverProtocolVersion::V0};
@@ -93,6 +121,19 @@ class TakeoverPacketHandler {
  private:
   std::unique_ptr<folly::AsyncUDPSocket> makeSocket(folly::EventBase* evb);
   void forwardPacket(Buf packet);
+  void forwardPacketV0(
+      const folly::SocketAddress& peerAddress,
+      Buf data,
+      const TimePoint& packetReceiveTime);
+  void batchPacket(
+      const folly::SocketAddress& peerAddress,
+      Buf data,
+      const TimePoint& packetReceiveTime);
+  void flushBatch();
+  void processForwardedBatch(Buf data, size_t offset);
+
+  // Flushes the batch at the end of the loop the packets were read in.
+  void runLoopCallback() noexcept override;
   // prevent copying
   TakeoverPacketHandler(const TakeoverPacketHandler&);
   TakeoverPacketHandler& operator=(const TakeoverPacketHandler&);
@@ -102,6 +143,12 @@ class TakeoverPacketHandler {
   std::unique_ptr<folly::AsyncUDPSocket> pktForwardingSocket_;
   bool packetForwardingEnabled_{false};
   QuicUDPSocketFactory* socketFactory_{nullptr};
+  // The version the packets are forwarded with.
+  TakeoverProtocolVersion forwardingProtocol_{TakeoverProtocolVersion::V0};
+  // V1 datagram being filled, and the receive time its packets are relative
+  // to.
+  Buf pendingBatch_;
+  TimePoint pendingBatchTime_;
 };
 
 /**
@@ -113,7 +160,7 @@ class TakeoverHandlerCallback : public folly::AsyncUDPSocket::ReadCallback,
   explicit TakeoverHandlerCallback(
       QuicServerWorker* worker,
       TakeoverPacketHandler& takeoverPktHandler,
-      const TransportSettings& transportSettings,
+      TransportSettingsSnapshot transportSettings,
       const folly::SocketAddress& address,
       std::unique_ptr<folly::AsyncUDPSocket> socket);
 
@@ -145,8 +192,8 @@ class TakeoverHandlerCallback : public folly::AsyncUDPSocket::ReadCallback,
   QuicServerWorker* worker_;
   // QuicServerWorker owns Packethandler
   TakeoverPacketHandler& takeoverPktHandler_;
-  // QuicServerWorker owns the transport settings
-  const TransportSettings& transportSettings_;
+  // settings of the QuicServerWorker when it made the callback
+  TransportSettingsSnapshot transportSettings_;
   folly::SocketAddress address_;
   std::unique_ptr<folly::AsyncUDPSocket> socket_;
   Buf readBuffer_;
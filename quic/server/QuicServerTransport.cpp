@@ -8,9 +8,12 @@
 
 #include <quic/server/QuicServerTransport.h>
 
+#include <quic/common/BlockRecycler.h>
+#include <quic/congestion_control/FairSharePacer.h>
 #include <quic/server/handshake/AppToken.h>
 #include <quic/server/handshake/DefaultAppTokenValidator.h>
 #include <quic/server/handshake/StatelessResetGenerator.h>
+#include <quic/server/state/ConnectionStateSerializer.h>
 
 namespace quic {
 
@@ -49,7 +52,9 @@ QuicServerTransport::Ptr QuicServerTransport::make(
     std::unique_ptr<folly::AsyncUDPSocket> sock,
     ConnectionCallback& cb,
     std::shared_ptr<const fizz::server::FizzServerContext> ctx) {
-  return std::make_shared<QuicServerTransport>(evb, std::move(sock), cb, ctx);
+  // Along with its control block, in a block recycled from closed ones.
+  return std::allocate_shared<QuicServerTransport>(
+      RecyclingAllocator<QuicServerTransport>(), evb, std::move(sock), cb, ctx);
 }
 
 void QuicServerTransport::setRoutingCallback(
@@ -77,6 +82,128 @@ void QuicServerTransport::setTransportInfoCallback(
   }
 }
 
+void QuicServerTransport::setSharedPacketBatch(
+    SharedPacketBatch* sharedBatch) noexcept {
+  if (conn_) {
+    conn_->sharedPacketBatch = sharedBatch;
+  }
+}
+
+void QuicServerTransport::setReceiveWindowBudget(
+    ReceiveWindowBudget* budget) noexcept {
+  if (conn_) {
+    releaseReceiveWindowBudget(*conn_);
+    conn_->receiveWindowBudget = budget;
+  }
+}
+
+void QuicServerTransport::setCongestionStateCache(
+    CongestionStateCache* cache) noexcept {
+  if (serverConn_) {
+    serverConn_->congestionStateCache = cache;
+  }
+}
+
+void QuicServerTransport::setPendingPacketBudget(
+    PendingPacketBudget* budget) noexcept {
+  if (!serverConn_) {
+    return;
+  }
+  for (auto pendingData :
+       {serverConn_->pendingZeroRttData.get(),
+        serverConn_->pendingOneRttData.get()}) {
+    if (pendingData) {
+      releasePendingPacketBudget(*serverConn_, *pendingData);
+      // The packets are only passed over to budgets they fit in.
+      pendingData->clear();
+    }
+  }
+  serverConn_->pendingPacketBudget = budget;
+}
+
+void QuicServerTransport::setInitialCipherPool(
+    std::shared_ptr<InitialCipherPool> pool) noexcept {
+  if (serverConn_) {
+    serverConn_->initialCipherPool = std::move(pool);
+  }
+}
+
+void QuicServerTransport::setTransportParametersCache(
+    std::shared_ptr<ServerTransportParametersCache> cache) noexcept {
+  if (serverConn_) {
+    serverConn_->transportParametersCache = std::move(cache);
+  }
+}
+
+void QuicServerTransport::setBandwidthAllocator(
+    std::shared_ptr<BandwidthAllocator> allocator) noexcept {
+  if (conn_ && conn_->pacer) {
+    conn_->pacer = std::make_unique<FairSharePacer>(
+        std::move(conn_->pacer), std::move(allocator));
+  }
+}
+
+void QuicServerTransport::setOverloadState(
+    QuicConnectionStateBase::OverloadState state) noexcept {
+  conn_->overloadState = std::move(state);
+}
+
+void QuicServerTransport::setHandshakeExecutor(
+    std::shared_ptr<folly::Executor> executor) noexcept {
+  handshakeExecutor_ = std::move(executor);
+}
+
+void QuicServerTransport::setEncryptExecutor(
+    std::shared_ptr<folly::Executor> executor,
+    size_t numHelpers) noexcept {
+  encryptExecutor_ = std::move(executor);
+  numEncryptHelpers_ = numHelpers;
+}
+
+bool QuicServerTransport::startPacketTrace(
+    std::shared_ptr<PacketTraceRecorder> recorder) {
+  CHECK(recorder);
+  if (!recorder->start(*serverConn_)) {
+    return false;
+  }
+  packetTraceRecorder_ = std::move(recorder);
+  return true;
+}
+
+void QuicServerTransport::stopPacketTrace() {
+  packetTraceRecorder_.reset();
+}
+
+bool QuicServerTransport::adoptConnectionState(
+    const folly::IOBuf& state,
+    std::vector<QuicConnectionStateBase::SelfConnectionId> connectionIds) {
+  if (!restoreConnectionState(*serverConn_, state)) {
+    return false;
+  }
+  conn_->selfConnectionIds = std::move(connectionIds);
+  for (const auto& selfConnId : conn_->selfConnectionIds) {
+    conn_->nextSelfConnectionIdSequence = std::max(
+        conn_->nextSelfConnectionIdSequence, selfConnId.sequence + 1);
+  }
+  // The transport the state comes from was routed, bound and wrote the
+  // ticket already.
+  notifiedRouting_ = true;
+  notifiedConnIdBound_ = true;
+  newSessionTicketWritten_ = true;
+  setIdleTimer();
+  maybeNotifyTransportReady();
+  return true;
+}
+
+void QuicServerTransport::closeForHandOff() {
+  closeImpl(
+      std::make_pair(
+          QuicErrorCode(LocalErrorCode::NO_ERROR),
+          std::string("Connection handed off")),
+      false /* drainConnection */,
+      false /* sendCloseImmediately */);
+}
+
 void QuicServerTransport::setConnectionIdAlgo(
     ConnectionIdAlgo* connIdAlgo) noexcept {
   CHECK(connIdAlgo);
@@ -97,10 +224,14 @@ void QuicServerTransport::setCongestionControllerFactory(
 void QuicServerTransport::onReadData(
     const folly::SocketAddress& peer,
     NetworkData&& networkData) {
+  if (packetTraceRecorder_) {
+    packetTraceRecorder_->onNetworkData(peer, networkData);
+  }
   ServerEvents::ReadData readData;
   readData.peer = peer;
   readData.networkData = std::move(networkData);
   onServerReadData(*serverConn_, readData);
+  maybeCarefulResume();
   processPendingData(true);
 
   if (closeState_ == CloseState::CLOSED) {
@@ -113,19 +244,46 @@ void QuicServerTransport::onReadData(
   }
   maybeWriteNewSessionTicket();
   maybeNotifyConnectionIdBound();
+  maybeRetireConnectionIds();
+  maybeIssueConnectionIds();
   maybeNotifyTransportReady();
 }
 
 void QuicServerTransport::accept() {
+  if (serverConn_->congestionStateCache) {
+    auto cached = serverConn_->congestionStateCache->get(
+        getOriginalPeerAddress().getIPAddress(), Clock::now());
+    if (cached) {
+      seedCongestionState(*conn_, *cached);
+      // Recreate the congestion controller for the seeded initial cwnd.
+      if (ccFactory_) {
+        conn_->congestionController = ccFactory_->makeCongestionController(
+            *conn_, conn_->transportSettings.defaultCongestionController);
+      }
+    }
+  }
   setIdleTimer();
   updateFlowControlStateWithSettings(
       conn_->flowControlState, conn_->transportSettings);
+  if (conn_->transportSettings.connectionStateExportEnabled) {
+    serverConn_->serverHandshakeLayer->setRetainOneRttSecrets(true);
+  }
+  if (conn_->transportSettings.packetCaptureDatagrams > 0) {
+    serverConn_->serverHandshakeLayer->setRetainKeyLog(true);
+  }
   serverConn_->serverHandshakeLayer->initialize(
       evb_,
       ctx_,
       this,
       std::make_unique<DefaultAppTokenValidator>(
           serverConn_, std::move(earlyDataAppParamsValidator_)));
+  if (handshakeExecutor_) {
+    serverConn_->serverHandshakeLayer->setCryptoExecutor(handshakeExecutor_);
+  }
+  if (encryptExecutor_ && numEncryptHelpers_ > 0) {
+    serverConn_->serverHandshakeLayer->setEncryptExecutor(
+        encryptExecutor_, numEncryptHelpers_);
+  }
 }
 
 void QuicServerTransport::writeData() {
@@ -156,7 +314,7 @@ void QuicServerTransport::writeData() {
       // pending in which case we would not derive the 1-RTT keys. We
       // shouldn't send a long header at this point, because the client may
       // have already dropped its handshake keys.
-      writeShortClose(
+      closePacket_ = writeShortClose(
           *socket_,
           *conn_,
           destConnId /* dst */,
@@ -165,7 +323,7 @@ void QuicServerTransport::writeData() {
           *conn_->oneRttWriteHeaderCipher);
     } else if (conn_->initialWriteCipher) {
       CHECK(conn_->initialHeaderCipher);
-      writeLongClose(
+      closePacket_ = writeLongClose(
           *socket_,
           *conn_,
           srcConnId /* src */,
@@ -179,16 +337,23 @@ void QuicServerTransport::writeData() {
     return;
   }
 
-  if (UNLIKELY(!conn_->initialWriteCipher)) {
+  if (UNLIKELY(
+          !conn_->initialWriteCipher && !conn_->handshakeSpacesDiscarded)) {
     // This would be possible if we read a packet from the network which
     // could not be parsed later.
     return;
   }
 
+  auto now = loopClockNow(*conn_);
   uint64_t packetLimit =
       (isConnectionPaced(*conn_)
-           ? conn_->congestionController->getPacingRate(Clock::now())
-           : conn_->transportSettings.writeConnectionDataPacketsLimit);
+           ? (conn_->pacer ? conn_->pacer->updateAndGetWriteBatchSize(now)
+                           : conn_->congestionController->getPacingRate(now))
+           : getWritePacketLimit(*conn_));
+  if (conn_->overloadState.writePacketsLimit) {
+    packetLimit =
+        std::min(packetLimit, *conn_->overloadState.writePacketsLimit);
+  }
   CryptoStreamScheduler initialScheduler(
       *conn_, *getCryptoStream(*conn_->cryptoState, EncryptionLevel::Initial));
   CryptoStreamScheduler handshakeScheduler(
@@ -247,28 +412,65 @@ void QuicServerTransport::writeData() {
 }
 
 void QuicServerTransport::closeTransport() {
+  if (serverConn_->congestionStateCache) {
+    serverConn_->congestionStateCache->update(
+        getOriginalPeerAddress().getIPAddress(), *conn_, Clock::now());
+  }
+  releaseReceiveWindowBudget(*conn_);
   serverConn_->serverHandshakeLayer->cancel();
   // Clear out pending data.
+  if (serverConn_->pendingZeroRttData) {
+    releasePendingPacketBudget(*serverConn_, *serverConn_->pendingZeroRttData);
+  }
+  if (serverConn_->pendingOneRttData) {
+    releasePendingPacketBudget(*serverConn_, *serverConn_->pendingOneRttData);
+  }
   serverConn_->pendingZeroRttData.reset();
   serverConn_->pendingOneRttData.reset();
   onServerClose(*serverConn_);
 }
 
+QuicServerTransport::SourceIdentity QuicServerTransport::getSourceIdentity()
+    const {
+  // TODO: we need a better way to solve the case that a QuicServerTransport
+  // is created and added to the map, but conn.ClientConnectionId doesn't get
+  // a legit value.
+  const ConnectionId* connId =
+      &(*serverConn_->serverConnIdParams->clientConnId);
+  if (conn_->clientConnectionId) {
+    connId = &(*conn_->clientConnectionId);
+  }
+  return std::make_pair(getOriginalPeerAddress(), *connId);
+}
+
+bool QuicServerTransport::handOffDrain(
+    std::chrono::milliseconds drainTimeout) {
+  if (!conn_->transportSettings.closedConnectionRecordsEnabled ||
+      !routingCb_ || !conn_->serverConnectionId) {
+    return false;
+  }
+  routingCb_->onConnectionDraining(shared_from_this(), drainTimeout);
+  return true;
+}
+
 void QuicServerTransport::unbindConnection() {
   if (routingCb_) {
     auto routingCb = routingCb_;
     routingCb_ = nullptr;
-    // TODO: we need a better way to solve the case that a QuicServerTransport
-    // is created and added to the map, but conn.ClientConnectionId doesn't get
-    // a legit value.
-    const ConnectionId* connId =
-        &(*serverConn_->serverConnIdParams->clientConnId);
-    if (conn_->clientConnectionId) {
-      connId = &(*conn_->clientConnectionId);
+    // Ids from the pool go first, onConnectionUnbound takes the handshake one.
+    auto& retiredIds = conn_->retiredSelfConnectionIds;
+    for (const auto& selfConnId : conn_->selfConnectionIds) {
+      if (selfConnId.sequence != 0) {
+        retiredIds.push_back(selfConnId.connId);
+      }
+    }
+    conn_->selfConnectionIds.clear();
+    if (!retiredIds.empty()) {
+      routingCb->onConnectionIdsRetired(shared_from_this(), retiredIds);
+      retiredIds.clear();
     }
     routingCb->onConnectionUnbound(
-        std::make_pair(getOriginalPeerAddress(), *connId),
-        conn_->serverConnectionId);
+        getSourceIdentity(), conn_->serverConnectionId);
   }
 }
 
@@ -280,6 +482,13 @@ std::shared_ptr<QuicTransportBase> QuicServerTransport::sharedGuard() {
   return shared_from_this();
 }
 
+std::string QuicServerTransport::getKeyLog() const {
+  if (!serverConn_->serverHandshakeLayer) {
+    return "";
+  }
+  return serverConn_->serverHandshakeLayer->getKeyLog();
+}
+
 void QuicServerTransport::onCryptoEventAvailable() noexcept {
   try {
     VLOG(10) << "onCryptoEventAvailable " << *this;
@@ -321,11 +530,18 @@ void QuicServerTransport::processPendingData(bool async) {
     pendingData = std::move(serverConn_->pendingOneRttData);
     // It's possible that 0-rtt packets are received after CFIN, we are not
     // dealing with that much level of reordering.
+    if (serverConn_->pendingZeroRttData) {
+      releasePendingPacketBudget(
+          *serverConn_, *serverConn_->pendingZeroRttData);
+    }
     serverConn_->pendingZeroRttData.reset();
   } else if (conn_->readCodec && conn_->readCodec->getZeroRttReadCipher()) {
     pendingData = std::move(serverConn_->pendingZeroRttData);
   }
   if (pendingData) {
+    // The packets are processed together below, so they no longer count
+    // against the budget of the worker.
+    releasePendingPacketBudget(*serverConn_, *pendingData);
     // Move the pending data out so that we don't ever add new data to the
     // pending data.
     VLOG_IF(10, !pendingData->empty())
@@ -361,32 +577,77 @@ void QuicServerTransport::maybeWriteNewSessionTicket() {
       serverConn_->serverHandshakeLayer->isHandshakeDone()) {
     QUIC_TRACE(fst_trace, *conn_, "write nst");
     newSessionTicketWritten_ = true;
-    AppToken appToken;
-    appToken.transportParams = createTicketTransportParameters(
-        conn_->transportSettings.idleTimeout.count(),
-        conn_->transportSettings.maxRecvPacketSize,
-        conn_->transportSettings.advertisedInitialConnectionWindowSize,
-        conn_->transportSettings.advertisedInitialBidiLocalStreamWindowSize,
-        conn_->transportSettings.advertisedInitialBidiRemoteStreamWindowSize,
-        conn_->transportSettings.advertisedInitialUniStreamWindowSize,
-        std::numeric_limits<uint32_t>::max(),
-        std::numeric_limits<uint32_t>::max());
-    appToken.sourceAddresses = serverConn_->tokenSourceAddresses;
-    appToken.version = conn_->version;
-    // If a client connects to server for the first time and doesn't attempt
-    // early data, tokenSourceAddresses will not be set because
-    // validateAndUpdateSourceAddressToken is not called in this case.
-    // So checking if source address token is empty here and adding peerAddr
-    // if so.
-    // TODO accumulate recent source tokens
-    if (appToken.sourceAddresses.empty()) {
-      appToken.sourceAddresses.push_back(conn_->peerAddress.getIPAddress());
-    }
-    if (earlyDataAppParamsGetter_) {
-      appToken.appParams = earlyDataAppParamsGetter_();
-    }
-    serverConn_->serverHandshakeLayer->writeNewSessionTicket(appToken);
+    writeNewSessionTicket(folly::none);
+  }
+  // A ticket with the path state is only worth it once slow start is over and
+  // the cwnd says something about the path.
+  if (newSessionTicketWritten_ && !congestionStateTicketWritten_ &&
+      conn_->transportSettings.carefulResumeEnabled &&
+      conn_->congestionController &&
+      !conn_->congestionController->inSlowStart() &&
+      conn_->lossState.mrtt != std::chrono::microseconds::max()) {
+    congestionStateTicketWritten_ = true;
+    TicketCongestionState congestionState;
+    congestionState.minRtt = conn_->lossState.mrtt;
+    congestionState.cwndBytes =
+        conn_->congestionController->getCongestionWindow();
+    congestionState.issueTime =
+        std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    writeNewSessionTicket(congestionState);
+  }
+}
+
+void QuicServerTransport::writeNewSessionTicket(
+    folly::Optional<TicketCongestionState> congestionState) {
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      conn_->transportSettings.idleTimeout.count(),
+      conn_->transportSettings.maxRecvPacketSize,
+      conn_->transportSettings.advertisedInitialConnectionWindowSize,
+      conn_->transportSettings.advertisedInitialBidiLocalStreamWindowSize,
+      conn_->transportSettings.advertisedInitialBidiRemoteStreamWindowSize,
+      conn_->transportSettings.advertisedInitialUniStreamWindowSize,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max());
+  appToken.sourceAddresses = serverConn_->tokenSourceAddresses;
+  appToken.version = conn_->version;
+  // If a client connects to server for the first time and doesn't attempt
+  // early data, tokenSourceAddresses will not be set because
+  // validateAndUpdateSourceAddressToken is not called in this case.
+  // So checking if source address token is empty here and adding peerAddr
+  // if so.
+  // TODO accumulate recent source tokens
+  if (appToken.sourceAddresses.empty()) {
+    appToken.sourceAddresses.push_back(conn_->peerAddress.getIPAddress());
+  }
+  if (earlyDataAppParamsGetter_) {
+    appToken.appParams = earlyDataAppParamsGetter_();
   }
+  appToken.congestionState = std::move(congestionState);
+  serverConn_->serverHandshakeLayer->writeNewSessionTicket(appToken);
+}
+
+void QuicServerTransport::maybeCarefulResume() {
+  auto& congestionState = serverConn_->ticketCongestionState;
+  if (!congestionState || conn_->lossState.lrtt == 0us) {
+    return;
+  }
+  // The first rtt sample decides, the saved state is dropped either way.
+  auto savedRtt = congestionState->minRtt;
+  auto lrtt = conn_->lossState.lrtt;
+  if (conn_->congestionController &&
+      lrtt >= savedRtt / kCarefulResumeRttLowerDivisor &&
+      lrtt <= savedRtt * kCarefulResumeRttUpperFactor) {
+    conn_->congestionController->carefulResume(
+        congestionState->cwndBytes, Clock::now());
+  } else {
+    VLOG(10) << "Rtt changed, not resuming cwnd=" << congestionState->cwndBytes
+             << " lrtt=" << lrtt.count() << "us saved=" << savedRtt.count()
+             << "us " << *this;
+  }
+  congestionState = folly::none;
 }
 
 void QuicServerTransport::maybeNotifyConnectionIdBound() {
@@ -398,6 +659,56 @@ void QuicServerTransport::maybeNotifyConnectionIdBound() {
   }
 }
 
+void QuicServerTransport::maybeRetireConnectionIds() {
+  auto& retiredIds = conn_->retiredSelfConnectionIds;
+  if (retiredIds.empty() || !routingCb_) {
+    return;
+  }
+  // The handshake id stays routed until the connection is unbound, as
+  // packets in flight may still carry it.
+  retiredIds.erase(
+      std::remove(
+          retiredIds.begin(), retiredIds.end(), *conn_->serverConnectionId),
+      retiredIds.end());
+  if (!retiredIds.empty()) {
+    routingCb_->onConnectionIdsRetired(shared_from_this(), retiredIds);
+  }
+  retiredIds.clear();
+}
+
+void QuicServerTransport::maybeIssueConnectionIds() {
+  // Issued ids are only routed to the transport once it's bound.
+  if (!notifiedConnIdBound_ || !routingCb_ ||
+      closeState_ != CloseState::OPEN) {
+    return;
+  }
+  auto poolSize = std::min<size_t>(
+      conn_->transportSettings.connectionIdPoolSize, kMaxConnectionIdPoolSize);
+  // One of the ids is the one in use.
+  auto numIssued = conn_->selfConnectionIds.size();
+  if (numIssued > poolSize) {
+    return;
+  }
+  const auto& connIdParams = *serverConn_->serverConnIdParams;
+  std::vector<ConnectionId> newIds;
+  newIds.reserve(poolSize + 1 - numIssued);
+  for (size_t i = numIssued; i <= poolSize; ++i) {
+    newIds.push_back(conn_->connIdAlgo->encodeConnectionId(connIdParams));
+  }
+  // Registering them all at once lets the worker update its map in one go,
+  // and queuing all the frames now sends them in the same packet.
+  routingCb_->onConnectionIdsAvailable(shared_from_this(), newIds);
+  StatelessResetGenerator generator(
+      conn_->transportSettings.statelessResetTokenSecret.value(),
+      conn_->serverAddr.getFullyQualified());
+  for (const auto& connId : newIds) {
+    auto sequence = conn_->nextSelfConnectionIdSequence++;
+    conn_->selfConnectionIds.push_back({sequence, connId});
+    auto token = generator.generateToken(connId);
+    sendSimpleFrame(*conn_, NewConnectionIdFrame(sequence, connId, token));
+  }
+}
+
 void QuicServerTransport::maybeNotifyTransportReady() {
   if (!transportReadyNotified_ && connCallback_ && hasWriteCipher()) {
     QUIC_TRACE(fst_trace, *conn_, "transport ready");
@@ -11,7 +11,9 @@
 #include <quic/api/QuicTransportBase.h>
 #include <quic/api/QuicTransportFunctions.h>
 #include <quic/codec/ConnectionIdAlgo.h>
+#include <quic/congestion_control/BandwidthAllocator.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/server/PacketTrace.h>
 #include <quic/server/handshake/ServerTransportParametersExtension.h>
 #include <quic/server/state/ServerStateMachine.h>
 #include <quic/state/QuicTransportStatsCallback.h>
@@ -39,6 +41,26 @@ class QuicServerTransport
     // be used any more for routing.
     virtual void onConnectionIdBound(Ptr transport) noexcept = 0;
 
+    // Called with connection ids issued to the peer on top of the one the
+    // transport was bound with, before they're sent. The ones that can't be
+    // routed to the transport, e.g. because they're in use by another one,
+    // are removed from ids and not issued.
+    virtual void onConnectionIdsAvailable(
+        Ptr transport,
+        std::vector<ConnectionId>& ids) noexcept = 0;
+
+    // Called with connection ids issued with onConnectionIdsAvailable once
+    // the peer retired them.
+    virtual void onConnectionIdsRetired(
+        Ptr transport,
+        const std::vector<ConnectionId>& ids) noexcept = 0;
+
+    // Called with a transport that closed, with closedConnectionRecordsEnabled,
+    // to drain for drainTimeout without it. It is unbound right after.
+    virtual void onConnectionDraining(
+        Ptr transport,
+        std::chrono::milliseconds drainTimeout) noexcept = 0;
+
     // Called when the connection is finished and needs to be Unbound.
     virtual void onConnectionUnbound(
         const SourceIdentity& address,
@@ -73,6 +95,107 @@ class QuicServerTransport
   virtual void setTransportInfoCallback(
       QuicTransportStatsCallback* infoCallback) noexcept;
 
+  /**
+   * Set the batch shared by the connections of the owning worker. Packets are
+   * then queued to it instead of being written to the socket directly. Pass
+   * nullptr to go back to direct writes.
+   */
+  virtual void setSharedPacketBatch(SharedPacketBatch* sharedBatch) noexcept;
+
+  /**
+   * Set the path state cache shared by the connections of the owning worker.
+   * The connection seeds its rtt and initial cwnd from it in accept(), and
+   * updates it when it closes. Pass nullptr to stop using it.
+   */
+  virtual void setCongestionStateCache(CongestionStateCache* cache) noexcept;
+
+  /**
+   * Set the receive window budget shared by the connections of the owning
+   * worker. The window growth of the connection is given back to the previous
+   * budget, if any. Pass nullptr to stop using it.
+   */
+  virtual void setReceiveWindowBudget(ReceiveWindowBudget* budget) noexcept;
+
+  /**
+   * Set the pending packet budget shared by the connections of the owning
+   * worker, which the packets the connection buffers until it can decrypt
+   * them are charged to. Packets already buffered are dropped. Pass nullptr
+   * to stop using it.
+   */
+  virtual void setPendingPacketBudget(PendingPacketBudget* budget) noexcept;
+
+  /**
+   * Set the pool the Initial ciphers of the connection are made from. The
+   * ciphers return their aeads to it when the connection drops them.
+   */
+  virtual void setInitialCipherPool(
+      std::shared_ptr<InitialCipherPool> pool) noexcept;
+
+  /**
+   * Set the cache the transport parameters of the connection are encoded
+   * through, shared by the connections of the owning worker.
+   */
+  virtual void setTransportParametersCache(
+      std::shared_ptr<ServerTransportParametersCache> cache) noexcept;
+
+  /**
+   * Set the load the connection sheds while the server is overloaded, see
+   * OverloadLevel. Can be changed at any time.
+   */
+  virtual void setOverloadState(
+      QuicConnectionStateBase::OverloadState state) noexcept;
+
+  /**
+   * Caps the pacing rate of the connection to its fair share of the
+   * allocator's budget, shared by the connections of the owning worker.
+   * Only paced connections with a pacer are capped, see
+   * TransportSettings::workerEgressBandwidth.
+   */
+  virtual void setBandwidthAllocator(
+      std::shared_ptr<BandwidthAllocator> allocator) noexcept;
+
+  /**
+   * Set the executor the expensive part of the handshake runs on, instead of
+   * the event base of the transport. See ServerHandshake::setCryptoExecutor.
+   * This must be set before accept().
+   */
+  virtual void setHandshakeExecutor(
+      std::shared_ptr<folly::Executor> executor) noexcept;
+
+  /**
+   * Set the executor and the number of its threads the 1-RTT packets are
+   * encrypted on, see ServerHandshake::setEncryptExecutor. This must be set
+   * before accept().
+   */
+  virtual void setEncryptExecutor(
+      std::shared_ptr<folly::Executor> executor,
+      size_t numHelpers) noexcept;
+
+  /**
+   * Records the datagrams read from now on to recorder, from the current
+   * state of the connection, until the recorder is finished or stopPacketTrace
+   * is called. Returns false, and records nothing, if the state cannot be
+   * serialized, see PacketTraceRecorder::start.
+   */
+  bool startPacketTrace(std::shared_ptr<PacketTraceRecorder> recorder);
+  void stopPacketTrace();
+
+  /**
+   * Takes over an established connection from the state another transport
+   * serialized, see serializeConnectionState, instead of accept(). The peer
+   * keeps using the given connection ids, which the caller routes to this
+   * transport. Returns false if the state cannot be restored.
+   */
+  bool adoptConnectionState(
+      const folly::IOBuf& state,
+      std::vector<QuicConnectionStateBase::SelfConnectionId> connectionIds);
+
+  /**
+   * Closes the transport without a connection close, once its state was
+   * adopted by another transport which the peer now talks to.
+   */
+  void closeForHandOff();
+
   /**
    * Set ConnectionIdAlgo implementation to encode and decode ConnectionId with
    * various info, such as routing related info.
@@ -93,14 +216,25 @@ class QuicServerTransport
   void writeData() override;
   void closeTransport() override;
   void unbindConnection() override;
+  bool handOffDrain(std::chrono::milliseconds drainTimeout) override;
   bool hasWriteCipher() const override;
   std::shared_ptr<QuicTransportBase> sharedGuard() override;
+  std::string getKeyLog() const override;
 
   const fizz::server::FizzServerContext& getCtx() {
     return *ctx_;
   }
 
   virtual void accept();
+
+  // Source address and connection id the peer was first routed with.
+  SourceIdentity getSourceIdentity() const;
+
+  // The last connection close packet sent, nullptr if none was.
+  const folly::IOBuf* getClosePacket() const {
+    return closePacket_.get();
+  }
+
   void setShedConnection() {
     shedConnection_ = true;
   }
@@ -115,16 +249,29 @@ class QuicServerTransport
  private:
   void processPendingData(bool async);
   void maybeWriteNewSessionTicket();
+  void writeNewSessionTicket(
+      folly::Optional<TicketCongestionState> congestionState);
+  void maybeCarefulResume();
   void maybeNotifyConnectionIdBound();
+  void maybeRetireConnectionIds();
+  void maybeIssueConnectionIds();
   void maybeNotifyTransportReady();
 
  private:
   RoutingCallback* routingCb_{nullptr};
+  Buf closePacket_;
   std::shared_ptr<const fizz::server::FizzServerContext> ctx_;
+  std::shared_ptr<folly::Executor> handshakeExecutor_;
+  std::shared_ptr<folly::Executor> encryptExecutor_;
+  size_t numEncryptHelpers_{0};
   bool notifiedRouting_{false};
   bool notifiedConnIdBound_{false};
   bool newSessionTicketWritten_{false};
+  // Whether a ticket with the path state of this connection was written, on
+  // top of the one written when the handshake is done.
+  bool congestionStateTicketWritten_{false};
   bool shedConnection_{false};
+  std::shared_ptr<PacketTraceRecorder> packetTraceRecorder_;
   QuicServerConnectionState* serverConn_;
 };
 } // namespace quic
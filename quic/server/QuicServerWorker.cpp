@@ -6,13 +6,22 @@
  *
  */
 
+#include <folly/Random.h>
 #include <folly/io/Cursor.h>
 #include <folly/system/ThreadId.h>
 #include <quic/QuicConstants.h>
+#include <quic/codec/Decode.h>
+#include <quic/codec/QuicPacketBuilder.h>
+#include <quic/common/BlockRecycler.h>
 #include <quic/common/Timers.h>
 
 #include <quic/server/QuicServerWorker.h>
+#include <quic/server/TransportProfile.h>
 #include <quic/server/handshake/StatelessResetGenerator.h>
+#include <quic/server/state/ConnectionStateSerializer.h>
+#include <quic/state/QuicStateFunctions.h>
+
+#include <unordered_set>
 
 namespace quic {
 
@@ -53,6 +62,26 @@ QuicTransportStatsCallback* QuicServerWorker::getTransportInfoCallback() const
   return infoCallback_.get();
 }
 
+void QuicServerWorker::setTraceLogger(
+    std::unique_ptr<WorkerTraceLogger> traceLogger) {
+  traceLogger_ = std::move(traceLogger);
+}
+
+void QuicServerWorker::setPacketCaptureCallback(
+    std::shared_ptr<PacketCaptureCallback> callback) {
+  packetCaptureCallback_ = std::move(callback);
+}
+
+void QuicServerWorker::onPacketDropped(
+    PacketDropReason reason,
+    const folly::SocketAddress& client,
+    const ConnectionId* dstConnId) {
+  QUIC_STATS(infoCallback_, onPacketDropped, reason);
+  if (traceLogger_) {
+    traceLogger_->onPacketDropped(reason, client, dstConnId);
+  }
+}
+
 void QuicServerWorker::setConnectionIdAlgo(
     std::unique_ptr<ConnectionIdAlgo> connIdAlgo) noexcept {
   CHECK(connIdAlgo);
@@ -65,11 +94,111 @@ void QuicServerWorker::setCongestionControllerFactory(
   ccFactory_ = ccFactory;
 }
 
+void QuicServerWorker::setHandshakeExecutor(
+    std::shared_ptr<folly::Executor> executor) {
+  handshakeExecutor_ = std::move(executor);
+}
+
+void QuicServerWorker::setEncryptExecutor(
+    std::shared_ptr<folly::Executor> executor,
+    size_t numHelpers) {
+  encryptExecutor_ = std::move(executor);
+  numEncryptHelpers_ = numHelpers;
+}
+
 void QuicServerWorker::start() {
   CHECK(socket_);
-  if (transportSettings_.pacingEnabled && !pacingTimer_) {
+  if (transportSettings_->pacingEnabled && !pacingTimer_) {
     pacingTimer_ = TimerHighRes::newTimer(
-        evb_, transportSettings_.pacingTimerTickInterval);
+        evb_, transportSettings_->pacingTimerTickInterval);
+  }
+  if (transportSettings_->receiveGROEnabled) {
+    groEnabled_ = setSocketGRO(socket_->getNetworkSocket(), true);
+    VLOG_IF(2, !groEnabled_) << "Failed to enable GRO on worker=" << this;
+  }
+  if (transportSettings_->enableECN) {
+    ecnEnabled_ = setSocketECN(
+        socket_->getNetworkSocket(), socket_->address().getFamily(), true);
+    if (!ecnEnabled_) {
+      VLOG(2) << "Failed to enable ECN on worker=" << this;
+      // The transports must not expect their packets to be ECT(0) marked.
+      auto settings = *transportSettings_;
+      settings.enableECN = false;
+      transportSettings_ =
+          std::make_shared<const TransportSettings>(std::move(settings));
+    }
+  }
+  if (transportSettings_->rxTimestampsEnabled) {
+    rxTimestampsEnabled_ =
+        setSocketRxTimestamps(socket_->getNetworkSocket(), true);
+    VLOG_IF(2, !rxTimestampsEnabled_)
+        << "Failed to enable receive timestamps on worker=" << this;
+  }
+  if (transportSettings_->bufferArenaEnabled) {
+    readBufferArena_ = std::make_unique<BufferArena>(
+        getReadBufferSize() + kBufferArenaReadBufferSlack,
+        transportSettings_->bufferArenaMaxBytes);
+    writeBufferArena_ = std::make_unique<BufferArena>(
+        kBufferArenaSendBufferSize, transportSettings_->bufferArenaMaxBytes);
+  }
+  if (transportSettings_->readBufferPoolSize > 0) {
+    readBufferPool_ = std::make_unique<QuicReadBufferPool>(
+        getReadBufferSize(),
+        transportSettings_->readBufferPoolSize,
+        transportSettings_->readBufferCopyThreshold,
+        readBufferArena_.get());
+  }
+  if (transportSettings_->maxRecvBatchSize > 1 || groEnabled_ || ecnEnabled_ ||
+      rxTimestampsEnabled_) {
+    recvmmsgStorage_.resize(transportSettings_->maxRecvBatchSize);
+  }
+  if (transportSettings_->workerWriteBatchEnabled) {
+    sharedPacketBatch_ = std::make_unique<SharedPacketBatch>(
+        evb_, *socket_, transportSettings_->workerWriteBatchSize);
+  }
+  if (transportSettings_->workerWriteSchedulerEnabled) {
+    writeScheduler_ = std::make_unique<QuicWriteScheduler>(
+        evb_, sharedPacketBatch_.get());
+  }
+  if (transportSettings_->pacingEnabled &&
+      transportSettings_->pacingTimerWheelEnabled) {
+    pacingTimerWheel_ = std::make_unique<PacingTimerWheel>(
+        evb_, transportSettings_->pacingTimerWheelSlotInterval);
+    if (sharedPacketBatch_) {
+      pacingTimerWheel_->setBatchCallback(
+          [batch = sharedPacketBatch_.get()] { batch->flush(); });
+    }
+  }
+  if (transportSettings_->loopClockEnabled) {
+    loopClock_ = std::make_unique<LoopClock>(evb_);
+  }
+  if (transportSettings_->congestionStateCacheSize > 0) {
+    congestionStateCache_ = std::make_unique<CongestionStateCache>(
+        transportSettings_->congestionStateCacheSize,
+        transportSettings_->congestionStateCacheTtl);
+  }
+  if (transportSettings_->initialCipherPoolSize > 0) {
+    initialCipherPool_ = std::make_shared<InitialCipherPool>(
+        transportSettings_->initialCipherPoolSize);
+  }
+  if (transportSettings_->workerEgressBandwidth > 0) {
+    bandwidthAllocator_ = std::make_shared<BandwidthAllocator>(
+        transportSettings_->workerEgressBandwidth);
+  }
+  if (transportSettings_->autotuneReceiveWindow) {
+    receiveWindowBudget_ = std::make_unique<ReceiveWindowBudget>(
+        transportSettings_->workerReceiveWindowBudget);
+  }
+  if (transportSettings_->pendingPacketBudgetBytes > 0) {
+    pendingPacketBudget_ = std::make_unique<PendingPacketBudget>(
+        transportSettings_->pendingPacketBudgetBytes);
+  }
+  if (transportSettings_->workerLoadReportInterval.count() > 0) {
+    if (transportSettings_->overloadLoopLatency.count() > 0) {
+      loadReporter_.setSampleCallback(
+          [this] { callback_->onWorkerLoadSampled(workerId_); });
+    }
+    loadReporter_.start(evb_, transportSettings_->workerLoadReportInterval);
   }
   socket_->resumeRead(this);
   VLOG(10) << "Registered read on worker=" << this
@@ -92,61 +221,220 @@ const folly::SocketAddress& QuicServerWorker::getAddress() const {
   return socket_->address();
 }
 
+size_t QuicServerWorker::getReadBufferSize() const noexcept {
+  return groEnabled_
+      ? std::max<size_t>(
+            transportSettings_->maxRecvPacketSize, kDefaultGROReadBufferSize)
+      : transportSettings_->maxRecvPacketSize;
+}
+
+Buf QuicServerWorker::createReadBuffer(size_t size) {
+  return readBufferArena_ ? readBufferArena_->createIOBuf(size)
+                          : folly::IOBuf::create(size);
+}
+
 void QuicServerWorker::getReadBuffer(void** buf, size_t* len) noexcept {
-  readBuffer_ = folly::IOBuf::create(transportSettings_.maxRecvPacketSize);
+  if (readBufferPool_) {
+    // A pooled buffer that was not consumed by the previous read is reused.
+    if (!pooledReadBuffer_) {
+      pooledReadBuffer_ = readBufferPool_->acquire();
+    }
+    *buf = pooledReadBuffer_.get();
+    *len = readBufferPool_->bufferSize();
+    return;
+  }
+  readBuffer_ = createReadBuffer(transportSettings_->maxRecvPacketSize);
   *buf = readBuffer_->writableData();
-  *len = transportSettings_.maxRecvPacketSize;
+  *len = transportSettings_->maxRecvPacketSize;
 }
 
 void QuicServerWorker::onDataAvailable(
     const folly::SocketAddress& client,
     size_t len,
     bool truncated) noexcept {
-  // TODO: we can get better receive time accuracy than this, with
-  // SO_TIMESTAMP or SIOCGSTAMP.
-  auto packetReceiveTime = Clock::now();
+  // Reads only get the kernel receive time with recvmmsg, see
+  // shouldOnlyNotify.
+  auto packetReceiveTime =
+      loopClock_ ? loopClock_->preciseNow() : Clock::now();
   VLOG(10) << "Worker=" << this
            << " Received data on thread=" << folly::getCurrentThreadID()
            << " processId=" << (int)processId_;
-  // Move readBuffer_ first so that we can get rid
-  // of it immediately so that if we return early,
-  // we've flushed it.
-  Buf data = std::move(readBuffer_);
-  if (truncated) {
-    // This is an error, drop the packet.
-    return;
+  Buf data;
+  if (readBufferPool_) {
+    if (truncated) {
+      // This is an error, drop the packet. The pooled buffer is kept for the
+      // next read.
+      return;
+    }
+    data = readBufferPool_->toIOBuf(pooledReadBuffer_, len);
+  } else {
+    // Move readBuffer_ first so that we can get rid
+    // of it immediately so that if we return early,
+    // we've flushed it.
+    data = std::move(readBuffer_);
+    if (truncated) {
+      // This is an error, drop the packet.
+      return;
+    }
+    data->append(len);
   }
-  data->append(len);
   QUIC_STATS(infoCallback_, onPacketReceived);
   QUIC_STATS(infoCallback_, onRead, len);
   handleNetworkData(client, std::move(data), packetReceiveTime);
 }
 
+void QuicServerWorker::onDatagram(
+    const folly::SocketAddress& client,
+    std::unique_ptr<folly::IOBuf> data) noexcept {
+  auto packetReceiveTime =
+      loopClock_ ? loopClock_->preciseNow() : Clock::now();
+  QUIC_STATS(infoCallback_, onPacketReceived);
+  QUIC_STATS(infoCallback_, onRead, data->length());
+  handleNetworkData(client, std::move(data), packetReceiveTime);
+}
+
+bool QuicServerWorker::shouldOnlyNotify() {
+#if FOLLY_HAVE_RECVMMSG
+  return transportSettings_->maxRecvBatchSize > 1 || groEnabled_ ||
+      ecnEnabled_ || rxTimestampsEnabled_;
+#else
+  return false;
+#endif
+}
+
+void QuicServerWorker::onNotifyDataAvailable(
+    folly::AsyncUDPSocket& sock) noexcept {
+  recvmmsgStorage_.resize(transportSettings_->maxRecvBatchSize);
+  recvmmsgBatch(
+      sock.getNetworkSocket().toFd(), transportSettings_->maxRecvBatchSize);
+}
+
+void QuicServerWorker::RecvmmsgStorage::resize(size_t numPackets) {
+  if (msgs.size() != numPackets) {
+    msgs.resize(numPackets);
+    impl.resize(numPackets);
+  }
+}
+
+void QuicServerWorker::recvmmsgBatch(int fd, size_t numPackets) noexcept {
+#if FOLLY_HAVE_RECVMMSG
+  const size_t readBufferSize = getReadBufferSize();
+  auto& msgs = recvmmsgStorage_.msgs;
+  for (size_t i = 0; i < numPackets; ++i) {
+    auto& impl = recvmmsgStorage_.impl[i];
+    if (readBufferPool_) {
+      if (!impl.pooledBuffer) {
+        impl.pooledBuffer = readBufferPool_->acquire();
+      }
+      impl.iovec.iov_base = impl.pooledBuffer.get();
+    } else {
+      if (!impl.readBuffer) {
+        impl.readBuffer = createReadBuffer(readBufferSize);
+      }
+      impl.iovec.iov_base = impl.readBuffer->writableData();
+    }
+    impl.iovec.iov_len = readBufferSize;
+    auto& msg = msgs[i].msg_hdr;
+    msg.msg_name = reinterpret_cast<void*>(&impl.addr);
+    msg.msg_namelen = sizeof(impl.addr);
+    msg.msg_iov = &impl.iovec;
+    msg.msg_iovlen = 1;
+    if (groEnabled_ || ecnEnabled_ || rxTimestampsEnabled_) {
+      msg.msg_control = impl.control;
+      msg.msg_controllen = sizeof(impl.control);
+    } else {
+      msg.msg_control = nullptr;
+      msg.msg_controllen = 0;
+    }
+    msg.msg_flags = 0;
+  }
+
+  int numMsgsRecvd =
+      ::recvmmsg(fd, msgs.data(), numPackets, MSG_DONTWAIT, nullptr);
+  if (numMsgsRecvd <= 0) {
+    if (numMsgsRecvd < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      onReadError(folly::AsyncSocketException(
+          folly::AsyncSocketException::INTERNAL_ERROR,
+          "recvmmsg() failed",
+          errno));
+    }
+    return;
+  }
+  // All the datagrams of a batch share one receive time.
+  auto packetReceiveTime =
+      loopClock_ ? loopClock_->preciseNow() : Clock::now();
+  auto systemReceiveTime = rxTimestampsEnabled_
+      ? std::chrono::system_clock::now()
+      : std::chrono::system_clock::time_point();
+  VLOG(10) << "Worker=" << this << " Received " << numMsgsRecvd
+           << " packets on thread=" << folly::getCurrentThreadID()
+           << " processId=" << (int)processId_;
+  for (int i = 0; i < numMsgsRecvd; ++i) {
+    auto& impl = recvmmsgStorage_.impl[i];
+    const auto& msg = msgs[i];
+    if (msg.msg_hdr.msg_flags & MSG_TRUNC) {
+      // This is an error, drop the packet. The read buffer is reused.
+      continue;
+    }
+    Buf data;
+    if (readBufferPool_) {
+      data = readBufferPool_->toIOBuf(impl.pooledBuffer, msg.msg_len);
+    } else {
+      data = std::move(impl.readBuffer);
+      data->append(msg.msg_len);
+    }
+    folly::SocketAddress client;
+    client.setFromSockaddr(
+        reinterpret_cast<sockaddr*>(&impl.addr), msg.msg_hdr.msg_namelen);
+    size_t segmentSize = groEnabled_ ? getGROSegmentSize(msg.msg_hdr) : 0;
+    // GRO only coalesces datagrams with the same TOS.
+    auto ecn =
+        ecnEnabled_ ? getECNCodepoint(msg.msg_hdr) : ECNCodepoint::NotECT;
+    auto receiveTime = rxTimestampsEnabled_
+        ? getRxTimestamp(msg.msg_hdr, packetReceiveTime, systemReceiveTime)
+        : packetReceiveTime;
+    if (segmentSize == 0) {
+      QUIC_STATS(infoCallback_, onPacketReceived);
+      QUIC_STATS(infoCallback_, onRead, msg.msg_len);
+      handleNetworkData(client, std::move(data), receiveTime, ecn);
+      continue;
+    }
+    groPackets_.clear();
+    splitGROBuffer(std::move(data), segmentSize, groPackets_);
+    for (auto& packet : groPackets_) {
+      QUIC_STATS(infoCallback_, onPacketReceived);
+      QUIC_STATS(infoCallback_, onRead, packet->length());
+      handleNetworkData(client, std::move(packet), receiveTime, ecn);
+    }
+  }
+#else
+  (void)fd;
+  (void)numPackets;
+#endif
+}
+
 void QuicServerWorker::handleNetworkData(
     const folly::SocketAddress& client,
     Buf data,
-    const TimePoint& packetReceiveTime) noexcept {
+    const TimePoint& packetReceiveTime,
+    ECNCodepoint ecn) noexcept {
   try {
     if (shutdown_) {
       VLOG(4) << "Packet received after shutdown, dropping";
-      QUIC_STATS(
-          infoCallback_, onPacketDropped, PacketDropReason::SERVER_SHUTDOWN);
+      onPacketDropped(PacketDropReason::SERVER_SHUTDOWN, client);
       return;
     }
 
     if (!callback_) {
       VLOG(0) << "Worker callback is null.  Dropping packet.";
-      QUIC_STATS(
-          infoCallback_,
-          onPacketDropped,
-          PacketDropReason::WORKER_NOT_INITIALIZED);
+      onPacketDropped(PacketDropReason::WORKER_NOT_INITIALIZED, client);
       return;
     }
+    loadReporter_.onBytesReceived(data->computeChainDataLength());
     folly::io::Cursor cursor(data.get());
     if (!cursor.canAdvance(sizeof(uint8_t))) {
       VLOG(4) << "Dropping packet too small";
-      QUIC_STATS(
-          infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
+      onPacketDropped(PacketDropReason::INVALID_PACKET, client);
       return;
     }
     uint8_t initialByte = cursor.readBE<uint8_t>();
@@ -167,7 +455,7 @@ void QuicServerWorker::handleNetworkData(
       return forwardNetworkData(
           client,
           std::move(routingData),
-          NetworkData(std::move(data), packetReceiveTime));
+          NetworkData(std::move(data), packetReceiveTime, ecn));
     }
 
     folly::Expected<ParsedLongHeaderInvariant, TransportErrorCode>
@@ -181,16 +469,19 @@ void QuicServerWorker::handleNetworkData(
     bool isInitial = longHeaderType == LongHeader::Types::Initial;
     bool isUsingClientConnId =
         isInitial || longHeaderType == LongHeader::Types::ZeroRtt;
+    if (isInitial && initialPacketFilter_ &&
+        !initialPacketFilter_->allowInitial(
+            client.getIPAddress(), packetReceiveTime)) {
+      VLOG(4) << "Dropping rate limited initial from client=" << client;
+      onPacketDropped(PacketDropReason::INITIAL_RATE_LIMITED, client);
+      return;
+    }
 
-    folly::Optional<std::pair<VersionNegotiationPacket, Buf>>
-        versionNegotiationPacket;
-    if (rejectNewConnections_ && isInitial) {
-      VersionNegotiationPacketBuilder builder(
-          parsedLongHeader->invariant.dstConnId,
-          parsedLongHeader->invariant.srcConnId,
-          std::vector<QuicVersion>{QuicVersion::MVFST_INVALID});
-      versionNegotiationPacket =
-          folly::make_optional(std::move(builder).buildPacket());
+    const CachedVersionNegotiationPacket* versionNegotiationPacket = nullptr;
+    if ((rejectNewConnections_ ||
+         overloadLevel_ >= OverloadLevel::REJECT_NEW_CONNECTIONS) &&
+        isInitial) {
+      versionNegotiationPacket = &rejectionPacket_;
     }
     if (!versionNegotiationPacket) {
       bool negotiationNeeded =
@@ -200,34 +491,40 @@ void QuicServerWorker::handleNetworkData(
               parsedLongHeader->invariant.version) == supportedVersions_.end();
       if (negotiationNeeded && !isInitial) {
         VLOG(3) << "Dropping non-initial packet due to invalid version";
-        QUIC_STATS(
-            infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
+        onPacketDropped(PacketDropReason::INVALID_PACKET, client);
         return;
       }
       if (negotiationNeeded) {
-        VersionNegotiationPacketBuilder builder(
-            parsedLongHeader->invariant.dstConnId,
-            parsedLongHeader->invariant.srcConnId,
-            supportedVersions_);
-        versionNegotiationPacket =
-            folly::make_optional(std::move(builder).buildPacket());
+        versionNegotiationPacket = versionNegotiationPacket_.get_pointer();
       }
     }
     if (versionNegotiationPacket) {
+      if (!allowStatelessResponse(packetReceiveTime)) {
+        VLOG(4) << "Dropping packet over the version negotiation rate, client="
+                << client;
+        onPacketDropped(
+            PacketDropReason::STATELESS_RESPONSE_RATE_LIMITED, client);
+        return;
+      }
       VLOG(4) << "Version negotiation sent to client=" << client;
-      auto len = versionNegotiationPacket->second->computeChainDataLength();
-      QUIC_STATS(infoCallback_, onWrite, len);
+      if (traceLogger_) {
+        traceLogger_->onVersionNegotiation(
+            client, parsedLongHeader->invariant.version);
+      }
+      auto packet = versionNegotiationPacket->build(
+          parsedLongHeader->invariant.dstConnId,
+          parsedLongHeader->invariant.srcConnId);
+      QUIC_STATS(infoCallback_, onWrite, packet->computeChainDataLength());
       QUIC_STATS(infoCallback_, onPacketProcessed);
       QUIC_STATS(infoCallback_, onPacketSent);
-      socket_->write(client, std::move(versionNegotiationPacket->second));
+      socket_->write(client, std::move(packet));
       return;
     }
 
     if (parsedLongHeader->invariant.dstConnId.size() < kMinConnectionIdSize) {
       // drop packet if connId is present but is not valid.
       VLOG(3) << "Dropping packet due to invalid connectionId";
-      QUIC_STATS(
-          infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
+      onPacketDropped(PacketDropReason::INVALID_PACKET, client);
       return;
     }
     RoutingData routingData(
@@ -239,10 +536,10 @@ void QuicServerWorker::handleNetworkData(
     return forwardNetworkData(
         client,
         std::move(routingData),
-        NetworkData(std::move(data), packetReceiveTime));
+        NetworkData(std::move(data), packetReceiveTime, ecn));
   } catch (const std::exception& ex) {
     // Drop the packet.
-    QUIC_STATS(infoCallback_, onPacketDropped, PacketDropReason::PARSE_ERROR);
+    onPacketDropped(PacketDropReason::PARSE_ERROR, client);
     VLOG(6) << "Failed to parse packet header " << ex.what();
   }
 }
@@ -255,8 +552,7 @@ void QuicServerWorker::tryHandlingAsHealthCheck(
   // check.
   if (!healthCheckToken_) {
     VLOG(4) << "Dropping packet, cannot parse header client=" << client;
-    QUIC_STATS(
-        infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
+    onPacketDropped(PacketDropReason::INVALID_PACKET, client);
     return;
   }
 
@@ -286,15 +582,24 @@ void QuicServerWorker::forwardNetworkData(
       takeoverPktHandler_.forwardPacketToAnotherServer(
           client, std::move(networkData.data), networkData.receiveTimePoint);
       QUIC_STATS(infoCallback_, onPacketForwarded);
+      if (traceLogger_) {
+        traceLogger_->onPacketForwarded(client, &routingData.destinationConnId);
+      }
       return;
     } else {
       VLOG(3) << "Dropping packet due to unknown connectionId version connId="
               << routingData.destinationConnId.hex();
-      QUIC_STATS(
-          infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
+      onPacketDropped(
+          PacketDropReason::INVALID_PACKET,
+          client,
+          &routingData.destinationConnId);
     }
     return;
   }
+  if (!routingData.isUsingClientConnId) {
+    routingData.connIdParams =
+        connIdAlgo_->parseConnectionId(routingData.destinationConnId);
+  }
   callback_->routeDataToWorker(
       client, std::move(routingData), std::move(networkData));
 }
@@ -316,6 +621,33 @@ void QuicServerWorker::dispatchPacketData(
     transport = cit->second;
     VLOG(10) << "Found existing connection for CID="
              << routingData.destinationConnId.hex() << " " << *transport;
+  } else if (
+      !handshakeRoutes_.empty() &&
+      handshakeRoutes_.count(routingData.destinationConnId)) {
+    // The connection is still being established on a handshake worker.
+    routingData.redirected = true;
+    auto workerId = handshakeRoutes_.at(routingData.destinationConnId);
+    if (traceLogger_) {
+      traceLogger_->onPacketRouted(
+          client, routingData.destinationConnId, workerId);
+    }
+    return callback_->routeDataToWorkerId(
+        workerId,
+        client,
+        std::move(routingData),
+        std::move(networkData));
+  } else if (
+      closedConnections_ &&
+      closedConnections_->onPacket(
+          routingData.destinationConnId,
+          routingData.sourceConnId
+              ? folly::make_optional(
+                    std::make_pair(client, *routingData.sourceConnId))
+              : folly::none,
+          *socket_)) {
+    VLOG(10) << "Packet for closed connection CID="
+             << routingData.destinationConnId.hex();
+    return;
   } else if (routingData.headerForm != HeaderForm::Long) {
     // Drop the packet if the header form is not long
     VLOG(3) << "Dropping non-long header packet with no connid match CID="
@@ -335,6 +667,19 @@ void QuicServerWorker::dispatchPacketData(
     // can only route by address.
     auto source = std::make_pair(client, *routingData.sourceConnId);
     auto sit = sourceAddressMap_.find(source);
+    auto rit = sit == sourceAddressMap_.end()
+        ? redirectedConnections_.find(source)
+        : redirectedConnections_.end();
+    if (rit != redirectedConnections_.end()) {
+      // The connection was handed to another worker, its packets follow.
+      routingData.redirected = true;
+      if (traceLogger_) {
+        traceLogger_->onPacketRouted(
+            client, routingData.destinationConnId, rit->second);
+      }
+      return callback_->routeDataToWorkerId(
+          rit->second, client, std::move(routingData), std::move(networkData));
+    }
     if (sit == sourceAddressMap_.end()) {
       // TODO for O-RTT types we need to create new connections to handle
       // the case, where the new server gets packets sent to the old one due
@@ -356,41 +701,92 @@ void QuicServerWorker::dispatchPacketData(
             kMinInitialPacketSize) {
           // Don't even attempt to forward the packet, just drop it.
           VLOG(3) << "Dropping small initial packet from client=" << client;
-          QUIC_STATS(
-              infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
+          onPacketDropped(
+              PacketDropReason::INVALID_PACKET,
+              client,
+              &routingData.destinationConnId);
+          return;
+        }
+        if ((transportSettings_->newConnectionLoadBalancing ||
+             transportSettings_->numHandshakeWorkers > 0) &&
+            !routingData.redirected) {
+          auto workerId = callback_->pickWorkerForNewConnection(workerId_);
+          if (workerId && *workerId != workerId_) {
+            VLOG(4) << "Handing new connection from client=" << client
+                    << " to workerId=" << (uint32_t)*workerId
+                    << ", workerId=" << (uint32_t)workerId_;
+            redirectedConnections_.set(source, *workerId);
+            routingData.redirected = true;
+            if (traceLogger_) {
+              traceLogger_->onPacketRouted(
+                  client, routingData.destinationConnId, *workerId);
+            }
+            return callback_->routeDataToWorkerId(
+                *workerId,
+                client,
+                std::move(routingData),
+                std::move(networkData));
+          }
+        }
+        if (retryTokenGenerator_ &&
+            !validateNewConnection(client, routingData, networkData)) {
+          return;
+        }
+        if (initialPacketFilter_ &&
+            !initialPacketFilter_->admitNewConnection(
+                networkData.receiveTimePoint)) {
+          VLOG(3) << "Dropping initial over the new connection rate, client="
+                  << client;
+          onPacketDropped(
+              PacketDropReason::NEW_CONNECTION_RATE_LIMITED,
+              client,
+              &routingData.destinationConnId);
           return;
         }
-        // create 'accepting' transport
-        auto sock = makeSocket(getEventBase());
-        auto trans = transportFactory_->make(
-            getEventBase(), std::move(sock), client, ctx_);
-        trans->setPacingTimer(pacingTimer_);
-        trans->setRoutingCallback(this);
-        trans->setSupportedVersions(supportedVersions_);
-        trans->setOriginalPeerAddress(client);
-        trans->setCongestionControllerFactory(ccFactory_);
+        folly::Optional<uint8_t> dataWorkerId;
+        if (transportSettings_->numHandshakeWorkers > 0) {
+          dataWorkerId = callback_->pickDataWorker(workerId_);
+        }
+        // Settings are picked before the transport creates its congestion
+        // controller and pacer from them. The worker's settings are only
+        // copied once for the connection, unless they are overridden.
+        folly::Optional<TransportSettings> settings;
+        if (transportSettings_->transportProfilesEnabled &&
+            congestionStateCache_) {
+          auto profile = selectTransportProfile(congestionStateCache_->get(
+              client.getIPAddress(), networkData.receiveTimePoint));
+          VLOG(4) << "Transport profile=" << toString(profile)
+                  << " for client=" << client;
+          settings = *transportSettings_;
+          applyTransportProfile(*settings, profile);
+        }
         if (transportSettingsOverrideFn_) {
           folly::Optional<TransportSettings> overridenTransportSettings =
               transportSettingsOverrideFn_(
-                  transportSettings_, client.getIPAddress());
+                  settings ? *settings : *transportSettings_,
+                  client.getIPAddress());
           if (overridenTransportSettings) {
-            trans->setTransportSettings(*overridenTransportSettings);
-          } else {
-            trans->setTransportSettings(transportSettings_);
+            settings = std::move(overridenTransportSettings);
+          }
+        }
+        if (dataWorkerId) {
+          // The state is exported to the data worker once established.
+          if (!settings) {
+            settings = *transportSettings_;
           }
-        } else {
-          trans->setTransportSettings(transportSettings_);
+          settings->connectionStateExportEnabled = true;
         }
-        trans->setConnectionIdAlgo(connIdAlgo_.get());
-        // parameters to create server chosen connection id
+        // parameters to create server chosen connection id, which route the
+        // connection to its data worker from the start.
         ServerConnectionIdParams serverConnIdParams(
-            hostId_, static_cast<uint8_t>(processId_), workerId_);
+            hostId_,
+            static_cast<uint8_t>(processId_),
+            dataWorkerId ? *dataWorkerId : workerId_);
         serverConnIdParams.clientConnId = *routingData.sourceConnId;
-        trans->setServerConnectionIdParams(std::move(serverConnIdParams));
-        if (infoCallback_) {
-          trans->setTransportInfoCallback(infoCallback_.get());
-        }
+        auto trans = makeTransport(
+            client, std::move(settings), std::move(serverConnIdParams));
         trans->accept();
+        loadReporter_.onConnectionAdded();
         auto result = sourceAddressMap_.emplace(std::make_pair(
             std::make_pair(client, *routingData.sourceConnId), trans));
         if (!result.second) {
@@ -409,20 +805,33 @@ void QuicServerWorker::dispatchPacketData(
   if (LIKELY(!dropPacket)) {
     DCHECK(transport->getEventBase()->isInEventBaseThread());
     transport->onNetworkData(client, std::move(networkData));
+    maybeHandOffConnection(transport);
+    return;
+  }
+  if (routingData.redirected && routingData.headerForm == HeaderForm::Short) {
+    // Another worker routed it here, the connection was just handed off or
+    // closed. That worker sends the resets for its connection ids.
+    VLOG(4) << "Dropping redirected packet with no connid match CID="
+            << routingData.destinationConnId.hex();
+    onPacketDropped(
+        PacketDropReason::CONNECTION_NOT_FOUND,
+        client,
+        &routingData.destinationConnId);
     return;
   }
-  ServerConnectionIdParams connIdParam =
-      connIdAlgo_->parseConnectionId(routingData.destinationConnId);
+  ServerConnectionIdParams connIdParam = routingData.connIdParams
+      ? *routingData.connIdParams
+      : connIdAlgo_->parseConnectionId(routingData.destinationConnId);
   if (UNLIKELY(connIdParam.hostId != hostId_)) {
     VLOG(3) << "Dropping packet routed to wrong host, CID="
             << routingData.destinationConnId.hex()
             << ", workerId=" << (uint32_t)workerId_
             << ", hostId=" << (uint32_t)hostId_
             << ", received hostId=" << (uint32_t)connIdParam.hostId;
-    QUIC_STATS(
-        infoCallback_,
-        onPacketDropped,
-        PacketDropReason::ROUTING_ERROR_WRONG_HOST);
+    onPacketDropped(
+        PacketDropReason::ROUTING_ERROR_WRONG_HOST,
+        client,
+        &routingData.destinationConnId);
     return sendResetPacket(
         routingData.headerForm,
         client,
@@ -431,8 +840,10 @@ void QuicServerWorker::dispatchPacketData(
   }
 
   if (!packetForwardingEnabled_) {
-    QUIC_STATS(
-        infoCallback_, onPacketDropped, PacketDropReason::CONNECTION_NOT_FOUND);
+    onPacketDropped(
+        PacketDropReason::CONNECTION_NOT_FOUND,
+        client,
+        &routingData.destinationConnId);
     return sendResetPacket(
         routingData.headerForm,
         client,
@@ -443,8 +854,10 @@ void QuicServerWorker::dispatchPacketData(
   // There's no existing connection for the packet's CID or the client's
   // addr, and doesn't belong to the old server. Send a Reset.
   if (connIdParam.processId == static_cast<uint8_t>(processId_)) {
-    QUIC_STATS(
-        infoCallback_, onPacketDropped, PacketDropReason::CONNECTION_NOT_FOUND);
+    onPacketDropped(
+        PacketDropReason::CONNECTION_NOT_FOUND,
+        client,
+        &routingData.destinationConnId);
     return sendResetPacket(
         routingData.headerForm,
         client,
@@ -461,6 +874,153 @@ void QuicServerWorker::dispatchPacketData(
   takeoverPktHandler_.forwardPacketToAnotherServer(
       client, std::move(networkData.data), networkData.receiveTimePoint);
   QUIC_STATS(infoCallback_, onPacketForwarded);
+  if (traceLogger_) {
+    traceLogger_->onPacketForwarded(client, &routingData.destinationConnId);
+  }
+}
+
+QuicServerTransport::Ptr QuicServerWorker::makeTransport(
+    const folly::SocketAddress& client,
+    folly::Optional<TransportSettings> settings,
+    ServerConnectionIdParams serverConnIdParams) {
+  // The objects of the transport are built from the blocks of the closed
+  // ones, up to the current limit.
+  BlockRecycler::setRecycledBlocksPerSize(
+      transportSettings_->recycledConnectionBlocks);
+  // create 'accepting' transport
+  auto sock = makeSocket(getEventBase());
+  auto trans =
+      transportFactory_->make(getEventBase(), std::move(sock), client, ctx_);
+  trans->setPacingTimer(pacingTimer_);
+  trans->setRoutingCallback(this);
+  trans->setSupportedVersions(supportedVersions_);
+  trans->setOriginalPeerAddress(client);
+  trans->setCongestionControllerFactory(ccFactory_);
+  if (handshakeExecutor_) {
+    trans->setHandshakeExecutor(handshakeExecutor_);
+  }
+  if (encryptExecutor_) {
+    trans->setEncryptExecutor(encryptExecutor_, numEncryptHelpers_);
+  }
+  if (settings) {
+    trans->setTransportSettings(std::move(*settings));
+  } else {
+    trans->setTransportSettings(*transportSettings_);
+  }
+  trans->setConnectionIdAlgo(connIdAlgo_.get());
+  trans->setServerConnectionIdParams(std::move(serverConnIdParams));
+  if (infoCallback_) {
+    trans->setTransportInfoCallback(infoCallback_.get());
+  }
+  if (packetCaptureCallback_) {
+    trans->setPacketCaptureCallback(packetCaptureCallback_);
+  }
+  if (sharedPacketBatch_) {
+    trans->setSharedPacketBatch(sharedPacketBatch_.get());
+  }
+  if (writeScheduler_) {
+    trans->setWriteScheduler(writeScheduler_.get());
+  }
+  if (pacingTimerWheel_) {
+    trans->setPacingTimerWheel(pacingTimerWheel_.get());
+  }
+  if (loopClock_) {
+    trans->setLoopClock(loopClock_.get());
+  }
+  if (writeBufferArena_) {
+    trans->setBufferArena(writeBufferArena_.get());
+  }
+  if (congestionStateCache_) {
+    trans->setCongestionStateCache(congestionStateCache_.get());
+  }
+  if (receiveWindowBudget_) {
+    trans->setReceiveWindowBudget(receiveWindowBudget_.get());
+  }
+  if (pendingPacketBudget_) {
+    trans->setPendingPacketBudget(pendingPacketBudget_.get());
+  }
+  if (initialCipherPool_) {
+    trans->setInitialCipherPool(initialCipherPool_);
+  }
+  if (bandwidthAllocator_) {
+    trans->setBandwidthAllocator(bandwidthAllocator_);
+  }
+  trans->setTransportParametersCache(transportParametersCache_);
+  if (overloadLevel_ != OverloadLevel::NONE) {
+    trans->setOverloadState(getOverloadState());
+  }
+  return trans;
+}
+
+void QuicServerWorker::maybeHandOffConnection(
+    const QuicServerTransport::Ptr& transport) {
+  if (transportSettings_->numHandshakeWorkers == 0) {
+    return;
+  }
+  const auto& conn =
+      static_cast<const QuicServerConnectionState&>(*transport->getState());
+  if (!conn.serverConnIdParams || !conn.serverConnectionId ||
+      conn.serverConnIdParams->workerId == workerId_ || !transport->good() ||
+      !conn.serverHandshakeLayer->isHandshakeDone() ||
+      conn.streamManager->streamCount() > 0) {
+    return;
+  }
+  // Only succeeds once nothing is in flight or buffered any more.
+  auto state = serializeConnectionState(conn);
+  if (!state) {
+    return;
+  }
+  auto dataWorkerId = conn.serverConnIdParams->workerId;
+  VLOG(4) << "Handing established connection " << *transport
+          << " to workerId=" << (uint32_t)dataWorkerId
+          << ", workerId=" << (uint32_t)workerId_;
+  ConnectionHandOff handOff;
+  handOff.peer = conn.peerAddress;
+  handOff.state = std::move(*state);
+  handOff.connectionIds = conn.selfConnectionIds;
+  // Queued before the transport unbinds, so that the data worker adopts the
+  // connection before it drops the route to this worker.
+  callback_->handOffConnection(dataWorkerId, std::move(handOff));
+  transport->closeForHandOff();
+}
+
+void QuicServerWorker::setHandshakeRoute(
+    const ConnectionId& connId,
+    folly::Optional<uint8_t> handshakeWorkerId) {
+  if (handshakeWorkerId) {
+    handshakeRoutes_[connId] = *handshakeWorkerId;
+  } else {
+    handshakeRoutes_.erase(connId);
+  }
+}
+
+bool QuicServerWorker::adoptConnection(ConnectionHandOff&& handOff) {
+  if (!handOff.state || handOff.connectionIds.empty()) {
+    return false;
+  }
+  for (const auto& selfConnId : handOff.connectionIds) {
+    handshakeRoutes_.erase(selfConnId.connId);
+  }
+  ServerConnectionIdParams serverConnIdParams(
+      hostId_, static_cast<uint8_t>(processId_), workerId_);
+  auto trans =
+      makeTransport(handOff.peer, folly::none, std::move(serverConnIdParams));
+  if (!trans->adoptConnectionState(*handOff.state, handOff.connectionIds)) {
+    VLOG(3) << "Dropping connection handed off from client=" << handOff.peer;
+    trans->setRoutingCallback(nullptr);
+    trans->closeNow(folly::none);
+    return false;
+  }
+  for (const auto& selfConnId : handOff.connectionIds) {
+    if (!connectionIdMap_.emplace(selfConnId.connId, trans).second) {
+      LOG(ERROR) << "connectionIdMap_ already has CID=" << selfConnId.connId;
+    }
+  }
+  loadReporter_.onConnectionAdded();
+  QUIC_STATS(infoCallback_, onNewConnection);
+  VLOG(4) << "Adopted connection " << *trans
+          << ", workerId=" << (uint32_t)workerId_;
+  return true;
 }
 
 void QuicServerWorker::sendResetPacket(
@@ -476,18 +1036,135 @@ void QuicServerWorker::sendResetPacket(
   uint16_t maxResetPacketSize = std::min<uint16_t>(
       std::max<uint16_t>(kMinStatelessPacketSize, packetSize),
       kDefaultUDPSendPacketLen);
-  CHECK(transportSettings_.statelessResetTokenSecret.hasValue());
-  StatelessResetGenerator generator(
-      *transportSettings_.statelessResetTokenSecret,
-      getAddress().getFullyQualified());
-  StatelessResetToken token = generator.generateToken(connId);
-  StatelessResetPacketBuilder builder(maxResetPacketSize, token);
+  if (!allowStatelessResponse(networkData.receiveTimePoint)) {
+    // The packet was already counted as dropped.
+    VLOG(4) << "Not sending a reset over the rate, client=" << client;
+    return;
+  }
+  auto cachedToken = statelessResetTokens_.find(connId);
+  if (cachedToken == statelessResetTokens_.end()) {
+    if (!statelessResetGenerator_) {
+      CHECK(transportSettings_->statelessResetTokenSecret.hasValue());
+      statelessResetGenerator_ = std::make_unique<StatelessResetGenerator>(
+          *transportSettings_->statelessResetTokenSecret,
+          getAddress().getFullyQualified());
+    }
+    statelessResetTokens_.set(
+        connId, statelessResetGenerator_->generateToken(connId));
+    cachedToken = statelessResetTokens_.find(connId);
+  }
+  StatelessResetPacketBuilder builder(maxResetPacketSize, cachedToken->second);
   auto resetData = std::move(builder).buildPacket();
   socket_->write(client, std::move(resetData));
   QUIC_STATS(infoCallback_, onWrite, resetData->computeChainDataLength());
   QUIC_STATS(infoCallback_, onPacketSent);
 }
 
+bool QuicServerWorker::allowStatelessResponse(TimePoint now) {
+  return !statelessResponseLimiter_ || statelessResponseLimiter_->consume(now);
+}
+
+bool QuicServerWorker::validateNewConnection(
+    const folly::SocketAddress& client,
+    const RoutingData& routingData,
+    const NetworkData& networkData) {
+  folly::io::Cursor cursor(networkData.data.get());
+  uint8_t initialByte = cursor.readBE<uint8_t>();
+  auto parsedHeader = parseLongHeader(initialByte, cursor);
+  if (!parsedHeader || !parsedHeader->parsedLongHeader) {
+    VLOG(3) << "Dropping unparsable initial from client=" << client;
+    onPacketDropped(
+        PacketDropReason::PARSE_ERROR, client, &routingData.destinationConnId);
+    return false;
+  }
+  const auto& header = parsedHeader->parsedLongHeader->header;
+  if (header.hasToken()) {
+    auto originalDstConnId = retryTokenGenerator_->decryptToken(
+        header.getToken()->clone(),
+        client.getIPAddress(),
+        std::chrono::system_clock::now());
+    if (!originalDstConnId) {
+      VLOG(3) << "Dropping initial with invalid token from client=" << client;
+      onPacketDropped(
+          PacketDropReason::INVALID_RETRY_TOKEN,
+          client,
+          &routingData.destinationConnId);
+      return false;
+    }
+    VLOG(4) << "Validated client=" << client
+            << " original CID=" << originalDstConnId->hex()
+            << " CID=" << routingData.destinationConnId.hex();
+    return true;
+  }
+  if (!shouldSendRetry(client, networkData.receiveTimePoint)) {
+    return true;
+  }
+  sendRetryPacket(client, header);
+  return false;
+}
+
+bool QuicServerWorker::shouldSendRetry(
+    const folly::SocketAddress& client,
+    TimePoint now) {
+  if (overloadLevel_ >= OverloadLevel::RETRY) {
+    return true;
+  }
+  auto pendingThreshold = transportSettings_->retryPendingHandshakesThreshold;
+  auto sourceThreshold =
+      transportSettings_->retryNewConnectionsPerSourceThreshold;
+  if (pendingThreshold == 0 && sourceThreshold == 0) {
+    return true;
+  }
+  if (pendingThreshold > 0 && sourceAddressMap_.size() >= pendingThreshold) {
+    return true;
+  }
+  if (sourceThreshold == 0) {
+    return false;
+  }
+  auto it = sourceRates_.find(client.getIPAddress());
+  if (it == sourceRates_.end() ||
+      now - it->second.windowStart > kRetrySourceRateWindow) {
+    SourceRate rate;
+    rate.windowStart = now;
+    rate.newConnections = 1;
+    sourceRates_.set(client.getIPAddress(), rate);
+    return false;
+  }
+  return ++it->second.newConnections > sourceThreshold;
+}
+
+void QuicServerWorker::sendRetryPacket(
+    const folly::SocketAddress& client,
+    const LongHeader& initialHeader) {
+  std::vector<uint8_t> connIdData(kDefaultConnectionIdSize);
+  folly::Random::secureRandom(connIdData.data(), connIdData.size());
+  ConnectionId retrySrcConnId(connIdData);
+  auto token = retryTokenGenerator_->encryptToken(
+      client.getIPAddress(),
+      initialHeader.getDestinationConnId(),
+      std::chrono::system_clock::now());
+  LongHeader retryHeader(
+      LongHeader::Types::Retry,
+      retrySrcConnId,
+      initialHeader.getSourceConnId(),
+      0,
+      initialHeader.getVersion(),
+      std::move(token),
+      initialHeader.getDestinationConnId());
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen, std::move(retryHeader), 0);
+  auto packet = std::move(builder).buildPacket();
+  auto retryData = std::move(packet.header);
+  if (packet.body) {
+    retryData->prependChain(std::move(packet.body));
+  }
+  VLOG(4) << "Retry sent to client=" << client;
+  auto len = retryData->computeChainDataLength();
+  socket_->write(client, std::move(retryData));
+  QUIC_STATS(infoCallback_, onWrite, len);
+  QUIC_STATS(infoCallback_, onPacketSent);
+}
+
 void QuicServerWorker::allowBeingTakenOver(
     std::unique_ptr<folly::AsyncUDPSocket> socket,
     const folly::SocketAddress& address) {
@@ -504,9 +1181,10 @@ void QuicServerWorker::allowBeingTakenOver(
 }
 
 void QuicServerWorker::startPacketForwarding(
-    const folly::SocketAddress& destAddr) {
+    const folly::SocketAddress& destAddr,
+    TakeoverProtocolVersion peerVersion) {
   packetForwardingEnabled_ = true;
-  takeoverPktHandler_.setDestination(destAddr);
+  takeoverPktHandler_.setDestination(destAddr, peerVersion);
 }
 
 void QuicServerWorker::stopPacketForwarding() {
@@ -538,6 +1216,11 @@ TakeoverProtocolVersion QuicServerWorker::getTakeoverProtocolVersion() const
   return takeoverPktHandler_.getTakeoverProtocolVersion();
 }
 
+void QuicServerWorker::setTakeoverProtocolVersion(
+    TakeoverProtocolVersion version) noexcept {
+  takeoverPktHandler_.setTakeoverProtocolVersion(version);
+}
+
 void QuicServerWorker::setProcessId(enum ProcessId id) noexcept {
   processId_ = id;
 }
@@ -572,6 +1255,7 @@ void QuicServerWorker::setTransportFactory(
 void QuicServerWorker::setSupportedVersions(
     const std::vector<QuicVersion>& supportedVersions) {
   supportedVersions_ = supportedVersions;
+  versionNegotiationPacket_.emplace(supportedVersions_);
 }
 
 void QuicServerWorker::setFizzContext(
@@ -581,15 +1265,77 @@ void QuicServerWorker::setFizzContext(
 
 void QuicServerWorker::setTransportSettings(
     TransportSettings transportSettings) {
-  transportSettings_ = transportSettings;
+  setTransportSettings(
+      std::make_shared<const TransportSettings>(std::move(transportSettings)));
+}
+
+void QuicServerWorker::setTransportSettings(
+    TransportSettingsSnapshot transportSettings) {
+  CHECK(transportSettings);
+  transportSettings_ = std::move(transportSettings);
+  if (transportSettings_->retryTokenSecret) {
+    retryTokenGenerator_ = std::make_unique<RetryTokenGenerator>(
+        *transportSettings_->retryTokenSecret,
+        transportSettings_->retryTokenLifetime);
+  } else {
+    retryTokenGenerator_.reset();
+  }
+  if (transportSettings_->initialsPerPrefixRate > 0 ||
+      transportSettings_->newConnectionsRate > 0) {
+    initialPacketFilter_ = std::make_unique<InitialPacketFilter>(
+        transportSettings_->initialsPerPrefixRate,
+        transportSettings_->initialsPerPrefixBurst,
+        transportSettings_->newConnectionsRate,
+        transportSettings_->newConnectionsBurst);
+  } else {
+    initialPacketFilter_.reset();
+  }
+  if (transportSettings_->statelessResponsesRate > 0) {
+    statelessResponseLimiter_.emplace(
+        transportSettings_->statelessResponsesRate,
+        transportSettings_->statelessResponsesBurst,
+        Clock::now());
+  } else {
+    statelessResponseLimiter_.clear();
+  }
+  // The secret may have changed.
+  statelessResetGenerator_.reset();
+  statelessResetTokens_.clear();
 }
 
 void QuicServerWorker::rejectNewConnections(bool rejectNewConnections) {
   rejectNewConnections_ = rejectNewConnections;
 }
 
+void QuicServerWorker::setOverloadLevel(OverloadLevel level) {
+  if (level == overloadLevel_) {
+    return;
+  }
+  VLOG(2) << "Worker=" << this << " overloadLevel="
+          << overloadLevelToString(level);
+  overloadLevel_ = level;
+  auto state = getOverloadState();
+  for (const auto& transport : getTransports()) {
+    transport->setOverloadState(state);
+  }
+}
+
+QuicConnectionStateBase::OverloadState QuicServerWorker::getOverloadState()
+    const {
+  QuicConnectionStateBase::OverloadState state;
+  state.reduceAckFrequency =
+      overloadLevel_ >= OverloadLevel::REDUCE_ACK_FREQUENCY;
+  if (overloadLevel_ >= OverloadLevel::CAP_WRITES) {
+    state.writePacketsLimit = transportSettings_->overloadWritePacketsLimit;
+  }
+  return state;
+}
+
 void QuicServerWorker::enablePartialReliability(bool enabled) {
-  transportSettings_.partialReliabilityEnabled = enabled;
+  auto settings = *transportSettings_;
+  settings.partialReliabilityEnabled = enabled;
+  transportSettings_ =
+      std::make_shared<const TransportSettings>(std::move(settings));
 }
 
 void QuicServerWorker::setHealthCheckToken(
@@ -627,8 +1373,49 @@ void QuicServerWorker::onConnectionIdAvailable(
       connectionIdMap_.emplace(std::make_pair(id, std::move(transport)));
   if (!result.second) {
     LOG(ERROR) << "connectionIdMap_ already has CID=" << id;
-  } else {
-    QUIC_STATS(infoCallback_, onNewConnection);
+    return;
+  }
+  QUIC_STATS(infoCallback_, onNewConnection);
+  if (transportSettings_->numHandshakeWorkers > 0) {
+    // The connection id routes the peer to the data worker the connection is
+    // handed to, which forwards its packets here until then.
+    auto dataWorkerId = connIdAlgo_->parseConnectionId(id).workerId;
+    if (dataWorkerId != workerId_) {
+      callback_->setHandshakeRoute(dataWorkerId, id, workerId_);
+    }
+  }
+}
+
+void QuicServerWorker::onConnectionIdsAvailable(
+    QuicServerTransport::Ptr transport,
+    std::vector<ConnectionId>& ids) noexcept {
+  VLOG(4) << "Adding " << ids.size() << " CIDs into connectionIdMap_ for "
+          << *transport;
+  connectionIdMap_.reserve(connectionIdMap_.size() + ids.size());
+  ids.erase(
+      std::remove_if(
+          ids.begin(),
+          ids.end(),
+          [&](const ConnectionId& id) {
+            if (!connectionIdMap_.emplace(id, transport).second) {
+              LOG(ERROR) << "connectionIdMap_ already has CID=" << id;
+              return true;
+            }
+            return false;
+          }),
+      ids.end());
+}
+
+void QuicServerWorker::onConnectionIdsRetired(
+    QuicServerTransport::Ptr transport,
+    const std::vector<ConnectionId>& ids) noexcept {
+  for (const auto& id : ids) {
+    VLOG(4) << "Removing from connectionIdMap_ for CID=" << id << " "
+            << *transport;
+    auto it = connectionIdMap_.find(id);
+    if (it != connectionIdMap_.end() && it->second == transport) {
+      connectionIdMap_.erase(it);
+    }
   }
 }
 
@@ -652,17 +1439,147 @@ void QuicServerWorker::onConnectionIdBound(
   }
 }
 
+void QuicServerWorker::onConnectionDraining(
+    QuicServerTransport::Ptr transport,
+    std::chrono::milliseconds drainTimeout) noexcept {
+  if (!closedConnections_) {
+    closedConnections_ =
+        std::make_unique<ClosedConnectionTable>(evb_->timer());
+  }
+  const auto& conn = *transport->getState();
+  std::vector<ConnectionId> connIds;
+  for (const auto& selfConnId : conn.selfConnectionIds) {
+    auto it = connectionIdMap_.find(selfConnId.connId);
+    if (it != connectionIdMap_.end() && it->second == transport) {
+      connIds.push_back(selfConnId.connId);
+    }
+  }
+  // Only a connection still routed by address can get long header packets
+  // that don't carry one of its connection ids.
+  folly::Optional<ClosedConnectionTable::SourceIdentity> source;
+  auto sourceIdentity = transport->getSourceIdentity();
+  auto sit = sourceAddressMap_.find(sourceIdentity);
+  if (sit != sourceAddressMap_.end() && sit->second == transport) {
+    source = std::move(sourceIdentity);
+  }
+  VLOG(4) << "Keeping a record of closed connection " << *transport
+          << " for " << drainTimeout.count() << "ms";
+  // A connection closed by its peer doesn't answer it any more.
+  closedConnections_->add(
+      connIds,
+      source,
+      conn.peerAddress,
+      conn.peerConnectionError ? nullptr : transport->getClosePacket(),
+      drainTimeout);
+}
+
 void QuicServerWorker::onConnectionUnbound(
     const QuicServerTransport::SourceIdentity& source,
     folly::Optional<ConnectionId> connectionId) noexcept {
   VLOG(4) << "Removing from sourceAddressMap_ address=" << source.first;
   // TODO: verify we are removing the right transport
   sourceAddressMap_.erase(source);
+  loadReporter_.onConnectionRemoved();
   if (connectionId) {
     VLOG(4) << "Removing from connectionIdMap_ for CID=" << *connectionId
             << ", workerId=" << (uint32_t)workerId_;
     connectionIdMap_.erase(*connectionId);
     QUIC_STATS(infoCallback_, onConnectionClose, folly::none);
+    if (transportSettings_->numHandshakeWorkers > 0) {
+      auto dataWorkerId =
+          connIdAlgo_->parseConnectionId(*connectionId).workerId;
+      if (dataWorkerId != workerId_) {
+        callback_->setHandshakeRoute(dataWorkerId, *connectionId, folly::none);
+      }
+    }
+  }
+}
+
+std::vector<QuicServerTransport::Ptr> QuicServerWorker::getTransports() const {
+  std::vector<QuicServerTransport::Ptr> transports;
+  transports.reserve(connectionIdMap_.size() + sourceAddressMap_.size());
+  for (const auto& it : connectionIdMap_) {
+    transports.push_back(it.second);
+  }
+  for (const auto& it : sourceAddressMap_) {
+    transports.push_back(it.second);
+  }
+  std::sort(transports.begin(), transports.end());
+  transports.erase(
+      std::unique(transports.begin(), transports.end()), transports.end());
+  return transports;
+}
+
+uint64_t QuicServerWorker::getBufferedBytes() const {
+  uint64_t bufferedBytes = 0;
+  for (const auto& transport : getTransports()) {
+    bufferedBytes += getConnectionBufferedBytes(*transport->getState());
+  }
+  return bufferedBytes;
+}
+
+size_t QuicServerWorker::shedConnections(uint64_t maxBufferedBytes) {
+  std::vector<std::pair<uint64_t, QuicServerTransport::Ptr>> connections;
+  uint64_t bufferedBytes = 0;
+  for (auto& transport : getTransports()) {
+    auto connBufferedBytes = getConnectionBufferedBytes(*transport->getState());
+    bufferedBytes += connBufferedBytes;
+    connections.emplace_back(connBufferedBytes, std::move(transport));
+  }
+  std::sort(
+      connections.begin(),
+      connections.end(),
+      [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first; });
+  size_t numShed = 0;
+  for (auto& connection : connections) {
+    if (bufferedBytes <= maxBufferedBytes) {
+      break;
+    }
+    VLOG(2) << "Shedding connection under memory pressure bufferedBytes="
+            << connection.first << " " << *connection.second;
+    bufferedBytes -= connection.first;
+    connection.second->closeNow(std::make_pair(
+        QuicErrorCode(TransportErrorCode::SERVER_BUSY),
+        std::string("shedding under memory pressure")));
+    numShed++;
+  }
+  return numShed;
+}
+
+std::vector<QuicServerWorker::TransportLoopTime>
+QuicServerWorker::getTopTransportsByLoopTime(size_t n) const {
+  std::vector<TransportLoopTime> loopTimes;
+  for (const auto& transport : getTransports()) {
+    const auto& conn = *transport->getState();
+    TransportLoopTime loopTime;
+    loopTime.serverConnectionId = conn.serverConnectionId;
+    loopTime.peerAddress = conn.peerAddress;
+    loopTime.workerId = workerId_;
+    loopTime.callbacks = conn.loopTime.callbacks;
+    loopTime.loopTime = conn.loopTime.estimated;
+    loopTimes.push_back(std::move(loopTime));
+  }
+  auto byLoopTime = [](const auto& lhs, const auto& rhs) {
+    return lhs.loopTime > rhs.loopTime;
+  };
+  if (loopTimes.size() > n) {
+    std::partial_sort(
+        loopTimes.begin(), loopTimes.begin() + n, loopTimes.end(), byLoopTime);
+    loopTimes.resize(n);
+  } else {
+    std::sort(loopTimes.begin(), loopTimes.end(), byLoopTime);
+  }
+  return loopTimes;
+}
+
+WorkerLoad QuicServerWorker::getLoad() const {
+  return loadReporter_.getLoad();
+}
+
+void QuicServerWorker::setReceiveWindowMemoryPressure(
+    bool underMemoryPressure) {
+  if (receiveWindowBudget_) {
+    receiveWindowBudget_->setMemoryPressure(underMemoryPressure);
   }
 }
 
@@ -681,23 +1598,65 @@ void QuicServerWorker::shutdownAllConnections(LocalErrorCode error) {
     takeoverCB_->pause();
   }
   callback_ = nullptr;
+  // Write out whatever the connections queued before they switch to the
+  // close batch.
+  sharedPacketBatch_.reset();
+  // The connection closes are written together, with as few sendmmsg calls
+  // as they take, rather than with a write each.
+  std::unique_ptr<SharedPacketBatch> closeBatch;
+  if (socket_) {
+    closeBatch = std::make_unique<SharedPacketBatch>(
+        evb_, *socket_, transportSettings_->workerWriteBatchSize);
+  }
   for (auto& it : sourceAddressMap_) {
     auto transport = it.second;
     transport->setRoutingCallback(nullptr);
     transport->setTransportInfoCallback(nullptr);
+    transport->setSharedPacketBatch(closeBatch.get());
+    transport->setWriteScheduler(nullptr);
+    transport->setPacingTimerWheel(nullptr);
+    transport->setLoopClock(nullptr);
+    transport->setCongestionStateCache(nullptr);
+    transport->setReceiveWindowBudget(nullptr);
+    transport->setPendingPacketBudget(nullptr);
     transport->closeNow(
         std::make_pair(QuicErrorCode(error), std::string("shutting down")));
+    transport->setSharedPacketBatch(nullptr);
   }
+  // Transports with a pool of connection ids are in the map more than once.
+  std::unordered_set<QuicServerTransport*> closedTransports;
   for (auto& it : connectionIdMap_) {
     auto transport = it.second;
+    if (!closedTransports.insert(transport.get()).second) {
+      continue;
+    }
     transport->setRoutingCallback(nullptr);
     transport->setTransportInfoCallback(nullptr);
+    transport->setSharedPacketBatch(closeBatch.get());
+    transport->setWriteScheduler(nullptr);
+    transport->setPacingTimerWheel(nullptr);
+    transport->setLoopClock(nullptr);
+    transport->setCongestionStateCache(nullptr);
+    transport->setReceiveWindowBudget(nullptr);
+    transport->setPendingPacketBudget(nullptr);
     transport->closeNow(
         std::make_pair(QuicErrorCode(error), std::string("shutting down")));
+    transport->setSharedPacketBatch(nullptr);
     QUIC_STATS(infoCallback_, onConnectionClose, folly::none);
   }
+  closeBatch.reset();
   sourceAddressMap_.clear();
   connectionIdMap_.clear();
+  handshakeRoutes_.clear();
+  if (traceLogger_) {
+    traceLogger_->writeDropCounts();
+  }
+  writeScheduler_.reset();
+  pacingTimerWheel_.reset();
+  loopClock_.reset();
+  receiveWindowBudget_.reset();
+  pendingPacketBudget_.reset();
+  closedConnections_.reset();
   takeoverPktHandler_.stop();
   if (infoCallback_) {
     infoCallback_.reset();
@@ -10,18 +10,41 @@
 #include <unordered_map>
 
 #include <folly/io/async/AsyncUDPSocket.h>
-
+#include <folly/portability/Sockets.h>
+
+#include <quic/api/QuicBatchWriter.h>
+#include <quic/api/QuicECN.h>
+#include <quic/api/QuicGRO.h>
+#include <quic/api/QuicReadBufferPool.h>
+#include <quic/api/QuicRxTimestamp.h>
+#include <quic/api/QuicWriteScheduler.h>
 #include <quic/codec/ConnectionIdAlgo.h>
+#include <quic/codec/QuicPacketBuilder.h>
+#include <quic/common/BufferArena.h>
+#include <quic/common/LoopClock.h>
+#include <quic/common/PacingTimerWheel.h>
 #include <quic/common/Timers.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/flowcontrol/ReceiveWindowBudget.h>
+#include <quic/handshake/InitialCipherPool.h>
+#include <quic/server/ClosedConnectionTable.h>
+#include <quic/server/CongestionStateCache.h>
+#include <quic/server/InitialPacketFilter.h>
+#include <quic/server/OverloadController.h>
+#include <quic/server/QuicDatagramReadCallback.h>
 #include <quic/server/QuicServerPacketRouter.h>
 #include <quic/server/QuicServerTransportFactory.h>
 #include <quic/server/QuicUDPSocketFactory.h>
+#include <quic/server/WorkerLoadReporter.h>
+#include <quic/server/WorkerTraceLogger.h>
+#include <quic/server/handshake/RetryTokenGenerator.h>
+#include <quic/server/handshake/StatelessResetGenerator.h>
 #include <quic/state/QuicTransportStatsCallback.h>
 
 namespace quic {
 
 class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
+                         public QuicDatagramReadCallback,
                          public QuicServerTransport::RoutingCallback {
  public:
   using TransportSettingsOverrideFn =
@@ -29,6 +52,15 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
           const quic::TransportSettings&,
           const folly::IPAddress&)>;
 
+  // An established connection a handshake worker moves to a data worker,
+  // see TransportSettings::numHandshakeWorkers.
+  struct ConnectionHandOff {
+    folly::SocketAddress peer;
+    // from serializeConnectionState
+    Buf state;
+    std::vector<QuicConnectionStateBase::SelfConnectionId> connectionIds;
+  };
+
   class WorkerCallback {
    public:
     virtual ~WorkerCallback() = default;
@@ -39,6 +71,40 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
         const folly::SocketAddress& client,
         RoutingData&& routingData,
         NetworkData&& networkData) = 0;
+
+    // Id of the worker a new connection arriving at the worker with the given
+    // id should be created on instead, none to keep it there.
+    virtual folly::Optional<uint8_t> pickWorkerForNewConnection(
+        uint8_t workerId) = 0;
+
+    // Dispatches the data on the worker with the given id, on its thread.
+    virtual void routeDataToWorkerId(
+        uint8_t workerId,
+        const folly::SocketAddress& client,
+        RoutingData&& routingData,
+        NetworkData&& networkData) = 0;
+
+    // The worker with the given id took a load sample, on its thread. Only
+    // called when overloadLoopLatency is set.
+    virtual void onWorkerLoadSampled(uint8_t workerId) = 0;
+
+    // With numHandshakeWorkers, the data worker the connections created on
+    // the handshake worker with the given id are moved to, none if it is not
+    // a handshake worker.
+    virtual folly::Optional<uint8_t> pickDataWorker(uint8_t workerId) = 0;
+
+    // Has the data worker with the given id forward the packets for connId
+    // to the handshake worker with handshakeWorkerId until the connection is
+    // handed off, or stop doing so if handshakeWorkerId is none.
+    virtual void setHandshakeRoute(
+        uint8_t workerId,
+        const ConnectionId& connId,
+        folly::Optional<uint8_t> handshakeWorkerId) = 0;
+
+    // Moves the connection to the worker with the given id, on its thread.
+    virtual void handOffConnection(
+        uint8_t workerId,
+        ConnectionHandOff&& handOff) = 0;
   };
 
   explicit QuicServerWorker(std::shared_ptr<WorkerCallback> callback);
@@ -97,9 +163,12 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
 
   /**
    * Setup address that the taken over quic server is listening to forward
-   * misrouted packets belonging to the old server.
+   * misrouted packets belonging to the old server. The old server accepts
+   * takeover protocol versions up to peerVersion.
    */
-  void startPacketForwarding(const folly::SocketAddress& destAddr);
+  void startPacketForwarding(
+      const folly::SocketAddress& destAddr,
+      TakeoverProtocolVersion peerVersion = TakeoverProtocolVersion::V0);
 
   /**
    * Stop forwarding of packets and clean up any allocated resources
@@ -114,6 +183,8 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
 
   TakeoverProtocolVersion getTakeoverProtocolVersion() const noexcept;
 
+  void setTakeoverProtocolVersion(TakeoverProtocolVersion version) noexcept;
+
   /*
    * Sets the id of the server, that is later used in the routing of the packets
    * The id will be used to set a bit in the ConnectionId for routing.
@@ -155,11 +226,27 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
 
   void setTransportSettings(TransportSettings transportSettings);
 
+  /**
+   * Same as above without copying the settings, the connections of the
+   * worker are created from the snapshot as long as it is set.
+   */
+  void setTransportSettings(TransportSettingsSnapshot transportSettings);
+
   /**
    * If true, start to reject any new connection during handshake
    */
   void rejectNewConnections(bool rejectNewConnections);
 
+  /**
+   * Sheds load as the given level asks, see OverloadLevel: it applies to the
+   * new connections as well as the existing ones.
+   */
+  void setOverloadLevel(OverloadLevel level);
+
+  OverloadLevel getOverloadLevel() const {
+    return overloadLevel_;
+  }
+
   /**
    * Enable/disable partial reliability on connection settings.
    */
@@ -184,6 +271,30 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
    */
   QuicTransportStatsCallback* getTransportInfoCallback() const noexcept;
 
+  /**
+   * Set the logger tracing the packets this worker routes, forwards or drops
+   * before they reach a transport. Without it, drops are only counted by the
+   * stats callback.
+   */
+  void setTraceLogger(std::unique_ptr<WorkerTraceLogger> traceLogger);
+
+  WorkerTraceLogger* getTraceLogger() const {
+    return traceLogger_.get();
+  }
+
+  /**
+   * Set where the transports of this worker hand their packet capture over,
+   * see TransportSettings::packetCaptureDatagrams.
+   */
+  void setPacketCaptureCallback(
+      std::shared_ptr<PacketCaptureCallback> callback);
+
+  // Counts the drop in the stats callback and traces it.
+  void onPacketDropped(
+      QuicTransportStatsCallback::PacketDropReason reason,
+      const folly::SocketAddress& client,
+      const ConnectionId* dstConnId = nullptr);
+
   /**
    * Set ConnectionIdAlgo implementation to encode and decode ConnectionId with
    * various info, such as routing related info.
@@ -199,6 +310,22 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   void setCongestionControllerFactory(
       std::shared_ptr<CongestionControllerFactory> factory);
 
+  /**
+   * Set the executor the handshakes of the accepted connections run their
+   * signature and key exchange on, see QuicServer::setHandshakeExecutor.
+   * This must be set before the server starts (and accepts connections)
+   */
+  void setHandshakeExecutor(std::shared_ptr<folly::Executor> executor);
+
+  /**
+   * Set the executor the accepted connections encrypt their 1-RTT packets
+   * on, see QuicServer::setEncryptExecutor.
+   * This must be set before the server starts (and accepts connections)
+   */
+  void setEncryptExecutor(
+      std::shared_ptr<folly::Executor> executor,
+      size_t numHelpers);
+
   // Read callback
   void getReadBuffer(void** buf, size_t* len) noexcept override;
 
@@ -207,6 +334,20 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       size_t len,
       bool truncated) noexcept override;
 
+  /**
+   * Returns true when batched reads or GRO are enabled, in which case the
+   * socket only notifies us that data is available and we read it with
+   * recvmmsg.
+   */
+  bool shouldOnlyNotify() override;
+
+  void onNotifyDataAvailable(folly::AsyncUDPSocket& sock) noexcept override;
+
+  // Datagram read callback, for sockets that receive into their own buffers
+  void onDatagram(
+      const folly::SocketAddress& client,
+      std::unique_ptr<folly::IOBuf> data) noexcept override;
+
   // Routing callback
   /**
    * Called when a connecton id is available for a new connection (i.e flow)
@@ -223,6 +364,27 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   void onConnectionIdBound(
       QuicServerTransport::Ptr transport) noexcept override;
 
+  /**
+   * Called with the connection ids a transport issues to its peer on top of
+   * the one it was bound with. The ones already in use are left out.
+   */
+  void onConnectionIdsAvailable(
+      QuicServerTransport::Ptr transport,
+      std::vector<ConnectionId>& ids) noexcept override;
+
+  // Called with the connection ids of a transport its peer retired.
+  void onConnectionIdsRetired(
+      QuicServerTransport::Ptr transport,
+      const std::vector<ConnectionId>& ids) noexcept override;
+
+  /**
+   * Keeps a ClosedConnectionTable record of the transport, which answers its
+   * peer until drainTimeout in its place.
+   */
+  void onConnectionDraining(
+      QuicServerTransport::Ptr transport,
+      std::chrono::milliseconds drainTimeout) noexcept override;
+
   /**
    * source: Source address and source CID
    * connectionId: destination CID (i.e. server chosen connection-id)
@@ -240,14 +402,28 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       RoutingData&& routingData,
       NetworkData&& networkData) noexcept;
 
+  /**
+   * See WorkerCallback::setHandshakeRoute. Must be called from the worker's
+   * EventBase.
+   */
+  void setHandshakeRoute(
+      const ConnectionId& connId,
+      folly::Optional<uint8_t> handshakeWorkerId);
+
+  /**
+   * Creates a transport for a connection a handshake worker handed off.
+   * Returns false if its state could not be restored. Must be called from
+   * the worker's EventBase.
+   */
+  bool adoptConnection(ConnectionHandOff&& handOff);
+
   using ConnIdToTransportMap = std::
       unordered_map<ConnectionId, QuicServerTransport::Ptr, ConnectionIdHash>;
 
   struct SourceIdentityHash {
     size_t operator()(const QuicServerTransport::SourceIdentity& sid) const {
       return folly::hash::hash_combine(
-          folly::hash::fnv32_buf(sid.second.data(), sid.second.size()),
-          sid.first.hash());
+          ConnectionIdHash()(sid.second), sid.first.hash());
     }
   };
   using SrcToTransportMap = std::unordered_map<
@@ -261,6 +437,75 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
 
   void shutdownAllConnections(LocalErrorCode error);
 
+  /**
+   * Sum of getConnectionBufferedBytes() over the connections of this worker.
+   * Walks all the connections, meant to be polled, not called per packet.
+   */
+  uint64_t getBufferedBytes() const;
+
+  /**
+   * Memory pressure hook. Closes the connections buffering the most bytes
+   * until the worker buffers at most maxBufferedBytes. Returns the number of
+   * connections closed. Must be called from the worker's EventBase.
+   */
+  size_t shedConnections(uint64_t maxBufferedBytes);
+
+  struct TransportLoopTime {
+    folly::Optional<ConnectionId> serverConnectionId;
+    folly::SocketAddress peerAddress;
+    uint8_t workerId{0};
+    // See QuicConnectionStateBase::LoopTime.
+    uint64_t callbacks{0};
+    std::chrono::microseconds loopTime{0};
+  };
+
+  /**
+   * The n connections of this worker that spent the most time in its event
+   * base, most first, as sampled with TransportSettings::loopTimeSampleRate.
+   * Walks all the connections, meant for debugging. Must be called from the
+   * worker's EventBase.
+   */
+  std::vector<TransportLoopTime> getTopTransportsByLoopTime(size_t n) const;
+
+  /**
+   * Load of this worker as of its last sample, all zeros unless
+   * workerLoadReportInterval is set. Thread safe.
+   */
+  WorkerLoad getLoad() const;
+
+  /**
+   * Memory pressure hook for receive window auto-tuning. Under memory pressure
+   * the connections stop growing their receive windows and shrink them back
+   * at their next window update. No-op without autotuneReceiveWindow.
+   */
+  void setReceiveWindowMemoryPressure(bool underMemoryPressure);
+
+  // for unit test
+  const ReceiveWindowBudget* getReceiveWindowBudget() const {
+    return receiveWindowBudget_.get();
+  }
+
+  // for unit test
+  const PendingPacketBudget* getPendingPacketBudget() const {
+    return pendingPacketBudget_.get();
+  }
+
+  // for unit test
+  const ClosedConnectionTable* getClosedConnections() const {
+    return closedConnections_.get();
+  }
+
+  // for unit test
+  const std::unordered_map<ConnectionId, uint8_t, ConnectionIdHash>&
+  getHandshakeRoutes() const {
+    return handshakeRoutes_;
+  }
+
+  // for unit test
+  const TransportSettingsSnapshot& getTransportSettingsSnapshot() const {
+    return transportSettings_;
+  }
+
   // for unit test
   folly::AsyncUDPSocket::ReadCallback* getTakeoverHandlerCallback() {
     return takeoverCB_.get();
@@ -270,7 +515,8 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   void handleNetworkData(
       const folly::SocketAddress& client,
       Buf data,
-      const TimePoint& receiveTime) noexcept;
+      const TimePoint& receiveTime,
+      ECNCodepoint ecn = ECNCodepoint::NotECT) noexcept;
 
   /**
    * Try handling the data as a health check.
@@ -315,12 +561,74 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       folly::EventBase* evb,
       int fd) const;
 
+  /**
+   * Reads up to maxRecvBatchSize datagrams from the listening socket in a
+   * single recvmmsg call and hands each of them to handleNetworkData. GRO
+   * coalesced datagrams are split into individual packets first.
+   */
+  void recvmmsgBatch(int fd, size_t numPackets) noexcept;
+
+  /**
+   * Size of the buffers we read datagrams into.
+   */
+  size_t getReadBufferSize() const noexcept;
+
+  // An empty buffer of size bytes to read a datagram into.
+  Buf createReadBuffer(size_t size);
+
+  /**
+   * A transport for a connection from client, set up with the worker's
+   * shared state. It is given settings if any or the worker's, and is routed
+   * with serverConnIdParams.
+   */
+  QuicServerTransport::Ptr makeTransport(
+      const folly::SocketAddress& client,
+      folly::Optional<TransportSettings> settings,
+      ServerConnectionIdParams serverConnIdParams);
+
+  /**
+   * On a handshake worker, moves the connection of transport to the data
+   * worker its connection id routes to once it is established and quiescent:
+   * without streams, outstanding packets or buffered data.
+   */
+  void maybeHandOffConnection(const QuicServerTransport::Ptr& transport);
+
+  /**
+   * Every transport of this worker once, whether it is routed by source
+   * address, by connection id or both.
+   */
+  std::vector<QuicServerTransport::Ptr> getTransports() const;
+
+  // Load the connections shed at the current overload level.
+  QuicConnectionStateBase::OverloadState getOverloadState() const;
+
   void sendResetPacket(
       const HeaderForm& headerForm,
       const folly::SocketAddress& client,
       const NetworkData& networkData,
       const ConnectionId& connId);
 
+  // Whether a version negotiation packet or a stateless reset may be sent,
+  // within statelessResponsesRate.
+  bool allowStatelessResponse(TimePoint now);
+
+  /**
+   * Address validation of a new connection, when retryTokenSecret is set.
+   * Returns false if the Initial was answered with a Retry or dropped for an
+   * invalid token, in which case no connection must be created for it.
+   */
+  bool validateNewConnection(
+      const folly::SocketAddress& client,
+      const RoutingData& routingData,
+      const NetworkData& networkData);
+
+  // Whether a new connection from client without a token gets a Retry.
+  bool shouldSendRetry(const folly::SocketAddress& client, TimePoint now);
+
+  void sendRetryPacket(
+      const folly::SocketAddress& client,
+      const LongHeader& initialHeader);
+
   std::unique_ptr<folly::AsyncUDPSocket> socket_;
   std::shared_ptr<WorkerCallback> callback_;
   folly::EventBase* evb_{nullptr};
@@ -329,22 +637,72 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   QuicUDPSocketFactory* socketFactory_;
   QuicServerTransportFactory* transportFactory_;
   std::shared_ptr<CongestionControllerFactory> ccFactory_{nullptr};
+  std::shared_ptr<folly::Executor> handshakeExecutor_;
+  std::shared_ptr<folly::Executor> encryptExecutor_;
+  size_t numEncryptHelpers_{0};
 
   ConnIdToTransportMap connectionIdMap_;
   SrcToTransportMap sourceAddressMap_;
-
+  // On a data worker, handshake workers with connections that will be
+  // handed to it, by the connection id the peer routes them with.
+  std::unordered_map<ConnectionId, uint8_t, ConnectionIdHash> handshakeRoutes_;
+
+  // Huge page backed arenas the receive buffers and the contiguous packet
+  // buffers of the transports come from, when bufferArenaEnabled is set.
+  std::unique_ptr<BufferArena> readBufferArena_;
+  std::unique_ptr<BufferArena> writeBufferArena_;
   Buf readBuffer_;
+  // Optional pool of receive buffers, used instead of readBuffer_ when
+  // readBufferPoolSize is set.
+  std::unique_ptr<QuicReadBufferPool> readBufferPool_;
+  QuicReadBufferPool::PooledBuffer pooledReadBuffer_;
+
+  // Storage for batched reads, sized in start() from maxRecvBatchSize and
+  // reused across read events.
+  struct RecvmmsgStorage {
+    struct impl_ {
+      struct sockaddr_storage addr;
+      struct iovec iovec;
+      // Control data for the GRO segment size, the ECN codepoint and the
+      // kernel receive time.
+      char control
+          [kGROControlSize + kECNControlSize + kRxTimestampControlSize];
+      // Buffers that are not consumed by a read are kept for the next one.
+      Buf readBuffer;
+      QuicReadBufferPool::PooledBuffer pooledBuffer;
+    };
+
+    void resize(size_t numPackets);
+
+    std::vector<struct mmsghdr> msgs;
+    std::vector<impl_> impl;
+  };
+  RecvmmsgStorage recvmmsgStorage_;
+  // Whether UDP GRO was successfully enabled on the listening socket.
+  bool groEnabled_{false};
+  // Whether the listening socket marks packets with ECT(0) and reports the
+  // ECN codepoints of received ones.
+  bool ecnEnabled_{false};
+  // Whether the listening socket reports the kernel receive time of datagrams.
+  bool rxTimestampsEnabled_{false};
+  // Scratch space for the packets of a GRO coalesced datagram.
+  std::vector<Buf> groPackets_;
+
   bool shutdown_{false};
   std::vector<QuicVersion> supportedVersions_;
   std::shared_ptr<const fizz::server::FizzServerContext> ctx_;
-  TransportSettings transportSettings_;
+  TransportSettingsSnapshot transportSettings_{
+      std::make_shared<const TransportSettings>()};
   folly::Optional<Buf> healthCheckToken_;
   bool rejectNewConnections_{false};
+  OverloadLevel overloadLevel_{OverloadLevel::NONE};
   uint8_t workerId_{0};
   std::unique_ptr<ConnectionIdAlgo> connIdAlgo_;
   uint16_t hostId_{0};
   // QuicServerWorker maintains ownership of the info stats callback
   std::unique_ptr<QuicTransportStatsCallback> infoCallback_;
+  std::unique_ptr<WorkerTraceLogger> traceLogger_;
+  std::shared_ptr<PacketCaptureCallback> packetCaptureCallback_;
 
   // Handle takeover between processes
   std::unique_ptr<TakeoverHandlerCallback> takeoverCB_;
@@ -354,6 +712,91 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   using PacketDropReason = QuicTransportStatsCallback::PacketDropReason;
   TimerHighRes::SharedPtr pacingTimer_;
 
+  // Write batch shared by all the connections of this worker, only set when
+  // workerWriteBatchEnabled is on.
+  std::unique_ptr<SharedPacketBatch> sharedPacketBatch_;
+
+  // Write scheduler shared by all the connections of this worker, only set
+  // when workerWriteSchedulerEnabled is on.
+  std::unique_ptr<QuicWriteScheduler> writeScheduler_;
+
+  // Pacing timer wheel shared by all the connections of this worker, only set
+  // when pacingTimerWheelEnabled is on.
+  std::unique_ptr<PacingTimerWheel> pacingTimerWheel_;
+
+  // Time of the current loop iteration shared by all the connections of this
+  // worker, only set when loopClockEnabled is on.
+  std::unique_ptr<LoopClock> loopClock_;
+
+  // Path state of closed connections, only set when congestionStateCacheSize
+  // is non zero.
+  std::unique_ptr<CongestionStateCache> congestionStateCache_;
+
+  // Receive window growth budget of the connections of this worker, only set
+  // when autotuneReceiveWindow is on.
+  std::unique_ptr<ReceiveWindowBudget> receiveWindowBudget_;
+
+  // Budget of the packets the connections of this worker buffer until they
+  // can decrypt them, only set when pendingPacketBudgetBytes is non zero.
+  std::unique_ptr<PendingPacketBudget> pendingPacketBudget_;
+
+  // Records of the closed connections of this worker while they drain, set
+  // once a connection with closedConnectionRecordsEnabled closes.
+  std::unique_ptr<ClosedConnectionTable> closedConnections_;
+
+  // Initial aeads released by the connections of this worker, only set when
+  // initialCipherPoolSize is non zero.
+  std::shared_ptr<InitialCipherPool> initialCipherPool_;
+  // Caps the pacing rates of the worker's connections, only set when
+  // workerEgressBandwidth is non zero.
+  std::shared_ptr<BandwidthAllocator> bandwidthAllocator_;
+
+  std::shared_ptr<ServerTransportParametersCache> transportParametersCache_{
+      std::make_shared<ServerTransportParametersCache>()};
+
+  // Rate limits of Initials and new connections, only set when
+  // initialsPerPrefixRate or newConnectionsRate is non zero.
+  std::unique_ptr<InitialPacketFilter> initialPacketFilter_;
+
+  // Address validation tokens, only set when retryTokenSecret is.
+  std::unique_ptr<RetryTokenGenerator> retryTokenGenerator_;
+
+  // Version negotiation packets for the supported versions, and for
+  // rejecting new connections, with the versions encoded once.
+  folly::Optional<CachedVersionNegotiationPacket> versionNegotiationPacket_;
+  CachedVersionNegotiationPacket rejectionPacket_{
+      std::vector<QuicVersion>{QuicVersion::MVFST_INVALID}};
+
+  // Rate limit of the packets above and of stateless resets, only set when
+  // statelessResponsesRate is non zero.
+  folly::Optional<RateLimiterBucket> statelessResponseLimiter_;
+
+  // Created for the first stateless reset, once the worker is bound. The
+  // tokens of the connection ids resets were recently sent for are kept, a
+  // peer that doesn't take the hint keeps sending to them.
+  std::unique_ptr<StatelessResetGenerator> statelessResetGenerator_;
+  folly::EvictingCacheMap<ConnectionId, StatelessResetToken, ConnectionIdHash>
+      statelessResetTokens_{kStatelessResetTokenCacheSize};
+
+  // New connections per source address in the current kRetrySourceRateWindow,
+  // only tracked when retryNewConnectionsPerSourceThreshold is non zero.
+  struct SourceRate {
+    TimePoint windowStart;
+    uint32_t newConnections{0};
+  };
+  folly::EvictingCacheMap<folly::IPAddress, SourceRate> sourceRates_{
+      kRetrySourceRateCacheSize};
+
+  WorkerLoadReporter loadReporter_;
+
+  // Workers that new connections were handed to, with
+  // newConnectionLoadBalancing.
+  folly::EvictingCacheMap<
+      QuicServerTransport::SourceIdentity,
+      uint8_t,
+      SourceIdentityHash>
+      redirectedConnections_{kRedirectedConnectionsCacheSize};
+
   // Used to override certain transport parameters, given the client address
   TransportSettingsOverrideFn transportSettingsOverrideFn_;
 };
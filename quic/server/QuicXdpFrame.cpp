@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicXdpFrame.h>
+
+#include <folly/portability/Sockets.h>
+
+#include <cstring>
+
+namespace {
+constexpr size_t kEthHeaderSize = 14;
+constexpr size_t kVlanTagSize = 4;
+constexpr uint16_t kEthTypeIPv4 = 0x0800;
+constexpr uint16_t kEthTypeIPv6 = 0x86dd;
+constexpr uint16_t kEthTypeVlan = 0x8100;
+constexpr size_t kIPv4HeaderSize = 20;
+constexpr size_t kIPv6HeaderSize = 40;
+constexpr size_t kUdpHeaderSize = 8;
+constexpr uint8_t kIpProtoUdp = 17;
+constexpr uint8_t kHopLimit = 64;
+
+uint16_t readBE16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+void writeBE16(uint8_t* p, uint16_t value) {
+  p[0] = value >> 8;
+  p[1] = value & 0xff;
+}
+
+// Internet checksum, RFC 1071.
+uint64_t checksumAdd(uint64_t sum, folly::ByteRange data) {
+  size_t i = 0;
+  for (; i + 1 < data.size(); i += 2) {
+    sum += readBE16(data.data() + i);
+  }
+  if (i < data.size()) {
+    sum += data[i] << 8;
+  }
+  return sum;
+}
+
+uint16_t checksumFinish(uint64_t sum) {
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return ~sum & 0xffff;
+}
+} // namespace
+
+namespace quic {
+
+folly::Optional<XdpUdpFrame> parseXdpUdpFrame(folly::ByteRange frame) {
+  if (frame.size() < kEthHeaderSize) {
+    return folly::none;
+  }
+  XdpUdpFrame parsed;
+  memcpy(parsed.dstMac.data(), frame.data(), parsed.dstMac.size());
+  memcpy(parsed.srcMac.data(), frame.data() + 6, parsed.srcMac.size());
+  size_t offset = 12;
+  uint16_t ethType = readBE16(frame.data() + offset);
+  offset += sizeof(ethType);
+  if (ethType == kEthTypeVlan) {
+    if (frame.size() < offset + kVlanTagSize) {
+      return folly::none;
+    }
+    ethType = readBE16(frame.data() + offset + 2);
+    offset += kVlanTagSize;
+  }
+  folly::IPAddress srcIp;
+  folly::IPAddress dstIp;
+  // Frames can be padded past the end of the IP packet.
+  size_t ipEnd;
+  if (ethType == kEthTypeIPv4) {
+    if (frame.size() < offset + kIPv4HeaderSize) {
+      return folly::none;
+    }
+    auto ip = frame.data() + offset;
+    size_t headerLen = (ip[0] & 0x0f) * 4;
+    size_t totalLen = readBE16(ip + 2);
+    // Fragments have the more fragments flag or an offset set.
+    bool fragment = (readBE16(ip + 6) & 0x3fff) != 0;
+    if ((ip[0] >> 4) != 4 || headerLen < kIPv4HeaderSize ||
+        ip[9] != kIpProtoUdp || fragment || totalLen < headerLen ||
+        offset + totalLen > frame.size()) {
+      return folly::none;
+    }
+    srcIp = folly::IPAddressV4::fromBinary(folly::ByteRange(ip + 12, 4));
+    dstIp = folly::IPAddressV4::fromBinary(folly::ByteRange(ip + 16, 4));
+    ipEnd = offset + totalLen;
+    offset += headerLen;
+  } else if (ethType == kEthTypeIPv6) {
+    if (frame.size() < offset + kIPv6HeaderSize) {
+      return folly::none;
+    }
+    auto ip = frame.data() + offset;
+    size_t payloadLen = readBE16(ip + 4);
+    if ((ip[0] >> 4) != 6 || ip[6] != kIpProtoUdp ||
+        offset + kIPv6HeaderSize + payloadLen > frame.size()) {
+      return folly::none;
+    }
+    srcIp = folly::IPAddressV6::fromBinary(folly::ByteRange(ip + 8, 16));
+    dstIp = folly::IPAddressV6::fromBinary(folly::ByteRange(ip + 24, 16));
+    ipEnd = offset + kIPv6HeaderSize + payloadLen;
+    offset += kIPv6HeaderSize;
+  } else {
+    return folly::none;
+  }
+  if (offset + kUdpHeaderSize > ipEnd) {
+    return folly::none;
+  }
+  auto udp = frame.data() + offset;
+  size_t udpLen = readBE16(udp + 4);
+  if (udpLen < kUdpHeaderSize || offset + udpLen > ipEnd) {
+    return folly::none;
+  }
+  parsed.src = folly::SocketAddress(srcIp, readBE16(udp));
+  parsed.dst = folly::SocketAddress(dstIp, readBE16(udp + 2));
+  parsed.payloadOffset = offset + kUdpHeaderSize;
+  parsed.payloadLength = udpLen - kUdpHeaderSize;
+  return parsed;
+}
+
+size_t xdpUdpHeadersSize(const folly::SocketAddress& dst) {
+  return kEthHeaderSize +
+      (dst.getFamily() == AF_INET ? kIPv4HeaderSize : kIPv6HeaderSize) +
+      kUdpHeaderSize;
+}
+
+size_t writeXdpUdpFrame(
+    folly::MutableByteRange out,
+    const MacAddress& srcMac,
+    const MacAddress& dstMac,
+    const folly::SocketAddress& src,
+    const folly::SocketAddress& dst,
+    folly::io::Cursor& payload,
+    size_t payloadLength) {
+  DCHECK_EQ(src.getFamily(), dst.getFamily());
+  size_t headersSize = xdpUdpHeadersSize(dst);
+  if (out.size() < headersSize + payloadLength) {
+    return 0;
+  }
+  bool v4 = dst.getFamily() == AF_INET;
+  auto frame = out.data();
+  memcpy(frame, dstMac.data(), dstMac.size());
+  memcpy(frame + 6, srcMac.data(), srcMac.size());
+  writeBE16(frame + 12, v4 ? kEthTypeIPv4 : kEthTypeIPv6);
+
+  auto ip = frame + kEthHeaderSize;
+  size_t udpLen = kUdpHeaderSize + payloadLength;
+  uint8_t* udp;
+  if (v4) {
+    memset(ip, 0, kIPv4HeaderSize);
+    ip[0] = 0x45;
+    writeBE16(ip + 2, kIPv4HeaderSize + udpLen);
+    // Don't fragment, like the kernel sockets of the server.
+    writeBE16(ip + 6, 0x4000);
+    ip[8] = kHopLimit;
+    ip[9] = kIpProtoUdp;
+    memcpy(ip + 12, src.getIPAddress().asV4().bytes(), 4);
+    memcpy(ip + 16, dst.getIPAddress().asV4().bytes(), 4);
+    writeBE16(
+        ip + 10,
+        checksumFinish(checksumAdd(0, folly::ByteRange(ip, kIPv4HeaderSize))));
+    udp = ip + kIPv4HeaderSize;
+  } else {
+    memset(ip, 0, 4);
+    ip[0] = 0x60;
+    writeBE16(ip + 4, udpLen);
+    ip[6] = kIpProtoUdp;
+    ip[7] = kHopLimit;
+    memcpy(ip + 8, src.getIPAddress().asV6().bytes(), 16);
+    memcpy(ip + 24, dst.getIPAddress().asV6().bytes(), 16);
+    udp = ip + kIPv6HeaderSize;
+  }
+  writeBE16(udp, src.getPort());
+  writeBE16(udp + 2, dst.getPort());
+  writeBE16(udp + 4, udpLen);
+  writeBE16(udp + 6, 0);
+  payload.pull(udp + kUdpHeaderSize, payloadLength);
+  if (!v4) {
+    // The pseudo header is the addresses, the length and the protocol.
+    uint64_t sum = checksumAdd(0, folly::ByteRange(ip + 8, 32));
+    sum += udpLen + kIpProtoUdp;
+    auto checksum =
+        checksumFinish(checksumAdd(sum, folly::ByteRange(udp, udpLen)));
+    // 0 means no checksum, which IPv6 doesn't allow.
+    writeBE16(udp + 6, checksum == 0 ? 0xffff : checksum);
+  }
+  return headersSize + payloadLength;
+}
+
+} // namespace quic
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/Cursor.h>
+
+#include <array>
+
+namespace quic {
+
+using MacAddress = std::array<uint8_t, 6>;
+
+/**
+ * The addresses of a UDP datagram in an Ethernet frame, as read off an
+ * AF_XDP socket, and where its payload is in the frame.
+ */
+struct XdpUdpFrame {
+  MacAddress srcMac;
+  MacAddress dstMac;
+  folly::SocketAddress src;
+  folly::SocketAddress dst;
+  size_t payloadOffset{0};
+  size_t payloadLength{0};
+};
+
+/**
+ * Parses an Ethernet frame, with at most one VLAN tag, holding an IPv4 or
+ * IPv6 UDP datagram. Returns none for anything else, including fragments and
+ * IPv6 packets with extension headers.
+ */
+folly::Optional<XdpUdpFrame> parseXdpUdpFrame(folly::ByteRange frame);
+
+// Size of the Ethernet, IP and UDP headers of a datagram to dst.
+size_t xdpUdpHeadersSize(const folly::SocketAddress& dst);
+
+/**
+ * Writes an Ethernet frame holding a UDP datagram from src to dst, whose
+ * payload are the next payloadLength bytes of payload, to out. src and dst
+ * must be of the same family. Returns the length of the frame, or 0 if it
+ * doesn't fit in out.
+ *
+ * The UDP checksum is left out of IPv4 datagrams, where it is optional, and
+ * computed for IPv6 ones.
+ */
+size_t writeXdpUdpFrame(
+    folly::MutableByteRange out,
+    const MacAddress& srcMac,
+    const MacAddress& dstMac,
+    const folly::SocketAddress& src,
+    const folly::SocketAddress& dst,
+    folly::io::Cursor& payload,
+    size_t payloadLength);
+
+} // namespace quic
@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicXdpUDPSocket.h>
+
+#if MVFST_HAVE_LIBXDP
+
+#include <folly/Exception.h>
+#include <sys/mman.h>
+
+namespace quic {
+
+QuicXdpQueue::Umem::~Umem() {
+  if (umem) {
+    xsk_umem__delete(umem);
+  }
+  if (area) {
+    ::munmap(area, size);
+  }
+}
+
+void QuicXdpQueue::Umem::release() {
+  if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete this;
+  }
+}
+
+QuicXdpQueue::QuicXdpQueue(folly::EventBase* evb, Options options)
+    : evb_(evb), options_(std::move(options)), kickCallback_(*this) {
+  CHECK_GE(options_.numFrames, 2u);
+  auto umem = std::make_unique<Umem>();
+  umem->frameSize = options_.frameSize;
+  umem->size = static_cast<size_t>(options_.numFrames) * options_.frameSize;
+  auto area = ::mmap(
+      nullptr,
+      umem->size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+  if (area == MAP_FAILED) {
+    folly::throwSystemError("mmap() of the UMEM failed");
+  }
+  umem->area = static_cast<uint8_t*>(area);
+
+  xsk_umem_config umemConfig = {};
+  umemConfig.fill_size = options_.ringSize;
+  umemConfig.comp_size = options_.ringSize;
+  umemConfig.frame_size = options_.frameSize;
+  umemConfig.frame_headroom = 0;
+  int ret = xsk_umem__create(
+      &umem->umem,
+      umem->area,
+      umem->size,
+      &umem->fill,
+      &umem->completion,
+      &umemConfig);
+  if (ret) {
+    folly::throwSystemErrorExplicit(-ret, "xsk_umem__create() failed");
+  }
+
+  xsk_socket_config config = {};
+  config.rx_size = options_.ringSize;
+  config.tx_size = options_.ringSize;
+  config.bind_flags =
+      XDP_USE_NEED_WAKEUP | (options_.zeroCopy ? XDP_ZEROCOPY : 0);
+  ret = xsk_socket__create(
+      &xsk_,
+      options_.ifname.c_str(),
+      options_.queueId,
+      umem->umem,
+      &rx_,
+      &tx_,
+      &config);
+  if (ret) {
+    folly::throwSystemErrorExplicit(-ret, "xsk_socket__create() failed");
+  }
+  umem_ = umem.release();
+  fd_ = xsk_socket__fd(xsk_);
+
+  numRxFrames_ = options_.numFrames / 2;
+  for (uint32_t i = 0; i < options_.numFrames; ++i) {
+    auto addr = static_cast<uint64_t>(i) * options_.frameSize;
+    if (i < numRxFrames_) {
+      freeRxFrames_.push_back(addr);
+    } else {
+      freeTxFrames_.push_back(addr);
+    }
+  }
+  refill();
+  initHandler(evb_, folly::NetworkSocket::fromFd(fd_));
+}
+
+QuicXdpQueue::~QuicXdpQueue() {
+  kickCallback_.cancelLoopCallback();
+  unregisterHandler();
+  xsk_socket__delete(xsk_);
+  umem_->release();
+}
+
+void QuicXdpQueue::setReadCallback(
+    folly::AsyncUDPSocket::ReadCallback* cb,
+    const folly::SocketAddress& local) {
+  readCallback_ = cb;
+  datagramCallback_ = dynamic_cast<QuicDatagramReadCallback*>(cb);
+  local_ = local;
+  if (cb && !isHandlerRegistered()) {
+    registerHandler(folly::EventHandler::READ | folly::EventHandler::PERSIST);
+  } else if (!cb && isHandlerRegistered()) {
+    unregisterHandler();
+  }
+}
+
+void QuicXdpQueue::handlerReady(uint16_t /*events*/) noexcept {
+  receive();
+  reapCompletions();
+  refill();
+}
+
+void QuicXdpQueue::receive() {
+  uint32_t idx = 0;
+  auto received = xsk_ring_cons__peek(&rx_, options_.rxBatchSize, &idx);
+  for (uint32_t i = 0; i < received; ++i) {
+    auto desc = xsk_ring_cons__rx_desc(&rx_, idx + i);
+    deliver(desc->addr, desc->len);
+  }
+  xsk_ring_cons__release(&rx_, received);
+}
+
+void QuicXdpQueue::deliver(uint64_t addr, uint32_t len) {
+  auto frameAddr = addr - addr % options_.frameSize;
+  auto data = static_cast<uint8_t*>(xsk_umem__get_data(umem_->area, addr));
+  auto frame = parseXdpUdpFrame(folly::ByteRange(data, len));
+  if (!frame || !readCallback_ || frame->dst.getPort() != local_.getPort()) {
+    freeRxFrames_.push_back(frameAddr);
+    return;
+  }
+  auto& link = getLink(frame->src);
+  link.known = true;
+  link.localMac = frame->dstMac;
+  link.gatewayMac = frame->srcMac;
+  link.localIp = frame->dst.getIPAddress();
+
+  auto peer = frame->src;
+  if (local_.getFamily() == AF_INET6 && peer.getFamily() == AF_INET) {
+    peer = folly::SocketAddress(
+        peer.getIPAddress().asV4().createIPv6(), peer.getPort());
+  }
+  auto payload = data + frame->payloadOffset;
+  auto payloadLength = frame->payloadLength;
+  if (datagramCallback_ &&
+      umem_->outstanding.load(std::memory_order_relaxed) < numRxFrames_ / 2) {
+    umem_->refs++;
+    umem_->outstanding++;
+    datagramCallback_->onDatagram(
+        peer,
+        folly::IOBuf::takeOwnership(
+            payload, payloadLength, freeRxFrame, umem_));
+    return;
+  }
+  if (datagramCallback_) {
+    auto buf = folly::IOBuf::copyBuffer(payload, payloadLength);
+    freeRxFrames_.push_back(frameAddr);
+    datagramCallback_->onDatagram(peer, std::move(buf));
+    return;
+  }
+  void* readBuf = nullptr;
+  size_t readLen = 0;
+  readCallback_->getReadBuffer(&readBuf, &readLen);
+  if (!readBuf) {
+    freeRxFrames_.push_back(frameAddr);
+    return;
+  }
+  bool truncated = payloadLength > readLen;
+  size_t copied = std::min(payloadLength, readLen);
+  memcpy(readBuf, payload, copied);
+  freeRxFrames_.push_back(frameAddr);
+  readCallback_->onDataAvailable(peer, copied, truncated);
+}
+
+void QuicXdpQueue::freeRxFrame(void* buf, void* userData) {
+  auto umem = static_cast<Umem*>(userData);
+  uint64_t addr = static_cast<uint8_t*>(buf) - umem->area;
+  {
+    std::lock_guard<std::mutex> guard(umem->mutex);
+    umem->returned.push_back(addr - addr % umem->frameSize);
+  }
+  umem->outstanding--;
+  umem->release();
+}
+
+void QuicXdpQueue::refill() {
+  {
+    std::lock_guard<std::mutex> guard(umem_->mutex);
+    freeRxFrames_.insert(
+        freeRxFrames_.end(), umem_->returned.begin(), umem_->returned.end());
+    umem_->returned.clear();
+  }
+  if (freeRxFrames_.empty()) {
+    return;
+  }
+  uint32_t idx = 0;
+  auto reserved =
+      xsk_ring_prod__reserve(&umem_->fill, freeRxFrames_.size(), &idx);
+  for (uint32_t i = 0; i < reserved; ++i) {
+    *xsk_ring_prod__fill_addr(&umem_->fill, idx + i) = freeRxFrames_.back();
+    freeRxFrames_.pop_back();
+  }
+  xsk_ring_prod__submit(&umem_->fill, reserved);
+  if (reserved > 0 && xsk_ring_prod__needs_wakeup(&umem_->fill)) {
+    // Lets the kernel know it has frames to receive into again.
+    ::recvfrom(fd_, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+  }
+}
+
+void QuicXdpQueue::reapCompletions() {
+  uint32_t idx = 0;
+  auto completed =
+      xsk_ring_cons__peek(&umem_->completion, options_.ringSize, &idx);
+  for (uint32_t i = 0; i < completed; ++i) {
+    freeTxFrames_.push_back(
+        *xsk_ring_cons__comp_addr(&umem_->completion, idx + i));
+  }
+  xsk_ring_cons__release(&umem_->completion, completed);
+}
+
+void QuicXdpQueue::kick() {
+  if (xsk_ring_prod__needs_wakeup(&tx_)) {
+    // Makes the kernel go through the transmit ring.
+    ::sendto(fd_, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+  }
+  reapCompletions();
+}
+
+QuicXdpQueue::Link& QuicXdpQueue::getLink(const folly::SocketAddress& addr) {
+  return addr.getFamily() == AF_INET || addr.getIPAddress().isIPv4Mapped()
+      ? v4Link_
+      : v6Link_;
+}
+
+bool QuicXdpQueue::canSend(
+    const folly::SocketAddress& peer,
+    size_t numDatagrams,
+    size_t len) {
+  if (!getLink(peer).known ||
+      xdpUdpHeadersSize(peer) + len > options_.frameSize) {
+    return false;
+  }
+  if (freeTxFrames_.size() < numDatagrams) {
+    reapCompletions();
+  }
+  return freeTxFrames_.size() >= numDatagrams &&
+      xsk_prod_nb_free(&tx_, numDatagrams) >= numDatagrams;
+}
+
+bool QuicXdpQueue::send(
+    const folly::SocketAddress& local,
+    const folly::SocketAddress& peer,
+    folly::io::Cursor& payload,
+    size_t len) {
+  if (!canSend(peer, 1, len)) {
+    return false;
+  }
+  auto& link = getLink(peer);
+  auto dst = peer;
+  if (peer.getIPAddress().isIPv4Mapped()) {
+    dst = folly::SocketAddress(
+        peer.getIPAddress().createIPv4(), peer.getPort());
+  }
+  // Sockets bound to the any address send from the address the peers send
+  // to.
+  auto localIp = local.getIPAddress();
+  if (localIp.isZero() || localIp.family() != dst.getFamily()) {
+    localIp = link.localIp;
+  }
+  uint32_t idx = 0;
+  if (xsk_ring_prod__reserve(&tx_, 1, &idx) != 1) {
+    return false;
+  }
+  auto addr = freeTxFrames_.back();
+  freeTxFrames_.pop_back();
+  auto frameLen = writeXdpUdpFrame(
+      folly::MutableByteRange(umem_->area + addr, options_.frameSize),
+      link.localMac,
+      link.gatewayMac,
+      folly::SocketAddress(localIp, local.getPort()),
+      dst,
+      payload,
+      len);
+  auto desc = xsk_ring_prod__tx_desc(&tx_, idx);
+  desc->addr = addr;
+  desc->len = frameLen;
+  xsk_ring_prod__submit(&tx_, 1);
+  // The kernel is woken up once for all the frames of the loop.
+  if (!kickCallback_.isLoopCallbackScheduled()) {
+    evb_->runInLoop(&kickCallback_);
+  }
+  return true;
+}
+
+QuicXdpUDPSocket::QuicXdpUDPSocket(
+    folly::EventBase* evb,
+    std::shared_ptr<QuicXdpQueue> queue)
+    : folly::AsyncUDPSocket(evb), queue_(std::move(queue)) {
+  CHECK(queue_);
+}
+
+QuicXdpUDPSocket::~QuicXdpUDPSocket() {
+  if (queueReading_) {
+    queue_->setReadCallback(nullptr, folly::SocketAddress());
+  }
+}
+
+void QuicXdpUDPSocket::resumeRead(ReadCallback* cob) {
+  folly::AsyncUDPSocket::resumeRead(cob);
+  queue_->setReadCallback(cob, address());
+  queueReading_ = true;
+}
+
+void QuicXdpUDPSocket::pauseRead() {
+  if (queueReading_) {
+    queue_->setReadCallback(nullptr, folly::SocketAddress());
+    queueReading_ = false;
+  }
+  folly::AsyncUDPSocket::pauseRead();
+}
+
+bool QuicXdpUDPSocket::sendThroughQueue(
+    const folly::SocketAddress& address,
+    const folly::IOBuf& buf,
+    int gso) {
+  auto len = buf.computeChainDataLength();
+  size_t segmentSize = gso > 0 ? static_cast<size_t>(gso) : len;
+  size_t numSegments =
+      segmentSize > 0 ? (len + segmentSize - 1) / segmentSize : 1;
+  if (!queue_->canSend(address, numSegments, segmentSize)) {
+    return false;
+  }
+  folly::io::Cursor cursor(&buf);
+  size_t sent = 0;
+  do {
+    auto segment = std::min(segmentSize, len - sent);
+    queue_->send(this->address(), address, cursor, segment);
+    sent += segment;
+  } while (sent < len);
+  return true;
+}
+
+ssize_t QuicXdpUDPSocket::write(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>& buf) {
+  if (sendThroughQueue(address, *buf, 0)) {
+    return buf->computeChainDataLength();
+  }
+  return folly::AsyncUDPSocket::write(address, buf);
+}
+
+int QuicXdpUDPSocket::writem(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>* bufs,
+    size_t count) {
+  size_t maxLen = 0;
+  for (size_t i = 0; i < count; ++i) {
+    maxLen = std::max(maxLen, bufs[i]->computeChainDataLength());
+  }
+  if (!queue_->canSend(address, count, maxLen)) {
+    return folly::AsyncUDPSocket::writem(address, bufs, count);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    sendThroughQueue(address, *bufs[i], 0);
+  }
+  return count;
+}
+
+ssize_t QuicXdpUDPSocket::writeGSO(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>& buf,
+    int gso) {
+  if (sendThroughQueue(address, *buf, gso)) {
+    return buf->computeChainDataLength();
+  }
+  return folly::AsyncUDPSocket::writeGSO(address, buf, gso);
+}
+
+} // namespace quic
+
+#endif
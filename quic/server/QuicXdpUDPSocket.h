@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#if MVFST_HAVE_LIBXDP
+
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventHandler.h>
+#include <quic/server/QuicDatagramReadCallback.h>
+#include <quic/server/QuicXdpFrame.h>
+#include <xdp/xsk.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace quic {
+
+/**
+ * An AF_XDP socket bound to one queue of a NIC, with its UMEM, shared by all
+ * the QuicXdpUDPSockets of an EventBase. It must only be used on the thread
+ * of that EventBase.
+ *
+ * The first half of the UMEM frames receive, the other half send. Received
+ * datagrams are handed to QuicDatagramReadCallbacks in buffers pointing into
+ * their UMEM frame, which goes back to the fill ring once the buffer is
+ * freed, from any thread. While half of the receive frames are held by such
+ * buffers, datagrams are copied instead, so the fill ring never runs dry.
+ *
+ * Frames are expected to be steered to the queue by the NIC, e.g. with an
+ * ethtool ntuple rule on the UDP port of the server, and then redirected to
+ * the socket by the default program libxdp loads on the interface.
+ */
+class QuicXdpQueue : public folly::EventHandler {
+ public:
+  struct Options {
+    // interface and queue the socket binds to
+    std::string ifname;
+    uint32_t queueId{0};
+    // number of frames in the UMEM, and their size
+    uint32_t numFrames{4096};
+    uint32_t frameSize{XSK_UMEM__DEFAULT_FRAME_SIZE};
+    // size of each of the rings
+    uint32_t ringSize{XSK_RING_CONS__DEFAULT_NUM_DESCS};
+    // asks for zero-copy mode, which fails if the driver doesn't support it
+    bool zeroCopy{false};
+    // most datagrams read from the receive ring at a time
+    uint32_t rxBatchSize{64};
+  };
+
+  QuicXdpQueue(folly::EventBase* evb, Options options);
+  ~QuicXdpQueue() override;
+
+  /**
+   * Delivers the datagrams to the port of local to cb, or stops delivering
+   * them if cb is null. IPv4 peers are reported as mapped addresses if
+   * local is an IPv6 address, like a dual stack socket does.
+   */
+  void setReadCallback(
+      folly::AsyncUDPSocket::ReadCallback* cb,
+      const folly::SocketAddress& local);
+
+  /**
+   * Sends the next len bytes of payload from local to peer. Returns false if
+   * it can't, because no frame from the peer's address family was received
+   * yet to learn the link from, or no send frame is free.
+   */
+  bool send(
+      const folly::SocketAddress& local,
+      const folly::SocketAddress& peer,
+      folly::io::Cursor& payload,
+      size_t len);
+
+  // Whether numDatagrams of up to len bytes can be sent to peer right now.
+  bool canSend(
+      const folly::SocketAddress& peer,
+      size_t numDatagrams,
+      size_t len);
+
+  void handlerReady(uint16_t events) noexcept override;
+
+ private:
+  // The UMEM and its fill and completion rings. Buffers of received frames
+  // hold a reference to it, so it can outlive the queue.
+  struct Umem {
+    uint8_t* area{nullptr};
+    size_t size{0};
+    uint32_t frameSize{0};
+    xsk_umem* umem{nullptr};
+    xsk_ring_prod fill;
+    xsk_ring_cons completion;
+    std::atomic<size_t> refs{1};
+    // Receive frames handed out in buffers.
+    std::atomic<size_t> outstanding{0};
+    // Receive frames whose buffers were freed, waiting for the fill ring.
+    std::mutex mutex;
+    std::vector<uint64_t> returned;
+
+    ~Umem();
+    void release();
+  };
+
+  // MAC addresses and local IP learned from the frames received, one for
+  // each address family.
+  struct Link {
+    bool known{false};
+    MacAddress localMac;
+    MacAddress gatewayMac;
+    folly::IPAddress localIp;
+  };
+
+  class KickCallback : public folly::EventBase::LoopCallback {
+   public:
+    explicit KickCallback(QuicXdpQueue& queue) : queue_(queue) {}
+    void runLoopCallback() noexcept override {
+      queue_.kick();
+    }
+
+   private:
+    QuicXdpQueue& queue_;
+  };
+
+  static void freeRxFrame(void* buf, void* userData);
+
+  void receive();
+  void deliver(uint64_t addr, uint32_t len);
+  void refill();
+  void reapCompletions();
+  void kick();
+  Link& getLink(const folly::SocketAddress& addr);
+
+  folly::EventBase* evb_;
+  Options options_;
+  Umem* umem_{nullptr};
+  xsk_socket* xsk_{nullptr};
+  xsk_ring_cons rx_;
+  xsk_ring_prod tx_;
+  int fd_{-1};
+  uint32_t numRxFrames_{0};
+  std::vector<uint64_t> freeRxFrames_;
+  std::vector<uint64_t> freeTxFrames_;
+  Link v4Link_;
+  Link v6Link_;
+  folly::AsyncUDPSocket::ReadCallback* readCallback_{nullptr};
+  QuicDatagramReadCallback* datagramCallback_{nullptr};
+  folly::SocketAddress local_;
+  KickCallback kickCallback_;
+};
+
+/**
+ * AsyncUDPSocket that sends and receives through a QuicXdpQueue, bypassing
+ * the kernel's UDP stack.
+ *
+ * The socket is still bound like a regular UDP socket. That reserves the
+ * port, and datagrams the NIC doesn't steer to the queue are read from it
+ * as usual. Writes go through the kernel socket as well until a datagram
+ * of the peer's address family came in through the queue, since the MAC
+ * addresses of frames sent are those of the frames received: the ones of
+ * the interface and of the gateway in the way of all the peers.
+ */
+class QuicXdpUDPSocket : public folly::AsyncUDPSocket {
+ public:
+  QuicXdpUDPSocket(folly::EventBase* evb, std::shared_ptr<QuicXdpQueue> queue);
+  ~QuicXdpUDPSocket() override;
+
+  void resumeRead(ReadCallback* cob) override;
+  void pauseRead() override;
+
+  ssize_t write(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf) override;
+  int writem(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>* bufs,
+      size_t count) override;
+  ssize_t writeGSO(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf,
+      int gso) override;
+
+ private:
+  // Sends buf in datagrams of at most gso bytes through the queue, if it can
+  // send all of them.
+  bool sendThroughQueue(
+      const folly::SocketAddress& address,
+      const folly::IOBuf& buf,
+      int gso);
+
+  std::shared_ptr<QuicXdpQueue> queue_;
+  bool queueReading_{false};
+};
+
+} // namespace quic
+
+#endif
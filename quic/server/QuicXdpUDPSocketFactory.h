@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#if MVFST_HAVE_LIBXDP
+
+#include <quic/server/QuicUDPSocketFactory.h>
+#include <quic/server/QuicXdpUDPSocket.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace quic {
+
+/**
+ * Creates AF_XDP backed sockets. Each EventBase gets a QuicXdpQueue of its
+ * own, on the queue after the ones of the EventBases before it, starting at
+ * the queueId of the options. It can be used both as the listener socket
+ * factory, when fd is -1, and as the new connection socket factory, in which
+ * case the sockets share the listening fd.
+ */
+class QuicXdpUDPSocketFactory : public QuicUDPSocketFactory {
+ public:
+  explicit QuicXdpUDPSocketFactory(QuicXdpQueue::Options options)
+      : options_(std::move(options)) {}
+  ~QuicXdpUDPSocketFactory() override {}
+
+  std::unique_ptr<folly::AsyncUDPSocket> make(folly::EventBase* evb, int fd)
+      override {
+    auto sock = std::make_unique<QuicXdpUDPSocket>(evb, getQueue(evb));
+    if (fd != -1) {
+      sock->setFD(
+          folly::NetworkSocket::fromFd(fd),
+          folly::AsyncUDPSocket::FDOwnership::SHARED);
+      sock->dontFragment(true);
+    } else {
+      sock->setReusePort(true);
+    }
+    return sock;
+  }
+
+ private:
+  struct EvbQueue {
+    std::weak_ptr<QuicXdpQueue> queue;
+    uint32_t queueId;
+  };
+
+  std::shared_ptr<QuicXdpQueue> getQueue(folly::EventBase* evb) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = queues_.find(evb);
+    if (it == queues_.end()) {
+      uint32_t queueId = options_.queueId + queues_.size();
+      it = queues_.emplace(evb, EvbQueue{{}, queueId}).first;
+    }
+    auto queue = it->second.queue.lock();
+    if (!queue) {
+      auto options = options_;
+      options.queueId = it->second.queueId;
+      queue = std::make_shared<QuicXdpQueue>(evb, std::move(options));
+      it->second.queue = queue;
+    }
+    return queue;
+  }
+
+  QuicXdpQueue::Options options_;
+  std::mutex mutex_;
+  std::unordered_map<folly::EventBase*, EvbQueue> queues_;
+};
+} // namespace quic
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/TransportProfile.h>
+
+#include <folly/lang/Assume.h>
+
+#include <algorithm>
+
+namespace quic {
+
+folly::StringPiece toString(TransportProfile profile) {
+  switch (profile) {
+    case TransportProfile::Default:
+      return "Default";
+    case TransportProfile::Interactive:
+      return "Interactive";
+    case TransportProfile::Bulk:
+      return "Bulk";
+    case TransportProfile::Mobile:
+      return "Mobile";
+  }
+  folly::assume_unreachable();
+}
+
+TransportProfile selectTransportProfile(
+    const folly::Optional<CachedCongestionState>& cached) {
+  if (!cached) {
+    return TransportProfile::Default;
+  }
+  if (cached->srtt >= kMobileProfileMinRtt ||
+      cached->rttvar * 2 >= cached->srtt) {
+    return TransportProfile::Mobile;
+  }
+  if (cached->cwndBytes >= kBulkProfileMinCwndBytes) {
+    return TransportProfile::Bulk;
+  }
+  return TransportProfile::Interactive;
+}
+
+void applyTransportProfile(
+    TransportSettings& settings,
+    TransportProfile profile) {
+  switch (profile) {
+    case TransportProfile::Default:
+      return;
+    case TransportProfile::Interactive:
+      settings.defaultCongestionController = CongestionControlType::Copa;
+      settings.pacingEnabled = true;
+      settings.ackFrequencyEnabled = false;
+      settings.deferWindowUpdates = false;
+      settings.batchingMode = QuicBatchingMode::BATCHING_MODE_NONE;
+      return;
+    case TransportProfile::Bulk:
+      settings.defaultCongestionController = CongestionControlType::BBR;
+      settings.pacingEnabled = true;
+      settings.ackFrequencyEnabled = true;
+      settings.autotuneReceiveWindow = true;
+      settings.advertisedInitialConnectionWindowSize = std::min(
+          settings.advertisedInitialConnectionWindowSize *
+              kBulkProfileWindowMultiplier,
+          std::max(
+              settings.maxReceiveConnectionWindowSize,
+              settings.advertisedInitialConnectionWindowSize));
+      for (auto window :
+           {&settings.advertisedInitialBidiLocalStreamWindowSize,
+            &settings.advertisedInitialBidiRemoteStreamWindowSize,
+            &settings.advertisedInitialUniStreamWindowSize}) {
+        *window = std::min(
+            *window * kBulkProfileWindowMultiplier,
+            std::max(settings.maxReceiveStreamWindowSize, *window));
+      }
+      if (settings.batchingMode == QuicBatchingMode::BATCHING_MODE_NONE) {
+        settings.batchingMode = QuicBatchingMode::BATCHING_MODE_SENDMMSG;
+      }
+      return;
+    case TransportProfile::Mobile:
+      settings.defaultCongestionController = CongestionControlType::BBR;
+      settings.pacingEnabled = true;
+      settings.ackFrequencyEnabled = false;
+      return;
+  }
+}
+
+} // namespace quic
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/server/CongestionStateCache.h>
+#include <quic/state/TransportSettings.h>
+
+#include <folly/Optional.h>
+
+namespace quic {
+
+/**
+ * Bundles of transport settings for the kind of path a new connection is
+ * on. The server worker picks one before it hands the settings to the
+ * transport, see TransportSettings::transportProfilesEnabled.
+ */
+enum class TransportProfile : uint8_t {
+  // The settings as configured.
+  Default,
+  // Short and stable path, the connection keeps its latency low: delay
+  // based congestion control, acks right away, no batching.
+  Interactive,
+  // Known large window: BBR with pacing, fewer acks, larger receive windows
+  // that grow on their own and batched writes.
+  Bulk,
+  // Long or jittery path, e.g. a cellular network: BBR with pacing, which
+  // doesn't back off on every loss, and acks right away.
+  Mobile,
+};
+
+folly::StringPiece toString(TransportProfile profile);
+
+/**
+ * Picks the profile of a connection from the path state of earlier
+ * connections from the same subnet, Default if there aren't any.
+ */
+TransportProfile selectTransportProfile(
+    const folly::Optional<CachedCongestionState>& cached);
+
+/**
+ * Applies profile on top of settings.
+ */
+void applyTransportProfile(
+    TransportSettings& settings,
+    TransportProfile profile);
+
+} // namespace quic
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/WorkerLoadReporter.h>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+void WorkerLoadReporter::start(
+    folly::EventBase* evb,
+    std::chrono::milliseconds interval) {
+  CHECK_GT(interval.count(), 0);
+  evb_ = evb;
+  interval_ = interval;
+  lastSampleTime_ = Clock::now();
+  bytesReceived_ = 0;
+  evb_->timer().scheduleTimeout(this, interval_);
+}
+
+void WorkerLoadReporter::sample() {
+  CHECK(evb_);
+  auto now = Clock::now();
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      now - lastSampleTime_);
+  if (elapsed.count() > 0) {
+    bytesPerSecond_.store(bytesReceived_ * 1000000 / elapsed.count());
+  }
+  lastSampleTime_ = now;
+  bytesReceived_ = 0;
+  loopLatencyUs_.store(static_cast<uint64_t>(evb_->getAvgLoopTime()));
+  sampledNumConnections_.store(numConnections_);
+  if (sampleCallback_) {
+    sampleCallback_();
+  }
+}
+
+WorkerLoad WorkerLoadReporter::getLoad() const {
+  WorkerLoad load;
+  load.loopLatency = std::chrono::microseconds(loopLatencyUs_.load());
+  load.numConnections = sampledNumConnections_.load();
+  load.bytesPerSecond = bytesPerSecond_.load();
+  return load;
+}
+
+void WorkerLoadReporter::timeoutExpired() noexcept {
+  sample();
+  evb_->timer().scheduleTimeout(this, interval_);
+}
+
+} // namespace quic
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/HHWheelTimer.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+namespace quic {
+
+/**
+ * Load of a server worker, as of its last sample.
+ */
+struct WorkerLoad {
+  // Average time the worker's event base spends on a loop iteration.
+  std::chrono::microseconds loopLatency{0};
+  uint64_t numConnections{0};
+  // Bytes received per second over the last sample interval.
+  uint64_t bytesPerSecond{0};
+};
+
+/**
+ * Samples the load of a worker every interval on the worker's thread, and
+ * publishes it so that it can be read from any thread, e.g. by another
+ * worker looking for where to create a new connection.
+ */
+class WorkerLoadReporter : private folly::HHWheelTimer::Callback {
+ public:
+  WorkerLoadReporter() = default;
+
+  ~WorkerLoadReporter() override = default;
+
+  // Starts sampling, on the worker's thread. The load is all zeros until then.
+  void start(folly::EventBase* evb, std::chrono::milliseconds interval);
+
+  // Called on the worker's thread.
+  void onBytesReceived(uint64_t bytes) {
+    bytesReceived_ += bytes;
+  }
+
+  // Called on the worker's thread.
+  void onConnectionAdded() {
+    numConnections_++;
+  }
+
+  // Called on the worker's thread.
+  void onConnectionRemoved() {
+    if (numConnections_ > 0) {
+      numConnections_--;
+    }
+  }
+
+  /**
+   * Takes a sample now, on the worker's thread. The timer calls this every
+   * interval.
+   */
+  void sample();
+
+  // Thread safe.
+  WorkerLoad getLoad() const;
+
+  // Called on the worker's thread after each sample.
+  void setSampleCallback(std::function<void()> callback) {
+    sampleCallback_ = std::move(callback);
+  }
+
+ private:
+  void timeoutExpired() noexcept override;
+
+  void callbackCanceled() noexcept override {
+    // The event base is going away.
+  }
+
+  folly::EventBase* evb_{nullptr};
+  std::chrono::milliseconds interval_{0};
+  TimePoint lastSampleTime_;
+  uint64_t bytesReceived_{0};
+  uint64_t numConnections_{0};
+  std::function<void()> sampleCallback_;
+
+  // The last sample.
+  std::atomic<uint64_t> loopLatencyUs_{0};
+  std::atomic<uint64_t> sampledNumConnections_{0};
+  std::atomic<uint64_t> bytesPerSecond_{0};
+};
+
+} // namespace quic
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/WorkerTraceLogger.h>
+
+#include <folly/json.h>
+#include <quic/codec/Types.h>
+
+#include <algorithm>
+
+namespace quic {
+
+WorkerTraceLogger::WorkerTraceLogger(
+    std::shared_ptr<QLogWriter> writer,
+    uint8_t workerId,
+    uint32_t sampleRate)
+    : writer_(std::move(writer)),
+      workerId_(workerId),
+      sampleRate_(std::max(sampleRate, 1u)) {}
+
+bool WorkerTraceLogger::sample() {
+  return eventsSeen_++ % sampleRate_ == 0;
+}
+
+void WorkerTraceLogger::onPacketDropped(
+    PacketDropReason reason,
+    const folly::SocketAddress& peer,
+    const ConnectionId* dstConnId) {
+  dropCounts_[static_cast<size_t>(reason)]++;
+  if (!sample()) {
+    return;
+  }
+  folly::dynamic data = folly::dynamic::object();
+  data["drop_reason"] = QuicTransportStatsCallback::toString(reason);
+  data["peer"] = peer.describe();
+  if (dstConnId) {
+    data["dcid"] = dstConnId->hex();
+  }
+  writeEvent("packet_dropped", std::move(data));
+}
+
+void WorkerTraceLogger::onPacketRouted(
+    const folly::SocketAddress& peer,
+    const ConnectionId& dstConnId,
+    uint8_t toWorkerId) {
+  if (!sample()) {
+    return;
+  }
+  folly::dynamic data = folly::dynamic::object();
+  data["peer"] = peer.describe();
+  data["dcid"] = dstConnId.hex();
+  data["to_worker"] = toWorkerId;
+  writeEvent("packet_routed", std::move(data));
+}
+
+void WorkerTraceLogger::onPacketForwarded(
+    const folly::SocketAddress& peer,
+    const ConnectionId* dstConnId) {
+  if (!sample()) {
+    return;
+  }
+  folly::dynamic data = folly::dynamic::object();
+  data["peer"] = peer.describe();
+  if (dstConnId) {
+    data["dcid"] = dstConnId->hex();
+  }
+  writeEvent("packet_forwarded", std::move(data));
+}
+
+void WorkerTraceLogger::onVersionNegotiation(
+    const folly::SocketAddress& peer,
+    QuicVersion clientVersion) {
+  if (!sample()) {
+    return;
+  }
+  folly::dynamic data = folly::dynamic::object();
+  data["peer"] = peer.describe();
+  data["client_version"] = toString(clientVersion);
+  writeEvent("version_negotiation", std::move(data));
+}
+
+void WorkerTraceLogger::writeDropCounts() {
+  folly::dynamic data = folly::dynamic::object();
+  for (size_t i = 0; i < dropCounts_.size(); i++) {
+    if (dropCounts_[i] > 0) {
+      data[QuicTransportStatsCallback::toString(
+          static_cast<PacketDropReason>(i))] = dropCounts_[i];
+    }
+  }
+  writeEvent("drop_counts", std::move(data));
+}
+
+void WorkerTraceLogger::writeEvent(
+    folly::StringPiece eventType,
+    folly::dynamic data) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint_);
+  folly::dynamic line = folly::dynamic::object;
+  line["worker"] = workerId_;
+  line["event"] = folly::dynamic::array(
+      folly::to<std::string>(refTime.count()),
+      "worker",
+      eventType,
+      std::move(data));
+  writer_->write(folly::toJson(line));
+}
+
+} // namespace quic
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/SocketAddress.h>
+#include <folly/dynamic.h>
+#include <quic/codec/QuicConnectionId.h>
+#include <quic/logging/StreamingQLogger.h>
+#include <quic/state/QuicTransportStatsCallback.h>
+
+#include <array>
+
+namespace quic {
+
+/**
+ * Logs what a server worker does with the packets it reads before, or
+ * instead of, handing them to a transport: routing them to another worker,
+ * forwarding them to another process on takeover, answering with version
+ * negotiation, or dropping them. Loss that happens there never shows up in
+ * the qlog of a connection.
+ *
+ * Events go to a QLogWriter one JSON object per line, in the event format
+ * of StreamingQLogger with the worker instead of the connection ids:
+ *   {"worker":1,"event":[relative_time,"worker",event_type,{...}]}
+ * One event in sampleRate is written. Drops are counted by reason whether
+ * their event is sampled or not, and the counts are written with
+ * writeDropCounts, e.g. when the worker shuts down.
+ *
+ * Used from the thread of its worker only.
+ */
+class WorkerTraceLogger {
+ public:
+  using PacketDropReason = QuicTransportStatsCallback::PacketDropReason;
+
+  WorkerTraceLogger(
+      std::shared_ptr<QLogWriter> writer,
+      uint8_t workerId,
+      uint32_t sampleRate = 1);
+
+  virtual ~WorkerTraceLogger() = default;
+
+  void onPacketDropped(
+      PacketDropReason reason,
+      const folly::SocketAddress& peer,
+      const ConnectionId* dstConnId = nullptr);
+
+  void onPacketRouted(
+      const folly::SocketAddress& peer,
+      const ConnectionId& dstConnId,
+      uint8_t toWorkerId);
+
+  // Forwarded to another process, see TakeoverPacketHandler.
+  void onPacketForwarded(
+      const folly::SocketAddress& peer,
+      const ConnectionId* dstConnId = nullptr);
+
+  void onVersionNegotiation(
+      const folly::SocketAddress& peer,
+      QuicVersion clientVersion);
+
+  void writeDropCounts();
+
+  uint64_t droppedPackets(PacketDropReason reason) const {
+    return dropCounts_[static_cast<size_t>(reason)];
+  }
+
+ protected:
+  // Writes the event, virtual for tests.
+  virtual void writeEvent(folly::StringPiece eventType, folly::dynamic data);
+
+ private:
+  bool sample();
+
+  std::shared_ptr<QLogWriter> writer_;
+  uint8_t workerId_;
+  uint32_t sampleRate_;
+  uint64_t eventsSeen_{0};
+  std::chrono::steady_clock::time_point refTimePoint_{
+      std::chrono::steady_clock::now()};
+  std::array<uint64_t, static_cast<size_t>(PacketDropReason::MAX) + 1>
+      dropCounts_{};
+};
+
+class WorkerTraceLoggerFactory {
+ public:
+  virtual ~WorkerTraceLoggerFactory() = default;
+
+  // Called once per worker, each worker needs a QLogWriter of its own.
+  virtual std::unique_ptr<WorkerTraceLogger> make(uint8_t workerId) = 0;
+};
+
+} // namespace quic
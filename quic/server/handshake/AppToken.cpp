@@ -67,6 +67,13 @@ fizz::Buf encodeAppToken(const AppToken& appToken) {
     fizz::detail::write(appToken.version.value(), appender);
   }
   fizz::detail::writeBuf<uint16_t>(appToken.appParams, appender);
+  if (appToken.congestionState) {
+    DCHECK(appToken.version);
+    fizz::detail::write<uint64_t>(
+        appToken.congestionState->minRtt.count(), appender);
+    fizz::detail::write(appToken.congestionState->cwndBytes, appender);
+    fizz::detail::write(appToken.congestionState->issueTime, appender);
+  }
   return buf;
 }
 
@@ -88,6 +95,16 @@ folly::Optional<AppToken> decodeAppToken(const folly::IOBuf& buf) {
     fizz::detail::read(v, cursor);
     appToken.version = v;
     fizz::detail::readBuf<uint16_t>(appToken.appParams, cursor);
+    if (cursor.isAtEnd()) {
+      return appToken;
+    }
+    TicketCongestionState congestionState;
+    uint64_t minRtt;
+    fizz::detail::read(minRtt, cursor);
+    congestionState.minRtt = std::chrono::microseconds(minRtt);
+    fizz::detail::read(congestionState.cwndBytes, cursor);
+    fizz::detail::read(congestionState.issueTime, cursor);
+    appToken.congestionState = congestionState;
   } catch (const std::exception& ex) {
     return folly::none;
   }
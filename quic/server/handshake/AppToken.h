@@ -15,6 +15,7 @@
 #include <folly/IPAddress.h>
 #include <folly/Optional.h>
 
+#include <chrono>
 #include <cstdint>
 #include <vector>
 
@@ -30,11 +31,21 @@ class IOBuf;
 
 namespace quic {
 
+// Path state of the connection that issued a ticket, for careful resume.
+struct TicketCongestionState {
+  std::chrono::microseconds minRtt{0us};
+  uint64_t cwndBytes{0};
+  // Seconds since the epoch of the system clock, which unlike Clock is the
+  // same across server restarts.
+  uint64_t issueTime{0};
+};
+
 struct AppToken {
   TicketTransportParameters transportParams;
   std::vector<folly::IPAddress> sourceAddresses;
   folly::Optional<QuicVersion> version;
   Buf appParams;
+  folly::Optional<TicketCongestionState> congestionState;
 };
 
 TicketTransportParameters createTicketTransportParameters(
@@ -143,6 +143,18 @@ bool DefaultAppTokenValidator::validate(
     return false;
   }
 
+  if (conn_->transportSettings.carefulResumeEnabled &&
+      appToken->congestionState) {
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    auto issueTime = std::chrono::seconds(appToken->congestionState->issueTime);
+    if (issueTime <= now && now - issueTime <= kCarefulResumeMaxTicketAge) {
+      conn_->ticketCongestionState = appToken->congestionState;
+    } else {
+      VLOG(10) << "Stale congestion state in the ticket";
+    }
+  }
+
   // If application has set validator and the token is invalid, reject 0-RTT.
   // If application did not set validator, it's valid.
   if (earlyDataAppParamsValidator_ &&
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/PrecompressedCertCache.h>
+
+#include <folly/Format.h>
+#include <quic/handshake/CertCompression.h>
+
+namespace quic {
+
+PrecompressedSelfCert::PrecompressedSelfCert(
+    std::shared_ptr<const fizz::SelfCert> cert,
+    const std::vector<std::shared_ptr<fizz::CertificateCompressor>>&
+        compressors)
+    : cert_(std::move(cert)) {
+  auto certMsg = cert_->getCertMessage();
+  for (const auto& compressor : compressors) {
+    compressedCerts_.emplace(
+        compressor->getAlgorithm(), compressor->compress(certMsg));
+  }
+}
+
+std::string PrecompressedSelfCert::getIdentity() const {
+  return cert_->getIdentity();
+}
+
+folly::ssl::X509UniquePtr PrecompressedSelfCert::getX509() const {
+  return cert_->getX509();
+}
+
+std::vector<std::string> PrecompressedSelfCert::getAltIdentities() const {
+  return cert_->getAltIdentities();
+}
+
+std::vector<fizz::SignatureScheme> PrecompressedSelfCert::getSigSchemes()
+    const {
+  return cert_->getSigSchemes();
+}
+
+fizz::CertificateMsg PrecompressedSelfCert::getCertMessage(
+    fizz::Buf certificateRequestContext) const {
+  return cert_->getCertMessage(std::move(certificateRequestContext));
+}
+
+fizz::CompressedCertificate PrecompressedSelfCert::getCompressedCert(
+    fizz::CertificateCompressionAlgorithm algo) const {
+  auto it = compressedCerts_.find(algo);
+  if (it == compressedCerts_.end()) {
+    throw std::runtime_error(folly::sformat(
+        "certificate not compressed with algorithm {}",
+        static_cast<uint16_t>(algo)));
+  }
+  fizz::CompressedCertificate compressedCert;
+  compressedCert.algorithm = it->second.algorithm;
+  compressedCert.uncompressed_length = it->second.uncompressed_length;
+  compressedCert.compressed_certificate_message =
+      it->second.compressed_certificate_message->clone();
+  return compressedCert;
+}
+
+fizz::Buf PrecompressedSelfCert::sign(
+    fizz::SignatureScheme scheme,
+    fizz::CertificateVerifyContext context,
+    folly::ByteRange toBeSigned) const {
+  return cert_->sign(scheme, context, toBeSigned);
+}
+
+PrecompressedCertCache::PrecompressedCertCache()
+    : PrecompressedCertCache(makeDefaultCertCompressors()) {}
+
+PrecompressedCertCache::PrecompressedCertCache(
+    std::vector<std::shared_ptr<fizz::CertificateCompressor>> compressors)
+    : compressors_(std::move(compressors)),
+      certManager_(std::make_shared<fizz::server::CertManager>()) {}
+
+std::shared_ptr<fizz::SelfCert> PrecompressedCertCache::getCompressedCert(
+    const std::shared_ptr<const fizz::SelfCert>& cert) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& compressedCert = compressedCerts_[cert.get()];
+  if (!compressedCert) {
+    compressedCert =
+        std::make_shared<PrecompressedSelfCert>(cert, compressors_);
+  }
+  return compressedCert;
+}
+
+void PrecompressedCertCache::addCert(
+    const std::shared_ptr<const fizz::SelfCert>& cert,
+    bool defaultCert) {
+  certManager_->addCert(getCompressedCert(cert), defaultCert);
+}
+
+std::vector<fizz::CertificateCompressionAlgorithm>
+PrecompressedCertCache::getAlgorithms() const {
+  std::vector<fizz::CertificateCompressionAlgorithm> algorithms;
+  for (const auto& compressor : compressors_) {
+    algorithms.push_back(compressor->getAlgorithm());
+  }
+  return algorithms;
+}
+
+std::shared_ptr<fizz::server::CertManager>
+PrecompressedCertCache::getCertManager() const {
+  return certManager_;
+}
+
+void PrecompressedCertCache::apply(
+    fizz::server::FizzServerContext& ctx) const {
+  ctx.setCertManager(certManager_);
+  ctx.setSupportedCompressionAlgorithms(getAlgorithms());
+}
+
+} // namespace quic
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <fizz/compression/CertificateCompressor.h>
+#include <fizz/protocol/Certificate.h>
+#include <fizz/server/CertManager.h>
+#include <fizz/server/FizzServerContext.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace quic {
+
+/**
+ * SelfCert whose certificate chain is compressed once, at construction, with
+ * each of the compressors. The handshakes get a copy of the compressed chain
+ * instead of compressing it again. Everything else is the wrapped cert's.
+ */
+class PrecompressedSelfCert : public fizz::SelfCert {
+ public:
+  PrecompressedSelfCert(
+      std::shared_ptr<const fizz::SelfCert> cert,
+      const std::vector<std::shared_ptr<fizz::CertificateCompressor>>&
+          compressors);
+
+  ~PrecompressedSelfCert() override = default;
+
+  std::string getIdentity() const override;
+
+  folly::ssl::X509UniquePtr getX509() const override;
+
+  std::vector<std::string> getAltIdentities() const override;
+
+  std::vector<fizz::SignatureScheme> getSigSchemes() const override;
+
+  fizz::CertificateMsg getCertMessage(
+      fizz::Buf certificateRequestContext = nullptr) const override;
+
+  /**
+   * Throws if the chain wasn't compressed with algo. The server only
+   * negotiates the algorithms of the cache the cert comes from.
+   */
+  fizz::CompressedCertificate getCompressedCert(
+      fizz::CertificateCompressionAlgorithm algo) const override;
+
+  fizz::Buf sign(
+      fizz::SignatureScheme scheme,
+      fizz::CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override;
+
+ private:
+  std::shared_ptr<const fizz::SelfCert> cert_;
+  std::map<fizz::CertificateCompressionAlgorithm, fizz::CompressedCertificate>
+      compressedCerts_;
+};
+
+/**
+ * The precompressed certificates of one FizzServerContext, and the cert
+ * manager they are served from.
+ *
+ * Each cert is compressed once with every compressor, adding it again reuses
+ * the compressed chains. apply() sets the manager and the compression
+ * algorithms on the context. The per connection copies of the context that
+ * ServerHandshake makes share the manager, so the compression cost is paid
+ * once per certificate rather than per handshake.
+ */
+class PrecompressedCertCache {
+ public:
+  // Compresses with makeDefaultCertCompressors().
+  PrecompressedCertCache();
+
+  explicit PrecompressedCertCache(
+      std::vector<std::shared_ptr<fizz::CertificateCompressor>> compressors);
+
+  // The precompressed version of cert, compressing it on the first call.
+  std::shared_ptr<fizz::SelfCert> getCompressedCert(
+      const std::shared_ptr<const fizz::SelfCert>& cert);
+
+  // Adds the precompressed version of cert to the cert manager.
+  void addCert(
+      const std::shared_ptr<const fizz::SelfCert>& cert,
+      bool defaultCert = false);
+
+  std::vector<fizz::CertificateCompressionAlgorithm> getAlgorithms() const;
+
+  std::shared_ptr<fizz::server::CertManager> getCertManager() const;
+
+  // Serves ctx's certs from the cache and offers its algorithms.
+  void apply(fizz::server::FizzServerContext& ctx) const;
+
+ private:
+  std::vector<std::shared_ptr<fizz::CertificateCompressor>> compressors_;
+  std::shared_ptr<fizz::server::CertManager> certManager_;
+
+  std::mutex mutex_;
+  std::unordered_map<
+      const fizz::SelfCert*,
+      std::shared_ptr<PrecompressedSelfCert>>
+      compressedCerts_;
+};
+
+} // namespace quic
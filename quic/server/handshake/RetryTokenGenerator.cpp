@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/RetryTokenGenerator.h>
+
+#include <fizz/crypto/Hkdf.h>
+#include <fizz/crypto/Sha256.h>
+#include <folly/Random.h>
+#include <folly/io/Cursor.h>
+#include <quic/handshake/FizzBridge.h>
+#include <quic/handshake/QuicFizzFactory.h>
+
+namespace {
+constexpr folly::StringPiece kSalt{"Retry token"};
+constexpr folly::StringPiece kKeyInfo{"key"};
+constexpr folly::StringPiece kIvInfo{"iv"};
+
+std::unique_ptr<folly::IOBuf> addressData(const folly::IPAddress& address) {
+  return folly::IOBuf::wrapBuffer(address.bytes(), address.byteCount());
+}
+} // namespace
+
+namespace quic {
+
+RetryTokenGenerator::RetryTokenGenerator(
+    RetryTokenSecret secret,
+    std::chrono::seconds lifetime)
+    : lifetime_(lifetime) {
+  fizz::HkdfImpl<fizz::Sha256> hkdf;
+  auto extractedSecret = hkdf.extract(kSalt, folly::range(secret));
+  QuicFizzFactory factory;
+  auto aead = factory.makeAead(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
+  auto key = hkdf.expand(
+      folly::range(extractedSecret),
+      *folly::IOBuf::copyBuffer(kKeyInfo),
+      aead->keyLength());
+  auto iv = hkdf.expand(
+      folly::range(extractedSecret),
+      *folly::IOBuf::copyBuffer(kIvInfo),
+      aead->ivLength());
+  aead->setKey(fizz::TrafficKey{std::move(key), std::move(iv)});
+  cipher_ = FizzAead::wrap(std::move(aead));
+}
+
+Buf RetryTokenGenerator::encryptToken(
+    const folly::IPAddress& clientIp,
+    const ConnectionId& originalDstConnId,
+    std::chrono::system_clock::time_point now) const {
+  auto plaintext = folly::IOBuf::create(
+      sizeof(uint64_t) + sizeof(uint8_t) + originalDstConnId.size());
+  folly::io::Appender appender(plaintext.get(), 0);
+  appender.writeBE<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          now.time_since_epoch())
+          .count());
+  appender.writeBE<uint8_t>(originalDstConnId.size());
+  appender.push(originalDstConnId.data(), originalDstConnId.size());
+
+  uint64_t seqNum = folly::Random::secureRand64();
+  auto associatedData = addressData(clientIp);
+  auto token = folly::IOBuf::create(sizeof(seqNum));
+  folly::io::Appender(token.get(), 0).writeBE<uint64_t>(seqNum);
+  token->prependChain(
+      cipher_->encrypt(std::move(plaintext), associatedData.get(), seqNum));
+  return token;
+}
+
+folly::Optional<ConnectionId> RetryTokenGenerator::decryptToken(
+    Buf token,
+    const folly::IPAddress& clientIp,
+    std::chrono::system_clock::time_point now) const {
+  folly::io::Cursor cursor(token.get());
+  if (!cursor.canAdvance(sizeof(uint64_t) + cipher_->getCipherOverhead())) {
+    return folly::none;
+  }
+  auto seqNum = cursor.readBE<uint64_t>();
+  Buf ciphertext;
+  cursor.clone(ciphertext, cursor.totalLength());
+  auto associatedData = addressData(clientIp);
+  auto plaintext = cipher_->tryDecrypt(
+      std::move(ciphertext), associatedData.get(), seqNum);
+  if (!plaintext) {
+    return folly::none;
+  }
+
+  folly::io::Cursor plaintextCursor(plaintext->get());
+  if (!plaintextCursor.canAdvance(sizeof(uint64_t) + sizeof(uint8_t))) {
+    return folly::none;
+  }
+  std::chrono::system_clock::time_point issueTime(std::chrono::milliseconds(
+      plaintextCursor.readBE<uint64_t>()));
+  if (issueTime > now || now - issueTime > lifetime_) {
+    return folly::none;
+  }
+  auto connIdLen = plaintextCursor.readBE<uint8_t>();
+  if (connIdLen > kMaxConnectionIdSize ||
+      !plaintextCursor.canAdvance(connIdLen)) {
+    return folly::none;
+  }
+  return ConnectionId(plaintextCursor, connIdLen);
+}
+
+} // namespace quic
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/IPAddress.h>
+#include <folly/Optional.h>
+#include <quic/codec/Types.h>
+#include <quic/handshake/Aead.h>
+
+#include <chrono>
+
+namespace quic {
+
+using RetryTokenSecret = std::array<uint8_t, kRetryTokenSecretLength>;
+
+/**
+ * Address validation tokens for Retry packets.
+ *
+ * The token carries the destination connection id of the client's first
+ * Initial and the time it was issued, encrypted with AES-128-GCM under a key
+ * derived from the RetryTokenSecret. The client address is the associated
+ * data, so a token only validates the address it was sent to. The server
+ * keeps no state per token: any server sharing the secret validates it.
+ *
+ * key, iv = HKDF-Expand(HKDF-Extract(Salt, secret), "key" | "iv")
+ * Token = seqNum | AEAD(key, iv ^ seqNum, issueTime | odcidLen | odcid, addr)
+ *
+ * seqNum is random, so that tokens don't reuse a nonce.
+ */
+class RetryTokenGenerator {
+ public:
+  RetryTokenGenerator(RetryTokenSecret secret, std::chrono::seconds lifetime);
+
+  Buf encryptToken(
+      const folly::IPAddress& clientIp,
+      const ConnectionId& originalDstConnId,
+      std::chrono::system_clock::time_point now) const;
+
+  /**
+   * The original destination connection id in the token, or none if the
+   * token doesn't decrypt for clientIp or is older than the lifetime.
+   */
+  folly::Optional<ConnectionId> decryptToken(
+      Buf token,
+      const folly::IPAddress& clientIp,
+      std::chrono::system_clock::time_point now) const;
+
+ private:
+  std::unique_ptr<Aead> cipher_;
+  std::chrono::seconds lifetime_;
+};
+} // namespace quic
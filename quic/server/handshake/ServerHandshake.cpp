@@ -9,7 +9,9 @@
 #include <quic/server/handshake/ServerHandshake.h>
 
 #include <fizz/protocol/Protocol.h>
+#include <folly/String.h>
 #include <quic/handshake/FizzBridge.h>
+#include <quic/handshake/ParallelAead.h>
 #include <quic/state/QuicStreamFunctions.h>
 
 namespace quic {
@@ -50,6 +52,18 @@ void ServerHandshake::initialize(
   }
 }
 
+void ServerHandshake::setCryptoExecutor(
+    std::shared_ptr<folly::Executor> cryptoExecutor) {
+  cryptoExecutor_ = std::move(cryptoExecutor);
+}
+
+void ServerHandshake::setEncryptExecutor(
+    std::shared_ptr<folly::Executor> encryptExecutor,
+    size_t numHelpers) {
+  encryptExecutor_ = std::move(encryptExecutor);
+  numEncryptHelpers_ = encryptExecutor_ ? numHelpers : 0;
+}
+
 void ServerHandshake::doHandshake(
     std::unique_ptr<folly::IOBuf> data,
     EncryptionLevel encryptionLevel) {
@@ -108,7 +122,17 @@ std::unique_ptr<Aead> ServerHandshake::getOneRttWriteCipher() {
   if (error_) {
     throw QuicTransportException(error_->first, error_->second);
   }
-  return FizzAead::wrap(std::move(oneRttWriteCipher_));
+  auto aead = FizzAead::wrap(std::move(oneRttWriteCipher_));
+  if (!aead || oneRttWriteHelperCiphers_.empty()) {
+    return aead;
+  }
+  std::vector<std::unique_ptr<Aead>> helperAeads;
+  for (auto& helperCipher : oneRttWriteHelperCiphers_) {
+    helperAeads.push_back(FizzAead::wrap(std::move(helperCipher)));
+  }
+  oneRttWriteHelperCiphers_.clear();
+  return std::make_unique<ParallelAead>(
+      std::move(aead), std::move(helperAeads), encryptExecutor_);
 }
 
 std::unique_ptr<Aead> ServerHandshake::getOneRttReadCipher() {
@@ -195,6 +219,27 @@ ServerHandshake::getContext() const {
   return context_;
 }
 
+void ServerHandshake::setRetainOneRttSecrets(bool retain) {
+  retainOneRttSecrets_ = retain;
+}
+
+folly::Optional<OneRttSecrets> ServerHandshake::getOneRttSecrets() const {
+  if (!oneRttCipher_ || oneRttClientSecret_.empty() ||
+      oneRttServerSecret_.empty()) {
+    return folly::none;
+  }
+  return OneRttSecrets{
+      *oneRttCipher_, oneRttClientSecret_, oneRttServerSecret_};
+}
+
+void ServerHandshake::setRetainKeyLog(bool retain) {
+  retainKeyLog_ = retain;
+}
+
+const std::string& ServerHandshake::getKeyLog() const {
+  return keyLog_;
+}
+
 const folly::Optional<std::string>& ServerHandshake::getApplicationProtocol()
     const {
   return state_.alpn();
@@ -287,7 +332,11 @@ void ServerHandshake::processPendingEvents() {
     if (!waitForData_) {
       switch (state_.readRecordLayer()->getEncryptionLevel()) {
         case fizz::EncryptionLevel::Plaintext:
-          actions = machine_.processSocketData(state_, initialReadBuf_);
+          if (cryptoExecutor_ && !initialReadBuf_.empty()) {
+            actions = processSocketDataAsync(initialReadBuf_);
+          } else {
+            actions = machine_.processSocketData(state_, initialReadBuf_);
+          }
           break;
         case fizz::EncryptionLevel::Handshake:
           actions = machine_.processSocketData(state_, handshakeReadBuf_);
@@ -315,6 +364,35 @@ void ServerHandshake::processPendingEvents() {
   }
 }
 
+fizz::server::AsyncActions ServerHandshake::processSocketDataAsync(
+    folly::IOBufQueue& queue) {
+  // state_ is only mutated by the actions, which can't run before these are
+  // done as actionGuard_ is held until then. So the state machine can read it
+  // from the other thread.
+  auto data = std::make_shared<folly::IOBufQueue>(
+      folly::IOBufQueue::cacheChainLength());
+  data->append(queue.move());
+  return folly::via(
+             cryptoExecutor_.get(),
+             [this, data]() -> folly::Future<fizz::server::Actions> {
+               auto actions = machine_.processSocketData(state_, *data);
+               return folly::variant_match(
+                   actions,
+                   [](folly::Future<fizz::server::Actions>& futureActions) {
+                     return std::move(futureActions);
+                   },
+                   [](fizz::server::Actions& immediateActions) {
+                     return folly::makeFuture(std::move(immediateActions));
+                   });
+             })
+      .via(executor_)
+      .then([data, &queue](fizz::server::Actions actions) {
+        data->append(queue.move());
+        queue = std::move(*data);
+        return actions;
+      });
+}
+
 ServerHandshake::ActionMoveVisitor::ActionMoveVisitor(ServerHandshake& server)
     : server_(server) {}
 
@@ -400,6 +478,37 @@ void ServerHandshake::ActionMoveVisitor::operator()(
       folly::range(secretAvailable.secret.secret),
       kQuicKeyLabel,
       kQuicIVLabel);
+  if (server_.retainKeyLog_ && server_.state_.clientRandom()) {
+    auto label = folly::variant_match(
+        secretAvailable.secret.type,
+        [](fizz::EarlySecrets earlySecrets) -> folly::StringPiece {
+          return earlySecrets == fizz::EarlySecrets::ClientEarlyTraffic
+              ? "CLIENT_EARLY_TRAFFIC_SECRET"
+              : "";
+        },
+        [](fizz::HandshakeSecrets handshakeSecrets) -> folly::StringPiece {
+          return handshakeSecrets ==
+                  fizz::HandshakeSecrets::ClientHandshakeTraffic
+              ? "CLIENT_HANDSHAKE_TRAFFIC_SECRET"
+              : "SERVER_HANDSHAKE_TRAFFIC_SECRET";
+        },
+        [](fizz::AppTrafficSecrets appSecrets) -> folly::StringPiece {
+          return appSecrets == fizz::AppTrafficSecrets::ClientAppTraffic
+              ? "CLIENT_TRAFFIC_SECRET_0"
+              : "SERVER_TRAFFIC_SECRET_0";
+        },
+        [](auto) -> folly::StringPiece { return ""; });
+    if (!label.empty()) {
+      folly::toAppend(
+          label,
+          " ",
+          folly::hexlify(folly::range(*server_.state_.clientRandom())),
+          " ",
+          folly::hexlify(folly::range(secretAvailable.secret.secret)),
+          "\n",
+          &server_.keyLog_);
+    }
+  }
   QuicFizzFactory factory;
   auto headerCipher = makePacketNumberCipher(
       &factory,
@@ -434,12 +543,32 @@ void ServerHandshake::ActionMoveVisitor::operator()(
           case fizz::AppTrafficSecrets::ClientAppTraffic:
             server_.oneRttReadCipher_ = std::move(aead);
             server_.oneRttReadHeaderCipher_ = std::move(headerCipher);
+            if (server_.retainOneRttSecrets_) {
+              server_.oneRttClientSecret_ = secretAvailable.secret.secret;
+            }
             break;
           case fizz::AppTrafficSecrets::ServerAppTraffic:
             server_.oneRttWriteCipher_ = std::move(aead);
+            server_.oneRttWriteHelperCiphers_.clear();
+            for (size_t i = 0; i < server_.numEncryptHelpers_; ++i) {
+              server_.oneRttWriteHelperCiphers_.push_back(
+                  fizz::Protocol::deriveRecordAeadWithLabel(
+                      *server_.state_.context()->getFactory(),
+                      *server_.state_.keyScheduler(),
+                      *server_.state_.cipher(),
+                      folly::range(secretAvailable.secret.secret),
+                      kQuicKeyLabel,
+                      kQuicIVLabel));
+            }
             server_.oneRttWriteHeaderCipher_ = std::move(headerCipher);
+            if (server_.retainOneRttSecrets_) {
+              server_.oneRttServerSecret_ = secretAvailable.secret.secret;
+            }
             break;
         }
+        if (server_.retainOneRttSecrets_) {
+          server_.oneRttCipher_ = *server_.state_.cipher();
+        }
       },
       [&](auto) {});
   server_.handshakeEventAvailable_ = true;
@@ -50,6 +50,15 @@ namespace quic {
  * }
  */
 
+/**
+ * The 1-RTT traffic secrets of a connection.
+ */
+struct OneRttSecrets {
+  fizz::CipherSuite cipher;
+  std::vector<uint8_t> clientSecret;
+  std::vector<uint8_t> serverSecret;
+};
+
 class ServerHandshake : public Handshake {
  public:
   class HandshakeCallback {
@@ -88,6 +97,26 @@ class ServerHandshake : public Handshake {
       HandshakeCallback* callback,
       std::unique_ptr<fizz::server::AppTokenValidator> validator = nullptr);
 
+  /**
+   * Runs the processing of the client's Initial crypto data, where the
+   * certificate signature, the key exchange and the key derivation happen, on
+   * cryptoExecutor instead of inline. The actions it produces are still run on
+   * the executor given to initialize, in order, and the callback is told about
+   * them with onCryptoEventAvailable(). Data arriving meanwhile is queued.
+   * Must be called before accept.
+   */
+  void setCryptoExecutor(std::shared_ptr<folly::Executor> cryptoExecutor);
+
+  /**
+   * Has the 1-RTT write cipher spread the packet batches it encrypts over
+   * numHelpers threads of encryptExecutor, see ParallelAead. Needs
+   * TransportSettings::maxEncryptBatchSize to be larger than 1 to have any
+   * effect. Must be called before the 1-RTT keys are derived.
+   */
+  void setEncryptExecutor(
+      std::shared_ptr<folly::Executor> encryptExecutor,
+      size_t numHelpers);
+
   /**
    * Performs the handshake, after a handshake you should check whether or
    * not an event is available.
@@ -190,6 +219,29 @@ class ServerHandshake : public Handshake {
   const std::shared_ptr<const fizz::server::FizzServerContext> getContext()
       const;
 
+  /**
+   * Keep the 1-RTT traffic secrets once they are derived, so that the
+   * connection state can be exported. Must be called before the handshake
+   * starts.
+   */
+  void setRetainOneRttSecrets(bool retain);
+
+  /**
+   * The retained 1-RTT traffic secrets. Only set with setRetainOneRttSecrets,
+   * once both secrets are derived.
+   */
+  folly::Optional<OneRttSecrets> getOneRttSecrets() const;
+
+  /**
+   * Keep the traffic secrets as they are derived, in the NSS key log format
+   * tools like Wireshark decrypt packets with. Must be called before the
+   * handshake starts.
+   */
+  void setRetainKeyLog(bool retain);
+
+  // The key log lines of the secrets derived so far, if retained.
+  const std::string& getKeyLog() const;
+
   /**
    * Retuns the negotiated ALPN from the handshake.
    */
@@ -244,10 +296,20 @@ class ServerHandshake : public Handshake {
    */
   void processPendingEvents();
 
+  /**
+   * Processes the data of queue on cryptoExecutor_. The state machine gets
+   * the data that was queued so far, what it leaves is put back in front of
+   * queue once the actions are back on executor_.
+   */
+  fizz::server::AsyncActions processSocketDataAsync(folly::IOBufQueue& queue);
+
   fizz::server::State state_;
   fizz::server::ServerStateMachine machine_;
   folly::Optional<folly::DelayedDestruction::DestructorGuard> actionGuard_;
   folly::Executor* executor_;
+  std::shared_ptr<folly::Executor> cryptoExecutor_;
+  std::shared_ptr<folly::Executor> encryptExecutor_;
+  size_t numEncryptHelpers_{0};
   std::shared_ptr<const fizz::server::FizzServerContext> context_;
   using PendingEvent = boost::variant<fizz::WriteNewSessionTicket>;
   std::deque<PendingEvent> pendingEvents_;
@@ -268,6 +330,8 @@ class ServerHandshake : public Handshake {
   std::unique_ptr<fizz::Aead> handshakeWriteCipher_;
   std::unique_ptr<fizz::Aead> oneRttReadCipher_;
   std::unique_ptr<fizz::Aead> oneRttWriteCipher_;
+  // Keyed like oneRttWriteCipher_, for the encryption helper threads.
+  std::vector<std::unique_ptr<fizz::Aead>> oneRttWriteHelperCiphers_;
   std::unique_ptr<fizz::Aead> zeroRttReadCipher_;
 
   std::unique_ptr<PacketNumberCipher> oneRttReadHeaderCipher_;
@@ -276,6 +340,14 @@ class ServerHandshake : public Handshake {
   std::unique_ptr<PacketNumberCipher> handshakeWriteHeaderCipher_;
   std::unique_ptr<PacketNumberCipher> zeroRttReadHeaderCipher_;
 
+  bool retainOneRttSecrets_{false};
+  folly::Optional<fizz::CipherSuite> oneRttCipher_;
+  std::vector<uint8_t> oneRttClientSecret_;
+  std::vector<uint8_t> oneRttServerSecret_;
+
+  bool retainKeyLog_{false};
+  std::string keyLog_;
+
   bool inHandshakeStack_{false};
   bool handshakeDone_{false};
   bool handshakeEventAvailable_{false};
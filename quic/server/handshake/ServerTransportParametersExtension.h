@@ -12,8 +12,158 @@
 #include <quic/handshake/TransportParameters.h>
 #include <quic/server/handshake/StatelessResetGenerator.h>
 
+#include <algorithm>
+
 namespace quic {
 
+/**
+ * What a server advertises in its transport parameters, but for its stateless
+ * reset token.
+ */
+struct ServerTransportParameterValues {
+  folly::Optional<QuicVersion> negotiatedVersion;
+  std::vector<QuicVersion> supportedVersions;
+  uint64_t initialMaxData;
+  uint64_t initialMaxStreamDataBidiLocal;
+  uint64_t initialMaxStreamDataBidiRemote;
+  uint64_t initialMaxStreamDataUni;
+  uint64_t initialMaxStreamsBidi;
+  uint64_t initialMaxStreamsUni;
+  std::chrono::milliseconds idleTimeout;
+  uint64_t ackDelayExponent;
+  uint64_t maxRecvPacketSize;
+  TransportPartialReliabilitySetting partialReliability;
+  uint64_t maxDatagramFrameSize;
+  folly::Optional<std::chrono::microseconds> minAckDelay;
+  bool fec;
+
+  bool operator==(const ServerTransportParameterValues& other) const {
+    return negotiatedVersion == other.negotiatedVersion &&
+        supportedVersions == other.supportedVersions &&
+        initialMaxData == other.initialMaxData &&
+        initialMaxStreamDataBidiLocal == other.initialMaxStreamDataBidiLocal &&
+        initialMaxStreamDataBidiRemote ==
+            other.initialMaxStreamDataBidiRemote &&
+        initialMaxStreamDataUni == other.initialMaxStreamDataUni &&
+        initialMaxStreamsBidi == other.initialMaxStreamsBidi &&
+        initialMaxStreamsUni == other.initialMaxStreamsUni &&
+        idleTimeout == other.idleTimeout &&
+        ackDelayExponent == other.ackDelayExponent &&
+        maxRecvPacketSize == other.maxRecvPacketSize &&
+        partialReliability == other.partialReliability &&
+        maxDatagramFrameSize == other.maxDatagramFrameSize &&
+        minAckDelay == other.minAckDelay && fec == other.fec;
+  }
+};
+
+inline ServerTransportParameters makeServerTransportParameters(
+    const ServerTransportParameterValues& values,
+    const StatelessResetToken& token) {
+  ServerTransportParameters params;
+  params.negotiated_version = values.negotiatedVersion;
+  params.supported_versions = values.supportedVersions;
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_stream_data_bidi_local,
+      values.initialMaxStreamDataBidiLocal));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_stream_data_bidi_remote,
+      values.initialMaxStreamDataBidiRemote));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_stream_data_uni,
+      values.initialMaxStreamDataUni));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_data, values.initialMaxData));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_streams_bidi,
+      values.initialMaxStreamsBidi));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_streams_uni,
+      values.initialMaxStreamsUni));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::idle_timeout, values.idleTimeout.count()));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::ack_delay_exponent, values.ackDelayExponent));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::max_packet_size, values.maxRecvPacketSize));
+  TransportParameter statelessReset;
+  statelessReset.parameter = TransportParameterId::stateless_reset_token;
+  statelessReset.value = folly::IOBuf::copyBuffer(token);
+  params.parameters.push_back(std::move(statelessReset));
+
+  uint64_t partialReliabilitySetting = 0;
+  if (values.partialReliability) {
+    partialReliabilitySetting = 1;
+  }
+  params.parameters.push_back(encodeIntegerParameter(
+      static_cast<TransportParameterId>(kPartialReliabilityParameterId),
+      partialReliabilitySetting));
+
+  if (values.maxDatagramFrameSize > 0) {
+    params.parameters.push_back(encodeIntegerParameter(
+        static_cast<TransportParameterId>(kMaxDatagramFrameSizeParameterId),
+        values.maxDatagramFrameSize));
+  }
+
+  if (values.minAckDelay) {
+    params.parameters.push_back(encodeIntegerParameter(
+        static_cast<TransportParameterId>(kMinAckDelayParameterId),
+        values.minAckDelay->count()));
+  }
+
+  if (values.fec) {
+    params.parameters.push_back(encodeIntegerParameter(
+        static_cast<TransportParameterId>(kFecParameterId), 1));
+  }
+  return params;
+}
+
+/**
+ * The encoded transport parameters of the last connection of a worker. The
+ * connections of a worker usually advertise the same parameters but for their
+ * stateless reset token, so instead of building and encoding every parameter
+ * they copy the encoding and write their token in place. Only used from the
+ * event base of the worker.
+ */
+class ServerTransportParametersCache {
+ public:
+  Buf encode(
+      const ServerTransportParameterValues& values,
+      const StatelessResetToken& token) {
+    if (!values_ || !(*values_ == values)) {
+      // Encoding with two tokens that differ in every byte tells where the
+      // token lands in the encoding.
+      StatelessResetToken zeroToken{};
+      StatelessResetToken onesToken;
+      onesToken.fill(0xff);
+      encoded_ =
+          encodeExtension(makeServerTransportParameters(values, zeroToken))
+              .extension_data;
+      encoded_->coalesce();
+      auto onesEncoded =
+          encodeExtension(makeServerTransportParameters(values, onesToken))
+              .extension_data;
+      onesEncoded->coalesce();
+      CHECK_EQ(encoded_->length(), onesEncoded->length());
+      auto mismatch = std::mismatch(
+          encoded_->data(),
+          encoded_->data() + encoded_->length(),
+          onesEncoded->data());
+      tokenOffset_ = mismatch.first - encoded_->data();
+      CHECK_LE(tokenOffset_ + token.size(), encoded_->length());
+      values_ = values;
+    }
+    auto encoded =
+        folly::IOBuf::copyBuffer(encoded_->data(), encoded_->length());
+    memcpy(encoded->writableData() + tokenOffset_, token.data(), token.size());
+    return encoded;
+  }
+
+ private:
+  folly::Optional<ServerTransportParameterValues> values_;
+  Buf encoded_;
+  size_t tokenOffset_{0};
+};
+
 class ServerTransportParametersExtension : public fizz::ServerExtensions {
  public:
   ServerTransportParametersExtension(
@@ -29,23 +179,37 @@ class ServerTransportParametersExtension : public fizz::ServerExtensions {
       uint64_t ackDelayExponent,
       uint64_t maxRecvPacketSize,
       TransportPartialReliabilitySetting partialReliability,
-      const StatelessResetToken& token)
-      : negotiatedVersion_(negotiatedVersion),
-        supportedVersions_(supportedVersions),
-        initialMaxData_(initialMaxData),
-        initialMaxStreamDataBidiLocal_(initialMaxStreamDataBidiLocal),
-        initialMaxStreamDataBidiRemote_(initialMaxStreamDataBidiRemote),
-        initialMaxStreamDataUni_(initialMaxStreamDataUni),
-        initialMaxStreamsBidi_(initialMaxStreamsBidi),
-        initialMaxStreamsUni_(initialMaxStreamsUni),
-        idleTimeout_(idleTimeout),
-        ackDelayExponent_(ackDelayExponent),
-        maxRecvPacketSize_(maxRecvPacketSize),
-        partialReliability_(partialReliability),
+      const StatelessResetToken& token,
+      uint64_t maxDatagramFrameSize = 0,
+      folly::Optional<std::chrono::microseconds> minAckDelay = folly::none,
+      bool fec = false)
+      : values_{negotiatedVersion,
+                supportedVersions,
+                initialMaxData,
+                initialMaxStreamDataBidiLocal,
+                initialMaxStreamDataBidiRemote,
+                initialMaxStreamDataUni,
+                initialMaxStreamsBidi,
+                initialMaxStreamsUni,
+                idleTimeout,
+                ackDelayExponent,
+                maxRecvPacketSize,
+                partialReliability,
+                maxDatagramFrameSize,
+                minAckDelay,
+                fec},
         token_(token) {}
 
   ~ServerTransportParametersExtension() override = default;
 
+  /**
+   * Encode the parameters through the cache of the worker rather than on
+   * their own.
+   */
+  void setCache(std::shared_ptr<ServerTransportParametersCache> cache) {
+    cache_ = std::move(cache);
+  }
+
   std::vector<fizz::Extension> getExtensions(
       const fizz::ClientHello& chlo) override {
     auto clientParams =
@@ -58,50 +222,19 @@ class ServerTransportParametersExtension : public fizz::ServerExtensions {
     }
     clientTransportParameters_ = std::move(clientParams);
     if (!clientTransportParameters_->initial_version.hasValue()) {
-      negotiatedVersion_ = folly::none;
+      values_.negotiatedVersion = folly::none;
     }
 
     std::vector<fizz::Extension> exts;
-
-    ServerTransportParameters params;
-    params.negotiated_version = negotiatedVersion_;
-    params.supported_versions = supportedVersions_;
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_stream_data_bidi_local,
-        initialMaxStreamDataBidiLocal_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_stream_data_bidi_remote,
-        initialMaxStreamDataBidiRemote_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_stream_data_uni,
-        initialMaxStreamDataUni_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_data, initialMaxData_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_streams_bidi,
-        initialMaxStreamsBidi_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_streams_uni, initialMaxStreamsUni_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::idle_timeout, idleTimeout_.count()));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::ack_delay_exponent, ackDelayExponent_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::max_packet_size, maxRecvPacketSize_));
-    TransportParameter statelessReset;
-    statelessReset.parameter = TransportParameterId::stateless_reset_token;
-    statelessReset.value = folly::IOBuf::copyBuffer(token_);
-    params.parameters.push_back(std::move(statelessReset));
-
-    uint64_t partialReliabilitySetting = 0;
-    if (partialReliability_) {
-      partialReliabilitySetting = 1;
+    if (cache_) {
+      fizz::Extension ext;
+      ext.extension_type = fizz::ExtensionType::quic_transport_parameters;
+      ext.extension_data = cache_->encode(values_, token_);
+      exts.push_back(std::move(ext));
+    } else {
+      exts.push_back(
+          encodeExtension(makeServerTransportParameters(values_, token_)));
     }
-    params.parameters.push_back(encodeIntegerParameter(
-        static_cast<TransportParameterId>(kPartialReliabilityParameterId),
-        partialReliabilitySetting));
-
-    exts.push_back(encodeExtension(params));
     return exts;
   }
 
@@ -110,19 +243,9 @@ class ServerTransportParametersExtension : public fizz::ServerExtensions {
   }
 
  private:
-  folly::Optional<QuicVersion> negotiatedVersion_;
-  std::vector<QuicVersion> supportedVersions_;
-  uint64_t initialMaxData_;
-  uint64_t initialMaxStreamDataBidiLocal_;
-  uint64_t initialMaxStreamDataBidiRemote_;
-  uint64_t initialMaxStreamDataUni_;
-  uint64_t initialMaxStreamsBidi_;
-  uint64_t initialMaxStreamsUni_;
-  std::chrono::milliseconds idleTimeout_;
-  uint64_t ackDelayExponent_;
-  uint64_t maxRecvPacketSize_;
-  TransportPartialReliabilitySetting partialReliability_;
+  ServerTransportParameterValues values_;
   folly::Optional<ClientTransportParameters> clientTransportParameters_;
   StatelessResetToken token_;
+  std::shared_ptr<ServerTransportParametersCache> cache_;
 };
 } // namespace quic
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/TicketKeyStore.h>
+
+#include <fizz/server/AeadTicketCipher.h>
+#include <quic/QuicConstants.h>
+
+namespace quic {
+
+TicketKeyStore::TicketKeyStore(std::chrono::seconds ticketValidity)
+    : ticketValidity_(ticketValidity) {}
+
+bool TicketKeyStore::setTicketSecrets(const std::vector<std::string>& secrets) {
+  if (secrets.empty()) {
+    return false;
+  }
+  std::vector<folly::ByteRange> secretRanges;
+  for (const auto& secret : secrets) {
+    if (secret.size() < kMinTicketSecretLength) {
+      return false;
+    }
+    secretRanges.push_back(folly::ByteRange(folly::StringPiece(secret)));
+  }
+  auto cipher = std::make_shared<fizz::server::AES128TicketCipher>();
+  cipher->setValidity(ticketValidity_);
+  if (!cipher->setTicketSecrets(std::move(secretRanges))) {
+    return false;
+  }
+  cipher_.reset(std::move(cipher));
+  return true;
+}
+
+bool TicketKeyStore::refresh(TicketSecretSource& source) {
+  auto secrets = source.getTicketSecrets();
+  return secrets && setTicketSecrets(*secrets);
+}
+
+folly::ReadMostlySharedPtr<fizz::server::TicketCipher>
+TicketKeyStore::getCipher() const {
+  return cipher_.getShared();
+}
+
+RotatingTicketCipher::RotatingTicketCipher(
+    std::shared_ptr<TicketKeyStore> store)
+    : store_(std::move(store)) {
+  CHECK(store_);
+}
+
+folly::Future<folly::Optional<
+    std::pair<std::unique_ptr<folly::IOBuf>, std::chrono::seconds>>>
+RotatingTicketCipher::encrypt(fizz::server::ResumptionState resState) const {
+  auto cipher = store_->getCipher();
+  if (!cipher) {
+    return folly::none;
+  }
+  return cipher->encrypt(std::move(resState));
+}
+
+folly::Future<
+    std::pair<fizz::PskType, folly::Optional<fizz::server::ResumptionState>>>
+RotatingTicketCipher::decrypt(
+    std::unique_ptr<folly::IOBuf> encryptedTicket) const {
+  auto cipher = store_->getCipher();
+  if (!cipher) {
+    return std::make_pair(fizz::PskType::Rejected, folly::none);
+  }
+  return cipher->decrypt(std::move(encryptedTicket));
+}
+
+} // namespace quic
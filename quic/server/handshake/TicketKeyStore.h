@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <fizz/server/TicketCipher.h>
+#include <folly/Optional.h>
+#include <folly/experimental/ReadMostlySharedPtr.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Where the session ticket secrets of a pool of servers come from, for
+ * example a secret distribution service. Every worker and host getting the
+ * same secrets can resume the sessions of the others, across restarts.
+ *
+ * The first secret encrypts new tickets, all of them decrypt. Rotation adds
+ * a new secret in front and keeps the previous ones for at least the ticket
+ * validity, so that outstanding tickets keep resuming.
+ */
+class TicketSecretSource {
+ public:
+  virtual ~TicketSecretSource() = default;
+
+  // The current secrets, or none if they are not available.
+  virtual folly::Optional<std::vector<std::string>> getTicketSecrets() = 0;
+};
+
+/**
+ * Ticket cipher keyed by the current ticket secrets.
+ *
+ * The handshakes of every worker read the cipher on each ticket they encrypt
+ * or decrypt, while secrets change once in a rotation period. Reads go
+ * through a ReadMostlySharedPtr, which takes no lock and doesn't bounce a
+ * shared reference count between the worker threads. Updates build a new
+ * cipher and publish it, handshakes in flight keep the one they started with.
+ */
+class TicketKeyStore {
+ public:
+  explicit TicketKeyStore(std::chrono::seconds ticketValidity);
+
+  /**
+   * Replaces the secrets. Handshakes may read from any thread meanwhile, but
+   * updates must not overlap. Returns false and keeps the current secrets if
+   * secrets is empty or one of them is shorter than kMinTicketSecretLength.
+   */
+  bool setTicketSecrets(const std::vector<std::string>& secrets);
+
+  // Fetches the secrets from source, returns whether they were updated.
+  bool refresh(TicketSecretSource& source);
+
+  // The current cipher, null until secrets are set.
+  folly::ReadMostlySharedPtr<fizz::server::TicketCipher> getCipher() const;
+
+ private:
+  std::chrono::seconds ticketValidity_;
+  folly::ReadMostlyMainPtr<fizz::server::TicketCipher> cipher_;
+};
+
+/**
+ * The TicketCipher to set on the FizzServerContext shared by the workers. It
+ * uses whatever secrets the store has at the time of the call. Without
+ * secrets, no ticket is issued and every ticket is rejected.
+ */
+class RotatingTicketCipher : public fizz::server::TicketCipher {
+ public:
+  explicit RotatingTicketCipher(std::shared_ptr<TicketKeyStore> store);
+
+  ~RotatingTicketCipher() override = default;
+
+  folly::Future<folly::Optional<
+      std::pair<std::unique_ptr<folly::IOBuf>, std::chrono::seconds>>>
+  encrypt(fizz::server::ResumptionState resState) const override;
+
+  folly::Future<
+      std::pair<fizz::PskType, folly::Optional<fizz::server::ResumptionState>>>
+  decrypt(std::unique_ptr<folly::IOBuf> encryptedTicket) const override;
+
+ private:
+  std::shared_ptr<TicketKeyStore> store_;
+};
+
+} // namespace quic
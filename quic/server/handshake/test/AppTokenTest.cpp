@@ -95,6 +95,21 @@ void expectAppTokenEqual(
   } else {
     EXPECT_EQ(decodedAppToken->appParams->computeChainDataLength(), 0);
   }
+
+  EXPECT_EQ(
+      decodedAppToken->congestionState.hasValue(),
+      appToken.congestionState.hasValue());
+  if (appToken.congestionState && decodedAppToken->congestionState) {
+    EXPECT_EQ(
+        decodedAppToken->congestionState->minRtt,
+        appToken.congestionState->minRtt);
+    EXPECT_EQ(
+        decodedAppToken->congestionState->cwndBytes,
+        appToken.congestionState->cwndBytes);
+    EXPECT_EQ(
+        decodedAppToken->congestionState->issueTime,
+        appToken.congestionState->issueTime);
+  }
 }
 
 TEST(AppTokenTest, TestEncodeAndDecodeNoSourceAddresses) {
@@ -253,5 +268,29 @@ TEST(AppTokenTest, TestEncodeAndDecodeIPv6AndIPv4AddressesWithAppToken) {
   expectAppTokenEqual(decodeAppToken(*buf), appToken);
 }
 
+TEST(AppTokenTest, TestEncodeAndDecodeWithCongestionState) {
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      kDefaultIdleTimeout.count(),
+      kDefaultUDPReadBufferSize,
+      kDefaultConnectionWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max());
+  appToken.sourceAddresses = {folly::IPAddress("1.2.3.4")};
+  appToken.version = QuicVersion::MVFST;
+  appToken.appParams = folly::IOBuf::copyBuffer("QPACK Params");
+  TicketCongestionState congestionState;
+  congestionState.minRtt = 35000us;
+  congestionState.cwndBytes = 1200 * 300;
+  congestionState.issueTime = 1600000000;
+  appToken.congestionState = congestionState;
+  Buf buf = encodeAppToken(appToken);
+
+  expectAppTokenEqual(decodeAppToken(*buf), appToken);
+}
+
 } // namespace test
 } // namespace quic
@@ -88,6 +88,48 @@ TEST(
   EXPECT_EQ(conn.flowControlState.advertisedMaxOffset, initialMaxData - 1);
 }
 
+TEST(DefaultAppTokenValidatorTest, TestCongestionState) {
+  QuicServerConnectionState conn;
+  conn.peerAddress = folly::SocketAddress("1.2.3.4", 443);
+  conn.version = QuicVersion::MVFST;
+  conn.transportSettings.carefulResumeEnabled = true;
+
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      conn.transportSettings.idleTimeout.count(),
+      conn.transportSettings.maxRecvPacketSize,
+      conn.transportSettings.advertisedInitialConnectionWindowSize,
+      conn.transportSettings.advertisedInitialBidiLocalStreamWindowSize,
+      conn.transportSettings.advertisedInitialBidiRemoteStreamWindowSize,
+      conn.transportSettings.advertisedInitialUniStreamWindowSize,
+      conn.transportSettings.advertisedInitialMaxStreamsBidi,
+      conn.transportSettings.advertisedInitialMaxStreamsUni);
+  appToken.version = conn.version;
+  auto now = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  TicketCongestionState congestionState;
+  congestionState.minRtt = 20000us;
+  congestionState.cwndBytes = 100000;
+  congestionState.issueTime = now.count();
+  appToken.congestionState = congestionState;
+  ResumptionState resState;
+  resState.appToken = encodeAppToken(appToken);
+
+  DefaultAppTokenValidator validator(&conn, nullptr);
+  EXPECT_TRUE(validator.validate(resState));
+  ASSERT_TRUE(conn.ticketCongestionState.hasValue());
+  EXPECT_EQ(20000us, conn.ticketCongestionState->minRtt);
+  EXPECT_EQ(100000, conn.ticketCongestionState->cwndBytes);
+
+  // A stale congestion state doesn't fail the ticket, it is just not used.
+  conn.ticketCongestionState = folly::none;
+  appToken.congestionState->issueTime =
+      (now - kCarefulResumeMaxTicketAge - std::chrono::seconds(1)).count();
+  resState.appToken = encodeAppToken(appToken);
+  EXPECT_TRUE(validator.validate(resState));
+  EXPECT_FALSE(conn.ticketCongestionState.hasValue());
+}
+
 TEST(DefaultAppTokenValidatorTest, TestInvalidNullAppToken) {
   QuicServerConnectionState conn;
   conn.peerAddress = folly::SocketAddress("1.2.3.4", 443);
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/PrecompressedCertCache.h>
+
+#include <fizz/compression/ZlibCertificateCompressor.h>
+#include <fizz/compression/ZlibCertificateDecompressor.h>
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+
+class FakeSelfCert : public fizz::SelfCert {
+ public:
+  std::string getIdentity() const override {
+    return "quic.test";
+  }
+
+  folly::ssl::X509UniquePtr getX509() const override {
+    return nullptr;
+  }
+
+  std::vector<std::string> getAltIdentities() const override {
+    return {};
+  }
+
+  std::vector<fizz::SignatureScheme> getSigSchemes() const override {
+    return {fizz::SignatureScheme::ecdsa_secp256r1_sha256};
+  }
+
+  fizz::CertificateMsg getCertMessage(fizz::Buf) const override {
+    certMessages++;
+    fizz::CertificateMsg certMsg;
+    certMsg.certificate_request_context = folly::IOBuf::create(0);
+    fizz::CertificateEntry entry;
+    entry.cert_data = folly::IOBuf::copyBuffer(std::string(4000, 'c'));
+    certMsg.certificate_list.push_back(std::move(entry));
+    return certMsg;
+  }
+
+  fizz::CompressedCertificate getCompressedCert(
+      fizz::CertificateCompressionAlgorithm) const override {
+    throw std::runtime_error("not compressed");
+  }
+
+  fizz::Buf sign(
+      fizz::SignatureScheme,
+      fizz::CertificateVerifyContext,
+      folly::ByteRange) const override {
+    return folly::IOBuf::copyBuffer("signature");
+  }
+
+  mutable size_t certMessages{0};
+};
+
+} // namespace
+
+class PrecompressedCertCacheTest : public Test {
+ protected:
+  void SetUp() override {
+    cert_ = std::make_shared<FakeSelfCert>();
+    cache_ = std::make_unique<PrecompressedCertCache>(
+        std::vector<std::shared_ptr<fizz::CertificateCompressor>>{
+            std::make_shared<fizz::ZlibCertificateCompressor>(9)});
+  }
+
+  std::shared_ptr<FakeSelfCert> cert_;
+  std::unique_ptr<PrecompressedCertCache> cache_;
+};
+
+TEST_F(PrecompressedCertCacheTest, CompressesOnce) {
+  auto compressedCert = cache_->getCompressedCert(cert_);
+  EXPECT_EQ(1, cert_->certMessages);
+  EXPECT_EQ(compressedCert, cache_->getCompressedCert(cert_));
+  for (int i = 0; i < 3; i++) {
+    compressedCert->getCompressedCert(
+        fizz::CertificateCompressionAlgorithm::zlib);
+  }
+  EXPECT_EQ(1, cert_->certMessages);
+}
+
+TEST_F(PrecompressedCertCacheTest, CompressedChainDecompresses) {
+  auto compressedCert = cache_->getCompressedCert(cert_);
+  auto compressed = compressedCert->getCompressedCert(
+      fizz::CertificateCompressionAlgorithm::zlib);
+  EXPECT_EQ(fizz::CertificateCompressionAlgorithm::zlib, compressed.algorithm);
+  EXPECT_LT(
+      compressed.compressed_certificate_message->computeChainDataLength(),
+      compressed.uncompressed_length);
+
+  fizz::ZlibCertificateDecompressor decompressor;
+  auto certMsg = decompressor.decompress(compressed);
+  ASSERT_EQ(1, certMsg.certificate_list.size());
+  EXPECT_TRUE(folly::IOBufEqualTo()(
+      certMsg.certificate_list[0].cert_data,
+      cert_->getCertMessage(nullptr).certificate_list[0].cert_data));
+}
+
+TEST_F(PrecompressedCertCacheTest, UnknownAlgorithmThrows) {
+  auto compressedCert = cache_->getCompressedCert(cert_);
+  EXPECT_THROW(
+      compressedCert->getCompressedCert(
+          fizz::CertificateCompressionAlgorithm::brotli),
+      std::runtime_error);
+}
+
+TEST_F(PrecompressedCertCacheTest, DelegatesToCert) {
+  auto compressedCert = cache_->getCompressedCert(cert_);
+  EXPECT_EQ(cert_->getIdentity(), compressedCert->getIdentity());
+  EXPECT_EQ(cert_->getSigSchemes(), compressedCert->getSigSchemes());
+  auto signature = compressedCert->sign(
+      fizz::SignatureScheme::ecdsa_secp256r1_sha256,
+      fizz::CertificateVerifyContext::Server,
+      folly::StringPiece("data"));
+  EXPECT_EQ("signature", signature->moveToFbString().toStdString());
+}
+
+TEST_F(PrecompressedCertCacheTest, ApplyToContext) {
+  cache_->addCert(cert_, true);
+  fizz::server::FizzServerContext ctx;
+  cache_->apply(ctx);
+  EXPECT_EQ(
+      std::vector<fizz::CertificateCompressionAlgorithm>(
+          {fizz::CertificateCompressionAlgorithm::zlib}),
+      ctx.getSupportedCompressionAlgorithms());
+  // A copy of the context, like the handshakes make, serves the same cert.
+  fizz::server::FizzServerContext copy(ctx);
+  auto cert = copy.getCert(
+      std::string("quic.test"),
+      {fizz::SignatureScheme::ecdsa_secp256r1_sha256},
+      {fizz::SignatureScheme::ecdsa_secp256r1_sha256});
+  ASSERT_TRUE(cert.hasValue());
+  EXPECT_EQ(cache_->getCompressedCert(cert_), cert->first);
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/RetryTokenGenerator.h>
+#include <folly/Random.h>
+#include <folly/portability/GTest.h>
+
+using namespace quic;
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+class RetryTokenGeneratorTest : public Test {
+ protected:
+  void SetUp() override {
+    folly::Random::secureRandom(secret_.data(), secret_.size());
+    generator_ = std::make_unique<RetryTokenGenerator>(secret_, 10s);
+  }
+
+  RetryTokenSecret secret_;
+  std::unique_ptr<RetryTokenGenerator> generator_;
+  folly::IPAddress address_{"1.2.3.4"};
+  ConnectionId connId_{{0x14, 0x35, 0x22, 0x11, 0x01, 0x02, 0x03, 0x04}};
+  std::chrono::system_clock::time_point now_{std::chrono::system_clock::now()};
+};
+
+TEST_F(RetryTokenGeneratorTest, RoundTrip) {
+  auto token = generator_->encryptToken(address_, connId_, now_);
+  auto originalDstConnId =
+      generator_->decryptToken(std::move(token), address_, now_ + 1s);
+  ASSERT_TRUE(originalDstConnId.hasValue());
+  EXPECT_EQ(connId_, *originalDstConnId);
+
+  // Another server with the same secret validates it too.
+  RetryTokenGenerator other(secret_, 10s);
+  token = generator_->encryptToken(address_, connId_, now_);
+  EXPECT_EQ(connId_, other.decryptToken(std::move(token), address_, now_));
+}
+
+TEST_F(RetryTokenGeneratorTest, DifferentTokens) {
+  auto token1 = generator_->encryptToken(address_, connId_, now_);
+  auto token2 = generator_->encryptToken(address_, connId_, now_);
+  EXPECT_FALSE(folly::IOBufEqualTo()(*token1, *token2));
+}
+
+TEST_F(RetryTokenGeneratorTest, WrongAddress) {
+  auto token = generator_->encryptToken(address_, connId_, now_);
+  EXPECT_FALSE(generator_
+                   ->decryptToken(
+                       std::move(token), folly::IPAddress("1.2.3.5"), now_)
+                   .hasValue());
+  token = generator_->encryptToken(folly::IPAddress("::1"), connId_, now_);
+  EXPECT_FALSE(
+      generator_->decryptToken(std::move(token), address_, now_).hasValue());
+}
+
+TEST_F(RetryTokenGeneratorTest, WrongSecret) {
+  RetryTokenSecret otherSecret;
+  folly::Random::secureRandom(otherSecret.data(), otherSecret.size());
+  RetryTokenGenerator other(otherSecret, 10s);
+  auto token = generator_->encryptToken(address_, connId_, now_);
+  EXPECT_FALSE(other.decryptToken(std::move(token), address_, now_));
+}
+
+TEST_F(RetryTokenGeneratorTest, Expired) {
+  auto token = generator_->encryptToken(address_, connId_, now_);
+  EXPECT_FALSE(generator_->decryptToken(token->clone(), address_, now_ + 11s));
+  EXPECT_FALSE(generator_->decryptToken(token->clone(), address_, now_ - 1s));
+  EXPECT_TRUE(generator_->decryptToken(token->clone(), address_, now_ + 10s));
+}
+
+TEST_F(RetryTokenGeneratorTest, Tampered) {
+  auto token = generator_->encryptToken(address_, connId_, now_);
+  token->coalesce();
+  for (size_t i = 0; i < token->length(); i++) {
+    auto tampered = token->clone();
+    tampered->unshare();
+    tampered->writableData()[i] ^= 0x01;
+    EXPECT_FALSE(generator_->decryptToken(std::move(tampered), address_, now_))
+        << "byte " << i;
+  }
+  auto truncated = token->clone();
+  truncated->trimEnd(1);
+  EXPECT_FALSE(generator_->decryptToken(std::move(truncated), address_, now_));
+  EXPECT_FALSE(generator_->decryptToken(
+      folly::IOBuf::copyBuffer("short"), address_, now_));
+}
+
+} // namespace test
+} // namespace quic
@@ -18,6 +18,7 @@
 #include <fizz/protocol/test/Mocks.h>
 #include <fizz/server/test/Mocks.h>
 
+#include <folly/executors/ManualExecutor.h>
 #include <folly/io/async/SSLContext.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/io/async/test/MockAsyncTransport.h>
@@ -395,6 +396,41 @@ TEST_F(ServerHandshakeTest, TestMalformedHandshakeMessage) {
   EXPECT_TRUE(ex);
 }
 
+class ServerHandshakeCryptoExecutorTest : public ServerHandshakeTest {
+ public:
+  ~ServerHandshakeCryptoExecutorTest() override = default;
+
+  void initialize() override {
+    ServerHandshakeTest::initialize();
+    handshake->setCryptoExecutor(cryptoExecutor);
+  }
+
+  std::shared_ptr<folly::ManualExecutor> cryptoExecutor{
+      std::make_shared<folly::ManualExecutor>()};
+};
+
+TEST_F(ServerHandshakeCryptoExecutorTest, TestHandshakeSuccess) {
+  clientServerRound();
+  // The ClientHello waits for the crypto executor, nothing to write yet.
+  EXPECT_TRUE(cryptoState->initialStream.writeBuffer.empty());
+  EXPECT_TRUE(cryptoState->handshakeStream.writeBuffer.empty());
+  // Once it ran, the actions are back on the event base, and the callback
+  // passes the server flight to the client.
+  EXPECT_EQ(1, cryptoExecutor->run());
+  evb.loop();
+
+  serverClientRound();
+  // The client Finished is processed inline.
+  clientServerRound();
+  EXPECT_EQ(0, cryptoExecutor->run());
+  EXPECT_EQ(handshake->getPhase(), ServerHandshake::Phase::Established);
+  if (ex) {
+    std::rethrow_exception(ex);
+  }
+  expectOneRttCipher(true);
+  EXPECT_TRUE(handshakeSuccess);
+}
+
 class AsyncRejectingTicketCipher : public fizz::server::TicketCipher {
  public:
   ~AsyncRejectingTicketCipher() override = default;
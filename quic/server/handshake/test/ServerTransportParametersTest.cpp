@@ -89,6 +89,53 @@ TEST(ServerTransportParametersTest, TestGetExtensionsD18) {
   EXPECT_EQ(token, expectedToken);
 }
 
+static std::unique_ptr<ServerTransportParametersExtension> makeExtension(
+    const StatelessResetToken& token) {
+  return std::make_unique<ServerTransportParametersExtension>(
+      QuicVersion::MVFST_OLD,
+      std::vector<QuicVersion>{MVFST1, QuicVersion::MVFST_OLD},
+      kDefaultConnectionWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max(),
+      kDefaultIdleTimeout,
+      kDefaultAckDelayExponent,
+      kDefaultUDPSendPacketLen,
+      kDefaultPartialReliability,
+      token);
+}
+
+TEST(ServerTransportParametersTest, TestGetExtensionsCached) {
+  auto cache = std::make_shared<ServerTransportParametersCache>();
+  for (auto initialVersion :
+       {folly::Optional<QuicVersion>(QuicVersion::MVFST_OLD),
+        folly::Optional<QuicVersion>(folly::none)}) {
+    for (int i = 0; i < 2; ++i) {
+      auto token = generateStatelessResetToken();
+      auto cached = makeExtension(token);
+      cached->setCache(cache);
+      auto cachedExtensions =
+          cached->getExtensions(getClientHello(initialVersion));
+      auto extensions =
+          makeExtension(token)->getExtensions(getClientHello(initialVersion));
+      ASSERT_EQ(cachedExtensions.size(), 1);
+      EXPECT_TRUE(folly::IOBufEqualTo()(
+          cachedExtensions[0].extension_data, extensions[0].extension_data));
+
+      auto serverParams =
+          getExtension<ServerTransportParameters>(cachedExtensions);
+      ASSERT_TRUE(serverParams.hasValue());
+      EXPECT_EQ(
+          serverParams->negotiated_version.hasValue(),
+          initialVersion.hasValue());
+      EXPECT_EQ(
+          getStatelessResetTokenParameter(serverParams->parameters), token);
+    }
+  }
+}
+
 TEST(ServerTransportParametersTest, TestGetExtensionsMissingClientParams) {
   ServerTransportParametersExtension ext(
       QuicVersion::MVFST,
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/TicketKeyStore.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+namespace {
+
+class FakeTicketSecretSource : public TicketSecretSource {
+ public:
+  folly::Optional<std::vector<std::string>> getTicketSecrets() override {
+    return secrets;
+  }
+
+  folly::Optional<std::vector<std::string>> secrets;
+};
+
+} // namespace
+
+class TicketKeyStoreTest : public Test {
+ protected:
+  void SetUp() override {
+    store_ = std::make_shared<TicketKeyStore>(1h);
+    cipher_ = std::make_unique<RotatingTicketCipher>(store_);
+  }
+
+  std::unique_ptr<folly::IOBuf> encryptTicket(
+      const fizz::server::TicketCipher& cipher) {
+    fizz::server::ResumptionState resState;
+    resState.version = fizz::ProtocolVersion::tls_1_3;
+    resState.cipher = fizz::CipherSuite::TLS_AES_128_GCM_SHA256;
+    resState.resumptionSecret = folly::IOBuf::copyBuffer("resumption");
+    resState.alpn = "h3";
+    resState.ticketIssueTime = std::chrono::system_clock::now();
+    resState.handshakeTime = resState.ticketIssueTime;
+    auto ticket = cipher.encrypt(std::move(resState)).get();
+    if (!ticket) {
+      return nullptr;
+    }
+    return std::move(ticket->first);
+  }
+
+  fizz::PskType decryptTicket(
+      const fizz::server::TicketCipher& cipher,
+      const folly::IOBuf& ticket) {
+    return cipher.decrypt(ticket.clone()).get().first;
+  }
+
+  std::string secret(char c) {
+    return std::string(kMinTicketSecretLength, c);
+  }
+
+  std::shared_ptr<TicketKeyStore> store_;
+  std::unique_ptr<RotatingTicketCipher> cipher_;
+};
+
+TEST_F(TicketKeyStoreTest, NoSecrets) {
+  EXPECT_FALSE(store_->getCipher());
+  EXPECT_EQ(nullptr, encryptTicket(*cipher_));
+  EXPECT_EQ(
+      fizz::PskType::Rejected,
+      decryptTicket(*cipher_, *folly::IOBuf::copyBuffer("ticket")));
+  EXPECT_FALSE(store_->setTicketSecrets({}));
+  EXPECT_FALSE(store_->setTicketSecrets({"short"}));
+  EXPECT_FALSE(store_->getCipher());
+}
+
+TEST_F(TicketKeyStoreTest, SharedSecrets) {
+  ASSERT_TRUE(store_->setTicketSecrets({secret('a')}));
+  auto ticket = encryptTicket(*cipher_);
+  ASSERT_NE(nullptr, ticket);
+  EXPECT_EQ(fizz::PskType::Resumption, decryptTicket(*cipher_, *ticket));
+
+  // Another host with the same secrets resumes it.
+  auto otherStore = std::make_shared<TicketKeyStore>(1h);
+  ASSERT_TRUE(otherStore->setTicketSecrets({secret('a')}));
+  RotatingTicketCipher otherCipher(otherStore);
+  EXPECT_EQ(fizz::PskType::Resumption, decryptTicket(otherCipher, *ticket));
+
+  // But not one with other secrets.
+  ASSERT_TRUE(otherStore->setTicketSecrets({secret('b')}));
+  EXPECT_EQ(fizz::PskType::Rejected, decryptTicket(otherCipher, *ticket));
+}
+
+TEST_F(TicketKeyStoreTest, Rotation) {
+  ASSERT_TRUE(store_->setTicketSecrets({secret('a')}));
+  auto oldTicket = encryptTicket(*cipher_);
+  ASSERT_NE(nullptr, oldTicket);
+  // A handshake in flight keeps the cipher it has.
+  auto oldCipher = store_->getCipher();
+
+  // The new secret encrypts, the old one still decrypts.
+  ASSERT_TRUE(store_->setTicketSecrets({secret('b'), secret('a')}));
+  auto newTicket = encryptTicket(*cipher_);
+  ASSERT_NE(nullptr, newTicket);
+  EXPECT_EQ(fizz::PskType::Resumption, decryptTicket(*cipher_, *oldTicket));
+  EXPECT_EQ(fizz::PskType::Resumption, decryptTicket(*cipher_, *newTicket));
+  EXPECT_EQ(fizz::PskType::Rejected, decryptTicket(*oldCipher, *newTicket));
+
+  // Once the old secret is retired, its tickets are rejected.
+  ASSERT_TRUE(store_->setTicketSecrets({secret('b')}));
+  EXPECT_EQ(fizz::PskType::Rejected, decryptTicket(*cipher_, *oldTicket));
+  EXPECT_EQ(fizz::PskType::Resumption, decryptTicket(*cipher_, *newTicket));
+}
+
+TEST_F(TicketKeyStoreTest, Refresh) {
+  FakeTicketSecretSource source;
+  EXPECT_FALSE(store_->refresh(source));
+  EXPECT_FALSE(store_->getCipher());
+  source.secrets = std::vector<std::string>{secret('a')};
+  EXPECT_TRUE(store_->refresh(source));
+  EXPECT_TRUE(store_->getCipher());
+  // Bad secrets from the source don't replace the good ones.
+  source.secrets = std::vector<std::string>{"short"};
+  EXPECT_FALSE(store_->refresh(source));
+  EXPECT_TRUE(store_->getCipher());
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/state/ConnectionStateSerializer.h>
+
+#include <fizz/protocol/Factory.h>
+#include <folly/io/Cursor.h>
+#include <quic/handshake/FizzBridge.h>
+#include <quic/handshake/HandshakeLayer.h>
+#include <quic/handshake/QuicFizzFactory.h>
+#include <quic/state/StateMachine.h>
+
+namespace quic {
+
+namespace {
+
+constexpr uint8_t kConnectionStateFormatVersion = 1;
+
+void writeBytes(folly::io::Appender& appender, folly::ByteRange bytes) {
+  appender.writeBE<uint8_t>(bytes.size());
+  appender.push(bytes.data(), bytes.size());
+}
+
+std::vector<uint8_t> readBytes(folly::io::Cursor& cursor) {
+  std::vector<uint8_t> bytes(cursor.readBE<uint8_t>());
+  cursor.pull(bytes.data(), bytes.size());
+  return bytes;
+}
+
+void writeConnectionId(
+    folly::io::Appender& appender,
+    const ConnectionId& connId) {
+  writeBytes(appender, folly::range(connId));
+}
+
+ConnectionId readConnectionId(folly::io::Cursor& cursor) {
+  // Throws if the id is too long.
+  return ConnectionId(readBytes(cursor));
+}
+
+void writeOptionalPacketNum(
+    folly::io::Appender& appender,
+    const folly::Optional<PacketNum>& packetNum) {
+  appender.writeBE<uint8_t>(packetNum.hasValue());
+  appender.writeBE<uint64_t>(packetNum.value_or(0));
+}
+
+folly::Optional<PacketNum> readOptionalPacketNum(folly::io::Cursor& cursor) {
+  bool hasValue = cursor.readBE<uint8_t>();
+  auto packetNum = cursor.readBE<uint64_t>();
+  return hasValue ? folly::make_optional(packetNum) : folly::none;
+}
+
+void writeStreamIds(
+    folly::io::Appender& appender,
+    const std::deque<StreamId>& streamIds) {
+  appender.writeBE<uint64_t>(streamIds.size());
+  for (auto streamId : streamIds) {
+    appender.writeBE<uint64_t>(streamId);
+  }
+}
+
+std::deque<StreamId> readStreamIds(folly::io::Cursor& cursor) {
+  std::deque<StreamId> streamIds;
+  auto numStreamIds = cursor.readBE<uint64_t>();
+  for (uint64_t i = 0; i < numStreamIds; i++) {
+    streamIds.push_back(cursor.readBE<uint64_t>());
+  }
+  return streamIds;
+}
+
+bool isQuiescent(const QuicStreamState& stream) {
+  return stream.readBuffer.empty() && stream.writeBuffer.empty() &&
+      stream.retransmissionBuffer.empty() && stream.lossBuffer.empty() &&
+      matchesStates<StreamSendStateData, StreamSendStates::Open>(
+             stream.send.state) &&
+      matchesStates<StreamReceiveStateData, StreamReceiveStates::Open>(
+             stream.recv.state);
+}
+
+std::unique_ptr<Aead> makeOneRttCipher(
+    fizz::Factory& factory,
+    fizz::CipherSuite cipher,
+    folly::ByteRange secret) {
+  auto aead = factory.makeAead(cipher);
+  auto deriver = factory.makeKeyDeriver(cipher);
+  fizz::TrafficKey key;
+  key.key = deriver->expandLabel(
+      secret, kQuicKeyLabel, folly::IOBuf::create(0), aead->keyLength());
+  key.iv = deriver->expandLabel(
+      secret, kQuicIVLabel, folly::IOBuf::create(0), aead->ivLength());
+  aead->setKey(std::move(key));
+  return FizzAead::wrap(std::move(aead));
+}
+
+} // namespace
+
+folly::Optional<Buf> serializeConnectionState(
+    const QuicServerConnectionState& conn) {
+  if (!conn.serverHandshakeLayer ||
+      !conn.serverHandshakeLayer->isHandshakeDone()) {
+    VLOG(4) << "Not exporting connection state, handshake not done";
+    return folly::none;
+  }
+  auto secrets = conn.serverHandshakeLayer->getOneRttSecrets();
+  if (!secrets) {
+    VLOG(4) << "Not exporting connection state, secrets not retained";
+    return folly::none;
+  }
+  return serializeConnectionState(conn, *secrets);
+}
+
+folly::Optional<Buf> serializeConnectionState(
+    const QuicServerConnectionState& conn,
+    const OneRttSecrets& secrets) {
+  if (!conn.version || !conn.serverConnectionId ||
+      !conn.clientConnectionId || !conn.congestionController) {
+    VLOG(4) << "Not exporting connection state, connection not established";
+    return folly::none;
+  }
+  if (!conn.outstandingPackets.empty() ||
+      !conn.datagramState.readBuffer.empty() ||
+      !conn.datagramState.writeBuffer.empty()) {
+    VLOG(4) << "Not exporting connection state, data in flight";
+    return folly::none;
+  }
+  for (const auto& stream : conn.streamManager->streams()) {
+    if (!isQuiescent(stream.second)) {
+      VLOG(4) << "Not exporting connection state, stream=" << stream.first
+              << " has buffered data";
+      return folly::none;
+    }
+  }
+
+  auto buf = folly::IOBuf::create(kDefaultUDPSendPacketLen);
+  folly::io::Appender appender(buf.get(), kDefaultUDPSendPacketLen);
+  appender.writeBE<uint8_t>(kConnectionStateFormatVersion);
+  appender.writeBE<std::underlying_type<QuicVersion>::type>(
+      static_cast<std::underlying_type<QuicVersion>::type>(*conn.version));
+  writeConnectionId(appender, *conn.serverConnectionId);
+  writeConnectionId(appender, *conn.clientConnectionId);
+  auto peerIp = conn.peerAddress.getIPAddress().toByteArray();
+  writeBytes(appender, folly::range(peerIp));
+  appender.writeBE<uint16_t>(conn.peerAddress.getPort());
+
+  appender.writeBE<uint16_t>(static_cast<uint16_t>(secrets.cipher));
+  writeBytes(appender, folly::range(secrets.clientSecret));
+  writeBytes(appender, folly::range(secrets.serverSecret));
+
+  const auto& ackState = conn.ackStates.appDataAckState;
+  appender.writeBE<uint64_t>(ackState.nextPacketNum);
+  appender.writeBE<uint64_t>(ackState.largestAckedByPeer);
+  writeOptionalPacketNum(appender, ackState.largestReceivedPacketNum);
+  appender.writeBE<uint64_t>(ackState.acks.size());
+  for (const auto& interval : ackState.acks) {
+    appender.writeBE<uint64_t>(interval.start);
+    appender.writeBE<uint64_t>(interval.end);
+  }
+
+  appender.writeBE<uint64_t>(conn.lossState.srtt.count());
+  appender.writeBE<uint64_t>(conn.lossState.lrtt.count());
+  appender.writeBE<uint64_t>(conn.lossState.rttvar.count());
+  appender.writeBE<uint64_t>(conn.lossState.mrtt.count());
+  appender.writeBE<uint64_t>(conn.lossState.largestSent);
+  appender.writeBE<uint64_t>(conn.congestionController->getCongestionWindow());
+
+  appender.writeBE<uint64_t>(conn.peerIdleTimeout.count());
+  appender.writeBE<uint64_t>(conn.peerAckDelayExponent);
+  appender.writeBE<uint64_t>(conn.udpSendPacketLen);
+
+  const auto& flowControl = conn.flowControlState;
+  appender.writeBE<uint64_t>(flowControl.windowSize);
+  appender.writeBE<uint64_t>(flowControl.advertisedMaxOffset);
+  appender.writeBE<uint64_t>(flowControl.peerAdvertisedMaxOffset);
+  appender.writeBE<uint64_t>(flowControl.sumCurReadOffset);
+  appender.writeBE<uint64_t>(flowControl.sumMaxObservedOffset);
+  appender.writeBE<uint64_t>(flowControl.sumCurWriteOffset);
+  appender.writeBE<uint64_t>(
+      flowControl.peerAdvertisedInitialMaxStreamOffsetBidiLocal);
+  appender.writeBE<uint64_t>(
+      flowControl.peerAdvertisedInitialMaxStreamOffsetBidiRemote);
+  appender.writeBE<uint64_t>(
+      flowControl.peerAdvertisedInitialMaxStreamOffsetUni);
+
+  auto streamIds = conn.streamManager->getStreamIdState();
+  appender.writeBE<uint64_t>(streamIds.nextAcceptablePeerBidirectionalStreamId);
+  appender.writeBE<uint64_t>(
+      streamIds.nextAcceptablePeerUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(
+      streamIds.nextAcceptableLocalBidirectionalStreamId);
+  appender.writeBE<uint64_t>(
+      streamIds.nextAcceptableLocalUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.nextBidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.nextUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxLocalBidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxLocalUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxRemoteBidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxRemoteUnidirectionalStreamId);
+  writeStreamIds(appender, streamIds.openPeerStreams);
+  writeStreamIds(appender, streamIds.openLocalStreams);
+
+  appender.writeBE<uint64_t>(conn.streamManager->streams().size());
+  for (const auto& entry : conn.streamManager->streams()) {
+    const auto& stream = entry.second;
+    appender.writeBE<uint64_t>(stream.id);
+    appender.writeBE<uint64_t>(stream.currentWriteOffset);
+    appender.writeBE<uint64_t>(stream.currentReadOffset);
+    appender.writeBE<uint64_t>(stream.currentReceiveOffset);
+    appender.writeBE<uint64_t>(stream.maxOffsetObserved);
+    appender.writeBE<uint64_t>(stream.flowControlState.windowSize);
+    appender.writeBE<uint64_t>(stream.flowControlState.advertisedMaxOffset);
+    appender.writeBE<uint64_t>(
+        stream.flowControlState.peerAdvertisedMaxOffset);
+    appender.writeBE<uint8_t>(stream.isControl);
+  }
+  return std::move(buf);
+}
+
+bool restoreConnectionState(
+    QuicServerConnectionState& conn,
+    const folly::IOBuf& state) {
+  try {
+    folly::io::Cursor cursor(&state);
+    if (cursor.readBE<uint8_t>() != kConnectionStateFormatVersion) {
+      VLOG(4) << "Unknown connection state format";
+      return false;
+    }
+    auto version = static_cast<QuicVersion>(
+        cursor.readBE<std::underlying_type<QuicVersion>::type>());
+    auto serverConnectionId = readConnectionId(cursor);
+    auto clientConnectionId = readConnectionId(cursor);
+    auto peerIp = readBytes(cursor);
+    auto peerPort = cursor.readBE<uint16_t>();
+
+    auto cipher = static_cast<fizz::CipherSuite>(cursor.readBE<uint16_t>());
+    auto clientSecret = readBytes(cursor);
+    auto serverSecret = readBytes(cursor);
+
+    conn.version = version;
+    conn.serverConnectionId = serverConnectionId;
+    conn.clientConnectionId = clientConnectionId;
+    conn.peerAddress = folly::SocketAddress(
+        folly::IPAddress::fromBinary(folly::range(peerIp)), peerPort);
+    conn.originalPeerAddress = conn.peerAddress;
+
+    QuicFizzFactory fizzFactory;
+    conn.readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
+    conn.readCodec->setClientConnectionId(clientConnectionId);
+    conn.readCodec->setServerConnectionId(serverConnectionId);
+    conn.readCodec->setOneRttReadCipher(
+        makeOneRttCipher(fizzFactory, cipher, folly::range(clientSecret)));
+    conn.readCodec->setOneRttHeaderCipher(makePacketNumberCipher(
+        &fizzFactory, folly::range(clientSecret), cipher));
+    conn.oneRttWriteCipher =
+        makeOneRttCipher(fizzFactory, cipher, folly::range(serverSecret));
+    conn.oneRttWriteHeaderCipher = makePacketNumberCipher(
+        &fizzFactory, folly::range(serverSecret), cipher);
+
+    auto& ackState = conn.ackStates.appDataAckState;
+    ackState.nextPacketNum = cursor.readBE<uint64_t>();
+    ackState.largestAckedByPeer = cursor.readBE<uint64_t>();
+    ackState.largestReceivedPacketNum = readOptionalPacketNum(cursor);
+    auto numAckIntervals = cursor.readBE<uint64_t>();
+    for (uint64_t i = 0; i < numAckIntervals; i++) {
+      auto start = cursor.readBE<uint64_t>();
+      auto end = cursor.readBE<uint64_t>();
+      ackState.acks.insert(start, end);
+    }
+
+    conn.lossState.srtt = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    conn.lossState.lrtt = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    conn.lossState.rttvar =
+        std::chrono::microseconds(cursor.readBE<uint64_t>());
+    conn.lossState.mrtt = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    conn.lossState.largestSent = cursor.readBE<uint64_t>();
+    auto cwndBytes = cursor.readBE<uint64_t>();
+
+    conn.peerIdleTimeout =
+        std::chrono::milliseconds(cursor.readBE<uint64_t>());
+    conn.peerAckDelayExponent = cursor.readBE<uint64_t>();
+    conn.udpSendPacketLen = cursor.readBE<uint64_t>();
+    if (conn.udpSendPacketLen == 0) {
+      throw std::runtime_error("Invalid packet length");
+    }
+    conn.readCodec->setCodecParameters(
+        CodecParameters(conn.peerAckDelayExponent, version));
+
+    auto& flowControl = conn.flowControlState;
+    flowControl.windowSize = cursor.readBE<uint64_t>();
+    flowControl.advertisedMaxOffset = cursor.readBE<uint64_t>();
+    flowControl.peerAdvertisedMaxOffset = cursor.readBE<uint64_t>();
+    flowControl.sumCurReadOffset = cursor.readBE<uint64_t>();
+    flowControl.sumMaxObservedOffset = cursor.readBE<uint64_t>();
+    flowControl.sumCurWriteOffset = cursor.readBE<uint64_t>();
+    flowControl.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+        cursor.readBE<uint64_t>();
+    flowControl.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+        cursor.readBE<uint64_t>();
+    flowControl.peerAdvertisedInitialMaxStreamOffsetUni =
+        cursor.readBE<uint64_t>();
+
+    StreamIdState streamIds;
+    streamIds.nextAcceptablePeerBidirectionalStreamId =
+        cursor.readBE<uint64_t>();
+    streamIds.nextAcceptablePeerUnidirectionalStreamId =
+        cursor.readBE<uint64_t>();
+    streamIds.nextAcceptableLocalBidirectionalStreamId =
+        cursor.readBE<uint64_t>();
+    streamIds.nextAcceptableLocalUnidirectionalStreamId =
+        cursor.readBE<uint64_t>();
+    streamIds.nextBidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.nextUnidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.maxLocalBidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.maxLocalUnidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.maxRemoteBidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.maxRemoteUnidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.openPeerStreams = readStreamIds(cursor);
+    streamIds.openLocalStreams = readStreamIds(cursor);
+    conn.streamManager->setStreamIdState(streamIds);
+
+    auto numStreams = cursor.readBE<uint64_t>();
+    for (uint64_t i = 0; i < numStreams; i++) {
+      auto stream = conn.streamManager->getStream(cursor.readBE<uint64_t>());
+      stream->currentWriteOffset = cursor.readBE<uint64_t>();
+      stream->currentReadOffset = cursor.readBE<uint64_t>();
+      stream->currentReceiveOffset = cursor.readBE<uint64_t>();
+      stream->maxOffsetObserved = cursor.readBE<uint64_t>();
+      stream->flowControlState.windowSize = cursor.readBE<uint64_t>();
+      stream->flowControlState.advertisedMaxOffset = cursor.readBE<uint64_t>();
+      stream->flowControlState.peerAdvertisedMaxOffset =
+          cursor.readBE<uint64_t>();
+      stream->isControl = cursor.readBE<uint8_t>();
+    }
+
+    seedCongestionState(
+        conn,
+        CachedCongestionState{conn.lossState.srtt,
+                              conn.lossState.rttvar,
+                              conn.lossState.mrtt,
+                              cwndBytes,
+                              Clock::now()});
+    if (conn.congestionControllerFactory) {
+      conn.congestionController =
+          conn.congestionControllerFactory->makeCongestionController(
+              conn, conn.transportSettings.defaultCongestionController);
+    }
+  } catch (const std::exception& ex) {
+    VLOG(4) << "Failed to restore connection state: " << ex.what();
+    return false;
+  }
+  return true;
+}
+
+} // namespace quic
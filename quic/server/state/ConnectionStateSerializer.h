@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/server/handshake/ServerHandshake.h>
+#include <quic/server/state/ServerStateMachine.h>
+
+#include <folly/Optional.h>
+#include <folly/io/IOBuf.h>
+
+namespace quic {
+
+/**
+ * Serializes the state an established connection needs to carry on in
+ * another process, e.g. the new server during a hot restart: the connection
+ * ids, the 1-RTT secrets, the packet number and ack state, the flow control
+ * and stream offsets, and the path's rtt and congestion window.
+ *
+ * Only quiescent connections can be moved: no outstanding packets and no
+ * buffered stream or datagram data. Returns none otherwise, or when the
+ * 1-RTT secrets were not retained, see
+ * TransportSettings::connectionStateExportEnabled.
+ */
+folly::Optional<Buf> serializeConnectionState(
+    const QuicServerConnectionState& conn);
+
+/**
+ * Same as above with the given secrets, for callers that keep them along
+ * the connection themselves.
+ */
+folly::Optional<Buf> serializeConnectionState(
+    const QuicServerConnectionState& conn,
+    const OneRttSecrets& secrets);
+
+/**
+ * Restores a state from serializeConnectionState onto a fresh connection
+ * state, i.e. one that has not read or written any packet yet. The 1-RTT
+ * ciphers, the read codec, and the congestion controller are rebuilt.
+ * Returns false if the state cannot be parsed, in which case conn must be
+ * discarded.
+ */
+bool restoreConnectionState(
+    QuicServerConnectionState& conn,
+    const folly::IOBuf& state);
+
+} // namespace quic
@@ -12,6 +12,7 @@
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/handshake/TransportParameters.h>
 #include <quic/logging/QLoggerConstants.h>
+#include <quic/state/QuicFecFunctions.h>
 #include <quic/state/QuicPacingFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
 #include <quic/state/QuicTransportStatsCallback.h>
@@ -34,8 +35,11 @@ bool maybeNATRebinding(
     return true;
   }
 
-  return newIPAddr.isV4() && oldIPAddr.isV4() &&
-      newIPAddr.inSubnet(oldIPAddr, 24);
+  if (newIPAddr.isV4() && oldIPAddr.isV4()) {
+    return newIPAddr.inSubnet(oldIPAddr, kMigrationV4PrefixLen);
+  }
+  return newIPAddr.isV6() && oldIPAddr.isV6() &&
+      newIPAddr.inSubnet(oldIPAddr, kMigrationV6PrefixLen);
 }
 
 CongestionAndRttState moveCurrentCongestionAndRttState(
@@ -61,22 +65,68 @@ void resetCongestionAndRttState(QuicServerConnectionState& conn) {
   conn.lossState.rttvar = 0us;
 }
 
+void recoverCongestionAndRttState(
+    QuicServerConnectionState& conn,
+    CongestionAndRttState& state) {
+  conn.congestionController = std::move(state.congestionController);
+  conn.lossState.srtt = state.srtt;
+  conn.lossState.lrtt = state.lrtt;
+  conn.lossState.rttvar = state.rttvar;
+}
+
+bool isRecoverable(
+    const CongestionAndRttState& state,
+    const folly::SocketAddress& peerAddress) {
+  return state.peerAddress == peerAddress &&
+      Clock::now() - state.recordTime <=
+      kTimeToRetainLastCongestionAndRttState;
+}
+
 void recoverOrResetCongestionAndRttState(
     QuicServerConnectionState& conn,
     const folly::SocketAddress& peerAddress) {
   auto& lastState = conn.migrationState.lastCongestionAndRtt;
-  if (lastState && lastState->peerAddress == peerAddress &&
-      (Clock::now() - lastState->recordTime <=
-       kTimeToRetainLastCongestionAndRttState)) {
+  if (lastState && isRecoverable(*lastState, peerAddress)) {
     // recover from matched non-stale state
-    conn.congestionController = std::move(lastState->congestionController);
-    conn.lossState.srtt = lastState->srtt;
-    conn.lossState.lrtt = lastState->lrtt;
-    conn.lossState.rttvar = lastState->rttvar;
+    recoverCongestionAndRttState(conn, *lastState);
     conn.migrationState.lastCongestionAndRtt = folly::none;
-  } else {
-    resetCongestionAndRttState(conn);
+    return;
+  }
+  auto& olderStates = conn.migrationState.olderCongestionAndRtt;
+  auto it = std::find_if(
+      olderStates.begin(), olderStates.end(), [&](const auto& state) {
+        return isRecoverable(state, peerAddress);
+      });
+  if (it != olderStates.end()) {
+    recoverCongestionAndRttState(conn, *it);
+    olderStates.erase(it);
+    return;
+  }
+  resetCongestionAndRttState(conn);
+}
+
+void retainCongestionAndRttState(
+    QuicServerConnectionState& conn,
+    CongestionAndRttState state) {
+  auto& migrationState = conn.migrationState;
+  auto& olderStates = migrationState.olderCongestionAndRtt;
+  // A path has at most one state, the latest.
+  olderStates.erase(
+      std::remove_if(
+          olderStates.begin(),
+          olderStates.end(),
+          [&](const auto& olderState) {
+            return olderState.peerAddress == state.peerAddress;
+          }),
+      olderStates.end());
+  if (migrationState.lastCongestionAndRtt &&
+      migrationState.lastCongestionAndRtt->peerAddress != state.peerAddress) {
+    olderStates.push_back(std::move(*migrationState.lastCongestionAndRtt));
+    if (olderStates.size() > kMaxRetainedPathStates) {
+      olderStates.pop_front();
+    }
   }
+  migrationState.lastCongestionAndRtt = std::move(state);
 }
 } // namespace
 
@@ -109,6 +159,15 @@ void processClientInitialParams(
   auto partialReliability = getIntegerParameter(
       static_cast<TransportParameterId>(kPartialReliabilityParameterId),
       clientParams.parameters);
+  auto maxDatagramFrameSize = getIntegerParameter(
+      static_cast<TransportParameterId>(kMaxDatagramFrameSizeParameterId),
+      clientParams.parameters);
+  auto minAckDelay = getIntegerParameter(
+      static_cast<TransportParameterId>(kMinAckDelayParameterId),
+      clientParams.parameters);
+  auto fec = getIntegerParameter(
+      static_cast<TransportParameterId>(kFecParameterId),
+      clientParams.parameters);
   if (!packetSize || *packetSize == 0) {
     packetSize = kDefaultMaxUDPPayload;
   }
@@ -148,9 +207,10 @@ void processClientInitialParams(
   }
   conn.peerAckDelayExponent =
       ackDelayExponent.value_or(kDefaultAckDelayExponent);
-  // TODO: udpSendPacketLen should also be limited by PMTU
   if (conn.transportSettings.canIgnorePathMTU) {
     conn.udpSendPacketLen = *packetSize;
+  } else if (conn.transportSettings.pmtuDiscoveryEnabled) {
+    startPmtuDiscovery(conn, *packetSize);
   }
 
   if (partialReliability && *partialReliability != 0 &&
@@ -159,6 +219,13 @@ void processClientInitialParams(
   }
   VLOG(10) << "conn.partialReliabilityEnabled="
            << conn.partialReliabilityEnabled;
+  conn.datagramState.maxWriteFrameSize = maxDatagramFrameSize.value_or(0);
+  if (minAckDelay) {
+    conn.ackFrequencyState.peerMinAckDelay =
+        std::chrono::microseconds(*minAckDelay);
+  }
+  conn.fecState.enabled =
+      conn.transportSettings.fecEnabled && fec && *fec != 0;
 }
 
 void updateHandshakeState(QuicServerConnectionState& conn) {
@@ -234,8 +301,22 @@ void updateHandshakeState(QuicServerConnectionState& conn) {
     conn.readCodec->setHandshakeHeaderCipher(
         std::move(handshakeReadHeaderCipher));
   }
-  if (handshakeLayer->isHandshakeDone()) {
-    conn.readCodec->onHandshakeDone(Clock::now());
+  if (handshakeLayer->isHandshakeDone() &&
+      !conn.readCodec->getHandshakeDoneTime()) {
+    auto now = Clock::now();
+    conn.readCodec->onHandshakeDone(now);
+    // The client only finishes the handshake once it got all of our initial
+    // and handshake data.
+    if (conn.transportSettings.discardHandshakeSpaces) {
+      discardHandshakeSpaces(conn);
+    } else {
+      releaseHandshakeCryptoStreams(*conn.cryptoState);
+    }
+    QUIC_STATS(
+        conn.infoCallback,
+        onHandshakeDuration,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - conn.connectionTime));
   }
 }
 
@@ -352,6 +433,8 @@ void onConnectionMigration(
         conn.transportSettings.limitedCwndInMss * conn.udpSendPacketLen;
   } else {
     previousPeerAddresses.erase(it);
+    // Back on a validated path, it is not amplification limited.
+    conn.writableBytesLimit = folly::none;
   }
 
   // At this point, path validation scheduled, writable bytes limit set
@@ -377,10 +460,18 @@ void onConnectionMigration(
       // remember its congestion state and rtt stats
       CongestionAndRttState state = moveCurrentCongestionAndRttState(conn);
       recoverOrResetCongestionAndRttState(conn, newPeerAddress);
-      conn.migrationState.lastCongestionAndRtt = std::move(state);
+      retainCongestionAndRttState(conn, std::move(state));
     }
   }
 
+  // A new path gets a fresh connection id, when the peer issued one, so that
+  // the peer's paths cannot be linked by an observer. A NAT rebinding is not
+  // the peer's choice and keeps it.
+  if (!isNATRebinding && !conn.peerConnectionIds.empty()) {
+    conn.clientConnectionId = conn.peerConnectionIds.front().connectionId;
+    conn.peerConnectionIds.pop_front();
+  }
+
   conn.peerAddress = newPeerAddress;
 }
 
@@ -463,31 +554,47 @@ void onServerReadDataFromOpen(
 
     conn.serverConnectionId =
         conn.connIdAlgo->encodeConnectionId(*conn.serverConnIdParams);
+    conn.selfConnectionIds.push_back({0, *conn.serverConnectionId});
     StatelessResetGenerator generator(
         conn.transportSettings.statelessResetTokenSecret.value(),
         conn.serverAddr.getFullyQualified());
     StatelessResetToken token =
         generator.generateToken(*conn.serverConnectionId);
 
-    conn.serverHandshakeLayer->accept(
-        std::make_shared<ServerTransportParametersExtension>(
-            version,
-            conn.supportedVersions,
-            conn.transportSettings.advertisedInitialConnectionWindowSize,
-            conn.transportSettings.advertisedInitialBidiLocalStreamWindowSize,
-            conn.transportSettings.advertisedInitialBidiRemoteStreamWindowSize,
-            conn.transportSettings.advertisedInitialUniStreamWindowSize,
-            conn.transportSettings.advertisedInitialMaxStreamsBidi,
-            conn.transportSettings.advertisedInitialMaxStreamsUni,
-            conn.transportSettings.idleTimeout,
-            conn.transportSettings.ackDelayExponent,
-            conn.transportSettings.maxRecvPacketSize,
-            conn.transportSettings.partialReliabilityEnabled,
-            token));
+    conn.streamManager->setInitialMaxRemoteStreams(
+        conn.transportSettings.advertisedInitialMaxStreamsBidi,
+        conn.transportSettings.advertisedInitialMaxStreamsUni);
+    auto transportParams = std::make_shared<ServerTransportParametersExtension>(
+        version,
+        conn.supportedVersions,
+        conn.transportSettings.advertisedInitialConnectionWindowSize,
+        conn.transportSettings.advertisedInitialBidiLocalStreamWindowSize,
+        conn.transportSettings.advertisedInitialBidiRemoteStreamWindowSize,
+        conn.transportSettings.advertisedInitialUniStreamWindowSize,
+        conn.transportSettings.advertisedInitialMaxStreamsBidi,
+        conn.transportSettings.advertisedInitialMaxStreamsUni,
+        conn.transportSettings.idleTimeout,
+        conn.transportSettings.ackDelayExponent,
+        conn.transportSettings.maxRecvPacketSize,
+        conn.transportSettings.partialReliabilityEnabled,
+        token,
+        conn.transportSettings.datagramsEnabled ? kMaxDatagramFrameSize : 0,
+        conn.transportSettings.ackFrequencyEnabled
+            ? folly::make_optional(kMinAckDelay)
+            : folly::none,
+        conn.transportSettings.fecEnabled);
+    if (conn.transportParametersCache) {
+      transportParams->setCache(conn.transportParametersCache);
+    }
+    conn.serverHandshakeLayer->accept(std::move(transportParams));
     QuicFizzFactory fizzFactory;
     conn.readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
-    conn.readCodec->setInitialReadCipher(getClientInitialCipher(
-        &fizzFactory, initialDestinationConnectionId, version));
+    conn.readCodec->setInitialReadCipher(
+        conn.initialCipherPool
+            ? conn.initialCipherPool->getClientInitialCipher(
+                  &fizzFactory, initialDestinationConnectionId, version)
+            : getClientInitialCipher(
+                  &fizzFactory, initialDestinationConnectionId, version));
     conn.readCodec->setClientConnectionId(clientConnectionId);
     if (conn.qLogger) {
       conn.qLogger->scid = conn.serverConnectionId;
@@ -495,8 +602,11 @@ void onServerReadDataFromOpen(
     }
     conn.readCodec->setCodecParameters(
         CodecParameters(conn.peerAckDelayExponent, version));
-    conn.initialWriteCipher = getServerInitialCipher(
-        &fizzFactory, initialDestinationConnectionId, version);
+    conn.initialWriteCipher = conn.initialCipherPool
+        ? conn.initialCipherPool->getServerInitialCipher(
+              &fizzFactory, initialDestinationConnectionId, version)
+        : getServerInitialCipher(
+              &fizzFactory, initialDestinationConnectionId, version);
 
     conn.readCodec->setInitialHeaderCipher(makeClientInitialHeaderCipher(
         &fizzFactory, initialDestinationConnectionId, version));
@@ -519,7 +629,7 @@ void onServerReadDataFromOpen(
           if (!originalData.hasValue()) {
             VLOG(10) << "drop cipher unavailable, no data " << conn;
             if (conn.qLogger) {
-              conn.qLogger->addPacketDrop(packetSize, kCipherUnavailable.str());
+              conn.qLogger->addPacketDrop(packetSize, kCipherUnavailable);
             }
             QUIC_TRACE(packet_drop, conn, "cipher_unavailable");
             return false;
@@ -527,7 +637,7 @@ void onServerReadDataFromOpen(
           if (!originalData->packet || originalData->packet->empty()) {
             VLOG(10) << "drop because no data " << conn;
             if (conn.qLogger) {
-              conn.qLogger->addPacketDrop(packetSize, kNoData.str());
+              conn.qLogger->addPacketDrop(packetSize, kNoData);
             }
             QUIC_TRACE(packet_drop, conn, "no_data");
             return false;
@@ -537,7 +647,7 @@ void onServerReadDataFromOpen(
             VLOG(10) << "drop because unexpected protection level " << conn;
             if (conn.qLogger) {
               conn.qLogger->addPacketDrop(
-                  packetSize, kUnexpectedProtectionLevel.str());
+                  packetSize, kUnexpectedProtectionLevel);
             }
             QUIC_TRACE(packet_drop, conn, "unexpected_protection_level");
             return false;
@@ -549,7 +659,7 @@ void onServerReadDataFromOpen(
           if (combinedSize >= conn.transportSettings.maxPacketsToBuffer) {
             VLOG(10) << "drop because max buffered " << conn;
             if (conn.qLogger) {
-              conn.qLogger->addPacketDrop(packetSize, kMaxBuffered.str());
+              conn.qLogger->addPacketDrop(packetSize, kMaxBuffered);
             }
             QUIC_TRACE(packet_drop, conn, "max_buffered");
             return false;
@@ -559,6 +669,22 @@ void onServerReadDataFromOpen(
               originalData->protectionType == ProtectionType::ZeroRtt
               ? conn.pendingZeroRttData
               : conn.pendingOneRttData;
+          auto& packet = originalData->packet;
+          // The packet usually shares the buffer of the whole datagram, or
+          // of the read, which would be held for as long as it is pending.
+          if (packet->isChained() || packet->isShared() ||
+              packet->capacity() > 2 * packet->length()) {
+            packet = folly::IOBuf::copyBuffer(packet->coalesce());
+          }
+          if (pendingData && conn.pendingPacketBudget &&
+              !conn.pendingPacketBudget->reserve(packet->capacity())) {
+            VLOG(10) << "drop because worker max buffered " << conn;
+            if (conn.qLogger) {
+              conn.qLogger->addPacketDrop(packetSize, kMaxBuffered);
+            }
+            QUIC_TRACE(packet_drop, conn, "max_buffered");
+            return false;
+          }
           if (pendingData) {
             QUIC_TRACE(
                 packet_buffered,
@@ -570,7 +696,8 @@ void onServerReadDataFromOpen(
             pendingReadData.peer = readData.peer;
             pendingReadData.networkData = NetworkData(
                 std::move(originalData->packet),
-                readData.networkData.receiveTimePoint);
+                readData.networkData.receiveTimePoint,
+                readData.networkData.ecn);
             pendingData->emplace_back(std::move(pendingReadData));
             VLOG(10) << "Adding pending data to "
                      << toString(originalData->protectionType)
@@ -580,7 +707,7 @@ void onServerReadDataFromOpen(
                      << toString(originalData->protectionType)
                      << " buffer no longer available " << conn;
             if (conn.qLogger) {
-              conn.qLogger->addPacketDrop(packetSize, kBufferUnavailable.str());
+              conn.qLogger->addPacketDrop(packetSize, kBufferUnavailable);
             }
             QUIC_TRACE(packet_drop, conn, "buffer_unavailable");
           }
@@ -589,7 +716,7 @@ void onServerReadDataFromOpen(
         [&](const auto&) {
           VLOG(10) << "drop because reset " << conn;
           if (conn.qLogger) {
-            conn.qLogger->addPacketDrop(packetSize, kReset.str());
+            conn.qLogger->addPacketDrop(packetSize, kReset);
           }
           QUIC_TRACE(packet_drop, conn, "reset");
           return false;
@@ -690,10 +817,17 @@ void onServerReadDataFromOpen(
         conn.qLogger->scid = conn.serverConnectionId;
       }
     }
-    if (conn.qLogger) {
+    if (conn.qLogger &&
+        conn.qLogger->samplePacket(QLogEventType::PacketReceived)) {
       conn.qLogger->addPacket(regularPacket, packetSize);
     }
     QUIC_TRACE(packet_recvd, conn, packetNum, packetSize);
+    QUIC_PROBE(
+        packet_received,
+        conn,
+        static_cast<uint8_t>(packetNumberSpace),
+        packetNum,
+        packetSize);
     // We assume that the higher layer takes care of validating that the version
     // is supported.
     if (!conn.version) {
@@ -733,9 +867,28 @@ void onServerReadDataFromOpen(
       }
     }
 
+    if (exceedsReassemblyBudget(conn, regularPacket)) {
+      // Not acked, the peer sends the data again once it is declared lost.
+      VLOG(10) << "drop over the reassembly budget packet=" << packetNum << " "
+               << conn;
+      if (conn.qLogger) {
+        conn.qLogger->addPacketDrop(
+            packetSize,
+            QuicTransportStatsCallback::toString(
+                PacketDropReason::REASSEMBLY_BUDGET_EXCEEDED));
+      }
+      QUIC_STATS(
+          conn.infoCallback,
+          onPacketDropped,
+          PacketDropReason::REASSEMBLY_BUDGET_EXCEEDED);
+      continue;
+    }
+
     auto& ackState = getAckState(conn, packetNumberSpace);
     auto outOfOrder = updateLargestReceivedPacketNum(
         ackState, packetNum, readData.networkData.receiveTimePoint);
+    updateECNCountsRecvd(ackState, readData.networkData.ecn);
+    pruneAckRanges(conn, ackState, readData.networkData.receiveTimePoint);
     DCHECK(hasReceivedPackets(conn));
 
     bool pktHasRetransmittableData = false;
@@ -837,6 +990,7 @@ void onServerReadDataFromOpen(
                      << " fin=" << frame.fin << " " << conn;
             pktHasRetransmittableData = true;
             isNonProbingPacket = true;
+            fecOnStreamFrameReceived(conn, packetNum, frame);
             auto stream = conn.streamManager->getStream(frame.streamId);
             // Ignore data from closed streams that we don't have the
             // state for any more.
@@ -941,6 +1095,11 @@ void onServerReadDataFromOpen(
                 packetNum,
                 readData.peer != conn.peerAddress);
           },
+          [&](DatagramFrame& datagramFrame) {
+            pktHasRetransmittableData = true;
+            isNonProbingPacket = true;
+            handleDatagram(conn, datagramFrame);
+          },
           [&](auto&) {
             // TODO update isNonProbingPacket
           });
@@ -952,14 +1111,17 @@ void onServerReadDataFromOpen(
     updateWritableByteLimitOnRecvPacket(conn);
 
     if (conn.peerAddress != readData.peer) {
-      // TODO use new conn id, make sure the other endpoint has new conn id
       if (isNonProbingPacket) {
         if (packetNum == ackState.largestReceivedPacketNum) {
           onConnectionMigration(conn, readData.peer);
         }
       } else {
-        // Server will need to response with PathResponse to the new address
-        // while not updating peerAddress to new address
+        // A probe of a path the peer may migrate to later. The connection
+        // stays on the current path, and keeps going: the probe's
+        // PathResponse goes out on the current path, since the transport only
+        // writes to peerAddress.
+        VLOG(4) << "Probing packet from new peer=" << readData.peer << " "
+                << conn;
         if (conn.qLogger) {
           conn.qLogger->addPacketDrop(
               packetSize,
@@ -970,8 +1132,6 @@ void onServerReadDataFromOpen(
             conn.infoCallback,
             onPacketDropped,
             PacketDropReason::PEER_ADDRESS_CHANGE);
-        throw QuicTransportException(
-            "Probing not supported yet", TransportErrorCode::INVALID_MIGRATION);
       }
     }
 
@@ -1057,7 +1217,7 @@ void onServerReadDataFromClosed(
       [&](folly::Optional<CipherUnavailable>&) {
         VLOG(10) << "drop cipher unavailable " << conn;
         if (conn.qLogger) {
-          conn.qLogger->addPacketDrop(packetSize, kCipherUnavailable.str());
+          conn.qLogger->addPacketDrop(packetSize, kCipherUnavailable);
         }
         QUIC_TRACE(packet_drop, conn, "cipher_unavailable");
         return false;
@@ -1065,7 +1225,7 @@ void onServerReadDataFromClosed(
       [&](const auto&) {
         VLOG(10) << "drop because reset " << conn;
         if (conn.qLogger) {
-          conn.qLogger->addPacketDrop(packetSize, kReset.str());
+          conn.qLogger->addPacketDrop(packetSize, kReset);
         }
         QUIC_TRACE(packet_drop, conn, "reset");
         return false;
@@ -1111,10 +1271,17 @@ void onServerReadDataFromClosed(
   auto pnSpace = folly::variant_match(
       regularOptional->header,
       [](const auto& h) { return h.getPacketNumberSpace(); });
-  if (conn.qLogger) {
+  if (conn.qLogger &&
+      conn.qLogger->samplePacket(QLogEventType::PacketReceived)) {
     conn.qLogger->addPacket(regularPacket, packetSize);
   }
   QUIC_TRACE(packet_recvd, conn, packetNum, packetSize);
+  QUIC_PROBE(
+      packet_received,
+      conn,
+      static_cast<uint8_t>(pnSpace),
+      packetNum,
+      packetSize);
 
   bool isProtectedPacket = protectionLevel == ProtectionType::ZeroRtt ||
       protectionLevel == ProtectionType::KeyPhaseZero ||
@@ -1172,4 +1339,17 @@ void onServerCloseOpenState(QuicServerConnectionState& conn) {
   conn.state = ServerState::Closed;
 }
 
+void releasePendingPacketBudget(
+    QuicServerConnectionState& conn,
+    const std::vector<ServerEvents::ReadData>& pendingData) {
+  if (!conn.pendingPacketBudget) {
+    return;
+  }
+  uint64_t bytes = 0;
+  for (const auto& pendingPacket : pendingData) {
+    bytes += pendingPacket.networkData.data->capacity();
+  }
+  conn.pendingPacketBudget->release(bytes);
+}
+
 } // namespace quic
@@ -9,16 +9,21 @@
 #pragma once
 
 #include <glog/logging.h>
+#include <deque>
 #include <memory>
 #include <vector>
 
 #include <quic/QuicException.h>
 #include <quic/codec/Types.h>
+#include <quic/common/BlockRecycler.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
 #include <quic/congestion_control/QuicCubic.h>
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/logging/QuicLogger.h>
 #include <quic/loss/QuicLossFunctions.h>
+#include <quic/handshake/InitialCipherPool.h>
+#include <quic/server/CongestionStateCache.h>
+#include <quic/server/PendingPacketBudget.h>
 #include <quic/server/handshake/ServerHandshake.h>
 #include <quic/state/AckHandlers.h>
 #include <quic/state/QPRFunctions.h>
@@ -50,24 +55,6 @@ struct ServerEvents {
   struct Close {};
 };
 
-struct CongestionAndRttState {
-  // The corresponding peer address
-  folly::SocketAddress peerAddress;
-
-  // Time when this state is recorded, i.e. when migration happens
-  TimePoint recordTime;
-
-  // Congestion controller
-  std::unique_ptr<CongestionController> congestionController;
-
-  // Smooth rtt
-  std::chrono::microseconds srtt;
-  // Latest rtt
-  std::chrono::microseconds lrtt;
-  // Rtt var
-  std::chrono::microseconds rttvar;
-};
-
 struct ConnectionMigrationState {
   uint32_t numMigrations{0};
 
@@ -76,11 +63,24 @@ struct ConnectionMigrationState {
 
   // Congestion state and rtt stats of last validated peer
   folly::Optional<CongestionAndRttState> lastCongestionAndRtt;
+
+  // Same for the validated peers before it, oldest first. At most
+  // kMaxRetainedPathStates are kept.
+  std::deque<CongestionAndRttState> olderCongestionAndRtt;
 };
 
 struct QuicServerConnectionState : public QuicConnectionStateBase {
   ~QuicServerConnectionState() override = default;
 
+  // Recycled with the rest of the connection, see BlockRecycler.
+  static void* operator new(size_t size) {
+    return BlockRecycler::allocate(size);
+  }
+
+  static void operator delete(void* p, size_t size) noexcept {
+    BlockRecycler::deallocate(p, size);
+  }
+
   ServerState state;
 
   // Data which we cannot read yet, because the handshake has not completed.
@@ -113,6 +113,23 @@ struct QuicServerConnectionState : public QuicConnectionStateBase {
   // Server address of VIP. Currently used as input for stateless reset token.
   folly::SocketAddress serverAddr;
 
+  // Path state cache of the owning worker, if it has one.
+  CongestionStateCache* congestionStateCache{nullptr};
+
+  // Budget of the owning worker the pending data is charged to, if it has
+  // one.
+  PendingPacketBudget* pendingPacketBudget{nullptr};
+
+  // Initial cipher pool of the owning worker, if it has one.
+  std::shared_ptr<InitialCipherPool> initialCipherPool;
+
+  // Encoded transport parameters of the owning worker, if it has them.
+  std::shared_ptr<ServerTransportParametersCache> transportParametersCache;
+
+  // Path state from the ticket of a resumed connection, until the first rtt
+  // sample decides whether the congestion controller can use it.
+  folly::Optional<TicketCongestionState> ticketCongestionState;
+
   QuicServerConnectionState() : QuicConnectionStateBase(QuicNodeType::Server) {
     state = ServerState::Open;
     // Create the crypto stream.
@@ -181,4 +198,12 @@ void updateTransportParamsFromTicket(
 void onConnectionMigration(
     QuicServerConnectionState& conn,
     const folly::SocketAddress& newPeerAddress);
+
+/**
+ * Gives the bytes of the packets of pendingData back to the pending packet
+ * budget of the connection, once they are processed or dropped.
+ */
+void releasePendingPacketBudget(
+    QuicServerConnectionState& conn,
+    const std::vector<ServerEvents::ReadData>& pendingData);
 } // namespace quic
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/ClosedConnectionTable.h>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/test/MockAsyncUDPSocket.h>
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+class ClosedConnectionTableTest : public Test {
+ protected:
+  folly::EventBase evb_;
+  folly::test::MockAsyncUDPSocket sock_{&evb_};
+  ClosedConnectionTable table_{evb_.timer()};
+  ConnectionId connId1_{std::vector<uint8_t>{1, 2, 3, 4, 5, 6, 7, 8}};
+  ConnectionId connId2_{std::vector<uint8_t>{8, 7, 6, 5, 4, 3, 2, 1}};
+  folly::SocketAddress peer_{"1.2.3.4", 1234};
+};
+
+TEST_F(ClosedConnectionTableTest, ResendCloseWithBackoff) {
+  auto closePacket = folly::IOBuf::copyBuffer("close");
+  closePacket->prependChain(folly::IOBuf::copyBuffer("packet"));
+  table_.add({connId1_, connId2_}, folly::none, peer_, closePacket.get(), 1s);
+  EXPECT_EQ(table_.size(), 1);
+
+  std::vector<std::string> sent;
+  EXPECT_CALL(sock_, write(peer_, _))
+      .WillRepeatedly(Invoke([&](const auto&, const auto& buf) {
+        // Copied into a single buffer.
+        EXPECT_FALSE(buf->isChained());
+        sent.emplace_back(
+            reinterpret_cast<const char*>(buf->data()), buf->length());
+        return buf->length();
+      }));
+  // Sent again after 1, 2 and 4 more packets.
+  for (int i = 0; i < 7; i++) {
+    EXPECT_TRUE(table_.onPacket(
+        i % 2 ? connId1_ : connId2_, folly::none, sock_));
+  }
+  ASSERT_EQ(sent.size(), 3);
+  EXPECT_EQ(sent[0], "closepacket");
+
+  ConnectionId otherConnId({0, 0, 0, 0, 0, 0, 0, 0});
+  EXPECT_FALSE(table_.onPacket(otherConnId, folly::none, sock_));
+}
+
+TEST_F(ClosedConnectionTableTest, NoClosePacket) {
+  ClosedConnectionTable::SourceIdentity source(peer_, connId2_);
+  table_.add({connId1_}, source, peer_, nullptr, 1s);
+  EXPECT_CALL(sock_, write(_, _)).Times(0);
+  EXPECT_TRUE(table_.onPacket(connId1_, folly::none, sock_));
+  ConnectionId initialConnId({0, 0, 0, 0, 0, 0, 0, 0});
+  EXPECT_TRUE(table_.onPacket(initialConnId, source, sock_));
+  EXPECT_FALSE(table_.onPacket(
+      initialConnId,
+      ClosedConnectionTable::SourceIdentity(peer_, initialConnId),
+      sock_));
+}
+
+TEST_F(ClosedConnectionTableTest, RecordExpires) {
+  table_.add({connId1_}, folly::none, peer_, nullptr, 10ms);
+  ClosedConnectionTable::SourceIdentity source(peer_, connId1_);
+  table_.add({connId2_}, source, peer_, nullptr, 1s);
+  EXPECT_EQ(table_.size(), 2);
+  evb_.runAfterDelay([&] { evb_.terminateLoopSoon(); }, 100);
+  evb_.loopForever();
+  EXPECT_EQ(table_.size(), 1);
+  EXPECT_FALSE(table_.onPacket(connId1_, folly::none, sock_));
+  EXPECT_TRUE(table_.onPacket(connId2_, folly::none, sock_));
+}
+
+TEST_F(ClosedConnectionTableTest, ReplaceStaleRecord) {
+  table_.add({connId1_, connId2_}, folly::none, peer_, nullptr, 1s);
+  table_.add({connId2_}, folly::none, peer_, nullptr, 1s);
+  // The first record is gone with all of its connection ids.
+  EXPECT_EQ(table_.size(), 1);
+  EXPECT_FALSE(table_.onPacket(connId1_, folly::none, sock_));
+  EXPECT_TRUE(table_.onPacket(connId2_, folly::none, sock_));
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/CongestionStateCache.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/server/state/ServerStateMachine.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+class CongestionStateCacheTest : public Test {
+ protected:
+  void SetUp() override {
+    conn_.lossState.srtt = 20ms;
+    conn_.lossState.lrtt = 22ms;
+    conn_.lossState.rttvar = 5ms;
+    conn_.lossState.mrtt = 18ms;
+  }
+
+  QuicServerConnectionState conn_;
+  CongestionStateCache cache_{2, std::chrono::seconds(10)};
+};
+
+TEST_F(CongestionStateCacheTest, SameSubnet) {
+  auto now = Clock::now();
+  cache_.update(folly::IPAddress("10.0.0.1"), conn_, now);
+  auto cached = cache_.get(folly::IPAddress("10.0.0.200"), now);
+  ASSERT_TRUE(cached.hasValue());
+  EXPECT_EQ(20ms, cached->srtt);
+  EXPECT_EQ(5ms, cached->rttvar);
+  EXPECT_EQ(18ms, cached->minRtt);
+  EXPECT_EQ(
+      conn_.congestionController->getCongestionWindow(), cached->cwndBytes);
+
+  EXPECT_FALSE(cache_.get(folly::IPAddress("10.0.1.1"), now).hasValue());
+  // An IPv4 mapped IPv6 address is in the same subnet.
+  EXPECT_TRUE(cache_.get(folly::IPAddress("::ffff:10.0.0.2"), now).hasValue());
+}
+
+TEST_F(CongestionStateCacheTest, Ipv6Subnet) {
+  auto now = Clock::now();
+  cache_.update(folly::IPAddress("2001:db8:0:1::1"), conn_, now);
+  EXPECT_TRUE(
+      cache_.get(folly::IPAddress("2001:db8:0:1:ffff::1"), now).hasValue());
+  EXPECT_FALSE(cache_.get(folly::IPAddress("2001:db8:0:2::1"), now).hasValue());
+}
+
+TEST_F(CongestionStateCacheTest, IgnoreConnectionWithoutRttSample) {
+  conn_.lossState.lrtt = 0us;
+  cache_.update(folly::IPAddress("10.0.0.1"), conn_, Clock::now());
+  EXPECT_EQ(0, cache_.size());
+}
+
+TEST_F(CongestionStateCacheTest, Expire) {
+  auto now = Clock::now();
+  cache_.update(folly::IPAddress("10.0.0.1"), conn_, now);
+  EXPECT_TRUE(cache_.get(folly::IPAddress("10.0.0.1"), now + 10s).hasValue());
+  EXPECT_FALSE(cache_.get(folly::IPAddress("10.0.0.1"), now + 11s).hasValue());
+  EXPECT_EQ(0, cache_.size());
+}
+
+TEST_F(CongestionStateCacheTest, EvictLeastRecentlyUsed) {
+  auto now = Clock::now();
+  cache_.update(folly::IPAddress("10.0.0.1"), conn_, now);
+  cache_.update(folly::IPAddress("10.0.1.1"), conn_, now);
+  EXPECT_TRUE(cache_.get(folly::IPAddress("10.0.0.1"), now).hasValue());
+  cache_.update(folly::IPAddress("10.0.2.1"), conn_, now);
+  EXPECT_EQ(2, cache_.size());
+  EXPECT_TRUE(cache_.get(folly::IPAddress("10.0.0.1"), now).hasValue());
+  EXPECT_FALSE(cache_.get(folly::IPAddress("10.0.1.1"), now).hasValue());
+  EXPECT_TRUE(cache_.get(folly::IPAddress("10.0.2.1"), now).hasValue());
+}
+
+TEST_F(CongestionStateCacheTest, SeedCongestionState) {
+  QuicServerConnectionState conn;
+  CachedCongestionState state;
+  state.srtt = 20ms;
+  state.rttvar = 5ms;
+  state.cwndBytes = 100 * conn.udpSendPacketLen;
+  seedCongestionState(conn, state);
+  EXPECT_EQ(20ms, conn.lossState.srtt);
+  EXPECT_EQ(5ms, conn.lossState.rttvar);
+  EXPECT_EQ(100, conn.transportSettings.initCwndInMss);
+
+  // The seeded cwnd stays within initCwndInMss and maxCwndInMss.
+  QuicServerConnectionState smallConn;
+  auto initCwndInMss = smallConn.transportSettings.initCwndInMss;
+  state.cwndBytes = smallConn.udpSendPacketLen;
+  seedCongestionState(smallConn, state);
+  EXPECT_EQ(initCwndInMss, smallConn.transportSettings.initCwndInMss);
+
+  QuicServerConnectionState largeConn;
+  state.cwndBytes = std::numeric_limits<uint64_t>::max();
+  seedCongestionState(largeConn, state);
+  EXPECT_EQ(
+      largeConn.transportSettings.maxCwndInMss,
+      largeConn.transportSettings.initCwndInMss);
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/state/ConnectionStateSerializer.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/CongestionControllerFactory.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class ConnectionStateSerializerTest : public Test {
+ protected:
+  void SetUp() override {
+    conn_.version = QuicVersion::MVFST;
+    conn_.serverConnectionId = getTestConnectionId(1);
+    conn_.clientConnectionId = getTestConnectionId(2);
+    conn_.peerAddress = folly::SocketAddress("1.2.3.4", 1234);
+    secrets_.cipher = fizz::CipherSuite::TLS_AES_128_GCM_SHA256;
+    secrets_.clientSecret = std::vector<uint8_t>(32, 0x11);
+    secrets_.serverSecret = std::vector<uint8_t>(32, 0x22);
+  }
+
+  QuicServerConnectionState conn_;
+  OneRttSecrets secrets_;
+};
+
+TEST_F(ConnectionStateSerializerTest, RoundTrip) {
+  conn_.ackStates.appDataAckState.nextPacketNum = 100;
+  conn_.ackStates.appDataAckState.largestAckedByPeer = 99;
+  conn_.ackStates.appDataAckState.largestReceivedPacketNum = 50;
+  conn_.ackStates.appDataAckState.acks.insert(10, 20);
+  conn_.ackStates.appDataAckState.acks.insert(30, 50);
+  conn_.lossState.srtt = 30ms;
+  conn_.lossState.rttvar = 5ms;
+  conn_.lossState.mrtt = 20ms;
+  conn_.lossState.largestSent = 99;
+  conn_.flowControlState.peerAdvertisedMaxOffset = 5000;
+  conn_.flowControlState.sumCurWriteOffset = 1000;
+  auto stream = conn_.streamManager->createNextBidirectionalStream().value();
+  stream->currentWriteOffset = 1000;
+  stream->flowControlState.peerAdvertisedMaxOffset = 2000;
+  stream->isControl = true;
+  auto streamId = stream->id;
+
+  auto state = serializeConnectionState(conn_, secrets_);
+  ASSERT_TRUE(state.hasValue());
+
+  QuicServerConnectionState restored;
+  restored.congestionControllerFactory =
+      std::make_shared<DefaultCongestionControllerFactory>();
+  ASSERT_TRUE(restoreConnectionState(restored, **state));
+  EXPECT_EQ(QuicVersion::MVFST, *restored.version);
+  EXPECT_EQ(getTestConnectionId(1), *restored.serverConnectionId);
+  EXPECT_EQ(getTestConnectionId(2), *restored.clientConnectionId);
+  EXPECT_EQ(conn_.peerAddress, restored.peerAddress);
+  EXPECT_NE(nullptr, restored.readCodec);
+  EXPECT_NE(nullptr, restored.oneRttWriteCipher);
+  EXPECT_NE(nullptr, restored.oneRttWriteHeaderCipher);
+
+  const auto& ackState = restored.ackStates.appDataAckState;
+  EXPECT_EQ(100, ackState.nextPacketNum);
+  EXPECT_EQ(99, ackState.largestAckedByPeer);
+  EXPECT_EQ(50, *ackState.largestReceivedPacketNum);
+  EXPECT_EQ(2, ackState.acks.size());
+  EXPECT_EQ(30ms, restored.lossState.srtt);
+  EXPECT_EQ(5ms, restored.lossState.rttvar);
+  EXPECT_EQ(20ms, restored.lossState.mrtt);
+  EXPECT_EQ(5000, restored.flowControlState.peerAdvertisedMaxOffset);
+  EXPECT_EQ(1000, restored.flowControlState.sumCurWriteOffset);
+  EXPECT_NE(nullptr, restored.congestionController);
+
+  ASSERT_EQ(1, restored.streamManager->streams().size());
+  auto restoredStream = restored.streamManager->getStream(streamId);
+  EXPECT_EQ(1000, restoredStream->currentWriteOffset);
+  EXPECT_EQ(2000, restoredStream->flowControlState.peerAdvertisedMaxOffset);
+  EXPECT_TRUE(restoredStream->isControl);
+  // The next local stream follows the restored one.
+  auto next = restored.streamManager->createNextBidirectionalStream().value();
+  EXPECT_EQ(streamId + 4, next->id);
+}
+
+TEST_F(ConnectionStateSerializerTest, RefusesBusyConnection) {
+  auto stream = conn_.streamManager->createNextBidirectionalStream().value();
+  stream->writeBuffer.append(folly::IOBuf::copyBuffer("hello"));
+  EXPECT_FALSE(serializeConnectionState(conn_, secrets_).hasValue());
+  stream->writeBuffer.move();
+
+  conn_.datagramState.writeBuffer.push_back(folly::IOBuf::copyBuffer("a"));
+  EXPECT_FALSE(serializeConnectionState(conn_, secrets_).hasValue());
+  conn_.datagramState.writeBuffer.clear();
+  EXPECT_TRUE(serializeConnectionState(conn_, secrets_).hasValue());
+}
+
+TEST_F(ConnectionStateSerializerTest, RefusesWithoutHandshake) {
+  EXPECT_FALSE(serializeConnectionState(conn_).hasValue());
+}
+
+TEST_F(ConnectionStateSerializerTest, RejectsTruncatedState) {
+  auto state = serializeConnectionState(conn_, secrets_);
+  ASSERT_TRUE(state.hasValue());
+  auto data = (*state)->coalesce();
+  for (size_t len : {size_t(0), size_t(1), data.size() / 2, data.size() - 1}) {
+    QuicServerConnectionState restored;
+    EXPECT_FALSE(restoreConnectionState(
+        restored, *folly::IOBuf::copyBuffer(data.data(), len)));
+  }
+}
+
+} // namespace test
+} // namespace quic
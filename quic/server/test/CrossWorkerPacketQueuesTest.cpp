@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/CrossWorkerPacketQueues.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+
+#include <thread>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+
+ForwardedPacket makePacket(uint16_t port, const std::string& data) {
+  RoutingData routingData(
+      HeaderForm::Short, false, false, getTestConnectionId(), folly::none);
+  NetworkData networkData(folly::IOBuf::copyBuffer(data), Clock::now());
+  return ForwardedPacket(
+      folly::SocketAddress("1.2.3.4", port),
+      std::move(routingData),
+      std::move(networkData));
+}
+
+} // namespace
+
+TEST(CrossWorkerPacketQueuesTest, PushDrain) {
+  CrossWorkerPacketQueues queues(3, 10);
+  auto packet = makePacket(1, "a");
+  EXPECT_TRUE(queues.push(0, 2, packet));
+  packet = makePacket(2, "b");
+  EXPECT_TRUE(queues.push(1, 2, packet));
+  packet = makePacket(3, "c");
+  EXPECT_TRUE(queues.push(0, 1, packet));
+
+  std::vector<uint16_t> ports;
+  EXPECT_EQ(2, queues.drain(2, [&](ForwardedPacket&& forwarded) {
+    ports.push_back(forwarded.client.getPort());
+    EXPECT_EQ(1, forwarded.networkData.data->computeChainDataLength());
+  }));
+  EXPECT_EQ(std::vector<uint16_t>({1, 2}), ports);
+  EXPECT_EQ(0, queues.drain(2, [](ForwardedPacket&&) {}));
+  EXPECT_EQ(1, queues.drain(1, [](ForwardedPacket&&) {}));
+}
+
+TEST(CrossWorkerPacketQueuesTest, Full) {
+  CrossWorkerPacketQueues queues(2, 2);
+  for (int i = 0; i < 2; i++) {
+    auto packet = makePacket(i, "a");
+    EXPECT_TRUE(queues.push(0, 1, packet));
+  }
+  auto packet = makePacket(2, "full");
+  EXPECT_FALSE(queues.push(0, 1, packet));
+  // Left alone for the caller.
+  EXPECT_EQ("full", packet.networkData.data->moveToFbString().toStdString());
+  // The other rings of the destination are not full.
+  packet = makePacket(3, "b");
+  EXPECT_TRUE(queues.push(1, 1, packet));
+  EXPECT_EQ(3, queues.drain(1, [](ForwardedPacket&&) {}));
+}
+
+TEST(CrossWorkerPacketQueuesTest, MarkPending) {
+  CrossWorkerPacketQueues queues(2, 10);
+  EXPECT_TRUE(queues.markPending(1));
+  EXPECT_FALSE(queues.markPending(1));
+  EXPECT_TRUE(queues.markPending(0));
+  queues.drain(1, [](ForwardedPacket&&) {});
+  EXPECT_TRUE(queues.markPending(1));
+  EXPECT_FALSE(queues.markPending(0));
+}
+
+TEST(CrossWorkerPacketQueuesTest, ConcurrentProducers) {
+  constexpr size_t kProducers = 4;
+  constexpr size_t kPerProducer = 10000;
+  CrossWorkerPacketQueues queues(kProducers + 1, 64);
+  std::atomic<size_t> done{0};
+  std::vector<std::thread> producers;
+  for (size_t src = 0; src < kProducers; src++) {
+    producers.emplace_back([&, src] {
+      for (size_t i = 0; i < kPerProducer; i++) {
+        auto packet = makePacket(src, "a");
+        while (!queues.push(src, kProducers, packet)) {
+          std::this_thread::yield();
+        }
+        queues.markPending(kProducers);
+      }
+      done++;
+    });
+  }
+  size_t drained = 0;
+  while (done < kProducers || drained < kProducers * kPerProducer) {
+    drained += queues.drain(kProducers, [&](ForwardedPacket&&) {});
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  EXPECT_EQ(kProducers * kPerProducer, drained);
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/InitialPacketFilter.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+TEST(RateLimiterBucketTest, RefillsAtRate) {
+  auto now = Clock::now();
+  RateLimiterBucket bucket(100, 2, now);
+  EXPECT_TRUE(bucket.consume(now));
+  EXPECT_TRUE(bucket.consume(now));
+  EXPECT_FALSE(bucket.consume(now));
+  // One token per 10ms.
+  EXPECT_FALSE(bucket.consume(now + 5ms));
+  EXPECT_TRUE(bucket.consume(now + 15ms));
+  EXPECT_FALSE(bucket.consume(now + 15ms));
+  // Never more than the burst.
+  EXPECT_TRUE(bucket.consume(now + 10s));
+  EXPECT_TRUE(bucket.consume(now + 10s));
+  EXPECT_FALSE(bucket.consume(now + 10s));
+}
+
+TEST(InitialPacketFilterTest, Disabled) {
+  InitialPacketFilter filter(0, 1, 0, 1);
+  auto now = Clock::now();
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(filter.allowInitial(folly::IPAddress("10.0.0.1"), now));
+    EXPECT_TRUE(filter.admitNewConnection(now));
+  }
+}
+
+TEST(InitialPacketFilterTest, PerPrefix) {
+  InitialPacketFilter filter(10, 2, 0, 1);
+  auto now = Clock::now();
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("10.0.0.1"), now));
+  // Same /24.
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("10.0.0.2"), now));
+  EXPECT_FALSE(filter.allowInitial(folly::IPAddress("10.0.0.3"), now));
+  // Other prefixes have their own bucket.
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("10.0.1.1"), now));
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("::ffff:10.0.2.1"), now));
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("2001:db8::1"), now));
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("2001:db8:0:1::1"), now));
+  EXPECT_FALSE(filter.allowInitial(folly::IPAddress("2001:db8:0:2::1"), now));
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("10.0.0.1"), now + 100ms));
+}
+
+TEST(InitialPacketFilterTest, TableCollision) {
+  // Every prefix maps to the same entry.
+  InitialPacketFilter filter(10, 1, 0, 1, 1);
+  auto now = Clock::now();
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("10.0.0.1"), now));
+  EXPECT_FALSE(filter.allowInitial(folly::IPAddress("10.0.0.1"), now));
+  // Takes the entry over with a full bucket.
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("10.0.1.1"), now));
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("10.0.0.1"), now));
+}
+
+TEST(InitialPacketFilterTest, NewConnections) {
+  InitialPacketFilter filter(0, 1, 1, 3);
+  auto now = Clock::now();
+  EXPECT_TRUE(filter.admitNewConnection(now));
+  EXPECT_TRUE(filter.admitNewConnection(now));
+  EXPECT_TRUE(filter.admitNewConnection(now));
+  EXPECT_FALSE(filter.admitNewConnection(now));
+  EXPECT_TRUE(filter.admitNewConnection(now + 1s));
+  EXPECT_TRUE(filter.allowInitial(folly::IPAddress("10.0.0.1"), now));
+}
+
+TEST(InitialPacketFilterTest, PrefixOf) {
+  EXPECT_EQ(
+      folly::IPAddress("10.1.2.0"),
+      InitialPacketFilter::prefixOf(folly::IPAddress("10.1.2.3")));
+  EXPECT_EQ(
+      folly::IPAddress("10.1.2.0"),
+      InitialPacketFilter::prefixOf(folly::IPAddress("::ffff:10.1.2.3")));
+  EXPECT_EQ(
+      folly::IPAddress("2001:db8:1::"),
+      InitialPacketFilter::prefixOf(folly::IPAddress("2001:db8:1:2::3")));
+}
+
+} // namespace test
+} // namespace quic
@@ -73,6 +73,44 @@ class MockWorkerCallback : public QuicServerWorker::WorkerCallback {
       routeDataToWorkerShort(client, routingData, networkData);
     }
   }
+
+  MOCK_METHOD1(pickWorkerForNewConnection, folly::Optional<uint8_t>(uint8_t));
+
+  MOCK_METHOD4(
+      routeDataToWorkerIdMock,
+      void(
+          uint8_t,
+          const folly::SocketAddress&,
+          std::unique_ptr<RoutingData>&,
+          std::unique_ptr<NetworkData>&));
+
+  void routeDataToWorkerId(
+      uint8_t workerId,
+      const folly::SocketAddress& client,
+      RoutingData&& routingDataIn,
+      NetworkData&& networkDataIn) {
+    auto routingData = std::make_unique<RoutingData>(std::move(routingDataIn));
+    auto networkData = std::make_unique<NetworkData>(std::move(networkDataIn));
+    routeDataToWorkerIdMock(workerId, client, routingData, networkData);
+  }
+
+  MOCK_METHOD1(onWorkerLoadSampled, void(uint8_t));
+
+  MOCK_METHOD1(pickDataWorker, folly::Optional<uint8_t>(uint8_t));
+
+  MOCK_METHOD3(
+      setHandshakeRoute,
+      void(uint8_t, const ConnectionId&, folly::Optional<uint8_t>));
+
+  MOCK_METHOD2(
+      handOffConnectionMock,
+      void(uint8_t, QuicServerWorker::ConnectionHandOff&));
+
+  void handOffConnection(
+      uint8_t workerId,
+      QuicServerWorker::ConnectionHandOff&& handOff) {
+    handOffConnectionMock(workerId, handOff);
+  }
 };
 
 class MockQuicUDPSocketFactory : public QuicUDPSocketFactory {
@@ -100,6 +138,24 @@ class MockRoutingCallback : public QuicServerTransport::RoutingCallback {
       ,
       onConnectionIdBound,
       void(QuicServerTransport::Ptr));
+  GMOCK_METHOD2_(
+      ,
+      noexcept,
+      ,
+      onConnectionIdsAvailable,
+      void(QuicServerTransport::Ptr, std::vector<ConnectionId>&));
+  GMOCK_METHOD2_(
+      ,
+      noexcept,
+      ,
+      onConnectionIdsRetired,
+      void(QuicServerTransport::Ptr, const std::vector<ConnectionId>&));
+  GMOCK_METHOD2_(
+      ,
+      noexcept,
+      ,
+      onConnectionDraining,
+      void(QuicServerTransport::Ptr, std::chrono::milliseconds));
   GMOCK_METHOD2_(
       ,
       noexcept,
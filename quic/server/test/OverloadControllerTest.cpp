@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/OverloadController.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+TEST(OverloadControllerTest, EscalatesOneLevelPerSample) {
+  OverloadController controller(1000us);
+  EXPECT_EQ(controller.onLoopLatency(500us), OverloadLevel::NONE);
+  EXPECT_EQ(controller.onLoopLatency(10000us), OverloadLevel::RETRY);
+  EXPECT_EQ(
+      controller.onLoopLatency(10000us),
+      OverloadLevel::REJECT_NEW_CONNECTIONS);
+  EXPECT_EQ(
+      controller.onLoopLatency(10000us), OverloadLevel::REDUCE_ACK_FREQUENCY);
+  EXPECT_EQ(controller.onLoopLatency(10000us), OverloadLevel::CAP_WRITES);
+  EXPECT_EQ(controller.onLoopLatency(10000us), OverloadLevel::CAP_WRITES);
+  EXPECT_EQ(controller.getLevel(), OverloadLevel::CAP_WRITES);
+}
+
+TEST(OverloadControllerTest, StopsAtThreshold) {
+  OverloadController controller(1000us);
+  EXPECT_EQ(controller.onLoopLatency(2500us), OverloadLevel::RETRY);
+  EXPECT_EQ(
+      controller.onLoopLatency(2500us),
+      OverloadLevel::REJECT_NEW_CONNECTIONS);
+  // Below the threshold of the next level, above the recovery latency of
+  // this one.
+  EXPECT_EQ(
+      controller.onLoopLatency(2500us),
+      OverloadLevel::REJECT_NEW_CONNECTIONS);
+}
+
+TEST(OverloadControllerTest, RecoversWithHysteresis) {
+  OverloadController controller(1000us);
+  controller.onLoopLatency(2000us);
+  controller.onLoopLatency(2000us);
+  ASSERT_EQ(controller.getLevel(), OverloadLevel::REJECT_NEW_CONNECTIONS);
+  // Just below the threshold isn't enough to go down.
+  EXPECT_EQ(
+      controller.onLoopLatency(1800us),
+      OverloadLevel::REJECT_NEW_CONNECTIONS);
+  EXPECT_EQ(controller.onLoopLatency(1000us), OverloadLevel::RETRY);
+  EXPECT_EQ(controller.onLoopLatency(800us), OverloadLevel::RETRY);
+  EXPECT_EQ(controller.onLoopLatency(100us), OverloadLevel::NONE);
+  EXPECT_EQ(controller.onLoopLatency(0us), OverloadLevel::NONE);
+}
+
+} // namespace test
+} // namespace quic
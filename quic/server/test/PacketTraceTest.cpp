@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/PacketTrace.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/CongestionControllerFactory.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class PacketTraceTest : public Test {
+ protected:
+  void SetUp() override {
+    conn_.version = QuicVersion::MVFST;
+    conn_.serverConnectionId = getTestConnectionId(1);
+    conn_.clientConnectionId = getTestConnectionId(2);
+    conn_.peerAddress = folly::SocketAddress("1.2.3.4", 1234);
+    secrets_.cipher = fizz::CipherSuite::TLS_AES_128_GCM_SHA256;
+    secrets_.clientSecret = std::vector<uint8_t>(32, 0x11);
+    secrets_.serverSecret = std::vector<uint8_t>(32, 0x22);
+  }
+
+  NetworkData makeNetworkData(const std::string& data, TimePoint time) {
+    return NetworkData(folly::IOBuf::copyBuffer(data), time, ECNCodepoint::CE);
+  }
+
+  QuicServerConnectionState conn_;
+  OneRttSecrets secrets_;
+};
+
+TEST_F(PacketTraceTest, RecordAndDecode) {
+  PacketTraceRecorder recorder;
+  EXPECT_FALSE(recorder.start(conn_));
+  EXPECT_FALSE(recorder.isRecording());
+  ASSERT_TRUE(recorder.start(conn_, secrets_));
+  EXPECT_TRUE(recorder.isRecording());
+
+  auto now = Clock::now();
+  folly::SocketAddress v4Peer("1.2.3.4", 1234);
+  folly::SocketAddress v6Peer("::1", 4321);
+  recorder.onNetworkData(v4Peer, makeNetworkData("first", now));
+  recorder.onNetworkData(
+      v6Peer, makeNetworkData("second", now + std::chrono::milliseconds(5)));
+  EXPECT_EQ(11u, recorder.recordedBytes());
+
+  auto encoded = recorder.finish();
+  ASSERT_TRUE(encoded.hasValue());
+  EXPECT_FALSE(recorder.isRecording());
+  auto trace = decodePacketTrace(**encoded);
+  ASSERT_TRUE(trace.hasValue());
+  ASSERT_TRUE(trace->connectionState);
+  ASSERT_EQ(2u, trace->datagrams.size());
+  EXPECT_EQ(v4Peer, trace->datagrams[0].peer);
+  EXPECT_EQ(v6Peer, trace->datagrams[1].peer);
+  EXPECT_EQ(ECNCodepoint::CE, trace->datagrams[1].ecn);
+  EXPECT_EQ(
+      std::chrono::milliseconds(5),
+      trace->datagrams[1].time - trace->datagrams[0].time);
+  EXPECT_TRUE(folly::IOBufEqualTo()(
+      folly::IOBuf::copyBuffer("second"), trace->datagrams[1].data));
+}
+
+TEST_F(PacketTraceTest, StopsWhenFull) {
+  PacketTraceRecorder recorder(8);
+  ASSERT_TRUE(recorder.start(conn_, secrets_));
+  recorder.onNetworkData(
+      conn_.peerAddress, makeNetworkData("first", Clock::now()));
+  recorder.onNetworkData(
+      conn_.peerAddress, makeNetworkData("second", Clock::now()));
+  EXPECT_FALSE(recorder.isRecording());
+  EXPECT_EQ(5u, recorder.recordedBytes());
+  auto trace = decodePacketTrace(**recorder.finish());
+  ASSERT_TRUE(trace.hasValue());
+  EXPECT_EQ(1u, trace->datagrams.size());
+}
+
+TEST_F(PacketTraceTest, RejectsTruncatedTrace) {
+  PacketTraceRecorder recorder;
+  ASSERT_TRUE(recorder.start(conn_, secrets_));
+  recorder.onNetworkData(
+      conn_.peerAddress, makeNetworkData("datagram", Clock::now()));
+  auto encoded = recorder.finish();
+  ASSERT_TRUE(encoded.hasValue());
+  auto data = (*encoded)->coalesce();
+  EXPECT_FALSE(decodePacketTrace(
+                   *folly::IOBuf::wrapBuffer(data.data(), data.size() - 1))
+                   .hasValue());
+}
+
+TEST_F(PacketTraceTest, Replay) {
+  PacketTraceRecorder recorder;
+  ASSERT_TRUE(recorder.start(conn_, secrets_));
+  recorder.onNetworkData(
+      conn_.peerAddress, makeNetworkData("not a packet", Clock::now()));
+  auto trace = decodePacketTrace(**recorder.finish());
+  ASSERT_TRUE(trace.hasValue());
+
+  QuicServerConnectionState replayed;
+  replayed.congestionControllerFactory =
+      std::make_shared<DefaultCongestionControllerFactory>();
+  EXPECT_TRUE(replayPacketTrace(replayed, *trace, Clock::now()));
+  EXPECT_EQ(conn_.serverConnectionId, replayed.serverConnectionId);
+  EXPECT_EQ(conn_.peerAddress, replayed.peerAddress);
+  // The datagram doesn't parse, and is dropped like the transport would.
+  EXPECT_EQ(ServerState::Open, replayed.state);
+  EXPECT_FALSE(replayed.ackStates.appDataAckState.largestReceivedPacketNum);
+
+  PacketTrace empty;
+  QuicServerConnectionState fresh;
+  EXPECT_FALSE(replayPacketTrace(fresh, empty, Clock::now()));
+}
+
+} // namespace test
+} // namespace quic
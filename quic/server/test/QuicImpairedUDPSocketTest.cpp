@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicImpairedUDPSocket.h>
+
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+
+namespace quic {
+namespace test {
+
+class CollectingReadCallback : public folly::AsyncUDPSocket::ReadCallback {
+ public:
+  void getReadBuffer(void** buf, size_t* len) noexcept override {
+    *buf = buffer_;
+    *len = sizeof(buffer_);
+  }
+
+  void onDataAvailable(
+      const folly::SocketAddress&,
+      size_t len,
+      bool truncated) noexcept override {
+    EXPECT_FALSE(truncated);
+    packets.emplace_back(buffer_, len);
+  }
+
+  void onReadError(const folly::AsyncSocketException&) noexcept override {
+    ADD_FAILURE();
+  }
+
+  void onReadClosed() noexcept override {}
+
+  std::vector<std::string> packets;
+
+ private:
+  char buffer_[1500];
+};
+
+class QuicImpairedUDPSocketTest : public testing::Test {
+ public:
+  void SetUp() override {
+    server_ = std::make_unique<folly::AsyncUDPSocket>(&evb_);
+    server_->bind(folly::SocketAddress("127.0.0.1", 0));
+    server_->resumeRead(&readCb_);
+  }
+
+  std::unique_ptr<QuicImpairedUDPSocket> makeClient(
+      QuicImpairedUDPSocket::Options options) {
+    auto client = std::make_unique<QuicImpairedUDPSocket>(&evb_, options);
+    client->bind(folly::SocketAddress("127.0.0.1", 0));
+    return client;
+  }
+
+  void loopFor(std::chrono::milliseconds duration) {
+    auto end = Clock::now() + duration;
+    while (Clock::now() < end) {
+      evb_.loopOnce(EVLOOP_NONBLOCK);
+    }
+  }
+
+ protected:
+  folly::EventBase evb_;
+  std::unique_ptr<folly::AsyncUDPSocket> server_;
+  CollectingReadCallback readCb_;
+};
+
+TEST_F(QuicImpairedUDPSocketTest, NoImpairment) {
+  auto client = makeClient(QuicImpairedUDPSocket::Options());
+  for (auto i = 0; i < 3; i++) {
+    client->write(server_->address(), folly::IOBuf::copyBuffer("hello"));
+  }
+  loopFor(std::chrono::milliseconds(50));
+  ASSERT_EQ(readCb_.packets.size(), 3);
+  for (const auto& packet : readCb_.packets) {
+    EXPECT_EQ(packet, "hello");
+  }
+  EXPECT_EQ(client->sendDropped(), 0);
+}
+
+TEST_F(QuicImpairedUDPSocketTest, Loss) {
+  QuicImpairedUDPSocket::Options options;
+  options.send.loss = 1;
+  auto client = makeClient(options);
+  EXPECT_EQ(
+      client->write(server_->address(), folly::IOBuf::copyBuffer("hello")),
+      5);
+  loopFor(std::chrono::milliseconds(50));
+  EXPECT_TRUE(readCb_.packets.empty());
+  EXPECT_EQ(client->sendDropped(), 1);
+}
+
+TEST_F(QuicImpairedUDPSocketTest, DelayAndDuplicate) {
+  QuicImpairedUDPSocket::Options options;
+  options.send.delay = std::chrono::milliseconds(100);
+  options.send.duplicate = 1;
+  auto client = makeClient(options);
+  client->write(server_->address(), folly::IOBuf::copyBuffer("hello"));
+  loopFor(std::chrono::milliseconds(20));
+  EXPECT_TRUE(readCb_.packets.empty());
+  loopFor(std::chrono::milliseconds(200));
+  ASSERT_EQ(readCb_.packets.size(), 2);
+  EXPECT_EQ(readCb_.packets[0], "hello");
+  EXPECT_EQ(readCb_.packets[1], "hello");
+}
+
+TEST_F(QuicImpairedUDPSocketTest, RateLimitQueue) {
+  QuicImpairedUDPSocket::Options options;
+  options.send.rate = 1000;
+  options.send.queueBytes = 10;
+  auto client = makeClient(options);
+  // The first two fit in the queue, the third one is dropped.
+  for (auto i = 0; i < 3; i++) {
+    client->write(server_->address(), folly::IOBuf::copyBuffer("hello"));
+  }
+  EXPECT_EQ(client->sendDropped(), 1);
+  loopFor(std::chrono::milliseconds(100));
+  EXPECT_EQ(readCb_.packets.size(), 2);
+}
+
+TEST_F(QuicImpairedUDPSocketTest, SplitGSO) {
+  auto client = makeClient(QuicImpairedUDPSocket::Options());
+  auto buf = folly::IOBuf::copyBuffer("aaaabbbbcc");
+  EXPECT_EQ(client->writeGSO(server_->address(), buf, 4), 10);
+  loopFor(std::chrono::milliseconds(50));
+  ASSERT_EQ(readCb_.packets.size(), 3);
+  EXPECT_EQ(readCb_.packets[0], "aaaa");
+  EXPECT_EQ(readCb_.packets[1], "bbbb");
+  EXPECT_EQ(readCb_.packets[2], "cc");
+}
+
+TEST_F(QuicImpairedUDPSocketTest, ReceiveDelay) {
+  QuicImpairedUDPSocket::Options options;
+  options.receive.delay = std::chrono::milliseconds(100);
+  auto receiver = makeClient(options);
+  CollectingReadCallback receiverCb;
+  receiver->resumeRead(&receiverCb);
+  server_->write(receiver->address(), folly::IOBuf::copyBuffer("hello"));
+  loopFor(std::chrono::milliseconds(20));
+  EXPECT_TRUE(receiverCb.packets.empty());
+  loopFor(std::chrono::milliseconds(200));
+  ASSERT_EQ(receiverCb.packets.size(), 1);
+  EXPECT_EQ(receiverCb.packets[0], "hello");
+  receiver->pauseRead();
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicIoUringUDPSocket.h>
+
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+
+namespace quic {
+namespace test {
+
+class CollectingReadCallback : public folly::AsyncUDPSocket::ReadCallback {
+ public:
+  void getReadBuffer(void** buf, size_t* len) noexcept override {
+    *buf = buffer_;
+    *len = sizeof(buffer_);
+  }
+
+  void onDataAvailable(
+      const folly::SocketAddress& client,
+      size_t len,
+      bool truncated) noexcept override {
+    EXPECT_FALSE(truncated);
+    peers.push_back(client);
+    packets.emplace_back(buffer_, len);
+  }
+
+  void onReadError(const folly::AsyncSocketException&) noexcept override {
+    ADD_FAILURE();
+  }
+
+  void onReadClosed() noexcept override {}
+
+  std::vector<folly::SocketAddress> peers;
+  std::vector<std::string> packets;
+
+ private:
+  char buffer_[1500];
+};
+
+std::unique_ptr<QuicIoUringUDPSocket> makeSocket(folly::EventBase& evb) {
+  try {
+    return std::make_unique<QuicIoUringUDPSocket>(
+        &evb, QuicIoUringUDPSocket::Options());
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "io_uring is not available: " << ex.what();
+    return nullptr;
+  }
+}
+
+TEST(QuicIoUringUDPSocketTest, Receive) {
+  folly::EventBase evb;
+  auto sock = makeSocket(evb);
+  if (!sock) {
+    return;
+  }
+  sock->bind(folly::SocketAddress("127.0.0.1", 0));
+  CollectingReadCallback readCb;
+  sock->resumeRead(&readCb);
+  EXPECT_TRUE(sock->isReading());
+
+  folly::AsyncUDPSocket client(&evb);
+  client.bind(folly::SocketAddress("127.0.0.1", 0));
+  for (auto i = 0; i < 3; i++) {
+    client.write(sock->address(), folly::IOBuf::copyBuffer("hello"));
+  }
+  for (auto i = 0; i < 100 && readCb.packets.size() < 3; i++) {
+    evb.loopOnce();
+  }
+  ASSERT_EQ(readCb.packets.size(), 3);
+  for (size_t i = 0; i < readCb.packets.size(); i++) {
+    EXPECT_EQ(readCb.packets[i], "hello");
+    EXPECT_EQ(readCb.peers[i], client.address());
+  }
+  sock->pauseRead();
+  EXPECT_FALSE(sock->isReading());
+}
+
+TEST(QuicIoUringUDPSocketTest, Send) {
+  folly::EventBase evb;
+  auto sock = makeSocket(evb);
+  if (!sock) {
+    return;
+  }
+  sock->bind(folly::SocketAddress("127.0.0.1", 0));
+
+  folly::AsyncUDPSocket server(&evb);
+  server.bind(folly::SocketAddress("127.0.0.1", 0));
+  CollectingReadCallback readCb;
+  server.resumeRead(&readCb);
+
+  std::unique_ptr<folly::IOBuf> bufs[2] = {
+      folly::IOBuf::copyBuffer("hello"), folly::IOBuf::copyBuffer("world")};
+  EXPECT_EQ(sock->writem(server.address(), bufs, 2), 2);
+  // nothing is submitted until the end of the loop
+  for (auto i = 0; i < 100 && readCb.packets.size() < 2; i++) {
+    evb.loopOnce();
+  }
+  ASSERT_EQ(readCb.packets.size(), 2);
+  EXPECT_EQ(readCb.packets[0], "hello");
+  EXPECT_EQ(readCb.packets[1], "world");
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicReusePortBpf.h>
+
+#include <folly/SocketAddress.h>
+#include <folly/net/NetOps.h>
+#include <folly/portability/GTest.h>
+#include <folly/portability/Sockets.h>
+#include <quic/codec/DefaultConnectionIdAlgo.h>
+#include <quic/codec/Types.h>
+
+#include <poll.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class QuicReusePortBpfTest : public Test {
+ protected:
+  void SetUp() override {
+    folly::SocketAddress address("127.0.0.1", 0);
+    for (size_t i = 0; i < kNumSockets; i++) {
+      auto sock = folly::netops::socket(AF_INET, SOCK_DGRAM, 0);
+      ASSERT_NE(sock, folly::NetworkSocket());
+      int one = 1;
+      folly::netops::setsockopt(
+          sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+      sockaddr_storage addr;
+      auto len = address.getAddress(&addr);
+      ASSERT_EQ(0, folly::netops::bind(sock, (sockaddr*)&addr, len));
+      if (i == 0) {
+        // The other sockets join the group of the first one.
+        address.setFromLocalAddress(sock);
+      }
+      sockets_.push_back(sock);
+    }
+    address_ = address;
+    client_ = folly::netops::socket(AF_INET, SOCK_DGRAM, 0);
+  }
+
+  void TearDown() override {
+    for (auto sock : sockets_) {
+      folly::netops::close(sock);
+    }
+    folly::netops::close(client_);
+  }
+
+  void send(const folly::IOBuf& packet) {
+    sockaddr_storage addr;
+    auto len = address_.getAddress(&addr);
+    ASSERT_EQ(
+        packet.length(),
+        folly::netops::sendto(
+            client_,
+            packet.data(),
+            packet.length(),
+            0,
+            (sockaddr*)&addr,
+            len));
+  }
+
+  // Index of the socket that got the packet, or -1.
+  int receive() {
+    std::vector<pollfd> fds;
+    for (auto sock : sockets_) {
+      fds.push_back({sock.toFd(), POLLIN, 0});
+    }
+    if (::poll(fds.data(), fds.size(), 1000) <= 0) {
+      return -1;
+    }
+    for (size_t i = 0; i < fds.size(); i++) {
+      if (fds[i].revents & POLLIN) {
+        char buf[kDefaultUDPSendPacketLen];
+        folly::netops::recv(sockets_[i], buf, sizeof(buf), 0);
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  std::unique_ptr<folly::IOBuf> makeShortHeaderPacket(uint8_t workerId) {
+    ServerConnectionIdParams params(0, 0, workerId);
+    auto connId = DefaultConnectionIdAlgo().encodeConnectionId(params);
+    auto packet = folly::IOBuf::create(kDefaultUDPSendPacketLen);
+    packet->writableData()[0] = ShortHeader::kFixedBitMask;
+    memcpy(packet->writableData() + 1, connId.data(), connId.size());
+    packet->append(1 + connId.size());
+    // Packet number and payload.
+    memset(packet->writableTail(), 0xaa, 16);
+    packet->append(16);
+    return packet;
+  }
+
+  static constexpr size_t kNumSockets = 3;
+  std::vector<folly::NetworkSocket> sockets_;
+  folly::NetworkSocket client_;
+  folly::SocketAddress address_;
+};
+
+TEST_F(QuicReusePortBpfTest, SteersByWorkerId) {
+  if (!attachReusePortBpfSteering(sockets_[0], kNumSockets)) {
+    GTEST_SKIP() << "Reuse port programs are not supported";
+  }
+  for (uint8_t workerId = 0; workerId < 2 * kNumSockets; workerId++) {
+    send(*makeShortHeaderPacket(workerId));
+    EXPECT_EQ(static_cast<int>(workerId % kNumSockets), receive());
+  }
+  // Worker ids with the high bits set.
+  for (uint8_t workerId : {0x7f, 0x80, 0xc1, 0xff}) {
+    send(*makeShortHeaderPacket(workerId));
+    EXPECT_EQ(static_cast<int>(workerId % kNumSockets), receive());
+  }
+}
+
+TEST_F(QuicReusePortBpfTest, LongHeaderAndShortPacketsFallBack) {
+  if (!attachReusePortBpfSteering(sockets_[0], kNumSockets)) {
+    GTEST_SKIP() << "Reuse port programs are not supported";
+  }
+  // The client's 4-tuple is fixed, the hash picks the same socket every time.
+  auto longHeader = makeShortHeaderPacket(2);
+  longHeader->writableData()[0] |= kHeaderFormMask;
+  send(*longHeader);
+  auto hashed = receive();
+  EXPECT_NE(-1, hashed);
+  send(*longHeader);
+  EXPECT_EQ(hashed, receive());
+  send(*folly::IOBuf::copyBuffer("\x40\x01"));
+  EXPECT_EQ(hashed, receive());
+}
+
+TEST_F(QuicReusePortBpfTest, RequiresWorkers) {
+  EXPECT_FALSE(attachReusePortBpfSteering(sockets_[0], 0));
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicServerCpuAffinity.h>
+
+#include <folly/net/NetOps.h>
+#include <folly/portability/GTest.h>
+#include <folly/portability/Sockets.h>
+
+#include <sched.h>
+#include <thread>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+
+// The last cpu the process may run on.
+int getAllowedCpu() {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0) {
+    return -1;
+  }
+  int allowed = -1;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &cpus)) {
+      allowed = cpu;
+    }
+  }
+  return allowed;
+}
+
+} // namespace
+
+TEST(QuicServerCpuAffinityTest, PinCurrentThread) {
+  auto cpu = getAllowedCpu();
+  ASSERT_GE(cpu, 0);
+  std::thread thread([cpu] {
+    ASSERT_TRUE(pinCurrentThreadToCpu(cpu));
+    EXPECT_EQ(cpu, sched_getcpu());
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    sched_getaffinity(0, sizeof(cpus), &cpus);
+    EXPECT_EQ(1, CPU_COUNT(&cpus));
+  });
+  thread.join();
+}
+
+TEST(QuicServerCpuAffinityTest, PinInvalidCpu) {
+  std::thread thread([] {
+    EXPECT_FALSE(pinCurrentThreadToCpu(-1));
+    EXPECT_FALSE(pinCurrentThreadToCpu(CPU_SETSIZE));
+  });
+  thread.join();
+}
+
+TEST(QuicServerCpuAffinityTest, SocketIncomingCpu) {
+  auto cpu = getAllowedCpu();
+  ASSERT_GE(cpu, 0);
+  auto sock = folly::netops::socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_NE(sock, folly::NetworkSocket());
+  ASSERT_TRUE(setSocketIncomingCpu(sock, cpu));
+  int incomingCpu = -1;
+  socklen_t len = sizeof(incomingCpu);
+  folly::netops::getsockopt(
+      sock, SOL_SOCKET, SO_INCOMING_CPU, &incomingCpu, &len);
+  EXPECT_EQ(cpu, incomingCpu);
+  folly::netops::close(sock);
+}
+
+} // namespace test
+} // namespace quic
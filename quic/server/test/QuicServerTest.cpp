@@ -7,6 +7,8 @@
  */
 
 #include <quic/server/QuicServer.h>
+#include <folly/Random.h>
+#include <folly/experimental/TestUtil.h>
 #include <folly/futures/Promise.h>
 #include <folly/io/IOBuf.h>
 #include <folly/io/async/test/MockAsyncUDPSocket.h>
@@ -15,9 +17,11 @@
 #include <quic/api/test/MockQuicSocket.h>
 #include <quic/api/test/MockQuicStats.h>
 #include <quic/api/test/Mocks.h>
+#include <quic/codec/Decode.h>
 #include <quic/codec/DefaultConnectionIdAlgo.h>
 #include <quic/codec/QuicHeaderCodec.h>
 #include <quic/common/test/TestUtils.h>
+#include <quic/server/handshake/RetryTokenGenerator.h>
 #include <quic/server/handshake/StatelessResetGenerator.h>
 #include <quic/server/test/Mocks.h>
 
@@ -84,6 +88,42 @@ TEST_F(SimpleQuicServerWorkerTest, DontFragment) {
   worker_->bind(addr);
 }
 
+TEST_F(SimpleQuicServerWorkerTest, RecvmmsgBatch) {
+  auto sock = std::make_unique<folly::AsyncUDPSocket>(&eventbase_);
+  auto rawSock = sock.get();
+  workerCb_ = std::make_shared<MockWorkerCallback>();
+  worker_ = std::make_unique<QuicServerWorker>(workerCb_);
+  TransportSettings settings;
+  settings.maxRecvBatchSize = 4;
+  worker_->setTransportSettings(settings);
+  worker_->setConnectionIdAlgo(std::make_unique<DefaultConnectionIdAlgo>());
+  worker_->setSupportedVersions({QuicVersion::MVFST});
+  worker_->setSocket(std::move(sock));
+  worker_->bind(folly::SocketAddress("::1", 0));
+  if (!worker_->shouldOnlyNotify()) {
+    // recvmmsg is not available on this platform.
+    worker_.reset();
+    return;
+  }
+
+  folly::AsyncUDPSocket client(&eventbase_);
+  client.bind(folly::SocketAddress("::1", 0));
+  size_t numPackets = 3;
+  for (size_t i = 0; i < numPackets; ++i) {
+    ShortHeader header(
+        ProtectionType::KeyPhaseZero, getTestConnectionId(), i + 1);
+    RegularQuicPacketBuilder builder(
+        kDefaultUDPSendPacketLen, std::move(header), 0 /* largestAcked */);
+    auto packet = packetToBuf(std::move(builder).buildPacket());
+    client.write(worker_->getAddress(), packet);
+  }
+
+  // All the packets are read with a single notification.
+  EXPECT_CALL(*workerCb_, routeDataToWorkerShort(_, _, _)).Times(numPackets);
+  worker_->onNotifyDataAvailable(*rawSock);
+  worker_.reset();
+}
+
 std::unique_ptr<folly::IOBuf> createData(size_t size) {
   std::string data;
   data.resize(size);
@@ -101,7 +141,8 @@ class QuicServerWorkerTest : public Test {
     worker_ = std::make_unique<QuicServerWorker>(workerCb_);
     auto transportInfoCb = std::make_unique<MockQuicStats>();
     TransportSettings settings;
-    settings.statelessResetTokenSecret = getRandSecret();
+    resetTokenSecret_ = getRandSecret();
+    settings.statelessResetTokenSecret = resetTokenSecret_;
     worker_->setTransportSettings(settings);
     worker_->setSocket(std::move(sock));
     worker_->setWorkerId(42);
@@ -171,6 +212,7 @@ class QuicServerWorkerTest : public Test {
   folly::test::MockAsyncUDPSocket* socketPtr_{nullptr};
   uint16_t hostId_{49};
   bool hasShutdown_{false};
+  StatelessResetSecret resetTokenSecret_;
 };
 
 void QuicServerWorkerTest::expectConnectionCreation(
@@ -223,7 +265,7 @@ void QuicServerWorkerTest::createQuicConnection(
 
 void QuicServerWorkerTest::testSendReset(
     Buf packet,
-    ConnectionId,
+    ConnectionId connId,
     ShortHeader shortHeader,
     QuicTransportStatsCallback::PacketDropReason dropReason) {
   EXPECT_CALL(*transportInfoCb_, onPacketDropped(dropReason)).Times(1);
@@ -243,7 +285,9 @@ void QuicServerWorkerTest::testSendReset(
                 Invoke([&](auto&, auto, auto) { return folly::none; }));
         codec.setOneRttReadCipher(std::move(aead));
         codec.setOneRttHeaderCipher(test::createNoOpHeaderCipher());
-        StatelessResetToken token = generateStatelessResetToken();
+        StatelessResetGenerator generator(
+            resetTokenSecret_, fakeAddress_.getFullyQualified());
+        StatelessResetToken token = generator.generateToken(connId);
         codec.setStatelessResetToken(token);
         AckStates ackStates;
         auto packetQueue = bufToQueue(buf->clone());
@@ -298,6 +342,75 @@ TEST_F(QuicServerWorkerTest, NoConnFoundTestReset) {
       QuicTransportStatsCallback::PacketDropReason::CONNECTION_NOT_FOUND);
 }
 
+TEST_F(QuicServerWorkerTest, StatelessResetsRateLimited) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = resetTokenSecret_;
+  settings.statelessResponsesRate = 1;
+  settings.statelessResponsesBurst = 1;
+  worker_->setTransportSettings(settings);
+  worker_->stopPacketForwarding();
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(PacketDropReason::CONNECTION_NOT_FOUND))
+      .Times(2);
+  // Only the first packet is answered.
+  EXPECT_CALL(*socketPtr_, write(_, _))
+      .WillOnce(Invoke([](auto&, const std::unique_ptr<folly::IOBuf>& buf) {
+        return buf->computeChainDataLength();
+      }));
+  auto now = Clock::now();
+  for (int i = 0; i < 2; ++i) {
+    RoutingData routingData(
+        HeaderForm::Short,
+        false,
+        false,
+        getTestConnectionId(hostId_),
+        folly::none);
+    worker_->dispatchPacketData(
+        kClientAddr,
+        std::move(routingData),
+        NetworkData(folly::IOBuf::copyBuffer("data"), now));
+  }
+}
+
+TEST_F(QuicServerWorkerTest, TransportSettingsSnapshotCopyOnWrite) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = resetTokenSecret_;
+  auto snapshot = std::make_shared<const TransportSettings>(settings);
+  worker_->setTransportSettings(snapshot);
+  EXPECT_EQ(worker_->getTransportSettingsSnapshot(), snapshot);
+
+  // Changing the settings of the worker leaves the shared snapshot alone.
+  worker_->enablePartialReliability(!settings.partialReliabilityEnabled);
+  EXPECT_NE(worker_->getTransportSettingsSnapshot(), snapshot);
+  EXPECT_EQ(
+      worker_->getTransportSettingsSnapshot()->partialReliabilityEnabled,
+      !settings.partialReliabilityEnabled);
+  EXPECT_EQ(
+      snapshot->partialReliabilityEnabled, settings.partialReliabilityEnabled);
+}
+
+TEST_F(QuicServerWorkerTest, ShortHeaderRoutingDataHasConnIdParams) {
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  auto connId = getTestConnectionId(hostId_);
+  PacketNum num = 2;
+  ShortHeader shortHeader(ProtectionType::KeyPhaseZero, connId, num);
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen, std::move(shortHeader), 0 /* largestAcked */);
+  auto packet = packetToBuf(std::move(builder).buildPacket());
+
+  // The routing info decoded while reading the header is handed over with
+  // the packet, so the receiving worker does not parse the conn id again.
+  EXPECT_CALL(*workerCb_, routeDataToWorkerShort(kClientAddr, _, _))
+      .WillOnce(Invoke([&](auto&, auto& routingData, auto&) {
+        EXPECT_EQ(routingData->destinationConnId, connId);
+        ASSERT_TRUE(routingData->connIdParams.hasValue());
+        EXPECT_EQ(routingData->connIdParams->hostId, hostId_);
+      }));
+  worker_->handleNetworkData(kClientAddr, std::move(packet), Clock::now());
+}
+
 TEST_F(QuicServerWorkerTest, QuicServerNewConnection) {
   EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
   auto connId = getTestConnectionId(hostId_);
@@ -420,6 +533,330 @@ TEST_F(QuicServerWorkerTest, InitialPacketTooSmall) {
   eventbase_.loop();
 }
 
+Buf createInitialPacket(
+    const ConnectionId& srcConnId,
+    const ConnectionId& dstConnId,
+    Buf token = nullptr) {
+  LongHeader header(
+      LongHeader::Types::Initial,
+      srcConnId,
+      dstConnId,
+      1,
+      QuicVersion::MVFST,
+      std::move(token));
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen, std::move(header), 0 /* largestAcked */);
+  writeFrame(PaddingFrame(), builder);
+  auto packet = packetToBuf(std::move(builder).buildPacket());
+  packet->prependChain(createData(kMinInitialPacketSize));
+  return packet;
+}
+
+class QuicServerWorkerRetryTest : public QuicServerWorkerTest {
+ public:
+  void SetUp() override {
+    QuicServerWorkerTest::SetUp();
+    folly::Random::secureRandom(retrySecret_.data(), retrySecret_.size());
+    settings_.statelessResetTokenSecret = resetTokenSecret_;
+    settings_.retryTokenSecret = retrySecret_;
+    worker_->setTransportSettings(settings_);
+  }
+
+  // Sends an Initial without token, and returns the Retry it gets.
+  LongHeader expectRetry(const ConnectionId& srcConnId, ConnectionId connId) {
+    EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+    Buf retry;
+    EXPECT_CALL(*socketPtr_, write(kClientAddr, _))
+        .WillOnce(Invoke([&](const folly::SocketAddress&,
+                             const std::unique_ptr<folly::IOBuf>& buf) {
+          retry = buf->clone();
+          return buf->computeChainDataLength();
+        }));
+    RoutingData routingData(HeaderForm::Long, true, true, connId, srcConnId);
+    worker_->dispatchPacketData(
+        kClientAddr,
+        std::move(routingData),
+        NetworkData(createInitialPacket(srcConnId, connId), Clock::now()));
+    EXPECT_EQ(0, worker_->getSrcToTransportMap().size());
+
+    folly::io::Cursor cursor(retry.get());
+    auto initialByte = cursor.readBE<uint8_t>();
+    auto parsedHeader = parseLongHeader(initialByte, cursor);
+    CHECK(parsedHeader && parsedHeader->parsedLongHeader);
+    return parsedHeader->parsedLongHeader->header;
+  }
+
+ protected:
+  TransportSettings settings_;
+  RetryTokenSecret retrySecret_;
+};
+
+TEST_F(QuicServerWorkerRetryTest, RetryWithoutToken) {
+  auto srcConnId = getTestConnectionId(hostId_);
+  auto connId = getTestConnectionId(hostId_ + 1);
+  auto retry = expectRetry(srcConnId, connId);
+  EXPECT_EQ(LongHeader::Types::Retry, retry.getHeaderType());
+  EXPECT_EQ(srcConnId, retry.getDestinationConnId());
+  EXPECT_EQ(connId, *retry.getOriginalDstConnId());
+  ASSERT_TRUE(retry.hasToken());
+  RetryTokenGenerator generator(retrySecret_, settings_.retryTokenLifetime);
+  EXPECT_EQ(
+      connId,
+      generator.decryptToken(
+          retry.getToken()->clone(),
+          kClientAddr.getIPAddress(),
+          std::chrono::system_clock::now()));
+}
+
+TEST_F(QuicServerWorkerRetryTest, ValidTokenCreatesConnection) {
+  auto srcConnId = getTestConnectionId(hostId_);
+  auto retry = expectRetry(srcConnId, getTestConnectionId(hostId_ + 1));
+
+  // The client retries to the connection id the server picked.
+  auto connId = retry.getSourceConnId();
+  auto data = createInitialPacket(srcConnId, connId, retry.getToken()->clone());
+  expectConnectionCreation(kClientAddr, srcConnId);
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, BufMatches(*data)));
+  RoutingData routingData(HeaderForm::Long, true, true, connId, srcConnId);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(data->clone(), Clock::now()));
+  EXPECT_EQ(
+      1,
+      worker_->getSrcToTransportMap().count(
+          std::make_pair(kClientAddr, srcConnId)));
+  eventbase_.loop();
+}
+
+TEST_F(QuicServerWorkerRetryTest, InvalidTokenDropped) {
+  auto srcConnId = getTestConnectionId(hostId_);
+  auto connId = getTestConnectionId(hostId_ + 1);
+  RetryTokenGenerator generator(retrySecret_, settings_.retryTokenLifetime);
+  // A token for another address.
+  auto token = generator.encryptToken(
+      folly::IPAddress("1.2.3.5"), connId, std::chrono::system_clock::now());
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+  EXPECT_CALL(*socketPtr_, write(_, _)).Times(0);
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(PacketDropReason::INVALID_RETRY_TOKEN));
+  RoutingData routingData(HeaderForm::Long, true, true, connId, srcConnId);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(
+          createInitialPacket(srcConnId, connId, std::move(token)),
+          Clock::now()));
+  EXPECT_EQ(0, worker_->getSrcToTransportMap().size());
+}
+
+TEST_F(QuicServerWorkerRetryTest, RetryAbovePendingHandshakes) {
+  settings_.retryPendingHandshakesThreshold = 1;
+  worker_->setTransportSettings(settings_);
+  // Below the threshold, connections are created without Retry.
+  auto srcConnId = getTestConnectionId(hostId_);
+  auto data = createInitialPacket(srcConnId, srcConnId);
+  expectConnectionCreation(kClientAddr, srcConnId);
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, BufMatches(*data)));
+  RoutingData routingData(HeaderForm::Long, true, true, srcConnId, srcConnId);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(data->clone(), Clock::now()));
+  eventbase_.loop();
+  Mock::VerifyAndClearExpectations(factory_.get());
+
+  // That handshake is still in progress.
+  auto retry = expectRetry(
+      getTestConnectionId(hostId_ + 1), getTestConnectionId(hostId_ + 2));
+  EXPECT_EQ(LongHeader::Types::Retry, retry.getHeaderType());
+}
+
+TEST_F(QuicServerWorkerRetryTest, RetryAboveSourceRate) {
+  settings_.retryNewConnectionsPerSourceThreshold = 1;
+  worker_->setTransportSettings(settings_);
+  auto srcConnId = getTestConnectionId(hostId_);
+  auto data = createInitialPacket(srcConnId, srcConnId);
+  expectConnectionCreation(kClientAddr, srcConnId);
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, BufMatches(*data)));
+  RoutingData routingData(HeaderForm::Long, true, true, srcConnId, srcConnId);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(data->clone(), Clock::now()));
+  eventbase_.loop();
+  Mock::VerifyAndClearExpectations(factory_.get());
+
+  // The second new connection from the same address within the window.
+  auto retry = expectRetry(
+      getTestConnectionId(hostId_ + 1), getTestConnectionId(hostId_ + 2));
+  EXPECT_EQ(LongHeader::Types::Retry, retry.getHeaderType());
+}
+
+TEST_F(QuicServerWorkerTest, InitialsRateLimited) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = resetTokenSecret_;
+  settings.initialsPerPrefixRate = 1;
+  settings.initialsPerPrefixBurst = 1;
+  worker_->setTransportSettings(settings);
+  auto connId = getTestConnectionId(hostId_);
+  EXPECT_CALL(*workerCb_, routeDataToWorkerLong(kClientAddr, _, _))
+      .WillOnce(Return());
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(PacketDropReason::INITIAL_RATE_LIMITED));
+  auto now = Clock::now();
+  worker_->handleNetworkData(
+      kClientAddr, createInitialPacket(connId, connId), now);
+  worker_->handleNetworkData(
+      kClientAddr, createInitialPacket(connId, connId), now);
+}
+
+TEST_F(QuicServerWorkerTest, NewConnectionsRateLimited) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = resetTokenSecret_;
+  settings.newConnectionsRate = 1;
+  settings.newConnectionsBurst = 1;
+  worker_->setTransportSettings(settings);
+  auto connId = getTestConnectionId(hostId_);
+  createQuicConnection(kClientAddr, connId);
+
+  auto otherConnId = getTestConnectionId(hostId_ + 1);
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(PacketDropReason::NEW_CONNECTION_RATE_LIMITED));
+  RoutingData routingData(
+      HeaderForm::Long, true, true, otherConnId, otherConnId);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(createData(kMinInitialPacketSize + 10), Clock::now()));
+  EXPECT_EQ(1, worker_->getSrcToTransportMap().size());
+}
+
+TEST_F(QuicServerWorkerTest, NewConnectionHandedToLessLoadedWorker) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = resetTokenSecret_;
+  settings.newConnectionLoadBalancing = true;
+  worker_->setTransportSettings(settings);
+  auto connId = getTestConnectionId(hostId_);
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+  EXPECT_CALL(*workerCb_, pickWorkerForNewConnection(42))
+      .WillOnce(Return(folly::make_optional<uint8_t>(7)));
+  EXPECT_CALL(*workerCb_, routeDataToWorkerIdMock(7, kClientAddr, _, _))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](auto, auto&, auto& routingData, auto&) {
+        EXPECT_TRUE(routingData->redirected);
+      }));
+  for (int i = 0; i < 2; i++) {
+    // The retransmission follows the first Initial, without asking again.
+    RoutingData routingData(HeaderForm::Long, true, true, connId, connId);
+    worker_->dispatchPacketData(
+        kClientAddr,
+        std::move(routingData),
+        NetworkData(createData(kMinInitialPacketSize + 10), Clock::now()));
+  }
+  EXPECT_EQ(0, worker_->getSrcToTransportMap().size());
+}
+
+TEST_F(QuicServerWorkerTest, RedirectedNewConnectionStays) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = resetTokenSecret_;
+  settings.newConnectionLoadBalancing = true;
+  worker_->setTransportSettings(settings);
+  EXPECT_CALL(*workerCb_, pickWorkerForNewConnection(_)).Times(0);
+  auto connId = getTestConnectionId(hostId_);
+  expectConnectionCreation(kClientAddr, connId);
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, _));
+  RoutingData routingData(HeaderForm::Long, true, true, connId, connId);
+  routingData.redirected = true;
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(createData(kMinInitialPacketSize + 10), Clock::now()));
+  EXPECT_EQ(1, worker_->getSrcToTransportMap().size());
+}
+
+TEST_F(QuicServerWorkerTest, HandshakeWorkerRoutesToDataWorker) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = resetTokenSecret_;
+  settings.numHandshakeWorkers = 1;
+  worker_->setTransportSettings(settings);
+  EXPECT_CALL(*workerCb_, pickWorkerForNewConnection(42))
+      .WillOnce(Return(folly::none));
+  EXPECT_CALL(*workerCb_, pickDataWorker(42))
+      .WillOnce(Return(folly::make_optional<uint8_t>(3)));
+  auto connId = getTestConnectionId(hostId_);
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).WillOnce(Return(transport_));
+  EXPECT_CALL(*transport_, setServerConnectionIdParams(_))
+      .WillOnce(Invoke([connId](ServerConnectionIdParams params) {
+        EXPECT_EQ(*params.clientConnId, connId);
+        EXPECT_EQ(params.workerId, 3);
+      }));
+  EXPECT_CALL(*transport_, setTransportSettings(_))
+      .WillOnce(Invoke([](TransportSettings transportSettings) {
+        EXPECT_TRUE(transportSettings.connectionStateExportEnabled);
+      }));
+  EXPECT_CALL(*transport_, accept());
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, _));
+  RoutingData routingData(HeaderForm::Long, true, true, connId, connId);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(createData(kMinInitialPacketSize + 10), Clock::now()));
+  EXPECT_EQ(1, worker_->getSrcToTransportMap().size());
+
+  // The data worker forwards the packets for the connection id here until
+  // the connection is handed to it.
+  auto serverConnId = DefaultConnectionIdAlgo().encodeConnectionId(
+      ServerConnectionIdParams(hostId_, 1, 3));
+  EXPECT_CALL(
+      *workerCb_,
+      setHandshakeRoute(3, serverConnId, Eq(folly::Optional<uint8_t>(42))));
+  worker_->onConnectionIdAvailable(transport_, serverConnId);
+  EXPECT_CALL(
+      *workerCb_,
+      setHandshakeRoute(
+          3, serverConnId, Eq(folly::Optional<uint8_t>(folly::none))));
+  worker_->onConnectionUnbound(
+      std::make_pair(kClientAddr, connId), serverConnId);
+}
+
+TEST_F(QuicServerWorkerTest, DataWorkerForwardsToHandshakeWorker) {
+  auto connId = getTestConnectionId(hostId_);
+  worker_->setHandshakeRoute(connId, 5);
+  EXPECT_CALL(*workerCb_, routeDataToWorkerIdMock(5, kClientAddr, _, _))
+      .WillOnce(Invoke([&](auto, auto&, auto& routingData, auto&) {
+        EXPECT_TRUE(routingData->redirected);
+      }));
+  RoutingData routingData(
+      HeaderForm::Short, false, false, connId, folly::none);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(createData(100), Clock::now()));
+  worker_->setHandshakeRoute(connId, folly::none);
+  EXPECT_TRUE(worker_->getHandshakeRoutes().empty());
+}
+
+TEST_F(QuicServerWorkerTest, RedirectedPacketWithoutConnectionNotReset) {
+  // The connection was handed off or closed after the packet was forwarded.
+  auto connId = getTestConnectionId(hostId_);
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(PacketDropReason::CONNECTION_NOT_FOUND));
+  EXPECT_CALL(*socketPtr_, write(_, _)).Times(0);
+  RoutingData routingData(
+      HeaderForm::Short, false, false, connId, folly::none);
+  routingData.redirected = true;
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(createData(100), Clock::now()));
+}
+
 TEST_F(QuicServerWorkerTest, QuicShedTest) {
   auto connId = getTestConnectionId(hostId_);
   createQuicConnection(kClientAddr, connId);
@@ -469,6 +906,67 @@ TEST_F(QuicServerWorkerTest, ConnectionIdTooShort) {
   eventbase_.loop();
 }
 
+TEST_F(QuicServerWorkerTest, DropsCountedByTraceLogger) {
+  folly::test::TemporaryDirectory dir;
+  worker_->setTraceLogger(std::make_unique<WorkerTraceLogger>(
+      std::make_shared<QLogWriter>((dir.path() / "trace").string()), 0));
+  auto connId = ConnectionId::createWithoutChecks({1});
+  LongHeader header(
+      LongHeader::Types::Initial, connId, connId, 1, QuicVersion::MVFST);
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(PacketDropReason::INVALID_PACKET));
+
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen, header, 0 /* largestAcked */);
+  auto packet = packetToBuf(std::move(builder).buildPacket());
+  worker_->handleNetworkData(kClientAddr, std::move(packet), Clock::now());
+  eventbase_.loop();
+  EXPECT_EQ(
+      1,
+      worker_->getTraceLogger()->droppedPackets(
+          PacketDropReason::INVALID_PACKET));
+}
+
+TEST_F(QuicServerWorkerTest, ShedConnectionsUnderMemoryPressure) {
+  MockConnectionCallback connCb;
+  auto transport2 = std::make_shared<MockQuicTransport>(
+      worker_->getEventBase(),
+      std::make_unique<folly::test::MockAsyncUDPSocket>(&eventbase_),
+      connCb,
+      nullptr);
+  EXPECT_CALL(*transportInfoCb_, onNewConnection()).Times(2);
+  worker_->onConnectionIdAvailable(transport_, getTestConnectionId(hostId_));
+  worker_->onConnectionIdAvailable(
+      transport2, getTestConnectionId(hostId_ + 1));
+
+  auto setBufferedBytes = [](const MockQuicTransport::Ptr& transport,
+                             uint64_t bufferedBytes) {
+    const_cast<QuicConnectionStateBase*>(transport->getState())
+        ->flowControlState.sumCurStreamBufferLen = bufferedBytes;
+  };
+  setBufferedBytes(transport_, 1000);
+  setBufferedBytes(transport2, 5000);
+  EXPECT_EQ(worker_->getBufferedBytes(), 6000u);
+  EXPECT_EQ(worker_->shedConnections(6000), 0u);
+
+  // Only the connection buffering the most is closed.
+  auto shedError = [](const auto& error) {
+    return error &&
+        folly::variant_match(
+            error->first,
+            [](TransportErrorCode code) {
+              return code == TransportErrorCode::SERVER_BUSY;
+            },
+            [](const auto&) { return false; });
+  };
+  EXPECT_CALL(*transport_, closeNow(_)).Times(AnyNumber());
+  EXPECT_CALL(*transport2, closeNow(_)).Times(AnyNumber());
+  EXPECT_CALL(*transport_, closeNow(Truly(shedError))).Times(0);
+  EXPECT_CALL(*transport2, closeNow(Truly(shedError)));
+  EXPECT_EQ(worker_->shedConnections(2000), 1u);
+}
+
 TEST_F(QuicServerWorkerTest, ShutdownQuicServer) {
   auto connId = getTestConnectionId(hostId_);
   createQuicConnection(kClientAddr, connId);
@@ -910,6 +1408,114 @@ TEST_F(QuicServerWorkerTakeoverTest, QuicServerTakeoverProcessForwardedPkt) {
   writeSock.release();
 }
 
+TEST_F(QuicServerWorkerTakeoverTest, QuicServerTakeoverForwardedBatch) {
+  // packets belong to different server
+  ConnectionId connId = createConnIdForServer(ProcessId::ZERO),
+               clientConnId = getTestConnectionId(clientHostId_);
+  takeoverWorker_->setProcessId(ProcessId::ONE);
+  takeoverWorker_->setTakeoverProtocolVersion(TakeoverProtocolVersion::V1);
+  takeoverWorker_->startPacketForwarding(
+      folly::SocketAddress("0", 0), TakeoverProtocolVersion::V1);
+
+  auto writeSock = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb_);
+  EXPECT_CALL(*takeoverSocketFactory_, _make(_, _))
+      .WillOnce(Return(writeSock.get()));
+  EXPECT_CALL(*writeSock, bind(_));
+  Buf batch;
+  EXPECT_CALL(*writeSock, write(_, _))
+      .WillOnce(Invoke([&](const SocketAddress& /* unused */,
+                           const std::unique_ptr<folly::IOBuf>& writtenData) {
+        batch = writtenData->clone();
+        return writtenData->computeChainDataLength();
+      }));
+  auto workerCb = [&](const folly::SocketAddress& client,
+                      std::unique_ptr<RoutingData>& routingData,
+                      std::unique_ptr<NetworkData>& networkData) {
+    takeoverWorker_->dispatchPacketData(
+        client, std::move(*routingData.get()), std::move(*networkData.get()));
+  };
+  EXPECT_CALL(*takeoverWorkerCb_, routeDataToWorkerLong(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Invoke(workerCb));
+  EXPECT_CALL(*transportInfoCb_, onPacketReceived()).Times(2);
+  EXPECT_CALL(*transportInfoCb_, onRead(_)).Times(2);
+  EXPECT_CALL(*transportInfoCb_, onPacketForwarded()).Times(2);
+  std::vector<Buf> packets;
+  for (int i = 0; i < 2; i++) {
+    size_t len{0};
+    auto data = writeTestDataOnWorkersBuf(
+        clientConnId,
+        connId,
+        len,
+        takeoverWorker_.get(),
+        LongHeader::Types::Handshake);
+    takeoverWorker_->onDataAvailable(clientAddr, len, false);
+    packets.push_back(std::move(data));
+  }
+  // Both packets go out in one datagram, at the end of the loop.
+  EXPECT_FALSE(batch);
+  evb_.loopOnce(EVLOOP_NONBLOCK);
+  ASSERT_TRUE(batch);
+  folly::io::Cursor cursor(batch.get());
+  EXPECT_EQ(0x0000002, cursor.readBE<uint32_t>());
+
+  // flip the server id to 'own' the packets (else it'll keep forwarding)
+  takeoverWorker_->setProcessId(ProcessId::ZERO);
+  folly::AsyncUDPSocket::ReadCallback* takeoverCb =
+      takeoverWorker_->getTakeoverHandlerCallback();
+  uint8_t* workerBuf = nullptr;
+  size_t workerBufLen = 0;
+  takeoverCb->getReadBuffer((void**)&workerBuf, &workerBufLen);
+  batch->coalesce();
+  ASSERT_GE(workerBufLen, batch->length());
+  memcpy(workerBuf, batch->data(), batch->length());
+
+  size_t processed = 0;
+  auto cb = [&](const folly::SocketAddress& addr,
+                std::unique_ptr<RoutingData>& /* routingData */,
+                std::unique_ptr<NetworkData>& networkData) {
+    // verify that it is the original client address and data
+    EXPECT_EQ(addr.getIPAddress(), clientAddr.getIPAddress());
+    EXPECT_EQ(addr.getPort(), clientAddr.getPort());
+    ASSERT_LT(processed, packets.size());
+    EXPECT_TRUE(eq(*packets[processed], *(networkData->data)));
+    // A view of the datagram, that can be decrypted in place.
+    EXPECT_FALSE(networkData->data->isShared());
+    EXPECT_LT(networkData->receiveTimePoint, Clock::now());
+    processed++;
+  };
+  EXPECT_CALL(*takeoverWorkerCb_, routeDataToWorkerLong(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Invoke(cb));
+  EXPECT_CALL(*transportInfoCb_, onForwardedPacketReceived()).Times(1);
+  EXPECT_CALL(*transportInfoCb_, onForwardedPacketProcessed()).Times(2);
+  takeoverCb->onDataAvailable(clientAddr, batch->length(), false);
+  EXPECT_EQ(2, processed);
+  takeoverWorker_->stopPacketForwarding();
+  // release this resource since MockQuicUDPSocketFactory::_make() hands its
+  // ownership to it's caller (i.e. QuicServerWorker)
+  writeSock.release();
+}
+
+TEST_F(QuicServerWorkerTakeoverTest, QuicServerTakeoverNegotiatesV0) {
+  // The peer only speaks V0.
+  takeoverWorker_->setTakeoverProtocolVersion(TakeoverProtocolVersion::V1);
+  EXPECT_EQ(
+      TakeoverProtocolVersion::V1,
+      takeoverWorker_->getTakeoverProtocolVersion());
+  ConnectionId connId = createConnIdForServer(ProcessId::ZERO);
+  takeoverWorker_->setProcessId(ProcessId::ONE);
+  size_t len{0};
+  auto pkt = writeTestDataOnWorkersBuf(
+      getTestConnectionId(clientHostId_),
+      connId,
+      len,
+      takeoverWorker_.get(),
+      LongHeader::Types::Handshake);
+  // testPacketForwarding checks for a V0 datagram.
+  testPacketForwarding(std::move(pkt), len, connId);
+}
+
 TEST_F(QuicServerWorkerTakeoverTest, QuicServerTakeoverCbReadClose) {
   folly::AsyncUDPSocket::ReadCallback* takeoverCb =
       takeoverWorker_->getTakeoverHandlerCallback();
@@ -1656,7 +2262,17 @@ void QuicServerTest::testReset(Buf packet) {
       .WillRepeatedly(Invoke([&](auto&, auto, auto) { return folly::none; }));
   codec.setOneRttReadCipher(std::move(aead));
   codec.setOneRttHeaderCipher(test::createNoOpHeaderCipher());
-  StatelessResetToken token = generateStatelessResetToken();
+  // The reset carries the token the server derives from the connection id of
+  // the packet that triggered it.
+  folly::io::Cursor cursor(packet.get());
+  auto initialByte = cursor.readBE<uint8_t>();
+  auto shortHeaderInvariant = parseShortHeaderInvariants(initialByte, cursor);
+  ASSERT_TRUE(shortHeaderInvariant.hasValue());
+  StatelessResetGenerator generator(
+      *transportSettings_.statelessResetTokenSecret,
+      serverAddr.getFullyQualified());
+  StatelessResetToken token =
+      generator.generateToken(shortHeaderInvariant->destinationConnId);
   codec.setStatelessResetToken(token);
   AckStates ackStates;
   auto packetQueue = bufToQueue(serverData->clone());
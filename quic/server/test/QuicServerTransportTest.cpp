@@ -804,6 +804,21 @@ TEST_F(QuicServerTransportTest, IdleTimeoutExpired) {
       verifyFramePresent<ConnectionCloseFrame>(serverWrites, *serverReadCodec));
 }
 
+TEST_F(QuicServerTransportTest, LazyIdleTimeoutRearms) {
+  EXPECT_CALL(*transportInfoCb_, onNewQuicStream()).Times(1);
+  server->getNonConstConn().transportSettings.lazyIdleTimeout = true;
+  StreamId streamId = server->createBidirectionalStream().value();
+  recvEncryptedStream(streamId, *IOBuf::copyBuffer("hello"));
+  ASSERT_TRUE(server->idleTimeout().isScheduled());
+
+  // The timer firing right after the activity rearms instead of closing.
+  server->idleTimeout().cancelTimeout();
+  server->idleTimeout().timeoutExpired();
+  EXPECT_FALSE(server->isClosed());
+  EXPECT_TRUE(server->idleTimeout().isScheduled());
+  EXPECT_CALL(*transportInfoCb_, onQuicStreamClosed());
+}
+
 TEST_F(QuicServerTransportTest, RecvDataAfterIdleTimeout) {
   server->idleTimeout().timeoutExpired();
 
@@ -1924,16 +1939,12 @@ TEST_F(QuicServerTransportTest, ReceiveProbingPacketFromChangedPeerAddress) {
   auto packet = std::move(builder).buildPacket();
   auto packetData = packetToBuf(packet);
   folly::SocketAddress newPeer("100.101.102.103", 23456);
-  try {
-    deliverData(std::move(packetData), true, &newPeer);
-    FAIL();
-  } catch (const std::runtime_error& ex) {
-    EXPECT_EQ(std::string(ex.what()), "Invalid migration");
-  }
-  EXPECT_TRUE(server->getConn().localConnectionError);
-  EXPECT_EQ(
-      server->getConn().localConnectionError->second,
-      "Probing not supported yet");
+  auto peerAddress = server->getConn().peerAddress;
+  deliverData(std::move(packetData), true, &newPeer);
+  // The probe does not move the connection, nor close it.
+  EXPECT_FALSE(server->getConn().localConnectionError);
+  EXPECT_FALSE(server->isClosed());
+  EXPECT_EQ(server->getConn().peerAddress, peerAddress);
 
   std::vector<int> indices =
       getQLogEventIndices(QLogEventType::PacketDrop, qLogger);
@@ -2168,21 +2179,13 @@ TEST_F(QuicServerTransportTest, ReceivePathResponseFromDifferentPeerAddress) {
       builder);
   auto packet = std::move(builder).buildPacket();
   folly::SocketAddress newPeer2("200.101.102.103", 23456);
-  try {
-    deliverData(packetToBuf(packet), false, &newPeer2);
-    FAIL();
-  } catch (const std::runtime_error& ex) {
-    EXPECT_EQ(std::string(ex.what()), "Invalid migration");
-  }
-  EXPECT_TRUE(server->isClosed());
+  deliverData(packetToBuf(packet), false, &newPeer2);
+  // A PathResponse is a probing frame, the connection stays on newPeer.
+  EXPECT_FALSE(server->isClosed());
+  EXPECT_EQ(server->getConn().peerAddress, newPeer);
   EXPECT_TRUE(server->getConn().outstandingPathValidation);
-  EXPECT_FALSE(server->getConn().pendingEvents.schedulePathValidationTimeout);
-  EXPECT_FALSE(server->pathValidationTimeout().isScheduled());
   EXPECT_TRUE(server->getConn().writableBytesLimit);
-  EXPECT_TRUE(server->getConn().localConnectionError);
-  EXPECT_EQ(
-      server->getConn().localConnectionError->second,
-      "Probing not supported yet");
+  EXPECT_FALSE(server->getConn().localConnectionError);
 }
 
 TEST_F(QuicServerTransportTest, TooManyMigrations) {
@@ -2360,6 +2363,12 @@ TEST_F(
   EXPECT_EQ(server->getConn().migrationState.lastCongestionAndRtt->lrtt, lrtt);
   EXPECT_EQ(
       server->getConn().migrationState.lastCongestionAndRtt->rttvar, rttvar);
+  // The state of the path before is kept, for a migration back to it.
+  const auto& olderStates =
+      server->getConn().migrationState.olderCongestionAndRtt;
+  ASSERT_EQ(1, olderStates.size());
+  EXPECT_EQ(newPeer, olderStates.front().peerAddress);
+  EXPECT_EQ(1000us, olderStates.front().srtt);
 }
 
 TEST_F(QuicServerTransportTest, MigrateToStaleValidatedPeer) {
@@ -2638,6 +2647,166 @@ TEST_F(QuicServerTransportTest, ClientAddressChangeNATRebinding) {
   EXPECT_FALSE(server->getConn().migrationState.lastCongestionAndRtt);
 }
 
+TEST_F(QuicServerTransportTest, MigrationRotatesPeerConnectionId) {
+  server->getNonConstConn().transportSettings.disableMigration = false;
+  ConnectionId newConnId({2, 4, 2, 3});
+
+  auto deliverNewConnectionId = [&] {
+    ShortHeader header(
+        ProtectionType::KeyPhaseZero,
+        *server->getConn().serverConnectionId,
+        clientNextAppDataPacketNum++);
+    RegularQuicPacketBuilder builder(
+        server->getConn().udpSendPacketLen,
+        std::move(header),
+        0 /* largestAcked */);
+    ASSERT_TRUE(builder.canBuildPacket());
+    writeSimpleFrame(
+        NewConnectionIdFrame(1, newConnId, StatelessResetToken()), builder);
+    deliverData(packetToBuf(std::move(builder).buildPacket()));
+  };
+  deliverNewConnectionId();
+  // Retransmissions are not pooled twice.
+  deliverNewConnectionId();
+  ASSERT_EQ(1, server->getConn().peerConnectionIds.size());
+
+  auto data = IOBuf::copyBuffer("bad data");
+  auto packetData = packetToBuf(createStreamPacket(
+      *clientConnectionId,
+      *server->getConn().serverConnectionId,
+      clientNextAppDataPacketNum++,
+      2,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */));
+  folly::SocketAddress newPeer("100.101.102.103", 23456);
+  deliverData(std::move(packetData), false, &newPeer);
+
+  EXPECT_EQ(server->getConn().peerAddress, newPeer);
+  EXPECT_EQ(newConnId, *server->getConn().clientConnectionId);
+  EXPECT_TRUE(server->getConn().peerConnectionIds.empty());
+}
+
+TEST_F(QuicServerTransportTest, NATRebindingKeepsPeerConnectionId) {
+  server->getNonConstConn().transportSettings.disableMigration = false;
+  server->getNonConstConn().peerConnectionIds.emplace_back(
+      1, ConnectionId({2, 4, 2, 3}), StatelessResetToken());
+
+  auto data = IOBuf::copyBuffer("bad data");
+  auto packetData = packetToBuf(createStreamPacket(
+      *clientConnectionId,
+      *server->getConn().serverConnectionId,
+      clientNextAppDataPacketNum++,
+      2,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */));
+  auto peerConnId = *server->getConn().clientConnectionId;
+  folly::SocketAddress newPeer(clientAddr.getIPAddress(), 23456);
+  deliverData(std::move(packetData), false, &newPeer);
+
+  EXPECT_EQ(server->getConn().peerAddress, newPeer);
+  EXPECT_EQ(peerConnId, *server->getConn().clientConnectionId);
+  EXPECT_EQ(1, server->getConn().peerConnectionIds.size());
+}
+
+TEST_F(QuicServerTransportTest, ConnectionIdPoolIssuedAndReplenished) {
+  server->getNonConstConn().transportSettings.connectionIdPoolSize = 2;
+  const auto& selfConnIds = server->getConn().selfConnectionIds;
+  std::vector<ConnectionId> issuedIds;
+  auto saveIssuedIds = [&](auto, std::vector<ConnectionId>& ids) {
+    issuedIds = ids;
+  };
+  auto deliverRetireConnectionId = [&](uint64_t sequence) {
+    ShortHeader header(
+        ProtectionType::KeyPhaseZero,
+        *server->getConn().serverConnectionId,
+        clientNextAppDataPacketNum++);
+    RegularQuicPacketBuilder builder(
+        server->getConn().udpSendPacketLen,
+        std::move(header),
+        0 /* largestAcked */);
+    ASSERT_TRUE(builder.canBuildPacket());
+    writeSimpleFrame(RetireConnectionIdFrame(sequence), builder);
+    deliverData(packetToBuf(std::move(builder).buildPacket()));
+  };
+
+  EXPECT_CALL(routingCallback, onConnectionIdsAvailable(_, _))
+      .WillOnce(Invoke(saveIssuedIds));
+  auto data = IOBuf::copyBuffer("data");
+  deliverData(packetToBuf(createStreamPacket(
+      *clientConnectionId,
+      *server->getConn().serverConnectionId,
+      clientNextAppDataPacketNum++,
+      2,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */)));
+  ASSERT_EQ(2u, issuedIds.size());
+  ASSERT_EQ(3u, selfConnIds.size());
+  EXPECT_EQ(0u, selfConnIds[0].sequence);
+  EXPECT_EQ(1u, selfConnIds[1].sequence);
+  EXPECT_EQ(issuedIds[0], selfConnIds[1].connId);
+  EXPECT_EQ(2u, selfConnIds[2].sequence);
+  EXPECT_EQ(issuedIds[1], selfConnIds[2].connId);
+
+  // Both ids went out in the same packet.
+  size_t numPackets = 0;
+  for (const auto& packet : server->getConn().outstandingPackets) {
+    size_t numNewConnIds = 0;
+    for (const auto& frame :
+         all_frames<QuicSimpleFrame>(packet.packet.frames)) {
+      if (boost::get<NewConnectionIdFrame>(&frame)) {
+        ++numNewConnIds;
+      }
+    }
+    if (numNewConnIds > 0) {
+      EXPECT_EQ(2u, numNewConnIds);
+      ++numPackets;
+    }
+  }
+  EXPECT_EQ(1u, numPackets);
+
+  auto retiredId = issuedIds[0];
+  EXPECT_CALL(
+      routingCallback,
+      onConnectionIdsRetired(_, std::vector<ConnectionId>{retiredId}));
+  EXPECT_CALL(routingCallback, onConnectionIdsAvailable(_, _))
+      .WillOnce(Invoke(saveIssuedIds));
+  deliverRetireConnectionId(1);
+  // Retransmissions are ignored.
+  deliverRetireConnectionId(1);
+  ASSERT_EQ(1u, issuedIds.size());
+  ASSERT_EQ(3u, selfConnIds.size());
+  EXPECT_EQ(3u, selfConnIds[2].sequence);
+  EXPECT_EQ(issuedIds[0], selfConnIds[2].connId);
+
+  // The handshake id stays routed until the connection is unbound.
+  EXPECT_CALL(routingCallback, onConnectionIdsRetired(_, _)).Times(0);
+  EXPECT_CALL(routingCallback, onConnectionIdsAvailable(_, _))
+      .WillOnce(Invoke(saveIssuedIds));
+  deliverRetireConnectionId(0);
+  ASSERT_EQ(3u, selfConnIds.size());
+  EXPECT_EQ(4u, selfConnIds[2].sequence);
+  Mock::VerifyAndClearExpectations(&routingCallback);
+}
+
+TEST_F(QuicServerTransportTest, RetireConnectionIdNeverIssued) {
+  ShortHeader header(
+      ProtectionType::KeyPhaseZero,
+      *server->getConn().serverConnectionId,
+      clientNextAppDataPacketNum++);
+  RegularQuicPacketBuilder builder(
+      server->getConn().udpSendPacketLen,
+      std::move(header),
+      0 /* largestAcked */);
+  ASSERT_TRUE(builder.canBuildPacket());
+  writeSimpleFrame(RetireConnectionIdFrame(1), builder);
+  EXPECT_THROW(
+      deliverData(packetToBuf(std::move(builder).buildPacket())),
+      std::runtime_error);
+}
+
 TEST_F(
     QuicServerTransportTest,
     ClientNATRebindingWhilePathValidationOutstanding) {
@@ -2839,6 +3008,40 @@ TEST_F(QuicUnencryptedServerTransportTest, TestPendingZeroRttData) {
   EXPECT_TRUE(server->getConn().pendingZeroRttData->empty());
 }
 
+TEST_F(QuicUnencryptedServerTransportTest, TestPendingZeroRttDataBudget) {
+  PendingPacketBudget budget(1000000);
+  server->setPendingPacketBudget(&budget);
+  auto data = IOBuf::copyBuffer("bad data");
+  auto sendZeroRttPacket = [&] {
+    auto packetData = packetToBuf(createStreamPacket(
+        *clientConnectionId,
+        server->getConn().serverConnectionId.value_or(getTestConnectionId(1)),
+        clientNextAppDataPacketNum++,
+        0,
+        *data,
+        0 /* cipherOverhead */,
+        0 /* largestAcked */,
+        std::make_pair(LongHeader::Types::ZeroRtt, QuicVersion::MVFST)));
+    EXPECT_CALL(*transportInfoCb_, onPacketDropped(_));
+    deliverData(std::move(packetData));
+  };
+  sendZeroRttPacket();
+  sendZeroRttPacket();
+  EXPECT_EQ(server->getConn().pendingZeroRttData->size(), 2u);
+  // Charged for the packets rather than for the buffers they were read in.
+  EXPECT_GT(budget.getReservedBytes(), 0u);
+  EXPECT_LT(budget.getReservedBytes(), kDefaultUDPSendPacketLen);
+
+  // Nothing fits in this one.
+  PendingPacketBudget emptyBudget(0);
+  server->setPendingPacketBudget(&emptyBudget);
+  EXPECT_EQ(budget.getReservedBytes(), 0u);
+  EXPECT_TRUE(server->getConn().pendingZeroRttData->empty());
+  sendZeroRttPacket();
+  EXPECT_TRUE(server->getConn().pendingZeroRttData->empty());
+  server->setPendingPacketBudget(nullptr);
+}
+
 TEST_F(QuicUnencryptedServerTransportTest, TestPendingOneRttData) {
   recvClientHello();
   auto data = IOBuf::copyBuffer("bad data");
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicServerWorker.h>
+
+#include <folly/Benchmark.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+
+using namespace quic;
+
+/**
+ * Lookup cost of the connection maps of QuicServerWorker as the number of
+ * connections grows. Every packet a worker reads does one lookup in the
+ * connection id map, the Initial and 0-rtt packets of a new connection one in
+ * the source map. The maps only hold empty transport pointers here, the
+ * connection scale end to end, with memory and CPU per idle connection, is
+ * measured with the perf sample's --idle clients.
+ */
+
+namespace {
+
+constexpr size_t kNumLookups = 1024;
+
+ConnectionId makeRandomConnectionId() {
+  std::vector<uint8_t> bytes(kDefaultConnectionIdSize);
+  for (auto& byte : bytes) {
+    byte = folly::Random::rand32(256);
+  }
+  return ConnectionId(bytes);
+}
+
+folly::SocketAddress makeAddress(size_t i) {
+  folly::SocketAddress address;
+  address.setFromIpPort(
+      folly::to<std::string>(
+          "10.", (i >> 16) & 0xff, ".", (i >> 8) & 0xff, ".", i & 0xff),
+      1024 + (i % 50000));
+  return address;
+}
+
+void connectionIdLookup(uint32_t iters, size_t numConnections, bool hit) {
+  QuicServerWorker::ConnIdToTransportMap connections;
+  std::vector<ConnectionId> lookups;
+  BENCHMARK_SUSPEND {
+    connections.reserve(numConnections);
+    std::vector<ConnectionId> connIds;
+    while (connections.size() < numConnections) {
+      auto connId = makeRandomConnectionId();
+      if (connections.emplace(connId, nullptr).second &&
+          connIds.size() < kNumLookups) {
+        connIds.push_back(connId);
+      }
+    }
+    for (size_t i = 0; i < kNumLookups; ++i) {
+      lookups.push_back(
+          hit ? connIds[i % connIds.size()] : makeRandomConnectionId());
+    }
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(connections.find(lookups[i % kNumLookups]));
+  }
+}
+
+void sourceLookup(uint32_t iters, size_t numConnections) {
+  QuicServerWorker::SrcToTransportMap sources;
+  std::vector<QuicServerTransport::SourceIdentity> lookups;
+  BENCHMARK_SUSPEND {
+    sources.reserve(numConnections);
+    for (size_t i = 0; i < numConnections; ++i) {
+      auto source = std::make_pair(makeAddress(i), makeRandomConnectionId());
+      if (lookups.size() < kNumLookups) {
+        lookups.push_back(source);
+      }
+      sources.emplace(std::move(source), nullptr);
+    }
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(sources.find(lookups[i % lookups.size()]));
+  }
+}
+
+} // namespace
+
+BENCHMARK_NAMED_PARAM(connectionIdLookup, 1k, 1000, true)
+BENCHMARK_NAMED_PARAM(connectionIdLookup, 100k, 100000, true)
+BENCHMARK_NAMED_PARAM(connectionIdLookup, 1M, 1000000, true)
+BENCHMARK_NAMED_PARAM(connectionIdLookup, 1M_miss, 1000000, false)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(sourceLookup, 1k, 1000)
+BENCHMARK_NAMED_PARAM(sourceLookup, 100k, 100000)
+BENCHMARK_NAMED_PARAM(sourceLookup, 1M, 1000000)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
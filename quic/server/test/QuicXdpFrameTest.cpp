@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/QuicXdpFrame.h>
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+namespace quic {
+namespace test {
+
+namespace {
+const MacAddress kSrcMac = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+const MacAddress kDstMac = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+
+std::vector<uint8_t> makeFrame(
+    const folly::SocketAddress& src,
+    const folly::SocketAddress& dst,
+    const std::string& payload) {
+  std::vector<uint8_t> frame(2048);
+  auto buf = folly::IOBuf::copyBuffer(payload);
+  folly::io::Cursor cursor(buf.get());
+  auto len = writeXdpUdpFrame(
+      folly::MutableByteRange(frame.data(), frame.size()),
+      kSrcMac,
+      kDstMac,
+      src,
+      dst,
+      cursor,
+      payload.size());
+  frame.resize(len);
+  return frame;
+}
+
+std::string payloadOf(
+    const std::vector<uint8_t>& frame,
+    const XdpUdpFrame& parsed) {
+  return std::string(
+      reinterpret_cast<const char*>(frame.data()) + parsed.payloadOffset,
+      parsed.payloadLength);
+}
+} // namespace
+
+TEST(QuicXdpFrameTest, RoundTripV4) {
+  folly::SocketAddress src("10.0.0.1", 4433);
+  folly::SocketAddress dst("10.0.0.2", 51234);
+  auto frame = makeFrame(src, dst, "hello");
+  EXPECT_EQ(frame.size(), xdpUdpHeadersSize(dst) + 5);
+  auto parsed = parseXdpUdpFrame(folly::ByteRange(frame.data(), frame.size()));
+  ASSERT_TRUE(parsed.hasValue());
+  EXPECT_EQ(parsed->src, src);
+  EXPECT_EQ(parsed->dst, dst);
+  EXPECT_EQ(parsed->srcMac, kSrcMac);
+  EXPECT_EQ(parsed->dstMac, kDstMac);
+  EXPECT_EQ(payloadOf(frame, *parsed), "hello");
+}
+
+TEST(QuicXdpFrameTest, RoundTripV6) {
+  folly::SocketAddress src("2001:db8::1", 4433);
+  folly::SocketAddress dst("2001:db8::2", 51234);
+  auto frame = makeFrame(src, dst, "hello world");
+  auto parsed = parseXdpUdpFrame(folly::ByteRange(frame.data(), frame.size()));
+  ASSERT_TRUE(parsed.hasValue());
+  EXPECT_EQ(parsed->src, src);
+  EXPECT_EQ(parsed->dst, dst);
+  EXPECT_EQ(payloadOf(frame, *parsed), "hello world");
+  // The UDP checksum is mandatory over IPv6.
+  auto udp = frame.data() + 14 + 40;
+  EXPECT_NE(udp[6] | udp[7], 0);
+}
+
+TEST(QuicXdpFrameTest, PaddedFrame) {
+  folly::SocketAddress src("10.0.0.1", 4433);
+  folly::SocketAddress dst("10.0.0.2", 51234);
+  auto frame = makeFrame(src, dst, "a");
+  frame.resize(60, 0);
+  auto parsed = parseXdpUdpFrame(folly::ByteRange(frame.data(), frame.size()));
+  ASSERT_TRUE(parsed.hasValue());
+  EXPECT_EQ(payloadOf(frame, *parsed), "a");
+}
+
+TEST(QuicXdpFrameTest, VlanTag) {
+  folly::SocketAddress src("10.0.0.1", 4433);
+  folly::SocketAddress dst("10.0.0.2", 51234);
+  auto frame = makeFrame(src, dst, "tagged");
+  std::vector<uint8_t> tag = {0x81, 0x00, 0x00, 0x0a};
+  frame.insert(frame.begin() + 12, tag.begin(), tag.end());
+  auto parsed = parseXdpUdpFrame(folly::ByteRange(frame.data(), frame.size()));
+  ASSERT_TRUE(parsed.hasValue());
+  EXPECT_EQ(parsed->src, src);
+  EXPECT_EQ(payloadOf(frame, *parsed), "tagged");
+}
+
+TEST(QuicXdpFrameTest, RejectFragment) {
+  folly::SocketAddress src("10.0.0.1", 4433);
+  folly::SocketAddress dst("10.0.0.2", 51234);
+  auto frame = makeFrame(src, dst, "hello");
+  // Sets the more fragments flag.
+  frame[14 + 6] |= 0x20;
+  EXPECT_FALSE(
+      parseXdpUdpFrame(folly::ByteRange(frame.data(), frame.size())));
+}
+
+TEST(QuicXdpFrameTest, RejectNonUdp) {
+  folly::SocketAddress src("10.0.0.1", 4433);
+  folly::SocketAddress dst("10.0.0.2", 51234);
+  auto frame = makeFrame(src, dst, "hello");
+  // TCP
+  frame[14 + 9] = 6;
+  EXPECT_FALSE(
+      parseXdpUdpFrame(folly::ByteRange(frame.data(), frame.size())));
+  // ARP
+  frame = makeFrame(src, dst, "hello");
+  frame[12] = 0x08;
+  frame[13] = 0x06;
+  EXPECT_FALSE(
+      parseXdpUdpFrame(folly::ByteRange(frame.data(), frame.size())));
+}
+
+TEST(QuicXdpFrameTest, RejectTruncated) {
+  folly::SocketAddress src("2001:db8::1", 4433);
+  folly::SocketAddress dst("2001:db8::2", 51234);
+  auto frame = makeFrame(src, dst, "hello");
+  frame.resize(frame.size() - 1);
+  EXPECT_FALSE(
+      parseXdpUdpFrame(folly::ByteRange(frame.data(), frame.size())));
+}
+
+TEST(QuicXdpFrameTest, DoesNotFit) {
+  folly::SocketAddress src("10.0.0.1", 4433);
+  folly::SocketAddress dst("10.0.0.2", 51234);
+  std::vector<uint8_t> frame(xdpUdpHeadersSize(dst) + 4);
+  auto buf = folly::IOBuf::copyBuffer("hello");
+  folly::io::Cursor cursor(buf.get());
+  EXPECT_EQ(
+      writeXdpUdpFrame(
+          folly::MutableByteRange(frame.data(), frame.size()),
+          kSrcMac,
+          kDstMac,
+          src,
+          dst,
+          cursor,
+          5),
+      0u);
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/TransportProfile.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+namespace {
+CachedCongestionState makeCachedState(
+    std::chrono::microseconds srtt,
+    std::chrono::microseconds rttvar,
+    uint64_t cwndBytes) {
+  CachedCongestionState state;
+  state.srtt = srtt;
+  state.rttvar = rttvar;
+  state.minRtt = srtt;
+  state.cwndBytes = cwndBytes;
+  return state;
+}
+} // namespace
+
+TEST(TransportProfileTest, Select) {
+  EXPECT_EQ(TransportProfile::Default, selectTransportProfile(folly::none));
+  EXPECT_EQ(
+      TransportProfile::Interactive,
+      selectTransportProfile(makeCachedState(20ms, 2ms, 64 * 1024)));
+  EXPECT_EQ(
+      TransportProfile::Bulk,
+      selectTransportProfile(
+          makeCachedState(20ms, 2ms, kBulkProfileMinCwndBytes)));
+  EXPECT_EQ(
+      TransportProfile::Mobile,
+      selectTransportProfile(
+          makeCachedState(kMobileProfileMinRtt, 2ms, 64 * 1024)));
+  // Jitter takes precedence over a large window.
+  EXPECT_EQ(
+      TransportProfile::Mobile,
+      selectTransportProfile(
+          makeCachedState(20ms, 10ms, kBulkProfileMinCwndBytes)));
+}
+
+TEST(TransportProfileTest, ApplyDefault) {
+  TransportSettings settings;
+  applyTransportProfile(settings, TransportProfile::Default);
+  EXPECT_EQ(CongestionControlType::Cubic, settings.defaultCongestionController);
+  EXPECT_FALSE(settings.pacingEnabled);
+}
+
+TEST(TransportProfileTest, ApplyBulk) {
+  TransportSettings settings;
+  settings.maxReceiveStreamWindowSize =
+      settings.advertisedInitialBidiLocalStreamWindowSize * 2;
+  auto connWindow = settings.advertisedInitialConnectionWindowSize;
+  applyTransportProfile(settings, TransportProfile::Bulk);
+  EXPECT_EQ(CongestionControlType::BBR, settings.defaultCongestionController);
+  EXPECT_TRUE(settings.pacingEnabled);
+  EXPECT_TRUE(settings.ackFrequencyEnabled);
+  EXPECT_TRUE(settings.autotuneReceiveWindow);
+  // The windows don't grow past the max receive windows.
+  EXPECT_EQ(
+      settings.maxReceiveStreamWindowSize,
+      settings.advertisedInitialBidiLocalStreamWindowSize);
+  EXPECT_EQ(
+      std::min(
+          connWindow * kBulkProfileWindowMultiplier,
+          std::max(connWindow, settings.maxReceiveConnectionWindowSize)),
+      settings.advertisedInitialConnectionWindowSize);
+  EXPECT_EQ(
+      QuicBatchingMode::BATCHING_MODE_SENDMMSG, settings.batchingMode);
+}
+
+TEST(TransportProfileTest, ApplyInteractive) {
+  TransportSettings settings;
+  settings.ackFrequencyEnabled = true;
+  settings.batchingMode = QuicBatchingMode::BATCHING_MODE_GSO;
+  applyTransportProfile(settings, TransportProfile::Interactive);
+  EXPECT_EQ(CongestionControlType::Copa, settings.defaultCongestionController);
+  EXPECT_FALSE(settings.ackFrequencyEnabled);
+  EXPECT_EQ(QuicBatchingMode::BATCHING_MODE_NONE, settings.batchingMode);
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/WorkerLoadReporter.h>
+
+#include <folly/portability/GTest.h>
+
+#include <thread>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+TEST(WorkerLoadReporterTest, ZeroUntilStarted) {
+  WorkerLoadReporter reporter;
+  reporter.onBytesReceived(1000);
+  reporter.onConnectionAdded();
+  auto load = reporter.getLoad();
+  EXPECT_EQ(0, load.loopLatency.count());
+  EXPECT_EQ(0, load.numConnections);
+  EXPECT_EQ(0, load.bytesPerSecond);
+}
+
+TEST(WorkerLoadReporterTest, Sample) {
+  folly::EventBase evb;
+  WorkerLoadReporter reporter;
+  reporter.start(&evb, std::chrono::milliseconds(1000));
+  reporter.onConnectionAdded();
+  reporter.onConnectionAdded();
+  reporter.onConnectionRemoved();
+  reporter.onBytesReceived(100000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  reporter.sample();
+  auto load = reporter.getLoad();
+  EXPECT_EQ(1, load.numConnections);
+  EXPECT_GT(load.bytesPerSecond, 0);
+  // At most 100000 bytes over at least 10ms.
+  EXPECT_LE(load.bytesPerSecond, 10000000);
+
+  // Nothing received since.
+  reporter.sample();
+  EXPECT_EQ(0, reporter.getLoad().bytesPerSecond);
+  reporter.onConnectionRemoved();
+  reporter.onConnectionRemoved();
+  reporter.sample();
+  EXPECT_EQ(0, reporter.getLoad().numConnections);
+}
+
+TEST(WorkerLoadReporterTest, SamplesEveryInterval) {
+  folly::EventBase evb;
+  WorkerLoadReporter reporter;
+  reporter.start(&evb, std::chrono::milliseconds(10));
+  reporter.onConnectionAdded();
+  evb.runAfterDelay([&] { evb.terminateLoopSoon(); }, 100);
+  evb.loopForever();
+  EXPECT_EQ(1, reporter.getLoad().numConnections);
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/WorkerTraceLogger.h>
+
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/experimental/TestUtil.h>
+#include <folly/json.h>
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+using PacketDropReason = QuicTransportStatsCallback::PacketDropReason;
+
+class WorkerTraceLoggerTest : public Test {
+ public:
+  std::vector<folly::dynamic> readLines() {
+    std::string contents;
+    EXPECT_TRUE(folly::readFile(path.c_str(), contents));
+    std::vector<folly::StringPiece> lines;
+    folly::split('\n', folly::trimWhitespace(contents), lines);
+    std::vector<folly::dynamic> events;
+    for (auto line : lines) {
+      if (!line.empty()) {
+        events.push_back(folly::parseJson(line));
+      }
+    }
+    return events;
+  }
+
+  folly::test::TemporaryDirectory dir;
+  std::string path{(dir.path() / "trace").string()};
+  folly::SocketAddress peer{"1.2.3.4", 1234};
+  ConnectionId connId{std::vector<uint8_t>{1, 2, 3, 4, 5, 6, 7, 8}};
+};
+
+TEST_F(WorkerTraceLoggerTest, Events) {
+  {
+    WorkerTraceLogger logger(std::make_shared<QLogWriter>(path), 3);
+    logger.onPacketDropped(PacketDropReason::INVALID_PACKET, peer);
+    logger.onPacketRouted(peer, connId, 1);
+    logger.onPacketForwarded(peer, &connId);
+    logger.onVersionNegotiation(peer, QuicVersion::MVFST);
+  }
+  auto events = readLines();
+  ASSERT_EQ(4, events.size());
+  for (auto& event : events) {
+    EXPECT_EQ(3, event["worker"].asInt());
+    EXPECT_EQ("worker", event["event"][1].asString());
+    EXPECT_EQ(peer.describe(), event["event"][3]["peer"].asString());
+  }
+  EXPECT_EQ("packet_dropped", events[0]["event"][2].asString());
+  EXPECT_EQ(
+      "INVALID_PACKET", events[0]["event"][3]["drop_reason"].asString());
+  EXPECT_EQ(nullptr, events[0]["event"][3].get_ptr("dcid"));
+  EXPECT_EQ("packet_routed", events[1]["event"][2].asString());
+  EXPECT_EQ(connId.hex(), events[1]["event"][3]["dcid"].asString());
+  EXPECT_EQ(1, events[1]["event"][3]["to_worker"].asInt());
+  EXPECT_EQ("packet_forwarded", events[2]["event"][2].asString());
+  EXPECT_EQ(connId.hex(), events[2]["event"][3]["dcid"].asString());
+  EXPECT_EQ("version_negotiation", events[3]["event"][2].asString());
+}
+
+TEST_F(WorkerTraceLoggerTest, SampledDropsStillCounted) {
+  {
+    WorkerTraceLogger logger(std::make_shared<QLogWriter>(path), 0, 4);
+    for (int i = 0; i < 7; i++) {
+      logger.onPacketDropped(
+          PacketDropReason::CONNECTION_NOT_FOUND, peer, &connId);
+    }
+    logger.onPacketDropped(PacketDropReason::SERVER_SHUTDOWN, peer);
+    EXPECT_EQ(
+        7, logger.droppedPackets(PacketDropReason::CONNECTION_NOT_FOUND));
+    EXPECT_EQ(1, logger.droppedPackets(PacketDropReason::SERVER_SHUTDOWN));
+    EXPECT_EQ(0, logger.droppedPackets(PacketDropReason::PARSE_ERROR));
+    logger.writeDropCounts();
+  }
+  auto events = readLines();
+  // The 1st and 5th drops, then the counts which are never sampled out.
+  ASSERT_EQ(3, events.size());
+  EXPECT_EQ("packet_dropped", events[0]["event"][2].asString());
+  EXPECT_EQ("packet_dropped", events[1]["event"][2].asString());
+  auto& counts = events[2]["event"][3];
+  EXPECT_EQ("drop_counts", events[2]["event"][2].asString());
+  EXPECT_EQ(2, counts.size());
+  EXPECT_EQ(7, counts["CONNECTION_NOT_FOUND"].asInt());
+  EXPECT_EQ(1, counts["SERVER_SHUTDOWN"].asInt());
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <glog/logging.h>
+
+#include <folly/FileUtil.h>
+#include <folly/init/Init.h>
+#include <folly/portability/GFlags.h>
+
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/server/PacketTrace.h>
+
+DEFINE_string(input, "", "Packet trace file to replay");
+DEFINE_uint32(iterations, 1, "Number of times to replay the trace");
+
+int main(int argc, char* argv[]) {
+#if FOLLY_HAVE_LIBGFLAGS
+  // Enable glog logging to stderr by default.
+  gflags::SetCommandLineOptionWithMode(
+      "logtostderr", "1", gflags::SET_FLAGS_DEFAULT);
+#endif
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+  folly::Init init(&argc, &argv);
+
+  std::string data;
+  if (FLAGS_input.empty() || !folly::readFile(FLAGS_input.c_str(), data)) {
+    LOG(ERROR) << "Can't read --input=" << FLAGS_input;
+    return 1;
+  }
+  auto buf = folly::IOBuf::wrapBufferAsValue(data.data(), data.size());
+  auto trace = quic::decodePacketTrace(buf);
+  if (!trace) {
+    LOG(ERROR) << "Malformed packet trace";
+    return 1;
+  }
+  auto ccFactory =
+      std::make_shared<quic::DefaultCongestionControllerFactory>();
+  std::chrono::microseconds elapsed{0};
+  for (uint32_t i = 0; i < FLAGS_iterations; i++) {
+    quic::QuicServerConnectionState conn;
+    conn.congestionControllerFactory = ccFactory;
+    auto start = quic::Clock::now();
+    try {
+      if (!quic::replayPacketTrace(conn, *trace, start)) {
+        LOG(ERROR) << "Can't restore the connection state of the trace";
+        return 1;
+      }
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "Replay failed: " << ex.what();
+      return 1;
+    }
+    elapsed += std::chrono::duration_cast<std::chrono::microseconds>(
+        quic::Clock::now() - start);
+  }
+  LOG(INFO) << "Replayed " << trace->datagrams.size() << " datagrams "
+            << FLAGS_iterations << " times in " << elapsed.count() << "us";
+  return 0;
+}
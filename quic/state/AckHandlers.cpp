@@ -15,6 +15,97 @@
 
 namespace quic {
 
+namespace {
+
+/**
+ * Validates the ECN counts of an ack frame against the packets it newly acks
+ * (RFC 9000 section 13.4.2.1), all of which were sent with ECT(0). Returns the
+ * number of packets the peer newly reports as CE marked.
+ */
+uint64_t processECNCounts(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    const ReadAckFrame& frame,
+    const CongestionController::AckEvent& ack) {
+  if (!conn.transportSettings.enableECN || conn.ecnValidationFailed) {
+    return 0;
+  }
+  // Counts of a reordered ack may be older than the ones already seen, only
+  // acks that move the largest acked forward are checked.
+  if (ack.largestAckedPacket != frame.largestAcked) {
+    return 0;
+  }
+  auto& previous = getAckState(conn, pnSpace).ecnCountsByPeer;
+  bool valid = frame.ecnCounts.hasValue();
+  if (valid) {
+    const auto& counts = *frame.ecnCounts;
+    // We never send ECT(1), and every newly acked packet was sent with ECT(0)
+    // so it must be counted as either ECT(0) or CE.
+    valid = counts.ect0 >= previous.ect0 && counts.ce >= previous.ce &&
+        counts.ect1 == 0 &&
+        (counts.ect0 - previous.ect0) + (counts.ce - previous.ce) >=
+            ack.ackedPackets.size();
+  }
+  if (!valid) {
+    VLOG(2) << "ECN validation failed " << conn;
+    conn.ecnValidationFailed = true;
+    return 0;
+  }
+  auto newCeCount = frame.ecnCounts->ce - previous.ce;
+  previous = *frame.ecnCounts;
+  return newCeCount;
+}
+
+/**
+ * Folds ack into into, as if the packets of both had been acked by one frame.
+ */
+void mergeAckEvent(
+    CongestionController::AckEvent& into,
+    CongestionController::AckEvent&& ack) {
+  into.ackTime = std::max(into.ackTime, ack.ackTime);
+  if (ack.largestAckedPacket) {
+    into.largestAckedPacket = std::max(
+        into.largestAckedPacket.value_or(*ack.largestAckedPacket),
+        *ack.largestAckedPacket);
+  }
+  into.ackedBytes += ack.ackedBytes;
+  if (ack.mrttSample) {
+    into.mrttSample =
+        std::min(into.mrttSample.value_or(*ack.mrttSample), *ack.mrttSample);
+  }
+  into.ackedPackets.insert(
+      into.ackedPackets.end(),
+      std::make_move_iterator(ack.ackedPackets.begin()),
+      std::make_move_iterator(ack.ackedPackets.end()));
+  into.ecnCeCount += ack.ecnCeCount;
+}
+
+/**
+ * Runs loss detection and the congestion controller on the packets ack
+ * acked in pnSpace.
+ */
+void processAckEvent(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    CongestionController::AckEvent&& ack,
+    const LossVisitor& lossVisitor) {
+  auto lossEvent = handleAckForLoss(conn, lossVisitor, ack, pnSpace);
+  if (conn.congestionController &&
+      (ack.largestAckedPacket.hasValue() || lossEvent)) {
+    if (lossEvent) {
+      lossEvent->persistentCongestion =
+          isPersistentCongestion(conn, *lossEvent);
+    }
+    conn.congestionController->onPacketAckOrLoss(
+        std::move(ack), std::move(lossEvent));
+  }
+  if (pnSpace == PacketNumberSpace::AppData) {
+    updateAckFrequency(conn);
+  }
+}
+
+} // namespace
+
 void processAckFrame(
     QuicConnectionStateBase& conn,
     PacketNumberSpace pnSpace,
@@ -58,7 +149,13 @@ void processAckFrame(
 
     // TODO: only process ACKs from packets which are sent from a greater than
     // or equal to crypto protection level.
+    // Acked packets are moved out as the range is walked and the range is
+    // erased from the deque once at the end. Packets of other spaces that sit
+    // between acked ones are moved over the holes first: [remainingIt,
+    // skippedIt) are always the holes left by acked packets.
     auto packetItEnd = packetIt;
+    auto remainingIt = packetIt;
+    auto skippedIt = packetIt;
     while (packetItEnd != conn.outstandingPackets.end()) {
       auto currentPacketNum = folly::variant_match(
           packetItEnd->packet.header,
@@ -73,6 +170,9 @@ void processAckFrame(
       if (currentPacketNum > ackBlockIt->endPacket) {
         break;
       }
+      remainingIt = remainingIt == skippedIt
+          ? packetItEnd
+          : std::move(skippedIt, packetItEnd, remainingIt);
       VLOG(10) << __func__ << " acked packetNum=" << currentPacketNum
                << " space=" << currentPacketNumberSpace
                << " handshake=" << (int)packetItEnd->isHandshake
@@ -88,6 +188,10 @@ void processAckFrame(
       if (packetItEnd->associatedEvent) {
         ++clonedPacketsAcked;
       }
+      if (pnSpace == PacketNumberSpace::AppData) {
+        onPmtuPacketAcked(
+            conn, currentPacketNum, packetItEnd->encodedSize, ackReceiveTime);
+      }
       // Update RTT if current packet is the largestAcked in the frame:
       auto ackReceiveTimeOrNow =
           ackReceiveTime > packetItEnd->time ? ackReceiveTime : Clock::now();
@@ -125,9 +229,10 @@ void processAckFrame(
       conn.lossState.lastAckedPacketSentTime = packetItEnd->time;
       conn.lossState.lastAckedTime = ackReceiveTime;
       ack.ackedPackets.push_back(std::move(*packetItEnd));
-      packetItEnd = conn.outstandingPackets.erase(packetItEnd);
+      skippedIt = ++packetItEnd;
     }
-    currentPacketItStart = packetItEnd;
+    currentPacketItStart =
+        conn.outstandingPackets.erase(remainingIt, skippedIt);
   }
   DCHECK_GE(conn.outstandingHandshakePacketsCount, handshakePacketAcked);
   conn.outstandingHandshakePacketsCount -= handshakePacketAcked;
@@ -140,19 +245,48 @@ void processAckFrame(
   DCHECK_GE(
       updatedOustandingPacketsCount, conn.outstandingHandshakePacketsCount);
   DCHECK_GE(updatedOustandingPacketsCount, conn.outstandingClonedPacketsCount);
-  auto lossEvent = handleAckForLoss(conn, lossVisitor, ack, pnSpace);
-  if (conn.congestionController &&
-      (ack.largestAckedPacket.hasValue() || lossEvent)) {
-    if (lossEvent) {
-      DCHECK(lossEvent->largestLostSentTime && lossEvent->smallestLostSentTime);
-      lossEvent->persistentCongestion = isPersistentCongestion(
-          conn,
-          *lossEvent->smallestLostSentTime,
-          *lossEvent->largestLostSentTime);
-    }
-    conn.congestionController->onPacketAckOrLoss(
-        std::move(ack), std::move(lossEvent));
+  if (ack.largestAckedPacket.hasValue()) {
+    ack.ecnCeCount = processECNCounts(conn, pnSpace, frame, ack);
+  }
+  if (!conn.lossState.lostPackets.empty()) {
+    detectSpuriousLosses(conn, pnSpace, frame, ackReceiveTime);
+  }
+  QUIC_PROBE(
+      ack_processed,
+      conn,
+      static_cast<uint8_t>(pnSpace),
+      ack.largestAckedPacket.value_or(0),
+      ack.ackedBytes,
+      ack.ackedPackets.size());
+  if (pnSpace == PacketNumberSpace::AppData && conn.ackBatch) {
+    mergeAckEvent(conn.ackBatch->ack, std::move(ack));
+    conn.ackBatch->numAckFrames++;
+    return;
+  }
+  processAckEvent(conn, pnSpace, std::move(ack), lossVisitor);
+}
+
+void startAckBatch(QuicConnectionStateBase& conn) {
+  if (conn.transportSettings.batchAckProcessing) {
+    conn.ackBatch.emplace();
+  }
+}
+
+void flushAckBatch(
+    QuicConnectionStateBase& conn,
+    const LossVisitor& lossVisitor) {
+  if (!conn.ackBatch) {
+    return;
+  }
+  auto batch = std::move(*conn.ackBatch);
+  conn.ackBatch.clear();
+  if (batch.numAckFrames == 0) {
+    return;
   }
+  VLOG(10) << __func__ << " ackFrames=" << batch.numAckFrames
+           << " ackedPackets=" << batch.ack.ackedPackets.size() << " " << conn;
+  processAckEvent(
+      conn, PacketNumberSpace::AppData, std::move(batch.ack), lossVisitor);
 }
 
 void commonAckVisitorForAckFrame(
@@ -24,6 +24,10 @@ using LossVisitor = std::function<
 /**
  * Processes an ack frame and removes any outstanding packets
  * from the connection that have already been sent.
+ *
+ * While an AppData ack batch is started, the packets the frame acks are
+ * folded into it, and loss detection and the congestion controller wait for
+ * flushAckBatch.
  */
 void processAckFrame(
     QuicConnectionStateBase& conn,
@@ -33,6 +37,20 @@ void processAckFrame(
     const LossVisitor& lossVisitor,
     const TimePoint& ackReceiveTime);
 
+/**
+ * Starts folding the AppData ack frames of a read batch into one ack event,
+ * with TransportSettings::batchAckProcessing.
+ */
+void startAckBatch(QuicConnectionStateBase& conn);
+
+/**
+ * Runs loss detection and the congestion controller once on the ack frames
+ * of the batch, and ends it.
+ */
+void flushAckBatch(
+    QuicConnectionStateBase& conn,
+    const LossVisitor& lossVisitor);
+
 /**
  * Visitor function to be invoked when we receive an ACK of the WriteAckFrame
  * that we sent.
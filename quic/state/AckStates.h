@@ -40,6 +40,15 @@ struct AckState {
   folly::Optional<PacketNum> largestReceivedAtLastCloseSent;
   // Next PacketNum we will send for packet in this packet number space
   PacketNum nextPacketNum{0};
+  // Largest received packet number when ACK range aging last ran, and when
+  // that was. Ranges at or below it get dropped once it is old enough.
+  folly::Optional<PacketNum> ageCheckpoint;
+  TimePoint ageCheckpointTime;
+  // ECN codepoints of the packets received in this space, echoed to the peer
+  // in ACK_ECN frames.
+  ECNCounts ecnCountsRecvd;
+  // Largest ECN counts the peer reported for our packets in this space.
+  ECNCounts ecnCountsByPeer;
 };
 
 struct AckStates {
@@ -66,7 +66,7 @@ void shrinkReadBuffer(QuicStreamState* stream) {
   shrinkBuffers(stream->readBuffer, stream->currentReadOffset);
 
   // pretends we read stream.currentReadOffset - lastReadOffset bytes
-  updateFlowControlOnRead(*stream, lastReadOffset, Clock::now());
+  updateFlowControlOnRead(*stream, lastReadOffset, loopClockNow(stream->conn));
   // may become readable after shrink
   stream->conn.streamManager->updateReadableStreams(*stream);
   stream->conn.streamManager->updatePeekableStreams(*stream);
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/QuicFecFunctions.h>
+
+#include <folly/hash/Hash.h>
+#include <quic/state/SimpleFrameFunctions.h>
+
+namespace {
+// checksum, stream id, offset, data length and fin bit
+constexpr size_t kChecksumLength = sizeof(uint32_t);
+constexpr size_t kSymbolHeaderLength =
+    kChecksumLength + sizeof(uint64_t) * 2 + sizeof(uint16_t) + 1;
+
+void appendBE(std::vector<uint8_t>& out, uint64_t value, size_t size) {
+  for (size_t i = size; i > 0; --i) {
+    out.push_back((value >> (8 * (i - 1))) & 0xff);
+  }
+}
+
+uint64_t readBE(const uint8_t* in, size_t size) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; ++i) {
+    value = (value << 8) | in[i];
+  }
+  return value;
+}
+
+uint32_t symbolChecksum(const uint8_t* in, size_t len) {
+  return folly::hash::fnv32_buf(in, len);
+}
+
+std::vector<uint8_t> encodeSymbol(
+    quic::StreamId streamId,
+    uint64_t offset,
+    bool fin,
+    const folly::IOBuf* data) {
+  size_t len = data ? data->computeChainDataLength() : 0;
+  std::vector<uint8_t> symbol(kChecksumLength);
+  symbol.reserve(kSymbolHeaderLength + len);
+  appendBE(symbol, streamId, sizeof(uint64_t));
+  appendBE(symbol, offset, sizeof(uint64_t));
+  appendBE(symbol, len, sizeof(uint16_t));
+  symbol.push_back(fin ? 1 : 0);
+  if (data) {
+    for (const auto& range : *data) {
+      symbol.insert(symbol.end(), range.begin(), range.end());
+    }
+  }
+  auto checksum = symbolChecksum(
+      symbol.data() + kChecksumLength, symbol.size() - kChecksumLength);
+  for (size_t i = 0; i < kChecksumLength; ++i) {
+    symbol[i] = (checksum >> (8 * (kChecksumLength - 1 - i))) & 0xff;
+  }
+  return symbol;
+}
+
+folly::Optional<quic::ReadStreamFrame> decodeSymbol(
+    const std::vector<uint8_t>& symbol) {
+  if (symbol.size() < kSymbolHeaderLength) {
+    return folly::none;
+  }
+  auto in = symbol.data() + kChecksumLength;
+  auto streamId = readBE(in, sizeof(uint64_t));
+  in += sizeof(uint64_t);
+  auto offset = readBE(in, sizeof(uint64_t));
+  in += sizeof(uint64_t);
+  auto len = readBE(in, sizeof(uint16_t));
+  in += sizeof(uint16_t);
+  auto fin = *in;
+  if (len > quic::kFecMaxSourceDataLength || fin > 1 ||
+      symbol.size() < kSymbolHeaderLength + len) {
+    return folly::none;
+  }
+  auto checksum = readBE(symbol.data(), kChecksumLength);
+  if (checksum !=
+      symbolChecksum(
+          symbol.data() + kChecksumLength,
+          kSymbolHeaderLength - kChecksumLength + len)) {
+    return folly::none;
+  }
+  return quic::ReadStreamFrame(
+      streamId,
+      offset,
+      folly::IOBuf::copyBuffer(symbol.data() + kSymbolHeaderLength, len),
+      fin == 1);
+}
+
+// XORs in into out, growing out with zeroes to the length of in.
+void xorSymbol(std::vector<uint8_t>& out, const std::vector<uint8_t>& in) {
+  if (out.size() < in.size()) {
+    out.resize(in.size(), 0);
+  }
+  for (size_t i = 0; i < in.size(); ++i) {
+    out[i] ^= in[i];
+  }
+}
+
+void adaptWindow(quic::QuicConnectionStateBase& conn) {
+  auto& fec = conn.fecState;
+  uint64_t sent = fec.numPacketsSent - fec.numPacketsSentAtAdaptation;
+  uint64_t lost = conn.lossState.rtxCount - fec.numPacketsLostAtAdaptation;
+  fec.numPacketsSentAtAdaptation = fec.numPacketsSent;
+  fec.numPacketsLostAtAdaptation = conn.lossState.rtxCount;
+  // A repair frame recovers one loss in its window, so the window is set to
+  // cover half as many packets as are lost in one, on average.
+  uint64_t window = lost == 0 ? quic::kFecMaxWindow : sent / (2 * lost);
+  fec.window = std::max<uint64_t>(
+      quic::kFecMinWindow, std::min<uint64_t>(window, quic::kFecMaxWindow));
+}
+} // namespace
+
+namespace quic {
+
+void fecOnStreamFrameWritten(
+    QuicConnectionStateBase& conn,
+    const QuicStreamLike& stream,
+    const WriteStreamFrame& frame,
+    PacketNum packetNum) {
+  auto& fec = conn.fecState;
+  if (!fec.enabled || frame.len > kFecMaxSourceDataLength) {
+    return;
+  }
+  const StreamBuffer* buffer = nullptr;
+  for (auto it = std::lower_bound(
+           stream.retransmissionBuffer.begin(),
+           stream.retransmissionBuffer.end(),
+           frame.offset,
+           [](const auto& retxBuffer, const auto& offset) {
+             return retxBuffer.offset < offset;
+           });
+       it != stream.retransmissionBuffer.end() && it->offset == frame.offset;
+       ++it) {
+    if (it->data.chainLength() == frame.len && it->eof == frame.fin) {
+      buffer = &*it;
+      break;
+    }
+  }
+  if (!buffer) {
+    return;
+  }
+  xorSymbol(
+      fec.repairSymbol,
+      encodeSymbol(
+          frame.streamId, frame.offset, frame.fin, buffer->data.front()));
+  if (!fec.firstPacketNum) {
+    fec.firstPacketNum = packetNum;
+  }
+  fec.lastPacketNum = packetNum;
+  ++fec.numSourceFrames;
+}
+
+void fecOnPacketWritten(QuicConnectionStateBase& conn) {
+  auto& fec = conn.fecState;
+  if (!fec.enabled) {
+    return;
+  }
+  ++fec.numPacketsSent;
+  if (fec.numPacketsSent - fec.numPacketsSentAtAdaptation >=
+      kFecAdaptationPackets) {
+    adaptWindow(conn);
+  }
+  if (fec.numSourceFrames < fec.window) {
+    return;
+  }
+  sendSimpleFrame(
+      conn,
+      FecRepairFrame(
+          *fec.firstPacketNum,
+          fec.lastPacketNum,
+          fec.numSourceFrames,
+          folly::IOBuf::copyBuffer(
+              fec.repairSymbol.data(), fec.repairSymbol.size())));
+  fec.repairSymbol.clear();
+  fec.firstPacketNum = folly::none;
+  fec.numSourceFrames = 0;
+}
+
+void fecOnStreamFrameReceived(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    const ReadStreamFrame& frame) {
+  auto& fec = conn.fecState;
+  if (!fec.enabled ||
+      (frame.data &&
+       frame.data->computeChainDataLength() > kFecMaxSourceDataLength)) {
+    return;
+  }
+  if (fec.receivedSymbols.size() == kFecMaxReceivedSymbols) {
+    fec.receivedSymbols.pop_front();
+  }
+  fec.receivedSymbols.push_back(
+      {packetNum,
+       encodeSymbol(
+           frame.streamId, frame.offset, frame.fin, frame.data.get())});
+}
+
+folly::Optional<ReadStreamFrame> fecRecoverStreamFrame(
+    QuicConnectionStateBase& conn,
+    const FecRepairFrame& frame) {
+  auto& fec = conn.fecState;
+  if (!fec.enabled) {
+    throw QuicTransportException(
+        "Received FEC_REPAIR without advertising it",
+        TransportErrorCode::PROTOCOL_VIOLATION,
+        FrameType::FEC_REPAIR);
+  }
+  if (!frame.repairData) {
+    return folly::none;
+  }
+  std::vector<uint8_t> symbol;
+  for (const auto& range : *frame.repairData) {
+    symbol.insert(symbol.end(), range.begin(), range.end());
+  }
+  uint64_t numReceived = 0;
+  for (const auto& received : fec.receivedSymbols) {
+    if (received.packetNum < frame.firstPacketNum ||
+        received.packetNum > frame.lastPacketNum) {
+      continue;
+    }
+    // The repair is padded to the longest symbol it covers.
+    if (received.symbol.size() > symbol.size()) {
+      return folly::none;
+    }
+    xorSymbol(symbol, received.symbol);
+    ++numReceived;
+  }
+  if (numReceived + 1 != frame.numSourceFrames) {
+    return folly::none;
+  }
+  auto recovered = decodeSymbol(symbol);
+  if (recovered) {
+    ++fec.numRecoveredFrames;
+  }
+  return recovered;
+}
+
+} // namespace quic
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/codec/Types.h>
+#include <quic/state/StateData.h>
+
+/**
+ * Forward error correction of small stream frames, enabled once both
+ * endpoints advertised kFecParameterId.
+ *
+ * Every stream frame with at most kFecMaxSourceDataLength bytes of data is a
+ * source frame. Its symbol is a checksum, its stream id, offset, length and
+ * fin bit, and its data. Once a window of source frames was sent, the sender
+ * follows them with a FEC_REPAIR frame holding the XOR of their symbols, zero
+ * padded to the longest one, and the range of packets they were sent in. A
+ * receiver missing exactly one of the source frames of that range gets its
+ * symbol back by XORing the others into the repair, and handles the frame as
+ * if it was received. The checksum weeds out symbols rebuilt from frames the
+ * two endpoints counted differently.
+ *
+ * The window shrinks as the sender loses more packets, down to one repair
+ * frame every kFecMinWindow source frames.
+ */
+
+namespace quic {
+
+/**
+ * Adds frame, sent on stream in packet packetNum of the AppData packet number
+ * space, to the next repair frame if it is a source frame. Must be called
+ * after the frame's data was moved to the retransmission buffer.
+ */
+void fecOnStreamFrameWritten(
+    QuicConnectionStateBase& conn,
+    const QuicStreamLike& stream,
+    const WriteStreamFrame& frame,
+    PacketNum packetNum);
+
+/**
+ * To be called after every packet of the AppData packet number space was
+ * written. Schedules a repair frame if the window is complete, and adapts the
+ * window to the loss seen since the last adaptation.
+ */
+void fecOnPacketWritten(QuicConnectionStateBase& conn);
+
+/**
+ * Keeps the symbol of frame, received in packet packetNum, if it is a source
+ * frame. Must be called before the frame's data is consumed.
+ */
+void fecOnStreamFrameReceived(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    const ReadStreamFrame& frame);
+
+/**
+ * Returns the source frame frame allows to recover, if exactly one of the
+ * source frames it covers is missing. Throws if forward error correction was
+ * not negotiated.
+ */
+folly::Optional<ReadStreamFrame> fecRecoverStreamFrame(
+    QuicConnectionStateBase& conn,
+    const FecRepairFrame& frame);
+
+} // namespace quic
@@ -9,7 +9,11 @@
 #include <quic/state/QuicStateFunctions.h>
 
 #include <quic/common/TimeUtil.h>
+#include <quic/logging/QLoggerConstants.h>
 #include <quic/logging/QuicLogger.h>
+#include <quic/state/QuicStreamFunctions.h>
+
+#include <algorithm>
 
 namespace {
 template <typename V, typename A>
@@ -68,10 +72,17 @@ void updateAckSendStateOnRecvPacket(
     bool pktHasRetransmittableData,
     bool pktHasCryptoData) {
   DCHECK(!pktHasCryptoData || pktHasRetransmittableData);
+  // The peer may have asked for a different packet tolerance with an
+  // ACK_FREQUENCY frame, it defaults to kRxPacketsPendingBeforeAckThresh.
+  const auto& ackFrequencyState = conn.ackFrequencyState;
+  auto rxThresh = static_cast<uint8_t>(ackFrequencyState.packetTolerance);
   uint8_t thresh =
       ((pktHasRetransmittableData || ackState.numRxPacketsRecvd)
-           ? kRxPacketsPendingBeforeAckThresh
-           : kNonRxPacketsPendingBeforeAckThresh);
+           ? rxThresh
+           : std::max(rxThresh, kNonRxPacketsPendingBeforeAckThresh));
+  if (ackFrequencyState.ignoreOrder) {
+    pktOutOfOrder = false;
+  }
   if (pktHasRetransmittableData) {
     if (pktHasCryptoData || pktOutOfOrder ||
         ++ackState.numRxPacketsRecvd + ackState.numNonRxPacketsRecvd >=
@@ -144,7 +155,15 @@ void updateAckSendStateOnSentPacketWithAcks(
 bool isConnectionPaced(const QuicConnectionStateBase& conn) noexcept {
   return (
       conn.transportSettings.pacingEnabled && conn.canBePaced &&
-      conn.congestionController && conn.congestionController->canBePaced());
+      conn.congestionController && conn.congestionController->canBePaced() &&
+      !conn.kernelPacer);
+}
+
+bool isConnectionKernelPaced(const QuicConnectionStateBase& conn) noexcept {
+  return (
+      conn.transportSettings.pacingEnabled && conn.canBePaced &&
+      conn.congestionController && conn.congestionController->canBePaced() &&
+      conn.kernelPacer);
 }
 
 AckState& getAckState(
@@ -175,6 +194,63 @@ const AckState& getAckState(
   folly::assume_unreachable();
 }
 
+void updateECNCountsRecvd(AckState& ackState, ECNCodepoint ecn) noexcept {
+  switch (ecn) {
+    case ECNCodepoint::NotECT:
+      return;
+    case ECNCodepoint::ECT0:
+      ++ackState.ecnCountsRecvd.ect0;
+      return;
+    case ECNCodepoint::ECT1:
+      ++ackState.ecnCountsRecvd.ect1;
+      return;
+    case ECNCodepoint::CE:
+      ++ackState.ecnCountsRecvd.ce;
+      return;
+  }
+  folly::assume_unreachable();
+}
+
+void pruneAckRanges(
+    QuicConnectionStateBase& conn,
+    AckState& ackState,
+    TimePoint receivedTime) {
+  uint64_t pruned = 0;
+  auto maxAckRanges =
+      std::max<uint64_t>(conn.transportSettings.maxAckRanges, 1);
+  while (ackState.acks.size() > maxAckRanges) {
+    ackState.acks.pop_front();
+    ++pruned;
+  }
+  // Aging works off a single checkpoint: the largest packet received when it
+  // was taken. Once it is older than the max age, every range at or below it
+  // is dropped and a new checkpoint is taken, so ranges live between one and
+  // two max ages.
+  auto maxAge = std::max<std::chrono::microseconds>(
+      conn.lossState.srtt * conn.transportSettings.ackRangeAgeRtts,
+      kMinAckRangeAge);
+  if (conn.transportSettings.ackRangeAgeRtts > 0 &&
+      ackState.largestReceivedPacketNum) {
+    if (!ackState.ageCheckpoint) {
+      ackState.ageCheckpoint = ackState.largestReceivedPacketNum;
+      ackState.ageCheckpointTime = receivedTime;
+    } else if (receivedTime - ackState.ageCheckpointTime >= maxAge) {
+      while (ackState.acks.size() > 1 &&
+             ackState.acks.front().end <= *ackState.ageCheckpoint) {
+        ackState.acks.pop_front();
+        ++pruned;
+      }
+      ackState.ageCheckpoint = ackState.largestReceivedPacketNum;
+      ackState.ageCheckpointTime = receivedTime;
+    }
+  }
+  if (pruned > 0) {
+    VLOG(10) << __func__ << " pruned=" << pruned
+             << " remaining=" << ackState.acks.size() << " " << conn;
+    QUIC_STATS(conn.infoCallback, onAckRangesPruned, pruned);
+  }
+}
+
 AckStateVersion currentAckStateVersion(
     const QuicConnectionStateBase& conn) noexcept {
   return AckStateVersion(
@@ -259,6 +335,75 @@ bool hasReceivedPackets(const QuicConnectionStateBase& conn) noexcept {
       conn.ackStates.appDataAckState.largestReceivedPacketNum;
 }
 
+void discardHandshakeSpaces(QuicConnectionStateBase& conn) {
+  if (conn.handshakeSpacesDiscarded) {
+    return;
+  }
+  conn.handshakeSpacesDiscarded = true;
+  conn.initialWriteCipher.reset();
+  conn.initialHeaderCipher.reset();
+  conn.handshakeWriteCipher.reset();
+  conn.handshakeWriteHeaderCipher.reset();
+  if (conn.readCodec) {
+    conn.readCodec->discardHandshakeCiphers();
+  }
+  if (conn.cryptoState) {
+    releaseHandshakeCryptoStreams(*conn.cryptoState);
+  }
+  for (auto ackState :
+       {&conn.ackStates.initialAckState, &conn.ackStates.handshakeAckState}) {
+    // Swap rather than clear, which frees the ack ranges.
+    AckState discarded;
+    discarded.nextPacketNum = ackState->nextPacketNum;
+    std::swap(*ackState, discarded);
+  }
+  conn.lossState.initialLossTime.clear();
+  conn.lossState.handshakeLossTime.clear();
+  auto& lostPackets = conn.lossState.lostPackets;
+  lostPackets.erase(
+      std::remove_if(
+          lostPackets.begin(),
+          lostPackets.end(),
+          [](const auto& lostPacket) {
+            return lostPacket.pnSpace != PacketNumberSpace::AppData;
+          }),
+      lostPackets.end());
+
+  uint64_t bytesInFlight = 0;
+  uint64_t pureAcks = 0;
+  uint64_t handshakePackets = 0;
+  auto& outstandingPackets = conn.outstandingPackets;
+  outstandingPackets.erase(
+      std::remove_if(
+          outstandingPackets.begin(),
+          outstandingPackets.end(),
+          [&](const OutstandingPacket& packet) {
+            auto pnSpace = folly::variant_match(
+                packet.packet.header,
+                [](const auto& h) { return h.getPacketNumberSpace(); });
+            if (pnSpace == PacketNumberSpace::AppData) {
+              return false;
+            }
+            if (packet.pureAck) {
+              pureAcks++;
+            } else {
+              bytesInFlight += packet.encodedSize;
+            }
+            if (packet.isHandshake) {
+              handshakePackets++;
+            }
+            return true;
+          }),
+      outstandingPackets.end());
+  DCHECK_GE(conn.outstandingPureAckPacketsCount, pureAcks);
+  conn.outstandingPureAckPacketsCount -= pureAcks;
+  DCHECK_GE(conn.outstandingHandshakePacketsCount, handshakePackets);
+  conn.outstandingHandshakePacketsCount -= handshakePackets;
+  if (conn.congestionController && bytesInFlight > 0) {
+    conn.congestionController->onRemoveBytesFromInflight(bytesInFlight);
+  }
+}
+
 folly::Optional<TimePoint>& getLossTime(
     QuicConnectionStateBase& conn,
     PacketNumberSpace pnSpace) noexcept {
@@ -284,4 +429,304 @@ std::pair<folly::Optional<TimePoint>, PacketNumberSpace> earliestLossTimer(
       std::make_pair(
           conn.lossState.appDataLossTime, PacketNumberSpace::AppData));
 }
+
+uint64_t getConnectionBufferedBytes(
+    const QuicConnectionStateBase& conn) noexcept {
+  // Received data is accounted for the same way connection flow control
+  // does, which includes the holes in the read buffers.
+  DCHECK_GE(
+      conn.flowControlState.sumMaxObservedOffset,
+      conn.flowControlState.sumCurReadOffset);
+  uint64_t bufferedBytes = conn.flowControlState.sumMaxObservedOffset -
+      conn.flowControlState.sumCurReadOffset;
+  bufferedBytes += conn.flowControlState.sumCurStreamBufferLen;
+  if (conn.cryptoState) {
+    bufferedBytes += conn.cryptoState->initialStream.writeBuffer.chainLength() +
+        conn.cryptoState->handshakeStream.writeBuffer.chainLength() +
+        conn.cryptoState->oneRttStream.writeBuffer.chainLength();
+  }
+  bufferedBytes += conn.outstandingPackets.size() * conn.udpSendPacketLen;
+  return bufferedBytes;
+}
+
+void updateWriteLimiter(
+    QuicConnectionStateBase& conn,
+    WriteLimiter limiter,
+    TimePoint now) {
+  auto& state = conn.writeLimiter;
+  if (state.since && limiter == state.current) {
+    return;
+  }
+  if (state.since && now > *state.since) {
+    state.time[static_cast<size_t>(state.current)] +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - *state.since);
+  }
+  state.current = limiter;
+  state.since = now;
+  if (conn.qLogger &&
+      conn.qLogger->isEnabled(QLogEventType::TransportStateUpdate)) {
+    conn.qLogger->addTransportStateUpdate(folly::to<std::string>(
+        kWriteLimited, writeLimiterToString(limiter)));
+  }
+}
+
+std::array<std::chrono::microseconds, kNumWriteLimiters> getWriteLimitedTime(
+    const QuicConnectionStateBase& conn,
+    TimePoint now) {
+  const auto& state = conn.writeLimiter;
+  auto time = state.time;
+  if (state.since && now > *state.since) {
+    time[static_cast<size_t>(state.current)] +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - *state.since);
+  }
+  return time;
+}
+
+void handleDatagram(QuicConnectionStateBase& conn, DatagramFrame& frame) {
+  if (!conn.transportSettings.datagramsEnabled ||
+      frame.length > kMaxDatagramFrameSize) {
+    throw QuicTransportException(
+        "Unexpected DATAGRAM frame",
+        TransportErrorCode::PROTOCOL_VIOLATION,
+        FrameType::DATAGRAM_LEN);
+  }
+  auto maxBuffered = conn.transportSettings.datagramReadBufferSize;
+  if (maxBuffered == 0) {
+    return;
+  }
+  auto& readBuffer = conn.datagramState.readBuffer;
+  if (readBuffer.size() >= maxBuffered) {
+    VLOG(10) << "Datagram read buffer full, dropping oldest datagram " << conn;
+    readBuffer.pop_front();
+  }
+  readBuffer.push_back(std::move(frame.data));
+}
+
+uint64_t getDatagramSizeLimit(const QuicConnectionStateBase& conn) noexcept {
+  if (!conn.transportSettings.datagramsEnabled ||
+      conn.datagramState.maxWriteFrameSize == 0) {
+    return 0;
+  }
+  // Short header with the longest connection id and packet number, the
+  // AEAD tag, and the DATAGRAM frame type and length.
+  constexpr uint64_t kDatagramOverhead = 1 + kMaxConnectionIdSize +
+      kMaxPacketNumEncodingSize + kCipherOverheadHeuristic + 1 +
+      sizeof(uint16_t);
+  uint64_t packetLimit = conn.udpSendPacketLen > kDatagramOverhead
+      ? conn.udpSendPacketLen - kDatagramOverhead
+      : 0;
+  uint64_t frameLimit =
+      conn.datagramState.maxWriteFrameSize > 1 + sizeof(uint16_t)
+      ? conn.datagramState.maxWriteFrameSize - 1 - sizeof(uint16_t)
+      : 0;
+  return std::min(packetLimit, frameLimit);
+}
+
+void handleAckFrequency(
+    QuicConnectionStateBase& conn,
+    const AckFrequencyFrame& frame) {
+  if (!conn.transportSettings.ackFrequencyEnabled) {
+    throw QuicTransportException(
+        "Received ACK_FREQUENCY without advertising min_ack_delay",
+        TransportErrorCode::PROTOCOL_VIOLATION,
+        FrameType::ACK_FREQUENCY);
+  }
+  if (frame.maxAckDelay < kMinAckDelay) {
+    throw QuicTransportException(
+        "ACK_FREQUENCY max ack delay below min_ack_delay",
+        TransportErrorCode::PROTOCOL_VIOLATION,
+        FrameType::ACK_FREQUENCY);
+  }
+  auto& ackFrequencyState = conn.ackFrequencyState;
+  if (ackFrequencyState.largestRecvdSequenceNumber &&
+      frame.sequenceNumber <= *ackFrequencyState.largestRecvdSequenceNumber) {
+    // Reordered or retransmitted stale request.
+    return;
+  }
+  VLOG(10) << "Peer requested ack frequency packetTolerance="
+           << frame.packetTolerance
+           << " maxAckDelay=" << frame.maxAckDelay.count()
+           << "us ignoreOrder=" << frame.ignoreOrder << " " << conn;
+  ackFrequencyState.largestRecvdSequenceNumber = frame.sequenceNumber;
+  // Acking more often than asked is always allowed, so cap the tolerance to
+  // keep the pending packet counters small.
+  ackFrequencyState.packetTolerance =
+      std::min(frame.packetTolerance, kMaxAckFrequencyPacketTolerance);
+  ackFrequencyState.maxAckDelay = frame.maxAckDelay;
+  ackFrequencyState.ignoreOrder = frame.ignoreOrder;
+}
+
+void updateAckFrequency(QuicConnectionStateBase& conn) {
+  auto& ackFrequencyState = conn.ackFrequencyState;
+  if (!conn.transportSettings.ackFrequencyEnabled ||
+      !ackFrequencyState.peerMinAckDelay || !conn.congestionController ||
+      conn.udpSendPacketLen == 0) {
+    return;
+  }
+  // Keep the default tolerance in slow start so the window keeps growing on
+  // every ack, then decimate acks to a fraction of the window.
+  uint64_t packetTolerance = kRxPacketsPendingBeforeAckThresh;
+  if (!conn.congestionController->inSlowStart()) {
+    uint64_t cwndPackets =
+        conn.congestionController->getCongestionWindow() / conn.udpSendPacketLen;
+    packetTolerance = std::max<uint64_t>(
+        kRxPacketsPendingBeforeAckThresh,
+        std::min(
+            cwndPackets / kAckFrequencyCwndFraction,
+            kMaxAckFrequencyPacketTolerance));
+  }
+  if (conn.overloadState.reduceAckFrequency) {
+    // Processing acks is part of the load an overloaded server sheds, even
+    // if that slows down slow start.
+    packetTolerance = std::min(
+        packetTolerance * kOverloadAckFrequencyMultiplier,
+        kMaxAckFrequencyPacketTolerance);
+  }
+  auto maxAckDelay = timeMax(*ackFrequencyState.peerMinAckDelay, kMaxAckTimeout);
+  const auto& latest = ackFrequencyState.latestRequest;
+  if (latest && latest->packetTolerance == packetTolerance &&
+      latest->maxAckDelay == maxAckDelay) {
+    return;
+  }
+  if (!latest && packetTolerance == kRxPacketsPendingBeforeAckThresh &&
+      maxAckDelay == kMaxAckTimeout) {
+    // The peer already uses these by default.
+    return;
+  }
+  AckFrequencyFrame frame(
+      ackFrequencyState.nextSequenceNumber++,
+      packetTolerance,
+      maxAckDelay,
+      false /* ignoreOrder */);
+  VLOG(10) << "Requesting ack frequency packetTolerance=" << packetTolerance
+           << " maxAckDelay=" << maxAckDelay.count() << "us " << conn;
+  // Supersede a request that hasn't been written yet instead of sending both.
+  auto& frames = conn.pendingEvents.frames;
+  auto pending = std::find_if(frames.begin(), frames.end(), [](auto& f) {
+    return boost::get<AckFrequencyFrame>(&f) != nullptr;
+  });
+  if (pending != frames.end()) {
+    *pending = frame;
+  } else {
+    frames.emplace_back(frame);
+  }
+  ackFrequencyState.latestRequest = std::move(frame);
+}
+
+namespace {
+bool pmtuSearchComplete(
+    const QuicConnectionStateBase::PmtuDiscoveryState& state) {
+  return state.searchHigh <= state.searchLow + kPmtuSearchPrecision;
+}
+
+void onPmtuSearchUpdated(QuicConnectionStateBase& conn, TimePoint now) {
+  auto& state = conn.pmtuDiscoveryState;
+  state.probeLosses = 0;
+  if (pmtuSearchComplete(state)) {
+    VLOG(10) << "Path MTU search complete packetLen=" << conn.udpSendPacketLen
+             << " " << conn;
+    state.nextSearchTime = now + kPmtuRaiseTimeout;
+  } else {
+    state.nextSearchTime.clear();
+  }
+}
+} // namespace
+
+void startPmtuDiscovery(
+    QuicConnectionStateBase& conn,
+    uint64_t peerMaxPacketSize) {
+  auto& state = conn.pmtuDiscoveryState;
+  state.enabled = true;
+  state.basePacketLen = conn.udpSendPacketLen;
+  state.searchLow = conn.udpSendPacketLen;
+  state.maxPacketLen = std::max(
+      conn.udpSendPacketLen,
+      std::min(peerMaxPacketSize, conn.transportSettings.maxPmtuProbeSize));
+  state.searchHigh = state.maxPacketLen + 1;
+}
+
+folly::Optional<uint64_t> getPmtuProbeSize(
+    QuicConnectionStateBase& conn,
+    TimePoint now) {
+  auto& state = conn.pmtuDiscoveryState;
+  if (!state.enabled || state.probePacketNum) {
+    return folly::none;
+  }
+  if (state.nextSearchTime) {
+    if (now < *state.nextSearchTime) {
+      return folly::none;
+    }
+    state.nextSearchTime.clear();
+    state.searchHigh = state.maxPacketLen + 1;
+  }
+  if (pmtuSearchComplete(state)) {
+    return folly::none;
+  }
+  return state.searchLow + (state.searchHigh - state.searchLow) / 2;
+}
+
+void onPmtuProbeSent(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    uint64_t probeSize) {
+  auto& state = conn.pmtuDiscoveryState;
+  state.probePacketNum = packetNum;
+  state.probeSize = probeSize;
+}
+
+void onPmtuPacketAcked(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    uint64_t encodedSize,
+    TimePoint now) {
+  auto& state = conn.pmtuDiscoveryState;
+  if (!state.enabled) {
+    return;
+  }
+  if (encodedSize > state.basePacketLen) {
+    state.largePacketLosses = 0;
+  }
+  if (state.probePacketNum != packetNum) {
+    return;
+  }
+  state.probePacketNum.clear();
+  state.searchLow = std::max(state.searchLow, state.probeSize);
+  conn.udpSendPacketLen = state.searchLow;
+  VLOG(10) << "Path MTU probe acked packetLen=" << conn.udpSendPacketLen << " "
+           << conn;
+  onPmtuSearchUpdated(conn, now);
+}
+
+bool onPmtuPacketLost(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    uint64_t encodedSize,
+    TimePoint now) {
+  auto& state = conn.pmtuDiscoveryState;
+  if (!state.enabled) {
+    return false;
+  }
+  if (state.probePacketNum == packetNum) {
+    state.probePacketNum.clear();
+    if (++state.probeLosses >= kPmtuMaxProbes) {
+      state.searchHigh = std::min(state.searchHigh, state.probeSize);
+      onPmtuSearchUpdated(conn, now);
+    }
+    return true;
+  }
+  if (encodedSize <= state.basePacketLen ||
+      ++state.largePacketLosses < kPmtuBlackHoleThreshold) {
+    return false;
+  }
+  VLOG(4) << "Path MTU black hole detected packetLen=" << conn.udpSendPacketLen
+          << " " << conn;
+  state.largePacketLosses = 0;
+  state.searchHigh = conn.udpSendPacketLen;
+  state.searchLow = state.basePacketLen;
+  conn.udpSendPacketLen = state.basePacketLen;
+  onPmtuSearchUpdated(conn, now);
+  return false;
+}
 } // namespace quic
@@ -52,8 +52,12 @@ void invokeStreamReceiveStateMachine(
       stream.recv, std::move(event), stream);
 }
 
+// Whether the connection is paced with the pacing timer.
 bool isConnectionPaced(const QuicConnectionStateBase& conn) noexcept;
 
+// Whether the connection is paced with departure times set on the socket.
+bool isConnectionKernelPaced(const QuicConnectionStateBase& conn) noexcept;
+
 AckState& getAckState(
     QuicConnectionStateBase& conn,
     PacketNumberSpace pnSpace) noexcept;
@@ -96,6 +100,23 @@ bool updateLargestReceivedPacketNum(
   return expectedNextPacket != packetNum;
 }
 
+/**
+ * Count the ECN codepoint of a packet received in the space of ackState, for
+ * the ACK_ECN frames we send back.
+ */
+void updateECNCountsRecvd(AckState& ackState, ECNCodepoint ecn) noexcept;
+
+/**
+ * Drop the ACK ranges the transport settings say are no longer worth
+ * tracking: the oldest ones beyond maxAckRanges, and the ones received more
+ * than ackRangeAgeRtts RTTs ago. The range holding the largest received
+ * packet is always kept.
+ */
+void pruneAckRanges(
+    QuicConnectionStateBase& conn,
+    AckState& ackState,
+    TimePoint receivedTime);
+
 std::deque<OutstandingPacket>::iterator getNextOutstandingPacket(
     QuicConnectionStateBase& conn,
     PacketNumberSpace packetNumberSpace,
@@ -106,6 +127,16 @@ std::deque<OutstandingPacket>::iterator getFirstOutstandingPacket(
 
 bool hasReceivedPackets(const QuicConnectionStateBase& conn) noexcept;
 
+/**
+ * Drop everything kept for the Initial and Handshake packet number spaces:
+ * the read and write keys, the crypto stream data, the ack states and the
+ * outstanding packets, whose bytes are taken out of the congestion
+ * controller's bytes in flight. Nothing is sent or received in those spaces
+ * once the handshake is confirmed, which is when this should be called.
+ * Later calls do nothing.
+ */
+void discardHandshakeSpaces(QuicConnectionStateBase& conn);
+
 bool hasReceivedPacketsAtLastCloseSent(
     const QuicConnectionStateBase& conn) noexcept;
 
@@ -121,4 +152,103 @@ folly::Optional<TimePoint>& getLossTime(
 
 std::pair<folly::Optional<TimePoint>, PacketNumberSpace> earliestLossTimer(
     const QuicConnectionStateBase& conn) noexcept;
+
+/**
+ * Estimate of the bytes the connection pins in buffers: stream data received
+ * and not read yet, stream and crypto data not sent yet, and a packet worth of
+ * data for each outstanding packet. Only uses counters that are maintained
+ * anyway, so it is cheap enough to poll for every connection.
+ */
+uint64_t getConnectionBufferedBytes(
+    const QuicConnectionStateBase& conn) noexcept;
+
+/**
+ * Makes limiter what limits the writes of conn as of now, accounting the time
+ * since the last change to the previous limiter.
+ */
+void updateWriteLimiter(
+    QuicConnectionStateBase& conn,
+    WriteLimiter limiter,
+    TimePoint now);
+
+/**
+ * Time conn spent limited by each WriteLimiter, up to now for the current
+ * one.
+ */
+std::array<std::chrono::microseconds, kNumWriteLimiters> getWriteLimitedTime(
+    const QuicConnectionStateBase& conn,
+    TimePoint now);
+
+/**
+ * Buffer a received DATAGRAM frame for the app, dropping the oldest buffered
+ * datagram when the read buffer is full. Throws if we never advertised
+ * datagram support.
+ */
+void handleDatagram(QuicConnectionStateBase& conn, DatagramFrame& frame);
+
+/**
+ * The largest datagram payload that fits in a single packet and is accepted
+ * by the peer, 0 if datagrams can't be sent on the connection.
+ */
+uint64_t getDatagramSizeLimit(const QuicConnectionStateBase& conn) noexcept;
+
+/**
+ * Apply the packet tolerance and max ack delay the peer asked for in an
+ * ACK_FREQUENCY frame, unless a newer request was already received. Throws if
+ * we never advertised support for the extension.
+ */
+void handleAckFrequency(
+    QuicConnectionStateBase& conn,
+    const AckFrequencyFrame& frame);
+
+/**
+ * Ask a peer supporting the ACK frequency extension to ack less often once the
+ * congestion controller is out of slow start. Schedules an ACK_FREQUENCY
+ * frame when the desired packet tolerance changes.
+ */
+void updateAckFrequency(QuicConnectionStateBase& conn);
+
+/**
+ * Start the path MTU search from the current udpSendPacketLen, up to the
+ * smaller of the peer's max_packet_size and
+ * TransportSettings::maxPmtuProbeSize.
+ */
+void startPmtuDiscovery(
+    QuicConnectionStateBase& conn,
+    uint64_t peerMaxPacketSize);
+
+/**
+ * The size of the next path MTU probe, none if no probe should be sent now.
+ * Starts the search over once kPmtuRaiseTimeout passed since it completed.
+ */
+folly::Optional<uint64_t> getPmtuProbeSize(
+    QuicConnectionStateBase& conn,
+    TimePoint now);
+
+void onPmtuProbeSent(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    uint64_t probeSize);
+
+/**
+ * Update the path MTU search for an acked AppData packet. An acked probe
+ * raises udpSendPacketLen to the probe size.
+ */
+void onPmtuPacketAcked(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    uint64_t encodedSize,
+    TimePoint now);
+
+/**
+ * Update the path MTU search for a lost AppData packet. Falls back to the
+ * base packet size when too many packets of the discovered size got lost.
+ * Returns true if the packet was a probe, probe losses say nothing about
+ * congestion.
+ */
+bool onPmtuPacketLost(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    uint64_t encodedSize,
+    TimePoint now);
 } // namespace quic
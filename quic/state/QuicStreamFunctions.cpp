@@ -23,6 +23,17 @@ void prependToBuf(quic::Buf& buf, quic::Buf toAppend) {
     buf = std::move(toAppend);
   }
 }
+
+// Holes in the data received, before each buffer that can't be read yet.
+size_t numReadBufferGaps(const quic::QuicStreamLike& stream) {
+  const auto& readBuffer = stream.readBuffer;
+  if (readBuffer.empty()) {
+    return 0;
+  }
+  return readBuffer.front().offset > stream.currentReadOffset
+      ? readBuffer.size()
+      : readBuffer.size() - 1;
+}
 } // namespace
 
 namespace quic {
@@ -37,7 +48,16 @@ void writeDataToQuicStream(QuicStreamState& stream, Buf data, bool eof) {
     // write a blocked frame first time the stream becomes blocked
     maybeWriteBlockAfterAPIWrite(stream);
   }
-  stream.writeBuffer.append(std::move(data));
+  if (len > 0 && len <= stream.conn.transportSettings.writeCoalesceThreshold) {
+    // Copy small writes into the tail of the write buffer. Otherwise every
+    // write adds an IOBuf to the chain, and every frame and retransmission
+    // buffer split off the chain clones each of them.
+    for (auto range : *data) {
+      stream.writeBuffer.append(range.data(), range.size());
+    }
+  } else {
+    stream.writeBuffer.append(std::move(data));
+  }
   if (eof) {
     auto bufferSize =
         stream.writeBuffer.front() ? stream.writeBuffer.chainLength() : 0;
@@ -48,7 +68,19 @@ void writeDataToQuicStream(QuicStreamState& stream, Buf data, bool eof) {
 }
 
 void writeDataToQuicStream(QuicCryptoStream& stream, Buf data) {
-  stream.writeBuffer.append(std::move(data));
+  if (!data) {
+    return;
+  }
+  for (auto range : *data) {
+    while (!range.empty()) {
+      auto tail =
+          stream.writeBuffer.preallocate(1, kDefaultCryptoStreamBufferSize);
+      auto len = std::min<size_t>(tail.second, range.size());
+      memcpy(tail.first, range.data(), len);
+      stream.writeBuffer.postallocate(len);
+      range.advance(len);
+    }
+  }
 }
 
 void appendDataToReadBufferCommon(
@@ -113,6 +145,18 @@ void appendDataToReadBufferCommon(
     return;
   }
 
+  // Data that arrives in order either extends the last buffer or starts a new
+  // one after it, so there is no need to walk the buffers before it.
+  auto& lastBuffer = readBuffer.back();
+  auto lastBufferEnd = lastBuffer.offset + lastBuffer.data.chainLength();
+  if (buffer.offset == lastBufferEnd) {
+    lastBuffer.data.append(buffer.data.move());
+    return;
+  } else if (buffer.offset > lastBufferEnd) {
+    readBuffer.emplace_back(std::move(buffer));
+    return;
+  }
+
   // Start overlap will point to the first buffer that overlaps with the
   // current buffer and End overlap will point to the last buffer that overlaps.
   // They must always be set together.
@@ -198,6 +242,13 @@ void appendDataToReadBufferCommon(
 }
 
 void appendDataToReadBuffer(QuicStreamState& stream, StreamBuffer buffer) {
+  if (stream.awaitingFirstByteSince && !buffer.data.empty()) {
+    stream.conn.latencies.streamTimeToFirstByte.add(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            loopClockNow(stream.conn) - *stream.awaitingFirstByteSince));
+    stream.awaitingFirstByteSince = folly::none;
+  }
+  auto gapsBefore = numReadBufferGaps(stream);
   appendDataToReadBufferCommon(
       stream,
       std::move(buffer),
@@ -205,6 +256,10 @@ void appendDataToReadBuffer(QuicStreamState& stream, StreamBuffer buffer) {
         updateFlowControlOnStreamData(
             stream, previousMaxOffsetObserved, bufferEndOffset);
       });
+  auto gapsAfter = numReadBufferGaps(stream);
+  if (gapsAfter > gapsBefore) {
+    stream.readGapCount += gapsAfter - gapsBefore;
+  }
 }
 
 void appendDataToReadBuffer(QuicCryptoStream& stream, StreamBuffer buffer) {
@@ -212,6 +267,34 @@ void appendDataToReadBuffer(QuicCryptoStream& stream, StreamBuffer buffer) {
       stream, std::move(buffer), [](uint64_t, uint64_t) {});
 }
 
+bool exceedsReassemblyBudget(
+    const QuicConnectionStateBase& conn,
+    const RegularQuicPacket& packet) {
+  auto budget = conn.transportSettings.reassemblyBudget;
+  if (budget == 0) {
+    return false;
+  }
+  uint64_t added = 0;
+  for (const auto& quicFrame : packet.frames) {
+    auto frame = boost::get<ReadStreamFrame>(&quicFrame);
+    if (!frame) {
+      continue;
+    }
+    // Streams the peer is yet to open start at 0.
+    auto stream = conn.streamManager->findStream(frame->streamId);
+    uint64_t contiguousEnd = stream ? stream->contiguousReadEnd() : 0;
+    if (frame->offset <= contiguousEnd) {
+      return false;
+    }
+    uint64_t heldEnd = stream ? stream->readBufferEnd() : 0;
+    uint64_t frameEnd = frame->offset + frame->data->computeChainDataLength();
+    if (frameEnd > heldEnd) {
+      added += frameEnd - heldEnd;
+    }
+  }
+  return added > 0 && conn.streamManager->reassemblyBytes() + added > budget;
+}
+
 std::pair<Buf, bool> readDataInOrderFromReadBuffer(
     QuicStreamLike& stream,
     uint64_t amount,
@@ -237,7 +320,10 @@ std::pair<Buf, bool> readDataInOrderFromReadBuffer(
     uint64_t toRead =
         std::min<uint64_t>(currSize, amount == 0 ? currSize : remaining);
     std::unique_ptr<folly::IOBuf> splice;
-    if (sinkData) {
+    if (toRead == currSize) {
+      // Detach the whole chain instead of walking it to split.
+      splice = curr->data.move();
+    } else if (sinkData) {
       curr->data.trimStart(toRead);
     } else {
       splice = curr->data.split(toRead);
@@ -282,7 +368,36 @@ std::pair<Buf, bool> readDataFromQuicStream(
   std::tie(data, eof) = readDataInOrderFromReadBuffer(stream, amount);
   // Update flow control before handling eof as eof is not subject to flow
   // control
-  updateFlowControlOnRead(stream, lastReadOffset, Clock::now());
+  updateFlowControlOnRead(stream, lastReadOffset, loopClockNow(stream.conn));
+  eof = stream.finalReadOffset &&
+      stream.currentReadOffset == *stream.finalReadOffset;
+  if (eof) {
+    stream.currentReadOffset += 1;
+  }
+  stream.conn.streamManager->updateReadableStreams(stream);
+  stream.conn.streamManager->updatePeekableStreams(stream);
+  return std::make_pair(std::move(data), eof);
+}
+
+std::pair<Buf, bool> readDataFromQuicStreamWithoutCredit(
+    QuicStreamState& stream) {
+  auto eof = stream.finalReadOffset &&
+      stream.currentReadOffset >= *stream.finalReadOffset;
+  if (eof) {
+    if (stream.currentReadOffset == *stream.finalReadOffset) {
+      stream.currentReadOffset += 1;
+    }
+    stream.conn.streamManager->updateReadableStreams(stream);
+    stream.conn.streamManager->updatePeekableStreams(stream);
+    return std::make_pair(nullptr, true);
+  }
+
+  uint64_t lastReadOffset = stream.currentReadOffset;
+
+  Buf data;
+  std::tie(data, eof) = readDataInOrderFromReadBuffer(stream, 0);
+  stream.flowControlState.unreleasedReadBytes +=
+      stream.currentReadOffset - lastReadOffset;
   eof = stream.finalReadOffset &&
       stream.currentReadOffset == *stream.finalReadOffset;
   if (eof) {
@@ -326,7 +441,7 @@ void consumeDataFromQuicStream(QuicStreamState& stream, uint64_t amount) {
   readDataInOrderFromReadBuffer(stream, amount, true /* sinkData */);
   // Update flow control before handling eof as eof is not subject to flow
   // control
-  updateFlowControlOnRead(stream, lastReadOffset, Clock::now());
+  updateFlowControlOnRead(stream, lastReadOffset, loopClockNow(stream.conn));
   eof = stream.finalReadOffset &&
       stream.currentReadOffset == *stream.finalReadOffset;
   if (eof) {
@@ -386,6 +501,83 @@ uint64_t getStreamNextOffsetToDeliver(const QuicStreamState& stream) {
   return minOffsetToDeliver;
 }
 
+uint64_t getStreamReadBufferedBytes(const QuicStreamLike& stream) {
+  uint64_t bufferedBytes = 0;
+  for (const auto& buffer : stream.readBuffer) {
+    bufferedBytes += buffer.data.chainLength();
+  }
+  return bufferedBytes;
+}
+
+uint64_t getStreamWriteBufferedBytes(const QuicStreamLike& stream) {
+  uint64_t bufferedBytes = stream.writeBuffer.chainLength();
+  for (const auto& buffer : stream.retransmissionBuffer) {
+    bufferedBytes += buffer.data.chainLength();
+  }
+  for (const auto& buffer : stream.lossBuffer) {
+    bufferedBytes += buffer.data.chainLength();
+  }
+  return bufferedBytes;
+}
+
+uint64_t getStreamSchedulingQuantumLeft(const QuicStreamState& stream) {
+  if (stream.schedulingQuantumLeft > 0) {
+    return stream.schedulingQuantumLeft;
+  }
+  return stream.weight * stream.conn.udpSendPacketLen;
+}
+
+void updateStreamSchedulingQuantum(
+    QuicStreamState& stream,
+    uint64_t bytesWritten) {
+  auto quantumLeft = getStreamSchedulingQuantumLeft(stream);
+  quantumLeft -= std::min(quantumLeft, bytesWritten);
+  auto& nextScheduledStream =
+      stream.conn.schedulingState.nextScheduledStream[stream.priority.urgency];
+  if (quantumLeft == 0 || !stream.hasWritableData()) {
+    stream.schedulingQuantumLeft = 0;
+    nextScheduledStream = stream.id + 1;
+  } else {
+    // The packet filled up mid turn, the next one resumes with this stream.
+    stream.schedulingQuantumLeft = quantumLeft;
+    nextScheduledStream = stream.id;
+  }
+}
+
+void insertIntoLossBuffer(QuicStreamLike& stream, StreamBuffer buffer) {
+  auto& lossBuffer = stream.lossBuffer;
+  // The loss buffer is sorted by offset.
+  auto next = std::upper_bound(
+      lossBuffer.begin(),
+      lossBuffer.end(),
+      buffer.offset,
+      [](const auto& offset, const auto& lost) {
+        return offset < lost.offset;
+      });
+  auto contiguous = [](const StreamBuffer& first, const StreamBuffer& second) {
+    return !first.eof &&
+        first.offset + first.data.chainLength() == second.offset;
+  };
+  if (next != lossBuffer.begin() && contiguous(*std::prev(next), buffer)) {
+    auto prev = std::prev(next);
+    prev->data.append(buffer.data.move());
+    prev->eof = buffer.eof;
+    if (next != lossBuffer.end() && contiguous(*prev, *next)) {
+      prev->data.append(next->data.move());
+      prev->eof = next->eof;
+      lossBuffer.erase(next);
+    }
+    return;
+  }
+  if (next != lossBuffer.end() && contiguous(buffer, *next)) {
+    buffer.data.append(next->data.move());
+    buffer.eof = next->eof;
+    *next = std::move(buffer);
+    return;
+  }
+  lossBuffer.insert(next, std::move(buffer));
+}
+
 void cancelHandshakeCryptoStreamRetransmissions(QuicCryptoState& cryptoState) {
   // Cancel any retransmissions we might want to do for the crypto stream.
   // This does not include data that is already deemed as lost, or data that
@@ -394,6 +586,17 @@ void cancelHandshakeCryptoStreamRetransmissions(QuicCryptoState& cryptoState) {
   cryptoState.handshakeStream.retransmissionBuffer.clear();
 }
 
+void releaseHandshakeCryptoStreams(QuicCryptoState& cryptoState) {
+  for (auto stream :
+       {&cryptoState.initialStream, &cryptoState.handshakeStream}) {
+    // Swap rather than clear, which lets deques hold on to their blocks.
+    std::deque<StreamBuffer>().swap(stream->readBuffer);
+    std::deque<StreamBuffer>().swap(stream->retransmissionBuffer);
+    std::deque<StreamBuffer>().swap(stream->lossBuffer);
+    stream->writeBuffer.move();
+  }
+}
+
 QuicCryptoStream* getCryptoStream(
     QuicCryptoState& cryptoState,
     EncryptionLevel encryptionLevel) {
@@ -23,7 +23,9 @@ void writeDataToQuicStream(QuicStreamState& stream, Buf data, bool eof);
 
 /**
  * Adds data to the end of the write buffer of the QUIC crypto stream. This
- * data will be written onto the socket.
+ * data will be written onto the socket. The data is copied into a buffer
+ * sized for a whole flight, so that the messages of a flight don't each add
+ * an IOBuf that every crypto frame and retransmission buffer then clones.
  */
 void writeDataToQuicStream(QuicCryptoStream& stream, Buf data);
 
@@ -43,6 +45,17 @@ void appendDataToReadBuffer(QuicStreamState& stream, StreamBuffer buffer);
  */
 void appendDataToReadBuffer(QuicCryptoStream& stream, StreamBuffer buffer);
 
+/**
+ * Whether the stream data of packet would take the connection's reassembly
+ * over TransportSettings::reassemblyBudget, in which case the whole packet
+ * is to be dropped before it is acked, for the peer to send it again later.
+ * Packets with any data the streams can read without waiting for a gap are
+ * always let through, so that the streams keep making progress.
+ */
+bool exceedsReassemblyBudget(
+    const QuicConnectionStateBase& conn,
+    const RegularQuicPacket& packet);
+
 /**
  * Reads data from the QUIC stream if data exists.
  * Returns a pair of data and whether or not EOF was reached on the stream.
@@ -52,6 +65,16 @@ std::pair<Buf, bool> readDataFromQuicStream(
     QuicStreamState& state,
     uint64_t amount = 0);
 
+/**
+ * Reads all the contiguous data of the QUIC stream as the buffers it was
+ * received in, like readDataFromQuicStream(stream, 0), but without flow
+ * control credit for the peer. The bytes read are counted in the stream's
+ * unreleasedReadBytes until they're credited with
+ * updateFlowControlOnReadRelease.
+ */
+std::pair<Buf, bool> readDataFromQuicStreamWithoutCredit(
+    QuicStreamState& state);
+
 /**
  * Reads data from the QUIC crypto data if data exists.
  * amount == 0 reads all the pending data in the stream.
@@ -97,6 +120,32 @@ uint64_t getLargestWriteOffsetSeen(const QuicStreamState& stream);
  */
 uint64_t getStreamNextOffsetToDeliver(const QuicStreamState& stream);
 
+/**
+ * Get the number of bytes received on the stream and not yet read by the app
+ */
+uint64_t getStreamReadBufferedBytes(const QuicStreamLike& stream);
+
+/**
+ * Get the number of bytes written to the stream and not yet acked, including
+ * the data buffered for retransmission
+ */
+uint64_t getStreamWriteBufferedBytes(const QuicStreamLike& stream);
+
+/**
+ * Get the number of bytes the stream may still send in its current weighted
+ * fair queueing turn. A stream that is not in a turn gets a full quantum.
+ */
+uint64_t getStreamSchedulingQuantumLeft(const QuicStreamState& stream);
+
+/**
+ * Charge new stream data written to the socket against the stream's weighted
+ * fair queueing turn. The turn passes to the next stream of the same urgency
+ * once the quantum is used up or the stream has nothing left to write.
+ */
+void updateStreamSchedulingQuantum(
+    QuicStreamState& stream,
+    uint64_t bytesWritten);
+
 /**
  * Common functions for merging data into the read buffer for a Quic stream like
  * object. Callers should provide a connFlowControlVisitor which will be invoked
@@ -117,6 +166,14 @@ std::pair<Buf, bool> readDataInOrderFromReadBuffer(
     uint64_t amount,
     bool sinkData = false);
 
+/**
+ * Moves a buffer of lost data into the loss buffer of stream, merging it with
+ * the buffers of contiguous data already there. A burst of losses then gets
+ * retransmitted in as few frames as fit the packets, rather than in frames as
+ * small as the ones originally sent.
+ */
+void insertIntoLossBuffer(QuicStreamLike& stream, StreamBuffer buffer);
+
 /**
  * Cancel the retransmissions of the crypto stream data.
  * TODO: remove this when we can deal with cleartext data after handshake done
@@ -124,6 +181,13 @@ std::pair<Buf, bool> readDataInOrderFromReadBuffer(
  */
 void cancelHandshakeCryptoStreamRetransmissions(QuicCryptoState& cryptoStream);
 
+/**
+ * Releases all the buffers of the initial and handshake crypto streams, once
+ * the peer is known to have received everything written to them. The stream
+ * offsets are kept, so that retransmissions from the peer are still ignored.
+ */
+void releaseHandshakeCryptoStreams(QuicCryptoState& cryptoState);
+
 /**
  * Returns the appropriate crypto stream for the protection type of the packet.
  */
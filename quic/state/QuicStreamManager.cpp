@@ -39,19 +39,22 @@ static void updateHolBlockedTime(QuicStreamState& stream) {
     if (stream.lastHolbTime) {
       stream.totalHolbTime +=
           std::chrono::duration_cast<std::chrono::microseconds>(
-              Clock::now() - *stream.lastHolbTime);
+              loopClockNow(stream.conn) - *stream.lastHolbTime);
       stream.lastHolbTime = folly::none;
     }
     return;
   }
 
+  stream.maxReassemblyBytes = std::max(
+      stream.maxReassemblyBytes,
+      stream.maxOffsetObserved - stream.currentReadOffset);
   // No HOL unblocking event has occured. If we are already HOL bloked,
   // we remain HOL blocked.
   if (stream.lastHolbTime) {
     return;
   }
   // If we were previously not HOL blocked, we are now.
-  stream.lastHolbTime = Clock::now();
+  stream.lastHolbTime = loopClockNow(stream.conn);
   stream.holbCount++;
 }
 
@@ -65,7 +68,7 @@ static bool isStreamUnopened(
 // Returns false if the stream is closed or already opened.
 static LocalErrorCode openStreamIfNotClosed(
     StreamId streamId,
-    std::deque<StreamId>& openStreams,
+    StreamIdSet& openStreams,
     StreamId& nextAcceptableStreamId,
     StreamId maxStreamId) {
   if (streamId < nextAcceptableStreamId) {
@@ -75,16 +78,7 @@ static LocalErrorCode openStreamIfNotClosed(
     return LocalErrorCode::STREAM_LIMIT_EXCEEDED;
   }
 
-  // Since this is a deque just insert at the back and sort after. The swapping
-  // has lower constant time operations than inserting into the proper sorted
-  // positions.
-  // TODO We can do better than this. We probably don't want a deque.
-  StreamId start = nextAcceptableStreamId;
-  while (start <= streamId) {
-    openStreams.push_back(start);
-    start += detail::kStreamIncrement;
-  }
-  std::sort(openStreams.begin(), openStreams.end());
+  openStreams.insert(nextAcceptableStreamId, streamId);
 
   if (streamId >= nextAcceptableStreamId) {
     nextAcceptableStreamId = streamId + detail::kStreamIncrement;
@@ -131,14 +125,86 @@ void QuicStreamManager::setMaxLocalUnidirectionalStreams(
   }
 }
 
+void QuicStreamManager::setInitialMaxRemoteStreams(
+    uint64_t maxBidirectionalStreams,
+    uint64_t maxUnidirectionalStreams) {
+  maxBidirectionalStreams = std::min(maxBidirectionalStreams, kMaxMaxStreams);
+  maxUnidirectionalStreams =
+      std::min(maxUnidirectionalStreams, kMaxMaxStreams);
+  maxRemoteBidirectionalStreamId_ =
+      maxBidirectionalStreams * detail::kStreamIncrement +
+      initialRemoteBidirectionalStreamId_;
+  maxRemoteUnidirectionalStreamId_ =
+      maxUnidirectionalStreams * detail::kStreamIncrement +
+      initialRemoteUnidirectionalStreamId_;
+  remoteBidirectionalStreamBudget_ = maxBidirectionalStreams;
+  remoteUnidirectionalStreamBudget_ = maxUnidirectionalStreams;
+}
+
+void QuicStreamManager::addRemoteStreamCredit(StreamId streamId) {
+  bool bidirectional = isBidirectionalStream(streamId);
+  auto budget = bidirectional ? remoteBidirectionalStreamBudget_
+                              : remoteUnidirectionalStreamBudget_;
+  if (budget == 0) {
+    return;
+  }
+  auto& credit = bidirectional ? remoteBidirectionalStreamCredit_
+                               : remoteUnidirectionalStreamCredit_;
+  credit++;
+  // Batch the credit up rather than sending a MAX_STREAMS per closed stream.
+  uint64_t fraction = std::max<uint64_t>(
+      conn_.transportSettings.streamLimitWindowingFraction, 1);
+  if (credit < std::max<uint64_t>(budget / fraction, 1)) {
+    return;
+  }
+  auto& maxStreamId = bidirectional ? maxRemoteBidirectionalStreamId_
+                                    : maxRemoteUnidirectionalStreamId_;
+  auto initialStreamId = bidirectional ? initialRemoteBidirectionalStreamId_
+                                       : initialRemoteUnidirectionalStreamId_;
+  uint64_t maxStreams = std::min(
+      (maxStreamId - initialStreamId) / detail::kStreamIncrement + credit,
+      kMaxMaxStreams);
+  credit = 0;
+  maxStreamId = maxStreams * detail::kStreamIncrement + initialStreamId;
+  auto& update = bidirectional ? remoteBidirectionalStreamLimitUpdate_
+                               : remoteUnidirectionalStreamLimitUpdate_;
+  update = maxStreams;
+}
+
+void QuicStreamManager::onStreamLimitUpdateSent(
+    bool bidirectional,
+    uint64_t maxStreams) {
+  auto& update = bidirectional ? remoteBidirectionalStreamLimitUpdate_
+                               : remoteUnidirectionalStreamLimitUpdate_;
+  if (update && *update <= maxStreams) {
+    update = folly::none;
+  }
+}
+
+void QuicStreamManager::onStreamLimitUpdateLost(
+    bool bidirectional,
+    uint64_t maxStreams) {
+  auto maxStreamId = bidirectional ? maxRemoteBidirectionalStreamId_
+                                   : maxRemoteUnidirectionalStreamId_;
+  auto initialStreamId = bidirectional ? initialRemoteBidirectionalStreamId_
+                                       : initialRemoteUnidirectionalStreamId_;
+  uint64_t currentMaxStreams =
+      (maxStreamId - initialStreamId) / detail::kStreamIncrement;
+  if (maxStreams < currentMaxStreams) {
+    // A larger limit was sent since.
+    return;
+  }
+  auto& update = bidirectional ? remoteBidirectionalStreamLimitUpdate_
+                               : remoteUnidirectionalStreamLimitUpdate_;
+  update = currentMaxStreams;
+}
+
 // We create local streams lazily. If a local stream was created
 // but not allocated yet, this will allocate a stream.
 // This will return nullptr if a stream is closed or un-opened.
 QuicStreamState* FOLLY_NULLABLE
 QuicStreamManager::getOrCreateOpenedLocalStream(StreamId streamId) {
-  auto streamIdx =
-      std::find(openLocalStreams_.begin(), openLocalStreams_.end(), streamId);
-  if (streamIdx != openLocalStreams_.end()) {
+  if (openLocalStreams_.contains(streamId)) {
     // Open a lazily created stream.
     auto it = streams_.emplace(
         std::piecewise_construct,
@@ -187,16 +253,77 @@ QuicStreamManager::createNextUnidirectionalStream() {
   return stream;
 }
 
+folly::Expected<std::vector<StreamId>, LocalErrorCode>
+QuicStreamManager::openNextLocalStreams(
+    uint64_t numStreams,
+    StreamId& nextStreamId,
+    StreamId& nextAcceptableStreamId,
+    StreamId maxStreamId) {
+  std::vector<StreamId> streamIds;
+  if (numStreams == 0) {
+    return streamIds;
+  }
+  if (numStreams > (maxStreamId - std::min(nextStreamId, maxStreamId)) /
+          detail::kStreamIncrement) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_LIMIT_EXCEEDED);
+  }
+  streamIds.reserve(numStreams);
+  if (nextStreamId != nextAcceptableStreamId) {
+    // Some of the ids were opened out of order with createStream, they have
+    // to be checked one by one.
+    for (uint64_t i = 0; i < numStreams; ++i) {
+      auto stream = createStream(nextStreamId);
+      if (stream.hasError()) {
+        return folly::makeUnexpected(stream.error());
+      }
+      nextStreamId += detail::kStreamIncrement;
+      streamIds.push_back(stream.value()->id);
+    }
+    return streamIds;
+  }
+  auto lastStreamId =
+      nextStreamId + (numStreams - 1) * detail::kStreamIncrement;
+  auto openedResult = openStreamIfNotClosed(
+      lastStreamId, openLocalStreams_, nextAcceptableStreamId, maxStreamId);
+  if (openedResult != LocalErrorCode::NO_ERROR) {
+    return folly::makeUnexpected(openedResult);
+  }
+  for (; nextStreamId <= lastStreamId;
+       nextStreamId += detail::kStreamIncrement) {
+    streamIds.push_back(nextStreamId);
+  }
+  // The states are created when the streams are first used.
+  streams_.reserve(streams_.size() + numStreams);
+  return streamIds;
+}
+
+folly::Expected<std::vector<StreamId>, LocalErrorCode>
+QuicStreamManager::openNextBidirectionalStreams(uint64_t numStreams) {
+  return openNextLocalStreams(
+      numStreams,
+      nextBidirectionalStreamId_,
+      nextAcceptableLocalBidirectionalStreamId_,
+      maxLocalBidirectionalStreamId_);
+}
+
+folly::Expected<std::vector<StreamId>, LocalErrorCode>
+QuicStreamManager::openNextUnidirectionalStreams(uint64_t numStreams) {
+  return openNextLocalStreams(
+      numStreams,
+      nextUnidirectionalStreamId_,
+      nextAcceptableLocalUnidirectionalStreamId_,
+      maxLocalUnidirectionalStreamId_);
+}
+
 QuicStreamState* FOLLY_NULLABLE
 QuicStreamManager::getOrCreatePeerStream(StreamId streamId) {
-  // This function maintains 4 invariants:
+  // This function maintains 3 invariants:
   // 1. Streams below nextAcceptableStreamId are streams that have been
   //    seen before. Everything above can be opened.
   // 2. Streams that have been seen before, always have an entry in
   //    openPeerStreams. If a stream below nextAcceptableStreamId does not
   //    have an entry in openPeerStreams, then it is closed.
-  // 3. openPeerStreams is ordered by streamId.
-  // 4. If streamId n is open all streams < n will be seen.
+  // 3. If streamId n is open all streams < n will be seen.
   // It also tries to create the entire state for a stream in a lazy manner.
 
   // Validate the stream id is correct
@@ -217,9 +344,7 @@ QuicStreamManager::getOrCreatePeerStream(StreamId streamId) {
   if (peerStream != streams_.end()) {
     return &peerStream->second;
   }
-  auto streamIdx =
-      std::find(openPeerStreams_.begin(), openPeerStreams_.end(), streamId);
-  if (streamIdx != openPeerStreams_.end()) {
+  if (openPeerStreams_.contains(streamId)) {
     // Stream was already open, create the state for it lazily.
     auto it = streams_.emplace(
         std::piecewise_construct,
@@ -229,13 +354,14 @@ QuicStreamManager::getOrCreatePeerStream(StreamId streamId) {
     return &it.first->second;
   }
 
-  auto previousPeerStreams = openPeerStreams_;
   auto& nextAcceptableStreamId = isUnidirectionalStream(streamId)
       ? nextAcceptablePeerUnidirectionalStreamId_
       : nextAcceptablePeerBidirectionalStreamId_;
   auto maxStreamId = isUnidirectionalStream(streamId)
       ? maxRemoteUnidirectionalStreamId_
       : maxRemoteBidirectionalStreamId_;
+  // Every stream from here to streamId is opened by this one.
+  auto firstNewStreamId = nextAcceptableStreamId;
   auto openedResult = openStreamIfNotClosed(
       streamId, openPeerStreams_, nextAcceptableStreamId, maxStreamId);
   if (openedResult == LocalErrorCode::CREATING_EXISTING_STREAM) {
@@ -246,13 +372,12 @@ QuicStreamManager::getOrCreatePeerStream(StreamId streamId) {
         "Exceeded stream limit.", TransportErrorCode::STREAM_LIMIT_ERROR);
   }
 
-  // Copy over the new streams.
-  std::set_difference(
-      openPeerStreams_.begin(),
-      openPeerStreams_.end(),
-      std::make_move_iterator(previousPeerStreams.begin()),
-      std::make_move_iterator(previousPeerStreams.end()),
-      std::back_inserter(newPeerStreams_));
+  // The streams below streamId only get their state once they are used, but
+  // the app is told about all of them.
+  for (auto newStreamId = firstNewStreamId; newStreamId <= streamId;
+       newStreamId += detail::kStreamIncrement) {
+    newPeerStreams_.push_back(newStreamId);
+  }
 
   auto it = streams_.emplace(
       std::piecewise_construct,
@@ -313,9 +438,11 @@ void QuicStreamManager::removeClosedStream(StreamId streamId) {
   DCHECK(inTerminalStates);
   readableStreams_.erase(streamId);
   peekableStreams_.erase(streamId);
-  writableStreams_.erase(streamId);
+  removeWritable(it->second);
+  rateLimitedStreams_.erase(streamId);
   blockedStreams_.erase(streamId);
   deliverableStreams_.erase(streamId);
+  deadlineStreams_.erase(streamId);
   windowUpdates_.erase(streamId);
   auto itr = std::find(lossStreams_.begin(), lossStreams_.end(), streamId);
   if (itr != lossStreams_.end()) {
@@ -325,22 +452,21 @@ void QuicStreamManager::removeClosedStream(StreamId streamId) {
   if (stopItr != stopSendingStreams_.end()) {
     stopSendingStreams_.erase(stopItr);
   }
+  // Bytes the app never released can't be credited to the stream any more,
+  // but they no longer take up the connection's window.
+  conn_.flowControlState.sumCurReadOffset +=
+      it->second.flowControlState.unreleasedReadBytes;
+  reassemblyBytes_ -= it->second.reassemblyBytes;
   if (it->second.isControl) {
     DCHECK_GT(numControlStreams_, 0);
     numControlStreams_--;
   }
   streams_.erase(it);
   QUIC_STATS(conn_.infoCallback, onQuicStreamClosed);
-  auto streamItr =
-      std::find(openPeerStreams_.begin(), openPeerStreams_.end(), streamId);
-  if (streamItr != openPeerStreams_.end()) {
-    openPeerStreams_.erase(streamItr);
+  if (openPeerStreams_.erase(streamId)) {
+    addRemoteStreamCredit(streamId);
   } else {
-    streamItr =
-        std::find(openLocalStreams_.begin(), openLocalStreams_.end(), streamId);
-    if (streamItr != openLocalStreams_.end()) {
-      openLocalStreams_.erase(streamItr);
-    }
+    openLocalStreams_.erase(streamId);
   }
   updateAppIdleState();
 }
@@ -358,6 +484,10 @@ void QuicStreamManager::updateLossStreams(QuicStreamState& stream) {
 
 void QuicStreamManager::updateReadableStreams(QuicStreamState& stream) {
   updateHolBlockedTime(stream);
+  auto held = stream.readBufferEnd() - stream.contiguousReadEnd();
+  reassemblyBytes_ += held;
+  reassemblyBytes_ -= stream.reassemblyBytes;
+  stream.reassemblyBytes = held;
   auto itr = readableStreams_.find(stream.id);
   if (!stream.hasReadableData() && !stream.streamReadError.hasValue()) {
     if (itr != readableStreams_.end()) {
@@ -378,10 +508,45 @@ void QuicStreamManager::updateReadableStreams(QuicStreamState& stream) {
 
 void QuicStreamManager::updateWritableStreams(QuicStreamState& stream) {
   if (stream.hasWritableData() && !stream.streamWriteError.hasValue()) {
-    stream.conn.streamManager->addWritable(stream.id);
+    if (stream.sendRate &&
+        getStreamSendRateDelay(stream, loopClockNow(conn_)).count() > 0) {
+      // Out of the writable streams until its rate lets it send again, so
+      // that it does not keep the write looper running meanwhile.
+      removeWritable(stream);
+      rateLimitedStreams_.insert(stream.id);
+      return;
+    }
+    addWritable(stream);
   } else {
-    stream.conn.streamManager->removeWritable(stream.id);
+    removeWritable(stream);
+  }
+  if (!rateLimitedStreams_.empty()) {
+    rateLimitedStreams_.erase(stream.id);
+  }
+}
+
+std::chrono::microseconds QuicStreamManager::refreshRateLimitedStreams() {
+  auto now = loopClockNow(conn_);
+  auto nextDelay = std::chrono::microseconds::zero();
+  auto itr = rateLimitedStreams_.begin();
+  while (itr != rateLimitedStreams_.end()) {
+    auto stream = findStream(*itr);
+    if (!stream) {
+      itr = rateLimitedStreams_.erase(itr);
+      continue;
+    }
+    auto delay = getStreamSendRateDelay(*stream, now);
+    if (delay.count() == 0) {
+      itr = rateLimitedStreams_.erase(itr);
+      updateWritableStreams(*stream);
+      continue;
+    }
+    if (nextDelay.count() == 0 || delay < nextDelay) {
+      nextDelay = delay;
+    }
+    ++itr;
   }
+  return nextDelay;
 }
 
 void QuicStreamManager::updatePeekableStreams(QuicStreamState& stream) {
@@ -414,7 +579,7 @@ void QuicStreamManager::updateAppIdleState() {
   }
   isAppIdle_ = !currentNonCtrlStreams;
   if (conn_.congestionController) {
-    conn_.congestionController->setAppIdle(isAppIdle_, Clock::now());
+    conn_.congestionController->setAppIdle(isAppIdle_, loopClockNow(conn_));
   }
 }
 
@@ -426,7 +591,62 @@ void QuicStreamManager::setStreamAsControl(QuicStreamState& stream) {
   updateAppIdleState();
 }
 
+void QuicStreamManager::setStreamPriority(
+    QuicStreamState& stream,
+    Priority priority) {
+  removeWritable(stream);
+  stream.priority = priority;
+  updateWritableStreams(stream);
+}
+
 bool QuicStreamManager::isAppIdle() const {
   return isAppIdle_;
 }
+
+StreamIdState QuicStreamManager::getStreamIdState() const {
+  StreamIdState state;
+  state.nextAcceptablePeerBidirectionalStreamId =
+      nextAcceptablePeerBidirectionalStreamId_;
+  state.nextAcceptablePeerUnidirectionalStreamId =
+      nextAcceptablePeerUnidirectionalStreamId_;
+  state.nextAcceptableLocalBidirectionalStreamId =
+      nextAcceptableLocalBidirectionalStreamId_;
+  state.nextAcceptableLocalUnidirectionalStreamId =
+      nextAcceptableLocalUnidirectionalStreamId_;
+  state.nextBidirectionalStreamId = nextBidirectionalStreamId_;
+  state.nextUnidirectionalStreamId = nextUnidirectionalStreamId_;
+  state.maxLocalBidirectionalStreamId = maxLocalBidirectionalStreamId_;
+  state.maxLocalUnidirectionalStreamId = maxLocalUnidirectionalStreamId_;
+  state.maxRemoteBidirectionalStreamId = maxRemoteBidirectionalStreamId_;
+  state.maxRemoteUnidirectionalStreamId = maxRemoteUnidirectionalStreamId_;
+  state.openPeerStreams = openPeerStreams_.sortedIds();
+  state.openLocalStreams = openLocalStreams_.sortedIds();
+  return state;
+}
+
+void QuicStreamManager::setStreamIdState(const StreamIdState& state) {
+  CHECK(streams_.empty());
+  nextAcceptablePeerBidirectionalStreamId_ =
+      state.nextAcceptablePeerBidirectionalStreamId;
+  nextAcceptablePeerUnidirectionalStreamId_ =
+      state.nextAcceptablePeerUnidirectionalStreamId;
+  nextAcceptableLocalBidirectionalStreamId_ =
+      state.nextAcceptableLocalBidirectionalStreamId;
+  nextAcceptableLocalUnidirectionalStreamId_ =
+      state.nextAcceptableLocalUnidirectionalStreamId;
+  nextBidirectionalStreamId_ = state.nextBidirectionalStreamId;
+  nextUnidirectionalStreamId_ = state.nextUnidirectionalStreamId;
+  maxLocalBidirectionalStreamId_ = state.maxLocalBidirectionalStreamId;
+  maxLocalUnidirectionalStreamId_ = state.maxLocalUnidirectionalStreamId;
+  maxRemoteBidirectionalStreamId_ = state.maxRemoteBidirectionalStreamId;
+  maxRemoteUnidirectionalStreamId_ = state.maxRemoteUnidirectionalStreamId;
+  openPeerStreams_.clear();
+  for (auto streamId : state.openPeerStreams) {
+    openPeerStreams_.insert(streamId);
+  }
+  openLocalStreams_.clear();
+  for (auto streamId : state.openLocalStreams) {
+    openLocalStreams_.insert(streamId);
+  }
+}
 } // namespace quic
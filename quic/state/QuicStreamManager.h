@@ -10,13 +10,18 @@
 
 #include <quic/QuicConstants.h>
 #include <quic/codec/Types.h>
+#include <quic/common/BlockRecycler.h>
 #include <quic/state/StreamData.h>
+#include <quic/state/StreamIdSet.h>
+#include <algorithm>
+#include <array>
 #include <deque>
 #include <map>
 #include <numeric>
 #include <queue>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 namespace quic {
 namespace detail {
@@ -24,8 +29,36 @@ namespace detail {
 constexpr uint8_t kStreamIncrement = 0x04;
 }
 
+/**
+ * The stream ids a QuicStreamManager has opened, and the ones it accepts next,
+ * so that they can be carried over to another connection state.
+ */
+struct StreamIdState {
+  StreamId nextAcceptablePeerBidirectionalStreamId{0};
+  StreamId nextAcceptablePeerUnidirectionalStreamId{0};
+  StreamId nextAcceptableLocalBidirectionalStreamId{0};
+  StreamId nextAcceptableLocalUnidirectionalStreamId{0};
+  StreamId nextBidirectionalStreamId{0};
+  StreamId nextUnidirectionalStreamId{0};
+  StreamId maxLocalBidirectionalStreamId{0};
+  StreamId maxLocalUnidirectionalStreamId{0};
+  StreamId maxRemoteBidirectionalStreamId{0};
+  StreamId maxRemoteUnidirectionalStreamId{0};
+  std::deque<StreamId> openPeerStreams;
+  std::deque<StreamId> openLocalStreams;
+};
+
 class QuicStreamManager {
  public:
+  // Recycled with the rest of the connection, see BlockRecycler.
+  static void* operator new(size_t size) {
+    return BlockRecycler::allocate(size);
+  }
+
+  static void operator delete(void* p, size_t size) noexcept {
+    BlockRecycler::deallocate(p, size);
+  }
+
   explicit QuicStreamManager(
       QuicConnectionStateBase& conn,
       QuicNodeType nodeType)
@@ -39,6 +72,8 @@ class QuicStreamManager {
       nextUnidirectionalStreamId_ = 0x03;
       initialBidirectionalStreamId_ = 0x01;
       initialUnidirectionalStreamId_ = 0x03;
+      initialRemoteBidirectionalStreamId_ = 0x00;
+      initialRemoteUnidirectionalStreamId_ = 0x02;
     } else {
       nextAcceptablePeerBidirectionalStreamId_ = 0x01;
       nextAcceptablePeerUnidirectionalStreamId_ = 0x03;
@@ -48,6 +83,8 @@ class QuicStreamManager {
       nextUnidirectionalStreamId_ = 0x02;
       initialBidirectionalStreamId_ = 0x00;
       initialUnidirectionalStreamId_ = 0x02;
+      initialRemoteBidirectionalStreamId_ = 0x01;
+      initialRemoteUnidirectionalStreamId_ = 0x03;
     }
   }
   /*
@@ -69,6 +106,20 @@ class QuicStreamManager {
   folly::Expected<QuicStreamState*, LocalErrorCode>
   createNextUnidirectionalStream();
 
+  /*
+   * Open the next numStreams bidirectional streams at once, with a single
+   * check of the stream limit. Either all of them are opened or none. Their
+   * state is created lazily, when they are first used.
+   */
+  folly::Expected<std::vector<StreamId>, LocalErrorCode>
+  openNextBidirectionalStreams(uint64_t numStreams);
+
+  /*
+   * Same as above, for unidirectional streams.
+   */
+  folly::Expected<std::vector<StreamId>, LocalErrorCode>
+  openNextUnidirectionalStreams(uint64_t numStreams);
+
   /*
    * Return the stream state or create it if the state has not yet been created.
    * Note that this is only valid for streams that are currently open.
@@ -86,6 +137,14 @@ class QuicStreamManager {
    */
   void updateReadableStreams(QuicStreamState& stream);
 
+  /*
+   * Span of the stream data received beyond a gap, over all the streams,
+   * see QuicStreamState::reassemblyBytes.
+   */
+  uint64_t reassemblyBytes() const {
+    return reassemblyBytes_;
+  }
+
   /*
    * Update the current peehable streams for the given stream state. This will
    * either add or remove it from the collection of currently peekable streams.
@@ -116,10 +175,8 @@ class QuicStreamManager {
    * thus the caller must check separately for the crypto stream.
    */
   bool streamExists(StreamId streamId) {
-    return std::binary_search(
-               openPeerStreams_.begin(), openPeerStreams_.end(), streamId) ||
-        std::binary_search(
-               openLocalStreams_.begin(), openLocalStreams_.end(), streamId);
+    return openPeerStreams_.contains(streamId) ||
+        openLocalStreams_.contains(streamId);
   }
 
   uint64_t openableLocalBidirectionalStreams() {
@@ -160,6 +217,7 @@ class QuicStreamManager {
     openLocalStreams_.clear();
     openPeerStreams_.clear();
     streams_.clear();
+    reassemblyBytes_ = 0;
   }
 
   /*
@@ -191,10 +249,12 @@ class QuicStreamManager {
     return !lossStreams_.empty();
   }
 
+  using WritableStreamSet = std::set<StreamId>;
+
   // TODO figure out a better interface here.
   /*
-   * Returns a mutable reference to the container holding the writable stream
-   * IDs.
+   * Returns a mutable reference to the containers holding the writable stream
+   * IDs, indexed by urgency.
    */
   auto& writableStreams() {
     return writableStreams_;
@@ -204,37 +264,66 @@ class QuicStreamManager {
    * Returns if there are any writable streams.
    */
   bool hasWritable() const {
-    return !writableStreams_.empty();
+    return std::any_of(
+        writableStreams_.begin(),
+        writableStreams_.end(),
+        [](const WritableStreamSet& level) { return !level.empty(); });
   }
 
   /*
    * Returns if the current writable streams contains the given id.
    */
   bool writableContains(StreamId streamId) const {
-    return writableStreams_.count(streamId) > 0;
+    return std::any_of(
+        writableStreams_.begin(),
+        writableStreams_.end(),
+        [streamId](const WritableStreamSet& level) {
+          return level.count(streamId) > 0;
+        });
   }
 
   /*
-   * Add a writable stream id.
+   * Add a writable stream.
    */
-  void addWritable(StreamId streamId) {
-    writableStreams_.insert(streamId);
+  void addWritable(const QuicStreamState& stream) {
+    writableStreams_[stream.priority.urgency].insert(stream.id);
   }
 
   /*
-   * Remove a writable stream id.
+   * Remove a writable stream.
    */
-  void removeWritable(StreamId streamId) {
-    writableStreams_.erase(streamId);
+  void removeWritable(const QuicStreamState& stream) {
+    writableStreams_[stream.priority.urgency].erase(stream.id);
   }
 
   /*
    * Clear the writable streams.
    */
   void clearWritable() {
-    writableStreams_.clear();
+    for (auto& level : writableStreams_) {
+      level.clear();
+    }
+    rateLimitedStreams_.clear();
+  }
+
+  /*
+   * Returns the streams with data to write that have to wait for their send
+   * rate first.
+   */
+  const auto& rateLimitedStreams() const {
+    return rateLimitedStreams_;
+  }
+
+  bool hasRateLimited() const {
+    return !rateLimitedStreams_.empty();
   }
 
+  /*
+   * Makes the rate limited streams that can send again writable. Returns
+   * how long until the next one of the others can, 0 if there is none left.
+   */
+  std::chrono::microseconds refreshRateLimitedStreams();
+
   /*
    * Returns a const reference to the underlying blocked streams container.
    */
@@ -277,6 +366,48 @@ class QuicStreamManager {
       uint64_t maxStreams,
       bool force = false);
 
+  /*
+   * Set the initial max number of streams the peer can open, as advertised
+   * to it. From then on, the peer is granted a new stream for every one of
+   * its streams that closes, so that it can keep as many streams open at
+   * once, see TransportSettings::streamLimitWindowingFraction.
+   */
+  void setInitialMaxRemoteStreams(
+      uint64_t maxBidirectionalStreams,
+      uint64_t maxUnidirectionalStreams);
+
+  /*
+   * The new max number of peer bidirectional streams to send in a
+   * MAX_STREAMS frame, if any.
+   */
+  folly::Optional<uint64_t> remoteBidirectionalStreamLimitUpdate() const {
+    return remoteBidirectionalStreamLimitUpdate_;
+  }
+
+  /*
+   * The new max number of peer unidirectional streams to send in a
+   * MAX_STREAMS frame, if any.
+   */
+  folly::Optional<uint64_t> remoteUnidirectionalStreamLimitUpdate() const {
+    return remoteUnidirectionalStreamLimitUpdate_;
+  }
+
+  bool hasStreamLimitUpdates() const {
+    return remoteBidirectionalStreamLimitUpdate_ ||
+        remoteUnidirectionalStreamLimitUpdate_;
+  }
+
+  /*
+   * Called when a MAX_STREAMS frame with maxStreams was written.
+   */
+  void onStreamLimitUpdateSent(bool bidirectional, uint64_t maxStreams);
+
+  /*
+   * Called when a MAX_STREAMS frame with maxStreams was lost. It is sent
+   * again unless a larger limit was sent since.
+   */
+  void onStreamLimitUpdateLost(bool bidirectional, uint64_t maxStreams);
+
   /*
    * Returns a const reference to the underlying stream window updates
    * container.
@@ -377,6 +508,34 @@ class QuicStreamManager {
     return deliverableStreams_.count(streamId) > 0;
   }
 
+  /*
+   * Returns a const reference to the streams that have write deadlines.
+   */
+  const auto& deadlineStreams() const {
+    return deadlineStreams_;
+  }
+
+  /*
+   * Returns if there are any streams with write deadlines.
+   */
+  bool hasDeadlines() const {
+    return !deadlineStreams_.empty();
+  }
+
+  /*
+   * Add a stream with write deadlines.
+   */
+  void addDeadline(StreamId streamId) {
+    deadlineStreams_.insert(streamId);
+  }
+
+  /*
+   * Remove a stream that has no more write deadlines.
+   */
+  void removeDeadline(StreamId streamId) {
+    deadlineStreams_.erase(streamId);
+  }
+
   /*
    * Returns a const reference to the underlying data rejected streams
    * container.
@@ -552,6 +711,12 @@ class QuicStreamManager {
    */
   void setStreamAsControl(QuicStreamState& stream);
 
+  /*
+   * Changes the scheduling priority of the given stream, moving it to the
+   * writable set of its new urgency if it has data to write.
+   */
+  void setStreamPriority(QuicStreamState& stream, Priority priority);
+
   /*
    * Clear the tracking of streams which can trigger API callbacks.
    */
@@ -565,6 +730,15 @@ class QuicStreamManager {
 
   bool isAppIdle() const;
 
+  StreamIdState getStreamIdState() const;
+
+  /*
+   * Takes over the stream ids of another stream manager. Only valid before
+   * any stream is created. The open streams get their state lazily, on
+   * getStream.
+   */
+  void setStreamIdState(const StreamIdState& state);
+
  private:
   // Updates the congestion controller app-idle state, after a change in the
   // number of streams.
@@ -577,6 +751,15 @@ class QuicStreamManager {
   QuicStreamState* FOLLY_NULLABLE
   getOrCreateOpenedLocalStream(StreamId streamId);
 
+  // Grants the peer a new stream in place of the closed streamId.
+  void addRemoteStreamCredit(StreamId streamId);
+
+  folly::Expected<std::vector<StreamId>, LocalErrorCode> openNextLocalStreams(
+      uint64_t numStreams,
+      StreamId& nextStreamId,
+      StreamId& nextAcceptableStreamId,
+      StreamId maxStreamId);
+
   QuicStreamState* FOLLY_NULLABLE getOrCreatePeerStream(StreamId streamId);
 
   QuicConnectionStateBase& conn_;
@@ -616,16 +799,41 @@ class QuicStreamManager {
 
   StreamId initialUnidirectionalStreamId_{0};
 
+  StreamId initialRemoteBidirectionalStreamId_{0};
+
+  StreamId initialRemoteUnidirectionalStreamId_{0};
+
+  // The number of streams the peer can keep open at once, 0 if its stream
+  // limits are not raised as its streams close.
+  uint64_t remoteBidirectionalStreamBudget_{0};
+
+  uint64_t remoteUnidirectionalStreamBudget_{0};
+
+  // Peer streams closed since the stream limits were last raised.
+  uint64_t remoteBidirectionalStreamCredit_{0};
+
+  uint64_t remoteUnidirectionalStreamCredit_{0};
+
+  folly::Optional<uint64_t> remoteBidirectionalStreamLimitUpdate_;
+
+  folly::Optional<uint64_t> remoteUnidirectionalStreamLimitUpdate_;
+
   uint64_t numControlStreams_{0};
 
-  // Streams that are opened by the peer on the connection. Ordered by id.
-  std::deque<StreamId> openPeerStreams_;
+  // Sum of the reassemblyBytes of the streams.
+  uint64_t reassemblyBytes_{0};
+
+  // Streams that are opened by the peer on the connection.
+  StreamIdSet openPeerStreams_;
 
-  // Streams that are opened locally on the connection. Ordered by id.
-  std::deque<StreamId> openLocalStreams_;
+  // Streams that are opened locally on the connection.
+  StreamIdSet openLocalStreams_;
 
-  // A map of streams that are active.
-  std::map<StreamId, QuicStreamState> streams_;
+  // A map of streams that are active. This is looked up for every stream frame
+  // that is received or scheduled, so it is hashed rather than ordered. The
+  // nodes are never moved, so pointers to the stream state stay valid until
+  // the stream is removed.
+  std::unordered_map<StreamId, QuicStreamState> streams_;
 
   std::deque<StreamId> newPeerStreams_;
 
@@ -635,8 +843,11 @@ class QuicStreamManager {
   // List of streams that have pending peeks
   std::set<StreamId> peekableStreams_;
 
-  // List of streams that have writable data
-  std::set<StreamId> writableStreams_;
+  // List of streams that have writable data, one set per urgency
+  std::array<WritableStreamSet, kMaxPriorityUrgency + 1> writableStreams_;
+
+  // Streams kept out of writableStreams_ by their send rate.
+  std::set<StreamId> rateLimitedStreams_;
 
   // List of streams that were blocked
   std::unordered_map<StreamId, StreamDataBlockedFrame> blockedStreams_;
@@ -650,6 +861,9 @@ class QuicStreamManager {
   // List of streams that have rejected data
   std::set<StreamId> dataRejectedStreams_;
 
+  // Streams that have data written with a deadline
+  std::set<StreamId> deadlineStreams_;
+
   // Streams that may be able to callback DeliveryCallback
   std::set<StreamId> deliverableStreams_;
 
@@ -9,6 +9,9 @@
 #include <quic/state/QuicStreamUtilities.h>
 #include <quic/state/StateData.h>
 
+#include <algorithm>
+#include <limits>
+
 namespace quic {
 
 bool isServerStream(StreamId stream) {
@@ -48,4 +51,70 @@ bool isRemoteStream(QuicNodeType nodeType, StreamId stream) {
   return (nodeType == QuicNodeType::Client && isServerStream(stream)) ||
       (nodeType == QuicNodeType::Server && isClientStream(stream));
 }
+
+namespace {
+constexpr uint64_t kMicrosPerSecond = 1000 * 1000;
+
+uint64_t getStreamSendRateBurst(const QuicStreamState& stream) {
+  uint64_t tickBytes = stream.sendRate *
+      stream.conn.transportSettings.pacingTimerTickInterval.count() /
+      kMicrosPerSecond;
+  return std::max<uint64_t>(stream.conn.udpSendPacketLen, tickBytes);
+}
+} // namespace
+
+uint64_t getStreamSendRateBytesLeft(
+    const QuicStreamState& stream,
+    TimePoint now) {
+  if (stream.sendRate == 0) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  auto burst = getStreamSendRateBurst(stream);
+  if (stream.sendRateTokens >= burst) {
+    return burst;
+  }
+  if (now <= stream.sendRateUpdateTime) {
+    return stream.sendRateTokens;
+  }
+  uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                         now - stream.sendRateUpdateTime)
+                         .count();
+  // Checked first so that the product below cannot overflow.
+  uint64_t fillTime =
+      (burst - stream.sendRateTokens) * kMicrosPerSecond / stream.sendRate;
+  if (elapsed >= fillTime) {
+    return burst;
+  }
+  return stream.sendRateTokens + elapsed * stream.sendRate / kMicrosPerSecond;
+}
+
+void updateStreamSendRate(
+    QuicStreamState& stream,
+    uint64_t bytesWritten,
+    TimePoint now) {
+  if (stream.sendRate == 0) {
+    return;
+  }
+  auto bytesLeft = getStreamSendRateBytesLeft(stream, now);
+  stream.sendRateTokens = bytesLeft - std::min(bytesLeft, bytesWritten);
+  stream.sendRateUpdateTime = now;
+}
+
+std::chrono::microseconds getStreamSendRateDelay(
+    const QuicStreamState& stream,
+    TimePoint now) {
+  if (stream.sendRate == 0) {
+    return std::chrono::microseconds::zero();
+  }
+  uint64_t needed = std::min<uint64_t>(
+      stream.conn.udpSendPacketLen, stream.writeBuffer.chainLength());
+  auto bytesLeft = getStreamSendRateBytesLeft(stream, now);
+  if (bytesLeft >= needed) {
+    return std::chrono::microseconds::zero();
+  }
+  // Rounded up so that the stream can send once the delay is over.
+  return std::chrono::microseconds(
+      ((needed - bytesLeft) * kMicrosPerSecond + stream.sendRate - 1) /
+      stream.sendRate);
+}
 } // namespace quic
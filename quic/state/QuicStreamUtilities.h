@@ -56,4 +56,31 @@ bool isLocalStream(QuicNodeType nodeType, StreamId stream);
  */
 bool isRemoteStream(QuicNodeType nodeType, StreamId stream);
 
+/**
+ * Returns the number of bytes the stream may send at now under its send
+ * rate, the max if it has none. Unused bytes add up to a pacing tick worth
+ * of the rate, and at least a packet.
+ */
+uint64_t getStreamSendRateBytesLeft(
+    const QuicStreamState& stream,
+    TimePoint now);
+
+/**
+ * Charges new stream data written to the socket against the stream's send
+ * rate.
+ */
+void updateStreamSendRate(
+    QuicStreamState& stream,
+    uint64_t bytesWritten,
+    TimePoint now);
+
+/**
+ * Returns how long the stream has to wait before its rate lets it send a
+ * packet, or what it has left to send if that is less. 0 if it can send now,
+ * or has no send rate.
+ */
+std::chrono::microseconds getStreamSendRateDelay(
+    const QuicStreamState& stream,
+    TimePoint now);
+
 } // namespace quic
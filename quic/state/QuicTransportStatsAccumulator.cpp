@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/QuicTransportStatsAccumulator.h>
+
+namespace quic {
+
+namespace {
+
+template <size_t N>
+void mergeCounts(
+    std::array<uint64_t, N>& counts,
+    const std::array<uint64_t, N>& other) {
+  for (size_t i = 0; i < N; ++i) {
+    counts[i] += other[i];
+  }
+}
+
+} // namespace
+
+void QuicTransportStats::merge(const QuicTransportStats& other) {
+  packetsReceived += other.packetsReceived;
+  duplicatedPacketsReceived += other.duplicatedPacketsReceived;
+  outOfOrderPacketsReceived += other.outOfOrderPacketsReceived;
+  packetsProcessed += other.packetsProcessed;
+  packetsSent += other.packetsSent;
+  packetRetransmissions += other.packetRetransmissions;
+  mergeCounts(packetsDropped, other.packetsDropped);
+  packetsForwarded += other.packetsForwarded;
+  forwardedPacketsReceived += other.forwardedPacketsReceived;
+  forwardedPacketsProcessed += other.forwardedPacketsProcessed;
+  newConnections += other.newConnections;
+  connectionsClosed += other.connectionsClosed;
+  mergeCounts(connectionCloseReasons, other.connectionCloseReasons);
+  newStreams += other.newStreams;
+  streamsClosed += other.streamsClosed;
+  streamsReset += other.streamsReset;
+  streamHolbTime.merge(other.streamHolbTime);
+  streamReadGaps += other.streamReadGaps;
+  maxStreamReassemblyBytes =
+      std::max(maxStreamReassemblyBytes, other.maxStreamReassemblyBytes);
+  connFlowControlUpdates += other.connFlowControlUpdates;
+  connFlowControlBlocked += other.connFlowControlBlocked;
+  streamFlowControlUpdates += other.streamFlowControlUpdates;
+  streamFlowControlBlocked += other.streamFlowControlBlocked;
+  cwndBlocked += other.cwndBlocked;
+  ptos += other.ptos;
+  statelessResets += other.statelessResets;
+  ackRangesPruned += other.ackRangesPruned;
+  bytesRead += other.bytesRead;
+  bytesWritten += other.bytesWritten;
+  handshakeDuration.merge(other.handshakeDuration);
+  srtt.merge(other.srtt);
+  minRtt.merge(other.minRtt);
+  latencies.merge(other.latencies);
+  for (size_t i = 0; i < kNumWriteLimiters; ++i) {
+    writeLimitedTime[i] += other.writeLimitedTime[i];
+  }
+}
+
+void QuicTransportStatsAccumulator::onPacketDropped(PacketDropReason reason) {
+  auto index = static_cast<size_t>(reason);
+  if (index < stats_.packetsDropped.size()) {
+    stats_.packetsDropped[index]++;
+  }
+}
+
+void QuicTransportStatsAccumulator::onConnectionClose(
+    folly::Optional<ConnectionCloseReason> reason) {
+  stats_.connectionsClosed++;
+  if (reason) {
+    auto index = static_cast<size_t>(*reason);
+    if (index < stats_.connectionCloseReasons.size()) {
+      stats_.connectionCloseReasons[index]++;
+    }
+  }
+}
+
+void QuicTransportStatsAccumulator::onConnectionLatencies(
+    const ConnectionLatencies& latencies) {
+  stats_.latencies.merge(latencies);
+}
+
+void QuicTransportStatsAccumulator::onWriteLimitedTime(
+    WriteLimiter limiter,
+    std::chrono::microseconds duration) {
+  auto index = static_cast<size_t>(limiter);
+  if (index < stats_.writeLimitedTime.size()) {
+    stats_.writeLimitedTime[index] += duration;
+  }
+}
+
+} // namespace quic
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/QuicTransportStatsCallback.h>
+
+namespace quic {
+
+/**
+ * Transport stats accumulated by QuicTransportStatsAccumulator, merged across
+ * workers by QuicServer::getTransportStats.
+ */
+struct QuicTransportStats {
+  using PacketDropReason = QuicTransportStatsCallback::PacketDropReason;
+  using ConnectionCloseReason =
+      QuicTransportStatsCallback::ConnectionCloseReason;
+
+  uint64_t packetsReceived{0};
+  uint64_t duplicatedPacketsReceived{0};
+  uint64_t outOfOrderPacketsReceived{0};
+  uint64_t packetsProcessed{0};
+  uint64_t packetsSent{0};
+  uint64_t packetRetransmissions{0};
+  // Indexed by PacketDropReason.
+  std::array<uint64_t, static_cast<size_t>(PacketDropReason::MAX)>
+      packetsDropped{};
+  uint64_t packetsForwarded{0};
+  uint64_t forwardedPacketsReceived{0};
+  uint64_t forwardedPacketsProcessed{0};
+
+  uint64_t newConnections{0};
+  uint64_t connectionsClosed{0};
+  // Closes that came with a reason, indexed by ConnectionCloseReason.
+  std::array<uint64_t, static_cast<size_t>(ConnectionCloseReason::MAX)>
+      connectionCloseReasons{};
+
+  uint64_t newStreams{0};
+  uint64_t streamsClosed{0};
+  uint64_t streamsReset{0};
+  // Of the streams closed after receiving data.
+  LatencyHistogram streamHolbTime;
+  uint64_t streamReadGaps{0};
+  uint64_t maxStreamReassemblyBytes{0};
+
+  uint64_t connFlowControlUpdates{0};
+  uint64_t connFlowControlBlocked{0};
+  uint64_t streamFlowControlUpdates{0};
+  uint64_t streamFlowControlBlocked{0};
+  uint64_t cwndBlocked{0};
+  uint64_t ptos{0};
+  uint64_t statelessResets{0};
+  uint64_t ackRangesPruned{0};
+
+  uint64_t bytesRead{0};
+  uint64_t bytesWritten{0};
+
+  LatencyHistogram handshakeDuration;
+  LatencyHistogram srtt;
+  LatencyHistogram minRtt;
+  ConnectionLatencies latencies;
+  // Indexed by WriteLimiter.
+  std::array<std::chrono::microseconds, kNumWriteLimiters> writeLimitedTime{};
+
+  void merge(const QuicTransportStats& other);
+};
+
+/**
+ * QuicTransportStatsCallback accumulating the stats of a single worker in
+ * plain counters, without atomics or locks. It must only be used from the
+ * worker's thread, including getStats, so that reading the stats of all the
+ * workers means running on each of their event bases, as
+ * QuicServer::getTransportStats does.
+ */
+class QuicTransportStatsAccumulator : public QuicTransportStatsCallback {
+ public:
+  ~QuicTransportStatsAccumulator() override = default;
+
+  const QuicTransportStats& getStats() const {
+    return stats_;
+  }
+
+  void resetStats() {
+    stats_ = QuicTransportStats();
+  }
+
+  void onPacketReceived() override {
+    stats_.packetsReceived++;
+  }
+
+  void onDuplicatedPacketReceived() override {
+    stats_.duplicatedPacketsReceived++;
+  }
+
+  void onOutOfOrderPacketReceived() override {
+    stats_.outOfOrderPacketsReceived++;
+  }
+
+  void onPacketProcessed() override {
+    stats_.packetsProcessed++;
+  }
+
+  void onPacketSent() override {
+    stats_.packetsSent++;
+  }
+
+  void onPacketRetransmission() override {
+    stats_.packetRetransmissions++;
+  }
+
+  void onPacketDropped(PacketDropReason reason) override;
+
+  void onPacketForwarded() override {
+    stats_.packetsForwarded++;
+  }
+
+  void onForwardedPacketReceived() override {
+    stats_.forwardedPacketsReceived++;
+  }
+
+  void onForwardedPacketProcessed() override {
+    stats_.forwardedPacketsProcessed++;
+  }
+
+  void onNewConnection() override {
+    stats_.newConnections++;
+  }
+
+  void onConnectionClose(
+      folly::Optional<ConnectionCloseReason> reason = folly::none) override;
+
+  void onHandshakeDuration(std::chrono::microseconds duration) override {
+    stats_.handshakeDuration.add(duration);
+  }
+
+  void onConnectionRtt(
+      std::chrono::microseconds srtt,
+      std::chrono::microseconds minRtt) override {
+    stats_.srtt.add(srtt);
+    stats_.minRtt.add(minRtt);
+  }
+
+  void onConnectionLatencies(const ConnectionLatencies& latencies) override;
+
+  void onWriteLimitedTime(
+      WriteLimiter limiter,
+      std::chrono::microseconds duration) override;
+
+  void onNewQuicStream() override {
+    stats_.newStreams++;
+  }
+
+  void onQuicStreamClosed() override {
+    stats_.streamsClosed++;
+  }
+
+  void onQuicStreamReset() override {
+    stats_.streamsReset++;
+  }
+
+  void onStreamReassembly(
+      std::chrono::microseconds holbTime,
+      uint32_t gaps,
+      uint64_t maxReassemblyBytes) override {
+    stats_.streamHolbTime.add(holbTime);
+    stats_.streamReadGaps += gaps;
+    stats_.maxStreamReassemblyBytes =
+        std::max(stats_.maxStreamReassemblyBytes, maxReassemblyBytes);
+  }
+
+  void onConnFlowControlUpdate() override {
+    stats_.connFlowControlUpdates++;
+  }
+
+  void onConnFlowControlBlocked() override {
+    stats_.connFlowControlBlocked++;
+  }
+
+  void onStreamFlowControlUpdate() override {
+    stats_.streamFlowControlUpdates++;
+  }
+
+  void onStreamFlowControlBlocked() override {
+    stats_.streamFlowControlBlocked++;
+  }
+
+  void onCwndBlocked() override {
+    stats_.cwndBlocked++;
+  }
+
+  void onPTO() override {
+    stats_.ptos++;
+  }
+
+  void onStatelessReset() override {
+    stats_.statelessResets++;
+  }
+
+  void onAckRangesPruned(uint64_t numRanges) override {
+    stats_.ackRangesPruned += numRanges;
+  }
+
+  void onRead(size_t bufSize) override {
+    stats_.bytesRead += bufSize;
+  }
+
+  void onWrite(size_t bufSize) override {
+    stats_.bytesWritten += bufSize;
+  }
+
+ private:
+  QuicTransportStats stats_;
+};
+
+class QuicTransportStatsAccumulatorFactory
+    : public QuicTransportStatsCallbackFactory {
+ public:
+  ~QuicTransportStatsAccumulatorFactory() override = default;
+
+  std::unique_ptr<QuicTransportStatsCallback> make(
+      folly::EventBase* /* evb */) override {
+    return std::make_unique<QuicTransportStatsAccumulator>();
+  }
+};
+
+} // namespace quic
@@ -11,10 +11,72 @@
 #include <folly/Optional.h>
 #include <folly/functional/Invoke.h>
 #include <folly/io/async/EventBase.h>
+#include <folly/lang/Bits.h>
+#include <quic/QuicConstants.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <string>
 
 namespace quic {
 
+/**
+ * Histogram of latencies in power of two buckets: bucket i counts the
+ * samples in [2^(i-1), 2^i) microseconds, bucket 0 the ones under a
+ * microsecond and the last bucket everything above. Adding a sample is a few
+ * instructions, so that the transport can keep one per connection.
+ */
+struct LatencyHistogram {
+  static constexpr size_t kNumBuckets = 24;
+
+  std::array<uint32_t, kNumBuckets> buckets{};
+  uint64_t count{0};
+  std::chrono::microseconds sum{0};
+  std::chrono::microseconds max{0};
+
+  void add(std::chrono::microseconds latency) {
+    latency = std::max(latency, std::chrono::microseconds::zero());
+    auto bucket = std::min<size_t>(
+        folly::findLastSet(static_cast<uint64_t>(latency.count())),
+        kNumBuckets - 1);
+    buckets[bucket]++;
+    count++;
+    sum += latency;
+    max = std::max(max, latency);
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+  }
+};
+
+/**
+ * Latencies a connection samples over its lifetime, delivered at close.
+ */
+struct ConnectionLatencies {
+  // From the creation of a locally initiated bidirectional stream to the
+  // first byte received on it.
+  LatencyHistogram streamTimeToFirstByte;
+  // Time spent processing the packets of a single read from the socket.
+  LatencyHistogram readLoop;
+  // Time spent in a single write loop.
+  LatencyHistogram writeLoop;
+  // From the receipt of the largest acknowledged packet to the ACK frame.
+  LatencyHistogram ackDelay;
+
+  void merge(const ConnectionLatencies& other) {
+    streamTimeToFirstByte.merge(other.streamTimeToFirstByte);
+    readLoop.merge(other.readLoop);
+    writeLoop.merge(other.writeLoop);
+    ackDelay.merge(other.ackDelay);
+  }
+};
+
 /* Interface for Transport level stats per VIP (server)
  * Quic Transport expects applications to instantiate this per thread (and
  * do necessary aggregation at the application level).
@@ -39,6 +101,11 @@ class QuicTransportStatsCallback {
     WORKER_NOT_INITIALIZED,
     SERVER_SHUTDOWN,
     INITIAL_CONNID_SMALL,
+    INVALID_RETRY_TOKEN,
+    INITIAL_RATE_LIMITED,
+    NEW_CONNECTION_RATE_LIMITED,
+    STATELESS_RESPONSE_RATE_LIMITED,
+    REASSEMBLY_BUDGET_EXCEEDED,
     // NOTE: MAX should always be at the end
     MAX
   };
@@ -80,6 +147,24 @@ class QuicTransportStatsCallback {
   virtual void onConnectionClose(
       folly::Optional<ConnectionCloseReason> reason = folly::none) = 0;
 
+  // time from the creation of the connection to the end of the handshake,
+  // once per connection
+  virtual void onHandshakeDuration(std::chrono::microseconds duration) = 0;
+
+  // smoothed and min rtt of a closing connection that had an rtt sample
+  virtual void onConnectionRtt(
+      std::chrono::microseconds srtt,
+      std::chrono::microseconds minRtt) = 0;
+
+  // latencies sampled by a closing connection
+  virtual void onConnectionLatencies(
+      const ConnectionLatencies& latencies) = 0;
+
+  // time a closing connection spent limited by limiter
+  virtual void onWriteLimitedTime(
+      WriteLimiter limiter,
+      std::chrono::microseconds duration) = 0;
+
   // stream level metrics
   virtual void onNewQuicStream() = 0;
 
@@ -87,6 +172,13 @@ class QuicTransportStatsCallback {
 
   virtual void onQuicStreamReset() = 0;
 
+  // When a stream that received data is closed: the time it was head of line
+  // blocked, the gaps opened in its data and the most bytes reassembly held.
+  virtual void onStreamReassembly(
+      std::chrono::microseconds holbTime,
+      uint32_t gaps,
+      uint64_t maxReassemblyBytes) = 0;
+
   // flow control / congestion control / loss recovery related metrics
   virtual void onConnFlowControlUpdate() = 0;
 
@@ -101,6 +193,12 @@ class QuicTransportStatsCallback {
   // retransmission timeout counter
   virtual void onPTO() = 0;
 
+  // stateless reset received from the peer
+  virtual void onStatelessReset() = 0;
+
+  // number of received ACK ranges dropped by the range limit or by aging
+  virtual void onAckRangesPruned(uint64_t numRanges) = 0;
+
   // metrics to track bytes read from / written to wire
   virtual void onRead(size_t bufSize) = 0;
 
@@ -149,6 +247,16 @@ class QuicTransportStatsCallback {
         return "SERVER_SHUTDOWN";
       case PacketDropReason::INITIAL_CONNID_SMALL:
         return "INITIAL_CONNID_SMALL";
+      case PacketDropReason::INVALID_RETRY_TOKEN:
+        return "INVALID_RETRY_TOKEN";
+      case PacketDropReason::INITIAL_RATE_LIMITED:
+        return "INITIAL_RATE_LIMITED";
+      case PacketDropReason::NEW_CONNECTION_RATE_LIMITED:
+        return "NEW_CONNECTION_RATE_LIMITED";
+      case PacketDropReason::STATELESS_RESPONSE_RATE_LIMITED:
+        return "STATELESS_RESPONSE_RATE_LIMITED";
+      case PacketDropReason::REASSEMBLY_BUDGET_EXCEEDED:
+        return "REASSEMBLY_BUDGET_EXCEEDED";
       case PacketDropReason::MAX:
         return "MAX";
       default:
@@ -9,9 +9,24 @@
 #include "SimpleFrameFunctions.h"
 
 #include <boost/variant/get.hpp>
+#include <quic/state/QuicFecFunctions.h>
 #include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
 
+namespace {
+// Whether the peer retired the connection id of frame, which makes sending it
+// again pointless. Ids the connection doesn't keep track of are never retired.
+bool connectionIdRetired(
+    const quic::QuicConnectionStateBase& conn,
+    const quic::NewConnectionIdFrame& frame) {
+  const auto& ids = conn.selfConnectionIds;
+  return !ids.empty() &&
+      std::none_of(ids.begin(), ids.end(), [&](const auto& selfConnId) {
+           return selfConnId.sequence == frame.sequence;
+         });
+}
+} // namespace
+
 namespace quic {
 void sendSimpleFrame(QuicConnectionStateBase& conn, QuicSimpleFrame frame) {
   conn.pendingEvents.frames.emplace_back(std::move(frame));
@@ -62,7 +77,26 @@ folly::Optional<QuicSimpleFrame> updateSimpleFrameOnPacketClone(
       },
       [&](const NewConnectionIdFrame& frame)
           -> folly::Optional<QuicSimpleFrame> {
+        if (connectionIdRetired(conn, frame)) {
+          return folly::none;
+        }
+        return QuicSimpleFrame(frame);
+      },
+      [&](const RetireConnectionIdFrame& frame)
+          -> folly::Optional<QuicSimpleFrame> {
+        return QuicSimpleFrame(frame);
+      },
+      [&](const AckFrequencyFrame& frame) -> folly::Optional<QuicSimpleFrame> {
+        // Only the latest request matters to the peer
+        const auto& latest = conn.ackFrequencyState.latestRequest;
+        if (!latest || latest->sequenceNumber != frame.sequenceNumber) {
+          return folly::none;
+        }
         return QuicSimpleFrame(frame);
+      },
+      [&](const FecRepairFrame&) -> folly::Optional<QuicSimpleFrame> {
+        // The source frames it covers are retransmitted if lost
+        return folly::none;
       });
 }
 
@@ -123,7 +157,21 @@ void updateSimpleFrameOnPacketLoss(
         // Do not retransmit PATH_RESPONSE to avoid buffering
       },
       [&](const NewConnectionIdFrame& frame) {
+        if (!connectionIdRetired(conn, frame)) {
+          conn.pendingEvents.frames.push_back(frame);
+        }
+      },
+      [&](const RetireConnectionIdFrame& frame) {
         conn.pendingEvents.frames.push_back(frame);
+      },
+      [&](const AckFrequencyFrame& frame) {
+        const auto& latest = conn.ackFrequencyState.latestRequest;
+        if (latest && latest->sequenceNumber == frame.sequenceNumber) {
+          conn.pendingEvents.frames.push_back(frame);
+        }
+      },
+      [&](const FecRepairFrame&) {
+        // The source frames it covers are retransmitted if lost
       });
 }
 
@@ -173,9 +221,57 @@ bool updateSimpleFrameOnPacketReceived(
         conn.writableBytesLimit = folly::none;
         return false;
       },
-      [&](const NewConnectionIdFrame&) {
-        // TODO junqiw
+      [&](const NewConnectionIdFrame& frame) {
+        const auto& currentConnId = conn.nodeType == QuicNodeType::Server
+            ? conn.clientConnectionId
+            : conn.serverConnectionId;
+        auto& peerConnectionIds = conn.peerConnectionIds;
+        bool known = (currentConnId && *currentConnId == frame.connectionId) ||
+            std::any_of(
+                peerConnectionIds.begin(),
+                peerConnectionIds.end(),
+                [&](const NewConnectionIdFrame& connId) {
+                  return connId.sequence == frame.sequence ||
+                      connId.connectionId == frame.connectionId;
+                });
+        // Retransmissions are ignored, and so are ids past the limit.
+        if (!known && peerConnectionIds.size() < kMaxPeerConnectionIds) {
+          peerConnectionIds.push_back(frame);
+        }
         return false;
+      },
+      [&](const RetireConnectionIdFrame& frame) {
+        if (frame.sequenceId >= conn.nextSelfConnectionIdSequence) {
+          throw QuicTransportException(
+              "RETIRE_CONNECTION_ID of an id never issued",
+              TransportErrorCode::PROTOCOL_VIOLATION,
+              FrameType::RETIRE_CONNECTION_ID);
+        }
+        auto& ids = conn.selfConnectionIds;
+        auto it = std::find_if(ids.begin(), ids.end(), [&](const auto& id) {
+          return id.sequence == frame.sequenceId;
+        });
+        // Retransmissions are ignored.
+        if (it != ids.end()) {
+          conn.retiredSelfConnectionIds.push_back(it->connId);
+          ids.erase(it);
+        }
+        return false;
+      },
+      [&](const AckFrequencyFrame& frame) {
+        handleAckFrequency(conn, frame);
+        return true;
+      },
+      [&](const FecRepairFrame& frame) {
+        auto recovered = fecRecoverStreamFrame(conn, frame);
+        if (recovered) {
+          auto stream = conn.streamManager->getStream(recovered->streamId);
+          if (stream) {
+            invokeStreamReceiveStateMachine(
+                conn, *stream, std::move(*recovered));
+          }
+        }
+        return true;
       });
 }
 
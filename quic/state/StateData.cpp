@@ -7,6 +7,7 @@
  */
 
 #include <quic/state/StateData.h>
+#include <quic/common/LoopClock.h>
 #include <quic/state/QuicStreamUtilities.h>
 
 namespace quic {
@@ -38,6 +39,8 @@ QuicStreamState::QuicStreamState(StreamId idIn, QuicConnectionStateBase& connIn)
     } else {
       send.state = StreamSendStates::Invalid();
     }
+  } else if (conn.infoCallback && isLocalStream(connIn.nodeType, idIn)) {
+    awaitingFirstByteSince = loopClockNow(connIn);
   }
 }
 
@@ -56,6 +59,14 @@ std::ostream& operator<<(std::ostream& os, const QuicConnectionStateBase& st) {
   return os;
 }
 
+TimePoint loopClockNow(const QuicConnectionStateBase& conn) {
+  return conn.loopClock ? conn.loopClock->now() : Clock::now();
+}
+
+TimePoint preciseLoopClockNow(const QuicConnectionStateBase& conn) {
+  return conn.loopClock ? conn.loopClock->preciseNow() : Clock::now();
+}
+
 AckStateVersion::AckStateVersion(
     uint64_t initialVersion,
     uint64_t handshakeVersion,
@@ -13,12 +13,15 @@
 #include <folly/io/IOBufQueue.h>
 #include <folly/io/async/AsyncUDPSocket.h>
 #include <folly/io/async/HHWheelTimer.h>
+#include <folly/sorted_vector_types.h>
 #include <quic/QuicConstants.h>
 #include <quic/codec/ConnectionIdAlgo.h>
 #include <quic/codec/QuicReadCodec.h>
 #include <quic/codec/QuicWriteCodec.h>
 #include <quic/codec/Types.h>
+#include <quic/common/BlockRecycler.h>
 #include <quic/handshake/HandshakeLayer.h>
+#include <quic/logging/PacketCapture.h>
 #include <quic/logging/QLogger.h>
 #include <quic/state/AckStates.h>
 #include <quic/state/QuicStreamManager.h>
@@ -26,23 +29,34 @@
 #include <quic/state/StateMachine.h>
 #include <quic/state/StreamData.h>
 #include <quic/state/TransportSettings.h>
+#include <array>
 #include <chrono>
+#include <deque>
 #include <list>
 #include <map>
 #include <numeric>
 #include <queue>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 namespace quic {
 
 struct NetworkData {
   Buf data;
   TimePoint receiveTimePoint;
+  // ECN codepoint of the datagram, NotECT unless the socket reports it.
+  ECNCodepoint ecn{ECNCodepoint::NotECT};
+  // Further datagrams read in the same batch as data, with the same receive
+  // time and ECN codepoint. Each of them is parsed as a datagram of its own.
+  std::vector<Buf> batch;
 
   NetworkData() = default;
-  NetworkData(Buf&& buf, const TimePoint& receiveTime)
-      : data(std::move(buf)), receiveTimePoint(receiveTime) {}
+  NetworkData(
+      Buf&& buf,
+      const TimePoint& receiveTime,
+      ECNCodepoint ecnIn = ECNCodepoint::NotECT)
+      : data(std::move(buf)), receiveTimePoint(receiveTime), ecn(ecnIn) {}
 };
 
 /**
@@ -63,53 +77,36 @@ struct NetworkData {
 using PacketEvent = PacketNum;
 
 struct OutstandingPacket {
-  // Structure representing the frames that are outstanding including the header
-  // that was sent.
-  RegularQuicWritePacket packet;
+  // The fields that ack and loss processing read for every packet come first
+  // and the flags are packed together, so that they share a cache line instead
+  // of being spread around the frames. The delivery state the bandwidth
+  // sampler measures a packet against is kept by the sampler, per ack.
+
   // Time that the packet was sent.
   TimePoint time;
+  // Total sent bytes on this connection including this packet itself when this
+  // packet is sent.
+  uint64_t totalBytesSent;
   // Size of the packet sent on the wire.
   uint32_t encodedSize;
   // Whether this packet has any data from stream 0
   bool isHandshake;
   // Whether this packet is pure ack
   bool pureAck;
-  // Total sent bytes on this connection including this packet itself when this
-  // packet is sent.
-  uint64_t totalBytesSent;
-  // Information regarding the last acked packet on this connection when this
-  // packet is sent.
-  struct LastAckedPacketInfo {
-    TimePoint sentTime;
-    TimePoint ackTime;
-    // Total sent bytes on this connection when the last acked packet is acked.
-    uint64_t totalBytesSent;
-    // Total acked bytes on this connection when last acked packet is acked,
-    // including the last acked packet.
-    uint64_t totalBytesAcked;
-
-    LastAckedPacketInfo(
-        TimePoint sentTimeIn,
-        TimePoint ackTimeIn,
-        uint64_t totalBytesSentIn,
-        uint64_t totalBytesAckedIn)
-        : sentTime(sentTimeIn),
-          ackTime(ackTimeIn),
-          totalBytesSent(totalBytesSentIn),
-          totalBytesAcked(totalBytesAckedIn) {}
-  };
-  folly::Optional<LastAckedPacketInfo> lastAckedPacketInfo;
-
-  // PacketEvent associated with this OutstandingPacket. This will be a
-  // folly::none if the packet isn't a clone and hasn't been cloned.
-  folly::Optional<PacketEvent> associatedEvent;
-
   /**
    * Whether the packet is sent when congestion controller is in app-limited
    * state.
    */
   bool isAppLimited{false};
 
+  // PacketEvent associated with this OutstandingPacket. This will be a
+  // folly::none if the packet isn't a clone and hasn't been cloned.
+  folly::Optional<PacketEvent> associatedEvent;
+
+  // Structure representing the frames that are outstanding including the header
+  // that was sent.
+  RegularQuicWritePacket packet;
+
   OutstandingPacket(
       RegularQuicWritePacket packetIn,
       TimePoint timeIn,
@@ -117,12 +114,12 @@ struct OutstandingPacket {
       bool isHandshakeIn,
       bool pureAckIn,
       uint64_t totalBytesSentIn)
-      : packet(std::move(packetIn)),
-        time(std::move(timeIn)),
+      : time(std::move(timeIn)),
+        totalBytesSent(totalBytesSentIn),
         encodedSize(encodedSizeIn),
         isHandshake(isHandshakeIn),
         pureAck(pureAckIn),
-        totalBytesSent(totalBytesSentIn) {}
+        packet(std::move(packetIn)) {}
 };
 
 struct CongestionController {
@@ -140,6 +137,14 @@ struct CongestionController {
     folly::Optional<TimePoint> smallestLostSentTime;
     // Whether this LossEvent also indicates persistent congestion
     bool persistentCongestion;
+    // The longest period between the sent times of two lost packets with no
+    // packet acked in between, for the persistent congestion. It is tracked
+    // over runs of consecutive packet numbers as packets are added in the
+    // order they were sent, so that no list of the lost packets is needed.
+    std::chrono::microseconds longestLostPeriod{0us};
+    // The current run of consecutive lost packet numbers.
+    folly::Optional<TimePoint> lostPeriodStart;
+    folly::Optional<PacketNum> lostPeriodLastPacketNum;
 
     explicit LossEvent(TimePoint time = Clock::now())
         : lostBytes(0),
@@ -166,6 +171,29 @@ struct CongestionController {
           std::max(packet.time, largestLostSentTime.value_or(packet.time));
       smallestLostSentTime =
           std::min(packet.time, smallestLostSentTime.value_or(packet.time));
+      if (!lostPeriodLastPacketNum ||
+          packetNum != *lostPeriodLastPacketNum + 1) {
+        lostPeriodStart = packet.time;
+      }
+      lostPeriodLastPacketNum = packetNum;
+      longestLostPeriod = std::max(
+          longestLostPeriod,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              packet.time - *lostPeriodStart));
+    }
+
+    /**
+     * A lost packet that doesn't count in the event, like a pure ack. It
+     * doesn't end the current lost period, but doesn't start one either.
+     */
+    void skipLostPacket(PacketNum packetNum) {
+      if (lostPeriodLastPacketNum &&
+          packetNum == *lostPeriodLastPacketNum + 1) {
+        lostPeriodLastPacketNum = packetNum;
+      } else {
+        lostPeriodStart.clear();
+        lostPeriodLastPacketNum.clear();
+      }
     }
   };
 
@@ -184,6 +212,10 @@ struct CongestionController {
 
     // OutstandingPackets acked in this ack event
     std::vector<OutstandingPacket> ackedPackets;
+
+    // Number of packets that the ACK_ECN frame of this ack event newly
+    // reports as CE marked.
+    uint64_t ecnCeCount{0};
   };
 
   virtual ~CongestionController() = default;
@@ -256,6 +288,67 @@ struct CongestionController {
    * state.
    */
   virtual bool isAppLimited() const = 0;
+
+  /**
+   * Whether the congestion controller is still growing its window
+   * exponentially, i.e. slow start, startup or hystart depending on the
+   * algorithm.
+   */
+  virtual bool inSlowStart() const = 0;
+
+  /**
+   * Careful resume from savedCwndBytes, the cwnd of an earlier connection on
+   * the same path, see CarefulResume. Returns whether the cwnd jumped.
+   * Controllers without support for it, or past slow start, ignore it.
+   */
+  virtual bool carefulResume(
+      uint64_t /* savedCwndBytes */,
+      TimePoint /* now */) {
+    return false;
+  }
+
+  /**
+   * A packet declared lost in the LossEvent of lossTime got acked after all.
+   * Controllers that can undo their response to a loss do it once all the
+   * packets lost since their window reduction were spurious, see LossUndo.
+   */
+  virtual void onSpuriousLoss(TimePoint /* lossTime */) {}
+};
+
+/**
+ * Paces the writes of a connection at the rate its congestion controller
+ * targets. Congestion controllers only report their target, the pacer decides
+ * when the transport writes and how much.
+ */
+struct Pacer {
+  virtual ~Pacer() = default;
+
+  /**
+   * Sets the target rate to cwndBytes per rtt. Congestion controllers call
+   * this whenever their target changes.
+   */
+  virtual void refreshPacingRate(
+      uint64_t cwndBytes,
+      std::chrono::microseconds rtt) = 0;
+
+  // Smallest interval between two writes, the tick of the pacing timer.
+  virtual void setMinimalInterval(std::chrono::microseconds interval) = 0;
+
+  /**
+   * Time until the next paced write. 0 means the connection cannot be paced
+   * at the current rate, and writes as if pacing was off.
+   */
+  virtual std::chrono::microseconds getTimeUntilNextWrite(
+      TimePoint currentTime) const = 0;
+
+  // Number of packets the connection can write at currentTime.
+  virtual uint64_t updateAndGetWriteBatchSize(TimePoint currentTime) = 0;
+
+  virtual void onPacketSent() = 0;
+
+  // Interval between two bursts and the size of a burst at the target rate.
+  virtual std::chrono::microseconds getPacingInterval() const = 0;
+  virtual uint64_t getPacingBurstSize() const = 0;
 };
 
 struct QuicCryptoStream : public QuicStreamLike {
@@ -263,6 +356,15 @@ struct QuicCryptoStream : public QuicStreamLike {
 };
 
 struct QuicCryptoState {
+  // Recycled with the rest of the connection, see BlockRecycler.
+  static void* operator new(size_t size) {
+    return BlockRecycler::allocate(size);
+  }
+
+  static void operator delete(void* p, size_t size) noexcept {
+    BlockRecycler::deallocate(p, size);
+  }
+
   // Stream to exchange the initial cryptographic material.
   QuicCryptoStream initialStream;
 
@@ -313,6 +415,29 @@ struct LossState {
   PacketNum largestSent{0};
   // Reordering threshold used
   uint32_t reorderingThreshold{kReorderingThreshold};
+  // Time threshold of the loss detection, in eighths of the rtt.
+  uint32_t timeReorderingThreshold{kTimeReorderingThreshold};
+  // A packet declared lost, remembered so that an ack of it later is detected
+  // as a spurious loss. Only with
+  // TransportSettings::spuriousLossDetectionEnabled.
+  struct LostPacket {
+    PacketNum packetNum;
+    PacketNumberSpace pnSpace;
+    // lossTime of the LossEvent the packet was in.
+    TimePoint lossTime;
+    // The largest acked packet when it was declared lost.
+    PacketNum largestAcked;
+    // Which of the reordering thresholds it exceeded.
+    bool lostByTime;
+    bool lostByReordering;
+  };
+  // In the order they were declared lost.
+  std::deque<LostPacket> lostPackets;
+  // Number of lost packets acked later.
+  uint32_t spuriousLossCount{0};
+  // Loss events since the last spurious loss, adapted thresholds go back to
+  // their defaults after kReorderingThresholdResetLossEvents.
+  uint32_t lossEventsSinceSpuriousLoss{0};
   // Timer for time reordering detection or early retransmit alarm.
   folly::Optional<TimePoint> initialLossTime, handshakeLossTime,
       appDataLossTime;
@@ -356,9 +481,34 @@ struct LossState {
   TimePoint lastRetransmittablePacketSentTime;
 };
 
+// Congestion state and rtt stats of a path the connection moved away from.
+struct CongestionAndRttState {
+  // The corresponding peer address
+  folly::SocketAddress peerAddress;
+
+  // Time when this state is recorded, i.e. when the path stops being used
+  TimePoint recordTime;
+
+  // Congestion controller
+  std::unique_ptr<CongestionController> congestionController;
+
+  // Smooth rtt
+  std::chrono::microseconds srtt;
+  // Latest rtt
+  std::chrono::microseconds lrtt;
+  // Rtt var
+  std::chrono::microseconds rttvar;
+};
+
 class Logger;
 class CongestionControllerFactory;
 class LoopDetectorCallback;
+class SharedPacketBatch;
+class ZeroCopySendTracker;
+class KernelPacer;
+class ReceiveWindowBudget;
+class LoopClock;
+class BufferArena;
 
 struct QuicConnectionStateBase {
   virtual ~QuicConnectionStateBase() = default;
@@ -377,6 +527,11 @@ struct QuicConnectionStateBase {
   // Connection Congestion controller
   std::unique_ptr<CongestionController> congestionController;
 
+  // Pacer of the connection, only set with
+  // TransportSettings::tokenBucketPacerEnabled. Without it the congestion
+  // controller paces.
+  std::unique_ptr<Pacer> pacer;
+
   // Congestion Controller factory to create specific impl of cc algorithm
   std::shared_ptr<CongestionControllerFactory> congestionControllerFactory;
 
@@ -396,7 +551,10 @@ struct QuicConnectionStateBase {
   // associatedEvent or if it's not in this set, there is no need to process its
   // frames upon ack or loss.
   // TODO: Enforce only AppTraffic packets to be clonable
-  std::set<PacketEvent> outstandingPacketEvents;
+  // Only packets cloned on a PTO have an event, so the set stays small. A
+  // sorted vector reuses its storage instead of allocating a tree node for
+  // every clone.
+  folly::sorted_vector_set<PacketEvent> outstandingPacketEvents;
 
   // Number of pure ack packets outstanding.
   uint64_t outstandingPureAckPacketsCount{0};
@@ -407,6 +565,10 @@ struct QuicConnectionStateBase {
   // Number of packets are clones or cloned.
   uint64_t outstandingClonedPacketsCount{0};
 
+  // Whether the Initial and Handshake packet number spaces were discarded,
+  // see discardHandshakeSpaces.
+  bool handshakeSpacesDiscarded{false};
+
   // The read codec to decrypt and decode packets.
   std::unique_ptr<QuicReadCodec> readCodec;
 
@@ -445,6 +607,25 @@ struct QuicConnectionStateBase {
   // The current server chosen connection id.
   folly::Optional<ConnectionId> serverConnectionId;
 
+  // Connection ids the peer issued with NEW_CONNECTION_ID that are not in use
+  // yet, oldest first. At most kMaxPeerConnectionIds are kept.
+  std::deque<NewConnectionIdFrame> peerConnectionIds;
+
+  // Connection ids issued to the peer that it hasn't retired, with their
+  // sequence numbers. The one of the handshake has sequence number 0.
+  struct SelfConnectionId {
+    uint64_t sequence;
+    ConnectionId connId;
+  };
+  std::vector<SelfConnectionId> selfConnectionIds;
+
+  // Sequence number of the next connection id issued to the peer.
+  uint64_t nextSelfConnectionIdSequence{1};
+
+  // Connection ids the peer retired since the last time the transport removed
+  // them from routing.
+  std::vector<ConnectionId> retiredSelfConnectionIds;
+
   // ConnectionIdAlgo implementation to encode and decode ConnectionId with
   // various info, such as routing related info.
   ConnectionIdAlgo* connIdAlgo{nullptr};
@@ -495,11 +676,19 @@ struct QuicConnectionStateBase {
     // Whether a connection level window update is due to send
     bool connWindowUpdate{false};
 
+    // Whether one of the queued window updates can't wait for the next packet,
+    // see TransportSettings::deferWindowUpdates.
+    bool urgentWindowUpdate{false};
+
     // If there is a pending loss detection alarm update
     bool setLossDetectionAlarm{false};
 
     // Number of probing packets to send after PTO
     uint8_t numProbePackets{0};
+
+    // Whether a PING is due, see TransportSettings::keepaliveInterval. It
+    // goes out with the next packet written.
+    bool sendPing{false};
   };
 
   PendingEvents pendingEvents;
@@ -530,6 +719,11 @@ struct QuicConnectionStateBase {
     uint64_t sumCurStreamBufferLen{0};
     // The packet number in which we got the last largest max data.
     folly::Optional<PacketNum> largestMaxOffsetReceived;
+    // Since when the peer's flow control blocks the connection, if it does.
+    folly::Optional<TimePoint> blockedSince;
+    // Time the connection was blocked by the peer's flow control, not
+    // counting the current blocking.
+    std::chrono::microseconds totalBlockedTime{0us};
     // The following are advertised by the peer, and are set to zero initially
     // so that we cannot send any data until we know the peer values.
     // The initial max stream offset for peer-initiated bidirectional streams.
@@ -540,6 +734,8 @@ struct QuicConnectionStateBase {
     uint64_t peerAdvertisedInitialMaxStreamOffsetUni{0};
     // Time at which the last flow control update was sent by the transport.
     folly::Optional<TimePoint> timeOfLastFlowControlUpdate;
+    // Bytes of window growth reserved from receiveWindowBudget.
+    uint64_t reservedWindowBytes{0};
   };
 
   // Current state of flow control.
@@ -563,7 +759,10 @@ struct QuicConnectionStateBase {
   uint64_t udpSendPacketLen{kDefaultUDPSendPacketLen};
 
   struct PacketSchedulingState {
-    StreamId lastScheduledStream{0};
+    // The stream each urgency level starts writing from. It only moves forward
+    // after an incremental stream was written, so that incremental streams of
+    // the same urgency take turns.
+    std::array<StreamId, kMaxPriorityUrgency + 1> nextScheduledStream{};
   };
 
   PacketSchedulingState schedulingState;
@@ -578,9 +777,67 @@ struct QuicConnectionStateBase {
   // QLogger for this connection
   std::shared_ptr<QLogger> qLogger;
 
+  // Last datagrams of the connection, only set with
+  // TransportSettings::packetCaptureDatagrams.
+  std::unique_ptr<PacketCaptureRing> packetCapture;
+
   // Track stats for various server events
   QuicTransportStatsCallback* infoCallback{nullptr};
 
+  // Latencies sampled while infoCallback is set, delivered to it at close.
+  ConnectionLatencies latencies;
+
+  struct LoopTime {
+    // Event base callbacks into the transport: reads, writes, timers and
+    // loopers.
+    uint64_t callbacks{0};
+    // Time spent in them, extrapolated from the sampled ones, see
+    // TransportSettings::loopTimeSampleRate.
+    std::chrono::microseconds estimated{0};
+  };
+
+  LoopTime loopTime;
+
+  struct WriteLimiterState {
+    WriteLimiter current{WriteLimiter::App};
+    // Since when current limits the writes, none before the first write.
+    folly::Optional<TimePoint> since;
+    // Time spent limited by each WriteLimiter, not counting current.
+    std::array<std::chrono::microseconds, kNumWriteLimiters> time{};
+  };
+
+  WriteLimiterState writeLimiter;
+
+  // Batch shared with the other connections of the same server worker. When
+  // set, packets are queued to it instead of being written to the socket
+  // directly.
+  SharedPacketBatch* sharedPacketBatch{nullptr};
+
+  // Long header packets already written but not sent yet, so that the packets
+  // written next can share their datagram, see
+  // TransportSettings::coalescePackets.
+  Buf coalescedPackets;
+
+  // Zero copy state of the connection's socket, set when GSO batches can be
+  // sent with MSG_ZEROCOPY.
+  ZeroCopySendTracker* zeroCopySendTracker{nullptr};
+
+  // Kernel pacing state of the connection's socket, set when pacing is
+  // offloaded to the kernel.
+  KernelPacer* kernelPacer{nullptr};
+
+  // Budget of the receive window growth shared with the other connections of
+  // the same server worker, see TransportSettings::autotuneReceiveWindow.
+  ReceiveWindowBudget* receiveWindowBudget{nullptr};
+
+  // Time of the current event base loop iteration, shared with the other
+  // connections on the same event base. Read with loopClockNow.
+  LoopClock* loopClock{nullptr};
+
+  // Where contiguous packet buffers are allocated from, shared with the other
+  // connections of the same server worker.
+  BufferArena* bufferArena{nullptr};
+
   struct HappyEyeballsState {
     // Delay timer
     folly::HHWheelTimer::Callback* connAttemptDelayTimeout{nullptr};
@@ -592,7 +849,8 @@ struct QuicConnectionStateBase {
     folly::SocketAddress v4PeerAddress;
 
     // The address that this socket will try to connect to after connection
-    // attempt delay timeout fires
+    // attempt delay timeout fires. Once finished, the address of the losing
+    // socket, if it's kept as a standby path.
     folly::SocketAddress secondPeerAddress;
 
     // The UDP socket that will be used for the second connection attempt
@@ -618,6 +876,132 @@ struct QuicConnectionStateBase {
   // Whether or not both ends agree to use partial reliability
   bool partialReliabilityEnabled{false};
 
+  struct DatagramState {
+    // Largest DATAGRAM frame the peer accepts, 0 if it doesn't support them.
+    uint64_t maxWriteFrameSize{0};
+    // Datagrams received and not yet read by the app.
+    std::deque<Buf> readBuffer;
+    // Datagrams written by the app and not yet sent. They leave the buffer
+    // once they are in a packet and are never retransmitted.
+    std::deque<Buf> writeBuffer;
+  };
+
+  DatagramState datagramState;
+
+  struct AckFrequencyState {
+    // Smallest max ack delay the peer accepts, none if the peer doesn't
+    // support ACK_FREQUENCY frames.
+    folly::Optional<std::chrono::microseconds> peerMinAckDelay;
+    // Sequence number of the next ACK_FREQUENCY frame we send.
+    uint64_t nextSequenceNumber{0};
+    // The latest ACK_FREQUENCY frame we sent or scheduled. Older ones are
+    // neither cloned nor retransmitted.
+    folly::Optional<AckFrequencyFrame> latestRequest;
+
+    // What the peer asked us to honor in its latest ACK_FREQUENCY frame.
+    folly::Optional<uint64_t> largestRecvdSequenceNumber;
+    uint64_t packetTolerance{kRxPacketsPendingBeforeAckThresh};
+    std::chrono::microseconds maxAckDelay{kMaxAckTimeout};
+    bool ignoreOrder{false};
+  };
+
+  AckFrequencyState ackFrequencyState;
+
+  // Forward error correction of small stream frames, see
+  // quic/state/QuicFecFunctions.h.
+  struct FecState {
+    // Whether both endpoints advertised kFecParameterId.
+    bool enabled{false};
+
+    // Source frames covered by the next repair frame.
+    uint32_t window{kFecMaxWindow};
+    // XOR of the symbols of the source frames sent since the last repair
+    // frame, the packets they were sent in and how many there are.
+    std::vector<uint8_t> repairSymbol;
+    folly::Optional<PacketNum> firstPacketNum;
+    PacketNum lastPacketNum{0};
+    uint64_t numSourceFrames{0};
+    // Packets sent and lost as the window was last adapted.
+    uint64_t numPacketsSent{0};
+    uint64_t numPacketsSentAtAdaptation{0};
+    uint64_t numPacketsLostAtAdaptation{0};
+
+    struct ReceivedSymbol {
+      PacketNum packetNum;
+      std::vector<uint8_t> symbol;
+    };
+    // Symbols of the latest kFecMaxReceivedSymbols source frames received.
+    std::deque<ReceivedSymbol> receivedSymbols;
+    // Number of stream frames recovered from repair frames.
+    uint64_t numRecoveredFrames{0};
+  };
+
+  FecState fecState;
+
+  // Datagram packetization layer path MTU discovery (RFC 8899). Packets
+  // padded to the probed size are sent with a PING, and udpSendPacketLen goes
+  // up to the probed size once the probe is acked. The search is binary
+  // between the largest size known to work and the smallest one known not to.
+  struct PmtuDiscoveryState {
+    bool enabled{false};
+    // udpSendPacketLen the search started from, fallen back to when the path
+    // stops carrying packets of the discovered size.
+    uint64_t basePacketLen{kDefaultUDPSendPacketLen};
+    // Largest size the search may go up to.
+    uint64_t maxPacketLen{kDefaultUDPSendPacketLen};
+    // Largest size known to make it through the path.
+    uint64_t searchLow{kDefaultUDPSendPacketLen};
+    // Smallest size known not to make it through, or one past maxPacketLen.
+    uint64_t searchHigh{kDefaultUDPSendPacketLen};
+    // The probe in flight, at most one is outstanding at a time.
+    folly::Optional<PacketNum> probePacketNum;
+    uint64_t probeSize{0};
+    // Number of probes of the current probe size lost in a row.
+    uint64_t probeLosses{0};
+    // Packets larger than basePacketLen lost since one was last acked.
+    uint64_t largePacketLosses{0};
+    // When to search again after the search completed.
+    folly::Optional<TimePoint> nextSearchTime;
+  };
+
+  PmtuDiscoveryState pmtuDiscoveryState;
+
+  // Set when the ECN counts the peer reports fail validation (RFC 9000
+  // section 13.4.2), either because the peer does not report them or because
+  // the path clears or rewrites the codepoints. The counts are ignored from
+  // then on.
+  bool ecnValidationFailed{false};
+
+  // The AppData ACK frames of the batch being read, see
+  // TransportSettings::batchAckProcessing. Only set while reading a batch of
+  // more than one datagram.
+  struct AckBatch {
+    CongestionController::AckEvent ack;
+    // ACK frames folded into ack so far.
+    uint64_t numAckFrames{0};
+  };
+
+  folly::Optional<AckBatch> ackBatch;
+
+  // What is left of the write budget of the current write, see
+  // TransportSettings::writeLoopTimeBudget. Only set while writing.
+  struct WriteLoopBudget {
+    folly::Optional<TimePoint> deadline;
+    folly::Optional<uint64_t> bytesLeft;
+  };
+
+  WriteLoopBudget writeLoopBudget;
+
+  // Load shedding asked for by an overloaded server, see OverloadLevel.
+  struct OverloadState {
+    // Ask the peer to ack kOverloadAckFrequencyMultiplier times less often.
+    bool reduceAckFrequency{false};
+    // Most packets written at a time, none for no cap.
+    folly::Optional<uint64_t> writePacketsLimit;
+  };
+
+  OverloadState overloadState;
+
   // Debug information. Currently only used to debug busy loop of Transport
   // WriteLooper.
   struct DebugState {
@@ -635,6 +1019,19 @@ struct QuicConnectionStateBase {
 
 std::ostream& operator<<(std::ostream& os, const QuicConnectionStateBase& st);
 
+/**
+ * The time of the current event base loop iteration, or Clock::now() when
+ * the connection has no LoopClock. Meant for the per packet paths, where
+ * reading the clock for every packet costs more than the precision is
+ * worth.
+ */
+TimePoint loopClockNow(const QuicConnectionStateBase& conn);
+
+/**
+ * Reads the clock, and makes it the time of the rest of the iteration.
+ */
+TimePoint preciseLoopClockNow(const QuicConnectionStateBase& conn);
+
 struct AckStateVersion {
   uint64_t initialAckStateVersion{kDefaultIntervalSetVersion};
   uint64_t handshakeAckStateVersion{kDefaultIntervalSetVersion};
@@ -13,7 +13,10 @@
 #include <boost/variant/get.hpp>
 #include <boost/variant/static_visitor.hpp>
 #include <folly/Overload.h>
+#include <cstdint>
 #include <exception>
+#include <initializer_list>
+#include <type_traits>
 
 namespace quic {
 
@@ -37,9 +40,10 @@ namespace quic {
  * 4. Create Events for transitions
  *     struct Event1 {};
  *     struct Event2 {};
- * 5. Add a member to State data which is variant type of all the states.
+ * 5. Add a member to State data which holds one of the states, either an
+ *    EnumState of them or, for states that carry data, a variant of them.
  *    struct StateData {
- *      boost::variant<State1, State2> state;
+ *      EnumState<State1, State2> state;
  *    }
  * 6. Declare the handlers
  *     QUIC_DECLARE_STATE_HANDLER(Machine, State1, Event1, State2);
@@ -58,7 +62,9 @@ namespace quic {
  *
  *     invokeHandler<Machine, Event1>(data, event1);
  *
- * This will invoke the appropriate handler.
+ * This will invoke the appropriate handler. With an EnumState, the handler
+ * is picked from a table of the machine's handlers for the event built at
+ * compile time, indexed by the current state.
  */
 
 template <class S1, class S2>
@@ -74,6 +80,60 @@ struct Or<Condition, Conditions...>
     : std::conditional<Condition::value, std::true_type, Or<Conditions...>>::
           type {};
 
+template <class State, class... States>
+struct StateIndexOf;
+
+template <class State, class... States>
+struct StateIndexOf<State, State, States...>
+    : std::integral_constant<uint8_t, 0> {};
+
+template <class State, class Other, class... States>
+struct StateIndexOf<State, Other, States...>
+    : std::integral_constant<
+          uint8_t,
+          1 + StateIndexOf<State, States...>::value> {};
+
+/**
+ * One of States, which are empty types, stored as its index in States. This
+ * is the enum of the states, generated from their types so that handlers
+ * can still be declared per state type.
+ */
+template <class... States>
+class EnumState {
+ public:
+  static_assert(sizeof...(States) <= 256, "Too many states");
+
+  template <class State>
+  /* implicit */ EnumState(State) noexcept
+      : index_(StateIndexOf<State, States...>::value) {}
+
+  template <class State>
+  EnumState& operator=(State) noexcept {
+    index_ = StateIndexOf<State, States...>::value;
+    return *this;
+  }
+
+  uint8_t index() const noexcept {
+    return index_;
+  }
+
+  template <class State>
+  bool is() const noexcept {
+    return index_ == StateIndexOf<State, States...>::value;
+  }
+
+  template <class... Matching>
+  bool matches() const noexcept {
+    bool matched = false;
+    // Expands to an or of is() over Matching.
+    (void)std::initializer_list<int>{(matched |= is<Matching>(), 0)...};
+    return matched;
+  }
+
+ private:
+  uint8_t index_;
+};
+
 template <typename T>
 struct Matcher {
   bool operator()(const T&) const {
@@ -81,10 +141,26 @@ struct Matcher {
   }
 };
 
+template <class StateType>
+struct StateMatcher {
+  template <class... States>
+  static bool matches(const StateType& state) {
+    return folly::variant_match(
+        state, Matcher<States>{}..., [](const auto&) { return false; });
+  }
+};
+
+template <class... AllStates>
+struct StateMatcher<EnumState<AllStates...>> {
+  template <class... States>
+  static bool matches(const EnumState<AllStates...>& state) {
+    return state.template matches<States...>();
+  }
+};
+
 template <typename StateType, typename... States>
 bool matchesStates(const StateType& state) {
-  return folly::variant_match(
-      state, Matcher<States>{}..., [](const auto&) { return false; });
+  return StateMatcher<StateType>::template matches<States...>(state);
 }
 
 template <class Machine, class State, class Event, class... AllowedStates>
@@ -156,13 +232,41 @@ struct state_visitor : public boost::static_visitor<> {
   typename Machine::UserData& userData_;
 };
 
+template <class Machine, class Event, class StateType>
+struct StateDispatcher {
+  static void dispatch(
+      typename Machine::StateData& data,
+      Event event,
+      typename Machine::UserData& userData) {
+    auto visitor =
+        state_visitor<Machine, Event>(std::move(event), data, userData);
+    boost::apply_visitor(visitor, data.state);
+  }
+};
+
+template <class Machine, class Event, class... States>
+struct StateDispatcher<Machine, Event, EnumState<States...>> {
+  using HandlerFn = void (*)(
+      typename Machine::StateData&,
+      Event&&,
+      typename Machine::UserData&);
+
+  static void dispatch(
+      typename Machine::StateData& data,
+      Event event,
+      typename Machine::UserData& userData) {
+    static constexpr HandlerFn kHandlers[] = {
+        &Handler<Machine, States, Event>::handle...};
+    kHandlers[data.state.index()](data, std::move(event), userData);
+  }
+};
+
 template <class Machine, class Event>
 void invokeHandler(
     typename Machine::StateData& data,
     Event event,
     typename Machine::UserData& userData) {
-  auto visitor =
-      state_visitor<Machine, Event>(std::move(event), data, userData);
-  return boost::apply_visitor(visitor, data.state);
+  StateDispatcher<Machine, Event, std::decay_t<decltype(data.state)>>::
+      dispatch(data, std::move(event), userData);
 }
 }
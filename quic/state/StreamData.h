@@ -30,6 +30,19 @@ struct StreamBuffer {
   StreamBuffer& operator=(StreamBuffer&& other) = default;
 };
 
+struct Priority {
+  // Streams of a lower urgency are always written before streams of a higher
+  // one.
+  uint8_t urgency{kDefaultPriorityUrgency};
+  // Incremental streams of the same urgency share the connection round robin,
+  // the other ones are written one after another in stream id order.
+  bool incremental{false};
+
+  Priority() = default;
+  Priority(uint8_t urgencyIn, bool incrementalIn)
+      : urgency(urgencyIn), incremental(incrementalIn) {}
+};
+
 struct QuicStreamLike {
   virtual ~QuicStreamLike() = default;
 
@@ -106,32 +119,28 @@ struct StreamReceiveStates {
   struct Invalid {};
 };
 
-using StreamSendStateData = boost::variant<
+using StreamSendStateData = EnumState<
     StreamSendStates::Open,
     StreamSendStates::ResetSent,
     StreamSendStates::Closed,
     StreamSendStates::Invalid>;
 
-using StreamReceiveStateData = boost::variant<
+using StreamReceiveStateData = EnumState<
     StreamReceiveStates::Open,
     StreamReceiveStates::Closed,
     StreamReceiveStates::Invalid>;
 
 inline std::string streamStateToString(const StreamSendStateData& state) {
-  return folly::variant_match(
-      state,
-      [](const StreamSendStates::Open&) { return "Open"; },
-      [](const StreamSendStates::ResetSent&) { return "ResetSent"; },
-      [](const StreamSendStates::Closed&) { return "Closed"; },
-      [](const StreamSendStates::Invalid&) { return "Invalid"; });
+  // In the order of StreamSendStateData.
+  static constexpr const char* kNames[] = {
+      "Open", "ResetSent", "Closed", "Invalid"};
+  return kNames[state.index()];
 }
 
 inline std::string streamStateToString(const StreamReceiveStateData& state) {
-  return folly::variant_match(
-      state,
-      [](const StreamReceiveStates::Open&) { return "Open"; },
-      [](const StreamReceiveStates::Closed&) { return "Closed"; },
-      [](const StreamReceiveStates::Invalid&) { return "Invalid"; });
+  // In the order of StreamReceiveStateData.
+  static constexpr const char* kNames[] = {"Open", "Closed", "Invalid"};
+  return kNames[state.index()];
 }
 
 struct QuicStreamState : public QuicStreamLike {
@@ -154,10 +163,32 @@ struct QuicStreamState : public QuicStreamLike {
     uint64_t peerAdvertisedMaxOffset{0};
     // Time at which the last flow control update was sent by the transport.
     folly::Optional<TimePoint> timeOfLastFlowControlUpdate;
+    // Since when the peer's flow control blocks the stream, if it does.
+    folly::Optional<TimePoint> blockedSince;
+    // Time the stream was blocked by the peer's flow control, not counting
+    // the current blocking.
+    std::chrono::microseconds totalBlockedTime{0us};
+    // Bytes handed to the app by readZeroCopy that it hasn't released yet.
+    // They are read but not credited back to the peer.
+    uint64_t unreleasedReadBytes{0};
   };
 
   StreamFlowControlState flowControlState;
 
+  struct WriteDeadline {
+    // Stream offset right after the data the deadline applies to.
+    uint64_t endOffset;
+    TimePoint deadline;
+  };
+
+  // Deadlines passed to writeChain, in offset order. Each one covers the data
+  // between the previous entry's endOffset and its own.
+  std::deque<WriteDeadline> writeDeadlines;
+
+  // Creation time of a locally initiated bidirectional stream, until its
+  // first byte is received. Only set when there is an infoCallback.
+  folly::Optional<TimePoint> awaitingFirstByteSince;
+
   // Stream level read error occured.
   folly::Optional<QuicErrorCode> streamReadError;
   // Stream level write error occured.
@@ -175,12 +206,6 @@ struct QuicStreamState : public QuicStreamLike {
   // sent out by us.
   folly::Optional<PacketNum> latestMaxStreamDataPacket;
 
-  // Tells whether this stream is a control stream.
-  // It is set by the app via setControlStream and the transport can use this
-  // knowledge for optimizations e.g. for setting the app limited state on
-  // congestion control with control streams still active.
-  bool isControl{false};
-
   // The last time we detected we were head of line blocked on the stream.
   folly::Optional<Clock::time_point> lastHolbTime;
 
@@ -191,6 +216,45 @@ struct QuicStreamState : public QuicStreamLike {
   // lastHolbTime indicates whether the stream is HOL blocked at the moment.
   uint32_t holbCount{0};
 
+  // Number of gaps opened in the data received, each one by data arriving
+  // ahead of what was received so far, or in the middle of an existing gap.
+  uint32_t readGapCount{0};
+
+  // Largest span of the stream, from currentReadOffset to maxOffsetObserved,
+  // received while HOL blocked: what reassembly had to hold for a gap.
+  uint64_t maxReassemblyBytes{0};
+
+  // Span of the data received beyond the first gap, as of the last
+  // updateReadableStreams. Counted toward the connection's
+  // QuicStreamManager::reassemblyBytes.
+  uint64_t reassemblyBytes{0};
+
+  // Tells whether this stream is a control stream.
+  // It is set by the app via setControlStream and the transport can use this
+  // knowledge for optimizations e.g. for setting the app limited state on
+  // congestion control with control streams still active.
+  // Placed after holbCount so it fits in its padding.
+  bool isControl{false};
+
+  // Scheduling priority of the stream, set by the app via setStreamPriority.
+  Priority priority;
+
+  // Weight of the stream with weighted fair queueing, set by the app via
+  // setStreamWeight.
+  uint16_t weight{kDefaultStreamWeight};
+
+  // Bytes the stream may still send in its current weighted fair queueing
+  // turn, 0 when it is not in a turn.
+  uint64_t schedulingQuantumLeft{0};
+
+  // Rate the stream sends new data at, in bytes per second, 0 for no limit.
+  // Set by the app via setStreamSendRate.
+  uint64_t sendRate{0};
+
+  // Bytes the stream could send under its rate as of sendRateUpdateTime.
+  uint64_t sendRateTokens{0};
+  TimePoint sendRateUpdateTime;
+
   // Returns true if both send and receive state machines are in a terminal
   // state
   bool inTerminalStates() const {
@@ -235,5 +299,21 @@ struct QuicStreamState : public QuicStreamLike {
   bool hasPeekableData() const {
     return readBuffer.size() > 0;
   }
+
+  // End of the data that can be read without waiting for a gap to fill.
+  uint64_t contiguousReadEnd() const {
+    if (!readBuffer.empty() && readBuffer.front().offset <= currentReadOffset) {
+      return readBuffer.front().offset + readBuffer.front().data.chainLength();
+    }
+    return currentReadOffset;
+  }
+
+  // End of the data received and not read yet.
+  uint64_t readBufferEnd() const {
+    if (readBuffer.empty()) {
+      return currentReadOffset;
+    }
+    return readBuffer.back().offset + readBuffer.back().data.chainLength();
+  }
 };
 } // namespace quic
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/StreamIdSet.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace quic {
+
+constexpr size_t StreamIdSet::kNumStreamTypes;
+constexpr uint64_t StreamIdSet::kBitsPerWord;
+
+bool StreamIdSet::contains(StreamId streamId) const {
+  const auto& bitmap = bitmaps_[streamId % kNumStreamTypes];
+  auto index = streamId / kNumStreamTypes;
+  if (index < bitmap.base) {
+    return false;
+  }
+  auto offset = index - bitmap.base;
+  auto word = offset / kBitsPerWord;
+  if (word >= bitmap.words.size()) {
+    return false;
+  }
+  return bitmap.words[word] & (uint64_t(1) << (offset % kBitsPerWord));
+}
+
+void StreamIdSet::insert(StreamId streamId) {
+  auto& bitmap = bitmaps_[streamId % kNumStreamTypes];
+  auto index = streamId / kNumStreamTypes;
+  if (bitmap.words.empty()) {
+    bitmap.base = index - index % kBitsPerWord;
+  }
+  while (index < bitmap.base) {
+    bitmap.words.push_front(0);
+    bitmap.base -= kBitsPerWord;
+  }
+  auto offset = index - bitmap.base;
+  auto word = offset / kBitsPerWord;
+  if (word >= bitmap.words.size()) {
+    bitmap.words.resize(word + 1, 0);
+  }
+  auto bit = uint64_t(1) << (offset % kBitsPerWord);
+  if (!(bitmap.words[word] & bit)) {
+    bitmap.words[word] |= bit;
+    bitmap.count++;
+  }
+}
+
+void StreamIdSet::insert(StreamId start, StreamId end) {
+  for (auto streamId = start; streamId <= end; streamId += kNumStreamTypes) {
+    insert(streamId);
+  }
+}
+
+bool StreamIdSet::erase(StreamId streamId) {
+  if (!contains(streamId)) {
+    return false;
+  }
+  auto& bitmap = bitmaps_[streamId % kNumStreamTypes];
+  auto offset = streamId / kNumStreamTypes - bitmap.base;
+  bitmap.words[offset / kBitsPerWord] &=
+      ~(uint64_t(1) << (offset % kBitsPerWord));
+  bitmap.count--;
+  // Streams close roughly in order, so this keeps the bitmap short.
+  while (!bitmap.words.empty() && bitmap.words.front() == 0) {
+    bitmap.words.pop_front();
+    bitmap.base += kBitsPerWord;
+  }
+  return true;
+}
+
+size_t StreamIdSet::size() const {
+  size_t size = 0;
+  for (const auto& bitmap : bitmaps_) {
+    size += bitmap.count;
+  }
+  return size;
+}
+
+bool StreamIdSet::empty() const {
+  return size() == 0;
+}
+
+void StreamIdSet::clear() {
+  for (auto& bitmap : bitmaps_) {
+    bitmap = Bitmap();
+  }
+}
+
+std::deque<StreamId> StreamIdSet::sortedIds() const {
+  std::deque<StreamId> ids;
+  uint64_t begin = std::numeric_limits<uint64_t>::max();
+  uint64_t end = 0;
+  for (const auto& bitmap : bitmaps_) {
+    if (bitmap.count > 0) {
+      begin = std::min(begin, bitmap.base);
+      end = std::max(end, bitmap.base + bitmap.words.size() * kBitsPerWord);
+    }
+  }
+  // Ids are ordered by index first, and then by type.
+  for (auto index = begin; index < end; index++) {
+    for (StreamId type = 0; type < kNumStreamTypes; type++) {
+      auto streamId = index * kNumStreamTypes + type;
+      if (contains(streamId)) {
+        ids.push_back(streamId);
+      }
+    }
+  }
+  return ids;
+}
+
+} // namespace quic
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/codec/Types.h>
+
+#include <array>
+#include <deque>
+
+namespace quic {
+
+/**
+ * A set of stream ids, kept as one bitmap per stream type. Each bitmap starts
+ * at the word of its lowest id, so looking up, adding or removing a stream is
+ * constant time, and the memory taken is bounded by the distance between the
+ * lowest and the highest id of a type rather than by the number of ids.
+ *
+ * Streams of a type are opened in order and closed in any order, so the
+ * bitmaps only ever grow at the back and shrink at the front.
+ */
+class StreamIdSet {
+ public:
+  bool contains(StreamId streamId) const;
+
+  void insert(StreamId streamId);
+
+  // Adds all the streams of the type of end from start through end.
+  void insert(StreamId start, StreamId end);
+
+  // Returns false if streamId was not in the set.
+  bool erase(StreamId streamId);
+
+  size_t size() const;
+
+  bool empty() const;
+
+  void clear();
+
+  // The ids in the set, in increasing order across all the types.
+  std::deque<StreamId> sortedIds() const;
+
+ private:
+  static constexpr size_t kNumStreamTypes = 4;
+  static constexpr uint64_t kBitsPerWord = 64;
+
+  struct Bitmap {
+    // Index, i.e. id divided by the number of types, of the first bit.
+    uint64_t base{0};
+    std::deque<uint64_t> words;
+    size_t count{0};
+  };
+
+  std::array<Bitmap, kNumStreamTypes> bitmaps_;
+};
+
+} // namespace quic
@@ -8,11 +8,50 @@
 
 #pragma once
 
+#include <folly/Optional.h>
 #include <quic/QuicConstants.h>
 #include <chrono>
+#include <memory>
 
 namespace quic {
 
+/**
+ * Per connection overrides of congestion controller constants, so that
+ * parameter sets can be A/B tested without a rebuild, e.g. from
+ * QuicServerWorker::setTransportSettingsOverrideFn. Each controller reads its
+ * own parameters when it's constructed, and logs the ones it uses to qlog;
+ * unset or out of range parameters keep the controller's defaults.
+ */
+struct CongestionControlParams {
+  struct CubicParams {
+    // Multiplicative decrease of the cwnd on loss, in (0, 1).
+    // kDefaultCubicReductionFactor by default.
+    folly::Optional<double> beta;
+  };
+
+  struct BbrParams {
+    // Pacing and cwnd gain of Startup, that Drain paces at the inverse of.
+    // Above 1, kStartupGain by default.
+    folly::Optional<float> startupGain;
+    // Cwnd gain of ProbeBw, kProbeBwGain by default.
+    folly::Optional<float> probeBwCwndGain;
+  };
+
+  struct CopaParams {
+    // Takes precedence over TransportSettings::latencyFactor.
+    folly::Optional<double> latencyFactor;
+  };
+
+  CubicParams cubic;
+  BbrParams bbr;
+  CopaParams copa;
+
+  bool empty() const {
+    return !cubic.beta && !bbr.startupGain && !bbr.probeBwCwndGain &&
+        !copa.latencyFactor;
+  }
+};
+
 struct TransportSettings {
   // The initial connection window advertised to the peer.
   uint64_t advertisedInitialConnectionWindowSize{kDefaultConnectionWindowSize};
@@ -24,29 +63,182 @@ struct TransportSettings {
   uint64_t advertisedInitialMaxStreamsBidi{
       std::numeric_limits<uint32_t>::max()};
   uint64_t advertisedInitialMaxStreamsUni{std::numeric_limits<uint32_t>::max()};
+  // A server grants the peer a new stream for each of its streams that
+  // closed, so that it never has more than the advertised number of streams
+  // open. The new streams are granted once 1 / streamLimitWindowingFraction
+  // of the advertised limit closed.
+  uint64_t streamLimitWindowingFraction{kDefaultStreamLimitWindowingFraction};
   // Maximum number of packets to buffer while cipher is unavailable.
   uint32_t maxPacketsToBuffer{kDefaultMaxBufferedPackets};
+  // Bytes of such packets all the connections of a server worker buffer
+  // together, see PendingPacketBudget. 0 for no limit across connections.
+  uint64_t pendingPacketBudgetBytes{0};
+  // Whether a server connection that closes leaves a ClosedConnectionTable
+  // record behind to drain, rather than keeping its whole transport.
+  bool closedConnectionRecordsEnabled{false};
   // Idle timeout to advertise to the peer.
   std::chrono::milliseconds idleTimeout{kDefaultIdleTimeout};
+  // Whether activity only records its time instead of rescheduling the idle
+  // timer, which checks the time when it fires and rearms for the rest of
+  // the idle timeout if there was activity since it was scheduled.
+  bool lazyIdleTimeout{false};
+  // Send a PING when no ack eliciting packet was sent for this long, to keep
+  // NAT bindings and the peer's idle timer alive. 0 disables the keepalive.
+  std::chrono::milliseconds keepaliveInterval{0};
   // Ack delay exponent to use.
   uint64_t ackDelayExponent{kDefaultAckDelayExponent};
+  // Maximum number of ACK ranges to remember per packet number space.
+  uint64_t maxAckRanges{kDefaultMaxAckRanges};
+  // Number of RTTs after which received ACK ranges are no longer tracked.
+  // 0 disables aging.
+  uint32_t ackRangeAgeRtts{kDefaultAckRangeAgeRtts};
+  // Hold back pure acks while read callbacks are due to run, so that they
+  // go out with what the callbacks write instead of in their own packet.
+  bool coalesceAcksWithReads{false};
   // Default congestion controller type.
   CongestionControlType defaultCongestionController{
       CongestionControlType::Cubic};
+  // Number of subnets a server worker caches the path state of closed
+  // connections for, to seed the rtt and initial cwnd of new connections from
+  // the same subnet. 0 disables the cache.
+  uint32_t congestionStateCacheSize{0};
+  // Number of released Initial aeads a server worker keeps to re-key for new
+  // connections instead of allocating them. 0 disables the pool.
+  size_t initialCipherPoolSize{0};
+  // Number of memory blocks of each of the objects a connection is made of,
+  // like its transport and connection state, a server worker keeps from the
+  // connections that closed to build new ones from, see BlockRecycler. 0
+  // disables the recycling.
+  uint32_t recycledConnectionBlocks{0};
+  // Number of packets each server worker can have in flight to each other
+  // worker, when their connection lives on another worker. 0 forwards every
+  // packet with its own event base callback instead.
+  uint32_t crossWorkerQueueSize{0};
+  // How often each server worker samples its load: loop latency, connection
+  // count and bytes received per second. 0 disables the reporting.
+  std::chrono::milliseconds workerLoadReportInterval{0ms};
+  // Hand the new connections of a worker whose loop latency is at least
+  // workerHotLoopLatency to the least loaded worker. Needs the load reports.
+  bool newConnectionLoadBalancing{false};
+  std::chrono::microseconds workerHotLoopLatency{kDefaultWorkerHotLoopLatency};
+  // Number of the server's workers, the last ones, that only run the
+  // handshakes. New connections are created on them and moved to the least
+  // loaded of the other workers once established, or to each in turn without
+  // the load reports. 0 disables it, and so does a value leaving no other
+  // worker.
+  uint32_t numHandshakeWorkers{0};
+  // Loop latency, averaged over the server's workers, from which the server
+  // sheds load, see OverloadLevel: each further multiple of it goes up a
+  // level. Needs the load reports, 0 disables it.
+  std::chrono::microseconds overloadLoopLatency{0us};
+  // Packets a connection writes at a time at OverloadLevel::CAP_WRITES.
+  uint64_t overloadWritePacketsLimit{kDefaultOverloadWritePacketsLimit};
+  // Cached path state older than this is not used.
+  std::chrono::seconds congestionStateCacheTtl{
+      kDefaultCongestionStateCacheTtl};
+  // Whether the connections of a server worker read the time once per loop
+  // iteration of the worker, see LoopClock.
+  bool loopClockEnabled{false};
+  // Whether a server worker applies the TransportProfile picked from the
+  // cached path state of a new connection's subnet to its settings, before
+  // the settings override function runs. Needs the congestion state cache.
+  bool transportProfilesEnabled{false};
+  // Initial packets per second a server worker accepts from one source
+  // prefix, before routing them. 0 disables the limit.
+  uint32_t initialsPerPrefixRate{0};
+  uint32_t initialsPerPrefixBurst{kDefaultInitialsPerPrefixBurst};
+  // New connections per second a server worker creates. Initials that would
+  // create one beyond that are dropped. 0 disables the limit.
+  uint32_t newConnectionsRate{0};
+  uint32_t newConnectionsBurst{kDefaultNewConnectionsBurst};
+  // Version negotiation packets and stateless resets per second a server
+  // worker sends, beyond which the packets they answer are dropped. 0
+  // disables the limit.
+  uint32_t statelessResponsesRate{0};
+  uint32_t statelessResponsesBurst{kDefaultStatelessResponsesBurst};
+  // Whether Cubic leaves slow start with HyStart++ (RFC 9406) instead of
+  // Hystart. A delay increase first moves it to conservative slow start,
+  // which goes back to slow start if the delay increase was spurious.
+  bool cubicHystartPlusPlus{false};
+  // Whether Cubic computes its window in integers, with fixedPointCbrt,
+  // instead of with cbrt and pow. Its time to origin is then rounded down to
+  // a millisecond, like the time since the last reduction already is.
+  bool cubicFixedPointMath{false};
+  // Whether the server saves the cwnd and rtt of a connection in its session
+  // tickets, and, on resumption, jumps the cwnd towards the saved one once the
+  // first rtt sample matches the saved rtt. Only Cubic and NewReno jump.
+  bool carefulResumeEnabled{false};
+  // Whether the client saves the rtt, cwnd and address family of the path in
+  // its psk cache entries, and seeds connections resuming them from it.
+  bool pskPathMetricsEnabled{false};
+  // Whether the client offers TLS certificate compression. The server
+  // compresses when its certificates come from a PrecompressedCertCache.
+  bool certCompressionEnabled{false};
+  // Whether the server keeps the 1-RTT secrets of its connections, so that
+  // serializeConnectionState can hand established ones to another process.
+  bool connectionStateExportEnabled{false};
   // Param to determine sensitivity of CongestionController to latency. Only
   // used by COPA.
   folly::Optional<double> latencyFactor;
+  // Whether COPA switches to its competitive mode when the queue doesn't
+  // empty, see Copa::Mode.
+  bool copaCompetitiveModeEnabled{false};
+  // Whether the BBR bandwidth sampler takes one sample per ack, from the
+  // acked packet sent last, instead of one per acked packet.
+  bool bbrPerAckBandwidthSample{false};
+  // Parameters of the congestion controllers for this connection.
+  CongestionControlParams congestionControlParams;
   // The max UDP packet size we are willing to receive.
   uint64_t maxRecvPacketSize{kDefaultUDPReadBufferSize};
+  // Number of idle receive buffers to keep for reuse instead of allocating a
+  // buffer per datagram. 0 disables receive buffer pooling.
+  uint32_t readBufferPoolSize{kDefaultReadBufferPoolSize};
+  // Stream writes up to this many bytes are copied into the stream's write
+  // buffer so back to back small writes share one buffer. 0 disables it.
+  uint32_t writeCoalesceThreshold{kDefaultWriteCoalesceThreshold};
+  // Most read and peek callbacks invoked in one loop each, the next loop
+  // carries on with the streams after the last one served. 0 is no limit.
+  uint32_t streamCallbacksPerLoop{0};
+  // How streams of the same urgency share the connection.
+  StreamSchedulingMode streamSchedulingMode{StreamSchedulingMode::RoundRobin};
+  // With receive buffer pooling, datagrams up to this size are copied into a
+  // right sized buffer so that long lived data does not pin pooled buffers.
+  uint32_t readBufferCopyThreshold{kDefaultReadBufferCopyThreshold};
+  // Whether server workers allocate their receive buffers, and the buffers
+  // of packets built with contiguousPacketBuffers, from BufferArenas backed
+  // by huge pages. Each arena maps up to bufferArenaMaxBytes.
+  bool bufferArenaEnabled{false};
+  uint64_t bufferArenaMaxBytes{kDefaultBufferArenaMaxBytes};
   // Can we ignore the path mtu when sending a packet. This is useful for
   // testing.
   bool canIgnorePathMTU{false};
+  // Whether to search for the largest packet size the path supports with
+  // padded probe packets, see PmtuDiscoveryState. Ignored when
+  // canIgnorePathMTU is set.
+  bool pmtuDiscoveryEnabled{false};
+  // Whether lost packets that get acked later are detected as spurious
+  // losses. The reordering thresholds of the loss detection then adapt to the
+  // reordering of the path, and Cubic and NewReno undo their window
+  // reduction when all the losses of a recovery were spurious.
+  bool spuriousLossDetectionEnabled{false};
+  // Largest packet size probed for. The peer's max_packet_size also caps it.
+  uint64_t maxPmtuProbeSize{kDefaultMaxUDPPayload};
   // Whether or not to use a connected UDP socket on the client. This should
   // only be used in environments where you know your IP address does not
   // change. See AsyncUDPSocket::connect for the caveats.
   bool connectUDP{false};
+  // Whether a client racing both address families with happy eyeballs keeps
+  // the socket of the family that lost open as a standby path. It fails over
+  // to it once the current path goes standbyPathFailoverPtoCount PTOs in a row
+  // without an ack, and back if that one fails as well. Each path keeps its
+  // own congestion state and rtt. The server has to allow migration.
+  bool standbyPathEnabled{false};
+  uint32_t standbyPathFailoverPtoCount{kDefaultStandbyPathFailoverPtoCount};
   // Maximum number of consecutive PTOs before the connection is torn down.
   uint16_t maxNumPTOs{kDefaultMaxNumPTO};
+  // Maximum number of clones of a packet outstanding at once. Probes without
+  // anything else to clone carry a PING instead.
+  uint64_t maxClonesPerPacket{kDefaultMaxClonesPerPacket};
   // Whether to turn off PMTUD on the socket
   bool turnoffPMTUD{false};
   // Whether to listen to socket error
@@ -60,6 +252,26 @@ struct TransportSettings {
   // Pacing timer tick interval
   std::chrono::microseconds pacingTimerTickInterval{
       kDefaultPacingTimerTickInterval};
+  // Whether the connections of a worker pace with one timer wheel of
+  // pacingTimerWheelSlotInterval slots instead of the pacing timer. The
+  // connections due in the same slot write in one wakeup, and with the worker
+  // write batch their packets go out with one sendmmsg.
+  bool pacingTimerWheelEnabled{false};
+  // Whether the connection paces with a TokenBucketPacer fed with the target
+  // rate of the congestion controller, instead of the congestion controller
+  // pacing. It also paces NewReno.
+  bool tokenBucketPacerEnabled{false};
+  // Egress budget of a server worker in bytes per second, e.g. the NIC's
+  // capacity divided by the number of workers. The pacing rates of the
+  // worker's connections are capped to their max-min fair share of it, see
+  // BandwidthAllocator. Needs tokenBucketPacerEnabled, 0 disables it.
+  uint64_t workerEgressBandwidth{0};
+  std::chrono::microseconds pacingTimerWheelSlotInterval{
+      kDefaultPacingTimerWheelSlotInterval};
+  // Whether pacing is offloaded to the kernel with SO_TXTIME departure times
+  // instead of the pacing timer. Needs the fq qdisc on the egress interface.
+  // Timer pacing is used if the socket does not support SO_TXTIME.
+  bool kernelPacingEnabled{false};
   ZeroRttSourceTokenMatchingPolicy zeroRttSourceTokenMatchingPolicy{
       ZeroRttSourceTokenMatchingPolicy::LIMIT_IF_NO_EXACT_MATCH};
   bool attemptEarlyData{true};
@@ -67,17 +279,91 @@ struct TransportSettings {
   // writeConnectionDataToSocket.
   uint64_t writeConnectionDataPacketsLimit{
       kDefaultWriteConnectionDataPacketLimit};
+  // Time and bytes one event loop iteration may spend writing. Each budget is
+  // split evenly between the transports of the EventBase that have data to
+  // write, so a lone connection gets all of it. Setting either replaces
+  // writeConnectionDataPacketsLimit for unpaced connections, 0 disables it.
+  std::chrono::microseconds writeLoopTimeBudget{0us};
+  uint64_t writeLoopBytesBudget{0};
   // Frequency of sending flow control updates. We can send one update every
   // flowControlRttFrequency * RTT if the flow control changes.
   uint16_t flowControlRttFrequency{2};
   // Frequency of sending flow control updates. We can send one update every
   // flowControlWindowFrequency * window if the flow control changes.
   uint16_t flowControlWindowFrequency{2};
+  // Whether the receive windows grow when the peer uses them up faster than
+  // they are refreshed within flowControlRttFrequency * RTT, up to the max
+  // window sizes below. A server worker caps the growth of all its
+  // connections at workerReceiveWindowBudget, see ReceiveWindowBudget.
+  bool autotuneReceiveWindow{false};
+  uint64_t maxReceiveStreamWindowSize{kDefaultMaxReceiveStreamWindowSize};
+  uint64_t maxReceiveConnectionWindowSize{
+      kDefaultMaxReceiveConnectionWindowSize};
+  uint64_t workerReceiveWindowBudget{kDefaultWorkerReceiveWindowBudget};
+  // Most bytes of stream data received ahead of a gap the connection holds,
+  // see exceedsReassemblyBudget. Packets that would go over it are dropped
+  // unacked. 0 for no budget, in which case reassembly is only bounded by
+  // the flow control windows.
+  uint64_t reassemblyBudget{0};
+  // Whether window updates wait for the next packet the connection sends
+  // anyway, acks included, instead of triggering a write of their own. They
+  // are still written right away once the peer is about to be blocked, see
+  // kUrgentWindowUpdateFraction.
+  bool deferWindowUpdates{false};
+  // maximum number of MAX_STREAM_DATA frames per packet with
+  // deferWindowUpdates, so that they don't crowd out the packet's data.
+  uint32_t maxWindowUpdatesPerPacket{kDefaultMaxWindowUpdatesPerPacket};
   // batching mode
   QuicBatchingMode batchingMode{QuicBatchingMode::BATCHING_MODE_NONE};
+  // Whether each packet is built and encrypted in a single buffer, see
+  // RegularQuicPacketBuilder::useContiguousBuffer.
+  bool contiguousPacketBuffers{false};
+  // maximum number of packets built by a write loop before they are encrypted
+  // together with Aead::encryptBatch.
+  uint32_t maxEncryptBatchSize{kDefaultMaxEncryptBatchSize};
+  // Whether Initial and Handshake packets are coalesced with the packets of
+  // the next packet number spaces into a single datagram.
+  bool coalescePackets{false};
   // maximum number of packets we can batch. This does not apply to
   // BATCHING_MODE_NONE
   uint32_t maxBatchSize{kDefaultQuicMaxBatchSize};
+  // Whether the GSO batches of paced connections are sized to the pacing
+  // burst instead of maxBatchSize, so that each burst is written with a
+  // single GSO send, which kernel pacing gives a single departure time.
+  bool pacingAwareBatching{false};
+  // maximum number of datagrams the server worker or the client transport
+  // reads per socket read event. Values greater than 1 enable batched reads
+  // with recvmmsg, the client processes each batch before writing.
+  uint32_t maxRecvBatchSize{kDefaultQuicMaxRecvBatchSize};
+  // Whether to enable UDP GRO on the receiving sockets. Datagrams coalesced by
+  // the kernel are split back into individual packets before processing.
+  bool receiveGROEnabled{false};
+  // Whether to send packets with the ECT(0) codepoint and echo the ECN
+  // codepoints of received packets in ACK_ECN frames. CE marks reported by the
+  // peer are handed to the congestion controller once the path passes ECN
+  // validation.
+  bool enableECN{false};
+  // Whether the receiving sockets report the time the kernel received each
+  // datagram, which is used as its receive time instead of the time it was
+  // read, so that event loop delays don't inflate the RTT samples.
+  bool rxTimestampsEnabled{false};
+  // Whether server connections defer their writes to a batch owned by the
+  // worker, which writes the packets of all its connections with one sendmmsg
+  // call at the end of the event loop iteration. Only connections sharing the
+  // worker's listening socket take part in the batch.
+  bool workerWriteBatchEnabled{false};
+  // maximum number of packets in the worker write batch before it is flushed.
+  uint32_t workerWriteBatchSize{kDefaultWorkerWriteBatchSize};
+  // Whether the connections of a worker write from one write scheduler shared
+  // by the worker instead of each running its own write loop. Connections are
+  // serviced round robin once per event loop iteration, paced connections
+  // keep using their own write loop.
+  bool workerWriteSchedulerEnabled{false};
+  // Whether to send large GSO batches with MSG_ZEROCOPY. Completions are read
+  // from the socket error queue, so this needs enableSocketErrMsgCallback.
+  bool zeroCopySendEnabled{false};
+  // minimum size in bytes of a GSO batch to be sent with zero copy.
+  uint32_t zeroCopySendThreshold{kDefaultZeroCopySendThreshold};
   // Sets network unreachable to be a non fatal error. In some environments,
   // EHOSTUNREACH or ENETUNREACH could just be because the routing table is
   // being setup. This option makes those non fatal connection errors.
@@ -105,11 +391,77 @@ struct TransportSettings {
   uint64_t totalBufferSpaceAvailable{kDefaultBufferSpaceAvailable};
   // Whether or not to advertise partial reliability capability
   bool partialReliabilityEnabled{false};
+  // Whether to advertise support for unreliable DATAGRAM frames.
+  bool datagramsEnabled{false};
+  // maximum number of received datagrams buffered until read by the app. The
+  // oldest one is dropped when a new datagram arrives on a full buffer.
+  uint32_t datagramReadBufferSize{kDefaultMaxDatagramsBuffered};
+  // maximum number of datagrams buffered until written to the socket.
+  uint32_t datagramWriteBufferSize{kDefaultMaxDatagramsBuffered};
+  // Whether to advertise support for ACK_FREQUENCY frames, and ask a peer that
+  // supports them to ack less often once out of slow start.
+  bool ackFrequencyEnabled{false};
+  // Whether to advertise forward error correction, and send FEC_REPAIR frames
+  // protecting small stream frames to a peer that advertises it too.
+  bool fecEnabled{false};
   // Whether the endpoint allows peer to migrate to new address
   bool disableMigration{true};
+  // number of connection ids a server keeps issued to the client on top of
+  // the one in use, for it to migrate with. They are issued together once the
+  // handshake is done, and replaced as the client retires them. At most
+  // kMaxConnectionIdPoolSize, 0 to issue none.
+  uint32_t connectionIdPoolSize{0};
   // default stateless reset secret for stateless reset token
   folly::Optional<std::array<uint8_t, kStatelessResetTokenSecretLength>>
       statelessResetTokenSecret;
+  // Secret of the address validation tokens. When set, the server answers
+  // Initials without a token with a Retry once one of the thresholds below is
+  // reached, and only creates a connection for an Initial carrying a valid
+  // token. With both thresholds at 0 every new connection is retried.
+  folly::Optional<std::array<uint8_t, kRetryTokenSecretLength>>
+      retryTokenSecret;
+  // number of handshakes in progress on a worker from which it sends Retry,
+  // 0 to not look at them.
+  uint32_t retryPendingHandshakesThreshold{0};
+  // number of new connections from one address within kRetrySourceRateWindow
+  // beyond which it gets Retry, 0 to not look at the rate.
+  uint32_t retryNewConnectionsPerSourceThreshold{0};
+  // how long a Retry token is valid.
+  std::chrono::seconds retryTokenLifetime{kDefaultRetryTokenLifetime};
+  // qlog events to log, a bit per QLogEventType, see QLogger::isEnabled.
+  uint32_t qLogEvents{kQLogAllEvents};
+  // log one packet event in this many, 1 logs them all. Other events, e.g.
+  // losses and closes, are not sampled.
+  uint32_t qLogPacketSampleRate{1};
+  // Time one in this many event base callbacks into the transport, to
+  // attribute the worker's time to its connections, 0 disables it. See
+  // QuicServer::getTopTransportsByLoopTime.
+  uint32_t loopTimeSampleRate{0};
+  // Last datagrams sent and received each connection keeps in its
+  // PacketCaptureRing, 0 to not capture. See
+  // QuicTransportBase::dumpPacketCapture.
+  uint32_t packetCaptureDatagrams{0};
+  // Bytes of each captured datagram kept, headers first.
+  uint32_t packetCaptureSnapLength{kDefaultPacketCaptureSnapLength};
+  // Consecutive PTOs after which the capture is handed to the
+  // PacketCaptureCallback, 0 to not capture on PTOs.
+  uint32_t packetCapturePtoThreshold{kDefaultPacketCapturePtoThreshold};
+  // Whether to drop the keys, crypto data, ack state and outstanding packets
+  // of the Initial and Handshake packet number spaces as soon as the
+  // handshake is confirmed, rather than keeping the Initial read keys for
+  // kTimeToRetainInitialKeys and the rest until the connection goes away.
+  bool discardHandshakeSpaces{false};
+  // Whether the ACK frames of the 1-RTT packets read in one batch are folded
+  // into one ack event, so loss detection and the congestion controller run
+  // once for the batch rather than once for each of its ACK frames.
+  bool batchAckProcessing{false};
 };
 
+/**
+ * Settings that never change once made, shared by the workers of a server
+ * and read by each of them when it creates a connection. Changing them means
+ * making a new snapshot.
+ */
+using TransportSettingsSnapshot = std::shared_ptr<const TransportSettings>;
+
 } // namespace quic
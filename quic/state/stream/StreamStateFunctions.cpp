@@ -53,7 +53,7 @@ void onResetQuicStream(QuicStreamState& stream, RstStreamFrame&& frame) {
     auto lastReadOffset = stream.currentReadOffset;
     stream.currentReadOffset = frame.offset;
     stream.maxOffsetObserved = frame.offset;
-    updateFlowControlOnRead(stream, lastReadOffset, Clock::now());
+    updateFlowControlOnRead(stream, lastReadOffset, loopClockNow(stream.conn));
   }
   stream.conn.streamManager->updateReadableStreams(stream);
   stream.conn.streamManager->updateWritableStreams(stream);
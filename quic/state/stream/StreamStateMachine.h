@@ -44,12 +44,7 @@ inline void StreamSendStateMachineInvalidHandler(const QuicStreamState& state) {
   throw QuicTransportException(
       folly::to<std::string>(
           "Invalid transition from state=",
-          folly::variant_match(
-              state.send.state,
-              [](const StreamSendStates::Open&) { return "Open"; },
-              [](const StreamSendStates::ResetSent&) { return "ResetSent"; },
-              [](const StreamSendStates::Closed&) { return "Closed"; },
-              [](const StreamSendStates::Invalid&) { return "Invalid"; })),
+          streamStateToString(state.send.state)),
       TransportErrorCode::STREAM_STATE_ERROR);
 }
 
@@ -67,11 +62,7 @@ inline void StreamReceiveStateMachineInvalidHandler(
   throw QuicTransportException(
       folly::to<std::string>(
           "Invalid transition from state=",
-          folly::variant_match(
-              state.recv.state,
-              [](const StreamReceiveStates::Open&) { return "Open"; },
-              [](const StreamReceiveStates::Closed&) { return "Closed"; },
-              [](const StreamReceiveStates::Invalid&) { return "Invalid"; })),
+          streamStateToString(state.recv.state)),
       TransportErrorCode::STREAM_STATE_ERROR);
 }
 
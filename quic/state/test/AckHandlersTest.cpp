@@ -1005,6 +1005,232 @@ TEST_F(AckHandlersTest, PureAckDoesNotUpdateRtt) {
   EXPECT_TRUE(conn.outstandingPackets.empty());
 }
 
+TEST_F(AckHandlersTest, AckWithInterleavedPacketNumberSpaces) {
+  QuicServerConnectionState conn;
+  conn.congestionController = nullptr;
+  // Get the loss detection out of the way
+  conn.lossState.reorderingThreshold = 100;
+  conn.lossState.srtt = 10s;
+  auto sentTime = Clock::now();
+  for (PacketNum packetNum = 1; packetNum <= 10; packetNum++) {
+    for (auto pnSpace :
+         {PacketNumberSpace::Handshake, PacketNumberSpace::AppData}) {
+      auto regularPacket = createNewPacket(packetNum, pnSpace);
+      regularPacket.frames.emplace_back(PaddingFrame());
+      conn.outstandingPackets.emplace_back(OutstandingPacket(
+          std::move(regularPacket),
+          sentTime,
+          1,
+          false /* handshake */,
+          false /* pureAck */,
+          packetNum));
+    }
+  }
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 8;
+  ackFrame.ackBlocks.emplace_back(6, 8);
+  ackFrame.ackBlocks.emplace_back(2, 4);
+  std::vector<PacketNum> ackedPackets;
+  processAckFrame(
+      conn,
+      PacketNumberSpace::AppData,
+      ackFrame,
+      [&](const auto& outstandingPacket, const auto&, const auto&) {
+        ackedPackets.push_back(folly::variant_match(
+            outstandingPacket.packet.header,
+            [](const auto& h) { return h.getPacketSequenceNum(); }));
+      },
+      [&](auto&, auto&, bool, auto) {},
+      Clock::now());
+  EXPECT_THAT(ackedPackets, ElementsAre(2u, 3u, 4u, 6u, 7u, 8u));
+
+  // Every handshake packet is still outstanding, and the order is preserved.
+  std::vector<std::pair<PacketNumberSpace, PacketNum>> remaining;
+  for (const auto& outstandingPacket : conn.outstandingPackets) {
+    remaining.emplace_back(folly::variant_match(
+        outstandingPacket.packet.header, [](const auto& h) {
+          return std::make_pair(
+              h.getPacketNumberSpace(), h.getPacketSequenceNum());
+        }));
+  }
+  std::vector<std::pair<PacketNumberSpace, PacketNum>> expected;
+  for (PacketNum packetNum = 1; packetNum <= 10; packetNum++) {
+    expected.emplace_back(PacketNumberSpace::Handshake, packetNum);
+    if (packetNum < 2 || packetNum == 5 || packetNum > 8) {
+      expected.emplace_back(PacketNumberSpace::AppData, packetNum);
+    }
+  }
+  EXPECT_EQ(expected, remaining);
+}
+
+TEST_P(AckHandlersTest, EcnCeCountsReachCongestionController) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.enableECN = true;
+  auto mockController = std::make_unique<MockCongestionController>();
+  auto rawController = mockController.get();
+  conn.congestionController = std::move(mockController);
+  conn.lossState.srtt = 10s;
+  auto sentTime = Clock::now();
+  for (PacketNum packetNum = 1; packetNum <= 4; packetNum++) {
+    conn.outstandingPackets.emplace_back(OutstandingPacket(
+        createNewPacket(packetNum, GetParam()),
+        sentTime,
+        1,
+        false,
+        false,
+        packetNum));
+  }
+
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 2;
+  ackFrame.ackBlocks.emplace_back(1, 2);
+  ackFrame.ecnCounts = ECNCounts{1, 0, 1};
+  EXPECT_CALL(*rawController, onPacketAckOrLoss(_, _))
+      .WillOnce(Invoke([&](auto ack, auto) {
+        ASSERT_TRUE(ack.hasValue());
+        EXPECT_EQ(1, ack->ecnCeCount);
+      }));
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [](const auto&, const auto&, const auto&) {},
+      [](auto&, auto&, bool, PacketNum) {},
+      Clock::now());
+
+  // Only the newly reported CE marks count.
+  ackFrame.largestAcked = 4;
+  ackFrame.ackBlocks.clear();
+  ackFrame.ackBlocks.emplace_back(1, 4);
+  ackFrame.ecnCounts = ECNCounts{1, 0, 3};
+  EXPECT_CALL(*rawController, onPacketAckOrLoss(_, _))
+      .WillOnce(Invoke([&](auto ack, auto) {
+        ASSERT_TRUE(ack.hasValue());
+        EXPECT_EQ(2, ack->ecnCeCount);
+      }));
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [](const auto&, const auto&, const auto&) {},
+      [](auto&, auto&, bool, PacketNum) {},
+      Clock::now());
+  EXPECT_FALSE(conn.ecnValidationFailed);
+}
+
+TEST_P(AckHandlersTest, EcnValidationFails) {
+  auto ackWithCounts = [&](QuicServerConnectionState& conn,
+                           folly::Optional<ECNCounts> ecnCounts) {
+    auto mockController = std::make_unique<MockCongestionController>();
+    EXPECT_CALL(*mockController, onPacketAckOrLoss(_, _))
+        .WillOnce(Invoke(
+            [&](auto ack, auto) { EXPECT_EQ(0, ack->ecnCeCount); }));
+    conn.congestionController = std::move(mockController);
+    conn.transportSettings.enableECN = true;
+    for (PacketNum packetNum = 1; packetNum <= 2; packetNum++) {
+      conn.outstandingPackets.emplace_back(OutstandingPacket(
+          createNewPacket(packetNum, GetParam()),
+          Clock::now(),
+          1,
+          false,
+          false,
+          packetNum));
+    }
+    ReadAckFrame ackFrame;
+    ackFrame.largestAcked = 2;
+    ackFrame.ackBlocks.emplace_back(1, 2);
+    ackFrame.ecnCounts = ecnCounts;
+    processAckFrame(
+        conn,
+        GetParam(),
+        ackFrame,
+        [](const auto&, const auto&, const auto&) {},
+        [](auto&, auto&, bool, PacketNum) {},
+        Clock::now());
+  };
+
+  // The marks didn't make it to the peer.
+  QuicServerConnectionState noCounts;
+  ackWithCounts(noCounts, folly::none);
+  EXPECT_TRUE(noCounts.ecnValidationFailed);
+
+  // One of the two acked packets lost its mark on the way.
+  QuicServerConnectionState tooFewMarks;
+  ackWithCounts(tooFewMarks, ECNCounts{0, 0, 1});
+  EXPECT_TRUE(tooFewMarks.ecnValidationFailed);
+
+  // We never send ECT(1).
+  QuicServerConnectionState remarked;
+  ackWithCounts(remarked, ECNCounts{1, 1, 0});
+  EXPECT_TRUE(remarked.ecnValidationFailed);
+
+  QuicServerConnectionState valid;
+  ackWithCounts(valid, ECNCounts{2, 0, 0});
+  EXPECT_FALSE(valid.ecnValidationFailed);
+}
+
+TEST_P(AckHandlersTest, AckBatch) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.batchAckProcessing = true;
+  auto mockController = std::make_unique<MockCongestionController>();
+  auto rawController = mockController.get();
+  conn.congestionController = std::move(mockController);
+  auto sentTime = Clock::now();
+  for (PacketNum packetNum = 1; packetNum <= 4; packetNum++) {
+    conn.outstandingPackets.emplace_back(OutstandingPacket(
+        createNewPacket(packetNum, GetParam()),
+        sentTime,
+        1,
+        false,
+        false,
+        packetNum));
+  }
+  auto ackTime = sentTime + 10ms;
+  auto ack = [&](PacketNum start, PacketNum end, TimePoint time) {
+    ReadAckFrame ackFrame;
+    ackFrame.largestAcked = end;
+    ackFrame.ackBlocks.emplace_back(start, end);
+    processAckFrame(
+        conn,
+        GetParam(),
+        ackFrame,
+        [](const auto&, const auto&, const auto&) {},
+        [](auto&, auto&, bool, PacketNum) {},
+        time);
+  };
+  bool batched = GetParam() == PacketNumberSpace::AppData;
+  startAckBatch(conn);
+  if (batched) {
+    EXPECT_CALL(*rawController, onPacketAckOrLoss(_, _)).Times(0);
+  } else {
+    // Only the acks of 1-RTT packets wait for the batch.
+    EXPECT_CALL(*rawController, onPacketAckOrLoss(_, _)).Times(2);
+  }
+  ack(1, 2, ackTime);
+  ack(3, 3, ackTime + 1ms);
+  Mock::VerifyAndClearExpectations(rawController);
+
+  EXPECT_EQ(1u, conn.outstandingPackets.size());
+  if (batched) {
+    EXPECT_CALL(*rawController, onPacketAckOrLoss(_, _))
+        .WillOnce(Invoke([&](auto ack, auto) {
+          EXPECT_EQ(3u, *ack->largestAckedPacket);
+          EXPECT_EQ(3u, ack->ackedBytes);
+          EXPECT_EQ(3u, ack->ackedPackets.size());
+          EXPECT_EQ(ackTime + 1ms, ack->ackTime);
+          EXPECT_EQ(10ms, *ack->mrttSample);
+        }));
+  }
+  flushAckBatch(conn, [](auto&, auto&, bool, PacketNum) {});
+  EXPECT_FALSE(conn.ackBatch.hasValue());
+  EXPECT_EQ(3u, getAckState(conn, GetParam()).largestAckedByPeer);
+  Mock::VerifyAndClearExpectations(rawController);
+
+  // Nothing more to flush.
+  EXPECT_CALL(*rawController, onPacketAckOrLoss(_, _)).Times(0);
+  flushAckBatch(conn, [](auto&, auto&, bool, PacketNum) {});
+}
+
 INSTANTIATE_TEST_CASE_P(
     AckHandlersTests,
     AckHandlersTest,
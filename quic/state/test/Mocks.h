@@ -24,7 +24,7 @@ class MockCongestionController : public CongestionController {
       void(folly::Optional<AckEvent>, folly::Optional<LossEvent>));
   MOCK_CONST_METHOD0(getWritableBytes, uint64_t());
   MOCK_CONST_METHOD0(getCongestionWindow, uint64_t());
-  MOCK_METHOD0(onSpuriousLoss, void());
+  MOCK_METHOD1(onSpuriousLoss, void(TimePoint));
   GMOCK_METHOD1_(, , , setConnectionEmulation, void(uint8_t));
   MOCK_CONST_METHOD0(canBePaced, bool());
   MOCK_CONST_METHOD0(type, CongestionControlType());
@@ -40,6 +40,7 @@ class MockCongestionController : public CongestionController {
   GMOCK_METHOD2_(, , , setAppIdle, void(bool, TimePoint));
   MOCK_METHOD0(setAppLimited, void());
   MOCK_CONST_METHOD0(isAppLimited, bool());
+  MOCK_CONST_METHOD0(inSlowStart, bool());
 };
 } // namespace test
 } // namespace quic
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/QuicFecFunctions.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class QuicFecFunctionsTest : public Test {
+ public:
+  void SetUp() override {
+    conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+        kDefaultStreamWindowSize;
+    conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+        kDefaultStreamWindowSize;
+    conn.flowControlState.peerAdvertisedMaxOffset =
+        kDefaultConnectionWindowSize;
+    conn.streamManager->setMaxLocalBidirectionalStreams(
+        kDefaultMaxStreamsBidirectional);
+    conn.fecState.enabled = true;
+    conn.fecState.window = kFecMinWindow;
+    peer.fecState.enabled = true;
+  }
+
+  // Writes data on stream as a frame of packetNum, and returns the frame the
+  // peer would read.
+  ReadStreamFrame writeFrame(
+      QuicStreamState& stream,
+      const std::string& data,
+      bool fin,
+      PacketNum packetNum) {
+    uint64_t offset = stream.currentWriteOffset;
+    stream.retransmissionBuffer.emplace_back(
+        IOBuf::copyBuffer(data), offset, fin);
+    stream.currentWriteOffset += data.size();
+    WriteStreamFrame frame(stream.id, offset, data.size(), fin);
+    fecOnStreamFrameWritten(conn, stream, frame, packetNum);
+    fecOnPacketWritten(conn);
+    return ReadStreamFrame(stream.id, offset, IOBuf::copyBuffer(data), fin);
+  }
+
+  folly::Optional<FecRepairFrame> pendingRepair() {
+    for (const auto& frame : conn.pendingEvents.frames) {
+      auto repair = boost::get<FecRepairFrame>(&frame);
+      if (repair) {
+        return *repair;
+      }
+    }
+    return folly::none;
+  }
+
+  QuicServerConnectionState conn;
+  QuicServerConnectionState peer;
+};
+
+TEST_F(QuicFecFunctionsTest, RecoverLostFrame) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  std::vector<ReadStreamFrame> frames;
+  frames.push_back(writeFrame(*stream, "hello", false, 10));
+  frames.push_back(writeFrame(*stream, "forward error", false, 11));
+  frames.push_back(writeFrame(*stream, "!", false, 12));
+  EXPECT_FALSE(pendingRepair());
+  frames.push_back(writeFrame(*stream, "correction", true, 14));
+
+  auto repair = pendingRepair();
+  ASSERT_TRUE(repair);
+  EXPECT_EQ(10u, repair->firstPacketNum);
+  EXPECT_EQ(14u, repair->lastPacketNum);
+  EXPECT_EQ(4u, repair->numSourceFrames);
+  EXPECT_EQ(0u, conn.fecState.numSourceFrames);
+
+  // The second frame is lost.
+  fecOnStreamFrameReceived(peer, 10, frames[0]);
+  fecOnStreamFrameReceived(peer, 12, frames[2]);
+  fecOnStreamFrameReceived(peer, 14, frames[3]);
+  auto recovered = fecRecoverStreamFrame(peer, *repair);
+  ASSERT_TRUE(recovered);
+  EXPECT_EQ(stream->id, recovered->streamId);
+  EXPECT_EQ(frames[1].offset, recovered->offset);
+  EXPECT_FALSE(recovered->fin);
+  EXPECT_TRUE(IOBufEqualTo()(frames[1].data, recovered->data));
+  EXPECT_EQ(1u, peer.fecState.numRecoveredFrames);
+}
+
+TEST_F(QuicFecFunctionsTest, NothingToRecover) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  std::vector<ReadStreamFrame> frames;
+  for (PacketNum packetNum = 0; packetNum < kFecMinWindow; ++packetNum) {
+    frames.push_back(writeFrame(*stream, "data", false, packetNum));
+  }
+  auto repair = pendingRepair();
+  ASSERT_TRUE(repair);
+
+  // Two frames lost, one repair isn't enough.
+  fecOnStreamFrameReceived(peer, 0, frames[0]);
+  fecOnStreamFrameReceived(peer, 1, frames[1]);
+  EXPECT_FALSE(fecRecoverStreamFrame(peer, *repair));
+
+  // None lost.
+  fecOnStreamFrameReceived(peer, 2, frames[2]);
+  fecOnStreamFrameReceived(peer, 3, frames[3]);
+  EXPECT_FALSE(fecRecoverStreamFrame(peer, *repair));
+  EXPECT_EQ(0u, peer.fecState.numRecoveredFrames);
+}
+
+TEST_F(QuicFecFunctionsTest, LargeFramesNotProtected) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  writeFrame(
+      *stream, std::string(kFecMaxSourceDataLength + 1, 'a'), false, 0);
+  EXPECT_EQ(0u, conn.fecState.numSourceFrames);
+}
+
+TEST_F(QuicFecFunctionsTest, RepairWithoutNegotiation) {
+  peer.fecState.enabled = false;
+  FecRepairFrame repair(0, 1, 1, IOBuf::copyBuffer("repair"));
+  EXPECT_THROW(fecRecoverStreamFrame(peer, repair), QuicTransportException);
+}
+
+TEST_F(QuicFecFunctionsTest, WindowAdaptsToLoss) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  conn.fecState.window = kFecMaxWindow;
+  // 10 packets lost out of 100 shrink the window to 5 source frames.
+  conn.lossState.rtxCount = 10;
+  for (PacketNum packetNum = 0; packetNum < kFecAdaptationPackets;
+       ++packetNum) {
+    writeFrame(*stream, "data", false, packetNum);
+  }
+  EXPECT_EQ(5u, conn.fecState.window);
+
+  // No loss, back to the largest window.
+  for (PacketNum packetNum = kFecAdaptationPackets;
+       packetNum < 2 * kFecAdaptationPackets;
+       ++packetNum) {
+    writeFrame(*stream, "data", false, packetNum);
+  }
+  EXPECT_EQ(kFecMaxWindow, conn.fecState.window);
+}
+
+} // namespace test
+} // namespace quic
@@ -9,6 +9,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <quic/api/test/MockQuicStats.h>
 #include <quic/common/test/TestUtils.h>
 #include <quic/server/state/ServerStateMachine.h>
 #include <quic/state/QuicStateFunctions.h>
@@ -79,6 +80,90 @@ TEST_P(UpdateLargestReceivedPacketNumTest, ReceiveOld) {
       currentLargestReceived);
 }
 
+TEST_P(UpdateLargestReceivedPacketNumTest, PruneOldestAckRanges) {
+  QuicServerConnectionState conn;
+  MockQuicStats quicStats;
+  conn.infoCallback = &quicStats;
+  auto& ackState = getAckState(conn, GetParam());
+  uint64_t maxAckRanges = 4;
+  conn.transportSettings.maxAckRanges = maxAckRanges;
+  EXPECT_CALL(quicStats, onAckRangesPruned(1)).Times(6);
+  auto now = Clock::now();
+  for (PacketNum packetNum = 0; packetNum < 20; packetNum += 2) {
+    updateLargestReceivedPacketNum(ackState, packetNum, now);
+    pruneAckRanges(conn, ackState, now);
+  }
+  ASSERT_EQ(ackState.acks.size(), maxAckRanges);
+  EXPECT_EQ(ackState.acks.front().start, 12u);
+  EXPECT_EQ(ackState.acks.back().end, 18u);
+  EXPECT_EQ(*ackState.largestReceivedPacketNum, 18u);
+}
+
+TEST_P(UpdateLargestReceivedPacketNumTest, AgeOutAckRanges) {
+  QuicServerConnectionState conn;
+  MockQuicStats quicStats;
+  conn.infoCallback = &quicStats;
+  conn.lossState.srtt = 200ms;
+  conn.transportSettings.ackRangeAgeRtts = 10;
+  auto& ackState = getAckState(conn, GetParam());
+  auto start = Clock::now();
+  for (PacketNum packetNum = 0; packetNum < 6; packetNum += 2) {
+    updateLargestReceivedPacketNum(ackState, packetNum, start);
+    pruneAckRanges(conn, ackState, start);
+  }
+  EXPECT_EQ(ackState.acks.size(), 3u);
+
+  // Not old enough yet.
+  EXPECT_CALL(quicStats, onAckRangesPruned(_)).Times(0);
+  updateLargestReceivedPacketNum(ackState, 8, start + 1s);
+  pruneAckRanges(conn, ackState, start + 1s);
+  EXPECT_EQ(ackState.acks.size(), 4u);
+  Mock::VerifyAndClearExpectations(&quicStats);
+
+  // The first checkpoint was taken at packet 0.
+  EXPECT_CALL(quicStats, onAckRangesPruned(1));
+  updateLargestReceivedPacketNum(ackState, 10, start + 2s);
+  pruneAckRanges(conn, ackState, start + 2s);
+  EXPECT_EQ(ackState.acks.size(), 4u);
+  EXPECT_EQ(ackState.acks.front().start, 2u);
+  Mock::VerifyAndClearExpectations(&quicStats);
+
+  // Everything up to the checkpoint at packet 10 goes, but the range holding
+  // the largest received packet is kept.
+  EXPECT_CALL(quicStats, onAckRangesPruned(3));
+  pruneAckRanges(conn, ackState, start + 4s);
+  ASSERT_EQ(ackState.acks.size(), 1u);
+  EXPECT_EQ(ackState.acks.front().start, 10u);
+}
+
+TEST_P(UpdateLargestReceivedPacketNumTest, AgingDisabled) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.ackRangeAgeRtts = 0;
+  auto& ackState = getAckState(conn, GetParam());
+  auto start = Clock::now();
+  for (PacketNum packetNum = 0; packetNum < 6; packetNum += 2) {
+    auto now = start + std::chrono::seconds(packetNum * 10);
+    updateLargestReceivedPacketNum(ackState, packetNum, now);
+    pruneAckRanges(conn, ackState, now);
+  }
+  EXPECT_EQ(ackState.acks.size(), 3u);
+  EXPECT_FALSE(ackState.ageCheckpoint.hasValue());
+}
+
+TEST_P(UpdateLargestReceivedPacketNumTest, CountECNCodepoints) {
+  QuicServerConnectionState conn;
+  auto& ackState = getAckState(conn, GetParam());
+  updateECNCountsRecvd(ackState, ECNCodepoint::NotECT);
+  EXPECT_TRUE(ackState.ecnCountsRecvd.empty());
+  updateECNCountsRecvd(ackState, ECNCodepoint::ECT0);
+  updateECNCountsRecvd(ackState, ECNCodepoint::ECT0);
+  updateECNCountsRecvd(ackState, ECNCodepoint::ECT1);
+  updateECNCountsRecvd(ackState, ECNCodepoint::CE);
+  EXPECT_EQ(ackState.ecnCountsRecvd.ect0, 2);
+  EXPECT_EQ(ackState.ecnCountsRecvd.ect1, 1);
+  EXPECT_EQ(ackState.ecnCountsRecvd.ce, 1);
+}
+
 INSTANTIATE_TEST_CASE_P(
     UpdateLargestReceivedPacketNumTests,
     UpdateLargestReceivedPacketNumTest,
@@ -299,6 +384,40 @@ TEST_P(UpdateAckStateTest, UpdateAckSendStateOnRecvPacketsNonRxOutOfOrder) {
   EXPECT_FALSE(verifyToScheduleAckTimeout(conn));
 }
 
+TEST_P(UpdateAckStateTest, UpdateAckSendStateOnRecvPacketsAckFrequency) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  conn.transportSettings.ackFrequencyEnabled = true;
+  auto& ackState = getAckState(conn, GetParam());
+  handleAckFrequency(conn, AckFrequencyFrame(1, 20, 50ms, true));
+  EXPECT_EQ(conn.ackFrequencyState.maxAckDelay, 50ms);
+  // Out of order packets no longer trigger an immediate ack
+  updateAckSendStateOnRecvPacket(conn, ackState, true, true, false);
+  EXPECT_FALSE(verifyToAckImmediately(conn, ackState));
+  for (size_t i = 0; i < 18; i++) {
+    updateAckSendStateOnRecvPacket(conn, ackState, false, true, false);
+    EXPECT_FALSE(verifyToAckImmediately(conn, ackState));
+    EXPECT_TRUE(verifyToScheduleAckTimeout(conn));
+  }
+  updateAckSendStateOnRecvPacket(conn, ackState, false, true, false);
+  EXPECT_TRUE(verifyToAckImmediately(conn, ackState));
+
+  // A stale request is ignored
+  handleAckFrequency(conn, AckFrequencyFrame(0, 2, 5ms, false));
+  EXPECT_EQ(conn.ackFrequencyState.packetTolerance, 20);
+  EXPECT_TRUE(conn.ackFrequencyState.ignoreOrder);
+}
+
+TEST_F(UpdateAckStateTest, AckFrequencyNotAdvertised) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  EXPECT_THROW(
+      handleAckFrequency(conn, AckFrequencyFrame(0, 20, 50ms, false)),
+      QuicTransportException);
+  conn.transportSettings.ackFrequencyEnabled = true;
+  EXPECT_THROW(
+      handleAckFrequency(conn, AckFrequencyFrame(0, 20, 100us, false)),
+      QuicTransportException);
+}
+
 INSTANTIATE_TEST_CASE_P(
     UpdateAckStateTests,
     UpdateAckStateTest,
@@ -547,6 +666,233 @@ TEST_F(QuicStateFunctionsTest, EarliestLossTimer) {
   EXPECT_EQ(currentTime, earliestLossTimer(conn).first.value());
 }
 
+TEST_F(QuicStateFunctionsTest, UpdateAckFrequency) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.ackFrequencyEnabled = true;
+  conn.ackFrequencyState.peerMinAckDelay = 1ms;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+
+  // Nothing to ask for in slow start
+  EXPECT_CALL(*rawCongestionController, inSlowStart())
+      .WillRepeatedly(Return(true));
+  updateAckFrequency(conn);
+  EXPECT_TRUE(conn.pendingEvents.frames.empty());
+
+  EXPECT_CALL(*rawCongestionController, inSlowStart())
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(*rawCongestionController, getCongestionWindow())
+      .WillRepeatedly(Return(conn.udpSendPacketLen * 100));
+  updateAckFrequency(conn);
+  ASSERT_EQ(conn.pendingEvents.frames.size(), 1);
+  auto frame = boost::get<AckFrequencyFrame>(conn.pendingEvents.frames.front());
+  EXPECT_EQ(frame.sequenceNumber, 0);
+  EXPECT_EQ(frame.packetTolerance, 100 / kAckFrequencyCwndFraction);
+  EXPECT_EQ(frame.maxAckDelay, kMaxAckTimeout);
+
+  // Same window, no new request
+  updateAckFrequency(conn);
+  EXPECT_EQ(conn.pendingEvents.frames.size(), 1);
+
+  // A larger window supersedes the unsent request
+  EXPECT_CALL(*rawCongestionController, getCongestionWindow())
+      .WillRepeatedly(Return(conn.udpSendPacketLen * 1000));
+  updateAckFrequency(conn);
+  ASSERT_EQ(conn.pendingEvents.frames.size(), 1);
+  frame = boost::get<AckFrequencyFrame>(conn.pendingEvents.frames.front());
+  EXPECT_EQ(frame.sequenceNumber, 1);
+  EXPECT_EQ(frame.packetTolerance, kMaxAckFrequencyPacketTolerance);
+  EXPECT_EQ(conn.ackFrequencyState.latestRequest->sequenceNumber, 1);
+}
+
+TEST_F(QuicStateFunctionsTest, UpdateAckFrequencyOverloaded) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.ackFrequencyEnabled = true;
+  conn.ackFrequencyState.peerMinAckDelay = 1ms;
+  conn.overloadState.reduceAckFrequency = true;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+
+  // Reduced even in slow start
+  EXPECT_CALL(*rawCongestionController, inSlowStart())
+      .WillRepeatedly(Return(true));
+  updateAckFrequency(conn);
+  ASSERT_EQ(conn.pendingEvents.frames.size(), 1);
+  auto frame = boost::get<AckFrequencyFrame>(conn.pendingEvents.frames.front());
+  EXPECT_EQ(
+      frame.packetTolerance,
+      kRxPacketsPendingBeforeAckThresh * kOverloadAckFrequencyMultiplier);
+
+  // Still capped
+  EXPECT_CALL(*rawCongestionController, inSlowStart())
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(*rawCongestionController, getCongestionWindow())
+      .WillRepeatedly(Return(conn.udpSendPacketLen * 1000));
+  updateAckFrequency(conn);
+  frame = boost::get<AckFrequencyFrame>(conn.pendingEvents.frames.front());
+  EXPECT_EQ(frame.packetTolerance, kMaxAckFrequencyPacketTolerance);
+}
+
+TEST_F(QuicStateFunctionsTest, PmtuDiscoverySearch) {
+  QuicServerConnectionState conn;
+  auto now = Clock::now();
+  EXPECT_FALSE(getPmtuProbeSize(conn, now).hasValue());
+
+  conn.udpSendPacketLen = 1200;
+  conn.transportSettings.maxPmtuProbeSize = 9000;
+  startPmtuDiscovery(conn, 1500);
+  EXPECT_EQ(conn.pmtuDiscoveryState.maxPacketLen, 1500);
+  auto probeSize = getPmtuProbeSize(conn, now);
+  ASSERT_TRUE(probeSize.hasValue());
+  EXPECT_GT(*probeSize, 1200);
+  EXPECT_LE(*probeSize, 1500);
+
+  // Only one probe in flight
+  onPmtuProbeSent(conn, 10, *probeSize);
+  EXPECT_FALSE(getPmtuProbeSize(conn, now).hasValue());
+  onPmtuPacketAcked(conn, 10, *probeSize, now);
+  EXPECT_EQ(conn.udpSendPacketLen, *probeSize);
+
+  // Losing kPmtuMaxProbes probes of a size ends the search below it.
+  auto failedSize = *getPmtuProbeSize(conn, now);
+  for (uint64_t i = 0; i < kPmtuMaxProbes; ++i) {
+    EXPECT_EQ(*getPmtuProbeSize(conn, now), failedSize);
+    onPmtuProbeSent(conn, 20 + i, failedSize);
+    EXPECT_TRUE(onPmtuPacketLost(conn, 20 + i, failedSize, now));
+  }
+  EXPECT_EQ(conn.pmtuDiscoveryState.searchHigh, failedSize);
+  EXPECT_EQ(conn.udpSendPacketLen, *probeSize);
+
+  // Keep going until the search completes.
+  PacketNum packetNum = 100;
+  while (auto size = getPmtuProbeSize(conn, now)) {
+    EXPECT_LT(*size, failedSize);
+    onPmtuProbeSent(conn, packetNum, *size);
+    onPmtuPacketAcked(conn, packetNum++, *size, now);
+  }
+  EXPECT_GE(conn.udpSendPacketLen + kPmtuSearchPrecision, failedSize);
+  ASSERT_TRUE(conn.pmtuDiscoveryState.nextSearchTime.hasValue());
+  EXPECT_TRUE(getPmtuProbeSize(conn, now + kPmtuRaiseTimeout).hasValue());
+}
+
+TEST_F(QuicStateFunctionsTest, PmtuDiscoveryBlackHole) {
+  QuicServerConnectionState conn;
+  auto now = Clock::now();
+  conn.udpSendPacketLen = 1200;
+  startPmtuDiscovery(conn, 1500);
+  auto probeSize = *getPmtuProbeSize(conn, now);
+  onPmtuProbeSent(conn, 1, probeSize);
+  onPmtuPacketAcked(conn, 1, probeSize, now);
+  ASSERT_EQ(conn.udpSendPacketLen, probeSize);
+
+  // An ack of a large packet restarts the count
+  PacketNum packetNum = 10;
+  for (uint64_t i = 0; i < kPmtuBlackHoleThreshold - 1; ++i) {
+    EXPECT_FALSE(onPmtuPacketLost(conn, packetNum++, probeSize, now));
+  }
+  onPmtuPacketAcked(conn, packetNum++, probeSize, now);
+  for (uint64_t i = 0; i < kPmtuBlackHoleThreshold - 1; ++i) {
+    onPmtuPacketLost(conn, packetNum++, probeSize, now);
+  }
+  EXPECT_EQ(conn.udpSendPacketLen, probeSize);
+  onPmtuPacketLost(conn, packetNum++, probeSize, now);
+  EXPECT_EQ(conn.udpSendPacketLen, 1200);
+  EXPECT_EQ(conn.pmtuDiscoveryState.searchHigh, probeSize);
+}
+
+TEST_F(QuicStateFunctionsTest, ConnectionBufferedBytes) {
+  QuicServerConnectionState conn;
+  EXPECT_EQ(getConnectionBufferedBytes(conn), 0u);
+  conn.flowControlState.sumMaxObservedOffset = 3000;
+  conn.flowControlState.sumCurReadOffset = 1000;
+  conn.flowControlState.sumCurStreamBufferLen = 500;
+  conn.cryptoState->handshakeStream.writeBuffer.append(
+      folly::IOBuf::copyBuffer("finished"));
+  conn.outstandingPackets.emplace_back(
+      makeTestShortPacket(), Clock::now(), 100, false, false, 100);
+  EXPECT_EQ(getConnectionBufferedBytes(conn), 2508u + conn.udpSendPacketLen);
+}
+
+TEST_F(QuicStateFunctionsTest, WriteLimitedTime) {
+  QuicServerConnectionState conn;
+  auto app = static_cast<size_t>(WriteLimiter::App);
+  auto cwnd = static_cast<size_t>(WriteLimiter::Cwnd);
+  auto now = Clock::now();
+  EXPECT_EQ(0us, getWriteLimitedTime(conn, now)[app]);
+
+  updateWriteLimiter(conn, WriteLimiter::App, now);
+  updateWriteLimiter(conn, WriteLimiter::App, now + 5ms);
+  updateWriteLimiter(conn, WriteLimiter::Cwnd, now + 10ms);
+  auto time = getWriteLimitedTime(conn, now + 25ms);
+  EXPECT_EQ(10ms, time[app]);
+  EXPECT_EQ(15ms, time[cwnd]);
+  // The current period is only accounted for once it ends.
+  EXPECT_EQ(0us, conn.writeLimiter.time[cwnd]);
+
+  updateWriteLimiter(conn, WriteLimiter::None, now + 30ms);
+  EXPECT_EQ(20ms, conn.writeLimiter.time[cwnd]);
+  EXPECT_EQ(WriteLimiter::None, conn.writeLimiter.current);
+}
+
+TEST_F(QuicStateFunctionsTest, DiscardHandshakeSpaces) {
+  QuicServerConnectionState conn;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  conn.initialWriteCipher = createNoOpAead();
+  conn.handshakeWriteCipher = createNoOpAead();
+  conn.readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
+  conn.readCodec->setHandshakeReadCipher(createNoOpAead());
+  conn.cryptoState->handshakeStream.writeBuffer.append(
+      folly::IOBuf::copyBuffer("finished"));
+  conn.ackStates.handshakeAckState.acks.insert(1, 5);
+  conn.ackStates.handshakeAckState.needsToSendAckImmediately = true;
+  conn.ackStates.handshakeAckState.nextPacketNum = 7;
+  conn.lossState.handshakeLossTime = Clock::now();
+
+  conn.outstandingPackets.emplace_back(
+      makeTestLongPacket(LongHeader::Types::Initial),
+      Clock::now(),
+      1200,
+      true,
+      false,
+      0);
+  conn.outstandingPackets.emplace_back(
+      makeTestLongPacket(LongHeader::Types::Handshake),
+      Clock::now(),
+      50,
+      false,
+      true,
+      0);
+  conn.outstandingPackets.emplace_back(
+      makeTestShortPacket(), Clock::now(), 1000, false, false, 0);
+  conn.outstandingHandshakePacketsCount = 1;
+  conn.outstandingPureAckPacketsCount = 1;
+
+  // The pure ack was never in flight.
+  EXPECT_CALL(*rawCongestionController, onRemoveBytesFromInflight(1200));
+  discardHandshakeSpaces(conn);
+  EXPECT_TRUE(conn.handshakeSpacesDiscarded);
+  EXPECT_EQ(conn.initialWriteCipher, nullptr);
+  EXPECT_EQ(conn.handshakeWriteCipher, nullptr);
+  EXPECT_EQ(conn.readCodec->getHandshakeReadCipher(), nullptr);
+  EXPECT_TRUE(conn.cryptoState->handshakeStream.writeBuffer.empty());
+  EXPECT_TRUE(conn.ackStates.handshakeAckState.acks.empty());
+  EXPECT_FALSE(conn.ackStates.handshakeAckState.needsToSendAckImmediately);
+  EXPECT_EQ(conn.ackStates.handshakeAckState.nextPacketNum, 7u);
+  EXPECT_FALSE(conn.lossState.handshakeLossTime.hasValue());
+  ASSERT_EQ(conn.outstandingPackets.size(), 1u);
+  EXPECT_EQ(conn.outstandingPackets.front().encodedSize, 1000u);
+  EXPECT_EQ(conn.outstandingHandshakePacketsCount, 0u);
+  EXPECT_EQ(conn.outstandingPureAckPacketsCount, 0u);
+
+  // Only once.
+  EXPECT_CALL(*rawCongestionController, onRemoveBytesFromInflight(_)).Times(0);
+  discardHandshakeSpaces(conn);
+}
+
 INSTANTIATE_TEST_CASE_P(
     QuicStateFunctionsTests,
     QuicStateFunctionsTest,
@@ -11,8 +11,10 @@
 
 #include <quic/state/QuicStreamFunctions.h>
 
+#include <quic/api/test/MockQuicStats.h>
 #include <quic/client/state/ClientStateMachine.h>
 #include <quic/common/test/TestUtils.h>
+#include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/server/state/ServerStateMachine.h>
 
 using namespace folly;
@@ -106,6 +108,109 @@ TEST_F(QuicStreamFunctionsTest, TestWriteStream) {
   EXPECT_TRUE(eq(stream->writeBuffer.move(), buf1));
 }
 
+TEST_F(QuicStreamFunctionsTest, TestWriteStreamCoalescesSmallWrites) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  conn.transportSettings.writeCoalesceThreshold = 100;
+  std::string expected;
+  for (int i = 0; i < 10; ++i) {
+    auto data = folly::to<std::string>("message ", i, " ");
+    writeDataToQuicStream(*stream, IOBuf::copyBuffer(data), false);
+    expected += data;
+  }
+  EXPECT_EQ(stream->writeBuffer.front()->countChainElements(), 1u);
+
+  // Writes above the threshold are chained without copying.
+  auto large = IOBuf::copyBuffer(std::string(200, 'a'));
+  auto largeData = large->data();
+  writeDataToQuicStream(*stream, std::move(large), false);
+  expected += std::string(200, 'a');
+  EXPECT_EQ(stream->writeBuffer.front()->countChainElements(), 2u);
+  EXPECT_EQ(stream->writeBuffer.front()->prev()->data(), largeData);
+  EXPECT_EQ(
+      expected, stream->writeBuffer.move()->moveToFbString().toStdString());
+}
+
+TEST_F(QuicStreamFunctionsTest, TestStreamBufferedBytes) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  EXPECT_EQ(getStreamReadBufferedBytes(*stream), 0u);
+  EXPECT_EQ(getStreamWriteBufferedBytes(*stream), 0u);
+
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(IOBuf::copyBuffer("I just met you"), 0));
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(IOBuf::copyBuffer("crazy"), 20, true));
+  EXPECT_EQ(getStreamReadBufferedBytes(*stream), 19u);
+
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer("so call me"), false);
+  stream->retransmissionBuffer.emplace_back(
+      IOBuf::copyBuffer("here's my"), 0, false);
+  stream->lossBuffer.emplace_back(IOBuf::copyBuffer("number"), 9, false);
+  EXPECT_EQ(getStreamWriteBufferedBytes(*stream), 25u);
+}
+
+TEST_F(QuicStreamFunctionsTest, TestStreamSchedulingQuantum) {
+  conn.udpSendPacketLen = 1000;
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  auto urgency = stream->priority.urgency;
+  stream->weight = 2;
+  writeDataToQuicStream(*stream, buildRandomInputData(10000), false);
+  EXPECT_EQ(getStreamSchedulingQuantumLeft(*stream), 2000u);
+
+  // The packet filled up mid turn.
+  updateStreamSchedulingQuantum(*stream, 1500);
+  EXPECT_EQ(getStreamSchedulingQuantumLeft(*stream), 500u);
+  EXPECT_EQ(conn.schedulingState.nextScheduledStream[urgency], stream->id);
+
+  // The quantum is used up, the turn passes on and the next one is full.
+  updateStreamSchedulingQuantum(*stream, 500);
+  EXPECT_EQ(stream->schedulingQuantumLeft, 0u);
+  EXPECT_EQ(getStreamSchedulingQuantumLeft(*stream), 2000u);
+  EXPECT_EQ(
+      conn.schedulingState.nextScheduledStream[urgency], stream->id + 1);
+}
+
+TEST_F(QuicStreamFunctionsTest, TestTimeToFirstByte) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  EXPECT_FALSE(stream->awaitingFirstByteSince);
+
+  NiceMock<MockQuicStats> stats;
+  conn.infoCallback = &stats;
+  // Server initiated bidirectional stream.
+  auto peerStream = conn.streamManager->getStream(1);
+  EXPECT_FALSE(peerStream->awaitingFirstByteSince);
+  stream = conn.streamManager->createNextBidirectionalStream().value();
+  EXPECT_TRUE(stream->awaitingFirstByteSince);
+  appendDataToReadBuffer(*stream, StreamBuffer(nullptr, 0, false));
+  EXPECT_TRUE(stream->awaitingFirstByteSince);
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("a"), 0));
+  EXPECT_FALSE(stream->awaitingFirstByteSince);
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("b"), 1));
+  appendDataToReadBuffer(*peerStream, StreamBuffer(IOBuf::copyBuffer("c"), 0));
+  EXPECT_EQ(1, conn.latencies.streamTimeToFirstByte.count);
+}
+
+TEST_F(QuicStreamFunctionsTest, TestLatencyHistogramBuckets) {
+  LatencyHistogram histogram;
+  histogram.add(0us);
+  histogram.add(1us);
+  histogram.add(3us);
+  histogram.add(1000us);
+  histogram.add(1h);
+  EXPECT_EQ(1, histogram.buckets[0]);
+  EXPECT_EQ(1, histogram.buckets[1]);
+  EXPECT_EQ(1, histogram.buckets[2]);
+  EXPECT_EQ(1, histogram.buckets[10]);
+  EXPECT_EQ(1, histogram.buckets[LatencyHistogram::kNumBuckets - 1]);
+  EXPECT_EQ(5, histogram.count);
+  EXPECT_EQ(std::chrono::microseconds(1h), histogram.max);
+
+  LatencyHistogram other;
+  other.add(2us);
+  histogram.merge(other);
+  EXPECT_EQ(2, histogram.buckets[2]);
+  EXPECT_EQ(6, histogram.count);
+}
+
 TEST_F(QuicStreamFunctionsTest, TestReadDataWrittenInOrder) {
   auto stream = conn.streamManager->createNextBidirectionalStream().value();
   auto streamLastMaxOffset = stream->maxOffsetObserved;
@@ -359,6 +464,29 @@ TEST_F(QuicStreamFunctionsTest, TestReadDataFromMultipleBufs) {
   EXPECT_EQ(nullptr, readData2.first);
 }
 
+TEST_F(QuicStreamFunctionsTest, TestReadDataWithoutCredit) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  auto windowSize = stream->flowControlState.windowSize;
+  stream->flowControlState.advertisedMaxOffset = windowSize;
+  conn.flowControlState.advertisedMaxOffset =
+      conn.flowControlState.windowSize;
+  auto data = buildRandomInputData(windowSize);
+  appendDataToReadBuffer(*stream, StreamBuffer(data->clone(), 0));
+
+  auto readData = readDataFromQuicStreamWithoutCredit(*stream);
+  EXPECT_FALSE(readData.second);
+  EXPECT_EQ(readData.first->computeChainDataLength(), windowSize);
+  EXPECT_EQ(stream->flowControlState.unreleasedReadBytes, windowSize);
+  EXPECT_EQ(conn.flowControlState.sumCurReadOffset, 0);
+  // Reading the whole window would have sent a window update.
+  EXPECT_FALSE(conn.streamManager->pendingWindowUpdate(stream->id));
+
+  updateFlowControlOnReadRelease(*stream, windowSize, Clock::now());
+  EXPECT_EQ(stream->flowControlState.unreleasedReadBytes, 0);
+  EXPECT_EQ(conn.flowControlState.sumCurReadOffset, windowSize);
+  EXPECT_TRUE(conn.streamManager->pendingWindowUpdate(stream->id));
+}
+
 TEST_F(QuicStreamFunctionsTest, TestReadDataOutOfOrder) {
   auto stream = conn.streamManager->createNextBidirectionalStream().value();
   auto buf1 = IOBuf::copyBuffer(" you ");
@@ -399,6 +527,33 @@ TEST_F(QuicStreamFunctionsTest, TestReadDataOutOfOrder) {
   EXPECT_TRUE(readData4.second);
 }
 
+TEST_F(QuicStreamFunctionsTest, TestInOrderDataAfterHoleIsMerged) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(IOBuf::copyBuffer("this is crazy. "), 19));
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(IOBuf::copyBuffer("Here's my number "), 34));
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(IOBuf::copyBuffer("so call me maybe"), 51, true));
+  // Contiguous data behind the hole ends up in a single buffer.
+  EXPECT_EQ(stream->readBuffer.size(), 1);
+  EXPECT_EQ(stream->readBuffer.back().offset, 19);
+
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(IOBuf::copyBuffer("I just met "), 0));
+  EXPECT_EQ(stream->readBuffer.size(), 2);
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(IOBuf::copyBuffer("you and "), 11));
+  EXPECT_EQ(stream->readBuffer.size(), 1);
+
+  auto readData = readDataFromQuicStream(*stream);
+  EXPECT_EQ(
+      "I just met you and this is crazy. Here's my number so call me maybe",
+      readData.first->moveToFbString().toStdString());
+  EXPECT_TRUE(readData.second);
+  EXPECT_TRUE(stream->readBuffer.empty());
+}
+
 TEST_F(QuicStreamFunctionsTest, TestReadOverlappingData) {
   auto stream = conn.streamManager->createNextBidirectionalStream().value();
   auto buf1 = IOBuf::copyBuffer("I just met you ");
@@ -886,10 +1041,7 @@ TEST_F(QuicServerStreamFunctionsTest, GetOrCreateClientOutOfOrderStream) {
       conn.streamManager->openPeerStreams().size(),
       ((outOfOrderStream) / kStreamIncrement) + 1);
 
-  conn.streamManager->openPeerStreams().erase(std::find(
-      conn.streamManager->openPeerStreams().begin(),
-      conn.streamManager->openPeerStreams().end(),
-      closedStream));
+  conn.streamManager->openPeerStreams().erase(closedStream);
   EXPECT_EQ(conn.streamManager->getStream(closedStream), nullptr);
 }
 
@@ -916,10 +1068,7 @@ TEST_F(QuicServerStreamFunctionsTest, GetOrCreateClosedClientStream) {
   StreamId outOfOrderStream1 = 100;
   StreamId closedStream = 48;
   conn.streamManager->getStream(outOfOrderStream1);
-  conn.streamManager->openPeerStreams().erase(std::find(
-      conn.streamManager->openPeerStreams().begin(),
-      conn.streamManager->openPeerStreams().end(),
-      closedStream));
+  conn.streamManager->openPeerStreams().erase(closedStream);
   EXPECT_EQ(conn.streamManager->getStream(closedStream), nullptr);
 }
 
@@ -929,10 +1078,7 @@ TEST_F(
   StreamId outOfOrderStream1 = 96;
   StreamId outOfOrderStream2 = 100;
   conn.streamManager->getStream(outOfOrderStream1);
-  conn.streamManager->openPeerStreams().erase(std::find(
-      conn.streamManager->openPeerStreams().begin(),
-      conn.streamManager->openPeerStreams().end(),
-      outOfOrderStream1));
+  conn.streamManager->openPeerStreams().erase(outOfOrderStream1);
   conn.streamManager->getStream(outOfOrderStream2);
   EXPECT_EQ(
       conn.streamManager->openPeerStreams().size(),
@@ -943,10 +1089,7 @@ TEST_F(QuicStreamFunctionsTest, GetOrCreateServerStreamAfterClosingLastStream) {
   StreamId outOfOrderStream1 = 97;
   StreamId outOfOrderStream2 = 101;
   conn.streamManager->getStream(outOfOrderStream1);
-  conn.streamManager->openPeerStreams().erase(std::find(
-      conn.streamManager->openPeerStreams().begin(),
-      conn.streamManager->openPeerStreams().end(),
-      outOfOrderStream1));
+  conn.streamManager->openPeerStreams().erase(outOfOrderStream1);
   conn.streamManager->getStream(outOfOrderStream2);
   EXPECT_EQ(
       conn.streamManager->openPeerStreams().size(),
@@ -957,10 +1100,7 @@ TEST_F(QuicStreamFunctionsTest, GetOrCreateClosedServerStream) {
   StreamId outOfOrderStream1 = 97;
   StreamId closedStream = 49;
   conn.streamManager->getStream(outOfOrderStream1);
-  conn.streamManager->openPeerStreams().erase(std::find(
-      conn.streamManager->openPeerStreams().begin(),
-      conn.streamManager->openPeerStreams().end(),
-      closedStream));
+  conn.streamManager->openPeerStreams().erase(closedStream);
   EXPECT_EQ(conn.streamManager->getStream(closedStream), nullptr);
 }
 
@@ -1281,6 +1421,90 @@ TEST_F(QuicStreamFunctionsTest, UpdatesLastHolbTime) {
   EXPECT_TRUE(stream->lastHolbTime);
 }
 
+TEST_F(QuicStreamFunctionsTest, CountsReadGapsAndReassembly) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("efgh"), 4));
+  conn.streamManager->updateReadableStreams(*stream);
+  EXPECT_EQ(1, stream->readGapCount);
+  EXPECT_EQ(8, stream->maxReassemblyBytes);
+
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("mn"), 12));
+  conn.streamManager->updateReadableStreams(*stream);
+  EXPECT_EQ(2, stream->readGapCount);
+  EXPECT_EQ(14, stream->maxReassemblyBytes);
+
+  // Splits the gap between 8 and 12 in two.
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("j"), 9));
+  EXPECT_EQ(3, stream->readGapCount);
+  // Filling a gap or extending the data before another one opens none.
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("abcd"), 0));
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("op"), 14));
+  conn.streamManager->updateReadableStreams(*stream);
+  EXPECT_EQ(3, stream->readGapCount);
+  EXPECT_FALSE(stream->lastHolbTime);
+
+  readDataFromQuicStream(*stream);
+  EXPECT_TRUE(stream->lastHolbTime);
+  // What is left to reassemble after the read spans less than before.
+  EXPECT_EQ(14, stream->maxReassemblyBytes);
+}
+
+TEST_F(QuicStreamFunctionsTest, ReassemblyBytes) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("efgh"), 4));
+  conn.streamManager->updateReadableStreams(*stream);
+  EXPECT_EQ(8, stream->reassemblyBytes);
+  EXPECT_EQ(8, conn.streamManager->reassemblyBytes());
+
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("abc"), 0));
+  conn.streamManager->updateReadableStreams(*stream);
+  // Only the byte missing at 3 is left to reassemble.
+  EXPECT_EQ(5, conn.streamManager->reassemblyBytes());
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("d"), 3));
+  conn.streamManager->updateReadableStreams(*stream);
+  EXPECT_EQ(0, stream->reassemblyBytes);
+  EXPECT_EQ(0, conn.streamManager->reassemblyBytes());
+}
+
+TEST_F(QuicStreamFunctionsTest, ExceedsReassemblyBudget) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("efgh"), 4));
+  conn.streamManager->updateReadableStreams(*stream);
+  auto makePacket = [](std::vector<ReadStreamFrame> frames) {
+    RegularQuicPacket packet(
+        ShortHeader(ProtectionType::KeyPhaseZero, getTestConnectionId()));
+    for (auto& frame : frames) {
+      packet.frames.emplace_back(std::move(frame));
+    }
+    return packet;
+  };
+  auto frame = [](StreamId id, uint64_t offset, size_t len) {
+    return ReadStreamFrame(
+        id, offset, IOBuf::copyBuffer(std::string(len, 'x')), false);
+  };
+  auto farAhead = makePacket({frame(stream->id, 10, 4)});
+  EXPECT_FALSE(exceedsReassemblyBudget(conn, farAhead));
+
+  conn.transportSettings.reassemblyBudget = 10;
+  // 8 bytes held, up to 14 with the frame.
+  EXPECT_TRUE(exceedsReassemblyBudget(conn, farAhead));
+  EXPECT_FALSE(
+      exceedsReassemblyBudget(conn, makePacket({frame(stream->id, 8, 2)})));
+  // Filling a gap takes no more reassembly.
+  EXPECT_FALSE(
+      exceedsReassemblyBudget(conn, makePacket({frame(stream->id, 2, 1)})));
+  // Data the stream can read lets the whole packet through.
+  EXPECT_FALSE(exceedsReassemblyBudget(
+      conn, makePacket({frame(stream->id, 10, 4), frame(stream->id, 0, 2)})));
+  // A stream the peer is yet to open.
+  auto peerStreamId = stream->id + 1;
+  ASSERT_EQ(nullptr, conn.streamManager->findStream(peerStreamId));
+  EXPECT_TRUE(
+      exceedsReassemblyBudget(conn, makePacket({frame(peerStreamId, 4, 1)})));
+  EXPECT_FALSE(
+      exceedsReassemblyBudget(conn, makePacket({frame(peerStreamId, 0, 20)})));
+}
+
 TEST_F(QuicStreamFunctionsTest, HolbTimingUpdateReadingListIdempotentWrtHolb) {
   // test that calling uRL in succession (without new data or readsd)
   // does not affect the HOLB state
@@ -1511,7 +1735,7 @@ TEST_F(QuicStreamFunctionsTest, RemovedClosedState) {
   auto streamId = stream->id;
   conn.streamManager->readableStreams().emplace(streamId);
   conn.streamManager->peekableStreams().emplace(streamId);
-  conn.streamManager->addWritable(streamId);
+  conn.streamManager->addWritable(*stream);
   conn.streamManager->queueBlocked(streamId, 0);
   conn.streamManager->addDeliverable(streamId);
   conn.streamManager->addLoss(streamId);
@@ -1691,11 +1915,7 @@ TEST_F(QuicStreamFunctionsTest, StreamExists) {
   EXPECT_TRUE(conn.streamManager->streamExists(peerStream));
   EXPECT_TRUE(conn.streamManager->streamExists(peerAutoOpened));
 
-  auto it = std::find(
-      conn.streamManager->openPeerStreams().begin(),
-      conn.streamManager->openPeerStreams().end(),
-      peerAutoOpened);
-  conn.streamManager->openPeerStreams().erase(it);
+  conn.streamManager->openPeerStreams().erase(peerAutoOpened);
 
   conn.streamManager->removeClosedStream(peerStream);
 
@@ -1855,6 +2075,32 @@ TEST_F(QuicStreamFunctionsTest, LossBufferStillHasData) {
   EXPECT_TRUE(conn.streamManager->hasLoss());
 }
 
+TEST_F(QuicStreamFunctionsTest, InsertIntoLossBufferMergesContiguous) {
+  QuicStreamState stream(3, conn);
+  insertIntoLossBuffer(stream, StreamBuffer(IOBuf::copyBuffer("ghi"), 6));
+  insertIntoLossBuffer(stream, StreamBuffer(IOBuf::copyBuffer("abc"), 0));
+  // Neither contiguous to the data before nor after it.
+  insertIntoLossBuffer(
+      stream, StreamBuffer(IOBuf::copyBuffer("xyz"), 20, true));
+  EXPECT_EQ(3u, stream.lossBuffer.size());
+
+  // Fills the gap between the first two.
+  insertIntoLossBuffer(stream, StreamBuffer(IOBuf::copyBuffer("def"), 3));
+  ASSERT_EQ(2u, stream.lossBuffer.size());
+  EXPECT_EQ(0u, stream.lossBuffer[0].offset);
+  EXPECT_FALSE(stream.lossBuffer[0].eof);
+  IOBufEqualTo eq;
+  EXPECT_TRUE(eq(
+      *IOBuf::copyBuffer("abcdefghi"), *stream.lossBuffer[0].data.front()));
+
+  // Merges into the last one, which carries the FIN.
+  insertIntoLossBuffer(stream, StreamBuffer(IOBuf::copyBuffer("uvw"), 17));
+  ASSERT_EQ(2u, stream.lossBuffer.size());
+  EXPECT_EQ(17u, stream.lossBuffer[1].offset);
+  EXPECT_TRUE(stream.lossBuffer[1].eof);
+  EXPECT_EQ(6u, stream.lossBuffer[1].data.chainLength());
+}
+
 TEST_F(QuicStreamFunctionsTest, WritableList) {
   StreamId id = 3;
   QuicStreamState stream(id, conn);
@@ -1897,6 +2143,35 @@ TEST_F(QuicStreamFunctionsTest, AckCryptoStream) {
   EXPECT_EQ(conn.cryptoState->handshakeStream.retransmissionBuffer.size(), 0);
 }
 
+TEST_F(QuicStreamFunctionsTest, WriteCryptoStreamContiguous) {
+  auto& cryptoStream = conn.cryptoState->handshakeStream;
+  auto ee = IOBuf::copyBuffer("EncryptedExtensions");
+  ee->prependChain(IOBuf::copyBuffer("Certificate"));
+  writeDataToQuicStream(cryptoStream, std::move(ee));
+  writeDataToQuicStream(cryptoStream, IOBuf::copyBuffer("Finished"));
+  writeDataToQuicStream(cryptoStream, nullptr);
+  auto data = cryptoStream.writeBuffer.move();
+  EXPECT_FALSE(data->isChained());
+  EXPECT_EQ("EncryptedExtensionsCertificateFinished", data->moveToFbString());
+}
+
+TEST_F(QuicStreamFunctionsTest, ReleaseHandshakeCryptoStreams) {
+  auto& cryptoState = *conn.cryptoState;
+  cryptoState.initialStream.retransmissionBuffer.emplace_back(
+      StreamBuffer(IOBuf::copyBuffer("SHLO"), 0));
+  cryptoState.initialStream.currentWriteOffset = 4;
+  writeDataToQuicStream(cryptoState.handshakeStream, IOBuf::copyBuffer("EE"));
+  cryptoState.handshakeStream.lossBuffer.emplace_back(
+      StreamBuffer(IOBuf::copyBuffer("Cert"), 0));
+  writeDataToQuicStream(cryptoState.oneRttStream, IOBuf::copyBuffer("NST"));
+  releaseHandshakeCryptoStreams(cryptoState);
+  EXPECT_TRUE(cryptoState.initialStream.retransmissionBuffer.empty());
+  EXPECT_EQ(cryptoState.initialStream.currentWriteOffset, 4u);
+  EXPECT_TRUE(cryptoState.handshakeStream.writeBuffer.empty());
+  EXPECT_TRUE(cryptoState.handshakeStream.lossBuffer.empty());
+  EXPECT_FALSE(cryptoState.oneRttStream.writeBuffer.empty());
+}
+
 TEST_F(QuicStreamFunctionsTest, AckCryptoStreamOffsetLengthMismatch) {
   auto chlo = IOBuf::copyBuffer("CHLO");
   auto& cryptoStream = conn.cryptoState->handshakeStream;
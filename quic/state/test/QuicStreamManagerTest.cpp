@@ -179,5 +179,112 @@ TEST_F(QuicStreamManagerTest, TestAppIdleCloseControlStream) {
   manager.removeClosedStream(stream->id);
   EXPECT_TRUE(manager.isAppIdle());
 }
+
+TEST_F(QuicStreamManagerTest, ImplicitlyOpenedPeerStreams) {
+  auto& manager = *conn.streamManager;
+  manager.getStream(0x10);
+  EXPECT_EQ(manager.streamCount(), 1u);
+  EXPECT_EQ(manager.openPeerStreams().size(), 5u);
+  std::deque<StreamId> newStreams = {0x0, 0x4, 0x8, 0xc, 0x10};
+  EXPECT_EQ(manager.newPeerStreams(), newStreams);
+
+  // Only the streams opened since are new.
+  manager.clearNewPeerStreams();
+  manager.getStream(0x8);
+  manager.getStream(0x18);
+  EXPECT_EQ(manager.streamCount(), 3u);
+  EXPECT_EQ(manager.openPeerStreams().size(), 7u);
+  newStreams = {0x14, 0x18};
+  EXPECT_EQ(manager.newPeerStreams(), newStreams);
+}
+
+TEST_F(QuicStreamManagerTest, CloseImplicitlyOpenedPeerStreams) {
+  auto& manager = *conn.streamManager;
+  // Past the first word of the bitmap, and in both directions.
+  manager.getStream(0x190);
+  manager.getStream(0x6);
+  EXPECT_EQ(manager.openPeerStreams().size(), 103u);
+  EXPECT_TRUE(manager.streamExists(0x100));
+  EXPECT_TRUE(manager.streamExists(0x2));
+  EXPECT_FALSE(manager.streamExists(0xa));
+  EXPECT_FALSE(manager.streamExists(0x194));
+
+  for (StreamId id = 0; id < 0x190; id += 4) {
+    EXPECT_TRUE(manager.openPeerStreams().erase(id));
+  }
+  EXPECT_FALSE(manager.openPeerStreams().erase(0x100));
+  EXPECT_FALSE(manager.streamExists(0x100));
+  EXPECT_EQ(manager.getStream(0x100), nullptr);
+  std::deque<StreamId> openStreams = {0x2, 0x6, 0x190};
+  EXPECT_EQ(manager.openPeerStreams().sortedIds(), openStreams);
+
+  // Only the streams above the closed ones can be opened.
+  manager.getStream(0x198);
+  EXPECT_TRUE(manager.streamExists(0x194));
+  EXPECT_EQ(manager.openPeerStreams().size(), 5u);
+}
+
+TEST_F(QuicStreamManagerTest, OpenNextStreamsBatch) {
+  auto& manager = *conn.streamManager;
+  manager.setMaxLocalBidirectionalStreams(4, true);
+  auto uni = manager.createNextUnidirectionalStream();
+  ASSERT_FALSE(uni.hasError());
+
+  auto ids = manager.openNextBidirectionalStreams(3);
+  ASSERT_FALSE(ids.hasError());
+  EXPECT_EQ(std::vector<StreamId>({1, 5, 9}), ids.value());
+  EXPECT_EQ(manager.openableLocalBidirectionalStreams(), 1u);
+  // The open streams stay sorted across both directions.
+  std::deque<StreamId> openStreams = {1, 3, 5, 9};
+  EXPECT_EQ(manager.openLocalStreams().sortedIds(), openStreams);
+  for (auto id : ids.value()) {
+    EXPECT_TRUE(manager.streamExists(id));
+    ASSERT_NE(manager.getStream(id), nullptr);
+  }
+
+  // All or nothing past the limit.
+  auto exceeded = manager.openNextBidirectionalStreams(2);
+  ASSERT_TRUE(exceeded.hasError());
+  EXPECT_EQ(exceeded.error(), LocalErrorCode::STREAM_LIMIT_EXCEEDED);
+  EXPECT_EQ(manager.openableLocalBidirectionalStreams(), 1u);
+
+  auto next = manager.createNextBidirectionalStream();
+  ASSERT_FALSE(next.hasError());
+  EXPECT_EQ(next.value()->id, 13);
+  EXPECT_TRUE(manager.openNextBidirectionalStreams(0).value().empty());
+}
+
+TEST_F(QuicStreamManagerTest, RemoteStreamCreditBatched) {
+  auto& manager = *conn.streamManager;
+  conn.transportSettings.streamLimitWindowingFraction = 2;
+  manager.setInitialMaxRemoteStreams(4, 4);
+  EXPECT_EQ(manager.openableRemoteBidirectionalStreams(), 4u);
+  EXPECT_THROW(manager.getStream(16), QuicTransportException);
+
+  auto closeStream = [&](StreamId id) {
+    auto stream = manager.getStream(id);
+    ASSERT_NE(stream, nullptr);
+    stream->send.state = StreamSendStates::Closed();
+    stream->recv.state = StreamReceiveStates::Closed();
+    manager.removeClosedStream(id);
+  };
+  closeStream(0);
+  EXPECT_FALSE(manager.hasStreamLimitUpdates());
+  closeStream(4);
+  ASSERT_TRUE(manager.remoteBidirectionalStreamLimitUpdate().hasValue());
+  EXPECT_EQ(*manager.remoteBidirectionalStreamLimitUpdate(), 6u);
+  EXPECT_FALSE(manager.remoteUnidirectionalStreamLimitUpdate().hasValue());
+  // Both streams were replaced, the peer can open 4 more at once again.
+  EXPECT_EQ(manager.openableRemoteBidirectionalStreams(), 4u);
+  EXPECT_NE(manager.getStream(20), nullptr);
+
+  manager.onStreamLimitUpdateSent(true, 6);
+  EXPECT_FALSE(manager.hasStreamLimitUpdates());
+  // An older limit isn't sent again.
+  manager.onStreamLimitUpdateLost(true, 4);
+  EXPECT_FALSE(manager.hasStreamLimitUpdates());
+  manager.onStreamLimitUpdateLost(true, 6);
+  EXPECT_EQ(*manager.remoteBidirectionalStreamLimitUpdate(), 6u);
+}
 } // namespace test
 } // namespace quic
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/QuicTransportStatsAccumulator.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+TEST(QuicTransportStatsAccumulatorTest, AccumulatesAndMerges) {
+  QuicTransportStatsAccumulator first;
+  first.onPacketReceived();
+  first.onPacketReceived();
+  first.onPacketDropped(
+      QuicTransportStatsCallback::PacketDropReason::PARSE_ERROR);
+  first.onConnectionClose();
+  first.onConnectionClose(
+      QuicTransportStatsCallback::ConnectionCloseReason::IDLE_TIMEOUT);
+  first.onRead(100);
+  first.onConnectionRtt(
+      std::chrono::microseconds(20000), std::chrono::microseconds(10000));
+  ConnectionLatencies latencies;
+  latencies.writeLoop.add(std::chrono::microseconds(50));
+  first.onConnectionLatencies(latencies);
+  first.onStreamReassembly(std::chrono::microseconds(300), 2, 1000);
+
+  QuicTransportStatsAccumulator second;
+  second.onPacketReceived();
+  second.onRead(50);
+  second.onStreamReassembly(std::chrono::microseconds(0), 1, 4000);
+  second.onConnectionLatencies(latencies);
+
+  QuicTransportStats stats;
+  stats.merge(first.getStats());
+  stats.merge(second.getStats());
+  EXPECT_EQ(3, stats.packetsReceived);
+  EXPECT_EQ(
+      1,
+      stats.packetsDropped[static_cast<size_t>(
+          QuicTransportStatsCallback::PacketDropReason::PARSE_ERROR)]);
+  EXPECT_EQ(2, stats.connectionsClosed);
+  EXPECT_EQ(
+      1,
+      stats.connectionCloseReasons[static_cast<size_t>(
+          QuicTransportStatsCallback::ConnectionCloseReason::IDLE_TIMEOUT)]);
+  EXPECT_EQ(150, stats.bytesRead);
+  EXPECT_EQ(1, stats.srtt.count);
+  EXPECT_EQ(std::chrono::microseconds(10000), stats.minRtt.max);
+  EXPECT_EQ(2, stats.latencies.writeLoop.count);
+  EXPECT_EQ(2, stats.streamHolbTime.count);
+  EXPECT_EQ(std::chrono::microseconds(300), stats.streamHolbTime.max);
+  EXPECT_EQ(3, stats.streamReadGaps);
+  EXPECT_EQ(4000, stats.maxStreamReassemblyBytes);
+
+  first.resetStats();
+  EXPECT_EQ(0, first.getStats().packetsReceived);
+  EXPECT_EQ(0, first.getStats().latencies.writeLoop.count);
+}
+
+} // namespace test
+} // namespace quic
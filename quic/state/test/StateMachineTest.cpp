@@ -123,12 +123,29 @@ void Handler<Machine, State2, Event2>::handle(
   transit<State3>(s);
 }
 
+struct ConnectionStateEnum {
+  EnumState<State1, State2, State3> state{State1()};
+  bool visitedState1Event1{false};
+  bool visitedState1Event2{false};
+  bool visitedState2Event2{false};
+};
+
+// Uses the handlers of TestMachineT.
+struct TestMachineEnum {
+  using StateData = ConnectionStateEnum;
+  using UserData = ConnectionStateEnum;
+  static void InvalidEventHandler(ConnectionStateEnum& /*s*/) {
+    throw InvalidHandlerException("invalid state in enum machine");
+  }
+};
+
 namespace test {
 
 class StateMachineTest : public Test {
  public:
   ConnectionState state;
   ConnectionStateT<int> stateT;
+  ConnectionStateEnum stateEnum;
 };
 
 TEST_F(StateMachineTest, TestTransitions) {
@@ -181,5 +198,32 @@ TEST_F(StateMachineTest, TestTemplateInvalid) {
       invokeHandler<TestMachineT<int>>(stateT, Event1(), stateT),
       InvalidHandlerException);
 }
+
+TEST_F(StateMachineTest, TestEnumTransitions) {
+  EXPECT_TRUE(stateEnum.state.is<State1>());
+  invokeHandler<TestMachineEnum>(stateEnum, Event1(), stateEnum);
+  EXPECT_TRUE(stateEnum.visitedState1Event1);
+  EXPECT_FALSE(stateEnum.visitedState1Event2);
+  EXPECT_FALSE(stateEnum.visitedState2Event2);
+  EXPECT_TRUE(stateEnum.state.is<State2>());
+  bool matches = matchesStates<decltype(stateEnum.state), State1, State2>(
+      stateEnum.state);
+  EXPECT_TRUE(matches);
+
+  invokeHandler<TestMachineEnum>(stateEnum, Event2(), stateEnum);
+  EXPECT_TRUE(stateEnum.visitedState2Event2);
+  EXPECT_TRUE(stateEnum.state.is<State3>());
+  matches = matchesStates<decltype(stateEnum.state), State1, State2>(
+      stateEnum.state);
+  EXPECT_FALSE(matches);
+}
+
+TEST_F(StateMachineTest, TestEnumInvalid) {
+  stateEnum.state = State2();
+  EXPECT_THROW(
+      invokeHandler<TestMachineEnum>(stateEnum, Event1(), stateEnum),
+      InvalidHandlerException);
+  EXPECT_TRUE(stateEnum.state.is<State2>());
+}
 } // namespace test
 } // namespace quic